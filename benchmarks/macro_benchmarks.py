@@ -0,0 +1,173 @@
+"""End-to-end benchmarks of the structure learning algorithms of PyBNesian.
+
+The data of each configuration is sampled from a known network (with random structure and parameters) using
+BayesianNetwork.sample(). Each configuration is executed in its own process, and the report contains its wall time, peak
+RSS, number of local score evaluations and independence tests, and the structural Hamming distance (SHD) between the
+learned and the known structures:
+
+    python benchmarks/macro_benchmarks.py --output macro.json
+    python benchmarks/macro_benchmarks.py --quick --filter hc.
+"""
+import argparse
+import multiprocessing
+import sys
+import time
+import pybnesian as pbn
+import util_benchmark
+
+BN_TYPES = {
+    "gaussian": pbn.GaussianNetworkType,
+    "discrete": pbn.DiscreteBNType,
+    "clg": pbn.CLGNetworkType,
+}
+
+
+def hc_learner(score, bn_type=None):
+    def learn(df, kind):
+        model_type = bn_type() if bn_type is not None else BN_TYPES[kind]()
+        return pbn.hc(df, bn_type=model_type, score=score, seed=0)
+
+    return learn
+
+
+def pc_learner(test_class, **test_kwargs):
+    def learn(df, kind):
+        return pbn.PC().estimate(test_class(df, **test_kwargs))
+
+    return learn
+
+
+def mmhc_learner(test_class, **test_kwargs):
+    def learn(df, kind):
+        return pbn.MMHC().estimate(test_class(df, **test_kwargs),
+                                   pbn.ArcOperatorSet(),
+                                   pbn.BIC(df),
+                                   bn_type=BN_TYPES[kind]())
+
+    return learn
+
+
+# (name, data kind, maximum number of nodes, maximum number of rows, learner). The configurations with non-parametric
+# models or tests are limited to smaller sizes.
+CONFIGURATIONS = [
+    ("hc.bic", "gaussian", None, None, hc_learner("bic")),
+    ("hc.bge", "gaussian", None, None, hc_learner("bge")),
+    ("hc.cv-lik", "gaussian", None, None, hc_learner("cv-lik")),
+    ("hc.bic", "clg", None, None, hc_learner("bic")),
+    ("hc.cv-lik", "clg", None, None, hc_learner("cv-lik")),
+    ("hc.cv-lik.spbn", "gaussian", 50, 10000, hc_learner("cv-lik", pbn.SemiparametricBNType)),
+    ("pc.LinearCorrelation", "gaussian", None, None, pc_learner(pbn.LinearCorrelation)),
+    ("pc.KMutualInformation", "gaussian", 50, 10000, pc_learner(pbn.KMutualInformation, k=10, seed=0, samples=100)),
+    ("pc.RCoT", "gaussian", 200, 100000, pc_learner(pbn.RCoT, seed=0)),
+    ("pc.ChiSquare", "discrete", None, None, pc_learner(pbn.ChiSquare)),
+    ("pc.MutualInformation", "clg", None, None, pc_learner(pbn.MutualInformation)),
+    ("mmhc.LinearCorrelation", "gaussian", None, None, mmhc_learner(pbn.LinearCorrelation)),
+    ("mmhc.KMutualInformation", "gaussian", 50, 10000,
+     mmhc_learner(pbn.KMutualInformation, k=10, seed=0, samples=100)),
+    ("mmhc.RCoT", "gaussian", 200, 100000, mmhc_learner(pbn.RCoT, seed=0)),
+    ("mmhc.ChiSquare", "discrete", None, None, mmhc_learner(pbn.ChiSquare)),
+    ("mmhc.MutualInformation", "clg", None, None, mmhc_learner(pbn.MutualInformation)),
+]
+
+
+def peak_rss_bytes():
+    """Returns the peak resident set size of this process, or None if it is not available in this platform."""
+    try:
+        import resource
+    except ImportError:
+        return None
+
+    maxrss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # ru_maxrss is in bytes in macOS and in kilobytes in Linux.
+    return maxrss if sys.platform == "darwin" else maxrss * 1024
+
+
+def profiler_counts(stats):
+    """Sums the profiler counters of the local score evaluations, the independence tests and the CPD fits."""
+    def calls(prefix, parts):
+        return sum(c.calls for name, c in stats.items() if name.startswith(prefix) and name.count(":") == parts)
+
+    return {
+        "local_score_evaluations": calls("local_score:", 1),
+        "independence_tests": calls("pvalue:", 1),
+        "cpd_fits": calls("fit:", 1),
+    }
+
+
+def run_configuration(index, kind, nodes, rows, queue):
+    learn = CONFIGURATIONS[index][4]
+    try:
+        true_model = util_benchmark.known_network(kind, nodes, seed=0)
+        df = util_benchmark.sample_known_network(true_model, rows, seed=0)
+
+        pbn.reset_profiler()
+        pbn.enable_profiler()
+        start = time.perf_counter()
+        learned = learn(df, kind)
+        seconds = time.perf_counter() - start
+        pbn.disable_profiler()
+
+        result = {
+            "seconds": seconds,
+            "peak_rss_bytes": peak_rss_bytes(),
+            "shd": util_benchmark.structural_hamming_distance(true_model, learned),
+            "true_arcs": true_model.num_arcs(),
+        }
+        result.update(profiler_counts(pbn.profiler_stats()))
+        queue.put(result)
+    except Exception as e:
+        queue.put({"error": "{}: {}".format(type(e).__name__, e)})
+
+
+def run_benchmarks(nodes, rows, name_filter=None, verbose=True):
+    # Each configuration runs in a new process, so the peak RSS of the configurations are independent.
+    context = multiprocessing.get_context("spawn")
+    results = []
+
+    for index, (name, kind, max_nodes, max_rows, _) in enumerate(CONFIGURATIONS):
+        if name_filter is not None and name_filter not in name:
+            continue
+
+        for n in nodes:
+            if max_nodes is not None and n > max_nodes:
+                continue
+
+            for r in rows:
+                if max_rows is not None and r > max_rows:
+                    continue
+
+                queue = context.Queue()
+                process = context.Process(target=run_configuration, args=(index, kind, n, r, queue))
+                process.start()
+                process.join()
+                # The process can be killed (e.g., if it runs out of memory) before it returns the result.
+                result = queue.get() if not queue.empty() else {"error": "exit code " + str(process.exitcode)}
+
+                params = {"data": kind, "nodes": n, "rows": r}
+                results.append({"name": name, "params": params, "result": result})
+
+                if verbose:
+                    print("{} {}: {}".format(name, params, result), flush=True)
+
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Runs the end-to-end structure learning benchmarks of PyBNesian.")
+    parser.add_argument("--nodes", type=int, nargs="+", default=[50, 200, 1000], help="Number of nodes.")
+    parser.add_argument("--rows", type=int, nargs="+", default=[10000, 100000, 1000000], help="Number of rows.")
+    parser.add_argument("--filter", default=None, help="Only runs the configurations whose name contains this string.")
+    parser.add_argument("--quick", action="store_true", help="Runs small sizes only (20 nodes, 2000 rows).")
+    parser.add_argument("--output", default=None, help="File of the JSON report. By default, it is printed to stdout.")
+    args = parser.parse_args()
+
+    nodes, rows = args.nodes, args.rows
+    if args.quick:
+        nodes, rows = [20], [2000]
+
+    results = run_benchmarks(nodes, rows, args.filter, verbose=args.output is not None)
+    util_benchmark.write_report("macro", results, args.output)
+
+
+if __name__ == "__main__":
+    main()
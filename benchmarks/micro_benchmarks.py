@@ -0,0 +1,159 @@
+"""Micro-benchmarks of the hot paths of PyBNesian: the local scores, the independence tests and the KDE log-likelihood.
+
+Each benchmark is executed over synthetic data of several sizes and the timings are written as a JSON report:
+
+    python benchmarks/micro_benchmarks.py --output micro.json
+    python benchmarks/micro_benchmarks.py --quick --filter score.
+"""
+import argparse
+import numpy as np
+import pybnesian as pbn
+import util_benchmark
+
+
+def evidence_sets(columns):
+    """Returns (variable, evidence) pairs with the previous 0, 1 and 2 columns as evidence."""
+    return [(columns[i], columns[i - k:i]) for i in range(2, len(columns)) for k in range(3)]
+
+
+def independence_sets(columns):
+    """Returns (x, y, evidence) triples with the 0, 1 and 2 columns between x and y as evidence."""
+    return [(columns[i], columns[i - 3], columns[i - k:i]) for i in range(3, len(columns)) for k in range(3)]
+
+
+def pvalue(test, x, y, evidence):
+    if not evidence:
+        return test.pvalue(x, y)
+    elif len(evidence) == 1:
+        return test.pvalue(x, y, evidence[0])
+    else:
+        return test.pvalue(x, y, evidence)
+
+
+def score_benchmark(score_class, model_class, node_type=None, **score_kwargs):
+    def benchmark(df):
+        columns = list(df.columns.values)
+
+        def setup():
+            if node_type is not None:
+                model = model_class(columns, [(c, node_type) for c in columns])
+            else:
+                model = model_class(columns)
+            model.set_unknown_node_types(df)
+            return score_class(df, **score_kwargs), model
+
+        def run(state):
+            score, model = state
+            for variable, evidence in evidence_sets(columns):
+                score.local_score(model, variable, evidence)
+
+        return setup, run
+
+    return benchmark
+
+
+def independence_benchmark(test_class, **test_kwargs):
+    def benchmark(df):
+        columns = list(df.columns.values)
+
+        def setup():
+            return test_class(df, **test_kwargs)
+
+        def run(test):
+            for x, y, evidence in independence_sets(columns):
+                pvalue(test, x, y, evidence)
+
+        return setup, run
+
+    return benchmark
+
+
+def kde_benchmark(max_variables=3):
+    def benchmark(df):
+        columns = list(df.columns.values)[:max_variables]
+        rng = np.random.default_rng(0)
+        test_df = df.iloc[rng.permutation(df.shape[0])]
+
+        def setup():
+            kde = pbn.KDE(columns, backend=pbn.KDEBackend.CPU)
+            kde.fit(df)
+            return kde
+
+        def run(kde):
+            kde.logl(test_df)
+
+        return setup, run
+
+    return benchmark
+
+
+# (name, data kind, maximum number of rows, benchmark). The benchmarks with a quadratic cost in the number of rows are
+# limited to a maximum number of rows.
+BENCHMARKS = [
+    ("score.BIC.local_score", "gaussian", None, score_benchmark(pbn.BIC, pbn.GaussianNetwork)),
+    ("score.BIC.local_score", "discrete", None, score_benchmark(pbn.BIC, pbn.DiscreteBN)),
+    ("score.BIC.local_score", "clg", None, score_benchmark(pbn.BIC, pbn.CLGNetwork)),
+    ("score.BGe.local_score", "gaussian", None, score_benchmark(pbn.BGe, pbn.GaussianNetwork)),
+    ("score.BDe.local_score", "discrete", None, score_benchmark(pbn.BDe, pbn.DiscreteBN)),
+    ("score.CVLikelihood.local_score", "gaussian", None,
+     score_benchmark(pbn.CVLikelihood, pbn.GaussianNetwork, k=10, seed=0)),
+    ("score.CVLikelihood.local_score.CKDE", "gaussian", 10000,
+     score_benchmark(pbn.CVLikelihood, pbn.SemiparametricBN, node_type=pbn.CKDEType(), k=10, seed=0)),
+    ("test.LinearCorrelation.pvalue", "gaussian", None, independence_benchmark(pbn.LinearCorrelation)),
+    ("test.KMutualInformation.pvalue", "gaussian", 10000,
+     independence_benchmark(pbn.KMutualInformation, k=10, seed=0, samples=10)),
+    ("test.RCoT.pvalue", "gaussian", None, independence_benchmark(pbn.RCoT, seed=0)),
+    ("test.ChiSquare.pvalue", "discrete", None, independence_benchmark(pbn.ChiSquare)),
+    ("test.MutualInformation.pvalue", "clg", None, independence_benchmark(pbn.MutualInformation)),
+    ("kde.KDE.logl", "gaussian", 10000, kde_benchmark()),
+]
+
+
+def run_benchmarks(rows, columns, repeat, name_filter=None, verbose=True):
+    results = []
+    data = {}
+
+    for name, kind, max_rows, benchmark in BENCHMARKS:
+        if name_filter is not None and name_filter not in name:
+            continue
+
+        for n in rows:
+            if max_rows is not None and n > max_rows:
+                continue
+
+            for d in columns:
+                if (kind, n, d) not in data:
+                    data[(kind, n, d)] = util_benchmark.generate_data(kind, n, d)
+
+                setup, run = benchmark(data[(kind, n, d)])
+                seconds = util_benchmark.time_benchmark(setup, run, repeat)
+
+                params = {"data": kind, "rows": n, "columns": d}
+                results.append({"name": name, "params": params, "repeat": repeat, "seconds": seconds})
+
+                if verbose:
+                    print("{} {}: {:.6f} s".format(name, params, seconds["median"]), flush=True)
+
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Runs the micro-benchmarks of PyBNesian.")
+    parser.add_argument("--rows", type=int, nargs="+", default=[1000, 10000, 100000], help="Number of rows.")
+    parser.add_argument("--columns", type=int, nargs="+", default=[5, 20], help="Number of columns.")
+    parser.add_argument("--repeat", type=int, default=5, help="Number of timed executions of each benchmark.")
+    parser.add_argument("--filter", default=None, help="Only runs the benchmarks whose name contains this string.")
+    parser.add_argument("--quick", action="store_true", help="Runs small sizes only (1000 rows, 5 columns).")
+    parser.add_argument("--output", default=None, help="File of the JSON report. By default, it is printed to stdout.")
+    args = parser.parse_args()
+
+    rows, columns, repeat = args.rows, args.columns, args.repeat
+    if args.quick:
+        rows, columns, repeat = [1000], [5], min(repeat, 3)
+
+    results = run_benchmarks(rows, columns, repeat, args.filter, verbose=args.output is not None)
+    util_benchmark.write_report("micro", results, args.output)
+
+
+if __name__ == "__main__":
+    main()
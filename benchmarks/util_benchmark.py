@@ -0,0 +1,217 @@
+import json
+import platform
+import statistics
+import sys
+import time
+import numpy as np
+import pandas as pd
+import pybnesian as pbn
+
+# Version of the JSON report. It is increased when a key is renamed or removed, so the dashboards that track the
+# reports can detect incompatible changes.
+SCHEMA_VERSION = 1
+
+
+def linear_parents(d, max_parents=2):
+    """Returns the parents of each node i of a model with d nodes: the max_parents previous nodes."""
+    return [list(range(max(0, i - max_parents), i)) for i in range(d)]
+
+
+def generate_gaussian_data(n, d, seed=0):
+    """Samples n rows of d continuous variables. Each variable is a linear Gaussian of the two previous variables."""
+    rng = np.random.default_rng(seed)
+    data = np.empty((n, d))
+
+    for i, parents in enumerate(linear_parents(d)):
+        coefs = rng.uniform(0.5, 2, size=len(parents)) * rng.choice([-1, 1], size=len(parents))
+        data[:, i] = rng.normal(0, 1, size=n) + data[:, parents] @ coefs
+
+    return pd.DataFrame(data, columns=["x" + str(i) for i in range(d)])
+
+
+def generate_discrete_data(n, d, seed=0, categories=3):
+    """Samples n rows of d discrete variables. Each variable copies the sum of its two previous variables with
+    probability 0.6, and is uniformly sampled otherwise."""
+    rng = np.random.default_rng(seed)
+    data = np.empty((n, d), dtype=int)
+
+    for i, parents in enumerate(linear_parents(d)):
+        uniform = rng.integers(0, categories, size=n)
+        if parents:
+            copy = data[:, parents].sum(axis=1) % categories
+            data[:, i] = np.where(rng.uniform(size=n) < 0.6, copy, uniform)
+        else:
+            data[:, i] = uniform
+
+    labels = np.asarray(["c" + str(c) for c in range(categories)])
+    return pd.DataFrame({"x" + str(i): labels[data[:, i]] for i in range(d)}, dtype="category")
+
+
+def generate_clg_data(n, d, seed=0, categories=3):
+    """Samples n rows of d variables: the first d // 2 are discrete and the rest are conditional linear Gaussians with
+    the previous continuous variable and a discrete variable as parents."""
+    rng = np.random.default_rng(seed)
+    num_discrete = max(1, d // 2)
+    discrete = generate_discrete_data(n, num_discrete, seed, categories)
+
+    df = discrete.copy()
+    previous = np.zeros(n)
+    for i in range(num_discrete, d):
+        codes = discrete.iloc[:, i % num_discrete].cat.codes.to_numpy()
+        means = rng.normal(0, 2, size=categories)
+        previous = means[codes] + 0.8 * previous + rng.normal(0, 1, size=n)
+        df["x" + str(i)] = previous
+
+    return df
+
+
+def generate_data(kind, n, d, seed=0):
+    if kind == "gaussian":
+        return generate_gaussian_data(n, d, seed)
+    elif kind == "discrete":
+        return generate_discrete_data(n, d, seed)
+    elif kind == "clg":
+        return generate_clg_data(n, d, seed)
+    else:
+        raise ValueError("Wrong data kind: " + kind)
+
+
+def random_dag(num_nodes, max_parents=3, window=10, seed=0):
+    """Returns the arcs of a random DAG. The parents of each node i are sampled from the window previous nodes, so the
+    DAGs of large networks are sparse and the order of the nodes is a topological sort."""
+    rng = np.random.default_rng(seed)
+    arcs = []
+    for i in range(1, num_nodes):
+        candidates = np.arange(max(0, i - window), i)
+        num_parents = rng.integers(0, min(max_parents, candidates.size) + 1)
+        for p in rng.choice(candidates, size=num_parents, replace=False):
+            arcs.append((int(p), i))
+
+    return arcs
+
+
+def known_network(kind, num_nodes, seed=0, seed_rows=5000, categories=3):
+    """Returns a known network of num_nodes nodes (with random structure and parameters) to sample benchmark data.
+
+    The parameters are fitted from seed_rows rows sampled with numpy following the structure of the network. For the
+    "clg" kind, the first third of the nodes is discrete, so the discrete nodes only have discrete parents."""
+    rng = np.random.default_rng(seed)
+    names = ["x" + str(i) for i in range(num_nodes)]
+    num_discrete = {"gaussian": 0, "discrete": num_nodes, "clg": num_nodes // 3}[kind]
+
+    arcs = random_dag(num_nodes, seed=seed)
+    parents = [[] for _ in range(num_nodes)]
+    for p, c in arcs:
+        parents[c].append(p)
+
+    labels = np.asarray(["c" + str(c) for c in range(categories)])
+    codes = np.zeros((seed_rows, num_discrete), dtype=int)
+    continuous = np.zeros((seed_rows, num_nodes))
+
+    for i in range(num_nodes):
+        discrete_parents = [p for p in parents[i] if p < num_discrete]
+        config = np.zeros(seed_rows, dtype=int)
+        for p in discrete_parents:
+            config = config * categories + codes[:, p]
+
+        if i < num_discrete:
+            cpt = rng.dirichlet(np.ones(categories), size=categories ** len(discrete_parents))
+            cumulative = cpt[config].cumsum(axis=1)
+            codes[:, i] = (rng.uniform(size=(seed_rows, 1)) > cumulative).sum(axis=1).clip(max=categories - 1)
+        else:
+            continuous_parents = [p for p in parents[i] if p >= num_discrete]
+            num_continuous = len(continuous_parents)
+            coefs = rng.uniform(0.5, 2, size=num_continuous) * rng.choice([-1, 1], size=num_continuous)
+            means = rng.normal(0, 2, size=categories ** len(discrete_parents))
+            linear = continuous[:, continuous_parents] @ coefs
+            # Standardizes the linear combination, so the variance does not grow along the network.
+            if continuous_parents:
+                linear = (linear - linear.mean()) / max(linear.std(), 1e-8)
+            continuous[:, i] = means[config] + linear + rng.normal(0, 1, size=seed_rows)
+
+    df = pd.DataFrame({names[i]: (pd.Categorical(labels[codes[:, i]], categories=labels)
+                                  if i < num_discrete else continuous[:, i]) for i in range(num_nodes)})
+
+    model_class = {"gaussian": pbn.GaussianNetwork, "discrete": pbn.DiscreteBN, "clg": pbn.CLGNetwork}[kind]
+    model = model_class(names, [(names[p], names[c]) for p, c in arcs])
+    model.fit(df)
+    return model
+
+
+def sample_known_network(model, rows, seed=0):
+    """Samples rows instances of the known network with BayesianNetwork.sample()."""
+    return model.sample(rows, seed=seed, ordered=True).to_pandas()
+
+
+def structural_hamming_distance(true_graph, graph):
+    """Returns the structural Hamming distance between the CPDAGs of two graphs: the number of node pairs whose
+    connection (no connection, undirected edge, or arc in each direction) is different."""
+
+    def cpdag(g):
+        if hasattr(g, "edges"):
+            return g
+        return pbn.Dag(g.nodes(), g.arcs()).to_pdag()
+
+    def connections(g):
+        res = {}
+        for s, t in g.arcs():
+            res[frozenset((s, t))] = (s, t)
+        for s, t in g.edges():
+            res[frozenset((s, t))] = None
+        return res
+
+    true_connections = connections(cpdag(true_graph))
+    learned_connections = connections(cpdag(graph))
+
+    pairs = set(true_connections) | set(learned_connections)
+    return sum(1 for pair in pairs if true_connections.get(pair, "none") != learned_connections.get(pair, "none"))
+
+
+def time_benchmark(setup, run, repeat, warmup=1):
+    """Times run(setup()) repeat times, after warmup executions. The setup is not timed, so each execution starts from
+    the same (not cached) state."""
+    for _ in range(warmup):
+        run(setup())
+
+    times = []
+    for _ in range(repeat):
+        state = setup()
+        start = time.perf_counter()
+        run(state)
+        times.append(time.perf_counter() - start)
+
+    return {
+        "min": min(times),
+        "median": statistics.median(times),
+        "mean": statistics.mean(times),
+        "stdev": statistics.stdev(times) if len(times) > 1 else 0.,
+    }
+
+
+def environment():
+    return {
+        "pybnesian_version": getattr(pbn, "__version__", "unknown"),
+        "python_version": platform.python_version(),
+        "platform": platform.platform(),
+        "machine": platform.machine(),
+        "processor": platform.processor(),
+    }
+
+
+def write_report(suite, results, output=None):
+    """Writes the JSON report of a suite. The results are sorted by name and parameters, and the keys of each object
+    are sorted, so the reports of different runs can be diffed."""
+    report = {
+        "schema_version": SCHEMA_VERSION,
+        "suite": suite,
+        "environment": environment(),
+        "benchmarks": sorted(results, key=lambda r: (r["name"], json.dumps(r["params"], sort_keys=True))),
+    }
+
+    if output is None:
+        json.dump(report, sys.stdout, indent=2, sort_keys=True)
+        sys.stdout.write("\n")
+    else:
+        with open(output, "w") as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+            f.write("\n")
@@ -0,0 +1,149 @@
+#include <arrow/array/concatenate.h>
+#include <dataset/chunked_dataframe.hpp>
+
+namespace dataset {
+
+namespace {
+
+// The kernels of DataFrame read the null bitmaps from the first bit, so the batch columns that are slices of a chunk
+// (with an offset) and contain nulls are copied. The copy is limited to the rows of one batch.
+Array_ptr aligned_column(const Array_ptr& column) {
+    if (column->offset() == 0 || column->null_count() == 0) return column;
+
+    RAISE_RESULT_ERROR(auto copied, arrow::Concatenate({column}))
+    return copied;
+}
+
+std::vector<DataFrame> table_batches(const std::shared_ptr<arrow::Table>& table) {
+    std::vector<DataFrame> batches;
+
+    arrow::TableBatchReader reader(*table);
+    std::shared_ptr<RecordBatch> batch;
+    while (true) {
+        RAISE_STATUS_ERROR(reader.ReadNext(&batch));
+        if (!batch) break;
+        if (batch->num_rows() == 0) continue;
+
+        Array_vector columns;
+        columns.reserve(batch->num_columns());
+        for (const auto& column : batch->columns()) {
+            columns.push_back(aligned_column(column));
+        }
+
+        batches.push_back(DataFrame(RecordBatch::Make(batch->schema(), batch->num_rows(), columns)));
+    }
+
+    return batches;
+}
+
+std::shared_ptr<arrow::Table> table_from_dataframe(const DataFrame& df) {
+    RAISE_RESULT_ERROR(auto table, arrow::Table::FromRecordBatches({df.record_batch()}))
+    return table;
+}
+
+void check_continuous_columns(const std::shared_ptr<arrow::Schema>& schema, const std::vector<std::string>& columns) {
+    for (const auto& name : columns) {
+        auto field = schema->GetFieldByName(name);
+        if (!field) throw std::invalid_argument("Column index " + name + " do not exist in ChunkedDataFrame.");
+
+        switch (field->type()->id()) {
+            case Type::DOUBLE:
+            case Type::FLOAT:
+                break;
+            default:
+                throw std::invalid_argument("Column " + name + " must have \"double\" or \"float\" data type.");
+        }
+    }
+}
+
+}  // namespace
+
+ChunkedDataFrame::ChunkedDataFrame(std::shared_ptr<arrow::Table> table)
+    : m_table(std::move(table)), m_batches(table_batches(m_table)) {}
+
+ChunkedDataFrame::ChunkedDataFrame(const DataFrame& df) : ChunkedDataFrame(table_from_dataframe(df)) {}
+
+VectorXd ChunkedDataFrame::means(const std::vector<std::string>& columns) const {
+    check_continuous_columns(m_table->schema(), columns);
+
+    VectorXd sum = VectorXd::Zero(columns.size());
+    VectorXd rows = VectorXd::Zero(columns.size());
+
+    for (const auto& b : m_batches) {
+        for (size_t i = 0; i < columns.size(); ++i) {
+            auto column = b.col(columns[i]);
+            auto valid = column->length() - column->null_count();
+            if (valid == 0) continue;
+
+            sum(i) += mean(column) * valid;
+            rows(i) += valid;
+        }
+    }
+
+    return sum.cwiseQuotient(rows);
+}
+
+ChunkedDataFrame::Moments ChunkedDataFrame::moments(const std::vector<std::string>& columns) const {
+    check_continuous_columns(m_table->schema(), columns);
+
+    auto n = columns.size();
+    Moments res{0, VectorXd::Zero(n), MatrixXd::Zero(n, n)};
+
+    // The moments of the batches are merged with the pairwise update of Chan et al., which is stable for any number of
+    // batches.
+    for (const auto& b : m_batches) {
+        Buffer_ptr bitmap = b.null_count(columns) > 0 ? b.combined_bitmap(columns) : nullptr;
+        int64_t rows = bitmap ? util::bit_util::non_null_count(bitmap, b.num_rows()) : b.num_rows();
+        if (rows == 0) continue;
+
+        VectorXd batch_means = bitmap ? b.means(bitmap, columns) : b.means(columns);
+        MatrixXd batch_sse;
+        switch (b.same_type(columns)->id()) {
+            case Type::DOUBLE:
+                batch_sse = std::move(*b.sse<arrow::DoubleType>(bitmap, columns.begin(), columns.end()));
+                break;
+            case Type::FLOAT:
+                batch_sse = b.sse<arrow::FloatType>(bitmap, columns.begin(), columns.end())->template cast<double>();
+                break;
+            default:
+                throw std::invalid_argument("The columns of ChunkedDataFrame must have the same data type.");
+        }
+
+        auto total = res.rows + rows;
+        VectorXd delta = batch_means - res.means;
+        double weight = static_cast<double>(res.rows) * static_cast<double>(rows) / static_cast<double>(total);
+
+        res.sse += batch_sse + weight * delta * delta.transpose();
+        res.means += delta * (static_cast<double>(rows) / static_cast<double>(total));
+        res.rows = total;
+    }
+
+    return res;
+}
+
+MatrixXd ChunkedDataFrame::sse(const std::vector<std::string>& columns) const { return moments(columns).sse; }
+
+MatrixXd ChunkedDataFrame::cov(const std::vector<std::string>& columns) const {
+    auto m = moments(columns);
+    return m.sse / static_cast<double>(m.rows - 1);
+}
+
+DataFrame ChunkedDataFrame::combine() const {
+    Array_vector columns;
+    columns.reserve(m_table->num_columns());
+    for (const auto& column : m_table->columns()) {
+        if (column->num_chunks() == 1) {
+            columns.push_back(column->chunk(0));
+        } else if (column->num_chunks() == 0) {
+            RAISE_RESULT_ERROR(auto empty, arrow::MakeArrayOfNull(column->type(), 0))
+            columns.push_back(empty);
+        } else {
+            RAISE_RESULT_ERROR(auto combined, arrow::Concatenate(column->chunks()))
+            columns.push_back(combined);
+        }
+    }
+
+    return DataFrame(RecordBatch::Make(m_table->schema(), m_table->num_rows(), columns));
+}
+
+}  // namespace dataset
@@ -0,0 +1,93 @@
+#ifndef PYBNESIAN_DATASET_CHUNKED_DATAFRAME_HPP
+#define PYBNESIAN_DATASET_CHUNKED_DATAFRAME_HPP
+
+#include <dataset/dataset.hpp>
+
+using Eigen::MatrixXd, Eigen::VectorXd;
+
+namespace dataset {
+
+// An arrow::Table with chunked columns (as read from Parquet files or Arrow datasets) that is processed in batches
+// instead of being concatenated into one DataFrame. The batches are zero-copy DataFrames of consecutive rows that end
+// at the chunk boundaries of every column, so the peak memory is the Table plus the statistics of one batch.
+class ChunkedDataFrame {
+public:
+    ChunkedDataFrame(std::shared_ptr<arrow::Table> table);
+    // A ChunkedDataFrame with one batch.
+    ChunkedDataFrame(const DataFrame& df);
+
+    const std::shared_ptr<arrow::Table>& table() const { return m_table; }
+    const arrow::Table* operator->() const { return m_table.get(); }
+
+    int64_t num_rows() const { return m_table->num_rows(); }
+    int num_columns() const { return m_table->num_columns(); }
+    std::vector<std::string> column_names() const { return m_table->ColumnNames(); }
+
+    int num_batches() const { return m_batches.size(); }
+    const DataFrame& batch(int i) const {
+        if (i < 0 || i >= num_batches())
+            throw std::invalid_argument("Batch index " + std::to_string(i) + " do not exist in ChunkedDataFrame.");
+        return m_batches[i];
+    }
+    const std::vector<DataFrame>& batches() const { return m_batches; }
+
+    // Calls f(batch) for each batch, in order.
+    template <typename F>
+    void for_each_batch(F&& f) const {
+        for (const auto& b : m_batches) {
+            f(b);
+        }
+    }
+
+    // Returns the mean of each column, ignoring the null values of the column. The columns must be "double" or
+    // "float".
+    VectorXd means(const std::vector<std::string>& columns) const;
+    // Returns the sum of squared errors (and the covariance) of the columns in the rows where all of them are valid.
+    MatrixXd sse(const std::vector<std::string>& columns) const;
+    MatrixXd cov(const std::vector<std::string>& columns) const;
+
+    // Returns a DataFrame with all the rows. It copies the data of the columns with more than one chunk.
+    DataFrame combine() const;
+
+private:
+    struct Moments {
+        int64_t rows;
+        VectorXd means;
+        MatrixXd sse;
+    };
+
+    Moments moments(const std::vector<std::string>& columns) const;
+
+    std::shared_ptr<arrow::Table> m_table;
+    std::vector<DataFrame> m_batches;
+};
+
+}  // namespace dataset
+
+namespace pybind11::detail {
+template <>
+struct type_caster<std::shared_ptr<arrow::Table>> {
+public:
+    PYBIND11_TYPE_CASTER(std::shared_ptr<arrow::Table>, _("pyarrow.Table"));
+
+    bool load(handle src, bool) {
+        PyObject* py_ptr = src.ptr();
+
+        if (pyarrow::is_table(py_ptr)) {
+            auto result = pyarrow::unwrap_table(py_ptr);
+            if (result.ok()) {
+                value = result.ValueOrDie();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static handle cast(std::shared_ptr<arrow::Table> src, return_value_policy /* policy */, handle /* parent */) {
+        return pyarrow::wrap_table(src);
+    }
+};
+}  // namespace pybind11::detail
+
+#endif  // PYBNESIAN_DATASET_CHUNKED_DATAFRAME_HPP
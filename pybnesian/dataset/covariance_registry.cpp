@@ -0,0 +1,76 @@
+#include <dataset/covariance_registry.hpp>
+
+namespace dataset {
+
+CovarianceRegistry& CovarianceRegistry::get() {
+    static CovarianceRegistry registry;
+    return registry;
+}
+
+CovarianceRegistry::ColumnKey CovarianceRegistry::column_key(const Array_ptr& column) {
+    const auto& data = column->data();
+    auto byte_width = std::static_pointer_cast<arrow::FixedWidthType>(column->type())->bit_width() / 8;
+    return ColumnKey{data->buffers[1]->data() + data->offset * byte_width, column->length(), column->type_id()};
+}
+
+CovarianceRegistry::PairKey CovarianceRegistry::pair_key(const Array_ptr& a, const Array_ptr& b) {
+    auto ka = column_key(a);
+    auto kb = column_key(b);
+    // The covariance is symmetric, so the pairs are sorted by the address of their values.
+    if (std::less<const uint8_t*>{}(kb.values, ka.values)) std::swap(ka, kb);
+    return PairKey{ka, kb};
+}
+
+bool CovarianceRegistry::lookup(const Array_vector& columns, MatrixXd& cov) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < columns.size(); ++i) {
+        for (size_t j = i; j < columns.size(); ++j) {
+            auto it = m_entries.find(pair_key(columns[i], columns[j]));
+            if (it == m_entries.end()) return false;
+
+            // The address of a released buffer can be reused by a different column.
+            auto first = it->second.first.lock();
+            auto second = it->second.second.lock();
+            if (!first || !second) return false;
+
+            cov(i, j) = cov(j, i) = it->second.covariance;
+        }
+    }
+
+    return true;
+}
+
+void CovarianceRegistry::insert(const Array_vector& columns, const MatrixXd& cov) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < columns.size(); ++i) {
+        for (size_t j = i; j < columns.size(); ++j) {
+            auto key = pair_key(columns[i], columns[j]);
+            auto a = columns[i]->data()->buffers[1];
+            auto b = columns[j]->data()->buffers[1];
+            if (key.first.values != column_key(columns[i]).values) std::swap(a, b);
+
+            auto [it, inserted] = m_entries.insert_or_assign(key, Entry{a, b, cov(i, j)});
+            if (inserted) m_order.push_back(it->first);
+        }
+    }
+
+    while (m_entries.size() > max_entries) {
+        m_entries.erase(m_order.front());
+        m_order.pop_front();
+    }
+}
+
+std::size_t CovarianceRegistry::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+void CovarianceRegistry::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_order.clear();
+}
+
+}  // namespace dataset
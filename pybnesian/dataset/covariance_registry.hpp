@@ -0,0 +1,118 @@
+#ifndef PYBNESIAN_DATASET_COVARIANCE_REGISTRY_HPP
+#define PYBNESIAN_DATASET_COVARIANCE_REGISTRY_HPP
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <dataset/dataset.hpp>
+#include <util/hash_utils.hpp>
+#include <util/profiler.hpp>
+
+using Eigen::MatrixXd;
+
+namespace dataset {
+
+// Caches the covariances between the pairs of double or float columns without null values of all the DataFrames of
+// the process. A column is identified by its values (the address of its first value, its length and its data type)
+// instead of its DataFrame, so the covariances are shared by all the DataFrames that contain the same columns: a
+// DataFrame and its selections of columns, or the training DataFrames of each fold of a CrossValidation, that are
+// slices of the same fold columns (see CrossValidationProperties::fold_column()). The entries keep weak references to
+// the buffers of their columns, so the entry of a released column is never returned for a new column allocated at the
+// same address.
+//
+// The covariance of two columns only depends on these two columns (see compute_cov()), so the matrices assembled from
+// the cache are equal to the result of cov(). The statistics of a bandwidth selector or an independence test are read
+// with O(d^2) lookups, and a pass over the data is only needed if some pair of columns is not cached. The entries are
+// evicted in FIFO order when the cache contains more than max_entries entries.
+class CovarianceRegistry {
+public:
+    static constexpr std::size_t max_entries = 1 << 20;
+
+    static CovarianceRegistry& get();
+
+    // Returns the covariance matrix of columns, as cov(). If some column contains null values, the covariance is
+    // computed with the rows where all the columns are valid, without using the cache.
+    template <typename ArrowType>
+    EigenMatrix<ArrowType> cov(const Array_vector& columns);
+
+    std::size_t size() const;
+    void clear();
+
+private:
+    CovarianceRegistry() : m_mutex(), m_entries(), m_order() {}
+
+    struct ColumnKey {
+        const uint8_t* values;
+        int64_t length;
+        arrow::Type::type type;
+
+        bool operator==(const ColumnKey& other) const {
+            return values == other.values && length == other.length && type == other.type;
+        }
+    };
+
+    struct PairKey {
+        ColumnKey first;
+        ColumnKey second;
+
+        bool operator==(const PairKey& other) const { return first == other.first && second == other.second; }
+    };
+
+    class HashPairKey {
+    public:
+        inline std::size_t operator()(const PairKey& key) const {
+            size_t seed = 0;
+            util::hash_combine(seed, key.first.values);
+            util::hash_combine(seed, key.first.length);
+            util::hash_combine(seed, key.second.values);
+            util::hash_combine(seed, key.second.length);
+            return seed;
+        }
+    };
+
+    struct Entry {
+        std::weak_ptr<arrow::Buffer> first;
+        std::weak_ptr<arrow::Buffer> second;
+        double covariance;
+    };
+
+    static ColumnKey column_key(const Array_ptr& column);
+    static PairKey pair_key(const Array_ptr& a, const Array_ptr& b);
+
+    // Copies the cached covariances of columns to cov. Returns false if some pair of columns is not cached.
+    bool lookup(const Array_vector& columns, MatrixXd& cov) const;
+    void insert(const Array_vector& columns, const MatrixXd& cov);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<PairKey, Entry, HashPairKey> m_entries;
+    std::deque<PairKey> m_order;
+};
+
+template <typename ArrowType>
+EigenMatrix<ArrowType> CovarianceRegistry::cov(const Array_vector& columns) {
+    using CType = typename ArrowType::c_type;
+    using MatrixType = Matrix<CType, Dynamic, Dynamic>;
+
+    // dataset::cov() takes non-const iterators.
+    Array_vector v = columns;
+    bool cacheable = !v.empty() && v[0]->length() > 1 && std::all_of(v.begin(), v.end(), [](const Array_ptr& c) {
+                         return c->null_count() == 0;
+                     });
+
+    if (!cacheable) return dataset::cov<ArrowType, true>(v.begin(), v.end());
+
+    MatrixXd cached(v.size(), v.size());
+    if (lookup(v, cached)) {
+        util::profile_count([] { return std::string("covariance_registry:hit"); });
+        return std::make_unique<MatrixType>(cached.template cast<CType>());
+    }
+
+    util::profile_count([] { return std::string("covariance_registry:miss"); });
+    auto res = dataset::cov<ArrowType, false>(v.begin(), v.end());
+    insert(v, res->template cast<double>());
+    return res;
+}
+
+}  // namespace dataset
+
+#endif  // PYBNESIAN_DATASET_COVARIANCE_REGISTRY_HPP
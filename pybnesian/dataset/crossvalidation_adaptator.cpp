@@ -2,32 +2,61 @@
 
 namespace dataset {
 
-std::pair<DataFrame, DataFrame> CrossValidation::generate_cv_pair(int fold) const {
-    arrow::NumericBuilder<arrow::Int32Type> builder;
+Array_ptr CrossValidationProperties::fold_column(const std::string& name, const Array_ptr& column) {
+    std::lock_guard<std::mutex> lock(m_fold_mutex);
+
+    auto it = m_fold_columns.find(name);
+    if (it != m_fold_columns.end()) return it->second;
+
+    if (!m_fold_indices) {
+        arrow::NumericBuilder<arrow::Int32Type> builder;
+        RAISE_STATUS_ERROR(builder.Reserve(2 * indices.size()));
+        RAISE_STATUS_ERROR(builder.AppendValues(indices.data(), indices.size()));
+        RAISE_STATUS_ERROR(builder.AppendValues(indices.data(), indices.size()));
+        RAISE_STATUS_ERROR(builder.Finish(&m_fold_indices));
+    }
 
+    RAISE_RESULT_ERROR(auto taken,
+                       arrow::compute::Take(column, m_fold_indices, arrow::compute::TakeOptions::NoBoundsCheck()))
+    auto fold_column = taken.make_array();
+    m_fold_columns.insert({name, fold_column});
+    return fold_column;
+}
+
+std::pair<DataFrame, DataFrame> CrossValidation::generate_cv_pair(int fold) const {
     auto test_fold_start = prop->limits[fold];
     auto test_fold_end = prop->limits[fold + 1];
     auto test_fold_size = test_fold_end - test_fold_start;
+    auto train_size = prop->limits.back() - test_fold_size;
 
-    auto right_train_size = prop->limits.back() - test_fold_end;
+    Array_vector train_columns;
+    Array_vector test_columns;
+    train_columns.reserve(m_df->num_columns());
+    test_columns.reserve(m_df->num_columns());
 
-    RAISE_STATUS_ERROR(builder.Reserve(prop->limits.back() - test_fold_size));
-    if (test_fold_start > 0) {
-        RAISE_STATUS_ERROR(builder.AppendValues(prop->indices.data(), test_fold_start));
-    }
+    for (auto j = 0; j < m_df->num_columns(); ++j) {
+        auto column = prop->fold_column(m_df->schema()->field(j)->name(), m_df.col(j));
 
-    if (right_train_size > 0) {
-        RAISE_STATUS_ERROR(builder.AppendValues(prop->indices.data() + test_fold_end, right_train_size));
-    }
+        auto train_column = column->Slice(test_fold_end, train_size);
+        auto test_column = column->Slice(test_fold_start, test_fold_size);
 
-    Array_ptr arrow_indices;
-    RAISE_STATUS_ERROR(builder.Finish(&arrow_indices));
-    auto train_df = m_df.take(arrow_indices);
+        if (column->null_count() > 0) {
+            // The null bitmaps are read without the offset of the slices, so the columns with nulls are copied.
+            auto train_copy = arrow::Concatenate({train_column});
+            RAISE_STATUS_ERROR(train_copy.status());
+            train_column = std::move(train_copy).ValueOrDie();
 
-    RAISE_STATUS_ERROR(builder.AppendValues(prop->indices.data() + test_fold_start, test_fold_size));
-    RAISE_STATUS_ERROR(builder.Finish(&arrow_indices));
+            auto test_copy = arrow::Concatenate({test_column});
+            RAISE_STATUS_ERROR(test_copy.status());
+            test_column = std::move(test_copy).ValueOrDie();
+        }
+
+        train_columns.push_back(train_column);
+        test_columns.push_back(test_column);
+    }
 
-    return std::make_pair(std::move(train_df), m_df.take(arrow_indices));
+    return std::make_pair(DataFrame(arrow::RecordBatch::Make(m_df->schema(), train_size, train_columns)),
+                          DataFrame(arrow::RecordBatch::Make(m_df->schema(), test_fold_size, test_columns)));
 }
 
 std::pair<std::vector<int>, std::vector<int>> CrossValidation::generate_cv_pair_indices(int fold) const {
@@ -37,10 +66,13 @@ std::pair<std::vector<int>, std::vector<int>> CrossValidation::generate_cv_pair_
     int test_size = test_fold_end - test_fold_start;
     int train_size = prop->limits.back() - test_size;
 
+    // The training instances are in the same order as in generate_cv_pair().
     std::vector<int> train_indices(train_size);
 
-    std::copy(prop->indices.cbegin(), prop->indices.cbegin() + test_fold_start, train_indices.begin());
-    std::copy(prop->indices.cbegin() + test_fold_end, prop->indices.cend(), train_indices.begin() + test_fold_start);
+    std::copy(prop->indices.cbegin() + test_fold_end, prop->indices.cend(), train_indices.begin());
+    std::copy(prop->indices.cbegin(),
+              prop->indices.cbegin() + test_fold_start,
+              train_indices.begin() + (prop->indices.size() - test_fold_end));
 
     std::vector<int> test_indices(test_size);
     std::copy(prop->indices.cbegin() + test_fold_start, prop->indices.cbegin() + test_fold_end, test_indices.begin());
@@ -1,7 +1,9 @@
 #ifndef PYBNESIAN_DATASET_CROSSVALIDATION_ADAPTATOR_HPP
 #define PYBNESIAN_DATASET_CROSSVALIDATION_ADAPTATOR_HPP
 
+#include <mutex>
 #include <random>
+#include <unordered_map>
 #include <dataset/dataset.hpp>
 
 using Array_ptr = std::shared_ptr<arrow::Array>;
@@ -15,7 +17,7 @@ namespace dataset {
 class CrossValidationProperties {
 public:
     CrossValidationProperties(const DataFrame& df, int k, unsigned int seed, bool include_null)
-        : k(k), m_seed(seed), indices(), limits() {
+        : k(k), m_seed(seed), indices(), limits(), m_fold_mutex(), m_fold_indices(), m_fold_columns() {
         if (k <= 1 || k > df->num_rows()) {
             throw std::invalid_argument("Cannot split " + std::to_string(df->num_rows()) + " instances into " +
                                         std::to_string(k) + " folds.");
@@ -30,10 +32,10 @@ public:
             int valid_rows = util::bit_util::non_null_count(combined_bitmap, total_rows);
             indices.reserve(valid_rows);
 
-            auto bitmap_data = combined_bitmap->data();
-            for (auto i = 0; i < total_rows; ++i) {
-                if (util::bit_util::GetBit(bitmap_data, i)) indices.push_back(i);
-            }
+            util::bit_util::visit_set_runs(
+                combined_bitmap->data(), total_rows, [&indices](int64_t begin, int64_t run) {
+                    for (auto i = begin, end = begin + run; i < end; ++i) indices.push_back(i);
+                });
         }
 
         std::mt19937 rng{m_seed};
@@ -60,10 +62,20 @@ public:
     friend class CrossValidation;
 
 private:
+    // Returns the column with the instances in the order of indices, repeated twice. Thus, the test instances of each
+    // fold and its training instances (the instances after the test fold followed by the instances before it) are
+    // contiguous slices of the column. Each column is materialised the first time it is used, and it is shared by all
+    // the CrossValidation objects created with CrossValidation::loc().
+    Array_ptr fold_column(const std::string& name, const Array_ptr& column);
+
     int k;
     unsigned int m_seed;
     std::vector<int> indices;
     std::vector<int> limits;
+    // The folds can be generated at the same time by different threads.
+    std::mutex m_fold_mutex;
+    Array_ptr m_fold_indices;
+    std::unordered_map<std::string, Array_ptr> m_fold_columns;
 };
 
 class CrossValidation {
@@ -124,6 +136,8 @@ public:
 
     std::pair<DataFrame, DataFrame> fold(int fold) { return generate_cv_pair(fold); }
 
+    int num_folds() const { return prop->k; }
+
     const DataFrame& data() const { return m_df; }
 
     template <typename T, util::enable_if_index_container_t<T, int> = 0>
@@ -1,11 +1,21 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
 #include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/reader.h>
 #include <arrow/util/align_util.h>
 #include <arrow/util/bitmap_ops.h>
+#include <arrow/python/numpy_convert.h>
 #include <arrow/python/pyarrow.h>
 #include <dataset/dataset.hpp>
+#include <dataset/derived_columns.hpp>
 #include <Eigen/Dense>
 #include <util/parameter_traits.hpp>
 #include <util/basic_eigen_ops.hpp>
+#include <util/parallel.hpp>
 
 using Eigen::MatrixXd;
 
@@ -46,6 +56,192 @@ py::object pandas_to_pyarrow_array(py::handle pyobject) {
     return d;
 }
 
+namespace {
+
+// Wraps the buffer of a 1D, contiguous and aligned float64/float32 NumPy array without copying. It returns nullptr
+// if the array does not meet these conditions.
+Buffer_ptr numpy_float_buffer(py::handle array, std::shared_ptr<DataType>& type) {
+    if (!py::hasattr(array, "dtype") || !py::hasattr(array, "flags") || array.attr("ndim").cast<int>() != 1)
+        return nullptr;
+
+    auto dtype = array.attr("dtype");
+    if (dtype.attr("kind").cast<std::string>() != "f" || !dtype.attr("isnative").cast<bool>()) return nullptr;
+
+    auto flags = array.attr("flags");
+    if (!flags.attr("c_contiguous").cast<bool>() || !flags.attr("aligned").cast<bool>()) return nullptr;
+
+    switch (dtype.attr("itemsize").cast<int>()) {
+        case 8:
+            type = arrow::float64();
+            break;
+        case 4:
+            type = arrow::float32();
+            break;
+        default:
+            return nullptr;
+    }
+
+    return std::make_shared<pyarrow::NumPyBuffer>(array.ptr());
+}
+
+// Creates the Arrow array of a NumPy buffer. As in pyarrow.Array.from_pandas(), the NaN values are null.
+template <typename ArrowType>
+Array_ptr numpy_float_array(const Buffer_ptr& values, int64_t length) {
+    using CType = typename ArrowType::c_type;
+    auto raw_values = reinterpret_cast<const CType*>(values->data());
+
+    int64_t null_count = 0;
+    for (int64_t i = 0; i < length; ++i) {
+        null_count += std::isnan(raw_values[i]);
+    }
+
+    Buffer_ptr bitmap = nullptr;
+    if (null_count > 0) {
+        RAISE_RESULT_ERROR(bitmap, arrow::AllocateBitmap(length))
+        auto bits = bitmap->mutable_data();
+        std::fill(bits, bits + bitmap->size(), 0);
+        for (int64_t i = 0; i < length; ++i) {
+            if (!std::isnan(raw_values[i])) bits[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+        }
+    }
+
+    return std::make_shared<arrow::NumericArray<ArrowType>>(length, values, bitmap, null_count);
+}
+
+Array_ptr numpy_float_array(const Buffer_ptr& values, const std::shared_ptr<DataType>& type, int64_t length) {
+    if (type->id() == Type::DOUBLE)
+        return numpy_float_array<arrow::DoubleType>(values, length);
+    else
+        return numpy_float_array<arrow::FloatType>(values, length);
+}
+
+// FNV-1a hash of size bytes, combined by words of 8 bytes.
+uint64_t bytes_hash(const uint8_t* data, int64_t size, uint64_t hash = 14695981039346656037ull) {
+    int64_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+
+    for (; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+// Hash of the bytes of a NumPy buffer. The pandas DataFrames can be modified in place (e.g., df.loc[...] = ...), so
+// the address of a buffer does not identify its values.
+uint64_t buffer_hash(const Buffer_ptr& buffer) { return bytes_hash(buffer->data(), buffer->size()); }
+
+// The last pandas DataFrame converted without copying. It is reused while the DataFrame has the same columns (names
+// and NumPy buffers) and the hashes of their values are unchanged, so the NaN values are not checked again and the
+// caches keyed by the converted columns (e.g., DataFrame::eigen_view()) keep their entries.
+struct PandasConversionCache {
+    py::weakref dataframe;
+    std::vector<std::string> names;
+    std::vector<const uint8_t*> data;
+    std::vector<uint64_t> hashes;
+    std::shared_ptr<RecordBatch> batch;
+};
+
+PandasConversionCache& pandas_conversion_cache() {
+    // Never destroyed, so the Python references are not released after the interpreter finalization.
+    static auto* cache = new PandasConversionCache();
+    return *cache;
+}
+
+// Converts a pandas DataFrame with float64/float32 columns without copying their NumPy buffers. It returns nullptr if
+// the DataFrame cannot be converted in this way.
+std::shared_ptr<RecordBatch> pandas_float_record_batch(py::handle pyobject) {
+    std::vector<std::string> names;
+    std::vector<Buffer_ptr> buffers;
+    std::vector<std::shared_ptr<DataType>> types;
+    auto length = pyobject.attr("shape").cast<py::tuple>()[0].cast<int64_t>();
+
+    for (auto item : pyobject.attr("items")()) {
+        auto name_series = item.cast<py::tuple>();
+        if (!py::isinstance<py::str>(name_series[0])) return nullptr;
+
+        std::shared_ptr<DataType> type;
+        auto buffer = numpy_float_buffer(name_series[1].attr("values"), type);
+        if (!buffer) return nullptr;
+
+        names.push_back(name_series[0].cast<std::string>());
+        buffers.push_back(std::move(buffer));
+        types.push_back(std::move(type));
+    }
+
+    std::vector<uint64_t> hashes;
+    hashes.reserve(buffers.size());
+    for (const auto& buffer : buffers) {
+        hashes.push_back(buffer_hash(buffer));
+    }
+
+    auto& cache = pandas_conversion_cache();
+    if (cache.batch && cache.dataframe().ptr() == pyobject.ptr() && cache.names == names &&
+        cache.batch->num_rows() == length && cache.hashes == hashes) {
+        bool same_data = true;
+        for (size_t i = 0; same_data && i < buffers.size(); ++i) {
+            same_data = buffers[i]->data() == cache.data[i];
+        }
+
+        if (same_data) return cache.batch;
+    }
+
+    Array_vector columns;
+    arrow::SchemaBuilder b;
+    std::vector<const uint8_t*> data;
+    columns.reserve(names.size());
+    data.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        columns.push_back(numpy_float_array(buffers[i], types[i], length));
+        data.push_back(buffers[i]->data());
+        RAISE_STATUS_ERROR(b.AddField(arrow::field(names[i], types[i])));
+    }
+
+    RAISE_RESULT_ERROR(auto schema, b.Finish())
+    auto batch = RecordBatch::Make(schema, length, columns);
+
+    try {
+        cache.dataframe = py::weakref(pyobject);
+        cache.names = std::move(names);
+        cache.data = std::move(data);
+        cache.hashes = std::move(hashes);
+        cache.batch = batch;
+    } catch (py::error_already_set&) {
+        // The object does not support weak references.
+        cache = PandasConversionCache();
+    }
+
+    return batch;
+}
+
+}  // namespace
+
+std::shared_ptr<RecordBatch> pandas_to_record_batch(py::handle pyobject) {
+    if (auto batch = pandas_float_record_batch(pyobject)) return batch;
+
+    auto a = pandas_to_pyarrow_record_batch(pyobject);
+    auto result = pyarrow::unwrap_batch(a.ptr());
+    if (result.ok()) return result.ValueOrDie();
+
+    return nullptr;
+}
+
+Array_ptr pandas_to_array(py::handle pyobject) {
+    std::shared_ptr<DataType> type;
+    auto values = pyobject.attr("values");
+    if (auto buffer = numpy_float_buffer(values, type)) return numpy_float_array(buffer, type, py::len(values));
+
+    auto a = pandas_to_pyarrow_array(pyobject);
+    auto result = pyarrow::unwrap_array(a.ptr());
+    if (result.ok()) return result.ValueOrDie();
+
+    return nullptr;
+}
+
 std::shared_ptr<RecordBatch> to_record_batch(py::handle data) {
     PyObject* py_ptr = data.ptr();
 
@@ -57,11 +253,8 @@ std::shared_ptr<RecordBatch> to_record_batch(py::handle data) {
             throw std::runtime_error("pyarrow's RecordBatch could not be converted.");
         }
     } else if (is_pandas_dataframe(data)) {
-        auto a = pandas_to_pyarrow_record_batch(data);
-        auto result = pyarrow::unwrap_batch(a.ptr());
-
-        if (result.ok()) {
-            return result.ValueOrDie();
+        if (auto batch = pandas_to_record_batch(data)) {
+            return batch;
         } else {
             throw std::runtime_error("pyarrow's RecordBatch could not be converted.");
         }
@@ -72,6 +265,137 @@ std::shared_ptr<RecordBatch> to_record_batch(py::handle data) {
     return nullptr;
 }
 
+namespace {
+
+// Returns the indices of columns in schema, or all the indices if columns is empty.
+std::vector<int> column_indices(const std::shared_ptr<arrow::Schema>& schema,
+                                const std::vector<std::string>& columns,
+                                const std::string& path) {
+    std::vector<int> indices;
+    if (columns.empty()) {
+        indices.resize(schema->num_fields());
+        std::iota(indices.begin(), indices.end(), 0);
+        return indices;
+    }
+
+    indices.reserve(columns.size());
+    for (const auto& name : columns) {
+        auto index = schema->GetFieldIndex(name);
+        if (index == -1) throw std::invalid_argument("Column \"" + name + "\" not present in file " + path + ".");
+        indices.push_back(index);
+    }
+
+    return indices;
+}
+
+Array_ptr combine_chunks(const std::shared_ptr<arrow::ChunkedArray>& column) {
+    if (column->num_chunks() == 1) return column->chunk(0);
+
+    if (column->num_chunks() == 0) {
+        RAISE_RESULT_ERROR(auto empty, arrow::MakeArrayOfNull(column->type(), 0))
+        return empty;
+    }
+
+    RAISE_RESULT_ERROR(auto combined, arrow::Concatenate(column->chunks()))
+    return combined;
+}
+
+// Returns a DataFrame with the columns of table in the order of columns, or in the order of table if columns is
+// empty. It only copies the data of the columns with more than one chunk.
+DataFrame table_to_dataframe(const std::shared_ptr<arrow::Table>& table, const std::vector<std::string>& columns) {
+    if (columns.empty()) {
+        Array_vector arrays;
+        arrays.reserve(table->num_columns());
+        for (const auto& column : table->columns()) {
+            arrays.push_back(combine_chunks(column));
+        }
+
+        return DataFrame(RecordBatch::Make(table->schema(), table->num_rows(), arrays));
+    }
+
+    Array_vector arrays;
+    arrays.reserve(columns.size());
+    arrow::SchemaBuilder b;
+    for (const auto& name : columns) {
+        auto index = table->schema()->GetFieldIndex(name);
+        arrays.push_back(combine_chunks(table->column(index)));
+        RAISE_STATUS_ERROR(b.AddField(table->schema()->field(index)));
+    }
+
+    RAISE_RESULT_ERROR(auto schema, b.Finish())
+    return DataFrame(RecordBatch::Make(schema, table->num_rows(), arrays));
+}
+
+std::shared_ptr<arrow::ipc::RecordBatchFileReader> open_ipc_reader(
+    const std::shared_ptr<arrow::io::RandomAccessFile>& file, const arrow::ipc::IpcReadOptions& options) {
+    RAISE_RESULT_ERROR(auto reader, arrow::ipc::RecordBatchFileReader::Open(file, options))
+    return reader;
+}
+
+std::shared_ptr<arrow::Table> read_ipc_table(const std::shared_ptr<arrow::ipc::RecordBatchFileReader>& reader) {
+    std::vector<std::shared_ptr<RecordBatch>> batches;
+    batches.reserve(reader->num_record_batches());
+    for (int i = 0; i < reader->num_record_batches(); ++i) {
+        RAISE_RESULT_ERROR(auto batch, reader->ReadRecordBatch(i))
+        batches.push_back(std::move(batch));
+    }
+
+    RAISE_RESULT_ERROR(auto table, arrow::Table::FromRecordBatches(reader->schema(), batches))
+    return table;
+}
+
+}  // namespace
+
+DataFrame read_ipc(const std::string& path, const std::vector<std::string>& columns) {
+    RAISE_RESULT_ERROR(auto file, arrow::io::MemoryMappedFile::Open(path, arrow::io::FileMode::READ))
+
+    auto options = arrow::ipc::IpcReadOptions::Defaults();
+    // Only the selected columns are read (and decompressed). The selected columns are returned in the order of the
+    // file, so they are reordered in table_to_dataframe().
+    options.included_fields = column_indices(open_ipc_reader(file, options)->schema(), columns, path);
+
+    return table_to_dataframe(read_ipc_table(open_ipc_reader(file, options)), columns);
+}
+
+DataFrame read_parquet(const std::string& path,
+                       const std::vector<std::string>& columns,
+                       const std::vector<int>& row_groups) {
+    py::object py_columns = py::none();
+    if (!columns.empty()) {
+        py::list l;
+        for (const auto& name : columns) {
+            l.append(name);
+        }
+        py_columns = l;
+    }
+
+    // The Parquet reader of pyarrow is used because PyBNesian is not linked with the Parquet library.
+    auto parquet = py::module::import("pyarrow.parquet");
+    py::object py_table;
+    if (row_groups.empty()) {
+        py_table = parquet.attr("read_table")(path, py::arg("columns") = py_columns, py::arg("memory_map") = true);
+    } else {
+        auto file = parquet.attr("ParquetFile")(path, py::arg("memory_map") = true);
+        auto num_row_groups = file.attr("num_row_groups").cast<int>();
+        py::list py_row_groups;
+        for (auto row_group : row_groups) {
+            if (row_group < 0 || row_group >= num_row_groups) {
+                throw std::invalid_argument("Row group " + std::to_string(row_group) + " not present in " + path +
+                                            " (" + std::to_string(num_row_groups) + " row groups).");
+            }
+
+            py_row_groups.append(row_group);
+        }
+
+        py_table = file.attr("read_row_groups")(py_row_groups, py::arg("columns") = py_columns);
+    }
+
+    auto result = pyarrow::unwrap_table(py_table.ptr());
+    if (!result.ok()) throw std::runtime_error("pyarrow's Table could not be converted.");
+
+    return table_to_dataframe(result.ValueOrDie(), columns);
+}
+
 Array_ptr copy_array(const Array_ptr& array) {
     switch (array->type_id()) {
         case Type::DOUBLE:
@@ -139,6 +463,66 @@ std::vector<std::string> DataFrame::column_names() const {
     return names;
 }
 
+DataFrameBuilder::DataFrameBuilder(const DataFrame& df) : DataFrameBuilder(df->num_rows()) {
+    reserve(df->num_columns());
+    auto schema = df->schema();
+    for (int i = 0, num_fields = schema->num_fields(); i < num_fields; ++i) {
+        append(schema->field(i), df.col(i));
+    }
+}
+
+int DataFrameBuilder::index(const std::string& name) const {
+    auto found = m_indices.find(name);
+    if (found == m_indices.end()) throw std::invalid_argument("Column " + name + " do not exist in DataFrame.");
+    return found->second;
+}
+
+Array_ptr DataFrameBuilder::col(const std::string& name) const { return m_columns[index(name)]; }
+
+void DataFrameBuilder::append(Field_ptr field, Array_ptr column) {
+    if (column->length() != m_num_rows)
+        throw std::invalid_argument("Column " + field->name() + " has " + std::to_string(column->length()) +
+                                    " rows. Expected " + std::to_string(m_num_rows) + " rows.");
+    if (!m_indices.insert({field->name(), m_columns.size()}).second)
+        throw std::invalid_argument("Column " + field->name() + " is already present in the DataFrame.");
+
+    m_fields.push_back(std::move(field));
+    m_columns.push_back(std::move(column));
+}
+
+DataFrame DataFrameBuilder::loc(const std::vector<std::string>& names) const {
+    std::vector<Field_ptr> fields;
+    Array_vector columns;
+    fields.reserve(names.size());
+    columns.reserve(names.size());
+
+    for (const auto& name : names) {
+        auto i = index(name);
+        fields.push_back(m_fields[i]);
+        columns.push_back(m_columns[i]);
+    }
+
+    return DataFrame(RecordBatch::Make(arrow::schema(std::move(fields)), m_num_rows, std::move(columns)));
+}
+
+void DataFrameBuilder::clear() {
+    m_fields.clear();
+    m_columns.clear();
+    m_indices.clear();
+}
+
+DataFrame DataFrameBuilder::finish() {
+    auto df = DataFrame(RecordBatch::Make(arrow::schema(std::move(m_fields)), m_num_rows, std::move(m_columns)));
+    clear();
+    return df;
+}
+
+DataFrame DataFrameBuilder::finish(const std::vector<std::string>& names) {
+    auto df = loc(names);
+    clear();
+    return df;
+}
+
 int64_t null_count(Array_iterator begin, Array_iterator end) {
     int64_t r = 0;
     for (auto it = begin; it != end; it++) {
@@ -147,47 +531,226 @@ int64_t null_count(Array_iterator begin, Array_iterator end) {
     return r;
 }
 
-Buffer_ptr combined_bitmap(Array_iterator begin, Array_iterator end) {
-    if (null_count(begin, end) > 0) {
-        Array_iterator first_null_col = end;
+namespace {
 
-        for (auto it = begin; it < end; ++it) {
-            if ((*it)->null_count() != 0) {
-                first_null_col = it;
-                break;
-            }
+// Memoizes the combined bitmap and the number of valid rows of the column sets with null values. The columns without
+// null values do not change the combined bitmap, so the entries are identified by the sorted ArrayData of the columns
+// with null values. An entry is removed when its columns are destroyed, or in least-recently-used order when there are
+// more than capacity entries.
+class CombinedBitmapCache {
+public:
+    static constexpr size_t capacity = 64;
+
+    static CombinedBitmapCache& get() {
+        static CombinedBitmapCache cache;
+        return cache;
+    }
+
+    std::pair<Buffer_ptr, int64_t> combined_bitmap(Array_iterator begin, Array_iterator end);
+
+private:
+    struct Entry {
+        std::vector<std::weak_ptr<arrow::ArrayData>> columns;
+        Buffer_ptr bitmap;
+        int64_t valid_rows;
+    };
+
+    std::list<Entry>::iterator find_entry(const Array_vector& null_columns);
+
+    std::mutex m_mutex;
+    std::list<Entry> m_entries;
+};
+
+std::list<CombinedBitmapCache::Entry>::iterator CombinedBitmapCache::find_entry(const Array_vector& null_columns) {
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->columns.size() != null_columns.size()) continue;
+
+        bool equal = true;
+        for (size_t i = 0; equal && i < null_columns.size(); ++i) {
+            equal = it->columns[i].lock() == null_columns[i]->data();
         }
 
-        auto res = Buffer::Copy((*first_null_col)->null_bitmap(), arrow::default_cpu_memory_manager());
-        auto bitmap = std::move(res).ValueOrDie();
+        if (equal) return it;
+    }
 
-        for (auto it = ++first_null_col; it < end; ++it) {
-            auto col = *it;
-            if (col->null_count()) {
-                auto other_bitmap = col->null_bitmap();
+    return m_entries.end();
+}
 
-                arrow::internal::BitmapAnd(
-                    bitmap->data(), 0, other_bitmap->data(), 0, (*first_null_col)->length(), 0, bitmap->mutable_data());
-            }
+std::pair<Buffer_ptr, int64_t> CombinedBitmapCache::combined_bitmap(Array_iterator begin, Array_iterator end) {
+    Array_vector null_columns;
+    for (auto it = begin; it != end; ++it) {
+        if ((*it)->null_count() > 0) null_columns.push_back(*it);
+    }
+
+    if (null_columns.empty()) return std::make_pair(nullptr, std::distance(begin, end) > 0 ? (*begin)->length() : 0);
+
+    std::sort(null_columns.begin(), null_columns.end(), [](const Array_ptr& a, const Array_ptr& b) {
+        return a->data().get() < b->data().get();
+    });
+    null_columns.erase(std::unique(null_columns.begin(),
+                                   null_columns.end(),
+                                   [](const Array_ptr& a, const Array_ptr& b) { return a->data() == b->data(); }),
+                       null_columns.end());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = find_entry(null_columns);
+        if (it != m_entries.end()) {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            return std::make_pair(it->bitmap, it->valid_rows);
         }
-        return bitmap;
+    }
+
+    auto length = null_columns[0]->length();
+    Buffer_ptr bitmap;
+    if (null_columns.size() == 1) {
+        bitmap = null_columns[0]->null_bitmap();
     } else {
-        return nullptr;
+        auto res = Buffer::Copy(null_columns[0]->null_bitmap(), arrow::default_cpu_memory_manager());
+        bitmap = std::move(res).ValueOrDie();
+
+        for (auto it = null_columns.begin() + 1; it != null_columns.end(); ++it) {
+            arrow::internal::BitmapAnd(
+                bitmap->data(), 0, (*it)->null_bitmap()->data(), 0, length, 0, bitmap->mutable_data());
+        }
     }
+
+    auto valid_rows = static_cast<int64_t>(util::bit_util::non_null_count(bitmap, length));
+
+    std::vector<std::weak_ptr<arrow::ArrayData>> weak_columns;
+    weak_columns.reserve(null_columns.size());
+    for (const auto& c : null_columns) {
+        weak_columns.push_back(c->data());
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.remove_if([](const Entry& e) {
+        return std::any_of(
+            e.columns.begin(), e.columns.end(), [](const std::weak_ptr<arrow::ArrayData>& c) { return c.expired(); });
+    });
+
+    if (find_entry(null_columns) == m_entries.end()) {
+        m_entries.push_front(Entry{std::move(weak_columns), bitmap, valid_rows});
+        if (m_entries.size() > capacity) m_entries.pop_back();
+    }
+
+    return std::make_pair(bitmap, valid_rows);
+}
+
+}  // namespace
+
+Buffer_ptr combined_bitmap(Array_iterator begin, Array_iterator end) {
+    return CombinedBitmapCache::get().combined_bitmap(begin, end).first;
 }
 
 int64_t valid_rows(Array_iterator begin, Array_iterator end) {
-    if (std::distance(begin, end) == 0) {
-        return 0;
+    return CombinedBitmapCache::get().combined_bitmap(begin, end).second;
+}
+
+std::vector<uint64_t> column_hashes(const Array_vector& columns) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(columns.size());
+    for (const auto& column : columns) {
+        auto offset = column->offset();
+        auto length = column->length();
+        auto byte_width = static_cast<const arrow::FixedWidthType&>(*column->type()).bit_width() / 8;
+
+        const auto& buffers = column->data()->buffers;
+        auto hash = bytes_hash(buffers[1]->data() + offset * byte_width, length * byte_width);
+        if (column->null_count() > 0) {
+            auto bitmap_bytes = (offset + length + 7) / 8 - offset / 8;
+            hash = bytes_hash(buffers[0]->data() + offset / 8, bitmap_bytes, hash);
+        }
+
+        hashes.push_back(hash);
     }
 
-    auto bitmap = combined_bitmap(begin, end);
-    if (bitmap)
-        return util::bit_util::non_null_count(bitmap, (*begin)->length());
-    else
-        return (*begin)->length();
+    return hashes;
+}
+
+EigenMatrixCache& EigenMatrixCache::get() {
+    static EigenMatrixCache cache;
+    return cache;
+}
+
+std::list<EigenMatrixCache::Entry>::iterator EigenMatrixCache::find_entry(const Array_vector& columns,
+                                                                        const std::vector<uint64_t>& hashes,
+                                                                        Type::type type,
+                                                                        bool append_ones) {
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->type != type || it->append_ones != append_ones || it->hashes != hashes) continue;
+
+        bool equal = true;
+        for (size_t i = 0; equal && i < columns.size(); ++i) {
+            equal = it->columns[i].lock() == columns[i]->data();
+        }
+
+        if (equal) return it;
+    }
+
+    return m_entries.end();
+}
+
+std::shared_ptr<const void> EigenMatrixCache::find(const Array_vector& columns,
+                                                   const std::vector<uint64_t>& hashes,
+                                                   Type::type type,
+                                                   bool append_ones) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = find_entry(columns, hashes, type, append_ones);
+    if (it == m_entries.end()) return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, it);
+    return it->matrix;
+}
+
+void EigenMatrixCache::insert(const Array_vector& columns,
+                              const std::vector<uint64_t>& hashes,
+                              Type::type type,
+                              bool append_ones,
+                              std::shared_ptr<const void> matrix,
+                              size_t bytes) {
+    if (bytes > max_bytes) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        auto expired = std::any_of(it->columns.begin(),
+                                   it->columns.end(),
+                                   [](const std::weak_ptr<arrow::ArrayData>& c) { return c.expired(); });
+        if (expired) {
+            m_bytes -= it->bytes;
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Another thread inserted the same matrix.
+    if (find_entry(columns, hashes, type, append_ones) != m_entries.end()) return;
+
+    std::vector<std::weak_ptr<arrow::ArrayData>> weak_columns;
+    weak_columns.reserve(columns.size());
+    for (const auto& c : columns) {
+        weak_columns.push_back(c->data());
+    }
+
+    m_entries.push_front(Entry{std::move(weak_columns), hashes, type, append_ones, std::move(matrix), bytes});
+    m_bytes += bytes;
+
+    while (m_entries.size() > capacity || m_bytes > max_bytes) {
+        m_bytes -= m_entries.back().bytes;
+        m_entries.pop_back();
+    }
 }
 
+void EigenMatrixCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+
 std::string index_to_string(int i) { return std::to_string(i); }
 
 std::string index_to_string(const std::string& name) { return name; }
@@ -330,56 +893,69 @@ VectorXd means(const Buffer_ptr& bitmap, Array_iterator begin, Array_iterator en
     return res;
 }
 
-template <typename ArrowType, typename EigenArray>
-Array_ptr normalize_column(const Array_ptr& array, EigenArray& eig) {
-    util::normalize_cols(eig);
+DataFrame DataFrame::normalize(int num_threads) const {
+    std::vector<Array_ptr> columns = this->columns();
 
-    arrow::NumericBuilder<ArrowType> builder;
-    RAISE_STATUS_ERROR(builder.Reserve(array->length()));
-    if (array->null_count() == 0) {
-        RAISE_STATUS_ERROR(builder.AppendValues(eig.data(), eig.rows()));
-    } else {
-        auto bitmap_data = array->null_bitmap_data();
-        for (int i = 0, j = 0; i < array->length(); ++i) {
-            if (util::bit_util::GetBit(bitmap_data, i)) {
-                builder.UnsafeAppend(eig(j++));
-            } else {
-                builder.UnsafeAppendNull();
-            }
+    util::parallel_for(0, this->num_columns(), num_threads, [&](int i, int) {
+        switch (columns[i]->type_id()) {
+            case Type::DOUBLE:
+            case Type::FLOAT:
+                columns[i] = DerivedColumnCache::shared().get(columns[i], DerivedColumnKind::ZScore).array;
+                break;
+            default:
+                break;
         }
+    });
+
+    return DataFrame(arrow::RecordBatch::Make(m_batch->schema(), this->num_rows(), columns));
+}
+
+DataFrame DataFrame::ranked(int num_threads) const {
+    std::vector<Array_ptr> columns = this->columns();
+
+    util::parallel_for(0, this->num_columns(), num_threads, [&](int i, int) {
+        columns[i] = DerivedColumnCache::shared().get(columns[i], DerivedColumnKind::Rank).array;
+    });
+
+    arrow::SchemaBuilder b(arrow::SchemaBuilder::ConflictPolicy::CONFLICT_ERROR);
+    for (int i = 0; i < this->num_columns(); ++i) {
+        RAISE_STATUS_ERROR(b.AddField(arrow::field(name(i), columns[i]->type())));
     }
+    RAISE_RESULT_ERROR(auto schema, b.Finish())
 
-    std::shared_ptr<arrow::Array> out;
-    RAISE_STATUS_ERROR(builder.Finish(&out));
+    return DataFrame(arrow::RecordBatch::Make(schema, this->num_rows(), columns));
+}
 
-    return out;
+std::pair<double, double> DataFrame::min_max(int index) const {
+    auto res = DerivedColumnCache::shared().get(col(index), DerivedColumnKind::MinMax);
+    return std::make_pair(res.first, res.second);
 }
 
-DataFrame DataFrame::normalize() const {
-    auto continuous_cols = continuous_columns();
+DataFrame DataFrame::sample_rows(int64_t n, unsigned int seed) const {
+    if (n < 0) throw std::invalid_argument("The number of sampled rows must be a non-negative number.");
 
-    std::vector<Array_ptr> columns;
+    int64_t total_rows = num_rows();
+    if (n >= total_rows) return *this;
 
-    for (auto i = 0; i < this->num_columns(); ++i) {
-        auto column = col(i);
+    // Selection sampling (Knuth's algorithm S): each row is selected with probability
+    // (remaining rows to select) / (remaining rows), so the indices are generated in increasing order.
+    std::mt19937 rng{seed};
+    std::uniform_real_distribution<double> unif;
 
-        switch (column->type_id()) {
-            case Type::DOUBLE: {
-                auto eigen_vec = to_eigen<false, arrow::DoubleType>(i);
-                columns.push_back(normalize_column<arrow::DoubleType>(column, *eigen_vec));
-                break;
-            }
-            case Type::FLOAT: {
-                auto eigen_vec = to_eigen<false, arrow::FloatType>(i);
-                columns.push_back(normalize_column<arrow::FloatType>(column, *eigen_vec));
-                break;
-            }
-            default:
-                columns.push_back(column);
+    arrow::Int64Builder builder;
+    RAISE_STATUS_ERROR(builder.Reserve(n));
+
+    int64_t selected = 0;
+    for (int64_t i = 0; i < total_rows && selected < n; ++i) {
+        if (static_cast<double>(total_rows - i) * unif(rng) < static_cast<double>(n - selected)) {
+            builder.UnsafeAppend(i);
+            ++selected;
         }
     }
 
-    return DataFrame(arrow::RecordBatch::Make(m_batch->schema(), this->num_rows(), columns));
+    Array_ptr take_ind;
+    RAISE_STATUS_ERROR(builder.Finish(&take_ind));
+    return take(take_ind);
 }
 
 }  // namespace dataset
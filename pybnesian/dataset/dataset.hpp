@@ -1,6 +1,9 @@
 #ifndef PYBNESIAN_DATASET_DATASET_HPP
 #define PYBNESIAN_DATASET_DATASET_HPP
 
+#include <list>
+#include <unordered_map>
+#include <mutex>
 #include <Eigen/Dense>
 #include <arrow/python/pyarrow.h>
 #include <arrow/python/platform.h>
@@ -10,6 +13,9 @@
 #include <util/parameter_traits.hpp>
 #include <util/bit_util.hpp>
 #include <util/arrow_macros.hpp>
+#include <util/parallel.hpp>
+#include <util/scratch_arena.hpp>
+#include <util/simd.hpp>
 
 namespace pyarrow = arrow::py;
 namespace py = pybind11;
@@ -30,6 +36,13 @@ namespace dataset {
 bool is_pandas_dataframe(py::handle pyobject);
 bool is_pandas_series(py::handle pyobject);
 
+// Converts a pandas DataFrame/Series. The float64/float32 columns are not copied if their NumPy arrays are contiguous,
+// and the last DataFrame converted in this way is cached until its columns change. The null values (NaN) are found
+// when the DataFrame is converted, so the cached conversion does not detect NaN values assigned in place. It returns
+// nullptr if the conversion fails.
+std::shared_ptr<RecordBatch> pandas_to_record_batch(py::handle pyobject);
+Array_ptr pandas_to_array(py::handle pyobject);
+
 std::shared_ptr<RecordBatch> to_record_batch(py::handle pyobject);
 py::object pandas_to_pyarrow_record_batch(py::handle pyobject);
 py::object pandas_to_pyarrow_array(py::handle pyobject);
@@ -90,11 +103,7 @@ typename ArrowType::c_type* fill_data_bitmap(typename ArrowType::c_type* ptr,
     auto dwn_col = std::static_pointer_cast<ArrayType>(input_array);
     auto raw_values = dwn_col->raw_values();
 
-    auto k = 0;
-    for (auto j = 0; j < total_rows; ++j) {
-        if (util::bit_util::GetBit(bitmap_data, j)) ptr[k++] = raw_values[j];
-    }
-    return ptr + k;
+    return ptr + util::bit_util::compact(bitmap_data, total_rows, raw_values, ptr);
 }
 
 std::shared_ptr<arrow::DataType> same_type(Array_iterator begin, Array_iterator end);
@@ -111,11 +120,10 @@ typename ArrowType::c_type min(Array_ptr& a) {
         MapType map(raw, a->length());
         return map.minCoeff();
     } else {
-        auto bitmap = a->null_bitmap_data();
         auto res = std::numeric_limits<CType>::infinity();
-        for (auto i = 0; i < a->length(); ++i) {
-            if (util::bit_util::GetBit(bitmap, i) && raw[i] < res) res = raw[i];
-        }
+        util::bit_util::visit_set_runs(a->null_bitmap_data(), a->length(), [raw, &res](int64_t begin, int64_t run) {
+            res = std::min(res, MapType(raw + begin, run).minCoeff());
+        });
         return res;
     }
 }
@@ -137,11 +145,10 @@ typename ArrowType::c_type max(Array_ptr& a) {
         MapType map(raw, a->length());
         return map.maxCoeff();
     } else {
-        auto bitmap = a->null_bitmap_data();
         auto res = -std::numeric_limits<CType>::infinity();
-        for (auto i = 0; i < a->length(); ++i) {
-            if (util::bit_util::GetBit(bitmap, i) && raw[i] > res) res = raw[i];
-        }
+        util::bit_util::visit_set_runs(a->null_bitmap_data(), a->length(), [raw, &res](int64_t begin, int64_t run) {
+            res = std::max(res, MapType(raw + begin, run).maxCoeff());
+        });
         return res;
     }
 }
@@ -151,6 +158,46 @@ typename ArrowType::c_type max(Array_ptr&& a) {
     return max<ArrowType>(a);
 }
 
+// //////////////////////////////////// accurate reductions //////////////////////////////
+// The sums of float values are computed in blocks of reduction_block_size values: each block is reduced in float (with
+// the vectorized Eigen reductions) and the blocks are accumulated in double. Thus, the float data is read once, but the
+// rounding error does not grow with the number of values. The double values are reduced directly.
+inline constexpr Eigen::Index reduction_block_size = 256;
+
+template <typename Derived>
+double accurate_sum(const Eigen::MatrixBase<Derived>& v) {
+    if constexpr (std::is_same_v<typename Derived::Scalar, double>) {
+        return v.sum();
+    } else {
+        double res = 0;
+        for (Eigen::Index i = 0; i < v.size(); i += reduction_block_size) {
+            res += static_cast<double>(v.segment(i, std::min(reduction_block_size, v.size() - i)).sum());
+        }
+        return res;
+    }
+}
+
+// The contiguous vectors use the kernels of util::simd for the instruction set of the CPU.
+template <typename DerivedA, typename DerivedB>
+double accurate_dot(const Eigen::MatrixBase<DerivedA>& a, const Eigen::MatrixBase<DerivedB>& b) {
+    if constexpr ((DerivedA::Flags & Eigen::DirectAccessBit) != 0 && (DerivedB::Flags & Eigen::DirectAccessBit) != 0) {
+        if (a.innerStride() == 1 && b.innerStride() == 1 && (a.cols() == 1 || a.rows() == 1) &&
+            (b.cols() == 1 || b.rows() == 1))
+            return util::simd::dot(a.derived().data(), b.derived().data(), static_cast<size_t>(a.size()));
+    }
+
+    if constexpr (std::is_same_v<typename DerivedA::Scalar, double>) {
+        return a.dot(b);
+    } else {
+        double res = 0;
+        for (Eigen::Index i = 0; i < a.size(); i += reduction_block_size) {
+            auto length = std::min(reduction_block_size, a.size() - i);
+            res += static_cast<double>(a.segment(i, length).dot(b.segment(i, length)));
+        }
+        return res;
+    }
+}
+
 // //////////////////////////////////// mean() //////////////////////////////
 double mean(Array_ptr& a);
 double mean(const Buffer_ptr& bitmap, Array_ptr& a);
@@ -167,12 +214,13 @@ typename ArrowType::c_type mean(const Buffer_ptr& bitmap, Array_ptr& a) {
 
     auto raw = dwn->raw_values();
     auto bitmap_data = bitmap->data();
-    CType res = 0;
-    for (auto i = 0; i < a->length(); ++i) {
-        if (util::bit_util::GetBit(bitmap_data, i)) res += raw[i];
-    }
+    // The sum is accumulated in double, so the mean of float columns is not affected by the number of rows.
+    double res = 0;
+    util::bit_util::visit_set_runs(bitmap_data, a->length(), [raw, &res](int64_t begin, int64_t run) {
+        res += accurate_sum(Map<const Matrix<CType, Dynamic, 1>>(raw + begin, run));
+    });
 
-    return res / static_cast<CType>(util::bit_util::non_null_count(bitmap, a->length()));
+    return static_cast<CType>(res / util::bit_util::non_null_count(bitmap, a->length()));
 }
 
 template <typename ArrowType>
@@ -185,7 +233,7 @@ typename ArrowType::c_type mean(Array_ptr& a) {
     auto raw = dwn->raw_values();
     if (a->null_count() == 0) {
         MapType map(raw, a->length());
-        return map.mean();
+        return static_cast<CType>(accurate_sum(map) / a->length());
     } else {
         auto bitmap = a->null_bitmap();
         return mean<ArrowType>(bitmap, a);
@@ -329,40 +377,247 @@ MapOrMatrixType<append_ones, ArrowType, contains_null> to_eigen(Array_ptr col) {
     }
 }
 
-// //////////////////////////////////// cov() //////////////////////////////
-template <typename ArrowType, typename MatrixObject>
-EigenMatrix<ArrowType> compute_cov(std::vector<MatrixObject>& v) {
-    using CType = typename ArrowType::c_type;
-    auto N = v[0].rows();
-    auto n = v.size();
-    EigenMatrix<ArrowType> res = std::make_unique<typename EigenMatrix<ArrowType>::element_type>(n, n);
+// //////////////////////////////////// eigen_view() //////////////////////////////
+// A read-only column-major matrix with some columns of a DataFrame. It keeps alive the memory it references: the
+// Arrow buffers of the columns or a cached copy.
+template <typename ArrowType>
+class EigenMatrixView {
+public:
+    using MatrixType = Matrix<typename ArrowType::c_type, Dynamic, Dynamic>;
+    using MapType = Map<const MatrixType>;
+
+    EigenMatrixView(std::shared_ptr<const void> owner,
+                    const typename ArrowType::c_type* data,
+                    Eigen::Index rows,
+                    Eigen::Index cols)
+        : m_owner(std::move(owner)), m_map(data, rows, cols) {}
+
+    const MapType& operator*() const { return m_map; }
+    const MapType* operator->() const { return &m_map; }
+
+private:
+    std::shared_ptr<const void> m_owner;
+    MapType m_map;
+};
 
-    CType inv_N = 1 / static_cast<CType>(N - 1);
+// Returns a hash of the values (and the null bitmap) of each float/double column.
+std::vector<uint64_t> column_hashes(const Array_vector& columns);
 
-    for (size_t i = 0; i < v.size(); ++i) {
-        (*res)(i, i) = v[i].squaredNorm() * inv_N;
+// Caches the matrices of the column sets requested with eigen_view(). The entries are identified by the ArrayData of
+// the columns, so they are shared between the DataFrames with the same columns (e.g. the loc() or the copies of a
+// DataFrame, or the repeated conversions of the same pandas DataFrame). The buffers of a column can be modified in
+// place (e.g., the NumPy arrays of a pandas DataFrame), so the entries also store the column_hashes() of their
+// columns, and an entry is not returned if the values of its columns changed. An entry is removed when its columns are
+// destroyed, or in least-recently-used order when there are more than capacity entries or max_bytes bytes.
+class EigenMatrixCache {
+public:
+    static constexpr size_t capacity = 16;
+    static constexpr size_t max_bytes = size_t{1} << 28;
+
+    static EigenMatrixCache& get();
+
+    // Returns the cached matrix, or nullptr if it is not in the cache. hashes are the column_hashes() of columns.
+    std::shared_ptr<const void> find(const Array_vector& columns,
+                                     const std::vector<uint64_t>& hashes,
+                                     Type::type type,
+                                     bool append_ones);
+    void insert(const Array_vector& columns,
+                const std::vector<uint64_t>& hashes,
+                Type::type type,
+                bool append_ones,
+                std::shared_ptr<const void> matrix,
+                size_t bytes);
+    void clear();
+
+private:
+    struct Entry {
+        std::vector<std::weak_ptr<arrow::ArrayData>> columns;
+        std::vector<uint64_t> hashes;
+        Type::type type;
+        bool append_ones;
+        std::shared_ptr<const void> matrix;
+        size_t bytes;
+    };
+
+    std::list<Entry>::iterator find_entry(const Array_vector& columns,
+                                          const std::vector<uint64_t>& hashes,
+                                          Type::type type,
+                                          bool append_ones);
+
+    std::mutex m_mutex;
+    std::list<Entry> m_entries;
+    size_t m_bytes = 0;
+};
 
-        for (size_t j = i + 1; j < v.size(); ++j) {
-            (*res)(i, j) = (*res)(j, i) = v[i].dot(v[j]) * inv_N;
+// Returns true if the null-free columns are stored contiguously in memory, so they can be viewed without copying.
+template <typename ArrowType>
+bool contiguous_columns(Array_iterator begin, Array_iterator end) {
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+
+    if (begin == end) return false;
+
+    auto rows = (*begin)->length();
+    auto next_data = std::static_pointer_cast<ArrayType>(*begin)->raw_values();
+    for (auto it = begin; it != end; ++it) {
+        auto dwn_col = std::static_pointer_cast<ArrayType>(*it);
+        if ((*it)->null_count() > 0 || dwn_col->raw_values() != next_data) return false;
+        next_data += rows;
+    }
+
+    return true;
+}
+
+template <bool append_ones, typename ArrowType>
+EigenMatrixView<ArrowType> eigen_view(Array_iterator begin, Array_iterator end, int64_t num_rows) {
+    using MatrixType = typename EigenMatrixView<ArrowType>::MatrixType;
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+
+    auto ncols = std::distance(begin, end);
+
+    if constexpr (!append_ones) {
+        if (contiguous_columns<ArrowType>(begin, end)) {
+            auto columns = std::make_shared<Array_vector>(begin, end);
+            auto data = std::static_pointer_cast<ArrayType>(*begin)->raw_values();
+            return EigenMatrixView<ArrowType>(std::move(columns), data, num_rows, ncols);
         }
     }
 
-    return res;
+    std::shared_ptr<const MatrixType> matrix;
+    if (ncols == 0) {
+        matrix = std::make_shared<MatrixType>(MatrixType::Ones(num_rows, append_ones));
+    } else {
+        Array_vector columns(begin, end);
+        auto hashes = column_hashes(columns);
+        auto& cache = EigenMatrixCache::get();
+        matrix =
+            std::static_pointer_cast<const MatrixType>(cache.find(columns, hashes, ArrowType::type_id, append_ones));
+
+        if (!matrix) {
+            if (null_count(begin, end) == 0)
+                matrix = dataset::to_eigen<append_ones, ArrowType, false>(begin, end);
+            else
+                matrix = dataset::to_eigen<append_ones, ArrowType, true>(begin, end);
+
+            cache.insert(columns,
+                         hashes,
+                         ArrowType::type_id,
+                         append_ones,
+                         matrix,
+                         sizeof(typename ArrowType::c_type) * matrix->size());
+        }
+    }
+
+    auto data = matrix->data();
+    auto rows = matrix->rows();
+    auto cols = matrix->cols();
+    return EigenMatrixView<ArrowType>(std::move(matrix), data, rows, cols);
 }
 
+// //////////////////////////////////// cov() //////////////////////////////
+// The centered columns of cov() and sse() are allocated in the util::ScratchArena of the thread, so the repeated calls
+// of a structure learning algorithm do not allocate memory.
 template <typename ArrowType>
-EigenMatrix<ArrowType> cov(Buffer_ptr bitmap, Array_iterator begin, Array_iterator end) {
-    using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-    std::vector<EigenVector> columns;
-    auto n = std::distance(begin, end);
-    columns.reserve(n);
+using ScratchVector = Map<Matrix<typename ArrowType::c_type, Dynamic, 1>, Eigen::Aligned64>;
+
+// Copies the values of col with a set bit in bitmap (all the values if bitmap is null) to the ScratchArena of the
+// thread, centered at their mean.
+template <typename ArrowType>
+ScratchVector<ArrowType> centered_scratch_column(const Buffer_ptr& bitmap, const Array_ptr& col) {
+    using CType = typename ArrowType::c_type;
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+
+    auto rows = col->length();
+    auto valid_rows = bitmap ? util::bit_util::non_null_count(bitmap, rows) : rows;
+    auto c = util::ScratchArena::get().vector<CType>(valid_rows);
+
+    if (bitmap)
+        fill_data_bitmap<ArrowType>(c.data(), col, bitmap->data(), rows);
+    else
+        c = Map<const Matrix<CType, Dynamic, 1>>(std::static_pointer_cast<ArrayType>(col)->raw_values(), rows);
+
+    c.array() -= static_cast<CType>(accurate_sum(c) / c.rows());
+    return c;
+}
+
+template <typename ArrowType>
+std::vector<ScratchVector<ArrowType>> centered_scratch_columns(const Buffer_ptr& bitmap,
+                                                               Array_iterator begin,
+                                                               Array_iterator end) {
+    std::vector<ScratchVector<ArrowType>> columns;
+    columns.reserve(std::distance(begin, end));
 
     for (auto it = begin; it != end; ++it) {
-        auto c = to_eigen<false, ArrowType>(bitmap, *it);
-        auto m = c->mean();
-        columns.push_back(c->array() - m);
+        columns.push_back(centered_scratch_column<ArrowType>(bitmap, *it));
     }
 
+    return columns;
+}
+
+// The cross products of compute_cov() and compute_sse() are computed as a blocked SYRK: the rows are split in panels of
+// cross_product_panel_rows rows and the columns in tiles of cross_product_tile_cols columns, so the segments of two
+// tiles in a panel (256 KiB of double values) stay in the cache while all their cross products are computed, instead of
+// reading both columns from memory for each pair. The panels are a multiple of reduction_block_size.
+inline constexpr Eigen::Index cross_product_panel_rows = 2048;
+inline constexpr int cross_product_tile_cols = 8;
+// The pairs of tiles are computed in parallel (with the hardware concurrency) if the number of products of values of
+// the upper triangle is at least cross_product_parallel_work.
+inline constexpr double cross_product_parallel_work = 1 << 26;
+
+// Returns the cross products v[i]^T v[j] of the (centered) columns. Each cross product is the sum, in order, of the
+// accurate_dot() of its panels, so it only depends on its two columns: not on the other columns (see
+// CovarianceRegistry) or on the number of threads. With a single panel, it is accurate_dot() of the columns.
+template <typename MatrixObject>
+MatrixXd cross_products(std::vector<MatrixObject>& v) {
+    int n = v.size();
+    MatrixXd res = MatrixXd::Zero(n, n);
+    if (n == 0) return res;
+
+    auto N = v[0].rows();
+    int tiles = (n + cross_product_tile_cols - 1) / cross_product_tile_cols;
+    std::vector<std::pair<int, int>> tile_pairs;
+    tile_pairs.reserve(tiles * (tiles + 1) / 2);
+    for (int ti = 0; ti < tiles; ++ti) {
+        for (int tj = ti; tj < tiles; ++tj) {
+            tile_pairs.emplace_back(ti, tj);
+        }
+    }
+
+    auto work = 0.5 * static_cast<double>(n) * (n + 1) * N;
+    int num_threads = (work >= cross_product_parallel_work) ? 0 : 1;
+
+    util::parallel_for(0, static_cast<int>(tile_pairs.size()), num_threads, [&](int t, int) {
+        auto [ti, tj] = tile_pairs[t];
+        auto i_begin = ti * cross_product_tile_cols;
+        auto i_end = std::min(n, i_begin + cross_product_tile_cols);
+        auto j_begin = tj * cross_product_tile_cols;
+        auto j_end = std::min(n, j_begin + cross_product_tile_cols);
+
+        for (Eigen::Index begin = 0; begin < N; begin += cross_product_panel_rows) {
+            auto length = std::min(cross_product_panel_rows, N - begin);
+            for (auto i = i_begin; i < i_end; ++i) {
+                auto vi = v[i].segment(begin, length);
+                for (auto j = std::max(i, j_begin); j < j_end; ++j) {
+                    res(i, j) += accurate_dot(vi, v[j].segment(begin, length));
+                }
+            }
+        }
+    });
+
+    return res;
+}
+
+template <typename ArrowType, typename MatrixObject>
+EigenMatrix<ArrowType> compute_cov(std::vector<MatrixObject>& v) {
+    using CType = typename ArrowType::c_type;
+    double inv_N = 1 / static_cast<double>(v[0].rows() - 1);
+    MatrixXd products = cross_products(v).template selfadjointView<Eigen::Upper>();
+    return std::make_unique<typename EigenMatrix<ArrowType>::element_type>((products * inv_N).template cast<CType>());
+}
+
+template <typename ArrowType>
+EigenMatrix<ArrowType> cov(Buffer_ptr bitmap, Array_iterator begin, Array_iterator end) {
+    util::ScratchScope scope;
+    auto columns = centered_scratch_columns<ArrowType>(bitmap, begin, end);
     return compute_cov<ArrowType>(columns);
 }
 
@@ -372,31 +627,14 @@ EigenMatrix<ArrowType> cov(Array_iterator begin, Array_iterator end) {
         auto bitmap = combined_bitmap(begin, end);
         return cov<ArrowType>(bitmap, begin, end);
     } else {
-        using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-        std::vector<EigenVector> columns;
-        auto n = std::distance(begin, end);
-        columns.reserve(n);
-
-        for (auto it = begin; it != end; ++it) {
-            auto c = to_eigen<false, ArrowType, false>(*it);
-            auto m = c->mean();
-            columns.push_back(c->array() - m);
-        }
-
-        return compute_cov<ArrowType>(columns);
+        return cov<ArrowType>(nullptr, begin, end);
     }
 }
 
 template <typename ArrowType>
 typename ArrowType::c_type cov(Buffer_ptr bitmap, Array_ptr col) {
-    using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-    std::vector<EigenVector> columns;
-    columns.reserve(1);
-
-    auto c = to_eigen<false, ArrowType>(bitmap, col);
-    auto m = c->mean();
-    columns.push_back(c->array() - m);
-
+    util::ScratchScope scope;
+    std::vector<ScratchVector<ArrowType>> columns{centered_scratch_column<ArrowType>(bitmap, col)};
     return *compute_cov<ArrowType>(columns)->data();
 }
 
@@ -406,48 +644,22 @@ typename ArrowType::c_type cov(Array_ptr col) {
         auto bitmap = col->null_bitmap();
         return cov<ArrowType>(bitmap, col);
     } else {
-        using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-        std::vector<EigenVector> columns;
-        columns.reserve(1);
-
-        auto c = to_eigen<false, ArrowType, false>(col);
-        auto m = c->mean();
-        columns.push_back(c->array() - m);
-
-        return *compute_cov<ArrowType>(columns)->data();
+        return cov<ArrowType>(nullptr, col);
     }
 }
 
 // //////////////////////////////////// sse() //////////////////////////////
 template <typename ArrowType, typename MatrixObject>
 EigenMatrix<ArrowType> compute_sse(std::vector<MatrixObject>& v) {
-    auto n = v.size();
-    EigenMatrix<ArrowType> res = std::make_unique<typename EigenMatrix<ArrowType>::element_type>(n, n);
-
-    for (size_t i = 0; i < v.size(); ++i) {
-        (*res)(i, i) = v[i].squaredNorm();
-
-        for (size_t j = i + 1; j < v.size(); ++j) {
-            (*res)(i, j) = (*res)(j, i) = v[i].dot(v[j]);
-        }
-    }
-
-    return res;
+    using CType = typename ArrowType::c_type;
+    MatrixXd products = cross_products(v).template selfadjointView<Eigen::Upper>();
+    return std::make_unique<typename EigenMatrix<ArrowType>::element_type>(products.template cast<CType>());
 }
 
 template <typename ArrowType>
 EigenMatrix<ArrowType> sse(Buffer_ptr bitmap, Array_iterator begin, Array_iterator end) {
-    using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-    std::vector<EigenVector> columns;
-    auto n = std::distance(begin, end);
-    columns.reserve(n);
-
-    for (auto it = begin; it != end; ++it) {
-        auto c = to_eigen<false, ArrowType>(bitmap, *it);
-        auto m = c->mean();
-        columns.push_back(c->array() - m);
-    }
-
+    util::ScratchScope scope;
+    auto columns = centered_scratch_columns<ArrowType>(bitmap, begin, end);
     return compute_sse<ArrowType>(columns);
 }
 
@@ -457,31 +669,14 @@ EigenMatrix<ArrowType> sse(Array_iterator begin, Array_iterator end) {
         auto bitmap = combined_bitmap(begin, end);
         return sse<ArrowType>(bitmap, begin, end);
     } else {
-        using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-        std::vector<EigenVector> columns;
-        auto n = std::distance(begin, end);
-        columns.reserve(n);
-
-        for (auto it = begin; it != end; ++it) {
-            auto c = to_eigen<false, ArrowType, false>(*it);
-            auto m = c->mean();
-            columns.push_back(c->array() - m);
-        }
-
-        return compute_sse<ArrowType>(columns);
+        return sse<ArrowType>(nullptr, begin, end);
     }
 }
 
 template <typename ArrowType>
 EigenMatrix<ArrowType> sse(Buffer_ptr bitmap, Array_ptr col) {
-    using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-    std::vector<EigenVector> columns;
-    columns.reserve(1);
-
-    auto c = to_eigen<false, ArrowType>(bitmap, col);
-    auto m = c->mean();
-    columns.push_back(c->array() - m);
-
+    util::ScratchScope scope;
+    std::vector<ScratchVector<ArrowType>> columns{centered_scratch_column<ArrowType>(bitmap, col)};
     return compute_sse<ArrowType>(columns);
 }
 
@@ -491,15 +686,7 @@ EigenMatrix<ArrowType> sse(Array_ptr col) {
         auto bitmap = col->null_bitmap();
         return sse<ArrowType>(bitmap, col);
     } else {
-        using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
-        std::vector<EigenVector> columns;
-        columns.reserve(1);
-
-        auto c = to_eigen<false, ArrowType, false>(col);
-        auto m = c->mean();
-        columns.push_back(c->array() - m);
-
-        return compute_sse<ArrowType>(columns);
+        return sse<ArrowType>(nullptr, col);
     }
 }
 
@@ -1737,6 +1924,20 @@ public:
         return dataset::sse<ArrowType>(bitmap, c.begin(), c.end());
     }
 
+    ///////////////////////////// eigen_view<ArrowType> /////////////////////////
+    // Returns a view of the columns without copying if they are null-free and contiguous in memory. Otherwise, the
+    // matrix is copied once and kept in the EigenMatrixCache. The rows with null values are removed.
+    template <bool append_ones, typename ArrowType, typename Index, enable_if_index_t<Index, int> = 0>
+    EigenMatrixView<ArrowType> eigen_view(const Index& index) const {
+        Array_vector v{derived().col(index)};
+        return dataset::eigen_view<append_ones, ArrowType>(v.begin(), v.end(), derived().num_rows());
+    }
+    template <bool append_ones, typename ArrowType, typename T, enable_if_index_container_t<T, int> = 0>
+    EigenMatrixView<ArrowType> eigen_view(const T& cols) const {
+        Array_vector v = indices_to_columns(cols);
+        return dataset::eigen_view<append_ones, ArrowType>(v.begin(), v.end(), derived().num_rows());
+    }
+
     ///////////////////////////// indices_to_columns /////////////////////////
     Array_vector indices_to_columns() const;
     template <typename T, enable_if_index_container_t<T, int> = 0>
@@ -2036,7 +2237,23 @@ public:
     std::vector<int> discrete_columns() const;
     std::vector<int> continuous_columns() const;
 
-    DataFrame normalize() const;
+    // Returns the DataFrame with the continuous columns normalized to zero mean and unit variance. The normalized
+    // columns are computed with num_threads threads and cached in DerivedColumnCache, so they are computed once for
+    // the same data.
+    DataFrame normalize(int num_threads = 1) const;
+    // Returns the ranks of the values of each column as "float" columns. The columns must be "double" or "float". The
+    // ranks are cached as in normalize().
+    DataFrame ranked(int num_threads = 1) const;
+    // Returns the minimum and maximum of a "double" or "float" column. The result is cached as in normalize().
+    std::pair<double, double> min_max(int index) const;
+    template <typename StringType, util::enable_if_stringable_t<StringType, int> = 0>
+    std::pair<double, double> min_max(const StringType& name) const {
+        return min_max(index(name));
+    }
+
+    // Returns a uniform random sample of n rows (without replacement), in the order of the DataFrame. If n is greater
+    // than or equal to the number of rows, it returns the DataFrame.
+    DataFrame sample_rows(int64_t n, unsigned int seed) const;
 
     DataFrame filter_null() const {
         if (null_count() == 0) {
@@ -2051,9 +2268,9 @@ public:
             arrow::AdaptiveIntBuilder builder;
             RAISE_STATUS_ERROR(builder.Reserve(valid_rows));
 
-            for (auto i = 0; i < total_rows; ++i) {
-                if (util::bit_util::GetBit(bitmap_data, i)) RAISE_STATUS_ERROR(builder.Append(i));
-            }
+            util::bit_util::visit_set_runs(bitmap_data, total_rows, [&builder](int64_t begin, int64_t run) {
+                for (auto i = begin, end = begin + run; i < end; ++i) RAISE_STATUS_ERROR(builder.Append(i));
+            });
 
             Array_ptr take_ind;
             RAISE_STATUS_ERROR(builder.Finish(&take_ind));
@@ -2075,6 +2292,60 @@ public:
 private:
     std::shared_ptr<RecordBatch> m_batch;
 };
+
+// A mutable set of columns with the same number of rows, used to assemble a DataFrame column by column. Appending a
+// column is O(1) (amortized), and the columns are moved to the DataFrame by finish(), so assembling a DataFrame of d
+// columns is O(d) instead of O(d^2) with arrow::RecordBatch::AddColumn().
+class DataFrameBuilder {
+public:
+    DataFrameBuilder(int64_t num_rows) : m_num_rows(num_rows), m_fields(), m_columns(), m_indices() {}
+    // Starts with the columns of df.
+    DataFrameBuilder(const DataFrame& df);
+
+    void reserve(int num_columns) {
+        m_fields.reserve(num_columns);
+        m_columns.reserve(num_columns);
+        m_indices.reserve(num_columns);
+    }
+
+    int64_t num_rows() const { return m_num_rows; }
+    int num_columns() const { return m_columns.size(); }
+    bool has_column(const std::string& name) const { return m_indices.count(name) > 0; }
+    Array_ptr col(const std::string& name) const;
+
+    void append(Field_ptr field, Array_ptr column);
+    void append(const std::string& name, Array_ptr column) {
+        auto type = column->type();
+        append(arrow::field(name, std::move(type)), std::move(column));
+    }
+
+    // Returns a DataFrame with the columns names (in that order), without copying the builder.
+    DataFrame loc(const std::vector<std::string>& names) const;
+    // Moves the columns to a DataFrame, in the order they were appended. The builder is empty after the call.
+    DataFrame finish();
+    // Returns a DataFrame with the columns names (in that order). The builder is empty after the call.
+    DataFrame finish(const std::vector<std::string>& names);
+
+private:
+    int index(const std::string& name) const;
+    void clear();
+
+    int64_t m_num_rows;
+    std::vector<Field_ptr> m_fields;
+    Array_vector m_columns;
+    std::unordered_map<std::string, int> m_indices;
+};
+
+// Reads the columns of an Arrow IPC file (Feather v2). The file is memory-mapped, so the DataFrame does not copy the
+// data if the file is uncompressed and contains a single record batch. If columns is empty, all the columns are read.
+DataFrame read_ipc(const std::string& path, const std::vector<std::string>& columns = {});
+
+// Reads the columns of a Parquet file. Unlike read_ipc(), the reading is eager: the selected columns of the selected
+// row groups are decoded into memory. If columns is empty, all the columns are read. If row_groups is empty, all the
+// row groups are read, so a file larger than the memory must be read by row groups.
+DataFrame read_parquet(const std::string& path,
+                       const std::vector<std::string>& columns = {},
+                       const std::vector<int>& row_groups = {});
 }  // namespace dataset
 
 namespace pybind11::detail {
@@ -2105,10 +2376,8 @@ public:
                 return false;
             }
         } else if (dataset::is_pandas_dataframe(src)) {
-            auto a = dataset::pandas_to_pyarrow_record_batch(src);
-            auto result = pyarrow::unwrap_batch(a.ptr());
-            if (result.ok()) {
-                value = result.ValueOrDie();
+            if (auto batch = dataset::pandas_to_record_batch(src)) {
+                value = batch;
                 return true;
             } else {
                 return false;
@@ -2160,11 +2429,8 @@ public:
                 return false;
             }
         } else if (dataset::is_pandas_series(src)) {
-            auto a = dataset::pandas_to_pyarrow_array(src);
-            auto result = pyarrow::unwrap_array(a.ptr());
-
-            if (result.ok()) {
-                value = result.ValueOrDie();
+            if (auto array = dataset::pandas_to_array(src)) {
+                value = array;
                 return true;
             } else {
                 return false;
@@ -2230,6 +2496,30 @@ public:
     }
 };
 
+template <>
+struct type_caster<std::shared_ptr<arrow::Schema>> {
+public:
+    PYBIND11_TYPE_CASTER(std::shared_ptr<arrow::Schema>, _("pyarrow.Schema"));
+
+    bool load(handle src, bool) {
+        PyObject* py_ptr = src.ptr();
+
+        if (!pyarrow::is_schema(py_ptr)) return false;
+
+        auto result = pyarrow::unwrap_schema(py_ptr);
+        if (result.ok()) {
+            value = result.ValueOrDie();
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    static handle cast(std::shared_ptr<arrow::Schema> src, return_value_policy /* policy */, handle /* parent */) {
+        return pyarrow::wrap_schema(src);
+    }
+};
+
 }  // namespace pybind11::detail
 
 #endif  // PYBNESIAN_DATASET_DATASET_HPP
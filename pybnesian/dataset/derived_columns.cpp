@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <numeric>
+#include <dataset/dataset.hpp>
+#include <dataset/derived_columns.hpp>
+#include <util/basic_eigen_ops.hpp>
+#include <util/hash_utils.hpp>
+
+namespace dataset {
+
+std::size_t DerivedColumnCache::KeyHash::operator()(const Key& key) const {
+    std::size_t seed = std::hash<const void*>{}(key.data);
+    util::hash_combine(seed, key.null_bitmap);
+    util::hash_combine(seed, key.offset);
+    util::hash_combine(seed, key.length);
+    util::hash_combine(seed, static_cast<int>(key.type));
+    util::hash_combine(seed, static_cast<int>(key.kind));
+    return seed;
+}
+
+DerivedColumnCache::Key DerivedColumnCache::make_key(const Array_ptr& column, DerivedColumnKind kind) {
+    const auto& data = column->data();
+    const void* null_bitmap = column->null_count() > 0 ? column->null_bitmap_data() : nullptr;
+    return Key{data->buffers[1]->data(), null_bitmap, column->offset(), column->length(), column->type_id(), kind};
+}
+
+template <typename OutputArrowType, typename InputArrowType>
+Array_ptr rank_column(const Array_ptr& column) {
+    using OutputCType = typename OutputArrowType::c_type;
+    using ArrayType = typename arrow::TypeTraits<InputArrowType>::ArrayType;
+
+    auto dwn = std::static_pointer_cast<ArrayType>(column);
+    auto raw_values = dwn->raw_values();
+
+    std::vector<size_t> indices;
+    indices.reserve(column->length() - column->null_count());
+    if (column->null_count() == 0) {
+        indices.resize(column->length());
+        std::iota(indices.begin(), indices.end(), 0);
+    } else {
+        for (int64_t i = 0; i < column->length(); ++i) {
+            if (column->IsValid(i)) indices.push_back(i);
+        }
+    }
+
+    std::sort(
+        indices.begin(), indices.end(), [raw_values](size_t a, size_t b) { return raw_values[a] < raw_values[b]; });
+
+    std::vector<OutputCType> ranked_data(column->length(), 0);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        ranked_data[indices[i]] = static_cast<OutputCType>(i);
+    }
+
+    arrow::NumericBuilder<OutputArrowType> builder;
+    if (column->null_count() == 0) {
+        RAISE_STATUS_ERROR(builder.AppendValues(ranked_data.begin(), ranked_data.end()));
+    } else {
+        std::vector<bool> valid(column->length());
+        for (int64_t i = 0; i < column->length(); ++i) {
+            valid[i] = column->IsValid(i);
+        }
+        RAISE_STATUS_ERROR(builder.AppendValues(ranked_data, valid));
+    }
+
+    Array_ptr out;
+    RAISE_STATUS_ERROR(builder.Finish(&out));
+    return out;
+}
+
+template <typename ArrowType>
+Array_ptr zscore_column(const Array_ptr& column) {
+    using MatrixType = Matrix<typename ArrowType::c_type, Dynamic, 1>;
+
+    std::unique_ptr<MatrixType> eig;
+    if (column->null_count() == 0) {
+        eig = std::make_unique<MatrixType>(*dataset::to_eigen<false, ArrowType, false>(column));
+    } else {
+        eig = dataset::to_eigen<false, ArrowType, true>(column);
+    }
+
+    util::normalize_cols(*eig);
+
+    arrow::NumericBuilder<ArrowType> builder;
+    RAISE_STATUS_ERROR(builder.Reserve(column->length()));
+    if (column->null_count() == 0) {
+        RAISE_STATUS_ERROR(builder.AppendValues(eig->data(), eig->rows()));
+    } else {
+        auto bitmap_data = column->null_bitmap_data();
+        for (int64_t i = 0, j = 0; i < column->length(); ++i) {
+            if (util::bit_util::GetBit(bitmap_data, column->offset() + i)) {
+                builder.UnsafeAppend((*eig)(j++));
+            } else {
+                builder.UnsafeAppendNull();
+            }
+        }
+    }
+
+    Array_ptr out;
+    RAISE_STATUS_ERROR(builder.Finish(&out));
+    return out;
+}
+
+template <typename ArrowType>
+DerivedColumn compute_column(const Array_ptr& column, DerivedColumnKind kind) {
+    switch (kind) {
+        case DerivedColumnKind::Rank:
+            return DerivedColumn{rank_column<arrow::FloatType, ArrowType>(column), 0, 0};
+        case DerivedColumnKind::ZScore:
+            return DerivedColumn{zscore_column<ArrowType>(column), 0, 0};
+        case DerivedColumnKind::MinMax: {
+            Array_ptr col = column;
+            return DerivedColumn{nullptr,
+                                 static_cast<double>(dataset::min<ArrowType>(col)),
+                                 static_cast<double>(dataset::max<ArrowType>(col))};
+        }
+        default:
+            throw std::invalid_argument("Wrong derived column kind.");
+    }
+}
+
+DerivedColumn DerivedColumnCache::compute(const Array_ptr& column, DerivedColumnKind kind) {
+    switch (column->type_id()) {
+        case Type::DOUBLE:
+            return compute_column<arrow::DoubleType>(column, kind);
+        case Type::FLOAT:
+            return compute_column<arrow::FloatType>(column, kind);
+        default:
+            throw std::invalid_argument(
+                "Derived columns are only implemented for \"double\" and \"float\" data types.");
+    }
+}
+
+void DerivedColumnCache::insert_unlocked(const Key& key, Entry&& entry) {
+    // Remove the entries of the data that does not exist anymore, and then the oldest entries.
+    for (auto it = m_order.begin(); it != m_order.end();) {
+        auto e = m_entries.find(*it);
+        if (e->second.buffer.expired()) {
+            m_memory -= e->second.memory;
+            m_entries.erase(e);
+            it = m_order.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    while (!m_order.empty() && m_memory + entry.memory > max_memory) {
+        auto it = m_entries.find(m_order.front());
+        m_memory -= it->second.memory;
+        m_entries.erase(it);
+        m_order.pop_front();
+    }
+
+    m_memory += entry.memory;
+    m_order.push_back(key);
+    m_entries.emplace(key, std::move(entry));
+}
+
+DerivedColumn DerivedColumnCache::get(const Array_ptr& column, DerivedColumnKind kind) {
+    auto key = make_key(column, kind);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end() && !it->second.buffer.expired()) return it->second.column;
+    }
+
+    auto res = compute(column, kind);
+
+    std::size_t memory = 0;
+    if (res.array) {
+        for (const auto& b : res.array->data()->buffers) {
+            if (b) memory += b->size();
+        }
+    }
+
+    if (memory > max_memory) return res;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_entries.find(key); it != m_entries.end()) {
+        // The address of an expired entry was reused by new data.
+        if (!it->second.buffer.expired()) return it->second.column;
+
+        m_memory -= it->second.memory;
+        m_entries.erase(it);
+        m_order.erase(std::find(m_order.begin(), m_order.end(), key));
+    }
+
+    insert_unlocked(key, Entry{column->data()->buffers[1], res, memory});
+    return res;
+}
+
+}  // namespace dataset
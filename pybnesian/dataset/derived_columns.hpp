@@ -0,0 +1,94 @@
+#ifndef PYBNESIAN_DATASET_DERIVED_COLUMNS_HPP
+#define PYBNESIAN_DATASET_DERIVED_COLUMNS_HPP
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <arrow/api.h>
+
+using Array_ptr = std::shared_ptr<arrow::Array>;
+
+namespace dataset {
+
+enum class DerivedColumnKind { Rank, ZScore, MinMax };
+
+// A column derived from a column of a DataFrame. Rank and ZScore columns are stored in array, and the MinMax of a
+// column is stored in (first, second).
+struct DerivedColumn {
+    Array_ptr array;
+    double first;
+    double second;
+};
+
+// A process-wide cache of the columns derived from the columns of the DataFrames (ranks, z-scores and min/max), so the
+// tests and scores created with the same data compute them once. The columns are identified by the address of their
+// data, so the DataFrames converted again from the same pandas DataFrame or pyarrow RecordBatch share the derived
+// columns. An entry is valid while the data buffer of its column is alive, so the address cannot be reused by other
+// data. As the rest of the library, this assumes that the data is not modified in place.
+//
+// The entries are evicted in FIFO order when the derived arrays contain more than max_memory bytes.
+class DerivedColumnCache {
+public:
+    static constexpr std::size_t max_memory = std::size_t{1} << 30;
+
+    static DerivedColumnCache& shared() {
+        static DerivedColumnCache cache;
+        return cache;
+    }
+
+    // Returns the derived column of kind of column. The column must be a "double" or "float" array.
+    DerivedColumn get(const Array_ptr& column, DerivedColumnKind kind);
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_order.clear();
+        m_memory = 0;
+    }
+
+private:
+    DerivedColumnCache() : m_mutex(), m_entries(), m_order(), m_memory(0) {}
+
+    struct Key {
+        const void* data;
+        const void* null_bitmap;
+        int64_t offset;
+        int64_t length;
+        arrow::Type::type type;
+        DerivedColumnKind kind;
+
+        bool operator==(const Key& other) const {
+            return data == other.data && null_bitmap == other.null_bitmap && offset == other.offset &&
+                   length == other.length && type == other.type && kind == other.kind;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        // The data buffer of the column. The entry is not valid if it has expired.
+        std::weak_ptr<arrow::Buffer> buffer;
+        DerivedColumn column;
+        std::size_t memory;
+    };
+
+    static Key make_key(const Array_ptr& column, DerivedColumnKind kind);
+    static DerivedColumn compute(const Array_ptr& column, DerivedColumnKind kind);
+    void insert_unlocked(const Key& key, Entry&& entry);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    std::deque<Key> m_order;
+    std::size_t m_memory;
+};
+
+}  // namespace dataset
+
+#endif  // PYBNESIAN_DATASET_DERIVED_COLUMNS_HPP
@@ -94,6 +94,96 @@ void append_slice(const DataFrame& slice, Array_vector& columns, Field_vector& f
     }
 }
 
+namespace {
+
+template <typename ArrowType>
+std::pair<VectorXd, MatrixXd> lagged_moments(const DataFrame& origin,
+                                              int max_lag,
+                                              int num_rows,
+                                              const std::vector<int>& indices) {
+    int num_variables = origin->num_columns();
+    int n = indices.size();
+
+    // The origin variable (as a position in variables) and the first origin row of each index.
+    std::vector<int> variables;
+    std::unordered_map<int, int> variable_position;
+    std::vector<int> position(n);
+    std::vector<int> start(n);
+    for (int i = 0; i < n; ++i) {
+        auto v = indices[i] % num_variables;
+        auto it = variable_position.find(v);
+        if (it == variable_position.end()) {
+            it = variable_position.insert({v, variables.size()}).first;
+            variables.push_back(v);
+        }
+
+        position[i] = it->second;
+        start[i] = max_lag - indices[i] / num_variables;
+    }
+
+    // The origin rows of the variables, shifted by their mean to reduce the rounding errors.
+    int origin_rows = num_rows + max_lag;
+    MatrixXd x(origin_rows, variables.size());
+    for (size_t k = 0; k < variables.size(); ++k) {
+        auto data = origin.template data<ArrowType>(variables[k]);
+        for (int r = 0; r < origin_rows; ++r) {
+            x(r, k) = data[r];
+        }
+    }
+
+    VectorXd shift = x.colwise().mean().transpose();
+    x.rowwise() -= shift.transpose();
+
+    // The sums of the rows [s, s + num_rows) of each variable.
+    MatrixXd sums(variables.size(), max_lag + 1);
+    sums.col(0) = x.topRows(num_rows).colwise().sum().transpose();
+    for (int s = 1; s <= max_lag; ++s) {
+        sums.col(s) = sums.col(s - 1) - x.row(s - 1).transpose() + x.row(num_rows + s - 1).transpose();
+    }
+
+    VectorXd means(n);
+    std::vector<std::vector<int>> starting(max_lag + 1);
+    for (int i = 0; i < n; ++i) {
+        means(i) = sums(position[i], start[i]) / num_rows + shift(position[i]);
+        starting[start[i]].push_back(i);
+    }
+
+    MatrixXd sse(n, n);
+    for (int d = 0; d <= max_lag; ++d) {
+        // The cross products of the rows [s, s + num_rows) with the rows [s + d, s + d + num_rows). Moving the windows
+        // one row only changes their first and last rows.
+        MatrixXd cross = x.topRows(num_rows).transpose() * x.middleRows(d, num_rows);
+        for (int s = 0; s + d <= max_lag; ++s) {
+            if (s > 0) {
+                cross += x.row(num_rows + s - 1).transpose() * x.row(num_rows + s - 1 + d) -
+                         x.row(s - 1).transpose() * x.row(s - 1 + d);
+            }
+
+            for (auto i : starting[s]) {
+                for (auto j : starting[s + d]) {
+                    sse(i, j) = sse(j, i) =
+                        cross(position[i], position[j]) - sums(position[i], s) * sums(position[j], s + d) / num_rows;
+                }
+            }
+        }
+    }
+
+    return std::make_pair(means, sse);
+}
+
+}  // namespace
+
+std::pair<VectorXd, MatrixXd> LaggedDataFrame::moments(const std::vector<int>& indices) const {
+    switch (m_df.same_type(indices)->id()) {
+        case Type::DOUBLE:
+            return lagged_moments<arrow::DoubleType>(m_origin, m_max_lag, m_df->num_rows(), indices);
+        case Type::FLOAT:
+            return lagged_moments<arrow::FloatType>(m_origin, m_max_lag, m_df->num_rows(), indices);
+        default:
+            throw std::invalid_argument("Lagged moments can only be computed for continuous columns.");
+    }
+}
+
 void append_slice(const std::vector<DataFrame>& slices,
                   Array_vector& columns,
                   Field_vector& fields,
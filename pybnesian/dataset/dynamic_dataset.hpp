@@ -37,6 +37,29 @@ struct DynamicVariable {
     int temporal_slice;
 };
 
+// A DataFrame whose columns are lagged slices of the columns of an origin DataFrame, such as the static and the
+// transition DataFrames of a DynamicDataFrame: the column s * V + v (where V is the number of columns of origin)
+// contains the rows [max_lag - s, max_lag - s + num_rows) of the column v of origin.
+class LaggedDataFrame {
+public:
+    LaggedDataFrame(DataFrame df, DataFrame origin, int max_lag)
+        : m_df(std::move(df)), m_origin(std::move(origin)), m_max_lag(max_lag) {}
+
+    const DataFrame& dataframe() const { return m_df; }
+
+    // Returns the means and the sum of squared errors of the columns indices of dataframe(), which must be continuous
+    // of the same type and without null values. The cross products of two columns only depend on their origin
+    // variables, the difference of their lags and a few boundary rows, so they are computed from the lagged cross
+    // products of the origin variables: one pass over the origin data for each lag, instead of one pass for each pair
+    // of columns.
+    std::pair<VectorXd, MatrixXd> moments(const std::vector<int>& indices) const;
+
+private:
+    DataFrame m_df;
+    DataFrame m_origin;
+    int m_max_lag;
+};
+
 class DynamicDataFrame;
 template <>
 struct dataframe_traits<DynamicDataFrame> {
@@ -148,6 +171,10 @@ public:
 
     const DataFrame& transition_df() const { return m_transition; }
 
+    LaggedDataFrame lagged_static_df() const { return LaggedDataFrame(m_static, m_origin, m_markovian_order - 1); }
+
+    LaggedDataFrame lagged_transition_df() const { return LaggedDataFrame(m_transition, m_origin, m_markovian_order); }
+
     std::shared_ptr<RecordBatch> operator->() const { return m_transition.record_batch(); }
 
 private:
@@ -237,7 +264,9 @@ class DynamicAdaptator {
 public:
     template <typename... Args>
     DynamicAdaptator(DynamicDataFrame df, const Args&... args)
-        : m_df(df), m_static(m_df.static_df(), args...), m_transition(m_df.transition_df(), args...) {}
+        : m_df(df),
+          m_static(make_element(m_df.lagged_static_df(), args...)),
+          m_transition(make_element(m_df.lagged_transition_df(), args...)) {}
 
     const DynamicDataFrame& dataframe() const { return m_df; }
     DynamicDataFrame& dataframe() { return m_df; }
@@ -259,6 +288,15 @@ public:
     int markovian_order() const { return m_df.markovian_order(); }
 
 private:
+    // The elements that can be constructed from a LaggedDataFrame use the lagged structure of its columns.
+    template <typename... Args>
+    static T make_element(const LaggedDataFrame& df, const Args&... args) {
+        if constexpr (std::is_constructible_v<T, const LaggedDataFrame&, const Args&...>)
+            return T(df, args...);
+        else
+            return T(df.dataframe(), args...);
+    }
+
     DynamicDataFrame m_df;
     T m_static;
     T m_transition;
@@ -35,10 +35,10 @@ public:
             int valid_rows = util::bit_util::non_null_count(combined_bitmap, total_rows);
             indices.reserve(valid_rows);
 
-            auto bitmap_data = combined_bitmap->data();
-            for (auto i = 0; i < total_rows; ++i) {
-                if (util::bit_util::GetBit(bitmap_data, i)) indices.push_back(i);
-            }
+            util::bit_util::visit_set_runs(
+                combined_bitmap->data(), total_rows, [&indices](int64_t begin, int64_t run) {
+                    for (auto i = begin, end = begin + run; i < end; ++i) indices.push_back(i);
+                });
         }
 
         std::mt19937 rng{m_seed};
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <dataset/missing_patterns.hpp>
+
+namespace dataset {
+
+MissingPatternMoments::MissingPatternMoments(const DataFrame& df, const std::vector<int>& columns)
+    : m_df(df), m_columns(columns), m_has_nulls(), m_mutex(), m_moments(), m_order(), m_cells(0) {
+    m_has_nulls.reserve(columns.size());
+    for (auto c : columns) {
+        m_has_nulls.push_back(m_df.null_count(c) > 0);
+    }
+}
+
+std::shared_ptr<PatternMoments> MissingPatternMoments::compute_moments(const std::vector<int>& pattern) const {
+    auto res = std::make_shared<PatternMoments>();
+    res->positions = std::vector<int>(m_columns.size(), -1);
+
+    std::vector<int> included;
+    for (int i = 0, size = m_columns.size(); i < size; ++i) {
+        if (!m_has_nulls[i] || std::binary_search(pattern.begin(), pattern.end(), i)) {
+            res->positions[i] = included.size();
+            included.push_back(m_columns[i]);
+        }
+    }
+
+    std::vector<int> pattern_columns;
+    pattern_columns.reserve(pattern.size());
+    for (auto p : pattern) {
+        pattern_columns.push_back(m_columns[p]);
+    }
+
+    Buffer_ptr bitmap = pattern.empty() ? nullptr : m_df.combined_bitmap(pattern_columns);
+    res->rows = bitmap ? util::bit_util::non_null_count(bitmap, m_df->num_rows()) : m_df->num_rows();
+
+    if (bitmap)
+        res->means = m_df.means(bitmap, included);
+    else
+        res->means = m_df.means(included);
+
+    switch (m_df.same_type(included)->id()) {
+        case Type::DOUBLE:
+            res->sse = std::move(*m_df.sse<arrow::DoubleType>(bitmap, included.begin(), included.end()));
+            break;
+        case Type::FLOAT:
+            res->sse = m_df.sse<arrow::FloatType>(bitmap, included.begin(), included.end())->template cast<double>();
+            break;
+        default:
+            throw std::invalid_argument("Missingness pattern moments require \"double\" or \"float\" data.");
+    }
+
+    return res;
+}
+
+std::shared_ptr<const PatternMoments> MissingPatternMoments::moments(const std::vector<int>& variables) const {
+    std::vector<int> pattern;
+    for (auto v : variables) {
+        if (m_has_nulls[v]) pattern.push_back(v);
+    }
+    std::sort(pattern.begin(), pattern.end());
+    pattern.erase(std::unique(pattern.begin(), pattern.end()), pattern.end());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_moments.find(pattern);
+        if (it != m_moments.end()) return it->second;
+    }
+
+    std::shared_ptr<const PatternMoments> res = compute_moments(pattern);
+
+    std::size_t cells = res->sse.size();
+    if (cells > m_max_cells) return res;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_moments.find(pattern); it != m_moments.end()) return it->second;
+    if (cells > m_max_cells) return res;
+
+    evict_unlocked(cells);
+    m_cells += cells;
+    m_order.push_back(pattern);
+    m_moments.emplace(pattern, res);
+    return res;
+}
+
+void MissingPatternMoments::evict_unlocked(std::size_t cells) const {
+    while (!m_order.empty() && m_cells + cells > m_max_cells) {
+        auto it = m_moments.find(m_order.front());
+        m_cells -= it->second->sse.size();
+        m_moments.erase(it);
+        m_order.pop_front();
+    }
+}
+
+}  // namespace dataset
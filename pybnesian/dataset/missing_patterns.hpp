@@ -0,0 +1,84 @@
+#ifndef PYBNESIAN_DATASET_MISSING_PATTERNS_HPP
+#define PYBNESIAN_DATASET_MISSING_PATTERNS_HPP
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <dataset/dataset.hpp>
+#include <util/hash_utils.hpp>
+
+using Eigen::MatrixXd, Eigen::VectorXd;
+
+namespace dataset {
+
+// The means and the SSE of a set of columns in the rows where the columns of a missingness pattern are not null.
+struct PatternMoments {
+    int64_t rows;
+    // The position of each column in means and sse, or -1 if the column is not available in the rows of the pattern.
+    std::vector<int> positions;
+    VectorXd means;
+    MatrixXd sse;
+};
+
+// Caches the moments of a set of continuous columns of a DataFrame for each missingness pattern. The pattern of a
+// query is the subset of its columns that contain nulls, so the queries that contain the same columns with nulls
+// share the moments, which contain all the columns without nulls and the columns of the pattern. This is exact: the
+// moments of the columns of a query are computed with the rows where all of them are valid.
+//
+// When the missing values are sporadic and concentrated in a few columns, there are few patterns and the statistics
+// of most queries are read from the cache instead of the data. The moments are evicted in FIFO order when the cache
+// contains more than max_cells cells (or the limit of set_max_cells()).
+class MissingPatternMoments {
+public:
+    static constexpr std::size_t max_cells = 1 << 22;
+
+    // columns are the indices of the columns in df. All of them must have the same (floating point) data type.
+    MissingPatternMoments(const DataFrame& df, const std::vector<int>& columns);
+
+    // The variables are positions in the list of columns of the constructor.
+    bool has_nulls(int variable) const { return m_has_nulls[variable]; }
+    // Returns the moments of the missingness pattern of variables.
+    std::shared_ptr<const PatternMoments> moments(const std::vector<int>& variables) const;
+
+    // Number of bytes of the cached SSE matrices.
+    std::size_t memory() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return sizeof(double) * m_cells;
+    }
+    // Changes the maximum number of cached cells, evicting the oldest moments if the cache has more cells.
+    void set_max_cells(std::size_t cells) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_max_cells = cells;
+        evict_unlocked(0);
+    }
+
+private:
+    std::shared_ptr<PatternMoments> compute_moments(const std::vector<int>& pattern) const;
+    // Evicts the oldest moments until cells more cells fit in the cache.
+    void evict_unlocked(std::size_t cells) const;
+
+    class HashIndices {
+    public:
+        inline std::size_t operator()(const std::vector<int>& indices) const {
+            size_t seed = indices.size();
+            for (auto i : indices) {
+                util::hash_combine(seed, i);
+            }
+            return seed;
+        }
+    };
+
+    DataFrame m_df;
+    std::vector<int> m_columns;
+    std::vector<bool> m_has_nulls;
+
+    mutable std::mutex m_mutex;
+    mutable std::unordered_map<std::vector<int>, std::shared_ptr<const PatternMoments>, HashIndices> m_moments;
+    mutable std::deque<std::vector<int>> m_order;
+    mutable std::size_t m_cells;
+    mutable std::atomic<std::size_t> m_max_cells = max_cells;
+};
+
+}  // namespace dataset
+
+#endif  // PYBNESIAN_DATASET_MISSING_PATTERNS_HPP
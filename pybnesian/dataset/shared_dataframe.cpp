@@ -0,0 +1,108 @@
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <dataset/shared_dataframe.hpp>
+#include <util/arrow_macros.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace dataset {
+
+namespace {
+
+long current_process_id() {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+void write_ipc_batch(const std::shared_ptr<arrow::io::OutputStream>& file, const DataFrame& df) {
+    // The default options do not compress the buffers, so the columns can be memory-mapped.
+    RAISE_RESULT_ERROR(auto writer, arrow::ipc::MakeFileWriter(file, df->schema()))
+    RAISE_STATUS_ERROR(writer->WriteRecordBatch(*df.record_batch()))
+    RAISE_STATUS_ERROR(writer->Close())
+}
+
+// Returns a new file name in the shared memory directory of the operating system, or in the temporary directory if
+// there is no shared memory directory.
+std::string shared_memory_path() {
+    std::error_code ec;
+    fs::path dir = "/dev/shm";
+    if (!fs::is_directory(dir, ec)) dir = fs::temp_directory_path();
+
+    std::random_device rd;
+    std::stringstream name;
+    name << "pybnesian_df_" << current_process_id() << "_" << std::hex << rd() << rd() << ".arrow";
+    return (dir / name.str()).string();
+}
+
+}  // namespace
+
+void write_ipc(const DataFrame& df, const std::string& path) {
+    RAISE_RESULT_ERROR(auto file, arrow::io::FileOutputStream::Open(path))
+    write_ipc_batch(file, df);
+    RAISE_STATUS_ERROR(file->Close())
+}
+
+SharedDataFrame::SharedDataFrame(const DataFrame& df, const std::optional<std::string>& path)
+    : m_path(path ? *path : shared_memory_path()), m_df(), m_owner() {
+    std::error_code ec;
+    if (fs::exists(m_path, ec)) throw std::invalid_argument("File " + m_path + " already exists.");
+
+    // The file is written with a temporary name, so the other processes never attach to an incomplete file.
+    auto tmp_path = m_path + ".tmp";
+    try {
+        write_ipc(df, tmp_path);
+        fs::rename(tmp_path, m_path);
+    } catch (...) {
+        fs::remove(tmp_path, ec);
+        throw;
+    }
+
+    m_owner = current_process_id();
+    m_df = read_ipc(m_path);
+}
+
+SharedDataFrame::SharedDataFrame(const std::string& path, DataFrame df)
+    : m_path(path), m_df(std::move(df)), m_owner() {}
+
+SharedDataFrame::~SharedDataFrame() {
+    if (owner()) {
+        std::error_code ec;
+        fs::remove(m_path, ec);
+    }
+}
+
+std::shared_ptr<SharedDataFrame> SharedDataFrame::attach(const std::string& path) {
+    std::error_code ec;
+    if (!fs::exists(path, ec))
+        throw std::invalid_argument("SharedDataFrame " + path + " does not exist. It was removed by its owner.");
+
+    return std::shared_ptr<SharedDataFrame>(new SharedDataFrame(path, read_ipc(path)));
+}
+
+bool SharedDataFrame::owner() const { return m_owner && *m_owner == current_process_id(); }
+
+void SharedDataFrame::unlink() {
+    std::error_code ec;
+    fs::remove(m_path, ec);
+    m_owner.reset();
+}
+
+std::shared_ptr<SharedDataFrame> SharedDataFrame::__setstate__(py::tuple& t) {
+    if (t.size() != 1) throw std::runtime_error("Not valid SharedDataFrame.");
+
+    return attach(t[0].cast<std::string>());
+}
+
+}  // namespace dataset
@@ -0,0 +1,57 @@
+#ifndef PYBNESIAN_DATASET_SHARED_DATAFRAME_HPP
+#define PYBNESIAN_DATASET_SHARED_DATAFRAME_HPP
+
+#include <optional>
+#include <dataset/dataset.hpp>
+
+namespace dataset {
+
+// Writes the DataFrame in an uncompressed Arrow IPC file with a single record batch, so read_ipc() memory-maps its
+// columns without copying them.
+void write_ipc(const DataFrame& df, const std::string& path);
+
+// A DataFrame exported to an Arrow IPC file that is memory-mapped by every process that uses it. By default, the file
+// is created in the shared memory of the operating system (/dev/shm), so the data is never written to the disk.
+//
+// The pickles of a SharedDataFrame only contain the path of the file, so the worker processes of multiprocessing
+// attach to the same memory instead of receiving a copy of the data. The DataFrame of an attached SharedDataFrame
+// uses the memory-mapped buffers, and so do the scores, tests and models built with it.
+//
+// The process that exports the DataFrame owns the file, and removes it when the SharedDataFrame is destroyed or
+// unlink() is called. The processes that already attached to the file keep their mappings.
+class SharedDataFrame {
+public:
+    // Exports df to path. If path is empty, a new file is created in the shared memory directory.
+    SharedDataFrame(const DataFrame& df, const std::optional<std::string>& path = std::nullopt);
+    ~SharedDataFrame();
+
+    SharedDataFrame(const SharedDataFrame&) = delete;
+    SharedDataFrame& operator=(const SharedDataFrame&) = delete;
+
+    // Attaches to a file exported by another SharedDataFrame. The attached SharedDataFrame does not own the file.
+    static std::shared_ptr<SharedDataFrame> attach(const std::string& path);
+
+    const std::string& path() const { return m_path; }
+    // Returns true if this SharedDataFrame removes the file when it is destroyed.
+    bool owner() const;
+    const DataFrame& dataframe() const { return m_df; }
+
+    // Removes the file. The DataFrames already attached keep their data, but the file cannot be attached again.
+    void unlink();
+
+    py::tuple __getstate__() const { return py::make_tuple(m_path); }
+    static std::shared_ptr<SharedDataFrame> __setstate__(py::tuple& t);
+
+private:
+    SharedDataFrame(const std::string& path, DataFrame df);
+
+    std::string m_path;
+    DataFrame m_df;
+    // The process id of the owner, or nullopt if the file is not owned. A process forked from the owner does not own
+    // the file.
+    std::optional<long> m_owner;
+};
+
+}  // namespace dataset
+
+#endif  // PYBNESIAN_DATASET_SHARED_DATAFRAME_HPP
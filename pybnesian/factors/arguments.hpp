@@ -142,6 +142,31 @@ private:
         m_name_type_args;
 };
 
+// Creates a new factor using the construction arguments of the score. The construction arguments are Python objects,
+// so the GIL is acquired while they are used. This allows calling this function from threads that do not hold the
+// GIL.
+template <typename Model>
+std::shared_ptr<Factor> new_factor_from_arguments(const Model& model,
+                                                  const std::shared_ptr<FactorType>& variable_type,
+                                                  const std::string& variable,
+                                                  const std::vector<std::string>& evidence,
+                                                  const Arguments& arguments) {
+    py::gil_scoped_acquire gil;
+    auto [args, kwargs] = arguments.args(variable, variable_type);
+    return variable_type->new_factor(model, variable, evidence, args, kwargs);
+}
+
+// Destroys a factor created with new_factor_from_arguments(). Python derived factors keep a reference to a Python
+// object, so it is released while holding the GIL.
+inline void release_factor(std::shared_ptr<Factor>& factor) {
+    if (factor && factor->is_python_derived()) {
+        py::gil_scoped_acquire gil;
+        factor.reset();
+    } else {
+        factor.reset();
+    }
+}
+
 }  // namespace factors
 
 #endif  // PYBNESIAN_FACTORS_ARGUMENTS_HPP
\ No newline at end of file
@@ -41,6 +41,9 @@ std::shared_ptr<Factor> CKDEType::new_factor(const ConditionalBayesianNetworkBas
 }
 
 void CKDE::fit(const DataFrame& df) {
+    // The joint and marginal KDEs are fitted in the device locked here.
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+
     auto type = df.same_type(m_variables);
 
     m_training_type = type;
@@ -58,7 +61,34 @@ void CKDE::fit(const DataFrame& df) {
     m_fitted = true;
 }
 
+void CKDE::fit_incremental(const CKDE& previous, const DataFrame& df) {
+    if (!previous.fitted() || previous.variable() != this->variable()) {
+        fit(df);
+        return;
+    }
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+
+    auto type = df.same_type(m_variables);
+
+    m_training_type = type;
+    switch (type->id()) {
+        case Type::DOUBLE:
+            _fit<arrow::DoubleType>(df, &previous);
+            break;
+        case Type::FLOAT:
+            _fit<arrow::FloatType>(df, &previous);
+            break;
+        default:
+            throw std::invalid_argument("Wrong data type to fit KDE. [double] or [float] data is expected.");
+    }
+
+    m_fitted = true;
+}
+
 VectorXd CKDE::logl(const DataFrame& df) const {
+    auto opencl_lock = OpenCLConfig::get(m_joint.opencl_device()).lock();
+
     check_fitted();
     auto type = df.same_type(m_variables);
 
@@ -77,6 +107,8 @@ VectorXd CKDE::logl(const DataFrame& df) const {
 }
 
 double CKDE::slogl(const DataFrame& df) const {
+    auto opencl_lock = OpenCLConfig::get(m_joint.opencl_device()).lock();
+
     check_fitted();
     auto type = df.same_type(m_variables);
 
@@ -95,11 +127,17 @@ double CKDE::slogl(const DataFrame& df) const {
 }
 
 Array_ptr CKDE::sample(int n, const DataFrame& evidence_values, unsigned int seed) const {
+    auto opencl_lock = OpenCLConfig::get(m_joint.opencl_device()).lock();
+
     if (n < 0) {
         throw std::invalid_argument("n should be a non-negative number");
     }
 
     check_fitted();
+    if (out_of_core())
+        throw std::invalid_argument("The training data of the CKDE does not fit in the OpenCL device, so it cannot be "
+                                    "sampled.");
+
     if (!this->evidence().empty()) {
         auto type = evidence_values.same_type(this->evidence());
 
@@ -120,7 +158,12 @@ Array_ptr CKDE::sample(int n, const DataFrame& evidence_values, unsigned int see
 }
 
 VectorXd CKDE::cdf(const DataFrame& df) const {
+    auto opencl_lock = OpenCLConfig::get(m_joint.opencl_device()).lock();
+
     check_fitted();
+    if (out_of_core())
+        throw std::invalid_argument("The training data of the CKDE does not fit in the OpenCL device, so its cdf "
+                                    "cannot be computed.");
     auto type = df.same_type(m_variables);
 
     if (type->id() != m_training_type->id()) {
@@ -137,6 +180,27 @@ VectorXd CKDE::cdf(const DataFrame& df) const {
     }
 }
 
+MatrixXd CKDE::logl_grid(const VectorXd& values, const DataFrame& evidence) const {
+    auto opencl_lock = OpenCLConfig::get(m_joint.opencl_device()).lock();
+
+    check_fitted();
+    if (!this->evidence().empty()) {
+        auto type = evidence.same_type(this->evidence());
+        if (type->id() != m_training_type->id()) {
+            throw std::invalid_argument("Data type of training and test datasets is different.");
+        }
+    }
+
+    switch (m_training_type->id()) {
+        case Type::DOUBLE:
+            return _logl_grid<arrow::DoubleType>(values, evidence);
+        case Type::FLOAT:
+            return _logl_grid<arrow::FloatType>(values, evidence);
+        default:
+            throw std::runtime_error("Unreachable code.");
+    }
+}
+
 std::string CKDE::ToString() const {
     std::stringstream stream;
     const auto& e = this->evidence();
@@ -161,6 +225,13 @@ std::string CKDE::ToString() const {
     }
 }
 
+util::MemoryUsage CKDE::memory_usage() const {
+    util::MemoryUsage usage;
+    usage.add("joint", m_joint.memory_usage());
+    usage.add("marg", m_marg.memory_usage());
+    return usage;
+}
+
 py::tuple CKDE::__getstate__() const {
     switch (m_training_type->id()) {
         case Type::DOUBLE:
@@ -173,45 +244,121 @@ py::tuple CKDE::__getstate__() const {
     }
 }
 
+void CKDE::restore_marginal() {
+    m_bselector = m_joint.bandwidth_type();
+    m_training_type = m_joint.data_type();
+    N = m_joint.num_instances();
+
+    if (this->evidence().empty()) return;
+
+    auto& joint_bandwidth = m_joint.bandwidth();
+    auto d = m_variables.size();
+    auto marg_bandwidth = joint_bandwidth.bottomRightCorner(d - 1, d - 1);
+    m_marg = KDE(this->evidence(), m_bselector, KDEBackend::OPENCL, relative_error());
+
+    if (auto mapped = m_joint.mapped_training()) {
+        // The training data of the evidence follows the column of the variable, so the marginal KDE also uses the
+        // memory-mapped file.
+        switch (m_training_type->id()) {
+            case Type::DOUBLE:
+                m_marg.fit_mapped<arrow::DoubleType>(marg_bandwidth,
+                                                     m_joint.mapped_storage(),
+                                                     static_cast<const double*>(mapped) + N,
+                                                     m_training_type,
+                                                     N);
+                break;
+            case Type::FLOAT:
+                m_marg.fit_mapped<arrow::FloatType>(marg_bandwidth,
+                                                    m_joint.mapped_storage(),
+                                                    static_cast<const float*>(mapped) + N,
+                                                    m_training_type,
+                                                    N);
+                break;
+            default:
+                throw std::invalid_argument("Wrong data type in CKDE.");
+        }
+
+        return;
+    }
+
+    if (m_joint.out_of_core()) {
+        switch (m_training_type->id()) {
+            case Type::DOUBLE: {
+                MatrixXd marg_training = m_joint.training_matrix<arrow::DoubleType>().rightCols(d - 1);
+                m_marg.fit_host<arrow::DoubleType>(marg_bandwidth, marg_training, m_training_type);
+                break;
+            }
+            case Type::FLOAT: {
+                MatrixXf marg_training = m_joint.training_matrix<arrow::FloatType>().rightCols(d - 1);
+                m_marg.fit_host<arrow::FloatType>(marg_bandwidth, marg_training, m_training_type);
+                break;
+            }
+            default:
+                throw std::invalid_argument("Wrong data type in CKDE.");
+        }
+
+        return;
+    }
+
+    cl::Buffer& training_buffer = m_joint.training_buffer();
+
+    auto& opencl = OpenCLConfig::get();
+
+    switch (m_training_type->id()) {
+        case Type::DOUBLE: {
+            auto marg_buffer = opencl.copy_buffer<double>(training_buffer, N, N * (d - 1));
+            m_marg.fit<arrow::DoubleType>(marg_bandwidth, marg_buffer, m_joint.data_type(), N);
+            break;
+        }
+        case Type::FLOAT: {
+            auto marg_buffer = opencl.copy_buffer<float>(training_buffer, N, N * (d - 1));
+            m_marg.fit<arrow::FloatType>(marg_bandwidth, marg_buffer, m_joint.data_type(), N);
+            break;
+        }
+        default:
+            throw std::invalid_argument("Wrong data type in CKDE.");
+    }
+}
+
 CKDE CKDE::__setstate__(py::tuple& t) {
-    if (t.size() != 4) throw std::runtime_error("Not valid CKDE.");
+    if (t.size() != 4 && t.size() != 5) throw std::runtime_error("Not valid CKDE.");
 
-    CKDE ckde(t[0].cast<std::string>(), t[1].cast<std::vector<std::string>>());
+    auto relative_error = (t.size() == 5) ? t[4].cast<double>() : 0.;
+    CKDE ckde(t[0].cast<std::string>(), t[1].cast<std::vector<std::string>>(), relative_error);
 
     ckde.m_fitted = t[2].cast<bool>();
 
     if (ckde.m_fitted) {
+        auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
         auto joint_tuple = t[3].cast<py::tuple>();
-        auto kde_joint = KDE::__setstate__(joint_tuple);
-        ckde.m_bselector = kde_joint.bandwidth_type();
-        ckde.m_training_type = kde_joint.data_type();
-        ckde.N = kde_joint.num_instances();
-        ckde.m_joint = std::move(kde_joint);
-
-        if (!ckde.evidence().empty()) {
-            auto& joint_bandwidth = ckde.m_joint.bandwidth();
-            auto d = ckde.m_variables.size();
-            auto marg_bandwidth = joint_bandwidth.bottomRightCorner(d - 1, d - 1);
-
-            cl::Buffer& training_buffer = ckde.m_joint.training_buffer();
-
-            auto& opencl = OpenCLConfig::get();
-
-            switch (ckde.m_training_type->id()) {
-                case Type::DOUBLE: {
-                    auto marg_buffer = opencl.copy_buffer<double>(training_buffer, ckde.N, ckde.N * (d - 1));
-                    ckde.m_marg.fit<arrow::DoubleType>(marg_bandwidth, marg_buffer, ckde.m_joint.data_type(), ckde.N);
-                    break;
-                }
-                case Type::FLOAT: {
-                    auto marg_buffer = opencl.copy_buffer<float>(training_buffer, ckde.N, ckde.N * (d - 1));
-                    ckde.m_marg.fit<arrow::FloatType>(marg_bandwidth, marg_buffer, ckde.m_joint.data_type(), ckde.N);
-                    break;
-                }
-                default:
-                    throw std::invalid_argument("Wrong data type in CKDE.");
-            }
-        }
+        ckde.m_joint = KDE::__setstate__(joint_tuple);
+        ckde.restore_marginal();
+    }
+
+    return ckde;
+}
+
+void CKDE::write_binary(util::BinaryWriter& writer) const {
+    writer.write(this->variable());
+    writer.write(this->evidence());
+    writer.write(m_fitted);
+    // The joint KDE of a CKDE not fitted is saved to keep its bandwidth selector and relative error.
+    m_joint.write_binary(writer);
+}
+
+CKDE CKDE::read_binary(util::BinaryReader& reader) {
+    auto variable = reader.read_string();
+    auto evidence = reader.read_strings();
+    auto fitted = reader.read_bool();
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+    auto joint = KDE::read_binary(reader);
+
+    CKDE ckde(variable, evidence, joint.bandwidth_type(), joint.relative_error());
+    ckde.m_fitted = fitted;
+    if (fitted) {
+        ckde.m_joint = std::move(joint);
+        ckde.restore_marginal();
     }
 
     return ckde;
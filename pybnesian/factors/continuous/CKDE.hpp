@@ -1,7 +1,7 @@
 #ifndef PYBNESIAN_FACTORS_CONTINUOUS_CKDE_HPP
 #define PYBNESIAN_FACTORS_CONTINUOUS_CKDE_HPP
 
-#include <random>
+#include <mutex>
 #include <pybind11/stl.h>
 #include <pybind11/eigen.h>
 #include <dataset/dataset.hpp>
@@ -18,8 +18,9 @@ namespace pyarrow = arrow::py;
 using dataset::DataFrame;
 using Eigen::VectorXd, Eigen::VectorXi;
 using factors::FactorType, factors::discrete::DiscreteAdaptator;
-using kde::KDE, kde::BandwidthSelector, kde::NormalReferenceRule, kde::UnivariateKDE, kde::MultivariateKDE;
-using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits;
+using kde::KDE, kde::KDEBackend, kde::BandwidthSelector, kde::NormalReferenceRule, kde::UnivariateKDE,
+    kde::MultivariateKDE;
+using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits, opencl::PooledBuffer;
 
 namespace factors::continuous {
 
@@ -64,9 +65,13 @@ public:
     using FactorTypeClass = CKDEType;
 
     CKDE() = default;
-    CKDE(std::string variable, std::vector<std::string> evidence)
-        : CKDE(variable, evidence, std::make_shared<NormalReferenceRule>()) {}
-    CKDE(std::string variable, std::vector<std::string> evidence, std::shared_ptr<BandwidthSelector> b_selector)
+    CKDE(std::string variable, std::vector<std::string> evidence, double relative_error = 0)
+        : CKDE(variable, evidence, std::make_shared<NormalReferenceRule>(), relative_error) {}
+    // If relative_error > 0, the joint and marginal KDEs approximate their logl (see KDE).
+    CKDE(std::string variable,
+         std::vector<std::string> evidence,
+         std::shared_ptr<BandwidthSelector> b_selector,
+         double relative_error = 0)
         : Factor(variable, evidence),
           m_variables(),
           m_fitted(false),
@@ -82,9 +87,10 @@ public:
             m_variables.push_back(*it);
         }
 
-        m_joint = KDE(m_variables, b_selector);
+        // The conditional KDE uses the OpenCL buffers of the joint and marginal KDEs.
+        m_joint = KDE(m_variables, b_selector, KDEBackend::OPENCL, relative_error);
         if (!this->evidence().empty()) {
-            m_marg = KDE(this->evidence(), b_selector);
+            m_marg = KDE(this->evidence(), b_selector, KDEBackend::OPENCL, relative_error);
         }
     }
 
@@ -115,15 +121,30 @@ public:
 
     std::shared_ptr<BandwidthSelector> bandwidth_type() const { return m_bselector; }
 
+    double relative_error() const { return m_joint.relative_error(); }
+    // If the training data does not fit in the OpenCL device, the joint and marginal KDEs stream it in blocks (see
+    // KDE::out_of_core()). Then, the logl is the difference of the logl of both KDEs, and the CKDE cannot be sampled
+    // nor compute its cdf.
+    bool out_of_core() const { return m_joint.out_of_core(); }
+
     void fit(const DataFrame& df) override;
+    // Fits the CKDE with df reusing previous, a CKDE of the same variable fitted with the same instances whose
+    // evidence has one variable more or less (see KDE::fit_incremental()).
+    void fit_incremental(const CKDE& previous, const DataFrame& df);
     VectorXd logl(const DataFrame& df) const override;
     double slogl(const DataFrame& df) const override;
+    // The memory of the joint and marginal KDEs (see KDE::memory_usage()).
+    util::MemoryUsage memory_usage() const override;
 
     Array_ptr sample(int n,
                      const DataFrame& evidence_values,
                      unsigned int seed = std::random_device{}()) const override;
 
     VectorXd cdf(const DataFrame& df) const;
+    // Returns the conditional logl of each value of the variable (the columns) given each row of evidence (the rows).
+    // The terms of the evidence in the joint kernels are computed once for all the values. The rows with null values
+    // are NaN. If the CKDE has no evidence, all the rows are the marginal logl of the values.
+    MatrixXd logl_grid(const VectorXd& values, const DataFrame& evidence) const;
 
     std::string ToString() const override;
 
@@ -131,12 +152,16 @@ public:
     static CKDE __setstate__(py::tuple& t);
     static CKDE __setstate__(py::tuple&& t) { return __setstate__(t); }
 
+    void write_binary(util::BinaryWriter& writer) const;
+    static CKDE read_binary(util::BinaryReader& reader);
+
 private:
     void check_fitted() const {
         if (!fitted()) throw std::invalid_argument("CKDE factor not fitted.");
     }
+    // If previous is not null, the joint KDE is fitted from the joint KDE of previous.
     template <typename ArrowType>
-    void _fit(const DataFrame& df);
+    void _fit(const DataFrame& df, const CKDE* previous = nullptr);
 
     template <typename ArrowType>
     VectorXd _logl(const DataFrame& df) const;
@@ -144,31 +169,60 @@ private:
     template <typename ArrowType>
     double _slogl(const DataFrame& df) const;
 
+    // Returns the conditional logl of the m rows of a column-major test matrix of m_variables in test_buffer.
     template <typename ArrowType>
-    Array_ptr _sample(int n, const DataFrame& evidence_values, unsigned int seed) const;
+    PooledBuffer logl_buffer(cl::Buffer& test_buffer, int m) const;
+    template <typename ArrowType>
+    PooledBuffer logl_buffer(const DataFrame& df, Buffer_ptr& bitmap) const;
+
+    // The joint and marginal logl can be computed in one pass if the bandwidth of the marginal KDE is the bandwidth
+    // of the evidence in the joint KDE.
+    bool fused_logl() const {
+        auto d = m_variables.size();
+        return m_joint.bandwidth().bottomRightCorner(d - 1, d - 1) == m_marg.bandwidth();
+    }
+    template <typename ArrowType>
+    PooledBuffer _logl_fused(cl::Buffer& test_buffer, int m) const;
+    // Returns the training data and the Cholesky factor of the joint bandwidth with the evidence before the variable.
+    template <typename ArrowType>
+    std::pair<cl::Buffer, cl::Buffer> fused_buffers() const;
 
+    // Returns the logl of the non-null rows of df, streaming the test data to the OpenCL device in chunks.
     template <typename ArrowType>
-    Array_ptr _sample_multivariate(int n, const DataFrame& evidence_values, unsigned int seed) const;
+    Matrix<typename ArrowType::c_type, Dynamic, 1> logl_pipelined(const DataFrame& df) const;
+
+    template <typename ArrowType>
+    Array_ptr _sample(int n, const DataFrame& evidence_values, unsigned int seed) const;
 
     template <typename ArrowType>
-    VectorXi _sample_indices_multivariate(Matrix<typename ArrowType::c_type, Dynamic, 1>& random_prob,
-                                          const DataFrame& evidence_values,
-                                          int n) const;
+    PooledBuffer _sample_multivariate(int n, const DataFrame& evidence_values, unsigned int seed) const;
 
     template <typename ArrowType, typename KDEType>
-    cl::Buffer _sample_indices_from_weights(cl::Buffer& random_prob, cl::Buffer& test_buffer, int n) const;
+    PooledBuffer _sample_indices_from_weights(cl::Buffer& random_prob, cl::Buffer& test_buffer, int n) const;
 
     template <typename ArrowType>
     VectorXd _cdf(const DataFrame& df) const;
 
     template <typename ArrowType>
-    cl::Buffer _cdf_univariate(cl::Buffer& test_buffer, int m) const;
+    MatrixXd _logl_grid(const VectorXd& values, const DataFrame& evidence) const;
+    // Evaluates the logl of the m rows of the evidence matrix (m x evidence().size(), column-major) in the device.
+    template <typename ArrowType>
+    MatrixXd logl_grid_device(const VectorXd& values,
+                              const Matrix<typename ArrowType::c_type, Dynamic, Dynamic>& x) const;
+    // Evaluates the logl of the Cartesian product of values and the evidence rows with _logl().
+    template <typename ArrowType>
+    MatrixXd logl_grid_cartesian(const VectorXd& values, const DataFrame& evidence) const;
+
+    template <typename ArrowType>
+    PooledBuffer _cdf_univariate(cl::Buffer& test_buffer, int m) const;
 
     template <typename ArrowType, typename KDEType>
-    cl::Buffer _cdf_multivariate(cl::Buffer& variable_test_buffer, cl::Buffer& evidence_test_buffer, int m) const;
+    PooledBuffer _cdf_multivariate(cl::Buffer& variable_test_buffer, cl::Buffer& evidence_test_buffer, int m) const;
 
     template <typename ArrowType>
     py::tuple __getstate__() const;
+    // Sets the data type and the marginal KDE of a fitted CKDE once m_joint is restored.
+    void restore_marginal();
 
     std::vector<std::string> m_variables;
     bool m_fitted;
@@ -177,18 +231,38 @@ private:
     size_t N;
     KDE m_joint;
     KDE m_marg;
+    // The buffers of the one pass logl. They are created when they are first needed, and shared by the copies of the
+    // CKDE fitted with the same data.
+    struct FusedBuffers {
+        std::mutex mutex;
+        MatrixXd bandwidth;
+        cl::Buffer training;
+        cl::Buffer cholesky;
+    };
+    std::shared_ptr<FusedBuffers> m_fused_buffers = std::make_shared<FusedBuffers>();
 };
 
 template <typename ArrowType>
-void CKDE::_fit(const DataFrame& df) {
-    m_joint.fit(df);
+void CKDE::_fit(const DataFrame& df, const CKDE* previous) {
+    if (previous)
+        m_joint.fit_incremental(previous->m_joint, df);
+    else
+        m_joint.fit(df);
     N = m_joint.num_instances();
+    m_fused_buffers = std::make_shared<FusedBuffers>();
 
     if (!this->evidence().empty()) {
         auto& joint_bandwidth = m_joint.bandwidth();
         auto d = m_variables.size();
         auto marg_bandwidth = joint_bandwidth.bottomRightCorner(d - 1, d - 1);
 
+        if (out_of_core()) {
+            // The training data of the evidence follows the column of the variable.
+            kde::CPUMatrix<ArrowType> marg_training = m_joint.training_matrix<ArrowType>().rightCols(d - 1);
+            m_marg.fit_host<ArrowType>(marg_bandwidth, marg_training, m_joint.data_type());
+            return;
+        }
+
         cl::Buffer& training_buffer = m_joint.training_buffer();
 
         auto& opencl = OpenCLConfig::get();
@@ -204,48 +278,34 @@ VectorXd CKDE::_logl(const DataFrame& df) const {
     using CType = typename ArrowType::c_type;
     using VectorType = Matrix<CType, Dynamic, 1>;
 
-    auto logl_joint = m_joint.logl_buffer<ArrowType>(df);
+    // The approximate logl of the KDEs is computed in the host, and the out of core KDEs stream their training data.
+    if (relative_error() > 0 || out_of_core()) {
+        auto logl = m_joint.logl(df);
+        if (!this->evidence().empty()) logl -= m_marg.logl(df);
+        return logl;
+    }
 
     auto combined_bitmap = df.combined_bitmap(m_variables);
     auto m = df->num_rows();
     if (combined_bitmap) m = util::bit_util::non_null_count(combined_bitmap, df->num_rows());
 
-    auto& opencl = OpenCLConfig::get();
-    if (!this->evidence().empty()) {
-        cl::Buffer logl_marg;
-        if (combined_bitmap)
-            logl_marg = m_marg.logl_buffer<ArrowType>(df, combined_bitmap);
-        else
-            logl_marg = m_marg.logl_buffer<ArrowType>(df);
-
-        auto& k_substract = opencl.kernel(OpenCL_kernel_traits<ArrowType>::substract_vectors);
-        k_substract.setArg(0, logl_joint);
-        k_substract.setArg(1, logl_marg);
-        auto& queue = opencl.queue();
-        RAISE_ENQUEUEKERNEL_ERROR(
-            queue.enqueueNDRangeKernel(k_substract, cl::NullRange, cl::NDRange(m), cl::NullRange));
+    VectorType read_data;
+    if (m > OpenCLConfig::pipeline_rows()) {
+        read_data = logl_pipelined<ArrowType>(df);
+    } else {
+        auto logl = logl_buffer<ArrowType>(df, combined_bitmap);
+        read_data.resize(m);
+        OpenCLConfig::get().read_from_buffer(read_data.data(), logl, m);
     }
 
     if (combined_bitmap) {
-        VectorType read_data(m);
         auto bitmap_data = combined_bitmap->data();
 
-        opencl.read_from_buffer(read_data.data(), logl_joint, m);
-
         VectorXd res(df->num_rows());
-
-        for (int i = 0, k = 0; i < df->num_rows(); ++i) {
-            if (util::bit_util::GetBit(bitmap_data, i)) {
-                res(i) = static_cast<double>(read_data[k++]);
-            } else {
-                res(i) = util::nan<double>;
-            }
-        }
+        util::bit_util::expand(bitmap_data, df->num_rows(), read_data.data(), util::nan<double>, res.data());
 
         return res;
     } else {
-        VectorType read_data(df->num_rows());
-        opencl.read_from_buffer(read_data.data(), logl_joint, df->num_rows());
         if constexpr (!std::is_same_v<CType, double>)
             return read_data.template cast<double>();
         else
@@ -254,187 +314,465 @@ VectorXd CKDE::_logl(const DataFrame& df) const {
 }
 
 template <typename ArrowType>
-double CKDE::_slogl(const DataFrame& df) const {
+Matrix<typename ArrowType::c_type, Dynamic, 1> CKDE::logl_pipelined(const DataFrame& df) const {
     using CType = typename ArrowType::c_type;
 
-    auto logl_joint = m_joint.logl_buffer<ArrowType>(df);
+    auto test_matrix = df.to_eigen<false, ArrowType>(m_variables);
+    auto m = test_matrix->rows();
 
-    auto combined_bitmap = df.combined_bitmap(m_variables);
-    auto m = df->num_rows();
-    if (combined_bitmap) m = util::bit_util::non_null_count(combined_bitmap, df->num_rows());
+    Matrix<CType, Dynamic, 1> res(m);
+    OpenCLConfig::multi_device_rows(
+        test_matrix->data(),
+        m,
+        m_variables.size(),
+        // The chunk can be evaluated by any device of the pool.
+        [this](cl::Buffer& test_buffer, int rows) { return logl_buffer<ArrowType>(test_buffer, rows); },
+        res.data());
+    return res;
+}
 
+template <typename ArrowType>
+PooledBuffer CKDE::logl_buffer(const DataFrame& df, Buffer_ptr& bitmap) const {
     auto& opencl = OpenCLConfig::get();
-    if (!this->evidence().empty()) {
-        cl::Buffer logl_marg;
-        if (combined_bitmap)
-            logl_marg = m_marg.logl_buffer<ArrowType>(df, combined_bitmap);
-        else
-            logl_marg = m_marg.logl_buffer<ArrowType>(df);
 
-        auto& k_substract = opencl.kernel(OpenCL_kernel_traits<ArrowType>::substract_vectors);
-        k_substract.setArg(0, logl_joint);
-        k_substract.setArg(1, logl_marg);
-        auto& queue = opencl.queue();
-        RAISE_ENQUEUEKERNEL_ERROR(
-            queue.enqueueNDRangeKernel(k_substract, cl::NullRange, cl::NDRange(m), cl::NullRange));
-    }
+    std::unique_ptr<Matrix<typename ArrowType::c_type, Dynamic, Dynamic>> test_matrix;
+    if (bitmap)
+        test_matrix = df.to_eigen<false, ArrowType>(bitmap, m_variables);
+    else
+        test_matrix = df.to_eigen<false, ArrowType>(m_variables);
+    auto m = test_matrix->rows();
+    auto test_buffer = opencl.copy_to_temp_buffer(test_matrix->data(), m * m_variables.size());
 
-    auto buffer_sum = opencl.sum1d<ArrowType>(logl_joint, m);
+    return logl_buffer<ArrowType>(test_buffer, m);
+}
 
-    CType result = 0;
-    opencl.read_from_buffer(&result, buffer_sum, 1);
-    return static_cast<double>(result);
+template <typename ArrowType>
+PooledBuffer CKDE::logl_buffer(cl::Buffer& test_buffer, int m) const {
+    using CType = typename ArrowType::c_type;
+
+    if (this->evidence().empty()) return m_joint.logl_buffer<ArrowType>(test_buffer, m);
+
+    // The mixed precision logl keeps evaluating each KDE on its own.
+    bool mixed_precision = std::is_same_v<ArrowType, arrow::DoubleType> && OpenCLConfig::mixed_precision();
+    if (!mixed_precision && fused_logl()) return _logl_fused<ArrowType>(test_buffer, m);
+
+    auto& opencl = OpenCLConfig::get();
+    auto logl_joint = m_joint.logl_buffer<ArrowType>(test_buffer, m);
+
+    // The evidence columns are after the first column of the test matrix.
+    auto evidence_buffer = opencl.copy_temp_buffer<CType>(test_buffer, m, m * this->evidence().size());
+    auto logl_marg = m_marg.logl_buffer<ArrowType>(evidence_buffer, m);
+
+    auto& k_substract = opencl.kernel(OpenCL_kernel_traits<ArrowType>::substract_vectors);
+    k_substract.setArg(0, logl_joint);
+    k_substract.setArg(1, logl_marg);
+    RAISE_ENQUEUEKERNEL_ERROR(
+        opencl.queue().enqueueNDRangeKernel(k_substract, cl::NullRange, cl::NDRange(m), cl::NullRange));
+
+    return logl_joint;
 }
 
 template <typename ArrowType>
-Array_ptr CKDE::_sample(int n, const DataFrame& evidence_values, unsigned int seed) const {
+std::pair<cl::Buffer, cl::Buffer> CKDE::fused_buffers() const {
     using CType = typename ArrowType::c_type;
-    using VectorType = Matrix<CType, Dynamic, 1>;
+    using MatrixType = Matrix<CType, Dynamic, Dynamic>;
 
-    if (this->evidence().empty()) {
-        arrow::NumericBuilder<ArrowType> builder;
-        RAISE_STATUS_ERROR(builder.Resize(n));
-        std::mt19937 rng{seed};
-        std::uniform_int_distribution<> uniform(0, N - 1);
-
-        std::normal_distribution<CType> normal(0, std::sqrt(m_joint.bandwidth()(0, 0)));
-        VectorType training_data(N);
-        const auto& training_buffer = m_joint.training_buffer();
-        auto& opencl = OpenCLConfig::get();
-        opencl.read_from_buffer(training_data.data(), training_buffer, N);
+    // The buffers can be requested at the same time by the devices of OpenCLConfig::multi_device_rows().
+    std::lock_guard<std::mutex> l(m_fused_buffers->mutex);
+
+    auto& opencl = OpenCLConfig::get();
+    auto d = m_variables.size();
 
-        for (auto i = 0; i < n; ++i) {
-            auto index = uniform(rng);
-            builder.UnsafeAppend(training_data(index) + normal(rng));
+    if (m_fused_buffers->training() == nullptr) {
+        auto training = opencl.new_buffer<CType>(N * d);
+        opencl.copy_buffer_region<CType>(m_joint.training_buffer(), N, training, 0, N * (d - 1));
+        opencl.copy_buffer_region<CType>(m_joint.training_buffer(), 0, training, N * (d - 1), N);
+        m_fused_buffers->training = training;
+    }
+
+    // The bandwidth of the joint KDE can be modified after fitting the CKDE.
+    const auto& bandwidth = m_joint.bandwidth();
+    if (m_fused_buffers->cholesky() == nullptr || m_fused_buffers->bandwidth != bandwidth) {
+        MatrixXd permuted(d, d);
+        for (size_t i = 0; i < d; ++i) {
+            for (size_t j = 0; j < d; ++j) {
+                permuted(i, j) = bandwidth((i + 1) % d, (j + 1) % d);
+            }
         }
 
-        Array_ptr out;
-        RAISE_STATUS_ERROR(builder.Finish(&out));
-        return out;
-    } else {
-        return _sample_multivariate<ArrowType>(n, evidence_values, seed);
+        MatrixType cholesky = permuted.llt().matrixLLT().template cast<CType>();
+        m_fused_buffers->cholesky = opencl.copy_to_buffer(cholesky.data(), d * d);
+        m_fused_buffers->bandwidth = bandwidth;
     }
+
+    // The buffers can be used by the queues of other devices.
+    opencl.queue().finish();
+
+    return std::make_pair(m_fused_buffers->training, m_fused_buffers->cholesky);
 }
 
+// With the evidence before the variable, the Cholesky factor of the marginal bandwidth is the top-left block of the
+// Cholesky factor of the joint bandwidth. Thus, the differences between the test and training instances are
+// substracted and solved once for both KDEs, and only the log-sum-exp is computed for each of them.
 template <typename ArrowType>
-Array_ptr CKDE::_sample_multivariate(int n, const DataFrame& evidence_values, unsigned int seed) const {
+PooledBuffer CKDE::_logl_fused(cl::Buffer& test_buffer, int m) const {
     using CType = typename ArrowType::c_type;
-    using ArrowArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
-    using VectorType = Matrix<CType, Dynamic, 1>;
-    using MatrixType = Matrix<CType, Dynamic, Dynamic>;
+    auto d = m_variables.size();
+    auto& opencl = OpenCLConfig::get();
+    auto [training, cholesky] = fused_buffers<ArrowType>();
+
+    auto test_permuted = opencl.temp_buffer<CType>(m * d);
+    opencl.copy_buffer_region<CType>(test_buffer, m, test_permuted, 0, m * (d - 1));
+    opencl.copy_buffer_region<CType>(test_buffer, 0, test_permuted, m * (d - 1), m);
+
+    auto res_joint = opencl.temp_buffer<CType>(m);
+    auto res_marg = opencl.temp_buffer<CType>(m);
+
+    // Each test instance uses a column of the joint and marginal logl matrices, and a row of the temporary matrix.
+    auto allocated_m = opencl.temp_mat_cols(N, m, N + d, sizeof(CType));
+    auto joint_logls = opencl.temp_buffer<CType>(N * allocated_m);
+    auto marg_logls = opencl.temp_buffer<CType>(N * allocated_m);
+    auto tmp_mat_buffer = opencl.temp_buffer<CType>(std::max(N, allocated_m) * d);
+
+    auto joint_lognorm = static_cast<CType>(m_joint.lognorm_const());
+    auto marg_lognorm = static_cast<CType>(m_marg.lognorm_const());
+
+    for (auto offset = 0; offset < m; offset += allocated_m) {
+        auto length = std::min(static_cast<int>(allocated_m), m - offset);
+        MultivariateKDE::execute_conditional_logl_mat<ArrowType>(training,
+                                                                 N,
+                                                                 test_permuted,
+                                                                 m,
+                                                                 offset,
+                                                                 length,
+                                                                 d,
+                                                                 cholesky,
+                                                                 joint_lognorm,
+                                                                 marg_lognorm,
+                                                                 tmp_mat_buffer,
+                                                                 joint_logls,
+                                                                 marg_logls);
+        opencl.logsumexp_cols_offset<ArrowType>(joint_logls, N, length, res_joint, offset);
+        opencl.logsumexp_cols_offset<ArrowType>(marg_logls, N, length, res_marg, offset);
+    }
 
-    const auto& e = this->evidence();
+    auto& k_substract = opencl.kernel(OpenCL_kernel_traits<ArrowType>::substract_vectors);
+    k_substract.setArg(0, res_joint);
+    k_substract.setArg(1, res_marg);
+    RAISE_ENQUEUEKERNEL_ERROR(
+        opencl.queue().enqueueNDRangeKernel(k_substract, cl::NullRange, cl::NDRange(m), cl::NullRange));
 
-    if (!evidence_values.has_columns(e)) throw std::domain_error("Evidence values not present for sampling.");
+    return res_joint;
+}
+
+template <typename ArrowType>
+MatrixXd CKDE::_logl_grid(const VectorXd& values, const DataFrame& evidence) const {
+    using CType = typename ArrowType::c_type;
+
+    // The approximate logl of the KDEs is computed in the host, and the mixed precision and out of core KDEs are
+    // evaluated on their own.
+    bool mixed_precision = std::is_same_v<ArrowType, arrow::DoubleType> && OpenCLConfig::mixed_precision();
+    if (this->evidence().empty() || relative_error() > 0 || mixed_precision || out_of_core())
+        return logl_grid_cartesian<ArrowType>(values, evidence);
 
-    VectorType random_prob(n);
-    std::mt19937 rng{seed};
-    std::uniform_real_distribution<CType> uniform(0, 1);
-    for (auto i = 0; i < n; ++i) {
-        random_prob(i) = uniform(rng);
+    auto combined_bitmap = evidence.combined_bitmap(this->evidence());
+    std::unique_ptr<Matrix<CType, Dynamic, Dynamic>> x;
+    if (combined_bitmap)
+        x = evidence.to_eigen<false, ArrowType>(combined_bitmap, this->evidence());
+    else
+        x = evidence.to_eigen<false, ArrowType>(this->evidence());
+
+    auto valid = logl_grid_device<ArrowType>(values, *x);
+    if (!combined_bitmap) return valid;
+
+    auto bitmap_data = combined_bitmap->data();
+    MatrixXd res(evidence->num_rows(), values.rows());
+    for (Eigen::Index c = 0; c < res.cols(); ++c) {
+        util::bit_util::expand(
+            bitmap_data, evidence->num_rows(), valid.col(c).data(), util::nan<double>, res.col(c).data());
     }
 
-    VectorXi sample_indices = _sample_indices_multivariate<ArrowType>(random_prob, evidence_values, n);
+    return res;
+}
+
+// With the evidence before the variable and the variable of the test instance set to 0, the solved difference of the
+// variable for a value y is the solved difference for 0 plus y / L(d-1, d-1), where L is the Cholesky factor of the
+// joint bandwidth. Thus, the differences with the training instances are substracted and solved once for each evidence
+// row, and the conditional_logl_grid kernel evaluates the joint kernels of all the values from them.
+template <typename ArrowType>
+MatrixXd CKDE::logl_grid_device(const VectorXd& values,
+                                const Matrix<typename ArrowType::c_type, Dynamic, Dynamic>& x) const {
+    using CType = typename ArrowType::c_type;
+    using MatrixType = Matrix<CType, Dynamic, Dynamic>;
+
+    auto d = m_variables.size();
+    int m = x.rows();
+    int num_values = values.rows();
+    if (m == 0 || num_values == 0) return MatrixXd(m, num_values);
+
+    auto& opencl = OpenCLConfig::get();
+    auto [training, cholesky] = fused_buffers<ArrowType>();
 
+    MatrixType test = MatrixType::Zero(m, d);
+    test.leftCols(d - 1) = x;
+    auto test_buffer = opencl.copy_to_temp_buffer(test.data(), m * d);
+
+    Matrix<CType, Dynamic, 1> casted_values = values.template cast<CType>();
+    auto values_buffer = opencl.copy_to_temp_buffer(casted_values.data(), num_values);
+
+    // L(d-1, d-1)^2 is the variance of the variable given the evidence in the joint bandwidth.
     const auto& bandwidth = m_joint.bandwidth();
-    const auto& marg_bandwidth = m_marg.bandwidth();
+    auto marg_bandwidth = bandwidth.bottomRightCorner(d - 1, d - 1);
+    VectorXd cross = bandwidth.col(0).tail(d - 1);
+    double conditional_variance = bandwidth(0, 0) - cross.dot(marg_bandwidth.llt().solve(cross));
+    auto inverse_diagonal = static_cast<CType>(1 / std::sqrt(conditional_variance));
+    auto joint_lognorm = static_cast<CType>(m_joint.lognorm_const());
+
+    auto allocated_values = opencl.temp_mat_cols(N, num_values, d, sizeof(CType));
+    auto joint_logls = opencl.temp_buffer<CType>(N * allocated_values);
+    auto diff_buffer = opencl.temp_buffer<CType>(N * d);
+    auto res_joint = opencl.temp_buffer<CType>(m * num_values);
+
+    auto& k_substract = opencl.kernel(OpenCL_kernel_traits<ArrowType>::substract);
+    k_substract.setArg(0, training);
+    k_substract.setArg(1, static_cast<unsigned int>(N));
+    k_substract.setArg(2, 0u);
+    k_substract.setArg(3, static_cast<unsigned int>(N));
+    k_substract.setArg(4, test_buffer);
+    k_substract.setArg(5, static_cast<unsigned int>(m));
+    k_substract.setArg(6, 0u);
+    k_substract.setArg(8, diff_buffer);
+
+    auto& k_solve = opencl.kernel(OpenCL_kernel_traits<ArrowType>::solve);
+    k_solve.setArg(0, diff_buffer);
+    k_solve.setArg(1, static_cast<unsigned int>(N));
+    k_solve.setArg(2, static_cast<unsigned int>(d));
+    k_solve.setArg(3, cholesky);
+
+    auto& k_grid = opencl.kernel(OpenCL_kernel_traits<ArrowType>::conditional_logl_grid);
+    k_grid.setArg(0, diff_buffer);
+    k_grid.setArg(1, static_cast<unsigned int>(d));
+    k_grid.setArg(2, values_buffer);
+    k_grid.setArg(5, inverse_diagonal);
+    k_grid.setArg(6, joint_lognorm);
+    k_grid.setArg(7, joint_logls);
+
+    auto& queue = opencl.queue();
+    for (int i = 0; i < m; ++i) {
+        k_substract.setArg(7, static_cast<unsigned int>(i));
+        RAISE_ENQUEUEKERNEL_ERROR(
+            queue.enqueueNDRangeKernel(k_substract, cl::NullRange, cl::NDRange(N * d), cl::NullRange));
+        RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(k_solve, cl::NullRange, cl::NDRange(N), cl::NullRange));
+
+        for (int offset = 0; offset < num_values; offset += allocated_values) {
+            auto length = std::min(static_cast<int>(allocated_values), num_values - offset);
+            k_grid.setArg(3, static_cast<unsigned int>(offset));
+            k_grid.setArg(4, static_cast<unsigned int>(length));
+            RAISE_ENQUEUEKERNEL_ERROR(
+                queue.enqueueNDRangeKernel(k_grid, cl::NullRange, cl::NDRange(N), cl::NullRange));
+            opencl.logsumexp_cols_offset<ArrowType>(joint_logls, N, length, res_joint, i * num_values + offset);
+        }
+    }
 
-    auto cholesky = marg_bandwidth.llt();
-    auto matrixL = cholesky.matrixL();
+    auto evidence_buffer = opencl.copy_to_temp_buffer(x.data(), m * (d - 1));
+    auto logl_marg = m_marg.logl_buffer<ArrowType>(evidence_buffer, m);
 
-    auto d = e.size();
-    MatrixXd inverseL = MatrixXd::Identity(d, d);
+    // The values of each evidence row are contiguous.
+    MatrixType joint(num_values, m);
+    opencl.read_from_buffer(joint.data(), res_joint, m * num_values);
+    Matrix<CType, Dynamic, 1> marg(m);
+    opencl.read_from_buffer(marg.data(), logl_marg, m);
 
-    // Solves and saves the result in inverseL
-    matrixL.solveInPlace(inverseL);
-    auto R = inverseL * bandwidth.bottomLeftCorner(d, 1);
-    auto cond_var = bandwidth(0, 0) - R.squaredNorm();
-    auto transform = (R.transpose() * inverseL).transpose().template cast<CType>();
+    MatrixXd res = joint.transpose().template cast<double>();
+    res.colwise() -= marg.template cast<double>();
+    return res;
+}
 
-    MatrixType training_dataset(N, m_variables.size());
-    auto& opencl = OpenCLConfig::get();
-    opencl.read_from_buffer(training_dataset.data(), m_joint.training_buffer(), N * m_variables.size());
+template <typename ArrowType>
+MatrixXd CKDE::logl_grid_cartesian(const VectorXd& values, const DataFrame& evidence) const {
+    using CType = typename ArrowType::c_type;
+    using BuilderType = typename arrow::TypeTraits<ArrowType>::BuilderType;
+
+    int num_values = values.rows();
+    // Without evidence, the logl of the values is the same for all the rows.
+    int m = this->evidence().empty() ? 1 : evidence->num_rows();
+
+    arrow::NumericBuilder<arrow::Int32Type> indices_builder;
+    BuilderType values_builder;
+    RAISE_STATUS_ERROR(indices_builder.Reserve(m * num_values));
+    RAISE_STATUS_ERROR(values_builder.Reserve(m * num_values));
+    for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < num_values; ++j) {
+            indices_builder.UnsafeAppend(i);
+            values_builder.UnsafeAppend(static_cast<CType>(values(j)));
+        }
+    }
 
-    MatrixType evidence_substract(n, e.size());
-    for (size_t j = 0; j < e.size(); ++j) {
-        auto evidence = evidence_values->GetColumnByName(e[j]);
-        auto dwn_evidence = std::static_pointer_cast<ArrowArrayType>(evidence);
-        auto raw_values = dwn_evidence->raw_values();
-        for (auto i = 0; i < n; ++i) {
-            evidence_substract(i, j) = raw_values[i] - training_dataset(sample_indices(i), j + 1);
+    Array_ptr indices, values_array;
+    RAISE_STATUS_ERROR(indices_builder.Finish(&indices));
+    RAISE_STATUS_ERROR(values_builder.Finish(&values_array));
+
+    DataFrame cartesian(m * num_values);
+    if (!this->evidence().empty()) cartesian = evidence.loc(this->evidence()).take(indices);
+    RAISE_RESULT_ERROR(auto batch, cartesian->AddColumn(0, this->variable(), values_array))
+
+    VectorXd logl = _logl<ArrowType>(DataFrame(std::move(batch)));
+    MatrixXd res = Eigen::Map<MatrixXd>(logl.data(), num_values, m).transpose();
+    if (this->evidence().empty()) return res.replicate(evidence->num_rows(), 1);
+    return res;
+}
+
+template <typename ArrowType>
+double CKDE::_slogl(const DataFrame& df) const {
+    using CType = typename ArrowType::c_type;
+
+    if (relative_error() > 0 || out_of_core()) {
+        auto logl = _logl<ArrowType>(df);
+        double result = 0;
+        for (auto i = 0; i < logl.rows(); ++i) {
+            if (!std::isnan(logl(i))) result += logl(i);
         }
+        return result;
     }
 
-    auto cond_mean = (evidence_substract * transform).eval();
+    auto combined_bitmap = df.combined_bitmap(m_variables);
+    auto m = df->num_rows();
+    if (combined_bitmap) m = util::bit_util::non_null_count(combined_bitmap, df->num_rows());
 
-    std::normal_distribution<CType> normal(0, std::sqrt(cond_var));
-    arrow::NumericBuilder<ArrowType> builder;
-    RAISE_STATUS_ERROR(builder.Resize(n));
+    if (m > OpenCLConfig::pipeline_rows()) return logl_pipelined<ArrowType>(df).template cast<double>().sum();
+
+    auto logl = logl_buffer<ArrowType>(df, combined_bitmap);
+
+    auto& opencl = OpenCLConfig::get();
+    auto buffer_sum = opencl.sum1d<ArrowType>(logl, m);
+
+    CType result = 0;
+    opencl.read_from_buffer(&result, buffer_sum, 1);
+    return static_cast<double>(result);
+}
+
+// The whole sampling runs in the OpenCL device, drawing the random numbers with a counter-based generator (see
+// philox_random in KDE.cl.src). Only the sampled values are read back.
+template <typename ArrowType>
+Array_ptr CKDE::_sample(int n, const DataFrame& evidence_values, unsigned int seed) const {
+    using CType = typename ArrowType::c_type;
+    using VectorType = Matrix<CType, Dynamic, 1>;
+
+    VectorType sampled(n);
+    if (n > 0) {
+        auto& opencl = OpenCLConfig::get();
+        PooledBuffer res;
+        if (this->evidence().empty()) {
+            res = opencl.temp_buffer<CType>(n);
+            auto& k_sample = opencl.kernel(OpenCL_kernel_traits<ArrowType>::sample_kde_1d);
+            k_sample.setArg(0, m_joint.training_buffer());
+            k_sample.setArg(1, static_cast<unsigned int>(N));
+            k_sample.setArg(2, static_cast<CType>(std::sqrt(m_joint.bandwidth()(0, 0))));
+            k_sample.setArg(3, seed);
+            k_sample.setArg(4, res);
+            RAISE_ENQUEUEKERNEL_ERROR(
+                opencl.queue().enqueueNDRangeKernel(k_sample, cl::NullRange, cl::NDRange(n), cl::NullRange));
+        } else {
+            res = _sample_multivariate<ArrowType>(n, evidence_values, seed);
+        }
 
-    for (auto i = 0; i < n; ++i) {
-        cond_mean(i) += training_dataset(sample_indices(i), 0) + normal(rng);
+        opencl.read_from_buffer(sampled.data(), res, n);
     }
 
-    RAISE_STATUS_ERROR(builder.AppendValues(cond_mean.data(), n));
+    arrow::NumericBuilder<ArrowType> builder;
+    RAISE_STATUS_ERROR(builder.AppendValues(sampled.data(), n));
 
     Array_ptr out;
     RAISE_STATUS_ERROR(builder.Finish(&out));
-
     return out;
 }
 
 template <typename ArrowType>
-VectorXi CKDE::_sample_indices_multivariate(Matrix<typename ArrowType::c_type, Dynamic, 1>& random_prob,
-                                            const DataFrame& evidence_values,
-                                            int n) const {
+PooledBuffer CKDE::_sample_multivariate(int n, const DataFrame& evidence_values, unsigned int seed) const {
     using CType = typename ArrowType::c_type;
-    using ArrowArray = typename arrow::TypeTraits<ArrowType>::ArrayType;
+    using ArrowArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+    using VectorType = Matrix<CType, Dynamic, 1>;
     using MatrixType = Matrix<CType, Dynamic, Dynamic>;
 
     const auto& e = this->evidence();
-    MatrixType test_matrix(n, e.size());
-
-    for (size_t i = 0; i < e.size(); ++i) {
-        auto evidence = evidence_values->GetColumnByName(e[i]);
 
-        auto dwn_evidence = std::static_pointer_cast<ArrowArray>(evidence);
-        auto raw_evidence = dwn_evidence->raw_values();
+    if (!evidence_values.has_columns(e)) throw std::domain_error("Evidence values not present for sampling.");
 
-        std::memcpy(test_matrix.data() + i * n, raw_evidence, sizeof(CType) * n);
+    MatrixType evidence_matrix(n, e.size());
+    for (size_t j = 0; j < e.size(); ++j) {
+        auto evidence = evidence_values->GetColumnByName(e[j]);
+        auto dwn_evidence = std::static_pointer_cast<ArrowArrayType>(evidence);
+        std::memcpy(evidence_matrix.data() + j * n, dwn_evidence->raw_values(), sizeof(CType) * n);
     }
 
     auto& opencl = OpenCLConfig::get();
-    auto test_buffer = opencl.copy_to_buffer(test_matrix.data(), n * e.size());
-    auto buff_random_prob = opencl.copy_to_buffer(random_prob.data(), n);
+    auto evidence_buffer = opencl.copy_to_temp_buffer(evidence_matrix.data(), n * e.size());
+
+    auto random_prob = opencl.temp_buffer<CType>(n);
+    auto& k_random_uniform = opencl.kernel(OpenCL_kernel_traits<ArrowType>::random_uniform);
+    k_random_uniform.setArg(0, seed);
+    k_random_uniform.setArg(1, random_prob);
+    RAISE_ENQUEUEKERNEL_ERROR(
+        opencl.queue().enqueueNDRangeKernel(k_random_uniform, cl::NullRange, cl::NDRange(n), cl::NullRange));
 
-    cl::Buffer indices_buffer;
+    PooledBuffer sample_indices;
     if (e.size() == 1)
-        indices_buffer = _sample_indices_from_weights<ArrowType, UnivariateKDE>(buff_random_prob, test_buffer, n);
+        sample_indices = _sample_indices_from_weights<ArrowType, UnivariateKDE>(random_prob, evidence_buffer, n);
     else
-        indices_buffer = _sample_indices_from_weights<ArrowType, MultivariateKDE>(buff_random_prob, test_buffer, n);
+        sample_indices = _sample_indices_from_weights<ArrowType, MultivariateKDE>(random_prob, evidence_buffer, n);
+
+    const auto& bandwidth = m_joint.bandwidth();
+    const auto& marg_bandwidth = m_marg.bandwidth();
+
+    auto cholesky = marg_bandwidth.llt();
+    auto matrixL = cholesky.matrixL();
+
+    auto d = e.size();
+    MatrixXd inverseL = MatrixXd::Identity(d, d);
+
+    // Solves and saves the result in inverseL
+    matrixL.solveInPlace(inverseL);
+    auto R = inverseL * bandwidth.bottomLeftCorner(d, 1);
+    auto cond_var = bandwidth(0, 0) - R.squaredNorm();
+    VectorType transform = (R.transpose() * inverseL).transpose().template cast<CType>();
+    auto transform_buffer = opencl.copy_to_temp_buffer(transform.data(), d);
+
+    auto res = opencl.temp_buffer<CType>(n);
+    auto& k_sample = opencl.kernel(OpenCL_kernel_traits<ArrowType>::sample_ckde);
+    k_sample.setArg(0, m_joint.training_buffer());
+    k_sample.setArg(1, static_cast<unsigned int>(N));
+    k_sample.setArg(2, evidence_buffer);
+    k_sample.setArg(3, static_cast<unsigned int>(n));
+    k_sample.setArg(4, static_cast<unsigned int>(d));
+    k_sample.setArg(5, sample_indices);
+    k_sample.setArg(6, transform_buffer);
+    k_sample.setArg(7, static_cast<CType>(std::sqrt(cond_var)));
+    k_sample.setArg(8, seed);
+    k_sample.setArg(9, res);
+    RAISE_ENQUEUEKERNEL_ERROR(
+        opencl.queue().enqueueNDRangeKernel(k_sample, cl::NullRange, cl::NDRange(n), cl::NullRange));
 
-    VectorXi res(n);
-    opencl.read_from_buffer(res.data(), indices_buffer, n);
     return res;
 }
 
 template <typename ArrowType, typename KDEType>
-cl::Buffer CKDE::_sample_indices_from_weights(cl::Buffer& random_prob, cl::Buffer& test_buffer, int n) const {
+PooledBuffer CKDE::_sample_indices_from_weights(cl::Buffer& random_prob, cl::Buffer& test_buffer, int n) const {
     using CType = typename ArrowType::c_type;
 
     auto& opencl = OpenCLConfig::get();
-    auto res = opencl.new_buffer<int>(n);
+    auto res = opencl.temp_buffer<int>(n);
     opencl.fill_buffer<int>(res, N - 1, n);
 
-    auto [mat_logls, allocated_m] = opencl.allocate_temp_mat<ArrowType>(N, n);
+    auto extra_rows = std::is_same_v<KDEType, MultivariateKDE> ? this->evidence().size() : 0;
+    auto [mat_logls, allocated_m] = opencl.allocate_temp_mat<ArrowType>(N, n, extra_rows);
     auto iterations = static_cast<int>(std::ceil(static_cast<double>(n) / static_cast<double>(allocated_m)));
 
-    cl::Buffer tmp_mat_buffer;
+    PooledBuffer tmp_mat_buffer;
     if constexpr (std::is_same_v<KDEType, MultivariateKDE>) {
         if (N > allocated_m)
-            tmp_mat_buffer = opencl.new_buffer<CType>(N * this->evidence().size());
+            tmp_mat_buffer = opencl.temp_buffer<CType>(N * this->evidence().size());
         else
-            tmp_mat_buffer = opencl.new_buffer<CType>(allocated_m * this->evidence().size());
+            tmp_mat_buffer = opencl.temp_buffer<CType>(allocated_m * this->evidence().size());
     }
 
     auto& k_exp = opencl.kernel(OpenCL_kernel_traits<ArrowType>::exp_elementwise);
@@ -512,15 +850,15 @@ VectorXd CKDE::_cdf(const DataFrame& df) const {
     using VectorType = Matrix<CType, Dynamic, 1>;
     auto& opencl = OpenCLConfig::get();
 
-    cl::Buffer res_buffer;
+    PooledBuffer res_buffer;
     auto test_matrix = df.to_eigen<false, ArrowType>(m_variables);
     auto m = test_matrix->rows();
 
-    auto test_buffer = opencl.copy_to_buffer(test_matrix->data(), m);
+    auto test_buffer = opencl.copy_to_temp_buffer(test_matrix->data(), m);
     if (this->evidence().empty()) {
         res_buffer = _cdf_univariate<ArrowType>(test_buffer, m);
     } else {
-        auto evidence_test_buffer = opencl.copy_to_buffer(test_matrix->data() + m, m * this->evidence().size());
+        auto evidence_test_buffer = opencl.copy_to_temp_buffer(test_matrix->data() + m, m * this->evidence().size());
         if (this->evidence().size() == 1) {
             res_buffer = _cdf_multivariate<ArrowType, UnivariateKDE>(test_buffer, evidence_test_buffer, m);
         } else {
@@ -544,24 +882,17 @@ VectorXd CKDE::_cdf(const DataFrame& df) const {
         opencl.read_from_buffer(read_data.data(), res_buffer, valid);
 
         VectorXd res(df->num_rows());
-
-        for (int i = 0, k = 0; i < df->num_rows(); ++i) {
-            if (util::bit_util::GetBit(bitmap_data, i)) {
-                res(i) = static_cast<double>(read_data[k++]);
-            } else {
-                res(i) = util::nan<double>;
-            }
-        }
+        util::bit_util::expand(bitmap_data, df->num_rows(), read_data.data(), util::nan<double>, res.data());
 
         return res;
     }
 }
 
 template <typename ArrowType>
-cl::Buffer CKDE::_cdf_univariate(cl::Buffer& test_buffer, int m) const {
+PooledBuffer CKDE::_cdf_univariate(cl::Buffer& test_buffer, int m) const {
     using CType = typename ArrowType::c_type;
     auto& opencl = OpenCLConfig::get();
-    auto res = opencl.new_buffer<CType>(m);
+    auto res = opencl.temp_buffer<CType>(m);
 
     auto [mu, allocated_m] = opencl.allocate_temp_mat<ArrowType>(N, m);
     auto iterations = std::ceil(static_cast<double>(m) / static_cast<double>(allocated_m));
@@ -593,7 +924,7 @@ cl::Buffer CKDE::_cdf_univariate(cl::Buffer& test_buffer, int m) const {
 }
 
 template <typename ArrowType, typename KDEType>
-cl::Buffer CKDE::_cdf_multivariate(cl::Buffer& variable_test_buffer, cl::Buffer& evidence_test_buffer, int m) const {
+PooledBuffer CKDE::_cdf_multivariate(cl::Buffer& variable_test_buffer, cl::Buffer& evidence_test_buffer, int m) const {
     using CType = typename ArrowType::c_type;
 
     const auto& bandwidth = m_joint.bandwidth();
@@ -612,22 +943,24 @@ cl::Buffer CKDE::_cdf_multivariate(cl::Buffer& variable_test_buffer, cl::Buffer&
     auto transform = (R.transpose() * inverseL).template cast<CType>().eval();
 
     auto& opencl = OpenCLConfig::get();
-    auto transform_buffer = opencl.copy_to_buffer(transform.data(), this->evidence().size());
+    auto transform_buffer = opencl.copy_to_temp_buffer(transform.data(), this->evidence().size());
 
-    auto res = opencl.new_buffer<CType>(m);
+    auto res = opencl.temp_buffer<CType>(m);
 
-    auto [mu, allocated_m] = opencl.allocate_temp_mat<ArrowType>(N, m);
-    auto W = opencl.new_buffer<CType>(N * allocated_m);
-    auto sum_W = opencl.new_buffer<CType>(allocated_m);
+    // W and sum_W, and the temporary matrix of the multivariate KDE if allocated_m > N.
+    auto extra_rows = N + 1 + (std::is_same_v<KDEType, MultivariateKDE> ? this->evidence().size() : 0);
+    auto [mu, allocated_m] = opencl.allocate_temp_mat<ArrowType>(N, m, extra_rows);
+    auto W = opencl.temp_buffer<CType>(N * allocated_m);
+    auto sum_W = opencl.temp_buffer<CType>(allocated_m);
 
     auto iterations = static_cast<int>(std::ceil(static_cast<double>(m) / static_cast<double>(allocated_m)));
 
-    cl::Buffer tmp_mat_buffer;
+    PooledBuffer tmp_mat_buffer;
     if constexpr (std::is_same_v<KDEType, MultivariateKDE>) {
         if (N > allocated_m)
-            tmp_mat_buffer = opencl.new_buffer<CType>(N * this->evidence().size());
+            tmp_mat_buffer = opencl.temp_buffer<CType>(N * this->evidence().size());
         else
-            tmp_mat_buffer = opencl.new_buffer<CType>(allocated_m * this->evidence().size());
+            tmp_mat_buffer = opencl.temp_buffer<CType>(allocated_m * this->evidence().size());
     }
 
     auto& k_exp = opencl.kernel(OpenCL_kernel_traits<ArrowType>::exp_elementwise);
@@ -741,7 +1074,7 @@ py::tuple CKDE::__getstate__() const {
         joint_tuple = m_joint.__getstate__();
     }
 
-    return py::make_tuple(this->variable(), this->evidence(), m_fitted, joint_tuple);
+    return py::make_tuple(this->variable(), this->evidence(), m_fitted, joint_tuple, relative_error());
 }
 
 // Fix const name: https://stackoverflow.com/a/15862594
@@ -765,6 +1098,16 @@ struct CKDEFitter {
             }
         }
     }
+
+    // The CKDE factors do not implement partial_fit(), so they are never updated with it.
+    static bool valid(const std::shared_ptr<Factor>& factor) { return factor->fitted(); }
+
+    // The CKDEs with a Python-derived bandwidth selector need the GIL to be fitted, so they are fitted serially. The
+    // other CKDEs are fitted concurrently, and their OpenCL kernels are enqueued from the threads.
+    static bool concurrent(const std::shared_ptr<Factor>& factor) {
+        auto bselector = std::static_pointer_cast<CKDE>(factor)->bandwidth_type();
+        return !bselector || !bselector->is_python_derived();
+    }
 };
 
 using HCKDE = DiscreteAdaptator<CKDE, CKDEFitter, HCKDEName>;
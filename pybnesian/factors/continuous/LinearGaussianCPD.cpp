@@ -1,4 +1,6 @@
 #include <Python.h>
+#include <array>
+#include <type_traits>
 #include <pybind11/stl.h>
 #include <pybind11/eigen.h>
 #include <arrow/python/pyarrow.h>
@@ -11,9 +13,10 @@
 #include <dataset/dataset.hpp>
 #include <util/bit_util.hpp>
 #include <util/math_constants.hpp>
+#include <util/philox.hpp>
 #include <util/arrow_macros.hpp>
 #include <Eigen/Dense>
-#include <learning/parameters/mle_base.hpp>
+#include <learning/parameters/mle_LinearGaussianCPD.hpp>
 #include <boost/math/distributions/normal.hpp>
 
 namespace py = pybind11;
@@ -88,37 +91,166 @@ void LinearGaussianCPD::fit(const DataFrame& df) {
 
     m_beta = params.beta;
     m_variance = params.variance;
+    m_statistics.reset();
     m_fitted = true;
 }
 
-template <typename ArrowType>
-Matrix<typename ArrowType::c_type, Dynamic, 1> logl_impl(const DataFrame& df,
-                                                         const VectorXd& beta,
-                                                         double variance,
-                                                         const std::string& var,
-                                                         const std::vector<std::string>& evidence) {
+void LinearGaussianCPD::partial_fit(const DataFrame& df, double forgetting) {
+    check_forgetting(forgetting);
+    if (m_fitted && !m_statistics)
+        throw std::invalid_argument("The LinearGaussianCPD of " + variable() +
+                                    " was not fitted with partial_fit(), so it does not have sufficient statistics.");
+
+    auto batch = learning::parameters::linear_gaussian_statistics(df, variable(), evidence());
+    if (m_statistics) {
+        learning::parameters::update_statistics(*m_statistics, batch, forgetting);
+    } else {
+        m_statistics = std::move(batch);
+    }
+
+    auto params = learning::parameters::_fit_statistics(*m_statistics);
+
+    m_beta = params.beta;
+    m_variance = params.variance;
+    m_fitted = true;
+}
+
+void LinearGaussianCPD::weighted_fit(const DataFrame& df, const VectorXd& weights) {
+    auto stats = learning::parameters::linear_gaussian_statistics(df, variable(), evidence(), weights);
+    auto params = learning::parameters::_fit_statistics(stats);
+
+    m_beta = params.beta;
+    m_variance = params.variance;
+    m_statistics.reset();
+    m_fitted = true;
+}
+
+// Maximum number of evidence variables with a specialized residuals loop.
+constexpr int max_fixed_evidence = 8;
+
+// Calls f(i, residual) for each row i of df (or only the non-null rows if contains_null), where residual is the value
+// of var minus the mean of the LinearGaussianCPD. It reads the Arrow buffers in a single pass without copying the
+// columns. The number of evidence variables NumEvidence is fixed at compile time (or Dynamic), so the loop over the
+// evidence is unrolled.
+template <typename ArrowType, int NumEvidence, bool contains_null, typename F>
+void for_each_residual_impl(const DataFrame& df,
+                            const VectorXd& beta,
+                            const std::string& var,
+                            const std::vector<std::string>& evidence,
+                            F&& f) {
     using CType = typename ArrowType::c_type;
-    using ArrayVecType = Array<CType, Dynamic, 1>;
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+    using EvidencePointers =
+        std::conditional_t<NumEvidence == Dynamic, std::vector<const CType*>, std::array<const CType*, NumEvidence>>;
+
+    auto raw_values = [&df](const std::string& name) {
+        return std::static_pointer_cast<ArrayType>(df.col(name))->raw_values();
+    };
+
+    const CType* var_values = raw_values(var);
+    int num_evidence = evidence.size();
+
+    EvidencePointers evidence_values{};
+    if constexpr (NumEvidence == Dynamic) evidence_values.resize(num_evidence);
+    Matrix<CType, NumEvidence, 1> evidence_beta(num_evidence);
+    for (int k = 0; k < num_evidence; ++k) {
+        evidence_values[k] = raw_values(evidence[k]);
+        evidence_beta(k) = static_cast<CType>(beta(k + 1));
+    }
 
-    double inv_std = 1 / std::sqrt(variance);
+    CType intercept = static_cast<CType>(beta(0));
 
-    ArrayVecType logl;
-    auto var_array = df.to_eigen<false, ArrowType, false>(var);
-    if (evidence.empty()) {
-        logl = -0.5 * (inv_std * (var_array->array() - beta(0))).square();
-    } else {
-        ArrayVecType means = ArrayVecType::Constant(df->num_rows(), beta(0));
-        int idx = 1;
-        for (auto it = evidence.begin(); it != evidence.end(); ++it, ++idx) {
-            auto ev_array = df.to_eigen<false, ArrowType, false>(*it);
-            means += static_cast<CType>(beta[idx]) * ev_array->array();
+    const uint8_t* bitmap_data = nullptr;
+    Buffer_ptr combined_bitmap;
+    if constexpr (contains_null) {
+        combined_bitmap = df.combined_bitmap(var, evidence);
+        bitmap_data = combined_bitmap->data();
+    }
+
+    for (int64_t i = 0, end = df->num_rows(); i < end; ++i) {
+        if constexpr (contains_null) {
+            if (!util::bit_util::GetBit(bitmap_data, i)) continue;
         }
 
-        logl = -0.5 * (inv_std * (var_array->array() - means)).square();
+        CType mean = intercept;
+        for (int k = 0; k < (NumEvidence == Dynamic ? num_evidence : NumEvidence); ++k) {
+            mean += evidence_beta(k) * evidence_values[k][i];
+        }
+
+        f(i, var_values[i] - mean);
     }
+}
+
+template <typename ArrowType, bool contains_null, int NumEvidence = 0, typename F>
+void for_each_residual(const DataFrame& df,
+                       const VectorXd& beta,
+                       const std::string& var,
+                       const std::vector<std::string>& evidence,
+                       F&& f) {
+    if constexpr (NumEvidence > max_fixed_evidence) {
+        for_each_residual_impl<ArrowType, Dynamic, contains_null>(df, beta, var, evidence, f);
+    } else {
+        if (evidence.size() == NumEvidence)
+            for_each_residual_impl<ArrowType, NumEvidence, contains_null>(df, beta, var, evidence, f);
+        else
+            for_each_residual<ArrowType, contains_null, NumEvidence + 1>(df, beta, var, evidence, f);
+    }
+}
+
+// Stores the log-likelihood of the rows without null values in out, or adds it to out if accumulate is true. The other
+// rows of out are not modified.
+template <typename ArrowType, bool contains_null, typename OutType>
+void residuals_logl_into(const DataFrame& df,
+                         const VectorXd& beta,
+                         double variance,
+                         const std::string& var,
+                         const std::vector<std::string>& evidence,
+                         OutType& out,
+                         bool accumulate) {
+    using CType = typename ArrowType::c_type;
+
+    CType half_inv_variance = static_cast<CType>(0.5 / variance);
+    CType lognorm = static_cast<CType>(-0.5 * std::log(variance) - 0.5 * std::log(2 * pi<double>));
+
+    if (accumulate) {
+        for_each_residual<ArrowType, contains_null>(
+            df, beta, var, evidence, [&out, half_inv_variance, lognorm](int64_t i, CType residual) {
+                out(i) += lognorm - half_inv_variance * residual * residual;
+            });
+    } else {
+        for_each_residual<ArrowType, contains_null>(
+            df, beta, var, evidence, [&out, half_inv_variance, lognorm](int64_t i, CType residual) {
+                out(i) = lognorm - half_inv_variance * residual * residual;
+            });
+    }
+}
+
+template <typename ArrowType, bool contains_null>
+Matrix<typename ArrowType::c_type, Dynamic, 1> residuals_logl(const DataFrame& df,
+                                                              const VectorXd& beta,
+                                                              double variance,
+                                                              const std::string& var,
+                                                              const std::vector<std::string>& evidence) {
+    using CType = typename ArrowType::c_type;
+    using VectorType = Matrix<CType, Dynamic, 1>;
+
+    VectorType logl;
+    if constexpr (contains_null)
+        logl = VectorType::Constant(df->num_rows(), util::nan<CType>);
+    else
+        logl.resize(df->num_rows());
 
-    logl += -0.5 * std::log(variance) - 0.5 * std::log(2 * pi<CType>);
-    return logl.matrix();
+    residuals_logl_into<ArrowType, contains_null>(df, beta, variance, var, evidence, logl, false);
+    return logl;
+}
+
+template <typename ArrowType>
+Matrix<typename ArrowType::c_type, Dynamic, 1> logl_impl(const DataFrame& df,
+                                                         const VectorXd& beta,
+                                                         double variance,
+                                                         const std::string& var,
+                                                         const std::vector<std::string>& evidence) {
+    return residuals_logl<ArrowType, false>(df, beta, variance, var, evidence);
 }
 
 template <typename ArrowType>
@@ -127,18 +259,27 @@ Matrix<typename ArrowType::c_type, Dynamic, 1> logl_impl_null(const DataFrame& d
                                                               double variance,
                                                               const std::string& var,
                                                               const std::vector<std::string>& evidence) {
-    using CType = typename ArrowType::c_type;
+    return residuals_logl<ArrowType, true>(df, beta, variance, var, evidence);
+}
 
-    auto logl = logl_impl<ArrowType>(df, beta, variance, var, evidence);
-    auto combined_bitmap = df.combined_bitmap(var, evidence);
-    auto bitmap_data = combined_bitmap->data();
-    auto logl_ptr = logl.data();
+// The sum of the squared residuals is accumulated in double, and the log-likelihood is computed at the end.
+template <typename ArrowType, bool contains_null>
+double residuals_slogl(const DataFrame& df,
+                       const VectorXd& beta,
+                       double variance,
+                       const std::string& var,
+                       const std::vector<std::string>& evidence) {
+    using CType = typename ArrowType::c_type;
 
-    for (int i = 0; i < df->num_rows(); ++i) {
-        if (!util::bit_util::GetBit(bitmap_data, i)) logl_ptr[i] = util::nan<CType>;
-    }
+    double sse = 0;
+    int64_t valid_rows = 0;
+    for_each_residual<ArrowType, contains_null>(
+        df, beta, var, evidence, [&sse, &valid_rows](int64_t, CType residual) {
+            sse += static_cast<double>(residual) * residual;
+            ++valid_rows;
+        });
 
-    return logl;
+    return -0.5 * valid_rows * (std::log(variance) + std::log(2 * pi<double>)) - 0.5 * sse / variance;
 }
 
 template <typename ArrowType>
@@ -147,7 +288,7 @@ double slogl_impl(const DataFrame& df,
                   double variance,
                   const std::string& var,
                   const std::vector<std::string>& evidence) {
-    return logl_impl<ArrowType>(df, beta, variance, var, evidence).sum();
+    return residuals_slogl<ArrowType, false>(df, beta, variance, var, evidence);
 }
 
 template <typename ArrowType>
@@ -156,18 +297,7 @@ double slogl_impl_null(const DataFrame& df,
                        double variance,
                        const std::string& var,
                        const std::vector<std::string>& evidence) {
-    auto logl = logl_impl<ArrowType>(df, beta, variance, var, evidence);
-
-    auto combined_bitmap = df.combined_bitmap(var, evidence);
-    auto bitmap_data = combined_bitmap->data();
-    auto logl_ptr = logl.data();
-
-    double accum = 0;
-    for (int i = 0; i < df->num_rows(); ++i) {
-        if (util::bit_util::GetBit(bitmap_data, i)) accum += logl_ptr[i];
-    }
-
-    return accum;
+    return residuals_slogl<ArrowType, true>(df, beta, variance, var, evidence);
 }
 
 template <typename ArrowType>
@@ -273,6 +403,27 @@ VectorXd LinearGaussianCPD::logl(const DataFrame& df) const {
     }
 }
 
+void LinearGaussianCPD::logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out, bool accumulate) const {
+    check_fitted();
+    check_logl_output(df, out.rows());
+    auto type_id = df.same_type(this->variable(), this->evidence())->id();
+    if (type_id != Type::DOUBLE && type_id != Type::FLOAT)
+        throw std::invalid_argument("Wrong data type to compute logl. [double] or [float] data is expected.");
+
+    // The log-likelihood of the rows with null values is NaN, so these DataFrames use the result of logl().
+    if (df.null_count(this->variable(), this->evidence()) != 0) {
+        Factor::logl_into(df, out, accumulate);
+        return;
+    }
+
+    if (type_id == Type::DOUBLE)
+        residuals_logl_into<arrow::DoubleType, false>(
+            df, m_beta, m_variance, this->variable(), this->evidence(), out, accumulate);
+    else
+        residuals_logl_into<arrow::FloatType, false>(
+            df, m_beta, m_variance, this->variable(), this->evidence(), out, accumulate);
+}
+
 double LinearGaussianCPD::slogl(const DataFrame& df) const {
     check_fitted();
     switch (df.same_type(this->variable(), this->evidence())->id()) {
@@ -325,11 +476,10 @@ Array_ptr LinearGaussianCPD::sample(int n, const DataFrame& evidence_values, uns
     arrow::NumericBuilder<arrow::DoubleType> builder;
     RAISE_STATUS_ERROR(builder.Resize(n));
 
-    std::mt19937 rng{seed};
-    std::normal_distribution<> normal(m_beta(0), std::sqrt(m_variance));
-
+    // The noise of each row only depends on the seed and the row index (as in the CKDE sampling kernels).
+    double sd = std::sqrt(m_variance);
     for (auto i = 0; i < n; ++i) {
-        builder.UnsafeAppend(normal(rng));
+        builder.UnsafeAppend(m_beta(0) + sd * util::philox::normal(i, seed));
     }
 
     std::shared_ptr<arrow::DoubleArray> out;
@@ -403,12 +553,24 @@ std::string LinearGaussianCPD::ToString() const {
     return stream.str();
 }
 
+util::MemoryUsage LinearGaussianCPD::memory_usage() const {
+    util::MemoryUsage usage;
+    usage.add("beta", util::eigen_bytes(m_beta));
+    if (m_statistics)
+        usage.add("statistics", util::eigen_bytes(m_statistics->mean) + util::eigen_bytes(m_statistics->scatter));
+    return usage;
+}
+
 py::tuple LinearGaussianCPD::__getstate__() const {
-    return py::make_tuple(this->variable(), this->evidence(), m_fitted, m_beta, m_variance);
+    py::object statistics = py::none();
+    if (m_statistics) statistics = py::make_tuple(m_statistics->count, m_statistics->mean, m_statistics->scatter);
+
+    return py::make_tuple(this->variable(), this->evidence(), m_fitted, m_beta, m_variance, statistics);
 }
 
 LinearGaussianCPD LinearGaussianCPD::__setstate__(py::tuple& t) {
-    if (t.size() != 5) throw std::runtime_error("Not valid LinearGaussianCPD.");
+    // The states without the sufficient statistics (of previous versions) have 5 elements.
+    if (t.size() != 5 && t.size() != 6) throw std::runtime_error("Not valid LinearGaussianCPD.");
 
     LinearGaussianCPD cpd(t[0].cast<std::string>(), t[1].cast<std::vector<std::string>>());
 
@@ -416,6 +578,34 @@ LinearGaussianCPD LinearGaussianCPD::__setstate__(py::tuple& t) {
     cpd.m_beta = t[3].cast<VectorXd>();
     cpd.m_variance = t[4].cast<double>();
 
+    if (t.size() == 6 && !t[5].is_none()) {
+        auto statistics = t[5].cast<py::tuple>();
+        cpd.m_statistics = LinearGaussianCPD_Statistics{
+            statistics[0].cast<double>(), statistics[1].cast<VectorXd>(), statistics[2].cast<MatrixXd>()};
+    }
+
+    return cpd;
+}
+
+void LinearGaussianCPD::write_binary(util::BinaryWriter& writer) const {
+    writer.write(this->variable());
+    writer.write(this->evidence());
+    writer.write(m_fitted);
+    writer.write_matrix(m_beta);
+    writer.write(m_variance);
+}
+
+LinearGaussianCPD LinearGaussianCPD::read_binary(util::BinaryReader& reader) {
+    auto variable = reader.read_string();
+    LinearGaussianCPD cpd(variable, reader.read_strings());
+
+    cpd.m_fitted = reader.read_bool();
+    auto beta = reader.read_matrix<double>();
+    if (beta.cols() > 1 || (cpd.m_fitted && static_cast<size_t>(beta.rows()) != cpd.evidence().size() + 1))
+        throw std::runtime_error("Not valid LinearGaussianCPD.");
+    cpd.m_beta = beta;
+    cpd.m_variance = reader.read<double>();
+
     return cpd;
 }
 
@@ -1,13 +1,14 @@
 #ifndef PYBNESIAN_FACTORS_CONTINUOUS_LINEARGAUSSIANCPD_HPP
 #define PYBNESIAN_FACTORS_CONTINUOUS_LINEARGAUSSIANCPD_HPP
 
+#include <optional>
 #include <random>
 #include <factors/factors.hpp>
 #include <factors/discrete/DiscreteAdaptator.hpp>
 #include <dataset/dataset.hpp>
 
 using dataset::DataFrame;
-using Eigen::VectorXd;
+using Eigen::VectorXd, Eigen::MatrixXd;
 using factors::Factor;
 using factors::discrete::DiscreteAdaptator;
 
@@ -57,6 +58,14 @@ struct LinearGaussianCPD_Params {
     double variance;
 };
 
+// The sufficient statistics of a LinearGaussianCPD (see LinearGaussianCPD::partial_fit()): the (weighted) number of
+// instances, and the mean and the scatter matrix of the evidence followed by the variable.
+struct LinearGaussianCPD_Statistics {
+    double count;
+    VectorXd mean;
+    MatrixXd scatter;
+};
+
 class LinearGaussianCPD : public Factor {
 public:
     using ParamsClass = LinearGaussianCPD_Params;
@@ -74,11 +83,25 @@ public:
 
     bool fitted() const override { return m_fitted; }
     void fit(const DataFrame& df) override;
+    // Updates the sufficient statistics with the instances of df and fits the parameters with them. The statistics
+    // of the previous instances are multiplied by forgetting, so the sequence of partial_fit() calls with forgetting
+    // equal to 1 fits the same parameters (up to rounding errors) as fit() with all the instances.
+    void partial_fit(const DataFrame& df, double forgetting = 1) override;
+    // Fits the parameters with the weighted sufficient statistics of df, so an integer weight is equivalent to
+    // repeating the row.
+    void weighted_fit(const DataFrame& df, const VectorXd& weights) override;
+    // The sufficient statistics of the instances of partial_fit(). The factors fitted with fit() or constructed with
+    // the parameters do not have statistics.
+    const std::optional<LinearGaussianCPD_Statistics>& statistics() const { return m_statistics; }
     VectorXd logl(const DataFrame& df) const override;
+    // Writes the log-likelihood of the DataFrames without null values (in the columns of the CPD) directly in out.
+    void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out, bool accumulate = false) const override;
     double slogl(const DataFrame& df) const override;
     VectorXd cdf(const DataFrame& df) const;
 
     std::string ToString() const override;
+    // The coefficients and the sufficient statistics of partial_fit().
+    util::MemoryUsage memory_usage() const override;
 
     const VectorXd& beta() const { return m_beta; }
     void set_beta(const VectorXd& new_beta) {
@@ -87,6 +110,7 @@ public:
                 "Wrong number of elements for the beta vector: " + std::to_string(new_beta.rows()) +
                 ". Expected size: " + std::to_string((evidence().size() + 1)));
         m_beta = new_beta;
+        m_statistics.reset();
 
         if (m_variance > 0) m_fitted = true;
     }
@@ -98,6 +122,7 @@ public:
         }
 
         m_variance = v;
+        m_statistics.reset();
         if (m_beta.rows() == static_cast<int>(evidence().size() + 1)) m_fitted = true;
     }
 
@@ -109,6 +134,10 @@ public:
     static LinearGaussianCPD __setstate__(py::tuple& t);
     static LinearGaussianCPD __setstate__(py::tuple&& t) { return __setstate__(t); }
 
+    // The sufficient statistics of partial_fit() are not saved in the binary format.
+    void write_binary(util::BinaryWriter& writer) const;
+    static LinearGaussianCPD read_binary(util::BinaryReader& reader);
+
 private:
     void check_fitted() const {
         if (!fitted()) throw std::invalid_argument("LinearGaussianCPD factor not fitted.");
@@ -117,6 +146,7 @@ private:
     bool m_fitted;
     VectorXd m_beta;
     double m_variance;
+    std::optional<LinearGaussianCPD_Statistics> m_statistics;
 };
 
 // Fix const name: https://stackoverflow.com/a/15862594
@@ -127,6 +157,11 @@ struct CLinearGaussianCPDName {
 struct LinearGaussianFitter {
     static bool fit(const std::shared_ptr<Factor>& factor, const DataFrame& df) {
         factor->fit(df);
+        return valid(factor);
+    }
+
+    // Returns true if the fitted factor can be used: its variance is not (almost) zero or infinite.
+    static bool valid(const std::shared_ptr<Factor>& factor) {
         auto dwn = std::static_pointer_cast<LinearGaussianCPD>(factor);
 
         if (dwn->variance() < util::machine_tol || std::isinf(dwn->variance())) {
@@ -135,6 +170,9 @@ struct LinearGaussianFitter {
 
         return true;
     }
+
+    // The LinearGaussianCPDs are fitted without the GIL, so the configurations are fitted concurrently.
+    static bool concurrent(const std::shared_ptr<Factor>&) { return true; }
 };
 
 using CLinearGaussianCPD = DiscreteAdaptator<LinearGaussianCPD, LinearGaussianFitter, CLinearGaussianCPDName>;
@@ -4,6 +4,7 @@
 #include <factors/factors.hpp>
 #include <factors/discrete/discrete_indices.hpp>
 #include <util/math_constants.hpp>
+#include <util/parallel.hpp>
 #include <fort.hpp>
 
 using Eigen::VectorXi;
@@ -17,6 +18,9 @@ public:
                                                const std::vector<std::string>& evidence,
                                                const Assignment& discrete_assignment) const = 0;
 
+    // Returns true if the base factors are constructed with additional arguments.
+    virtual bool has_arguments() const = 0;
+
     virtual py::tuple __getstate__() const = 0;
 };
 
@@ -42,6 +46,8 @@ public:
         }
     }
 
+    bool has_arguments() const override { return sizeof...(Args) > 0; }
+
     py::tuple __getstate__() const override {
         return py::make_tuple(false, py::module_::import("pickle").attr("dumps")(m_args));
     }
@@ -79,6 +85,8 @@ public:
         }
     }
 
+    bool has_arguments() const override { return sizeof...(Args) > 0 && !m_args.empty(); }
+
     py::tuple __getstate__() const override {
         return py::make_tuple(true, py::module_::import("pickle").attr("dumps")(m_args));
     }
@@ -87,6 +95,13 @@ private:
     std::unordered_map<Assignment, std::tuple<Args...>, AssignmentHash> m_args;
 };
 
+// A factor with a BaseFactor for each configuration of the discrete evidence. The factors of the configurations are
+// fitted and evaluated concurrently with all the hardware threads (as the KDE evaluation), so a DiscreteAdaptator
+// evaluated inside a parallel loop (e.g., in BayesianNetworkBase::parallel_logl()) runs them serially. The results of
+// each configuration are scattered to its rows, so they do not depend on the number of threads.
+//
+// BaseFitter::concurrent(factor) returns true if the base factor can be fitted without the GIL (e.g., it does not
+// call a Python-derived bandwidth selector). Otherwise, the factors are fitted serially.
 template <typename BaseFactor, typename BaseFitter, typename FactorName>
 class DiscreteAdaptator : public Factor {
 public:
@@ -100,7 +115,10 @@ public:
           m_continuous_evidence(),
           m_cardinality(),
           m_strides(),
-          m_factors() {}
+          m_sparse(false),
+          m_configurations(),
+          m_factors(),
+          m_statistics_factors() {}
 
     template <typename... CArgs>
     DiscreteAdaptator(const std::string& variable,
@@ -114,7 +132,10 @@ public:
           m_continuous_evidence(),
           m_cardinality(),
           m_strides(),
-          m_factors() {}
+          m_sparse(false),
+          m_configurations(),
+          m_factors(),
+          m_statistics_factors() {}
 
     std::shared_ptr<arrow::DataType> data_type() const override {
         check_fitted();
@@ -127,11 +148,45 @@ public:
     bool fitted() const override { return m_fitted; }
 
     void fit(const DataFrame& df) override;
+    // Updates the factor of each configuration of the discrete evidence with the partial_fit() of the base factor. The
+    // factors of the configurations without instances in df are also updated, so the statistics of all the
+    // configurations are forgotten at the same rate. The configurations that can not be fitted yet (see BaseFitter)
+    // keep their statistics, so they are fitted when the next instances arrive.
+    void partial_fit(const DataFrame& df, double forgetting = 1) override;
     VectorXd logl(const DataFrame& df) const override;
     double slogl(const DataFrame& df) const override;
 
     std::shared_ptr<Factor> conditional_factor(Assignment& assignment) const;
 
+    // The evidence of the fitted factor split in discrete and continuous evidence. The factors of the configurations of
+    // the discrete evidence are indexed with the strides(), and they are nullptr if the configuration is not fitted.
+    //
+    // If the discrete evidence has more than sparse_configurations_threshold configurations, the factor is sparse: it
+    // only stores the factors of the configurations() with data, and the rest of configurations are not fitted.
+    const std::vector<std::string>& discrete_evidence() const {
+        check_fitted();
+        return m_discrete_evidence;
+    }
+    const std::vector<std::vector<std::string>>& discrete_values() const {
+        check_fitted();
+        return m_discrete_values;
+    }
+    const std::vector<std::string>& continuous_evidence() const {
+        check_fitted();
+        return m_continuous_evidence;
+    }
+    const VectorXi& strides() const {
+        check_fitted();
+        return m_strides;
+    }
+    // The factor of each configuration, or of each configurations() if the factor is sparse.
+    const std::vector<std::shared_ptr<Factor>>& conditional_factors() const {
+        check_fitted();
+        return m_factors;
+    }
+    bool sparse() const { return m_sparse; }
+    const std::vector<int>& configurations() const { return m_configurations; }
+
     std::string ToString() const override;
 
     Array_ptr sample(int n,
@@ -143,6 +198,11 @@ public:
     static DiscreteAdaptator<BaseFactor, BaseFitter, FactorName> __setstate__(py::tuple& t);
     static DiscreteAdaptator<BaseFactor, BaseFitter, FactorName> __setstate__(py::tuple&& t) { return __setstate__(t); }
 
+    // The factors constructed with additional arguments cannot be saved in the binary format. The statistics of
+    // partial_fit() are not saved.
+    void write_binary(util::BinaryWriter& writer) const;
+    static DiscreteAdaptator<BaseFactor, BaseFitter, FactorName> read_binary(util::BinaryReader& reader);
+
 private:
     void check_fitted() const;
     void check_equal_domain(const DataFrame& df) const;
@@ -150,6 +210,34 @@ private:
         check_fitted();
         check_equal_domain(df);
     }
+    // Splits the evidence in discrete and continuous evidence, and reads the domain of the discrete evidence from df.
+    void set_evidence_domain(const DataFrame& df);
+    // Returns the position in m_factors of the factor of a configuration of the discrete evidence, or -1 if a sparse
+    // factor does not store the configuration.
+    int factor_position(int configuration) const {
+        if (!m_sparse) return configuration;
+
+        auto found = std::lower_bound(m_configurations.begin(), m_configurations.end(), configuration);
+        if (found == m_configurations.end() || *found != configuration) return -1;
+        return found - m_configurations.begin();
+    }
+    // Groups the rows of df by the configuration of the discrete evidence. The data of each group contains the
+    // columns of the continuous factors.
+    DiscretePartition continuous_partition(const DataFrame& df) const {
+        return DiscretePartition(
+            df, m_discrete_evidence, m_strides, m_cardinality.prod(), df.loc(variable(), m_continuous_evidence));
+    }
+    // Returns the groups of the partition with rows and a fitted factor, as pairs of the group and the position of its
+    // factor in m_factors.
+    std::vector<std::pair<int, int>> fitted_groups(const DiscretePartition& partition) const {
+        std::vector<std::pair<int, int>> groups;
+        for (auto g = 0; g < partition.num_groups(); ++g) {
+            auto position = factor_position(partition.configuration(g));
+            if (partition.rows(g) > 0 && position != -1 && m_factors[position]) groups.push_back({g, position});
+        }
+
+        return groups;
+    }
 
     std::unique_ptr<BaseFactorParameters> m_args;
     bool m_fitted;
@@ -158,7 +246,13 @@ private:
     std::vector<std::string> m_continuous_evidence;
     VectorXi m_cardinality;
     VectorXi m_strides;
+    bool m_sparse;
+    // The configurations of the factors of a sparse factor, in increasing order.
+    std::vector<int> m_configurations;
     std::vector<std::shared_ptr<Factor>> m_factors;
+    // The factors updated by partial_fit(), in the same order as m_factors. The factors that can not be fitted yet are
+    // nullptr in m_factors. It is empty if the factor is fitted with fit().
+    std::vector<std::shared_ptr<Factor>> m_statistics_factors;
 };
 
 template <typename BaseFactor, typename BaseFitter, typename FactorName>
@@ -186,7 +280,7 @@ void DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::check_equal_domain(c
 }
 
 template <typename BaseFactor, typename BaseFitter, typename FactorName>
-void DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::fit(const DataFrame& df) {
+void DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::set_evidence_domain(const DataFrame& df) {
     std::vector<std::string> discrete_evidence, continuous_evidence;
 
     for (const auto& e : evidence()) {
@@ -208,78 +302,172 @@ void DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::fit(const DataFrame&
     m_discrete_evidence = discrete_evidence;
     m_discrete_values.clear();
     m_continuous_evidence = continuous_evidence;
+    m_sparse = false;
+    m_configurations.clear();
     m_factors.clear();
+    m_statistics_factors.clear();
 
-    if (m_discrete_evidence.empty()) {
-        auto factor = m_args->initialize(variable(), m_continuous_evidence, Assignment());
-        m_factors.push_back(std::move(factor));
-        m_factors.back()->fit(df);
-    } else {
+    if (!m_discrete_evidence.empty()) {
         std::tie(m_cardinality, m_strides) = factors::discrete::create_cardinality_strides(df, m_discrete_evidence);
+        if (m_cardinality.cast<double>().prod() > std::numeric_limits<int>::max())
+            throw std::invalid_argument("The number of configurations of the discrete evidence of " + variable() +
+                                        " does not fit in the discrete indices.");
 
         m_discrete_values.reserve(m_discrete_evidence.size());
         for (auto it = m_discrete_evidence.begin(), end = m_discrete_evidence.end(); it != end; ++it) {
-            auto dict_evidence = std::static_pointer_cast<arrow::DictionaryArray>(df.col(*it));
-
-            factors::discrete::check_is_string_dictionary(dict_evidence, *it);
-            auto dict_evidence_values = std::static_pointer_cast<arrow::StringArray>(dict_evidence->dictionary());
-
-            std::vector<std::string> ev;
-            ev.reserve(dict_evidence_values->length());
-            for (auto j = 0; j < dict_evidence_values->length(); ++j) {
-                ev.push_back(dict_evidence_values->GetString(j));
-            }
-
-            m_discrete_values.push_back(ev);
+            m_discrete_values.push_back(factors::discrete::discrete_column(df, *it)->categories);
         }
+    }
+}
 
-        auto num_factors = m_cardinality.prod();
-        m_factors.reserve(num_factors);
-
-        auto slices = discrete_slice_indices(df, m_discrete_evidence, m_strides, num_factors);
+template <typename BaseFactor, typename BaseFitter, typename FactorName>
+void DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::fit(const DataFrame& df) {
+    set_evidence_domain(df);
 
-        for (auto i = 0; i < num_factors; ++i) {
-            if (slices[i]) {
-                auto assignment =
-                    Assignment::from_index(i, m_discrete_evidence, m_discrete_values, m_cardinality, m_strides);
+    if (m_discrete_evidence.empty()) {
+        auto factor = m_args->initialize(variable(), m_continuous_evidence, Assignment());
+        m_factors.push_back(std::move(factor));
+        m_factors.back()->fit(df);
+    } else {
+        auto partition = continuous_partition(df);
+        m_sparse = partition.sparse();
+        m_factors.reserve(partition.num_groups());
+
+        // The factors are created serially in the order of the configurations, and then fitted concurrently. Each
+        // entry of unfitted is the position of the factor in m_factors and the group of its data.
+        std::vector<std::pair<int, int>> unfitted;
+        bool concurrent = true;
+        for (auto g = 0; g < partition.num_groups(); ++g) {
+            if (partition.rows(g) > 0) {
+                auto configuration = partition.configuration(g);
+                auto assignment = Assignment::from_index(
+                    configuration, m_discrete_evidence, m_discrete_values, m_cardinality, m_strides);
 
                 auto factor = m_args->initialize(variable(), m_continuous_evidence, assignment);
                 m_factors.push_back(std::move(factor));
+                if (m_sparse) m_configurations.push_back(configuration);
 
                 if (!m_factors.back()->fitted()) {
-                    auto df_filtered = df.take(slices[i]);
-
-                    if (!BaseFitter::fit(m_factors.back(), df_filtered)) {
-                        m_factors.back() = nullptr;
-                    }
+                    unfitted.push_back({static_cast<int>(m_factors.size()) - 1, g});
+                    concurrent = concurrent && BaseFitter::concurrent(m_factors.back());
                 }
             } else {
                 m_factors.push_back(nullptr);
             }
         }
+
+        auto threads = concurrent ? util::effective_num_threads(0) : 1;
+        util::parallel_for(0, unfitted.size(), threads, [this, &partition, &unfitted](int k, int) {
+            auto& factor = m_factors[unfitted[k].first];
+            if (!BaseFitter::fit(factor, partition.data(unfitted[k].second))) {
+                factor = nullptr;
+            }
+        });
     }
 
     m_fitted = true;
 }
 
-template <typename ArrowType>
-void logl_impl(const std::shared_ptr<Factor>& f, const DataFrame& df, const Array_ptr& indices, VectorXd& res) {
-    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
-    auto dwn_indices = std::static_pointer_cast<ArrayType>(indices);
-    auto raw_indices = dwn_indices->raw_values();
-
-    if (f) {
-        auto df_filtered = df.take(indices);
-        auto ll = f->logl(df_filtered);
+template <typename BaseFactor, typename BaseFitter, typename FactorName>
+void DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::partial_fit(const DataFrame& df, double forgetting) {
+    check_forgetting(forgetting);
+
+    if (m_fitted) {
+        if (m_statistics_factors.empty())
+            throw std::invalid_argument("Factor " + ToString() +
+                                        " was not fitted with partial_fit(), so it does not have sufficient "
+                                        "statistics.");
+        check_equal_domain(df);
+    } else {
+        set_evidence_domain(df);
+        if (!m_discrete_evidence.empty()) {
+            m_sparse = m_cardinality.cast<double>().prod() > sparse_configurations_threshold;
+            if (!m_sparse) {
+                m_factors.resize(m_cardinality.prod());
+                m_statistics_factors.resize(m_cardinality.prod());
+            }
+        }
+    }
 
-        for (auto i = 0; i < dwn_indices->length(); ++i) {
-            res(raw_indices[i]) = ll(i);
+    if (m_discrete_evidence.empty()) {
+        if (!m_fitted) {
+            m_statistics_factors.push_back(m_args->initialize(variable(), m_continuous_evidence, Assignment()));
+            m_factors.push_back(m_statistics_factors.back());
         }
+
+        m_statistics_factors[0]->partial_fit(df, forgetting);
     } else {
-        for (auto i = 0; i < dwn_indices->length(); ++i) {
-            res(raw_indices[i]) = util::nan<double>;
+        auto partition = continuous_partition(df);
+
+        std::vector<bool> updated(m_statistics_factors.size(), false);
+        // The factors of the configurations that are not stored in a sparse factor, in increasing order.
+        std::vector<std::pair<int, std::shared_ptr<Factor>>> new_factors;
+
+        for (auto g = 0; g < partition.num_groups(); ++g) {
+            if (partition.rows(g) == 0) continue;
+
+            auto configuration = partition.configuration(g);
+            auto position = factor_position(configuration);
+            if (position != -1 && m_statistics_factors[position]) {
+                m_statistics_factors[position]->partial_fit(partition.data(g), forgetting);
+                updated[position] = true;
+            } else {
+                auto assignment = Assignment::from_index(
+                    configuration, m_discrete_evidence, m_discrete_values, m_cardinality, m_strides);
+                auto factor = m_args->initialize(variable(), m_continuous_evidence, assignment);
+                factor->partial_fit(partition.data(g));
+
+                if (position != -1) {
+                    m_statistics_factors[position] = std::move(factor);
+                    updated[position] = true;
+                } else {
+                    new_factors.push_back({configuration, std::move(factor)});
+                }
+            }
+        }
+
+        if (forgetting < 1) {
+            // An empty DataFrame only forgets the statistics.
+            auto empty = df.loc(variable(), m_continuous_evidence).slice(0, 0);
+            for (size_t k = 0, k_end = m_statistics_factors.size(); k < k_end; ++k) {
+                if (!updated[k] && m_statistics_factors[k]) m_statistics_factors[k]->partial_fit(empty, forgetting);
+            }
+        }
+
+        if (!new_factors.empty()) {
+            std::vector<int> configurations;
+            std::vector<std::shared_ptr<Factor>> statistics_factors;
+            configurations.reserve(m_configurations.size() + new_factors.size());
+            statistics_factors.reserve(m_configurations.size() + new_factors.size());
+
+            size_t j = 0;
+            for (auto& [configuration, factor] : new_factors) {
+                for (; j < m_configurations.size() && m_configurations[j] < configuration; ++j) {
+                    configurations.push_back(m_configurations[j]);
+                    statistics_factors.push_back(std::move(m_statistics_factors[j]));
+                }
+
+                configurations.push_back(configuration);
+                statistics_factors.push_back(std::move(factor));
+            }
+
+            for (; j < m_configurations.size(); ++j) {
+                configurations.push_back(m_configurations[j]);
+                statistics_factors.push_back(std::move(m_statistics_factors[j]));
+            }
+
+            m_configurations = std::move(configurations);
+            m_statistics_factors = std::move(statistics_factors);
+            m_factors.resize(m_statistics_factors.size());
         }
     }
+
+    for (size_t k = 0, k_end = m_statistics_factors.size(); k < k_end; ++k) {
+        const auto& factor = m_statistics_factors[k];
+        m_factors[k] = (factor && (m_discrete_evidence.empty() || BaseFitter::valid(factor))) ? factor : nullptr;
+    }
+
+    m_fitted = true;
 }
 
 template <typename BaseFactor, typename BaseFitter, typename FactorName>
@@ -289,23 +477,22 @@ VectorXd DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::logl(const DataF
     if (m_discrete_evidence.empty()) {
         return m_factors[0]->logl(df);
     } else {
-        auto num_factors = m_factors.size();
-        auto slices = discrete_slice_indices(df, m_discrete_evidence, m_strides, num_factors);
+        auto partition = continuous_partition(df);
+        auto groups = fitted_groups(partition);
 
-        VectorXd res(df->num_rows());
+        // The rows with null discrete evidence or without a fitted factor are NaN.
+        VectorXd res = VectorXd::Constant(df->num_rows(), util::nan<double>);
 
-        if (auto combined_bitmap = df.combined_bitmap(m_discrete_evidence)) {
-            auto bitmap_data = combined_bitmap->data();
-            for (auto i = 0; i < df->num_rows(); ++i) {
-                if (!util::bit_util::GetBit(bitmap_data, i)) res(i) = util::nan<double>;
-            }
-        }
+        // The groups contain disjoint rows, so each group writes its rows of res concurrently.
+        util::parallel_for(0, groups.size(), util::effective_num_threads(0), [&](int i, int) {
+            auto [g, position] = groups[i];
+            auto ll = m_factors[position]->logl(partition.data(g));
+            auto row_indices = partition.row_indices(g);
 
-        for (size_t i = 0; i < num_factors; ++i) {
-            if (slices[i]) {
-                logl_impl<arrow::Int32Type>(m_factors[i], df, slices[i], res);
+            for (auto k = 0; k < ll.rows(); ++k) {
+                res(row_indices[k]) = ll(k);
             }
-        }
+        });
 
         return res;
     }
@@ -318,16 +505,19 @@ double DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::slogl(const DataFr
     if (m_discrete_evidence.empty()) {
         return m_factors[0]->slogl(df);
     } else {
-        auto num_factors = m_factors.size();
-        auto slices = discrete_slice_indices(df, m_discrete_evidence, m_strides, num_factors);
+        auto partition = continuous_partition(df);
+        auto groups = fitted_groups(partition);
 
-        double res = 0;
+        std::vector<double> group_slogl(groups.size());
+        util::parallel_for(0, groups.size(), util::effective_num_threads(0), [&](int i, int) {
+            auto [g, position] = groups[i];
+            group_slogl[i] = m_factors[position]->slogl(partition.data(g));
+        });
 
-        for (size_t i = 0; i < num_factors; ++i) {
-            if (slices[i] && m_factors[i]) {
-                auto df_filtered = df.take(slices[i]);
-                res += m_factors[i]->slogl(df_filtered);
-            }
+        // The slogl of the groups are added in order, as in the serial evaluation.
+        double res = 0;
+        for (auto s : group_slogl) {
+            res += s;
         }
 
         return res;
@@ -338,8 +528,8 @@ template <typename BaseFactor, typename BaseFitter, typename FactorName>
 std::shared_ptr<Factor> DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::conditional_factor(
     Assignment& assignment) const {
     check_fitted();
-    auto index = assignment.index(m_discrete_evidence, m_discrete_values, m_strides);
-    return m_factors[index];
+    auto position = factor_position(assignment.index(m_discrete_evidence, m_discrete_values, m_strides));
+    return (position != -1) ? m_factors[position] : nullptr;
 }
 
 template <typename BaseFactor, typename BaseFitter, typename FactorName>
@@ -380,8 +570,10 @@ std::string DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::ToString() co
             table << fort::endr << fort::header;
             table.range_write_ln(m_discrete_evidence.begin(), m_discrete_evidence.end());
 
-            for (size_t k = 0, num_factors = m_cardinality.prod(); k < num_factors; ++k) {
-                auto ass = Assignment::from_index(k, m_discrete_evidence, m_discrete_values, m_cardinality, m_strides);
+            for (size_t k = 0, num_factors = m_factors.size(); k < num_factors; ++k) {
+                auto configuration = m_sparse ? m_configurations[k] : k;
+                auto ass = Assignment::from_index(
+                    configuration, m_discrete_evidence, m_discrete_values, m_cardinality, m_strides);
 
                 for (const auto& discrete_evidence : m_discrete_evidence) {
                     table << static_cast<std::string>(ass.value(discrete_evidence));
@@ -395,6 +587,14 @@ std::string DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::ToString() co
                 table << fort::endr;
             }
 
+            // The sparse factors do not store the rest of configurations.
+            if (m_sparse) {
+                for (size_t j = 0; j < m_discrete_evidence.size(); ++j) {
+                    table << "*";
+                }
+                table << "not fitted" << fort::endr;
+            }
+
             ss << table.to_string();
         } else {
             ss << " not fitted.";
@@ -410,50 +610,44 @@ std::string DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::ToString() co
     return ss.str();
 }
 
-template <typename IndicesArrowType, typename ResultArrowType>
+template <typename ResultArrowType>
 void sample_factor_impl(const std::shared_ptr<Factor>& f,
-                        int n,
-                        const DataFrame& evidence_values,
+                        const DiscretePartition& partition,
+                        int group,
                         unsigned int seed,
-                        const Array_ptr& indices,
                         Array_ptr& res) {
-    using IndicesArrayType = typename arrow::TypeTraits<IndicesArrowType>::ArrayType;
     using ResultArrayType = typename arrow::TypeTraits<ResultArrowType>::ArrayType;
-    auto dwn_indices = std::static_pointer_cast<IndicesArrayType>(indices);
-    auto raw_indices = dwn_indices->raw_values();
+    auto rows = partition.rows(group);
+    auto row_indices = partition.row_indices(group);
 
     auto raw_res = res->data()->template GetMutableValues<typename ResultArrowType::c_type>(1);
 
     if (f) {
-        auto df_filtered = evidence_values.take(indices);
-        auto sample = f->sample(n, df_filtered, seed);
+        auto sample = f->sample(rows, partition.data(group), seed);
 
         auto dwn_sample = std::static_pointer_cast<ResultArrayType>(sample);
         auto raw_sample = dwn_sample->raw_values();
 
-        for (auto i = 0; i < dwn_indices->length(); ++i) {
-            raw_res[raw_indices[i]] = raw_sample[i];
+        for (auto i = 0; i < rows; ++i) {
+            raw_res[row_indices[i]] = raw_sample[i];
         }
     } else {
-        for (auto i = 0; i < dwn_indices->length(); ++i) {
-            raw_res[raw_indices[i]] = util::nan<typename ResultArrowType::c_type>;
+        for (auto i = 0; i < rows; ++i) {
+            raw_res[row_indices[i]] = util::nan<typename ResultArrowType::c_type>;
         }
     }
 }
 
+// Samples the rows of each group of the partition with the factor of the group. The seed of each group is seed plus
+// its configuration.
 template <typename ResultArrowType>
-void sample_impl(std::vector<Array_ptr>& slice_builders,
-                 const std::vector<std::shared_ptr<Factor>>& factors,
-                 int n,
-                 const DataFrame& evidence_values,
+void sample_impl(const DiscretePartition& partition,
+                 const std::vector<std::shared_ptr<Factor>>& group_factors,
                  unsigned int seed,
                  Array_ptr& res) {
-    auto num_factors = factors.size();
-
-    for (size_t i = 0; i < num_factors; ++i) {
-        if (slice_builders[i]) {
-            sample_factor_impl<arrow::Int32Type, ResultArrowType>(
-                factors[i], n, evidence_values, seed + i, slice_builders[i], res);
+    for (auto g = 0; g < partition.num_groups(); ++g) {
+        if (partition.rows(g) > 0) {
+            sample_factor_impl<ResultArrowType>(group_factors[g], partition, g, seed + partition.configuration(g), res);
         }
     }
 }
@@ -476,8 +670,17 @@ Array_ptr DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::sample(int n,
     if (m_discrete_evidence.empty()) {
         return m_factors[0]->sample(n, evidence_values, seed);
     } else {
-        auto num_factors = m_factors.size();
-        auto slices = discrete_slice_indices(evidence_values, m_discrete_evidence, m_strides, num_factors);
+        DiscretePartition partition(evidence_values,
+                                    m_discrete_evidence,
+                                    m_strides,
+                                    m_cardinality.prod(),
+                                    evidence_values.loc(m_continuous_evidence));
+
+        std::vector<std::shared_ptr<Factor>> group_factors(partition.num_groups());
+        for (auto g = 0; g < partition.num_groups(); ++g) {
+            auto position = factor_position(partition.configuration(g));
+            if (position != -1) group_factors[g] = m_factors[position];
+        }
 
         Array_ptr res;
 
@@ -487,7 +690,7 @@ Array_ptr DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::sample(int n,
                 RAISE_STATUS_ERROR(builder.AppendEmptyValues(n));
                 RAISE_STATUS_ERROR(builder.Finish(&res));
 
-                sample_impl<arrow::DoubleType>(slices, m_factors, n, evidence_values, seed, res);
+                sample_impl<arrow::DoubleType>(partition, group_factors, seed, res);
                 break;
             }
             case Type::FLOAT: {
@@ -495,7 +698,7 @@ Array_ptr DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::sample(int n,
                 RAISE_STATUS_ERROR(builder.AppendEmptyValues(n));
                 RAISE_STATUS_ERROR(builder.Finish(&res));
 
-                sample_impl<arrow::FloatType>(slices, m_factors, n, evidence_values, seed, res);
+                sample_impl<arrow::FloatType>(partition, group_factors, seed, res);
                 break;
             }
             default:
@@ -517,7 +720,9 @@ py::tuple DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::__getstate__()
                           m_continuous_evidence,
                           m_cardinality,
                           m_strides,
-                          m_factors);
+                          m_factors,
+                          m_configurations,
+                          m_statistics_factors);
 }
 
 template <typename BaseFactor, typename BaseFitter, typename FactorName>
@@ -546,6 +751,83 @@ DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::__setstate__(py::tuple& t
         res.m_strides = t[8].cast<VectorXi>();
         // All the base factors are C++, so no need to keep Python object alive
         res.m_factors = t[9].cast<std::vector<std::shared_ptr<Factor>>>();
+        // The states without the configurations of the sparse factors have 10 elements, and the states without the
+        // factors of partial_fit() have 11 elements.
+        if (t.size() >= 11) res.m_configurations = t[10].cast<std::vector<int>>();
+        if (t.size() >= 12) {
+            res.m_statistics_factors = t[11].cast<std::vector<std::shared_ptr<Factor>>>();
+            // The fitted factors are the same objects as the factors of partial_fit().
+            if (res.m_statistics_factors.size() != res.m_factors.size())
+                throw std::runtime_error("Not valid DiscreteAdaptator.");
+            for (size_t k = 0, k_end = res.m_factors.size(); k < k_end; ++k) {
+                if (res.m_factors[k]) res.m_factors[k] = res.m_statistics_factors[k];
+            }
+        }
+        res.m_sparse = res.m_cardinality.cast<double>().prod() > sparse_configurations_threshold;
+
+        if (res.m_sparse && res.m_configurations.size() != res.m_factors.size())
+            throw std::runtime_error("Not valid DiscreteAdaptator.");
+    }
+
+    return res;
+}
+
+template <typename BaseFactor, typename BaseFitter, typename FactorName>
+void DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::write_binary(util::BinaryWriter& writer) const {
+    if (m_args->has_arguments()) {
+        throw std::invalid_argument("Factor " + ToString() +
+                                    " has additional arguments, so it cannot be saved in the binary format.");
+    }
+
+    writer.write(this->variable());
+    writer.write(this->evidence());
+    writer.write(m_fitted);
+
+    if (m_fitted) {
+        writer.write(m_discrete_evidence);
+        writer.write(m_discrete_values);
+        writer.write(m_continuous_evidence);
+        writer.write_matrix(m_cardinality);
+        writer.write_matrix(m_strides);
+        // The dense factors do not write the configurations, so their format does not depend on the sparse factors.
+        if (m_sparse) writer.write_matrix(Eigen::Map<const VectorXi>(m_configurations.data(), m_configurations.size()));
+
+        writer.write<std::uint64_t>(m_factors.size());
+        for (const auto& f : m_factors) {
+            // The configurations of the discrete evidence without data have no factor.
+            writer.write(f != nullptr);
+            if (f) static_cast<const BaseFactor&>(*f).write_binary(writer);
+        }
+    }
+}
+
+template <typename BaseFactor, typename BaseFitter, typename FactorName>
+DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>
+DiscreteAdaptator<BaseFactor, BaseFitter, FactorName>::read_binary(util::BinaryReader& reader) {
+    auto variable = reader.read_string();
+    DiscreteAdaptator<BaseFactor, BaseFitter, FactorName> res(variable, reader.read_strings());
+
+    res.m_fitted = reader.read_bool();
+
+    if (res.m_fitted) {
+        res.m_discrete_evidence = reader.read_strings();
+        res.m_discrete_values = reader.read_nested_strings();
+        res.m_continuous_evidence = reader.read_strings();
+        res.m_cardinality = reader.read_matrix<int>();
+        res.m_strides = reader.read_matrix<int>();
+        res.m_sparse = res.m_cardinality.cast<double>().prod() > sparse_configurations_threshold;
+        if (res.m_sparse) {
+            auto stored = reader.read_matrix<int>();
+            res.m_configurations.assign(stored.data(), stored.data() + stored.size());
+        }
+
+        res.m_factors.resize(reader.read_count(sizeof(std::uint8_t)));
+        for (auto& f : res.m_factors) {
+            if (reader.read_bool()) f = std::make_shared<BaseFactor>(BaseFactor::read_binary(reader));
+        }
+
+        if (res.m_sparse && res.m_configurations.size() != res.m_factors.size())
+            throw std::runtime_error("Not valid DiscreteAdaptator.");
     }
 
     return res;
@@ -1,8 +1,10 @@
+#include <algorithm>
+#include <iterator>
 #include <pybind11/stl.h>
 #include <pybind11/eigen.h>
 #include <factors/discrete/DiscreteFactor.hpp>
 #include <models/BayesianNetwork.hpp>
-#include <learning/parameters/mle_base.hpp>
+#include <learning/parameters/mle_DiscreteFactor.hpp>
 #include <util/math_constants.hpp>
 #include <fort.hpp>
 
@@ -34,42 +36,126 @@ std::shared_ptr<Factor> DiscreteFactorType::new_factor(const ConditionalBayesian
 void DiscreteFactor::fit(const DataFrame& df) {
     MLE<DiscreteFactor> mle;
 
-    auto params = mle.estimate(df, variable(), evidence());
+    set_fitted_params(df, mle.estimate(df, variable(), evidence()));
+}
+
+void DiscreteFactor::weighted_fit(const DataFrame& df, const VectorXd& weights) {
+    auto type = df.same_type(variable(), evidence());
+    if (type->id() != arrow::Type::DICTIONARY) {
+        throw std::invalid_argument("Wrong data type to fit DiscreteFactor. Categorical data is expected.");
+    }
+
+    set_fitted_params(df, learning::parameters::_fit_weighted(df, variable(), evidence(), weights));
+}
+
+namespace {
+
+// Merges the counts of the sorted configurations of a sparse factor with the counts of new_counts, returning the sorted
+// union of the configurations.
+std::vector<int> merge_sparse_counts(const std::vector<int>& configurations,
+                                     VectorXd& counts,
+                                     const factors::discrete::SparseJointCounts& new_counts,
+                                     int num_categories) {
+    const auto& new_configurations = new_counts.configurations;
+
+    std::vector<int> merged;
+    merged.reserve(configurations.size() + new_configurations.size());
+    std::set_union(configurations.begin(),
+                   configurations.end(),
+                   new_configurations.begin(),
+                   new_configurations.end(),
+                   std::back_inserter(merged));
+
+    VectorXd merged_counts = VectorXd::Zero(merged.size() * num_categories);
+    for (size_t k = 0, j = 0, l = 0; k < merged.size(); ++k) {
+        auto offset = k * num_categories;
+        if (j < configurations.size() && configurations[j] == merged[k]) {
+            merged_counts.segment(offset, num_categories) = counts.segment(j++ * num_categories, num_categories);
+        }
+        if (l < new_configurations.size() && new_configurations[l] == merged[k]) {
+            merged_counts.segment(offset, num_categories) +=
+                new_counts.counts.segment(l++ * num_categories, num_categories).cast<double>();
+        }
+    }
+
+    counts = std::move(merged_counts);
+    return merged;
+}
+
+}  // namespace
+
+void DiscreteFactor::partial_fit(const DataFrame& df, double forgetting) {
+    check_forgetting(forgetting);
+    if (m_fitted && !m_counts)
+        throw std::invalid_argument("The DiscreteFactor of " + variable() +
+                                    " was not fitted with partial_fit(), so it does not have sufficient statistics.");
+
+    auto type = df.same_type(variable(), evidence());
+    if (type->id() != arrow::Type::DICTIONARY) {
+        throw std::invalid_argument("Wrong data type to fit DiscreteFactor. Categorical data is expected.");
+    }
+
+    if (m_fitted) {
+        check_equal_domain(df);
+        *m_counts *= forgetting;
+    } else {
+        std::tie(m_cardinality, m_strides) =
+            factors::discrete::create_cardinality_strides(df, variable(), evidence());
+
+        m_variable_values = factors::discrete::discrete_column(df, variable())->categories;
+        m_evidence_values.clear();
+        m_evidence_values.reserve(evidence().size());
+        for (const auto& e : evidence()) {
+            m_evidence_values.push_back(factors::discrete::discrete_column(df, e)->categories);
+        }
+
+        set_configurations({});
+        m_counts = VectorXd::Zero(m_sparse ? 0 : m_cardinality.prod());
+    }
+
+    if (m_sparse) {
+        auto num_categories = m_cardinality(0);
+        auto batch = factors::discrete::sparse_joint_counts(df, variable(), evidence(), m_cardinality, m_strides);
+        set_configurations(merge_sparse_counts(m_configurations, *m_counts, batch, num_categories));
+
+        // The configurations without data are represented by one configuration with zero counts after the stored ones.
+        int num_configurations = m_configurations.size();
+        VectorXd counts = VectorXd::Zero((num_configurations + 1) * num_categories);
+        counts.head(m_counts->rows()) = *m_counts;
+
+        VectorXi table_cardinality(2);
+        table_cardinality << num_categories, num_configurations + 1;
+        m_logprob = learning::parameters::_fit_counts(counts, table_cardinality).logprob;
+    } else {
+        auto batch = factors::discrete::joint_counts(df, variable(), evidence(), m_cardinality, m_strides);
+        *m_counts += batch.cast<double>();
+        m_logprob = learning::parameters::_fit_counts(*m_counts, m_cardinality).logprob;
+    }
+
+    m_mapped_storage.reset();
+    m_mapped_logprob = nullptr;
+    m_fitted = true;
+}
 
-    m_logprob = params.logprob;
-    m_cardinality = params.cardinality;
+void DiscreteFactor::set_fitted_params(const DataFrame& df, ParamsClass params) {
+    m_counts.reset();
+    m_logprob = std::move(params.logprob);
+    m_mapped_storage.reset();
+    m_mapped_logprob = nullptr;
+    m_cardinality = std::move(params.cardinality);
     m_strides = VectorXi(m_cardinality.rows());
     m_strides(0) = 1;
     for (size_t i = 1, i_end = static_cast<size_t>(m_strides.rows()); i < i_end; ++i) {
         m_strides(i) = m_strides(i - 1) * m_cardinality(i - 1);
     }
+    set_configurations(std::move(params.configurations));
 
-    auto dict_variable = std::static_pointer_cast<arrow::DictionaryArray>(df.col(variable()));
-
-    factors::discrete::check_is_string_dictionary(dict_variable, variable());
-    auto dict_variable_values = std::static_pointer_cast<arrow::StringArray>(dict_variable->dictionary());
-
-    m_variable_values.clear();
-    m_variable_values.reserve(dict_variable_values->length());
-    for (auto i = 0; i < dict_variable_values->length(); ++i) {
-        m_variable_values.push_back(dict_variable_values->GetString(i));
-    }
+    m_variable_values = factors::discrete::discrete_column(df, variable())->categories;
 
     m_evidence_values.clear();
     m_evidence_values.reserve(evidence().size());
     for (auto it = evidence().begin(), end = evidence().end(); it != end; ++it) {
-        auto dict_evidence = std::static_pointer_cast<arrow::DictionaryArray>(df.col(*it));
-
-        factors::discrete::check_is_string_dictionary(dict_evidence, *it);
-        auto dict_evidence_values = std::static_pointer_cast<arrow::StringArray>(dict_evidence->dictionary());
-
-        std::vector<std::string> ev;
-        ev.reserve(dict_evidence_values->length());
-        for (auto j = 0; j < dict_evidence_values->length(); ++j) {
-            ev.push_back(dict_evidence_values->GetString(j));
-        }
-
-        m_evidence_values.push_back(ev);
+        m_evidence_values.push_back(factors::discrete::discrete_column(df, *it)->categories);
     }
 
     m_fitted = true;
@@ -84,31 +170,31 @@ void DiscreteFactor::check_equal_domain(const DataFrame& df) const {
 }
 
 VectorXd DiscreteFactor::_logl_null(const DataFrame& df) const {
-    VectorXi indices = discrete_indices<true>(df);
-
-    auto evidence_pair = std::make_pair(evidence().begin(), evidence().end());
-    auto combined_bitmap = df.combined_bitmap(variable(), evidence_pair);
+    auto logprob = logprob_table();
+    auto combined_bitmap = df.combined_bitmap(variable(), evidence());
     auto* bitmap_data = combined_bitmap->data();
 
     VectorXd res(df->num_rows());
-    for (auto i = 0, j = 0; i < indices.rows(); ++i) {
-        if (util::bit_util::GetBit(bitmap_data, i))
-            res(i) = m_logprob(indices(j++));
-        else
-            res(i) = util::nan<double>;
-    }
+    for_each_discrete_indices_block<true>(
+        df, variable(), evidence(), m_strides, combined_bitmap, [&](int offset, int length, const int* indices) {
+            for (auto k = 0; k < length; ++k) {
+                res(offset + k) = util::bit_util::GetBit(bitmap_data, offset + k) ? logprob(table_index(indices[k]))
+                                                                                  : util::nan<double>;
+            }
+        });
 
     return res;
 }
 
 VectorXd DiscreteFactor::_logl(const DataFrame& df) const {
-    VectorXi indices = discrete_indices<false>(df);
-
+    auto logprob = logprob_table();
     VectorXd res(df->num_rows());
-
-    for (auto i = 0; i < indices.rows(); ++i) {
-        res(i) = m_logprob(indices(i));
-    }
+    for_each_discrete_indices_block<false>(
+        df, variable(), evidence(), m_strides, nullptr, [&](int offset, int length, const int* indices) {
+            for (auto k = 0; k < length; ++k) {
+                res(offset + k) = logprob(table_index(indices[k]));
+            }
+        });
 
     return res;
 }
@@ -126,28 +212,30 @@ VectorXd DiscreteFactor::logl(const DataFrame& df) const {
 }
 
 double DiscreteFactor::_slogl_null(const DataFrame& df) const {
-    VectorXi indices = discrete_indices<true>(df);
-
-    auto evidence_pair = std::make_pair(evidence().begin(), evidence().end());
-    auto combined_bitmap = df.combined_bitmap(variable(), evidence_pair);
+    auto logprob = logprob_table();
+    auto combined_bitmap = df.combined_bitmap(variable(), evidence());
     auto* bitmap_data = combined_bitmap->data();
 
     double res = 0;
-    for (auto i = 0, j = 0; i < indices.rows(); ++i) {
-        if (util::bit_util::GetBit(bitmap_data, i)) res += m_logprob(indices(j++));
-    }
+    for_each_discrete_indices_block<true>(
+        df, variable(), evidence(), m_strides, combined_bitmap, [&](int offset, int length, const int* indices) {
+            for (auto k = 0; k < length; ++k) {
+                if (util::bit_util::GetBit(bitmap_data, offset + k)) res += logprob(table_index(indices[k]));
+            }
+        });
 
     return res;
 }
 
 double DiscreteFactor::_slogl(const DataFrame& df) const {
-    VectorXi indices = discrete_indices<false>(df);
-
+    auto logprob = logprob_table();
     double res = 0;
-
-    for (auto i = 0; i < indices.rows(); ++i) {
-        res += m_logprob(indices(i));
-    }
+    for_each_discrete_indices_block<false>(
+        df, variable(), evidence(), m_strides, nullptr, [&](int offset, int length, const int* indices) {
+            for (auto k = 0; k < length; ++k) {
+                res += logprob(table_index(indices[k]));
+            }
+        });
 
     return res;
 }
@@ -164,6 +252,54 @@ double DiscreteFactor::slogl(const DataFrame& df) const {
     }
 }
 
+void DiscreteFactor::alias_table(int offset, double* threshold, int* alias) const {
+    auto logprob = logprob_table();
+    int num_categories = m_variable_values.size();
+
+    std::vector<double> scaled(num_categories);
+    double sum = 0;
+    for (int j = 0; j < num_categories; ++j) {
+        scaled[j] = std::exp(logprob(offset + j));
+        sum += scaled[j];
+    }
+
+    // Vose's method: each category with less than the average probability is paired with a category with more.
+    std::vector<int> small, large;
+    for (int j = 0; j < num_categories; ++j) {
+        scaled[j] *= num_categories / sum;
+        if (scaled[j] < 1)
+            small.push_back(j);
+        else
+            large.push_back(j);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        int s = small.back();
+        small.pop_back();
+        int l = large.back();
+
+        threshold[s] = scaled[s];
+        alias[s] = l;
+
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // The remaining categories have probability 1 / num_categories (up to rounding errors).
+    for (auto j : small) {
+        threshold[j] = 1;
+        alias[j] = j;
+    }
+
+    for (auto j : large) {
+        threshold[j] = 1;
+        alias[j] = j;
+    }
+}
+
 Array_ptr DiscreteFactor::sample(int n, const DataFrame& evidence_values, unsigned int seed) const {
     if (n < 0) {
         throw std::invalid_argument("n should be a non-negative number");
@@ -226,10 +362,12 @@ std::string DiscreteFactor::ToString() const {
             table.range_write(e.begin(), e.end());
             table.range_write_ln(m_variable_values.begin(), m_variable_values.end());
 
-            auto parent_configurations = m_cardinality.bottomRows(e.size()).prod();
+            auto logprob = logprob_table();
+            // The sparse factors only show the stored configurations and the distribution of the rest.
+            int parent_configurations = sparse() ? m_configurations.size() : m_cardinality.bottomRows(e.size()).prod();
 
             for (auto k = 0; k < parent_configurations; ++k) {
-                double index = k * m_cardinality(0);
+                double index = (sparse() ? m_configurations[k] : k) * m_cardinality(0);
                 for (size_t j = 0; j < e.size(); ++j) {
                     auto assignment_index =
                         static_cast<int>(std::floor(index / m_strides(j + 1))) % m_cardinality(j + 1);
@@ -237,7 +375,18 @@ std::string DiscreteFactor::ToString() const {
                 }
 
                 for (auto i = 0; i < m_cardinality(0); ++i) {
-                    table << std::exp(m_logprob(index + i));
+                    table << std::exp(logprob(k * m_cardinality(0) + i));
+                }
+                table << fort::endr;
+            }
+
+            if (sparse()) {
+                for (size_t j = 0; j < e.size(); ++j) {
+                    table << "*";
+                }
+
+                for (auto i = 0; i < m_cardinality(0); ++i) {
+                    table << std::exp(logprob(parent_configurations * m_cardinality(0) + i));
                 }
                 table << fort::endr;
             }
@@ -259,7 +408,7 @@ std::string DiscreteFactor::ToString() const {
             table.row(1).set_cell_text_align(fort::text_align::center);
 
             for (auto i = 0; i < m_cardinality(0); ++i) {
-                table << std::exp(m_logprob(i));
+                table << std::exp(logprob()(i));
             }
             table << fort::endr;
             stream << table.to_string();
@@ -271,6 +420,36 @@ std::string DiscreteFactor::ToString() const {
     return stream.str();
 }
 
+util::MemoryUsage DiscreteFactor::memory_usage() const {
+    util::MemoryUsage usage;
+    usage.add("logprob", util::eigen_bytes(m_logprob));
+    // Each configuration of a sparse factor is also stored in the hash table of its positions.
+    usage.add("configurations",
+              util::vector_bytes(m_configurations) +
+                  m_configuration_positions.size() * (sizeof(std::pair<const int, int>) + sizeof(void*)));
+    if (m_counts) usage.add("counts", util::eigen_bytes(*m_counts));
+    return usage;
+}
+
+VectorXd DiscreteFactor::dense_logprob() const {
+    check_fitted();
+    if (!sparse()) return logprob();
+
+    auto logprob = logprob_table();
+    auto num_categories = m_cardinality(0);
+    int parent_configurations = m_cardinality.tail(m_cardinality.rows() - 1).prod();
+    VectorXd res(m_cardinality.prod());
+    for (auto k = 0; k < parent_configurations; ++k) {
+        auto offset = k * num_categories;
+        auto table_offset = table_index(offset);
+        for (auto i = 0; i < num_categories; ++i) {
+            res(offset + i) = logprob(table_offset + i);
+        }
+    }
+
+    return res;
+}
+
 py::tuple DiscreteFactor::__getstate__() const {
     std::vector<std::string> variable_values;
     std::vector<std::vector<std::string>> evidence_values;
@@ -279,14 +458,47 @@ py::tuple DiscreteFactor::__getstate__() const {
     if (m_fitted) {
         variable_values = m_variable_values;
         evidence_values = m_evidence_values;
-        logprob = m_logprob;
+        logprob = logprob_table();
     }
 
-    return py::make_tuple(variable(), evidence(), m_fitted, variable_values, evidence_values, logprob);
+    py::object counts = py::none();
+    if (m_counts) counts = py::cast(*m_counts);
+
+    return py::make_tuple(
+        variable(), evidence(), m_fitted, variable_values, evidence_values, logprob, m_configurations, counts);
+}
+
+void DiscreteFactor::set_configurations(std::vector<int> configurations) {
+    m_sparse = factors::discrete::sparse_configurations(m_cardinality);
+    m_configurations = std::move(configurations);
+
+    m_configuration_positions.clear();
+    for (int k = 0, k_end = m_configurations.size(); k < k_end; ++k) {
+        m_configuration_positions.insert({m_configurations[k], k});
+    }
+}
+
+void DiscreteFactor::compute_strides() {
+    VectorXi cardinality(evidence().size() + 1);
+    VectorXi strides(evidence().size() + 1);
+
+    cardinality(0) = m_variable_values.size();
+    strides(0) = 1;
+
+    int i = 1;
+    for (auto it = m_evidence_values.begin(), end = m_evidence_values.end(); it != end; ++it, ++i) {
+        cardinality(i) = it->size();
+        strides(i) = strides(i - 1) * cardinality(i - 1);
+    }
+
+    m_cardinality = std::move(cardinality);
+    m_strides = std::move(strides);
 }
 
 DiscreteFactor DiscreteFactor::__setstate__(py::tuple& t) {
-    if (t.size() != 6) throw std::runtime_error("Not valid DiscreteFactor.");
+    // The states without the configurations of the sparse factors have 6 elements, and the states without the counts
+    // of partial_fit() have 7 elements.
+    if (t.size() < 6 || t.size() > 8) throw std::runtime_error("Not valid DiscreteFactor.");
 
     DiscreteFactor dist(t[0].cast<std::string>(), t[1].cast<std::vector<std::string>>());
 
@@ -297,20 +509,69 @@ DiscreteFactor DiscreteFactor::__setstate__(py::tuple& t) {
         dist.m_evidence_values = t[4].cast<std::vector<std::vector<std::string>>>();
         dist.m_logprob = t[5].cast<VectorXd>();
 
-        VectorXi cardinality(dist.evidence().size() + 1);
-        VectorXi strides(dist.evidence().size() + 1);
+        dist.compute_strides();
+        dist.set_configurations(t.size() == 7 ? t[6].cast<std::vector<int>>() : std::vector<int>{});
+
+        auto size = dist.sparse() ? (dist.m_configurations.size() + 1) * dist.m_cardinality(0)
+                                  : dist.m_cardinality.prod();
+        if (static_cast<size_t>(dist.m_logprob.rows()) != static_cast<size_t>(size))
+            throw std::runtime_error("Not valid DiscreteFactor.");
+
+        if (t.size() == 8 && !t[7].is_none()) {
+            dist.m_counts = t[7].cast<VectorXd>();
+            auto counts_size = dist.sparse() ? size - dist.m_cardinality(0) : size;
+            if (static_cast<size_t>(dist.m_counts->rows()) != static_cast<size_t>(counts_size))
+                throw std::runtime_error("Not valid DiscreteFactor.");
+        }
+    }
+
+    return dist;
+}
+
+void DiscreteFactor::write_binary(util::BinaryWriter& writer) const {
+    writer.write(variable());
+    writer.write(evidence());
+    writer.write(m_fitted);
+
+    if (m_fitted) {
+        writer.write(m_variable_values);
+        writer.write(m_evidence_values);
+        // The dense factors do not write the configurations, so their format does not depend on the sparse factors.
+        if (sparse()) writer.write_matrix(Eigen::Map<const VectorXi>(m_configurations.data(), m_configurations.size()));
+        writer.write_matrix(logprob_table());
+    }
+}
+
+DiscreteFactor DiscreteFactor::read_binary(util::BinaryReader& reader) {
+    auto variable = reader.read_string();
+    DiscreteFactor dist(variable, reader.read_strings());
 
-        cardinality(0) = dist.m_variable_values.size();
-        strides(0) = 1;
+    dist.m_fitted = reader.read_bool();
 
-        int i = 1;
-        for (auto it = dist.m_evidence_values.begin(), end = dist.m_evidence_values.end(); it != end; ++it, ++i) {
-            cardinality(i) = it->size();
-            strides(i) = strides(i - 1) * cardinality(i - 1);
+    if (dist.m_fitted) {
+        dist.m_variable_values = reader.read_strings();
+        dist.m_evidence_values = reader.read_nested_strings();
+        dist.compute_strides();
+
+        std::vector<int> configurations;
+        if (factors::discrete::sparse_configurations(dist.m_cardinality)) {
+            auto stored = reader.read_matrix<int>();
+            configurations.assign(stored.data(), stored.data() + stored.size());
         }
+        dist.set_configurations(std::move(configurations));
 
-        dist.m_cardinality = std::move(cardinality);
-        dist.m_strides = std::move(strides);
+        auto logprob = reader.read_matrix<double>();
+        auto size = dist.sparse() ? (dist.m_configurations.size() + 1) * dist.m_cardinality(0)
+                                  : dist.m_cardinality.prod();
+        if (static_cast<size_t>(logprob.size()) != static_cast<size_t>(size))
+            throw std::runtime_error("Not valid DiscreteFactor.");
+
+        if (reader.memory_map()) {
+            dist.m_mapped_storage = reader.mapping();
+            dist.m_mapped_logprob = logprob.data();
+        } else {
+            dist.m_logprob = logprob;
+        }
     }
 
     return dist;
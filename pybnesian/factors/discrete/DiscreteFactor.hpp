@@ -1,13 +1,15 @@
 #ifndef PYBNESIAN_FACTORS_DISCRETE_DISCRETEFACTOR_HPP
 #define PYBNESIAN_FACTORS_DISCRETE_DISCRETEFACTOR_HPP
 
+#include <optional>
 #include <random>
 #include <dataset/dataset.hpp>
 #include <factors/factors.hpp>
 #include <factors/discrete/discrete_indices.hpp>
+#include <util/philox.hpp>
 
 using dataset::DataFrame;
-using Eigen::VectorXd, Eigen::VectorXi;
+using Eigen::VectorXd, Eigen::VectorXi, Eigen::Map;
 using factors::FactorType;
 
 using Array_ptr = std::shared_ptr<arrow::Array>;
@@ -54,6 +56,8 @@ private:
 struct DiscreteFactor_Params {
     VectorXd logprob;
     VectorXi cardinality;
+    // The parent configurations of the table if sparse_configurations(cardinality). See logprob_table().
+    std::vector<int> configurations;
 };
 
 class DiscreteFactor : public Factor {
@@ -66,8 +70,12 @@ public:
           m_variable_values(),
           m_evidence_values(),
           m_logprob(),
+          m_mapped_storage(),
           m_cardinality(),
           m_strides(),
+          m_configurations(),
+          m_configuration_positions(),
+          m_sparse(false),
           m_fitted(false) {}
 
     std::shared_ptr<FactorType> type() const override { return DiscreteFactorType::get(); }
@@ -97,12 +105,60 @@ public:
     }
     bool fitted() const override { return m_fitted; }
     void fit(const DataFrame& df) override;
+    // Adds the joint counts of df to the (weighted) counts of the previous calls and fits the parameters with them.
+    // The categories of the variables are read from the first df, and the next DataFrames must have the same
+    // categories. The sparse factors store the counts of the configurations that appear in any df.
+    void partial_fit(const DataFrame& df, double forgetting = 1) override;
+    // Fits the parameters with the weighted joint counts of df, so an integer weight is equivalent to repeating the
+    // row.
+    void weighted_fit(const DataFrame& df, const VectorXd& weights) override;
+    // Sets the parameters estimated with df (e.g., from counts computed outside of fit()). The categories of the
+    // variables are read from df.
+    void set_fitted_params(const DataFrame& df, ParamsClass params);
     VectorXd logl(const DataFrame& df) const override;
     double slogl(const DataFrame& df) const override;
 
     void check_equal_domain(const DataFrame& df) const;
 
     std::string ToString() const override;
+    // The log-probability table (if it is not memory-mapped), the configurations of a sparse factor and the counts of
+    // partial_fit().
+    util::MemoryUsage memory_usage() const override;
+
+    // Returns the log-probability table, indexed by the discrete_indices() of the assignments. The table is owned by
+    // the factor or is in a memory-mapped file (see read_binary()). The sparse factors do not have a dense table (see
+    // dense_logprob()).
+    Map<const VectorXd> logprob() const {
+        if (sparse()) throw std::invalid_argument("The log-probability table of a sparse DiscreteFactor is not dense.");
+        return logprob_table();
+    }
+    // Returns the log-probability table of all the configurations, also for the sparse factors.
+    VectorXd dense_logprob() const;
+    const VectorXi& strides() const { return m_strides; }
+
+    // A DiscreteFactor with more than sparse_configurations_threshold parent configurations is sparse: it only stores
+    // the probabilities of the parent configurations that appear in the fitted data, and the rest of configurations
+    // have a uniform distribution (as the configurations without data in a dense factor).
+    bool sparse() const { return m_sparse; }
+    // The parent configurations stored in a sparse factor, in increasing order.
+    const std::vector<int>& configurations() const { return m_configurations; }
+    // Returns the stored table: the dense table, or the tables of the configurations() followed by the uniform
+    // distribution of the rest of configurations in a sparse factor.
+    Map<const VectorXd> logprob_table() const {
+        auto size = sparse() ? (m_configurations.size() + 1) * m_cardinality(0) : m_cardinality.prod();
+        if (m_mapped_logprob) return Map<const VectorXd>(m_mapped_logprob, size);
+        return Map<const VectorXd>(m_logprob.data(), m_logprob.rows());
+    }
+    // Returns the position in logprob_table() of a discrete_indices() of the assignments.
+    int table_index(int index) const {
+        if (!sparse()) return index;
+
+        auto num_categories = m_cardinality(0);
+        auto found = m_configuration_positions.find(index / num_categories);
+        int position =
+            (found != m_configuration_positions.end()) ? found->second : static_cast<int>(m_configurations.size());
+        return position * num_categories + index % num_categories;
+    }
 
     VectorXi discrete_indices(const DataFrame& df) const {
         return factors::discrete::discrete_indices(df, variable(), evidence(), m_strides);
@@ -121,48 +177,54 @@ public:
     static DiscreteFactor __setstate__(py::tuple& t);
     static DiscreteFactor __setstate__(py::tuple&& t) { return __setstate__(t); }
 
+    // The joint counts of partial_fit() are not saved in the binary format.
+    void write_binary(util::BinaryWriter& writer) const;
+    static DiscreteFactor read_binary(util::BinaryReader& reader);
+
 private:
     void check_fitted() const {
         if (!fitted()) throw std::invalid_argument("DiscreteFactor factor not fitted.");
     }
 
+    // Computes the cardinality and strides of the variable and evidence from their values.
+    void compute_strides();
+    // Sets the configurations of a sparse factor and their positions, after the cardinality is set.
+    void set_configurations(std::vector<int> configurations);
+
     VectorXd _logl(const DataFrame& df) const;
     VectorXd _logl_null(const DataFrame& df) const;
     double _slogl(const DataFrame& df) const;
     double _slogl_null(const DataFrame& df) const;
 
+    // Builds the Walker alias table of the distribution at offset in logprob_table(): the category j is sampled
+    // with probability threshold[j], and alias[j] is sampled otherwise. A sample is drawn in constant time.
+    void alias_table(int offset, double* threshold, int* alias) const;
     template <typename ArrowType>
     Array_ptr sample_indices(int n, const DataFrame& evidence_values, unsigned int seed) const;
 
     std::vector<std::string> m_variable_values;
     std::vector<std::vector<std::string>> m_evidence_values;
     VectorXd m_logprob;
+    // The log-probability table in a memory-mapped file. If it is not null, it is used instead of m_logprob.
+    std::shared_ptr<const void> m_mapped_storage;
+    const double* m_mapped_logprob = nullptr;
     VectorXi m_cardinality;
     VectorXi m_strides;
+    std::vector<int> m_configurations;
+    std::unordered_map<int, int> m_configuration_positions;
+    bool m_sparse = false;
     bool m_fitted;
+    // The joint counts of partial_fit(), in the order of logprob_table() (without the uniform distribution of the
+    // configurations without data of a sparse factor).
+    std::optional<VectorXd> m_counts;
 };
 
 template <typename ArrowType>
 Array_ptr DiscreteFactor::sample_indices(int n, const DataFrame& evidence_values, unsigned int seed) const {
-    int parent_configurations = m_logprob.rows() / m_variable_values.size();
-    VectorXd accum_prob(m_logprob.rows());
-
-    for (auto i = 0; i < parent_configurations; ++i) {
-        auto offset = i * m_variable_values.size();
-
-        accum_prob(offset) = std::exp(m_logprob(offset));
-        for (size_t j = 1, end = m_variable_values.size() - 1; j < end; ++j) {
-            accum_prob(offset + j) = accum_prob(offset + j - 1) + std::exp(m_logprob(offset + j));
-        }
-    }
-
-    std::mt19937 rng{seed};
-    std::uniform_int_distribution<> uniform(0, 1);
-
-    using CType = typename ArrowType::c_type;
-    arrow::NumericBuilder<ArrowType> builder;
-    RAISE_STATUS_ERROR(builder.Resize(n));
+    int num_categories = m_variable_values.size();
 
+    // The offset in logprob_table() of the parent configuration of each row.
+    VectorXi parent_offset;
     if (!evidence().empty()) {
         if (!evidence_values.has_columns(evidence()))
             throw std::domain_error("Evidence values not present for sampling.");
@@ -171,36 +233,45 @@ Array_ptr DiscreteFactor::sample_indices(int n, const DataFrame& evidence_values
         if (evidence_values.null_count(evidence()) > 0)
             throw std::domain_error("Evidence values contain null rows in the evidence variables.");
 
-        auto parent_offset =
+        parent_offset =
             factors::discrete::discrete_indices(evidence_values, evidence(), m_strides.tail(evidence().size()));
-
-        for (auto i = 0; i < n; ++i) {
-            double random_number = uniform(rng);
-
-            CType index = m_variable_values.size() - 1;
-            for (size_t j = 0, end = m_variable_values.size() - 1; j < end; ++j) {
-                if (random_number < accum_prob(parent_offset(i) + j)) {
-                    index = j;
-                    break;
-                }
+        if (sparse()) {
+            for (auto i = 0; i < n; ++i) {
+                parent_offset(i) = table_index(parent_offset(i));
             }
-            builder.UnsafeAppend(index);
         }
     } else {
-        for (auto i = 0; i < n; ++i) {
-            double random_number = uniform(rng);
-
-            CType index = m_variable_values.size() - 1;
-            for (size_t j = 0, end = m_variable_values.size() - 1; j < end; ++j) {
-                if (random_number < accum_prob(j)) {
-                    index = j;
-                    break;
-                }
-            }
-            builder.UnsafeAppend(index);
+        parent_offset = VectorXi::Zero(n);
+    }
+
+    // The alias tables are only built for the parent configurations of the evidence, in order of appearance.
+    std::vector<int> alias_offset(logprob_table().rows() / num_categories, -1);
+    std::vector<double> threshold;
+    std::vector<int> alias;
+    for (auto i = 0; i < n; ++i) {
+        auto& offset = alias_offset[parent_offset(i) / num_categories];
+        if (offset == -1) {
+            offset = threshold.size();
+            threshold.resize(offset + num_categories);
+            alias.resize(offset + num_categories);
+            alias_table(parent_offset(i), threshold.data() + offset, alias.data() + offset);
         }
     }
 
+
+    using CType = typename ArrowType::c_type;
+    arrow::NumericBuilder<ArrowType> builder;
+    RAISE_STATUS_ERROR(builder.Resize(n));
+
+    for (auto i = 0; i < n; ++i) {
+        auto offset = alias_offset[parent_offset(i) / num_categories];
+
+        double u = util::philox::uniform(i, seed) * num_categories;
+        int category = std::min(static_cast<int>(u), num_categories - 1);
+        CType index = (u - category < threshold[offset + category]) ? category : alias[offset + category];
+        builder.UnsafeAppend(index);
+    }
+
     std::shared_ptr<arrow::Array> out;
     RAISE_STATUS_ERROR(builder.Finish(&out));
 
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <numeric>
+#include <factors/discrete/bit_sliced_index.hpp>
+#include <util/bit_util.hpp>
+
+namespace factors::discrete {
+
+namespace {
+
+using ColumnBitmaps = BitSlicedIndex::ColumnBitmaps;
+
+template <typename ArrowType>
+void fill_bitmaps(ColumnBitmaps& bitmaps, const Array_ptr& indices, int64_t num_words) {
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+    auto dwn_indices = std::static_pointer_cast<ArrayType>(indices);
+
+    auto set_row = [&](int64_t i) {
+        auto category = static_cast<int64_t>(dwn_indices->Value(i));
+        auto bit = uint64_t{1} << (i & 63);
+        if (bitmaps.num_planes == 0) {
+            bitmaps.words[category * num_words + (i >> 6)] |= bit;
+        } else {
+            for (int p = 0; p < bitmaps.num_planes; ++p) {
+                if ((category >> p) & 1) bitmaps.words[p * num_words + (i >> 6)] |= bit;
+            }
+        }
+    };
+
+    if (indices->null_count() == 0) {
+        for (int64_t i = 0; i < indices->length(); ++i) {
+            set_row(i);
+        }
+    } else {
+        for (int64_t i = 0; i < indices->length(); ++i) {
+            if (dwn_indices->IsValid(i)) {
+                set_row(i);
+                if (bitmaps.num_planes > 0) bitmaps.valid[i >> 6] |= uint64_t{1} << (i & 63);
+            }
+        }
+    }
+}
+
+// Number of bits of the category indices of a bit-packed column.
+int num_planes(int cardinality) {
+    int planes = 1;
+    while ((1 << planes) < cardinality) ++planes;
+    return planes;
+}
+
+// Calls f(category) where category(w) returns the w-th word of the bitmap of a category. The words of a bit-packed
+// column are computed from its planes: tail masks the rows after the end of the data in the last word, where the
+// planes of the columns without nulls are 0 (category 0).
+template <typename F>
+void visit_category(const ColumnBitmaps& column, int category, int64_t num_words, uint64_t tail, F&& f) {
+    if (column.num_planes == 0) {
+        const auto* words = column.words.data() + category * num_words;
+        f([words](int64_t w) { return words[w]; });
+    } else {
+        const auto* planes = column.words.data();
+        const auto* valid = column.valid.empty() ? nullptr : column.valid.data();
+        const auto num_planes = column.num_planes;
+        f([=](int64_t w) {
+            uint64_t word = valid ? valid[w] : (w + 1 == num_words ? tail : ~uint64_t{0});
+            for (int p = 0; p < num_planes; ++p) {
+                auto plane = planes[p * num_words + w];
+                word &= ((category >> p) & 1) ? plane : ~plane;
+            }
+            return word;
+        });
+    }
+}
+
+// Order in which the variables of a table are intersected: the variables with less categories go first, so that less
+// intermediate bitmaps are created.
+std::vector<int> intersection_order(const VectorXi& cardinality) {
+    std::vector<int> order(cardinality.rows());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(), [&cardinality](int a, int b) { return cardinality(a) < cardinality(b); });
+    return order;
+}
+
+struct CountState {
+    std::vector<const ColumnBitmaps*> columns;
+    std::vector<int> cardinality;
+    std::vector<int> strides;
+    std::vector<std::vector<uint64_t>> buffers;
+    int64_t num_words;
+    uint64_t tail;
+};
+
+// Returns the bitmap of a category. The bitmap of a bit-packed column is computed in buffer.
+const uint64_t* category_rows(const CountState& state, int category, std::vector<uint64_t>& buffer) {
+    const auto& column = *state.columns[0];
+    if (column.num_planes == 0) return column.words.data() + category * state.num_words;
+
+    visit_category(column, category, state.num_words, state.tail, [&](auto category_word) {
+        for (int64_t w = 0; w < state.num_words; ++w) {
+            buffer[w] = category_word(w);
+        }
+    });
+
+    return buffer.data();
+}
+
+void count_configurations(CountState& state, size_t level, const uint64_t* rows, int offset, VectorXi& counts) {
+    const auto num_words = state.num_words;
+    const auto& column = *state.columns[level];
+
+    if (level + 1 == state.columns.size()) {
+        for (int c = 0; c < state.cardinality[level]; ++c) {
+            visit_category(column, c, num_words, state.tail, [&](auto category_word) {
+                int count = 0;
+                for (int64_t w = 0; w < num_words; ++w) {
+                    count += util::bit_util::PopCount(rows[w] & category_word(w));
+                }
+
+                counts(offset + c * state.strides[level]) = count;
+            });
+        }
+    } else {
+        auto* buffer = state.buffers[level].data();
+        for (int c = 0; c < state.cardinality[level]; ++c) {
+            uint64_t any = 0;
+            visit_category(column, c, num_words, state.tail, [&](auto category_word) {
+                for (int64_t w = 0; w < num_words; ++w) {
+                    buffer[w] = rows[w] & category_word(w);
+                    any |= buffer[w];
+                }
+            });
+
+            if (any) count_configurations(state, level + 1, buffer, offset + c * state.strides[level], counts);
+        }
+    }
+}
+
+}  // namespace
+
+bool BitSlicedIndex::is_efficient(const VectorXi& cardinality) {
+    auto order = intersection_order(cardinality);
+
+    int64_t intersections = 0;
+    int64_t configurations = cardinality(order[0]);
+    for (size_t i = 1; i < order.size(); ++i) {
+        configurations *= cardinality(order[i]);
+        intersections += configurations;
+    }
+
+    return intersections <= static_cast<int64_t>(max_cells_per_variable) * cardinality.rows();
+}
+
+const BitSlicedIndex::ColumnBitmaps& BitSlicedIndex::bitmaps(const std::string& variable) const {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_bitmaps.find(variable);
+        if (it != m_bitmaps.end()) return *it->second;
+    }
+
+    auto dict = std::static_pointer_cast<arrow::DictionaryArray>(m_df.col(variable));
+    auto indices = dict->indices();
+
+    auto bitmaps = std::make_shared<ColumnBitmaps>();
+    bitmaps->cardinality = dict->dictionary()->length();
+    if (bitmaps->cardinality <= max_packed_cardinality) {
+        bitmaps->num_planes = num_planes(bitmaps->cardinality);
+        bitmaps->words.resize(bitmaps->num_planes * m_num_words, 0);
+        if (indices->null_count() > 0) bitmaps->valid.resize(m_num_words, 0);
+    } else {
+        bitmaps->num_planes = 0;
+        bitmaps->words.resize(bitmaps->cardinality * m_num_words, 0);
+    }
+
+    switch (indices->type_id()) {
+        case Type::INT8:
+            fill_bitmaps<arrow::Int8Type>(*bitmaps, indices, m_num_words);
+            break;
+        case Type::INT16:
+            fill_bitmaps<arrow::Int16Type>(*bitmaps, indices, m_num_words);
+            break;
+        case Type::INT32:
+            fill_bitmaps<arrow::Int32Type>(*bitmaps, indices, m_num_words);
+            break;
+        case Type::INT64:
+            fill_bitmaps<arrow::Int64Type>(*bitmaps, indices, m_num_words);
+            break;
+        default:
+            throw std::invalid_argument("Wrong indices array type of DictionaryArray.");
+    }
+
+    // If other thread created the bitmaps meanwhile, its bitmaps are kept.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return *m_bitmaps.emplace(variable, std::move(bitmaps)).first->second;
+}
+
+std::size_t BitSlicedIndex::memory() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::size_t res = 0;
+    for (const auto& e : m_bitmaps) {
+        res += (e.second->words.size() + e.second->valid.size()) * sizeof(uint64_t);
+    }
+    return res;
+}
+
+VectorXi BitSlicedIndex::joint_counts(const std::string& variable,
+                                      const std::vector<std::string>& evidence,
+                                      const VectorXi& cardinality,
+                                      const VectorXi& strides) const {
+    if (!is_efficient(cardinality)) {
+        return factors::discrete::joint_counts(m_df, variable, evidence, cardinality, strides);
+    }
+
+    VectorXi counts = VectorXi::Zero(cardinality.prod());
+    if (m_num_words == 0) return counts;
+
+    CountState state;
+    state.num_words = m_num_words;
+    auto tail_rows = m_df->num_rows() & 63;
+    state.tail = tail_rows == 0 ? ~uint64_t{0} : (uint64_t{1} << tail_rows) - 1;
+    for (auto i : intersection_order(cardinality)) {
+        const auto& name = (i == 0) ? variable : evidence[i - 1];
+        state.columns.push_back(&bitmaps(name));
+        state.cardinality.push_back(cardinality(i));
+        state.strides.push_back(strides(i));
+    }
+
+    state.buffers.resize(state.columns.size());
+    for (size_t level = 0; level + 1 < state.columns.size(); ++level) {
+        state.buffers[level].resize(m_num_words);
+    }
+
+    if (state.columns.size() == 1) {
+        // Without evidence, the counts are the number of rows of each category.
+        for (int c = 0; c < state.cardinality[0]; ++c) {
+            visit_category(*state.columns[0], c, m_num_words, state.tail, [&](auto category_word) {
+                int count = 0;
+                for (int64_t w = 0; w < m_num_words; ++w) {
+                    count += util::bit_util::PopCount(category_word(w));
+                }
+
+                counts(c * state.strides[0]) = count;
+            });
+        }
+    } else {
+        for (int c = 0; c < state.cardinality[0]; ++c) {
+            const auto* rows = category_rows(state, c, state.buffers[0]);
+            count_configurations(state, 1, rows, c * state.strides[0], counts);
+        }
+    }
+
+    return counts;
+}
+
+}  // namespace factors::discrete
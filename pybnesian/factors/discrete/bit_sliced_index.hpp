@@ -0,0 +1,72 @@
+#ifndef PYBNESIAN_FACTORS_DISCRETE_BIT_SLICED_INDEX_HPP
+#define PYBNESIAN_FACTORS_DISCRETE_BIT_SLICED_INDEX_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <dataset/dataset.hpp>
+#include <factors/discrete/discrete_indices.hpp>
+
+using dataset::DataFrame;
+using Eigen::VectorXi;
+
+namespace factors::discrete {
+
+// A bit-sliced index of the discrete columns of a DataFrame. For each category of a column, it stores a bitmap with
+// the rows that take that category (the null rows are not set in any bitmap). The columns with at most
+// max_packed_cardinality categories are bit-packed instead: they store a bitmap for each bit of the category indices
+// (and a validity bitmap if the column contains nulls), and the bitmap of a category is computed word by word when it
+// is intersected. Then, a binary column takes 1 bit per row and a column with 3 or 4 categories takes 2 bits per row.
+//
+// The joint counts of a set of variables are computed by intersecting the bitmaps of each configuration and counting
+// the set bits, so each configuration costs rows / 64 word operations. The configurations whose prefix has no rows are
+// pruned. This is faster than joint_counts() when the contingency table is small compared to the number of rows.
+//
+// The bitmaps of a column are created the first time the column is used. The index can be used from multiple threads.
+class BitSlicedIndex {
+public:
+    // Maximum number of intersected bitmaps (per variable of the table) for which the bit-sliced counting is used.
+    static constexpr int max_cells_per_variable = 16;
+    // Maximum number of categories of the bit-packed columns.
+    static constexpr int max_packed_cardinality = 8;
+
+    BitSlicedIndex(const DataFrame& df)
+        : m_df(df), m_num_words((df->num_rows() + 63) / 64), m_mutex(), m_bitmaps() {}
+
+    // Returns true if the joint counts of a table with this cardinality are faster to compute with the bitmaps.
+    static bool is_efficient(const VectorXi& cardinality);
+
+    // Returns the joint counts of variable and evidence. The result is identical to factors::discrete::joint_counts().
+    // If the table is not is_efficient(), the counts are computed with factors::discrete::joint_counts().
+    VectorXi joint_counts(const std::string& variable,
+                          const std::vector<std::string>& evidence,
+                          const VectorXi& cardinality,
+                          const VectorXi& strides) const;
+
+    // The bitmaps of a column.
+    struct ColumnBitmaps {
+        int cardinality;
+        // Number of bits of the category indices if the column is bit-packed, or 0 if it stores a bitmap for each
+        // category.
+        int num_planes;
+        // The bitmap of each category, or the bitmap of each bit of the category indices.
+        std::vector<uint64_t> words;
+        // The valid rows of a bit-packed column. It is empty if the column does not contain nulls.
+        std::vector<uint64_t> valid;
+    };
+
+    // Number of bytes of the bitmaps created.
+    std::size_t memory() const;
+
+private:
+    const ColumnBitmaps& bitmaps(const std::string& variable) const;
+
+    const DataFrame m_df;
+    int64_t m_num_words;
+    mutable std::mutex m_mutex;
+    mutable std::unordered_map<std::string, std::shared_ptr<const ColumnBitmaps>> m_bitmaps;
+};
+
+}  // namespace factors::discrete
+
+#endif  // PYBNESIAN_FACTORS_DISCRETE_BIT_SLICED_INDEX_HPP
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <factors/discrete/discrete_columns.hpp>
+#include <factors/discrete/discrete_indices.hpp>
+#include <util/hash_utils.hpp>
+
+namespace factors::discrete {
+
+std::size_t DiscreteColumnRegistry::KeyHash::operator()(const Key& key) const {
+    std::size_t seed = std::hash<const void*>{}(key.indices);
+    util::hash_combine(seed, key.offset);
+    util::hash_combine(seed, key.length);
+    util::hash_combine(seed, key.categories);
+    util::hash_combine(seed, key.categories_offset);
+    util::hash_combine(seed, key.num_categories);
+    return seed;
+}
+
+std::shared_ptr<const DiscreteColumn> create_discrete_column(const std::shared_ptr<arrow::DictionaryArray>& dict,
+                                                             const std::string& variable) {
+    check_is_string_dictionary(dict, variable);
+
+    auto res = std::make_shared<DiscreteColumn>();
+
+    auto indices = dict->indices();
+    res->index_type = indices->type_id();
+    switch (res->index_type) {
+        case Type::INT8:
+            res->raw_indices = std::static_pointer_cast<arrow::Int8Array>(indices)->raw_values();
+            break;
+        case Type::INT16:
+            res->raw_indices = std::static_pointer_cast<arrow::Int16Array>(indices)->raw_values();
+            break;
+        case Type::INT32:
+            res->raw_indices = std::static_pointer_cast<arrow::Int32Array>(indices)->raw_values();
+            break;
+        case Type::INT64:
+            res->raw_indices = std::static_pointer_cast<arrow::Int64Array>(indices)->raw_values();
+            break;
+        default:
+            throw std::invalid_argument("Wrong indices array type of DictionaryArray.");
+    }
+
+    auto categories = std::static_pointer_cast<arrow::StringArray>(dict->dictionary());
+    res->cardinality = categories->length();
+    res->categories.reserve(categories->length());
+    for (auto i = 0; i < categories->length(); ++i) {
+        res->categories.push_back(categories->GetString(i));
+    }
+
+    return res;
+}
+
+std::shared_ptr<const DiscreteColumn> DiscreteColumnRegistry::get(const Array_ptr& column,
+                                                                  const std::string& variable) {
+    if (column->type_id() != Type::DICTIONARY)
+        throw std::invalid_argument("Variable " + variable + " is not categorical.");
+
+    auto dict = std::static_pointer_cast<arrow::DictionaryArray>(column);
+    const auto& indices_buffer = dict->indices()->data()->buffers[1];
+    const auto& categories_buffer = dict->dictionary()->data()->buffers[1];
+
+    // Empty columns are not registered.
+    if (!indices_buffer || !categories_buffer) return create_discrete_column(dict, variable);
+
+    Key key{indices_buffer->data(),
+            column->offset(),
+            column->length(),
+            categories_buffer->data(),
+            dict->dictionary()->offset(),
+            dict->dictionary()->length()};
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end() && !it->second.expired()) return it->second.column;
+    }
+
+    auto res = create_discrete_column(dict, variable);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_entries.find(key); it != m_entries.end()) {
+        if (!it->second.expired()) return it->second.column;
+
+        // The address of an expired entry was reused by new data.
+        m_entries.erase(it);
+        m_order.erase(std::find(m_order.begin(), m_order.end(), key));
+    }
+
+    // Remove the entries of the data that does not exist anymore, and then the oldest entries.
+    for (auto it = m_order.begin(); it != m_order.end();) {
+        auto e = m_entries.find(*it);
+        if (e->second.expired()) {
+            m_entries.erase(e);
+            it = m_order.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    while (m_order.size() >= max_entries) {
+        m_entries.erase(m_order.front());
+        m_order.pop_front();
+    }
+
+    m_order.push_back(key);
+    m_entries.emplace(key, Entry{indices_buffer, categories_buffer, res});
+    return res;
+}
+
+}  // namespace factors::discrete
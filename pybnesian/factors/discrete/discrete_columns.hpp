@@ -0,0 +1,96 @@
+#ifndef PYBNESIAN_FACTORS_DISCRETE_DISCRETE_COLUMNS_HPP
+#define PYBNESIAN_FACTORS_DISCRETE_DISCRETE_COLUMNS_HPP
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <dataset/dataset.hpp>
+
+using dataset::DataFrame;
+
+namespace factors::discrete {
+
+// A validated discrete (string dictionary) column.
+struct DiscreteColumn {
+    // Type of the indices of the DictionaryArray (INT8, INT16, INT32 or INT64).
+    arrow::Type::type index_type;
+    // The indices of the DictionaryArray, with the offset of the array applied.
+    const void* raw_indices;
+    int cardinality;
+    std::vector<std::string> categories;
+};
+
+// A process-wide registry of the discrete columns of the DataFrames. Each dictionary column is validated (and its
+// categories are extracted) once, instead of on every fit(), logl() or count of the discrete factors, scores and
+// independence tests. As dataset::DerivedColumnCache, the columns are identified by the address of their data and an
+// entry is valid while the data of its column is alive.
+//
+// The entries are evicted in FIFO order when the registry contains more than max_entries columns.
+class DiscreteColumnRegistry {
+public:
+    static constexpr std::size_t max_entries = 1 << 12;
+
+    static DiscreteColumnRegistry& shared() {
+        static DiscreteColumnRegistry registry;
+        return registry;
+    }
+
+    // Returns the DiscreteColumn of column. It throws std::invalid_argument if column is not a DictionaryArray with
+    // string categories. variable is the name of the column in the error messages.
+    std::shared_ptr<const DiscreteColumn> get(const Array_ptr& column, const std::string& variable);
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_order.clear();
+    }
+
+private:
+    DiscreteColumnRegistry() : m_mutex(), m_entries(), m_order() {}
+
+    struct Key {
+        const void* indices;
+        int64_t offset;
+        int64_t length;
+        const void* categories;
+        int64_t categories_offset;
+        int64_t num_categories;
+
+        bool operator==(const Key& other) const {
+            return indices == other.indices && offset == other.offset && length == other.length &&
+                   categories == other.categories && categories_offset == other.categories_offset &&
+                   num_categories == other.num_categories;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        // The indices and the categories of the column. The entry is not valid if any has expired.
+        std::weak_ptr<arrow::Buffer> indices;
+        std::weak_ptr<arrow::Buffer> categories;
+        std::shared_ptr<const DiscreteColumn> column;
+
+        bool expired() const { return indices.expired() || categories.expired(); }
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    std::deque<Key> m_order;
+};
+
+// Returns the DiscreteColumn of the column variable of df.
+inline std::shared_ptr<const DiscreteColumn> discrete_column(const DataFrame& df, const std::string& variable) {
+    return DiscreteColumnRegistry::shared().get(df.col(variable), variable);
+}
+
+}  // namespace factors::discrete
+
+#endif  // PYBNESIAN_FACTORS_DISCRETE_DISCRETE_COLUMNS_HPP
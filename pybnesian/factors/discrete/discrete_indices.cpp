@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
 #include <factors/discrete/discrete_indices.hpp>
+#include <factors/factors.hpp>
+#include <util/simd.hpp>
 
 namespace factors::discrete {
 
@@ -51,6 +56,70 @@ void sum_to_discrete_indices(VectorXi& accum_indices, Array_ptr& indices, int st
     }
 }
 
+namespace {
+
+template <typename IndexType>
+void accumulate_discrete_indices(const void* raw_indices, int offset, int length, int stride, int* block) {
+    util::simd::accumulate_strided(static_cast<const IndexType*>(raw_indices) + offset, length, stride, block);
+}
+
+DiscreteIndicesColumn discrete_indices_column(arrow::Type::type index_type, const void* raw_indices, int stride) {
+    switch (index_type) {
+        case Type::INT8:
+            return DiscreteIndicesColumn{raw_indices, stride, accumulate_discrete_indices<int8_t>};
+        case Type::INT16:
+            return DiscreteIndicesColumn{raw_indices, stride, accumulate_discrete_indices<int16_t>};
+        case Type::INT32:
+            return DiscreteIndicesColumn{raw_indices, stride, accumulate_discrete_indices<int32_t>};
+        case Type::INT64:
+            return DiscreteIndicesColumn{raw_indices, stride, accumulate_discrete_indices<int64_t>};
+        default:
+            throw std::invalid_argument("Wrong indices array type of DictionaryArray.");
+    }
+}
+
+}  // namespace
+
+DiscreteIndicesColumn discrete_indices_column(const Array_ptr& column, int stride) {
+    auto dict = std::static_pointer_cast<arrow::DictionaryArray>(column);
+    auto indices = dict->indices();
+
+    switch (indices->type_id()) {
+        case Type::INT8:
+            return discrete_indices_column(
+                Type::INT8, std::static_pointer_cast<arrow::Int8Array>(indices)->raw_values(), stride);
+        case Type::INT16:
+            return discrete_indices_column(
+                Type::INT16, std::static_pointer_cast<arrow::Int16Array>(indices)->raw_values(), stride);
+        case Type::INT32:
+            return discrete_indices_column(
+                Type::INT32, std::static_pointer_cast<arrow::Int32Array>(indices)->raw_values(), stride);
+        case Type::INT64:
+            return discrete_indices_column(
+                Type::INT64, std::static_pointer_cast<arrow::Int64Array>(indices)->raw_values(), stride);
+        default:
+            throw std::invalid_argument("Wrong indices array type of DictionaryArray.");
+    }
+}
+
+DiscreteIndicesColumn discrete_indices_column(const DiscreteColumn& column, int stride) {
+    return discrete_indices_column(column.index_type, column.raw_indices, stride);
+}
+
+std::vector<DiscreteIndicesColumn> discrete_indices_columns(const DataFrame& df,
+                                                            const std::string& variable,
+                                                            const std::vector<std::string>& evidence,
+                                                            const VectorXi& strides) {
+    std::vector<DiscreteIndicesColumn> columns;
+    columns.reserve(evidence.size() + 1);
+    columns.push_back(discrete_indices_column(*discrete_column(df, variable), strides(0)));
+    for (size_t i = 0; i < evidence.size(); ++i) {
+        columns.push_back(discrete_indices_column(*discrete_column(df, evidence[i]), strides(i + 1)));
+    }
+
+    return columns;
+}
+
 VectorXi discrete_indices(const DataFrame& df,
                           const std::string& variable,
                           const std::vector<std::string>& evidence,
@@ -76,14 +145,11 @@ std::pair<VectorXi, VectorXi> create_strides(const DataFrame& df,
     VectorXi cardinality(num_variables);
     VectorXi strides(num_variables);
 
-    auto dict_variable = std::static_pointer_cast<arrow::DictionaryArray>(df.col(variable));
-
-    cardinality(0) = dict_variable->dictionary()->length();
+    cardinality(0) = discrete_column(df, variable)->cardinality;
     strides(0) = 1;
 
     for (size_t i = 1; i < num_variables; ++i) {
-        auto dict_evidence = std::static_pointer_cast<arrow::DictionaryArray>(df.col(evidence[i - 1]));
-        cardinality(i) = dict_evidence->dictionary()->length();
+        cardinality(i) = discrete_column(df, evidence[i - 1])->cardinality;
         strides(i) = strides(i - 1) * cardinality(i - 1);
     }
 
@@ -96,14 +162,11 @@ std::pair<VectorXi, VectorXi> create_cardinality_strides(const DataFrame& df,
     VectorXi cardinality(1 + evidence.size());
     VectorXi strides(1 + evidence.size());
 
-    auto first_array = std::static_pointer_cast<arrow::DictionaryArray>(df.col(variable));
-
-    cardinality(0) = first_array->dictionary()->length();
+    cardinality(0) = discrete_column(df, variable)->cardinality;
     strides(0) = 1;
 
     for (size_t i = 0, i_end = evidence.size(); i < i_end; ++i) {
-        auto dict_array = std::static_pointer_cast<arrow::DictionaryArray>(df.col(evidence[i]));
-        cardinality(i + 1) = dict_array->dictionary()->length();
+        cardinality(i + 1) = discrete_column(df, evidence[i])->cardinality;
         strides(i + 1) = strides(i) * cardinality(i);
     }
 
@@ -117,38 +180,213 @@ std::pair<VectorXi, VectorXi> create_cardinality_strides(const DataFrame& df,
     VectorXi cardinality(variables.size());
     VectorXi strides(variables.size());
 
-    auto first_array = std::static_pointer_cast<arrow::DictionaryArray>(df.col(variables[0]));
-
-    cardinality(0) = first_array->dictionary()->length();
+    cardinality(0) = discrete_column(df, variables[0])->cardinality;
     strides(0) = 1;
 
     for (size_t i = 1, i_end = variables.size(); i < i_end; ++i) {
-        auto dict_array = std::static_pointer_cast<arrow::DictionaryArray>(df.col(variables[i]));
-        cardinality(i) = dict_array->dictionary()->length();
+        cardinality(i) = discrete_column(df, variables[i])->cardinality;
         strides(i) = strides(i - 1) * cardinality(i - 1);
     }
 
     return std::make_pair(cardinality, strides);
 }
 
+VectorXi count_indices(const VectorXi& indices, int joint_values) {
+    VectorXi counts = VectorXi::Zero(joint_values);
+
+    for (auto i = 0; i < indices.rows(); ++i) {
+        ++counts(indices(i));
+    }
+
+    return counts;
+}
+
 VectorXi joint_counts(const DataFrame& df,
                       const std::string& variable,
                       const std::vector<std::string>& evidence,
                       const VectorXi& cardinality,
                       const VectorXi& strides) {
-    auto joint_values = cardinality.prod();
+    VectorXi indices = discrete_indices(df, variable, evidence, strides);
+    return count_indices(indices, cardinality.prod());
+}
+
+std::pair<VectorXi, VectorXi> joint_counts(const dataset::ChunkedDataFrame& df,
+                                           const std::string& variable,
+                                           const std::vector<std::string>& evidence) {
+    if (df.num_batches() == 0) throw std::invalid_argument("ChunkedDataFrame does not contain any row.");
+
+    const auto& first = df.batch(0);
+    auto [cardinality, strides] = create_cardinality_strides(first, variable, evidence);
+    if (cardinality.cast<double>().prod() > std::numeric_limits<int>::max())
+        throw std::invalid_argument("The number of configurations of " + variable +
+                                    " and its evidence does not fit in the discrete indices.");
+
+    VectorXi counts = VectorXi::Zero(cardinality.prod());
+    for (int b = 0; b < df.num_batches(); ++b) {
+        const auto& batch = df.batch(b);
+        if (b > 0) {
+            if (discrete_column(batch, variable)->categories != discrete_column(first, variable)->categories)
+                throw std::invalid_argument("The chunks of variable " + variable + " have different categories.");
+            for (const auto& e : evidence) {
+                if (discrete_column(batch, e)->categories != discrete_column(first, e)->categories)
+                    throw std::invalid_argument("The chunks of variable " + e + " have different categories.");
+            }
+        }
+
+        counts += joint_counts(batch, variable, evidence, cardinality, strides);
+    }
+
+    return std::make_pair(cardinality, counts);
+}
+
+namespace {
+
+// Returns the sorted parent configurations of the joint indices and their counts, where the i-th index adds weight(i)
+// to its count.
+template <typename Counts, typename Weight>
+std::pair<std::vector<int>, Counts> sparse_counts(const VectorXi& indices, int num_categories, Weight&& weight) {
+    using Scalar = typename Counts::Scalar;
+
+    // The position of each parent configuration in the order they appear.
+    std::unordered_map<int, int> positions;
+    std::vector<int> configurations;
+    std::vector<Scalar> counts;
+    for (auto i = 0; i < indices.rows(); ++i) {
+        auto [it, inserted] = positions.insert({indices(i) / num_categories, configurations.size()});
+        if (inserted) {
+            configurations.push_back(it->first);
+            counts.resize(counts.size() + num_categories, 0);
+        }
+
+        counts[it->second * num_categories + indices(i) % num_categories] += weight(i);
+    }
+
+    std::vector<int> order(configurations.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&configurations](int a, int b) {
+        return configurations[a] < configurations[b];
+    });
+
+    std::pair<std::vector<int>, Counts> res{std::vector<int>(configurations.size()), Counts(counts.size())};
+    for (int k = 0, k_end = order.size(); k < k_end; ++k) {
+        res.first[k] = configurations[order[k]];
+        std::copy(counts.begin() + order[k] * num_categories,
+                  counts.begin() + (order[k] + 1) * num_categories,
+                  res.second.data() + k * num_categories);
+    }
+
+    return res;
+}
+
+void check_joint_indices(const std::string& variable, const VectorXi& cardinality) {
+    if (cardinality.cast<double>().prod() > std::numeric_limits<int>::max())
+        throw std::invalid_argument("The number of configurations of " + variable +
+                                    " and its evidence does not fit in the discrete indices.");
+}
+
+}  // namespace
+
+SparseJointCounts sparse_joint_counts(const DataFrame& df,
+                                      const std::string& variable,
+                                      const std::vector<std::string>& evidence,
+                                      const VectorXi& cardinality,
+                                      const VectorXi& strides) {
+    check_joint_indices(variable, cardinality);
 
-    VectorXi counts = VectorXi::Zero(joint_values);
     VectorXi indices = discrete_indices(df, variable, evidence, strides);
+    auto [configurations, counts] = sparse_counts<VectorXi>(indices, cardinality(0), [](int) { return 1; });
+    return SparseJointCounts{std::move(configurations), std::move(counts)};
+}
+
+VectorXd weighted_joint_counts(const DataFrame& df,
+                               const std::string& variable,
+                               const std::vector<std::string>& evidence,
+                               const VectorXi& cardinality,
+                               const VectorXi& strides,
+                               const VectorXd& weights) {
+    VectorXi indices = discrete_indices(df, variable, evidence, strides);
+    VectorXd valid = factors::valid_weights(df, weights, variable, evidence);
 
-    // Compute counts
+    VectorXd counts = VectorXd::Zero(cardinality.prod());
     for (auto i = 0; i < indices.rows(); ++i) {
-        ++counts(indices(i));
+        counts(indices(i)) += valid(i);
     }
 
     return counts;
 }
 
+WeightedSparseJointCounts weighted_sparse_joint_counts(const DataFrame& df,
+                                                       const std::string& variable,
+                                                       const std::vector<std::string>& evidence,
+                                                       const VectorXi& cardinality,
+                                                       const VectorXi& strides,
+                                                       const VectorXd& weights) {
+    check_joint_indices(variable, cardinality);
+
+    VectorXi indices = discrete_indices(df, variable, evidence, strides);
+    VectorXd valid = factors::valid_weights(df, weights, variable, evidence);
+    auto [configurations, counts] = sparse_counts<VectorXd>(indices, cardinality(0), [&valid](int i) {
+        return valid(i);
+    });
+    return WeightedSparseJointCounts{std::move(configurations), std::move(counts)};
+}
+
+std::vector<std::pair<VectorXi, VectorXi>> batch_joint_counts(
+    const DataFrame& df, const std::string& variable, const std::vector<std::vector<std::string>>& evidence_sets) {
+    std::vector<std::pair<VectorXi, VectorXi>> res(evidence_sets.size());
+
+    // The evidence sets are counted in lexicographic order, so the consecutive sets share their longest prefixes.
+    std::vector<size_t> order(evidence_sets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&evidence_sets](size_t a, size_t b) {
+        return evidence_sets[a] < evidence_sets[b];
+    });
+
+    // prefix_indices[i] contains the discrete indices of variable and the first i variables of prefix. The indices of
+    // the next evidence set start from the indices of its longest common prefix with the previous set, and add one
+    // column at a time. The strides of a variable only depend on the previous variables, so the indices of a prefix are
+    // valid for all the evidence sets that extend it.
+    std::vector<std::string> prefix;
+    std::vector<VectorXi> prefix_indices;
+    bool variable_null = df.null_count(variable) > 0;
+
+    for (auto i : order) {
+        const auto& evidence = evidence_sets[i];
+        auto [cardinality, strides] = create_cardinality_strides(df, variable, evidence);
+
+        if (variable_null || df.null_count(evidence) > 0) {
+            auto counts = joint_counts(df, variable, evidence, cardinality, strides);
+            res[i] = std::make_pair(std::move(cardinality), std::move(counts));
+            continue;
+        }
+
+        size_t common = 0;
+        while (common < prefix.size() && common < evidence.size() && prefix[common] == evidence[common]) ++common;
+
+        prefix.resize(common);
+        if (prefix_indices.empty()) {
+            prefix_indices.push_back(discrete_indices<false>(df, variable, {}, strides));
+        } else {
+            prefix_indices.resize(common + 1);
+        }
+
+        for (auto k = common; k < evidence.size(); ++k) {
+            VectorXi indices = prefix_indices.back();
+            auto dict_evidence = std::static_pointer_cast<arrow::DictionaryArray>(df.col(evidence[k]));
+            auto evidence_indices = dict_evidence->indices();
+            sum_to_discrete_indices(indices, evidence_indices, strides(k + 1));
+
+            prefix.push_back(evidence[k]);
+            prefix_indices.push_back(std::move(indices));
+        }
+
+        auto counts = count_indices(prefix_indices.back(), cardinality.prod());
+        res[i] = std::make_pair(std::move(cardinality), std::move(counts));
+    }
+
+    return res;
+}
+
 VectorXi marginal_counts(const VectorXi& joint_counts,
                          int index,
                          const VectorXi& cardinality,
@@ -203,23 +441,92 @@ std::vector<Array_ptr> discrete_slice_indices(const DataFrame& df,
     return slices;
 }
 
+DiscretePartition::DiscretePartition(const DataFrame& df,
+                                     const std::vector<std::string>& discrete_vars,
+                                     const VectorXi& strides,
+                                     int num_configurations,
+                                     const DataFrame& data)
+    : m_data(data),
+      m_sorted(),
+      m_row_indices(),
+      m_raw_row_indices(nullptr),
+      m_sparse(num_configurations > sparse_configurations_threshold),
+      m_configurations(),
+      m_offsets(),
+      m_zero_copy(data.null_count() == 0) {
+    // The group of each row with valid discrete values.
+    VectorXi groups = discrete_indices(df, discrete_vars, strides);
+    auto num_groups = num_configurations;
+
+    if (m_sparse) {
+        m_configurations.assign(groups.data(), groups.data() + groups.rows());
+        std::sort(m_configurations.begin(), m_configurations.end());
+        m_configurations.erase(std::unique(m_configurations.begin(), m_configurations.end()), m_configurations.end());
+
+        std::unordered_map<int, int> positions;
+        for (int k = 0, k_end = m_configurations.size(); k < k_end; ++k) {
+            positions.insert({m_configurations[k], k});
+        }
+
+        for (auto i = 0; i < groups.rows(); ++i) {
+            groups(i) = positions[groups(i)];
+        }
+
+        num_groups = m_configurations.size();
+    }
+
+    m_offsets.assign(num_groups + 1, 0);
+    for (auto i = 0; i < groups.rows(); ++i) {
+        ++m_offsets[groups(i) + 1];
+    }
+    std::partial_sum(m_offsets.begin(), m_offsets.end(), m_offsets.begin());
+
+    arrow::NumericBuilder<arrow::Int32Type> builder;
+    RAISE_STATUS_ERROR(builder.AppendEmptyValues(groups.rows()));
+    RAISE_STATUS_ERROR(builder.Finish(&m_row_indices));
+    auto raw_row_indices = m_row_indices->data()->GetMutableValues<int32_t>(1);
+    m_raw_row_indices = raw_row_indices;
+
+    // The next position of each group.
+    std::vector<int> position(m_offsets.begin(), m_offsets.end() - 1);
+    if (df.null_count(discrete_vars) == 0) {
+        for (auto i = 0; i < groups.rows(); ++i) {
+            raw_row_indices[position[groups(i)]++] = i;
+        }
+    } else {
+        auto bitmap = df.combined_bitmap(discrete_vars);
+        auto bitmap_data = bitmap->data();
+
+        for (auto i = 0, j = 0; i < df->num_rows(); ++i) {
+            if (util::bit_util::GetBit(bitmap_data, i)) {
+                raw_row_indices[position[groups(j++)]++] = i;
+            }
+        }
+    }
+
+    if (m_zero_copy) m_sorted = data.take(m_row_indices);
+}
+
+DataFrame DiscretePartition::data(int group) const {
+    auto offset = m_offsets[group];
+    auto length = rows(group);
+
+    if (m_zero_copy)
+        return m_sorted.slice(offset, length);
+    else
+        return m_data.take(m_row_indices->Slice(offset, length));
+}
+
 void check_domain_variable(const DataFrame& df,
                            const std::string& variable,
                            const std::vector<std::string>& variable_values) {
-    auto var_array = df.col(variable);
-    if (var_array->type_id() != arrow::Type::DICTIONARY)
-        throw std::invalid_argument("Variable " + variable + " is not categorical.");
-
-    auto var_dictionary = std::static_pointer_cast<arrow::DictionaryArray>(var_array);
-
-    factors::discrete::check_is_string_dictionary(var_dictionary, variable);
-    auto var_names = std::static_pointer_cast<arrow::StringArray>(var_dictionary->dictionary());
+    const auto& categories = discrete_column(df, variable)->categories;
 
-    if (variable_values.size() != static_cast<size_t>(var_names->length()))
+    if (variable_values.size() != categories.size())
         throw std::invalid_argument("Variable " + variable + " does not contain the same categories.");
 
-    for (auto j = 0; j < var_names->length(); ++j) {
-        if (variable_values[j] != var_names->GetString(j))
+    for (size_t j = 0; j < categories.size(); ++j) {
+        if (variable_values[j] != categories[j])
             throw std::invalid_argument("Category at index " + std::to_string(j) + " is different for variable " +
                                         variable);
     }
@@ -1,10 +1,13 @@
 #ifndef PYBNESIAN_FACTORS_DISCRETE_DISCRETE_INDICES_HPP
 #define PYBNESIAN_FACTORS_DISCRETE_DISCRETE_INDICES_HPP
 
+#include <algorithm>
 #include <arrow/compute/api.h>
 #include <Eigen/Dense>
 #include <dataset/dataset.hpp>
+#include <dataset/chunked_dataframe.hpp>
 #include <factors/assignment.hpp>
+#include <factors/discrete/discrete_columns.hpp>
 #include <util/hash_utils.hpp>
 
 using dataset::DataFrame;
@@ -126,6 +129,71 @@ VectorXi discrete_indices(const DataFrame& df, const std::vector<std::string>& v
 
 VectorXi discrete_indices(const DataFrame& df, const std::vector<std::string>& variables, const VectorXi& strides);
 
+// Number of rows of the blocks of for_each_discrete_indices_block().
+constexpr int discrete_indices_block_rows = 1024;
+
+// The dictionary indices of a column, and the function that adds them to a block of discrete indices. The function is
+// instantiated for each index type, so the type of the indices is only checked once per column.
+struct DiscreteIndicesColumn {
+    const void* raw_indices;
+    int stride;
+    void (*accumulate)(const void* raw_indices, int offset, int length, int stride, int* block);
+};
+
+// Returns the DiscreteIndicesColumn of a dictionary column.
+DiscreteIndicesColumn discrete_indices_column(const Array_ptr& column, int stride);
+DiscreteIndicesColumn discrete_indices_column(const DiscreteColumn& column, int stride);
+
+std::vector<DiscreteIndicesColumn> discrete_indices_columns(const DataFrame& df,
+                                                            const std::string& variable,
+                                                            const std::vector<std::string>& evidence,
+                                                            const VectorXi& strides);
+
+// Calls f(offset, length, block) for consecutive blocks of discrete_indices_block_rows rows of df, where block contains
+// the discrete indices (see discrete_indices()) of the rows [offset, offset + length). The indices of each block are
+// accumulated from all the columns while they are in the cache, and f() usually gathers the values of a table with
+// them. If contains_null, the index of the rows that are null in combined_bitmap is 0.
+template <bool contains_null, typename F>
+void for_each_discrete_indices_block(const DataFrame& df,
+                                     const std::string& variable,
+                                     const std::vector<std::string>& evidence,
+                                     const VectorXi& strides,
+                                     const Buffer_ptr& combined_bitmap,
+                                     F&& f) {
+    auto columns = discrete_indices_columns(df, variable, evidence, strides);
+    const uint8_t* raw_bitmap = nullptr;
+    if constexpr (contains_null) raw_bitmap = combined_bitmap->data();
+
+    for_each_discrete_indices_block(columns, df->num_rows(), raw_bitmap, f);
+}
+
+// Same as for_each_discrete_indices_block() with the columns of the indices. If raw_bitmap is not null, the index of
+// the rows that are null in raw_bitmap is 0.
+template <typename F>
+void for_each_discrete_indices_block(const std::vector<DiscreteIndicesColumn>& columns,
+                                     int64_t rows,
+                                     const uint8_t* raw_bitmap,
+                                     F&& f) {
+    int block[discrete_indices_block_rows];
+    for (int offset = 0; offset < rows; offset += discrete_indices_block_rows) {
+        int length = std::min(discrete_indices_block_rows, static_cast<int>(rows - offset));
+
+        std::fill(block, block + length, 0);
+        for (const auto& column : columns) {
+            column.accumulate(column.raw_indices, offset, length, column.stride, block);
+        }
+
+        if (raw_bitmap) {
+            // The indices of the null values can be out of the range of the dictionary.
+            for (int k = 0; k < length; ++k) {
+                if (!util::bit_util::GetBit(raw_bitmap, offset + k)) block[k] = 0;
+            }
+        }
+
+        f(offset, length, static_cast<const int*>(block));
+    }
+}
+
 std::pair<VectorXi, VectorXi> create_cardinality_strides(const DataFrame& df,
                                                          const std::string& variable,
                                                          const std::vector<std::string>& evidence);
@@ -137,6 +205,66 @@ VectorXi joint_counts(const DataFrame& df,
                       const std::vector<std::string>& evidence,
                       const VectorXi& cardinality,
                       const VectorXi& strides);
+// Returns the cardinality and the joint counts of variable and evidence in a ChunkedDataFrame. The counts of each batch
+// are accumulated, so the chunks are not concatenated. The chunks of each column must have the same categories.
+std::pair<VectorXi, VectorXi> joint_counts(const dataset::ChunkedDataFrame& df,
+                                           const std::string& variable,
+                                           const std::vector<std::string>& evidence);
+
+// The factors with more parent configurations than sparse_configurations_threshold only store the parent configurations
+// that appear in the data (see sparse_joint_counts()).
+constexpr int sparse_configurations_threshold = 1 << 16;
+
+// Returns true if the parent configurations of the cardinality (the cardinality of the variable followed by the
+// cardinality of the evidence) should be stored sparsely.
+inline bool sparse_configurations(const VectorXi& cardinality) {
+    return cardinality.tail(cardinality.rows() - 1).cast<double>().prod() > sparse_configurations_threshold;
+}
+
+// The joint counts of the parent configurations that appear in the data. The counts of the rest of parent
+// configurations are 0.
+struct SparseJointCounts {
+    // The parent configurations (the joint index divided by the cardinality of the variable) in increasing order.
+    std::vector<int> configurations;
+    // The counts of the k-th configuration are [k * cardinality(0), (k + 1) * cardinality(0)).
+    VectorXi counts;
+};
+
+// Same as joint_counts(), but only the parent configurations that appear in df are stored. The memory is proportional
+// to the number of rows instead of the number of configurations.
+SparseJointCounts sparse_joint_counts(const DataFrame& df,
+                                      const std::string& variable,
+                                      const std::vector<std::string>& evidence,
+                                      const VectorXi& cardinality,
+                                      const VectorXi& strides);
+
+// Same as SparseJointCounts, with the weighted counts of weighted_sparse_joint_counts().
+struct WeightedSparseJointCounts {
+    std::vector<int> configurations;
+    VectorXd counts;
+};
+
+// Same as joint_counts() and sparse_joint_counts(), but each row adds its weight (see factors::check_weights()) to the
+// counts instead of 1.
+VectorXd weighted_joint_counts(const DataFrame& df,
+                               const std::string& variable,
+                               const std::vector<std::string>& evidence,
+                               const VectorXi& cardinality,
+                               const VectorXi& strides,
+                               const VectorXd& weights);
+WeightedSparseJointCounts weighted_sparse_joint_counts(const DataFrame& df,
+                                                       const std::string& variable,
+                                                       const std::vector<std::string>& evidence,
+                                                       const VectorXi& cardinality,
+                                                       const VectorXi& strides,
+                                                       const VectorXd& weights);
+
+// Computes the cardinality and the joint_counts() of variable and each of the evidence sets. The evidence sets are
+// counted in lexicographic order and the discrete indices of each set are extended from the indices of its longest
+// common prefix with the previous set, so the enumerations of util::Combinations and util::AllSubsets (where the
+// consecutive sets only change their last variables) read one or two columns for most of the sets.
+std::vector<std::pair<VectorXi, VectorXi>> batch_joint_counts(
+    const DataFrame& df, const std::string& variable, const std::vector<std::vector<std::string>>& evidence_sets);
 
 VectorXi marginal_counts(const VectorXi& joint_counts, int index, const VectorXi& cardinality, const VectorXi& strides);
 
@@ -145,6 +273,46 @@ std::vector<Array_ptr> discrete_slice_indices(const DataFrame& df,
                                               const VectorXi& indices,
                                               int num_factors);
 
+// The rows of a DataFrame grouped by the configuration of some discrete variables (the discrete_indices() of the
+// variables) with a counting sort, so the rows of each group are contiguous. The rows with null values in the discrete
+// variables are not included in any group.
+//
+// If there are at most sparse_configurations_threshold configurations, there is a group for each configuration (that
+// can be empty). Otherwise, the partition is sparse: it only has a group for each configuration that appears in df, in
+// increasing order of configuration.
+//
+// The columns of data (a DataFrame with the rows of df, e.g. df.loc()) are reordered with one take() for all the
+// groups, and the data of each group is a zero-copy slice of it. If data contains null values, the data of each group
+// is taken from data, because the null bitmaps of the slices would not start at the first row.
+class DiscretePartition {
+public:
+    DiscretePartition(const DataFrame& df,
+                      const std::vector<std::string>& discrete_vars,
+                      const VectorXi& strides,
+                      int num_configurations,
+                      const DataFrame& data);
+
+    bool sparse() const { return m_sparse; }
+    int num_groups() const { return m_offsets.size() - 1; }
+    // Returns the configuration of the rows of a group.
+    int configuration(int group) const { return m_sparse ? m_configurations[group] : group; }
+    int rows(int group) const { return m_offsets[group + 1] - m_offsets[group]; }
+    // Returns the rows of data in the group.
+    DataFrame data(int group) const;
+    // Returns the index in df of each row of data(group).
+    const int* row_indices(int group) const { return m_raw_row_indices + m_offsets[group]; }
+
+private:
+    DataFrame m_data;
+    DataFrame m_sorted;
+    Array_ptr m_row_indices;
+    const int* m_raw_row_indices;
+    bool m_sparse;
+    std::vector<int> m_configurations;
+    std::vector<int> m_offsets;
+    bool m_zero_copy;
+};
+
 void check_domain_variable(const DataFrame& df,
                            const std::string& variable,
                            const std::vector<std::string>& variable_values);
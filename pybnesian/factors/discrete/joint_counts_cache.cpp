@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <factors/discrete/joint_counts_cache.hpp>
+
+namespace factors::discrete {
+
+namespace {
+
+std::vector<std::string> sorted_variables(const std::string& variable, const std::vector<std::string>& evidence) {
+    std::vector<std::string> variables;
+    variables.reserve(evidence.size() + 1);
+    variables.push_back(variable);
+    variables.insert(variables.end(), evidence.begin(), evidence.end());
+    std::sort(variables.begin(), variables.end());
+    return variables;
+}
+
+VectorXi cumulative_strides(const VectorXi& cardinality) {
+    VectorXi strides(cardinality.rows());
+    if (strides.rows() > 0) strides(0) = 1;
+    for (auto i = 1; i < strides.rows(); ++i) {
+        strides(i) = strides(i - 1) * cardinality(i - 1);
+    }
+    return strides;
+}
+
+// Reorders (and marginalizes) the counts of from_variables to the variables in to_variables. Every variable in
+// to_variables must be in from_variables. Returns the cardinality and the counts of to_variables.
+std::pair<VectorXi, VectorXi> reindex_counts(const std::vector<std::string>& from_variables,
+                                             const VectorXi& from_cardinality,
+                                             const VectorXi& from_counts,
+                                             const std::vector<std::string>& to_variables) {
+    VectorXi to_cardinality(to_variables.size());
+    std::vector<int> position(to_variables.size());
+    for (size_t i = 0; i < to_variables.size(); ++i) {
+        auto it = std::lower_bound(from_variables.begin(), from_variables.end(), to_variables[i]);
+        position[i] = std::distance(from_variables.begin(), it);
+        to_cardinality(i) = from_cardinality(position[i]);
+    }
+
+    auto from_strides = cumulative_strides(from_cardinality);
+    auto to_strides = cumulative_strides(to_cardinality);
+
+    VectorXi to_counts = VectorXi::Zero(to_cardinality.prod());
+    for (auto i = 0; i < from_counts.rows(); ++i) {
+        int index = 0;
+        for (size_t j = 0; j < position.size(); ++j) {
+            index += ((i / from_strides(position[j])) % from_cardinality(position[j])) * to_strides(j);
+        }
+        to_counts(index) += from_counts(i);
+    }
+
+    return std::make_pair(std::move(to_cardinality), std::move(to_counts));
+}
+
+}  // namespace
+
+std::pair<VectorXi, VectorXi> JointCountsCache::joint_counts(const DataFrame& df,
+                                                             const std::string& variable,
+                                                             const std::vector<std::string>& evidence) {
+    if (auto cached = find(df, variable, evidence)) return std::move(*cached);
+
+    auto [cardinality, strides] = create_cardinality_strides(df, variable, evidence);
+    auto counts = m_index ? m_index->joint_counts(variable, evidence, cardinality, strides)
+                          : factors::discrete::joint_counts(df, variable, evidence, cardinality, strides);
+    insert(variable, evidence, cardinality, counts);
+    return std::make_pair(std::move(cardinality), std::move(counts));
+}
+
+std::vector<std::pair<VectorXi, VectorXi>> JointCountsCache::batch_joint_counts(
+    const DataFrame& df, const std::string& variable, const std::vector<std::vector<std::string>>& evidence_sets) {
+    std::vector<std::pair<VectorXi, VectorXi>> res(evidence_sets.size());
+
+    std::vector<size_t> missing;
+    std::vector<std::vector<std::string>> missing_sets;
+    for (size_t i = 0; i < evidence_sets.size(); ++i) {
+        if (auto cached = find(df, variable, evidence_sets[i])) {
+            res[i] = std::move(*cached);
+            continue;
+        }
+
+        auto [cardinality, strides] = create_cardinality_strides(df, variable, evidence_sets[i]);
+        if (m_index && BitSlicedIndex::is_efficient(cardinality)) {
+            auto counts = m_index->joint_counts(variable, evidence_sets[i], cardinality, strides);
+            insert(variable, evidence_sets[i], cardinality, counts);
+            res[i] = std::make_pair(std::move(cardinality), std::move(counts));
+        } else {
+            missing.push_back(i);
+            missing_sets.push_back(evidence_sets[i]);
+        }
+    }
+
+    if (!missing.empty()) {
+        auto computed = factors::discrete::batch_joint_counts(df, variable, missing_sets);
+        for (size_t k = 0; k < missing.size(); ++k) {
+            insert(variable, missing_sets[k], computed[k].first, computed[k].second);
+            res[missing[k]] = std::move(computed[k]);
+        }
+    }
+
+    return res;
+}
+
+std::optional<std::pair<VectorXi, VectorXi>> JointCountsCache::find(const DataFrame& df,
+                                                                    const std::string& variable,
+                                                                    const std::vector<std::string>& evidence) const {
+    auto key = sorted_variables(variable, evidence);
+
+    std::vector<std::string> to_variables;
+    to_variables.reserve(evidence.size() + 1);
+    to_variables.push_back(variable);
+    to_variables.insert(to_variables.end(), evidence.begin(), evidence.end());
+
+    std::shared_ptr<const Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            entry = it->second;
+        } else {
+            // Search the supersets among the tables of the least frequent variable.
+            const std::unordered_set<const Entry*>* candidates = nullptr;
+            for (const auto& v : key) {
+                auto it_var = m_entries_by_variable.find(v);
+                if (it_var == m_entries_by_variable.end()) return std::nullopt;
+                if (!candidates || it_var->second.size() < candidates->size()) candidates = &it_var->second;
+            }
+
+            const Entry* best = nullptr;
+            for (const auto* candidate : *candidates) {
+                if ((!best || candidate->counts.rows() < best->counts.rows()) &&
+                    std::includes(
+                        candidate->variables.begin(), candidate->variables.end(), key.begin(), key.end())) {
+                    best = candidate;
+                }
+            }
+
+            if (best) entry = m_entries.find(best->variables)->second;
+        }
+    }
+
+    if (!entry) return std::nullopt;
+
+    if (entry->variables.size() > key.size()) {
+        // The rows with a null in the other variables of the superset are not counted in the cached table.
+        std::vector<std::string> others;
+        std::set_difference(entry->variables.begin(),
+                            entry->variables.end(),
+                            key.begin(),
+                            key.end(),
+                            std::back_inserter(others));
+        if (df.null_count(others) > 0) return std::nullopt;
+    }
+
+    return reindex_counts(entry->variables, entry->cardinality, entry->counts, to_variables);
+}
+
+void JointCountsCache::insert(const std::string& variable,
+                              const std::vector<std::string>& evidence,
+                              const VectorXi& cardinality,
+                              const VectorXi& counts) {
+    if (static_cast<std::size_t>(counts.rows()) > m_max_cells) return;
+
+    std::vector<std::string> from_variables;
+    from_variables.reserve(evidence.size() + 1);
+    from_variables.push_back(variable);
+    from_variables.insert(from_variables.end(), evidence.begin(), evidence.end());
+
+    auto entry = std::make_shared<Entry>();
+    entry->variables = sorted_variables(variable, evidence);
+
+    // reindex_counts() needs sorted from_variables, so the counts are sorted through an index permutation.
+    std::vector<int> order(from_variables.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&from_variables](int a, int b) {
+        return from_variables[a] < from_variables[b];
+    });
+
+    VectorXi sorted_cardinality(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        sorted_cardinality(i) = cardinality(order[i]);
+    }
+
+    auto from_strides = cumulative_strides(cardinality);
+    auto to_strides = cumulative_strides(sorted_cardinality);
+
+    VectorXi sorted_counts(counts.rows());
+    for (auto i = 0; i < counts.rows(); ++i) {
+        int index = 0;
+        for (size_t j = 0; j < order.size(); ++j) {
+            index += ((i / from_strides(order[j])) % cardinality(order[j])) * to_strides(j);
+        }
+        sorted_counts(index) = counts(i);
+    }
+
+    entry->cardinality = std::move(sorted_cardinality);
+    entry->counts = std::move(sorted_counts);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.count(entry->variables) > 0) return;
+
+    // The maximum can be reduced by set_max_cells() while the counts are sorted.
+    if (static_cast<std::size_t>(entry->counts.rows()) > m_max_cells) return;
+    evict_unlocked(entry->counts.rows());
+
+    m_num_cells += entry->counts.rows();
+    for (const auto& v : entry->variables) {
+        m_entries_by_variable[v].insert(entry.get());
+    }
+    m_insertion_order.push_back(entry->variables);
+    auto key = entry->variables;
+    m_entries.emplace(std::move(key), std::move(entry));
+}
+
+void JointCountsCache::evict_unlocked(std::size_t cells) {
+    while (!m_insertion_order.empty() && m_num_cells + cells > m_max_cells) {
+        auto it = m_entries.find(m_insertion_order.front());
+        m_num_cells -= it->second->counts.rows();
+        for (const auto& v : it->second->variables) {
+            m_entries_by_variable[v].erase(it->second.get());
+        }
+        m_entries.erase(it);
+        m_insertion_order.pop_front();
+    }
+}
+
+}  // namespace factors::discrete
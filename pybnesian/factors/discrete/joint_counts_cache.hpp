@@ -0,0 +1,123 @@
+#ifndef PYBNESIAN_FACTORS_DISCRETE_JOINT_COUNTS_CACHE_HPP
+#define PYBNESIAN_FACTORS_DISCRETE_JOINT_COUNTS_CACHE_HPP
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <dataset/dataset.hpp>
+#include <factors/discrete/bit_sliced_index.hpp>
+#include <factors/discrete/discrete_indices.hpp>
+#include <util/hash_utils.hpp>
+#include <util/memory_usage.hpp>
+
+using dataset::DataFrame;
+using Eigen::VectorXi;
+
+namespace factors::discrete {
+
+// A cache of the contingency tables (joint counts) of the discrete variables of a DataFrame. The tables are stored by
+// their set of variables, so the counts of a set of variables in any order can be obtained from a cached table of the
+// same set. If the set is not cached, the counts can also be marginalized from a cached table of a superset.
+//
+// The cache can be used from multiple threads. It must only be used with the same DataFrame.
+class JointCountsCache {
+public:
+    static constexpr std::size_t default_max_cells = 1 << 22;
+
+    // The cache stores at most max_cells counts. When it is full, the oldest tables are removed. If index is not
+    // nullptr, the small tables that are not cached are counted with the BitSlicedIndex.
+    JointCountsCache(std::shared_ptr<BitSlicedIndex> index = nullptr, std::size_t max_cells = default_max_cells)
+        : m_index(index),
+          m_max_cells(max_cells),
+          m_num_cells(0),
+          m_mutex(),
+          m_entries(),
+          m_entries_by_variable(),
+          m_insertion_order() {}
+
+    // Returns the cardinality and the joint counts of variable and evidence. The result is identical to
+    // create_cardinality_strides() and joint_counts().
+    std::pair<VectorXi, VectorXi> joint_counts(const DataFrame& df,
+                                               const std::string& variable,
+                                               const std::vector<std::string>& evidence);
+
+    // Returns joint_counts() for each evidence set. The tables that are not cached are computed with the
+    // BitSlicedIndex (if it is efficient) or factors::discrete::batch_joint_counts().
+    std::vector<std::pair<VectorXi, VectorXi>> batch_joint_counts(
+        const DataFrame& df, const std::string& variable, const std::vector<std::vector<std::string>>& evidence_sets);
+
+    std::size_t num_cells() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_num_cells;
+    }
+
+    std::size_t max_cells() const { return m_max_cells; }
+    // Changes the maximum number of cached counts, removing the oldest tables if the cache has more counts.
+    void set_max_cells(std::size_t max_cells) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_max_cells = max_cells;
+        evict_unlocked(0);
+    }
+
+    // The memory of the cached counts and of the bitmaps of the BitSlicedIndex.
+    util::MemoryUsage memory_usage() const {
+        util::MemoryUsage usage;
+        usage.add("counts", sizeof(int) * num_cells());
+        if (m_index) usage.add("bit_sliced_index", m_index->memory());
+        return usage;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_num_cells = 0;
+        m_entries.clear();
+        m_entries_by_variable.clear();
+        m_insertion_order.clear();
+    }
+
+private:
+    using Key = std::vector<std::string>;
+
+    class HashKey {
+    public:
+        inline std::size_t operator()(const Key& key) const {
+            size_t seed = key.size();
+            for (const auto& v : key) {
+                util::hash_combine(seed, v);
+            }
+            return seed;
+        }
+    };
+
+    // The counts of a table are stored in the order of the sorted variables.
+    struct Entry {
+        Key variables;
+        VectorXi cardinality;
+        VectorXi counts;
+    };
+
+    std::optional<std::pair<VectorXi, VectorXi>> find(const DataFrame& df,
+                                                      const std::string& variable,
+                                                      const std::vector<std::string>& evidence) const;
+    void insert(const std::string& variable,
+                const std::vector<std::string>& evidence,
+                const VectorXi& cardinality,
+                const VectorXi& counts);
+    // Removes the oldest tables until cells more counts fit in the cache.
+    void evict_unlocked(std::size_t cells);
+
+    std::shared_ptr<BitSlicedIndex> m_index;
+    std::atomic<std::size_t> m_max_cells;
+    std::size_t m_num_cells;
+    mutable std::mutex m_mutex;
+    std::unordered_map<Key, std::shared_ptr<const Entry>, HashKey> m_entries;
+    std::unordered_map<std::string, std::unordered_set<const Entry*>> m_entries_by_variable;
+    std::deque<Key> m_insertion_order;
+};
+
+}  // namespace factors::discrete
+
+#endif  // PYBNESIAN_FACTORS_DISCRETE_JOINT_COUNTS_CACHE_HPP
@@ -8,7 +8,10 @@
 #include <random>
 #include <pybind11/pybind11.h>
 #include <dataset/dataset.hpp>
+#include <util/binary_io.hpp>
+#include <util/memory_usage.hpp>
 #include <util/pickle.hpp>
+#include <util/profiler.hpp>
 
 using dataset::DataFrame;
 
@@ -115,6 +118,42 @@ std::shared_ptr<F> generic_new_factor(const std::string& variable,
     }
 }
 
+// Checks the forgetting factor of Factor::partial_fit().
+inline void check_forgetting(double forgetting) {
+    if (!(forgetting > 0 && forgetting <= 1)) throw std::invalid_argument("The forgetting factor must be in (0, 1].");
+}
+
+// Checks the row weights of Factor::weighted_fit(): a finite and non-negative weight for each row of df. The weights
+// are frequency weights, so an integer weight is equivalent to repeating the row that number of times.
+inline void check_weights(const DataFrame& df, const VectorXd& weights) {
+    if (weights.rows() != df->num_rows())
+        throw std::invalid_argument("The number of weights (" + std::to_string(weights.rows()) +
+                                    ") is not the number of rows of the DataFrame (" +
+                                    std::to_string(df->num_rows()) + ").");
+    if (!weights.allFinite() || (weights.array() < 0).any())
+        throw std::invalid_argument("The weights must be finite and non-negative numbers.");
+}
+
+// Checks the output buffer of Factor::logl_into() and BayesianNetworkBase::logl_into(): one element for each row of df.
+inline void check_logl_output(const DataFrame& df, Eigen::Index size) {
+    if (size != df->num_rows())
+        throw std::invalid_argument("The size of the output buffer (" + std::to_string(size) +
+                                    ") is not the number of rows of the DataFrame (" +
+                                    std::to_string(df->num_rows()) + ").");
+}
+
+// Returns the weights of the rows of df without null values in the columns.
+template <typename... Args>
+VectorXd valid_weights(const DataFrame& df, const VectorXd& weights, const Args&... columns) {
+    if (df.null_count(columns...) == 0) return weights;
+
+    auto bitmap = df.combined_bitmap(columns...);
+    const auto* raw_bitmap = bitmap->data();
+    VectorXd res(util::bit_util::non_null_count(bitmap, df->num_rows()));
+    util::bit_util::compact(raw_bitmap, df->num_rows(), weights.data(), res.data());
+    return res;
+}
+
 class Factor {
 public:
     Factor() = default;
@@ -178,7 +217,28 @@ public:
 
     virtual bool fitted() const = 0;
     virtual void fit(const DataFrame& df) = 0;
+    // Updates the fitted parameters with the instances of df, keeping sufficient statistics of all the instances seen
+    // by partial_fit(). The statistics of the previous instances are multiplied by forgetting in (0, 1], so the old
+    // instances are forgotten exponentially. The factors without sufficient statistics do not implement it.
+    virtual void partial_fit(const DataFrame&, double forgetting = 1) {
+        check_forgetting(forgetting);
+        throw std::invalid_argument("Factor " + ToString() + " does not support partial_fit().");
+    }
+    // Fits the parameters with the rows of df weighted by weights (see check_weights()). The factors that do not
+    // support weighted rows do not implement it.
+    virtual void weighted_fit(const DataFrame&, const VectorXd&) {
+        throw std::invalid_argument("Factor " + ToString() + " does not support weighted_fit().");
+    }
     virtual VectorXd logl(const DataFrame& df) const = 0;
+    // Same as logl(), but the log-likelihood is stored in out, or added to out if accumulate is true, so the caller can
+    // reuse its buffer. out must have df->num_rows() elements. The default implementation copies the result of logl().
+    virtual void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out, bool accumulate = false) const {
+        check_logl_output(df, out.rows());
+        if (accumulate)
+            out += logl(df);
+        else
+            out = logl(df);
+    }
     virtual double slogl(const DataFrame& df) const = 0;
     // VectorXd cdf(const DataFrame& df) const;
 
@@ -188,6 +248,10 @@ public:
                              const DataFrame& evidence_values,
                              unsigned int seed = std::random_device{}()) const = 0;
 
+    // Returns the memory used by the fitted parameters and the training data of the factor. The default implementation
+    // returns an empty report.
+    virtual util::MemoryUsage memory_usage() const { return util::MemoryUsage(); }
+
     void save(const std::string& name) const { util::save_object(*this, name); }
 
     virtual py::tuple __getstate__() const = 0;
@@ -197,6 +261,18 @@ private:
     std::vector<std::string> m_evidence;
 };
 
+// Fits the factor, recording the fit in the "fit:<FactorType>" counter of the profiler.
+inline void profiled_fit(Factor& factor, const DataFrame& df) {
+    util::ProfileScope profile([&factor] { return "fit:" + factor.type_ref().ToString(); });
+    factor.fit(df);
+}
+
+// Same as profiled_fit(), but the factor is updated with partial_fit() in the "partial_fit:<FactorType>" counter.
+inline void profiled_partial_fit(Factor& factor, const DataFrame& df, double forgetting) {
+    util::ProfileScope profile([&factor] { return "partial_fit:" + factor.type_ref().ToString(); });
+    factor.partial_fit(df, forgetting);
+}
+
 }  // namespace factors
 
 #endif  // PYBNESIAN_FACTORS_FACTORS_HPP
\ No newline at end of file
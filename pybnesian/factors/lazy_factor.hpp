@@ -0,0 +1,87 @@
+#ifndef PYBNESIAN_FACTORS_LAZY_FACTOR_HPP
+#define PYBNESIAN_FACTORS_LAZY_FACTOR_HPP
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <factors/factors.hpp>
+
+namespace factors {
+
+// A CPD that is loaded the first time it is used (see models::load_binary()). The variable, evidence, type and fitted
+// state of the CPD are known before it is loaded, so a Bayesian network can check a LazyFactor without loading it.
+// The Bayesian networks replace the LazyFactor with the loaded CPD when it is accessed with cpd(), so a LazyFactor is
+// never returned to the user.
+class LazyFactor : public Factor {
+public:
+    LazyFactor(const std::string& variable,
+               const std::vector<std::string>& evidence,
+               std::shared_ptr<FactorType> type,
+               bool fitted,
+               std::function<std::shared_ptr<Factor>()> loader)
+        : Factor(variable, evidence),
+          m_type(type),
+          m_fitted(fitted),
+          m_loader(std::move(loader)),
+          m_once(),
+          m_loaded(false),
+          m_factor() {}
+
+    // Returns the CPD, loading it if it is not loaded yet. It can be called from multiple threads.
+    const std::shared_ptr<Factor>& factor() const {
+        std::call_once(m_once, [this]() {
+            m_factor = m_loader();
+            m_loader = nullptr;
+            m_loaded = true;
+        });
+
+        return m_factor;
+    }
+
+    bool loaded() const { return m_loaded; }
+
+    std::shared_ptr<arrow::DataType> data_type() const override { return factor()->data_type(); }
+
+    std::shared_ptr<FactorType> type() const override { return m_type; }
+    FactorType& type_ref() const override { return *m_type; }
+
+    bool fitted() const override { return m_loaded ? m_factor->fitted() : m_fitted; }
+    void fit(const DataFrame& df) override { factor()->fit(df); }
+    void partial_fit(const DataFrame& df, double forgetting = 1) override { factor()->partial_fit(df, forgetting); }
+    VectorXd logl(const DataFrame& df) const override { return factor()->logl(df); }
+    void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out, bool accumulate = false) const override {
+        factor()->logl_into(df, out, accumulate);
+    }
+    double slogl(const DataFrame& df) const override { return factor()->slogl(df); }
+
+    std::string ToString() const override { return factor()->ToString(); }
+
+    Array_ptr sample(int n, const DataFrame& evidence_values, unsigned int seed) const override {
+        return factor()->sample(n, evidence_values, seed);
+    }
+
+    // The CPDs that are not loaded yet do not use memory, so they are not loaded.
+    util::MemoryUsage memory_usage() const override {
+        return m_loaded ? m_factor->memory_usage() : util::MemoryUsage();
+    }
+
+    py::tuple __getstate__() const override { return factor()->__getstate__(); }
+
+    // Returns the loaded CPD of factor if it is a LazyFactor. Otherwise, returns factor.
+    static const std::shared_ptr<Factor>& unwrap(const std::shared_ptr<Factor>& factor) {
+        if (auto lazy = dynamic_cast<const LazyFactor*>(factor.get())) return lazy->factor();
+        return factor;
+    }
+
+private:
+    std::shared_ptr<FactorType> m_type;
+    bool m_fitted;
+    mutable std::function<std::shared_ptr<Factor>()> m_loader;
+    mutable std::once_flag m_once;
+    mutable std::atomic<bool> m_loaded;
+    mutable std::shared_ptr<Factor> m_factor;
+};
+
+}  // namespace factors
+
+#endif  // PYBNESIAN_FACTORS_LAZY_FACTOR_HPP
@@ -1,6 +1,8 @@
 #ifndef PYBNESIAN_GRAPH_GENERIC_GRAPH_HPP
 #define PYBNESIAN_GRAPH_GENERIC_GRAPH_HPP
 
+#include <mutex>
+#include <optional>
 #include <pybind11/pybind11.h>
 #include <boost/dynamic_bitset.hpp>
 #include <graph/graph_types.hpp>
@@ -41,37 +43,45 @@ struct GraphTraits;
 template <template <GraphType> typename _GraphClass>
 struct GraphTraits<_GraphClass<Directed>> {
     using NodeType = DNode;
+    using AdjacencySet = DNode::AdjacencySet;
     template <GraphType Type>
     using GraphClass = _GraphClass<Type>;
     inline static constexpr bool has_arcs = true;
     inline static constexpr bool has_edges = false;
+    inline static constexpr bool is_acyclic = false;
 };
 
 template <template <GraphType> typename _GraphClass>
 struct GraphTraits<_GraphClass<DirectedAcyclic>> {
     using NodeType = DNode;
+    using AdjacencySet = DNode::AdjacencySet;
     template <GraphType Type>
     using GraphClass = _GraphClass<Type>;
     inline static constexpr bool has_arcs = true;
     inline static constexpr bool has_edges = false;
+    inline static constexpr bool is_acyclic = true;
 };
 
 template <template <GraphType> typename _GraphClass>
 struct GraphTraits<_GraphClass<Undirected>> {
     using NodeType = UNode;
+    using AdjacencySet = UNode::AdjacencySet;
     template <GraphType Type>
     using GraphClass = _GraphClass<Type>;
     inline static constexpr bool has_arcs = false;
     inline static constexpr bool has_edges = true;
+    inline static constexpr bool is_acyclic = false;
 };
 
 template <template <GraphType> typename _GraphClass>
 struct GraphTraits<_GraphClass<PartiallyDirected>> {
     using NodeType = PDNode;
+    using AdjacencySet = PDNode::AdjacencySet;
     template <GraphType Type>
     using GraphClass = _GraphClass<Type>;
     inline static constexpr bool has_arcs = true;
     inline static constexpr bool has_edges = true;
+    inline static constexpr bool is_acyclic = false;
 };
 
 template <typename G, typename _ = void>
@@ -108,6 +118,44 @@ static_assert(util::GenericInstantation<GraphType>::is_template_instantation_v<G
               "GenericInstantation failed for Graph, Dag.");
 static_assert(is_unconditional_graph_v<Dag>, "Dag is not unconditional graph");
 
+// Returns the index in to of each raw index of from (-1 for the free indices), so the conversions between graphs add
+// the arcs and edges with their indices, resolving each name once instead of once for each arc.
+template <typename From, typename To>
+std::vector<int> translate_indices(const From& from, const To& to) {
+    std::vector<int> translation(from.num_raw_nodes(), -1);
+    for (const auto& [name, index] : from.indices()) {
+        translation[index] = to.index(name);
+    }
+
+    return translation;
+}
+
+// Adds the arcs and edges of from to the new graph to, where translation is translate_indices(from, to).
+template <GraphType Type, typename From, typename To>
+void copy_arcs_edges(const From& from, To& to, const std::vector<int>& translation) {
+    if constexpr (GraphTraits<Graph<Type>>::has_arcs) {
+        if constexpr (Type == DirectedAcyclic) {
+            std::vector<Arc> arcs;
+            arcs.reserve(from.num_arcs());
+            for (const auto& arc : from.arc_indices()) {
+                arcs.push_back({translation[arc.first], translation[arc.second]});
+            }
+
+            to.add_arcs(arcs);
+        } else {
+            for (const auto& arc : from.arc_indices()) {
+                to.add_arc(translation[arc.first], translation[arc.second]);
+            }
+        }
+    }
+
+    if constexpr (GraphTraits<Graph<Type>>::has_edges) {
+        for (const auto& edge : from.edge_indices()) {
+            to.add_edge(translation[edge.first], translation[edge.second]);
+        }
+    }
+}
+
 template <GraphType Type, template <GraphType> typename GraphClass>
 ConditionalGraph<Type> to_conditional_graph(const GraphClass<Type>& g,
                                             const std::vector<std::string>& nodes,
@@ -151,18 +199,7 @@ ConditionalGraph<Type> to_conditional_graph(const GraphClass<Type>& g,
             static_assert(util::always_false<GraphClass<Type>>, "Wrong GraphType.");
     }
 
-    if constexpr (GraphTraits<Graph<Type>>::has_arcs) {
-        for (const auto& arc : g.arc_indices()) {
-            cgraph.add_arc(g.name(arc.first), g.name(arc.second));
-        }
-    }
-
-    if constexpr (GraphTraits<Graph<Type>>::has_edges) {
-        for (const auto& edge : g.edge_indices()) {
-            cgraph.add_edge(g.name(edge.first), g.name(edge.second));
-        }
-    }
-
+    copy_arcs_edges<Type>(g, cgraph, translate_indices(g, cgraph));
     return cgraph;
 }
 
@@ -177,18 +214,7 @@ Graph<Type> to_unconditional_graph(const GraphClass<Type>& g) {
         nodes.insert(nodes.end(), g.interface_nodes().begin(), g.interface_nodes().end());
 
         Graph<Type> graph(nodes);
-
-        if constexpr (GraphTraits<ConditionalGraph<Type>>::has_arcs) {
-            for (const auto& arc : g.arc_indices()) {
-                graph.add_arc(g.name(arc.first), g.name(arc.second));
-            }
-        }
-        if constexpr (GraphTraits<ConditionalGraph<Type>>::has_edges) {
-            for (const auto& edge : g.edge_indices()) {
-                graph.add_edge(g.name(edge.first), g.name(edge.second));
-            }
-        }
-
+        copy_arcs_edges<Type>(g, graph, translate_indices(g, graph));
         return graph;
     }
 }
@@ -320,7 +346,10 @@ G __setstate__(py::tuple& t) {
 
     G g(t[0].cast<std::vector<std::string>>());
 
-    if constexpr (GraphTraits<G>::has_arcs) {
+    if constexpr (GraphTraits<G>::is_acyclic) {
+        // The arcs of a corrupted state could create a cycle.
+        g.add_arcs(t[1].cast<std::vector<Arc>>());
+    } else if constexpr (GraphTraits<G>::has_arcs) {
         auto arcs = t[1].cast<std::vector<Arc>>();
 
         for (auto& arc : arcs) {
@@ -357,7 +386,9 @@ G __setstate__(py::tuple& t) {
 
     G g(t[0].cast<std::vector<std::string>>(), t[1].cast<std::vector<std::string>>());
 
-    if constexpr (GraphTraits<G>::has_arcs) {
+    if constexpr (GraphTraits<G>::is_acyclic) {
+        g.add_arcs(t[2].cast<ArcStringVector>());
+    } else if constexpr (GraphTraits<G>::has_arcs) {
         auto arcs = t[2].cast<ArcStringVector>();
 
         for (const auto& arc : arcs) {
@@ -476,6 +507,9 @@ public:
 
     const std::vector<int>& free_indices() const { return m_free_indices; }
 
+    // Number of node additions and removals, so it changes every time the nodes change.
+    std::size_t nodes_version() const { return m_nodes_version; }
+
     bool is_valid(int idx) const { return idx >= 0 && idx < num_raw_nodes() && m_nodes[idx].is_valid(); }
 
     int check_index(int idx) const {
@@ -504,10 +538,12 @@ private:
     std::unordered_map<std::string, int> m_indices;
     BidirectionalMapIndex<std::string> m_string_nodes;
     std::vector<int> m_free_indices;
+    std::size_t m_nodes_version = 0;
 };
 
 template <typename Derived>
 int GraphBase<Derived>::create_node(const std::string& node) {
+    ++m_nodes_version;
     if (!m_free_indices.empty()) {
         int idx = m_free_indices.back();
         m_free_indices.pop_back();
@@ -576,6 +612,7 @@ void GraphBase<Derived>::remove_node_unsafe(int index) {
     m_indices.erase(m_nodes[index].name());
     m_nodes[index].invalidate();
     m_free_indices.push_back(index);
+    ++m_nodes_version;
 }
 
 template <typename Derived>
@@ -754,6 +791,7 @@ public:
         if (!is_interface(index)) {
             m_string_nodes.remove(m_nodes[index].name());
             m_interface_nodes.insert(m_nodes[index].name());
+            ++m_nodes_version;
         }
     }
 
@@ -761,6 +799,7 @@ public:
         if (!is_interface(node)) {
             m_string_nodes.remove(node);
             m_interface_nodes.insert(node);
+            ++m_nodes_version;
         }
     }
 
@@ -769,6 +808,7 @@ public:
             const auto& node_name = name(index);
             m_string_nodes.insert(node_name);
             m_interface_nodes.remove(node_name);
+            ++m_nodes_version;
         }
     }
 
@@ -776,11 +816,15 @@ public:
         if (is_interface(node)) {
             m_string_nodes.insert(node);
             m_interface_nodes.remove(node);
+            ++m_nodes_version;
         }
     }
 
     const std::vector<int> free_indices() const { return m_free_indices; }
 
+    // Number of node additions, removals and interface changes, so it changes every time the nodes change.
+    std::size_t nodes_version() const { return m_nodes_version; }
+
     bool is_valid(int idx) const {
         return idx >= 0 && static_cast<size_t>(idx) < m_nodes.size() && m_nodes[idx].is_valid();
     }
@@ -815,10 +859,12 @@ private:
     // all nodes -> index
     std::unordered_map<std::string, int> m_indices;
     std::vector<int> m_free_indices;
+    std::size_t m_nodes_version = 0;
 };
 
 template <typename Derived>
 int ConditionalGraphBase<Derived>::create_node(const std::string& node) {
+    ++m_nodes_version;
     if (!m_free_indices.empty()) {
         int idx = m_free_indices.back();
         m_free_indices.pop_back();
@@ -905,6 +951,7 @@ void ConditionalGraphBase<Derived>::remove_node_unsafe(int index) {
 
     m_nodes[index].invalidate();
     m_free_indices.push_back(index);
+    ++m_nodes_version;
 }
 
 template <typename Derived>
@@ -918,6 +965,7 @@ void ConditionalGraphBase<Derived>::remove_interface_node_unsafe(int index) {
 
     m_nodes[index].invalidate();
     m_free_indices.push_back(index);
+    ++m_nodes_version;
 }
 
 template <typename Derived>
@@ -968,6 +1016,7 @@ class ArcGraph {
 public:
     using Base = BaseClass<Derived>;
     using NodeType = typename GraphTraits<Derived>::NodeType;
+    using AdjacencySet = typename GraphTraits<Derived>::AdjacencySet;
     inline Base& base() { return static_cast<Base&>(static_cast<Derived&>(*this)); }
     inline const Base& base() const { return static_cast<const Base&>(static_cast<const Derived&>(*this)); }
     inline ArcGraph<Derived, BaseClass>& arc_base() { return *this; }
@@ -976,7 +1025,7 @@ public:
     friend class BaseClass<Derived>;
 
     ArcGraph() = default;
-    ArcGraph(const std::vector<std::string>& nodes) : m_arcs(), m_roots(), m_leaves() {
+    ArcGraph(const std::vector<std::string>& nodes) : m_arcs(), m_roots(), m_leaves(), m_arcs_version(0) {
         for (const auto& name : nodes) {
             const auto& this_base = base();
             if constexpr (is_unconditional_graph_v<Derived>) {
@@ -995,6 +1044,9 @@ public:
 
     int num_arcs() const { return m_arcs.size(); }
 
+    // Number of arc additions and removals, so it changes every time the arcs change.
+    std::size_t arcs_version() const { return m_arcs_version; }
+
     template <typename V>
     int num_parents(const V& idx) const {
         return num_parents_unsafe(base().check_index(idx));
@@ -1028,7 +1080,7 @@ public:
     }
 
     template <typename V>
-    const std::unordered_set<int>& parent_set(const V& idx) const {
+    const AdjacencySet& parent_set(const V& idx) const {
         return base().raw_node(idx).parents();
     }
 
@@ -1049,7 +1101,7 @@ public:
     }
 
     template <typename V>
-    const std::unordered_set<int>& children_set(const V& idx) const {
+    const AdjacencySet& children_set(const V& idx) const {
         return base().m_nodes[base().check_index(idx)].children();
     }
 
@@ -1152,6 +1204,7 @@ private:
     ArcSet m_arcs;
     std::unordered_set<int> m_roots;
     std::unordered_set<int> m_leaves;
+    std::size_t m_arcs_version = 0;
 };
 
 template <typename Derived, template <typename> typename BaseClass>
@@ -1207,6 +1260,7 @@ void ArcGraph<Derived, BaseClass>::add_arc_unsafe(int source, int target) {
         }
     }
 
+    ++m_arcs_version;
     m_arcs.insert({source, target});
     base().m_nodes[target].add_parent(source);
     base().m_nodes[source].add_children(target);
@@ -1214,6 +1268,7 @@ void ArcGraph<Derived, BaseClass>::add_arc_unsafe(int source, int target) {
 
 template <typename Derived, template <typename> typename BaseClass>
 void ArcGraph<Derived, BaseClass>::remove_arc_unsafe(int source, int target) {
+    ++m_arcs_version;
     m_arcs.erase({source, target});
     base().m_nodes[target].remove_parent(source);
     base().m_nodes[source].remove_children(target);
@@ -1301,6 +1356,7 @@ class EdgeGraph {
 public:
     using Base = BaseClass<Derived>;
     using NodeType = typename GraphTraits<Derived>::NodeType;
+    using AdjacencySet = typename GraphTraits<Derived>::AdjacencySet;
 
     inline Base& base() { return static_cast<Base&>(static_cast<Derived&>(*this)); }
     inline const Base& base() const { return static_cast<const Base&>(static_cast<const Derived&>(*this)); }
@@ -1333,7 +1389,7 @@ public:
     }
 
     template <typename V>
-    const std::unordered_set<int>& neighbor_set(const V& idx) const {
+    const AdjacencySet& neighbor_set(const V& idx) const {
         return base().raw_node(idx).neighbors();
     }
 
@@ -1831,6 +1887,193 @@ public:
     using DirectedImpl<ConditionalDirectedGraph, graph::ConditionalGraphBase>::DirectedImpl;
 };
 
+// The transitive closure of the arcs of a DAG: the descendants of each node as a bitset, so a path query costs O(1).
+// The index is built when there are enough path queries without changes in the arcs, so the graphs that change after
+// each query keep using a graph search. The index is updated in O(n^2 / 64) when an arc is added, and rebuilt lazily
+// in O(n * m / 64) when an arc is removed.
+class ReachabilityIndex {
+public:
+    // Graphs with more nodes do not use the index, so its memory is bounded.
+    static constexpr int max_nodes = 4096;
+    // Number of path queries without changes in the arcs before building the index.
+    static constexpr int build_queries = 8;
+
+    ReachabilityIndex() = default;
+    ReachabilityIndex(const ReachabilityIndex& other) {
+        std::lock_guard<std::mutex> lock(other.m_mutex);
+        copy(other);
+    }
+
+    ReachabilityIndex& operator=(const ReachabilityIndex& other) {
+        if (this != &other) {
+            std::scoped_lock lock(m_mutex, other.m_mutex);
+            copy(other);
+        }
+        return *this;
+    }
+
+    // Returns whether there is a path from source to target, or std::nullopt if the index is not available.
+    template <typename G>
+    std::optional<bool> has_path(const G& g, int source, int target) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!available(g)) return std::nullopt;
+        return m_descendants[source][target];
+    }
+
+    // Returns whether there is a path from source to target without the arc source -> target, or std::nullopt if the
+    // index is not available.
+    template <typename G>
+    std::optional<bool> has_path_no_direct_arc(const G& g, int source, int target) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!available(g)) return std::nullopt;
+
+        for (auto ch : g.raw_nodes()[source].children()) {
+            if (ch != target && m_descendants[ch][target]) return true;
+        }
+
+        return false;
+    }
+
+    // Updates the index after adding the arc source -> target to g, if the index was valid for g before adding the arc
+    // (previous_version is the arcs_version() of g before adding the arc).
+    template <typename G>
+    void add_arc(const G& g, int source, int target, std::size_t previous_version) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_built || m_version != previous_version || static_cast<int>(m_descendants.size()) != g.num_raw_nodes())
+            return;
+
+        auto reached = m_descendants[target];
+        reached.set(target);
+
+        for (auto& descendants : m_descendants) {
+            if (descendants[source]) descendants |= reached;
+        }
+
+        m_descendants[source] |= reached;
+        m_version = g.arcs_version();
+    }
+
+private:
+    void copy(const ReachabilityIndex& other) {
+        m_descendants = other.m_descendants;
+        m_built = other.m_built;
+        m_version = other.m_version;
+        m_query_version = other.m_query_version;
+        m_queries = other.m_queries;
+    }
+
+    template <typename G>
+    bool available(const G& g) const {
+        if (g.num_raw_nodes() > max_nodes) return false;
+
+        auto version = g.arcs_version();
+        if (m_built && m_version == version && static_cast<int>(m_descendants.size()) == g.num_raw_nodes())
+            return true;
+
+        if (m_query_version != version) {
+            m_query_version = version;
+            m_queries = 0;
+        }
+
+        if (++m_queries < build_queries) return false;
+        return build(g);
+    }
+
+    template <typename G>
+    bool build(const G& g) const {
+        int n = g.num_raw_nodes();
+        const auto& nodes = g.raw_nodes();
+
+        // Topological sort of the raw nodes (including the interface nodes of a conditional graph).
+        std::vector<int> incoming(n, 0);
+        std::vector<int> order;
+        order.reserve(n);
+        int num_valid = 0;
+        for (int i = 0; i < n; ++i) {
+            if (!nodes[i].is_valid()) continue;
+            ++num_valid;
+            incoming[i] = nodes[i].parents().size();
+            if (incoming[i] == 0) order.push_back(i);
+        }
+
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (auto ch : nodes[order[k]].children()) {
+                if (--incoming[ch] == 0) order.push_back(ch);
+            }
+        }
+
+        m_built = false;
+        // The graph has a cycle.
+        if (static_cast<int>(order.size()) != num_valid) return false;
+
+        m_descendants.assign(n, dynamic_bitset<>(static_cast<size_t>(n)));
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            auto& descendants = m_descendants[*it];
+            for (auto ch : nodes[*it].children()) {
+                descendants |= m_descendants[ch];
+                descendants.set(ch);
+            }
+        }
+
+        m_built = true;
+        m_version = g.arcs_version();
+        return true;
+    }
+
+    mutable std::mutex m_mutex;
+    mutable std::vector<dynamic_bitset<>> m_descendants;
+    mutable bool m_built = false;
+    mutable std::size_t m_version = 0;
+    mutable std::size_t m_query_version = 0;
+    mutable int m_queries = 0;
+};
+
+// Caches the topological sort of a graph while its nodes and arcs do not change.
+class TopologicalOrderCache {
+public:
+    TopologicalOrderCache() = default;
+    TopologicalOrderCache(const TopologicalOrderCache& other) {
+        std::lock_guard<std::mutex> lock(other.m_mutex);
+        copy(other);
+    }
+
+    TopologicalOrderCache& operator=(const TopologicalOrderCache& other) {
+        if (this != &other) {
+            std::scoped_lock lock(m_mutex, other.m_mutex);
+            copy(other);
+        }
+        return *this;
+    }
+
+    // Returns the cached topological sort of g. If the nodes or the arcs of g changed, it is computed again with
+    // sort(), which returns a std::vector<int>.
+    template <typename G, typename Sort>
+    const std::vector<int>& get(const G& g, Sort&& sort) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto version = std::make_pair(g.nodes_version(), g.arcs_version());
+        if (!m_valid || m_version != version) {
+            m_valid = false;
+            m_order = sort();
+            m_version = version;
+            m_valid = true;
+        }
+
+        return m_order;
+    }
+
+private:
+    void copy(const TopologicalOrderCache& other) {
+        m_order = other.m_order;
+        m_valid = other.m_valid;
+        m_version = other.m_version;
+    }
+
+    mutable std::mutex m_mutex;
+    mutable std::vector<int> m_order;
+    mutable bool m_valid = false;
+    mutable std::pair<std::size_t, std::size_t> m_version;
+};
+
 template <typename Derived, typename BaseClass>
 class DagImpl : public BaseClass {
 public:
@@ -1846,11 +2089,11 @@ public:
     DagImpl(const std::vector<std::string>& nodes) : BaseClass(nodes) {}
     template <typename B = BaseClass, std::enable_if_t<std::is_same_v<DirectedGraph, B>, int> = 0>
     DagImpl(const ArcStringVector& arcs) : BaseClass(arcs) {
-        topological_sort();
+        topological_indices();
     }
     template <typename B = BaseClass, std::enable_if_t<std::is_same_v<DirectedGraph, B>, int> = 0>
     DagImpl(const std::vector<std::string>& nodes, const ArcStringVector& arcs) : BaseClass(nodes, arcs) {
-        topological_sort();
+        topological_indices();
     }
 
     // /////////////////////////////////////
@@ -1864,10 +2107,15 @@ public:
             const std::vector<std::string>& interface_nodes,
             const ArcStringVector& arcs)
         : BaseClass(nodes, interface_nodes, arcs) {
-        topological_sort();
+        topological_indices();
     }
 
     std::vector<std::string> topological_sort() const;
+    // Same as topological_sort(), but it returns the indices of the nodes. The sort is cached until the nodes or the
+    // arcs change, so the returned reference is invalidated when the graph is modified.
+    const std::vector<int>& topological_indices() const {
+        return m_topological_order.get(*this, [this]() { return compute_topological_indices(); });
+    }
 
     template <typename V>
     bool can_add_arc(const V& source, const V& target) const {
@@ -1887,6 +2135,25 @@ public:
 
     bool can_flip_arc_unsafe(int source, int target) const;
 
+    template <typename V>
+    bool has_path(const V& source, const V& target) const {
+        auto s = this->check_index(source);
+        auto t = this->check_index(target);
+        return has_path_unsafe(s, t);
+    }
+
+    // Same as DirectedImpl::has_path_unsafe() and DirectedImpl::has_path_unsafe_no_direct_arc(), but they use the
+    // ReachabilityIndex when it is available.
+    bool has_path_unsafe(int source, int target) const;
+    bool has_path_unsafe_no_direct_arc(int source, int target) const;
+
+    // Same as ArcGraph::add_arc_unsafe(), but it also updates the ReachabilityIndex.
+    void add_arc_unsafe(int source, int target) {
+        auto previous_version = this->arcs_version();
+        BaseClass::add_arc_unsafe(source, target);
+        m_reachability.add_arc(*this, source, target, previous_version);
+    }
+
     template <typename V>
     void add_arc(const V& source, const V& target) {
         auto s = this->check_index(source);
@@ -1899,10 +2166,16 @@ public:
 
         if (!this->has_arc_unsafe(s, t)) {
             check_can_exist_arc(*this, s, t);
-            BaseClass::add_arc_unsafe(s, t);
+            add_arc_unsafe(s, t);
         }
     }
 
+    // Adds all the arcs (names or indices of the nodes) and checks the acyclicity once with a topological sort, instead
+    // of a path search before adding each arc as in add_arc(). The arcs already present in the graph are ignored. If
+    // the arcs create a cycle, the graph is not modified.
+    template <typename V>
+    void add_arcs(const std::vector<std::pair<V, V>>& arcs);
+
     template <typename V>
     void flip_arc(const V& source, const V& target) {
         auto s = this->check_index(source);
@@ -1922,7 +2195,7 @@ public:
 
     bool is_dag() const {
         try {
-            topological_sort();
+            topological_indices();
             return true;
         } catch (std::invalid_argument&) {
             return false;
@@ -1941,6 +2214,12 @@ public:
                                                         const std::vector<std::string>& interface_nodes) const;
     ConditionalGraph<DirectedAcyclic> conditional_graph() const;
     Graph<DirectedAcyclic> unconditional_graph() const;
+
+private:
+    std::vector<int> compute_topological_indices() const;
+
+    ReachabilityIndex m_reachability;
+    TopologicalOrderCache m_topological_order;
 };
 
 class DagBase {
@@ -1967,10 +2246,10 @@ public:
     virtual const ArcSet& arc_indices() const = 0;
     virtual std::vector<std::string> parents(const std::string& node) const = 0;
     virtual std::vector<int> parent_indices(const std::string& node) const = 0;
-    virtual const std::unordered_set<int>& parent_set(const std::string& node) const = 0;
+    virtual const AdjacencySet& parent_set(const std::string& node) const = 0;
     virtual std::vector<std::string> children(const std::string& node) const = 0;
     virtual std::vector<int> children_indices(const std::string& node) const = 0;
-    virtual const std::unordered_set<int>& children_set(const std::string& idx) const = 0;
+    virtual const AdjacencySet& children_set(const std::string& idx) const = 0;
     virtual void add_arc(const std::string& source, const std::string& target) = 0;
     virtual bool has_arc(const std::string& source, const std::string& target) const = 0;
     virtual void remove_arc(const std::string& source, const std::string& target) = 0;
@@ -1984,6 +2263,7 @@ public:
     virtual ConditionalGraph<DirectedAcyclic> conditional_graph() const = 0;
     virtual Graph<DirectedAcyclic> unconditional_graph() const = 0;
     virtual std::vector<std::string> topological_sort() const = 0;
+    virtual const std::vector<int>& topological_indices() const = 0;
     virtual bool is_dag() const = 0;
 };
 
@@ -2069,7 +2349,7 @@ public:
     std::vector<int> parent_indices(const std::string& node) const override { return B::parent_indices(node); }
 
     using B::parent_set;
-    const std::unordered_set<int>& parent_set(const std::string& node) const override { return B::parent_set(node); }
+    const AdjacencySet& parent_set(const std::string& node) const override { return B::parent_set(node); }
 
     using B::children;
     std::vector<std::string> children(const std::string& node) const override { return B::children(node); }
@@ -2078,7 +2358,7 @@ public:
     std::vector<int> children_indices(const std::string& node) const override { return B::children_indices(node); }
 
     using B::children_set;
-    const std::unordered_set<int>& children_set(const std::string& node) const override {
+    const AdjacencySet& children_set(const std::string& node) const override {
         return B::children_set(node);
     }
 
@@ -2117,6 +2397,8 @@ public:
 
     std::vector<std::string> topological_sort() const override { return B::topological_sort(); }
 
+    const std::vector<int>& topological_indices() const override { return B::topological_indices(); }
+
     bool is_dag() const override { return B::is_dag(); }
 };
 
@@ -2657,6 +2939,19 @@ inline Graph<Directed> DirectedImpl<Derived, BaseClass>::unconditional_graph() c
 
 template <typename Derived, typename BaseClass>
 std::vector<std::string> DagImpl<Derived, BaseClass>::topological_sort() const {
+    const auto& indices = topological_indices();
+
+    std::vector<std::string> top_sort;
+    top_sort.reserve(indices.size());
+    for (auto idx : indices) {
+        top_sort.push_back(this->name(idx));
+    }
+
+    return top_sort;
+}
+
+template <typename Derived, typename BaseClass>
+std::vector<int> DagImpl<Derived, BaseClass>::compute_topological_indices() const {
     std::vector<int> incoming_edges(this->num_nodes());
 
     for (const auto& n : this->nodes()) {
@@ -2674,7 +2969,7 @@ std::vector<std::string> DagImpl<Derived, BaseClass>::topological_sort() const {
         }
     }
 
-    std::vector<std::string> top_sort;
+    std::vector<int> top_sort;
     top_sort.reserve(this->num_nodes());
 
     std::vector<int> stack;
@@ -2687,7 +2982,7 @@ std::vector<std::string> DagImpl<Derived, BaseClass>::topological_sort() const {
         auto idx = this->index_from_collapsed(coll_idx);
         stack.pop_back();
 
-        top_sort.push_back(this->collapsed_name(coll_idx));
+        top_sort.push_back(idx);
 
         for (const auto& children : this->children_set(idx)) {
             auto coll_ch = this->collapsed_from_index(children);
@@ -2707,6 +3002,18 @@ std::vector<std::string> DagImpl<Derived, BaseClass>::topological_sort() const {
     return top_sort;
 }
 
+template <typename Derived, typename BaseClass>
+bool DagImpl<Derived, BaseClass>::has_path_unsafe(int source, int target) const {
+    if (auto path = m_reachability.has_path(*this, source, target)) return *path;
+    return BaseClass::has_path_unsafe(source, target);
+}
+
+template <typename Derived, typename BaseClass>
+bool DagImpl<Derived, BaseClass>::has_path_unsafe_no_direct_arc(int source, int target) const {
+    if (auto path = m_reachability.has_path_no_direct_arc(*this, source, target)) return *path;
+    return BaseClass::has_path_unsafe_no_direct_arc(source, target);
+}
+
 template <typename Derived, typename BaseClass>
 bool DagImpl<Derived, BaseClass>::can_add_arc_unsafe(int source, int target) const {
     if (source != target && can_exist_arc(*this, source, target) &&
@@ -2717,6 +3024,43 @@ bool DagImpl<Derived, BaseClass>::can_add_arc_unsafe(int source, int target) con
     return false;
 }
 
+template <typename Derived, typename BaseClass>
+template <typename V>
+void DagImpl<Derived, BaseClass>::add_arcs(const std::vector<std::pair<V, V>>& arcs) {
+    // The arcs are checked before modifying the graph.
+    std::vector<Arc> indices;
+    indices.reserve(arcs.size());
+    for (const auto& arc : arcs) {
+        auto s = this->check_index(arc.first);
+        auto t = this->check_index(arc.second);
+        if (s == t) {
+            throw std::runtime_error("Arc " + this->name(s) + " -> " + this->name(t) +
+                                     " addition would break acyclity.");
+        }
+
+        if (!this->has_arc_unsafe(s, t)) check_can_exist_arc(*this, s, t);
+        indices.push_back({s, t});
+    }
+
+    // The ReachabilityIndex is not updated for each arc. It is rebuilt when it is needed again.
+    std::vector<Arc> added;
+    added.reserve(indices.size());
+    for (const auto& arc : indices) {
+        if (!this->has_arc_unsafe(arc.first, arc.second)) {
+            BaseClass::add_arc_unsafe(arc.first, arc.second);
+            added.push_back(arc);
+        }
+    }
+
+    if (!is_dag()) {
+        for (const auto& arc : added) {
+            BaseClass::remove_arc_unsafe(arc.first, arc.second);
+        }
+
+        throw std::runtime_error("The addition of the arcs would break acyclity.");
+    }
+}
+
 template <typename Derived, typename BaseClass>
 bool DagImpl<Derived, BaseClass>::can_flip_arc_unsafe(int source, int target) const {
     if (source == target || !can_exist_arc(*this, target, source)) return false;
@@ -1,27 +1,98 @@
 #ifndef PYBNESIAN_GRAPH_GRAPH_TYPES_HPP
 #define PYBNESIAN_GRAPH_GRAPH_TYPES_HPP
 
+#include <algorithm>
+#include <initializer_list>
 #include <string>
 #include <unordered_set>
+#include <vector>
 #include <util/hash_utils.hpp>
 
 namespace graph {
 
-class PDNode;
+// Set of node indices stored as a sorted vector. The parents, children and neighbors of a node are usually few, so a
+// contiguous array is more compact and faster to traverse and query than a hash set.
+class SortedIndexSet {
+public:
+    using value_type = int;
+    using size_type = std::size_t;
+    using const_iterator = std::vector<int>::const_iterator;
+    using iterator = const_iterator;
+
+    SortedIndexSet() = default;
+    SortedIndexSet(std::initializer_list<int> indices) : SortedIndexSet(indices.begin(), indices.end()) {}
+
+    template <typename InputIt>
+    SortedIndexSet(InputIt first, InputIt last) : m_indices(first, last) {
+        std::sort(m_indices.begin(), m_indices.end());
+        m_indices.erase(std::unique(m_indices.begin(), m_indices.end()), m_indices.end());
+    }
+
+    const_iterator begin() const { return m_indices.begin(); }
+    const_iterator end() const { return m_indices.end(); }
+    const_iterator cbegin() const { return m_indices.cbegin(); }
+    const_iterator cend() const { return m_indices.cend(); }
+
+    size_type size() const { return m_indices.size(); }
+    bool empty() const { return m_indices.empty(); }
+
+    const_iterator find(int idx) const {
+        auto it = std::lower_bound(m_indices.begin(), m_indices.end(), idx);
+        return (it != m_indices.end() && *it == idx) ? it : m_indices.end();
+    }
+
+    size_type count(int idx) const { return std::binary_search(m_indices.begin(), m_indices.end(), idx); }
+    bool contains(int idx) const { return count(idx) > 0; }
+
+    std::pair<const_iterator, bool> insert(int idx) {
+        auto it = std::lower_bound(m_indices.begin(), m_indices.end(), idx);
+        if (it != m_indices.end() && *it == idx) return {it, false};
+        return {m_indices.insert(it, idx), true};
+    }
+
+    template <typename InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (; first != last; ++first) insert(*first);
+    }
+
+    size_type erase(int idx) {
+        auto it = std::lower_bound(m_indices.begin(), m_indices.end(), idx);
+        if (it == m_indices.end() || *it != idx) return 0;
+        m_indices.erase(it);
+        return 1;
+    }
+
+    void clear() { m_indices.clear(); }
+
+    bool operator==(const SortedIndexSet& other) const { return m_indices == other.m_indices; }
+    bool operator!=(const SortedIndexSet& other) const { return m_indices != other.m_indices; }
+
+private:
+    std::vector<int> m_indices;
+};
 
-class DNode {
+template <typename Set>
+class PDNodeImpl;
+
+// The nodes are templated on the set type that stores their adjacent nodes, so the storage policy of each graph type
+// can be selected in its GraphTraits.
+template <typename Set>
+class DNodeImpl {
 public:
-    DNode(int idx, std::string name, std::unordered_set<int> parents = {}, std::unordered_set<int> children = {})
+    using AdjacencySet = Set;
+
+    DNodeImpl(int idx, std::string name, Set parents = {}, Set children = {})
         : m_idx(idx), m_name(name), m_parents(parents), m_children(children) {}
-    friend class PDNode;
+    template <typename>
+    friend class PDNodeImpl;
 
     int index() const { return m_idx; }
 
     const std::string& name() const { return m_name; }
 
-    const std::unordered_set<int>& parents() const { return m_parents; }
+    const Set& parents() const { return m_parents; }
 
-    const std::unordered_set<int>& children() const { return m_children; }
+    const Set& children() const { return m_children; }
 
     void add_parent(int p) { m_parents.insert(p); }
 
@@ -47,8 +118,8 @@ public:
 private:
     int m_idx;
     std::string m_name;
-    std::unordered_set<int> m_parents;
-    std::unordered_set<int> m_children;
+    Set m_parents;
+    Set m_children;
 };
 
 using Arc = std::pair<int, int>;
@@ -64,18 +135,21 @@ struct ArcHash {
     }
 };
 
-class UNode {
+template <typename Set>
+class UNodeImpl {
 public:
-    UNode(int idx, std::string name, std::unordered_set<int> neighbors = {})
-        : m_idx(idx), m_name(name), m_neighbors(neighbors) {}
+    using AdjacencySet = Set;
+
+    UNodeImpl(int idx, std::string name, Set neighbors = {}) : m_idx(idx), m_name(name), m_neighbors(neighbors) {}
 
-    friend class PDNode;
+    template <typename>
+    friend class PDNodeImpl;
 
     int index() const { return m_idx; }
 
     const std::string& name() const { return m_name; }
 
-    const std::unordered_set<int>& neighbors() const { return m_neighbors; }
+    const Set& neighbors() const { return m_neighbors; }
 
     void add_neighbor(int p) { m_neighbors.insert(p); }
 
@@ -92,7 +166,7 @@ public:
 private:
     int m_idx;
     std::string m_name;
-    std::unordered_set<int> m_neighbors;
+    Set m_neighbors;
 };
 
 using Edge = std::pair<int, int>;
@@ -120,23 +194,22 @@ struct EdgeEqualTo {
     }
 };
 
-class PDNode {
+template <typename Set>
+class PDNodeImpl {
 public:
-    PDNode(int idx,
-           std::string name,
-           std::unordered_set<int> parents = {},
-           std::unordered_set<int> children = {},
-           std::unordered_set<int> neighbors = {})
+    using AdjacencySet = Set;
+
+    PDNodeImpl(int idx, std::string name, Set parents = {}, Set children = {}, Set neighbors = {})
         : m_idx(idx), m_name(name), m_neighbors(neighbors), m_parents(parents), m_children(children) {}
 
-    PDNode(DNode&& dn)
+    PDNodeImpl(DNodeImpl<Set>&& dn)
         : m_idx(dn.m_idx),
           m_name(std::move(dn.m_name)),
           m_neighbors(),
           m_parents(std::move(dn.m_parents)),
           m_children(std::move(dn.m_children)) {}
 
-    PDNode(UNode&& un)
+    PDNodeImpl(UNodeImpl<Set>&& un)
         : m_idx(un.m_idx),
           m_name(std::move(un.m_name)),
           m_neighbors(std::move(un.m_neighbors)),
@@ -147,11 +220,11 @@ public:
 
     const std::string& name() const { return m_name; }
 
-    const std::unordered_set<int>& neighbors() const { return m_neighbors; }
+    const Set& neighbors() const { return m_neighbors; }
 
-    const std::unordered_set<int>& parents() const { return m_parents; }
+    const Set& parents() const { return m_parents; }
 
-    const std::unordered_set<int>& children() const { return m_children; }
+    const Set& children() const { return m_children; }
 
     void add_neighbor(int p) { m_neighbors.insert(p); }
 
@@ -182,11 +255,18 @@ public:
 private:
     int m_idx;
     std::string m_name;
-    std::unordered_set<int> m_neighbors;
-    std::unordered_set<int> m_parents;
-    std::unordered_set<int> m_children;
+    Set m_neighbors;
+    Set m_parents;
+    Set m_children;
 };
 
+// Default storage of the adjacent nodes. Use std::unordered_set<int> for graphs with nodes of very high degree.
+using AdjacencySet = SortedIndexSet;
+
+using DNode = DNodeImpl<AdjacencySet>;
+using UNode = UNodeImpl<AdjacencySet>;
+using PDNode = PDNodeImpl<AdjacencySet>;
+
 }  // namespace graph
 
 #endif  // PYBNESIAN_GRAPH_GRAPH_TYPES_HPP
\ No newline at end of file
@@ -0,0 +1,617 @@
+#include <inference/DiscreteInference.hpp>
+#include <numeric>
+#include <queue>
+#include <unordered_set>
+#include <factors/discrete/DiscreteFactor.hpp>
+#include <factors/discrete/discrete_indices.hpp>
+#include <util/hash_utils.hpp>
+#include <util/math_constants.hpp>
+
+using factors::discrete::DiscreteFactor, factors::discrete::DiscreteIndicesColumn;
+
+namespace inference {
+
+namespace {
+
+int num_configurations(const std::vector<int>& cardinality) {
+    return std::accumulate(cardinality.begin(), cardinality.end(), 1, std::multiplies<int>());
+}
+
+// Returns the stride in p of each variable of variables. The stride is 0 if p does not contain the variable.
+std::vector<int> strides_of(const DiscretePotential& p, const std::vector<int>& variables) {
+    std::vector<int> own_strides(p.variables.size());
+    int stride = 1;
+    for (size_t i = 0; i < p.variables.size(); ++i) {
+        own_strides[i] = stride;
+        stride *= p.cardinality[i];
+    }
+
+    std::vector<int> strides(variables.size(), 0);
+    for (size_t i = 0; i < variables.size(); ++i) {
+        auto pos = p.position(variables[i]);
+        if (pos != -1) strides[i] = own_strides[pos];
+    }
+
+    return strides;
+}
+
+// Calls f(i, j, k) for each configuration i of the variables with the given cardinality, where j and k are the indices
+// of the configuration in the potentials with strides strides_j and strides_k (see strides_of()).
+template <typename F>
+void for_each_configuration(const std::vector<int>& cardinality,
+                            const std::vector<int>& strides_j,
+                            const std::vector<int>& strides_k,
+                            F&& f) {
+    std::vector<int> configuration(cardinality.size(), 0);
+    int j = 0, k = 0;
+    for (int i = 0, i_end = num_configurations(cardinality); i < i_end; ++i) {
+        f(i, j, k);
+
+        for (size_t v = 0; v < cardinality.size(); ++v) {
+            if (++configuration[v] < cardinality[v]) {
+                j += strides_j[v];
+                k += strides_k[v];
+                break;
+            }
+
+            configuration[v] = 0;
+            j -= (cardinality[v] - 1) * strides_j[v];
+            k -= (cardinality[v] - 1) * strides_k[v];
+        }
+    }
+}
+
+// Normalizes the values to sum 1. If the sum is 0 (the evidence has probability 0), the values are NaN.
+void normalize(VectorXd& values) {
+    auto sum = values.sum();
+    if (sum > 0)
+        values /= sum;
+    else
+        values.setConstant(util::nan<double>);
+}
+
+struct EvidenceHash {
+    std::size_t operator()(const std::vector<int>& evidence) const {
+        std::size_t seed = evidence.size();
+        for (auto e : evidence) {
+            util::hash_combine(seed, e);
+        }
+        return seed;
+    }
+};
+
+}  // namespace
+
+DiscretePotential::DiscretePotential(std::vector<int> variables, std::vector<int> cardinality, double value)
+    : variables(std::move(variables)), cardinality(std::move(cardinality)), values() {
+    values = VectorXd::Constant(num_configurations(this->cardinality), value);
+}
+
+int DiscretePotential::position(int variable) const {
+    auto found = std::find(variables.begin(), variables.end(), variable);
+    return found == variables.end() ? -1 : std::distance(variables.begin(), found);
+}
+
+DiscretePotential DiscretePotential::product(const DiscretePotential& other) const {
+    auto new_variables = variables;
+    auto new_cardinality = cardinality;
+    for (size_t i = 0; i < other.variables.size(); ++i) {
+        if (!contains(other.variables[i])) {
+            new_variables.push_back(other.variables[i]);
+            new_cardinality.push_back(other.cardinality[i]);
+        }
+    }
+
+    DiscretePotential result(new_variables, new_cardinality, 0);
+    for_each_configuration(result.cardinality,
+                           strides_of(*this, result.variables),
+                           strides_of(other, result.variables),
+                           [&](int i, int j, int k) { result.values(i) = values(j) * other.values(k); });
+
+    return result;
+}
+
+DiscretePotential DiscretePotential::marginalize(const std::vector<int>& new_variables) const {
+    std::vector<int> new_cardinality;
+    new_cardinality.reserve(new_variables.size());
+    for (auto v : new_variables) {
+        new_cardinality.push_back(cardinality[position(v)]);
+    }
+
+    DiscretePotential result(new_variables, new_cardinality, 0);
+    for_each_configuration(cardinality,
+                           strides_of(*this, variables),
+                           strides_of(result, variables),
+                           [&](int, int j, int k) { result.values(k) += values(j); });
+
+    return result;
+}
+
+DiscretePotential DiscretePotential::sum_out(int variable) const {
+    std::vector<int> new_variables;
+    for (auto v : variables) {
+        if (v != variable) new_variables.push_back(v);
+    }
+
+    return marginalize(new_variables);
+}
+
+void DiscretePotential::reduce(int variable, int value) {
+    auto pos = position(variable);
+    int stride = num_configurations(std::vector<int>(cardinality.begin(), cardinality.begin() + pos));
+    for (int i = 0, i_end = values.rows(); i < i_end; ++i) {
+        if ((i / stride) % cardinality[pos] != value) values(i) = 0;
+    }
+}
+
+void DiscretePotential::absorb(const DiscretePotential& message, const DiscretePotential& previous) {
+    for_each_configuration(cardinality,
+                           strides_of(*this, variables),
+                           strides_of(message, variables),
+                           [&](int, int j, int k) {
+                               auto p = previous.values(k);
+                               values(j) = (p == 0) ? 0 : values(j) * message.values(k) / p;
+                           });
+}
+
+DiscreteInference::DiscreteInference(const BayesianNetworkBase& model)
+    : m_nodes(model.nodes()),
+      m_indices(),
+      m_categories(m_nodes.size()),
+      m_category_indices(m_nodes.size()),
+      m_parents(m_nodes.size()),
+      m_cpds(m_nodes.size()),
+      m_initial(),
+      m_calibrated(),
+      m_edges(),
+      m_node_clique() {
+    if (!model.fitted()) throw std::invalid_argument("Model not fitted.");
+
+    for (int i = 0, i_end = m_nodes.size(); i < i_end; ++i) {
+        m_indices.insert({m_nodes[i], i});
+    }
+
+    std::vector<std::shared_ptr<DiscreteFactor>> cpds;
+    cpds.reserve(m_nodes.size());
+    for (int i = 0, i_end = m_nodes.size(); i < i_end; ++i) {
+        auto cpd = std::dynamic_pointer_cast<DiscreteFactor>(model.cpd(m_nodes[i]));
+        if (!cpd) throw std::invalid_argument("The CPD of " + m_nodes[i] + " is not a DiscreteFactor.");
+
+        m_categories[i] = cpd->variable_values();
+        for (int j = 0, j_end = m_categories[i].size(); j < j_end; ++j) {
+            m_category_indices[i].insert({m_categories[i][j], j});
+        }
+
+        cpds.push_back(cpd);
+    }
+
+    for (int i = 0, i_end = m_nodes.size(); i < i_end; ++i) {
+        const auto& cpd = cpds[i];
+        std::vector<int> variables{i};
+        std::vector<int> cardinality{static_cast<int>(m_categories[i].size())};
+
+        const auto& evidence = cpd->evidence();
+        for (size_t k = 0; k < evidence.size(); ++k) {
+            auto p = index(evidence[k]);
+            if (cpd->evidence_values()[k] != m_categories[p]) {
+                throw std::invalid_argument("The categories of " + evidence[k] + " in the CPD of " + m_nodes[i] +
+                                            " are not the categories of the CPD of " + evidence[k] + ".");
+            }
+
+            m_parents[i].push_back(p);
+            variables.push_back(p);
+            cardinality.push_back(m_categories[p].size());
+        }
+
+        m_cpds[i] = DiscretePotential(variables, cardinality, 0);
+        m_cpds[i].values = cpd->dense_logprob().array().exp();
+    }
+
+    compile_junction_tree();
+}
+
+int DiscreteInference::index(const std::string& node) const {
+    auto found = m_indices.find(node);
+    if (found == m_indices.end()) throw std::invalid_argument("Node " + node + " is not present in the model.");
+    return found->second;
+}
+
+std::vector<std::vector<std::string>> DiscreteInference::cliques() const {
+    std::vector<std::vector<std::string>> names;
+    names.reserve(m_initial.size());
+    for (const auto& clique : m_initial) {
+        std::vector<std::string> clique_names;
+        for (auto v : clique.variables) {
+            clique_names.push_back(m_nodes[v]);
+        }
+        names.push_back(std::move(clique_names));
+    }
+
+    return names;
+}
+
+std::vector<int> DiscreteInference::evidence_indices(
+    const std::unordered_map<std::string, std::string>& evidence) const {
+    std::vector<int> indices(m_nodes.size(), -1);
+    for (const auto& [node, value] : evidence) {
+        auto i = index(node);
+        auto found = m_category_indices[i].find(value);
+        if (found == m_category_indices[i].end()) {
+            throw std::invalid_argument("Category " + value + " is not a category of " + node + ".");
+        }
+
+        indices[i] = found->second;
+    }
+
+    return indices;
+}
+
+void DiscreteInference::compile_junction_tree() {
+    int n = m_nodes.size();
+
+    // Moral graph.
+    std::vector<std::unordered_set<int>> adjacency(n);
+    for (int i = 0; i < n; ++i) {
+        const auto& parents = m_parents[i];
+        for (size_t k = 0; k < parents.size(); ++k) {
+            adjacency[i].insert(parents[k]);
+            adjacency[parents[k]].insert(i);
+            for (size_t l = k + 1; l < parents.size(); ++l) {
+                adjacency[parents[k]].insert(parents[l]);
+                adjacency[parents[l]].insert(parents[k]);
+            }
+        }
+    }
+
+    // Triangulation with the greedy min-fill heuristic. The ties are broken with the size of the clique.
+    std::vector<std::vector<int>> cliques;
+    std::vector<bool> eliminated(n, false);
+    for (int step = 0; step < n; ++step) {
+        int best = -1;
+        int best_fill = 0;
+        double best_weight = 0;
+        for (int v = 0; v < n; ++v) {
+            if (eliminated[v]) continue;
+
+            int fill = 0;
+            double weight = m_categories[v].size();
+            for (auto a : adjacency[v]) {
+                weight *= m_categories[a].size();
+                for (auto b : adjacency[v]) {
+                    if (a < b && !adjacency[a].count(b)) ++fill;
+                }
+            }
+
+            if (best == -1 || fill < best_fill || (fill == best_fill && weight < best_weight)) {
+                best = v;
+                best_fill = fill;
+                best_weight = weight;
+            }
+        }
+
+        std::vector<int> clique(adjacency[best].begin(), adjacency[best].end());
+        clique.push_back(best);
+        std::sort(clique.begin(), clique.end());
+
+        for (auto a : adjacency[best]) {
+            for (auto b : adjacency[best]) {
+                if (a != b) adjacency[a].insert(b);
+            }
+            adjacency[a].erase(best);
+        }
+        adjacency[best].clear();
+        eliminated[best] = true;
+
+        // A clique created by an elimination is not maximal only if it is contained in a previous clique.
+        bool maximal = std::none_of(cliques.begin(), cliques.end(), [&clique](const std::vector<int>& other) {
+            return std::includes(other.begin(), other.end(), clique.begin(), clique.end());
+        });
+
+        if (maximal) cliques.push_back(std::move(clique));
+    }
+
+    // Maximum weight spanning tree of the cliques (Kruskal), where the weight is the size of the separator. The
+    // disconnected components are joined with empty separators.
+    int num_cliques = cliques.size();
+    std::vector<std::tuple<int, int, std::vector<int>>> candidates;
+    for (int a = 0; a < num_cliques; ++a) {
+        for (int b = a + 1; b < num_cliques; ++b) {
+            std::vector<int> separator;
+            std::set_intersection(cliques[a].begin(),
+                                  cliques[a].end(),
+                                  cliques[b].begin(),
+                                  cliques[b].end(),
+                                  std::back_inserter(separator));
+            candidates.emplace_back(a, b, std::move(separator));
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return std::get<2>(a).size() > std::get<2>(b).size();
+    });
+
+    std::vector<int> component(num_cliques);
+    std::iota(component.begin(), component.end(), 0);
+    auto find = [&component](int c) {
+        while (component[c] != c) c = component[c] = component[component[c]];
+        return c;
+    };
+
+    std::vector<std::vector<std::pair<int, std::vector<int>>>> tree(num_cliques);
+    for (auto& [a, b, separator] : candidates) {
+        auto ca = find(a), cb = find(b);
+        if (ca == cb) continue;
+
+        component[ca] = cb;
+        tree[a].emplace_back(b, separator);
+        tree[b].emplace_back(a, separator);
+    }
+
+    // Breadth-first order of the edges from the root clique 0.
+    std::vector<bool> visited(num_cliques, false);
+    std::queue<int> pending;
+    pending.push(0);
+    visited[0] = true;
+    while (!pending.empty()) {
+        auto c = pending.front();
+        pending.pop();
+
+        for (const auto& [child, separator] : tree[c]) {
+            if (visited[child]) continue;
+
+            visited[child] = true;
+            m_edges.push_back(JunctionTreeEdge{c, child, separator});
+            pending.push(child);
+        }
+    }
+
+    auto clique_size = [this](const std::vector<int>& clique) {
+        double size = 1;
+        for (auto v : clique) size *= m_categories[v].size();
+        return size;
+    };
+
+    // The smallest clique that contains each node.
+    m_node_clique.assign(n, -1);
+    for (int c = 0; c < num_cliques; ++c) {
+        for (auto v : cliques[c]) {
+            if (m_node_clique[v] == -1 || clique_size(cliques[c]) < clique_size(cliques[m_node_clique[v]]))
+                m_node_clique[v] = c;
+        }
+    }
+
+    for (const auto& clique : cliques) {
+        std::vector<int> cardinality;
+        for (auto v : clique) cardinality.push_back(m_categories[v].size());
+        m_initial.emplace_back(clique, cardinality, 1);
+    }
+
+    // Each CPD is multiplied into the smallest clique that contains its family.
+    for (int i = 0; i < n; ++i) {
+        int best = -1;
+        for (int c = 0; c < num_cliques; ++c) {
+            const auto& clique = cliques[c];
+            bool contains_family = std::all_of(m_cpds[i].variables.begin(), m_cpds[i].variables.end(), [&](int v) {
+                return std::binary_search(clique.begin(), clique.end(), v);
+            });
+
+            if (contains_family && (best == -1 || clique_size(clique) < clique_size(cliques[best]))) best = c;
+        }
+
+        m_initial[best] = m_initial[best].product(m_cpds[i]);
+    }
+
+    m_calibrated = m_initial;
+    calibrate(m_calibrated);
+}
+
+void DiscreteInference::calibrate(std::vector<DiscretePotential>& cliques) const {
+    std::vector<DiscretePotential> separators;
+    separators.reserve(m_edges.size());
+    for (const auto& edge : m_edges) {
+        std::vector<int> cardinality;
+        for (auto v : edge.separator) cardinality.push_back(m_categories[v].size());
+        separators.emplace_back(edge.separator, cardinality, 1);
+    }
+
+    // Collect the messages from the leaves to the root.
+    for (int e = m_edges.size() - 1; e >= 0; --e) {
+        const auto& edge = m_edges[e];
+        auto message = cliques[edge.child].marginalize(edge.separator);
+        cliques[edge.parent].absorb(message, separators[e]);
+        separators[e] = std::move(message);
+    }
+
+    // Distribute the messages from the root to the leaves.
+    for (int e = 0, e_end = m_edges.size(); e < e_end; ++e) {
+        const auto& edge = m_edges[e];
+        auto message = cliques[edge.parent].marginalize(edge.separator);
+        cliques[edge.child].absorb(message, separators[e]);
+        separators[e] = std::move(message);
+    }
+}
+
+std::vector<DiscretePotential> DiscreteInference::calibrated_cliques(const std::vector<int>& evidence) const {
+    auto cliques = m_initial;
+    for (int v = 0, v_end = evidence.size(); v < v_end; ++v) {
+        if (evidence[v] != -1) cliques[m_node_clique[v]].reduce(v, evidence[v]);
+    }
+
+    calibrate(cliques);
+    return cliques;
+}
+
+VectorXd DiscreteInference::clique_marginal(const std::vector<DiscretePotential>& cliques, int variable) const {
+    VectorXd marginal = cliques[m_node_clique[variable]].marginalize({variable}).values;
+    normalize(marginal);
+    return marginal;
+}
+
+VectorXd DiscreteInference::query(const std::vector<std::string>& variables,
+                                  const std::unordered_map<std::string, std::string>& evidence) const {
+    if (variables.empty()) throw std::invalid_argument("The query must contain at least one variable.");
+
+    std::vector<int> query;
+    for (const auto& v : variables) {
+        auto i = index(v);
+        if (std::find(query.begin(), query.end(), i) != query.end())
+            throw std::invalid_argument("Variable " + v + " is repeated in the query.");
+        query.push_back(i);
+    }
+
+    auto ev = evidence_indices(evidence);
+
+    // The CPDs of the nodes that are not ancestors of the query or the evidence sum to 1, so they are removed.
+    std::vector<bool> relevant(m_nodes.size(), false);
+    std::vector<int> pending = query;
+    for (int v = 0, v_end = ev.size(); v < v_end; ++v) {
+        if (ev[v] != -1) pending.push_back(v);
+    }
+
+    while (!pending.empty()) {
+        auto v = pending.back();
+        pending.pop_back();
+        if (relevant[v]) continue;
+
+        relevant[v] = true;
+        pending.insert(pending.end(), m_parents[v].begin(), m_parents[v].end());
+    }
+
+    std::vector<DiscretePotential> potentials;
+    std::vector<int> eliminate;
+    for (int v = 0, v_end = m_nodes.size(); v < v_end; ++v) {
+        if (!relevant[v]) continue;
+
+        auto p = m_cpds[v];
+        for (auto pv : p.variables) {
+            if (ev[pv] != -1) p.reduce(pv, ev[pv]);
+        }
+        potentials.push_back(std::move(p));
+
+        if (std::find(query.begin(), query.end(), v) == query.end()) eliminate.push_back(v);
+    }
+
+    while (!eliminate.empty()) {
+        // Greedy order: the variable with the smallest product of the potentials that contain it.
+        size_t best = 0;
+        double best_size = std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < eliminate.size(); ++k) {
+            std::unordered_set<int> scope;
+            for (const auto& p : potentials) {
+                if (p.contains(eliminate[k])) scope.insert(p.variables.begin(), p.variables.end());
+            }
+
+            double size = 1;
+            for (auto v : scope) size *= m_categories[v].size();
+
+            if (size < best_size) {
+                best = k;
+                best_size = size;
+            }
+        }
+
+        auto variable = eliminate[best];
+        eliminate.erase(eliminate.begin() + best);
+
+        std::vector<DiscretePotential> remaining;
+        DiscretePotential product({}, {}, 1);
+        for (auto& p : potentials) {
+            if (p.contains(variable))
+                product = product.product(p);
+            else
+                remaining.push_back(std::move(p));
+        }
+
+        remaining.push_back(product.sum_out(variable));
+        potentials = std::move(remaining);
+    }
+
+    DiscretePotential joint({}, {}, 1);
+    for (const auto& p : potentials) {
+        joint = joint.product(p);
+    }
+
+    VectorXd posterior = joint.marginalize(query).values;
+    normalize(posterior);
+    return posterior;
+}
+
+VectorXd DiscreteInference::marginal(const std::string& variable,
+                                     const std::unordered_map<std::string, std::string>& evidence) const {
+    auto v = index(variable);
+    auto ev = evidence_indices(evidence);
+
+    if (evidence.empty()) return clique_marginal(m_calibrated, v);
+    return clique_marginal(calibrated_cliques(ev), v);
+}
+
+std::vector<MatrixXd> DiscreteInference::query_batch(const std::vector<std::string>& variables,
+                                                     const DataFrame& evidence) const {
+    std::vector<int> query;
+    for (const auto& v : variables) {
+        query.push_back(index(v));
+    }
+
+    auto rows = evidence->num_rows();
+    std::vector<int> columns;
+    std::vector<std::vector<int>> values;
+    for (const auto& name : evidence->schema()->field_names()) {
+        auto i = index(name);
+        factors::discrete::check_domain_variable(evidence, name, m_categories[i]);
+
+        auto column = evidence.col(name);
+        std::vector<int> column_values(rows);
+        factors::discrete::for_each_discrete_indices_block(
+            std::vector<DiscreteIndicesColumn>{factors::discrete::discrete_indices_column(column, 1)},
+            rows,
+            nullptr,
+            [&](int offset, int length, const int* indices) {
+                for (int k = 0; k < length; ++k) {
+                    column_values[offset + k] = column->IsNull(offset + k) ? -1 : indices[k];
+                }
+            });
+
+        columns.push_back(i);
+        values.push_back(std::move(column_values));
+    }
+
+    std::vector<MatrixXd> result;
+    for (auto q : query) {
+        result.push_back(MatrixXd(rows, m_categories[q].size()));
+    }
+
+    // The first row of each distinct evidence configuration.
+    std::unordered_map<std::vector<int>, int, EvidenceHash> first_rows;
+    std::vector<int> ev(m_nodes.size(), -1);
+    std::vector<int> key(columns.size());
+    for (int r = 0; r < rows; ++r) {
+        bool has_evidence = false;
+        for (size_t k = 0; k < columns.size(); ++k) {
+            key[k] = ev[columns[k]] = values[k][r];
+            has_evidence |= key[k] != -1;
+        }
+
+        auto [it, inserted] = first_rows.insert({key, r});
+        if (!inserted) {
+            for (size_t q = 0; q < query.size(); ++q) {
+                result[q].row(r) = result[q].row(it->second);
+            }
+            continue;
+        }
+
+        std::vector<DiscretePotential> evidence_cliques;
+        const auto* cliques = &m_calibrated;
+        if (has_evidence) {
+            evidence_cliques = calibrated_cliques(ev);
+            cliques = &evidence_cliques;
+        }
+
+        for (size_t q = 0; q < query.size(); ++q) {
+            result[q].row(r) = clique_marginal(*cliques, query[q]).transpose();
+        }
+    }
+
+    return result;
+}
+
+}  // namespace inference
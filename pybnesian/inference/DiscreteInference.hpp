@@ -0,0 +1,99 @@
+#ifndef PYBNESIAN_INFERENCE_DISCRETEINFERENCE_HPP
+#define PYBNESIAN_INFERENCE_DISCRETEINFERENCE_HPP
+
+#include <models/BayesianNetwork.hpp>
+
+using Eigen::MatrixXd, Eigen::VectorXd;
+using models::BayesianNetworkBase;
+
+namespace inference {
+
+// A table of non-negative values over a set of discrete variables (identified by their index in the model). The table
+// is indexed like the DiscreteFactor tables: the stride of the first variable is 1 and the stride of each variable is
+// the product of the cardinalities of the previous variables.
+struct DiscretePotential {
+    DiscretePotential() = default;
+    DiscretePotential(std::vector<int> variables, std::vector<int> cardinality, double value);
+
+    // Returns the position of variable in variables, or -1 if the potential does not contain it.
+    int position(int variable) const;
+    bool contains(int variable) const { return position(variable) != -1; }
+
+    DiscretePotential product(const DiscretePotential& other) const;
+    // Returns the potential over variables (in that order), summing out the rest of variables.
+    DiscretePotential marginalize(const std::vector<int>& variables) const;
+    DiscretePotential sum_out(int variable) const;
+    // Sets to 0 the values of the configurations where variable is not equal to value.
+    void reduce(int variable, int value);
+    // Multiplies the potential by message / previous, where message and previous are potentials over the same subset of
+    // variables. 0 / 0 is 0.
+    void absorb(const DiscretePotential& message, const DiscretePotential& previous);
+
+    std::vector<int> variables;
+    std::vector<int> cardinality;
+    VectorXd values;
+};
+
+// Exact inference on a fitted Bayesian network of DiscreteFactors. The queries of joint posteriors are solved with
+// variable elimination, removing first the nodes that are not ancestors of the query or the evidence. The queries of
+// marginal posteriors are solved with a junction tree compiled when the object is created. The junction tree
+// calibrated without evidence is cached, so the marginals without evidence are read from the cached tree.
+//
+// The DiscreteInference does not change if the model is modified or fitted again.
+class DiscreteInference {
+public:
+    DiscreteInference(const BayesianNetworkBase& model);
+
+    const std::vector<std::string>& nodes() const { return m_nodes; }
+    const std::vector<std::string>& categories(const std::string& node) const { return m_categories[index(node)]; }
+    // The variables of each clique of the junction tree.
+    std::vector<std::vector<std::string>> cliques() const;
+
+    // Returns the joint posterior P(variables | evidence), indexed like a DiscretePotential over variables. If the
+    // evidence has probability 0, the posterior is NaN.
+    VectorXd query(const std::vector<std::string>& variables,
+                   const std::unordered_map<std::string, std::string>& evidence) const;
+    // Returns the marginal posterior P(variable | evidence).
+    VectorXd marginal(const std::string& variable, const std::unordered_map<std::string, std::string>& evidence) const;
+    // Returns the marginal posterior of each variable for each row of evidence. The columns of evidence are categorical
+    // columns of the nodes, and the null values are not observed. The i-th row of the k-th matrix is
+    // P(variables[k] | evidence of the i-th row). The junction tree is calibrated once for each distinct evidence row.
+    std::vector<MatrixXd> query_batch(const std::vector<std::string>& variables, const DataFrame& evidence) const;
+
+private:
+    // A junction tree edge. The edges are sorted in breadth-first order from the root clique 0.
+    struct JunctionTreeEdge {
+        int parent;
+        int child;
+        std::vector<int> separator;
+    };
+
+    int index(const std::string& node) const;
+    // Returns the category index of each node in evidence, or -1 if the node is not observed.
+    std::vector<int> evidence_indices(const std::unordered_map<std::string, std::string>& evidence) const;
+
+    void compile_junction_tree();
+    // Calibrates the clique potentials with the Hugin algorithm.
+    void calibrate(std::vector<DiscretePotential>& cliques) const;
+    // Returns the calibrated clique potentials for the evidence (without normalizing).
+    std::vector<DiscretePotential> calibrated_cliques(const std::vector<int>& evidence) const;
+    VectorXd clique_marginal(const std::vector<DiscretePotential>& cliques, int variable) const;
+
+    std::vector<std::string> m_nodes;
+    std::unordered_map<std::string, int> m_indices;
+    std::vector<std::vector<std::string>> m_categories;
+    std::vector<std::unordered_map<std::string, int>> m_category_indices;
+    std::vector<std::vector<int>> m_parents;
+    // The potential P(node | parents) of each node.
+    std::vector<DiscretePotential> m_cpds;
+    // The clique potentials before the calibration, and after the calibration without evidence.
+    std::vector<DiscretePotential> m_initial;
+    std::vector<DiscretePotential> m_calibrated;
+    std::vector<JunctionTreeEdge> m_edges;
+    // The smallest clique that contains each node.
+    std::vector<int> m_node_clique;
+};
+
+}  // namespace inference
+
+#endif  // PYBNESIAN_INFERENCE_DISCRETEINFERENCE_HPP
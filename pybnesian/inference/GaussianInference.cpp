@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <numeric>
+#include <inference/GaussianInference.hpp>
+#include <factors/continuous/LinearGaussianCPD.hpp>
+#include <util/math_constants.hpp>
+#include <util/profiler.hpp>
+
+using factors::continuous::LinearGaussianCPD;
+
+namespace inference {
+
+namespace {
+
+VectorXd select(const VectorXd& v, const std::vector<int>& indices) {
+    VectorXd res(indices.size());
+    for (int i = 0, i_end = indices.size(); i < i_end; ++i) {
+        res(i) = v(indices[i]);
+    }
+
+    return res;
+}
+
+MatrixXd select(const MatrixXd& m, const std::vector<int>& rows, const std::vector<int>& cols) {
+    MatrixXd res(rows.size(), cols.size());
+    for (int j = 0, j_end = cols.size(); j < j_end; ++j) {
+        for (int i = 0, i_end = rows.size(); i < i_end; ++i) {
+            res(i, j) = m(rows[i], cols[j]);
+        }
+    }
+
+    return res;
+}
+
+}  // namespace
+
+GaussianInference::GaussianInference(const BayesianNetworkBase& model)
+    : m_nodes(model.nodes()),
+      m_indices(),
+      m_mean(VectorXd::Zero(m_nodes.size())),
+      m_covariance(MatrixXd::Zero(m_nodes.size(), m_nodes.size())),
+      m_mutex(),
+      m_llt_cache(),
+      m_llt_order() {
+    if (!model.fitted()) throw std::invalid_argument("Model not fitted.");
+
+    for (int i = 0, i_end = m_nodes.size(); i < i_end; ++i) {
+        m_indices.insert({m_nodes[i], i});
+    }
+
+    // The parents of each node are visited before the node, so the covariances of a node with the visited nodes are
+    // Cov(x_i, x_u) = sum_k beta(k+1) Cov(x_parent_k, x_u). The covariances with the nodes that are not visited yet are
+    // still zero, and they are filled when these nodes are visited.
+    for (const auto& node : model.graph().topological_sort()) {
+        auto lg = std::dynamic_pointer_cast<LinearGaussianCPD>(model.cpd(node));
+        if (!lg) throw std::invalid_argument("The CPD of " + node + " is not a LinearGaussianCPD.");
+
+        const auto& beta = lg->beta();
+        const auto& evidence = lg->evidence();
+        auto i = index(node);
+
+        m_mean(i) = beta(0);
+        VectorXd row = VectorXd::Zero(m_nodes.size());
+        for (int k = 0, k_end = evidence.size(); k < k_end; ++k) {
+            auto p = index(evidence[k]);
+            m_mean(i) += beta(k + 1) * m_mean(p);
+            row += beta(k + 1) * m_covariance.col(p);
+        }
+
+        double variance = lg->variance();
+        for (int k = 0, k_end = evidence.size(); k < k_end; ++k) {
+            variance += beta(k + 1) * row(index(evidence[k]));
+        }
+        row(i) = variance;
+
+        m_covariance.col(i) = row;
+        m_covariance.row(i) = row.transpose();
+    }
+}
+
+int GaussianInference::index(const std::string& node) const {
+    auto found = m_indices.find(node);
+    if (found == m_indices.end()) throw std::invalid_argument("Node " + node + " is not present in the model.");
+    return found->second;
+}
+
+std::pair<std::vector<int>, MatrixXd> GaussianInference::evidence_matrix(const DataFrame& evidence,
+                                                                         const std::vector<std::string>& names) const {
+    std::vector<int> indices;
+    MatrixXd values(evidence->num_rows(), names.size());
+    for (int k = 0, k_end = names.size(); k < k_end; ++k) {
+        indices.push_back(index(names[k]));
+
+        if (evidence.null_count(names[k]) > 0)
+            throw std::invalid_argument("The values of " + names[k] + " contain null values.");
+
+        switch (evidence.col(names[k])->type_id()) {
+            case arrow::Type::DOUBLE:
+                values.col(k) = *evidence.to_eigen<false, arrow::DoubleType, false>(names[k]);
+                break;
+            case arrow::Type::FLOAT:
+                values.col(k) = evidence.to_eigen<false, arrow::FloatType, false>(names[k])->template cast<double>();
+                break;
+            default:
+                throw std::invalid_argument("Wrong data type for " + names[k] +
+                                            ". [double] or [float] data is expected.");
+        }
+    }
+
+    return std::make_pair(std::move(indices), std::move(values));
+}
+
+std::shared_ptr<const Eigen::LLT<MatrixXd>> GaussianInference::evidence_llt(const std::vector<int>& evidence) const {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_llt_cache.find(evidence);
+        if (found != m_llt_cache.end()) {
+            util::profile_count([] { return std::string("gaussian_inference:llt_hit"); });
+            return found->second;
+        }
+    }
+
+    util::profile_count([] { return std::string("gaussian_inference:llt_miss"); });
+    auto llt = std::make_shared<Eigen::LLT<MatrixXd>>(select(m_covariance, evidence, evidence));
+    if (llt->info() != Eigen::Success)
+        throw std::runtime_error("The covariance matrix of the evidence is not positive definite.");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto [it, inserted] = m_llt_cache.insert({evidence, llt});
+    if (inserted) {
+        m_llt_order.push_back(evidence);
+        if (m_llt_order.size() > max_cached_evidence) {
+            m_llt_cache.erase(m_llt_order.front());
+            m_llt_order.pop_front();
+        }
+    }
+
+    return it->second;
+}
+
+GaussianInference::GaussianPosterior GaussianInference::posterior(const std::vector<std::string>& variables,
+                                                                  const std::vector<int>& evidence) const {
+    if (variables.empty()) throw std::invalid_argument("The query must contain at least one variable.");
+
+    std::vector<bool> observed(m_nodes.size(), false);
+    for (auto e : evidence) {
+        observed[e] = true;
+    }
+
+    std::vector<int> query;
+    for (const auto& v : variables) {
+        auto i = index(v);
+        if (observed[i]) throw std::invalid_argument("Variable " + v + " is both in the query and the evidence.");
+        if (std::find(query.begin(), query.end(), i) != query.end())
+            throw std::invalid_argument("Variable " + v + " is repeated in the query.");
+        query.push_back(i);
+    }
+
+    GaussianPosterior result;
+    if (evidence.empty()) {
+        result.mean = select(m_mean, query);
+        result.gain = MatrixXd::Zero(query.size(), 0);
+        result.covariance = select(m_covariance, query, query);
+        return result;
+    }
+
+    // The evidence is sorted, so the cached decomposition does not depend on the order of the evidence.
+    std::vector<int> order(evidence.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&evidence](int a, int b) { return evidence[a] < evidence[b]; });
+    std::vector<int> sorted_evidence;
+    for (auto k : order) {
+        sorted_evidence.push_back(evidence[k]);
+    }
+
+    auto llt = evidence_llt(sorted_evidence);
+
+    // Schur complement: gain = Cov(q, e) Cov(e, e)^-1 and covariance = Cov(q, q) - gain Cov(e, q).
+    MatrixXd cross = select(m_covariance, query, sorted_evidence);
+    MatrixXd sorted_gain = llt->solve(cross.transpose()).transpose();
+
+    result.mean = select(m_mean, query) - sorted_gain * select(m_mean, sorted_evidence);
+    result.covariance = select(m_covariance, query, query) - sorted_gain * cross.transpose();
+    result.gain.resize(query.size(), evidence.size());
+    for (int k = 0, k_end = order.size(); k < k_end; ++k) {
+        result.gain.col(order[k]) = sorted_gain.col(k);
+    }
+
+    return result;
+}
+
+std::pair<VectorXd, MatrixXd> GaussianInference::query(const std::vector<std::string>& variables,
+                                                       const std::unordered_map<std::string, double>& evidence) const {
+    std::vector<int> evidence_indices;
+    VectorXd evidence_values(evidence.size());
+    for (const auto& [node, value] : evidence) {
+        evidence_values(evidence_indices.size()) = value;
+        evidence_indices.push_back(index(node));
+    }
+
+    auto p = posterior(variables, evidence_indices);
+    return std::make_pair(p.mean + p.gain * evidence_values, std::move(p.covariance));
+}
+
+std::pair<MatrixXd, MatrixXd> GaussianInference::query_batch(const std::vector<std::string>& variables,
+                                                             const DataFrame& evidence) const {
+    auto [evidence_indices, evidence_values] = evidence_matrix(evidence, evidence->schema()->field_names());
+
+    auto p = posterior(variables, evidence_indices);
+    MatrixXd means = (evidence_values * p.gain.transpose()).rowwise() + p.mean.transpose();
+    return std::make_pair(std::move(means), std::move(p.covariance));
+}
+
+VectorXd GaussianInference::conditional_logl(const std::vector<std::string>& variables, const DataFrame& df) const {
+    std::vector<std::string> evidence_names;
+    for (const auto& name : df->schema()->field_names()) {
+        if (std::find(variables.begin(), variables.end(), name) == variables.end()) evidence_names.push_back(name);
+    }
+
+    auto [evidence_indices, evidence_values] = evidence_matrix(df, evidence_names);
+    auto query_values = evidence_matrix(df, variables).second;
+
+    auto p = posterior(variables, evidence_indices);
+    Eigen::LLT<MatrixXd> llt(p.covariance);
+    if (llt.info() != Eigen::Success)
+        throw std::runtime_error("The covariance matrix of the posterior is not positive definite.");
+
+    // The residuals of each row are the columns of residuals, so the Mahalanobis distances are the squared norms of the
+    // columns of L^-1 residuals.
+    MatrixXd residuals = (query_values - evidence_values * p.gain.transpose()).transpose();
+    residuals.colwise() -= p.mean;
+    llt.matrixL().solveInPlace(residuals);
+
+    double logdet = 2 * llt.matrixLLT().diagonal().array().log().sum();
+    double lognorm = -0.5 * (variables.size() * std::log(2 * util::pi<double>) + logdet);
+    return (lognorm - 0.5 * residuals.colwise().squaredNorm().array()).matrix().transpose();
+}
+
+}  // namespace inference
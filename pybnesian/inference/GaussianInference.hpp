@@ -0,0 +1,87 @@
+#ifndef PYBNESIAN_INFERENCE_GAUSSIANINFERENCE_HPP
+#define PYBNESIAN_INFERENCE_GAUSSIANINFERENCE_HPP
+
+#include <deque>
+#include <mutex>
+#include <models/BayesianNetwork.hpp>
+#include <util/hash_utils.hpp>
+
+using Eigen::MatrixXd, Eigen::VectorXd;
+using models::BayesianNetworkBase;
+
+namespace inference {
+
+// Exact inference on a fitted Bayesian network of LinearGaussianCPDs. The network is compiled into its joint
+// multivariate normal distribution when the object is created: the joint mean and covariance are computed from the
+// coefficients and variances of the CPDs, visiting the nodes in topological order. A query conditions the joint on the
+// evidence with the Schur complement of the covariance of the evidence.
+//
+// The Cholesky decomposition of the covariance of each set of evidence variables is cached (up to max_cached_evidence
+// sets, evicted in FIFO order), so the queries with the same evidence variables only solve triangular systems. The
+// posterior covariance does not depend on the values of the evidence, and the posterior mean is an affine function of
+// them, so the batched queries only solve the posterior once for all the rows.
+//
+// The GaussianInference does not change if the model is modified or fitted again.
+class GaussianInference {
+public:
+    static constexpr std::size_t max_cached_evidence = 64;
+
+    GaussianInference(const BayesianNetworkBase& model);
+
+    const std::vector<std::string>& nodes() const { return m_nodes; }
+    // The mean and covariance of the joint distribution, in the order of nodes().
+    const VectorXd& mean() const { return m_mean; }
+    const MatrixXd& covariance() const { return m_covariance; }
+
+    // Returns the mean and covariance of P(variables | evidence).
+    std::pair<VectorXd, MatrixXd> query(const std::vector<std::string>& variables,
+                                        const std::unordered_map<std::string, double>& evidence) const;
+    // Returns the posterior mean for each row of evidence (a matrix where the i-th row is the mean of the i-th row) and
+    // the posterior covariance, that is the same for all the rows. The columns of evidence are continuous columns of
+    // the nodes without null values.
+    std::pair<MatrixXd, MatrixXd> query_batch(const std::vector<std::string>& variables,
+                                              const DataFrame& evidence) const;
+    // Returns the log-density of P(variables | evidence) for each row of df, where the evidence are the rest of
+    // columns of df.
+    VectorXd conditional_logl(const std::vector<std::string>& variables, const DataFrame& df) const;
+
+private:
+    // The posterior of the query given the evidence: the mean is mean + gain * evidence_values.
+    struct GaussianPosterior {
+        VectorXd mean;
+        MatrixXd gain;
+        MatrixXd covariance;
+    };
+
+    class HashIndices {
+    public:
+        inline std::size_t operator()(const std::vector<int>& indices) const {
+            size_t seed = indices.size();
+            for (auto i : indices) {
+                util::hash_combine(seed, i);
+            }
+            return seed;
+        }
+    };
+
+    int index(const std::string& node) const;
+    // Returns the indices of the evidence (in the order of the columns of evidence) and the matrix with their values.
+    std::pair<std::vector<int>, MatrixXd> evidence_matrix(const DataFrame& evidence,
+                                                          const std::vector<std::string>& names) const;
+    GaussianPosterior posterior(const std::vector<std::string>& variables, const std::vector<int>& evidence) const;
+    // Returns the Cholesky decomposition of the covariance of the evidence, where evidence is sorted.
+    std::shared_ptr<const Eigen::LLT<MatrixXd>> evidence_llt(const std::vector<int>& evidence) const;
+
+    std::vector<std::string> m_nodes;
+    std::unordered_map<std::string, int> m_indices;
+    VectorXd m_mean;
+    MatrixXd m_covariance;
+
+    mutable std::mutex m_mutex;
+    mutable std::unordered_map<std::vector<int>, std::shared_ptr<const Eigen::LLT<MatrixXd>>, HashIndices> m_llt_cache;
+    mutable std::deque<std::vector<int>> m_llt_order;
+};
+
+}  // namespace inference
+
+#endif  // PYBNESIAN_INFERENCE_GAUSSIANINFERENCE_HPP
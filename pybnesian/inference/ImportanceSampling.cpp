@@ -0,0 +1,294 @@
+#include <arrow/api.h>
+#include <factors/discrete/DiscreteFactor.hpp>
+#include <inference/ImportanceSampling.hpp>
+#include <util/parallel.hpp>
+
+using factors::discrete::DiscreteFactor;
+
+namespace inference {
+
+namespace {
+
+// Returns the seed of a block of instances, so the blocks are independent streams of random numbers.
+unsigned int block_seed(unsigned int seed, int block) {
+    std::seed_seq seq{seed, static_cast<unsigned int>(block)};
+    unsigned int res;
+    seq.generate(&res, &res + 1);
+    return res;
+}
+
+// Returns log(exp(a) + exp(b)).
+double log_add(double a, double b) {
+    if (a == -std::numeric_limits<double>::infinity()) return b;
+    if (b == -std::numeric_limits<double>::infinity()) return a;
+    auto m = std::max(a, b);
+    return m + std::log(std::exp(a - m) + std::exp(b - m));
+}
+
+// Returns a DataFrame with the columns of names.
+DataFrame select_columns(const std::vector<std::string>& names,
+                         const std::unordered_map<std::string, Array_ptr>& columns,
+                         int rows) {
+    std::vector<Field_ptr> fields;
+    Array_vector arrays;
+    for (const auto& name : names) {
+        const auto& column = columns.at(name);
+        fields.push_back(arrow::field(name, column->type()));
+        arrays.push_back(column);
+    }
+
+    return DataFrame(arrow::RecordBatch::Make(arrow::schema(fields), rows, arrays));
+}
+
+// Returns logl(variable | evidence) of the factor f, given the columns of a block.
+VectorXd factor_logl(const Factor& f, const std::unordered_map<std::string, Array_ptr>& columns, int rows) {
+    std::vector<std::string> names{f.variable()};
+    names.insert(names.end(), f.evidence().begin(), f.evidence().end());
+    return f.logl(select_columns(names, columns, rows));
+}
+
+std::shared_ptr<arrow::Scalar> index_scalar(const std::shared_ptr<arrow::DataType>& index_type, int64_t index) {
+    RAISE_RESULT_ERROR(auto scalar, arrow::MakeScalar(index_type, static_cast<int64_t>(index)))
+    return scalar;
+}
+
+// Returns the evidence column of the discrete node name encoded with the categories of its CPD, so the indices of the
+// evidence are the indices of the model.
+Array_ptr model_categories_column(const Array_ptr& column, const std::string& name, const DiscreteFactor& cpd) {
+    if (column->type_id() != arrow::Type::DICTIONARY)
+        throw std::invalid_argument("The evidence of the discrete node " + name + " must be categorical.");
+
+    auto dict_column = std::static_pointer_cast<arrow::DictionaryArray>(column);
+    if (dict_column->dictionary()->type_id() != arrow::Type::STRING)
+        throw std::invalid_argument("The categories of the evidence of node " + name + " must be strings.");
+
+    auto dictionary = std::static_pointer_cast<arrow::StringArray>(dict_column->dictionary());
+    auto value = dictionary->GetString(dict_column->GetValueIndex(0));
+
+    const auto& categories = cpd.variable_values();
+    auto it = std::find(categories.begin(), categories.end(), value);
+    if (it == categories.end())
+        throw std::invalid_argument("Category " + value + " of the evidence is not a category of node " + name + ".");
+
+    arrow::StringBuilder dict_builder;
+    RAISE_STATUS_ERROR(dict_builder.AppendValues(categories));
+    std::shared_ptr<arrow::StringArray> model_dictionary;
+    RAISE_STATUS_ERROR(dict_builder.Finish(&model_dictionary));
+
+    auto type = cpd.data_type();
+    auto index_type = std::static_pointer_cast<arrow::DictionaryType>(type)->index_type();
+    auto index = index_scalar(index_type, std::distance(categories.begin(), it));
+    RAISE_RESULT_ERROR(auto indices, arrow::MakeArrayFromScalar(*index, 1))
+
+    return std::make_shared<arrow::DictionaryArray>(type, indices, model_dictionary);
+}
+
+Array_ptr concatenate_blocks(const Array_vector& blocks) {
+    if (blocks.size() == 1) return blocks[0];
+
+    RAISE_RESULT_ERROR(auto res, arrow::Concatenate(blocks))
+    return res;
+}
+
+}  // namespace
+
+ImportanceSampling::ImportanceSampling(const BayesianNetworkBase& model) : ImportanceSampling(model, model) {}
+
+ImportanceSampling::ImportanceSampling(const BayesianNetworkBase& model, const BayesianNetworkBase& proposal)
+    : m_nodes(model.nodes()),
+      m_cpds(),
+      m_proposal_cpds(),
+      m_proposal_order(proposal.graph().topological_sort()),
+      m_likelihood_weighting(&model == &proposal),
+      m_python_derived(false) {
+    if (dynamic_cast<const ConditionalBayesianNetworkBase*>(&model) ||
+        dynamic_cast<const ConditionalBayesianNetworkBase*>(&proposal))
+        throw std::invalid_argument("ImportanceSampling is not available for conditional Bayesian networks.");
+    if (!model.fitted()) throw std::invalid_argument("Model not fitted.");
+    if (!proposal.fitted()) throw std::invalid_argument("Proposal not fitted.");
+
+    for (const auto& node : m_nodes) {
+        if (!proposal.contains_node(node))
+            throw std::invalid_argument("Node " + node + " of the model is not present in the proposal.");
+
+        m_cpds.insert({node, model.cpd(node)});
+        m_proposal_cpds.insert({node, proposal.cpd(node)});
+        m_python_derived |= model.cpd(node)->is_python_derived() || proposal.cpd(node)->is_python_derived();
+    }
+
+    if (proposal.num_nodes() != model.num_nodes())
+        throw std::invalid_argument("The proposal must contain the same nodes as the model.");
+}
+
+DataFrame ImportanceSampling::checked_evidence(const DataFrame& evidence) const {
+    if (evidence->num_rows() != 1) throw std::invalid_argument("The evidence must contain exactly one row.");
+
+    for (const auto& name : evidence->schema()->field_names()) {
+        if (m_cpds.count(name) == 0) throw std::invalid_argument("Node " + name + " is not present in the model.");
+    }
+
+    if (evidence.null_count() > 0) throw std::invalid_argument("The evidence contains null values.");
+
+    auto batch = evidence.record_batch();
+    for (int i = 0; i < batch->num_columns(); ++i) {
+        const auto& name = batch->schema()->field(i)->name();
+        auto discrete_cpd = std::dynamic_pointer_cast<DiscreteFactor>(m_cpds.at(name));
+
+        if (discrete_cpd) {
+            auto column = model_categories_column(batch->column(i), name, *discrete_cpd);
+            RAISE_RESULT_ERROR(batch, batch->SetColumn(i, arrow::field(name, column->type()), column))
+        } else if (batch->column(i)->type_id() == arrow::Type::DICTIONARY) {
+            throw std::invalid_argument("The evidence of the continuous node " + name + " can not be categorical.");
+        }
+    }
+
+    return DataFrame(batch);
+}
+
+WeightedSamples ImportanceSampling::sample_block(const DataFrame& evidence, int rows, unsigned int seed) const {
+    // Repeats the evidence row for all the instances of the block.
+    arrow::NumericBuilder<arrow::Int32Type> builder;
+    RAISE_STATUS_ERROR(builder.AppendEmptyValues(rows));
+    Array_ptr zeros;
+    RAISE_STATUS_ERROR(builder.Finish(&zeros));
+    auto repeated = evidence.take(zeros);
+
+    std::unordered_map<std::string, Array_ptr> columns;
+    for (const auto& name : repeated->schema()->field_names()) {
+        columns.insert({name, repeated.col(name)});
+    }
+
+    VectorXd log_weights = VectorXd::Zero(rows);
+    std::vector<std::string> sampled;
+    for (size_t i = 0; i < m_proposal_order.size(); ++i) {
+        const auto& node = m_proposal_order[i];
+        if (columns.count(node) > 0) continue;
+
+        const auto& proposal = *m_proposal_cpds.at(node);
+        auto parents = select_columns(proposal.evidence(), columns, rows);
+        columns.insert({node, proposal.sample(rows, parents, seed + i)});
+        sampled.push_back(node);
+
+        if (!m_likelihood_weighting) log_weights -= factor_logl(proposal, columns, rows);
+    }
+
+    // With likelihood weighting, the densities of the sampled nodes in the model and the proposal cancel out.
+    for (const auto& node : m_nodes) {
+        if (m_likelihood_weighting && std::find(sampled.begin(), sampled.end(), node) != sampled.end()) continue;
+        log_weights += factor_logl(*m_cpds.at(node), columns, rows);
+    }
+
+    // The NaN log-likelihoods (e.g. configurations of a CLG without a fitted factor) have weight 0.
+    log_weights = log_weights.unaryExpr(
+        [](double w) { return std::isnan(w) ? -std::numeric_limits<double>::infinity() : w; });
+
+    return WeightedSamples{select_columns(sampled, columns, rows), std::move(log_weights)};
+}
+
+WeightedSamples ImportanceSampling::sample_blocks(const DataFrame& evidence,
+                                                  int first_block,
+                                                  int num_blocks,
+                                                  int last_rows,
+                                                  unsigned int seed,
+                                                  int num_threads) const {
+    std::vector<WeightedSamples> blocks(num_blocks);
+    util::parallel_for(0, num_blocks, num_threads, [&](int b, int) {
+        int rows = (b == num_blocks - 1) ? last_rows : block_rows;
+        blocks[b] = sample_block(evidence, rows, block_seed(seed, first_block + b));
+    });
+
+    int64_t n = 0;
+    for (const auto& block : blocks) {
+        n += block.log_weights.rows();
+    }
+
+    VectorXd log_weights(n);
+    int64_t offset = 0;
+    for (const auto& block : blocks) {
+        log_weights.segment(offset, block.log_weights.rows()) = block.log_weights;
+        offset += block.log_weights.rows();
+    }
+
+    auto schema = blocks[0].samples->schema();
+    Array_vector columns;
+    for (auto j = 0; j < schema->num_fields(); ++j) {
+        Array_vector column_blocks;
+        for (const auto& block : blocks) {
+            column_blocks.push_back(block.samples.col(j));
+        }
+        columns.push_back(concatenate_blocks(column_blocks));
+    }
+
+    return WeightedSamples{DataFrame(arrow::RecordBatch::Make(schema, n, columns)), std::move(log_weights)};
+}
+
+WeightedSamples ImportanceSampling::sample(int n, const DataFrame& evidence, unsigned int seed, int num_threads) const {
+    if (n <= 0) throw std::invalid_argument("n should be a positive number.");
+    auto model_evidence = checked_evidence(evidence);
+    util::effective_num_threads(num_threads);
+
+    int num_blocks = (n + block_rows - 1) / block_rows;
+    return sample_blocks(model_evidence, 0, num_blocks, n - (num_blocks - 1) * block_rows, seed, num_threads);
+}
+
+WeightedSampleStream ImportanceSampling::stream(const DataFrame& evidence,
+                                                int batch_size,
+                                                double min_ess,
+                                                int max_samples,
+                                                unsigned int seed,
+                                                int num_threads) const {
+    if (batch_size <= 0) throw std::invalid_argument("batch_size should be a positive number.");
+    if (max_samples <= 0) throw std::invalid_argument("max_samples should be a positive number.");
+    auto model_evidence = checked_evidence(evidence);
+    util::effective_num_threads(num_threads);
+
+    return WeightedSampleStream(*this, model_evidence, batch_size, min_ess, max_samples, seed, num_threads);
+}
+
+WeightedSampleStream::WeightedSampleStream(ImportanceSampling sampler,
+                                           DataFrame evidence,
+                                           int batch_size,
+                                           double min_ess,
+                                           int max_samples,
+                                           unsigned int seed,
+                                           int num_threads)
+    : m_sampler(std::move(sampler)),
+      m_evidence(std::move(evidence)),
+      m_batch_size(batch_size),
+      m_min_ess(min_ess),
+      m_max_samples(max_samples),
+      m_seed(seed),
+      m_num_threads(num_threads),
+      m_num_samples(0),
+      m_next_block(0),
+      m_log_sum(-std::numeric_limits<double>::infinity()),
+      m_log_sum_squares(-std::numeric_limits<double>::infinity()) {}
+
+double WeightedSampleStream::effective_sample_size() const {
+    if (m_log_sum == -std::numeric_limits<double>::infinity()) return 0;
+    return std::exp(2 * m_log_sum - m_log_sum_squares);
+}
+
+std::optional<WeightedSamples> WeightedSampleStream::next() {
+    if (finished()) return std::nullopt;
+
+    int n = std::min(m_batch_size, m_max_samples - m_num_samples);
+    int num_blocks = (n + ImportanceSampling::block_rows - 1) / ImportanceSampling::block_rows;
+    auto batch = m_sampler.sample_blocks(m_evidence,
+                                         m_next_block,
+                                         num_blocks,
+                                         n - (num_blocks - 1) * ImportanceSampling::block_rows,
+                                         m_seed,
+                                         m_num_threads);
+
+    for (auto i = 0; i < batch.log_weights.rows(); ++i) {
+        m_log_sum = log_add(m_log_sum, batch.log_weights(i));
+        m_log_sum_squares = log_add(m_log_sum_squares, 2 * batch.log_weights(i));
+    }
+
+    m_num_samples += n;
+    m_next_block += num_blocks;
+    return batch;
+}
+
+}  // namespace inference
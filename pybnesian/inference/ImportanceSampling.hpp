@@ -0,0 +1,118 @@
+#ifndef PYBNESIAN_INFERENCE_IMPORTANCESAMPLING_HPP
+#define PYBNESIAN_INFERENCE_IMPORTANCESAMPLING_HPP
+
+#include <optional>
+#include <models/BayesianNetwork.hpp>
+
+using Eigen::VectorXd;
+using models::BayesianNetworkBase;
+
+namespace inference {
+
+// A set of samples of the nodes that are not observed, with the logarithm of their (unnormalized) importance weights.
+struct WeightedSamples {
+    DataFrame samples;
+    VectorXd log_weights;
+};
+
+class WeightedSampleStream;
+
+// Approximate inference on a fitted Bayesian network with importance sampling. The non-evidence nodes are sampled from
+// a proposal network with Factor::sample(), with the evidence nodes fixed to their observed values, and each sample is
+// weighted by the ratio of the model and proposal densities, computed with Factor::logl().
+//
+// If the proposal is the model itself, this is likelihood weighting: only the CPDs of the evidence nodes contribute to
+// the weights.
+//
+// The samples are drawn in blocks of block_rows instances. Each block has its own seed, derived from the seed and the
+// index of the block, so the result does not depend on the number of threads. The CPDs are shared with the networks,
+// so the networks should not be fitted again while the object is used.
+class ImportanceSampling {
+public:
+    static constexpr int block_rows = 1 << 12;
+
+    // Likelihood weighting.
+    ImportanceSampling(const BayesianNetworkBase& model);
+    ImportanceSampling(const BayesianNetworkBase& model, const BayesianNetworkBase& proposal);
+
+    bool likelihood_weighting() const { return m_likelihood_weighting; }
+    // Returns true if a CPD of the model or the proposal is implemented in Python, so the GIL cannot be released.
+    bool has_python_derived() const { return m_python_derived; }
+
+    // Returns n weighted samples given evidence, a DataFrame with one row and a column for each evidence node. The
+    // blocks are sampled in parallel with num_threads threads (0 selects the hardware concurrency).
+    WeightedSamples sample(int n, const DataFrame& evidence, unsigned int seed, int num_threads) const;
+
+    // Returns a stream of batches of batch_size weighted samples. The stream ends when the effective sample size of all
+    // the weighted samples reaches min_ess, or max_samples samples have been drawn.
+    WeightedSampleStream stream(const DataFrame& evidence,
+                                int batch_size,
+                                double min_ess,
+                                int max_samples,
+                                unsigned int seed,
+                                int num_threads) const;
+
+private:
+    friend class WeightedSampleStream;
+
+    // Checks that evidence has one row with the value of nodes of the model, and returns it with the discrete columns
+    // encoded with the categories of the model (e.g., a pandas Categorical of one row only contains its own category).
+    DataFrame checked_evidence(const DataFrame& evidence) const;
+    // Samples the instances of the blocks [first_block, first_block + num_blocks), where the last block has
+    // last_rows instances.
+    WeightedSamples sample_blocks(const DataFrame& evidence,
+                                  int first_block,
+                                  int num_blocks,
+                                  int last_rows,
+                                  unsigned int seed,
+                                  int num_threads) const;
+    WeightedSamples sample_block(const DataFrame& evidence, int rows, unsigned int seed) const;
+
+    std::vector<std::string> m_nodes;
+    // The CPDs of the model and the proposal (equal if m_likelihood_weighting).
+    std::unordered_map<std::string, std::shared_ptr<Factor>> m_cpds;
+    std::unordered_map<std::string, std::shared_ptr<Factor>> m_proposal_cpds;
+    // A topological sort of the proposal.
+    std::vector<std::string> m_proposal_order;
+    bool m_likelihood_weighting;
+    bool m_python_derived;
+};
+
+// A stream of batches of weighted samples returned by ImportanceSampling::stream(). The effective sample size of the
+// samples returned so far is (sum of weights)^2 / (sum of squared weights), accumulated in log space.
+class WeightedSampleStream {
+public:
+    WeightedSampleStream(ImportanceSampling sampler,
+                         DataFrame evidence,
+                         int batch_size,
+                         double min_ess,
+                         int max_samples,
+                         unsigned int seed,
+                         int num_threads);
+
+    // Returns the next batch, or std::nullopt if the stream has finished.
+    std::optional<WeightedSamples> next();
+
+    bool finished() const { return m_num_samples >= m_max_samples || effective_sample_size() >= m_min_ess; }
+    int num_samples() const { return m_num_samples; }
+    double effective_sample_size() const;
+    bool has_python_derived() const { return m_sampler.has_python_derived(); }
+
+private:
+    ImportanceSampling m_sampler;
+    DataFrame m_evidence;
+    int m_batch_size;
+    double m_min_ess;
+    int m_max_samples;
+    unsigned int m_seed;
+    int m_num_threads;
+    int m_num_samples;
+    int m_next_block;
+    // log(sum of weights) and log(sum of squared weights).
+    double m_log_sum;
+    double m_log_sum_squares;
+};
+
+}  // namespace inference
+
+#endif  // PYBNESIAN_INFERENCE_IMPORTANCESAMPLING_HPP
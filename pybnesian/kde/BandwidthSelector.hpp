@@ -13,6 +13,11 @@ public:
     virtual VectorXd diag_bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const = 0;
     virtual MatrixXd bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const = 0;
 
+    // Returns k if the bandwidth of d variables estimated from N instances is k times their covariance matrix.
+    // Otherwise, returns 0. The bandwidth of a KDE can be updated without estimating it again if k is known (see
+    // KDE::fit_incremental()).
+    virtual double covariance_scale(int, int) const { return 0; }
+
     virtual bool is_python_derived() const { return false; }
 
     static std::shared_ptr<BandwidthSelector>& keep_python_alive(std::shared_ptr<BandwidthSelector>& b) {
@@ -0,0 +1,143 @@
+#include <kde/BinnedGrid.hpp>
+#include <unsupported/Eigen/FFT>
+#include <util/math_constants.hpp>
+
+namespace kde {
+
+namespace {
+
+// Finds the grid cell that contains the point with relative coordinates u (in grid steps from the lower point), and
+// the relative position inside the cell.
+void locate(const VectorXd& u, int grid_size, std::vector<int>& cell, VectorXd& frac) {
+    for (int k = 0; k < u.rows(); ++k) {
+        cell[k] = std::min(static_cast<int>(u(k)), grid_size - 2);
+        frac(k) = u(k) - cell[k];
+    }
+}
+
+// Calls f(index, weight) for each vertex of a grid cell, where weight is the multilinear weight of the vertex.
+template <typename F>
+void for_each_vertex(const std::vector<int>& cell, const VectorXd& frac, int grid_size, F&& f) {
+    int d = cell.size();
+    for (int c = 0; c < (1 << d); ++c) {
+        int index = 0;
+        int stride = 1;
+        double weight = 1;
+        for (int k = 0; k < d; ++k) {
+            bool upper = (c >> k) & 1;
+            index += (cell[k] + upper) * stride;
+            weight *= upper ? frac(k) : 1 - frac(k);
+            stride *= grid_size;
+        }
+
+        f(index, weight);
+    }
+}
+
+}  // namespace
+
+BinnedGrid::BinnedGrid(const MatrixXd& data, const VectorXd& lower, const VectorXd& upper, int grid_size)
+    : m_lower(lower), m_delta(lower.rows()), m_grid_size(grid_size), m_num_instances(data.rows()), m_counts() {
+    if (grid_size < 2) throw std::invalid_argument("The grid size of a binned approximation must be at least 2.");
+
+    int d = lower.rows();
+    if (upper.rows() != d || data.cols() != d)
+        throw std::invalid_argument("Wrong dimensions for the grid bounds of the binned approximation.");
+
+    double total_points = std::pow(static_cast<double>(grid_size), d);
+    if (total_points > max_grid_points)
+        throw std::invalid_argument("The binned approximation of " + std::to_string(d) + " variables with grid size " +
+                                    std::to_string(grid_size) + " needs more than " +
+                                    std::to_string(max_grid_points) + " grid points.");
+
+    for (int k = 0; k < d; ++k) {
+        auto range = upper(k) - lower(k);
+        // All the instances are in the lower point of a constant variable.
+        m_delta(k) = (range > 0) ? range / (grid_size - 1) : 1;
+    }
+
+    m_counts = VectorXd::Zero(static_cast<int>(total_points));
+
+    std::vector<int> cell(d);
+    VectorXd frac(d);
+    for (int i = 0; i < data.rows(); ++i) {
+        VectorXd u = (data.row(i).transpose() - m_lower).cwiseQuotient(m_delta).cwiseMax(0).cwiseMin(grid_size - 1);
+        locate(u, grid_size, cell, frac);
+        for_each_vertex(cell, frac, grid_size, [this](int index, double weight) { m_counts(index) += weight; });
+    }
+}
+
+VectorXd BinnedGrid::kernel_sums(const VectorXd& diagonal_bandwidth) const {
+    int d = num_variables();
+    if (diagonal_bandwidth.rows() != d)
+        throw std::invalid_argument("Wrong dimension for bandwidth vector. it should be a " + std::to_string(d) +
+                                    " vector.");
+
+    if ((diagonal_bandwidth.array() <= 0).any())
+        throw std::invalid_argument("The bandwidth of a binned approximation must be positive.");
+
+    VectorXd sums = m_counts;
+    int total_points = sums.rows();
+
+    Eigen::FFT<double> fft;
+    std::vector<double> kernel, line;
+    std::vector<std::complex<double>> kernel_spectrum, spectrum;
+
+    int stride = 1;
+    for (int k = 0; k < d; ++k) {
+        double sd = std::sqrt(diagonal_bandwidth(k));
+        // Number of grid steps of the truncated kernel.
+        auto L = static_cast<int>(std::min(m_grid_size - 1., std::ceil(kernel_truncation * sd / m_delta(k))));
+
+        // The circular convolution of length P is equal to the linear convolution in the grid if P >= grid_size + L.
+        int P = 1;
+        while (P < m_grid_size + L) P *= 2;
+
+        double lognorm = -0.5 * std::log(2 * util::pi<double> * diagonal_bandwidth(k));
+        kernel.assign(P, 0.);
+        for (int l = 0; l <= L; ++l) {
+            double z = l * m_delta(k) / sd;
+            kernel[l] = std::exp(-0.5 * z * z + lognorm);
+            if (l > 0) kernel[P - l] = kernel[l];
+        }
+        fft.fwd(kernel_spectrum, kernel);
+
+        // Convolves each line of grid points along the variable k.
+        for (int start = 0; start < total_points; ++start) {
+            if ((start / stride) % m_grid_size != 0) continue;
+
+            line.assign(P, 0.);
+            for (int j = 0; j < m_grid_size; ++j) line[j] = sums(start + j * stride);
+
+            fft.fwd(spectrum, line);
+            for (int j = 0; j < P; ++j) spectrum[j] *= kernel_spectrum[j];
+            fft.inv(line, spectrum);
+
+            for (int j = 0; j < m_grid_size; ++j) sums(start + j * stride) = line[j];
+        }
+
+        stride *= m_grid_size;
+    }
+
+    return sums;
+}
+
+std::optional<double> BinnedGrid::interpolate(const VectorXd& values, const VectorXd& x) const {
+    VectorXd u = (x - m_lower).cwiseQuotient(m_delta);
+    // Also discards the NaN values.
+    if (!((u.array() >= 0).all() && (u.array() <= m_grid_size - 1).all())) return std::nullopt;
+
+    int d = num_variables();
+    std::vector<int> cell(d);
+    VectorXd frac(d);
+    locate(u, m_grid_size, cell, frac);
+
+    double res = 0;
+    for_each_vertex(cell, frac, m_grid_size, [&values, &res](int index, double weight) {
+        res += weight * values(index);
+    });
+
+    return res;
+}
+
+}  // namespace kde
@@ -0,0 +1,55 @@
+#ifndef PYBNESIAN_KDE_BINNEDGRID_HPP
+#define PYBNESIAN_KDE_BINNEDGRID_HPP
+
+#include <optional>
+#include <Eigen/Dense>
+
+using Eigen::MatrixXd, Eigen::VectorXd;
+
+namespace kde {
+
+// Approximates the sums of Gaussian kernels with a diagonal bandwidth H of a set of training instances t_i:
+//
+//     S(x) = sum_i K_H(x - t_i)
+//
+// The instances are linearly binned in a regular grid with grid_size points per variable: each instance splits its
+// weight between the 2^d vertices of its grid cell, proportionally to the proximity to each vertex. Then, S is
+// evaluated in the grid points as the discrete convolution of the bin counts with the kernel. The product kernel is
+// separable, so the convolution is computed with 1D FFTs along each variable in O(d G^d log G) time, where
+// G = grid_size and d is the number of variables.
+class BinnedGrid {
+public:
+    // The kernel weights are truncated at kernel_truncation standard deviations of each variable.
+    static constexpr double kernel_truncation = 6;
+    // Maximum number of grid points (grid_size^d).
+    static constexpr int max_grid_points = 1 << 22;
+
+    // Bins the rows of data in a grid whose extreme points in each variable are lower and upper. The instances
+    // outside the grid are moved to its border.
+    BinnedGrid(const MatrixXd& data, const VectorXd& lower, const VectorXd& upper, int grid_size);
+
+    int grid_size() const { return m_grid_size; }
+    int num_variables() const { return m_lower.rows(); }
+    int num_instances() const { return m_num_instances; }
+
+    // The weight of the instances in each grid point. The grid points are in column-major order: the first variable
+    // changes faster.
+    const VectorXd& counts() const { return m_counts; }
+
+    // Returns the approximation of S in each grid point.
+    VectorXd kernel_sums(const VectorXd& diagonal_bandwidth) const;
+
+    // Returns the multilinear interpolation of the grid values in x, or std::nullopt if x is outside the grid.
+    std::optional<double> interpolate(const VectorXd& values, const VectorXd& x) const;
+
+private:
+    VectorXd m_lower;
+    VectorXd m_delta;
+    int m_grid_size;
+    int m_num_instances;
+    VectorXd m_counts;
+};
+
+}  // namespace kde
+
+#endif  // PYBNESIAN_KDE_BINNEDGRID_HPP
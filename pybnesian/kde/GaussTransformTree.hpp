@@ -0,0 +1,228 @@
+#ifndef PYBNESIAN_KDE_GAUSSTRANSFORMTREE_HPP
+#define PYBNESIAN_KDE_GAUSSTRANSFORMTREE_HPP
+
+#include <kdtree/kdtree.hpp>
+#include <util/parallel.hpp>
+
+using kdtree::KDTree, kdtree::KDTreeNode, kdtree::PointMatrix, kdtree::DistanceArray, kdtree::QueryWorkspace,
+    kdtree::EuclideanDistance;
+
+namespace kde {
+
+// Computes the sum of the Gaussian kernels of a set of training instances t_i:
+//
+//     S(x) = sum_i exp(-0.5 (x - t_i)^T H^{-1} (x - t_i))
+//
+// with a relative error bound |S'(x) - S(x)| <= relative_error * S(x). The instances are whitened by the Cholesky
+// factor of the bandwidth H, so the kernel only depends on the Euclidean distance in the whitened space, and stored in
+// a KDTree. For each test instance, the nodes of the tree are visited from the nearest to the farthest. The
+// contribution of a node of n instances is bounded by n * K(max_distance) and n * K(min_distance) (the distances to its
+// bounding box). If (K(min_distance) - K(max_distance)) / 2 <= relative_error * S_lower / N, where S_lower is a lower
+// bound of S(x), the contribution of the node is approximated by n * (K(min_distance) + K(max_distance)) / 2.
+// Otherwise, its children (or its instances, if it is a leaf) are visited.
+template <typename ArrowType>
+class GaussTransformTree {
+public:
+    using CType = typename ArrowType::c_type;
+
+    static constexpr int leafsize = 32;
+    // Number of consecutive test instances processed by a thread at a time.
+    static constexpr int block_size = 64;
+
+    GaussTransformTree(const PointMatrix<ArrowType>& training, const MatrixXd& bandwidth, double relative_error);
+
+    double relative_error() const { return m_relative_error; }
+
+    std::size_t memory_bytes() const {
+        return m_tree.memory_bytes() + util::eigen_bytes(m_node_mines) + util::eigen_bytes(m_node_maxes);
+    }
+
+    // Returns log(S(x)) for each row x of test_matrix, evaluated with num_threads threads (0 selects the hardware
+    // concurrency).
+    VectorXd log_sum_kernels(const PointMatrix<ArrowType>& test_matrix, int num_threads = 0) const;
+
+private:
+    struct NodeDistance {
+        double min_distance;
+        double max_distance;
+        size_t node;
+    };
+
+    struct NodeDistanceComparator {
+        inline bool operator()(const NodeDistance& a, const NodeDistance& b) { return a.min_distance > b.min_distance; }
+    };
+
+    PointMatrix<ArrowType> whiten(const PointMatrix<ArrowType>& m) const;
+
+    NodeDistance node_distance(const EigenVector<ArrowType>& point, size_t node) const;
+
+    double log_sum_kernels_instance(QueryWorkspace<ArrowType>& workspace, std::vector<NodeDistance>& heap) const;
+
+    KDTree m_tree;
+    VectorXd m_mean;
+    MatrixXd m_cholesky;
+    // The bounding box of each node (one column per node).
+    MatrixXd m_node_mines;
+    MatrixXd m_node_maxes;
+    double m_relative_error;
+};
+
+template <typename ArrowType>
+GaussTransformTree<ArrowType>::GaussTransformTree(const PointMatrix<ArrowType>& training,
+                                                  const MatrixXd& bandwidth,
+                                                  double relative_error)
+    : m_tree(),
+      m_mean(training.template cast<double>().colwise().mean().transpose()),
+      m_cholesky(bandwidth.llt().matrixL()),
+      m_node_mines(),
+      m_node_maxes(),
+      m_relative_error(relative_error) {
+    if (relative_error <= 0) {
+        throw std::invalid_argument("The relative error of a GaussTransformTree must be a positive number.");
+    }
+
+    auto whitened = whiten(training);
+
+    arrow::NumericBuilder<ArrowType> builder;
+    std::vector<Array_ptr> columns;
+    arrow::SchemaBuilder b(arrow::SchemaBuilder::ConflictPolicy::CONFLICT_ERROR);
+    for (int j = 0; j < whitened.cols(); ++j) {
+        RAISE_STATUS_ERROR(builder.AppendValues(whitened.col(j).data(), whitened.rows()));
+        Array_ptr out;
+        RAISE_STATUS_ERROR(builder.Finish(&out));
+        columns.push_back(out);
+        builder.Reset();
+
+        RAISE_STATUS_ERROR(b.AddField(arrow::field(std::to_string(j), out->type())));
+    }
+    RAISE_RESULT_ERROR(auto schema, b.Finish())
+
+    m_tree.fit(DataFrame(arrow::RecordBatch::Make(schema, whitened.rows(), columns)), leafsize);
+
+    // The nodes are in depth-first order, so the children of a node are always after it.
+    const auto& nodes = m_tree.nodes();
+    const auto& points = m_tree.points<ArrowType>();
+    m_node_mines.resize(whitened.cols(), nodes.size());
+    m_node_maxes.resize(whitened.cols(), nodes.size());
+    for (auto i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+        const auto& node = nodes[i];
+        if (node.is_leaf()) {
+            auto leaf_points = points.middleRows(node.begin, node.end - node.begin);
+            m_node_mines.col(i) = leaf_points.colwise().minCoeff().transpose().template cast<double>();
+            m_node_maxes.col(i) = leaf_points.colwise().maxCoeff().transpose().template cast<double>();
+        } else {
+            m_node_mines.col(i) = m_node_mines.col(i + 1).cwiseMin(m_node_mines.col(node.right));
+            m_node_maxes.col(i) = m_node_maxes.col(i + 1).cwiseMax(m_node_maxes.col(node.right));
+        }
+    }
+}
+
+// The instances are centered (to reduce the rounding errors) and transformed by the inverse of the Cholesky factor:
+// x^T H^{-1} x = ||L^{-1} x||^2.
+template <typename ArrowType>
+PointMatrix<ArrowType> GaussTransformTree<ArrowType>::whiten(const PointMatrix<ArrowType>& m) const {
+    Matrix<CType, Dynamic, Dynamic> cholesky = m_cholesky.template cast<CType>();
+    PointMatrix<ArrowType> whitened = m.rowwise() - m_mean.transpose().template cast<CType>();
+    cholesky.transpose().template triangularView<Eigen::Upper>().template solveInPlace<Eigen::OnTheRight>(whitened);
+    return whitened;
+}
+
+template <typename ArrowType>
+typename GaussTransformTree<ArrowType>::NodeDistance GaussTransformTree<ArrowType>::node_distance(
+    const EigenVector<ArrowType>& point, size_t node) const {
+    auto p = point.template cast<double>();
+    auto below = (m_node_mines.col(node) - p).array();
+    auto above = (p - m_node_maxes.col(node)).array();
+
+    double min_distance = below.max(above).max(0.).square().sum();
+    double max_distance = (-below).max(-above).square().sum();
+    return NodeDistance{min_distance, max_distance, node};
+}
+
+template <typename ArrowType>
+double GaussTransformTree<ArrowType>::log_sum_kernels_instance(QueryWorkspace<ArrowType>& workspace,
+                                                               std::vector<NodeDistance>& heap) const {
+    EuclideanDistance<ArrowType> distance;
+    const auto& nodes = m_tree.nodes();
+    const auto& points = m_tree.points<ArrowType>();
+    double N = static_cast<double>(points.rows());
+
+    // The kernels are scaled by the kernel of the nearest neighbor, so the largest kernel is 1 and the sum does not
+    // underflow.
+    m_tree.query_instance(workspace, 1, distance);
+    double offset = static_cast<double>(workspace.neighbors.front().first);
+
+    NodeDistanceComparator comparator;
+    auto kernel = [offset](double d) { return std::exp(-0.5 * (d - offset)); };
+
+    double computed_sum = 0;
+    // Lower bound of the kernels of the nodes in the heap.
+    double pending_lower = 0;
+
+    heap.clear();
+    heap.push_back(node_distance(workspace.point, 0));
+    pending_lower += N * kernel(heap.front().max_distance);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), comparator);
+        auto current = heap.back();
+        heap.pop_back();
+
+        const auto& node = nodes[current.node];
+        double n = static_cast<double>(node.end - node.begin);
+        double kernel_max = kernel(current.min_distance);
+        double kernel_min = kernel(current.max_distance);
+        pending_lower -= n * kernel_min;
+
+        double sum_lower = computed_sum + pending_lower + n * kernel_min;
+        if (0.5 * (kernel_max - kernel_min) <= m_relative_error * sum_lower / N) {
+            computed_sum += 0.5 * n * (kernel_max + kernel_min);
+        } else if (node.is_leaf()) {
+            auto leaf_points = points.middleRows(node.begin, node.end - node.begin);
+            distance.distances(leaf_points, workspace.point, workspace.leaf_distances);
+            auto leaf_distances = workspace.leaf_distances.head(node.end - node.begin);
+            computed_sum += static_cast<double>(
+                (static_cast<CType>(-0.5) * (leaf_distances - static_cast<CType>(offset))).exp().sum());
+        } else {
+            for (auto child : {current.node + 1, node.right}) {
+                auto child_distance = node_distance(workspace.point, child);
+                pending_lower +=
+                    static_cast<double>(nodes[child].end - nodes[child].begin) * kernel(child_distance.max_distance);
+                heap.push_back(child_distance);
+                std::push_heap(heap.begin(), heap.end(), comparator);
+            }
+        }
+    }
+
+    return std::log(computed_sum) - 0.5 * offset;
+}
+
+template <typename ArrowType>
+VectorXd GaussTransformTree<ArrowType>::log_sum_kernels(const PointMatrix<ArrowType>& test_matrix,
+                                                        int num_threads) const {
+    auto whitened = whiten(test_matrix);
+    int m = whitened.rows();
+    VectorXd res(m);
+
+    int num_blocks = (m + block_size - 1) / block_size;
+    num_threads = util::effective_num_threads(num_threads);
+    std::vector<std::optional<QueryWorkspace<ArrowType>>> workspaces(num_threads);
+    std::vector<std::vector<NodeDistance>> heaps(num_threads);
+
+    util::parallel_for(0, num_blocks, num_threads, [&](int block, int thread_index) {
+        auto& workspace = workspaces[thread_index];
+        if (!workspace) workspace.emplace(whitened.cols(), m_tree.max_leaf_size());
+
+        int end = std::min(m, (block + 1) * block_size);
+        for (int i = block * block_size; i < end; ++i) {
+            workspace->point = whitened.row(i).transpose();
+            res(i) = log_sum_kernels_instance(*workspace, heaps[thread_index]);
+        }
+    });
+
+    return res;
+}
+
+}  // namespace kde
+
+#endif  // PYBNESIAN_KDE_GAUSSTRANSFORMTREE_HPP
@@ -1,4 +1,7 @@
+#include <typeinfo>
 #include <kde/KDE.hpp>
+#include <kde/ScottsBandwidth.hpp>
+#include <kde/UCV.hpp>
 #include <arrow/python/helpers.h>
 
 namespace kde {
@@ -7,11 +10,16 @@ void KDE::copy_bandwidth_opencl() {
     auto d = m_variables.size();
     auto llt_cov = m_bandwidth.llt();
     auto llt_matrix = llt_cov.matrixLLT();
+    m_cholesky = llt_cov.matrixL();
 
     m_lognorm_const = -llt_matrix.diagonal().array().log().sum() -
                       0.5 * m_variables.size() * std::log(2 * util::pi<double>) - std::log(N);
 
-    auto& opencl = OpenCLConfig::get();
+    // The CPU backend computes the Cholesky factor when it evaluates the logl.
+    if (m_backend == KDEBackend::CPU) return;
+
+    auto& opencl = OpenCLConfig::get(m_device);
+    m_mixed_buffers = std::make_shared<MixedPrecisionBuffers>();
 
     switch (m_training_type->id()) {
         case Type::DOUBLE: {
@@ -28,6 +36,85 @@ void KDE::copy_bandwidth_opencl() {
     }
 }
 
+void KDE::update_tree() {
+    if (!m_fitted) return;
+
+    switch (m_training_type->id()) {
+        case Type::DOUBLE:
+            build_tree<arrow::DoubleType>();
+            break;
+        case Type::FLOAT:
+            build_tree<arrow::FloatType>();
+            break;
+        default:
+            throw std::invalid_argument("Unreachable code.");
+    }
+}
+
+size_t KDE::training_block_rows(size_t rows, size_t element_bytes) const {
+    auto configured = static_cast<size_t>(OpenCLConfig::training_block_rows());
+    if (configured > 0) return (rows > configured) ? configured : 0;
+
+    auto& opencl = OpenCLConfig::get(m_device);
+    auto row_bytes = element_bytes * m_variables.size();
+    // Half of the device memory is left for the other models and the temporary buffers.
+    auto max_bytes = std::min<cl_ulong>(opencl.max_buffer_memory(), opencl.global_memory() / 2);
+    if (rows * row_bytes <= max_bytes) return 0;
+
+    // The blocks are smaller, so a block and the temporary buffers of the evaluation fit in the device.
+    return std::max<size_t>(1, max_bytes / (4 * row_bytes));
+}
+
+std::pair<cl::Buffer, cl::Buffer> KDE::mixed_precision_buffers() const {
+    // The buffers can be requested at the same time by the devices of OpenCLConfig::multi_device_rows().
+    std::lock_guard<std::mutex> l(m_mixed_buffers->mutex);
+
+    if (m_mixed_buffers->training() == nullptr) {
+        auto& opencl = OpenCLConfig::get();
+        auto d = m_variables.size();
+
+        auto training = opencl.new_buffer<float>(N * d);
+        auto cholesky = opencl.new_buffer<float>(d * d);
+
+        auto& k_to_float = opencl.kernel(OpenCL_kernel_traits<arrow::DoubleType>::convert_to_float);
+        k_to_float.setArg(0, m_training);
+        k_to_float.setArg(1, training);
+        RAISE_ENQUEUEKERNEL_ERROR(
+            opencl.queue().enqueueNDRangeKernel(k_to_float, cl::NullRange, cl::NDRange(N * d), cl::NullRange));
+        k_to_float.setArg(0, m_H_cholesky);
+        k_to_float.setArg(1, cholesky);
+        RAISE_ENQUEUEKERNEL_ERROR(
+            opencl.queue().enqueueNDRangeKernel(k_to_float, cl::NullRange, cl::NDRange(d * d), cl::NullRange));
+        // The buffers can be used by the queues of other devices.
+        opencl.queue().finish();
+
+        m_mixed_buffers->training = training;
+        m_mixed_buffers->cholesky = cholesky;
+    }
+
+    return std::make_pair(m_mixed_buffers->training, m_mixed_buffers->cholesky);
+}
+
+util::MemoryUsage KDE::memory_usage() const {
+    util::MemoryUsage usage;
+    usage.add("training",
+              util::eigen_bytes(m_training_double) + util::eigen_bytes(m_training_float),
+              opencl::buffer_bytes(m_training));
+    usage.add("bandwidth",
+              util::eigen_bytes(m_bandwidth) + util::eigen_bytes(m_cholesky),
+              opencl::buffer_bytes(m_H_cholesky));
+    usage.add("weights", util::eigen_bytes(m_log_weights), opencl::buffer_bytes(m_log_weights_buffer));
+    if (m_mixed_buffers) {
+        std::lock_guard<std::mutex> l(m_mixed_buffers->mutex);
+        usage.add("mixed_precision",
+                  0,
+                  opencl::buffer_bytes(m_mixed_buffers->training) + opencl::buffer_bytes(m_mixed_buffers->cholesky));
+    }
+    usage.add("tree",
+              (m_tree_double ? m_tree_double->memory_bytes() : 0) + (m_tree_float ? m_tree_float->memory_bytes() : 0));
+    return usage;
+}
+
 DataFrame KDE::training_data() const {
     check_fitted();
     switch (m_training_type->id()) {
@@ -41,6 +128,9 @@ DataFrame KDE::training_data() const {
 }
 
 void KDE::fit(const DataFrame& df) {
+    if (m_backend == KDEBackend::OPENCL) m_device = OpenCLConfig::select_device();
+    auto opencl_lock = lock_opencl();
+
     m_training_type = df.same_type(m_variables);
 
     bool contains_null = df.null_count(m_variables) > 0;
@@ -65,9 +155,113 @@ void KDE::fit(const DataFrame& df) {
     }
 
     m_fitted = true;
+    update_tree();
+}
+
+void KDE::fit(const DataFrame& df, int condensed_instances, unsigned int seed) {
+    if (condensed_instances <= 0)
+        throw std::invalid_argument("The number of condensed instances of a KDE must be a positive number.");
+    // The GaussTransformTree does not weight the training instances.
+    if (m_relative_error > 0) throw std::invalid_argument("A KDE with a positive relative error cannot be condensed.");
+
+    fit(df);
+
+    auto opencl_lock = lock_opencl();
+    switch (m_training_type->id()) {
+        case Type::DOUBLE:
+            condense<arrow::DoubleType>(condensed_instances, seed);
+            break;
+        case Type::FLOAT:
+            condense<arrow::FloatType>(condensed_instances, seed);
+            break;
+        default:
+            throw std::invalid_argument("Unreachable code.");
+    }
+}
+
+void KDE::fit(const DataFrame& df, const VectorXd& weights) {
+    // The GaussTransformTree does not weight the training instances.
+    if (m_relative_error > 0) throw std::invalid_argument("A KDE with a positive relative error cannot be weighted.");
+    if (weights.rows() != df->num_rows())
+        throw std::invalid_argument("The number of weights (" + std::to_string(weights.rows()) +
+                                    ") is not the number of rows of the DataFrame (" +
+                                    std::to_string(df->num_rows()) + ").");
+    if (!weights.allFinite() || (weights.array() < 0).any())
+        throw std::invalid_argument("The weights must be finite and non-negative numbers.");
+
+    // The rows with zero weight are removed, so the log weights of the training instances are finite.
+    auto bitmap = df.null_count(m_variables) > 0 ? df.combined_bitmap(m_variables) : nullptr;
+    arrow::AdaptiveIntBuilder builder;
+    std::vector<double> training_weights;
+    for (int64_t i = 0, rows = df->num_rows(); i < rows; ++i) {
+        if (weights(i) > 0 && (!bitmap || util::bit_util::GetBit(bitmap->data(), i))) {
+            RAISE_STATUS_ERROR(builder.Append(i));
+            training_weights.push_back(weights(i));
+        }
+    }
+
+    if (training_weights.empty())
+        throw std::invalid_argument("The KDE cannot be fitted: all the rows have zero weight or null values.");
+
+    Array_ptr take_ind;
+    RAISE_STATUS_ERROR(builder.Finish(&take_ind));
+    fit(df.take(take_ind));
+
+    auto opencl_lock = lock_opencl();
+    Map<const VectorXd> w(training_weights.data(), training_weights.size());
+    m_log_weights = (w.array() * (static_cast<double>(N) / w.sum())).log();
+
+    if (m_backend == KDEBackend::OPENCL) {
+        if (m_training_type->id() == Type::DOUBLE)
+            copy_log_weights_opencl<double>();
+        else
+            copy_log_weights_opencl<float>();
+    }
+}
+
+void KDE::fit_incremental(const KDE& previous, const DataFrame& df) {
+    bool compatible = previous.fitted() && m_backend == KDEBackend::OPENCL && previous.m_backend == KDEBackend::OPENCL;
+    // The training instances of a condensed KDE are not the instances of df, and the columns of an out of core KDE
+    // are not in the device.
+    compatible = compatible && !previous.condensed() && !previous.out_of_core();
+    // The bandwidth of previous must have been estimated by the same type of bandwidth selector.
+    compatible = compatible && !m_bselector->is_python_derived() &&
+                 typeid(*m_bselector) == typeid(*previous.m_bselector);
+    compatible = compatible && df.null_count(m_variables) == 0 &&
+                 df.same_type(m_variables)->id() == previous.m_training_type->id();
+
+    if (!compatible) {
+        fit(df);
+        return;
+    }
+
+    m_device = OpenCLConfig::select_device();
+    auto opencl_lock = lock_opencl();
+
+    bool updated = false;
+    switch (previous.m_training_type->id()) {
+        case Type::DOUBLE:
+            updated = _fit_incremental<arrow::DoubleType>(previous, df);
+            break;
+        case Type::FLOAT:
+            updated = _fit_incremental<arrow::FloatType>(previous, df);
+            break;
+        default:
+            throw std::invalid_argument("Wrong data type to fit KDE. [double] or [float] data is expected.");
+    }
+
+    if (!updated) {
+        fit(df);
+        return;
+    }
+
+    m_fitted = true;
+    update_tree();
 }
 
 VectorXd KDE::logl(const DataFrame& df) const {
+    auto opencl_lock = lock_opencl();
+
     check_fitted();
     auto type = df.same_type(m_variables);
 
@@ -86,6 +280,8 @@ VectorXd KDE::logl(const DataFrame& df) const {
 }
 
 double KDE::slogl(const DataFrame& df) const {
+    auto opencl_lock = lock_opencl();
+
     check_fitted();
     auto type = df.same_type(m_variables);
 
@@ -115,10 +311,86 @@ py::tuple KDE::__getstate__() const {
     }
 }
 
+template <typename CType>
+void KDE::restore_fitted(const CType* training_data) {
+    using MatrixType = Matrix<CType, Dynamic, Dynamic>;
+    auto d = m_variables.size();
+
+    if (m_backend == KDEBackend::CPU) {
+        if constexpr (std::is_same_v<CType, double>)
+            m_training_double = Map<const MatrixType>(training_data, N, d);
+        else
+            m_training_float = Map<const MatrixType>(training_data, N, d);
+
+        update_tree();
+        return;
+    }
+
+    auto llt_cov = m_bandwidth.llt();
+    MatrixType llt_matrix = llt_cov.matrixLLT().template cast<CType>();
+    m_cholesky = llt_cov.matrixL();
+
+    m_device = OpenCLConfig::select_device();
+    auto& opencl = OpenCLConfig::get(m_device);
+    m_H_cholesky = opencl.copy_to_buffer(llt_matrix.data(), d * d);
+    if (condensed()) copy_log_weights_opencl<CType>();
+
+    m_block_rows = training_block_rows(N, sizeof(CType));
+    if (out_of_core()) {
+        if constexpr (std::is_same_v<CType, double>)
+            m_training_double = Map<const MatrixType>(training_data, N, d);
+        else
+            m_training_float = Map<const MatrixType>(training_data, N, d);
+    } else {
+        m_training = opencl.copy_to_buffer(training_data, N * d);
+    }
+
+    update_tree();
+}
+
+template <typename ArrowType>
+void KDE::fit_host(const MatrixXd& bandwidth,
+                   const CPUMatrix<ArrowType>& training_data,
+                   std::shared_ptr<arrow::DataType> training_type) {
+    auto d = m_variables.size();
+    if ((bandwidth.rows() != bandwidth.cols()) || (static_cast<size_t>(bandwidth.rows()) != d)) {
+        throw std::invalid_argument("Bandwidth matrix must be a square matrix with dimensionality " +
+                                    std::to_string(d));
+    }
+    if (static_cast<size_t>(training_data.cols()) != d)
+        throw std::invalid_argument("The training data must have " + std::to_string(d) + " columns.");
+
+    m_bandwidth = bandwidth;
+    auto llt_cov = m_bandwidth.llt();
+    m_cholesky = llt_cov.matrixL();
+
+    m_shared_training.reset();
+    release_mapped_training();
+    release_host_training();
+    reset_log_weights();
+    m_mixed_buffers = std::make_shared<MixedPrecisionBuffers>();
+    m_training_type = training_type;
+    N = training_data.rows();
+    m_lognorm_const = -llt_cov.matrixLLT().diagonal().array().log().sum() -
+                      0.5 * d * std::log(2 * util::pi<double>) - std::log(N);
+    m_fitted = true;
+    restore_fitted(training_data.data());
+}
+
+template void KDE::fit_host<arrow::DoubleType>(const MatrixXd&,
+                                               const CPUMatrix<arrow::DoubleType>&,
+                                               std::shared_ptr<arrow::DataType>);
+template void KDE::fit_host<arrow::FloatType>(const MatrixXd&,
+                                              const CPUMatrix<arrow::FloatType>&,
+                                              std::shared_ptr<arrow::DataType>);
+
 KDE KDE::__setstate__(py::tuple& t) {
-    if (t.size() != 8) throw std::runtime_error("Not valid KDE.");
+    if (t.size() < 8 || t.size() > 11) throw std::runtime_error("Not valid KDE.");
 
-    KDE kde(t[0].cast<std::vector<std::string>>());
+    // The KDEs saved without a backend were evaluated with OpenCL.
+    auto backend = (t.size() > 8) ? static_cast<KDEBackend>(t[8].cast<int>()) : KDEBackend::OPENCL;
+    auto relative_error = (t.size() > 9) ? t[9].cast<double>() : 0.;
+    KDE kde(t[0].cast<std::vector<std::string>>(), backend, relative_error);
 
     kde.m_fitted = t[1].cast<bool>();
     kde.m_bselector = t[2].cast<std::shared_ptr<BandwidthSelector>>();
@@ -129,28 +401,17 @@ KDE KDE::__setstate__(py::tuple& t) {
         kde.m_lognorm_const = t[5].cast<double>();
         kde.N = static_cast<size_t>(t[6].cast<int>());
         kde.m_training_type = pyarrow::GetPrimitiveType(static_cast<arrow::Type::type>(t[7].cast<int>()));
-
-        auto llt_cov = kde.m_bandwidth.llt();
-        auto llt_matrix = llt_cov.matrixLLT();
-
-        auto& opencl = OpenCLConfig::get();
+        if (t.size() > 10) kde.m_log_weights = t[10].cast<VectorXd>();
 
         switch (kde.m_training_type->id()) {
             case Type::DOUBLE: {
-                kde.m_H_cholesky =
-                    opencl.copy_to_buffer(llt_matrix.data(), kde.m_variables.size() * kde.m_variables.size());
-
                 auto training_data = t[4].cast<VectorXd>();
-                kde.m_training = opencl.copy_to_buffer(training_data.data(), kde.N * kde.m_variables.size());
+                kde.restore_fitted(training_data.data());
                 break;
             }
             case Type::FLOAT: {
-                MatrixXf casted_cholesky = llt_matrix.template cast<float>();
-                kde.m_H_cholesky =
-                    opencl.copy_to_buffer(casted_cholesky.data(), kde.m_variables.size() * kde.m_variables.size());
-
                 auto training_data = t[4].cast<VectorXf>();
-                kde.m_training = opencl.copy_to_buffer(training_data.data(), kde.N * kde.m_variables.size());
+                kde.restore_fitted(training_data.data());
                 break;
             }
             default:
@@ -161,4 +422,131 @@ KDE KDE::__setstate__(py::tuple& t) {
     return kde;
 }
 
+namespace {
+
+enum class BinarySelector : std::uint8_t { NORMAL_REFERENCE_RULE, SCOTTS_BANDWIDTH, UCV };
+
+void write_bandwidth_selector(util::BinaryWriter& writer, const std::shared_ptr<BandwidthSelector>& bselector) {
+    if (bselector->is_python_derived()) {
+        throw std::invalid_argument("The bandwidth selector " + bselector->ToString() +
+                                    " is defined in Python, so it cannot be saved in the binary format.");
+    }
+
+    if (std::dynamic_pointer_cast<NormalReferenceRule>(bselector)) {
+        writer.write(static_cast<std::uint8_t>(BinarySelector::NORMAL_REFERENCE_RULE));
+    } else if (std::dynamic_pointer_cast<ScottsBandwidth>(bselector)) {
+        writer.write(static_cast<std::uint8_t>(BinarySelector::SCOTTS_BANDWIDTH));
+    } else if (auto ucv = std::dynamic_pointer_cast<UCV>(bselector)) {
+        writer.write(static_cast<std::uint8_t>(BinarySelector::UCV));
+        writer.write(ucv->pattern_search());
+        writer.write<std::int32_t>(ucv->binned_grid_size());
+    } else {
+        throw std::invalid_argument("The bandwidth selector " + bselector->ToString() +
+                                    " cannot be saved in the binary format.");
+    }
+}
+
+std::shared_ptr<BandwidthSelector> read_bandwidth_selector(util::BinaryReader& reader) {
+    switch (static_cast<BinarySelector>(reader.read<std::uint8_t>())) {
+        case BinarySelector::NORMAL_REFERENCE_RULE:
+            return std::make_shared<NormalReferenceRule>();
+        case BinarySelector::SCOTTS_BANDWIDTH:
+            return std::make_shared<ScottsBandwidth>();
+        case BinarySelector::UCV: {
+            auto pattern_search = reader.read_bool();
+            auto binned_grid_size = reader.read<std::int32_t>();
+            return std::make_shared<UCV>(pattern_search, binned_grid_size);
+        }
+        default:
+            throw std::runtime_error("Not valid bandwidth selector in KDE.");
+    }
+}
+
+}  // namespace
+
+template <typename ArrowType>
+void KDE::_write_binary(util::BinaryWriter& writer) const {
+    using CType = typename ArrowType::c_type;
+
+    writer.write(static_cast<std::int32_t>(m_training_type->id()));
+    writer.write<std::uint64_t>(N);
+    writer.write(m_lognorm_const);
+    writer.write_matrix(m_bandwidth);
+
+    if (m_backend == KDEBackend::CPU || out_of_core()) {
+        writer.write_matrix(training_matrix<ArrowType>());
+    } else {
+        Matrix<CType, Dynamic, Dynamic> training(N, m_variables.size());
+        OpenCLConfig::get(m_device).read_from_buffer(training.data(), m_training, N * m_variables.size());
+        writer.write_matrix(training);
+    }
+}
+
+template <typename ArrowType>
+void KDE::_read_binary(util::BinaryReader& reader) {
+    auto training = reader.read_matrix<typename ArrowType::c_type>();
+    if (training.cols() != static_cast<Eigen::Index>(m_variables.size()) ||
+        training.rows() != static_cast<Eigen::Index>(N)) {
+        throw std::runtime_error("Not valid training data in KDE.");
+    }
+
+    if (reader.memory_map()) {
+        fit_mapped<ArrowType>(m_bandwidth, reader.mapping(), training.data(), m_training_type, N);
+    } else {
+        restore_fitted(training.data());
+    }
+}
+
+void KDE::write_binary(util::BinaryWriter& writer) const {
+    if (condensed()) throw std::invalid_argument("A condensed KDE cannot be saved in the binary format.");
+
+    writer.write(m_variables);
+    writer.write(static_cast<std::int32_t>(m_backend));
+    writer.write(m_relative_error);
+    write_bandwidth_selector(writer, m_bselector);
+    writer.write(m_fitted);
+
+    if (m_fitted) {
+        switch (m_training_type->id()) {
+            case Type::DOUBLE:
+                _write_binary<arrow::DoubleType>(writer);
+                break;
+            case Type::FLOAT:
+                _write_binary<arrow::FloatType>(writer);
+                break;
+            default:
+                throw std::runtime_error("Unreachable code.");
+        }
+    }
+}
+
+KDE KDE::read_binary(util::BinaryReader& reader) {
+    auto variables = reader.read_strings();
+    auto backend = static_cast<KDEBackend>(reader.read<std::int32_t>());
+    auto relative_error = reader.read<double>();
+    auto bselector = read_bandwidth_selector(reader);
+    KDE kde(variables, bselector, backend, relative_error);
+
+    kde.m_fitted = reader.read_bool();
+    if (kde.m_fitted) {
+        kde.m_training_type = pyarrow::GetPrimitiveType(static_cast<arrow::Type::type>(reader.read<std::int32_t>()));
+        kde.N = reader.read<std::uint64_t>();
+        kde.m_lognorm_const = reader.read<double>();
+        kde.m_bandwidth = reader.read_matrix<double>();
+
+        switch (kde.m_training_type->id()) {
+            case Type::DOUBLE:
+                kde._read_binary<arrow::DoubleType>(reader);
+                break;
+            case Type::FLOAT:
+                kde._read_binary<arrow::FloatType>(reader);
+                break;
+            default:
+                throw std::runtime_error("Not valid data type in KDE.");
+        }
+    }
+
+    return kde;
+}
+
 }  // namespace kde
@@ -4,15 +4,51 @@
 #include <pybind11/stl.h>
 #include <pybind11/eigen.h>
 #include <kde/BandwidthSelector.hpp>
+#include <kde/GaussTransformTree.hpp>
+#include <kde/KMeansCondensation.hpp>
 #include <kde/NormalReferenceRule.hpp>
 #include <opencl/opencl_config.hpp>
+#include <util/basic_eigen_ops.hpp>
+#include <util/binary_io.hpp>
 #include <util/math_constants.hpp>
+#include <util/parallel.hpp>
 #include <util/pickle.hpp>
 
-using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits;
+using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits, opencl::OpenCLLock, opencl::PooledBuffer;
 
 namespace kde {
 
+// The device used to evaluate a KDE. KDEBackend::AUTO selects KDEBackend::OPENCL if the default OpenCL device is a
+// GPU. Otherwise, it selects KDEBackend::CPU, which evaluates the kernels with vectorized Eigen code in the host and
+// does not initialize OpenCL.
+enum class KDEBackend { AUTO, OPENCL, CPU };
+
+inline KDEBackend resolve_backend(KDEBackend backend) {
+    if (backend == KDEBackend::AUTO) return OpenCLConfig::gpu_available() ? KDEBackend::OPENCL : KDEBackend::CPU;
+    return backend;
+}
+
+template <typename ArrowType>
+using CPUMatrix = Matrix<typename ArrowType::c_type, Dynamic, Dynamic>;
+template <typename ArrowType>
+using CPUVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
+
+// Computes the logsumexp of each column of the first cols columns of logls, and saves it in output starting from
+// output_offset.
+template <typename ArrowType>
+void logsumexp_cols_cpu(const CPUMatrix<ArrowType>& logls, int cols, VectorXd& output, int output_offset) {
+    using CType = typename ArrowType::c_type;
+    for (int j = 0; j < cols; ++j) {
+        auto col = logls.col(j);
+        CType max = col.maxCoeff();
+        if (std::isinf(max)) {
+            output(output_offset + j) = static_cast<double>(max);
+        } else {
+            output(output_offset + j) = static_cast<double>(max + std::log((col.array() - max).exp().sum()));
+        }
+    }
+}
+
 struct UnivariateKDE {
     template <typename ArrowType>
     void static execute_logl_mat(const cl::Buffer& training_vec,
@@ -38,6 +74,14 @@ struct UnivariateKDE {
                                           const cl::Buffer& transform_mean,
                                           cl::Buffer&,
                                           cl::Buffer& output_mat);
+    template <typename ArrowType>
+    static void execute_logl_mat_cpu(const CPUMatrix<ArrowType>& training,
+                                     const CPUVector<ArrowType>&,
+                                     const CPUMatrix<ArrowType>& test,
+                                     const int test_offset,
+                                     const int test_length,
+                                     const typename ArrowType::c_type lognorm_const,
+                                     CPUMatrix<ArrowType>& output_mat);
 };
 
 template <typename ArrowType>
@@ -92,6 +136,23 @@ void UnivariateKDE::execute_conditional_means(const cl::Buffer& joint_training,
         k_conditional_means_1d, cl::NullRange, cl::NDRange(training_rows * test_length), cl::NullRange));
 }
 
+// The training and test instances are standardized by the bandwidth, so the kernel is the standard normal density.
+template <typename ArrowType>
+void UnivariateKDE::execute_logl_mat_cpu(const CPUMatrix<ArrowType>& training,
+                                         const CPUVector<ArrowType>&,
+                                         const CPUMatrix<ArrowType>& test,
+                                         const int test_offset,
+                                         const int test_length,
+                                         const typename ArrowType::c_type lognorm_const,
+                                         CPUMatrix<ArrowType>& output_mat) {
+    using CType = typename ArrowType::c_type;
+    auto training_col = training.col(0).array();
+    for (int j = 0; j < test_length; ++j) {
+        output_mat.col(j).array() =
+            static_cast<CType>(-0.5) * (training_col - test(test_offset + j, 0)).square() + lognorm_const;
+    }
+}
+
 struct MultivariateKDE {
     template <typename ArrowType>
     static void execute_logl_mat(const cl::Buffer& training_mat,
@@ -106,6 +167,24 @@ struct MultivariateKDE {
                                  cl::Buffer& tmp_mat,
                                  cl::Buffer& output_mat);
 
+    // Computes the logl matrices of a joint KDE and the marginal KDE of its first matrices_cols - 1 columns. The
+    // Cholesky factor of the marginal bandwidth is the top-left block of the joint Cholesky factor, so the whitened
+    // differences of the marginal KDE are the first columns of the joint whitened differences.
+    template <typename ArrowType>
+    static void execute_conditional_logl_mat(const cl::Buffer& training_mat,
+                                             const unsigned int training_rows,
+                                             const cl::Buffer& test_mat,
+                                             const unsigned int test_physical_rows,
+                                             const unsigned int test_offset,
+                                             const unsigned int test_length,
+                                             const unsigned int matrices_cols,
+                                             const cl::Buffer& cholesky,
+                                             const typename ArrowType::c_type joint_lognorm_const,
+                                             const typename ArrowType::c_type marg_lognorm_const,
+                                             cl::Buffer& tmp_mat,
+                                             cl::Buffer& joint_output_mat,
+                                             cl::Buffer& marg_output_mat);
+
     template <typename ArrowType>
     static void execute_conditional_means(const cl::Buffer& joint_training,
                                           const cl::Buffer& marg_training,
@@ -118,6 +197,15 @@ struct MultivariateKDE {
                                           const cl::Buffer& transform_mean,
                                           cl::Buffer& tmp_mat,
                                           cl::Buffer& output_mat);
+
+    template <typename ArrowType>
+    static void execute_logl_mat_cpu(const CPUMatrix<ArrowType>& training,
+                                     const CPUVector<ArrowType>& training_sqnorm,
+                                     const CPUMatrix<ArrowType>& test,
+                                     const int test_offset,
+                                     const int test_length,
+                                     const typename ArrowType::c_type lognorm_const,
+                                     CPUMatrix<ArrowType>& output_mat);
 };
 
 template <typename ArrowType>
@@ -174,8 +262,8 @@ void MultivariateKDE::execute_logl_mat(const cl::Buffer& training_mat,
             RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
                 k_square, cl::NullRange, cl::NDRange(training_rows * matrices_cols), cl::NullRange));
             k_logl_values_mat.setArg(4, i);
-            RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
-                k_logl_values_mat, cl::NullRange, cl::NDRange(training_rows), cl::NullRange));
+            RAISE_ENQUEUEKERNEL_ERROR(
+                opencl.enqueue_tuned_kernel(OpenCL_kernel_traits<ArrowType>::logl_values_mat_column, training_rows));
         }
     } else {
         k_substract.setArg(0, test_mat);
@@ -206,7 +294,104 @@ void MultivariateKDE::execute_logl_mat(const cl::Buffer& training_mat,
                 k_square, cl::NullRange, cl::NDRange(test_length * matrices_cols), cl::NullRange));
             k_logl_values_mat.setArg(4, i);
             RAISE_ENQUEUEKERNEL_ERROR(
-                queue.enqueueNDRangeKernel(k_logl_values_mat, cl::NullRange, cl::NDRange(test_length), cl::NullRange));
+                opencl.enqueue_tuned_kernel(OpenCL_kernel_traits<ArrowType>::logl_values_mat_row, test_length));
+        }
+    }
+}
+
+template <typename ArrowType>
+void MultivariateKDE::execute_conditional_logl_mat(const cl::Buffer& training_mat,
+                                                   const unsigned int training_rows,
+                                                   const cl::Buffer& test_mat,
+                                                   const unsigned int test_physical_rows,
+                                                   const unsigned int test_offset,
+                                                   const unsigned int test_length,
+                                                   const unsigned int matrices_cols,
+                                                   const cl::Buffer& cholesky,
+                                                   const typename ArrowType::c_type joint_lognorm_const,
+                                                   const typename ArrowType::c_type marg_lognorm_const,
+                                                   cl::Buffer& tmp_mat,
+                                                   cl::Buffer& joint_output_mat,
+                                                   cl::Buffer& marg_output_mat) {
+    auto& opencl = OpenCLConfig::get();
+
+    auto& k_substract = opencl.kernel(OpenCL_kernel_traits<ArrowType>::substract);
+
+    auto& k_solve = opencl.kernel(OpenCL_kernel_traits<ArrowType>::solve);
+    k_solve.setArg(0, tmp_mat);
+    k_solve.setArg(2, matrices_cols);
+    k_solve.setArg(3, cholesky);
+
+    auto& k_square = opencl.kernel(OpenCL_kernel_traits<ArrowType>::square);
+    k_square.setArg(0, tmp_mat);
+
+    auto& queue = opencl.queue();
+
+    if (training_rows > test_length) {
+        k_substract.setArg(0, training_mat);
+        k_substract.setArg(1, training_rows);
+        k_substract.setArg(2, 0u);
+        k_substract.setArg(3, training_rows);
+        k_substract.setArg(4, test_mat);
+        k_substract.setArg(5, test_physical_rows);
+        k_substract.setArg(6, test_offset);
+        k_substract.setArg(8, tmp_mat);
+
+        k_solve.setArg(1, training_rows);
+
+        auto& k_logl_values_mat = opencl.kernel(OpenCL_kernel_traits<ArrowType>::conditional_logl_mat_column);
+        k_logl_values_mat.setArg(0, tmp_mat);
+        k_logl_values_mat.setArg(1, matrices_cols);
+        k_logl_values_mat.setArg(2, joint_output_mat);
+        k_logl_values_mat.setArg(3, marg_output_mat);
+        k_logl_values_mat.setArg(4, training_rows);
+        k_logl_values_mat.setArg(6, joint_lognorm_const);
+        k_logl_values_mat.setArg(7, marg_lognorm_const);
+
+        for (unsigned int i = 0; i < test_length; ++i) {
+            k_substract.setArg(7, i);
+            RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
+                k_substract, cl::NullRange, cl::NDRange(training_rows * matrices_cols), cl::NullRange));
+            RAISE_ENQUEUEKERNEL_ERROR(
+                queue.enqueueNDRangeKernel(k_solve, cl::NullRange, cl::NDRange(training_rows), cl::NullRange));
+            RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
+                k_square, cl::NullRange, cl::NDRange(training_rows * matrices_cols), cl::NullRange));
+            k_logl_values_mat.setArg(5, i);
+            RAISE_ENQUEUEKERNEL_ERROR(opencl.enqueue_tuned_kernel(
+                OpenCL_kernel_traits<ArrowType>::conditional_logl_mat_column, training_rows));
+        }
+    } else {
+        k_substract.setArg(0, test_mat);
+        k_substract.setArg(1, test_physical_rows);
+        k_substract.setArg(2, test_offset);
+        k_substract.setArg(3, test_length);
+        k_substract.setArg(4, training_mat);
+        k_substract.setArg(5, training_rows);
+        k_substract.setArg(6, 0);
+        k_substract.setArg(8, tmp_mat);
+
+        k_solve.setArg(1, test_length);
+
+        auto& k_logl_values_mat = opencl.kernel(OpenCL_kernel_traits<ArrowType>::conditional_logl_mat_row);
+        k_logl_values_mat.setArg(0, tmp_mat);
+        k_logl_values_mat.setArg(1, matrices_cols);
+        k_logl_values_mat.setArg(2, joint_output_mat);
+        k_logl_values_mat.setArg(3, marg_output_mat);
+        k_logl_values_mat.setArg(4, training_rows);
+        k_logl_values_mat.setArg(6, joint_lognorm_const);
+        k_logl_values_mat.setArg(7, marg_lognorm_const);
+
+        for (unsigned int i = 0; i < training_rows; ++i) {
+            k_substract.setArg(7, i);
+            RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
+                k_substract, cl::NullRange, cl::NDRange(test_length * matrices_cols), cl::NullRange));
+            RAISE_ENQUEUEKERNEL_ERROR(
+                queue.enqueueNDRangeKernel(k_solve, cl::NullRange, cl::NDRange(test_length), cl::NullRange));
+            RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
+                k_square, cl::NullRange, cl::NDRange(test_length * matrices_cols), cl::NullRange));
+            k_logl_values_mat.setArg(5, i);
+            RAISE_ENQUEUEKERNEL_ERROR(
+                opencl.enqueue_tuned_kernel(OpenCL_kernel_traits<ArrowType>::conditional_logl_mat_row, test_length));
         }
     }
 }
@@ -289,6 +474,29 @@ void MultivariateKDE::execute_conditional_means(const cl::Buffer& joint_training
     }
 }
 
+// The training and test instances are whitened by the Cholesky factor of the bandwidth, so the squared Mahalanobis
+// distances are computed as ||t||^2 + ||x||^2 - 2 t^T x with a matrix product.
+template <typename ArrowType>
+void MultivariateKDE::execute_logl_mat_cpu(const CPUMatrix<ArrowType>& training,
+                                           const CPUVector<ArrowType>& training_sqnorm,
+                                           const CPUMatrix<ArrowType>& test,
+                                           const int test_offset,
+                                           const int test_length,
+                                           const typename ArrowType::c_type lognorm_const,
+                                           CPUMatrix<ArrowType>& output_mat) {
+    using CType = typename ArrowType::c_type;
+    auto test_block = test.middleRows(test_offset, test_length);
+    auto output_block = output_mat.leftCols(test_length);
+
+    output_block.noalias() = training * test_block.transpose();
+    CPUVector<ArrowType> test_sqnorm = test_block.rowwise().squaredNorm();
+
+    output_block.colwise() -= static_cast<CType>(0.5) * training_sqnorm;
+    output_block.rowwise() -= static_cast<CType>(0.5) * test_sqnorm.transpose();
+    // The rounding errors could produce (slightly) negative squared distances.
+    output_block = output_block.array().min(static_cast<CType>(0)) + lognorm_const;
+}
+
 class KDE {
 public:
     KDE()
@@ -296,26 +504,66 @@ public:
           m_fitted(false),
           m_bselector(std::make_shared<NormalReferenceRule>()),
           m_bandwidth(),
+          m_cholesky(),
           m_H_cholesky(),
           m_training(),
+          m_training_double(),
+          m_training_float(),
+          m_mapped_storage(),
+          m_mapped_training(nullptr),
           m_lognorm_const(0),
           N(0),
-          m_training_type(arrow::float64()) {}
-
-    KDE(std::vector<std::string> variables) : KDE(variables, std::make_shared<NormalReferenceRule>()) {}
-
-    KDE(std::vector<std::string> variables, std::shared_ptr<BandwidthSelector> b_selector)
+          m_training_type(arrow::float64()),
+          m_backend(resolve_backend(KDEBackend::AUTO)),
+          m_relative_error(0),
+          m_num_threads(0),
+          m_device(0),
+          m_block_rows(0),
+          m_log_weights(),
+          m_log_weights_buffer(),
+          m_mixed_buffers(std::make_shared<MixedPrecisionBuffers>()),
+          m_tree_double(),
+          m_tree_float() {}
+
+    KDE(std::vector<std::string> variables, KDEBackend backend = KDEBackend::AUTO, double relative_error = 0)
+        : KDE(variables, std::make_shared<NormalReferenceRule>(), backend, relative_error) {}
+
+    // If relative_error > 0, the logl is approximated with a GaussTransformTree, so the error of the density of each
+    // instance is at most relative_error times the density. Otherwise, the logl is exact.
+    KDE(std::vector<std::string> variables,
+        std::shared_ptr<BandwidthSelector> b_selector,
+        KDEBackend backend = KDEBackend::AUTO,
+        double relative_error = 0)
         : m_variables(variables),
           m_fitted(false),
           m_bselector(b_selector),
           m_bandwidth(),
+          m_cholesky(),
           m_H_cholesky(),
           m_training(),
+          m_training_double(),
+          m_training_float(),
+          m_mapped_storage(),
+          m_mapped_training(nullptr),
           m_lognorm_const(0),
           N(0),
-          m_training_type(arrow::float64()) {
+          m_training_type(arrow::float64()),
+          m_backend(resolve_backend(backend)),
+          m_relative_error(relative_error),
+          m_num_threads(0),
+          m_device(0),
+          m_block_rows(0),
+          m_log_weights(),
+          m_log_weights_buffer(),
+          m_mixed_buffers(std::make_shared<MixedPrecisionBuffers>()),
+          m_tree_double(),
+          m_tree_float() {
         if (b_selector == nullptr) throw std::runtime_error("Bandwidth selector procedure must be non-null.");
 
+        if (relative_error < 0) {
+            throw std::invalid_argument("The relative error of a KDE must be a non-negative number.");
+        }
+
         if (m_variables.empty()) {
             throw std::invalid_argument("Cannot create a KDE model with 0 variables");
         }
@@ -323,6 +571,22 @@ public:
 
     const std::vector<std::string>& variables() const { return m_variables; }
     void fit(const DataFrame& df);
+    // Fits the KDE with df and condenses its training instances in (at most) condensed_instances weighted instances.
+    // The bandwidth is estimated with all the instances of df. Then, the whitened instances are clustered with k-means
+    // (see kmeans_condensation()), and each cluster is replaced by its mean with a weight proportional to its number of
+    // instances, so the kernels are evaluated for condensed_instances instead of N instances. The approximation keeps
+    // the mass of every region of the data, and its error decreases as the clusters are smaller than the bandwidth.
+    void fit(const DataFrame& df, int condensed_instances, unsigned int seed = std::random_device{}());
+    // Fits the KDE with the rows of df weighted by weights, that must be finite and non-negative numbers. The density
+    // is a weighted mixture of the kernels of the rows, where the rows with zero weight or null values are not training
+    // instances. The bandwidth is estimated without weights by the bandwidth selector.
+    void fit(const DataFrame& df, const VectorXd& weights);
+    // Fits the KDE with df reusing previous, a KDE fitted with the same instances whose variables are the variables of
+    // this KDE with one variable added or removed (keeping the order of the other variables). The training columns of
+    // previous are copied in the device, and the Cholesky factor of the bandwidth is updated with a rank-one update
+    // instead of estimating the bandwidth again. If the KDE can not be updated (e.g., the bandwidth selector is not a
+    // scaled covariance, see BandwidthSelector::covariance_scale()), it is fitted as fit(df).
+    void fit_incremental(const KDE& previous, const DataFrame& df);
 
     template <typename ArrowType, typename EigenMatrix>
     void fit(EigenMatrix bandwidth,
@@ -330,6 +594,47 @@ public:
              std::shared_ptr<arrow::DataType> training_type,
              int training_instances);
 
+    // Fits the KDE with the (column-major) training data of a memory-mapped file (see util::BinaryReader), which is
+    // used without copying it. storage keeps the file mapped while the KDE uses it. With KDEBackend::OPENCL, the
+    // training data is used through a host buffer (see OpenCLConfig::host_buffer()) of the device locked by the caller.
+    template <typename ArrowType>
+    void fit_mapped(const MatrixXd& bandwidth,
+                    std::shared_ptr<const void> storage,
+                    const typename ArrowType::c_type* training_data,
+                    std::shared_ptr<arrow::DataType> training_type,
+                    int training_instances);
+
+    // Fits the KDE with the bandwidth and the training data in the host, which is copied to the storage of the backend
+    // (or kept in the host if the KDE is out_of_core()).
+    template <typename ArrowType>
+    void fit_host(const MatrixXd& bandwidth,
+                  const CPUMatrix<ArrowType>& training_data,
+                  std::shared_ptr<arrow::DataType> training_type);
+
+    // The training data in a memory-mapped file used by the KDE (see fit_mapped()), or nullptr if the KDE owns its
+    // training data.
+    const void* mapped_training() const { return m_mapped_training; }
+    const std::shared_ptr<const void>& mapped_storage() const { return m_mapped_storage; }
+
+    // Whether the training data is kept in the host and streamed to the OpenCL device in blocks when the KDE is
+    // evaluated, because it does not fit in the device (see OpenCLConfig::set_training_block_rows()).
+    bool out_of_core() const { return m_block_rows > 0; }
+    // The training data in the host. It is only available with KDEBackend::CPU or if the KDE is out_of_core().
+    template <typename ArrowType>
+    Map<const CPUMatrix<ArrowType>> training_matrix() const {
+        using CType = typename ArrowType::c_type;
+        if (m_mapped_training)
+            return Map<const CPUMatrix<ArrowType>>(static_cast<const CType*>(m_mapped_training), N, m_variables.size());
+
+        const CPUMatrix<ArrowType>* training;
+        if constexpr (std::is_same_v<ArrowType, arrow::DoubleType>)
+            training = &m_training_double;
+        else
+            training = &m_training_float;
+
+        return Map<const CPUMatrix<ArrowType>>(training->data(), training->rows(), training->cols());
+    }
+
     const MatrixXd& bandwidth() const { return m_bandwidth; }
     void setBandwidth(MatrixXd& new_bandwidth) {
         if (new_bandwidth.rows() != new_bandwidth.cols() ||
@@ -340,9 +645,14 @@ public:
                 std::to_string(m_variables.size()) + ", " + std::to_string(m_variables.size()) + ")");
 
         m_bandwidth = new_bandwidth;
-        if (m_bandwidth.rows() > 0) copy_bandwidth_opencl();
+        if (m_bandwidth.rows() > 0) {
+            copy_bandwidth_opencl();
+            update_tree();
+        }
     }
 
+    // The OpenCL buffers are only used with KDEBackend::OPENCL. The training buffer is null if the KDE is
+    // out_of_core().
     cl::Buffer& training_buffer() { return m_training; }
     const cl::Buffer& training_buffer() const { return m_training; }
 
@@ -359,6 +669,14 @@ public:
     }
     int num_variables() const { return m_variables.size(); }
     bool fitted() const { return m_fitted; }
+    // Whether the training instances are weighted (see fit(df, condensed_instances) and fit(df, weights)).
+    bool condensed() const { return m_log_weights.rows() > 0; }
+    // The weight of each training instance in the density. The weights sum to 1.
+    VectorXd weights() const {
+        check_fitted();
+        if (condensed()) return m_log_weights.array().exp() / static_cast<double>(N);
+        return VectorXd::Constant(N, 1. / static_cast<double>(N));
+    }
 
     std::shared_ptr<arrow::DataType> data_type() const {
         check_fitted();
@@ -367,53 +685,190 @@ public:
 
     std::shared_ptr<BandwidthSelector> bandwidth_type() const { return m_bselector; }
 
+    KDEBackend backend() const { return m_backend; }
+    double relative_error() const { return m_relative_error; }
+    // Number of threads that evaluate the logl in the CPU (KDEBackend::CPU or relative_error > 0). A value of 0 (the
+    // default) selects the hardware concurrency. The result does not depend on the number of threads.
+    int num_threads() const { return m_num_threads; }
+    void set_num_threads(int num_threads) {
+        util::effective_num_threads(num_threads);
+        m_num_threads = num_threads;
+    }
+    // The OpenCL device of the pool that evaluates the model.
+    int opencl_device() const { return m_device; }
+
     VectorXd logl(const DataFrame& df) const;
 
     template <typename ArrowType>
-    cl::Buffer logl_buffer(const DataFrame& df) const;
+    PooledBuffer logl_buffer(const DataFrame& df) const;
+    template <typename ArrowType>
+    PooledBuffer logl_buffer(const DataFrame& df, Buffer_ptr& bitmap) const;
+    // Returns the logl of the m rows of a column-major test matrix in test_buffer.
     template <typename ArrowType>
-    cl::Buffer logl_buffer(const DataFrame& df, Buffer_ptr& bitmap) const;
+    PooledBuffer logl_buffer(cl::Buffer& test_buffer, int m) const;
 
     double slogl(const DataFrame& df) const;
 
+    // Returns the memory of the training data (in the host or in the OpenCL device), the bandwidth, the weights of a
+    // condensed KDE, the mixed precision buffers and the trees of the approximate logl. The device columns shared by
+    // the KDEs fitted with the same data (see OpenCLConfig::shared_column()) are counted in each KDE.
+    util::MemoryUsage memory_usage() const;
+
     void save(const std::string name) { util::save_object(*this, name); }
 
     py::tuple __getstate__() const;
     static KDE __setstate__(py::tuple& t);
     static KDE __setstate__(py::tuple&& t) { return __setstate__(t); }
 
+    // Saves and loads the KDE in the binary format (see models::load_binary()). The training data is copied once from
+    // the memory-mapped file to the storage of the backend.
+    void write_binary(util::BinaryWriter& writer) const;
+    static KDE read_binary(util::BinaryReader& reader);
+
 private:
     void check_fitted() const {
         if (!fitted()) throw std::invalid_argument("KDE factor not fitted.");
     }
+
+    // The CPU backend does not use (nor initialize) OpenCL, so it does not lock it.
+    OpenCLLock lock_opencl() const {
+        if (m_backend == KDEBackend::CPU) return OpenCLLock();
+        return OpenCLConfig::get(m_device).lock();
+    }
     template <typename ArrowType>
     DataFrame _training_data() const;
 
     template <typename ArrowType, bool contains_null>
     void _fit(const DataFrame& df);
+    // Returns false if the KDE can not be fitted from previous.
+    template <typename ArrowType>
+    bool _fit_incremental(const KDE& previous, const DataFrame& df);
 
     template <typename ArrowType>
     VectorXd _logl(const DataFrame& df) const;
     template <typename ArrowType>
     double _slogl(const DataFrame& df) const;
 
+    // Number of training instances reduced by each work item of the logl_lse kernel.
+    static constexpr int fused_rows_per_item = 32;
+
+    template <typename ArrowType, typename KDEType>
+    PooledBuffer _logl_impl(cl::Buffer& test_buffer, int m) const;
+    // The logl of double test data with the kernel exponents computed in float (see
+    // OpenCLConfig::set_mixed_precision()).
+    template <typename KDEType>
+    PooledBuffer _logl_impl_mixed(cl::Buffer& test_buffer, int m) const;
+    // Returns the float copies of the training data and the Cholesky factor of the bandwidth.
+    std::pair<cl::Buffer, cl::Buffer> mixed_precision_buffers() const;
+
+    // Returns the logl of the non-null rows of df, streaming the test data to the OpenCL device in chunks.
+    template <typename ArrowType>
+    Matrix<typename ArrowType::c_type, Dynamic, 1> logl_pipelined(const DataFrame& df) const;
+
+    // Returns the number of training instances of each block streamed to the OpenCL device for rows training instances
+    // of element_bytes bytes, or 0 if they fit in the device.
+    size_t training_block_rows(size_t rows, size_t element_bytes) const;
+    // Uploads the rows training instances of an out of core KDE starting from offset to a temporary buffer.
+    template <typename ArrowType>
+    PooledBuffer training_block(size_t offset, size_t rows) const;
+    // Releases the training data in the host of a KDE evaluated with OpenCL.
+    void release_host_training() {
+        m_block_rows = 0;
+        m_training_double = MatrixXd();
+        m_training_float = MatrixXf();
+    }
+
+    // Releases the training data of a memory-mapped file when the KDE is fitted again.
+    void release_mapped_training() {
+        m_mapped_storage.reset();
+        m_mapped_training = nullptr;
+    }
+
+    template <typename ArrowType>
+    const std::shared_ptr<GaussTransformTree<ArrowType>>& tree() const {
+        if constexpr (std::is_same_v<ArrowType, arrow::DoubleType>)
+            return m_tree_double;
+        else
+            return m_tree_float;
+    }
+
+    // Builds the GaussTransformTree of the training data if relative_error > 0.
+    template <typename ArrowType>
+    void build_tree();
+    void update_tree();
+
+    // Replaces the training instances by the weighted means of their k-means clusters.
+    template <typename ArrowType>
+    void condense(int condensed_instances, unsigned int seed);
+    // Copies m_log_weights to the device.
+    template <typename CType>
+    void copy_log_weights_opencl();
+    void reset_log_weights() {
+        m_log_weights = VectorXd();
+        m_log_weights_buffer = cl::Buffer();
+    }
+
+    template <typename ArrowType>
+    VectorXd logl_cpu(const DataFrame& df) const;
     template <typename ArrowType, typename KDEType>
-    cl::Buffer _logl_impl(cl::Buffer& test_buffer, int m) const;
+    VectorXd _logl_cpu_impl(const CPUMatrix<ArrowType>& test_matrix) const;
 
     void copy_bandwidth_opencl();
 
     template <typename ArrowType>
     py::tuple __getstate__() const;
+    template <typename ArrowType>
+    void _write_binary(util::BinaryWriter& writer) const;
+    template <typename ArrowType>
+    void _read_binary(util::BinaryReader& reader);
+    // Restores a fitted KDE from its column-major training data once m_bandwidth, N and m_training_type are set.
+    template <typename CType>
+    void restore_fitted(const CType* training_data);
 
     std::vector<std::string> m_variables;
     bool m_fitted;
     std::shared_ptr<BandwidthSelector> m_bselector;
     MatrixXd m_bandwidth;
+    // The lower Cholesky factor of m_bandwidth in the host.
+    MatrixXd m_cholesky;
     cl::Buffer m_H_cholesky;
     cl::Buffer m_training;
+    // The shared device column used as m_training by the univariate KDEs fitted without null values (see
+    // OpenCLConfig::shared_column()).
+    std::shared_ptr<cl::Buffer> m_shared_training;
+    // The training data of KDEBackend::CPU (or of an out of core KDE) for each data type.
+    MatrixXd m_training_double;
+    MatrixXf m_training_float;
+    // The training data in a memory-mapped file (see fit_mapped()). If it is not null, it is used instead of the
+    // training data owned by the KDE.
+    std::shared_ptr<const void> m_mapped_storage;
+    const void* m_mapped_training;
     double m_lognorm_const;
     size_t N;
     std::shared_ptr<arrow::DataType> m_training_type;
+    KDEBackend m_backend;
+    double m_relative_error;
+    int m_num_threads;
+    int m_device;
+    // If positive, the KDE is out of core: the training data is in m_training_double or m_training_float, and it is
+    // uploaded to the device in blocks of m_block_rows instances.
+    size_t m_block_rows;
+    // The log of the weights of the training instances of a condensed KDE scaled by N (so they are 0 if the instances
+    // have the same weight), or empty if the KDE is not condensed. They are added to the kernel exponents, so
+    // m_lognorm_const keeps the -log(N) term.
+    VectorXd m_log_weights;
+    cl::Buffer m_log_weights_buffer;
+    // The float copies of the double training data and Cholesky factor used by the mixed precision logl. They are
+    // created when they are first needed, and shared by the copies of the KDE fitted with the same data.
+    struct MixedPrecisionBuffers {
+        std::mutex mutex;
+        cl::Buffer training;
+        cl::Buffer cholesky;
+    };
+    std::shared_ptr<MixedPrecisionBuffers> m_mixed_buffers;
+    // The tree of the approximate logl for each data type.
+    std::shared_ptr<GaussTransformTree<arrow::DoubleType>> m_tree_double;
+    std::shared_ptr<GaussTransformTree<arrow::FloatType>> m_tree_float;
 };
 
 template <typename ArrowType>
@@ -422,9 +877,15 @@ DataFrame KDE::_training_data() const {
     using VectorType = Matrix<CType, Dynamic, 1>;
     arrow::NumericBuilder<ArrowType> builder;
 
-    auto& opencl = OpenCLConfig::get();
-    VectorType tmp_buffer(N * m_variables.size());
-    opencl.read_from_buffer(tmp_buffer.data(), m_training, N * m_variables.size());
+    VectorType tmp_buffer;
+    if (m_backend == KDEBackend::CPU || out_of_core()) {
+        const auto& training = training_matrix<ArrowType>();
+        tmp_buffer = Map<const VectorType>(training.data(), training.size());
+    } else {
+        auto& opencl = OpenCLConfig::get();
+        tmp_buffer = VectorType(N * m_variables.size());
+        opencl.read_from_buffer(tmp_buffer.data(), m_training, N * m_variables.size());
+    }
 
     std::vector<Array_ptr> columns;
     arrow::SchemaBuilder b(arrow::SchemaBuilder::ConflictPolicy::CONFLICT_ERROR);
@@ -458,20 +919,64 @@ void KDE::_fit(const DataFrame& df) {
 
     auto llt_cov = m_bandwidth.llt();
     auto llt_matrix = llt_cov.matrixLLT();
+    m_cholesky = llt_cov.matrixL();
 
-    auto& opencl = OpenCLConfig::get();
+    m_shared_training.reset();
+    release_mapped_training();
+    reset_log_weights();
 
-    if constexpr (std::is_same_v<CType, double>) {
-        m_H_cholesky = opencl.copy_to_buffer(llt_matrix.data(), d * d);
+    if (m_backend == KDEBackend::CPU) {
+        auto training_data = df.to_eigen<false, ArrowType, contains_null>(m_variables);
+        N = training_data->rows();
+
+        if constexpr (std::is_same_v<CType, double>)
+            m_training_double = std::move(*training_data);
+        else
+            m_training_float = std::move(*training_data);
     } else {
-        using MatrixType = Matrix<CType, Dynamic, Dynamic>;
-        MatrixType casted_cholesky = llt_matrix.template cast<CType>();
-        m_H_cholesky = opencl.copy_to_buffer(casted_cholesky.data(), d * d);
-    }
+        auto& opencl = OpenCLConfig::get();
+        release_host_training();
+        m_block_rows = training_block_rows(df.valid_rows(m_variables), sizeof(CType));
+
+        if (out_of_core()) {
+            // The training data is streamed to the device when the KDE is evaluated.
+            auto training_data = df.to_eigen<false, ArrowType, contains_null>(m_variables);
+            N = training_data->rows();
+            m_training = cl::Buffer();
+
+            if constexpr (std::is_same_v<CType, double>)
+                m_training_double = std::move(*training_data);
+            else
+                m_training_float = std::move(*training_data);
+        } else if constexpr (contains_null) {
+            auto training_data = df.to_eigen<false, ArrowType, contains_null>(m_variables);
+            N = training_data->rows();
+            m_training = opencl.copy_to_buffer(training_data->data(), N * d);
+        } else {
+            // The training matrix is assembled from the shared device copies of the columns.
+            N = df->num_rows();
+            if (d == 1) {
+                m_shared_training = opencl.shared_column<ArrowType>(df.col(m_variables[0]));
+                m_training = *m_shared_training;
+            } else {
+                m_training = opencl.new_buffer<CType>(N * d);
+                for (size_t i = 0; i < d; ++i) {
+                    auto column = opencl.shared_column<ArrowType>(df.col(m_variables[i]));
+                    opencl.copy_buffer_region<CType>(*column, 0, m_training, i * N, N);
+                }
+            }
+        }
 
-    auto training_data = df.to_eigen<false, ArrowType, contains_null>(m_variables);
-    N = training_data->rows();
-    m_training = opencl.copy_to_buffer(training_data->data(), N * d);
+        if constexpr (std::is_same_v<CType, double>) {
+            m_H_cholesky = opencl.copy_to_buffer(llt_matrix.data(), d * d);
+        } else {
+            using MatrixType = Matrix<CType, Dynamic, Dynamic>;
+            MatrixType casted_cholesky = llt_matrix.template cast<CType>();
+            m_H_cholesky = opencl.copy_to_buffer(casted_cholesky.data(), d * d);
+        }
+
+        m_mixed_buffers = std::make_shared<MixedPrecisionBuffers>();
+    }
 
     m_lognorm_const =
         -llt_matrix.diagonal().array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>) - std::log(N);
@@ -484,6 +989,10 @@ void KDE::fit(EigenMatrix bandwidth,
               int training_instances) {
     using CType = typename ArrowType::c_type;
 
+    if (m_backend != KDEBackend::OPENCL) {
+        throw std::invalid_argument("A KDE can only be fitted with an OpenCL buffer using KDEBackend::OPENCL.");
+    }
+
     if ((bandwidth.rows() != bandwidth.cols()) || (static_cast<size_t>(bandwidth.rows()) != m_variables.size())) {
         throw std::invalid_argument("Bandwidth matrix must be a square matrix with dimensionality " +
                                     std::to_string(m_variables.size()));
@@ -491,9 +1000,12 @@ void KDE::fit(EigenMatrix bandwidth,
 
     m_bandwidth = bandwidth;
     auto d = m_variables.size();
-    auto llt_cov = bandwidth.llt();
+    auto llt_cov = m_bandwidth.llt();
     auto cholesky = llt_cov.matrixLLT();
-    auto& opencl = OpenCLConfig::get();
+    m_cholesky = llt_cov.matrixL();
+    // The training data is in the device locked by the caller.
+    m_device = OpenCLConfig::select_device();
+    auto& opencl = OpenCLConfig::get(m_device);
 
     if constexpr (std::is_same_v<CType, double>) {
         m_H_cholesky = opencl.copy_to_buffer(cholesky.data(), d * d);
@@ -504,10 +1016,178 @@ void KDE::fit(EigenMatrix bandwidth,
     }
 
     m_training = training_data;
+    m_shared_training.reset();
+    release_mapped_training();
+    release_host_training();
+    reset_log_weights();
+    m_mixed_buffers = std::make_shared<MixedPrecisionBuffers>();
     m_training_type = training_type;
     N = training_instances;
     m_lognorm_const = -cholesky.diagonal().array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>) - std::log(N);
     m_fitted = true;
+    build_tree<ArrowType>();
+}
+
+template <typename ArrowType>
+void KDE::fit_mapped(const MatrixXd& bandwidth,
+                     std::shared_ptr<const void> storage,
+                     const typename ArrowType::c_type* training_data,
+                     std::shared_ptr<arrow::DataType> training_type,
+                     int training_instances) {
+    using CType = typename ArrowType::c_type;
+    auto d = m_variables.size();
+
+    // The training data of an out of core KDE is streamed from the memory-mapped file.
+    if (m_backend == KDEBackend::OPENCL) {
+        m_device = OpenCLConfig::select_device();
+        if (training_block_rows(training_instances, sizeof(CType)) == 0) {
+            auto& opencl = OpenCLConfig::get(m_device);
+            fit<ArrowType>(bandwidth,
+                           opencl.host_buffer(training_data, training_instances * d),
+                           training_type,
+                           training_instances);
+            m_mapped_storage = std::move(storage);
+            m_mapped_training = training_data;
+            return;
+        }
+    }
+
+    if ((bandwidth.rows() != bandwidth.cols()) || (static_cast<size_t>(bandwidth.rows()) != d)) {
+        throw std::invalid_argument("Bandwidth matrix must be a square matrix with dimensionality " +
+                                    std::to_string(d));
+    }
+
+    m_bandwidth = bandwidth;
+    auto llt_cov = m_bandwidth.llt();
+    auto cholesky = llt_cov.matrixLLT();
+    m_cholesky = llt_cov.matrixL();
+
+    release_host_training();
+    m_shared_training.reset();
+    reset_log_weights();
+    m_mapped_storage = std::move(storage);
+    m_mapped_training = training_data;
+    m_training_type = training_type;
+    N = training_instances;
+    m_lognorm_const = -cholesky.diagonal().array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>) - std::log(N);
+    if (m_backend == KDEBackend::OPENCL) {
+        m_training = cl::Buffer();
+        m_block_rows = training_block_rows(N, sizeof(CType));
+        copy_bandwidth_opencl();
+    }
+    m_fitted = true;
+    build_tree<ArrowType>();
+}
+
+template <typename ArrowType>
+bool KDE::_fit_incremental(const KDE& previous, const DataFrame& df) {
+    using CType = typename ArrowType::c_type;
+    using VectorType = Matrix<CType, Dynamic, 1>;
+
+    auto d = m_variables.size();
+    auto previous_d = previous.m_variables.size();
+    bool added = d > previous_d;
+
+    const auto& longer = added ? m_variables : previous.m_variables;
+    const auto& shorter = added ? previous.m_variables : m_variables;
+    if (longer.size() != shorter.size() + 1) return false;
+
+    // The position of the added (or removed) variable.
+    size_t position = 0;
+    while (position < shorter.size() && shorter[position] == longer[position]) ++position;
+    if (!std::equal(shorter.begin() + position, shorter.end(), longer.begin() + position + 1)) return false;
+
+    auto instances = static_cast<size_t>(df->num_rows());
+    if (previous.N != instances || instances <= d) return false;
+    // The columns are copied in the device, so the training data must fit in it.
+    if (training_block_rows(instances, sizeof(CType)) > 0) return false;
+
+    auto previous_scale = m_bselector->covariance_scale(previous_d, instances);
+    auto scale = m_bselector->covariance_scale(d, instances);
+    if (previous_scale <= 0 || scale <= 0) return false;
+
+    // The Cholesky factor and the bandwidth are updated as covariance matrices.
+    MatrixXd previous_cov = previous.m_bandwidth / previous_scale;
+    MatrixXd previous_cholesky = previous.m_cholesky / std::sqrt(previous_scale);
+
+    MatrixXd cov(d, d);
+    MatrixXd cholesky;
+    std::optional<VectorType> added_column;
+    if (added) {
+        // Only the covariance of the added variable is estimated. It is computed as DataFrame::cov().
+        added_column = VectorType(*df.to_eigen<false, ArrowType, false>(m_variables[position]));
+        VectorType centered = added_column->array() - added_column->mean();
+
+        CType inv_N = 1 / static_cast<CType>(instances - 1);
+        VectorXd c(d);
+        for (size_t j = 0; j < d; ++j) {
+            if (j == position) {
+                c(j) = static_cast<double>(centered.squaredNorm() * inv_N);
+            } else {
+                VectorType column = *df.to_eigen<false, ArrowType, false>(m_variables[j]);
+                column.array() -= column.mean();
+                c(j) = static_cast<double>(centered.dot(column) * inv_N);
+            }
+        }
+
+        for (size_t i = 0, prev_i = 0; i < d; ++i) {
+            if (i == position) continue;
+            for (size_t j = 0, prev_j = 0; j < d; ++j) {
+                if (j == position) continue;
+                cov(i, j) = previous_cov(prev_i, prev_j++);
+            }
+            ++prev_i;
+        }
+        cov.row(position) = c.transpose();
+        cov.col(position) = c;
+
+        // The bandwidth estimated from df would not be positive definite.
+        if (!util::is_psd(cov) || !util::cholesky_insert(previous_cholesky, position, c, cholesky)) return false;
+    } else {
+        for (size_t i = 0; i < d; ++i) {
+            for (size_t j = 0; j < d; ++j) {
+                cov(i, j) = previous_cov(i + (i >= position), j + (j >= position));
+            }
+        }
+
+        cholesky = util::cholesky_remove(previous_cholesky, position);
+    }
+
+    m_bandwidth = scale * cov;
+    m_cholesky = std::sqrt(scale) * cholesky;
+
+    // The training data is in the device locked by the caller.
+    auto& opencl = OpenCLConfig::get(m_device);
+    if constexpr (std::is_same_v<CType, double>) {
+        m_H_cholesky = opencl.copy_to_buffer(m_cholesky.data(), d * d);
+    } else {
+        MatrixXf casted_cholesky = m_cholesky.template cast<float>();
+        m_H_cholesky = opencl.copy_to_buffer(casted_cholesky.data(), d * d);
+    }
+
+    // The columns of previous are copied in the device. Only the added column is copied from the host.
+    m_training = opencl.new_buffer<CType>(instances * d);
+    m_shared_training.reset();
+    release_mapped_training();
+    release_host_training();
+    reset_log_weights();
+    for (size_t j = 0; j < d; ++j) {
+        if (added && j == position) {
+            auto column_buffer = opencl.copy_to_temp_buffer(added_column->data(), instances);
+            opencl.copy_buffer_region<CType>(column_buffer, 0, m_training, instances * j, instances);
+        } else {
+            auto previous_j = (added && j > position) ? j - 1 : ((!added && j >= position) ? j + 1 : j);
+            opencl.copy_buffer_region<CType>(
+                previous.m_training, instances * previous_j, m_training, instances * j, instances);
+        }
+    }
+
+    m_mixed_buffers = std::make_shared<MixedPrecisionBuffers>();
+    m_training_type = previous.m_training_type;
+    N = instances;
+    m_lognorm_const =
+        -m_cholesky.diagonal().array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>) - std::log(N);
+    return true;
 }
 
 template <typename ArrowType>
@@ -515,32 +1195,40 @@ VectorXd KDE::_logl(const DataFrame& df) const {
     using CType = typename ArrowType::c_type;
     using VectorType = Matrix<CType, Dynamic, 1>;
 
-    auto logl_buff = logl_buffer<ArrowType>(df);
-    auto& opencl = OpenCLConfig::get();
+    if (m_backend == KDEBackend::CPU || m_relative_error > 0) {
+        if (df.null_count(m_variables) == 0) return logl_cpu<ArrowType>(df);
+
+        auto logl_valid = logl_cpu<ArrowType>(df);
+        auto bitmap = df.combined_bitmap(m_variables);
+        auto bitmap_data = bitmap->data();
+
+        VectorXd res(df->num_rows());
+        util::bit_util::expand(bitmap_data, df->num_rows(), logl_valid.data(), util::nan<double>, res.data());
+
+        return res;
+    }
+
+    auto m = df.valid_rows(m_variables);
+    VectorType read_data;
+    if (m > OpenCLConfig::pipeline_rows()) {
+        read_data = logl_pipelined<ArrowType>(df);
+    } else {
+        auto logl_buff = logl_buffer<ArrowType>(df);
+        read_data.resize(m);
+        OpenCLConfig::get().read_from_buffer(read_data.data(), logl_buff, m);
+    }
+
     if (df.null_count(m_variables) == 0) {
-        VectorType read_data(df->num_rows());
-        opencl.read_from_buffer(read_data.data(), logl_buff, df->num_rows());
         if constexpr (!std::is_same_v<CType, double>)
             return read_data.template cast<double>();
         else
             return read_data;
     } else {
-        auto m = df.valid_rows(m_variables);
-        VectorType read_data(m);
         auto bitmap = df.combined_bitmap(m_variables);
         auto bitmap_data = bitmap->data();
 
-        opencl.read_from_buffer(read_data.data(), logl_buff, m);
-
         VectorXd res(df->num_rows());
-
-        for (int i = 0, k = 0; i < df->num_rows(); ++i) {
-            if (util::bit_util::GetBit(bitmap_data, i)) {
-                res(i) = static_cast<double>(read_data[k++]);
-            } else {
-                res(i) = util::nan<double>;
-            }
-        }
+        util::bit_util::expand(bitmap_data, df->num_rows(), read_data.data(), util::nan<double>, res.data());
 
         return res;
     }
@@ -550,8 +1238,12 @@ template <typename ArrowType>
 double KDE::_slogl(const DataFrame& df) const {
     using CType = typename ArrowType::c_type;
 
-    auto logl_buff = logl_buffer<ArrowType>(df);
+    if (m_backend == KDEBackend::CPU || m_relative_error > 0) return logl_cpu<ArrowType>(df).sum();
+
     auto m = df.valid_rows(m_variables);
+    if (m > OpenCLConfig::pipeline_rows()) return logl_pipelined<ArrowType>(df).template cast<double>().sum();
+
+    auto logl_buff = logl_buffer<ArrowType>(df);
 
     auto& opencl = OpenCLConfig::get();
     auto buffer_sum = opencl.sum1d<ArrowType>(logl_buff, m);
@@ -562,12 +1254,35 @@ double KDE::_slogl(const DataFrame& df) const {
 }
 
 template <typename ArrowType>
-cl::Buffer KDE::logl_buffer(const DataFrame& df) const {
+Matrix<typename ArrowType::c_type, Dynamic, 1> KDE::logl_pipelined(const DataFrame& df) const {
+    auto test_matrix = df.to_eigen<false, ArrowType>(m_variables);
+    auto m = test_matrix->rows();
+
+    Matrix<typename ArrowType::c_type, Dynamic, 1> res(m);
+    OpenCLConfig::multi_device_rows(
+        test_matrix->data(),
+        m,
+        m_variables.size(),
+        [this](cl::Buffer& test_buffer, int rows) { return logl_buffer<ArrowType>(test_buffer, rows); },
+        res.data());
+    return res;
+}
+
+template <typename ArrowType>
+PooledBuffer KDE::logl_buffer(cl::Buffer& test_buffer, int m) const {
+    if (m_variables.size() == 1)
+        return _logl_impl<ArrowType, UnivariateKDE>(test_buffer, m);
+    else
+        return _logl_impl<ArrowType, MultivariateKDE>(test_buffer, m);
+}
+
+template <typename ArrowType>
+PooledBuffer KDE::logl_buffer(const DataFrame& df) const {
     auto& opencl = OpenCLConfig::get();
 
     auto test_matrix = df.to_eigen<false, ArrowType>(m_variables);
     auto m = test_matrix->rows();
-    auto test_buffer = opencl.copy_to_buffer(test_matrix->data(), m * m_variables.size());
+    auto test_buffer = opencl.copy_to_temp_buffer(test_matrix->data(), m * m_variables.size());
 
     if (m_variables.size() == 1)
         return _logl_impl<ArrowType, UnivariateKDE>(test_buffer, m);
@@ -576,12 +1291,12 @@ cl::Buffer KDE::logl_buffer(const DataFrame& df) const {
 }
 
 template <typename ArrowType>
-cl::Buffer KDE::logl_buffer(const DataFrame& df, Buffer_ptr& bitmap) const {
+PooledBuffer KDE::logl_buffer(const DataFrame& df, Buffer_ptr& bitmap) const {
     auto& opencl = OpenCLConfig::get();
 
     auto test_matrix = df.to_eigen<false, ArrowType>(bitmap, m_variables);
     auto m = test_matrix->rows();
-    auto test_buffer = opencl.copy_to_buffer(test_matrix->data(), m * m_variables.size());
+    auto test_buffer = opencl.copy_to_temp_buffer(test_matrix->data(), m * m_variables.size());
 
     if (m_variables.size() == 1)
         return _logl_impl<ArrowType, UnivariateKDE>(test_buffer, m);
@@ -589,52 +1304,323 @@ cl::Buffer KDE::logl_buffer(const DataFrame& df, Buffer_ptr& bitmap) const {
         return _logl_impl<ArrowType, MultivariateKDE>(test_buffer, m);
 }
 
+// The kernel exponents of each test instance are reduced by the logl_lse kernel with an online log-sum-exp as they are
+// computed, so they are never stored in a temporary matrix. Each work group reduces a chunk of the training instances
+// of a test instance, and the partial results of the chunks (a small num_chunks x allocated_m matrix) are combined by
+// finish_logl_lse.
+//
+// If the training data is out of core, the blocks of training instances are uploaded to the device one after another,
+// and the chunks of each block are saved in consecutive rows of the same partial results, so they are combined by
+// finish_logl_lse as the chunks of a single buffer.
 template <typename ArrowType, typename KDEType>
-cl::Buffer KDE::_logl_impl(cl::Buffer& test_buffer, int m) const {
+PooledBuffer KDE::_logl_impl(cl::Buffer& test_buffer, int m) const {
+    // The mixed precision logl does not weight the training instances of a condensed KDE, nor streams them.
+    if constexpr (std::is_same_v<ArrowType, arrow::DoubleType>) {
+        if (OpenCLConfig::mixed_precision() && !condensed() && !out_of_core())
+            return _logl_impl_mixed<KDEType>(test_buffer, m);
+    }
+
     using CType = typename ArrowType::c_type;
     auto d = m_variables.size();
     auto& opencl = OpenCLConfig::get();
-    auto res = opencl.new_buffer<CType>(m);
+    auto res = opencl.temp_buffer<CType>(m);
+
+    MatrixXd inv_cholesky = MatrixXd::Identity(d, d);
+    m_cholesky.template triangularView<Eigen::Lower>().solveInPlace(inv_cholesky);
+    Matrix<CType, Dynamic, Dynamic> casted_inv_cholesky = inv_cholesky.template cast<CType>();
+    auto inv_cholesky_buffer = opencl.copy_to_temp_buffer(casted_inv_cholesky.data(), d * d);
+
+    const auto* kernel_name = condensed() ? OpenCL_kernel_traits<ArrowType>::logl_lse_weighted
+                                          : OpenCL_kernel_traits<ArrowType>::logl_lse;
+    auto block_rows = out_of_core() ? m_block_rows : N;
+    auto free_local_memory = opencl.max_local_memory() - opencl.kernel_local_memory(kernel_name) - d * sizeof(CType);
+    // The local reduction needs a power of 2 local size.
+    auto local_size = util::bit_util::previous_power2(
+        std::min(static_cast<int>(free_local_memory / (2 * sizeof(CType))),
+                 static_cast<int>(opencl.kernel_local_size(kernel_name))));
+    local_size = std::min(local_size, util::bit_util::next_power2(static_cast<int>(block_rows)));
+    auto block_chunks = [local_size](size_t rows) {
+        return static_cast<int>(std::ceil(static_cast<double>(rows) / (local_size * fused_rows_per_item)));
+    };
+
+    int num_chunks = 0;
+    for (size_t offset = 0; offset < N; offset += block_rows) {
+        num_chunks += block_chunks(std::min(block_rows, N - offset));
+    }
 
-    auto [mat_logls, allocated_m] = opencl.allocate_temp_mat<ArrowType>(N, m);
-    auto iterations = static_cast<int>(std::ceil(static_cast<double>(m) / static_cast<double>(allocated_m)));
+    auto allocated_m = static_cast<int>(opencl.temp_mat_cols(num_chunks, m, num_chunks, sizeof(CType)));
+    auto chunk_max = opencl.temp_buffer<CType>(num_chunks * allocated_m);
+    auto chunk_sum = opencl.temp_buffer<CType>(num_chunks * allocated_m);
+
+    auto& k_logl_lse = opencl.kernel(kernel_name);
+    k_logl_lse.setArg(2, test_buffer);
+    k_logl_lse.setArg(3, static_cast<unsigned int>(m));
+    k_logl_lse.setArg(5, static_cast<unsigned int>(d));
+    k_logl_lse.setArg(6, inv_cholesky_buffer);
+    k_logl_lse.setArg(7, cl::Local(d * sizeof(CType)));
+    k_logl_lse.setArg(8, cl::Local(local_size * sizeof(CType)));
+    k_logl_lse.setArg(9, cl::Local(local_size * sizeof(CType)));
+    k_logl_lse.setArg(10, chunk_max);
+    k_logl_lse.setArg(11, chunk_sum);
+    k_logl_lse.setArg(13, static_cast<unsigned int>(num_chunks));
+
+    auto& k_finish_logl_lse = opencl.kernel(OpenCL_kernel_traits<ArrowType>::finish_logl_lse);
+    k_finish_logl_lse.setArg(0, chunk_max);
+    k_finish_logl_lse.setArg(1, chunk_sum);
+    k_finish_logl_lse.setArg(2, static_cast<unsigned int>(num_chunks));
+    k_finish_logl_lse.setArg(3, static_cast<CType>(m_lognorm_const));
+    k_finish_logl_lse.setArg(4, res);
 
-    cl::Buffer tmp_mat_buffer;
+    auto& queue = opencl.queue();
+    auto enqueue_logl_lse = [&](int chunk_offset, size_t rows, int length) {
+        auto chunks = block_chunks(rows);
+        k_logl_lse.setArg(1, static_cast<unsigned int>(rows));
+        k_logl_lse.setArg(12, static_cast<unsigned int>(chunk_offset));
+        RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
+            k_logl_lse, cl::NullRange, cl::NDRange(local_size * chunks, length), cl::NDRange(local_size, 1)));
+        return chunks;
+    };
+
+    for (auto offset = 0; offset < m; offset += allocated_m) {
+        auto length = std::min(allocated_m, m - offset);
+        k_logl_lse.setArg(4, static_cast<unsigned int>(offset));
+
+        if (out_of_core()) {
+            // The blocks are uploaded again for each range of test instances, which only happens if the partial
+            // results of all the test instances do not fit in the device.
+            int chunk_offset = 0;
+            for (size_t block_offset = 0; block_offset < N; block_offset += block_rows) {
+                auto rows = std::min(block_rows, N - block_offset);
+                auto block = training_block<ArrowType>(block_offset, rows);
+                k_logl_lse.setArg(0, block);
+
+                PooledBuffer block_log_weights;
+                if (condensed()) {
+                    Matrix<CType, Dynamic, 1> log_weights =
+                        m_log_weights.segment(block_offset, rows).template cast<CType>();
+                    block_log_weights = opencl.copy_to_temp_buffer(log_weights.data(), rows);
+                    k_logl_lse.setArg(14, block_log_weights);
+                }
+
+                chunk_offset += enqueue_logl_lse(chunk_offset, rows, length);
+            }
+        } else {
+            k_logl_lse.setArg(0, m_training);
+            if (condensed()) k_logl_lse.setArg(14, m_log_weights_buffer);
+            enqueue_logl_lse(0, N, length);
+        }
+
+        k_finish_logl_lse.setArg(5, static_cast<unsigned int>(offset));
+        RAISE_ENQUEUEKERNEL_ERROR(
+            queue.enqueueNDRangeKernel(k_finish_logl_lse, cl::NullRange, cl::NDRange(length), cl::NullRange));
+    }
+
+    return res;
+}
+
+template <typename ArrowType>
+PooledBuffer KDE::training_block(size_t offset, size_t rows) const {
+    auto d = m_variables.size();
+    CPUMatrix<ArrowType> block = training_matrix<ArrowType>().middleRows(offset, rows);
+    return OpenCLConfig::get().copy_to_temp_buffer(block.data(), rows * d);
+}
+
+template <typename KDEType>
+PooledBuffer KDE::_logl_impl_mixed(cl::Buffer& test_buffer, int m) const {
+    auto d = m_variables.size();
+    auto& opencl = OpenCLConfig::get();
+    auto [training, cholesky] = mixed_precision_buffers();
+
+    auto test_float = opencl.temp_buffer<float>(m * d);
+    auto& k_to_float = opencl.kernel(OpenCL_kernel_traits<arrow::DoubleType>::convert_to_float);
+    k_to_float.setArg(0, test_buffer);
+    k_to_float.setArg(1, test_float);
+    RAISE_ENQUEUEKERNEL_ERROR(
+        opencl.queue().enqueueNDRangeKernel(k_to_float, cl::NullRange, cl::NDRange(m * d), cl::NullRange));
+
+    auto res = opencl.temp_buffer<double>(m);
+
+    // Each test instance uses a column of float kernel exponents and a column of double values for the log-sum-exp.
+    auto extra_rows = std::is_same_v<KDEType, MultivariateKDE> ? d : 0;
+    auto allocated_m = opencl.temp_mat_cols(N, m, extra_rows, sizeof(float) + sizeof(double));
+    auto mat_exponents = opencl.temp_buffer<float>(N * allocated_m);
+    auto mat_logls = opencl.temp_buffer<double>(N * allocated_m);
+
+    PooledBuffer tmp_mat_buffer;
     if constexpr (std::is_same_v<KDEType, MultivariateKDE>) {
-        if (N > allocated_m)
-            tmp_mat_buffer = opencl.new_buffer<CType>(N * m_variables.size());
-        else
-            tmp_mat_buffer = opencl.new_buffer<CType>(allocated_m * m_variables.size());
-    }
-
-    for (auto i = 0; i < (iterations - 1); ++i) {
-        KDEType::template execute_logl_mat<ArrowType>(m_training,
-                                                      N,
-                                                      test_buffer,
-                                                      m,
-                                                      i * allocated_m,
-                                                      allocated_m,
-                                                      d,
-                                                      m_H_cholesky,
-                                                      m_lognorm_const,
-                                                      tmp_mat_buffer,
-                                                      mat_logls);
-        opencl.logsumexp_cols_offset<ArrowType>(mat_logls, N, allocated_m, res, i * allocated_m);
-    }
-    auto remaining_m = m - (iterations - 1) * allocated_m;
-
-    KDEType::template execute_logl_mat<ArrowType>(m_training,
-                                                  N,
-                                                  test_buffer,
-                                                  m,
-                                                  m - remaining_m,
-                                                  remaining_m,
-                                                  d,
-                                                  m_H_cholesky,
-                                                  m_lognorm_const,
-                                                  tmp_mat_buffer,
-                                                  mat_logls);
-    opencl.logsumexp_cols_offset<ArrowType>(mat_logls, N, remaining_m, res, (iterations - 1) * allocated_m);
+        tmp_mat_buffer = opencl.temp_buffer<float>(std::max(N, allocated_m) * d);
+    }
+
+    // The normalization constant is added in double.
+    auto& k_to_double = opencl.kernel(OpenCL_kernel_traits<arrow::FloatType>::convert_to_double);
+    k_to_double.setArg(0, mat_exponents);
+    k_to_double.setArg(1, m_lognorm_const);
+    k_to_double.setArg(2, mat_logls);
+
+    for (auto offset = 0; offset < m; offset += allocated_m) {
+        auto length = std::min(static_cast<int>(allocated_m), m - offset);
+        KDEType::template execute_logl_mat<arrow::FloatType>(
+            training, N, test_float, m, offset, length, d, cholesky, 0.f, tmp_mat_buffer, mat_exponents);
+        RAISE_ENQUEUEKERNEL_ERROR(
+            opencl.queue().enqueueNDRangeKernel(k_to_double, cl::NullRange, cl::NDRange(N * length), cl::NullRange));
+        opencl.logsumexp_cols_offset<arrow::DoubleType>(mat_logls, N, length, res, offset);
+    }
+
+    return res;
+}
+
+template <typename ArrowType>
+void KDE::build_tree() {
+    if (m_relative_error == 0) return;
+
+    std::shared_ptr<GaussTransformTree<ArrowType>> tree;
+    if (m_backend == KDEBackend::CPU || out_of_core()) {
+        tree = std::make_shared<GaussTransformTree<ArrowType>>(
+            training_matrix<ArrowType>(), m_bandwidth, m_relative_error);
+    } else {
+        CPUMatrix<ArrowType> training(N, m_variables.size());
+        OpenCLConfig::get().read_from_buffer(training.data(), m_training, N * m_variables.size());
+        tree = std::make_shared<GaussTransformTree<ArrowType>>(training, m_bandwidth, m_relative_error);
+    }
+
+    if constexpr (std::is_same_v<ArrowType, arrow::DoubleType>)
+        m_tree_double = std::move(tree);
+    else
+        m_tree_float = std::move(tree);
+}
+
+template <typename ArrowType>
+void KDE::condense(int condensed_instances, unsigned int seed) {
+    using CType = typename ArrowType::c_type;
+    auto d = m_variables.size();
+
+    if (static_cast<size_t>(condensed_instances) >= N) return;
+
+    CPUMatrix<ArrowType> training;
+    if (m_backend == KDEBackend::CPU || out_of_core()) {
+        training = training_matrix<ArrowType>();
+    } else {
+        training = CPUMatrix<ArrowType>(N, d);
+        OpenCLConfig::get(m_device).read_from_buffer(training.data(), m_training, N * d);
+    }
+
+    // The instances are clustered with the distances of the kernels: x^T H^{-1} x = ||L^{-1} x||^2.
+    CPUMatrix<ArrowType> cholesky = m_cholesky.template cast<CType>();
+    CPUVector<ArrowType> mean = training.colwise().mean().transpose();
+    CPUMatrix<ArrowType> whitened = training.rowwise() - mean.transpose();
+    cholesky.transpose().template triangularView<Eigen::Upper>().template solveInPlace<Eigen::OnTheRight>(whitened);
+    auto clusters = kmeans_condensation(whitened, condensed_instances, seed);
+    whitened = CPUMatrix<ArrowType>();
+
+    // The means are accumulated in double, so the rounding errors do not grow with the size of the clusters.
+    auto k = clusters.counts.size();
+    MatrixXd sums = MatrixXd::Zero(k, d);
+    for (size_t i = 0; i < N; ++i) {
+        sums.row(clusters.labels[i]) += training.row(i).template cast<double>();
+    }
+
+    m_log_weights = VectorXd(k);
+    for (size_t c = 0; c < k; ++c) {
+        sums.row(c) /= static_cast<double>(clusters.counts[c]);
+        m_log_weights(c) = std::log(static_cast<double>(clusters.counts[c]) * k / N);
+    }
+    CPUMatrix<ArrowType> centers = sums.template cast<CType>();
+
+    N = k;
+    m_lognorm_const =
+        -m_cholesky.diagonal().array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>) - std::log(N);
+
+    if (m_backend == KDEBackend::OPENCL) {
+        auto& opencl = OpenCLConfig::get(m_device);
+        release_host_training();
+        m_shared_training.reset();
+        m_mixed_buffers = std::make_shared<MixedPrecisionBuffers>();
+        copy_log_weights_opencl<CType>();
+
+        m_block_rows = training_block_rows(N, sizeof(CType));
+        if (!out_of_core()) {
+            m_training = opencl.copy_to_buffer(centers.data(), N * d);
+            return;
+        }
+        m_training = cl::Buffer();
+    }
+
+    if constexpr (std::is_same_v<CType, double>)
+        m_training_double = std::move(centers);
+    else
+        m_training_float = std::move(centers);
+}
+
+template <typename CType>
+void KDE::copy_log_weights_opencl() {
+    auto& opencl = OpenCLConfig::get(m_device);
+    if constexpr (std::is_same_v<CType, double>) {
+        m_log_weights_buffer = opencl.copy_to_buffer(m_log_weights.data(), N);
+    } else {
+        VectorXf casted_log_weights = m_log_weights.template cast<float>();
+        m_log_weights_buffer = opencl.copy_to_buffer(casted_log_weights.data(), N);
+    }
+}
+
+// Returns the logl of the rows of df without nulls.
+template <typename ArrowType>
+VectorXd KDE::logl_cpu(const DataFrame& df) const {
+    auto test_matrix = df.to_eigen<false, ArrowType>(m_variables);
+
+    if (m_relative_error > 0) {
+        VectorXd res = tree<ArrowType>()->log_sum_kernels(*test_matrix, m_num_threads);
+        res.array() += m_lognorm_const;
+        return res;
+    }
+
+    if (m_variables.size() == 1)
+        return _logl_cpu_impl<ArrowType, UnivariateKDE>(*test_matrix);
+    else
+        return _logl_cpu_impl<ArrowType, MultivariateKDE>(*test_matrix);
+}
+
+template <typename ArrowType, typename KDEType>
+VectorXd KDE::_logl_cpu_impl(const CPUMatrix<ArrowType>& test_matrix) const {
+    using CType = typename ArrowType::c_type;
+    // Number of test instances evaluated at the same time by each thread.
+    constexpr int block_size = 64;
+
+    const auto& training = training_matrix<ArrowType>();
+    int m = test_matrix.rows();
+
+    // The instances are centered (to reduce the rounding errors of the squared distances) and transformed by the
+    // inverse of the Cholesky factor: x^T H^{-1} x = ||L^{-1} x||^2.
+    CPUMatrix<ArrowType> cholesky = m_bandwidth.llt().matrixL().toDenseMatrix().template cast<CType>();
+    CPUVector<ArrowType> mean = training.colwise().mean().transpose();
+
+    CPUMatrix<ArrowType> whitened_training = training.rowwise() - mean.transpose();
+    cholesky.transpose().template triangularView<Eigen::Upper>().template solveInPlace<Eigen::OnTheRight>(
+        whitened_training);
+    CPUMatrix<ArrowType> whitened_test = test_matrix.rowwise() - mean.transpose();
+    cholesky.transpose().template triangularView<Eigen::Upper>().template solveInPlace<Eigen::OnTheRight>(
+        whitened_test);
+
+    CPUVector<ArrowType> training_sqnorm;
+    if constexpr (std::is_same_v<KDEType, MultivariateKDE>) training_sqnorm = whitened_training.rowwise().squaredNorm();
+    CPUVector<ArrowType> log_weights = m_log_weights.template cast<CType>();
+
+    VectorXd res(m);
+    auto lognorm_const = static_cast<CType>(m_lognorm_const);
+    int num_blocks = (m + block_size - 1) / block_size;
+    int num_threads = util::effective_num_threads(m_num_threads);
+    std::vector<std::optional<CPUMatrix<ArrowType>>> logls(num_threads);
+
+    util::parallel_for(0, num_blocks, num_threads, [&](int block, int thread_index) {
+        auto& mat_logls = logls[thread_index];
+        if (!mat_logls) mat_logls.emplace(N, block_size);
+
+        int offset = block * block_size;
+        int length = std::min(block_size, m - offset);
+        KDEType::template execute_logl_mat_cpu<ArrowType>(
+            whitened_training, training_sqnorm, whitened_test, offset, length, lognorm_const, *mat_logls);
+        if (log_weights.rows() > 0) mat_logls->leftCols(length).colwise() += log_weights;
+        logsumexp_cols_cpu<ArrowType>(*mat_logls, length, res, offset);
+    });
 
     return res;
 }
@@ -651,9 +1637,14 @@ py::tuple KDE::__getstate__() const {
     int training_type = -1;
 
     if (m_fitted) {
-        auto& opencl = OpenCLConfig::get();
-        training_data = VectorType(N * m_variables.size());
-        opencl.read_from_buffer(training_data.data(), m_training, N * m_variables.size());
+        if (m_backend == KDEBackend::CPU || out_of_core()) {
+            const auto& training = training_matrix<ArrowType>();
+            training_data = Map<const VectorType>(training.data(), training.size());
+        } else {
+            auto& opencl = OpenCLConfig::get();
+            training_data = VectorType(N * m_variables.size());
+            opencl.read_from_buffer(training_data.data(), m_training, N * m_variables.size());
+        }
 
         lognorm_const = m_lognorm_const;
         training_type = static_cast<int>(m_training_type->id());
@@ -661,8 +1652,17 @@ py::tuple KDE::__getstate__() const {
         bw = m_bandwidth;
     }
 
-    return py::make_tuple(
-        m_variables, m_fitted, m_bselector, bw, training_data, lognorm_const, N_export, training_type);
+    return py::make_tuple(m_variables,
+                          m_fitted,
+                          m_bselector,
+                          bw,
+                          training_data,
+                          lognorm_const,
+                          N_export,
+                          training_type,
+                          static_cast<int>(m_backend),
+                          m_relative_error,
+                          m_log_weights);
 }
 
 }  // namespace kde
@@ -0,0 +1,121 @@
+#ifndef PYBNESIAN_KDE_KMEANSCONDENSATION_HPP
+#define PYBNESIAN_KDE_KMEANSCONDENSATION_HPP
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <Eigen/Dense>
+#include <util/parallel.hpp>
+
+using Eigen::Matrix, Eigen::Dynamic;
+
+namespace kde {
+
+// The clusters of the k-means condensation of a set of instances. The labels are in [0, counts.size()), and the
+// clusters without instances are removed.
+struct KMeansCondensation {
+    std::vector<int> labels;
+    std::vector<int> counts;
+};
+
+// Clusters the rows of points in (at most) k clusters with the k-means (Lloyd) algorithm. The centers are initialized
+// with k random rows, and they are updated until the labels do not change or max_iterations iterations are run.
+//
+// The points are the whitened training instances of a KDE (see KDE::fit()), so the squared Euclidean distances are the
+// distances of the kernels. Each iteration costs O(N k d) for N points of d dimensions.
+template <typename CType>
+KMeansCondensation kmeans_condensation(const Matrix<CType, Dynamic, Dynamic>& points,
+                                       int k,
+                                       unsigned int seed,
+                                       int max_iterations = 10) {
+    using MatrixType = Matrix<CType, Dynamic, Dynamic>;
+    using VectorType = Matrix<CType, Dynamic, 1>;
+    // Number of points labelled at the same time by each thread.
+    constexpr int block_size = 256;
+
+    int n = points.rows();
+    int d = points.cols();
+    k = std::min(k, n);
+
+    std::vector<int> initial(n);
+    std::iota(initial.begin(), initial.end(), 0);
+    std::mt19937 rng{seed};
+    std::shuffle(initial.begin(), initial.end(), rng);
+
+    MatrixType centers(k, d);
+    for (int c = 0; c < k; ++c) {
+        centers.row(c) = points.row(initial[c]);
+    }
+
+    KMeansCondensation res{std::vector<int>(n, -1), std::vector<int>(k, 0)};
+
+    int num_blocks = (n + block_size - 1) / block_size;
+    int num_threads = util::effective_num_threads(0);
+    std::vector<MatrixType> distances(num_threads);
+
+    for (int iteration = 0; iteration < max_iterations; ++iteration) {
+        // ||x - c||^2 = ||c||^2 - 2 x^T c + ||x||^2, where ||x||^2 does not change the nearest center.
+        VectorType centers_sqnorm = centers.rowwise().squaredNorm();
+        std::vector<int> changed(num_blocks, 0);
+
+        util::parallel_for(0, num_blocks, num_threads, [&](int block, int thread_index) {
+            auto& block_distances = distances[thread_index];
+            int offset = block * block_size;
+            int length = std::min(block_size, n - offset);
+
+            block_distances.noalias() = points.middleRows(offset, length) * centers.transpose();
+            block_distances *= static_cast<CType>(-2);
+            block_distances.rowwise() += centers_sqnorm.transpose();
+
+            for (int i = 0; i < length; ++i) {
+                Eigen::Index nearest;
+                block_distances.row(i).minCoeff(&nearest);
+                if (res.labels[offset + i] != nearest) {
+                    res.labels[offset + i] = nearest;
+                    changed[block] = 1;
+                }
+            }
+        });
+
+        if (std::none_of(changed.begin(), changed.end(), [](int c) { return c != 0; })) break;
+
+        // The empty clusters keep their center.
+        MatrixType sums = MatrixType::Zero(k, d);
+        std::fill(res.counts.begin(), res.counts.end(), 0);
+        for (int i = 0; i < n; ++i) {
+            sums.row(res.labels[i]) += points.row(i);
+            ++res.counts[res.labels[i]];
+        }
+
+        for (int c = 0; c < k; ++c) {
+            if (res.counts[c] > 0) centers.row(c) = sums.row(c) / static_cast<CType>(res.counts[c]);
+        }
+    }
+
+    std::fill(res.counts.begin(), res.counts.end(), 0);
+    for (int i = 0; i < n; ++i) {
+        ++res.counts[res.labels[i]];
+    }
+
+    // Removes the empty clusters.
+    std::vector<int> new_labels(k, -1);
+    int num_clusters = 0;
+    for (int c = 0; c < k; ++c) {
+        if (res.counts[c] > 0) {
+            new_labels[c] = num_clusters;
+            res.counts[num_clusters++] = res.counts[c];
+        }
+    }
+    res.counts.resize(num_clusters);
+
+    for (auto& label : res.labels) {
+        label = new_labels[label];
+    }
+
+    return res;
+}
+
+}  // namespace kde
+
+#endif  // PYBNESIAN_KDE_KMEANSCONDENSATION_HPP
@@ -1,10 +1,13 @@
 #ifndef PYBNESIAN_KDE_NORMALREFERENCERULE_HPP
 #define PYBNESIAN_KDE_NORMALREFERENCERULE_HPP
 
+#include <dataset/covariance_registry.hpp>
 #include <kde/BandwidthSelector.hpp>
 #include <util/basic_eigen_ops.hpp>
 #include <util/exceptions.hpp>
 
+using dataset::CovarianceRegistry;
+
 namespace kde {
 
 class NormalReferenceRule : public BandwidthSelector {
@@ -59,6 +62,10 @@ public:
         }
     }
 
+    double covariance_scale(int d, int N) const override {
+        return std::pow(4. / (static_cast<double>(N) * (d + 2.)), 2. / (d + 4.));
+    }
+
     std::string ToString() const override { return "NormalReferenceRule"; }
 
     py::tuple __getstate__() const override { return py::make_tuple(); }
@@ -72,7 +79,7 @@ private:
     VectorXd diag_bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const {
         using CType = typename ArrowType::c_type;
 
-        auto cov_ptr = df.cov<ArrowType>(variables);
+        auto cov_ptr = CovarianceRegistry::get().cov<ArrowType>(df.indices_to_columns(variables));
         auto& cov = *cov_ptr;
 
         if (!util::is_psd(cov)) {
@@ -109,7 +116,7 @@ private:
     MatrixXd bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const {
         using CType = typename ArrowType::c_type;
 
-        auto cov = df.cov<ArrowType>(variables);
+        auto cov = CovarianceRegistry::get().cov<ArrowType>(df.indices_to_columns(variables));
 
         if (!util::is_psd(*cov)) {
             std::stringstream ss;
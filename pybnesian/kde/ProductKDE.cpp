@@ -6,30 +6,42 @@ namespace pyarrow = arrow::py;
 namespace kde {
 
 void ProductKDE::copy_bandwidth_opencl() {
-    m_cl_bandwidth.clear();
     auto& opencl = OpenCLConfig::get();
 
-    for (size_t i = 0; i < m_variables.size(); ++i) {
-        switch (m_training_type->id()) {
-            case Type::DOUBLE: {
-                auto sqrt = std::sqrt(m_bandwidth(i));
-                m_cl_bandwidth.push_back(opencl.copy_to_buffer(&sqrt, 1));
-                break;
-            }
-            case Type::FLOAT: {
-                auto casted = std::sqrt(static_cast<float>(m_bandwidth(i)));
-                m_cl_bandwidth.push_back(opencl.copy_to_buffer(&casted, 1));
-                break;
-            }
-            default:
-                throw std::invalid_argument("Unreachable code.");
+    // The kernels use the square root of the bandwidth of all the variables in one constant buffer.
+    switch (m_training_type->id()) {
+        case Type::DOUBLE: {
+            VectorXd sqrt_bandwidth = m_bandwidth.cwiseSqrt();
+            m_cl_bandwidth = opencl.copy_to_buffer(sqrt_bandwidth.data(), m_variables.size());
+            break;
         }
+        case Type::FLOAT: {
+            VectorXf casted = m_bandwidth.cast<float>().cwiseSqrt();
+            m_cl_bandwidth = opencl.copy_to_buffer(casted.data(), m_variables.size());
+            break;
+        }
+        default:
+            throw std::invalid_argument("Unreachable code.");
     }
 
     m_lognorm_const = -0.5 * m_variables.size() * std::log(2 * util::pi<double>) -
                       0.5 * m_bandwidth.array().log().sum() - std::log(N);
 }
 
+void ProductKDE::fit_binned(const MatrixXd& training) {
+    VectorXd padding = grid_padding * m_bandwidth.cwiseSqrt();
+    VectorXd lower = training.colwise().minCoeff().transpose() - padding;
+    VectorXd upper = training.colwise().maxCoeff().transpose() + padding;
+
+    m_binned.emplace(training, lower, upper, m_binned_grid_size);
+    update_binned_density();
+}
+
+void ProductKDE::update_binned_density() {
+    // The grid is not updated, so the instances outside the padding of the new bandwidth are evaluated exactly.
+    m_binned_density = m_binned->kernel_sums(m_bandwidth) / static_cast<double>(N);
+}
+
 DataFrame ProductKDE::training_data() const {
     check_fitted();
     switch (m_training_type->id()) {
@@ -43,6 +55,8 @@ DataFrame ProductKDE::training_data() const {
 }
 
 void ProductKDE::fit(const DataFrame& df) {
+    auto opencl_lock = OpenCLConfig::get().lock();
+
     m_training_type = df.same_type(m_variables);
 
     bool contains_null = df.null_count(m_variables) > 0;
@@ -70,6 +84,8 @@ void ProductKDE::fit(const DataFrame& df) {
 }
 
 VectorXd ProductKDE::logl(const DataFrame& df) const {
+    auto opencl_lock = OpenCLConfig::get().lock();
+
     check_fitted();
     auto type = df.same_type(m_variables);
 
@@ -88,6 +104,8 @@ VectorXd ProductKDE::logl(const DataFrame& df) const {
 }
 
 double ProductKDE::slogl(const DataFrame& df) const {
+    auto opencl_lock = OpenCLConfig::get().lock();
+
     check_fitted();
     auto type = df.same_type(m_variables);
 
@@ -118,9 +136,11 @@ py::tuple ProductKDE::__getstate__() const {
 }
 
 ProductKDE ProductKDE::__setstate__(py::tuple& t) {
-    if (t.size() != 8) throw std::runtime_error("Not valid ProductKDE.");
+    if (t.size() != 8 && t.size() != 9) throw std::runtime_error("Not valid ProductKDE.");
 
-    ProductKDE kde(t[0].cast<std::vector<std::string>>());
+    // The ProductKDE objects pickled before the binned approximation was added have 8 elements.
+    auto binned_grid_size = (t.size() == 9) ? t[8].cast<int>() : 0;
+    ProductKDE kde(t[0].cast<std::vector<std::string>>(), binned_grid_size);
 
     kde.m_fitted = t[1].cast<bool>();
     kde.m_bselector = t[2].cast<std::shared_ptr<BandwidthSelector>>();
@@ -134,32 +154,44 @@ ProductKDE ProductKDE::__setstate__(py::tuple& t) {
 
         auto& opencl = OpenCLConfig::get();
 
+        MatrixXd binned_training;
+        if (binned_grid_size > 0) binned_training.resize(kde.N, kde.m_variables.size());
+
         switch (kde.m_training_type->id()) {
             case Type::DOUBLE: {
                 auto data = t[4].cast<std::vector<VectorXd>>();
 
+                MatrixXd training(kde.N, kde.m_variables.size());
                 for (size_t i = 0; i < kde.m_variables.size(); ++i) {
-                    kde.m_cl_bandwidth.push_back(opencl.copy_to_buffer(&kde.m_bandwidth(i), 1));
-                    kde.m_training.push_back(opencl.copy_to_buffer(data[i].data(), kde.N));
+                    training.col(i) = data[i];
                 }
 
+                kde.m_training = opencl.copy_to_buffer(training.data(), kde.N * kde.m_variables.size());
+                if (binned_grid_size > 0) binned_training = training;
+
                 break;
             }
             case Type::FLOAT: {
                 auto data = t[4].cast<std::vector<VectorXf>>();
 
+                MatrixXf training(kde.N, kde.m_variables.size());
                 for (size_t i = 0; i < kde.m_variables.size(); ++i) {
-                    auto casted_bw = static_cast<float>(kde.m_bandwidth(i));
-
-                    kde.m_cl_bandwidth.push_back(opencl.copy_to_buffer(&casted_bw, 1));
-                    kde.m_training.push_back(opencl.copy_to_buffer(data[i].data(), kde.N));
+                    training.col(i) = data[i];
                 }
 
+                kde.m_training = opencl.copy_to_buffer(training.data(), kde.N * kde.m_variables.size());
+                if (binned_grid_size > 0) binned_training = training.template cast<double>();
+
                 break;
             }
             default:
                 throw std::runtime_error("Not valid data type in ProductKDE.");
         }
+
+        // The kernels use the square root of the bandwidth.
+        kde.copy_bandwidth_opencl();
+
+        if (binned_grid_size > 0) kde.fit_binned(binned_training);
     }
 
     return kde;
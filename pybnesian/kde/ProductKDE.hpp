@@ -3,11 +3,12 @@
 
 #include <util/pickle.hpp>
 #include <kde/BandwidthSelector.hpp>
+#include <kde/BinnedGrid.hpp>
 #include <kde/NormalReferenceRule.hpp>
 #include <opencl/opencl_config.hpp>
 #include <util/math_constants.hpp>
 
-using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits;
+using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits, opencl::PooledBuffer;
 
 namespace kde {
 
@@ -18,17 +19,36 @@ public:
           m_fitted(),
           m_bselector(std::make_shared<NormalReferenceRule>()),
           N(0),
-          m_training_type(arrow::float64()) {}
-
-    ProductKDE(std::vector<std::string> variables) : ProductKDE(variables, std::make_shared<NormalReferenceRule>()) {}
-
-    ProductKDE(std::vector<std::string> variables, std::shared_ptr<BandwidthSelector> b_selector)
-        : m_variables(variables), m_fitted(false), m_bselector(b_selector), N(0), m_training_type(arrow::float64()) {
+          m_training_type(arrow::float64()),
+          m_binned_grid_size(0),
+          m_binned(),
+          m_binned_density() {}
+
+    ProductKDE(std::vector<std::string> variables, int binned_grid_size = 0)
+        : ProductKDE(variables, std::make_shared<NormalReferenceRule>(), binned_grid_size) {}
+
+    // If binned_grid_size > 0, logl() is approximated in the CPU by binning the training data in a grid with
+    // binned_grid_size points per variable (see BinnedGrid). The test instances outside the grid, or where the binned
+    // density is too low to be accurate, are evaluated exactly.
+    ProductKDE(std::vector<std::string> variables,
+               std::shared_ptr<BandwidthSelector> b_selector,
+               int binned_grid_size = 0)
+        : m_variables(variables),
+          m_fitted(false),
+          m_bselector(b_selector),
+          N(0),
+          m_training_type(arrow::float64()),
+          m_binned_grid_size(binned_grid_size),
+          m_binned(),
+          m_binned_density() {
         if (b_selector == nullptr) throw std::runtime_error("Bandwidth selector procedure must be non-null.");
 
         if (m_variables.empty()) {
             throw std::invalid_argument("Cannot create a ProductKDE model with 0 variables");
         }
+
+        if (binned_grid_size < 0)
+            throw std::invalid_argument("The grid size of the binned approximation must be non-negative.");
     }
 
     const std::vector<std::string>& variables() const { return m_variables; }
@@ -45,6 +65,7 @@ public:
 
         m_bandwidth = new_bandwidth;
         if (m_bandwidth.rows() > 0) copy_bandwidth_opencl();
+        if (m_binned) update_binned_density();
     }
 
     DataFrame training_data() const;
@@ -63,10 +84,12 @@ public:
 
     std::shared_ptr<BandwidthSelector> bandwidth_type() const { return m_bselector; }
 
+    int binned_grid_size() const { return m_binned_grid_size; }
+
     VectorXd logl(const DataFrame& df) const;
 
     template <typename ArrowType>
-    cl::Buffer logl_buffer(const DataFrame& df) const;
+    PooledBuffer logl_buffer(const DataFrame& df) const;
 
     double slogl(const DataFrame& df) const;
 
@@ -77,10 +100,20 @@ public:
     static ProductKDE __setstate__(py::tuple&& t) { return __setstate__(t); }
 
 private:
+    // The grid of the binned approximation covers the training data extended by grid_padding standard deviations of
+    // the kernel.
+    static constexpr double grid_padding = 4;
+    // The binned densities smaller than binned_min_density times the maximum density of the grid are dominated by the
+    // rounding errors of the FFT, so their instances are evaluated exactly.
+    static constexpr double binned_min_density = 1e-8;
+
     void check_fitted() const {
         if (!fitted()) throw std::invalid_argument("ProductKDE factor not fitted.");
     }
 
+    void fit_binned(const MatrixXd& training);
+    void update_binned_density();
+
     template <typename ArrowType>
     DataFrame _training_data() const;
 
@@ -91,15 +124,19 @@ private:
     VectorXd _logl(const DataFrame& df) const;
     template <typename ArrowType>
     double _slogl(const DataFrame& df) const;
+    // Returns the binned log-likelihood of the rows of df without null values.
+    template <typename ArrowType>
+    VectorXd _binned_logl(const DataFrame& df) const;
 
     template <typename ArrowType>
     void product_logl_mat(cl::Buffer& test_buffer,
+                          const unsigned int test_physical_rows,
                           const unsigned int test_offset,
                           const unsigned int test_length,
                           cl::Buffer& output_mat) const;
 
     template <typename ArrowType>
-    cl::Buffer _logl_impl(cl::Buffer& test_buffer, int m) const;
+    PooledBuffer _logl_impl(cl::Buffer& test_buffer, int m) const;
 
     void copy_bandwidth_opencl();
 
@@ -110,11 +147,16 @@ private:
     bool m_fitted;
     std::shared_ptr<BandwidthSelector> m_bselector;
     VectorXd m_bandwidth;
-    std::vector<cl::Buffer> m_cl_bandwidth;
-    std::vector<cl::Buffer> m_training;
+    // The square root of the bandwidth of each variable.
+    cl::Buffer m_cl_bandwidth;
+    // The training data packed in a column-major matrix with N rows and one column for each variable.
+    cl::Buffer m_training;
     double m_lognorm_const;
     size_t N;
     std::shared_ptr<arrow::DataType> m_training_type;
+    int m_binned_grid_size;
+    std::optional<BinnedGrid> m_binned;
+    VectorXd m_binned_density;
 };
 
 template <typename ArrowType>
@@ -124,15 +166,14 @@ DataFrame ProductKDE::_training_data() const {
     arrow::NumericBuilder<ArrowType> builder;
 
     auto& opencl = OpenCLConfig::get();
-    VectorType tmp_buffer(N);
+    VectorType tmp_buffer(N * m_variables.size());
+    opencl.read_from_buffer(tmp_buffer.data(), m_training, N * m_variables.size());
 
     std::vector<Array_ptr> columns;
     arrow::SchemaBuilder b(arrow::SchemaBuilder::ConflictPolicy::CONFLICT_ERROR);
     for (size_t i = 0; i < m_variables.size(); ++i) {
-        opencl.read_from_buffer(tmp_buffer.data(), m_training[i], N);
-
         auto status = builder.Resize(N);
-        RAISE_STATUS_ERROR(builder.AppendValues(tmp_buffer.data(), N));
+        RAISE_STATUS_ERROR(builder.AppendValues(tmp_buffer.data() + i * N, N));
 
         Array_ptr out;
         RAISE_STATUS_ERROR(builder.Finish(&out));
@@ -155,8 +196,6 @@ void ProductKDE::_fit(const DataFrame& df) {
     using CType = typename ArrowType::c_type;
 
     if (static_cast<size_t>(m_bandwidth.rows()) != m_variables.size()) m_bandwidth = VectorXd(m_variables.size());
-    m_cl_bandwidth.clear();
-    m_training.clear();
 
     Buffer_ptr combined_bitmap;
     if constexpr (contains_null) combined_bitmap = df.combined_bitmap(m_variables);
@@ -167,26 +206,30 @@ void ProductKDE::_fit(const DataFrame& df) {
 
     m_bandwidth = m_bselector->diag_bandwidth(df, m_variables);
 
-    for (size_t i = 0; i < m_variables.size(); ++i) {
-        if constexpr (std::is_same_v<CType, double>) {
-            auto sqrt = std::sqrt(m_bandwidth(i));
-            m_cl_bandwidth.push_back(opencl.copy_to_buffer(&sqrt, 1));
-        } else {
-            auto casted = std::sqrt(static_cast<CType>(m_bandwidth(i)));
-            m_cl_bandwidth.push_back(opencl.copy_to_buffer(&casted, 1));
-        }
+    MatrixXd binned_training;
+    if (m_binned_grid_size > 0) binned_training.resize(N, m_variables.size());
 
-        if constexpr (contains_null) {
-            auto column = df.to_eigen<false, ArrowType>(combined_bitmap, m_variables[i]);
-            m_training.push_back(opencl.copy_to_buffer(column->data(), N));
-        } else {
-            auto column = df.to_eigen<false, ArrowType, false>(m_variables[i]);
-            m_training.push_back(opencl.copy_to_buffer(column->data(), N));
+    if constexpr (contains_null) {
+        auto training = df.to_eigen<false, ArrowType>(combined_bitmap, m_variables);
+        m_training = opencl.copy_to_buffer(training->data(), N * m_variables.size());
+        if (m_binned_grid_size > 0) binned_training = training->template cast<double>();
+    } else {
+        // The training matrix is assembled from the shared device copies of the columns.
+        m_training = opencl.new_buffer<CType>(N * m_variables.size());
+        for (size_t i = 0; i < m_variables.size(); ++i) {
+            auto column = opencl.shared_column<ArrowType>(df.col(m_variables[i]));
+            opencl.copy_buffer_region<CType>(*column, 0, m_training, i * N, N);
+            if (m_binned_grid_size > 0)
+                binned_training.col(i) = df.to_eigen<false, ArrowType, false>(m_variables[i])->template cast<double>();
         }
     }
 
-    m_lognorm_const = -0.5 * static_cast<double>(m_variables.size()) * std::log(2 * util::pi<double>) -
-                      0.5 * m_bandwidth.array().log().sum() - std::log(N);
+    copy_bandwidth_opencl();
+
+    if (m_binned_grid_size > 0)
+        fit_binned(binned_training);
+    else
+        m_binned.reset();
 }
 
 template <typename ArrowType>
@@ -194,99 +237,121 @@ VectorXd ProductKDE::_logl(const DataFrame& df) const {
     using CType = typename ArrowType::c_type;
     using VectorType = Matrix<CType, Dynamic, 1>;
 
-    auto logl_buff = logl_buffer<ArrowType>(df);
-    auto& opencl = OpenCLConfig::get();
-    if (df.null_count(m_variables) == 0) {
-        VectorType read_data(df->num_rows());
-        opencl.read_from_buffer(read_data.data(), logl_buff, df->num_rows());
-        if constexpr (!std::is_same_v<CType, double>)
-            return read_data.template cast<double>();
-        else
-            return read_data;
+    auto m = df.valid_rows(m_variables);
+    VectorXd valid_logl;
+    if (m_binned) {
+        valid_logl = _binned_logl<ArrowType>(df);
     } else {
-        auto m = df.valid_rows(m_variables);
+        auto logl_buff = logl_buffer<ArrowType>(df);
+        auto& opencl = OpenCLConfig::get();
         VectorType read_data(m);
-        auto bitmap = df.combined_bitmap(m_variables);
-        auto bitmap_data = bitmap->data();
-
         opencl.read_from_buffer(read_data.data(), logl_buff, m);
+        valid_logl = read_data.template cast<double>();
+    }
 
-        VectorXd res(df->num_rows());
+    if (df.null_count(m_variables) == 0) return valid_logl;
 
-        for (int i = 0, k = 0; i < df->num_rows(); ++i) {
-            if (util::bit_util::GetBit(bitmap_data, i)) {
-                res(i) = static_cast<double>(read_data[k++]);
-            } else {
-                res(i) = util::nan<double>;
-            }
+    auto bitmap = df.combined_bitmap(m_variables);
+    auto bitmap_data = bitmap->data();
+
+    VectorXd res(df->num_rows());
+    util::bit_util::expand(bitmap_data, df->num_rows(), valid_logl.data(), util::nan<double>, res.data());
+
+    return res;
+}
+
+template <typename ArrowType>
+VectorXd ProductKDE::_binned_logl(const DataFrame& df) const {
+    using CType = typename ArrowType::c_type;
+    using VectorType = Matrix<CType, Dynamic, 1>;
+
+    auto test_matrix = df.to_eigen<false, ArrowType>(m_variables);
+    auto m = test_matrix->rows();
+    auto min_density = binned_min_density * m_binned_density.maxCoeff();
+
+    VectorXd res(m);
+    std::vector<int> exact_rows;
+    for (int i = 0; i < m; ++i) {
+        auto density = m_binned->interpolate(m_binned_density, test_matrix->row(i).transpose().template cast<double>());
+        if (density && *density > min_density)
+            res(i) = std::log(*density);
+        else
+            exact_rows.push_back(i);
+    }
+
+    if (!exact_rows.empty()) {
+        auto m_exact = static_cast<int>(exact_rows.size());
+        Matrix<CType, Dynamic, Dynamic> exact_matrix(m_exact, m_variables.size());
+        for (int i = 0; i < m_exact; ++i) {
+            exact_matrix.row(i) = test_matrix->row(exact_rows[i]);
         }
 
-        return res;
+        auto& opencl = OpenCLConfig::get();
+        auto test_buffer = opencl.copy_to_temp_buffer(exact_matrix.data(), m_exact * m_variables.size());
+        auto logl_buff = _logl_impl<ArrowType>(test_buffer, m_exact);
+
+        VectorType exact_logl(m_exact);
+        opencl.read_from_buffer(exact_logl.data(), logl_buff, m_exact);
+        for (int i = 0; i < m_exact; ++i) {
+            res(exact_rows[i]) = static_cast<double>(exact_logl(i));
+        }
     }
+
+    return res;
 }
 
 template <typename ArrowType>
-cl::Buffer ProductKDE::logl_buffer(const DataFrame& df) const {
+PooledBuffer ProductKDE::logl_buffer(const DataFrame& df) const {
     auto& opencl = OpenCLConfig::get();
 
     auto test_matrix = df.to_eigen<false, ArrowType>(m_variables);
     auto m = test_matrix->rows();
     // std::ve
-    auto test_buffer = opencl.copy_to_buffer(test_matrix->data(), m * m_variables.size());
+    auto test_buffer = opencl.copy_to_temp_buffer(test_matrix->data(), m * m_variables.size());
 
     return _logl_impl<ArrowType>(test_buffer, m);
 }
 
 template <typename ArrowType>
 void ProductKDE::product_logl_mat(cl::Buffer& test_buffer,
+                                  const unsigned int test_physical_rows,
                                   const unsigned int test_offset,
                                   const unsigned int test_length,
                                   cl::Buffer& output_mat) const {
     using CType = typename ArrowType::c_type;
 
     auto& opencl = OpenCLConfig::get();
-    auto& k_logl_values_1d_mat = opencl.kernel(OpenCL_kernel_traits<ArrowType>::logl_values_1d_mat);
-    k_logl_values_1d_mat.setArg(0, m_training[0]);
-    k_logl_values_1d_mat.setArg(1, static_cast<unsigned int>(N));
-    k_logl_values_1d_mat.setArg(2, test_buffer);
-    k_logl_values_1d_mat.setArg(3, test_offset);
-    k_logl_values_1d_mat.setArg(4, m_cl_bandwidth[0]);
-    k_logl_values_1d_mat.setArg(5, static_cast<CType>(m_lognorm_const));
-    k_logl_values_1d_mat.setArg(6, output_mat);
+    auto& k_logl_values_product_mat = opencl.kernel(OpenCL_kernel_traits<ArrowType>::logl_values_product_mat);
+    k_logl_values_product_mat.setArg(0, m_training);
+    k_logl_values_product_mat.setArg(1, static_cast<unsigned int>(N));
+    k_logl_values_product_mat.setArg(2, test_buffer);
+    k_logl_values_product_mat.setArg(3, test_physical_rows);
+    k_logl_values_product_mat.setArg(4, test_offset);
+    k_logl_values_product_mat.setArg(5, static_cast<unsigned int>(m_variables.size()));
+    k_logl_values_product_mat.setArg(6, m_cl_bandwidth);
+    k_logl_values_product_mat.setArg(7, static_cast<CType>(m_lognorm_const));
+    k_logl_values_product_mat.setArg(8, output_mat);
     auto& queue = opencl.queue();
-    RAISE_ENQUEUEKERNEL_ERROR(
-        queue.enqueueNDRangeKernel(k_logl_values_1d_mat, cl::NullRange, cl::NDRange(N * test_length), cl::NullRange));
-
-    auto& k_add_logl_values_1d_mat = opencl.kernel(OpenCL_kernel_traits<ArrowType>::add_logl_values_1d_mat);
-    k_add_logl_values_1d_mat.setArg(1, static_cast<unsigned int>(N));
-    k_add_logl_values_1d_mat.setArg(2, test_buffer);
-    k_add_logl_values_1d_mat.setArg(5, output_mat);
-
-    for (size_t i = 1; i < m_variables.size(); ++i) {
-        k_add_logl_values_1d_mat.setArg(0, m_training[i]);
-        k_add_logl_values_1d_mat.setArg(3, static_cast<unsigned int>(i * test_length) + test_offset);
-        k_add_logl_values_1d_mat.setArg(4, m_cl_bandwidth[i]);
-        RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
-            k_add_logl_values_1d_mat, cl::NullRange, cl::NDRange(N * test_length), cl::NullRange));
-    }
+    RAISE_ENQUEUEKERNEL_ERROR(queue.enqueueNDRangeKernel(
+        k_logl_values_product_mat, cl::NullRange, cl::NDRange(N * test_length), cl::NullRange));
 }
 
 template <typename ArrowType>
-cl::Buffer ProductKDE::_logl_impl(cl::Buffer& test_buffer, int m) const {
+PooledBuffer ProductKDE::_logl_impl(cl::Buffer& test_buffer, int m) const {
     using CType = typename ArrowType::c_type;
     auto& opencl = OpenCLConfig::get();
-    auto res = opencl.new_buffer<CType>(m);
+    auto res = opencl.temp_buffer<CType>(m);
 
     auto [mat_logls, allocated_m] = opencl.allocate_temp_mat<ArrowType>(N, m);
     auto iterations = static_cast<int>(std::ceil(static_cast<double>(m) / static_cast<double>(allocated_m)));
 
     for (auto i = 0; i < (iterations - 1); ++i) {
-        product_logl_mat<ArrowType>(test_buffer, i * allocated_m, allocated_m, mat_logls);
+        product_logl_mat<ArrowType>(test_buffer, m, i * allocated_m, allocated_m, mat_logls);
         opencl.logsumexp_cols_offset<ArrowType>(mat_logls, N, allocated_m, res, i * allocated_m);
     }
 
     auto remaining_m = m - (iterations - 1) * allocated_m;
-    product_logl_mat<ArrowType>(test_buffer, m - remaining_m, remaining_m, mat_logls);
+    product_logl_mat<ArrowType>(test_buffer, m, m - remaining_m, remaining_m, mat_logls);
     opencl.logsumexp_cols_offset<ArrowType>(mat_logls, N, remaining_m, res, m - remaining_m);
 
     return res;
@@ -296,6 +361,8 @@ template <typename ArrowType>
 double ProductKDE::_slogl(const DataFrame& df) const {
     using CType = typename ArrowType::c_type;
 
+    if (m_binned) return _binned_logl<ArrowType>(df).sum();
+
     auto logl_buff = logl_buffer<ArrowType>(df);
     auto m = df.valid_rows(m_variables);
 
@@ -321,9 +388,10 @@ py::tuple ProductKDE::__getstate__() const {
     if (m_fitted) {
         auto& opencl = OpenCLConfig::get();
 
+        VectorType training(N * m_variables.size());
+        opencl.read_from_buffer(training.data(), m_training, N * m_variables.size());
         for (size_t i = 0; i < m_variables.size(); ++i) {
-            VectorType column(N);
-            opencl.read_from_buffer(column.data(), m_training[i], N);
+            training_data.push_back(training.segment(i * N, N));
         }
 
         lognorm_const = m_lognorm_const;
@@ -332,8 +400,15 @@ py::tuple ProductKDE::__getstate__() const {
         bw = m_bandwidth;
     }
 
-    return py::make_tuple(
-        m_variables, m_fitted, m_bselector, bw, training_data, lognorm_const, N_export, training_type);
+    return py::make_tuple(m_variables,
+                          m_fitted,
+                          m_bselector,
+                          bw,
+                          training_data,
+                          lognorm_const,
+                          N_export,
+                          training_type,
+                          m_binned_grid_size);
 }
 
 }  // namespace kde
@@ -1,6 +1,10 @@
 #ifndef PYBNESIAN_KDE_SCOTTSBANDWIDTH_HPP
 #define PYBNESIAN_KDE_SCOTTSBANDWIDTH_HPP
 
+#include <dataset/covariance_registry.hpp>
+
+using dataset::CovarianceRegistry;
+
 namespace kde {
 
 class ScottsBandwidth : public BandwidthSelector {
@@ -55,6 +59,8 @@ public:
         }
     }
 
+    double covariance_scale(int d, int N) const override { return std::pow(static_cast<double>(N), -2. / (d + 4.)); }
+
     std::string ToString() const override { return "ScottsBandwidth"; }
 
     py::tuple __getstate__() const override { return py::make_tuple(); }
@@ -79,8 +85,9 @@ private:
                 bandwidth(i) = k * df.cov<ArrowType>(combined_bitmap, variables[i]);
             }
         } else {
+            auto& registry = CovarianceRegistry::get();
             for (size_t i = 0; i < variables.size(); ++i) {
-                bandwidth(i) = k * df.cov<ArrowType, false>(variables[i]);
+                bandwidth(i) = k * (*registry.cov<ArrowType>({df.col(variables[i])}))(0, 0);
             }
         }
 
@@ -91,7 +98,7 @@ private:
     MatrixXd bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const {
         using CType = typename ArrowType::c_type;
 
-        auto cov = df.cov<ArrowType>(variables);
+        auto cov = CovarianceRegistry::get().cov<ArrowType>(df.indices_to_columns(variables));
 
         if (!util::is_psd(*cov)) {
             std::stringstream ss;
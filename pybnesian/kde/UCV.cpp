@@ -1,11 +1,12 @@
 #include <kde/UCV.hpp>
 #include <kde/NormalReferenceRule.hpp>
 #include <util/math_constants.hpp>
+#include <util/parallel.hpp>
 #include <util/vech_ops.hpp>
 #include <nlopt.hpp>
 
 using Eigen::LLT;
-using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits;
+using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits, opencl::PooledBuffer, opencl::SumReduction;
 
 namespace kde {
 
@@ -47,9 +48,7 @@ void UnivariateUCVScore::sum_triangular_scores(const cl::Buffer& training_data,
     k_sum_ucv_1d.setArg(5, output_2h);
     k_sum_ucv_1d.setArg(6, output_h);
 
-    auto& queue = opencl.queue();
-    RAISE_ENQUEUEKERNEL_ERROR(
-        queue.enqueueNDRangeKernel(k_sum_ucv_1d, cl::NullRange, cl::NDRange(length), cl::NullRange));
+    RAISE_ENQUEUEKERNEL_ERROR(opencl.enqueue_tuned_kernel(OpenCL_kernel_traits<ArrowType>::sum_ucv_1d, length));
 }
 
 class ProductUCVScore {
@@ -99,8 +98,7 @@ void ProductUCVScore::sum_triangular_scores(const cl::Buffer& training_data,
 
     for (unsigned int i = 1; i < training_cols; ++i) {
         k_sum_ucv_diag.setArg(4, i);
-        RAISE_ENQUEUEKERNEL_ERROR(
-            queue.enqueueNDRangeKernel(k_sum_ucv_diag, cl::NullRange, cl::NDRange(length), cl::NullRange));
+        RAISE_ENQUEUEKERNEL_ERROR(opencl.enqueue_tuned_kernel(OpenCL_kernel_traits<ArrowType>::sum_ucv_diag, length));
     }
 
     auto& k_copy_ucv_diag = opencl.kernel(OpenCL_kernel_traits<ArrowType>::copy_ucv_diag);
@@ -173,8 +171,7 @@ void MultivariateUCVScore::sum_triangular_scores(const cl::Buffer& training_data
     k_sum_ucv_mat.setArg(4, output_2h);
     k_sum_ucv_mat.setArg(5, output_h);
 
-    RAISE_ENQUEUEKERNEL_ERROR(
-        queue.enqueueNDRangeKernel(k_sum_ucv_mat, cl::NullRange, cl::NDRange(length), cl::NullRange));
+    RAISE_ENQUEUEKERNEL_ERROR(opencl.enqueue_tuned_kernel(OpenCL_kernel_traits<ArrowType>::sum_ucv_mat, length));
 }
 
 template <typename ArrowType, bool contains_null>
@@ -206,6 +203,29 @@ cl::Buffer UCVScorer::_copy_training_data(const DataFrame& df, const std::vector
     }
 }
 
+std::shared_ptr<BinnedGrid> UCVScorer::_binned_grid(const DataFrame& df,
+                                                     const std::vector<std::string>& variables,
+                                                     int grid_size) const {
+    if (grid_size < 0) throw std::invalid_argument("The grid size of the binned approximation must be non-negative.");
+    if (grid_size == 0) return nullptr;
+
+    MatrixXd training;
+    switch (m_training_type->id()) {
+        case Type::DOUBLE:
+            training = *df.to_eigen<false, arrow::DoubleType>(variables);
+            break;
+        case Type::FLOAT:
+            training = df.to_eigen<false, arrow::FloatType>(variables)->template cast<double>();
+            break;
+        default:
+            throw std::invalid_argument("Wrong data type to score UCV. [double] or [float] data is expected.");
+    }
+
+    // The convolutions are zero-padded, so the grid only needs to cover the training data.
+    return std::make_shared<BinnedGrid>(
+        training, training.colwise().minCoeff().transpose(), training.colwise().maxCoeff().transpose(), grid_size);
+}
+
 template <typename ArrowType>
 std::pair<cl::Buffer, typename ArrowType::c_type> UCVScorer::copy_diagonal_bandwidth(
     const Matrix<typename ArrowType::c_type, Dynamic, 1>& diagonal_sqrt_bandwidth) const {
@@ -247,12 +267,12 @@ double UCVScorer::score_diagonal_impl(
     auto iterations =
         static_cast<int>(std::ceil(static_cast<double>(n_distances) / static_cast<double>(instances_per_iteration)));
 
-    cl::Buffer sum2h = opencl.new_buffer<CType>(instances_per_iteration);
+    PooledBuffer sum2h = opencl.temp_buffer<CType>(instances_per_iteration);
     opencl.fill_buffer<CType>(sum2h, 0., instances_per_iteration);
-    cl::Buffer sumh = opencl.new_buffer<CType>(instances_per_iteration);
+    PooledBuffer sumh = opencl.temp_buffer<CType>(instances_per_iteration);
     opencl.fill_buffer<CType>(sumh, 0., instances_per_iteration);
 
-    cl::Buffer temp_h = opencl.new_buffer<CType>(instances_per_iteration);
+    PooledBuffer temp_h = opencl.temp_buffer<CType>(instances_per_iteration);
 
     for (auto i = 0; i < (iterations - 1); ++i) {
         ProductUCVScore::sum_triangular_scores<ArrowType>(m_training,
@@ -308,14 +328,14 @@ double UCVScorer::score_unconstrained_impl(
     auto iterations =
         static_cast<int>(std::ceil(static_cast<double>(n_distances) / static_cast<double>(instances_per_iteration)));
 
-    cl::Buffer sum2h = opencl.new_buffer<CType>(instances_per_iteration);
+    PooledBuffer sum2h = opencl.temp_buffer<CType>(instances_per_iteration);
     opencl.fill_buffer<CType>(sum2h, 0., instances_per_iteration);
-    cl::Buffer sumh = opencl.new_buffer<CType>(instances_per_iteration);
+    PooledBuffer sumh = opencl.temp_buffer<CType>(instances_per_iteration);
     opencl.fill_buffer<CType>(sumh, 0., instances_per_iteration);
 
-    cl::Buffer tmp_mat_buffer;
+    PooledBuffer tmp_mat_buffer;
     if constexpr (std::is_same_v<UCVScore, MultivariateUCVScore>) {
-        tmp_mat_buffer = opencl.new_buffer<CType>(instances_per_iteration * d);
+        tmp_mat_buffer = opencl.temp_buffer<CType>(instances_per_iteration * d);
     }
 
     for (auto i = 0; i < (iterations - 1); ++i) {
@@ -357,11 +377,95 @@ double UCVScorer::score_unconstrained_impl(
     return std::exp(lognorm_2H) + 2 * s2h / N - 4 * sh / (N - 1);
 }
 
+template <typename ArrowType>
+VectorXd UCVScorer::score_batch_impl(const std::vector<MatrixXd>& inv_choleskys, const VectorXd& lognorm_H) const {
+    using CType = typename ArrowType::c_type;
+    unsigned int num_bandwidths = inv_choleskys.size();
+
+    Matrix<CType, Dynamic, Dynamic> inv_matrix(d * d, num_bandwidths);
+    for (unsigned int b = 0; b < num_bandwidths; ++b) {
+        inv_matrix.col(b) = Eigen::Map<const VectorXd>(inv_choleskys[b].data(), d * d).template cast<CType>();
+    }
+
+    VectorXd lognorm_2H = lognorm_H.array() - 0.5 * d * std::log(2.);
+    Matrix<CType, Dynamic, 1> lognorm_H_c = lognorm_H.template cast<CType>();
+    Matrix<CType, Dynamic, 1> lognorm_2H_c = lognorm_2H.template cast<CType>();
+
+    auto& opencl = OpenCLConfig::get();
+    auto inv_buffer = opencl.copy_to_buffer(inv_matrix.data(), d * d * num_bandwidths);
+    auto lognorm_H_buffer = opencl.copy_to_buffer(lognorm_H_c.data(), num_bandwidths);
+    auto lognorm_2H_buffer = opencl.copy_to_buffer(lognorm_2H_c.data(), num_bandwidths);
+
+    auto n_distances = N * (N - 1) / 2;
+
+    // The sum matrices have a column for each bandwidth, so the pairs processed at a time are split between them.
+    auto instances_per_iteration =
+        std::min(std::max(static_cast<size_t>(1000000) / num_bandwidths, static_cast<size_t>(1)), n_distances);
+    auto iterations =
+        static_cast<int>(std::ceil(static_cast<double>(n_distances) / static_cast<double>(instances_per_iteration)));
+
+    PooledBuffer sum2h = opencl.temp_buffer<CType>(instances_per_iteration * num_bandwidths);
+    opencl.fill_buffer<CType>(sum2h, 0., instances_per_iteration * num_bandwidths);
+    PooledBuffer sumh = opencl.temp_buffer<CType>(instances_per_iteration * num_bandwidths);
+    opencl.fill_buffer<CType>(sumh, 0., instances_per_iteration * num_bandwidths);
+
+    auto& k_sum_ucv_batch = opencl.kernel(OpenCL_kernel_traits<ArrowType>::sum_ucv_batch);
+    k_sum_ucv_batch.setArg(0, m_training);
+    k_sum_ucv_batch.setArg(1, static_cast<unsigned int>(N));
+    k_sum_ucv_batch.setArg(2, static_cast<unsigned int>(d));
+    k_sum_ucv_batch.setArg(4, inv_buffer);
+    k_sum_ucv_batch.setArg(5, lognorm_2H_buffer);
+    k_sum_ucv_batch.setArg(6, lognorm_H_buffer);
+    k_sum_ucv_batch.setArg(7, num_bandwidths);
+    k_sum_ucv_batch.setArg(8, static_cast<unsigned int>(instances_per_iteration));
+    k_sum_ucv_batch.setArg(9, sum2h);
+    k_sum_ucv_batch.setArg(10, sumh);
+
+    auto& queue = opencl.queue();
+    for (auto i = 0; i < iterations; ++i) {
+        auto index_offset = i * instances_per_iteration;
+        auto length = std::min(instances_per_iteration, n_distances - index_offset);
+        k_sum_ucv_batch.setArg(3, static_cast<unsigned int>(index_offset));
+        RAISE_ENQUEUEKERNEL_ERROR(
+            queue.enqueueNDRangeKernel(k_sum_ucv_batch, cl::NullRange, cl::NDRange(length), cl::NullRange));
+    }
+
+    using Sum = SumReduction<ArrowType>;
+    auto b2h = opencl.reduction_cols<ArrowType, Sum>(sum2h, instances_per_iteration, num_bandwidths);
+    auto bh = opencl.reduction_cols<ArrowType, Sum>(sumh, instances_per_iteration, num_bandwidths);
+
+    Matrix<CType, Dynamic, 1> s2h(num_bandwidths), sh(num_bandwidths);
+    opencl.read_from_buffer(s2h.data(), b2h, num_bandwidths);
+    opencl.read_from_buffer(sh.data(), bh, num_bandwidths);
+
+    // Returns UCV scaled by N: N * UCV
+    return lognorm_2H.array().exp() + 2 * s2h.template cast<double>().array() / N -
+           4 * sh.template cast<double>().array() / (N - 1);
+}
+
+double UCVScorer::score_binned(const VectorXd& diagonal_bandwidth) const {
+    // The binned sums also include the pairs (i, i), whose kernel value is the normalization constant.
+    auto sum_pairs = [this](const VectorXd& bandwidth) {
+        auto lognorm_H = -0.5 * bandwidth.array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>);
+        auto sum_all = m_binned->counts().dot(m_binned->kernel_sums(bandwidth));
+        return 0.5 * (sum_all - N * std::exp(lognorm_H));
+    };
+
+    auto s2h = sum_pairs(2 * diagonal_bandwidth);
+    auto sh = sum_pairs(diagonal_bandwidth);
+    auto lognorm_2H = -0.5 * diagonal_bandwidth.array().log().sum() - 0.5 * d * std::log(4 * util::pi<double>);
+
+    // Returns UCV scaled by N: N * UCV
+    return std::exp(lognorm_2H) + 2 * s2h / N - 4 * sh / (N - 1);
+}
+
 double UCVScorer::score_diagonal(const VectorXd& diagonal_bandwidth) const {
     if (d != static_cast<size_t>(diagonal_bandwidth.rows()))
         throw std::invalid_argument("Wrong dimension for bandwidth vector. it should be a " + std::to_string(d) +
                                     " vector.");
 
+    if (m_binned) return score_binned(diagonal_bandwidth);
+
     switch (m_training_type->id()) {
         case Type::DOUBLE: {
             return score_diagonal_impl<arrow::DoubleType>(diagonal_bandwidth.cwiseSqrt());
@@ -379,6 +483,12 @@ double UCVScorer::score_unconstrained(const MatrixXd& bandwidth) const {
         throw std::invalid_argument("Wrong dimension for bandwidth matrix. it should be a " + std::to_string(d) + "x" +
                                     std::to_string(d) + " matrix.");
 
+    if (m_binned) {
+        if (!bandwidth.isDiagonal())
+            throw std::invalid_argument("The binned UCV approximation only supports diagonal bandwidth matrices.");
+        return score_binned(bandwidth.diagonal());
+    }
+
     switch (m_training_type->id()) {
         case Type::DOUBLE: {
             if (d == 1)
@@ -398,12 +508,91 @@ double UCVScorer::score_unconstrained(const MatrixXd& bandwidth) const {
     }
 }
 
+VectorXd UCVScorer::score_diagonal_batch(const std::vector<VectorXd>& diagonal_bandwidths) const {
+    if (m_binned) {
+        // Each bandwidth needs its own convolutions, so they are scored in parallel.
+        VectorXd scores(diagonal_bandwidths.size());
+        util::parallel_for(0, diagonal_bandwidths.size(), 0, [&](int i, int) {
+            scores(i) = score_diagonal(diagonal_bandwidths[i]);
+        });
+        return scores;
+    }
+
+    std::vector<MatrixXd> inv_choleskys;
+    inv_choleskys.reserve(diagonal_bandwidths.size());
+    VectorXd lognorm_H(diagonal_bandwidths.size());
+
+    for (size_t i = 0; i < diagonal_bandwidths.size(); ++i) {
+        const auto& bw = diagonal_bandwidths[i];
+        if (d != static_cast<size_t>(bw.rows()))
+            throw std::invalid_argument("Wrong dimension for bandwidth vector. it should be a " + std::to_string(d) +
+                                        " vector.");
+
+        inv_choleskys.push_back(bw.cwiseSqrt().cwiseInverse().asDiagonal());
+        lognorm_H(i) = -0.5 * bw.array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>);
+    }
+
+    switch (m_training_type->id()) {
+        case Type::DOUBLE:
+            return score_batch_impl<arrow::DoubleType>(inv_choleskys, lognorm_H);
+        case Type::FLOAT:
+            return score_batch_impl<arrow::FloatType>(inv_choleskys, lognorm_H);
+        default:
+            throw std::runtime_error("Unreachable code");
+    }
+}
+
+VectorXd UCVScorer::score_unconstrained_batch(const std::vector<MatrixXd>& bandwidths) const {
+    if (m_binned) {
+        VectorXd scores(bandwidths.size());
+        util::parallel_for(
+            0, bandwidths.size(), 0, [&](int i, int) { scores(i) = score_unconstrained(bandwidths[i]); });
+        return scores;
+    }
+
+    std::vector<MatrixXd> inv_choleskys;
+    inv_choleskys.reserve(bandwidths.size());
+    VectorXd lognorm_H(bandwidths.size());
+
+    for (size_t i = 0; i < bandwidths.size(); ++i) {
+        const auto& bw = bandwidths[i];
+        if (d != static_cast<size_t>(bw.rows()) || d != static_cast<size_t>(bw.cols()))
+            throw std::invalid_argument("Wrong dimension for bandwidth matrix. it should be a " + std::to_string(d) +
+                                        "x" + std::to_string(d) + " matrix.");
+
+        LLT<MatrixXd> llt(bw);
+        if (llt.info() != Eigen::Success)
+            throw std::invalid_argument("The bandwidth matrix must be positive definite.");
+
+        MatrixXd inv = MatrixXd::Identity(d, d);
+        llt.matrixL().solveInPlace(inv);
+        inv_choleskys.push_back(std::move(inv));
+        lognorm_H(i) = -llt.matrixLLT().diagonal().array().log().sum() - 0.5 * d * std::log(2 * util::pi<double>);
+    }
+
+    switch (m_training_type->id()) {
+        case Type::DOUBLE:
+            return score_batch_impl<arrow::DoubleType>(inv_choleskys, lognorm_H);
+        case Type::FLOAT:
+            return score_batch_impl<arrow::FloatType>(inv_choleskys, lognorm_H);
+        default:
+            throw std::runtime_error("Unreachable code");
+    }
+}
+
 struct UCVOptimInfo {
     UCVScorer ucv_scorer;
     double start_score;
     double start_determinant;
 };
 
+// Avoid too small/large determinants returning the start score.
+// Package ks uses 1e10 as constant.
+bool valid_determinant(double det, const UCVOptimInfo& optim_info) {
+    return det > util::machine_tol && det >= 1e-3 * optim_info.start_determinant &&
+           det <= 1e3 * optim_info.start_determinant && !std::isnan(det);
+}
+
 double wrap_ucv_diag_optim(unsigned n, const double* x, double*, void* my_func_data) {
     using MapType = Eigen::Map<const VectorXd>;
     MapType xm(x, n);
@@ -413,9 +602,7 @@ double wrap_ucv_diag_optim(unsigned n, const double* x, double*, void* my_func_d
     auto det_sqrt = xm.prod();
     auto det = det_sqrt * det_sqrt;
 
-    if (det <= util::machine_tol || det < 1e-3 * optim_info.start_determinant ||
-        det > 1e3 * optim_info.start_determinant)
-        return optim_info.start_score + 10e-8;
+    if (!valid_determinant(det, optim_info)) return optim_info.start_score + 10e-8;
 
     auto score = optim_info.ucv_scorer.score_diagonal(xm.array().square().matrix());
 
@@ -435,11 +622,7 @@ double wrap_ucv_optim(unsigned n, const double* x, double*, void* my_func_data)
 
     auto det = std::exp(2 * sqrt.diagonal().array().log().sum());
 
-    // Avoid too small/large determinants returning the start score.
-    // Package ks uses 1e10 as constant.
-    if (det <= util::machine_tol || det < 1e-3 * optim_info.start_determinant ||
-        det > 1e3 * optim_info.start_determinant || std::isnan(det))
-        return optim_info.start_score + 10e-8;
+    if (!valid_determinant(det, optim_info)) return optim_info.start_score + 10e-8;
 
     auto score = optim_info.ucv_scorer.score_unconstrained(H);
 
@@ -449,40 +632,172 @@ double wrap_ucv_optim(unsigned n, const double* x, double*, void* my_func_data)
     return score;
 }
 
-VectorXd UCV::diag_bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const {
-    if (variables.empty()) return VectorXd(0);
+// Returns the scores of a batch of candidates of wrap_ucv_diag_optim() (is_diagonal = true) or wrap_ucv_optim()
+// (is_diagonal = false). All the valid candidates are evaluated in a single call to the UCVScorer.
+VectorXd ucv_optim_batch(const std::vector<VectorXd>& candidates, const UCVOptimInfo& optim_info, bool is_diagonal) {
+    VectorXd scores = VectorXd::Constant(candidates.size(), optim_info.start_score + 10e-8);
+
+    std::vector<int> indices;
+    std::vector<VectorXd> diagonal_bandwidths;
+    std::vector<MatrixXd> bandwidths;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (is_diagonal) {
+            auto det_sqrt = candidates[i].prod();
+            if (!valid_determinant(det_sqrt * det_sqrt, optim_info)) continue;
+            diagonal_bandwidths.push_back(candidates[i].array().square().matrix());
+        } else {
+            auto sqrt = util::invvech_triangular(candidates[i]);
+            if (!valid_determinant(std::exp(2 * sqrt.diagonal().array().log().sum()), optim_info)) continue;
+            bandwidths.push_back(sqrt * sqrt.transpose());
+        }
 
-    NormalReferenceRule nr;
+        indices.push_back(i);
+    }
 
-    auto normal_bandwidth = nr.diag_bandwidth(df, variables);
+    if (indices.empty()) return scores;
 
-    UCVScorer ucv_scorer(df, variables);
-    auto start_score = ucv_scorer.score_unconstrained(normal_bandwidth);
-    auto start_determinant = normal_bandwidth.prod();
+    auto valid_scores = is_diagonal ? optim_info.ucv_scorer.score_diagonal_batch(diagonal_bandwidths)
+                                    : optim_info.ucv_scorer.score_unconstrained_batch(bandwidths);
 
-    UCVOptimInfo optim_info{/*.ucv_scorer = */ ucv_scorer,
-                            /*.start_score = */ start_score,
-                            /*.start_determinant = */ start_determinant};
+    for (size_t i = 0; i < indices.size(); ++i) {
+        // Avoid scores with too much difference.
+        if (std::abs(valid_scores(i)) <= 1e3 * std::abs(optim_info.start_score)) scores(indices[i]) = valid_scores(i);
+    }
+
+    return scores;
+}
+
+// The relative size of the initial step of the optimizers. A warm start is expected to be close to the optimum, so it
+// uses a smaller step.
+double initial_step_ratio(bool warm) { return warm ? 0.05 : 0.25; }
 
-    auto start_bandwidth = normal_bandwidth.cwiseSqrt().eval();
+VectorXd initial_step(const VectorXd& x, bool warm) {
+    auto ratio = initial_step_ratio(warm);
+    return (ratio * x.cwiseAbs()).cwiseMax(0.1 * ratio * x.cwiseAbs().maxCoeff());
+}
 
-    nlopt::opt opt(nlopt::LN_NELDERMEAD, start_bandwidth.rows());
-    opt.set_min_objective(wrap_ucv_diag_optim, &optim_info);
+// Minimizes the UCV with a multi-start compass search. First, the start point is scaled by different factors and the
+// best one is selected. Then, the 2n neighbors of the current point at the current step size are evaluated in a batch:
+// the current point moves to the best neighbor if it improves the score, or the step size is halved otherwise. A warm
+// start is not scaled.
+VectorXd ucv_pattern_search(const VectorXd& start, const UCVOptimInfo& optim_info, bool is_diagonal, bool warm) {
+    constexpr double xtol_rel = 1e-4;
+    constexpr int max_iterations = 1000;
+
+    std::vector<VectorXd> candidates;
+    if (warm) {
+        candidates.push_back(start);
+    } else {
+        for (auto scale : {0.5, 0.625, 0.75, 0.875, 1., 1.125, 1.25, 1.5}) {
+            candidates.push_back(scale * start);
+        }
+    }
+
+    auto scores = ucv_optim_batch(candidates, optim_info, is_diagonal);
+    Eigen::Index best;
+    double best_score = scores.minCoeff(&best);
+    VectorXd x = candidates[best];
+
+    auto max_abs = x.cwiseAbs().maxCoeff();
+    VectorXd step = initial_step(x, warm);
+
+    for (int iter = 0; iter < max_iterations && (step.array() > xtol_rel * max_abs).any(); ++iter) {
+        candidates.clear();
+        for (int i = 0; i < x.rows(); ++i) {
+            for (auto sign : {1., -1.}) {
+                VectorXd neighbor = x;
+                neighbor(i) += sign * step(i);
+                candidates.push_back(std::move(neighbor));
+            }
+        }
+
+        scores = ucv_optim_batch(candidates, optim_info, is_diagonal);
+        auto min_score = scores.minCoeff(&best);
+        if (min_score < best_score) {
+            best_score = min_score;
+            x = candidates[best];
+            max_abs = x.cwiseAbs().maxCoeff();
+        } else {
+            step *= 0.5;
+        }
+    }
+
+    return x;
+}
+
+// Minimizes the UCV with Nelder-Mead from start.
+VectorXd ucv_nelder_mead(const VectorXd& start, UCVOptimInfo& optim_info, bool is_diagonal, bool warm) {
+    nlopt::opt opt(nlopt::LN_NELDERMEAD, start.rows());
+    opt.set_min_objective(is_diagonal ? wrap_ucv_diag_optim : wrap_ucv_optim, &optim_info);
     opt.set_ftol_rel(1e-4);
     opt.set_xtol_rel(1e-4);
-    std::vector<double> x(start_bandwidth.rows());
-    std::copy(start_bandwidth.data(), start_bandwidth.data() + start_bandwidth.rows(), x.data());
-    double minf;
+    std::vector<double> x(start.data(), start.data() + start.rows());
+
+    if (warm) {
+        auto step = initial_step(start, warm);
+        opt.set_initial_step(std::vector<double>(step.data(), step.data() + step.rows()));
+    }
 
+    double minf;
     try {
         opt.optimize(x, minf);
     } catch (std::exception& e) {
         throw std::invalid_argument(std::string("Failed optimizing bandwidth: ") + e.what());
     }
 
-    std::copy(x.data(), x.data() + x.size(), start_bandwidth.data());
+    return Eigen::Map<VectorXd>(x.data(), x.size());
+}
+
+std::optional<VectorXd> UCV::warm_solution(bool diagonal, const std::vector<std::string>& variables) const {
+    std::lock_guard<std::mutex> lock(m_warm_mutex);
+    auto it = m_warm_solutions.find(WarmKey{diagonal, variables});
+    if (it == m_warm_solutions.end()) return std::nullopt;
+    return it->second;
+}
+
+void UCV::store_warm_solution(bool diagonal, const std::vector<std::string>& variables, const VectorXd& x) const {
+    std::lock_guard<std::mutex> lock(m_warm_mutex);
+    m_warm_solutions[WarmKey{diagonal, variables}] = x;
+}
+
+// Replaces start with the warm solution if its UCV is lower. Returns true if start was replaced.
+bool select_warm_start(const std::optional<VectorXd>& warm,
+                       VectorXd& start,
+                       const UCVOptimInfo& optim_info,
+                       bool is_diagonal) {
+    if (!warm || warm->rows() != start.rows()) return false;
+
+    auto scores = ucv_optim_batch({start, *warm}, optim_info, is_diagonal);
+    if (scores(1) >= scores(0)) return false;
+
+    start = *warm;
+    return true;
+}
+
+VectorXd UCV::diag_bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const {
+    if (variables.empty()) return VectorXd(0);
+
+    NormalReferenceRule nr;
+
+    auto normal_bandwidth = nr.diag_bandwidth(df, variables);
+
+    UCVScorer ucv_scorer(df, variables, m_binned_grid_size);
+    auto start_score = (m_pattern_search || m_binned_grid_size > 0) ? ucv_scorer.score_diagonal(normal_bandwidth)
+                                                                    : ucv_scorer.score_unconstrained(normal_bandwidth);
+    auto start_determinant = normal_bandwidth.prod();
+
+    UCVOptimInfo optim_info{/*.ucv_scorer = */ ucv_scorer,
+                            /*.start_score = */ start_score,
+                            /*.start_determinant = */ start_determinant};
 
-    return start_bandwidth.array().square().matrix();
+    VectorXd start_bandwidth = normal_bandwidth.cwiseSqrt();
+    auto warm = m_warm_start && select_warm_start(warm_solution(true, variables), start_bandwidth, optim_info, true);
+
+    auto x = m_pattern_search ? ucv_pattern_search(start_bandwidth, optim_info, true, warm)
+                              : ucv_nelder_mead(start_bandwidth, optim_info, true, warm);
+    if (m_warm_start) store_warm_solution(true, variables, x);
+
+    return x.array().square().matrix();
 }
 
 MatrixXd UCV::bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const {
@@ -492,7 +807,8 @@ MatrixXd UCV::bandwidth(const DataFrame& df, const std::vector<std::string>& var
 
     auto normal_bandwidth = nr.bandwidth(df, variables);
 
-    UCVScorer ucv_scorer(df, variables);
+    // The unconstrained bandwidth of more than one variable is not diagonal, so it cannot be binned.
+    UCVScorer ucv_scorer(df, variables, (variables.size() == 1) ? m_binned_grid_size : 0);
     auto start_score = ucv_scorer.score_unconstrained(normal_bandwidth);
     auto start_determinant = normal_bandwidth.determinant();
     UCVOptimInfo optim_info{/*.ucv_scorer = */ ucv_scorer,
@@ -500,25 +816,14 @@ MatrixXd UCV::bandwidth(const DataFrame& df, const std::vector<std::string>& var
                             /*.start_determinant = */ start_determinant};
 
     LLT<Eigen::Ref<MatrixXd>> start_sqrt(normal_bandwidth);
-    auto start_vech = util::vech(start_sqrt.matrixL());
-
-    nlopt::opt opt(nlopt::LN_NELDERMEAD, start_vech.rows());
-    opt.set_min_objective(wrap_ucv_optim, &optim_info);
-    opt.set_ftol_rel(1e-4);
-    opt.set_xtol_rel(1e-4);
-    std::vector<double> x(start_vech.rows());
-    std::copy(start_vech.data(), start_vech.data() + start_vech.rows(), x.data());
-    double minf;
-
-    try {
-        opt.optimize(x, minf);
-    } catch (std::exception& e) {
-        throw std::invalid_argument(std::string("Failed optimizing bandwidth: ") + e.what());
-    }
+    VectorXd start_vech = util::vech(start_sqrt.matrixL());
+    auto warm = m_warm_start && select_warm_start(warm_solution(false, variables), start_vech, optim_info, false);
 
-    std::copy(x.data(), x.data() + x.size(), start_vech.data());
+    auto x = m_pattern_search ? ucv_pattern_search(start_vech, optim_info, false, warm)
+                              : ucv_nelder_mead(start_vech, optim_info, false, warm);
+    if (m_warm_start) store_warm_solution(false, variables, x);
 
-    auto sqrt = util::invvech_triangular(start_vech);
+    auto sqrt = util::invvech_triangular(x);
     auto H = sqrt * sqrt.transpose();
 
     return H;
@@ -1,9 +1,13 @@
 #ifndef PYBNESIAN_KDE_UCV_HPP
 #define PYBNESIAN_KDE_UCV_HPP
 
+#include <map>
+#include <mutex>
+#include <optional>
 #include <dataset/dataset.hpp>
 #include <opencl/opencl_config.hpp>
 #include <kde/BandwidthSelector.hpp>
+#include <kde/BinnedGrid.hpp>
 
 using dataset::DataFrame;
 
@@ -11,16 +15,33 @@ namespace kde {
 
 class UCVScorer {
 public:
-    UCVScorer(const DataFrame& df, const std::vector<std::string>& variables)
+    // If binned_grid_size > 0, the scores of diagonal bandwidths are approximated in the CPU by binning the training
+    // data in a grid of binned_grid_size points per variable (see BinnedGrid). The binned UCVScorer does not score
+    // the bandwidth matrices with non-zero off-diagonal elements.
+    UCVScorer(const DataFrame& df, const std::vector<std::string>& variables, int binned_grid_size = 0)
         : m_training_type(df.same_type(variables)),
-          m_training(_copy_training_data(df, variables)),
+          m_binned(_binned_grid(df, variables, binned_grid_size)),
+          m_training(m_binned ? cl::Buffer() : _copy_training_data(df, variables)),
           N(df.valid_rows(variables)),
           d(variables.size()) {}
 
+    int binned_grid_size() const { return m_binned ? m_binned->grid_size() : 0; }
+
     double score_diagonal(const VectorXd& diagonal_bandwidth) const;
     double score_unconstrained(const MatrixXd& bandwidth) const;
 
+    // Returns the score of each bandwidth. All the bandwidths are evaluated by the same kernel launches, so the pairs
+    // of training instances are read once for the whole batch.
+    VectorXd score_diagonal_batch(const std::vector<VectorXd>& diagonal_bandwidths) const;
+    VectorXd score_unconstrained_batch(const std::vector<MatrixXd>& bandwidths) const;
+
 private:
+    double score_binned(const VectorXd& diagonal_bandwidth) const;
+
+    // inv_choleskys contains the inverse of the Cholesky factor of each bandwidth and lognorm_H the log of the
+    // normalization constant of its Gaussian kernel.
+    template <typename ArrowType>
+    VectorXd score_batch_impl(const std::vector<MatrixXd>& inv_choleskys, const VectorXd& lognorm_H) const;
     template <typename ArrowType>
     double score_diagonal_impl(const Matrix<typename ArrowType::c_type, Dynamic, 1>& diagonal_sqrt_bandwidth) const;
     template <typename ArrowType, typename KDEType>
@@ -37,8 +58,12 @@ private:
     template <typename ArrowType, bool contains_null>
     cl::Buffer _copy_training_data(const DataFrame& df, const std::vector<std::string>& variables) const;
     cl::Buffer _copy_training_data(const DataFrame& df, const std::vector<std::string>& variables) const;
+    std::shared_ptr<BinnedGrid> _binned_grid(const DataFrame& df,
+                                             const std::vector<std::string>& variables,
+                                             int grid_size) const;
 
     std::shared_ptr<arrow::DataType> m_training_type;
+    std::shared_ptr<BinnedGrid> m_binned;
     cl::Buffer m_training;
     size_t N;
     size_t d;
@@ -46,13 +71,63 @@ private:
 
 class UCV : public BandwidthSelector {
 public:
+    // If pattern_search is true, the bandwidth is optimized with a multi-start compass search that evaluates the
+    // candidate bandwidths of each iteration in a batch (see UCVScorer::score_unconstrained_batch()). Otherwise, it is
+    // optimized with Nelder-Mead starting from the NormalReferenceRule bandwidth.
+    //
+    // If binned_grid_size > 0, the UCV of the diagonal bandwidths (diag_bandwidth() and the bandwidth() of a single
+    // variable) is approximated by a binned UCVScorer with binned_grid_size points per variable.
+    //
+    // If warm_start is true, the last bandwidth optimized for each set of variables is kept, and the next optimization
+    // of the same variables starts from it (with a smaller initial step) if its UCV is lower than the UCV of the
+    // NormalReferenceRule bandwidth. This speeds up the related fits, such as the folds of a cross-validated score.
+    UCV(bool pattern_search = false, int binned_grid_size = 0, bool warm_start = false)
+        : m_pattern_search(pattern_search),
+          m_binned_grid_size(binned_grid_size),
+          m_warm_start(warm_start),
+          m_warm_mutex(),
+          m_warm_solutions() {
+        if (binned_grid_size < 0)
+            throw std::invalid_argument("The grid size of the binned approximation must be non-negative.");
+    }
+
     VectorXd diag_bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const override;
     MatrixXd bandwidth(const DataFrame& df, const std::vector<std::string>& variables) const override;
 
     std::string ToString() const override { return "UCV"; }
 
-    py::tuple __getstate__() const override { return py::make_tuple(); }
-    static std::shared_ptr<UCV> __setstate__(py::tuple&) { return std::make_shared<UCV>(); }
+    bool pattern_search() const { return m_pattern_search; }
+    int binned_grid_size() const { return m_binned_grid_size; }
+    bool warm_start() const { return m_warm_start; }
+    // Removes the bandwidths kept for the warm starts.
+    void clear_warm_start() {
+        std::lock_guard<std::mutex> lock(m_warm_mutex);
+        m_warm_solutions.clear();
+    }
+
+    py::tuple __getstate__() const override {
+        return py::make_tuple(m_pattern_search, m_binned_grid_size, m_warm_start);
+    }
+    static std::shared_ptr<UCV> __setstate__(py::tuple& t) {
+        // The UCV objects pickled before the pattern search was added have an empty state.
+        if (t.size() == 0) return std::make_shared<UCV>();
+        auto binned_grid_size = (t.size() > 1) ? t[1].cast<int>() : 0;
+        auto warm_start = (t.size() > 2) ? t[2].cast<bool>() : false;
+        return std::make_shared<UCV>(t[0].cast<bool>(), binned_grid_size, warm_start);
+    }
+
+private:
+    // The warm solutions are stored in the parametrization of the optimizer: the square root of the diagonal bandwidth
+    // (diagonal = true) or the vech of the Cholesky factor of the bandwidth.
+    using WarmKey = std::pair<bool, std::vector<std::string>>;
+    std::optional<VectorXd> warm_solution(bool diagonal, const std::vector<std::string>& variables) const;
+    void store_warm_solution(bool diagonal, const std::vector<std::string>& variables, const VectorXd& x) const;
+
+    bool m_pattern_search;
+    int m_binned_grid_size;
+    bool m_warm_start;
+    mutable std::mutex m_warm_mutex;
+    mutable std::map<WarmKey, VectorXd> m_warm_solutions;
 };
 
 }  // namespace kde
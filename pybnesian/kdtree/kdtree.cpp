@@ -2,28 +2,59 @@
 
 namespace kdtree {
 
-std::unique_ptr<KDTreeNode> KDTree::build_kdtree(const DataFrame& df, int leafsize) {
+namespace {
+
+template <typename ArrowType>
+void build_nodes(const DataFrame& df,
+                 int leafsize,
+                 std::vector<size_t>& indices,
+                 const EigenVector<ArrowType>& maxes,
+                 const EigenVector<ArrowType>& mines,
+                 int num_threads,
+                 std::vector<KDTreeNode>& nodes) {
+    if (num_threads > 1 && df->num_rows() >= KDTree::parallel_build_min_points) {
+        build_kdtree_parallel<ArrowType>(df, leafsize, indices, maxes, mines, num_threads, nodes);
+    } else {
+        build_kdtree<ArrowType>(df, leafsize, indices, 0, indices.size(), -1, true, maxes, mines, nodes);
+    }
+}
+
+}  // namespace
+
+void KDTree::build_kdtree(const DataFrame& df, int leafsize, int num_threads) {
+    m_nodes.clear();
+    num_threads = util::effective_num_threads(num_threads);
+
     switch (df.same_type()->id()) {
         case Type::DOUBLE: {
-            return kdtree::build_kdtree<arrow::DoubleType>(
-                df, leafsize, m_indices.begin(), m_indices.end(), -1, true, m_maxes, m_mines);
+            build_nodes<arrow::DoubleType>(df, leafsize, m_indices, m_maxes, m_mines, num_threads, m_nodes);
+            fill_points<arrow::DoubleType>(m_points_double);
+            m_points_float.resize(0, 0);
+            break;
         }
         case Type::FLOAT: {
-            return kdtree::build_kdtree<arrow::FloatType>(df,
-                                                          leafsize,
-                                                          m_indices.begin(),
-                                                          m_indices.end(),
-                                                          -1,
-                                                          true,
-                                                          m_maxes.template cast<float>(),
-                                                          m_mines.template cast<float>());
+            build_nodes<arrow::FloatType>(df,
+                                          leafsize,
+                                          m_indices,
+                                          m_maxes.template cast<float>(),
+                                          m_mines.template cast<float>(),
+                                          num_threads,
+                                          m_nodes);
+            fill_points<arrow::FloatType>(m_points_float);
+            m_points_double.resize(0, 0);
+            break;
         }
         default:
             throw std::invalid_argument("Wrong data type to apply KDTree.");
     }
+
+    m_max_leaf_size = 0;
+    for (const auto& node : m_nodes) {
+        if (node.is_leaf()) m_max_leaf_size = std::max(m_max_leaf_size, node.end - node.begin);
+    }
 }
 
-void KDTree::fit(DataFrame df, int leafsize) {
+void KDTree::fit(DataFrame df, int leafsize, int num_threads) {
     m_df = df;
     m_column_names = df.column_names();
     m_datatype = df.same_type();
@@ -52,136 +83,83 @@ void KDTree::fit(DataFrame df, int leafsize) {
             throw std::invalid_argument("Wrong data type to apply KDTree.");
     }
 
-    m_root = build_kdtree(df, leafsize);
+    build_kdtree(df, leafsize, num_threads);
 }
 
-std::vector<std::pair<VectorXd, VectorXi>> KDTree::query(const DataFrame& test_df, int k, double p) const {
+void KDTree::check_query(const DataFrame& test_df, int k, double eps) const {
     if (k >= m_df->num_rows()) {
         throw std::invalid_argument("\"k\" value equal or greater to training data size.");
     }
 
+    if (eps < 0) {
+        throw std::invalid_argument("\"eps\" must be a non-negative number.");
+    }
+
     test_df.raise_has_columns(m_column_names);
 
     if (test_df.same_type(m_column_names)->id() != m_datatype->id()) {
         throw std::invalid_argument("Test data type is different from training data types.");
     }
+}
+
+std::vector<std::pair<VectorXd, VectorXi>> KDTree::query(const DataFrame& test_df,
+                                                         int k,
+                                                         double p,
+                                                         double eps,
+                                                         int num_threads) const {
+    auto [distances, indices] = query_batch(test_df, k, p, eps, num_threads);
 
     std::vector<std::pair<VectorXd, VectorXi>> res;
     res.reserve(test_df->num_rows());
+    for (int i = 0; i < test_df->num_rows(); ++i) {
+        res.push_back(std::make_pair(distances.col(i), indices.col(i)));
+    }
+
+    return res;
+}
+
+std::pair<MatrixXd, MatrixXi> KDTree::query_batch(const DataFrame& test_df,
+                                                  int k,
+                                                  double p,
+                                                  double eps,
+                                                  int num_threads) const {
+    check_query(test_df, k, eps);
+
+    MatrixXd distances(k, test_df->num_rows());
+    MatrixXi indices(k, test_df->num_rows());
 
     switch (m_datatype->id()) {
-        case Type::DOUBLE: {
-            auto train_downcast = m_df.downcast_vector<arrow::DoubleType>(m_column_names);
-            auto test_downcast = test_df.downcast_vector<arrow::DoubleType>(m_column_names);
-
-            if (p == 1) {
-                ManhattanDistance<arrow::DoubleType> dist(train_downcast, test_downcast);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::DoubleType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            } else if (p == 2) {
-                EuclideanDistance<arrow::DoubleType> dist(train_downcast, test_downcast);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::DoubleType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            } else if (std::isinf(p)) {
-                ChebyshevDistance<arrow::DoubleType> dist(train_downcast, test_downcast);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::DoubleType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            } else {
-                MinkowskiP<arrow::DoubleType> dist(train_downcast, test_downcast, p);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::DoubleType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            }
+        case Type::DOUBLE:
+            query_points<arrow::DoubleType>(test_df, k, p, eps, num_threads, distances, indices);
             break;
-        }
-        case Type::FLOAT: {
-            auto train_downcast = m_df.downcast_vector<arrow::FloatType>(m_column_names);
-            auto test_downcast = test_df.downcast_vector<arrow::FloatType>(m_column_names);
-
-            if (p == 1) {
-                ManhattanDistance<arrow::FloatType> dist(train_downcast, test_downcast);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::FloatType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            } else if (p == 2) {
-                EuclideanDistance<arrow::FloatType> dist(train_downcast, test_downcast);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::FloatType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            } else if (std::isinf(p)) {
-                ChebyshevDistance<arrow::FloatType> dist(train_downcast, test_downcast);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::FloatType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            } else {
-                MinkowskiP<arrow::FloatType> dist(train_downcast, test_downcast, p);
-                for (int i = 0; i < test_df->num_rows(); ++i) {
-                    auto t = query_instance<arrow::FloatType>(test_downcast, i, k, dist);
-                    res.push_back(t);
-                }
-            }
+        case Type::FLOAT:
+            query_points<arrow::FloatType>(test_df, k, p, eps, num_threads, distances, indices);
             break;
-        }
         default:
             throw std::invalid_argument("Wrong data type to apply KDTree.");
     }
 
-    return res;
+    return std::make_pair(std::move(distances), std::move(indices));
 }
 
 std::tuple<VectorXi, VectorXi, VectorXi> KDTree::count_ball_subspaces(const DataFrame& test_df,
                                                                       const Array_ptr& x_data,
                                                                       const Array_ptr& y_data,
-                                                                      const VectorXd& eps) const {
+                                                                      const VectorXd& eps,
+                                                                      int num_threads) const {
     VectorXi count_xz(test_df->num_rows());
     VectorXi count_yz(test_df->num_rows());
     VectorXi count_z(test_df->num_rows());
 
     switch (m_datatype->id()) {
-        case Type::DOUBLE: {
-            auto train = m_df.downcast_vector<arrow::DoubleType>();
-            auto test = test_df.downcast_vector<arrow::DoubleType>();
-            ChebyshevDistance<arrow::DoubleType> dist(train, test);
-
-            auto x = std::static_pointer_cast<arrow::DoubleArray>(x_data)->raw_values();
-            auto y = std::static_pointer_cast<arrow::DoubleArray>(y_data)->raw_values();
-
-            for (int i = 0; i < test_df->num_rows(); ++i) {
-                auto c = count_ball_subspaces_instance<arrow::DoubleType>(test, x, y, i, dist, eps(i));
-
-                count_xz(i) = std::get<0>(c);
-                count_yz(i) = std::get<1>(c);
-                count_z(i) = std::get<2>(c);
-            }
+        case Type::DOUBLE:
+            count_ball_subspaces_points<arrow::DoubleType>(
+                test_df, x_data, y_data, eps, num_threads, count_xz, count_yz, count_z);
             break;
-        }
-        case Type::FLOAT: {
-            auto train = m_df.downcast_vector<arrow::FloatType>();
-            auto test = test_df.downcast_vector<arrow::FloatType>();
-            ChebyshevDistance<arrow::FloatType> dist(train, test);
-
-            auto x = std::static_pointer_cast<arrow::FloatArray>(x_data)->raw_values();
-            auto y = std::static_pointer_cast<arrow::FloatArray>(y_data)->raw_values();
-
-            for (int i = 0; i < test_df->num_rows(); ++i) {
-                auto c = count_ball_subspaces_instance<arrow::FloatType>(test, x, y, i, dist, eps(i));
-
-                count_xz(i) = std::get<0>(c);
-                count_yz(i) = std::get<1>(c);
-                count_z(i) = std::get<2>(c);
-            }
+        case Type::FLOAT:
+            count_ball_subspaces_points<arrow::FloatType>(
+                test_df, x_data, y_data, eps, num_threads, count_xz, count_yz, count_z);
             break;
-        }
         default:
             throw std::invalid_argument("Wrong data type to apply KDTree.");
     }
@@ -2,10 +2,15 @@
 #define PYBNESIAN_KDTREE_KDTREE_HPP
 
 #include <dataset/dataset.hpp>
-#include <queue>
+#include <util/memory_usage.hpp>
+#include <util/parallel.hpp>
+#include <util/simd.hpp>
+#include <algorithm>
+#include <numeric>
+#include <optional>
 
 using dataset::DataFrame;
-using Eigen::Matrix, Eigen::Dynamic, Eigen::VectorXd, Eigen::VectorXi;
+using Eigen::Matrix, Eigen::Dynamic, Eigen::MatrixXd, Eigen::MatrixXi, Eigen::VectorXd, Eigen::VectorXi;
 
 template <typename ArrowType>
 using EigenVector = Matrix<typename ArrowType::c_type, Dynamic, 1>;
@@ -18,26 +23,42 @@ using DowncastArray_vector = std::vector<DowncastArray_ptr<ArrowType>>;
 
 namespace kdtree {
 
+// The points of a KDTree (or a set of test points): one row per point and one column per dimension. The matrix is
+// column-major, so the values of a dimension are contiguous for consecutive points.
+template <typename ArrowType>
+using PointMatrix = Matrix<typename ArrowType::c_type, Dynamic, Dynamic>;
+
+template <typename ArrowType>
+using DistanceArray = Eigen::Array<typename ArrowType::c_type, Dynamic, 1>;
+
+// The distances compute the (non-normalized) distance from a point to each row of a block of points. The loops run
+// over the contiguous values of each dimension, so they are vectorized.
+//
+// The blocks of a PointMatrix are computed with the kernels of util::simd for the instruction set of the CPU.
+template <typename PointsType>
+inline constexpr bool is_contiguous_columns = (PointsType::Flags & Eigen::DirectAccessBit) && !PointsType::IsRowMajor &&
+                                              PointsType::InnerStrideAtCompileTime == 1;
+
 template <typename ArrowType>
 class EuclideanDistance {
 public:
     using CType = typename ArrowType::c_type;
-    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
 
-    EuclideanDistance(const std::vector<std::shared_ptr<ArrayType>>& train_data,
-                      const std::vector<std::shared_ptr<ArrayType>>& test_data)
-        : m_train_data(train_data), m_test_data(test_data) {}
-
-    inline CType distance(size_t train_index, size_t test_index) const {
-        CType d = 0;
-        for (auto it_train = m_train_data.begin(), it_train_end = m_train_data.end(), it_test = m_test_data.begin();
-             it_train != it_train_end;
-             ++it_train, ++it_test) {
-            CType t = ((*it_test)->Value(test_index) - (*it_train)->Value(train_index));
-            d += distance_p(t);
+    template <typename PointsType>
+    inline void distances(const Eigen::MatrixBase<PointsType>& points,
+                          const EigenVector<ArrowType>& point,
+                          DistanceArray<ArrowType>& d) const {
+        auto n = points.rows();
+        d.head(n).setZero();
+        if constexpr (is_contiguous_columns<PointsType>) {
+            for (auto j = 0; j < points.cols(); ++j) {
+                util::simd::add_squared_differences(points.derived().col(j).data(), point(j), n, d.data());
+            }
+        } else {
+            for (auto j = 0; j < points.cols(); ++j) {
+                d.head(n) += (points.col(j).array() - point(j)).square();
+            }
         }
-
-        return d;
     }
 
     inline CType distance_p(CType difference) const { return difference * difference; }
@@ -47,32 +68,28 @@ public:
     inline CType update_component_distance(CType distance, CType old_component, CType new_component) const {
         return distance - old_component + new_component;
     }
-
-private:
-    const std::vector<std::shared_ptr<ArrayType>>& m_train_data;
-    const std::vector<std::shared_ptr<ArrayType>>& m_test_data;
 };
 
 template <typename ArrowType>
 class ManhattanDistance {
 public:
     using CType = typename ArrowType::c_type;
-    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
 
-    ManhattanDistance(const std::vector<std::shared_ptr<ArrayType>>& train_data,
-                      const std::vector<std::shared_ptr<ArrayType>>& test_data)
-        : m_train_data(train_data), m_test_data(test_data) {}
-
-    inline CType distance(size_t train_index, size_t test_index) const {
-        CType d = 0;
-        for (auto it_train = m_train_data.begin(), it_train_end = m_train_data.end(), it_test = m_test_data.begin();
-             it_train != it_train_end;
-             ++it_train, ++it_test) {
-            CType t = ((*it_test)->Value(test_index) - (*it_train)->Value(train_index));
-            d += distance_p(t);
+    template <typename PointsType>
+    inline void distances(const Eigen::MatrixBase<PointsType>& points,
+                          const EigenVector<ArrowType>& point,
+                          DistanceArray<ArrowType>& d) const {
+        auto n = points.rows();
+        d.head(n).setZero();
+        if constexpr (is_contiguous_columns<PointsType>) {
+            for (auto j = 0; j < points.cols(); ++j) {
+                util::simd::add_abs_differences(points.derived().col(j).data(), point(j), n, d.data());
+            }
+        } else {
+            for (auto j = 0; j < points.cols(); ++j) {
+                d.head(n) += (points.col(j).array() - point(j)).abs();
+            }
         }
-
-        return d;
     }
 
     inline CType distance_p(CType difference) const { return std::abs(difference); }
@@ -82,32 +99,22 @@ public:
     inline CType update_component_distance(CType distance, CType old_component, CType new_component) const {
         return distance - old_component + new_component;
     }
-
-private:
-    const std::vector<std::shared_ptr<ArrayType>>& m_train_data;
-    const std::vector<std::shared_ptr<ArrayType>>& m_test_data;
 };
 
 template <typename ArrowType>
 class ChebyshevDistance {
 public:
     using CType = typename ArrowType::c_type;
-    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
 
-    ChebyshevDistance(const std::vector<std::shared_ptr<ArrayType>>& train_data,
-                      const std::vector<std::shared_ptr<ArrayType>>& test_data)
-        : m_train_data(train_data), m_test_data(test_data) {}
-
-    inline CType distance(size_t train_index, size_t test_index) const {
-        CType d = 0;
-        for (auto it_train = m_train_data.begin(), it_train_end = m_train_data.end(), it_test = m_test_data.begin();
-             it_train != it_train_end;
-             ++it_train, ++it_test) {
-            CType t = ((*it_test)->Value(test_index) - (*it_train)->Value(train_index));
-            d = std::max(d, abs(t));
+    template <typename PointsType>
+    inline void distances(const Eigen::MatrixBase<PointsType>& points,
+                          const EigenVector<ArrowType>& point,
+                          DistanceArray<ArrowType>& d) const {
+        auto n = points.rows();
+        d.head(n).setZero();
+        for (auto j = 0; j < points.cols(); ++j) {
+            d.head(n) = d.head(n).max((points.col(j).array() - point(j)).abs());
         }
-
-        return d;
     }
 
     inline CType distance_p(CType difference) const { return std::abs(difference); }
@@ -117,33 +124,24 @@ public:
     inline CType update_component_distance(CType distance, CType, CType new_component) const {
         return std::max(distance, new_component);
     }
-
-private:
-    const std::vector<std::shared_ptr<ArrayType>>& m_train_data;
-    const std::vector<std::shared_ptr<ArrayType>>& m_test_data;
 };
 
 template <typename ArrowType>
 class MinkowskiP {
 public:
     using CType = typename ArrowType::c_type;
-    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
 
-    MinkowskiP(const std::vector<std::shared_ptr<ArrayType>>& train_data,
-               const std::vector<std::shared_ptr<ArrayType>>& test_data,
-               double p)
-        : m_train_data(train_data), m_test_data(test_data), m_p(p) {}
-
-    inline CType distance(size_t train_index, size_t test_index) const {
-        CType d = 0;
-        for (auto it_train = m_train_data.begin(), it_train_end = m_train_data.end(), it_test = m_test_data.begin();
-             it_train != it_train_end;
-             ++it_train, ++it_test) {
-            CType t = ((*it_test)->Value(test_index) - (*it_train)->Value(train_index));
-            d += distance_p(t);
-        }
+    MinkowskiP(double p) : m_p(p) {}
 
-        return d;
+    template <typename PointsType>
+    inline void distances(const Eigen::MatrixBase<PointsType>& points,
+                          const EigenVector<ArrowType>& point,
+                          DistanceArray<ArrowType>& d) const {
+        auto n = points.rows();
+        d.head(n).setZero();
+        for (auto j = 0; j < points.cols(); ++j) {
+            d.head(n) += (points.col(j).array() - point(j)).abs().pow(static_cast<CType>(m_p));
+        }
     }
 
     inline CType distance_p(CType difference) const { return std::pow(std::abs(difference), static_cast<CType>(m_p)); }
@@ -155,8 +153,6 @@ public:
     }
 
 private:
-    const std::vector<std::shared_ptr<ArrayType>>& m_train_data;
-    const std::vector<std::shared_ptr<ArrayType>>& m_test_data;
     double m_p;
 };
 
@@ -177,26 +173,27 @@ struct NeighborComparator {
     inline bool operator()(const Neighbor<ArrowType>& a, const Neighbor<ArrowType>& b) { return a.first < b.first; }
 };
 
-template <typename ArrowType>
-using NeighborQueue =
-    std::priority_queue<Neighbor<ArrowType>, std::vector<Neighbor<ArrowType>>, NeighborComparator<ArrowType>>;
-
+// The nodes of a KDTree are stored in an array in depth-first order, so the left child of a node is always the next
+// node. The points of each node are the contiguous range [begin, end) of the reordered points of the tree.
 struct KDTreeNode {
-    size_t split_id;
+    size_t begin;
+    size_t end;
+    // Split dimension of the node, or -1 if the node is a leaf.
+    int split_id;
     double split_value;
-    KDTreeNode* parent;
-    std::unique_ptr<KDTreeNode> left;
-    std::unique_ptr<KDTreeNode> right;
-    bool is_leaf;
-    std::vector<size_t>::iterator indices_begin;
-    std::vector<size_t>::iterator indices_end;
+    // Position of the right child in the node array.
+    size_t right;
+
+    bool is_leaf() const { return split_id == -1; }
 };
 
 template <typename ArrowType>
 struct QueryNode {
-    KDTreeNode* node;
+    size_t node;
+    bool is_leaf;
     typename ArrowType::c_type min_distance;
-    Matrix<typename ArrowType::c_type, Dynamic, 1> side_distance;
+    // Position of the side distances of the node in QueryWorkspace::side_distances.
+    size_t side_offset;
 };
 
 template <typename ArrowType>
@@ -206,110 +203,223 @@ struct QueryNodeComparator {
         if (d != 0) {
             return d > 0;
         } else {
-            return a.node->is_leaf < b.node->is_leaf;
+            return a.is_leaf < b.is_leaf;
         }
     }
 };
 
+// Buffers of a query, reused across the test points of a batch to avoid allocating on every point.
 template <typename ArrowType>
-using QueryQueue =
-    std::priority_queue<QueryNode<ArrowType>, std::vector<QueryNode<ArrowType>>, QueryNodeComparator<ArrowType>>;
+struct QueryWorkspace {
+    EigenVector<ArrowType> point;
+    std::vector<QueryNode<ArrowType>> query_nodes;
+    std::vector<typename ArrowType::c_type> side_distances;
+    std::vector<Neighbor<ArrowType>> neighbors;
+    DistanceArray<ArrowType> leaf_distances;
+
+    QueryWorkspace(int num_dimensions, size_t max_leaf_size)
+        : point(num_dimensions), query_nodes(), side_distances(), neighbors(), leaf_distances(max_leaf_size) {}
+
+    void clear() {
+        query_nodes.clear();
+        side_distances.clear();
+        neighbors.clear();
+    }
+};
+
+// A subtree whose construction is deferred by build_kdtree(). It stores the arguments of its build_kdtree() call.
+template <typename ArrowType>
+struct KDTreeSubtreeTask {
+    size_t node;
+    size_t begin;
+    size_t end;
+    int updated_index;
+    bool update_left;
+    EigenVector<ArrowType> maxes;
+    EigenVector<ArrowType> mines;
+};
 
+// Builds the nodes of the points indices[begin, end). The indices are reordered, so the points of each node are
+// contiguous in indices. If tasks is not null, the nodes depth levels below the first node are not split: they are left
+// as leaves in nodes and their subtrees are appended to tasks.
 template <typename ArrowType>
-std::unique_ptr<KDTreeNode> build_kdtree(const DataFrame& df,
-                                         int leafsize,
-                                         std::vector<size_t>::iterator indices_begin,
-                                         std::vector<size_t>::iterator indices_end,
-                                         int updated_index,
-                                         bool update_left,
-                                         EigenVector<ArrowType> maxes,
-                                         EigenVector<ArrowType> mines) {
+void build_kdtree(const DataFrame& df,
+                  int leafsize,
+                  std::vector<size_t>& indices,
+                  size_t begin,
+                  size_t end,
+                  int updated_index,
+                  bool update_left,
+                  EigenVector<ArrowType> maxes,
+                  EigenVector<ArrowType> mines,
+                  std::vector<KDTreeNode>& nodes,
+                  std::vector<KDTreeSubtreeTask<ArrowType>>* tasks = nullptr,
+                  int depth = 0) {
     using CType = typename ArrowType::c_type;
 
-    auto n = std::distance(indices_begin, indices_end);
+    auto n = end - begin;
+    auto node_index = nodes.size();
+    nodes.push_back(KDTreeNode{/*.begin = */ begin,
+                               /*.end = */ end,
+                               /*.split_id = */ -1,
+                               /*.split_value = */ 0,
+                               /*.right = */ 0});
 
-    if (n <= leafsize) {
-        auto leaf = std::make_unique<KDTreeNode>();
-        leaf->is_leaf = true;
-        leaf->indices_begin = indices_begin;
-        leaf->indices_end = indices_end;
-        return leaf;
-    } else {
-        if (updated_index != -1) {
-            if (update_left) {
-                maxes(updated_index) = -std::numeric_limits<CType>::infinity();
-                auto array = df.downcast<ArrowType>(updated_index);
-                auto raw_values = array->raw_values();
-
-                for (auto it = indices_begin; it != indices_end; ++it) {
-                    maxes(updated_index) = std::max(maxes(updated_index), raw_values[*it]);
-                }
+    if (n <= static_cast<size_t>(leafsize)) return;
 
-            } else {
-                mines(updated_index) = std::numeric_limits<CType>::infinity();
-                auto array = df.downcast<ArrowType>(updated_index);
-                auto raw_values = array->raw_values();
+    if (tasks && depth == 0) {
+        tasks->push_back(
+            KDTreeSubtreeTask<ArrowType>{node_index, begin, end, updated_index, update_left, maxes, mines});
+        return;
+    }
 
-                for (auto it = indices_begin; it != indices_end; ++it) {
-                    mines(updated_index) = std::min(mines(updated_index), raw_values[*it]);
-                }
+    auto indices_begin = indices.begin() + begin;
+    auto indices_end = indices.begin() + end;
+
+    if (updated_index != -1) {
+        if (update_left) {
+            maxes(updated_index) = -std::numeric_limits<CType>::infinity();
+            auto array = df.downcast<ArrowType>(updated_index);
+            auto raw_values = array->raw_values();
+
+            for (auto it = indices_begin; it != indices_end; ++it) {
+                maxes(updated_index) = std::max(maxes(updated_index), raw_values[*it]);
             }
-        }
 
-        size_t split_id = 0;
-        double spread_size = 0;
-        for (int j = 0; j < df->num_columns(); ++j) {
-            if (maxes(j) - mines(j) > spread_size) {
-                split_id = j;
-                spread_size = maxes(j) - mines(j);
+        } else {
+            mines(updated_index) = std::numeric_limits<CType>::infinity();
+            auto array = df.downcast<ArrowType>(updated_index);
+            auto raw_values = array->raw_values();
+
+            for (auto it = indices_begin; it != indices_end; ++it) {
+                mines(updated_index) = std::min(mines(updated_index), raw_values[*it]);
             }
         }
+    }
 
-        if (mines(split_id) == maxes(split_id)) {
-            auto leaf = std::make_unique<KDTreeNode>();
-            leaf->is_leaf = true;
-            leaf->indices_begin = indices_begin;
-            leaf->indices_end = indices_end;
-            return leaf;
+    size_t split_id = 0;
+    double spread_size = 0;
+    for (int j = 0; j < df->num_columns(); ++j) {
+        if (maxes(j) - mines(j) > spread_size) {
+            split_id = j;
+            spread_size = maxes(j) - mines(j);
         }
+    }
 
-        auto median_id = n / 2;
-        auto mid_iter = indices_begin + median_id;
-
-        auto dwn_split_array = df.downcast<ArrowType>(split_id);
+    if (mines(split_id) == maxes(split_id)) return;
 
-        IndexComparator index_comparator(dwn_split_array->raw_values());
+    auto median_id = n / 2;
+    auto mid_iter = indices_begin + median_id;
 
-        std::nth_element(indices_begin, mid_iter, indices_end, index_comparator);
+    auto dwn_split_array = df.downcast<ArrowType>(split_id);
 
-        auto node = std::make_unique<KDTreeNode>();
+    IndexComparator index_comparator(dwn_split_array->raw_values());
 
-        node->split_id = split_id;
-        node->split_value = static_cast<double>(dwn_split_array->Value(*mid_iter));
-        node->parent = nullptr;
+    std::nth_element(indices_begin, mid_iter, indices_end, index_comparator);
 
-        node->left = build_kdtree<ArrowType>(df, leafsize, indices_begin, mid_iter, split_id, true, maxes, mines);
-        node->left->parent = node.get();
+    nodes[node_index].split_id = split_id;
+    nodes[node_index].split_value = static_cast<double>(dwn_split_array->Value(*mid_iter));
 
-        node->right = build_kdtree<ArrowType>(df, leafsize, mid_iter, indices_end, split_id, false, maxes, mines);
-        node->right->parent = node.get();
+    build_kdtree<ArrowType>(
+        df, leafsize, indices, begin, begin + median_id, split_id, true, maxes, mines, nodes, tasks, depth - 1);
+    nodes[node_index].right = nodes.size();
+    build_kdtree<ArrowType>(
+        df, leafsize, indices, begin + median_id, end, split_id, false, maxes, mines, nodes, tasks, depth - 1);
+}
 
-        node->is_leaf = false;
+// Builds the same nodes as build_kdtree() with num_threads threads. The first levels of the tree are built serially
+// until there are enough subtrees to balance the threads. The subtrees cover disjoint ranges of indices, so they are
+// built in parallel in their own node arrays, and then they are spliced in depth-first order into nodes.
+template <typename ArrowType>
+void build_kdtree_parallel(const DataFrame& df,
+                           int leafsize,
+                           std::vector<size_t>& indices,
+                           EigenVector<ArrowType> maxes,
+                           EigenVector<ArrowType> mines,
+                           int num_threads,
+                           std::vector<KDTreeNode>& nodes) {
+    // Four subtrees per thread, so the threads that build small subtrees take more of them.
+    int depth = 0;
+    while ((1 << depth) < 4 * num_threads) ++depth;
+
+    std::vector<KDTreeNode> top;
+    std::vector<KDTreeSubtreeTask<ArrowType>> tasks;
+    build_kdtree<ArrowType>(df, leafsize, indices, 0, indices.size(), -1, true, maxes, mines, top, &tasks, depth);
+
+    std::vector<std::vector<KDTreeNode>> subtrees(tasks.size());
+    util::parallel_for(0, static_cast<int>(tasks.size()), num_threads, [&](int t, int) {
+        const auto& task = tasks[t];
+        build_kdtree<ArrowType>(df,
+                                leafsize,
+                                indices,
+                                task.begin,
+                                task.end,
+                                task.updated_index,
+                                task.update_left,
+                                task.maxes,
+                                task.mines,
+                                subtrees[t]);
+    });
+
+    // Position of each top node in nodes: the subtree of a task replaces its node.
+    std::vector<size_t> position(top.size());
+    size_t total = 0;
+    for (size_t i = 0, t = 0; i < top.size(); ++i) {
+        position[i] = total;
+        if (t < tasks.size() && tasks[t].node == i) {
+            total += subtrees[t++].size();
+        } else {
+            ++total;
+        }
+    }
 
-        return node;
+    nodes.clear();
+    nodes.reserve(total);
+    for (size_t i = 0, t = 0; i < top.size(); ++i) {
+        if (t < tasks.size() && tasks[t].node == i) {
+            for (auto node : subtrees[t]) {
+                if (!node.is_leaf()) node.right += position[i];
+                nodes.push_back(node);
+            }
+            ++t;
+        } else {
+            auto node = top[i];
+            if (!node.is_leaf()) node.right = position[node.right];
+            nodes.push_back(node);
+        }
     }
 }
 
 class KDTree {
 public:
-    KDTree() : m_df(), m_column_names(), m_datatype(), m_root(), m_indices(), m_maxes(), m_mines() {}
-
-    KDTree(DataFrame df, int leafsize = 16)
+    // Number of consecutive test points processed by a thread at a time.
+    static constexpr int query_block_size = 64;
+    // The trees of less points are always built by one thread.
+    static constexpr int64_t parallel_build_min_points = 1 << 13;
+
+    KDTree()
+        : m_df(),
+          m_column_names(),
+          m_datatype(),
+          m_nodes(),
+          m_indices(),
+          m_points_double(),
+          m_points_float(),
+          m_max_leaf_size(0),
+          m_maxes(),
+          m_mines() {}
+
+    // The tree is built with num_threads threads (0 selects the hardware concurrency). The tree does not depend on
+    // num_threads.
+    KDTree(DataFrame df, int leafsize = 16, int num_threads = 1)
         : m_df(df),
           m_column_names(df.column_names()),
           m_datatype(df.same_type()),
-          m_root(),
+          m_nodes(),
           m_indices(df->num_rows()),
+          m_points_double(),
+          m_points_float(),
+          m_max_leaf_size(0),
           m_maxes(df->num_columns()),
           m_mines(df->num_columns()) {
         std::iota(m_indices.begin(), m_indices.end(), 0);
@@ -334,24 +444,42 @@ public:
                 throw std::invalid_argument("Wrong data type to apply KDTree.");
         }
 
-        m_root = build_kdtree(df, leafsize);
+        build_kdtree(df, leafsize, num_threads);
     }
 
-    void fit(DataFrame df, int leafsize = 16);
-    std::vector<std::pair<VectorXd, VectorXi>> query(const DataFrame& test_df, int k = 1, double p = 2) const;
+    void fit(DataFrame df, int leafsize = 16, int num_threads = 1);
+    // Returns the k nearest neighbors of each row of test_df with the Minkowski distance of order p. If eps > 0, the
+    // search is approximate: the distance to the i-th returned neighbor is at most (1 + eps) times the distance to the
+    // real i-th nearest neighbor. With eps = 0 the search is exact.
+    std::vector<std::pair<VectorXd, VectorXi>> query(const DataFrame& test_df,
+                                                     int k = 1,
+                                                     double p = 2,
+                                                     double eps = 0,
+                                                     int num_threads = 1) const;
+    // The same as query(), but the result is returned as a (k x test_df->num_rows()) matrix of distances and a matrix
+    // of training row indices. The i-th column contains the neighbors of the i-th test row, sorted by distance. The
+    // test rows are split among num_threads threads (0 selects the hardware concurrency).
+    std::pair<MatrixXd, MatrixXi> query_batch(const DataFrame& test_df,
+                                              int k = 1,
+                                              double p = 2,
+                                              double eps = 0,
+                                              int num_threads = 1) const;
+    // Searches the k nearest neighbors of workspace.point. The neighbors are left in workspace.neighbors, as a max-heap
+    // of (non-normalized distance, position in the reordered points).
     template <typename ArrowType, typename DistanceType>
-    std::pair<VectorXd, VectorXi> query_instance(const DowncastArray_vector<ArrowType>& test_downcast,
-                                                 size_t i,
-                                                 int k,
-                                                 const DistanceType& distance) const;
+    void query_instance(QueryWorkspace<ArrowType>& workspace,
+                        int k,
+                        const DistanceType& distance,
+                        double eps = 0) const;
 
     std::tuple<VectorXi, VectorXi, VectorXi> count_ball_subspaces(const DataFrame& test_df,
                                                                   const Array_ptr& x_data,
                                                                   const Array_ptr& y_data,
-                                                                  const VectorXd& eps) const;
+                                                                  const VectorXd& eps,
+                                                                  int num_threads = 1) const;
 
     template <typename ArrowType, typename DistanceType>
-    std::tuple<int, int, int> count_ball_subspaces_instance(const DowncastArray_vector<ArrowType>& test_df,
+    std::tuple<int, int, int> count_ball_subspaces_instance(QueryWorkspace<ArrowType>& workspace,
                                                             const typename ArrowType::c_type* x_data,
                                                             const typename ArrowType::c_type* y_data,
                                                             size_t i,
@@ -360,192 +488,394 @@ public:
 
     const DataFrame& ranked_data() const { return m_df; }
 
+    // The nodes of the tree in depth-first order.
+    const std::vector<KDTreeNode>& nodes() const { return m_nodes; }
+
+    // Memory used by the nodes, the indices and the reordered points of the tree. The ranked data is not included.
+    std::size_t memory_bytes() const {
+        return util::vector_bytes(m_nodes) + util::vector_bytes(m_indices) + util::eigen_bytes(m_points_double) +
+               util::eigen_bytes(m_points_float);
+    }
+
+    // The points of the tree reordered by leaf, so the points of a node are the rows [node.begin, node.end).
+    template <typename ArrowType>
+    const PointMatrix<ArrowType>& points() const {
+        if constexpr (std::is_same_v<ArrowType, arrow::DoubleType>) {
+            return m_points_double;
+        } else {
+            return m_points_float;
+        }
+    }
+
+    size_t max_leaf_size() const { return m_max_leaf_size; }
+
 private:
-    std::unique_ptr<KDTreeNode> build_kdtree(const DataFrame& df, int leafsize);
+    void build_kdtree(const DataFrame& df, int leafsize, int num_threads);
+
+    template <typename ArrowType>
+    void fill_points(PointMatrix<ArrowType>& points) const;
+
+    void check_query(const DataFrame& test_df, int k, double eps) const;
+
+    template <typename ArrowType>
+    void query_points(const DataFrame& test_df,
+                      int k,
+                      double p,
+                      double eps,
+                      int num_threads,
+                      MatrixXd& distances,
+                      MatrixXi& indices) const;
+
+    template <typename ArrowType, typename DistanceType>
+    void query_points(const PointMatrix<ArrowType>& test_points,
+                      int k,
+                      const DistanceType& distance,
+                      double eps,
+                      int num_threads,
+                      MatrixXd& distances,
+                      MatrixXi& indices) const;
+
+    template <typename ArrowType>
+    void count_ball_subspaces_points(const DataFrame& test_df,
+                                     const Array_ptr& x_data,
+                                     const Array_ptr& y_data,
+                                     const VectorXd& eps,
+                                     int num_threads,
+                                     VectorXi& count_xz,
+                                     VectorXi& count_yz,
+                                     VectorXi& count_z) const;
+
+    template <typename ArrowType, typename DistanceType>
+    void initial_side_distances(QueryWorkspace<ArrowType>& workspace,
+                                const DistanceType& distance,
+                                typename ArrowType::c_type& min_distance) const;
+
+    // Pushes a QueryNode to the heap of the workspace, copying the side distances at side_offset and replacing the
+    // side distance of split_id with split_distance (if split_id != -1).
+    template <typename ArrowType>
+    void push_query_node(QueryWorkspace<ArrowType>& workspace,
+                         size_t node,
+                         typename ArrowType::c_type min_distance,
+                         size_t side_offset,
+                         int split_id = -1,
+                         typename ArrowType::c_type split_distance = 0) const;
 
     DataFrame m_df;
     std::vector<std::string> m_column_names;
     std::shared_ptr<arrow::DataType> m_datatype;
-    std::unique_ptr<KDTreeNode> m_root;
+    std::vector<KDTreeNode> m_nodes;
+    // Original row of each reordered point.
     std::vector<size_t> m_indices;
+    // The points reordered by leaf. Only the matrix of the data type of the tree is used.
+    PointMatrix<arrow::DoubleType> m_points_double;
+    PointMatrix<arrow::FloatType> m_points_float;
+    size_t m_max_leaf_size;
     VectorXd m_maxes;
     VectorXd m_mines;
 };
 
-template <typename ArrowType, typename DistanceType>
-std::pair<VectorXd, VectorXi> KDTree::query_instance(const DowncastArray_vector<ArrowType>& test_downcast,
-                                                     size_t i,
-                                                     int k,
-                                                     const DistanceType& distance) const {
-    using CType = typename ArrowType::c_type;
-    using VectorType = Matrix<typename ArrowType::c_type, Dynamic, 1>;
+// Copies the rows of df (in the column order of the tree) to a PointMatrix.
+template <typename ArrowType>
+PointMatrix<ArrowType> to_point_matrix(const DataFrame& df, const std::vector<std::string>& columns) {
+    PointMatrix<ArrowType> points(df->num_rows(), columns.size());
+    for (size_t j = 0; j < columns.size(); ++j) {
+        auto raw_values = df.downcast<ArrowType>(columns[j])->raw_values();
+        std::copy(raw_values, raw_values + df->num_rows(), points.col(j).data());
+    }
+    return points;
+}
 
-    NeighborQueue<ArrowType> neighbors;
+template <typename ArrowType>
+void KDTree::fill_points(PointMatrix<ArrowType>& points) const {
+    points.resize(m_indices.size(), m_column_names.size());
+    for (size_t j = 0; j < m_column_names.size(); ++j) {
+        auto raw_values = m_df.downcast<ArrowType>(m_column_names[j])->raw_values();
+        auto column = points.col(j).data();
+        for (size_t i = 0; i < m_indices.size(); ++i) {
+            column[i] = raw_values[m_indices[i]];
+        }
+    }
+}
 
-    CType distance_upper_bound = std::numeric_limits<CType>::infinity();
-    for (auto i = 0; i < k; ++i) {
-        neighbors.push(std::make_pair(distance_upper_bound, -1));
+template <typename ArrowType>
+void KDTree::push_query_node(QueryWorkspace<ArrowType>& workspace,
+                             size_t node,
+                             typename ArrowType::c_type min_distance,
+                             size_t side_offset,
+                             int split_id,
+                             typename ArrowType::c_type split_distance) const {
+    auto num_dimensions = m_column_names.size();
+    auto new_offset = side_offset;
+    if (split_id != -1) {
+        new_offset = workspace.side_distances.size();
+        workspace.side_distances.resize(new_offset + num_dimensions);
+        std::copy_n(workspace.side_distances.begin() + side_offset,
+                    num_dimensions,
+                    workspace.side_distances.begin() + new_offset);
+        workspace.side_distances[new_offset + split_id] = split_distance;
     }
 
-    VectorType side_distance(m_column_names.size());
-    CType min_distance = 0;
+    workspace.query_nodes.push_back(QueryNode<ArrowType>{/*.node = */ node,
+                                                         /*.is_leaf = */ m_nodes[node].is_leaf(),
+                                                         /*.min_distance = */ min_distance,
+                                                         /*.side_offset = */ new_offset});
+    std::push_heap(workspace.query_nodes.begin(), workspace.query_nodes.end(), QueryNodeComparator<ArrowType>{});
+}
 
+template <typename ArrowType, typename DistanceType>
+void KDTree::initial_side_distances(QueryWorkspace<ArrowType>& workspace,
+                                    const DistanceType& distance,
+                                    typename ArrowType::c_type& min_distance) const {
+    using CType = typename ArrowType::c_type;
+
+    min_distance = 0;
+    workspace.side_distances.resize(m_column_names.size());
     for (size_t j = 0; j < m_column_names.size(); ++j) {
-        auto x_value = test_downcast[j]->Value(i);
-        side_distance(j) = std::max(0., std::max(x_value - m_maxes(j), m_mines(j) - x_value));
-        side_distance(j) = distance.distance_p(side_distance(j));
-        min_distance = distance.update_component_distance(min_distance, 0, side_distance(j));
+        auto x_value = workspace.point(j);
+        CType side = std::max(0., std::max(x_value - m_maxes(j), m_mines(j) - x_value));
+        workspace.side_distances[j] = distance.distance_p(side);
+        min_distance = distance.update_component_distance(min_distance, 0, workspace.side_distances[j]);
     }
+}
+
+template <typename ArrowType, typename DistanceType>
+void KDTree::query_instance(QueryWorkspace<ArrowType>& workspace,
+                            int k,
+                            const DistanceType& distance,
+                            double eps) const {
+    using CType = typename ArrowType::c_type;
 
-    QueryQueue<ArrowType> query_nodes;
+    const auto& tree_points = points<ArrowType>();
+    NeighborComparator<ArrowType> neighbor_comparator;
+    QueryNodeComparator<ArrowType> query_comparator;
 
-    query_nodes.push(QueryNode<ArrowType>{/*.node = */ m_root.get(),
-                                          /*.min_distance = */ min_distance,
-                                          /*.side_distance = */ side_distance});
+    workspace.clear();
+
+    // A node is only visited if it can contain a point (1 + eps) times closer than the current k-th neighbor. The
+    // factor is in the units of the non-normalized distance, so it is exactly 1 for the exact search.
+    CType bound_factor = distance.distance_p(static_cast<CType>(1 + eps));
+
+    CType distance_upper_bound = std::numeric_limits<CType>::infinity();
+    workspace.neighbors.assign(k, std::make_pair(distance_upper_bound, static_cast<size_t>(-1)));
+
+    CType min_distance;
+    initial_side_distances<ArrowType, DistanceType>(workspace, distance, min_distance);
+    push_query_node<ArrowType>(workspace, 0, min_distance, 0);
+
+    auto& query_nodes = workspace.query_nodes;
+    auto& neighbors = workspace.neighbors;
 
     while (!query_nodes.empty()) {
-        auto& query = query_nodes.top();
-        auto node = query.node;
+        auto query = query_nodes.front();
+        const auto& node = m_nodes[query.node];
+
+        if (query.min_distance * bound_factor >= distance_upper_bound) break;
 
-        if (query.min_distance >= distance_upper_bound) break;
+        std::pop_heap(query_nodes.begin(), query_nodes.end(), query_comparator);
+        query_nodes.pop_back();
 
-        if (node->is_leaf) {
-            for (auto it = node->indices_begin; it != node->indices_end; ++it) {
-                auto d = distance.distance(*it, i);
+        if (node.is_leaf()) {
+            auto n = node.end - node.begin;
+            distance.distances(tree_points.middleRows(node.begin, n), workspace.point, workspace.leaf_distances);
+
+            for (size_t j = 0; j < n; ++j) {
+                auto d = workspace.leaf_distances(j);
                 if (d < distance_upper_bound) {
-                    neighbors.pop();
-                    neighbors.push(std::make_pair(static_cast<double>(d), *it));
-                    distance_upper_bound = neighbors.top().first;
+                    std::pop_heap(neighbors.begin(), neighbors.end(), neighbor_comparator);
+                    neighbors.back() = std::make_pair(d, node.begin + j);
+                    std::push_heap(neighbors.begin(), neighbors.end(), neighbor_comparator);
+                    distance_upper_bound = neighbors.front().first;
                 }
             }
-            query_nodes.pop();
         } else {
-            KDTreeNode* near_node;
-            KDTreeNode* far_node;
+            size_t near_node;
+            size_t far_node;
 
-            auto p = test_downcast[node->split_id]->Value(i);
+            auto p = workspace.point(node.split_id);
 
-            if (p < node->split_value) {
-                near_node = node->left.get();
-                far_node = node->right.get();
+            if (p < node.split_value) {
+                near_node = query.node + 1;
+                far_node = node.right;
             } else {
-                near_node = node->right.get();
-                far_node = node->left.get();
+                near_node = node.right;
+                far_node = query.node + 1;
             }
 
-            QueryNode<ArrowType> near_query{/*.node = */ near_node,
-                                            /*.min_distance = */ query.min_distance,
-                                            /*.side_distance = */ query.side_distance};
-
-            VectorType far_side_distance = query.side_distance;
+            push_query_node<ArrowType>(workspace, near_node, query.min_distance, query.side_offset);
 
-            auto dis = node->split_value - p;
-            far_side_distance(node->split_id) = distance.distance_p(dis);
+            CType far_side_distance = distance.distance_p(node.split_value - p);
             CType far_min_distance = distance.update_component_distance(
-                query.min_distance, query.side_distance(node->split_id), far_side_distance(node->split_id));
+                query.min_distance, workspace.side_distances[query.side_offset + node.split_id], far_side_distance);
 
-            query_nodes.pop();
-            query_nodes.push(near_query);
-
-            if (far_min_distance < distance_upper_bound) {
-                query_nodes.push(QueryNode<ArrowType>{/*.node = */ far_node,
-                                                      /*.min_distance = */ far_min_distance,
-                                                      /*.side_distance = */ far_side_distance});
+            if (far_min_distance * bound_factor < distance_upper_bound) {
+                push_query_node<ArrowType>(
+                    workspace, far_node, far_min_distance, query.side_offset, node.split_id, far_side_distance);
             }
         }
     }
+}
 
-    VectorXd distances(k);
-    VectorXi indices(k);
+template <typename ArrowType, typename DistanceType>
+void KDTree::query_points(const PointMatrix<ArrowType>& test_points,
+                          int k,
+                          const DistanceType& distance,
+                          double eps,
+                          int num_threads,
+                          MatrixXd& distances,
+                          MatrixXi& indices) const {
+    // The tree is read-only, so the test points can be queried concurrently. Each thread keeps its own workspace and
+    // writes the neighbors directly to its columns of the result.
+    std::vector<std::optional<QueryWorkspace<ArrowType>>> workspaces(util::effective_num_threads(num_threads));
+
+    int num_points = test_points.rows();
+    int num_blocks = (num_points + query_block_size - 1) / query_block_size;
+    util::parallel_for(0, num_blocks, num_threads, [&](int block, int thread_index) {
+        auto& workspace = workspaces[thread_index];
+        if (!workspace) workspace.emplace(m_column_names.size(), m_max_leaf_size);
+
+        NeighborComparator<ArrowType> neighbor_comparator;
+
+        int end = std::min((block + 1) * query_block_size, num_points);
+        for (int i = block * query_block_size; i < end; ++i) {
+            workspace->point = test_points.row(i).transpose();
+            query_instance<ArrowType>(*workspace, k, distance, eps);
+
+            auto& neighbors = workspace->neighbors;
+            for (auto u = k - 1; u >= 0; --u) {
+                auto& neigh = neighbors.front();
+                distances(u, i) = distance.normalize(neigh.first);
+                indices(u, i) = (neigh.second < m_indices.size()) ? static_cast<int>(m_indices[neigh.second]) : -1;
+                std::pop_heap(neighbors.begin(), neighbors.end(), neighbor_comparator);
+                neighbors.pop_back();
+            }
+        }
+    });
+}
 
-    auto u = k - 1;
-    while (!neighbors.empty()) {
-        auto& neigh = neighbors.top();
-        distances(u) = distance.normalize(neigh.first);
-        indices(u) = neigh.second;
-        neighbors.pop();
-        --u;
+template <typename ArrowType>
+void KDTree::query_points(const DataFrame& test_df,
+                          int k,
+                          double p,
+                          double eps,
+                          int num_threads,
+                          MatrixXd& distances,
+                          MatrixXi& indices) const {
+    auto test_points = to_point_matrix<ArrowType>(test_df, m_column_names);
+
+    if (p == 1) {
+        query_points<ArrowType>(test_points, k, ManhattanDistance<ArrowType>{}, eps, num_threads, distances, indices);
+    } else if (p == 2) {
+        query_points<ArrowType>(test_points, k, EuclideanDistance<ArrowType>{}, eps, num_threads, distances, indices);
+    } else if (std::isinf(p)) {
+        query_points<ArrowType>(test_points, k, ChebyshevDistance<ArrowType>{}, eps, num_threads, distances, indices);
+    } else {
+        query_points<ArrowType>(test_points, k, MinkowskiP<ArrowType>(p), eps, num_threads, distances, indices);
     }
+}
+
+template <typename ArrowType>
+void KDTree::count_ball_subspaces_points(const DataFrame& test_df,
+                                         const Array_ptr& x_data,
+                                         const Array_ptr& y_data,
+                                         const VectorXd& eps,
+                                         int num_threads,
+                                         VectorXi& count_xz,
+                                         VectorXi& count_yz,
+                                         VectorXi& count_z) const {
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+
+    auto test = to_point_matrix<ArrowType>(test_df, test_df.column_names());
+    ChebyshevDistance<ArrowType> dist;
+    std::vector<std::optional<QueryWorkspace<ArrowType>>> workspaces(util::effective_num_threads(num_threads));
+
+    auto x = std::static_pointer_cast<ArrayType>(x_data)->raw_values();
+    auto y = std::static_pointer_cast<ArrayType>(y_data)->raw_values();
+
+    int num_points = test_df->num_rows();
+    int num_blocks = (num_points + query_block_size - 1) / query_block_size;
+    util::parallel_for(0, num_blocks, num_threads, [&](int block, int thread_index) {
+        auto& workspace = workspaces[thread_index];
+        if (!workspace) workspace.emplace(m_column_names.size(), m_max_leaf_size);
+
+        int end = std::min((block + 1) * query_block_size, num_points);
+        for (int i = block * query_block_size; i < end; ++i) {
+            workspace->point = test.row(i).transpose();
+            auto c = count_ball_subspaces_instance<ArrowType>(*workspace, x, y, i, dist, eps(i));
 
-    return std::make_pair(distances, indices);
+            count_xz(i) = std::get<0>(c);
+            count_yz(i) = std::get<1>(c);
+            count_z(i) = std::get<2>(c);
+        }
+    });
 }
 
 template <typename ArrowType, typename DistanceType>
-std::tuple<int, int, int> KDTree::count_ball_subspaces_instance(const DowncastArray_vector<ArrowType>& test_downcast,
+std::tuple<int, int, int> KDTree::count_ball_subspaces_instance(QueryWorkspace<ArrowType>& workspace,
                                                                 const typename ArrowType::c_type* x_data,
                                                                 const typename ArrowType::c_type* y_data,
                                                                 size_t i,
                                                                 const DistanceType& distance,
                                                                 const typename ArrowType::c_type eps_value) const {
     using CType = typename ArrowType::c_type;
-    using VectorType = Matrix<typename ArrowType::c_type, Dynamic, 1>;
 
-    VectorType side_distance(test_downcast.size());
-    CType min_distance = 0;
+    const auto& tree_points = points<ArrowType>();
+    QueryNodeComparator<ArrowType> query_comparator;
 
-    for (size_t j = 0; j < test_downcast.size(); ++j) {
-        auto p = test_downcast[j]->Value(i);
-        side_distance(j) = std::max(0., std::max(p - m_maxes(j), m_mines(j) - p));
-        side_distance(j) = distance.distance_p(side_distance(j));
-        min_distance = distance.update_component_distance(min_distance, 0, side_distance(j));
-    }
+    workspace.clear();
 
-    int count_xz = 0, count_yz = 0, count_z = 0;
+    CType min_distance;
+    initial_side_distances<ArrowType, DistanceType>(workspace, distance, min_distance);
 
-    QueryQueue<ArrowType> query_nodes;
+    int count_xz = 0, count_yz = 0, count_z = 0;
 
     if (min_distance < eps_value) {
-        query_nodes.push(QueryNode<ArrowType>{/*.node = */ m_root.get(),
-                                              /*.min_distance = */ min_distance,
-                                              /*.side_distance = */ side_distance});
+        push_query_node<ArrowType>(workspace, 0, min_distance, 0);
     }
 
+    auto& query_nodes = workspace.query_nodes;
     while (!query_nodes.empty()) {
-        auto& query = query_nodes.top();
-        auto node = query.node;
+        auto query = query_nodes.front();
+        const auto& node = m_nodes[query.node];
 
-        if (node->is_leaf) {
-            for (auto it = node->indices_begin; it != node->indices_end; ++it) {
-                auto d = distance.distance(*it, i);
+        std::pop_heap(query_nodes.begin(), query_nodes.end(), query_comparator);
+        query_nodes.pop_back();
 
-                if (d < eps_value) {
+        if (node.is_leaf()) {
+            auto n = node.end - node.begin;
+            distance.distances(tree_points.middleRows(node.begin, n), workspace.point, workspace.leaf_distances);
+
+            for (size_t j = 0; j < n; ++j) {
+                if (workspace.leaf_distances(j) < eps_value) {
+                    auto index = m_indices[node.begin + j];
                     ++count_z;
-                    if (std::abs(x_data[*it] - x_data[i]) < eps_value) ++count_xz;
-                    if (std::abs(y_data[*it] - y_data[i]) < eps_value) ++count_yz;
+                    if (std::abs(x_data[index] - x_data[i]) < eps_value) ++count_xz;
+                    if (std::abs(y_data[index] - y_data[i]) < eps_value) ++count_yz;
                 }
             }
-
-            query_nodes.pop();
         } else {
-            KDTreeNode* near_node;
-            KDTreeNode* far_node;
+            size_t near_node;
+            size_t far_node;
 
-            auto p = test_downcast[node->split_id]->Value(i);
-            if (p < node->split_value) {
-                near_node = node->left.get();
-                far_node = node->right.get();
+            auto p = workspace.point(node.split_id);
+            if (p < node.split_value) {
+                near_node = query.node + 1;
+                far_node = node.right;
             } else {
-                near_node = node->right.get();
-                far_node = node->left.get();
+                near_node = node.right;
+                far_node = query.node + 1;
             }
 
-            QueryNode<ArrowType> near_query{/*.node = */ near_node,
-                                            /*.min_distance = */ query.min_distance,
-                                            /*.side_distance = */ query.side_distance};
-
-            CType far_dimension_distance = distance.distance_p(node->split_value - p);
-            CType far_node_distance = distance.update_component_distance(
-                query.min_distance, query.side_distance(node->split_id), far_dimension_distance);
+            push_query_node<ArrowType>(workspace, near_node, query.min_distance, query.side_offset);
 
-            query_nodes.pop();
-            query_nodes.push(near_query);
+            CType far_dimension_distance = distance.distance_p(node.split_value - p);
+            CType far_node_distance =
+                distance.update_component_distance(query.min_distance,
+                                                   workspace.side_distances[query.side_offset + node.split_id],
+                                                   far_dimension_distance);
 
             if (far_node_distance < eps_value) {
-                VectorType far_side_distance = near_query.side_distance;
-                far_side_distance(node->split_id) = far_dimension_distance;
-                query_nodes.push(QueryNode<ArrowType>{/*.node = */ far_node,
-                                                      /*.min_distance = */ far_node_distance,
-                                                      /*.side_distance = */ far_side_distance});
+                push_query_node<ArrowType>(
+                    workspace, far_node, far_node_distance, query.side_offset, node.split_id, far_dimension_distance);
             }
         }
     }
@@ -555,4 +885,4 @@ std::tuple<int, int, int> KDTree::count_ball_subspaces_instance(const DowncastAr
 
 }  // namespace kdtree
 
-#endif  // PYBNESIAN_KDTREE_KDTREE_HPP
\ No newline at end of file
+#endif  // PYBNESIAN_KDTREE_KDTREE_HPP
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <learning/algorithms/async_learning.hpp>
+#include <util/parallel.hpp>
+
+namespace learning::algorithms {
+
+LearningTask::LearningTask(std::shared_ptr<Callback> callback)
+    : SearchBudget(std::nullopt, std::nullopt),
+      m_callback(callback),
+      m_mutex(),
+      m_done_cv(),
+      m_status(Status::Pending),
+      m_cancelled(false),
+      m_evaluations(0),
+      m_start(),
+      m_iterations(0),
+      m_events(),
+      m_partial_model(),
+      m_result(),
+      m_exception(),
+      m_done_callbacks() {
+    if (m_callback && m_callback->is_python_derived())
+        throw std::invalid_argument("The callback of an asynchronous task cannot be Python-derived.");
+}
+
+void LearningTask::call(BayesianNetworkBase& model, Operator* new_operator, Score& score, int num_iter) const {
+    // The model is copied out of the lock, so partial_model() does not wait for the copy.
+    auto copy = model.clone();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_partial_model = std::move(copy);
+        if (new_operator) {
+            m_iterations = num_iter;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+            m_events.push_back(ProgressEvent{num_iter, new_operator->delta(), elapsed.count()});
+        }
+    }
+
+    if (m_callback) m_callback->call(model, new_operator, score, num_iter);
+}
+
+bool LearningTask::stop(int64_t evaluations) const {
+    m_evaluations = evaluations;
+    return m_cancelled || (m_callback && m_callback->stop(evaluations));
+}
+
+bool LearningTask::cancel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_status == Status::Finished) return false;
+    m_cancelled = true;
+    return true;
+}
+
+LearningTask::Status LearningTask::status() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_status;
+}
+
+bool LearningTask::wait(std::optional<double> timeout) const {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto finished = [this]() { return m_status == Status::Finished; };
+    if (!timeout) {
+        m_done_cv.wait(lock, finished);
+        return true;
+    }
+
+    if (*timeout < 0) throw std::invalid_argument("timeout must be non-negative.");
+    return m_done_cv.wait_for(lock, std::chrono::duration<double>(*timeout), finished);
+}
+
+LearningTask::Result LearningTask::result(std::optional<double> timeout) const {
+    if (!wait(timeout)) throw std::runtime_error("The task did not finish before the timeout.");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_exception) std::rethrow_exception(m_exception);
+    return *m_result;
+}
+
+int LearningTask::iterations() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_iterations;
+}
+
+double LearningTask::elapsed() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_status == Status::Pending) return 0;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+    return elapsed.count();
+}
+
+std::vector<ProgressEvent> LearningTask::events(size_t first) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (first >= m_events.size()) return {};
+    return std::vector<ProgressEvent>(m_events.begin() + first, m_events.end());
+}
+
+std::shared_ptr<BayesianNetworkBase> LearningTask::partial_model() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_partial_model;
+}
+
+void LearningTask::add_done_callback(std::function<void()> f) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_status != Status::Finished) {
+            m_done_callbacks.push_back(std::move(f));
+            return;
+        }
+    }
+
+    f();
+}
+
+void LearningTask::run(const std::shared_ptr<LearningTask>& task, const Function& f) {
+    {
+        std::lock_guard<std::mutex> lock(task->m_mutex);
+        if (task->m_cancelled) {
+            task->m_exception =
+                std::make_exception_ptr(std::runtime_error("The task was cancelled before it started."));
+        } else {
+            task->m_status = Status::Running;
+            task->m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (!task->m_exception) {
+        try {
+            auto result = f(task);
+            std::lock_guard<std::mutex> lock(task->m_mutex);
+            task->m_result = std::move(result);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(task->m_mutex);
+            task->m_exception = std::current_exception();
+        }
+    }
+
+    task->finish();
+}
+
+void LearningTask::finish() {
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_status = Status::Finished;
+        std::swap(callbacks, m_done_callbacks);
+    }
+    m_done_cv.notify_all();
+
+    for (auto& f : callbacks) {
+        f();
+    }
+}
+
+LearningTaskPool& LearningTaskPool::get() {
+    // The pool is never destroyed, so the process does not wait for the running tasks when it exits.
+    static auto* pool = new LearningTaskPool(util::effective_num_threads(0));
+    return *pool;
+}
+
+LearningTaskPool::LearningTaskPool(int num_threads) : m_threads(), m_mutex(), m_work_cv(), m_pending() {
+    m_threads.reserve(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+        m_threads.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+void LearningTaskPool::submit(const std::shared_ptr<LearningTask>& task, LearningTask::Function f) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.emplace_back(task, std::move(f));
+    }
+    m_work_cv.notify_one();
+}
+
+void LearningTaskPool::worker_loop() {
+    while (true) {
+        std::pair<std::shared_ptr<LearningTask>, LearningTask::Function> next;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_cv.wait(lock, [this]() { return !m_pending.empty(); });
+            next = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+
+        LearningTask::run(next.first, next.second);
+    }
+}
+
+namespace {
+
+bool python_types(const FactorTypeVector& types) {
+    return std::any_of(types.begin(), types.end(), [](const auto& p) { return p.second->is_python_derived(); });
+}
+
+}  // namespace
+
+std::shared_ptr<LearningTask> hc_async(const DataFrame& df,
+                                       const std::shared_ptr<BayesianNetworkType> bn_type,
+                                       const std::shared_ptr<BayesianNetworkBase> start,
+                                       const std::optional<std::string>& score_str,
+                                       const std::optional<std::vector<std::string>>& operators_str,
+                                       const ArcStringVector& arc_blacklist,
+                                       const ArcStringVector& arc_whitelist,
+                                       const FactorTypeVector& type_blacklist,
+                                       const FactorTypeVector& type_whitelist,
+                                       const std::shared_ptr<Callback> callback,
+                                       int max_indegree,
+                                       int max_iters,
+                                       double epsilon,
+                                       int patience,
+                                       std::optional<unsigned int> seed,
+                                       int num_folds,
+                                       double test_holdout_ratio,
+                                       int num_threads,
+                                       int batch_operators) {
+    if (!bn_type && !start) {
+        throw std::invalid_argument("\"bn_type\" or \"start\" parameter must be specified.");
+    }
+
+    if ((bn_type && bn_type->is_python_derived()) || (start && start->has_python_derived()) ||
+        python_types(type_blacklist) || python_types(type_whitelist)) {
+        throw std::invalid_argument("An asynchronous hill-climbing cannot use Python-derived objects.");
+    }
+
+    util::effective_num_threads(num_threads);
+    if (batch_operators <= 0) throw std::invalid_argument("batch_operators must be a positive value.");
+    auto task = std::make_shared<LearningTask>(callback);
+
+    LearningTaskPool::get().submit(task, [=](const std::shared_ptr<LearningTask>& t) -> LearningTask::Result {
+        return hc(df,
+                  bn_type,
+                  start,
+                  score_str,
+                  operators_str,
+                  arc_blacklist,
+                  arc_whitelist,
+                  type_blacklist,
+                  type_whitelist,
+                  t,
+                  max_indegree,
+                  max_iters,
+                  epsilon,
+                  patience,
+                  seed,
+                  num_folds,
+                  test_holdout_ratio,
+                  0,
+                  num_threads,
+                  batch_operators);
+    });
+
+    return task;
+}
+
+std::shared_ptr<LearningTask> pc_async(const std::shared_ptr<IndependenceTest>& test,
+                                       const std::vector<std::string>& nodes,
+                                       const ArcStringVector& arc_blacklist,
+                                       const ArcStringVector& arc_whitelist,
+                                       const EdgeStringVector& edge_blacklist,
+                                       const EdgeStringVector& edge_whitelist,
+                                       double alpha,
+                                       bool use_sepsets,
+                                       double ambiguous_threshold,
+                                       bool allow_bidirected,
+                                       int num_threads,
+                                       const std::optional<std::string>& checkpoint,
+                                       const std::shared_ptr<PCCheckpoint>& resume,
+                                       const std::shared_ptr<SearchBudget>& budget,
+                                       bool association_order) {
+    if (!test) throw std::invalid_argument("hypot_test must be non-null.");
+    if (test->is_python_derived())
+        throw std::invalid_argument("An asynchronous PC cannot use a Python-derived independence test.");
+
+    util::effective_num_threads(num_threads);
+    auto task = std::make_shared<LearningTask>(budget);
+
+    LearningTaskPool::get().submit(task, [=](const std::shared_ptr<LearningTask>& t) -> LearningTask::Result {
+        PC pc;
+        return pc.estimate(*test,
+                           nodes,
+                           arc_blacklist,
+                           arc_whitelist,
+                           edge_blacklist,
+                           edge_whitelist,
+                           alpha,
+                           use_sepsets,
+                           ambiguous_threshold,
+                           allow_bidirected,
+                           0,
+                           num_threads,
+                           checkpoint,
+                           resume,
+                           t,
+                           association_order);
+    });
+
+    return task;
+}
+
+std::shared_ptr<LearningTask> fit_async(const std::shared_ptr<BayesianNetworkBase>& model,
+                                        const DataFrame& df,
+                                        const std::shared_ptr<const Arguments>& construction_args,
+                                        int num_threads,
+                                        bool fused) {
+    if (!model) throw std::invalid_argument("model must be non-null.");
+    if (model->has_python_derived())
+        throw std::invalid_argument("An asynchronous fit cannot use a Python-derived Bayesian network or CPD.");
+
+    util::effective_num_threads(num_threads);
+    auto task = std::make_shared<LearningTask>();
+
+    LearningTaskPool::get().submit(task, [=](const std::shared_ptr<LearningTask>&) -> LearningTask::Result {
+        model->parallel_fit(df, construction_args ? *construction_args : Arguments(), num_threads, fused);
+        return model;
+    });
+
+    return task;
+}
+
+}  // namespace learning::algorithms
@@ -0,0 +1,165 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_ASYNC_LEARNING_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_ASYNC_LEARNING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <variant>
+#include <learning/algorithms/callbacks/progress_events.hpp>
+#include <learning/algorithms/callbacks/search_budget.hpp>
+#include <learning/algorithms/hillclimbing.hpp>
+#include <learning/algorithms/pc.hpp>
+
+using learning::algorithms::callbacks::ProgressEvent;
+
+namespace learning::algorithms {
+
+// A learning algorithm executed in a thread of the LearningTaskPool. The task is also the callback (or the budget) of
+// the algorithm: it records the progress of the search and stops it when the task is cancelled, so a cancelled search
+// still returns the best model found so far. The user callback of the algorithm, if any, is called by the task.
+//
+// The threads of the pool never hold the GIL, so the algorithms of the tasks must not call Python code: the functions
+// that create the tasks reject the Python-derived objects.
+class LearningTask : public callbacks::SearchBudget {
+public:
+    enum class Status { Pending, Running, Finished };
+
+    using Result = std::variant<std::shared_ptr<BayesianNetworkBase>, PartiallyDirectedGraph>;
+    using Function = std::function<Result(const std::shared_ptr<LearningTask>&)>;
+
+    LearningTask(std::shared_ptr<Callback> callback = nullptr);
+
+    void call(BayesianNetworkBase& model, Operator* new_operator, Score& score, int num_iter) const override;
+    bool stop(int64_t evaluations) const override;
+    bool is_python_derived() const override { return false; }
+
+    // Requests the cancellation of the task. A pending task is never executed. A running task stops at the next check
+    // of stop(), so the algorithms that do not check the budget (e.g. the fit of a model) are not interrupted. Returns
+    // false if the task has already finished.
+    bool cancel();
+    bool cancelled() const { return m_cancelled; }
+    Status status() const;
+    bool done() const { return status() == Status::Finished; }
+
+    // Blocks until the task finishes or timeout seconds pass. Returns done().
+    bool wait(std::optional<double> timeout = std::nullopt) const;
+    // Returns the result of the task, blocking until it finishes. The exception thrown by the algorithm is rethrown.
+    Result result(std::optional<double> timeout = std::nullopt) const;
+
+    // Number of iterations of the search that applied an operator, and number of local scores (or independence tests)
+    // evaluated.
+    int iterations() const;
+    int64_t evaluations() const { return m_evaluations; }
+    // Seconds since the task started running.
+    double elapsed() const;
+    // Returns the progress events of the search from the first-th event (see ProgressEvents).
+    std::vector<ProgressEvent> events(size_t first = 0) const;
+    // Returns a copy of the current model of the search after the last iteration, or nullptr if the algorithm does not
+    // report its models.
+    std::shared_ptr<BayesianNetworkBase> partial_model() const;
+
+    // Registers a function that is called once, when the task finishes. It is called by the thread that finishes the
+    // task, or immediately by the calling thread if the task has already finished.
+    void add_done_callback(std::function<void()> f);
+
+    // Runs the task in the calling thread. Called by the LearningTaskPool.
+    static void run(const std::shared_ptr<LearningTask>& task, const Function& f);
+
+private:
+    void finish();
+
+    std::shared_ptr<Callback> m_callback;
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_done_cv;
+    Status m_status;
+    std::atomic<bool> m_cancelled;
+    mutable std::atomic<int64_t> m_evaluations;
+    std::chrono::steady_clock::time_point m_start;
+    mutable int m_iterations;
+    mutable std::vector<ProgressEvent> m_events;
+    mutable std::shared_ptr<BayesianNetworkBase> m_partial_model;
+    std::optional<Result> m_result;
+    std::exception_ptr m_exception;
+    std::vector<std::function<void()>> m_done_callbacks;
+};
+
+// A process-wide pool of native threads (one for each hardware thread) that executes the LearningTasks in FIFO order.
+// The threads are detached from the Python interpreter: the tasks should be finished (or cancelled and waited) before
+// the process exits.
+class LearningTaskPool {
+public:
+    static LearningTaskPool& get();
+
+    LearningTaskPool(const LearningTaskPool&) = delete;
+    LearningTaskPool& operator=(const LearningTaskPool&) = delete;
+
+    int num_threads() const { return m_threads.size(); }
+    void submit(const std::shared_ptr<LearningTask>& task, LearningTask::Function f);
+
+private:
+    LearningTaskPool(int num_threads);
+
+    void worker_loop();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::deque<std::pair<std::shared_ptr<LearningTask>, LearningTask::Function>> m_pending;
+};
+
+// Executes hc() in the LearningTaskPool. The parameters are the same as in hc(), except verbose.
+std::shared_ptr<LearningTask> hc_async(const DataFrame& df,
+                                       const std::shared_ptr<BayesianNetworkType> bn_type,
+                                       const std::shared_ptr<BayesianNetworkBase> start,
+                                       const std::optional<std::string>& score_str,
+                                       const std::optional<std::vector<std::string>>& operators_str,
+                                       const ArcStringVector& arc_blacklist,
+                                       const ArcStringVector& arc_whitelist,
+                                       const FactorTypeVector& type_blacklist,
+                                       const FactorTypeVector& type_whitelist,
+                                       const std::shared_ptr<Callback> callback,
+                                       int max_indegree,
+                                       int max_iters,
+                                       double epsilon,
+                                       int patience,
+                                       std::optional<unsigned int> seed,
+                                       int num_folds,
+                                       double test_holdout_ratio,
+                                       int num_threads = 1,
+                                       int batch_operators = 1);
+
+// Executes PC::estimate() in the LearningTaskPool. The parameters are the same as in PC::estimate(), except verbose.
+// The budget, if any, is checked together with the cancellation of the task.
+std::shared_ptr<LearningTask> pc_async(const std::shared_ptr<IndependenceTest>& test,
+                                       const std::vector<std::string>& nodes,
+                                       const ArcStringVector& arc_blacklist,
+                                       const ArcStringVector& arc_whitelist,
+                                       const EdgeStringVector& edge_blacklist,
+                                       const EdgeStringVector& edge_whitelist,
+                                       double alpha,
+                                       bool use_sepsets,
+                                       double ambiguous_threshold,
+                                       bool allow_bidirected,
+                                       int num_threads = 1,
+                                       const std::optional<std::string>& checkpoint = std::nullopt,
+                                       const std::shared_ptr<PCCheckpoint>& resume = nullptr,
+                                       const std::shared_ptr<SearchBudget>& budget = nullptr,
+                                       bool association_order = false);
+
+// Executes BayesianNetworkBase::parallel_fit() in the LearningTaskPool. The result of the task is model. The model must
+// not be used until the task finishes. construction_args is only used by the task, so it must be released with the
+// GIL if it contains Python arguments.
+std::shared_ptr<LearningTask> fit_async(const std::shared_ptr<BayesianNetworkBase>& model,
+                                        const DataFrame& df,
+                                        const std::shared_ptr<const Arguments>& construction_args,
+                                        int num_threads = 1,
+                                        bool fused = false);
+
+}  // namespace learning::algorithms
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_ASYNC_LEARNING_HPP
@@ -15,6 +15,11 @@ class Callback {
 public:
     virtual ~Callback() = default;
     virtual void call(BayesianNetworkBase& model, Operator* new_operator, Score& score, int num_iter) const = 0;
+    // Returns true if the search must stop. The search returns the best model found so far. evaluations is the number
+    // of local scores computed since the start of the search. It is checked before each iteration.
+    virtual bool stop(int64_t) const { return false; }
+    // Returns true if call() can execute Python code. The search holds the GIL while it uses these callbacks.
+    virtual bool is_python_derived() const { return true; }
 };
 
 }  // namespace learning::algorithms::callbacks
@@ -0,0 +1,64 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_PROGRESS_EVENTS_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_PROGRESS_EVENTS_HPP
+
+#include <chrono>
+#include <mutex>
+#include <learning/algorithms/callbacks/callback.hpp>
+
+namespace learning::algorithms::callbacks {
+
+struct ProgressEvent {
+    int iteration;
+    // Delta score of the operator applied in the iteration.
+    double delta;
+    // Seconds since the start of the search (or since the callback was created, for a resumed search).
+    double elapsed;
+};
+
+// Records an event for each iteration of the hill-climbing, so the progress of a search can be monitored without
+// parsing the text of the progress spinner. The events can be read from another thread while the search is running:
+// the callback does not call Python, so the search can release the GIL.
+class ProgressEvents : public Callback {
+public:
+    ProgressEvents() : m_mutex(), m_start(std::chrono::steady_clock::now()), m_events() {}
+
+    void call(BayesianNetworkBase&, Operator* new_operator, Score&, int num_iter) const override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!new_operator) {
+            // A new search starts.
+            if (num_iter == 0) m_start = std::chrono::steady_clock::now();
+            return;
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        m_events.push_back(ProgressEvent{num_iter, new_operator->delta(), elapsed.count()});
+    }
+
+    bool is_python_derived() const override { return false; }
+
+    // Returns the events from the first-th event.
+    std::vector<ProgressEvent> events(size_t first = 0) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (first >= m_events.size()) return {};
+        return std::vector<ProgressEvent>(m_events.begin() + first, m_events.end());
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_events.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.clear();
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    mutable std::chrono::steady_clock::time_point m_start;
+    mutable std::vector<ProgressEvent> m_events;
+};
+
+}  // namespace learning::algorithms::callbacks
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_PROGRESS_EVENTS_HPP
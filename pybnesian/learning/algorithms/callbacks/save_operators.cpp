@@ -0,0 +1,124 @@
+#include <learning/algorithms/callbacks/save_operators.hpp>
+
+namespace learning::algorithms::callbacks {
+
+AsyncLineWriter::AsyncLineWriter(const std::string& file_name)
+    : m_file(file_name, std::ios::out | std::ios::trunc),
+      m_mutex(),
+      m_work_cv(),
+      m_done_cv(),
+      m_pending(),
+      m_writing(false),
+      m_stop(false),
+      m_failed(false),
+      m_thread() {
+    if (!m_file) {
+        throw std::invalid_argument("The file \"" + file_name + "\" could not be opened.");
+    }
+
+    m_thread = std::thread(&AsyncLineWriter::run, this);
+}
+
+AsyncLineWriter::~AsyncLineWriter() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_work_cv.notify_one();
+    m_thread.join();
+}
+
+void AsyncLineWriter::write(std::vector<std::string>&& lines) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(std::move(lines));
+    }
+    m_work_cv.notify_one();
+}
+
+void AsyncLineWriter::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_pending.empty() && !m_writing; });
+}
+
+bool AsyncLineWriter::failed() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+void AsyncLineWriter::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_work_cv.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+        if (m_pending.empty()) break;
+
+        auto lines = std::move(m_pending.front());
+        m_pending.pop_front();
+        m_writing = true;
+        lock.unlock();
+
+        for (const auto& line : lines) {
+            m_file << line << '\n';
+        }
+        m_file.flush();
+        bool failed = !m_file;
+
+        lock.lock();
+        m_writing = false;
+        m_failed = m_failed || failed;
+        m_done_cv.notify_all();
+    }
+}
+
+SaveOperators::SaveOperators(const std::string& file_name, int write_interval)
+    : m_file_name(file_name),
+      m_write_interval(write_interval),
+      m_writer(),
+      m_lines(),
+      m_iterations(0) {
+    if (write_interval <= 0) {
+        throw std::invalid_argument("write_interval must be a positive value.");
+    }
+
+    m_writer = std::make_shared<AsyncLineWriter>(file_name);
+}
+
+void SaveOperators::call(BayesianNetworkBase& model, Operator* new_operator, Score&, int num_iter) const {
+    if (m_writer->failed()) {
+        throw std::runtime_error("Error writing the operators to \"" + m_file_name + "\".");
+    }
+
+    auto prefix = std::to_string(num_iter) + " ";
+
+    if (new_operator) {
+        m_lines.push_back(prefix + new_operator->ToString());
+
+        if (++m_iterations % m_write_interval == 0) {
+            m_writer->write(std::move(m_lines));
+            m_lines.clear();
+        }
+    } else if (num_iter == 0) {
+        for (const auto& arc : model.arcs()) {
+            m_lines.push_back(prefix + "Arc(" + arc.first + " -> " + arc.second + ")");
+        }
+
+        for (const auto& node : model.nodes()) {
+            auto type = model.node_type(node);
+            if (*type != UnknownFactorType::get_ref()) {
+                m_lines.push_back(prefix + "NodeType(" + node + ", " + type->ToString() + ")");
+            }
+        }
+    } else {
+        m_lines.push_back(prefix + "End");
+        m_writer->write(std::move(m_lines));
+        m_lines.clear();
+        m_iterations = 0;
+        m_writer->flush();
+
+        if (m_writer->failed()) {
+            throw std::runtime_error("Error writing the operators to \"" + m_file_name + "\".");
+        }
+    }
+}
+
+}  // namespace learning::algorithms::callbacks
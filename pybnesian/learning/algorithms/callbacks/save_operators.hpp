@@ -0,0 +1,65 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_SAVE_OPERATORS_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_SAVE_OPERATORS_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <learning/algorithms/callbacks/callback.hpp>
+
+namespace learning::algorithms::callbacks {
+
+// Appends the lines of text to a file in a background thread.
+class AsyncLineWriter {
+public:
+    AsyncLineWriter(const std::string& file_name);
+    ~AsyncLineWriter();
+
+    AsyncLineWriter(const AsyncLineWriter&) = delete;
+    AsyncLineWriter& operator=(const AsyncLineWriter&) = delete;
+
+    void write(std::vector<std::string>&& lines);
+    // Blocks until all the lines have been written.
+    void flush();
+    bool failed() const;
+
+private:
+    void run();
+
+    std::ofstream m_file;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    std::deque<std::vector<std::string>> m_pending;
+    bool m_writing;
+    bool m_stop;
+    bool m_failed;
+    std::thread m_thread;
+};
+
+// Saves the structure of the starting model and the operator applied on each iteration of the hill-climbing in a text
+// file, one line per change, instead of saving a copy of the model on each iteration as SaveModel. The lines are
+// buffered and written by a background thread every write_interval iterations, so the search does not wait for the
+// disk. The end of each search is always written before the search returns.
+//
+// Each line starts with the iteration number. The iteration 0 contains the arcs and the known node types of the
+// starting model, written as Arc(source -> target) and NodeType(node, type), and the last line of a search is End.
+class SaveOperators : public Callback {
+public:
+    SaveOperators(const std::string& file_name, int write_interval = 1);
+
+    void call(BayesianNetworkBase& model, Operator* new_operator, Score& score, int num_iter) const override;
+    bool is_python_derived() const override { return false; }
+
+private:
+    std::string m_file_name;
+    int m_write_interval;
+    std::shared_ptr<AsyncLineWriter> m_writer;
+    mutable std::vector<std::string> m_lines;
+    mutable int m_iterations;
+};
+
+}  // namespace learning::algorithms::callbacks
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_SAVE_OPERATORS_HPP
@@ -0,0 +1,52 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_SEARCH_BUDGET_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_SEARCH_BUDGET_HPP
+
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <learning/algorithms/callbacks/callback.hpp>
+
+namespace learning::algorithms::callbacks {
+
+// Stops a search when the wall-clock time since the budget was created (or reset) exceeds max_seconds, or when the
+// search has computed max_evaluations local scores (independence tests in PC). The search returns the best model found
+// before the budget ran out, so a budget turns the learning algorithms into anytime algorithms.
+class SearchBudget : public Callback {
+public:
+    SearchBudget(std::optional<double> max_seconds, std::optional<int64_t> max_evaluations)
+        : m_max_seconds(max_seconds), m_max_evaluations(max_evaluations), m_start(std::chrono::steady_clock::now()) {
+        if (m_max_seconds && *m_max_seconds < 0) throw std::invalid_argument("max_seconds must be non-negative.");
+        if (m_max_evaluations && *m_max_evaluations < 0)
+            throw std::invalid_argument("max_evaluations must be non-negative.");
+    }
+
+    void call(BayesianNetworkBase&, Operator*, Score&, int) const override {}
+
+    bool stop(int64_t evaluations) const override {
+        return (m_max_evaluations && evaluations >= *m_max_evaluations) ||
+               (m_max_seconds && elapsed() >= *m_max_seconds);
+    }
+
+    bool is_python_derived() const override { return false; }
+
+    const std::optional<double>& max_seconds() const { return m_max_seconds; }
+    const std::optional<int64_t>& max_evaluations() const { return m_max_evaluations; }
+
+    // Seconds since the budget was created or reset.
+    double elapsed() const {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        return elapsed.count();
+    }
+
+    // Restarts the wall-clock time of the budget.
+    void reset() { m_start = std::chrono::steady_clock::now(); }
+
+private:
+    std::optional<double> m_max_seconds;
+    std::optional<int64_t> m_max_evaluations;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+}  // namespace learning::algorithms::callbacks
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_CALLBACKS_SEARCH_BUDGET_HPP
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <learning/algorithms/candidate_parents.hpp>
+#include <util/parallel.hpp>
+
+namespace learning::algorithms {
+
+CandidateParents candidate_parents(const IndependenceTest& test,
+                                   int k,
+                                   const std::vector<std::string>& nodes,
+                                   const std::vector<std::string>& interface_nodes,
+                                   int num_threads) {
+    if (k <= 0) throw std::invalid_argument("The number of candidate parents must be positive.");
+
+    auto targets = nodes.empty() ? test.variable_names() : nodes;
+    if (!test.has_variables(targets) || !test.has_variables(interface_nodes))
+        throw std::invalid_argument(
+            "IndependenceTest do not contain all the variables in nodes/interface_nodes lists.");
+
+    auto sources = targets;
+    sources.insert(sources.end(), interface_nodes.begin(), interface_nodes.end());
+
+    util::gil_release_if_held release(!test.is_python_derived());
+
+    std::vector<std::vector<std::string>> candidates(targets.size());
+    util::parallel_for(
+        0, static_cast<int>(targets.size()), test.is_python_derived() ? 1 : num_threads, [&](int t, int) {
+            // (p-value, position in sources) of each possible candidate.
+            std::vector<std::pair<double, int>> pvalues;
+            pvalues.reserve(sources.size());
+            for (int s = 0, end = static_cast<int>(sources.size()); s < end; ++s) {
+                if (sources[s] != targets[t]) pvalues.emplace_back(test.pvalue(targets[t], sources[s]), s);
+            }
+
+            auto selected = std::min(static_cast<size_t>(k), pvalues.size());
+            std::partial_sort(pvalues.begin(), pvalues.begin() + selected, pvalues.end());
+
+            candidates[t].reserve(selected);
+            for (size_t i = 0; i < selected; ++i) {
+                candidates[t].push_back(sources[pvalues[i].second]);
+            }
+        });
+
+    CandidateParents res;
+    for (size_t t = 0; t < targets.size(); ++t) {
+        res.emplace(targets[t], std::move(candidates[t]));
+    }
+
+    return res;
+}
+
+}  // namespace learning::algorithms
@@ -0,0 +1,24 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_CANDIDATE_PARENTS_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_CANDIDATE_PARENTS_HPP
+
+#include <learning/independences/independence.hpp>
+#include <learning/operators/operators.hpp>
+
+using learning::independences::IndependenceTest;
+using learning::operators::CandidateParents;
+
+namespace learning::algorithms {
+
+// Selects the k candidate parents of each node in nodes with the strongest marginal association (the lowest p-value of
+// test) among the other nodes and the interface_nodes, as in the sparse candidate algorithm. If nodes is empty, the
+// variables of test are used. The nodes are processed in parallel with num_threads threads, and the ties are broken
+// by the order of the candidates, so the result does not depend on the number of threads.
+CandidateParents candidate_parents(const IndependenceTest& test,
+                                   int k,
+                                   const std::vector<std::string>& nodes,
+                                   const std::vector<std::string>& interface_nodes,
+                                   int num_threads = 1);
+
+}  // namespace learning::algorithms
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_CANDIDATE_PARENTS_HPP
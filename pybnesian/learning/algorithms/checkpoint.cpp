@@ -0,0 +1,118 @@
+#include <learning/algorithms/checkpoint.hpp>
+
+using learning::operators::AddArc, learning::operators::RemoveArc, learning::operators::FlipArc,
+    learning::operators::ChangeNodeType;
+
+namespace learning::algorithms {
+
+// The operators implemented in C++ are saved as tuples. The Python-derived operators are pickled.
+py::tuple operator_state(const std::shared_ptr<Operator>& op) {
+    if (!op->is_python_derived()) {
+        if (auto add = dynamic_cast<const AddArc*>(op.get())) {
+            return py::make_tuple("AddArc", add->source(), add->target(), add->delta());
+        } else if (auto remove = dynamic_cast<const RemoveArc*>(op.get())) {
+            return py::make_tuple("RemoveArc", remove->source(), remove->target(), remove->delta());
+        } else if (auto flip = dynamic_cast<const FlipArc*>(op.get())) {
+            return py::make_tuple("FlipArc", flip->source(), flip->target(), flip->delta());
+        } else if (auto change = dynamic_cast<const ChangeNodeType*>(op.get())) {
+            return py::make_tuple("ChangeNodeType", change->node(), change->node_type(), change->delta());
+        }
+    }
+
+    return py::make_tuple("Python", op);
+}
+
+std::shared_ptr<Operator> operator_from_state(const py::tuple& t) {
+    auto name = t[0].cast<std::string>();
+
+    if (name == "Python") {
+        auto op = t[1].cast<std::shared_ptr<Operator>>();
+        return Operator::keep_python_alive(op);
+    }
+
+    if (t.size() != 4) throw std::runtime_error("Not valid operator in HillClimbingCheckpoint.");
+
+    if (name == "AddArc") {
+        return std::make_shared<AddArc>(t[1].cast<std::string>(), t[2].cast<std::string>(), t[3].cast<double>());
+    } else if (name == "RemoveArc") {
+        return std::make_shared<RemoveArc>(t[1].cast<std::string>(), t[2].cast<std::string>(), t[3].cast<double>());
+    } else if (name == "FlipArc") {
+        return std::make_shared<FlipArc>(t[1].cast<std::string>(), t[2].cast<std::string>(), t[3].cast<double>());
+    } else if (name == "ChangeNodeType") {
+        auto node_type = t[2].cast<std::shared_ptr<FactorType>>();
+        return std::make_shared<ChangeNodeType>(
+            t[1].cast<std::string>(), FactorType::keep_python_alive(node_type), t[3].cast<double>());
+    }
+
+    throw std::runtime_error("Not valid operator in HillClimbingCheckpoint.");
+}
+
+py::list operators_state(const std::vector<std::shared_ptr<Operator>>& ops) {
+    py::list l;
+    for (const auto& op : ops) {
+        l.append(operator_state(op));
+    }
+    return l;
+}
+
+std::vector<std::shared_ptr<Operator>> operators_from_state(const py::list& l) {
+    std::vector<std::shared_ptr<Operator>> ops;
+    ops.reserve(l.size());
+    for (auto t : l) {
+        ops.push_back(operator_from_state(t.cast<py::tuple>()));
+    }
+    return ops;
+}
+
+py::tuple HillClimbingCheckpoint::__getstate__() const {
+    py::object memo = m_score_memo ? py::cast(m_score_memo) : py::none();
+
+    return py::make_tuple(m_model,
+                          m_iteration,
+                          m_patience_counter,
+                          m_accumulated_offset,
+                          operators_state(m_undo_log),
+                          operators_state(m_tabu),
+                          memo);
+}
+
+std::shared_ptr<HillClimbingCheckpoint> HillClimbingCheckpoint::__setstate__(py::tuple& t) {
+    if (t.size() != 7) throw std::runtime_error("Not valid HillClimbingCheckpoint.");
+
+    auto model = t[0].cast<std::shared_ptr<BayesianNetworkBase>>();
+    std::shared_ptr<LocalScoreMemo> memo = t[6].is_none() ? nullptr : t[6].cast<std::shared_ptr<LocalScoreMemo>>();
+
+    return std::make_shared<HillClimbingCheckpoint>(BayesianNetworkBase::keep_python_alive(model),
+                                                    t[1].cast<int>(),
+                                                    t[2].cast<int>(),
+                                                    t[3].cast<double>(),
+                                                    operators_from_state(t[4].cast<py::list>()),
+                                                    operators_from_state(t[5].cast<py::list>()),
+                                                    memo);
+}
+
+py::tuple PCCheckpoint::__getstate__() const {
+    py::list sepsets;
+    for (const auto& s : m_sepsets) {
+        sepsets.append(py::make_tuple(s.first, s.second, s.sepset, s.pvalue));
+    }
+
+    return py::make_tuple(m_level, sepsets);
+}
+
+std::shared_ptr<PCCheckpoint> PCCheckpoint::__setstate__(py::tuple& t) {
+    if (t.size() != 2) throw std::runtime_error("Not valid PCCheckpoint.");
+
+    std::vector<Sepset> sepsets;
+    for (auto e : t[1].cast<py::list>()) {
+        auto s = e.cast<py::tuple>();
+        sepsets.push_back(Sepset{s[0].cast<std::string>(),
+                                 s[1].cast<std::string>(),
+                                 s[2].cast<std::vector<std::string>>(),
+                                 s[3].cast<double>()});
+    }
+
+    return std::make_shared<PCCheckpoint>(t[0].cast<int>(), std::move(sepsets));
+}
+
+}  // namespace learning::algorithms
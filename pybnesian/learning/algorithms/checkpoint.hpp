@@ -0,0 +1,103 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_CHECKPOINT_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_CHECKPOINT_HPP
+
+#include <models/BayesianNetwork.hpp>
+#include <learning/operators/operators.hpp>
+#include <util/pickle.hpp>
+
+using learning::operators::Operator, learning::operators::LocalScoreMemo;
+using models::BayesianNetworkBase;
+
+namespace learning::algorithms {
+
+// Saves obj in the pickle file name. The object is saved in a temporary file that replaces name when it is complete, so
+// an interrupted save does not corrupt the previous checkpoint. The GIL is acquired if the search released it.
+template <typename OBJ>
+void save_checkpoint(const OBJ& obj, std::string name) {
+    py::gil_scoped_acquire gil;
+
+    if (name.size() < 7 || name.substr(name.size() - 7) != ".pickle") name += ".pickle";
+
+    auto tmp_name = name.substr(0, name.size() - 7) + ".tmp.pickle";
+    util::save_object(obj, tmp_name);
+    py::module_::import("os").attr("replace")(tmp_name, name);
+}
+
+// The state of GreedyHillClimbing after an iteration, to resume the search if it is interrupted. The delta scores of
+// the operators are not saved: they are computed again when the search is resumed, but the local scores are read from
+// the score memo of the checkpoint.
+class HillClimbingCheckpoint {
+public:
+    HillClimbingCheckpoint(std::shared_ptr<BayesianNetworkBase> model,
+                           int iteration,
+                           int patience_counter,
+                           double accumulated_offset,
+                           std::vector<std::shared_ptr<Operator>> undo_log,
+                           std::vector<std::shared_ptr<Operator>> tabu,
+                           std::shared_ptr<LocalScoreMemo> score_memo)
+        : m_model(model),
+          m_iteration(iteration),
+          m_patience_counter(patience_counter),
+          m_accumulated_offset(accumulated_offset),
+          m_undo_log(std::move(undo_log)),
+          m_tabu(std::move(tabu)),
+          m_score_memo(score_memo) {}
+
+    // The current model of the search (not the best model found).
+    const std::shared_ptr<BayesianNetworkBase>& model() const { return m_model; }
+    int iteration() const { return m_iteration; }
+    // Number of iterations since the best model was found.
+    int patience_counter() const { return m_patience_counter; }
+    double accumulated_offset() const { return m_accumulated_offset; }
+    // The opposite of the operators applied to the model since the best model was found, in order of application.
+    const std::vector<std::shared_ptr<Operator>>& undo_log() const { return m_undo_log; }
+    const std::vector<std::shared_ptr<Operator>>& tabu() const { return m_tabu; }
+    const std::shared_ptr<LocalScoreMemo>& score_memo() const { return m_score_memo; }
+
+    void save(const std::string& name) const { save_checkpoint(*this, name); }
+
+    py::tuple __getstate__() const;
+    static std::shared_ptr<HillClimbingCheckpoint> __setstate__(py::tuple& t);
+    static std::shared_ptr<HillClimbingCheckpoint> __setstate__(py::tuple&& t) { return __setstate__(t); }
+
+private:
+    std::shared_ptr<BayesianNetworkBase> m_model;
+    int m_iteration;
+    int m_patience_counter;
+    double m_accumulated_offset;
+    std::vector<std::shared_ptr<Operator>> m_undo_log;
+    std::vector<std::shared_ptr<Operator>> m_tabu;
+    std::shared_ptr<LocalScoreMemo> m_score_memo;
+};
+
+// The state of the skeleton search of PC after a sepset order, to resume the search if it is interrupted. The skeleton
+// is the complete graph without the edges that have a sepset (and without the blacklisted edges).
+class PCCheckpoint {
+public:
+    struct Sepset {
+        std::string first;
+        std::string second;
+        std::vector<std::string> sepset;
+        double pvalue;
+    };
+
+    PCCheckpoint(int level, std::vector<Sepset> sepsets) : m_level(level), m_sepsets(std::move(sepsets)) {}
+
+    // The next sepset order to test.
+    int level() const { return m_level; }
+    const std::vector<Sepset>& sepsets() const { return m_sepsets; }
+
+    void save(const std::string& name) const { save_checkpoint(*this, name); }
+
+    py::tuple __getstate__() const;
+    static std::shared_ptr<PCCheckpoint> __setstate__(py::tuple& t);
+    static std::shared_ptr<PCCheckpoint> __setstate__(py::tuple&& t) { return __setstate__(t); }
+
+private:
+    int m_level;
+    std::vector<Sepset> m_sepsets;
+};
+
+}  // namespace learning::algorithms
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_CHECKPOINT_HPP
@@ -1,43 +1,135 @@
 #ifndef PYBNESIAN_LEARNING_ALGORITHMS_CONSTRAINT_HPP
 #define PYBNESIAN_LEARNING_ALGORITHMS_CONSTRAINT_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <optional>
 #include <graph/generic_graph.hpp>
 #include <learning/independences/independence.hpp>
 #include <util/progress.hpp>
 #include <util/combinations.hpp>
+#include <util/parallel.hpp>
 
 using graph::PartiallyDirectedGraph;
-using learning::independences::IndependenceTest;
+using learning::independences::IndependenceTest, learning::independences::profiled_pvalue,
+    learning::independences::profiled_pvalues;
 using util::BaseProgressBar;
 using util::Combinations, util::Combinations2Sets;
 
 namespace learning::algorithms {
 
+// Stores the separating set and the p-value of each removed edge. The node indices of all the separating sets are
+// stored contiguously in a single pool (sorted inside each set), and the edges are located with an open addressing hash
+// table, so each edge only needs a small fixed-size entry.
 class SepSet {
 public:
-    void insert(Edge e, const std::unordered_set<int>& s, double pvalue) {
-        m_sep.insert(std::make_pair(e, std::make_pair(s, pvalue)));
+    // Sorted node indices of a separating set.
+    class View {
+    public:
+        View(const int* begin, const int* end) : m_begin(begin), m_end(end) {}
+
+        const int* begin() const { return m_begin; }
+        const int* end() const { return m_end; }
+        size_t size() const { return m_end - m_begin; }
+        bool empty() const { return m_begin == m_end; }
+        size_t count(int idx) const { return std::binary_search(m_begin, m_end, idx); }
+
+    private:
+        const int* m_begin;
+        const int* m_end;
+    };
+
+    // If e already has a separating set, it is not modified.
+    template <typename Set>
+    void insert(Edge e, const Set& s, double pvalue) {
+        if (find(e) != -1) return;
+
+        if (2 * (m_entries.size() + 1) > m_table.size()) rehash(std::max<size_t>(16, 2 * m_table.size()));
+
+        auto offset = m_pool.size();
+        m_pool.insert(m_pool.end(), s.begin(), s.end());
+        std::sort(m_pool.begin() + offset, m_pool.end());
+
+        auto key = normalize(e);
+        m_entries.push_back(Entry{key.first, key.second, offset, static_cast<int>(s.size()), pvalue});
+        m_table[slot(key)] = m_entries.size() - 1;
     }
 
-    void insert(Edge e, std::unordered_set<int>&& s, double pvalue) {
-        m_sep.insert(std::make_pair(e, std::make_pair(std::move(s), pvalue)));
-    }
-
-    const std::pair<std::unordered_set<int>, double>& sepset(Edge e) const {
-        auto f = m_sep.find(e);
-        if (f == m_sep.end()) {
+    std::pair<View, double> sepset(Edge e) const {
+        auto f = find(e);
+        if (f == -1) {
             throw std::out_of_range("Edge (" + std::to_string(e.first) + ", " + std::to_string(e.second) +
                                     ") not found in sepset.");
         }
 
-        return f->second;
+        const auto& entry = m_entries[f];
+        const int* begin = m_pool.data() + entry.offset;
+        return std::make_pair(View(begin, begin + entry.size), entry.pvalue);
     }
 
-    auto begin() { return m_sep.begin(); }
-    auto end() { return m_sep.end(); }
+    bool contains(Edge e) const { return find(e) != -1; }
+
+    size_t size() const { return m_entries.size(); }
+
+    // Calls f(edge, sepset, pvalue) for each edge with a separating set, in order of insertion.
+    template <typename F>
+    void for_each(F&& f) const {
+        for (const auto& entry : m_entries) {
+            const int* begin = m_pool.data() + entry.offset;
+            f(Edge{entry.first, entry.second}, View(begin, begin + entry.size), entry.pvalue);
+        }
+    }
 
 private:
-    std::unordered_map<Edge, std::pair<std::unordered_set<int>, double>, EdgeHash, EdgeEqualTo> m_sep;
+    struct Entry {
+        int first;
+        int second;
+        size_t offset;
+        int size;
+        double pvalue;
+    };
+
+    static Edge normalize(Edge e) { return {std::min(e.first, e.second), std::max(e.first, e.second)}; }
+
+    static size_t hash(Edge key) {
+        auto h = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(key.first)) << 32) |
+                 static_cast<std::uint32_t>(key.second);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    // Returns the slot of the table that contains key, or the first empty slot of its probe sequence.
+    size_t slot(Edge key) const {
+        auto mask = m_table.size() - 1;
+        auto i = hash(key) & mask;
+        while (m_table[i] != -1) {
+            const auto& entry = m_entries[m_table[i]];
+            if (entry.first == key.first && entry.second == key.second) break;
+            i = (i + 1) & mask;
+        }
+
+        return i;
+    }
+
+    // Returns the index of the entry of e, or -1 if e has no separating set.
+    int find(Edge e) const {
+        if (m_table.empty()) return -1;
+        return m_table[slot(normalize(e))];
+    }
+
+    void rehash(size_t capacity) {
+        m_table.assign(capacity, -1);
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            m_table[slot({m_entries[i].first, m_entries[i].second})] = i;
+        }
+    }
+
+    std::vector<int> m_pool;
+    std::vector<Entry> m_entries;
+    // Index of the entry of each slot, or -1 for the empty slots. Its size is always a power of two.
+    std::vector<int> m_table;
 };
 
 template <typename G>
@@ -58,6 +150,103 @@ void remove_interface_arcs_blacklist(G& g, const ArcSet& arc_blacklist) {
     }
 }
 
+// Maximum number of conditioning sets tested together with IndependenceTest::pvalues() when the search stops at the
+// first independent conditioning set. The sets after the independent one in its batch are tested in vain, so the
+// batches are small.
+constexpr size_t sepset_batch_size = 16;
+
+// Returns the first conditioning set of sepsets (in iteration order) that makes x and y independent, and its pvalue.
+// The conditioning sets are tested with IndependenceTest::pvalues() in batches of sepset_batch_size, or of
+// IndependenceTest::native_batch_size() if it is smaller.
+template <typename Sepsets>
+std::optional<std::pair<std::vector<std::string>, double>> find_independent_sepset(
+    const IndependenceTest& test, const std::string& x, const std::string& y, Sepsets& sepsets, double alpha) {
+    auto batch_size = std::max(std::min(sepset_batch_size, test.native_batch_size()), static_cast<size_t>(1));
+    std::vector<std::vector<std::string>> batch;
+    batch.reserve(batch_size);
+
+    auto test_batch = [&]() -> std::optional<std::pair<std::vector<std::string>, double>> {
+        auto pvalues = profiled_pvalues(test, x, y, batch);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (pvalues[i] > alpha) return std::make_pair(std::move(batch[i]), pvalues[i]);
+        }
+
+        batch.clear();
+        return std::nullopt;
+    };
+
+    for (const auto& sepset : sepsets) {
+        batch.push_back(sepset);
+        if (batch.size() == batch_size) {
+            if (auto found = test_batch()) return found;
+        }
+    }
+
+    if (!batch.empty()) return test_batch();
+
+    return std::nullopt;
+}
+
+// Computes the marginal p-values of the pairs of variables. The pairs are tested in chunks of sepset_batch_size with
+// IndependenceTest::pvalues(), and the chunks are executed concurrently with num_threads threads.
+template <typename G>
+std::vector<double> marginal_pvalues(const IndependenceTest& test,
+                                     const G& g,
+                                     const std::vector<std::pair<int, int>>& pairs,
+                                     int num_threads,
+                                     util::BaseProgressBar& progress) {
+    // The names of the nodes are resolved to the indices of the test once, so the tests run with integer ids. The
+    // Python-derived tests are called with the names, as their index-based tests call the name-based tests.
+    std::vector<int> test_index;
+    if (!test.is_python_derived()) {
+        int max_index = -1;
+        for (const auto& pair : pairs) {
+            max_index = std::max({max_index, pair.first, pair.second});
+        }
+
+        test_index.resize(max_index + 1, -1);
+        for (const auto& pair : pairs) {
+            for (auto v : {pair.first, pair.second}) {
+                if (test_index[v] == -1) test_index[v] = test.index(g.name(v));
+            }
+        }
+    }
+
+    std::vector<double> pvalues(pairs.size());
+    auto num_chunks = static_cast<int>((pairs.size() + sepset_batch_size - 1) / sepset_batch_size);
+
+    util::parallel_for(0, num_chunks, num_threads, [&](int c, int) {
+        auto begin = c * sepset_batch_size;
+        auto end = std::min(begin + sepset_batch_size, pairs.size());
+
+        std::vector<double> chunk_pvalues;
+        if (test_index.empty()) {
+            std::vector<std::pair<std::string, std::string>> names;
+            names.reserve(end - begin);
+            for (auto k = begin; k < end; ++k) {
+                names.push_back({g.name(pairs[k].first), g.name(pairs[k].second)});
+            }
+
+            chunk_pvalues = profiled_pvalues(test, names, {});
+        } else {
+            std::vector<std::pair<int, int>> indices;
+            indices.reserve(end - begin);
+            for (auto k = begin; k < end; ++k) {
+                indices.push_back({test_index[pairs[k].first], test_index[pairs[k].second]});
+            }
+
+            chunk_pvalues = profiled_pvalues(test, indices, std::vector<int>{});
+        }
+
+        for (auto k = begin; k < end; ++k) {
+            pvalues[k] = chunk_pvalues[k - begin];
+            progress.tick();
+        }
+    });
+
+    return pvalues;
+}
+
 struct vstructure {
     int p1;
     int p2;
@@ -75,11 +264,6 @@ std::pair<int, int> count_univariate_sepsets(const G& g,
     const auto& p1_name = g.name(vs.p1);
     const auto& p2_name = g.name(vs.p2);
 
-    if (test.pvalue(p1_name, p2_name, g.name(vs.children)) > alpha) {
-        ++indep_sepsets;
-        ++children_in_sepsets;
-    }
-
     std::unordered_set<int> possible_sepset;
     const auto& np1 = g.raw_node(vs.p1);
     const auto& np2 = g.raw_node(vs.p2);
@@ -90,8 +274,23 @@ std::pair<int, int> count_univariate_sepsets(const G& g,
     possible_sepset.insert(np2.parents().begin(), np2.parents().end());
     possible_sepset.erase(vs.children);
 
+    // The first conditioning set is the children of the v-structure.
+    std::vector<std::vector<std::string>> sepsets;
+    sepsets.reserve(possible_sepset.size() + 1);
+    sepsets.push_back({g.name(vs.children)});
     for (auto sp : possible_sepset) {
-        if (test.pvalue(p1_name, p2_name, g.name(sp)) > alpha) {
+        sepsets.push_back({g.name(sp)});
+    }
+
+    auto pvalues = profiled_pvalues(test, p1_name, p2_name, sepsets);
+
+    if (pvalues[0] > alpha) {
+        ++indep_sepsets;
+        ++children_in_sepsets;
+    }
+
+    for (size_t i = 1; i < pvalues.size(); ++i) {
+        if (pvalues[i] > alpha) {
             ++indep_sepsets;
         }
     }
@@ -108,11 +307,17 @@ std::pair<int, int> count_multivariate_sepsets(
     const auto& p1_name = g.name(vs.p1);
     const auto& p2_name = g.name(vs.p2);
 
+    std::vector<std::vector<std::string>> sepsets;
     for (const auto& sepset : comb) {
-        double pvalue = test.pvalue(p1_name, p2_name, sepset);
-        if (pvalue > alpha) {
+        sepsets.push_back(sepset);
+    }
+
+    auto pvalues = profiled_pvalues(test, p1_name, p2_name, sepsets);
+
+    for (size_t i = 0; i < sepsets.size(); ++i) {
+        if (pvalues[i] > alpha) {
             ++indep_sepsets;
-            if (std::find(sepset.begin(), sepset.end(), g.name(vs.children)) != sepset.end()) {
+            if (std::find(sepsets[i].begin(), sepsets[i].end(), g.name(vs.children)) != sepsets[i].end()) {
                 ++children_in_sepsets;
             }
         }
@@ -127,7 +332,7 @@ bool is_unambiguous_vstructure(
     size_t max_sepset =
         std::max(g.num_neighbors(vs.p1) + g.num_parents(vs.p1), g.num_neighbors(vs.p2) + g.num_parents(vs.p2));
 
-    double marg_pvalue = test.pvalue(g.name(vs.p1), g.name(vs.p2));
+    double marg_pvalue = profiled_pvalue(test, g.name(vs.p1), g.name(vs.p2));
 
     int indep_sepsets = 0;
     int children_in_sepsets = 0;
@@ -352,8 +557,8 @@ void direct_unshielded_triples(G& pdag,
     }
 }
 
-template <typename T>
-bool any_intersect(const std::unordered_set<T>& s1, const std::unordered_set<T>& s2) {
+template <typename Set>
+bool any_intersect(const Set& s1, const Set& s2) {
     const auto& [smaller_set, greater_set] = [&s1, &s2]() {
         if (s1.size() <= s2.size()) {
             return std::make_pair(s1, s2);
@@ -369,9 +574,9 @@ bool any_intersect(const std::unordered_set<T>& s1, const std::unordered_set<T>&
     return false;
 }
 
-template <typename T>
-std::unordered_set<T> intersect(const std::unordered_set<T>& s1, const std::unordered_set<T>& s2) {
-    std::unordered_set<T> res;
+template <typename Set>
+Set intersect(const Set& s1, const Set& s2) {
+    Set res;
 
     const auto& [smaller_set, greater_set] = [&s1, &s2]() {
         if (s1.size() <= s2.size()) {
@@ -396,6 +601,11 @@ public:
     static bool rule2(G& pdag);
     template <typename G>
     static bool rule3(G& pdag);
+    // Applies the rules 1, 2 and 3 until no more edges can be directed. After the first pass over all the edges, only
+    // the edges incident to the nodes of the new arcs are evaluated again. The edges of each pass are evaluated
+    // concurrently with num_threads threads.
+    template <typename G>
+    static bool apply(G& pdag, int num_threads = 1);
 };
 
 template <typename G, typename T>
@@ -508,6 +718,86 @@ bool MeekRules::rule3(G& pdag) {
     return changed;
 }
 
+// Returns whether any Meek rule directs the edge source - target as source -> target.
+template <typename G>
+bool meek_directs_edge(const G& pdag, int source, int target) {
+    const auto& s = pdag.raw_node(source);
+    const auto& t = pdag.raw_node(target);
+
+    // Rule 1: a -> source - target, where a and target are not adjacent.
+    for (auto a : s.parents()) {
+        if (!pdag.has_connection_unsafe(a, target)) return true;
+    }
+
+    // Rule 2: source -> z -> target.
+    for (auto z : s.children()) {
+        if (t.parents().count(z) > 0) return true;
+    }
+
+    // Rule 3: source - z1 -> target and source - z2 -> target, where z1 and z2 are not adjacent.
+    std::vector<int> common;
+    for (auto z : s.neighbors()) {
+        if (t.parents().count(z) > 0) common.push_back(z);
+    }
+
+    for (size_t i = 0; i < common.size(); ++i) {
+        for (size_t j = i + 1; j < common.size(); ++j) {
+            if (!pdag.has_connection_unsafe(common[i], common[j])) return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename G>
+bool MeekRules::apply(G& pdag, int num_threads) {
+    std::vector<Edge> to_check;
+    for (const auto& edge : pdag.edge_indices()) {
+        to_check.push_back({std::min(edge.first, edge.second), std::max(edge.first, edge.second)});
+    }
+    std::sort(to_check.begin(), to_check.end());
+
+    bool changed = false;
+    while (!to_check.empty()) {
+        // The rules are evaluated on the same graph for all the edges, so the evaluation is read-only.
+        std::vector<Arc> candidates(to_check.size(), {-1, -1});
+        util::parallel_for(0, static_cast<int>(to_check.size()), num_threads, [&](int i, int) {
+            const auto& edge = to_check[i];
+            if (meek_directs_edge(pdag, edge.first, edge.second))
+                candidates[i] = {edge.first, edge.second};
+            else if (meek_directs_edge(pdag, edge.second, edge.first))
+                candidates[i] = {edge.second, edge.first};
+        });
+
+        // A previous arc of this pass can make a candidate invalid (e.g., rule 3 needs two edges), so the rules are
+        // checked again before directing the candidate.
+        std::vector<int> changed_nodes;
+        for (const auto& arc : candidates) {
+            if (arc.first == -1 || !pdag.has_edge_unsafe(arc.first, arc.second)) continue;
+
+            if (meek_directs_edge(pdag, arc.first, arc.second)) {
+                pdag.direct(arc.first, arc.second);
+                changed_nodes.push_back(arc.first);
+                changed_nodes.push_back(arc.second);
+            }
+        }
+
+        changed |= !changed_nodes.empty();
+
+        // A new arc x -> y can only change the rules of the edges incident to x or y.
+        to_check.clear();
+        for (auto node : changed_nodes) {
+            for (auto neighbor : pdag.neighbor_set(node)) {
+                to_check.push_back({std::min(node, neighbor), std::max(node, neighbor)});
+            }
+        }
+        std::sort(to_check.begin(), to_check.end());
+        to_check.erase(std::unique(to_check.begin(), to_check.end()), to_check.end());
+    }
+
+    return changed;
+}
+
 }  // namespace learning::algorithms
 
 #endif  // PYBNESIAN_LEARNING_ALGORITHMS_CONSTRAINT_HPP
\ No newline at end of file
@@ -1,7 +1,10 @@
+#include <future>
 #include <memory>
+#include <optional>
 #include <models/DynamicBayesianNetwork.hpp>
 #include <learning/algorithms/mmhc.hpp>
 #include <learning/algorithms/dmmhc.hpp>
+#include <util/parallel.hpp>
 #include <util/validate_options.hpp>
 
 using models::ConditionalBayesianNetwork, models::ConditionalGaussianNetwork, models::ConditionalSemiparametricBN;
@@ -43,7 +46,8 @@ std::shared_ptr<DynamicBayesianNetworkBase> DMMHC::estimate(const DynamicIndepen
                                                             double epsilon,
                                                             int patience,
                                                             double alpha,
-                                                            int verbose) {
+                                                            int verbose,
+                                                            int num_threads) {
     std::vector<std::string> vars;
     if (variables.empty())
         vars = test.variable_names();
@@ -61,9 +65,12 @@ std::shared_ptr<DynamicBayesianNetworkBase> DMMHC::estimate(const DynamicIndepen
     auto static_nodes = util::temporal_names(vars, 1, markovian_order);
     auto static_arc_blacklist = static_blacklist(vars, markovian_order);
     const auto& static_tests = test.static_tests();
-
     auto& static_score = score.static_score();
 
+    auto transition_nodes = util::temporal_names(vars, 0, 0);
+    const auto& transition_tests = test.transition_tests();
+    auto& transition_score = score.transition_score();
+
     ArcStringVector arc_blacklist;
     ArcStringVector arc_whitelist;
     EdgeStringVector edge_blacklist;
@@ -71,48 +78,89 @@ std::shared_ptr<DynamicBayesianNetworkBase> DMMHC::estimate(const DynamicIndepen
     FactorTypeVector type_blacklist;
     FactorTypeVector type_whitelist;
 
-    auto g0 = mmhc.estimate(static_tests,
-                            op_set,
-                            static_score,
-                            static_nodes,
-                            bn_type,
-                            static_arc_blacklist,
-                            arc_whitelist,
-                            edge_blacklist,
-                            edge_whitelist,
-                            type_blacklist,
-                            type_whitelist,
-                            static_callback,
-                            max_indegree,
-                            max_iters,
-                            epsilon,
-                            patience,
-                            alpha,
-                            verbose);
-
-    auto transition_nodes = util::temporal_names(vars, 0, 0);
-    const auto& transition_tests = test.transition_tests();
-    auto& transition_score = score.transition_score();
+    auto static_skeleton = [&](int threads) {
+        return mmhc.skeleton(static_tests,
+                             static_score,
+                             static_nodes,
+                             bn_type,
+                             static_arc_blacklist,
+                             arc_whitelist,
+                             edge_blacklist,
+                             edge_whitelist,
+                             type_blacklist,
+                             type_whitelist,
+                             alpha,
+                             verbose,
+                             threads);
+    };
+
+    auto transition_skeleton = [&](int threads) {
+        return mmhc.skeleton_conditional(transition_tests,
+                                         transition_score,
+                                         transition_nodes,
+                                         static_nodes,
+                                         bn_type,
+                                         arc_blacklist,
+                                         arc_whitelist,
+                                         edge_blacklist,
+                                         edge_whitelist,
+                                         type_blacklist,
+                                         type_whitelist,
+                                         alpha,
+                                         verbose,
+                                         threads);
+    };
+
+    // The MMPC phases of the static and transition networks are independent, so they are executed at the same time,
+    // each one with half of the threads: the static skeleton in a new thread and the transition skeleton in the calling
+    // thread. The Python objects can not be called without the GIL, so the phases are executed serially with them.
+    bool python_derived = static_tests.is_python_derived() || transition_tests.is_python_derived() ||
+                          static_score.is_python_derived() || transition_score.is_python_derived() ||
+                          bn_type.is_python_derived();
+
+    std::optional<MMHCSkeleton<BayesianNetworkBase>> s0;
+    std::optional<MMHCSkeleton<ConditionalBayesianNetworkBase>> st;
+    if (num_threads != 1 && !python_derived) {
+        int total_threads = util::effective_num_threads(num_threads);
+        int static_threads = std::max(1, total_threads / 2);
+        int transition_threads = std::max(1, total_threads - static_threads);
+
+        auto static_future = std::async(std::launch::async, static_skeleton, static_threads);
+        st = transition_skeleton(transition_threads);
+
+        util::gil_release_if_held release;
+        s0 = static_future.get();
+    } else {
+        s0 = static_skeleton(num_threads);
+        st = transition_skeleton(num_threads);
+    }
 
-    auto gt = mmhc.estimate_conditional(transition_tests,
-                                        op_set,
-                                        transition_score,
-                                        transition_nodes,
-                                        static_nodes,
-                                        bn_type,
-                                        arc_blacklist,
-                                        arc_whitelist,
-                                        edge_blacklist,
-                                        edge_whitelist,
-                                        type_blacklist,
-                                        type_whitelist,
-                                        transition_callback,
-                                        max_indegree,
-                                        max_iters,
-                                        epsilon,
-                                        patience,
-                                        alpha,
-                                        verbose);
+    // The hill-climbing searches share the operator set, so they are executed serially.
+    auto g0 = mmhc.search(op_set,
+                          static_score,
+                          *s0,
+                          type_blacklist,
+                          type_whitelist,
+                          static_callback,
+                          max_indegree,
+                          max_iters,
+                          epsilon,
+                          patience,
+                          verbose,
+                          num_threads);
+
+    auto gt = mmhc.search(op_set,
+                          transition_score,
+                          *st,
+                          type_blacklist,
+                          type_whitelist,
+                          transition_callback,
+                          max_indegree,
+                          max_iters,
+                          epsilon,
+                          patience,
+                          verbose,
+                          num_threads);
 
     return std::make_shared<DynamicBayesianNetwork>(vars, markovian_order, std::move(g0), std::move(gt));
 }
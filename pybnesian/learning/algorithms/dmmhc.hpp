@@ -14,6 +14,7 @@ namespace learning::algorithms {
 
 class DMMHC {
 public:
+    // With num_threads != 1, the MMPC phases of the static and the transition networks are executed at the same time.
     std::shared_ptr<DynamicBayesianNetworkBase> estimate(const DynamicIndependenceTest& test,
                                                          OperatorSet& op_set,
                                                          DynamicScore& score,
@@ -27,7 +28,8 @@ public:
                                                          double epsilon,
                                                          int patience,
                                                          double alpha,
-                                                         int verbose = 0);
+                                                         int verbose = 0,
+                                                         int num_threads = 1);
 };
 
 }  // namespace learning::algorithms
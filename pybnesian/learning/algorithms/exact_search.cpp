@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <learning/algorithms/exact_search.hpp>
+#include <util/parallel.hpp>
+#include <util/progress.hpp>
+#include <util/validate_whitelists.hpp>
+
+namespace learning::algorithms {
+
+namespace {
+
+using NodeSet = uint32_t;
+
+// Number of parent sets sent to Score::local_scores() in each call.
+constexpr size_t score_batch_size = 1024;
+// Number of node subsets processed by each task of the dynamic programming.
+constexpr size_t subsets_block_size = 1 << 16;
+
+int set_size(NodeSet set) { return static_cast<int>(std::bitset<32>(set).count()); }
+
+std::vector<std::string> set_names(NodeSet set, const std::vector<std::string>& nodes) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (set & (NodeSet{1} << i)) names.push_back(nodes[i]);
+    }
+    return names;
+}
+
+// The parent sets of a node that have a better score than all their subsets, sorted by decreasing score.
+struct ParentSets {
+    std::vector<NodeSet> sets;
+    std::vector<double> scores;
+
+    // Returns the index of the best parent set contained in allowed, or -1 if there is none.
+    int best(NodeSet allowed) const {
+        for (size_t i = 0; i < sets.size(); ++i) {
+            if ((sets[i] & ~allowed) == 0) return static_cast<int>(i);
+        }
+        return -1;
+    }
+};
+
+// Calls f(set) for each subset of k elements of candidates.
+template <typename F>
+void for_each_combination(const std::vector<int>& candidates, int k, F&& f) {
+    int n = candidates.size();
+    if (k > n) return;
+
+    std::vector<int> indices(k);
+    std::iota(indices.begin(), indices.end(), 0);
+    while (true) {
+        NodeSet set = 0;
+        for (auto i : indices) set |= NodeSet{1} << candidates[i];
+        f(set);
+
+        int i = k - 1;
+        while (i >= 0 && indices[i] == n - k + i) --i;
+        if (i < 0) return;
+
+        ++indices[i];
+        for (int j = i + 1; j < k; ++j) indices[j] = indices[j - 1] + 1;
+    }
+}
+
+// Caches the local scores of the parent sets of the node v that contain the required parents, and only other parents
+// in candidates. The parent sets are evaluated by increasing size, so each parent set is only compared with its subsets
+// that were not pruned: if a pruned subset is better, a subset of that subset is also better.
+ParentSets cache_parent_sets(const BayesianNetworkBase& model,
+                             const Score& score,
+                             const std::vector<std::string>& nodes,
+                             int v,
+                             NodeSet required,
+                             NodeSet candidates,
+                             int max_indegree) {
+    std::vector<int> candidate_indices;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (candidates & (NodeSet{1} << i)) candidate_indices.push_back(i);
+    }
+
+    int max_size = candidate_indices.size();
+    if (max_indegree > 0) max_size = std::min(max_size, max_indegree - set_size(required));
+
+    std::vector<std::pair<NodeSet, double>> kept;
+    std::vector<NodeSet> batch;
+    std::vector<std::vector<std::string>> batch_parents;
+
+    auto flush = [&]() {
+        auto scores = score.local_scores(model, nodes[v], batch_parents);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (std::isnan(scores[i])) continue;
+
+            auto dominated = std::any_of(kept.begin(), kept.end(), [&](const auto& k) {
+                return (k.first & ~batch[i]) == 0 && k.second >= scores[i];
+            });
+
+            if (!dominated) kept.emplace_back(batch[i], scores[i]);
+        }
+
+        batch.clear();
+        batch_parents.clear();
+    };
+
+    for (int k = 0; k <= max_size; ++k) {
+        for_each_combination(candidate_indices, k, [&](NodeSet set) {
+            batch.push_back(set | required);
+            batch_parents.push_back(set_names(set | required, nodes));
+            if (batch.size() == score_batch_size) flush();
+        });
+
+        // The parent sets of the same size are not subsets of each other, so they can be evaluated together.
+        if (!batch.empty()) flush();
+    }
+
+    // Ties are broken by the order of evaluation, so the smallest parent sets are preferred.
+    std::stable_sort(kept.begin(), kept.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+    ParentSets res;
+    for (const auto& k : kept) {
+        res.sets.push_back(k.first);
+        res.scores.push_back(k.second);
+    }
+
+    return res;
+}
+
+}  // namespace
+
+std::shared_ptr<BayesianNetworkBase> ExactSearch::estimate(Score& score,
+                                                           const std::vector<std::string>& nodes,
+                                                           const BayesianNetworkType& bn_type,
+                                                           const ArcStringVector& arc_blacklist,
+                                                           const ArcStringVector& arc_whitelist,
+                                                           int max_indegree,
+                                                           int verbose,
+                                                           int num_threads) const {
+    if (!bn_type.is_homogeneous())
+        throw std::invalid_argument("ExactSearch requires a homogeneous Bayesian network type.");
+    if (max_indegree < 0) throw std::invalid_argument("max_indegree must be a non-negative number.");
+
+    std::vector<std::string> model_nodes = nodes;
+    if (model_nodes.empty())
+        model_nodes = score.data().column_names();
+    else if (!score.has_variables(model_nodes))
+        throw std::invalid_argument("Score do not contain all the variables in nodes list.");
+
+    int num_nodes = model_nodes.size();
+    if (num_nodes > max_nodes) {
+        throw std::invalid_argument("ExactSearch supports up to " + std::to_string(max_nodes) +
+                                    " nodes, but there are " + std::to_string(num_nodes) + " nodes.");
+    }
+
+    auto model = bn_type.new_bn(model_nodes);
+    if (!score.compatible_bn(*model)) throw std::invalid_argument("BayesianNetwork is not compatible with the score.");
+
+    auto restrictions = util::validate_restrictions(*model, arc_blacklist, arc_whitelist);
+
+    std::unordered_map<std::string, int> positions;
+    for (int i = 0; i < num_nodes; ++i) {
+        positions.insert({model_nodes[i], i});
+    }
+
+    NodeSet all_nodes = (NodeSet{1} << num_nodes) - 1;
+    std::vector<NodeSet> required(num_nodes, 0);
+    std::vector<NodeSet> candidates(num_nodes);
+    for (int v = 0; v < num_nodes; ++v) {
+        candidates[v] = all_nodes & ~(NodeSet{1} << v);
+    }
+
+    for (const auto& arc : restrictions.arc_blacklist) {
+        auto s = positions.at(model->name(arc.first));
+        auto t = positions.at(model->name(arc.second));
+        candidates[t] &= ~(NodeSet{1} << s);
+    }
+
+    for (const auto& arc : restrictions.arc_whitelist) {
+        auto s = positions.at(model->name(arc.first));
+        auto t = positions.at(model->name(arc.second));
+        required[t] |= NodeSet{1} << s;
+        candidates[t] &= ~(NodeSet{1} << s);
+    }
+
+    for (int v = 0; v < num_nodes; ++v) {
+        if (max_indegree > 0 && set_size(required[v]) > max_indegree) {
+            throw std::invalid_argument("The arc whitelist contains more than max_indegree parents for node " +
+                                        model_nodes[v] + ".");
+        }
+    }
+
+    bool python_derived = score.is_python_derived() || model->has_python_derived();
+    util::gil_release_if_held release(!python_derived);
+    auto threads = python_derived ? 1 : num_threads;
+
+    auto spinner = util::indeterminate_spinner(verbose);
+    spinner->update_status("Caching the scores of the parent sets...");
+
+    std::vector<ParentSets> parent_sets(num_nodes);
+    util::parallel_for(0, num_nodes, threads, [&](int v, int) {
+        parent_sets[v] =
+            cache_parent_sets(*model, score, model_nodes, v, required[v], candidates[v], max_indegree);
+    });
+
+    spinner->update_status("Finding the optimal sink of each subset of nodes...");
+
+    // best_score[S] is the score of the best DAG over the nodes of S, where the parents of the nodes must be in S, and
+    // sink[S] is the node of S without children in that DAG. The subsets of each size only depend on the smaller
+    // subsets, so they are processed in parallel.
+    size_t num_subsets = size_t{1} << num_nodes;
+    std::vector<double> best_score(num_subsets, -std::numeric_limits<double>::infinity());
+    std::vector<int8_t> sink(num_subsets, -1);
+    best_score[0] = 0;
+
+    int num_blocks = (num_subsets + subsets_block_size - 1) / subsets_block_size;
+    for (int size = 1; size <= num_nodes; ++size) {
+        util::parallel_for(0, num_blocks, threads, [&](int block, int) {
+            auto begin = block * subsets_block_size;
+            auto end = std::min(num_subsets, begin + subsets_block_size);
+            for (auto s = begin; s < end; ++s) {
+                auto set = static_cast<NodeSet>(s);
+                if (set_size(set) != size) continue;
+
+                for (int v = 0; v < num_nodes; ++v) {
+                    NodeSet bit = NodeSet{1} << v;
+                    if (!(set & bit)) continue;
+
+                    auto rest = set & ~bit;
+                    if (best_score[rest] == -std::numeric_limits<double>::infinity()) continue;
+
+                    auto best = parent_sets[v].best(rest);
+                    if (best == -1) continue;
+
+                    auto candidate = best_score[rest] + parent_sets[v].scores[best];
+                    if (candidate > best_score[set]) {
+                        best_score[set] = candidate;
+                        sink[set] = v;
+                    }
+                }
+            }
+        });
+    }
+
+    if (num_nodes > 0 && sink[all_nodes] == -1) {
+        throw std::invalid_argument(
+            "There is no DAG compatible with the arc whitelist, the arc blacklist and max_indegree.");
+    }
+
+    spinner->update_status("Building the optimal DAG...");
+
+    for (NodeSet set = all_nodes; set != 0;) {
+        int v = sink[set];
+        set &= ~(NodeSet{1} << v);
+
+        const auto& node_sets = parent_sets[v];
+        for (const auto& parent : set_names(node_sets.sets[node_sets.best(set)], model_nodes)) {
+            model->add_arc_unsafe(parent, model_nodes[v]);
+        }
+    }
+
+    spinner->mark_as_completed("Finished ExactSearch!");
+    return model;
+}
+
+}  // namespace learning::algorithms
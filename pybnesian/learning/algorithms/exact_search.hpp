@@ -0,0 +1,36 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_EXACT_SEARCH_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_EXACT_SEARCH_HPP
+
+#include <models/BayesianNetwork.hpp>
+#include <learning/scores/scores.hpp>
+
+using learning::scores::Score;
+using models::BayesianNetworkBase, models::BayesianNetworkType;
+using util::ArcStringVector;
+
+namespace learning::algorithms {
+
+// Finds the DAG with the optimal (decomposable) score by dynamic programming over the subsets of nodes, as in
+// T. Silander and P. Myllymäki (2006). A simple approach for finding the globally optimal Bayesian network structure.
+//
+// The local scores of the parent sets of each node are cached in parallel. A parent set is pruned if one of its subsets
+// has a better (or equal) score, because it can be replaced by the subset without creating cycles. Then, the best DAG
+// of each subset of nodes is found from the best DAGs of its subsets, so the time and memory are exponential in the
+// number of nodes (9 * 2^n bytes).
+class ExactSearch {
+public:
+    static constexpr int max_nodes = 30;
+
+    std::shared_ptr<BayesianNetworkBase> estimate(Score& score,
+                                                  const std::vector<std::string>& nodes,
+                                                  const BayesianNetworkType& bn_type,
+                                                  const ArcStringVector& arc_blacklist,
+                                                  const ArcStringVector& arc_whitelist,
+                                                  int max_indegree = 0,
+                                                  int verbose = 0,
+                                                  int num_threads = 1) const;
+};
+
+}  // namespace learning::algorithms
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_EXACT_SEARCH_HPP
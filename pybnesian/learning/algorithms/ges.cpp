@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <learning/algorithms/ges.hpp>
+#include <util/math_constants.hpp>
+#include <util/parallel.hpp>
+#include <util/progress.hpp>
+
+namespace learning::algorithms {
+
+namespace {
+
+// Insert(x, y, subset) or Delete(x, y, subset) operator of GES. subset is the set T of the Insert operator or the set H
+// of the Delete operator.
+struct GESOperator {
+    int x;
+    int y;
+    std::vector<int> subset;
+    double delta;
+
+    std::string ToString(const PartiallyDirectedGraph& g, bool insert) const {
+        std::string res = std::string(insert ? "Insert(" : "Delete(") + g.name(x) + ", " + g.name(y) + ", {";
+        for (size_t i = 0; i < subset.size(); ++i) {
+            if (i > 0) res += ", ";
+            res += g.name(subset[i]);
+        }
+        return res + "}) | Delta: " + std::to_string(delta);
+    }
+};
+
+bool is_clique(const PartiallyDirectedGraph& g, const std::vector<int>& nodes) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        for (size_t j = i + 1; j < nodes.size(); ++j) {
+            if (!g.has_connection_unsafe(nodes[i], nodes[j])) return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if every semi-directed path from source to target contains a node in blocked.
+bool blocks_semidirected_paths(const PartiallyDirectedGraph& g,
+                               int source,
+                               int target,
+                               const std::vector<int>& blocked) {
+    std::vector<char> visited(g.num_raw_nodes(), false);
+    for (auto b : blocked) visited[b] = true;
+
+    std::vector<int> stack{source};
+    visited[source] = true;
+
+    while (!stack.empty()) {
+        auto node = stack.back();
+        stack.pop_back();
+
+        for (const auto& adjacents : {std::cref(g.children_set(node)), std::cref(g.neighbor_set(node))}) {
+            for (auto adj : adjacents.get()) {
+                if (adj == target) return false;
+                if (!visited[adj]) {
+                    visited[adj] = true;
+                    stack.push_back(adj);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+class GESState {
+public:
+    GESState(const BayesianNetworkBase& model,
+             Score& score,
+             LocalScoreMemo& memo,
+             const PartiallyDirectedGraph& g,
+             const std::vector<char>& edge_blacklist)
+        : m_model(model), m_score(score), m_memo(memo), m_g(g), m_edge_blacklist(edge_blacklist) {}
+
+    // Best Insert(x, y, T) operator with target y.
+    std::optional<GESOperator> best_insert(int y) const {
+        std::optional<GESOperator> best;
+
+        auto num_nodes = m_g.num_nodes();
+        std::vector<int> parents(m_g.parent_set(y).begin(), m_g.parent_set(y).end());
+
+        for (int x = 0; x < num_nodes; ++x) {
+            if (x == y || m_g.has_connection_unsafe(x, y) || m_edge_blacklist[x * num_nodes + y]) continue;
+
+            std::vector<int> na, candidates;
+            for (auto n : m_g.neighbor_set(y)) {
+                if (m_g.has_connection_unsafe(n, x))
+                    na.push_back(n);
+                else
+                    candidates.push_back(n);
+            }
+
+            if (!is_clique(m_g, na)) continue;
+
+            std::vector<int> t;
+            enumerate_insert(x, y, parents, na, candidates, 0, t, best);
+        }
+
+        return best;
+    }
+
+    // Best Delete(x, y, H) operator with target y.
+    std::optional<GESOperator> best_delete(int y) const {
+        std::optional<GESOperator> best;
+
+        std::vector<int> adjacents(m_g.parent_set(y).begin(), m_g.parent_set(y).end());
+        adjacents.insert(adjacents.end(), m_g.neighbor_set(y).begin(), m_g.neighbor_set(y).end());
+
+        for (auto x : adjacents) {
+            std::vector<int> na;
+            for (auto n : m_g.neighbor_set(y)) {
+                if (n != x && m_g.has_connection_unsafe(n, x)) na.push_back(n);
+            }
+
+            if (na.size() >= 31)
+                throw std::runtime_error("GES can not enumerate the Delete operators of " + m_g.name(x) + " -> " +
+                                         m_g.name(y) + ": too many common neighbors.");
+
+            std::vector<int> base;
+            for (auto p : m_g.parent_set(y)) {
+                if (p != x) base.push_back(p);
+            }
+
+            for (unsigned int mask = 0, end = 1u << na.size(); mask < end; ++mask) {
+                std::vector<int> h, rest;
+                for (size_t i = 0; i < na.size(); ++i) {
+                    if ((mask >> i) & 1)
+                        h.push_back(na[i]);
+                    else
+                        rest.push_back(na[i]);
+                }
+
+                if (!is_clique(m_g, rest)) continue;
+
+                auto parents = base;
+                parents.insert(parents.end(), rest.begin(), rest.end());
+                auto prev_score = local_score(y, parents, x);
+                auto delta = local_score(y, parents) - prev_score;
+
+                if (!best || delta > best->delta) best = GESOperator{x, y, std::move(h), delta};
+            }
+        }
+
+        return best;
+    }
+
+private:
+    // Enumerates each set t (extended with candidates[k...]) such that na U t is a clique.
+    void enumerate_insert(int x,
+                          int y,
+                          const std::vector<int>& parents,
+                          const std::vector<int>& na,
+                          const std::vector<int>& candidates,
+                          size_t k,
+                          std::vector<int>& t,
+                          std::optional<GESOperator>& best) const {
+        auto new_parents = parents;
+        new_parents.insert(new_parents.end(), na.begin(), na.end());
+        new_parents.insert(new_parents.end(), t.begin(), t.end());
+
+        auto delta = local_score(y, new_parents, x) - local_score(y, new_parents);
+
+        // The semi-directed paths are only checked if the operator improves the current best.
+        if (!best || delta > best->delta) {
+            std::vector<int> blocked = na;
+            blocked.insert(blocked.end(), t.begin(), t.end());
+
+            if (blocks_semidirected_paths(m_g, y, x, blocked)) best = GESOperator{x, y, t, delta};
+        }
+
+        for (auto i = k; i < candidates.size(); ++i) {
+            auto c = candidates[i];
+
+            bool clique = std::all_of(na.begin(), na.end(), [&](int n) { return m_g.has_connection_unsafe(n, c); }) &&
+                          std::all_of(t.begin(), t.end(), [&](int n) { return m_g.has_connection_unsafe(n, c); });
+
+            if (clique) {
+                t.push_back(c);
+                enumerate_insert(x, y, parents, na, candidates, i + 1, t, best);
+                t.pop_back();
+            }
+        }
+    }
+
+    // Local score of y with parents (and extra, if it is not -1). The parents are sorted by index, so every parent set
+    // has a unique key in the memo.
+    double local_score(int y, std::vector<int> parents, int extra = -1) const {
+        if (extra != -1) parents.push_back(extra);
+        std::sort(parents.begin(), parents.end());
+
+        std::vector<std::string> parent_names;
+        parent_names.reserve(parents.size());
+        for (auto p : parents) parent_names.push_back(m_g.name(p));
+
+        return m_memo.local_score(m_model, m_score, m_g.name(y), parent_names);
+    }
+
+    const BayesianNetworkBase& m_model;
+    Score& m_score;
+    LocalScoreMemo& m_memo;
+    const PartiallyDirectedGraph& m_g;
+    const std::vector<char>& m_edge_blacklist;
+};
+
+// Returns the best operator of all the targets. The ties are broken by target index, so the result does not depend on
+// the number of threads.
+template <typename F>
+std::optional<GESOperator> best_operator(int num_nodes, int num_threads, F&& best_target) {
+    std::vector<std::optional<GESOperator>> best_ops(num_nodes);
+    util::parallel_for(0, num_nodes, num_threads, [&](int y, int) { best_ops[y] = best_target(y); });
+
+    std::optional<GESOperator> best;
+    for (auto& op : best_ops) {
+        if (op && (!best || op->delta > best->delta)) best = std::move(op);
+    }
+
+    return best;
+}
+
+}  // namespace
+
+PartiallyDirectedGraph GES::estimate_cpdag(Score& score,
+                                           const std::vector<std::string>& nodes,
+                                           const BayesianNetworkType& bn_type,
+                                           const EdgeStringVector& edge_blacklist,
+                                           double epsilon,
+                                           int verbose,
+                                           int num_threads,
+                                           const std::shared_ptr<LocalScoreMemo> score_memo) const {
+    if (!bn_type.is_homogeneous()) throw std::invalid_argument("GES requires a homogeneous Bayesian network type.");
+
+    std::vector<std::string> model_nodes = nodes;
+    if (model_nodes.empty())
+        model_nodes = score.data().column_names();
+    else if (!score.has_variables(model_nodes))
+        throw std::invalid_argument("Score do not contain all the variables in nodes list.");
+
+    auto model = bn_type.new_bn(model_nodes);
+    if (!score.compatible_bn(*model)) throw std::invalid_argument("BayesianNetwork is not compatible with the score.");
+
+    util::gil_release_if_held release(!score.is_python_derived() && !model->has_python_derived());
+
+    LocalScoreMemo own_memo;
+    if (score_memo) score_memo->check_score(score);
+    auto& memo = score_memo ? *score_memo : own_memo;
+
+    PartiallyDirectedGraph g(model_nodes);
+    auto num_nodes = g.num_nodes();
+
+    std::vector<char> blacklist(num_nodes * num_nodes, false);
+    for (const auto& edge : edge_blacklist) {
+        auto s = g.check_index(edge.first);
+        auto t = g.check_index(edge.second);
+        blacklist[s * num_nodes + t] = true;
+        blacklist[t * num_nodes + s] = true;
+    }
+
+    auto spinner = util::indeterminate_spinner(verbose);
+    spinner->update_status("Forward equivalence search...");
+
+    // Forward phase: inserts edges while the score improves.
+    while (true) {
+        GESState state(*model, score, memo, g, blacklist);
+        auto best = best_operator(num_nodes, num_threads, [&state](int y) { return state.best_insert(y); });
+
+        if (!best || (best->delta - epsilon) < util::machine_tol) break;
+
+        g.add_arc_unsafe(best->x, best->y);
+        for (auto t : best->subset) g.direct_unsafe(t, best->y);
+
+        g = g.to_dag().to_pdag();
+        spinner->lazy_update_status([&] { return best->ToString(g, true); });
+    }
+
+    spinner->update_status("Backward equivalence search...");
+
+    // Backward phase: deletes edges while the score improves.
+    while (true) {
+        GESState state(*model, score, memo, g, blacklist);
+        auto best = best_operator(num_nodes, num_threads, [&state](int y) { return state.best_delete(y); });
+
+        if (!best || (best->delta - epsilon) < util::machine_tol) break;
+
+        if (g.has_arc_unsafe(best->x, best->y))
+            g.remove_arc_unsafe(best->x, best->y);
+        else
+            g.remove_edge_unsafe(best->x, best->y);
+
+        for (auto h : best->subset) {
+            g.direct_unsafe(best->y, h);
+            if (g.has_edge_unsafe(best->x, h)) g.direct_unsafe(best->x, h);
+        }
+
+        g = g.to_dag().to_pdag();
+        spinner->lazy_update_status([&] { return best->ToString(g, false); });
+    }
+
+    spinner->mark_as_completed("Finished GES!");
+    return g;
+}
+
+std::shared_ptr<BayesianNetworkBase> GES::estimate(Score& score,
+                                                   const std::vector<std::string>& nodes,
+                                                   const BayesianNetworkType& bn_type,
+                                                   const EdgeStringVector& edge_blacklist,
+                                                   double epsilon,
+                                                   int verbose,
+                                                   int num_threads,
+                                                   const std::shared_ptr<LocalScoreMemo> score_memo) const {
+    auto cpdag = estimate_cpdag(score, nodes, bn_type, edge_blacklist, epsilon, verbose, num_threads, score_memo);
+    auto dag = cpdag.to_dag();
+
+    auto model = bn_type.new_bn(dag.nodes());
+    for (const auto& arc : dag.arcs()) {
+        model->add_arc_unsafe(arc.first, arc.second);
+    }
+
+    return model;
+}
+
+}  // namespace learning::algorithms
@@ -0,0 +1,43 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_GES_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_GES_HPP
+
+#include <graph/generic_graph.hpp>
+#include <models/BayesianNetwork.hpp>
+#include <learning/scores/scores.hpp>
+#include <learning/operators/operators.hpp>
+
+using graph::PartiallyDirectedGraph;
+using learning::operators::LocalScoreMemo;
+using learning::scores::Score;
+using models::BayesianNetworkBase, models::BayesianNetworkType;
+using util::EdgeStringVector;
+
+namespace learning::algorithms {
+
+// Greedy equivalence search by D.M. Chickering (2002). Optimal Structure Identification With Greedy Search. The search
+// is performed over the space of CPDAGs, so it never spends iterations on score-equivalent changes (such as reversing
+// a reversible arc). The score must be score-equivalent (e.g. BIC or BGe) and decomposable.
+class GES {
+public:
+    std::shared_ptr<BayesianNetworkBase> estimate(Score& score,
+                                                  const std::vector<std::string>& nodes,
+                                                  const BayesianNetworkType& bn_type,
+                                                  const EdgeStringVector& edge_blacklist,
+                                                  double epsilon,
+                                                  int verbose = 0,
+                                                  int num_threads = 1,
+                                                  const std::shared_ptr<LocalScoreMemo> score_memo = nullptr) const;
+
+    PartiallyDirectedGraph estimate_cpdag(Score& score,
+                                          const std::vector<std::string>& nodes,
+                                          const BayesianNetworkType& bn_type,
+                                          const EdgeStringVector& edge_blacklist,
+                                          double epsilon,
+                                          int verbose = 0,
+                                          int num_threads = 1,
+                                          const std::shared_ptr<LocalScoreMemo> score_memo = nullptr) const;
+};
+
+}  // namespace learning::algorithms
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_GES_HPP
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <random>
+#include <set>
 #include <learning/algorithms/hillclimbing.hpp>
 #include <util/validate_options.hpp>
 #include <dataset/dataset.hpp>
@@ -10,6 +13,8 @@
 #include <learning/scores/cv_likelihood.hpp>
 #include <learning/scores/holdout_likelihood.hpp>
 #include <learning/operators/operators.hpp>
+#include <util/parallel.hpp>
+#include <util/progress.hpp>
 
 using namespace dataset;
 
@@ -40,7 +45,9 @@ std::shared_ptr<BayesianNetworkBase> hc(const DataFrame& df,
                                         std::optional<unsigned int> seed,
                                         int num_folds,
                                         double test_holdout_ratio,
-                                        int verbose) {
+                                        int verbose,
+                                        int num_threads,
+                                        int batch_operators) {
     if (!bn_type && !start) {
         throw std::invalid_argument("\"bn_type\" or \"start\" parameter must be specified.");
     }
@@ -86,7 +93,193 @@ std::shared_ptr<BayesianNetworkBase> hc(const DataFrame& df,
                        max_iters,
                        epsilon,
                        patience,
-                       verbose);
+                       verbose,
+                       num_threads,
+                       nullptr,
+                       std::nullopt,
+                       1,
+                       nullptr,
+                       batch_operators);
+}
+
+namespace {
+
+// Returns a bootstrap resample of df: df.num_rows() rows drawn with replacement.
+DataFrame bootstrap_resample(const DataFrame& df, std::mt19937& rng) {
+    auto num_rows = df->num_rows();
+    std::uniform_int_distribution<int64_t> dist(0, num_rows - 1);
+
+    arrow::AdaptiveIntBuilder builder;
+    RAISE_STATUS_ERROR(builder.Reserve(num_rows));
+    for (int64_t i = 0; i < num_rows; ++i) {
+        RAISE_STATUS_ERROR(builder.Append(dist(rng)));
+    }
+
+    Array_ptr indices;
+    RAISE_STATUS_ERROR(builder.Finish(&indices));
+    return df.take(indices);
+}
+
+// Returns a random DAG with the arc_whitelist and, on average, one random parent for each node. The random arcs follow
+// a random topological order and they respect the arc_blacklist, the max_indegree and the arc restrictions of the
+// model type.
+std::shared_ptr<BayesianNetworkBase> random_start_model(const BayesianNetworkType& bn_type,
+                                                        const DataFrame& df,
+                                                        const ArcStringVector& arc_blacklist,
+                                                        const ArcStringVector& arc_whitelist,
+                                                        const FactorTypeVector& type_blacklist,
+                                                        const FactorTypeVector& type_whitelist,
+                                                        int max_indegree,
+                                                        std::mt19937& rng) {
+    auto nodes = df.column_names();
+    auto model = bn_type.new_bn(nodes);
+
+    // The node types can restrict the arcs of the model (see BayesianNetworkType::can_have_arc()).
+    model->force_type_whitelist(type_whitelist);
+    if (model->has_unknown_node_types()) model->set_unknown_node_types(df, type_blacklist);
+
+    model->force_whitelist(arc_whitelist);
+
+    std::set<std::pair<std::string, std::string>> blacklist(arc_blacklist.begin(), arc_blacklist.end());
+
+    std::shuffle(nodes.begin(), nodes.end(), rng);
+    auto p = (nodes.size() > 1) ? std::min(1., 2. / (nodes.size() - 1)) : 0.;
+    std::bernoulli_distribution add_arc(p);
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        for (size_t j = i + 1; j < nodes.size(); ++j) {
+            if (!add_arc(rng)) continue;
+
+            const auto& source = nodes[i];
+            const auto& target = nodes[j];
+
+            if (blacklist.count({source, target}) > 0) continue;
+            if (max_indegree > 0 && model->num_parents(target) >= max_indegree) continue;
+            if (model->has_arc(source, target) || !model->can_add_arc(source, target)) continue;
+
+            model->add_arc_unsafe(source, target);
+        }
+    }
+
+    return model;
+}
+
+}  // namespace
+
+std::map<std::pair<std::string, std::string>, double> bootstrap_hc(
+    const DataFrame& df,
+    const std::shared_ptr<BayesianNetworkType> bn_type,
+    int num_samples,
+    bool bootstrap,
+    bool random_start,
+    const std::optional<std::string>& score_str,
+    const std::optional<std::vector<std::string>>& operators_str,
+    const ArcStringVector& arc_blacklist,
+    const ArcStringVector& arc_whitelist,
+    const FactorTypeVector& type_blacklist,
+    const FactorTypeVector& type_whitelist,
+    int max_indegree,
+    int max_iters,
+    double epsilon,
+    int patience,
+    std::optional<unsigned int> seed,
+    int num_folds,
+    double test_holdout_ratio,
+    int verbose,
+    int num_threads) {
+    if (!bn_type) throw std::invalid_argument("\"bn_type\" parameter must be specified.");
+    if (num_samples <= 0) throw std::invalid_argument("num_samples must be a positive number.");
+    if (!bootstrap && !random_start)
+        throw std::invalid_argument("\"bootstrap\" or \"random_start\" must be True to obtain different structures.");
+    if (df->num_rows() == 0) throw std::invalid_argument("The DataFrame is empty.");
+
+    auto iseed = [seed]() {
+        if (seed)
+            return *seed;
+        else
+            return std::random_device{}();
+    }();
+
+    // Checks the options before starting the searches.
+    util::check_valid_operators(*bn_type, operators_str, arc_blacklist, arc_whitelist, max_indegree, type_whitelist);
+    util::check_valid_score(df, *bn_type, score_str, iseed, num_folds, test_holdout_ratio);
+
+    if (max_iters == 0) max_iters = std::numeric_limits<int>::max();
+
+    // The Python objects can not be used without the GIL, so the searches are executed serially.
+    auto python_types = bn_type->is_python_derived() ||
+                        std::any_of(type_blacklist.begin(),
+                                    type_blacklist.end(),
+                                    [](const auto& p) { return p.second->is_python_derived(); }) ||
+                        std::any_of(type_whitelist.begin(), type_whitelist.end(), [](const auto& p) {
+                            return p.second->is_python_derived();
+                        });
+    if (python_types) num_threads = 1;
+
+    auto progress = util::progress_bar(verbose);
+    progress->set_text("Bootstrap hill-climbing");
+    progress->set_max_progress(num_samples);
+    progress->set_progress(0);
+    std::mutex progress_mutex;
+
+    // The seed of each search depends only on its index, so the result does not depend on the number of threads.
+    std::vector<ArcStringVector> learned_arcs(num_samples);
+    util::parallel_for(0, num_samples, num_threads, [&](int i, int) {
+        std::mt19937 rng(iseed + i);
+
+        auto sample_df = bootstrap ? bootstrap_resample(df, rng) : df;
+
+        auto start = [&]() {
+            if (random_start)
+                return random_start_model(*bn_type,
+                                          sample_df,
+                                          arc_blacklist,
+                                          arc_whitelist,
+                                          type_blacklist,
+                                          type_whitelist,
+                                          max_indegree,
+                                          rng);
+            else
+                return bn_type->new_bn(sample_df.column_names());
+        }();
+
+        auto operators = util::check_valid_operators(
+            *bn_type, operators_str, arc_blacklist, arc_whitelist, max_indegree, type_whitelist);
+        auto score = util::check_valid_score(sample_df, *bn_type, score_str, iseed + i, num_folds, test_holdout_ratio);
+
+        GreedyHillClimbing hc;
+        auto model = hc.estimate(*operators,
+                                 *score,
+                                 *start,
+                                 arc_blacklist,
+                                 arc_whitelist,
+                                 type_blacklist,
+                                 type_whitelist,
+                                 nullptr,
+                                 max_indegree,
+                                 max_iters,
+                                 epsilon,
+                                 patience);
+
+        learned_arcs[i] = model->arcs();
+
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        progress->tick();
+    });
+
+    std::map<std::pair<std::string, std::string>, double> frequencies;
+    for (const auto& arcs : learned_arcs) {
+        for (const auto& arc : arcs) {
+            frequencies[arc] += 1;
+        }
+    }
+
+    for (auto& f : frequencies) {
+        f.second /= num_samples;
+    }
+
+    progress->mark_as_completed("Finished bootstrap hill-climbing!");
+    return frequencies;
 }
 
 }  // namespace learning::algorithms
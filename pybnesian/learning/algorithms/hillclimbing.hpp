@@ -1,13 +1,18 @@
 #ifndef PYBNESIAN_LEARNING_ALGORITHMS_HILLCLIMBING_HPP
 #define PYBNESIAN_LEARNING_ALGORITHMS_HILLCLIMBING_HPP
 
+#include <map>
+#include <unordered_set>
 #include <dataset/dataset.hpp>
 #include <models/BayesianNetwork.hpp>
 #include <learning/scores/scores.hpp>
 #include <learning/operators/operators.hpp>
 #include <learning/algorithms/callbacks/callback.hpp>
+#include <learning/algorithms/checkpoint.hpp>
 #include <util/validate_whitelists.hpp>
 #include <util/math_constants.hpp>
+#include <util/parallel.hpp>
+#include <util/profiler.hpp>
 #include <util/progress.hpp>
 #include <util/vector.hpp>
 
@@ -15,8 +20,9 @@ namespace py = pybind11;
 
 using dataset::DataFrame;
 using learning::algorithms::callbacks::Callback;
-using learning::operators::Operator, learning::operators::ArcOperator, learning::operators::ChangeNodeType,
-    learning::operators::OperatorTabuSet, learning::operators::OperatorSet, learning::operators::LocalScoreCache;
+using learning::operators::Operator, learning::operators::ArcOperator, learning::operators::AddArc,
+    learning::operators::FlipArc, learning::operators::ChangeNodeType, learning::operators::OperatorTabuSet,
+    learning::operators::OperatorSet, learning::operators::LocalScoreCache, learning::operators::LocalScoreMemo;
 using learning::scores::Score;
 using models::BayesianNetworkType, models::ConditionalBayesianNetworkBase;
 
@@ -41,7 +47,35 @@ std::shared_ptr<BayesianNetworkBase> hc(const DataFrame& df,
                                         std::optional<unsigned int> seed,
                                         int num_folds,
                                         double test_holdout_ratio,
-                                        int verbose = 0);
+                                        int verbose = 0,
+                                        int num_threads = 1,
+                                        int batch_operators = 1);
+
+// Executes num_samples independent greedy hill-climbing searches and returns the frequency of each arc in the learned
+// structures. If bootstrap is true, each search learns from a bootstrap resample of df. If random_start is true, each
+// search starts from a random DAG. The searches are executed concurrently, but the result does not depend on the
+// number of threads.
+std::map<std::pair<std::string, std::string>, double> bootstrap_hc(
+    const DataFrame& df,
+    const std::shared_ptr<BayesianNetworkType> bn_type,
+    int num_samples,
+    bool bootstrap,
+    bool random_start,
+    const std::optional<std::string>& score_str,
+    const std::optional<std::vector<std::string>>& operators_str,
+    const ArcStringVector& arc_blacklist,
+    const ArcStringVector& arc_whitelist,
+    const FactorTypeVector& type_blacklist,
+    const FactorTypeVector& type_whitelist,
+    int max_indegree,
+    int max_iters,
+    double epsilon,
+    int patience,
+    std::optional<unsigned int> seed,
+    int num_folds,
+    double test_holdout_ratio,
+    int verbose = 0,
+    int num_threads = 1);
 
 template <typename T>
 double validation_delta_score(const T& model,
@@ -59,6 +93,108 @@ double validation_delta_score(const T& model,
     return nnew - prev;
 }
 
+// The search saves a HillClimbingCheckpoint in file_name every interval iterations if file_name is not empty. If resume
+// is not null, the search continues from the state of resume (the start model is the model of resume).
+struct CheckpointOptions {
+    std::string file_name;
+    int interval = 1;
+    std::shared_ptr<HillClimbingCheckpoint> resume;
+};
+
+// The operators applied in an iteration of the batched hill-climbing. The first operator is always applied. The next
+// operators are only applied if their delta scores do not interact with the applied operators: their nodes_changed()
+// are disjoint, and they do not use a node whose node type is changed (or change the node type of a used node). They
+// also need to be valid after applying the previous operators, so the batch keeps the acyclicity of the model.
+//
+// Most iterations apply a single operator and improve the score, so the batch avoids the work that they do not need:
+// the interactions are only recorded if the batch can hold more than one operator, and the opposites that do not
+// depend on the model are only created if undo_operators() is called.
+template <typename T>
+class OperatorBatch {
+public:
+    explicit OperatorBatch(std::size_t max_operators) : m_track_interactions(max_operators > 1) {
+        m_operators.reserve(max_operators);
+        m_undo.reserve(max_operators);
+    }
+
+    // Applies op to model if it is compatible with the batch. Returns true if op was applied.
+    bool apply(T& model, const std::shared_ptr<Operator>& op) {
+        auto nodes = op->nodes_changed(model);
+        if (!m_operators.empty() && !compatible(model, *op, nodes)) return false;
+
+        // The opposites that depend on the model are created before applying the operator (e.g.,
+        // ChangeNodeType::opposite() reads the current type).
+        m_undo.push_back(model_independent_opposite(*op) ? nullptr : op->opposite(model));
+        op->apply(model);
+
+        if (m_track_interactions) {
+            if (auto arc = dynamic_cast<const ArcOperator*>(op.get())) {
+                m_used.insert(arc->source());
+            } else if (auto change_type = dynamic_cast<const ChangeNodeType*>(op.get())) {
+                m_type_changed.insert(change_type->node());
+            }
+
+            m_used.insert(nodes.begin(), nodes.end());
+            m_changed.insert(nodes.begin(), nodes.end());
+        }
+
+        if (m_nodes_changed.empty())
+            m_nodes_changed = std::move(nodes);
+        else
+            m_nodes_changed.insert(m_nodes_changed.end(), nodes.begin(), nodes.end());
+        m_delta += op->delta();
+        m_operators.push_back(op);
+        return true;
+    }
+
+    const std::vector<std::shared_ptr<Operator>>& operators() const { return m_operators; }
+    // The opposite of each applied operator, in the order of application.
+    const std::vector<std::shared_ptr<Operator>>& undo_operators(const T& model) {
+        for (std::size_t i = 0; i < m_undo.size(); ++i) {
+            if (!m_undo[i]) m_undo[i] = m_operators[i]->opposite(model);
+        }
+
+        return m_undo;
+    }
+    const std::vector<std::string>& nodes_changed() const { return m_nodes_changed; }
+    double delta() const { return m_delta; }
+
+    // Returns true if the opposite of op is the same before and after applying it (the native arc operators).
+    static bool model_independent_opposite(const Operator& op) {
+        return !op.is_python_derived() && dynamic_cast<const ArcOperator*>(&op);
+    }
+
+private:
+    bool compatible(const T& model, const Operator& op, const std::vector<std::string>& nodes) const {
+        auto changed = [this](const std::string& n) { return m_changed.count(n) > 0; };
+        if (std::any_of(nodes.begin(), nodes.end(), changed)) return false;
+
+        if (auto arc = dynamic_cast<const ArcOperator*>(&op)) {
+            if (m_type_changed.count(arc->source()) > 0) return false;
+
+            if (dynamic_cast<const AddArc*>(&op)) return model.can_add_arc(arc->source(), arc->target());
+            if (dynamic_cast<const FlipArc*>(&op))
+                return model.has_arc(arc->source(), arc->target()) && model.can_flip_arc(arc->source(), arc->target());
+            return model.has_arc(arc->source(), arc->target());
+        } else if (auto change_type = dynamic_cast<const ChangeNodeType*>(&op)) {
+            return m_used.count(change_type->node()) == 0;
+        }
+
+        // The interactions of other operators are unknown.
+        return false;
+    }
+
+    std::vector<std::shared_ptr<Operator>> m_operators;
+    std::vector<std::shared_ptr<Operator>> m_undo;
+    std::vector<std::string> m_nodes_changed;
+    std::unordered_set<std::string> m_changed;
+    // The nodes changed or used as the source of an arc operator.
+    std::unordered_set<std::string> m_used;
+    std::unordered_set<std::string> m_type_changed;
+    bool m_track_interactions;
+    double m_delta = 0;
+};
+
 template <bool zero_patience, typename S, typename T>
 std::shared_ptr<T> estimate_hc(OperatorSet& op_set,
                                S& score,
@@ -72,7 +208,11 @@ std::shared_ptr<T> estimate_hc(OperatorSet& op_set,
                                int max_iters,
                                double epsilon,
                                int patience,
-                               int verbose) {
+                               int verbose,
+                               int num_threads,
+                               const CheckpointOptions& checkpoint,
+                               const std::shared_ptr<LocalScoreMemo> score_memo,
+                               int batch_operators) {
     auto spinner = util::indeterminate_spinner(verbose);
     spinner->update_status("Checking dataset...");
 
@@ -100,9 +240,11 @@ std::shared_ptr<T> estimate_hc(OperatorSet& op_set,
     op_set.set_type_blacklist(type_blacklist);
     op_set.set_type_whitelist(type_whitelist);
     op_set.set_max_indegree(max_indegree);
+    op_set.set_num_threads(num_threads);
 
-    auto prev_current_model = current_model->clone();
-    auto best_model = current_model;
+    // The opposite of the operators applied to current_model since the best model was found. The best model is restored
+    // at the end by undoing them in reverse order, so no copy of the model is kept during the search.
+    std::vector<std::shared_ptr<Operator>> undo_log;
 
     spinner->update_status("Caching scores...");
 
@@ -118,45 +260,78 @@ std::shared_ptr<T> estimate_hc(OperatorSet& op_set,
         }
     }();
 
+    // The local scores are counted by the memo of the operator set, for the budget of the callback.
+    auto evaluations = [&op_set, &score_memo]() -> int64_t {
+        if (auto cache = op_set.local_score_cache()) return cache->memo().evaluations();
+        return score_memo ? score_memo->evaluations() : 0;
+    };
+    auto initial_evaluations = evaluations();
+
     op_set.cache_scores(*current_model, score);
     int p = 0;
     double accumulated_offset = 0;
 
     OperatorTabuSet tabu_set;
 
-    if (callback) callback->call(*current_model, nullptr, score, 0);
-
     auto iter = 0;
+    if (checkpoint.resume) {
+        iter = checkpoint.resume->iteration();
+        undo_log = checkpoint.resume->undo_log();
+
+        if constexpr (!zero_patience) {
+            p = checkpoint.resume->patience_counter();
+            accumulated_offset = checkpoint.resume->accumulated_offset();
+            for (const auto& op : checkpoint.resume->tabu()) {
+                tabu_set.insert(op);
+            }
+        }
+    }
+
+    if (callback) callback->call(*current_model, nullptr, score, iter);
+
     while (iter < max_iters) {
+        if (callback && callback->stop(evaluations() - initial_evaluations)) break;
         ++iter;
+        util::ProfileScope iteration_profile([] { return std::string("hc:iteration"); });
+
+        auto best_ops = [&]() -> std::vector<std::shared_ptr<Operator>> {
+            if (batch_operators > 1) return op_set.find_max_batch(*current_model, tabu_set, batch_operators, epsilon);
 
-        auto best_op = [&]() {
+            std::shared_ptr<Operator> op;
             if constexpr (zero_patience)
-                return op_set.find_max(*current_model);
+                op = op_set.find_max(*current_model);
             else
-                return op_set.find_max(*current_model, tabu_set);
+                op = op_set.find_max(*current_model, tabu_set);
+
+            if (op) return {op};
+            return {};
         }();
 
-        if (!best_op || (best_op->delta() - epsilon) < util::machine_tol) {
+        if (best_ops.empty() || (best_ops.front()->delta() - epsilon) < util::machine_tol) {
             break;
         }
 
-        best_op->apply(*current_model);
+        OperatorBatch<T> batch(best_ops.size());
+        for (const auto& op : best_ops) {
+            if (batch.operators().empty() || (op->delta() - epsilon) >= util::machine_tol)
+                batch.apply(*current_model, op);
+        }
 
-        auto nodes_changed = best_op->nodes_changed(*current_model);
+        const auto& best_op = batch.operators().front();
+        const auto& nodes_changed = batch.nodes_changed();
 
         double validation_delta = [&]() {
             if constexpr (std::is_base_of_v<ValidatedScore, S>) {
                 return validation_delta_score(*current_model, score, nodes_changed, local_validation);
             } else {
-                return best_op->delta();
+                return batch.delta();
             }
         }();
 
         if ((validation_delta + accumulated_offset) > util::machine_tol) {
             if constexpr (!zero_patience) {
                 if (p > 0) {
-                    best_model = current_model;
+                    undo_log.clear();
                     p = 0;
                     accumulated_offset = 0;
                 }
@@ -164,27 +339,43 @@ std::shared_ptr<T> estimate_hc(OperatorSet& op_set,
                 tabu_set.clear();
             }
         } else {
+            const auto& undo_ops = batch.undo_operators(*current_model);
+            undo_log.insert(undo_log.end(), undo_ops.begin(), undo_ops.end());
+
             if constexpr (zero_patience) {
-                best_model = prev_current_model;
                 break;
             } else {
-                if (p == 0) best_model = prev_current_model->clone();
                 if (++p > patience) break;
                 accumulated_offset += validation_delta;
-                tabu_set.insert(best_op->opposite(*current_model));
+                const auto& ops = batch.operators();
+                for (std::size_t i = 0; i < ops.size(); ++i) {
+                    if (OperatorBatch<T>::model_independent_opposite(*ops[i]))
+                        tabu_set.insert(undo_ops[i]);
+                    else
+                        tabu_set.insert(ops[i]->opposite(*current_model));
+                }
             }
         }
 
-        best_op->apply(*prev_current_model);
-
-        if (callback) callback->call(*current_model, best_op.get(), score, iter);
+        if (callback) {
+            for (const auto& op : batch.operators()) {
+                callback->call(*current_model, op.get(), score, iter);
+            }
+        }
 
         op_set.update_scores(*current_model, score, nodes_changed);
 
+        if (!checkpoint.file_name.empty() && iter % checkpoint.interval == 0) {
+            HillClimbingCheckpoint(
+                current_model, iter, p, accumulated_offset, undo_log, tabu_set.operators(), score_memo)
+                .save(checkpoint.file_name);
+        }
+
         if constexpr (std::is_base_of_v<ValidatedScore, S>) {
-            spinner->update_status(best_op->ToString() + " | Validation delta: " + std::to_string(validation_delta));
+            spinner->lazy_update_status(
+                [&] { return best_op->ToString() + " | Validation delta: " + std::to_string(validation_delta); });
         } else if constexpr (std::is_base_of_v<Score, S>) {
-            spinner->update_status(best_op->ToString());
+            spinner->lazy_update_status([&] { return best_op->ToString(); });
         } else {
             static_assert(util::always_false<S>, "Wrong Score class for hill-climbing.");
         }
@@ -192,10 +383,29 @@ std::shared_ptr<T> estimate_hc(OperatorSet& op_set,
 
     op_set.finished();
 
-    if (callback) callback->call(*best_model, nullptr, score, iter);
+    for (auto it = undo_log.rbegin(); it != undo_log.rend(); ++it) {
+        (*it)->apply(*current_model);
+    }
+
+    if (callback) callback->call(*current_model, nullptr, score, iter);
 
     spinner->mark_as_completed("Finished Hill-climbing!");
-    return best_model;
+    return current_model;
+}
+
+// Returns true if the search calls any Python object. The callbacks are considered Python code unless they are
+// implemented in C++ without calling Python (see Callback::is_python_derived()).
+template <typename T>
+bool python_derived_search(const OperatorSet& op_set,
+                           const Score& score,
+                           const T& start,
+                           const FactorTypeVector& type_blacklist,
+                           const FactorTypeVector& type_whitelist,
+                           const std::shared_ptr<Callback> callback) {
+    auto python_type = [](const auto& p) { return p.second->is_python_derived(); };
+    return (callback && callback->is_python_derived()) || op_set.has_python_derived() || score.is_python_derived() ||
+           start.has_python_derived() || std::any_of(type_blacklist.begin(), type_blacklist.end(), python_type) ||
+           std::any_of(type_whitelist.begin(), type_whitelist.end(), python_type);
 }
 
 template <typename T>
@@ -211,7 +421,14 @@ std::shared_ptr<T> estimate_downcast_score(OperatorSet& op_set,
                                            int max_iters,
                                            double epsilon,
                                            int patience,
-                                           int verbose) {
+                                           int verbose,
+                                           int num_threads = 1,
+                                           const CheckpointOptions& checkpoint = CheckpointOptions{},
+                                           const std::shared_ptr<LocalScoreMemo> score_memo = nullptr,
+                                           int batch_operators = 1) {
+    util::gil_release_if_held release(
+        !python_derived_search(op_set, score, start, type_blacklist, type_whitelist, callback));
+
     if (auto validated_score = dynamic_cast<ValidatedScore*>(&score)) {
         if (patience == 0) {
             return estimate_hc<true>(op_set,
@@ -226,7 +443,11 @@ std::shared_ptr<T> estimate_downcast_score(OperatorSet& op_set,
                                      max_iters,
                                      epsilon,
                                      patience,
-                                     verbose);
+                                     verbose,
+                                     num_threads,
+                                     checkpoint,
+                                     score_memo,
+                                     batch_operators);
         } else {
             return estimate_hc<false>(op_set,
                                       *validated_score,
@@ -240,7 +461,11 @@ std::shared_ptr<T> estimate_downcast_score(OperatorSet& op_set,
                                       max_iters,
                                       epsilon,
                                       patience,
-                                      verbose);
+                                      verbose,
+                                      num_threads,
+                                      checkpoint,
+                                      score_memo,
+                                      batch_operators);
         }
     } else {
         if (patience == 0) {
@@ -256,7 +481,11 @@ std::shared_ptr<T> estimate_downcast_score(OperatorSet& op_set,
                                      max_iters,
                                      epsilon,
                                      patience,
-                                     verbose);
+                                     verbose,
+                                     num_threads,
+                                     checkpoint,
+                                     score_memo,
+                                     batch_operators);
         } else {
             return estimate_hc<false>(op_set,
                                       score,
@@ -270,7 +499,11 @@ std::shared_ptr<T> estimate_downcast_score(OperatorSet& op_set,
                                       max_iters,
                                       epsilon,
                                       patience,
-                                      verbose);
+                                      verbose,
+                                      num_threads,
+                                      checkpoint,
+                                      score_memo,
+                                      batch_operators);
         }
     }
 }
@@ -288,17 +521,46 @@ std::shared_ptr<T> estimate_checks(OperatorSet& op_set,
                                    int max_iters,
                                    double epsilon,
                                    int patience,
-                                   int verbose) {
-    if (!score.compatible_bn(start)) {
+                                   int verbose,
+                                   int num_threads,
+                                   const std::shared_ptr<LocalScoreMemo> score_memo,
+                                   const CheckpointOptions& checkpoint,
+                                   int batch_operators = 1) {
+    if (checkpoint.interval <= 0) throw std::invalid_argument("checkpoint_interval must be a positive value.");
+    if (batch_operators <= 0) throw std::invalid_argument("batch_operators must be a positive value.");
+
+    const T* start_model = &start;
+    std::shared_ptr<T> resume_model;
+    if (checkpoint.resume) {
+        resume_model = std::dynamic_pointer_cast<T>(checkpoint.resume->model());
+
+        bool conditional_mismatch = std::is_same_v<T, BayesianNetworkBase> &&
+                                    dynamic_cast<const ConditionalBayesianNetworkBase*>(resume_model.get());
+        if (!resume_model || conditional_mismatch || resume_model->type_ref() != start.type_ref()) {
+            throw std::invalid_argument("The model of the checkpoint is not of the same type as the start model.");
+        }
+
+        start_model = resume_model.get();
+    }
+
+    if (!score.compatible_bn(*start_model)) {
         throw std::invalid_argument("BayesianNetwork is not compatible with the score.");
     }
 
-    util::validate_restrictions(start, arc_blacklist, arc_whitelist);
-    util::validate_type_restrictions(start, type_blacklist, type_whitelist);
+    util::validate_restrictions(*start_model, arc_blacklist, arc_whitelist);
+    util::validate_type_restrictions(*start_model, type_blacklist, type_whitelist);
+
+    auto memo = score_memo;
+    if (!memo && checkpoint.resume) memo = checkpoint.resume->score_memo();
+    // The checkpoints save the memo, so the local scores are not computed again when the search is resumed.
+    if (!memo && !checkpoint.file_name.empty()) memo = std::make_shared<LocalScoreMemo>();
+
+    if (memo) memo->check_score(score);
+    op_set.set_local_score_memo(memo);
 
     return estimate_downcast_score(op_set,
                                    score,
-                                   start,
+                                   *start_model,
                                    arc_blacklist,
                                    arc_whitelist,
                                    type_blacklist,
@@ -308,7 +570,11 @@ std::shared_ptr<T> estimate_checks(OperatorSet& op_set,
                                    max_iters,
                                    epsilon,
                                    patience,
-                                   verbose);
+                                   verbose,
+                                   num_threads,
+                                   checkpoint,
+                                   memo,
+                                   batch_operators);
 }
 
 class GreedyHillClimbing {
@@ -326,7 +592,13 @@ public:
                                 int max_iters,
                                 double epsilon,
                                 int patience,
-                                int verbose = 0) {
+                                int verbose = 0,
+                                int num_threads = 1,
+                                const std::shared_ptr<LocalScoreMemo> score_memo = nullptr,
+                                const std::optional<std::string>& checkpoint = std::nullopt,
+                                int checkpoint_interval = 1,
+                                const std::shared_ptr<HillClimbingCheckpoint> resume = nullptr,
+                                int batch_operators = 1) {
         return estimate_checks(op_set,
                                score,
                                start,
@@ -339,7 +611,11 @@ public:
                                max_iters,
                                epsilon,
                                patience,
-                               verbose);
+                               verbose,
+                               num_threads,
+                               score_memo,
+                               CheckpointOptions{checkpoint.value_or(""), checkpoint_interval, resume},
+                               batch_operators);
     }
 };
 
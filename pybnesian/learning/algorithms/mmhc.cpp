@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <learning/algorithms/mmhc.hpp>
 #include <learning/algorithms/mmpc.hpp>
 #include <learning/algorithms/hillclimbing.hpp>
@@ -21,15 +22,27 @@ void remove_asymmetries(std::vector<std::unordered_set<int>>& cpcs) {
     }
 }
 
-ArcStringVector create_hc_blacklist(BayesianNetworkBase& bn, const std::vector<std::unordered_set<int>>& cpcs) {
-    ArcStringVector blacklist;
+// Returns the index of each node in bn, so the blacklists resolve each name once instead of once for each pair.
+template <typename BN>
+std::vector<int> node_indices(const BN& bn, const std::vector<std::string>& nodes) {
+    std::vector<int> indices;
+    indices.reserve(nodes.size());
+    for (const auto& node : nodes) {
+        indices.push_back(bn.index(node));
+    }
 
-    const auto& nodes = bn.nodes();
+    return indices;
+}
 
-    for (auto i = 0, i_end = bn.num_nodes() - 1; i < i_end; ++i) {
-        auto index = bn.index(nodes[i]);
-        for (auto j = i + 1, j_end = bn.num_nodes(); j < j_end; ++j) {
-            auto other_index = bn.index(nodes[j]);
+// Adds the arcs between the pairs of nodes that are not in the CPCs of each other.
+void add_non_cpcs_blacklist(const std::vector<std::string>& nodes,
+                            const std::vector<int>& indices,
+                            const std::vector<std::unordered_set<int>>& cpcs,
+                            ArcStringVector& blacklist) {
+    for (auto i = 0, i_end = static_cast<int>(nodes.size()) - 1; i < i_end; ++i) {
+        auto index = indices[i];
+        for (auto j = i + 1, j_end = static_cast<int>(nodes.size()); j < j_end; ++j) {
+            auto other_index = indices[j];
 
             if (!cpcs[index].count(other_index)) {
                 blacklist.push_back({nodes[index], nodes[other_index]});
@@ -37,6 +50,13 @@ ArcStringVector create_hc_blacklist(BayesianNetworkBase& bn, const std::vector<s
             }
         }
     }
+}
+
+ArcStringVector create_hc_blacklist(BayesianNetworkBase& bn, const std::vector<std::unordered_set<int>>& cpcs) {
+    ArcStringVector blacklist;
+
+    const auto& nodes = bn.nodes();
+    add_non_cpcs_blacklist(nodes, node_indices(bn, nodes), cpcs, blacklist);
 
     return blacklist;
 }
@@ -46,51 +66,83 @@ ArcStringVector create_conditional_hc_blacklist(ConditionalBayesianNetworkBase&
     ArcStringVector blacklist;
 
     const auto& nodes = bn.nodes();
+    const auto& interface_nodes = bn.interface_nodes();
+    auto indices = node_indices(bn, nodes);
+    auto interface_indices = node_indices(bn, interface_nodes);
 
-    for (auto i = 0, i_end = bn.num_nodes() - 1; i < i_end; ++i) {
-        auto index = bn.index(nodes[i]);
-        for (auto j = i + 1, j_end = bn.num_nodes(); j < j_end; ++j) {
-            auto other_index = bn.index(nodes[j]);
+    add_non_cpcs_blacklist(nodes, indices, cpcs, blacklist);
 
-            if (!cpcs[index].count(other_index)) {
-                blacklist.push_back({nodes[index], nodes[other_index]});
-                blacklist.push_back({nodes[other_index], nodes[index]});
+    for (int n = 0, n_end = nodes.size(); n < n_end; ++n) {
+        const auto& node_cpcs = cpcs[indices[n]];
+        for (int i = 0, i_end = interface_nodes.size(); i < i_end; ++i) {
+            if (!node_cpcs.count(interface_indices[i])) {
+                blacklist.push_back({interface_nodes[i], nodes[n]});
             }
         }
     }
 
-    for (const auto& node : nodes) {
-        auto nindex = bn.index(node);
-        for (const auto& inode : bn.interface_nodes()) {
-            auto iindex = bn.index(inode);
+    return blacklist;
+}
 
-            if (!cpcs[nindex].count(iindex)) {
-                blacklist.push_back({inode, node});
-            }
+// Returns the CPCs of the skeleton of start, with the indices of the graph of the MMPC phase. The nodes of start that
+// are not in the graph are ignored.
+std::vector<std::unordered_set<int>> start_cpcs(const BayesianNetworkBase& start,
+                                                const std::unordered_map<std::string, int>& indices,
+                                                int num_total_nodes) {
+    std::vector<std::unordered_set<int>> cpcs(num_total_nodes);
+
+    for (const auto& arc : start.arcs()) {
+        auto source = indices.find(arc.first);
+        auto target = indices.find(arc.second);
+
+        if (source != indices.end() && target != indices.end()) {
+            cpcs[source->second].insert(target->second);
+            cpcs[target->second].insert(source->second);
         }
     }
 
-    return blacklist;
+    return cpcs;
 }
 
-std::shared_ptr<BayesianNetworkBase> MMHC::estimate(const IndependenceTest& test,
-                                                    OperatorSet& op_set,
-                                                    Score& score,
-                                                    const std::vector<std::string>& nodes,
-                                                    const BayesianNetworkType& bn_type,
-                                                    const ArcStringVector& varc_blacklist,
-                                                    const ArcStringVector& varc_whitelist,
-                                                    const EdgeStringVector& vedge_blacklist,
-                                                    const EdgeStringVector& vedge_whitelist,
-                                                    const FactorTypeVector& type_blacklist,
-                                                    const FactorTypeVector& type_whitelist,
-                                                    const std::shared_ptr<Callback> callback,
-                                                    int max_indegree,
-                                                    int max_iters,
-                                                    double epsilon,
-                                                    int patience,
-                                                    double alpha,
-                                                    int verbose) {
+// Adds to bn the whitelisted arcs and the arcs of start that are allowed by the CPCs and the blacklist.
+void add_start_arcs(BayesianNetworkBase& bn,
+                    const BayesianNetworkBase& start,
+                    const std::unordered_map<std::string, int>& indices,
+                    const std::vector<std::unordered_set<int>>& cpcs,
+                    const ArcStringVector& varc_blacklist,
+                    const ArcStringVector& arc_whitelist) {
+    bn.force_whitelist(arc_whitelist);
+
+    for (const auto& arc : start.arcs()) {
+        auto source = indices.find(arc.first);
+        auto target = indices.find(arc.second);
+
+        if (source == indices.end() || target == indices.end() || !cpcs[source->second].count(target->second))
+            continue;
+
+        if (std::find(varc_blacklist.begin(), varc_blacklist.end(), arc) != varc_blacklist.end()) continue;
+
+        if (!bn.has_arc(arc.first, arc.second) && bn.can_add_arc(arc.first, arc.second)) {
+            bn.add_arc(arc.first, arc.second);
+        }
+    }
+}
+
+MMHCSkeleton<BayesianNetworkBase> MMHC::skeleton(const IndependenceTest& test,
+                                                 Score& score,
+                                                 const std::vector<std::string>& nodes,
+                                                 const BayesianNetworkType& bn_type,
+                                                 const ArcStringVector& varc_blacklist,
+                                                 const ArcStringVector& varc_whitelist,
+                                                 const EdgeStringVector& vedge_blacklist,
+                                                 const EdgeStringVector& vedge_whitelist,
+                                                 const FactorTypeVector& type_blacklist,
+                                                 const FactorTypeVector& type_whitelist,
+                                                 double alpha,
+                                                 int verbose,
+                                                 int num_threads,
+                                                 const std::shared_ptr<LocalScoreMemo> score_memo,
+                                                 const std::shared_ptr<BayesianNetworkBase> start) {
     PartiallyDirectedGraph skeleton;
     std::shared_ptr<BayesianNetworkBase> bn;
     if (nodes.empty()) {
@@ -110,10 +162,15 @@ std::shared_ptr<BayesianNetworkBase> MMHC::estimate(const IndependenceTest& test
     if (!score.has_variables(skeleton.nodes()))
         throw std::invalid_argument("Score do not contain all the variables in nodes list.");
 
+    if (score_memo) score_memo->check_score(score);
+
     auto restrictions =
         util::validate_restrictions(skeleton, varc_blacklist, varc_whitelist, vedge_blacklist, vedge_whitelist);
     util::validate_type_restrictions(skeleton, type_blacklist, type_whitelist);
 
+    std::vector<std::unordered_set<int>> warm_start;
+    if (start) warm_start = start_cpcs(*start, skeleton.indices(), skeleton.num_nodes());
+
     auto progress = util::progress_bar(verbose);
     auto cpcs = mmpc_all_variables(test,
                                    skeleton,
@@ -121,7 +178,9 @@ std::shared_ptr<BayesianNetworkBase> MMHC::estimate(const IndependenceTest& test
                                    restrictions.arc_whitelist,
                                    restrictions.edge_blacklist,
                                    restrictions.edge_whitelist,
-                                   *progress);
+                                   *progress,
+                                   num_threads,
+                                   start ? &warm_start : nullptr);
 
     remove_asymmetries(cpcs);
 
@@ -134,24 +193,65 @@ std::shared_ptr<BayesianNetworkBase> MMHC::estimate(const IndependenceTest& test
         arc_whitelist.push_back({skeleton.name(p.first), skeleton.name(p.second)});
     }
 
-    return learning::algorithms::estimate_downcast_score(op_set,
-                                                         score,
-                                                         *bn,
-                                                         hc_blacklist,
-                                                         arc_whitelist,
-                                                         type_blacklist,
-                                                         type_whitelist,
-                                                         callback,
-                                                         max_indegree,
-                                                         max_iters,
-                                                         epsilon,
-                                                         patience,
-                                                         verbose);
+    if (start) add_start_arcs(*bn, *start, skeleton.indices(), cpcs, varc_blacklist, arc_whitelist);
+
+    return MMHCSkeleton<BayesianNetworkBase>{std::move(bn), std::move(hc_blacklist), std::move(arc_whitelist)};
 }
 
-std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
+std::shared_ptr<BayesianNetworkBase> MMHC::estimate(const IndependenceTest& test,
+                                                    OperatorSet& op_set,
+                                                    Score& score,
+                                                    const std::vector<std::string>& nodes,
+                                                    const BayesianNetworkType& bn_type,
+                                                    const ArcStringVector& varc_blacklist,
+                                                    const ArcStringVector& varc_whitelist,
+                                                    const EdgeStringVector& vedge_blacklist,
+                                                    const EdgeStringVector& vedge_whitelist,
+                                                    const FactorTypeVector& type_blacklist,
+                                                    const FactorTypeVector& type_whitelist,
+                                                    const std::shared_ptr<Callback> callback,
+                                                    int max_indegree,
+                                                    int max_iters,
+                                                    double epsilon,
+                                                    int patience,
+                                                    double alpha,
+                                                    int verbose,
+                                                    int num_threads,
+                                                    const std::shared_ptr<LocalScoreMemo> score_memo,
+                                                    const std::shared_ptr<BayesianNetworkBase> start) {
+    auto s = skeleton(test,
+                      score,
+                      nodes,
+                      bn_type,
+                      varc_blacklist,
+                      varc_whitelist,
+                      vedge_blacklist,
+                      vedge_whitelist,
+                      type_blacklist,
+                      type_whitelist,
+                      alpha,
+                      verbose,
+                      num_threads,
+                      score_memo,
+                      start);
+
+    return search(op_set,
+                  score,
+                  s,
+                  type_blacklist,
+                  type_whitelist,
+                  callback,
+                  max_indegree,
+                  max_iters,
+                  epsilon,
+                  patience,
+                  verbose,
+                  num_threads,
+                  score_memo);
+}
+
+MMHCSkeleton<ConditionalBayesianNetworkBase> MMHC::skeleton_conditional(
     const IndependenceTest& test,
-    OperatorSet& op_set,
     Score& score,
     const std::vector<std::string>& nodes,
     const std::vector<std::string>& interface_nodes,
@@ -162,35 +262,15 @@ std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
     const EdgeStringVector& vedge_whitelist,
     const FactorTypeVector& type_blacklist,
     const FactorTypeVector& type_whitelist,
-    const std::shared_ptr<Callback> callback,
-    int max_indegree,
-    int max_iters,
-    double epsilon,
-    int patience,
     double alpha,
-    int verbose) {
+    int verbose,
+    int num_threads,
+    const std::shared_ptr<LocalScoreMemo> score_memo,
+    const std::shared_ptr<ConditionalBayesianNetworkBase> start) {
     if (nodes.empty())
         throw std::invalid_argument("Node list cannot be empty to train a Conditional Bayesian network.");
     if (interface_nodes.empty())
-        return MMHC::estimate(test,
-                              op_set,
-                              score,
-                              nodes,
-                              bn_type,
-                              varc_blacklist,
-                              varc_whitelist,
-                              vedge_blacklist,
-                              vedge_whitelist,
-                              type_blacklist,
-                              type_whitelist,
-                              callback,
-                              max_indegree,
-                              max_iters,
-                              epsilon,
-                              patience,
-                              alpha,
-                              verbose)
-            ->conditional_bn();
+        throw std::invalid_argument("Interface node list cannot be empty to search a conditional skeleton.");
 
     if (!test.has_variables(nodes) || !test.has_variables(interface_nodes))
         throw std::invalid_argument(
@@ -198,6 +278,8 @@ std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
     if (!score.has_variables(nodes) || !score.has_variables(interface_nodes))
         throw std::invalid_argument("Score do not contain all the variables in nodes list.");
 
+    if (score_memo) score_memo->check_score(score);
+
     ConditionalPartiallyDirectedGraph skeleton(nodes, interface_nodes);
 
     auto bn = bn_type.new_cbn(nodes, interface_nodes);
@@ -210,6 +292,9 @@ std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
         util::validate_restrictions(skeleton, varc_blacklist, varc_whitelist, vedge_blacklist, vedge_whitelist);
     util::validate_type_restrictions(skeleton, type_blacklist, type_whitelist);
 
+    std::vector<std::unordered_set<int>> warm_start;
+    if (start) warm_start = start_cpcs(*start, skeleton.indices(), skeleton.num_joint_nodes());
+
     auto progress = util::progress_bar(verbose);
     auto cpcs = mmpc_all_variables(test,
                                    skeleton,
@@ -217,7 +302,9 @@ std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
                                    restrictions.arc_whitelist,
                                    restrictions.edge_blacklist,
                                    restrictions.edge_whitelist,
-                                   *progress);
+                                   *progress,
+                                   num_threads,
+                                   start ? &warm_start : nullptr);
     remove_asymmetries(cpcs);
     auto hc_blacklist = create_conditional_hc_blacklist(*bn, cpcs);
 
@@ -229,11 +316,143 @@ std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
         arc_whitelist.push_back({skeleton.name(p.first), skeleton.name(p.second)});
     }
 
+    if (start) add_start_arcs(*bn, *start, skeleton.indices(), cpcs, varc_blacklist, arc_whitelist);
+
+    return MMHCSkeleton<ConditionalBayesianNetworkBase>{
+        std::move(bn), std::move(hc_blacklist), std::move(arc_whitelist)};
+}
+
+std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
+    const IndependenceTest& test,
+    OperatorSet& op_set,
+    Score& score,
+    const std::vector<std::string>& nodes,
+    const std::vector<std::string>& interface_nodes,
+    const BayesianNetworkType& bn_type,
+    const ArcStringVector& varc_blacklist,
+    const ArcStringVector& varc_whitelist,
+    const EdgeStringVector& vedge_blacklist,
+    const EdgeStringVector& vedge_whitelist,
+    const FactorTypeVector& type_blacklist,
+    const FactorTypeVector& type_whitelist,
+    const std::shared_ptr<Callback> callback,
+    int max_indegree,
+    int max_iters,
+    double epsilon,
+    int patience,
+    double alpha,
+    int verbose,
+    int num_threads,
+    const std::shared_ptr<LocalScoreMemo> score_memo,
+    const std::shared_ptr<ConditionalBayesianNetworkBase> start) {
+    if (nodes.empty())
+        throw std::invalid_argument("Node list cannot be empty to train a Conditional Bayesian network.");
+    if (interface_nodes.empty())
+        return MMHC::estimate(test,
+                              op_set,
+                              score,
+                              nodes,
+                              bn_type,
+                              varc_blacklist,
+                              varc_whitelist,
+                              vedge_blacklist,
+                              vedge_whitelist,
+                              type_blacklist,
+                              type_whitelist,
+                              callback,
+                              max_indegree,
+                              max_iters,
+                              epsilon,
+                              patience,
+                              alpha,
+                              verbose,
+                              num_threads,
+                              score_memo,
+                              start)
+            ->conditional_bn();
+
+    auto s = skeleton_conditional(test,
+                                  score,
+                                  nodes,
+                                  interface_nodes,
+                                  bn_type,
+                                  varc_blacklist,
+                                  varc_whitelist,
+                                  vedge_blacklist,
+                                  vedge_whitelist,
+                                  type_blacklist,
+                                  type_whitelist,
+                                  alpha,
+                                  verbose,
+                                  num_threads,
+                                  score_memo,
+                                  start);
+
+    return search(op_set,
+                  score,
+                  s,
+                  type_blacklist,
+                  type_whitelist,
+                  callback,
+                  max_indegree,
+                  max_iters,
+                  epsilon,
+                  patience,
+                  verbose,
+                  num_threads,
+                  score_memo);
+}
+
+std::shared_ptr<BayesianNetworkBase> MMHC::search(OperatorSet& op_set,
+                                                  Score& score,
+                                                  const MMHCSkeleton<BayesianNetworkBase>& skeleton,
+                                                  const FactorTypeVector& type_blacklist,
+                                                  const FactorTypeVector& type_whitelist,
+                                                  const std::shared_ptr<Callback> callback,
+                                                  int max_indegree,
+                                                  int max_iters,
+                                                  double epsilon,
+                                                  int patience,
+                                                  int verbose,
+                                                  int num_threads,
+                                                  const std::shared_ptr<LocalScoreMemo> score_memo) {
+    op_set.set_local_score_memo(score_memo);
+    return learning::algorithms::estimate_downcast_score(op_set,
+                                                         score,
+                                                         *skeleton.bn,
+                                                         skeleton.arc_blacklist,
+                                                         skeleton.arc_whitelist,
+                                                         type_blacklist,
+                                                         type_whitelist,
+                                                         callback,
+                                                         max_indegree,
+                                                         max_iters,
+                                                         epsilon,
+                                                         patience,
+                                                         verbose,
+                                                         num_threads);
+}
+
+std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::search(
+    OperatorSet& op_set,
+    Score& score,
+    const MMHCSkeleton<ConditionalBayesianNetworkBase>& skeleton,
+    const FactorTypeVector& type_blacklist,
+    const FactorTypeVector& type_whitelist,
+    const std::shared_ptr<Callback> callback,
+    int max_indegree,
+    int max_iters,
+    double epsilon,
+    int patience,
+    int verbose,
+    int num_threads,
+    const std::shared_ptr<LocalScoreMemo> score_memo) {
+    op_set.set_local_score_memo(score_memo);
     return learning::algorithms::estimate_downcast_score(op_set,
                                                          score,
-                                                         *bn,
-                                                         hc_blacklist,
-                                                         arc_whitelist,
+                                                         *skeleton.bn,
+                                                         skeleton.arc_blacklist,
+                                                         skeleton.arc_whitelist,
                                                          type_blacklist,
                                                          type_whitelist,
                                                          callback,
@@ -241,7 +460,8 @@ std::shared_ptr<ConditionalBayesianNetworkBase> MMHC::estimate_conditional(
                                                          max_iters,
                                                          epsilon,
                                                          patience,
-                                                         verbose);
+                                                         verbose,
+                                                         num_threads);
 }
 
 }  // namespace learning::algorithms
\ No newline at end of file
@@ -8,13 +8,91 @@
 
 using learning::algorithms::callbacks::Callback;
 using learning::independences::IndependenceTest;
-using learning::operators::OperatorSet;
+using learning::operators::OperatorSet, learning::operators::LocalScoreMemo;
 using models::BayesianNetworkBase, models::ConditionalBayesianNetworkBase, models::BayesianNetworkType;
 
 namespace learning::algorithms {
 
+// The result of the MMPC phase of MMHC: the empty network that starts the hill-climbing search and the arc restrictions
+// of the search.
+template <typename BN>
+struct MMHCSkeleton {
+    std::shared_ptr<BN> bn;
+    ArcStringVector arc_blacklist;
+    ArcStringVector arc_whitelist;
+};
+
 class MMHC {
 public:
+    // estimate() is skeleton() followed by search(). The phases are exposed so that the MMPC phases of independent
+    // problems (e.g., the static and transition networks of DMMHC) can be executed at the same time.
+    //
+    // If start is not null, the MMPC phase verifies and repairs the CPCs of the skeleton of start instead of searching
+    // them from empty sets, and the hill-climbing starts from the arcs of start allowed by the new skeleton.
+    MMHCSkeleton<BayesianNetworkBase> skeleton(const IndependenceTest& test,
+                                               Score& score,
+                                               const std::vector<std::string>& nodes,
+                                               const BayesianNetworkType& bn_type,
+                                               const ArcStringVector& varc_blacklist,
+                                               const ArcStringVector& varc_whitelist,
+                                               const EdgeStringVector& vedge_blacklist,
+                                               const EdgeStringVector& vedge_whitelist,
+                                               const FactorTypeVector& type_blacklist,
+                                               const FactorTypeVector& type_whitelist,
+                                               double alpha,
+                                               int verbose = 0,
+                                               int num_threads = 1,
+                                               const std::shared_ptr<LocalScoreMemo> score_memo = nullptr,
+                                               const std::shared_ptr<BayesianNetworkBase> start = nullptr);
+
+    // The interface_nodes can not be empty.
+    MMHCSkeleton<ConditionalBayesianNetworkBase> skeleton_conditional(
+        const IndependenceTest& test,
+        Score& score,
+        const std::vector<std::string>& nodes,
+        const std::vector<std::string>& interface_nodes,
+        const BayesianNetworkType& bn_type,
+        const ArcStringVector& varc_blacklist,
+        const ArcStringVector& varc_whitelist,
+        const EdgeStringVector& vedge_blacklist,
+        const EdgeStringVector& vedge_whitelist,
+        const FactorTypeVector& type_blacklist,
+        const FactorTypeVector& type_whitelist,
+        double alpha,
+        int verbose = 0,
+        int num_threads = 1,
+        const std::shared_ptr<LocalScoreMemo> score_memo = nullptr,
+        const std::shared_ptr<ConditionalBayesianNetworkBase> start = nullptr);
+
+    std::shared_ptr<BayesianNetworkBase> search(OperatorSet& op_set,
+                                                Score& score,
+                                                const MMHCSkeleton<BayesianNetworkBase>& skeleton,
+                                                const FactorTypeVector& type_blacklist,
+                                                const FactorTypeVector& type_whitelist,
+                                                const std::shared_ptr<Callback> callback,
+                                                int max_indegree,
+                                                int max_iters,
+                                                double epsilon,
+                                                int patience,
+                                                int verbose = 0,
+                                                int num_threads = 1,
+                                                const std::shared_ptr<LocalScoreMemo> score_memo = nullptr);
+
+    std::shared_ptr<ConditionalBayesianNetworkBase> search(
+        OperatorSet& op_set,
+        Score& score,
+        const MMHCSkeleton<ConditionalBayesianNetworkBase>& skeleton,
+        const FactorTypeVector& type_blacklist,
+        const FactorTypeVector& type_whitelist,
+        const std::shared_ptr<Callback> callback,
+        int max_indegree,
+        int max_iters,
+        double epsilon,
+        int patience,
+        int verbose = 0,
+        int num_threads = 1,
+        const std::shared_ptr<LocalScoreMemo> score_memo = nullptr);
+
     std::shared_ptr<BayesianNetworkBase> estimate(const IndependenceTest& test,
                                                   OperatorSet& op_set,
                                                   Score& score,
@@ -32,7 +110,10 @@ public:
                                                   double epsilon,
                                                   int patience,
                                                   double alpha,
-                                                  int verbose = 0);
+                                                  int verbose = 0,
+                                                  int num_threads = 1,
+                                                  const std::shared_ptr<LocalScoreMemo> score_memo = nullptr,
+                                                  const std::shared_ptr<BayesianNetworkBase> start = nullptr);
 
     std::shared_ptr<ConditionalBayesianNetworkBase> estimate_conditional(
         const IndependenceTest& test,
@@ -53,7 +134,10 @@ public:
         double epsilon,
         int patience,
         double alpha,
-        int verbose = 0);
+        int verbose = 0,
+        int num_threads = 1,
+        const std::shared_ptr<LocalScoreMemo> score_memo = nullptr,
+        const std::shared_ptr<ConditionalBayesianNetworkBase> start = nullptr);
 };
 
 }  // namespace learning::algorithms
@@ -1,9 +1,12 @@
 // For std::iota
 #include <numeric>
+#include <queue>
+#include <unordered_map>
 #include <learning/algorithms/constraint.hpp>
 #include <learning/algorithms/mmpc.hpp>
 #include <Eigen/Dense>
 #include <util/combinations.hpp>
+#include <util/parallel.hpp>
 #include <util/progress.hpp>
 #include <util/vector.hpp>
 #include <util/validate_whitelists.hpp>
@@ -21,6 +24,9 @@ struct CPCAssoc {
     VectorXi maxmin_index;
 };
 
+// The association of the candidates of a variable are stored in its own column of BNCPCAssoc (and its own elements of
+// maxmin_assoc and maxmin_index). The forward phase of a variable only modifies its column (see BNCPCAssocCol), so
+// the forward phases of different variables can run concurrently on the same BNCPCAssoc.
 template <typename BN>
 class BNCPCAssoc;
 
@@ -362,7 +368,8 @@ void recompute_assoc(const IndependenceTest& test,
                      ColAssoc& assoc,
                      util::BaseProgressBar& progress) {
     const auto& variable_name = g.name(variable);
-    progress.set_text("MMPC Forward: sepset order " + std::to_string(cpc.size()) + " for " + variable_name);
+    progress.lazy_set_text(
+        [&] { return "MMPC Forward: sepset order " + std::to_string(cpc.size()) + " for " + variable_name; });
     progress.set_max_progress(to_be_checked.size());
     progress.set_progress(0);
 
@@ -374,13 +381,53 @@ void recompute_assoc(const IndependenceTest& test,
 
     assoc.reset_maxmin();
 
-    for (auto it = to_be_checked.begin(); it != to_be_checked.end();) {
-        double pvalue = test.pvalue(variable_name, g.name(*it), cpc_vec);
-        assoc.initialize_assoc(*it, pvalue);
+    std::vector<int> variables(to_be_checked.begin(), to_be_checked.end());
+    std::vector<std::pair<std::string, std::string>> pairs;
+    pairs.reserve(variables.size());
+    for (auto v : variables) {
+        pairs.push_back({variable_name, g.name(v)});
+    }
+
+    auto pvalues = profiled_pvalues(test, pairs, cpc_vec);
+    for (size_t i = 0; i < variables.size(); ++i) {
+        assoc.initialize_assoc(variables[i], pvalues[i]);
         progress.tick();
     }
 }
 
+// Returns the conditioning sets of the forward phase when last_added is added to the CPC old_cpc: all the subsets of
+// the new CPC that contain last_added, from the smallest to the largest.
+std::vector<std::vector<std::string>> forward_sepsets(std::vector<std::string> old_cpc, const std::string& last_added) {
+    std::vector<std::vector<std::string>> sepsets;
+
+    // Conditioning in just the last variable added.
+    sepsets.push_back({last_added});
+
+    // Conditioning in the last variable and another variable added.
+    if (old_cpc.size() > 1) {
+        for (const auto& pc : old_cpc) {
+            sepsets.push_back({pc, last_added});
+        }
+    }
+
+    // Conditioning in all the subsets of 2 to CPC.size()-1 size, including last variable added.
+    if (old_cpc.size() > 2) {
+        std::vector<std::string> fixed = {last_added};
+        AllSubsets comb(old_cpc, std::move(fixed), 3, old_cpc.size());
+        for (const auto& subset : comb) {
+            sepsets.push_back(subset);
+        }
+    }
+
+    // Conditioning in all the variables.
+    if (!old_cpc.empty()) {
+        old_cpc.push_back(last_added);
+        sepsets.push_back(std::move(old_cpc));
+    }
+
+    return sepsets;
+}
+
 template <typename G, typename ColAssoc>
 void update_min_assoc(const IndependenceTest& test,
                       const G& g,
@@ -394,102 +441,61 @@ void update_min_assoc(const IndependenceTest& test,
 
     assoc.reset_maxmin();
 
-    if (cpc.empty()) {
-        progress.set_text("MMPC Forward: no sepset for " + variable_name);
-        progress.set_max_progress(to_be_checked.size());
-        progress.set_progress(0);
-
-        for (auto v : to_be_checked) {
-            double pvalue = test.pvalue(variable_name, g.name(v));
-            assoc.initialize_assoc(v, pvalue);
-            progress.tick();
-        }
-    } else if (cpc.size() == 1) {
-        progress.set_text("MMPC Forward: sepset order 1 for " + variable_name);
-        progress.set_max_progress(to_be_checked.size());
-        progress.set_progress(0);
-
-        const auto& last_added_name = g.name(last_added_cpc);
-        for (auto v : to_be_checked) {
-            double pvalue = test.pvalue(variable_name, g.name(v), last_added_name);
-            assoc.update_assoc(v, pvalue);
-            progress.tick();
-        }
-    } else if (cpc.size() == 2) {
-        const auto& last_added_name = g.name(last_added_cpc);
+    std::vector<int> variables(to_be_checked.begin(), to_be_checked.end());
 
+    if (cpc.size() <= 1) {
         std::vector<std::string> cond;
-        cond.reserve(2);
-        for (auto pc : cpc) {
-            cond.push_back(g.name(pc));
+        if (cpc.empty()) {
+            progress.lazy_set_text([&] { return "MMPC Forward: no sepset for " + variable_name; });
+        } else {
+            progress.lazy_set_text([&] { return "MMPC Forward: sepset order 1 for " + variable_name; });
+            cond.push_back(g.name(last_added_cpc));
         }
 
-        progress.set_text("MMPC Forward: sepset order 2 for " + variable_name);
         progress.set_max_progress(to_be_checked.size());
         progress.set_progress(0);
 
-        for (auto v : to_be_checked) {
-            const auto& v_name = g.name(v);
-
-            double pvalue = test.pvalue(variable_name, v_name, last_added_name);
-            assoc.update_assoc(v, pvalue);
-
-            pvalue = test.pvalue(variable_name, v_name, cond);
-            assoc.update_assoc(v, pvalue);
+        // All the tests share the conditioning set, so they are submitted together.
+        std::vector<std::pair<std::string, std::string>> pairs;
+        pairs.reserve(variables.size());
+        for (auto v : variables) {
+            pairs.push_back({variable_name, g.name(v)});
+        }
 
+        auto pvalues = profiled_pvalues(test, pairs, cond);
+        for (size_t i = 0; i < variables.size(); ++i) {
+            if (cpc.empty())
+                assoc.initialize_assoc(variables[i], pvalues[i]);
+            else
+                assoc.update_assoc(variables[i], pvalues[i]);
             progress.tick();
         }
-    } else {
-        progress.set_text("MMPC Forward: sepset up to order " + std::to_string(cpc.size()) + " for " + variable_name);
-        progress.set_max_progress(to_be_checked.size());
-        progress.set_progress(0);
 
-        const auto& last_added_name = g.name(last_added_cpc);
-
-        std::vector<std::string> fixed = {last_added_name};
-
-        std::vector<std::string> old_cpc;
-        old_cpc.reserve(cpc.size());
-        for (auto pc : cpc) {
-            if (pc != last_added_cpc) {
-                old_cpc.push_back(g.name(pc));
-            }
-        }
+        return;
+    }
 
-        std::vector<std::string> cond(2);
-        cond[1] = last_added_name;
+    progress.lazy_set_text([&] {
+        return "MMPC Forward: sepset up to order " + std::to_string(cpc.size()) + " for " + variable_name;
+    });
 
-        // Conditioning in all the subsets of 2 to CPC.size()-1 size, including last variable added.
-        AllSubsets<std::string> comb;
-        if (cpc.size() > 3) {
-            comb = AllSubsets(old_cpc, std::move(fixed), 3, cpc.size() - 1);
+    std::vector<std::string> old_cpc;
+    old_cpc.reserve(cpc.size());
+    for (auto pc : cpc) {
+        if (pc != last_added_cpc) {
+            old_cpc.push_back(g.name(pc));
         }
+    }
 
-        for (auto v : to_be_checked) {
-            const auto& v_name = g.name(v);
-            // Conditioning in just the last variable added.
-            double pvalue = test.pvalue(variable_name, v_name, last_added_name);
-            assoc.update_assoc(v, pvalue);
-
-            // Conditioning in the last variable and another variable added.
-            for (const auto& pc : old_cpc) {
-                cond[0] = pc;
-                pvalue = test.pvalue(variable_name, v_name, cond);
-                assoc.update_assoc(v, pvalue);
-            }
+    // The conditioning sets are the same for all the variables, so the tests of each variable are submitted together.
+    auto sepsets = forward_sepsets(std::move(old_cpc), g.name(last_added_cpc));
 
-            if (cpc.size() > 3) {
-                for (const auto& subset : comb) {
-                    pvalue = test.pvalue(variable_name, v_name, subset);
-                    assoc.update_assoc(v, pvalue);
-                }
-            }
+    progress.set_max_progress(to_be_checked.size());
+    progress.set_progress(0);
 
-            // Conditioning in all the variables.
-            old_cpc.push_back(last_added_name);
-            pvalue = test.pvalue(variable_name, v_name, old_cpc);
+    for (auto v : variables) {
+        auto pvalues = profiled_pvalues(test, variable_name, g.name(v), sepsets);
+        for (auto pvalue : pvalues) {
             assoc.update_assoc(v, pvalue);
-            old_cpc.pop_back();
         }
 
         progress.tick();
@@ -507,6 +513,97 @@ void update_to_be_checked(const ColAssoc& assoc, std::unordered_set<int>& to_be_
     }
 }
 
+// The lazy variant of the forward phase loop. The min association of a candidate can only decrease (its p-value can
+// only increase) as the CPC grows, so its stale value is a bound of its current value. The candidates are kept in a
+// heap ordered by their stale values: only the top candidate is updated with the variables added to the CPC since its
+// last update, until the top candidate is up to date. Then, it has the max-min association of all the candidates, so it
+// is added to the CPC if it is dependent. The other candidates are never tested with the conditioning sets of the
+// variables added after they stop being competitive.
+//
+// The assoc contains the association of the candidates given the CPC without last_added.
+template <typename G, typename ColAssoc>
+void mmpc_lazy_forward_phase(const IndependenceTest& test,
+                             const G& g,
+                             int variable,
+                             double alpha,
+                             std::unordered_set<int>& cpc,
+                             std::unordered_set<int>& to_be_checked,
+                             ColAssoc& assoc,
+                             int last_added,
+                             util::BaseProgressBar& progress) {
+    const auto& variable_name = g.name(variable);
+
+    // The CPC before this phase, and the conditioning sets of each variable added in this phase.
+    std::vector<std::string> old_cpc;
+    for (auto pc : cpc) {
+        if (pc != last_added) old_cpc.push_back(g.name(pc));
+    }
+
+    std::vector<std::vector<std::vector<std::string>>> added_sepsets;
+    auto add_to_cpc = [&](int added) {
+        const auto& added_name = g.name(added);
+        added_sepsets.push_back(forward_sepsets(old_cpc, added_name));
+        old_cpc.push_back(added_name);
+
+        progress.lazy_set_text([&] {
+            return "MMPC Forward (lazy): sepset up to order " + std::to_string(old_cpc.size()) + " for " +
+                   variable_name;
+        });
+    };
+
+    add_to_cpc(last_added);
+
+    // Number of variables of added_sepsets tested with each candidate.
+    std::unordered_map<int, size_t> updated;
+    using HeapElement = std::pair<double, int>;
+    std::priority_queue<HeapElement, std::vector<HeapElement>, std::greater<HeapElement>> heap;
+    for (auto v : to_be_checked) {
+        updated[v] = 0;
+        heap.push({assoc.min_assoc(v), v});
+    }
+
+    progress.set_max_progress(to_be_checked.size());
+    progress.set_progress(0);
+
+    assoc.reset_maxmin();
+    while (!heap.empty()) {
+        auto [stale_assoc, v] = heap.top();
+        heap.pop();
+
+        auto& v_updated = updated[v];
+        if (v_updated == added_sepsets.size()) {
+            // No candidate can have a lower p-value, so the forward phase finishes if v is independent.
+            if (stale_assoc >= alpha) break;
+
+            cpc.insert(v);
+            to_be_checked.erase(v);
+            add_to_cpc(v);
+            progress.tick();
+            continue;
+        }
+
+        std::vector<std::vector<std::string>> sepsets;
+        for (auto end = added_sepsets.size(); v_updated < end; ++v_updated) {
+            const auto& s = added_sepsets[v_updated];
+            sepsets.insert(sepsets.end(), s.begin(), s.end());
+        }
+
+        auto pvalues = profiled_pvalues(test, variable_name, g.name(v), sepsets);
+        for (auto pvalue : pvalues) {
+            assoc.update_assoc(v, pvalue);
+        }
+
+        if (assoc.min_assoc(v) > alpha) {
+            to_be_checked.erase(v);
+            progress.tick();
+        } else {
+            heap.push({assoc.min_assoc(v), v});
+        }
+    }
+
+    assoc.reset_maxmin();
+}
+
 template <typename G, typename ColAssoc>
 void mmpc_forward_phase(const IndependenceTest& test,
                         const G& g,
@@ -516,7 +613,8 @@ void mmpc_forward_phase(const IndependenceTest& test,
                         std::unordered_set<int>& to_be_checked,
                         ColAssoc& assoc,
                         int last_added,
-                        util::BaseProgressBar& progress) {
+                        util::BaseProgressBar& progress,
+                        bool lazy = false) {
     bool changed_cpc = true;
 
     if (cpc.empty()) {
@@ -538,6 +636,12 @@ void mmpc_forward_phase(const IndependenceTest& test,
     }
 
     while (changed_cpc && !to_be_checked.empty()) {
+        // The first iteration of an empty CPC computes the marginal association of all the candidates.
+        if (lazy && !cpc.empty()) {
+            mmpc_lazy_forward_phase(test, g, variable, alpha, cpc, to_be_checked, assoc, last_added, progress);
+            return;
+        }
+
         update_min_assoc(test, g, variable, to_be_checked, cpc, assoc, last_added, progress);
         // int to_add = find_maxmin_assoc(assoc, to_be_checked, alpha);
         int to_add = assoc.maxmin_index();
@@ -576,7 +680,7 @@ void mmpc_backward_phase(const IndependenceTest& test,
             subset_variables.push_back(g.name(pc));
         }
 
-        progress.set_text("MMPC Backwards for " + variable_name);
+        progress.lazy_set_text([&] { return "MMPC Backwards for " + variable_name; });
         progress.set_max_progress(cpc.size());
         progress.set_progress(0);
 
@@ -590,49 +694,32 @@ void mmpc_backward_phase(const IndependenceTest& test,
             const auto& it_name = g.name(*it);
             util::swap_remove_v(subset_variables, it_name);
 
-            // Marginal independence
-            if (test.pvalue(variable_name, it_name) > alpha) {
-                it = cpc.erase(it);
-                progress.set_max_progress(cpc.size());
-                progress.tick();
-                continue;
+            // Marginal independence and independence sepset length 1.
+            std::vector<std::vector<std::string>> small_sepsets;
+            small_sepsets.reserve(subset_variables.size() + 1);
+            small_sepsets.push_back({});
+            for (const auto& other : subset_variables) {
+                small_sepsets.push_back({other});
             }
 
-            // Independence sepset length 1.
-            bool found_sepset = false;
-            for (auto it_other = subset_variables.begin(), end_other = subset_variables.end(); it_other != end_other;
-                 ++it_other) {
-                if (test.pvalue(variable_name, it_name, *it_other) > alpha) {
-                    it = cpc.erase(it);
-                    progress.set_max_progress(cpc.size());
-                    found_sepset = true;
-                    break;
-                }
-            }
+            bool found_sepset =
+                find_independent_sepset(test, variable_name, it_name, small_sepsets, alpha).has_value();
 
             if (!found_sepset && subset_variables.size() > 2) {
                 // Independence sepset length 2 to subset size - 1.
                 AllSubsets comb(subset_variables, 2, subset_variables.size() - 1);
-
-                for (const auto& s : comb) {
-                    if (test.pvalue(variable_name, it_name, s) > alpha) {
-                        it = cpc.erase(it);
-                        progress.set_max_progress(cpc.size());
-                        found_sepset = true;
-                        break;
-                    }
-                }
+                found_sepset = find_independent_sepset(test, variable_name, it_name, comb, alpha).has_value();
             }
 
             // Independence sepset length of subset size.
-            if (!found_sepset && subset_variables.size() > 1 &&
-                test.pvalue(variable_name, it_name, subset_variables) > alpha) {
-                it = cpc.erase(it);
-                progress.set_max_progress(cpc.size());
-                found_sepset = true;
+            if (!found_sepset && subset_variables.size() > 1) {
+                found_sepset = profiled_pvalue(test, variable_name, it_name, subset_variables) > alpha;
             }
 
-            if (!found_sepset) {
+            if (found_sepset) {
+                it = cpc.erase(it);
+                progress.set_max_progress(cpc.size());
+            } else {
                 // No sepset found, so include again the variable.
                 subset_variables.push_back(it_name);
                 ++it;
@@ -650,7 +737,8 @@ std::unordered_set<int> mmpc_variable(const IndependenceTest& test,
                                       const ArcSet& arc_whitelist,
                                       const EdgeSet& edge_blacklist,
                                       const EdgeSet& edge_whitelist,
-                                      util::BaseProgressBar& progress) {
+                                      util::BaseProgressBar& progress,
+                                      bool lazy) {
     std::unordered_set<int> cpc;
     std::unordered_set<int> to_be_checked;
 
@@ -690,11 +778,38 @@ std::unordered_set<int> mmpc_variable(const IndependenceTest& test,
     int last_added = 0;
     if (!cpc.empty()) last_added = MMPC_FORWARD_PHASE_RECOMPUTE_ASSOC;
 
-    mmpc_forward_phase(test, g, variable, alpha, cpc, to_be_checked, assoc_col, last_added, progress);
+    mmpc_forward_phase(test, g, variable, alpha, cpc, to_be_checked, assoc_col, last_added, progress, lazy);
     mmpc_backward_phase(test, g, variable, alpha, cpc, arc_whitelist, edge_whitelist, progress);
     return cpc;
 }
 
+// Updates the association of the pairs of variables in the serial order, so the result does not depend on the number of
+// threads used to compute pvalues.
+template <typename G>
+void apply_marginal_pvalues(double alpha,
+                            std::vector<std::unordered_set<int>>& cpcs,
+                            std::vector<std::unordered_set<int>>& to_be_checked,
+                            const std::vector<std::pair<int, int>>& pairs,
+                            const std::vector<double>& pvalues,
+                            BNCPCAssoc<G>& assoc) {
+    for (size_t k = 0; k < pairs.size(); ++k) {
+        auto [i_index, j_index] = pairs[k];
+        double pvalue = pvalues[k];
+        if (pvalue < alpha) {
+            if (cpcs[i_index].empty()) {
+                assoc.initialize_assoc(j_index, i_index, pvalue);
+            }
+
+            if (cpcs[j_index].empty()) {
+                assoc.initialize_assoc(i_index, j_index, pvalue);
+            }
+        } else {
+            to_be_checked[i_index].erase(j_index);
+            to_be_checked[j_index].erase(i_index);
+        }
+    }
+}
+
 template <typename G>
 void marginal_cpcs_all_variables(const IndependenceTest& test,
                                  const G& g,
@@ -703,38 +818,27 @@ void marginal_cpcs_all_variables(const IndependenceTest& test,
                                  std::vector<std::unordered_set<int>>& to_be_checked,
                                  const EdgeSet& edge_blacklist,
                                  BNCPCAssoc<G>& assoc,
+                                 int num_threads,
                                  util::BaseProgressBar& progress) {
     auto nnodes = g.num_nodes();
 
-    progress.set_text("MMPC Forward: No sepset");
-    progress.set_max_progress((nnodes * (nnodes - 1) / 2));
-    progress.set_progress(0);
-
+    std::vector<std::pair<int, int>> pairs;
     for (int i = 0, i_end = nnodes - 1; i < i_end; ++i) {
-        const auto& i_name = g.collapsed_name(i);
-        auto i_index = g.index(i_name);
+        auto i_index = g.index(g.collapsed_name(i));
         for (int j = i + 1; j < nnodes; ++j) {
-            const auto& j_name = g.collapsed_name(j);
-            auto j_index = g.index(j_name);
+            auto j_index = g.index(g.collapsed_name(j));
             if ((cpcs[i_index].empty() || cpcs[j_index].empty()) && edge_blacklist.count({i_index, j_index}) == 0) {
-                double pvalue = test.pvalue(i_name, j_name);
-                if (pvalue < alpha) {
-                    if (cpcs[i_index].empty()) {
-                        assoc.initialize_assoc(j_index, i_index, pvalue);
-                    }
-
-                    if (cpcs[j_index].empty()) {
-                        assoc.initialize_assoc(i_index, j_index, pvalue);
-                    }
-                } else {
-                    to_be_checked[i_index].erase(j_index);
-                    to_be_checked[j_index].erase(i_index);
-                }
+                pairs.push_back({i_index, j_index});
             }
-
-            progress.tick();
         }
     }
+
+    progress.set_text("MMPC Forward: No sepset");
+    progress.set_max_progress(pairs.size());
+    progress.set_progress(0);
+
+    auto pvalues = marginal_pvalues(test, g, pairs, num_threads, progress);
+    apply_marginal_pvalues(alpha, cpcs, to_be_checked, pairs, pvalues, assoc);
 }
 
 void marginal_cpcs_all_variables(const IndependenceTest& test,
@@ -744,43 +848,31 @@ void marginal_cpcs_all_variables(const IndependenceTest& test,
                                  std::vector<std::unordered_set<int>>& to_be_checked,
                                  const EdgeSet& edge_blacklist,
                                  BNCPCAssoc<ConditionalPartiallyDirectedGraph>& assoc,
+                                 int num_threads,
                                  util::BaseProgressBar& progress) {
-    auto nnodes = g.num_nodes();
-    auto inodes = g.num_interface_nodes();
-
-    progress.set_text("MMPC Forward: No sepset");
-    progress.set_max_progress(inodes * nnodes + (nnodes * (nnodes - 1) / 2));
-    progress.set_progress(0);
-
     // Cache marginal between nodes
     marginal_cpcs_all_variables<ConditionalPartiallyDirectedGraph>(
-        test, g, alpha, cpcs, to_be_checked, edge_blacklist, assoc, progress);
+        test, g, alpha, cpcs, to_be_checked, edge_blacklist, assoc, num_threads, progress);
 
     // Cache between nodes and interface_nodes
+    std::vector<std::pair<int, int>> pairs;
     for (const auto& node : g.nodes()) {
         auto nindex = g.index(node);
         for (const auto& inode : g.interface_nodes()) {
             auto iindex = g.index(inode);
 
             if ((cpcs[nindex].empty() || cpcs[iindex].empty()) && edge_blacklist.count({nindex, iindex}) == 0) {
-                double pvalue = test.pvalue(node, inode);
-                if (pvalue < alpha) {
-                    if (cpcs[nindex].empty()) {
-                        assoc.initialize_assoc(iindex, nindex, pvalue);
-                    }
-
-                    if (cpcs[iindex].empty()) {
-                        assoc.initialize_assoc(nindex, iindex, pvalue);
-                    }
-                } else {
-                    to_be_checked[nindex].erase(iindex);
-                    to_be_checked[iindex].erase(nindex);
-                }
+                pairs.push_back({nindex, iindex});
             }
-
-            progress.tick();
         }
     }
+
+    progress.set_text("MMPC Forward: No sepset for interface nodes");
+    progress.set_max_progress(pairs.size());
+    progress.set_progress(0);
+
+    auto pvalues = marginal_pvalues(test, g, pairs, num_threads, progress);
+    apply_marginal_pvalues(alpha, cpcs, to_be_checked, pairs, pvalues, assoc);
 }
 
 template <typename G>
@@ -808,7 +900,7 @@ void univariate_cpcs_all_variables(const IndependenceTest& test,
 
                 if (!repeated_test || i < p) {
                     const auto& p_name = g.name(p);
-                    double pvalue = test.pvalue(i_name, p_name, cpc_name);
+                    double pvalue = profiled_pvalue(test, i_name, p_name, cpc_name);
 
                     assoc.update_assoc(p, i, pvalue);
                     if (assoc.min_assoc(p, i) > alpha)
@@ -915,12 +1007,66 @@ std::vector<std::unordered_set<int>> mmpc_all_variables(const IndependenceTest&
                                                         const ArcSet& arc_whitelist,
                                                         const EdgeSet& edge_blacklist,
                                                         const EdgeSet& edge_whitelist,
-                                                        util::BaseProgressBar& progress) {
+                                                        util::BaseProgressBar& progress,
+                                                        int num_threads,
+                                                        const std::vector<std::unordered_set<int>>* warm_start,
+                                                        bool lazy) {
+    util::gil_release_if_held release(!test.is_python_derived());
+
     auto [cpcs, to_be_checked] = generate_cpcs(g, arc_whitelist, edge_blacklist, edge_whitelist);
 
+    auto for_all_variables = [&](const auto& cpc_variable) {
+        if (util::effective_num_threads(num_threads) <= 1) {
+            for (int i = 0; i < num_total_nodes; ++i) {
+                cpc_variable(i, progress);
+            }
+        } else {
+            // Each variable only modifies its CPC, its to_be_checked set and its column of assoc, so the variables are
+            // processed concurrently. The progress of each variable is not displayed because the threads would
+            // overwrite the text of the others.
+            progress.set_text("MMPC Forward/Backward phases");
+            progress.set_max_progress(num_total_nodes);
+            progress.set_progress(0);
+
+            util::VoidProgressBar void_progress;
+            util::parallel_for(0, num_total_nodes, num_threads, [&](int i, int) {
+                cpc_variable(i, void_progress);
+                progress.tick();
+            });
+        }
+    };
+
+    if (warm_start) {
+        // The CPC of each variable starts from its warm start CPC. The backward phase removes the members that are no
+        // longer dependent, and the forward phase adds the new members with the association given the verified CPC.
+        for_all_variables([&](int i, util::BaseProgressBar& variable_progress) {
+            std::vector<int> previous;
+            for (auto p : (*warm_start)[i]) {
+                if (to_be_checked[i].erase(p) > 0) {
+                    cpcs[i].insert(p);
+                    previous.push_back(p);
+                }
+            }
+
+            mmpc_backward_phase(test, g, i, alpha, cpcs[i], arc_whitelist, edge_whitelist, variable_progress);
+            for (auto p : previous) {
+                if (cpcs[i].count(p) == 0) to_be_checked[i].insert(p);
+            }
+
+            VectorXd min_assoc(cpcs.size());
+            BNCPCAssocCol<VectorXd> assoc_col(min_assoc, alpha);
+            int last_added = cpcs[i].empty() ? 0 : MMPC_FORWARD_PHASE_RECOMPUTE_ASSOC;
+            mmpc_forward_phase(
+                test, g, i, alpha, cpcs[i], to_be_checked[i], assoc_col, last_added, variable_progress, lazy);
+            mmpc_backward_phase(test, g, i, alpha, cpcs[i], arc_whitelist, edge_whitelist, variable_progress);
+        });
+
+        return cpcs;
+    }
+
     BNCPCAssoc assoc(g, alpha);
 
-    marginal_cpcs_all_variables(test, g, alpha, cpcs, to_be_checked, edge_blacklist, assoc, progress);
+    marginal_cpcs_all_variables(test, g, alpha, cpcs, to_be_checked, edge_blacklist, assoc, num_threads, progress);
 
     bool all_finished = true;
     for (int i = 0; i < num_total_nodes; ++i) {
@@ -938,7 +1084,7 @@ std::vector<std::unordered_set<int>> mmpc_all_variables(const IndependenceTest&
     if (!all_finished) {
         univariate_cpcs_all_variables(test, g, num_total_nodes, alpha, cpcs, to_be_checked, assoc, progress);
 
-        for (int i = 0; i < num_total_nodes; ++i) {
+        auto cpc_variable = [&](int i, util::BaseProgressBar& variable_progress) {
             auto col_min_assoc = assoc.min_assoc_col(i);
             // The cpc is whitelisted.
             if (cpcs[i].size() > 1) {
@@ -950,16 +1096,27 @@ std::vector<std::unordered_set<int>> mmpc_all_variables(const IndependenceTest&
                                    to_be_checked[i],
                                    col_min_assoc,
                                    MMPC_FORWARD_PHASE_RECOMPUTE_ASSOC,
-                                   progress);
+                                   variable_progress,
+                                   lazy);
             } else if (assoc.maxmin_index(i) != MMPC_FORWARD_PHASE_STOP) {
                 cpcs[i].insert(assoc.maxmin_index(i));
                 to_be_checked[i].erase(assoc.maxmin_index(i));
-                mmpc_forward_phase(
-                    test, g, i, alpha, cpcs[i], to_be_checked[i], col_min_assoc, assoc.maxmin_index(i), progress);
+                mmpc_forward_phase(test,
+                                   g,
+                                   i,
+                                   alpha,
+                                   cpcs[i],
+                                   to_be_checked[i],
+                                   col_min_assoc,
+                                   assoc.maxmin_index(i),
+                                   variable_progress,
+                                   lazy);
             }
 
-            mmpc_backward_phase(test, g, i, alpha, cpcs[i], arc_whitelist, edge_whitelist, progress);
-        }
+            mmpc_backward_phase(test, g, i, alpha, cpcs[i], arc_whitelist, edge_whitelist, variable_progress);
+        };
+
+        for_all_variables(cpc_variable);
     }
 
     return cpcs;
@@ -974,8 +1131,21 @@ std::vector<std::unordered_set<int>> mmpc_all_variables(const IndependenceTest&
                                                         const ArcSet& arc_whitelist,
                                                         const EdgeSet& edge_blacklist,
                                                         const EdgeSet& edge_whitelist,
-                                                        util::BaseProgressBar& progress) {
-    return mmpc_all_variables(test, g, g.num_nodes(), alpha, arc_whitelist, edge_blacklist, edge_whitelist, progress);
+                                                        util::BaseProgressBar& progress,
+                                                        int num_threads,
+                                                        const std::vector<std::unordered_set<int>>* warm_start,
+                                                        bool lazy) {
+    return mmpc_all_variables(test,
+                              g,
+                              g.num_nodes(),
+                              alpha,
+                              arc_whitelist,
+                              edge_blacklist,
+                              edge_whitelist,
+                              progress,
+                              num_threads,
+                              warm_start,
+                              lazy);
 }
 
 //
@@ -987,9 +1157,21 @@ std::vector<std::unordered_set<int>> mmpc_all_variables(const IndependenceTest&
                                                         const ArcSet& arc_whitelist,
                                                         const EdgeSet& edge_blacklist,
                                                         const EdgeSet& edge_whitelist,
-                                                        util::BaseProgressBar& progress) {
-    return mmpc_all_variables(
-        test, g, g.num_joint_nodes(), alpha, arc_whitelist, edge_blacklist, edge_whitelist, progress);
+                                                        util::BaseProgressBar& progress,
+                                                        int num_threads,
+                                                        const std::vector<std::unordered_set<int>>* warm_start,
+                                                        bool lazy) {
+    return mmpc_all_variables(test,
+                              g,
+                              g.num_joint_nodes(),
+                              alpha,
+                              arc_whitelist,
+                              edge_blacklist,
+                              edge_whitelist,
+                              progress,
+                              num_threads,
+                              warm_start,
+                              lazy);
 }
 
 template <typename G>
@@ -1002,7 +1184,9 @@ void estimate(G& skeleton,
               double alpha,
               double ambiguous_threshold,
               bool allow_bidirected,
-              int verbose) {
+              int verbose,
+              int num_threads,
+              bool lazy) {
     auto restrictions =
         util::validate_restrictions(skeleton, varc_blacklist, varc_whitelist, vedge_blacklist, vedge_whitelist);
 
@@ -1018,7 +1202,10 @@ void estimate(G& skeleton,
                                    restrictions.arc_whitelist,
                                    restrictions.edge_blacklist,
                                    restrictions.edge_whitelist,
-                                   *progress);
+                                   *progress,
+                                   num_threads,
+                                   nullptr,
+                                   lazy);
 
     for (auto i = 0; i < skeleton.num_nodes(); ++i) {
         for (auto p : cpcs[i]) {
@@ -1051,21 +1238,8 @@ void estimate(G& skeleton,
                               allow_bidirected,
                               *progress);
 
-    progress->set_max_progress(3);
     progress->set_text("Applying Meek rules");
-
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        progress->set_progress(0);
-
-        changed |= MeekRules::rule1(skeleton);
-        progress->tick();
-        changed |= MeekRules::rule2(skeleton);
-        progress->tick();
-        changed |= MeekRules::rule3(skeleton);
-        progress->tick();
-    }
+    MeekRules::apply(skeleton, num_threads);
 
     progress->mark_as_completed("Finished MMPC!");
 }
@@ -1079,7 +1253,9 @@ PartiallyDirectedGraph MMPC::estimate(const IndependenceTest& test,
                                       double alpha,
                                       double ambiguous_threshold,
                                       bool allow_bidirected,
-                                      int verbose) const {
+                                      int verbose,
+                                      int num_threads,
+                                      bool lazy) const {
     if (alpha <= 0 || alpha >= 1) throw std::invalid_argument("alpha must be a number between 0 and 1.");
     if (ambiguous_threshold < 0 || ambiguous_threshold > 1)
         throw std::invalid_argument("ambiguous_threshold must be a number between 0 and 1.");
@@ -1102,7 +1278,9 @@ PartiallyDirectedGraph MMPC::estimate(const IndependenceTest& test,
                                    alpha,
                                    ambiguous_threshold,
                                    allow_bidirected,
-                                   verbose);
+                                   verbose,
+                                   num_threads,
+                                   lazy);
 
     return skeleton;
 }
@@ -1117,7 +1295,9 @@ ConditionalPartiallyDirectedGraph MMPC::estimate_conditional(const IndependenceT
                                                              double alpha,
                                                              double ambiguous_threshold,
                                                              bool allow_bidirected,
-                                                             int verbose) const {
+                                                             int verbose,
+                                                             int num_threads,
+                                                             bool lazy) const {
     if (alpha <= 0 || alpha >= 1) throw std::invalid_argument("alpha must be a number between 0 and 1.");
     if (ambiguous_threshold < 0 || ambiguous_threshold > 1)
         throw std::invalid_argument("ambiguous_threshold must be a number between 0 and 1.");
@@ -1133,7 +1313,9 @@ ConditionalPartiallyDirectedGraph MMPC::estimate_conditional(const IndependenceT
                               alpha,
                               ambiguous_threshold,
                               allow_bidirected,
-                              verbose)
+                              verbose,
+                              num_threads,
+                              lazy)
             .conditional_graph();
 
     if (!test.has_variables(nodes) || !test.has_variables(interface_nodes))
@@ -1151,7 +1333,9 @@ ConditionalPartiallyDirectedGraph MMPC::estimate_conditional(const IndependenceT
                                    alpha,
                                    ambiguous_threshold,
                                    allow_bidirected,
-                                   verbose);
+                                   verbose,
+                                   num_threads,
+                                   lazy);
     return skeleton;
 }
 
@@ -11,6 +11,8 @@ using util::ArcStringVector, util::EdgeStringVector;
 
 namespace learning::algorithms {
 
+// If lazy is true, the forward phase only updates the association of the candidates that can have the max-min
+// association (see mmpc_lazy_forward_phase()). The CPCs are the same, but many less independence tests are executed.
 std::unordered_set<int> mmpc_variable(const IndependenceTest& test,
                                       const PartiallyDirectedGraph& g,
                                       int variable,
@@ -18,23 +20,35 @@ std::unordered_set<int> mmpc_variable(const IndependenceTest& test,
                                       const ArcSet& arc_whitelist,
                                       const EdgeSet& edge_blacklist,
                                       const EdgeSet& edge_whitelist,
-                                      util::BaseProgressBar& progress);
+                                      util::BaseProgressBar& progress,
+                                      bool lazy = false);
 
-std::vector<std::unordered_set<int>> mmpc_all_variables(const IndependenceTest& test,
-                                                        const PartiallyDirectedGraph& g,
-                                                        double alpha,
-                                                        const ArcSet& arc_whitelist,
-                                                        const EdgeSet& edge_blacklist,
-                                                        const EdgeSet& edge_whitelist,
-                                                        util::BaseProgressBar& progress);
+// If warm_start is not null, the CPC of each variable is searched starting from (*warm_start)[i] (e.g., the CPCs of a
+// previous time window), which is verified and repaired instead of searching from an empty CPC. The lazy parameter is
+// the same as in mmpc_variable().
+std::vector<std::unordered_set<int>> mmpc_all_variables(
+    const IndependenceTest& test,
+    const PartiallyDirectedGraph& g,
+    double alpha,
+    const ArcSet& arc_whitelist,
+    const EdgeSet& edge_blacklist,
+    const EdgeSet& edge_whitelist,
+    util::BaseProgressBar& progress,
+    int num_threads = 1,
+    const std::vector<std::unordered_set<int>>* warm_start = nullptr,
+    bool lazy = false);
 
-std::vector<std::unordered_set<int>> mmpc_all_variables(const IndependenceTest& test,
-                                                        const ConditionalPartiallyDirectedGraph& g,
-                                                        double alpha,
-                                                        const ArcSet& arc_whitelist,
-                                                        const EdgeSet& edge_blacklist,
-                                                        const EdgeSet& edge_whitelist,
-                                                        util::BaseProgressBar& progress);
+std::vector<std::unordered_set<int>> mmpc_all_variables(
+    const IndependenceTest& test,
+    const ConditionalPartiallyDirectedGraph& g,
+    double alpha,
+    const ArcSet& arc_whitelist,
+    const EdgeSet& edge_blacklist,
+    const EdgeSet& edge_whitelist,
+    util::BaseProgressBar& progress,
+    int num_threads = 1,
+    const std::vector<std::unordered_set<int>>* warm_start = nullptr,
+    bool lazy = false);
 
 class MMPC {
 public:
@@ -47,7 +61,9 @@ public:
                                     double alpha,
                                     double ambiguous_threshold,
                                     bool allow_bidirected,
-                                    int verbose) const;
+                                    int verbose,
+                                    int num_threads = 1,
+                                    bool lazy = false) const;
 
     ConditionalPartiallyDirectedGraph estimate_conditional(const IndependenceTest& test,
                                                            const std::vector<std::string>& nodes,
@@ -59,7 +75,9 @@ public:
                                                            double alpha,
                                                            double ambiguous_threshold,
                                                            bool allow_bidirected,
-                                                           int verbose) const;
+                                                           int verbose,
+                                                           int num_threads = 1,
+                                                           bool lazy = false) const;
 };
 
 }  // namespace learning::algorithms
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <learning/algorithms/order_search.hpp>
+#include <util/math_constants.hpp>
+#include <util/parallel.hpp>
+#include <util/progress.hpp>
+
+namespace learning::algorithms {
+
+namespace {
+
+// The parent sets of a node that have a better score than all their subsets, sorted by decreasing score. The parents
+// are the indices of the nodes, in increasing order.
+struct ParentSetList {
+    std::vector<std::vector<int>> sets;
+    std::vector<double> scores;
+
+    // Returns the index of the best parent set where all the parents satisfy allowed(p), or -1 if there is none.
+    template <typename F>
+    int best(F&& allowed) const {
+        for (size_t i = 0; i < sets.size(); ++i) {
+            if (std::all_of(sets[i].begin(), sets[i].end(), allowed)) return static_cast<int>(i);
+        }
+        return -1;
+    }
+};
+
+// Calls f(subset) for each subset of k elements of candidates.
+template <typename F>
+void for_each_combination(const std::vector<int>& candidates, int k, F&& f) {
+    int n = candidates.size();
+    if (k > n) return;
+
+    std::vector<int> indices(k);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::vector<int> subset(k);
+    while (true) {
+        for (int i = 0; i < k; ++i) subset[i] = candidates[indices[i]];
+        f(subset);
+
+        int i = k - 1;
+        while (i >= 0 && indices[i] == n - k + i) --i;
+        if (i < 0) return;
+
+        ++indices[i];
+        for (int j = i + 1; j < k; ++j) indices[j] = indices[j - 1] + 1;
+    }
+}
+
+// Caches the local scores of the parent sets of v with at most max_indegree (if positive) parents among candidates. The
+// parent sets are evaluated by increasing size, so each parent set is only compared with its subsets that were not
+// pruned: if a pruned subset is better, a subset of that subset is also better.
+ParentSetList cache_parent_sets(const BayesianNetworkBase& model,
+                                const Score& score,
+                                LocalScoreMemo& memo,
+                                const std::vector<std::string>& nodes,
+                                int v,
+                                const std::vector<int>& candidates,
+                                int max_indegree) {
+    int max_size = candidates.size();
+    if (max_indegree > 0) max_size = std::min(max_size, max_indegree);
+
+    ParentSetList res;
+    std::vector<std::string> parents;
+    for (int k = 0; k <= max_size; ++k) {
+        for_each_combination(candidates, k, [&](const std::vector<int>& subset) {
+            parents.clear();
+            for (auto p : subset) parents.push_back(nodes[p]);
+
+            auto s = memo.local_score(model, score, nodes[v], parents);
+            if (std::isnan(s)) return;
+
+            for (size_t i = 0; i < res.sets.size(); ++i) {
+                const auto& kept = res.sets[i];
+                if (res.scores[i] >= s && std::includes(subset.begin(), subset.end(), kept.begin(), kept.end())) return;
+            }
+
+            res.sets.push_back(subset);
+            res.scores.push_back(s);
+        });
+    }
+
+    // Ties are broken by the order of evaluation, so the smallest parent sets are preferred.
+    std::vector<int> indices(res.sets.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::stable_sort(
+        indices.begin(), indices.end(), [&res](int a, int b) { return res.scores[a] > res.scores[b]; });
+
+    ParentSetList sorted;
+    for (auto i : indices) {
+        sorted.sets.push_back(std::move(res.sets[i]));
+        sorted.scores.push_back(res.scores[i]);
+    }
+
+    return sorted;
+}
+
+class OrderState {
+public:
+    OrderState(const std::vector<ParentSetList>& parent_sets, std::vector<int>&& order)
+        : m_parent_sets(parent_sets), m_order(std::move(order)), m_position(m_order.size()), m_best(m_order.size()) {
+        for (size_t i = 0; i < m_order.size(); ++i) {
+            m_position[m_order[i]] = i;
+        }
+
+        for (size_t v = 0; v < m_order.size(); ++v) {
+            m_best[v] = best(v, [this, v](int p) { return m_position[p] < m_position[v]; });
+        }
+    }
+
+    const std::vector<int>& order() const { return m_order; }
+    const std::vector<int>& parents(int v) const { return m_parent_sets[v].sets[m_best[v]]; }
+    double local_score(int v) const { return m_parent_sets[v].scores[m_best[v]]; }
+
+    // Delta score of swapping the nodes in the positions i and i + 1.
+    double swap_delta(int i) const {
+        auto u = m_order[i];
+        auto w = m_order[i + 1];
+        auto [new_u, new_w] = swap_best(i);
+        return m_parent_sets[u].scores[new_u] + m_parent_sets[w].scores[new_w] - local_score(u) - local_score(w);
+    }
+
+    void swap(int i) {
+        auto u = m_order[i];
+        auto w = m_order[i + 1];
+        auto [new_u, new_w] = swap_best(i);
+        std::swap(m_order[i], m_order[i + 1]);
+        m_position[u] = i + 1;
+        m_position[w] = i;
+        m_best[u] = new_u;
+        m_best[w] = new_w;
+    }
+
+private:
+    template <typename F>
+    int best(int v, F&& allowed) const {
+        auto b = m_parent_sets[v].best(allowed);
+        // The empty parent set is always allowed, so it only happens if its local score is NaN.
+        if (b == -1) throw std::invalid_argument("There is no parent set with a valid local score for a node.");
+        return b;
+    }
+
+    // The best parent sets of the nodes in the positions i and i + 1 after swapping them.
+    std::pair<int, int> swap_best(int i) const {
+        auto u = m_order[i];
+        auto w = m_order[i + 1];
+        auto new_u = best(u, [this, i, w](int p) { return m_position[p] < i || p == w; });
+        auto new_w = best(w, [this, i](int p) { return m_position[p] < i; });
+        return {new_u, new_w};
+    }
+
+    const std::vector<ParentSetList>& m_parent_sets;
+    std::vector<int> m_order;
+    std::vector<int> m_position;
+    std::vector<int> m_best;
+};
+
+}  // namespace
+
+std::shared_ptr<BayesianNetworkBase> OrderBasedSearch::estimate(
+    Score& score,
+    const std::vector<std::string>& nodes,
+    const BayesianNetworkType& bn_type,
+    const CandidateParents& candidate_parents,
+    int max_indegree,
+    int max_iters,
+    double epsilon,
+    int verbose,
+    int num_threads,
+    const std::shared_ptr<LocalScoreMemo> score_memo) const {
+    if (!bn_type.is_homogeneous())
+        throw std::invalid_argument("OrderBasedSearch requires a homogeneous Bayesian network type.");
+    if (max_indegree < 0) throw std::invalid_argument("max_indegree must be a non-negative number.");
+
+    std::vector<std::string> model_nodes = nodes;
+    if (model_nodes.empty())
+        model_nodes = score.data().column_names();
+    else if (!score.has_variables(model_nodes))
+        throw std::invalid_argument("Score do not contain all the variables in nodes list.");
+
+    auto model = bn_type.new_bn(model_nodes);
+    if (!score.compatible_bn(*model)) throw std::invalid_argument("BayesianNetwork is not compatible with the score.");
+
+    int num_nodes = model_nodes.size();
+    std::unordered_map<std::string, int> positions;
+    for (int i = 0; i < num_nodes; ++i) {
+        positions.insert({model_nodes[i], i});
+    }
+
+    std::vector<std::vector<int>> candidates(num_nodes);
+    for (int v = 0; v < num_nodes; ++v) {
+        auto it = candidate_parents.find(model_nodes[v]);
+        if (it == candidate_parents.end()) {
+            for (int p = 0; p < num_nodes; ++p) {
+                if (p != v) candidates[v].push_back(p);
+            }
+        } else {
+            for (const auto& c : it->second) {
+                auto p = positions.find(c);
+                if (p == positions.end())
+                    throw std::invalid_argument("Candidate parent " + c + " of node " + model_nodes[v] +
+                                                " is not in the list of nodes.");
+                if (p->second != v) candidates[v].push_back(p->second);
+            }
+
+            std::sort(candidates[v].begin(), candidates[v].end());
+            candidates[v].erase(std::unique(candidates[v].begin(), candidates[v].end()), candidates[v].end());
+        }
+    }
+
+    bool python_derived = score.is_python_derived() || model->has_python_derived();
+    util::gil_release_if_held release(!python_derived);
+    auto threads = python_derived ? 1 : num_threads;
+
+    LocalScoreMemo own_memo;
+    if (score_memo) score_memo->check_score(score);
+    auto& memo = score_memo ? *score_memo : own_memo;
+
+    auto spinner = util::indeterminate_spinner(verbose);
+    spinner->update_status("Caching the scores of the parent sets...");
+
+    std::vector<ParentSetList> parent_sets(num_nodes);
+    util::parallel_for(0, num_nodes, threads, [&](int v, int) {
+        parent_sets[v] = cache_parent_sets(*model, score, memo, model_nodes, v, candidates[v], max_indegree);
+    });
+
+    std::vector<int> order(num_nodes);
+    std::iota(order.begin(), order.end(), 0);
+    OrderState state(parent_sets, std::move(order));
+
+    std::vector<double> deltas(std::max(num_nodes - 1, 0));
+    util::parallel_for(0, deltas.size(), threads, [&](int i, int) { deltas[i] = state.swap_delta(i); });
+
+    for (int iter = 0; iter < max_iters && !deltas.empty(); ++iter) {
+        auto best = std::max_element(deltas.begin(), deltas.end()) - deltas.begin();
+        auto delta = deltas[best];
+        if ((delta - epsilon) < util::machine_tol) break;
+
+        state.swap(best);
+        // Only the swaps with the positions best and best + 1 change.
+        for (auto i = std::max<int>(best - 1, 0); i <= std::min<int>(best + 1, deltas.size() - 1); ++i) {
+            deltas[i] = state.swap_delta(i);
+        }
+
+        spinner->lazy_update_status([&]() {
+            return "Swap(" + model_nodes[state.order()[best + 1]] + ", " + model_nodes[state.order()[best]] +
+                   ") | Delta: " + std::to_string(delta);
+        });
+    }
+
+    for (int v = 0; v < num_nodes; ++v) {
+        for (auto p : state.parents(v)) {
+            model->add_arc_unsafe(model_nodes[p], model_nodes[v]);
+        }
+    }
+
+    spinner->mark_as_completed("Finished OrderBasedSearch!");
+    return model;
+}
+
+}  // namespace learning::algorithms
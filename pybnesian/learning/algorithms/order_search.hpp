@@ -0,0 +1,35 @@
+#ifndef PYBNESIAN_LEARNING_ALGORITHMS_ORDER_SEARCH_HPP
+#define PYBNESIAN_LEARNING_ALGORITHMS_ORDER_SEARCH_HPP
+
+#include <models/BayesianNetwork.hpp>
+#include <learning/scores/scores.hpp>
+#include <learning/operators/operators.hpp>
+
+using learning::operators::CandidateParents, learning::operators::LocalScoreMemo;
+using learning::scores::Score;
+using models::BayesianNetworkBase, models::BayesianNetworkType;
+
+namespace learning::algorithms {
+
+// Order-based search by M. Teyssier and D. Koller (2005). Ordering-Based Search: A Simple and Effective Algorithm for
+// Learning Bayesian Networks. The search is a hill-climbing over the topological orders of the nodes, where each node
+// takes its best parent set among its predecessors in the order. The local scores of the parent sets of each node (with
+// at most max_indegree parents among its candidate parents) are cached once, in parallel, so the score of an order and
+// the delta score of swapping two adjacent nodes are computed without evaluating new local scores.
+class OrderBasedSearch {
+public:
+    std::shared_ptr<BayesianNetworkBase> estimate(Score& score,
+                                                  const std::vector<std::string>& nodes,
+                                                  const BayesianNetworkType& bn_type,
+                                                  const CandidateParents& candidate_parents,
+                                                  int max_indegree,
+                                                  int max_iters,
+                                                  double epsilon,
+                                                  int verbose = 0,
+                                                  int num_threads = 1,
+                                                  const std::shared_ptr<LocalScoreMemo> score_memo = nullptr) const;
+};
+
+}  // namespace learning::algorithms
+
+#endif  // PYBNESIAN_LEARNING_ALGORITHMS_ORDER_SEARCH_HPP
@@ -1,9 +1,13 @@
+#include <atomic>
 #include <optional>
 #include <graph/graph_types.hpp>
 #include <learning/algorithms/pc.hpp>
 #include <learning/algorithms/constraint.hpp>
+#include <learning/algorithms/checkpoint.hpp>
 #include <util/combinations.hpp>
 #include <util/validate_whitelists.hpp>
+#include <util/parallel.hpp>
+#include <util/profiler.hpp>
 #include <util/progress.hpp>
 #include <util/vector.hpp>
 
@@ -14,6 +18,36 @@ using util::Combinations, util::Combinations2Sets, util::ProgressBar;
 
 namespace learning::algorithms {
 
+using MarginalPvalues = std::unordered_map<Edge, double, EdgeHash, EdgeEqualTo>;
+
+// Counts the edges tested by PC, so the tests stop when the SearchBudget runs out. The edges that are not tested are
+// kept in the skeleton. Without a budget, all the edges are tested.
+class TestBudget {
+public:
+    TestBudget(const std::shared_ptr<SearchBudget>& budget)
+        : m_budget(budget), m_evaluations(0), m_interrupted(false) {}
+
+    bool limited() const { return m_budget != nullptr; }
+    // Returns true if some edge was not tested because the budget ran out.
+    bool interrupted() const { return m_interrupted; }
+
+    // Returns false if the budget ran out. Otherwise, counts num_edges new tested edges.
+    bool take(int64_t num_edges) {
+        if (m_budget && m_budget->stop(m_evaluations)) {
+            m_interrupted = true;
+            return false;
+        }
+
+        m_evaluations += num_edges;
+        return true;
+    }
+
+private:
+    std::shared_ptr<SearchBudget> m_budget;
+    std::atomic<int64_t> m_evaluations;
+    std::atomic<bool> m_interrupted;
+};
+
 template <typename G>
 bool max_cardinality(const G& g, int max_cardinality) {
     for (int i = 0; i < g.num_nodes(); ++i) {
@@ -22,77 +56,196 @@ bool max_cardinality(const G& g, int max_cardinality) {
     return true;
 }
 
-template <typename G>
-void remove_edges(G& g, const std::vector<Edge>& edges) {
-    for (auto edge : edges) {
-        g.remove_edge(edge.first, edge.second);
+// Searches a sepset for each edge with find_sepset(edge), concurrently with num_threads threads. The skeleton is not
+// modified while the sepsets are searched, so every test of a level uses the same adjacencies (as in PC-stable
+// [pc-stable]). Then, the edges with a sepset are removed and the sepsets are stored in the order of edges, so the
+// result does not depend on the number of threads. With a limited budget, the parallel threads take the budget in the
+// order they run. In the deterministic mode (see util::deterministic_mode()), the budget of the edges is taken in the
+// order of edges before the search, so the same edges are tested with any number of threads.
+template <typename G, typename FindSepset>
+void remove_separated_edges(G& skeleton,
+                            const std::vector<Edge>& edges,
+                            SepSet& sepset,
+                            int num_threads,
+                            util::BaseProgressBar& progress,
+                            TestBudget& budget,
+                            FindSepset&& find_sepset) {
+    std::vector<std::optional<std::pair<std::unordered_set<int>, double>>> found(edges.size());
+
+    std::vector<char> tested;
+    if (budget.limited() && util::deterministic_mode()) {
+        tested.reserve(edges.size());
+        for (size_t i = 0; i < edges.size(); ++i) {
+            tested.push_back(budget.take(1));
+        }
+    }
+
+    util::parallel_for(0, static_cast<int>(edges.size()), num_threads, [&](int i, int) {
+        if (tested.empty() ? budget.take(1) : tested[i]) found[i] = find_sepset(edges[i]);
+        progress.tick();
+    });
+
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (found[i]) {
+            skeleton.remove_edge(edges[i].first, edges[i].second);
+            sepset.insert(edges[i], std::move(found[i]->first), found[i]->second);
+        }
     }
 }
 
+// Returns the p-values of the marginal tests of the edges that are kept in the skeleton.
 template <typename G>
-void filter_marginal_skeleton(G& skeleton,
-                              const IndependenceTest& test,
-                              SepSet& sepset,
-                              double alpha,
-                              EdgeSet& edge_whitelist,
-                              util::BaseProgressBar& progress) {
+MarginalPvalues filter_marginal_skeleton(G& skeleton,
+                                         const IndependenceTest& test,
+                                         SepSet& sepset,
+                                         double alpha,
+                                         EdgeSet& edge_whitelist,
+                                         int num_threads,
+                                         util::BaseProgressBar& progress,
+                                         TestBudget& budget) {
     int nnodes = skeleton.num_nodes();
-    if constexpr (graph::is_unconditional_graph_v<G>)
-        progress.set_max_progress((nnodes * (nnodes - 1) / 2) - edge_whitelist.size());
-    else if constexpr (graph::is_conditional_graph_v<G>) {
-        progress.set_max_progress((nnodes * (nnodes - 1) / 2) + nnodes * skeleton.num_interface_nodes() -
-                                  edge_whitelist.size());
-    } else
-        static_assert(util::always_false<G>, "Wrong graph class");
-
-    progress.set_text("No sepset");
-    progress.set_progress(0);
-
     const auto& nodes = skeleton.nodes();
 
+    std::vector<Edge> edges;
     for (int i = 0; i < nnodes - 1; ++i) {
         auto index = skeleton.index(nodes[i]);
         for (int j = i + 1; j < nnodes; ++j) {
             auto other_index = skeleton.index(nodes[j]);
 
             if (skeleton.has_edge_unsafe(index, other_index) && edge_whitelist.count({index, other_index}) == 0) {
-                double pvalue = test.pvalue(nodes[i], nodes[j]);
-                if (pvalue > alpha) {
-                    skeleton.remove_edge_unsafe(index, other_index);
-                    sepset.insert({index, other_index}, {}, pvalue);
-                }
-                progress.tick();
+                edges.push_back({index, other_index});
             }
         }
     }
 
     if constexpr (graph::is_conditional_graph_v<G>) {
-        const auto& interface_nodes = skeleton.interface_nodes();
-
         for (const auto& node : nodes) {
             auto nindex = skeleton.index(node);
-            for (const auto& inode : interface_nodes) {
+            for (const auto& inode : skeleton.interface_nodes()) {
                 auto iindex = skeleton.index(inode);
 
                 if (skeleton.has_edge_unsafe(nindex, iindex) && edge_whitelist.count({nindex, iindex}) == 0) {
-                    double pvalue = test.pvalue(node, inode);
-                    if (pvalue > alpha) {
-                        skeleton.remove_edge_unsafe(nindex, iindex);
-                        sepset.insert({nindex, iindex}, {}, pvalue);
-                    }
-
-                    progress.tick();
+                    edges.push_back({nindex, iindex});
                 }
             }
         }
     }
+
+    progress.set_max_progress(edges.size());
+    progress.set_text("No sepset");
+    progress.set_progress(0);
+
+    if (!budget.take(edges.size())) return {};
+
+    auto pvalues = marginal_pvalues(test, skeleton, edges, num_threads, progress);
+
+    MarginalPvalues kept;
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (pvalues[i] > alpha) {
+            skeleton.remove_edge(edges[i].first, edges[i].second);
+            sepset.insert(edges[i], std::unordered_set<int>{}, pvalues[i]);
+        } else {
+            kept.insert({edges[i], pvalues[i]});
+        }
+    }
+
+    return kept;
+}
+
+// Returns the indices of the variables of sepset.
+template <typename G>
+std::unordered_set<int> sepset_indices(const G& g, const std::vector<std::string>& sepset) {
+    std::unordered_set<int> indices;
+    std::transform(sepset.begin(),
+                   sepset.end(),
+                   std::inserter(indices, indices.begin()),
+                   [&g](const std::string& name) { return g.index(name); });
+
+    return indices;
+}
+
+// Returns the marginal p-value of the edge, or nullopt if the edge was not tested in the marginal level (e.g., if it is
+// whitelisted or the search was resumed from a PCCheckpoint).
+inline std::optional<double> marginal_pvalue(const MarginalPvalues& marginal, const Edge& edge) {
+    auto it = marginal.find(edge);
+    if (it != marginal.end()) return it->second;
+    return {};
+}
+
+// Sorts the candidate conditioning variables of the edge so the variables most strongly associated with the pair of
+// nodes come first. The association of a candidate is its smallest marginal p-value with any of the two nodes, and the
+// candidates without marginal p-values come last. The ties are sorted by index.
+inline void sort_by_association(std::vector<int>& candidates, const Edge& edge, const MarginalPvalues& marginal) {
+    auto association = [&marginal, &edge](int c) {
+        double pvalue = 1;
+        if (auto p = marginal_pvalue(marginal, {edge.first, c})) pvalue = std::min(pvalue, *p);
+        if (auto p = marginal_pvalue(marginal, {edge.second, c})) pvalue = std::min(pvalue, *p);
+        return pvalue;
+    };
+
+    std::vector<std::pair<double, int>> sorted;
+    sorted.reserve(candidates.size());
+    for (auto c : candidates) {
+        sorted.push_back({association(c), c});
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        candidates[i] = sorted[i].second;
+    }
+}
+
+template <typename G>
+std::vector<std::string> candidate_names(const G& g, const std::vector<int>& candidates) {
+    std::vector<std::string> names;
+    names.reserve(candidates.size());
+    for (auto c : candidates) {
+        names.push_back(g.name(c));
+    }
+
+    return names;
 }
 
+// Enumerates the conditioning sets of an edge one by one, so the batched search of a level can test the next sets of
+// each edge in every round.
+class SepsetCursor {
+public:
+    virtual ~SepsetCursor() = default;
+    // Stores the next conditioning set in s. Returns false if all the conditioning sets were enumerated.
+    virtual bool next(std::vector<std::string>& s) = 0;
+};
+
+// A SepsetCursor over the conditioning sets of a sequence (a vector of sets or a Combinations object).
+template <typename Sequence>
+class SequenceCursor : public SepsetCursor {
+public:
+    SequenceCursor(Sequence&& sequence)
+        : m_sequence(std::move(sequence)), m_it(m_sequence.begin()), m_end(m_sequence.end()) {}
+
+    bool next(std::vector<std::string>& s) override {
+        if (m_it == m_end) return false;
+        s = *m_it;
+        ++m_it;
+        return true;
+    }
+
+private:
+    Sequence m_sequence;
+    decltype(std::declval<Sequence&>().begin()) m_it;
+    decltype(std::declval<Sequence&>().begin()) m_end;
+};
+
+template <typename Sequence>
+std::unique_ptr<SepsetCursor> sequence_cursor(Sequence sequence) {
+    return std::make_unique<SequenceCursor<Sequence>>(std::move(sequence));
+}
+
+// Returns the conditioning sets of size 1 of the edge, in the order tested by find_univariate_sepset(). If association
+// is not null, the sets are sorted with sort_by_association().
 template <typename G>
-std::optional<std::pair<int, double>> find_univariate_sepset(const G& g,
-                                                             const Edge& edge,
-                                                             double alpha,
-                                                             const IndependenceTest& test) {
+std::vector<std::vector<std::string>> univariate_sepsets(const G& g,
+                                                         const Edge& edge,
+                                                         const MarginalPvalues* association) {
     std::unordered_set<int> u;
     const auto& n1 = g.raw_node(edge.first);
     const auto& n2 = g.raw_node(edge.second);
@@ -105,113 +258,236 @@ std::optional<std::pair<int, double>> find_univariate_sepset(const G& g,
     u.erase(edge.first);
     u.erase(edge.second);
 
-    const auto& first_name = g.name(edge.first);
-    const auto& second_name = g.name(edge.second);
-    for (auto cond : u) {
-        double pvalue = test.pvalue(first_name, second_name, g.name(cond));
-        if (pvalue > alpha) {
-            return std::optional<std::pair<int, double>>(std::make_pair(cond, pvalue));
-        }
+    std::vector<int> candidates(u.begin(), u.end());
+    if (association) sort_by_association(candidates, edge, *association);
+
+    std::vector<std::vector<std::string>> sepsets;
+    sepsets.reserve(candidates.size());
+    for (auto cond : candidates) {
+        sepsets.push_back({g.name(cond)});
+    }
+
+    return sepsets;
+}
+
+template <typename G>
+std::optional<std::pair<std::unordered_set<int>, double>> find_univariate_sepset(const G& g,
+                                                                                 const Edge& edge,
+                                                                                 double alpha,
+                                                                                 const IndependenceTest& test,
+                                                                                 const MarginalPvalues* association) {
+    auto sepsets = univariate_sepsets(g, edge, association);
+    if (auto found = find_independent_sepset(test, g.name(edge.first), g.name(edge.second), sepsets, alpha)) {
+        return std::make_pair(sepset_indices(g, found->first), found->second);
     }
 
     return {};
 }
 
+// Returns the edges of the skeleton that are not whitelisted.
+template <typename G>
+std::vector<Edge> edges_to_test(const G& skeleton, EdgeSet& edge_whitelist) {
+    std::vector<Edge> edges;
+    for (const auto& edge : skeleton.edge_indices()) {
+        if (edge_whitelist.count({edge.first, edge.second}) == 0) {
+            edges.push_back(edge);
+        }
+    }
+
+    return edges;
+}
+
+// Returns the edges of the skeleton that are not whitelisted. With a budget or with association_order, the edges with a
+// larger marginal p-value (the weakest marginal association) are tested first, because they are the most likely to be
+// removed.
+template <typename G>
+std::vector<Edge> edges_to_test(const G& skeleton,
+                                EdgeSet& edge_whitelist,
+                                const MarginalPvalues& marginal,
+                                const TestBudget& budget,
+                                bool association_order) {
+    auto edges = edges_to_test(skeleton, edge_whitelist);
+    if (budget.limited() || association_order) {
+        auto pvalue = [&marginal](const Edge& e) { return marginal_pvalue(marginal, e).value_or(0); };
+
+        std::stable_sort(
+            edges.begin(), edges.end(), [&pvalue](const Edge& a, const Edge& b) { return pvalue(a) > pvalue(b); });
+    }
+
+    return edges;
+}
+
+// Same as remove_separated_edges(), for the tests with IndependenceTest::batched_levels(). The conditioning sets of all
+// the edges are tested in rounds: each round tests the next sepset_batch_size sets of every edge without a sepset with
+// one call to IndependenceTest::pvalues(). The sepset of an edge is its first set (in the order of make_cursor(edge))
+// with a p-value greater than alpha, so the result is the same as with remove_separated_edges(). The budget is checked
+// before each round, and the edges that are not completely tested are kept.
+template <typename G, typename MakeCursor>
+void remove_separated_edges_batched(G& skeleton,
+                                    const std::vector<Edge>& edges,
+                                    SepSet& sepset,
+                                    const IndependenceTest& test,
+                                    double alpha,
+                                    util::BaseProgressBar& progress,
+                                    TestBudget& budget,
+                                    MakeCursor&& make_cursor) {
+    int num_edges = edges.size();
+    std::vector<std::optional<std::pair<std::unordered_set<int>, double>>> found(num_edges);
+    std::vector<std::unique_ptr<SepsetCursor>> cursors(num_edges);
+    std::vector<std::pair<int, int>> test_edges(num_edges);
+    std::vector<int> active;
+    for (int i = 0; i < num_edges; ++i) {
+        if (budget.take(1)) cursors[i] = make_cursor(edges[i]);
+
+        if (cursors[i]) {
+            test_edges[i] = {test.index(skeleton.name(edges[i].first)), test.index(skeleton.name(edges[i].second))};
+            active.push_back(i);
+        } else {
+            progress.tick();
+        }
+    }
+
+    std::vector<IndependenceTest::IndexedTest> batch;
+    std::vector<int> batch_edges;
+    std::vector<std::vector<std::string>> batch_sepsets;
+    std::vector<int> next_active;
+    std::vector<std::string> s;
+    while (!active.empty() && budget.take(0)) {
+        batch.clear();
+        batch_edges.clear();
+        batch_sepsets.clear();
+        next_active.clear();
+
+        for (auto i : active) {
+            std::size_t count = 0;
+            for (; count < sepset_batch_size && cursors[i]->next(s); ++count) {
+                std::vector<int> ev;
+                ev.reserve(s.size());
+                for (const auto& e : s) {
+                    ev.push_back(test.index(e));
+                }
+
+                batch.push_back({test_edges[i].first, test_edges[i].second, std::move(ev)});
+                batch_edges.push_back(i);
+                batch_sepsets.push_back(s);
+            }
+
+            // An edge with less than sepset_batch_size new sets has no more sets to test.
+            if (count == sepset_batch_size) next_active.push_back(i);
+        }
+
+        auto pvalues = profiled_pvalues(test, batch);
+        for (std::size_t t = 0; t < batch.size(); ++t) {
+            auto i = batch_edges[t];
+            if (!found[i] && pvalues[t] > alpha) {
+                found[i] = std::make_pair(sepset_indices(skeleton, batch_sepsets[t]), pvalues[t]);
+            }
+        }
+
+        auto finished = active.size();
+        auto has_sepset = [&found](int i) { return found[i].has_value(); };
+        next_active.erase(std::remove_if(next_active.begin(), next_active.end(), has_sepset), next_active.end());
+        for (auto f = next_active.size(); f < finished; ++f) {
+            progress.tick();
+        }
+
+        std::swap(active, next_active);
+    }
+
+    for (int i = 0; i < num_edges; ++i) {
+        if (found[i]) {
+            skeleton.remove_edge(edges[i].first, edges[i].second);
+            sepset.insert(edges[i], std::move(found[i]->first), found[i]->second);
+        }
+    }
+}
+
 template <typename G>
 void filter_univariate_skeleton(G& skeleton,
                                 const IndependenceTest& test,
                                 SepSet& sepset,
                                 double alpha,
                                 EdgeSet& edge_whitelist,
-                                util::BaseProgressBar& progress) {
-    progress.set_max_progress(skeleton.num_edges() - edge_whitelist.size());
+                                int num_threads,
+                                util::BaseProgressBar& progress,
+                                const MarginalPvalues& marginal,
+                                TestBudget& budget,
+                                bool association_order) {
+    auto edges = edges_to_test(skeleton, edge_whitelist, marginal, budget, association_order);
+    auto association = association_order ? &marginal : nullptr;
+
+    progress.set_max_progress(edges.size());
     progress.set_text("Sepset Order 1");
     progress.set_progress(0);
 
-    std::vector<Edge> edges_to_remove;
-
-    for (const auto& edge : skeleton.edge_indices()) {
-        if (edge_whitelist.count({edge.first, edge.second}) == 0) {
-            auto indep = find_univariate_sepset(skeleton, edge, alpha, test);
-            if (indep) {
-                edges_to_remove.push_back(edge);
-                sepset.insert(edge, {indep->first}, indep->second);
-            }
-            progress.tick();
-        }
+    if (test.batched_levels()) {
+        remove_separated_edges_batched(skeleton, edges, sepset, test, alpha, progress, budget, [&](const Edge& edge) {
+            return sequence_cursor(univariate_sepsets(skeleton, edge, association));
+        });
+    } else {
+        remove_separated_edges(skeleton, edges, sepset, num_threads, progress, budget, [&](const Edge& edge) {
+            return find_univariate_sepset(skeleton, edge, alpha, test, association);
+        });
     }
-
-    remove_edges(skeleton, edges_to_remove);
 }
 
 template <typename G, typename Comb>
 std::optional<std::pair<std::unordered_set<int>, double>> evaluate_multivariate_sepset(
     const G& g, const Edge& edge, Comb& comb, const IndependenceTest& test, double alpha) {
-    const auto& first_name = g.name(edge.first);
-    const auto& second_name = g.name(edge.second);
-    for (const auto& sepset : comb) {
-        double pvalue = test.pvalue(first_name, second_name, sepset);
-        if (pvalue > alpha) {
-            std::unordered_set<int> indices;
-            std::transform(
-                sepset.begin(), sepset.end(), std::inserter(indices, indices.begin()), [&g](const std::string& name) {
-                    return g.index(name);
-                });
-
-            return std::optional<std::pair<std::unordered_set<int>, double>>(
-                std::make_pair<std::unordered_set<int>, double>(std::move(indices), std::move(pvalue)));
-        }
+    if (auto found = find_independent_sepset(test, g.name(edge.first), g.name(edge.second), comb, alpha)) {
+        return std::make_pair(sepset_indices(g, found->first), found->second);
     }
 
     return {};
 }
 
+// Returns the candidate variables of the conditioning sets of size sep_size of the edge: the adjacent variables of each
+// node of the edge, or nothing if a node does not have more than sep_size adjacent variables. If association is not
+// null, the candidates are sorted with sort_by_association(), so the conditioning sets of the variables most strongly
+// associated with the edge are tested first.
 template <typename G>
-std::optional<std::pair<std::unordered_set<int>, double>> find_multivariate_sepset(
-    const G& g, const Edge& edge, int sep_size, const IndependenceTest& test, double alpha) {
-    const auto& nbr1 = g.neighbor_set(edge.first);
-    const auto& pa1 = g.parent_set(edge.first);
-    const auto& nbr2 = g.neighbor_set(edge.second);
-    const auto& pa2 = g.parent_set(edge.second);
-
-    bool set1_valid = static_cast<int>(nbr1.size() + pa1.size()) > sep_size;
-    bool set2_valid = static_cast<int>(nbr2.size() + pa2.size()) > sep_size;
-
-    if (!set1_valid && !set2_valid) {
-        return {};
-    }
-
-    std::vector<std::string> u1;
-    if (set1_valid) {
-        u1.reserve(nbr1.size() + pa1.size());
-        for (auto nbr : nbr1) {
-            if (nbr != edge.second) u1.push_back(g.name(nbr));
+std::pair<std::optional<std::vector<std::string>>, std::optional<std::vector<std::string>>> multivariate_candidates(
+    const G& g, const Edge& edge, int sep_size, const MarginalPvalues* association) {
+    auto adjacent = [&](int node, int other) -> std::optional<std::vector<std::string>> {
+        const auto& nbr = g.neighbor_set(node);
+        const auto& pa = g.parent_set(node);
+        if (static_cast<int>(nbr.size() + pa.size()) <= sep_size) return {};
+
+        std::vector<int> candidates;
+        candidates.reserve(nbr.size() + pa.size());
+        for (auto n : nbr) {
+            if (n != other) candidates.push_back(n);
         }
+        candidates.insert(candidates.end(), pa.begin(), pa.end());
 
-        std::transform(pa1.begin(), pa1.end(), std::inserter(u1, u1.end()), [&g](int pa) { return g.name(pa); });
-    }
+        if (association) sort_by_association(candidates, edge, *association);
+        return candidate_names(g, candidates);
+    };
 
-    std::vector<std::string> u2;
-    if (set2_valid) {
-        u2.reserve(nbr2.size() + pa2.size());
-        for (auto nbr : nbr2) {
-            if (nbr != edge.first) u2.push_back(g.name(nbr));
-        }
-
-        std::transform(pa2.begin(), pa2.end(), std::inserter(u2, u2.end()), [&g](int pa) { return g.name(pa); });
-    }
+    return {adjacent(edge.first, edge.second), adjacent(edge.second, edge.first)};
+}
 
-    if (set1_valid) {
-        if (set2_valid) {
-            Combinations2Sets comb(std::move(u1), std::move(u2), sep_size);
+template <typename G>
+std::optional<std::pair<std::unordered_set<int>, double>> find_multivariate_sepset(
+    const G& g,
+    const Edge& edge,
+    int sep_size,
+    const IndependenceTest& test,
+    double alpha,
+    const MarginalPvalues* association) {
+    auto [u1, u2] = multivariate_candidates(g, edge, sep_size, association);
+
+    if (u1) {
+        if (u2) {
+            Combinations2Sets comb(std::move(*u1), std::move(*u2), sep_size);
             return evaluate_multivariate_sepset(g, edge, comb, test, alpha);
         } else {
-            Combinations comb(std::move(u1), sep_size);
+            Combinations comb(std::move(*u1), sep_size);
             return evaluate_multivariate_sepset(g, edge, comb, test, alpha);
         }
     } else {
-        if (set2_valid) {
-            Combinations comb(std::move(u2), sep_size);
+        if (u2) {
+            Combinations comb(std::move(*u2), sep_size);
             return evaluate_multivariate_sepset(g, edge, comb, test, alpha);
         }
     }
@@ -219,44 +495,122 @@ std::optional<std::pair<std::unordered_set<int>, double>> find_multivariate_seps
     return {};
 }
 
+// Returns a SepsetCursor over the conditioning sets tested by find_multivariate_sepset(), or nullptr if there are no
+// conditioning sets of size sep_size.
+template <typename G>
+std::unique_ptr<SepsetCursor> multivariate_cursor(const G& g,
+                                                  const Edge& edge,
+                                                  int sep_size,
+                                                  const MarginalPvalues* association) {
+    auto [u1, u2] = multivariate_candidates(g, edge, sep_size, association);
+
+    if (u1 && u2) return sequence_cursor(Combinations2Sets(std::move(*u1), std::move(*u2), sep_size));
+    if (u1) return sequence_cursor(Combinations(std::move(*u1), sep_size));
+    if (u2) return sequence_cursor(Combinations(std::move(*u2), sep_size));
+    return nullptr;
+}
+
+// Saves the sepsets found and the next sepset order in a PCCheckpoint.
+template <typename G>
+void save_pc_checkpoint(const G& g, const SepSet& sepset, int level, const std::string& file_name) {
+    std::vector<PCCheckpoint::Sepset> sepsets;
+    sepsets.reserve(sepset.size());
+    sepset.for_each([&](const Edge& edge, const SepSet::View& s, double pvalue) {
+        std::vector<std::string> names;
+        names.reserve(s.size());
+        for (auto idx : s) {
+            names.push_back(g.name(idx));
+        }
+
+        sepsets.push_back(PCCheckpoint::Sepset{g.name(edge.first), g.name(edge.second), std::move(names), pvalue});
+    });
+
+    PCCheckpoint(level, std::move(sepsets)).save(file_name);
+}
+
+// Removes the edges separated in resume from the skeleton, and inserts their sepsets. Returns the next sepset order.
 template <typename G>
-SepSet find_skeleton(
-    G& g, const IndependenceTest& test, double alpha, EdgeSet& edge_whitelist, util::BaseProgressBar& progress) {
+int resume_skeleton(G& g, SepSet& sepset, const PCCheckpoint& resume) {
+    for (const auto& s : resume.sepsets()) {
+        auto first = g.index(s.first);
+        auto second = g.index(s.second);
+        if (g.has_edge_unsafe(first, second)) g.remove_edge_unsafe(first, second);
+
+        sepset.insert({first, second}, sepset_indices(g, s.sepset), s.pvalue);
+    }
+
+    return resume.level();
+}
+
+template <typename G>
+SepSet find_skeleton(G& g,
+                     const IndependenceTest& test,
+                     double alpha,
+                     EdgeSet& edge_whitelist,
+                     int num_threads,
+                     util::BaseProgressBar& progress,
+                     const std::optional<std::string>& checkpoint,
+                     const std::shared_ptr<PCCheckpoint>& resume,
+                     TestBudget& budget,
+                     bool association_order) {
     if (static_cast<size_t>(g.num_edges()) == edge_whitelist.size()) {
         return SepSet{};
     }
 
     SepSet sepset;
-
-    filter_marginal_skeleton(g, test, sepset, alpha, edge_whitelist, progress);
+    auto limit = resume ? resume_skeleton(g, sepset, *resume) : 0;
+
+    // A level interrupted by the budget is not saved, so a resumed search tests its edges again.
+    auto save = [&]() {
+        if (checkpoint) save_pc_checkpoint(g, sepset, limit, *checkpoint);
+    };
+
+    auto level_profile = [&limit]() { return "pc:sepset_order:" + std::to_string(limit); };
+
+    MarginalPvalues marginal;
+    if (limit == 0) {
+        util::ProfileScope profile(level_profile);
+        marginal = filter_marginal_skeleton(g, test, sepset, alpha, edge_whitelist, num_threads, progress, budget);
+        if (budget.interrupted()) return sepset;
+        limit = 1;
+        save();
+    }
 
     if (static_cast<size_t>(g.num_edges()) == edge_whitelist.size() || max_cardinality(g, 1)) {
         return sepset;
     }
 
-    filter_univariate_skeleton(g, test, sepset, alpha, edge_whitelist, progress);
+    if (limit == 1) {
+        util::ProfileScope profile(level_profile);
+        filter_univariate_skeleton(
+            g, test, sepset, alpha, edge_whitelist, num_threads, progress, marginal, budget, association_order);
+        if (budget.interrupted()) return sepset;
+        limit = 2;
+        save();
+    }
 
-    std::vector<Edge> edges_to_remove;
-    auto limit = 2;
+    auto association = association_order ? &marginal : nullptr;
     while (static_cast<size_t>(g.num_edges()) > edge_whitelist.size() && !max_cardinality(g, limit)) {
-        progress.set_max_progress(g.num_edges() - edge_whitelist.size());
+        util::ProfileScope profile(level_profile);
+        auto edges = edges_to_test(g, edge_whitelist, marginal, budget, association_order);
+
+        progress.set_max_progress(edges.size());
         progress.set_text("Sepset Order " + std::to_string(limit));
         progress.set_progress(0);
 
-        for (auto& edge : g.edge_indices()) {
-            if (edge_whitelist.count({edge.first, edge.second}) == 0) {
-                auto indep = find_multivariate_sepset(g, edge, limit, test, alpha);
-                if (indep) {
-                    edges_to_remove.push_back(edge);
-                    sepset.insert(edge, std::move(indep->first), indep->second);
-                }
-                progress.tick();
-            }
+        if (test.batched_levels()) {
+            remove_separated_edges_batched(g, edges, sepset, test, alpha, progress, budget, [&](const Edge& edge) {
+                return multivariate_cursor(g, edge, limit, association);
+            });
+        } else {
+            remove_separated_edges(g, edges, sepset, num_threads, progress, budget, [&](const Edge& edge) {
+                return find_multivariate_sepset(g, edge, limit, test, alpha, association);
+            });
         }
 
-        remove_edges(g, edges_to_remove);
-        edges_to_remove.clear();
+        if (budget.interrupted()) return sepset;
         ++limit;
+        save();
     }
 
     return sepset;
@@ -273,7 +627,14 @@ void estimate(G& skeleton,
               bool use_sepsets,
               double ambiguous_threshold,
               bool allow_bidirected,
-              int verbose) {
+              int verbose,
+              int num_threads,
+              const std::optional<std::string>& checkpoint,
+              const std::shared_ptr<PCCheckpoint>& resume,
+              const std::shared_ptr<SearchBudget>& budget,
+              bool association_order) {
+    util::gil_release_if_held release(!test.is_python_derived());
+
     auto restrictions =
         util::validate_restrictions(skeleton, varc_blacklist, varc_whitelist, vedge_blacklist, vedge_whitelist);
 
@@ -297,7 +658,17 @@ void estimate(G& skeleton,
     }
 
     auto progress = util::progress_bar(verbose);
-    auto sepset = find_skeleton(skeleton, test, alpha, restrictions.edge_whitelist, *progress);
+    TestBudget test_budget(budget);
+    auto sepset = find_skeleton(skeleton,
+                                test,
+                                alpha,
+                                restrictions.edge_whitelist,
+                                num_threads,
+                                *progress,
+                                checkpoint,
+                                resume,
+                                test_budget,
+                                association_order);
 
     if constexpr (graph::is_conditional_graph_v<G>) {
         skeleton.direct_interface_edges();
@@ -316,21 +687,8 @@ void estimate(G& skeleton,
                               allow_bidirected,
                               *progress);
 
-    progress->set_max_progress(3);
     progress->set_text("Applying Meek rules");
-
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        progress->set_progress(0);
-
-        changed |= MeekRules::rule1(skeleton);
-        progress->tick();
-        changed |= MeekRules::rule2(skeleton);
-        progress->tick();
-        changed |= MeekRules::rule3(skeleton);
-        progress->tick();
-    }
+    MeekRules::apply(skeleton, num_threads);
 
     progress->mark_as_completed("Finished PC!");
 }
@@ -345,7 +703,12 @@ PartiallyDirectedGraph PC::estimate(const IndependenceTest& test,
                                     bool use_sepsets,
                                     double ambiguous_threshold,
                                     bool allow_bidirected,
-                                    int verbose) const {
+                                    int verbose,
+                                    int num_threads,
+                                    const std::optional<std::string>& checkpoint,
+                                    const std::shared_ptr<PCCheckpoint>& resume,
+                                    const std::shared_ptr<SearchBudget>& budget,
+                                    bool association_order) const {
     if (alpha <= 0 || alpha >= 1) throw std::invalid_argument("alpha must be a number between 0 and 1.");
     if (ambiguous_threshold < 0 || ambiguous_threshold > 1)
         throw std::invalid_argument("ambiguous_threshold must be a number between 0 and 1.");
@@ -370,7 +733,12 @@ PartiallyDirectedGraph PC::estimate(const IndependenceTest& test,
                                    use_sepsets,
                                    ambiguous_threshold,
                                    allow_bidirected,
-                                   verbose);
+                                   verbose,
+                                   num_threads,
+                                   checkpoint,
+                                   resume,
+                                   budget,
+                                   association_order);
     return skeleton;
 }
 
@@ -385,7 +753,12 @@ ConditionalPartiallyDirectedGraph PC::estimate_conditional(const IndependenceTes
                                                            bool use_sepsets,
                                                            double ambiguous_threshold,
                                                            bool allow_bidirected,
-                                                           int verbose) const {
+                                                           int verbose,
+                                                           int num_threads,
+                                                           const std::optional<std::string>& checkpoint,
+                                                           const std::shared_ptr<PCCheckpoint>& resume,
+                                                           const std::shared_ptr<SearchBudget>& budget,
+                                                           bool association_order) const {
     if (alpha <= 0 || alpha >= 1) throw std::invalid_argument("alpha must be a number between 0 and 1.");
     if (ambiguous_threshold < 0 || ambiguous_threshold > 1)
         throw std::invalid_argument("ambiguous_threshold must be a number between 0 and 1.");
@@ -402,7 +775,12 @@ ConditionalPartiallyDirectedGraph PC::estimate_conditional(const IndependenceTes
                             use_sepsets,
                             ambiguous_threshold,
                             allow_bidirected,
-                            verbose)
+                            verbose,
+                            num_threads,
+                            checkpoint,
+                            resume,
+                            budget,
+                            association_order)
             .conditional_graph();
 
     if (!test.has_variables(nodes) || !test.has_variables(interface_nodes))
@@ -421,7 +799,12 @@ ConditionalPartiallyDirectedGraph PC::estimate_conditional(const IndependenceTes
                                    use_sepsets,
                                    ambiguous_threshold,
                                    allow_bidirected,
-                                   verbose);
+                                   verbose,
+                                   num_threads,
+                                   checkpoint,
+                                   resume,
+                                   budget,
+                                   association_order);
     return skeleton;
 }
 
@@ -3,8 +3,11 @@
 
 #include <graph/generic_graph.hpp>
 #include <learning/independences/independence.hpp>
+#include <learning/algorithms/checkpoint.hpp>
+#include <learning/algorithms/callbacks/search_budget.hpp>
 
 using graph::PartiallyDirectedGraph, graph::ConditionalPartiallyDirectedGraph;
+using learning::algorithms::callbacks::SearchBudget;
 using learning::independences::IndependenceTest;
 using util::ArcStringVector;
 
@@ -22,7 +25,12 @@ public:
                                     bool use_sepsets,
                                     double ambiguous_threshold,
                                     bool allow_bidirected,
-                                    int verbose) const;
+                                    int verbose,
+                                    int num_threads = 1,
+                                    const std::optional<std::string>& checkpoint = std::nullopt,
+                                    const std::shared_ptr<PCCheckpoint>& resume = nullptr,
+                                    const std::shared_ptr<SearchBudget>& budget = nullptr,
+                                    bool association_order = false) const;
 
     ConditionalPartiallyDirectedGraph estimate_conditional(const IndependenceTest& test,
                                                            const std::vector<std::string>& nodes,
@@ -35,7 +43,12 @@ public:
                                                            bool use_sepsets,
                                                            double ambiguous_threshold,
                                                            bool allow_bidirected,
-                                                           int verbose) const;
+                                                           int verbose,
+                                                           int num_threads = 1,
+                                                           const std::optional<std::string>& checkpoint = std::nullopt,
+                                                           const std::shared_ptr<PCCheckpoint>& resume = nullptr,
+                                                           const std::shared_ptr<SearchBudget>& budget = nullptr,
+                                                           bool association_order = false) const;
 };
 
 }  // namespace learning::algorithms
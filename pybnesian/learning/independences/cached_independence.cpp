@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <learning/independences/cached_independence.hpp>
+
+namespace learning::independences {
+
+CachedIndependenceTest::CachedIndependenceTest(std::shared_ptr<IndependenceTest> test, size_t max_memory)
+    : CachedIndependenceTest(max_memory) {
+    if (!test) throw std::invalid_argument("The test of a CachedIndependenceTest can not be null.");
+    m_test = std::move(test);
+}
+
+void CachedIndependenceTest::bind(std::shared_ptr<IndependenceTest> test) {
+    if (!test) throw std::invalid_argument("The test of a CachedIndependenceTest can not be null.");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto name = test_name();
+    if (!name.empty() && name != test->ToString())
+        throw std::invalid_argument("The CachedIndependenceTest was created with a " + name +
+                                    " test, but it is bound to a " + test->ToString() + " test.");
+
+    for (const auto& entry : m_entries) {
+        const auto& key = entry.first;
+        if (!test->has_variables(key.x) || !test->has_variables(key.y) || !test->has_variables(key.z))
+            throw std::invalid_argument("The test does not have the variables of the CachedIndependenceTest.");
+    }
+
+    m_test = std::move(test);
+    m_test_name.clear();
+}
+
+CachedIndependenceTest::Key CachedIndependenceTest::make_key(const std::string& v1,
+                                                             const std::string& v2,
+                                                             const std::vector<std::string>& ev) {
+    Key key = v1 < v2 ? Key{v1, v2, ev} : Key{v2, v1, ev};
+    std::sort(key.z.begin(), key.z.end());
+    return key;
+}
+
+size_t CachedIndependenceTest::entry_memory(const Key& key) {
+    // Nodes of the list and the hash table, and the memory of the key strings.
+    size_t memory = sizeof(Entry) + 2 * sizeof(void*) + sizeof(std::reference_wrapper<const Key>) +
+                    sizeof(EntryList::iterator) + 3 * sizeof(void*);
+    memory += key.x.capacity() + key.y.capacity();
+    memory += key.z.capacity() * sizeof(std::string);
+    for (const auto& v : key.z) memory += v.capacity();
+    return memory;
+}
+
+double CachedIndependenceTest::cached_pvalue(const std::string& v1,
+                                             const std::string& v2,
+                                             const std::vector<std::string>& ev) const {
+    const auto& test = checked_test();
+
+    auto key = make_key(v1, v2, ev);
+    if (auto pvalue = find(key)) return *pvalue;
+
+    double pvalue;
+    switch (ev.size()) {
+        case 0:
+            pvalue = test.pvalue(v1, v2);
+            break;
+        case 1:
+            pvalue = test.pvalue(v1, v2, ev[0]);
+            break;
+        default:
+            pvalue = test.pvalue(v1, v2, ev);
+    }
+
+    insert(std::move(key), pvalue);
+    return pvalue;
+}
+
+std::vector<double> CachedIndependenceTest::pvalues(const std::string& v1,
+                                                    const std::string& v2,
+                                                    const std::vector<std::vector<std::string>>& evs) const {
+    const auto& test = checked_test();
+
+    std::vector<double> res(evs.size());
+    std::vector<Key> missing_keys;
+    std::vector<std::vector<std::string>> missing_evs;
+    std::vector<size_t> missing_indices;
+
+    for (size_t i = 0; i < evs.size(); ++i) {
+        auto key = make_key(v1, v2, evs[i]);
+        if (auto pvalue = find(key)) {
+            res[i] = *pvalue;
+        } else {
+            missing_keys.push_back(std::move(key));
+            missing_evs.push_back(evs[i]);
+            missing_indices.push_back(i);
+        }
+    }
+
+    if (missing_indices.empty()) return res;
+
+    auto pvalues = test.pvalues(v1, v2, missing_evs);
+    for (size_t k = 0; k < missing_indices.size(); ++k) {
+        res[missing_indices[k]] = pvalues[k];
+        insert(std::move(missing_keys[k]), pvalues[k]);
+    }
+
+    return res;
+}
+
+std::vector<double> CachedIndependenceTest::pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                                    const std::vector<std::string>& ev) const {
+    const auto& test = checked_test();
+
+    std::vector<double> res(pairs.size());
+    std::vector<Key> missing_keys;
+    std::vector<std::pair<std::string, std::string>> missing_pairs;
+    std::vector<size_t> missing_indices;
+
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        auto key = make_key(pairs[i].first, pairs[i].second, ev);
+        if (auto pvalue = find(key)) {
+            res[i] = *pvalue;
+        } else {
+            missing_keys.push_back(std::move(key));
+            missing_pairs.push_back(pairs[i]);
+            missing_indices.push_back(i);
+        }
+    }
+
+    if (missing_indices.empty()) return res;
+
+    auto pvalues = test.pvalues(missing_pairs, ev);
+    for (size_t k = 0; k < missing_indices.size(); ++k) {
+        res[missing_indices[k]] = pvalues[k];
+        insert(std::move(missing_keys[k]), pvalues[k]);
+    }
+
+    return res;
+}
+
+void CachedIndependenceTest::clear_unlocked() {
+    m_index.clear();
+    m_entries.clear();
+    m_memory = 0;
+    m_hits = 0;
+    m_misses = 0;
+}
+
+std::optional<double> CachedIndependenceTest::find(const Key& key) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto f = m_index.find(std::cref(key));
+    if (f == m_index.end()) {
+        util::profile_count([] { return std::string("cached_pvalue:miss"); });
+        return std::nullopt;
+    }
+
+    ++m_hits;
+    util::profile_count([] { return std::string("cached_pvalue:hit"); });
+
+    // Moves the entry to the front, as the most recently used.
+    m_entries.splice(m_entries.begin(), m_entries, f->second);
+    return f->second->second;
+}
+
+void CachedIndependenceTest::insert(Key&& key, double pvalue) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    insert_unlocked(std::move(key), pvalue);
+}
+
+void CachedIndependenceTest::insert_unlocked(Key&& key, double pvalue) const {
+    // Another thread could have run the same test.
+    if (m_index.count(std::cref(key)) > 0) return;
+
+    ++m_misses;
+
+    auto memory = entry_memory(key);
+    if (memory > m_max_memory) return;
+
+    m_entries.emplace_front(std::move(key), pvalue);
+    m_index.emplace(std::cref(m_entries.front().first), m_entries.begin());
+    m_memory += memory;
+
+    evict_unlocked();
+}
+
+void CachedIndependenceTest::evict_unlocked() const {
+    while (m_memory > m_max_memory) {
+        const auto& lru = m_entries.back();
+        m_memory -= entry_memory(lru.first);
+        m_index.erase(std::cref(lru.first));
+        m_entries.pop_back();
+    }
+}
+
+util::MemoryUsage CachedIndependenceTest::memory_usage() const {
+    util::MemoryUsage usage;
+    std::shared_ptr<IndependenceTest> test;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        usage.add("memo", m_memory);
+        test = m_test;
+    }
+
+    if (test) usage.add("test", test->memory_usage());
+    return usage;
+}
+
+void CachedIndependenceTest::set_max_cache_memory(std::size_t max_memory) {
+    std::shared_ptr<IndependenceTest> test;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_max_memory = max_memory;
+        evict_unlocked();
+        test = m_test;
+    }
+
+    if (test) test->set_max_cache_memory(max_memory);
+}
+
+py::tuple CachedIndependenceTest::__getstate__() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    py::list entries;
+    for (auto it = m_entries.rbegin(), end = m_entries.rend(); it != end; ++it) {
+        const auto& key = it->first;
+        entries.append(py::make_tuple(key.x, key.y, key.z, it->second));
+    }
+
+    return py::make_tuple(test_name(), m_max_memory, entries);
+}
+
+std::shared_ptr<CachedIndependenceTest> CachedIndependenceTest::__setstate__(py::tuple& t) {
+    if (t.size() != 3) throw std::runtime_error("Not valid CachedIndependenceTest.");
+
+    // The test must be bound to a test before it is used.
+    std::shared_ptr<CachedIndependenceTest> cached(new CachedIndependenceTest(t[1].cast<size_t>()));
+    cached->m_test_name = t[0].cast<std::string>();
+
+    // The entries are saved from the least recently used.
+    for (auto entry : t[2].cast<py::list>()) {
+        auto e = entry.cast<py::tuple>();
+        Key key{e[0].cast<std::string>(), e[1].cast<std::string>(), e[2].cast<std::vector<std::string>>()};
+        cached->insert_unlocked(std::move(key), e[3].cast<double>());
+    }
+    cached->m_misses = 0;
+
+    return cached;
+}
+
+}  // namespace learning::independences
@@ -0,0 +1,172 @@
+#ifndef PYBNESIAN_LEARNING_INDEPENDENCES_CACHED_INDEPENDENCE_HPP
+#define PYBNESIAN_LEARNING_INDEPENDENCES_CACHED_INDEPENDENCE_HPP
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <pybind11/pybind11.h>
+#include <learning/independences/independence.hpp>
+#include <util/hash_utils.hpp>
+#include <util/pickle.hpp>
+
+namespace py = pybind11;
+
+namespace learning::independences {
+
+// An IndependenceTest that memoizes the p-values of another test. The tests are canonicalized, so x _|_ y | z and
+// y _|_ x | z' are the same test when z' is a permutation of z. The memo is thread-safe, and the least recently used
+// p-values are removed when its memory exceeds max_memory.
+//
+// The same CachedIndependenceTest can be passed to many executions of PC, MMPC or MMHC, so the tests of an execution
+// are not run again in the next executions. The memo can be saved and loaded, and bound again to a test of the same
+// data with bind().
+class CachedIndependenceTest : public IndependenceTest {
+public:
+    static constexpr size_t default_max_memory = 64 * 1024 * 1024;
+
+    CachedIndependenceTest(std::shared_ptr<IndependenceTest> test, size_t max_memory = default_max_memory);
+
+    CachedIndependenceTest(const CachedIndependenceTest&) = delete;
+    CachedIndependenceTest& operator=(const CachedIndependenceTest&) = delete;
+
+    std::string ToString() const override { return "CachedIndependenceTest(" + test_name() + ")"; }
+
+    double pvalue(const std::string& v1, const std::string& v2) const override { return cached_pvalue(v1, v2, {}); }
+    double pvalue(const std::string& v1, const std::string& v2, const std::string& ev) const override {
+        return cached_pvalue(v1, v2, {ev});
+    }
+    double pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const override {
+        return cached_pvalue(v1, v2, ev);
+    }
+
+    // Only the tests that are not memoized are run, with the batched pvalues() of the wrapped test.
+    std::vector<double> pvalues(const std::string& v1,
+                                const std::string& v2,
+                                const std::vector<std::vector<std::string>>& evs) const override;
+    std::vector<double> pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                const std::vector<std::string>& ev) const override;
+    using IndependenceTest::pvalues;
+    std::size_t native_batch_size() const override { return checked_test().native_batch_size(); }
+    // The wrapped test is run through the memo, so the memo needs the GIL if the wrapped test is implemented in Python.
+    bool is_python_derived() const override { return checked_test().is_python_derived(); }
+
+    int num_variables() const override { return checked_test().num_variables(); }
+    std::vector<std::string> variable_names() const override { return checked_test().variable_names(); }
+    const std::string& name(int i) const override { return checked_test().name(i); }
+    int index(const std::string& name) const override { return checked_test().index(name); }
+    bool has_variables(const std::string& name) const override { return checked_test().has_variables(name); }
+    bool has_variables(const std::vector<std::string>& cols) const override {
+        return checked_test().has_variables(cols);
+    }
+
+    const std::shared_ptr<IndependenceTest>& test() const { return m_test; }
+    // Binds the memo to test. A CachedIndependenceTest loaded from a file must be bound to a test (with the same data)
+    // before it is used, because the wrapped test is not saved.
+    void bind(std::shared_ptr<IndependenceTest> test);
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+    // Approximate memory (in bytes) used by the memoized p-values.
+    size_t memory() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_memory;
+    }
+    size_t max_memory() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_max_memory;
+    }
+    // Number of tests that were found in (hits) or added to (misses) the memo.
+    size_t hits() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hits;
+    }
+    size_t misses() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_misses;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        clear_unlocked();
+    }
+
+    util::MemoryUsage memory_usage() const override;
+    // Sets max_memory() to max_memory, evicting the least recently used p-values, and limits the caches of the wrapped
+    // test.
+    void set_max_cache_memory(std::size_t max_memory) override;
+
+    void save(const std::string name) const { util::save_object(*this, name); }
+
+    py::tuple __getstate__() const;
+    static std::shared_ptr<CachedIndependenceTest> __setstate__(py::tuple& t);
+    static std::shared_ptr<CachedIndependenceTest> __setstate__(py::tuple&& t) { return __setstate__(t); }
+
+private:
+    CachedIndependenceTest(size_t max_memory)
+        : m_mutex(), m_test(), m_test_name(), m_max_memory(max_memory), m_index(), m_entries() {}
+
+    // The canonical form of a test: x < y and the sorted conditioning set.
+    struct Key {
+        std::string x;
+        std::string y;
+        std::vector<std::string> z;
+
+        bool operator==(const Key& other) const { return x == other.x && y == other.y && z == other.z; }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            size_t seed = std::hash<std::string>{}(key.x);
+            util::hash_combine(seed, key.y);
+            for (const auto& v : key.z) util::hash_combine(seed, v);
+            return seed;
+        }
+    };
+
+    struct KeyEqual {
+        bool operator()(const Key& a, const Key& b) const { return a == b; }
+    };
+
+    using Entry = std::pair<Key, double>;
+    using EntryList = std::list<Entry>;
+
+    static Key make_key(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev);
+    static size_t entry_memory(const Key& key);
+
+    const IndependenceTest& checked_test() const {
+        if (!m_test)
+            throw std::invalid_argument(
+                "The CachedIndependenceTest is not bound to a test. Call bind() before using it.");
+        return *m_test;
+    }
+    std::string test_name() const { return m_test ? m_test->ToString() : m_test_name; }
+
+    double cached_pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const;
+
+    void clear_unlocked();
+    std::optional<double> find(const Key& key) const;
+    void insert(Key&& key, double pvalue) const;
+    void insert_unlocked(Key&& key, double pvalue) const;
+    // Removes the least recently used p-values until m_memory <= m_max_memory.
+    void evict_unlocked() const;
+
+    mutable std::mutex m_mutex;
+    std::shared_ptr<IndependenceTest> m_test;
+    // IndependenceTest::ToString() of the test of a memo loaded from a file.
+    std::string m_test_name;
+    size_t m_max_memory;
+    mutable size_t m_memory = 0;
+    mutable size_t m_hits = 0;
+    mutable size_t m_misses = 0;
+    mutable std::unordered_map<std::reference_wrapper<const Key>, EntryList::iterator, KeyHash, KeyEqual> m_index;
+    // The most recently used p-values are at the front.
+    mutable EntryList m_entries;
+};
+
+}  // namespace learning::independences
+
+#endif  // PYBNESIAN_LEARNING_INDEPENDENCES_CACHED_INDEPENDENCE_HPP
@@ -2,6 +2,134 @@
 
 namespace learning::independences::continuous {
 
+namespace {
+
+// Number of rows of the blocks whose partial sums of products are computed by a work item.
+constexpr unsigned int product_block_rows = 1024;
+
+// Reads the rows x cols matrix of buffer into dest, which can be a block of a larger matrix.
+template <typename Scalar>
+void read_matrix(OpenCLConfig& opencl, const cl::Buffer& buffer, Eigen::Ref<Matrix<Scalar, Dynamic, Dynamic>> dest) {
+    if (dest.outerStride() == dest.rows()) {
+        opencl.read_from_buffer(dest.data(), buffer, dest.rows() * dest.cols());
+        return;
+    }
+
+    for (auto j = 0; j < dest.cols(); ++j) {
+        cl_int err_code = opencl.queue().enqueueReadBuffer(
+            buffer, CL_TRUE, sizeof(Scalar) * j * dest.rows(), sizeof(Scalar) * dest.rows(), dest.col(j).data());
+
+        if (err_code != CL_SUCCESS) {
+            throw std::runtime_error(std::string("Error reading buffer. ") + opencl::opencl_error(err_code) + " (" +
+                                     std::to_string(err_code) + ").");
+        }
+    }
+}
+
+// Returns the sum of the columns of the num_blocks x cols matrix of partial sums of buffer, accumulated in double.
+template <typename Scalar>
+VectorXd sum_partial_sums(OpenCLConfig& opencl, const cl::Buffer& buffer, int num_blocks, int cols) {
+    Matrix<Scalar, Dynamic, Dynamic> partial(num_blocks, cols);
+    opencl.read_from_buffer(partial.data(), buffer, num_blocks * cols);
+    return partial.template cast<double>().colwise().sum().transpose();
+}
+
+}  // namespace
+
+template <typename Scalar>
+void opencl_fourier_features(const Matrix<Scalar, Dynamic, Dynamic>& m,
+                             const Matrix<Scalar, Dynamic, Dynamic>& W,
+                             const Matrix<Scalar, Dynamic, 1>& b,
+                             Eigen::Ref<Matrix<Scalar, Dynamic, Dynamic>> fourier_features) {
+    using ArrowType = typename arrow::CTypeTraits<Scalar>::ArrowType;
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+    auto& opencl = OpenCLConfig::get();
+
+    unsigned int rows = m.rows();
+    unsigned int cols = m.cols();
+    auto input = opencl.copy_to_temp_buffer(m.data(), m.rows() * m.cols());
+    auto weights = opencl.copy_to_temp_buffer(W.data(), W.rows() * W.cols());
+    auto offsets = opencl.copy_to_temp_buffer(b.data(), b.rows());
+    auto output = opencl.temp_buffer<Scalar>(m.rows() * W.cols());
+
+    auto& k_fourier_features = opencl.kernel(OpenCL_kernel_traits<ArrowType>::rcot_fourier_features);
+    k_fourier_features.setArg(0, input);
+    k_fourier_features.setArg(1, rows);
+    k_fourier_features.setArg(2, cols);
+    k_fourier_features.setArg(3, weights);
+    k_fourier_features.setArg(4, offsets);
+    k_fourier_features.setArg(5, output);
+    RAISE_ENQUEUEKERNEL_ERROR(opencl.queue().enqueueNDRangeKernel(
+        k_fourier_features, cl::NullRange, cl::NDRange(m.rows() * W.cols()), cl::NullRange));
+
+    read_matrix<Scalar>(opencl, output, fourier_features);
+}
+
+template <typename Scalar>
+Matrix<Scalar, Dynamic, 1> opencl_eigenvalues_covariance(const Matrix<Scalar, Dynamic, Dynamic>& fourier_x,
+                                                         const Matrix<Scalar, Dynamic, Dynamic>& fourier_y) {
+    using ArrowType = typename arrow::CTypeTraits<Scalar>::ArrowType;
+    using MatrixType = Matrix<Scalar, Dynamic, Dynamic>;
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+    auto& opencl = OpenCLConfig::get();
+
+    unsigned int rows = fourier_x.rows();
+    unsigned int fx_cols = fourier_x.cols();
+    unsigned int fy_cols = fourier_y.cols();
+    unsigned int block_rows = product_block_rows;
+    unsigned int num_blocks = (rows + block_rows - 1) / block_rows;
+    int num_products = fx_cols * fy_cols;
+
+    auto fx = opencl.copy_to_temp_buffer(fourier_x.data(), rows * fx_cols);
+    auto fy = opencl.copy_to_temp_buffer(fourier_y.data(), rows * fy_cols);
+
+    // First pass: the means of the products.
+    auto sums = opencl.temp_buffer<Scalar>(num_blocks * num_products);
+    auto& k_product_sums = opencl.kernel(OpenCL_kernel_traits<ArrowType>::rcot_product_sums);
+    k_product_sums.setArg(0, fx);
+    k_product_sums.setArg(1, fy);
+    k_product_sums.setArg(2, rows);
+    k_product_sums.setArg(3, fy_cols);
+    k_product_sums.setArg(4, block_rows);
+    k_product_sums.setArg(5, num_blocks);
+    k_product_sums.setArg(6, sums);
+    RAISE_ENQUEUEKERNEL_ERROR(opencl.queue().enqueueNDRangeKernel(
+        k_product_sums, cl::NullRange, cl::NDRange(num_blocks * num_products), cl::NullRange));
+
+    VectorXd means_sum = sum_partial_sums<Scalar>(opencl, sums, num_blocks, num_products);
+    Matrix<Scalar, Dynamic, 1> means = (means_sum / static_cast<double>(rows)).template cast<Scalar>();
+    auto means_buffer = opencl.copy_to_temp_buffer(means.data(), num_products);
+
+    // Second pass: the centered crossproducts of the products.
+    auto crossproducts = opencl.temp_buffer<Scalar>(num_blocks * num_products * num_products);
+    auto& k_crossproducts = opencl.kernel(OpenCL_kernel_traits<ArrowType>::rcot_product_crossproducts);
+    k_crossproducts.setArg(0, fx);
+    k_crossproducts.setArg(1, fy);
+    k_crossproducts.setArg(2, rows);
+    k_crossproducts.setArg(3, fx_cols);
+    k_crossproducts.setArg(4, fy_cols);
+    k_crossproducts.setArg(5, means_buffer);
+    k_crossproducts.setArg(6, block_rows);
+    k_crossproducts.setArg(7, num_blocks);
+    k_crossproducts.setArg(8, crossproducts);
+    RAISE_ENQUEUEKERNEL_ERROR(opencl.queue().enqueueNDRangeKernel(
+        k_crossproducts, cl::NullRange, cl::NDRange(num_blocks * num_products * num_products), cl::NullRange));
+
+    VectorXd sse = sum_partial_sums<Scalar>(opencl, crossproducts, num_blocks, num_products * num_products);
+    Eigen::Map<MatrixXd> sse_mat(sse.data(), num_products, num_products);
+    MatrixType cov = (sse_mat / static_cast<double>(rows)).template cast<Scalar>();
+
+    auto eigen_solver = Eigen::SelfAdjointEigenSolver<MatrixType>(cov, Eigen::DecompositionOptions::EigenvaluesOnly);
+    return eigen_solver.eigenvalues();
+}
+
+template void opencl_fourier_features<double>(const MatrixXd&, const MatrixXd&, const VectorXd&, Eigen::Ref<MatrixXd>);
+template void opencl_fourier_features<float>(const MatrixXf&, const MatrixXf&, const VectorXf&, Eigen::Ref<MatrixXf>);
+template VectorXd opencl_eigenvalues_covariance<double>(const MatrixXd&, const MatrixXd&);
+template VectorXf opencl_eigenvalues_covariance<float>(const MatrixXf&, const MatrixXf&);
+
 template <typename ArrowType>
 double RCoT::pvalue(const std::string& x, const std::string& y) const {
     if (m_df.null_count(x, y) == 0) {
@@ -87,6 +215,7 @@ double RCoT::pvalue(const std::string& x, const std::string& y, const std::vecto
         if (util::sse(*x_vec) == 0 || util::sse(*y_vec) == 0) return 1;
 
         auto z_mat = m_df.to_eigen<false, ArrowType, false>(z);
+        auto z_indices = column_indices(z);
 
         auto z_sse = util::sse_cols(*z_mat);
 
@@ -107,13 +236,15 @@ double RCoT::pvalue(const std::string& x, const std::string& y, const std::vecto
                 }
             }
 
-            if (!valid_names.empty())
+            if (!valid_names.empty()) {
                 z_mat = m_df.to_eigen<false, ArrowType, false>(valid_names);
-            else
+                z_indices = column_indices(valid_names);
+            } else {
                 return RIT<false>(m_df.index(x), m_df.index(y), *x_vec, *y_vec);
+            }
         }
 
-        return RMultiZ<false>(m_df.index(x), m_df.index(y), *x_vec, *y_vec, *z_mat);
+        return RMultiZ<false>(m_df.index(x), m_df.index(y), z_indices, *x_vec, *y_vec, *z_mat);
     } else {
         auto combined_bitmap = m_df.combined_bitmap(x, y, z);
         auto x_vec = m_df.to_eigen<false, ArrowType>(combined_bitmap, x);
@@ -122,6 +253,7 @@ double RCoT::pvalue(const std::string& x, const std::string& y, const std::vecto
         if (util::sse(*x_vec) == 0 || util::sse(*y_vec) == 0) return 1;
 
         auto z_mat = m_df.to_eigen<false, ArrowType>(combined_bitmap, z);
+        auto z_indices = column_indices(z);
 
         auto z_sse = util::sse_cols(*z_mat);
 
@@ -147,12 +279,13 @@ double RCoT::pvalue(const std::string& x, const std::string& y, const std::vecto
                 x_vec = m_df.to_eigen<false, ArrowType>(combined_bitmap, x);
                 y_vec = m_df.to_eigen<false, ArrowType>(combined_bitmap, y);
                 z_mat = m_df.to_eigen<false, ArrowType>(valid_names);
+                z_indices = column_indices(valid_names);
             } else {
                 return RIT<true>(m_df.index(x), m_df.index(y), *x_vec, *y_vec);
             }
         }
 
-        return RMultiZ<true>(m_df.index(x), m_df.index(y), *x_vec, *y_vec, *z_mat);
+        return RMultiZ<true>(m_df.index(x), m_df.index(y), z_indices, *x_vec, *y_vec, *z_mat);
     }
 }
 
@@ -1,13 +1,20 @@
 #ifndef PYBNESIAN_LEARNING_INDEPENDENCES_CONTINUOUS_RCOT_HPP
 #define PYBNESIAN_LEARNING_INDEPENDENCES_CONTINUOUS_RCOT_HPP
 
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <unordered_map>
 #include <Eigen/Eigenvalues>
+#include <kde/KDE.hpp>
 #include <learning/independences/independence.hpp>
 #include <util/math_constants.hpp>
 #include <util/basic_eigen_ops.hpp>
 #include <util/chisquaresum.hpp>
 
+using kde::KDEBackend;
 using learning::independences::IndependenceTest;
 
 namespace learning::independences::continuous {
@@ -42,18 +49,38 @@ typename MatrixType::Scalar rf_sigma_impl(MatrixType& m) {
 
 class RCoT : public IndependenceTest {
 public:
-    RCoT(const DataFrame& df, int random_fourier_xy = 5, int random_fourier_z = 100)
-        : m_df(df.normalize()),
+    // The random fourier features of the variables are generated with a seed derived from seed and the variables, so
+    // the tests return the same p-values with the same seed. If cache_memory is greater than 0, the random fourier
+    // features of each variable are generated once and reused in the following tests. At most cache_memory bytes are
+    // cached.
+    //
+    // With KDEBackend::OPENCL, the random fourier features and the covariance of the products of the x and y features
+    // are computed with the OpenCL devices. The random weights of the features are still generated in the host, so the
+    // features are the same (up to rounding) as with KDEBackend::CPU.
+    //
+    // If subsample is greater than 0 and df has more rows, the tests use a uniform random sample (drawn with seed) of
+    // subsample rows of df. The sample is the same for all the tests, so their results are consistent.
+    RCoT(const DataFrame& df,
+         int random_fourier_xy = 5,
+         int random_fourier_z = 100,
+         std::size_t cache_memory = 0,
+         unsigned int seed = std::random_device{}(),
+         KDEBackend backend = KDEBackend::CPU,
+         int64_t subsample = 0)
+        : m_df((subsample > 0 ? df.sample_rows(subsample, seed) : df).normalize()),
           m_num_random_fourier_xy(random_fourier_xy),
           m_num_random_fourier_z(random_fourier_z),
-          m_dfourier_x(),
-          m_dfourier_y(),
-          m_dfourier_z(),
+          m_backend(kde::resolve_backend(backend)),
           m_dsigma(),
-          m_ffourier_x(),
-          m_ffourier_y(),
-          m_ffourier_z(),
-          m_fsigma() {
+          m_fsigma(),
+          m_cache_memory(cache_memory),
+          m_seed(seed),
+          m_cache_mutex(),
+          m_dcache(),
+          m_fcache(),
+          m_subsample(subsample) {
+        if (subsample < 0) throw std::invalid_argument("subsample must be a non-negative number.");
+
         auto continuous_indices = df.continuous_columns();
 
         if (continuous_indices.size() < 2) {
@@ -64,10 +91,6 @@ public:
 
         switch (type->id()) {
             case Type::DOUBLE: {
-                m_dfourier_x = MatrixXd(df.num_rows(), m_num_random_fourier_xy);
-                m_dfourier_y = MatrixXd(df.num_rows(), m_num_random_fourier_xy);
-                m_dfourier_z = MatrixXd(df.num_rows(), m_num_random_fourier_z);
-                m_tmp_dcov = MatrixXd(df.num_rows(), m_num_random_fourier_xy * m_num_random_fourier_xy);
                 m_dsigma = VectorXd(df->num_columns());
 
                 for (auto c : continuous_indices) {
@@ -80,10 +103,6 @@ public:
                 break;
             }
             case Type::FLOAT: {
-                m_ffourier_x = MatrixXf(df.num_rows(), m_num_random_fourier_xy);
-                m_ffourier_y = MatrixXf(df.num_rows(), m_num_random_fourier_xy);
-                m_ffourier_z = MatrixXf(df.num_rows(), m_num_random_fourier_z);
-                m_tmp_fcov = MatrixXf(df.num_rows(), m_num_random_fourier_xy * m_num_random_fourier_xy);
                 m_fsigma = VectorXf(df->num_columns());
 
                 for (auto c : continuous_indices) {
@@ -112,6 +131,11 @@ public:
     template <typename ArrowType>
     double pvalue(const std::string& x, const std::string& y, const std::vector<std::string>& z) const;
 
+    KDEBackend backend() const { return m_backend; }
+    int64_t subsample() const { return m_subsample; }
+
+    std::string ToString() const override { return "RCoT"; }
+
     int num_variables() const override { return m_df->num_columns(); }
 
     std::vector<std::string> variable_names() const override { return m_df.column_names(); }
@@ -122,6 +146,21 @@ public:
 
     bool has_variables(const std::vector<std::string>& cols) const override { return m_df.has_columns(cols); }
 
+    // The memory of the cached random fourier features. The limit reduces the cache_memory of the constructor.
+    util::MemoryUsage memory_usage() const override {
+        util::MemoryUsage usage;
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        usage.add("feature_cache", m_dcache.memory + m_fcache.memory);
+        return usage;
+    }
+
+    void set_max_cache_memory(std::size_t max_memory) override {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_max_cache_memory = max_memory;
+        evict_features_unlocked(m_dcache, 0);
+        evict_features_unlocked(m_fcache, 0);
+    }
+
 private:
     template <typename Scalar>
     Scalar rf_sigma(int index) const {
@@ -131,96 +170,166 @@ private:
             return m_fsigma(index);
     }
 
+    // Scratch matrices of a test: the random fourier features of each variable and the products of the x and y
+    // features. The products are not stored in the host with KDEBackend::OPENCL.
     template <typename Scalar>
-    Matrix<Scalar, Dynamic, Dynamic>& fourier_x() const {
-        if constexpr (std::is_same_v<Scalar, double>)
-            return m_dfourier_x;
-        else
-            return m_ffourier_x;
-    }
+    struct Workspace {
+        // The matrices are only reallocated when their sizes change.
+        void resize(int num_rows, int random_fourier_xy, int random_fourier_z, bool host_products) {
+            fourier_x.resize(num_rows, random_fourier_xy);
+            fourier_y.resize(num_rows, random_fourier_xy);
+            fourier_z.resize(num_rows, random_fourier_z);
+            tmp_cov.resize(host_products ? num_rows : 0, random_fourier_xy * random_fourier_xy);
+        }
 
+        Matrix<Scalar, Dynamic, Dynamic> fourier_x;
+        Matrix<Scalar, Dynamic, Dynamic> fourier_y;
+        Matrix<Scalar, Dynamic, Dynamic> fourier_z;
+        Matrix<Scalar, Dynamic, Dynamic> tmp_cov;
+    };
+
+    // Returns the workspace of the calling thread, sized for the tests of this RCoT. Each thread keeps one workspace
+    // (as util::ScratchArena), so the following tests of the thread do not allocate the scratch matrices, concurrent
+    // calls to pvalue() do not share them, and the workspace is freed when the thread ends.
     template <typename Scalar>
-    Matrix<Scalar, Dynamic, Dynamic>& fourier_y() const {
-        if constexpr (std::is_same_v<Scalar, double>)
-            return m_dfourier_y;
-        else
-            return m_ffourier_y;
+    Workspace<Scalar>& workspace() const {
+        thread_local Workspace<Scalar> ws;
+        ws.resize(m_df->num_rows(), m_num_random_fourier_xy, m_num_random_fourier_z, m_backend == KDEBackend::CPU);
+        return ws;
     }
 
+    // Cached random fourier features of the variables. The features are identified by the variable index and the number
+    // of features, and they are removed in insertion order when the cache is full.
     template <typename Scalar>
-    Matrix<Scalar, Dynamic, Dynamic>& fourier_z() const {
-        if constexpr (std::is_same_v<Scalar, double>)
-            return m_dfourier_z;
-        else
-            return m_ffourier_z;
+    struct FeatureCache {
+        std::unordered_map<int64_t, std::shared_ptr<const Matrix<Scalar, Dynamic, Dynamic>>> features;
+        std::deque<int64_t> insertion_order;
+        std::size_t memory = 0;
+    };
+
+    // The maximum memory of each feature cache.
+    std::size_t cache_limit() const { return std::min<std::size_t>(m_cache_memory, m_max_cache_memory); }
+
+    // Removes the oldest features until memory more bytes fit in the cache.
+    template <typename Scalar>
+    void evict_features_unlocked(FeatureCache<Scalar>& cache, std::size_t memory) const {
+        while (!cache.insertion_order.empty() && cache.memory + memory > cache_limit()) {
+            auto it = cache.features.find(cache.insertion_order.front());
+            cache.memory -= static_cast<std::size_t>(it->second->size()) * sizeof(Scalar);
+            cache.features.erase(it);
+            cache.insertion_order.pop_front();
+        }
     }
 
     template <typename Scalar>
-    Matrix<Scalar, Dynamic, Dynamic>& tmp_cov() const {
+    FeatureCache<Scalar>& feature_cache() const {
         if constexpr (std::is_same_v<Scalar, double>)
-            return m_tmp_dcov;
+            return m_dcache;
         else
-            return m_tmp_fcov;
+            return m_fcache;
     }
 
-    template <typename Mat>
-    Matrix<typename Mat::Scalar, Dynamic, 1> eigenvalues_covariance(Mat& fourier_x, Mat& fourier_y) const;
+    // Fills feat with the random fourier features of m, in the device of the backend.
+    template <typename InputMatrix, typename OutputMatrix, typename Random>
+    void fourier_features(InputMatrix& m,
+                          typename InputMatrix::Scalar sigma,
+                          int num_features,
+                          OutputMatrix& feat,
+                          Random& rng) const;
+    std::vector<int> column_indices(const std::vector<std::string>& names) const {
+        std::vector<int> indices;
+        indices.reserve(names.size());
+        for (const auto& name : names) indices.push_back(m_df.index(name));
+        return indices;
+    }
 
+    // Fills feat with the random fourier features of m, the values of the variables with indices. The random weights
+    // are generated with a seed derived from m_seed, indices and num_features.
+    template <typename InputMatrix, typename OutputMatrix>
+    void seeded_fourier_features(const std::vector<int>& indices,
+                                 InputMatrix& m,
+                                 typename InputMatrix::Scalar sigma,
+                                 int num_features,
+                                 OutputMatrix& feat) const {
+        std::vector<unsigned int> seeds{m_seed};
+        for (auto index : indices) seeds.push_back(static_cast<unsigned int>(index));
+        seeds.push_back(static_cast<unsigned int>(num_features));
+
+        std::seed_seq seq(seeds.begin(), seeds.end());
+        std::mt19937 rng(seq);
+        fourier_features(m, sigma, num_features, feat, rng);
+    }
+
+    // Returns the eigenvalues of the covariance of the products of the x and y features, in the device of the backend.
+    template <typename Mat, typename TmpMat>
+    Matrix<typename Mat::Scalar, Dynamic, 1> feature_eigenvalues(Mat& fourier_x, Mat& fourier_y, TmpMat& tmp_cov) const;
+
+    // Fills feat with the random fourier features of the variable with index, whose values (without nulls) are v.
     template <typename VectorType, typename FeatureType>
-    double RIT_impl(
-        VectorType& x, VectorType& y, FeatureType& feat_x, FeatureType& feat_y, double sigma_x, double sigma_y) const;
+    void variable_fourier_features(int index,
+                                   VectorType& v,
+                                   typename VectorType::Scalar sigma,
+                                   FeatureType& feat) const;
+
+    template <typename VectorType, typename FeatureType, typename TmpMat>
+    double RIT_impl(VectorType& x,
+                    VectorType& y,
+                    FeatureType& feat_x,
+                    FeatureType& feat_y,
+                    TmpMat& tmp_cov) const;
     template <bool contains_null, typename VectorType>
     double RIT(int x_index, int y_index, VectorType& x, VectorType& y) const;
 
-    template <typename VectorType, typename MatType, typename FeatureType>
+    template <typename VectorType, typename MatType, typename FeatureType, typename TmpMat>
     double TestWithZ_impl(VectorType& x,
                           VectorType& y,
                           MatType& z,
                           FeatureType& feat_x,
                           FeatureType& feat_y,
                           FeatureType& feat_z,
-                          double sigma_x,
-                          double sigma_y,
-                          double sigma_z) const;
+                          TmpMat& tmp_cov) const;
 
     template <bool contains_null, typename VectorType>
     double RSingleZ(int x_index, int y_index, int z_index, VectorType& x, VectorType& y, VectorType& z) const;
 
     template <bool contains_null, typename VectorType, typename MatType>
-    double RMultiZ(int x_index, int y_index, VectorType& x, VectorType& y, MatType& z) const;
+    double RMultiZ(int x_index,
+                   int y_index,
+                   const std::vector<int>& z_indices,
+                   VectorType& x,
+                   VectorType& y,
+                   MatType& z) const;
 
     DataFrame m_df;
     int m_num_random_fourier_xy;
     int m_num_random_fourier_z;
-    // Cache fourier matrices and sigmas (double or float).
-    mutable MatrixXd m_dfourier_x;
-    mutable MatrixXd m_dfourier_y;
-    mutable MatrixXd m_dfourier_z;
-    mutable MatrixXd m_tmp_dcov;
+    KDEBackend m_backend;
+    // Cache sigmas (double or float).
     VectorXd m_dsigma;
-    mutable MatrixXf m_ffourier_x;
-    mutable MatrixXf m_ffourier_y;
-    mutable MatrixXf m_ffourier_z;
-    mutable MatrixXf m_tmp_fcov;
     VectorXf m_fsigma;
+    std::size_t m_cache_memory;
+    // The limit of set_max_cache_memory().
+    std::atomic<std::size_t> m_max_cache_memory = util::unlimited_memory;
+    unsigned int m_seed;
+    mutable std::mutex m_cache_mutex;
+    mutable FeatureCache<double> m_dcache;
+    mutable FeatureCache<float> m_fcache;
+    int64_t m_subsample;
 };
 
-template <typename InputMatrix, typename OutputMatrix>
-void random_fourier_features(InputMatrix& m,
-                             typename InputMatrix::Scalar sigma,
-                             int num_features,
-                             OutputMatrix& fourier_features) {
-    static_assert(std::is_same_v<typename InputMatrix::Scalar, typename OutputMatrix::Scalar>,
-                  "Input/Output matrices must have the same type");
-
-    using Scalar = typename InputMatrix::Scalar;
+// Returns the random weights W (a dims x num_features matrix) and offsets b of the random fourier features
+// sqrt(2) * cos(m * W + b).
+template <typename Scalar, typename Random>
+std::pair<Matrix<Scalar, Dynamic, Dynamic>, Matrix<Scalar, Dynamic, 1>> random_fourier_weights(int dims,
+                                                                                            Scalar sigma,
+                                                                                            int num_features,
+                                                                                            Random& rng) {
     using MatrixType = Matrix<Scalar, Dynamic, Dynamic>;
     using VectorType = Matrix<Scalar, Dynamic, 1>;
 
-    MatrixType W(m.cols(), num_features);
+    MatrixType W(dims, num_features);
     VectorType b(num_features);
 
-    std::mt19937 rng(std::random_device{}());
     std::normal_distribution<Scalar> normal;
     for (auto j = 0; j < W.cols(); ++j) {
         for (auto i = 0; i < W.rows(); ++i) {
@@ -235,11 +344,76 @@ void random_fourier_features(InputMatrix& m,
     }
     b *= 2 * util::pi<Scalar>;
 
+    return std::make_pair(std::move(W), std::move(b));
+}
+
+template <typename InputMatrix, typename OutputMatrix, typename Random>
+void random_fourier_features(InputMatrix& m,
+                             typename InputMatrix::Scalar sigma,
+                             int num_features,
+                             OutputMatrix& fourier_features,
+                             Random& rng) {
+    static_assert(std::is_same_v<typename InputMatrix::Scalar, typename OutputMatrix::Scalar>,
+                  "Input/Output matrices must have the same type");
+
+    using Scalar = typename InputMatrix::Scalar;
+
+    auto [W, b] = random_fourier_weights<Scalar>(m.cols(), sigma, num_features, rng);
     fourier_features.noalias() = (m * W).rowwise() + b.transpose();
     fourier_features = fourier_features.array().cos().matrix();
     fourier_features = fourier_features * util::root_two<Scalar>;
 }
 
+template <typename InputMatrix, typename OutputMatrix>
+void random_fourier_features(InputMatrix& m,
+                             typename InputMatrix::Scalar sigma,
+                             int num_features,
+                             OutputMatrix& fourier_features) {
+    std::mt19937 rng(std::random_device{}());
+    random_fourier_features(m, sigma, num_features, fourier_features, rng);
+}
+
+template <typename VectorType, typename FeatureType>
+void RCoT::variable_fourier_features(int index,
+                                     VectorType& v,
+                                     typename VectorType::Scalar sigma,
+                                     FeatureType& feat) const {
+    using Scalar = typename VectorType::Scalar;
+    using MatrixType = Matrix<Scalar, Dynamic, Dynamic>;
+
+    if (cache_limit() == 0) {
+        seeded_fourier_features({index}, v, sigma, feat.cols(), feat);
+        return;
+    }
+
+    auto key = (static_cast<int64_t>(index) << 32) | static_cast<int64_t>(feat.cols());
+    auto& cache = feature_cache<Scalar>();
+
+    std::shared_ptr<const MatrixType> features;
+    {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        auto it = cache.features.find(key);
+        if (it != cache.features.end()) features = it->second;
+    }
+
+    if (!features) {
+        auto new_features = std::make_shared<MatrixType>(v.rows(), feat.cols());
+        seeded_fourier_features({index}, v, sigma, feat.cols(), *new_features);
+        features = new_features;
+
+        auto memory = static_cast<std::size_t>(new_features->size()) * sizeof(Scalar);
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        if (memory <= cache_limit() && cache.features.count(key) == 0) {
+            evict_features_unlocked(cache, memory);
+            cache.memory += memory;
+            cache.features.emplace(key, std::move(new_features));
+            cache.insertion_order.push_back(key);
+        }
+    }
+
+    feat = *features;
+}
+
 template <typename Mat, typename TmpMat>
 Matrix<typename Mat::Scalar, Dynamic, 1> eigenvalues_covariance_impl(Mat& fourier_x, Mat& fourier_y, TmpMat& tmp_mat) {
     using Scalar = typename Mat::Scalar;
@@ -249,16 +423,13 @@ Matrix<typename Mat::Scalar, Dynamic, 1> eigenvalues_covariance_impl(Mat& fourie
         tmp_mat.block(0, i * fourier_y.cols(), tmp_mat.rows(), fourier_y.cols()) =
             fourier_y.array().colwise() * fourier_x.col(i).array();
     }
-    auto cov = util::sse_mat(tmp_mat) * (1 / static_cast<Scalar>(fourier_x.rows()));
+    MatrixType cov = util::sse_mat(tmp_mat) * (1 / static_cast<Scalar>(fourier_x.rows()));
     auto eigen_solver = Eigen::SelfAdjointEigenSolver<MatrixType>(cov, Eigen::DecompositionOptions::EigenvaluesOnly);
     return eigen_solver.eigenvalues();
 }
 
-template <typename Mat>
-Matrix<typename Mat::Scalar, Dynamic, 1> RCoT::eigenvalues_covariance(Mat& fourier_x, Mat& fourier_y) const {
-    using Scalar = typename Mat::Scalar;
-    auto& cc = tmp_cov<Scalar>();
-
+template <typename Mat, typename TmpMat>
+Matrix<typename Mat::Scalar, Dynamic, 1> eigenvalues_covariance(Mat& fourier_x, Mat& fourier_y, TmpMat& cc) {
     if (fourier_x.rows() != cc.rows()) {
         auto tmp = cc.topRows(fourier_x.rows());
         return eigenvalues_covariance_impl(fourier_x, fourier_y, tmp);
@@ -267,6 +438,46 @@ Matrix<typename Mat::Scalar, Dynamic, 1> RCoT::eigenvalues_covariance(Mat& fouri
     }
 }
 
+// Computes the random fourier features sqrt(2) * cos(m * W + b) with the OpenCL device locked by the calling thread (or
+// the next device of the pool).
+template <typename Scalar>
+void opencl_fourier_features(const Matrix<Scalar, Dynamic, Dynamic>& m,
+                             const Matrix<Scalar, Dynamic, Dynamic>& W,
+                             const Matrix<Scalar, Dynamic, 1>& b,
+                             Eigen::Ref<Matrix<Scalar, Dynamic, Dynamic>> fourier_features);
+
+// Returns the eigenvalues of the covariance of the products of the columns of fourier_x and fourier_y, as
+// eigenvalues_covariance(). The products are computed with the OpenCL device, without storing them.
+template <typename Scalar>
+Matrix<Scalar, Dynamic, 1> opencl_eigenvalues_covariance(const Matrix<Scalar, Dynamic, Dynamic>& fourier_x,
+                                                         const Matrix<Scalar, Dynamic, Dynamic>& fourier_y);
+
+template <typename InputMatrix, typename OutputMatrix, typename Random>
+void RCoT::fourier_features(InputMatrix& m,
+                            typename InputMatrix::Scalar sigma,
+                            int num_features,
+                            OutputMatrix& feat,
+                            Random& rng) const {
+    using Scalar = typename InputMatrix::Scalar;
+
+    if (m_backend == KDEBackend::OPENCL) {
+        auto [W, b] = random_fourier_weights<Scalar>(m.cols(), sigma, num_features, rng);
+        opencl_fourier_features<Scalar>(m, W, b, feat);
+    } else {
+        random_fourier_features(m, sigma, num_features, feat, rng);
+    }
+}
+
+template <typename Mat, typename TmpMat>
+Matrix<typename Mat::Scalar, Dynamic, 1> RCoT::feature_eigenvalues(Mat& fourier_x,
+                                                                   Mat& fourier_y,
+                                                                   TmpMat& tmp_cov) const {
+    if (m_backend == KDEBackend::OPENCL)
+        return opencl_eigenvalues_covariance<typename Mat::Scalar>(fourier_x, fourier_y);
+    else
+        return eigenvalues_covariance(fourier_x, fourier_y, tmp_cov);
+}
+
 template <typename VectorType>
 Matrix<typename VectorType::Scalar, Dynamic, 1> filter_positive_elements(const VectorType& v) {
     using Scalar = typename VectorType::Scalar;
@@ -284,74 +495,55 @@ Matrix<typename VectorType::Scalar, Dynamic, 1> filter_positive_elements(const V
     return res;
 }
 
-template <typename VectorType, typename FeatureType>
-double RCoT::RIT_impl(
-    VectorType& x, VectorType& y, FeatureType& feat_x, FeatureType& feat_y, double sigma_x, double sigma_y) const {
-    random_fourier_features(x, sigma_x, m_num_random_fourier_xy, feat_x);
-    random_fourier_features(y, sigma_y, m_num_random_fourier_xy, feat_y);
-
+template <typename VectorType, typename FeatureType, typename TmpMat>
+double RCoT::RIT_impl(VectorType& x,
+                      VectorType& y,
+                      FeatureType& feat_x,
+                      FeatureType& feat_y,
+                      TmpMat& tmp_cov) const {
     util::normalize_cols(feat_x);
     util::normalize_cols(feat_y);
 
     auto Cxy = util::cov(feat_x, feat_y);
     auto sta = x.rows() * Cxy.squaredNorm();
-    auto eigs = eigenvalues_covariance(feat_x, feat_y);
+    auto eigs = feature_eigenvalues(feat_x, feat_y, tmp_cov);
     auto pos_eigs = filter_positive_elements(eigs);
 
-    if (pos_eigs.rows() < 4) {
-        auto pvalue = util::hbe_complement(pos_eigs, sta);
-        if (pvalue < 0) return 0;
-        return pvalue;
-    }
-
-    try {
-        auto pvalue = util::lpb4_complement(pos_eigs, sta);
-        if (pvalue < 0) return 0;
-        return pvalue;
-    } catch (std::exception&) {
-        auto pvalue = util::hbe_complement(pos_eigs, sta);
-        if (pvalue < 0) return 0;
-        return pvalue;
-    }
+    return util::chisquaresum_complement(pos_eigs, sta);
 }
 
 template <bool contains_null, typename VectorType>
 double RCoT::RIT(int x_index, int y_index, VectorType& x, VectorType& y) const {
     using Scalar = typename VectorType::Scalar;
+    auto& ws = workspace<Scalar>();
 
     if constexpr (contains_null) {
-        Scalar sigma_x = rf_sigma_impl(x);
-        Scalar sigma_y = rf_sigma_impl(y);
+        auto feat_x = ws.fourier_x.topRows(x.rows());
+        auto feat_y = ws.fourier_y.topRows(y.rows());
 
-        auto feat_x = fourier_x<Scalar>().topRows(x.rows());
-        auto feat_y = fourier_y<Scalar>().topRows(y.rows());
+        seeded_fourier_features({x_index}, x, rf_sigma_impl(x), m_num_random_fourier_xy, feat_x);
+        seeded_fourier_features({y_index}, y, rf_sigma_impl(y), m_num_random_fourier_xy, feat_y);
 
-        return RIT_impl(x, y, feat_x, feat_y, sigma_x, sigma_y);
+        return RIT_impl(x, y, feat_x, feat_y, ws.tmp_cov);
     } else {
-        Scalar sigma_x = rf_sigma<Scalar>(x_index);
-        Scalar sigma_y = rf_sigma<Scalar>(y_index);
+        auto& feat_x = ws.fourier_x;
+        auto& feat_y = ws.fourier_y;
 
-        auto& feat_x = fourier_x<Scalar>();
-        auto& feat_y = fourier_y<Scalar>();
+        variable_fourier_features(x_index, x, rf_sigma<Scalar>(x_index), feat_x);
+        variable_fourier_features(y_index, y, rf_sigma<Scalar>(y_index), feat_y);
 
-        return RIT_impl(x, y, feat_x, feat_y, sigma_x, sigma_y);
+        return RIT_impl(x, y, feat_x, feat_y, ws.tmp_cov);
     }
 }
 
-template <typename VectorType, typename MatType, typename FeatureType>
+template <typename VectorType, typename MatType, typename FeatureType, typename TmpMat>
 double RCoT::TestWithZ_impl(VectorType& x,
                             VectorType& y,
                             MatType& z,
                             FeatureType& feat_x,
                             FeatureType& feat_y,
                             FeatureType& feat_z,
-                            double sigma_x,
-                            double sigma_y,
-                            double sigma_z) const {
-    random_fourier_features(x, sigma_x, m_num_random_fourier_xy, feat_x);
-    random_fourier_features(y, sigma_y, m_num_random_fourier_xy, feat_y);
-    random_fourier_features(z, sigma_z, m_num_random_fourier_z, feat_z);
-
+                            TmpMat& tmp_cov) const {
     util::normalize_cols(feat_x);
     util::normalize_cols(feat_y);
     util::normalize_cols(feat_z);
@@ -373,77 +565,73 @@ double RCoT::TestWithZ_impl(VectorType& x,
     auto Cxy_z = Cxy - Cxz * i_Czz * Czy;
 
     auto sta = x.rows() * Cxy_z.squaredNorm();
-    auto eigs = eigenvalues_covariance(feat_x, feat_y);
+    auto eigs = feature_eigenvalues(feat_x, feat_y, tmp_cov);
     auto pos_eigs = filter_positive_elements(eigs);
 
-    if (m_num_random_fourier_z == 1 || pos_eigs.rows() < 4) {
-        auto pvalue = util::hbe_complement(pos_eigs, sta);
-        if (pvalue < 0) return 0;
-        return pvalue;
-    }
+    if (m_num_random_fourier_z == 1) return std::max<double>(util::hbe_complement(pos_eigs, sta), 0);
 
-    try {
-        auto pvalue = util::lpb4_complement(pos_eigs, sta);
-        if (pvalue < 0) return 0;
-        return pvalue;
-    } catch (std::exception&) {
-        auto pvalue = util::hbe_complement(pos_eigs, sta);
-        if (pvalue < 0) return 0;
-        return pvalue;
-    }
+    return util::chisquaresum_complement(pos_eigs, sta);
 }
 
 template <bool contains_null, typename VectorType>
 double RCoT::RSingleZ(int x_index, int y_index, int z_index, VectorType& x, VectorType& y, VectorType& z) const {
     using Scalar = typename VectorType::Scalar;
+    auto& ws = workspace<Scalar>();
 
     if constexpr (contains_null) {
-        Scalar sigma_x = rf_sigma_impl(x);
-        Scalar sigma_y = rf_sigma_impl(y);
-        Scalar sigma_z = rf_sigma_impl(z);
+        auto feat_x = ws.fourier_x.topRows(x.rows());
+        auto feat_y = ws.fourier_y.topRows(y.rows());
+        auto feat_z = ws.fourier_z.topRows(z.rows());
 
-        auto feat_x = fourier_x<Scalar>().topRows(x.rows());
-        auto feat_y = fourier_y<Scalar>().topRows(y.rows());
-        auto feat_z = fourier_z<Scalar>().topRows(z.rows());
+        seeded_fourier_features({x_index}, x, rf_sigma_impl(x), m_num_random_fourier_xy, feat_x);
+        seeded_fourier_features({y_index}, y, rf_sigma_impl(y), m_num_random_fourier_xy, feat_y);
+        seeded_fourier_features({z_index}, z, rf_sigma_impl(z), m_num_random_fourier_z, feat_z);
 
-        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, sigma_x, sigma_y, sigma_z);
+        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, ws.tmp_cov);
     } else {
-        Scalar sigma_x = rf_sigma<Scalar>(x_index);
-        Scalar sigma_y = rf_sigma<Scalar>(y_index);
-        Scalar sigma_z = rf_sigma<Scalar>(z_index);
+        auto& feat_x = ws.fourier_x;
+        auto& feat_y = ws.fourier_y;
+        auto& feat_z = ws.fourier_z;
 
-        auto& feat_x = fourier_x<Scalar>();
-        auto& feat_y = fourier_y<Scalar>();
-        auto& feat_z = fourier_z<Scalar>();
+        variable_fourier_features(x_index, x, rf_sigma<Scalar>(x_index), feat_x);
+        variable_fourier_features(y_index, y, rf_sigma<Scalar>(y_index), feat_y);
+        variable_fourier_features(z_index, z, rf_sigma<Scalar>(z_index), feat_z);
 
-        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, sigma_x, sigma_y, sigma_z);
+        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, ws.tmp_cov);
     }
 }
 
 template <bool contains_null, typename VectorType, typename MatType>
-double RCoT::RMultiZ(int x_index, int y_index, VectorType& x, VectorType& y, MatType& z) const {
+double RCoT::RMultiZ(int x_index,
+                     int y_index,
+                     const std::vector<int>& z_indices,
+                     VectorType& x,
+                     VectorType& y,
+                     MatType& z) const {
     using Scalar = typename VectorType::Scalar;
+    auto& ws = workspace<Scalar>();
 
     if constexpr (contains_null) {
-        Scalar sigma_x = rf_sigma_impl(x);
-        Scalar sigma_y = rf_sigma_impl(y);
-        Scalar sigma_z = rf_sigma_impl(z);
+        auto feat_x = ws.fourier_x.topRows(x.rows());
+        auto feat_y = ws.fourier_y.topRows(y.rows());
+        auto feat_z = ws.fourier_z.topRows(z.rows());
 
-        auto feat_x = fourier_x<Scalar>().topRows(x.rows());
-        auto feat_y = fourier_y<Scalar>().topRows(y.rows());
-        auto feat_z = fourier_z<Scalar>().topRows(z.rows());
+        seeded_fourier_features({x_index}, x, rf_sigma_impl(x), m_num_random_fourier_xy, feat_x);
+        seeded_fourier_features({y_index}, y, rf_sigma_impl(y), m_num_random_fourier_xy, feat_y);
+        seeded_fourier_features(z_indices, z, rf_sigma_impl(z), m_num_random_fourier_z, feat_z);
 
-        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, sigma_x, sigma_y, sigma_z);
+        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, ws.tmp_cov);
     } else {
-        Scalar sigma_x = rf_sigma<Scalar>(x_index);
-        Scalar sigma_y = rf_sigma<Scalar>(y_index);
-        Scalar sigma_z = rf_sigma_impl(z);
+        auto& feat_x = ws.fourier_x;
+        auto& feat_y = ws.fourier_y;
+        auto& feat_z = ws.fourier_z;
 
-        auto& feat_x = fourier_x<Scalar>();
-        auto& feat_y = fourier_y<Scalar>();
-        auto& feat_z = fourier_z<Scalar>();
+        variable_fourier_features(x_index, x, rf_sigma<Scalar>(x_index), feat_x);
+        variable_fourier_features(y_index, y, rf_sigma<Scalar>(y_index), feat_y);
+        // The features of a set of conditioning variables are not cached.
+        seeded_fourier_features(z_indices, z, rf_sigma_impl(z), m_num_random_fourier_z, feat_z);
 
-        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, sigma_x, sigma_y, sigma_z);
+        return TestWithZ_impl(x, y, z, feat_x, feat_y, feat_z, ws.tmp_cov);
     }
 }
 
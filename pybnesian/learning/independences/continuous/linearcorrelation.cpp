@@ -1,4 +1,5 @@
 #include <learning/independences/continuous/linearcorrelation.hpp>
+#include <map>
 #include <boost/math/distributions/students_t.hpp>
 
 using boost::math::cdf, boost::math::complement;
@@ -13,7 +14,11 @@ double cor_pvalue(double cor, int df) {
 }
 
 double LinearCorrelation::pvalue_cached(const std::string& v1, const std::string& v2) const {
-    double cor = cor_0cond(m_cov, cached_index(v1), cached_index(v2));
+    return pvalue_cached_indices(cached_index(v1), cached_index(v2));
+}
+
+double LinearCorrelation::pvalue_cached_indices(int v1, int v2) const {
+    double cor = cor_0cond(m_cov, v1, v2);
     return cor_pvalue(cor, m_df->num_rows() - 2);
 }
 
@@ -41,7 +46,11 @@ double LinearCorrelation::pvalue_impl(const std::string& v1, const std::string&
 }
 
 double LinearCorrelation::pvalue_cached(const std::string& v1, const std::string& v2, const std::string& ev) const {
-    double cor = cor_1cond(m_cov, cached_index(v1), cached_index(v2), cached_index(ev));
+    return pvalue_cached_indices(cached_index(v1), cached_index(v2), cached_index(ev));
+}
+
+double LinearCorrelation::pvalue_cached_indices(int v1, int v2, int ev) const {
+    double cor = cor_1cond(m_cov, v1, v2, ev);
     return cor_pvalue(cor, m_df->num_rows() - 3);
 }
 
@@ -68,11 +77,13 @@ double LinearCorrelation::pvalue_impl(const std::string& v1, const std::string&
     return cor_pvalue(cor, df);
 }
 
-double LinearCorrelation::pvalue_cached(const std::string& v1,
-                                        const std::string& v2,
-                                        const std::vector<std::string>& ev) const {
-    std::vector<int> cached_indices;
+double LinearCorrelation::pvalue(const std::string& v1,
+                                 const std::string& v2,
+                                 const std::vector<std::string>& ev) const {
+    if (!m_cached_cov && !m_pattern_moments) return pvalue_impl(v1, v2, ev);
 
+    std::vector<int> cached_indices;
+    cached_indices.reserve(ev.size() + 2);
     cached_indices.push_back(cached_index(v1));
     cached_indices.push_back(cached_index(v2));
 
@@ -80,7 +91,147 @@ double LinearCorrelation::pvalue_cached(const std::string& v1,
         cached_indices.push_back(cached_index(*it));
     }
 
+    if (m_cached_cov)
+        return pvalue_cached_indices(cached_indices);
+    else
+        return pvalue_pattern(cached_indices);
+}
+
+double LinearCorrelation::pvalue(int v1, int v2, const std::vector<int>& ev) const {
+    if (!m_cached_cov && !m_pattern_moments) return pvalue_impl(name(v1), name(v2), names(ev));
+
+    std::vector<int> cached_indices;
+    cached_indices.reserve(ev.size() + 2);
+    cached_indices.push_back(cached_index(v1));
+    cached_indices.push_back(cached_index(v2));
+
+    for (auto e : ev) {
+        cached_indices.push_back(cached_index(e));
+    }
+
+    if (m_cached_cov)
+        return pvalue_cached_indices(cached_indices);
+    else
+        return pvalue_pattern(cached_indices);
+}
+
+std::shared_ptr<const MatrixXd> LinearCorrelation::cholesky_factor(const std::vector<int>& z) const {
+    {
+        std::lock_guard<std::mutex> lock(m_cholesky_mutex);
+        auto it = m_cholesky.find(z);
+        if (it != m_cholesky.end()) return it->second;
+    }
+
+    int k = z.size();
+    auto last = z.back();
+
+    std::shared_ptr<MatrixXd> factor;
+    if (k == 1) {
+        if (m_cov(last, last) >= util::machine_tol) {
+            factor = std::make_shared<MatrixXd>(1, 1);
+            (*factor)(0, 0) = sqrt(m_cov(last, last));
+        }
+    } else if (auto prefix = cholesky_factor(std::vector<int>(z.begin(), z.end() - 1))) {
+        // The new row l of the factor solves L * l = cov(z[0..k-2], last).
+        VectorXd l(k - 1);
+        for (int i = 0; i < k - 1; ++i) {
+            l(i) = m_cov(z[i], last);
+        }
+
+        prefix->triangularView<Eigen::Lower>().solveInPlace(l);
+
+        auto d2 = m_cov(last, last) - l.squaredNorm();
+        if (d2 > util::machine_tol * m_cov(last, last)) {
+            factor = std::make_shared<MatrixXd>(MatrixXd::Zero(k, k));
+            factor->topLeftCorner(k - 1, k - 1) = *prefix;
+            factor->row(k - 1).head(k - 1) = l.transpose();
+            (*factor)(k - 1, k - 1) = sqrt(d2);
+        }
+    }
+
+    // The singular covariances are also cached (as nullptr), so they are not factorized again.
+    std::size_t cells = factor ? factor->size() : 1;
+
+    std::lock_guard<std::mutex> lock(m_cholesky_mutex);
+    if (cells > m_max_cholesky_cells || m_cholesky.count(z) > 0) return factor;
+
+    evict_cholesky_unlocked(cells);
+    m_cholesky_cells += cells;
+    m_cholesky_order.push_back(z);
+    m_cholesky.emplace(z, factor);
+    return factor;
+}
+
+void LinearCorrelation::evict_cholesky_unlocked(std::size_t cells) const {
+    while (!m_cholesky_order.empty() && m_cholesky_cells + cells > m_max_cholesky_cells) {
+        auto it = m_cholesky.find(m_cholesky_order.front());
+        m_cholesky_cells -= it->second ? it->second->size() : 1;
+        m_cholesky.erase(it);
+        m_cholesky_order.pop_front();
+    }
+}
+
+util::MemoryUsage LinearCorrelation::memory_usage() const {
+    util::MemoryUsage usage;
+    {
+        std::lock_guard<std::mutex> lock(m_opencl_mutex);
+        usage.add("cov", util::eigen_bytes(m_cov), m_cov_buffer ? opencl::buffer_bytes(*m_cov_buffer) : 0);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_cholesky_mutex);
+        usage.add("cholesky_cache", sizeof(double) * m_cholesky_cells);
+    }
+    if (m_pattern_moments) usage.add("pattern_moments", m_pattern_moments->memory());
+    return usage;
+}
+
+void LinearCorrelation::set_max_cache_memory(std::size_t max_memory) {
+    {
+        std::lock_guard<std::mutex> lock(m_cholesky_mutex);
+        m_max_cholesky_cells = std::min(max_cholesky_cells, max_memory / sizeof(double));
+        evict_cholesky_unlocked(0);
+    }
+    if (m_pattern_moments)
+        m_pattern_moments->set_max_cells(std::min(MissingPatternMoments::max_cells, max_memory / sizeof(double)));
+}
+
+std::optional<double> LinearCorrelation::cor_cholesky(int v1, int v2, const std::vector<int>& z) const {
+    auto factor = cholesky_factor(z);
+    if (!factor) return std::nullopt;
+
+    int k = z.size();
+    VectorXd a(k);
+    VectorXd b(k);
+    for (int i = 0; i < k; ++i) {
+        a(i) = m_cov(z[i], v1);
+        b(i) = m_cov(z[i], v2);
+    }
+
+    factor->triangularView<Eigen::Lower>().solveInPlace(a);
+    factor->triangularView<Eigen::Lower>().solveInPlace(b);
+
+    // Covariance of v1 and v2 given z.
+    auto var1 = m_cov(v1, v1) - a.squaredNorm();
+    auto var2 = m_cov(v2, v2) - b.squaredNorm();
+    auto cov12 = m_cov(v1, v2) - a.dot(b);
+
+    if (var1 <= util::machine_tol * m_cov(v1, v1) || var2 <= util::machine_tol * m_cov(v2, v2)) return std::nullopt;
+
+    return std::clamp(cov12 / sqrt(var1 * var2), -1., 1.);
+}
+
+double LinearCorrelation::pvalue_cached_indices(const std::vector<int>& cached_indices) const {
     int k = cached_indices.size();
+
+    // The conditioning variables are sorted, so the conditioning sets that share a prefix share the Cholesky factors.
+    std::vector<int> z(cached_indices.begin() + 2, cached_indices.end());
+    std::sort(z.begin(), z.end());
+
+    if (auto cor = cor_cholesky(cached_indices[0], cached_indices[1], z)) {
+        return cor_pvalue(*cor, m_df->num_rows() - 2 - k);
+    }
+
+    // The singular covariances are solved with the pseudo-inverse.
     MatrixXd cov(k, k);
 
     for (int i = 0; i < k; ++i) {
@@ -94,6 +245,139 @@ double LinearCorrelation::pvalue_cached(const std::string& v1,
     return cor_pvalue(cor, m_df->num_rows() - 2 - k);
 }
 
+double LinearCorrelation::pvalue_cached_test(const IndexedTest& test) const {
+    switch (test.ev.size()) {
+        case 0:
+            return pvalue_cached_indices(cached_index(test.v1), cached_index(test.v2));
+        case 1:
+            return pvalue_cached_indices(cached_index(test.v1), cached_index(test.v2), cached_index(test.ev[0]));
+        default: {
+            std::vector<int> cached_indices;
+            cached_indices.reserve(test.ev.size() + 2);
+            cached_indices.push_back(cached_index(test.v1));
+            cached_indices.push_back(cached_index(test.v2));
+            for (auto e : test.ev) {
+                cached_indices.push_back(cached_index(e));
+            }
+
+            return pvalue_cached_indices(cached_indices);
+        }
+    }
+}
+
+const cl::Buffer& LinearCorrelation::cov_buffer(OpenCLConfig& opencl) const {
+    std::lock_guard<std::mutex> lock(m_opencl_mutex);
+    // The devices of the pool share the same context, so the buffer is uploaded once for all of them.
+    if (!m_cov_buffer) m_cov_buffer = std::make_shared<cl::Buffer>(opencl.copy_to_buffer(m_cov.data(), m_cov.size()));
+    return *m_cov_buffer;
+}
+
+void LinearCorrelation::opencl_pvalues(const std::vector<IndexedTest>& tests,
+                                       const std::vector<int>& group,
+                                       int k,
+                                       std::vector<double>& res) const {
+    using ArrowType = arrow::DoubleType;
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+    auto& opencl = OpenCLConfig::get();
+    const auto& cov = cov_buffer(opencl);
+
+    unsigned int n = m_cov.rows();
+    unsigned int uk = k;
+    double tol = util::machine_tol;
+    auto df = m_df->num_rows() - 2 - k;
+
+    std::vector<unsigned int> cached_indices;
+    std::vector<int> z(k);
+    std::vector<double> cors;
+    auto& k_batch = opencl.kernel(OpenCL_kernel_traits<ArrowType>::linear_correlation_batch);
+    for (std::size_t begin = 0; begin < group.size(); begin += opencl_batch_tests) {
+        auto end = std::min(begin + opencl_batch_tests, group.size());
+        int batch = end - begin;
+
+        cached_indices.clear();
+        cached_indices.reserve(batch * (k + 2));
+        for (auto i = begin; i < end; ++i) {
+            const auto& test = tests[group[i]];
+            cached_indices.push_back(cached_index(test.v1));
+            cached_indices.push_back(cached_index(test.v2));
+
+            // The conditioning variables are sorted as in pvalue_cached_indices().
+            for (int j = 0; j < k; ++j) {
+                z[j] = cached_index(test.ev[j]);
+            }
+            std::sort(z.begin(), z.end());
+            cached_indices.insert(cached_indices.end(), z.begin(), z.end());
+        }
+
+        auto indices_buffer = opencl.copy_to_temp_buffer(cached_indices.data(), cached_indices.size());
+        auto workspace = opencl.temp_buffer<double>(batch * k * (k + 2));
+        auto output = opencl.temp_buffer<double>(batch);
+
+        k_batch.setArg(0, cov);
+        k_batch.setArg(1, n);
+        k_batch.setArg(2, uk);
+        k_batch.setArg(3, indices_buffer);
+        k_batch.setArg(4, tol);
+        k_batch.setArg(5, workspace);
+        k_batch.setArg(6, output);
+        RAISE_ENQUEUEKERNEL_ERROR(
+            opencl.queue().enqueueNDRangeKernel(k_batch, cl::NullRange, cl::NDRange(batch), cl::NullRange));
+
+        cors.resize(batch);
+        opencl.read_from_buffer(cors.data(), output, batch);
+
+        for (auto i = begin; i < end; ++i) {
+            auto cor = cors[i - begin];
+            res[group[i]] = std::isnan(cor) ? pvalue_cached_test(tests[group[i]]) : cor_pvalue(cor, df);
+        }
+    }
+}
+
+std::vector<double> LinearCorrelation::pvalues(const std::vector<IndexedTest>& tests) const {
+    if (!m_cached_cov) return IndependenceTest::pvalues(tests);
+
+    std::vector<double> res(tests.size());
+    // The tests with the same number of conditioning variables are evaluated with the same kernel launches.
+    std::map<int, std::vector<int>> groups;
+    for (int t = 0, size = tests.size(); t < size; ++t) {
+        int k = tests[t].ev.size();
+        if (m_backend == KDEBackend::OPENCL && k > 0)
+            groups[k].push_back(t);
+        else
+            res[t] = pvalue_cached_test(tests[t]);
+    }
+
+    for (const auto& [k, group] : groups) {
+        opencl_pvalues(tests, group, k, res);
+    }
+
+    return res;
+}
+
+double LinearCorrelation::pvalue_pattern(const std::vector<int>& cached_indices) const {
+    auto moments = m_pattern_moments->moments(cached_indices);
+    int k = cached_indices.size();
+
+    std::vector<int> positions;
+    positions.reserve(k);
+    for (auto i : cached_indices) {
+        positions.push_back(moments->positions[i]);
+    }
+
+    double inv_N = 1 / static_cast<double>(moments->rows - 1);
+    MatrixXd cov(k, k);
+    for (int i = 0; i < k; ++i) {
+        cov(i, i) = moments->sse(positions[i], positions[i]) * inv_N;
+        for (int j = i + 1; j < k; ++j) {
+            cov(i, j) = cov(j, i) = moments->sse(positions[i], positions[j]) * inv_N;
+        }
+    }
+
+    double cor = (k == 2) ? cor_0cond(cov, 0, 1) : cor_general(cov);
+    return cor_pvalue(cor, moments->rows - k);
+}
+
 double LinearCorrelation::pvalue_impl(const std::string& v1,
                                       const std::string& v2,
                                       const std::vector<std::string>& ev) const {
@@ -120,4 +404,85 @@ double LinearCorrelation::pvalue_impl(const std::string& v1,
     return cor_pvalue(cor, df);
 }
 
+std::vector<double> LinearCorrelation::pvalues(const std::string& v1,
+                                              const std::string& v2,
+                                              const std::vector<std::vector<std::string>>& evs) const {
+    if (!m_cached_cov) return IndependenceTest::pvalues(v1, v2, evs);
+
+    std::vector<int> cached_indices{cached_index(v1), cached_index(v2)};
+
+    std::vector<double> res;
+    res.reserve(evs.size());
+    for (const auto& ev : evs) {
+        switch (ev.size()) {
+            case 0:
+                res.push_back(pvalue_cached_indices(cached_indices[0], cached_indices[1]));
+                break;
+            case 1:
+                res.push_back(pvalue_cached_indices(cached_indices[0], cached_indices[1], cached_index(ev[0])));
+                break;
+            default: {
+                cached_indices.resize(2);
+                for (const auto& e : ev) {
+                    cached_indices.push_back(cached_index(e));
+                }
+
+                res.push_back(pvalue_cached_indices(cached_indices));
+            }
+        }
+    }
+
+    return res;
+}
+
+std::vector<double> LinearCorrelation::pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                              const std::vector<std::string>& ev) const {
+    if (!m_cached_cov) return IndependenceTest::pvalues(pairs, ev);
+
+    std::vector<std::pair<int, int>> index_pairs;
+    index_pairs.reserve(pairs.size());
+    for (const auto& pair : pairs) {
+        index_pairs.push_back({index(pair.first), index(pair.second)});
+    }
+
+    std::vector<int> index_ev;
+    index_ev.reserve(ev.size());
+    for (const auto& e : ev) {
+        index_ev.push_back(index(e));
+    }
+
+    return pvalues(index_pairs, index_ev);
+}
+
+std::vector<double> LinearCorrelation::pvalues(const std::vector<std::pair<int, int>>& pairs,
+                                              const std::vector<int>& ev) const {
+    if (!m_cached_cov) return IndependenceTest::pvalues(pairs, ev);
+
+    std::vector<int> cached_indices(2);
+    cached_indices.reserve(ev.size() + 2);
+    for (auto e : ev) {
+        cached_indices.push_back(cached_index(e));
+    }
+
+    std::vector<double> res;
+    res.reserve(pairs.size());
+    for (const auto& pair : pairs) {
+        cached_indices[0] = cached_index(pair.first);
+        cached_indices[1] = cached_index(pair.second);
+
+        switch (ev.size()) {
+            case 0:
+                res.push_back(pvalue_cached_indices(cached_indices[0], cached_indices[1]));
+                break;
+            case 1:
+                res.push_back(pvalue_cached_indices(cached_indices[0], cached_indices[1], cached_indices[2]));
+                break;
+            default:
+                res.push_back(pvalue_cached_indices(cached_indices));
+        }
+    }
+
+    return res;
+}
+
 }  // namespace learning::independences::continuous
\ No newline at end of file
@@ -2,12 +2,22 @@
 #define PYBNESIAN_LEARNING_INDEPENDENCES_CONTINUOUS_LINEARCORRELATION_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <optional>
 #include <dataset/dataset.hpp>
+#include <dataset/covariance_registry.hpp>
+#include <dataset/dynamic_dataset.hpp>
+#include <dataset/missing_patterns.hpp>
+#include <kde/KDE.hpp>
 #include <learning/independences/independence.hpp>
+#include <util/hash_utils.hpp>
 #include <util/math_constants.hpp>
 
-using dataset::DataFrame;
+using dataset::DataFrame, dataset::LaggedDataFrame, dataset::MissingPatternMoments, dataset::CovarianceRegistry;
 using Eigen::LLT, Eigen::Ref;
+using kde::KDEBackend;
 using learning::independences::IndependenceTest;
 
 namespace learning::independences::continuous {
@@ -67,34 +77,24 @@ double cor_general(EigenMatrix& cov) {
 
 class LinearCorrelation : public IndependenceTest {
 public:
-    LinearCorrelation(const DataFrame& df) : m_df(df), m_cached_cov(false), m_indices(), m_cov() {
-        auto continuous_indices = df.continuous_columns();
-
-        if (continuous_indices.size() < 2) {
-            throw std::invalid_argument("DataFrame does not contain enough continuous columns.");
-        }
-
-        if (m_df.null_count(continuous_indices) == 0) {
-            m_cached_cov = true;
-            for (int i = 0, size = continuous_indices.size(); i < size; ++i) {
-                m_indices.insert(std::make_pair(m_df->column_name(continuous_indices[i]), i));
-            }
-            switch (m_df.same_type(continuous_indices)->id()) {
-                case Type::DOUBLE:
-                    m_cov = *(m_df.cov<arrow::DoubleType, false>(continuous_indices).release());
-                    break;
-                case Type::FLOAT:
-                    m_cov = m_df.cov<arrow::FloatType, false>(continuous_indices)->template cast<double>();
-                    break;
-                default:
-                    break;
-            }
-        }
-    }
+    // Maximum number of cells of the cached Cholesky factors.
+    static constexpr std::size_t max_cholesky_cells = 1 << 20;
+    // Maximum number of tests evaluated by a kernel launch of the OpenCL backend.
+    static constexpr std::size_t opencl_batch_tests = 1 << 16;
+
+    // With KDEBackend::OPENCL, the batched pvalues(tests) of a DataFrame without nulls are evaluated with the OpenCL
+    // devices: the cached covariance is uploaded once, and the tests with the same number of conditioning variables are
+    // evaluated with one kernel launch. The p-values are the same (up to rounding) as with KDEBackend::CPU.
+    LinearCorrelation(const DataFrame& df, KDEBackend backend = KDEBackend::CPU)
+        : LinearCorrelation(df, nullptr, backend) {}
+    // The covariance of the columns of df is computed with LaggedDataFrame::moments().
+    LinearCorrelation(const LaggedDataFrame& df) : LinearCorrelation(df.dataframe(), &df, KDEBackend::CPU) {}
 
     double pvalue(const std::string& v1, const std::string& v2) const override {
         if (m_cached_cov)
             return pvalue_cached(v1, v2);
+        else if (m_pattern_moments)
+            return pvalue_pattern({cached_index(v1), cached_index(v2)});
         else
             return pvalue_impl(v1, v2);
     }
@@ -102,34 +102,138 @@ public:
     double pvalue(const std::string& v1, const std::string& v2, const std::string& ev) const override {
         if (m_cached_cov)
             return pvalue_cached(v1, v2, ev);
+        else if (m_pattern_moments)
+            return pvalue_pattern({cached_index(v1), cached_index(v2), cached_index(ev)});
         else
             return pvalue_impl(v1, v2, ev);
     }
 
-    double pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const override {
+    double pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const override;
+
+    using IndependenceTest::pvalue;
+    using IndependenceTest::pvalues;
+
+    // The indices of the variables are the indices of the columns of the DataFrame.
+    double pvalue(int v1, int v2) const override {
         if (m_cached_cov)
-            return pvalue_cached(v1, v2, ev);
+            return pvalue_cached_indices(cached_index(v1), cached_index(v2));
+        else if (m_pattern_moments)
+            return pvalue_pattern({cached_index(v1), cached_index(v2)});
         else
-            return pvalue_impl(v1, v2, ev);
+            return pvalue_impl(name(v1), name(v2));
+    }
+
+    double pvalue(int v1, int v2, int ev) const override {
+        if (m_cached_cov)
+            return pvalue_cached_indices(cached_index(v1), cached_index(v2), cached_index(ev));
+        else if (m_pattern_moments)
+            return pvalue_pattern({cached_index(v1), cached_index(v2), cached_index(ev)});
+        else
+            return pvalue_impl(name(v1), name(v2), name(ev));
     }
 
+    double pvalue(int v1, int v2, const std::vector<int>& ev) const override;
+
+    std::vector<double> pvalues(const std::string& v1,
+                                const std::string& v2,
+                                const std::vector<std::vector<std::string>>& evs) const override;
+    std::vector<double> pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                const std::vector<std::string>& ev) const override;
+    std::vector<double> pvalues(const std::vector<std::pair<int, int>>& pairs,
+                                const std::vector<int>& ev) const override;
+    std::vector<double> pvalues(const std::vector<IndexedTest>& tests) const override;
+
+    bool batched_levels() const override { return m_cached_cov && m_backend == KDEBackend::OPENCL; }
+
+    KDEBackend backend() const { return m_backend; }
+
+    std::string ToString() const override { return "LinearCorrelation"; }
+
     int num_variables() const override { return m_df->num_columns(); }
 
     std::vector<std::string> variable_names() const override { return m_df.column_names(); }
 
     const std::string& name(int i) const override { return m_df.name(i); }
 
+    int index(const std::string& name) const override {
+        auto i = m_df.index(name);
+        if (i == -1) throw std::invalid_argument("Variable " + name + " not present in LinearCorrelation.");
+        return i;
+    }
+
     bool has_variables(const std::string& name) const override { return m_df.has_columns(name); }
 
     bool has_variables(const std::vector<std::string>& cols) const override { return m_df.has_columns(cols); }
 
+    // The memory of the cached covariance (in the host and in the OpenCL devices), the cached Cholesky factors and the
+    // moments of the missingness patterns. The limit is applied to the Cholesky factors and the moments.
+    util::MemoryUsage memory_usage() const override;
+    void set_max_cache_memory(std::size_t max_memory) override;
+
 private:
+    LinearCorrelation(const DataFrame& df, const LaggedDataFrame* lagged, KDEBackend backend)
+        : m_df(df),
+          m_cached_cov(false),
+          m_indices(),
+          m_cached_positions(df->num_columns(), -1),
+          m_cov(),
+          m_cholesky_mutex(),
+          m_cholesky(),
+          m_cholesky_order(),
+          m_cholesky_cells(0),
+          m_max_cholesky_cells(max_cholesky_cells),
+          m_pattern_moments(),
+          m_backend(kde::resolve_backend(backend)),
+          m_opencl_mutex(),
+          m_cov_buffer() {
+        auto continuous_indices = df.continuous_columns();
+
+        if (continuous_indices.size() < 2) {
+            throw std::invalid_argument("DataFrame does not contain enough continuous columns.");
+        }
+
+        for (int i = 0, size = continuous_indices.size(); i < size; ++i) {
+            m_indices.insert(std::make_pair(m_df->column_name(continuous_indices[i]), i));
+            m_cached_positions[continuous_indices[i]] = i;
+        }
+
+        if (m_df.null_count(continuous_indices) > 0) {
+            // With nulls, the covariances are cached for each missingness pattern. This requires the same data type
+            // in all the continuous columns.
+            auto type = m_df.col(continuous_indices[0])->type_id();
+            bool same_type = std::all_of(continuous_indices.begin(), continuous_indices.end(), [this, type](int i) {
+                return m_df.col(i)->type_id() == type;
+            });
+
+            if (same_type) m_pattern_moments = std::make_shared<MissingPatternMoments>(m_df, continuous_indices);
+        } else {
+            m_cached_cov = true;
+            if (lagged) {
+                m_cov = lagged->moments(continuous_indices).second / static_cast<double>(m_df->num_rows() - 1);
+                return;
+            }
+
+            // The covariances are shared with the bandwidth selectors and the other tests of the same columns.
+            auto& registry = CovarianceRegistry::get();
+            auto continuous_columns = m_df.indices_to_columns(continuous_indices);
+            switch (m_df.same_type(continuous_indices)->id()) {
+                case Type::DOUBLE:
+                    m_cov = std::move(*registry.cov<arrow::DoubleType>(continuous_columns));
+                    break;
+                case Type::FLOAT:
+                    m_cov = registry.cov<arrow::FloatType>(continuous_columns)->template cast<double>();
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
     int cached_index(int v) const {
-        auto it = m_indices.find(m_df->column_name(v));
-        if (it == m_indices.end())
+        if (v < 0 || v >= static_cast<int>(m_cached_positions.size()) || m_cached_positions[v] == -1)
             throw std::invalid_argument("Continuous variable " + std::to_string(v) +
                                         " not present in LinearCorrelation.");
-        return it->second;
+        return m_cached_positions[v];
     }
 
     int cached_index(const std::string& name) const {
@@ -141,7 +245,36 @@ private:
 
     double pvalue_cached(const std::string& v1, const std::string& v2) const;
     double pvalue_cached(const std::string& v1, const std::string& v2, const std::string& ev) const;
-    double pvalue_cached(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const;
+
+    // Tests with the indices of the variables in the cached covariance. The cached_indices of the multivariate test
+    // contain v1, v2 and the evidence (in this order).
+    double pvalue_cached_indices(int v1, int v2) const;
+    double pvalue_cached_indices(int v1, int v2, int ev) const;
+    double pvalue_cached_indices(const std::vector<int>& cached_indices) const;
+    double pvalue_cached_test(const IndexedTest& test) const;
+
+    // Returns the copy of the cached covariance in the OpenCL devices, uploading it in the first call.
+    const cl::Buffer& cov_buffer(OpenCLConfig& opencl) const;
+    // Stores in res the p-values of the tests in group, which have k > 0 conditioning variables, computing the partial
+    // correlations with the OpenCL device. The singular tests are computed again with pvalue_cached_test().
+    void opencl_pvalues(const std::vector<IndexedTest>& tests,
+                        const std::vector<int>& group,
+                        int k,
+                        std::vector<double>& res) const;
+
+    // Returns the lower Cholesky factor of the cached covariance of the variables z (in this order), or nullptr if the
+    // covariance is singular. The factor is computed by extending the factor of z without its last variable with one
+    // row, so a factor costs O(k^2) if the factor of its prefix is cached.
+    std::shared_ptr<const MatrixXd> cholesky_factor(const std::vector<int>& z) const;
+    // Evicts the oldest Cholesky factors until cells more cells fit in the cache.
+    void evict_cholesky_unlocked(std::size_t cells) const;
+    // Returns the partial correlation of v1 and v2 given z using the Cholesky factor of z, or nothing if the covariance
+    // is singular.
+    std::optional<double> cor_cholesky(int v1, int v2, const std::vector<int>& z) const;
+
+    // Tests with the covariance of the missingness pattern of the variables, when the DataFrame contains nulls. The
+    // cached_indices contain v1, v2 and the evidence (in this order).
+    double pvalue_pattern(const std::vector<int>& cached_indices) const;
 
     double pvalue_impl(const std::string& v1, const std::string& v2) const;
     double pvalue_impl(const std::string& v1, const std::string& v2, const std::string& ev) const;
@@ -150,7 +283,30 @@ private:
     const DataFrame m_df;
     bool m_cached_cov;
     std::unordered_map<std::string, int> m_indices;
+    // The index in m_cov of each column of m_df, or -1 if the column is not cached.
+    std::vector<int> m_cached_positions;
     MatrixXd m_cov;
+
+    class HashIndices {
+    public:
+        inline std::size_t operator()(const std::vector<int>& indices) const {
+            size_t seed = indices.size();
+            for (auto i : indices) {
+                util::hash_combine(seed, i);
+            }
+            return seed;
+        }
+    };
+
+    mutable std::mutex m_cholesky_mutex;
+    mutable std::unordered_map<std::vector<int>, std::shared_ptr<const MatrixXd>, HashIndices> m_cholesky;
+    mutable std::deque<std::vector<int>> m_cholesky_order;
+    mutable std::size_t m_cholesky_cells;
+    std::atomic<std::size_t> m_max_cholesky_cells;
+    std::shared_ptr<MissingPatternMoments> m_pattern_moments;
+    KDEBackend m_backend;
+    mutable std::mutex m_opencl_mutex;
+    mutable std::shared_ptr<cl::Buffer> m_cov_buffer;
 };
 
 using DynamicLinearCorrelation = DynamicIndependenceTestAdaptator<LinearCorrelation>;
@@ -3,18 +3,131 @@
 #include <algorithm>
 
 #include <iomanip>
+#include <opencl/opencl_config.hpp>
+
+using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits;
 
 namespace learning::independences::continuous {
 
-double mi_pair(const DataFrame& df, int k) {
-    KDTree kdtree(df);
-    auto knn_results = kdtree.query(df, k + 1, std::numeric_limits<double>::infinity());
+namespace {
+
+// Returns the distance of each row of df to its k-th nearest row, with a KDTree or by brute force with the OpenCL
+// device.
+VectorXd knn_distances(const DataFrame& df, int k, double knn_eps, int num_threads, bool opencl) {
+    if (opencl) return bruteforce_knn_distances(df, k);
+
+    KDTree kdtree(df, 16, num_threads);
+    auto distances = kdtree.query_batch(df, k + 1, std::numeric_limits<double>::infinity(), knn_eps, num_threads).first;
+    return distances.row(k).transpose();
+}
 
-    VectorXd eps(df->num_rows());
-    for (auto i = 0; i < df->num_rows(); ++i) {
-        eps(i) = knn_results[i].first(k);
+// The MI estimate of Frenzel and Pompe from the counts of the neighbors of each row in the xz, yz and z subspaces.
+double conditional_mi(int k, const VectorXi& n_xz, const VectorXi& n_yz, const VectorXi& n_z) {
+    double res = 0;
+    for (int i = 0, rows = n_z.rows(); i < rows; ++i) {
+        res += boost::math::digamma(n_z(i)) - boost::math::digamma(n_xz(i)) - boost::math::digamma(n_yz(i));
     }
 
+    res /= n_z.rows();
+    res += boost::math::digamma(k);
+
+    return res;
+}
+
+// The counts of bruteforce_eps_neighbors() are computed in at most count_max_tiles tiles of at least
+// count_min_tile_rows rows, so the device has enough work items when df has few rows.
+constexpr int count_min_tile_rows = 1024;
+constexpr int count_max_tiles = 16;
+
+}  // namespace
+
+VectorXd bruteforce_knn_distances(const DataFrame& df, int k) {
+    using ArrowType = arrow::FloatType;
+
+    auto data = df.to_eigen<false, ArrowType, false>();
+    unsigned int rows = data->rows();
+    unsigned int cols = data->cols();
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+    auto& opencl = OpenCLConfig::get();
+
+    auto k_local_size = opencl.kernel_local_size(OpenCL_kernel_traits<ArrowType>::kmi_knn_distance);
+    auto k_local_memory = opencl.kernel_local_memory(OpenCL_kernel_traits<ArrowType>::kmi_knn_distance);
+    auto free_local_memory = opencl.max_local_memory() - k_local_memory;
+    auto local_size = std::min({static_cast<unsigned int>(k_local_size),
+                                static_cast<unsigned int>(free_local_memory / (cols * sizeof(float))),
+                                rows});
+    auto num_groups = (rows + local_size - 1) / local_size;
+    auto global_size = num_groups * local_size;
+
+    auto input = opencl.copy_to_temp_buffer(data->data(), rows * cols);
+    auto workspace = opencl.temp_buffer<float>(global_size * (k + 1));
+    auto output = opencl.temp_buffer<float>(rows);
+
+    auto& k_knn = opencl.kernel(OpenCL_kernel_traits<ArrowType>::kmi_knn_distance);
+    k_knn.setArg(0, input);
+    k_knn.setArg(1, rows);
+    k_knn.setArg(2, cols);
+    k_knn.setArg(3, static_cast<unsigned int>(k));
+    k_knn.setArg(4, cl::Local(local_size * cols * sizeof(float)));
+    k_knn.setArg(5, workspace);
+    k_knn.setArg(6, output);
+    RAISE_ENQUEUEKERNEL_ERROR(opencl.queue().enqueueNDRangeKernel(
+        k_knn, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size)));
+
+    VectorXf distances(rows);
+    opencl.read_from_buffer(distances.data(), output, rows);
+    return distances.cast<double>();
+}
+
+std::tuple<VectorXi, VectorXi, VectorXi> bruteforce_eps_neighbors(const DataFrame& df, const VectorXd& eps) {
+    using ArrowType = arrow::FloatType;
+
+    auto data = df.to_eigen<false, ArrowType, false>();
+    unsigned int rows = data->rows();
+    unsigned int cols = data->cols();
+
+    unsigned int num_tiles = std::min((rows + count_min_tile_rows - 1) / count_min_tile_rows,
+                                      static_cast<unsigned int>(count_max_tiles));
+    unsigned int tile_rows = (rows + num_tiles - 1) / num_tiles;
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+    auto& opencl = OpenCLConfig::get();
+
+    VectorXf eps_float = eps.cast<float>();
+    auto input = opencl.copy_to_temp_buffer(data->data(), rows * cols);
+    auto eps_buffer = opencl.copy_to_temp_buffer(eps_float.data(), rows);
+    auto partial_xz = opencl.temp_buffer<float>(num_tiles * rows);
+    auto partial_yz = opencl.temp_buffer<float>(num_tiles * rows);
+    auto partial_z = opencl.temp_buffer<float>(num_tiles * rows);
+
+    auto& k_count = opencl.kernel(OpenCL_kernel_traits<ArrowType>::kmi_count_subspaces);
+    k_count.setArg(0, input);
+    k_count.setArg(1, rows);
+    k_count.setArg(2, cols);
+    k_count.setArg(3, eps_buffer);
+    k_count.setArg(4, tile_rows);
+    k_count.setArg(5, num_tiles);
+    k_count.setArg(6, partial_xz);
+    k_count.setArg(7, partial_yz);
+    k_count.setArg(8, partial_z);
+    RAISE_ENQUEUEKERNEL_ERROR(opencl.queue().enqueueNDRangeKernel(
+        k_count, cl::NullRange, cl::NDRange(num_tiles * rows), cl::NullRange));
+
+    // The counts are integers lower than 2^24, so their float sums are exact.
+    auto sum_counts = [&opencl, rows, num_tiles](const cl::Buffer& partial) {
+        auto counts = opencl.reduction_cols<ArrowType, opencl::SumReduction<ArrowType>>(partial, num_tiles, rows);
+        VectorXf res(rows);
+        opencl.read_from_buffer(res.data(), counts, rows);
+        return VectorXi(res.cast<int>());
+    };
+
+    return std::make_tuple(sum_counts(partial_xz), sum_counts(partial_yz), sum_counts(partial_z));
+}
+
+double mi_pair(const DataFrame& df, int k, double knn_eps, int num_threads, bool opencl) {
+    VectorXd eps = knn_distances(df, k, knn_eps, num_threads, opencl);
+
     VectorXi nv1(df->num_rows());
     VectorXi nv2(df->num_rows());
 
@@ -41,14 +154,20 @@ double mi_pair(const DataFrame& df, int k) {
     return res;
 }
 
-double mi_triple(const DataFrame& df, int k) {
-    KDTree kdtree(df);
-    auto knn_results = kdtree.query(df, k + 1, std::numeric_limits<double>::infinity());
+double mi_triple(const DataFrame& df, int k, double knn_eps, int num_threads, bool opencl) {
+    auto raw_z = df.data<arrow::FloatType>(2);
 
-    VectorXd eps(df->num_rows());
-    for (auto i = 0; i < df->num_rows(); ++i) {
-        eps(i) = knn_results[i].first(k);
-    }
+    IndexComparator comp_z(raw_z);
+    std::vector<size_t> sort_z(df->num_rows());
+    std::iota(sort_z.begin(), sort_z.end(), 0);
+    std::sort(sort_z.begin(), sort_z.end(), comp_z);
+
+    return mi_triple(df, k, sort_z, knn_eps, num_threads, opencl);
+}
+
+double mi_triple(
+    const DataFrame& df, int k, const std::vector<size_t>& sort_z, double knn_eps, int num_threads, bool opencl) {
+    VectorXd eps = knn_distances(df, k, knn_eps, num_threads, opencl);
 
     VectorXi n_xz = VectorXi::Zero(df->num_rows());
     VectorXi n_yz = VectorXi::Zero(df->num_rows());
@@ -58,11 +177,6 @@ double mi_triple(const DataFrame& df, int k) {
     auto raw_y = df.data<arrow::FloatType>(1);
     auto raw_z = df.data<arrow::FloatType>(2);
 
-    IndexComparator comp_z(raw_z);
-    std::vector<size_t> sort_z(df->num_rows());
-    std::iota(sort_z.begin(), sort_z.end(), 0);
-    std::sort(sort_z.begin(), sort_z.end(), comp_z);
-
     for (int i = 0, rows = static_cast<int>(df->num_rows()); i < rows; ++i) {
         auto eps_i = static_cast<int>(eps(i));
         auto x_i = static_cast<int>(raw_x[i]);
@@ -98,94 +212,178 @@ double mi_triple(const DataFrame& df, int k) {
         }
     }
 
-    double res = 0;
-    for (int i = 0; i < df->num_rows(); ++i) {
-        res += boost::math::digamma(n_z(i)) - boost::math::digamma(n_xz(i)) - boost::math::digamma(n_yz(i));
-    }
-
-    res /= df->num_rows();
-    res += boost::math::digamma(k);
-
-    return res;
+    return conditional_mi(k, n_xz, n_yz, n_z);
 }
 
-double mi_general(const DataFrame& df, int k) {
-    KDTree kdtree(df);
-    auto knn_results = kdtree.query(df, k + 1, std::numeric_limits<double>::infinity());
-
-    VectorXd eps(df->num_rows());
-    for (auto i = 0; i < df->num_rows(); ++i) {
-        eps(i) = knn_results[i].first(k);
+double mi_general(const DataFrame& df, int k, double knn_eps, int num_threads, bool opencl) {
+    if (opencl) {
+        VectorXd eps = knn_distances(df, k, knn_eps, num_threads, true);
+        auto [n_xz, n_yz, n_z] = bruteforce_eps_neighbors(df, eps);
+        return conditional_mi(k, n_xz, n_yz, n_z);
     }
 
     std::vector<size_t> indices(df->num_columns() - 2);
     std::iota(indices.begin(), indices.end(), 2);
-    auto z_df = df.loc(indices);
-    KDTree ztree(z_df);
-    auto [n_xz, n_yz, n_z] = ztree.count_ball_subspaces(z_df, df.col(0), df.col(1), eps);
+    KDTree ztree(df.loc(indices), 16, num_threads);
 
-    double res = 0;
-    for (int i = 0; i < df->num_rows(); ++i) {
-        res += boost::math::digamma(n_z(i)) - boost::math::digamma(n_xz(i)) - boost::math::digamma(n_yz(i));
-    }
+    return mi_general(df, k, ztree, knn_eps, num_threads);
+}
 
-    res /= df->num_rows();
-    res += boost::math::digamma(k);
+double mi_general(const DataFrame& df, int k, const KDTree& ztree, double knn_eps, int num_threads) {
+    VectorXd eps = knn_distances(df, k, knn_eps, num_threads, false);
 
-    return res;
+    const auto& z_df = ztree.ranked_data();
+    auto [n_xz, n_yz, n_z] = ztree.count_ball_subspaces(z_df, df.col(0), df.col(1), eps, num_threads);
+
+    return conditional_mi(k, n_xz, n_yz, n_z);
 }
 
 double KMutualInformation::mi(const std::string& x, const std::string& y) const {
     auto subset_df = m_ranked_df.loc(x, y);
-    return mi_pair(subset_df, m_k);
+    return mi_pair(subset_df, m_k, m_knn_eps, m_num_threads, use_opencl(2));
 }
 
 double KMutualInformation::mi(const std::string& x, const std::string& y, const std::string& z) const {
     auto subset_df = m_ranked_df.loc(x, y, z);
-    return mi_triple(subset_df, m_k);
+    return mi_triple(subset_df, m_k, m_knn_eps, m_num_threads, use_opencl(3));
 }
 
 double KMutualInformation::mi(const std::string& x, const std::string& y, const std::vector<std::string>& z) const {
     auto subset_df = m_ranked_df.loc(x, y, z);
-    return mi_general(subset_df, m_k);
+    return mi_general(subset_df, m_k, m_knn_eps, m_num_threads, use_opencl(2 + z.size()));
 }
 
 double KMutualInformation::pvalue(const std::string& x, const std::string& y) const {
+    return permutation_test(x, y).pvalue;
+}
+
+PermutationTestResult KMutualInformation::permutation_test(const std::string& x, const std::string& y) const {
     auto value = mi(x, y);
 
-    auto shuffled_df = m_ranked_df.loc(Copy(x), y);
+    auto original_rank_x = m_ranked_df.template data<arrow::FloatType>(x);
 
-    auto x_begin = shuffled_df.template mutable_data<arrow::FloatType>(0);
-    auto x_end = x_begin + shuffled_df->num_rows();
-    std::mt19937 rng{m_seed};
+    // Each thread shuffles its own copy of x. The copies are created by their threads.
+    std::vector<std::optional<DataFrame>> shuffled_dfs(util::effective_num_threads(m_num_threads));
+    auto opencl = use_opencl(2);
 
-    int count_greater = 0;
-    for (int i = 0; i < m_samples; ++i) {
+    return run_permutations(value, [&](std::mt19937& rng, int thread_index) {
+        auto& shuffled_df = shuffled_dfs[thread_index];
+        if (!shuffled_df) shuffled_df = m_ranked_df.loc(Copy(x), y);
+
+        auto x_begin = shuffled_df->template mutable_data<arrow::FloatType>(0);
+        auto x_end = x_begin + (*shuffled_df)->num_rows();
+
+        // x is restored, so each permutation only depends on its rng.
+        std::copy(original_rank_x, original_rank_x + (*shuffled_df)->num_rows(), x_begin);
         std::shuffle(x_begin, x_end, rng);
-        auto shuffled_value = mi_pair(shuffled_df, m_k);
+        return mi_pair(*shuffled_df, m_k, m_knn_eps, m_num_threads, opencl);
+    });
+}
+
+MatrixXi KMutualInformation::z_neighbors(const DataFrame& z_df) const {
+    KDTree z_tree(z_df, 16, m_num_threads);
+    return z_tree
+        .query_batch(z_df, m_shuffle_neighbors, std::numeric_limits<double>::infinity(), m_knn_eps, m_num_threads)
+        .second;
+}
 
-        if (shuffled_value >= value) ++count_greater;
+std::shared_ptr<const KMutualInformation::ConditioningData> KMutualInformation::conditioning_data(
+    const std::vector<std::string>& z) const {
+    {
+        std::lock_guard<std::mutex> lock(m_conditioning_mutex);
+        auto it = m_conditioning.find(z);
+        if (it != m_conditioning.end()) return it->second;
     }
 
-    return static_cast<double>(count_greater) / m_samples;
+    auto data = std::make_shared<ConditioningData>();
+    data->neighbors = z_neighbors(m_df.loc(z));
+
+    if (z.size() == 1) {
+        auto raw_z = m_ranked_df.template data<arrow::FloatType>(z[0]);
+
+        IndexComparator comp_z(raw_z);
+        data->sort_z.resize(m_df->num_rows());
+        std::iota(data->sort_z.begin(), data->sort_z.end(), 0);
+        std::sort(data->sort_z.begin(), data->sort_z.end(), comp_z);
+    } else if (!use_opencl(2 + z.size())) {
+        data->ztree = std::make_shared<KDTree>(m_ranked_df.loc(z), 16, m_num_threads);
+    }
+
+    data->memory = util::eigen_bytes(data->neighbors) + util::vector_bytes(data->sort_z) +
+                   (data->ztree ? data->ztree->memory_bytes() : 0);
+
+    std::lock_guard<std::mutex> lock(m_conditioning_mutex);
+    auto it = m_conditioning.find(z);
+    if (it != m_conditioning.end()) return it->second;
+    if (data->memory > m_max_conditioning_memory) return data;
+
+    evict_conditioning_unlocked(data->memory, max_cached_conditioning_sets - 1);
+    m_conditioning_memory += data->memory;
+    m_conditioning_order.push_back(z);
+    m_conditioning.emplace(z, data);
+    return data;
 }
 
-double KMutualInformation::pvalue(const std::string& x, const std::string& y, const std::string& z) const {
-    auto original_mi = mi(x, y, z);
-    auto z_df = m_df.loc(z);
-    auto shuffled_df = m_ranked_df.loc(Copy(x), y, z);
-    auto original_rank_x = m_ranked_df.template data<arrow::FloatType>(x);
+void KMutualInformation::evict_conditioning_unlocked(std::size_t memory, std::size_t max_sets) const {
+    while (!m_conditioning_order.empty() &&
+           (m_conditioning_order.size() > max_sets || m_conditioning_memory + memory > m_max_conditioning_memory)) {
+        auto it = m_conditioning.find(m_conditioning_order.front());
+        m_conditioning_memory -= it->second->memory;
+        m_conditioning.erase(it);
+        m_conditioning_order.pop_front();
+    }
+}
 
-    return shuffled_pvalue(original_mi, original_rank_x, z_df, shuffled_df, MITriple{});
+PermutationTestResult KMutualInformation::permutation_test_impl(const std::string& x,
+                                                                const std::string& y,
+                                                                const std::vector<std::string>& z,
+                                                                const ConditioningData& data) const {
+    if (z.size() == 1) {
+        MITriple mi_calculator{data.sort_z, m_knn_eps, m_num_threads, use_opencl(3)};
+        auto original_mi = mi_calculator(m_ranked_df.loc(x, y, z), m_k);
+        return shuffled_test(original_mi, x, y, z, data.neighbors, mi_calculator);
+    } else {
+        MIGeneral mi_calculator{data.ztree.get(), m_knn_eps, m_num_threads, use_opencl(2 + z.size())};
+        auto original_mi = mi_calculator(m_ranked_df.loc(x, y, z), m_k);
+        return shuffled_test(original_mi, x, y, z, data.neighbors, mi_calculator);
+    }
+}
+
+double KMutualInformation::pvalue(const std::string& x, const std::string& y, const std::string& z) const {
+    return permutation_test(x, y, z).pvalue;
 }
 
 double KMutualInformation::pvalue(const std::string& x, const std::string& y, const std::vector<std::string>& z) const {
-    auto original_mi = mi(x, y, z);
-    auto z_df = m_df.loc(z);
-    auto shuffled_df = m_ranked_df.loc(Copy(x), y, z);
-    auto original_rank_x = m_ranked_df.template data<arrow::FloatType>(x);
+    return permutation_test(x, y, z).pvalue;
+}
+
+PermutationTestResult KMutualInformation::permutation_test(const std::string& x,
+                                                           const std::string& y,
+                                                           const std::string& z) const {
+    std::vector<std::string> z_vec{z};
+    return permutation_test_impl(x, y, z_vec, *conditioning_data(z_vec));
+}
+
+PermutationTestResult KMutualInformation::permutation_test(const std::string& x,
+                                                           const std::string& y,
+                                                           const std::vector<std::string>& z) const {
+    if (z.empty()) return permutation_test(x, y);
+    return permutation_test_impl(x, y, z, *conditioning_data(z));
+}
 
-    return shuffled_pvalue(original_mi, original_rank_x, z_df, shuffled_df, MIGeneral{});
+std::vector<double> KMutualInformation::pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                               const std::vector<std::string>& z) const {
+    if (z.empty()) return IndependenceTest::pvalues(pairs, z);
+
+    auto data = conditioning_data(z);
+
+    std::vector<double> res;
+    res.reserve(pairs.size());
+    for (const auto& [x, y] : pairs) {
+        res.push_back(permutation_test_impl(x, y, z, *data).pvalue);
+    }
+
+    return res;
 }
 
 }  // namespace learning::independences::continuous
\ No newline at end of file
@@ -1,101 +1,192 @@
 #ifndef PYBNESIAN_LEARNING_INDEPENDENCES_CONTINUOUS_MUTUAL_INFORMATION_HPP
 #define PYBNESIAN_LEARNING_INDEPENDENCES_CONTINUOUS_MUTUAL_INFORMATION_HPP
 
+#include <deque>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <dataset/dataset.hpp>
+#include <kde/KDE.hpp>
 #include <learning/independences/independence.hpp>
 #include <kdtree/kdtree.hpp>
+#include <util/hash_utils.hpp>
+#include <util/parallel.hpp>
+#include <boost/math/distributions/binomial.hpp>
 
 using dataset::DataFrame, dataset::Copy;
 using Eigen::MatrixXi;
 using Array_ptr = std::shared_ptr<arrow::Array>;
 using kdtree::KDTree, kdtree::IndexComparator;
+using kde::KDEBackend;
 
 namespace learning::independences::continuous {
 
-template <typename OutputArrowType, typename InputArrowType>
-DataFrame rank_data(const DataFrame& df) {
-    using OutputCType = typename OutputArrowType::c_type;
-    arrow::NumericBuilder<OutputArrowType> builder;
-
-    std::vector<Array_ptr> columns;
-    arrow::SchemaBuilder b(arrow::SchemaBuilder::ConflictPolicy::CONFLICT_ERROR);
-
-    std::vector<size_t> indices(df->num_rows());
-    std::iota(indices.begin(), indices.end(), 0);
-
-    std::vector<OutputCType> ranked_data(df->num_rows());
-
-    for (int j = 0; j < df->num_columns(); ++j) {
-        auto dwn = df.downcast<InputArrowType>(j);
-        auto raw_values = dwn->raw_values();
-
-        IndexComparator comp(raw_values);
-        std::sort(indices.begin(), indices.end(), comp);
-
-        for (int i = 0; i < df->num_rows(); ++i) {
-            ranked_data[indices[i]] = static_cast<OutputCType>(i);
-        }
-
-        RAISE_STATUS_ERROR(builder.AppendValues(ranked_data.begin(), ranked_data.end()));
-        Array_ptr out;
-        RAISE_STATUS_ERROR(builder.Finish(&out));
-        columns.push_back(out);
-        builder.Reset();
-
-        auto f = arrow::field(df.name(j), out->type());
-        RAISE_STATUS_ERROR(b.AddField(f));
-    }
-    RAISE_RESULT_ERROR(auto schema, b.Finish())
-
-    auto rb = arrow::RecordBatch::Make(schema, df->num_rows(), columns);
-    return DataFrame(rb);
-}
-
-template <typename OutputArrowType>
-DataFrame rank_data(const DataFrame& df) {
+// Returns the ranks of df as "float" data. The ranks are cached in dataset::DerivedColumnCache, so the tests created
+// with the same data rank it once.
+inline DataFrame rank_data(const DataFrame& df, int num_threads = 1) {
     switch (df.same_type()->id()) {
         case Type::DOUBLE:
-            return rank_data<OutputArrowType, arrow::DoubleType>(df);
         case Type::FLOAT:
-            return rank_data<OutputArrowType, arrow::FloatType>(df);
+            return df.ranked(num_threads);
         default:
             throw std::invalid_argument("Wrong data type in KMutualInformation.");
     }
 }
 
+// Returns the Chebyshev distance of each row of df to its k-th nearest row (excluding the row itself), computed by
+// brute force with the OpenCL device. The rows are compared in tiles loaded in the local memory of the device. The
+// columns of df must be "float" data.
+VectorXd bruteforce_knn_distances(const DataFrame& df, int k);
+// Returns the counts of KDTree::count_ball_subspaces() of each row of df, with the first and second columns of df as x
+// and y, and the rest of columns as z. The counts are computed by brute force with the OpenCL device. The columns of df
+// must be "float" data.
 std::tuple<VectorXi, VectorXi, VectorXi> bruteforce_eps_neighbors(const DataFrame& df, const VectorXd& eps);
 
-double mi_pair(const DataFrame& df, int k);
-double mi_triple(const DataFrame& df, int k);
-double mi_general(const DataFrame& df, int k);
+// The k-nn searches are (1 + eps)-approximate if eps > 0, and they are run with num_threads threads. See
+// KDTree::query_batch(). If opencl is true, the k-nn searches (and the ball counts of mi_general()) are computed with
+// bruteforce_knn_distances() and bruteforce_eps_neighbors(), which are always exact.
+double mi_pair(const DataFrame& df, int k, double eps = 0, int num_threads = 1, bool opencl = false);
+double mi_triple(const DataFrame& df, int k, double eps = 0, int num_threads = 1, bool opencl = false);
+// mi_triple() with the indices of the rows of df sorted by the third column.
+double mi_triple(const DataFrame& df,
+                 int k,
+                 const std::vector<size_t>& sort_z,
+                 double eps = 0,
+                 int num_threads = 1,
+                 bool opencl = false);
+double mi_general(const DataFrame& df, int k, double eps = 0, int num_threads = 1, bool opencl = false);
+// mi_general() with a KDTree of the columns of df from the third column.
+double mi_general(const DataFrame& df, int k, const KDTree& ztree, double eps = 0, int num_threads = 1);
+
+// The result of a permutation test of KMutualInformation.
+struct PermutationTestResult {
+    // Proportion of the evaluated permutations whose statistic is greater or equal than the original statistic.
+    double pvalue;
+    // Number of evaluated permutations. It is lower than the number of samples if the permutations stopped early.
+    int permutations;
+    // Clopper-Pearson confidence interval of the p-value, computed with the evaluated permutations. With early
+    // stopping, its confidence is the one of the checks of the stopping rule, so it does not contain alpha if the
+    // permutations stopped early.
+    double lower_bound;
+    double upper_bound;
+    double confidence;
+};
 
 class KMutualInformation : public IndependenceTest {
 public:
-    KMutualInformation(
-        DataFrame df, int k, unsigned int seed = std::random_device{}(), int shuffle_neighbors = 5, int samples = 1000)
-        : m_df(df),
-          m_ranked_df(rank_data<arrow::FloatType>(df)),
+    // Maximum number of cached conditioning sets.
+    static constexpr std::size_t max_cached_conditioning_sets = 64;
+    // Number of permutations evaluated between two checks of the early stopping.
+    static constexpr int early_stopping_block = 32;
+    // With KDEBackend::OPENCL, the tests of DataFrames with at least opencl_min_rows rows, or with at least
+    // opencl_min_dimensions variables (x, y and z), compute the k-nn searches and the ball counts by brute force with
+    // the OpenCL device. The KDTrees are faster for the rest of tests.
+    static constexpr int64_t opencl_min_rows = 1 << 15;
+    static constexpr int opencl_min_dimensions = 5;
+
+    // If alpha is given, the permutations stop as soon as the p-value is above or below alpha with the given
+    // confidence. The permutations (or the k-nn searches of a single permutation) are evaluated with num_threads
+    // threads. If knn_eps > 0, the k-nn searches are (1 + knn_eps)-approximate.
+    //
+    // If subsample is greater than 0 and df has more rows, the tests use a uniform random sample (drawn with seed) of
+    // subsample rows of df. The sample is the same for all the tests, so their results are consistent.
+    //
+    // The backend selects the device of the brute force k-nn searches (see opencl_min_rows). With KDEBackend::AUTO,
+    // the OpenCL device is used if it is a GPU.
+    KMutualInformation(DataFrame df,
+                       int k,
+                       unsigned int seed = std::random_device{}(),
+                       int shuffle_neighbors = 5,
+                       int samples = 1000,
+                       std::optional<double> alpha = std::nullopt,
+                       double confidence = 0.99,
+                       int num_threads = 1,
+                       double knn_eps = 0,
+                       int64_t subsample = 0,
+                       KDEBackend backend = KDEBackend::CPU)
+        : m_df(subsample > 0 ? df.sample_rows(subsample, seed) : df),
+          m_ranked_df(rank_data(m_df, num_threads)),
           m_k(k),
           m_seed(seed),
           m_shuffle_neighbors(shuffle_neighbors),
-          m_samples(samples) {}
+          m_samples(samples),
+          m_alpha(alpha),
+          m_confidence(confidence),
+          m_num_threads(num_threads),
+          m_knn_eps(knn_eps),
+          m_conditioning_mutex(),
+          m_conditioning(),
+          m_conditioning_order(),
+          m_conditioning_memory(0),
+          m_max_conditioning_memory(util::unlimited_memory),
+          m_subsample(subsample),
+          m_backend(kde::resolve_backend(backend)) {
+        if (m_subsample < 0) {
+            throw std::invalid_argument("subsample must be a non-negative number.");
+        }
+
+        if (m_alpha && (*m_alpha <= 0 || *m_alpha >= 1)) {
+            throw std::invalid_argument("alpha must be a number in (0, 1).");
+        }
+
+        if (m_confidence <= 0 || m_confidence >= 1) {
+            throw std::invalid_argument("confidence must be a number in (0, 1).");
+        }
+
+        if (m_knn_eps < 0) {
+            throw std::invalid_argument("knn_eps must be a non-negative number.");
+        }
+
+        // Throws if num_threads is not valid.
+        util::effective_num_threads(m_num_threads);
+    }
 
     double pvalue(const std::string& x, const std::string& y) const override;
     double pvalue(const std::string& x, const std::string& y, const std::string& z) const override;
     double pvalue(const std::string& x, const std::string& y, const std::vector<std::string>& z) const override;
 
+    using IndependenceTest::pvalues;
+    std::vector<double> pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                const std::vector<std::string>& z) const override;
+
+    // The permutation tests of pvalue(), with the number of evaluated permutations and the confidence interval of the
+    // p-value.
+    PermutationTestResult permutation_test(const std::string& x, const std::string& y) const;
+    PermutationTestResult permutation_test(const std::string& x, const std::string& y, const std::string& z) const;
+    PermutationTestResult permutation_test(const std::string& x,
+                                           const std::string& y,
+                                           const std::vector<std::string>& z) const;
+
+    // Returns the shuffle_neighbors nearest neighbors of each row of z_df, used in the conditional permutations.
+    MatrixXi z_neighbors(const DataFrame& z_df) const;
+
+    // Returns the conditional permutation test of x and y given z, where the shuffled x is taken from the neighbors of
+    // z.
     template <typename MICalculator>
-    double shuffled_pvalue(double original_mi,
-                           const float* original_rank_x,
-                           const DataFrame& z_df,
-                           DataFrame& shuffled_df,
-                           const MICalculator mi_calculator) const;
+    PermutationTestResult shuffled_test(double original_mi,
+                                        const std::string& x,
+                                        const std::string& y,
+                                        const std::vector<std::string>& z,
+                                        const MatrixXi& neighbors,
+                                        const MICalculator& mi_calculator) const;
+
+    // Returns the permutation test of original_mi, whose p-value is the proportion of the permutation statistics
+    // greater or equal than original_mi. shuffled_mi(rng, thread_index) returns the statistic of a permutation drawn
+    // with rng. Each permutation i uses its own random generator, seeded with the seed of the test and i, so the result
+    // does not depend on the number of threads.
+    template <typename ShuffledMI>
+    PermutationTestResult run_permutations(double original_mi, ShuffledMI&& shuffled_mi) const;
 
     double mi(const std::string& x, const std::string& y) const;
     double mi(const std::string& x, const std::string& y, const std::string& z) const;
     double mi(const std::string& x, const std::string& y, const std::vector<std::string>& z) const;
 
+    int64_t subsample() const { return m_subsample; }
+
+    KDEBackend backend() const { return m_backend; }
+
+    std::string ToString() const override { return "KMutualInformation"; }
+
     int num_variables() const override { return m_df->num_columns(); }
 
     std::vector<std::string> variable_names() const override { return m_df.column_names(); }
@@ -106,13 +197,79 @@ public:
 
     bool has_variables(const std::vector<std::string>& cols) const override { return m_df.has_columns(cols); }
 
+    // The memory of the cached neighbors, sorted indices and KDTrees of the conditioning sets. The limit is applied to
+    // the cached conditioning sets.
+    util::MemoryUsage memory_usage() const override {
+        util::MemoryUsage usage;
+        std::lock_guard<std::mutex> lock(m_conditioning_mutex);
+        usage.add("conditioning_cache", m_conditioning_memory);
+        return usage;
+    }
+
+    void set_max_cache_memory(std::size_t max_memory) override {
+        std::lock_guard<std::mutex> lock(m_conditioning_mutex);
+        m_max_conditioning_memory = max_memory;
+        evict_conditioning_unlocked(0, max_cached_conditioning_sets);
+    }
+
 private:
+    // Returns true if the tests with the given number of variables use the brute force k-nn searches of the OpenCL
+    // device.
+    bool use_opencl(int dimensions) const {
+        return m_backend == KDEBackend::OPENCL &&
+               (m_df->num_rows() >= opencl_min_rows || dimensions >= opencl_min_dimensions);
+    }
+
+    // The data of a conditional test that only depends on the conditioning set z: the neighbors of the conditional
+    // permutations, and the rows sorted by z (one variable) or the KDTree of the ranked z (more variables, if the
+    // tests do not use the OpenCL device). It is shared by all the permutations and all the pairs (x, y) tested with
+    // z.
+    struct ConditioningData {
+        MatrixXi neighbors;
+        std::vector<size_t> sort_z;
+        std::shared_ptr<KDTree> ztree;
+        std::size_t memory = 0;
+    };
+
+    class HashConditioningSet {
+    public:
+        inline std::size_t operator()(const std::vector<std::string>& z) const {
+            size_t seed = z.size();
+            for (const auto& v : z) {
+                util::hash_combine(seed, v);
+            }
+            return seed;
+        }
+    };
+
+    // Returns the ConditioningData of z. The last max_cached_conditioning_sets conditioning sets are cached.
+    std::shared_ptr<const ConditioningData> conditioning_data(const std::vector<std::string>& z) const;
+    // Removes the oldest conditioning sets until there are at most max_sets sets and a set of memory bytes fits in the
+    // limit.
+    void evict_conditioning_unlocked(std::size_t memory, std::size_t max_sets) const;
+    PermutationTestResult permutation_test_impl(const std::string& x,
+                                                const std::string& y,
+                                                const std::vector<std::string>& z,
+                                                const ConditioningData& data) const;
+
     DataFrame m_df;
     DataFrame m_ranked_df;
     int m_k;
     unsigned int m_seed;
     int m_shuffle_neighbors;
     int m_samples;
+    std::optional<double> m_alpha;
+    double m_confidence;
+    int m_num_threads;
+    double m_knn_eps;
+    mutable std::mutex m_conditioning_mutex;
+    mutable std::unordered_map<std::vector<std::string>, std::shared_ptr<const ConditioningData>, HashConditioningSet>
+        m_conditioning;
+    mutable std::deque<std::vector<std::string>> m_conditioning_order;
+    mutable std::size_t m_conditioning_memory;
+    std::size_t m_max_conditioning_memory;
+    int64_t m_subsample;
+    KDEBackend m_backend;
 };
 
 template <typename CType, typename Random>
@@ -159,53 +316,103 @@ void shuffle_dataframe(const CType* original_x,
 }
 
 struct MITriple {
-    inline double operator()(const DataFrame& df, int k) const { return mi_triple(df, k); }
+    const std::vector<size_t>& sort_z;
+    double eps;
+    int num_threads;
+    bool opencl;
+    inline double operator()(const DataFrame& df, int k) const {
+        return mi_triple(df, k, sort_z, eps, num_threads, opencl);
+    }
 };
 
+// The ztree is only used if opencl is false.
 struct MIGeneral {
-    inline double operator()(const DataFrame& df, int k) const { return mi_general(df, k); }
-};
-
-template <typename MICalculator>
-double KMutualInformation::shuffled_pvalue(double original_mi,
-                                           const float* original_rank_x,
-                                           const DataFrame& z_df,
-                                           DataFrame& shuffled_df,
-                                           const MICalculator mi_calculator) const {
-    std::mt19937 rng{m_seed};
-    MatrixXi neighbors(m_shuffle_neighbors, m_df->num_rows());
-
-    KDTree z_tree(z_df);
-    auto zknn = z_tree.query(z_df, m_shuffle_neighbors, std::numeric_limits<double>::infinity());
-
-    for (size_t i = 0; i < zknn.size(); ++i) {
-        auto indices = zknn[i].second;
-        for (int k = 0; k < m_shuffle_neighbors; ++k) {
-            neighbors(k, i) = indices[k];
-        }
+    const KDTree* ztree;
+    double eps;
+    int num_threads;
+    bool opencl;
+    inline double operator()(const DataFrame& df, int k) const {
+        return opencl ? mi_general(df, k, eps, num_threads, true) : mi_general(df, k, *ztree, eps, num_threads);
     }
+};
 
-    std::vector<size_t> order(m_df->num_rows());
-    std::iota(order.begin(), order.end(), 0);
-
-    std::vector<bool> used(m_df->num_rows());
+template <typename ShuffledMI>
+PermutationTestResult KMutualInformation::run_permutations(double original_mi, ShuffledMI&& shuffled_mi) const {
+    // With early stopping, the permutations are evaluated in blocks and the stopping rule is only checked between
+    // blocks, so the result does not depend on the number of threads.
+    int block = m_alpha ? early_stopping_block : m_samples;
+    int num_checks = (m_samples + block - 1) / block;
+    // The error probability is split among all the checks, so the stopped p-value is on the correct side of alpha
+    // with probability m_confidence.
+    double check_error = (1 - m_confidence) / num_checks;
 
-    auto shuffled_x = shuffled_df.template mutable_data<arrow::FloatType>(0);
+    using boost::math::binomial_distribution;
 
+    std::vector<char> greater(block);
     int count_greater = 0;
+    int done = 0;
+    double upper = 1;
+    double lower = 0;
+    while (done < m_samples) {
+        int end = std::min(done + block, m_samples);
+
+        util::parallel_for(done, end, m_num_threads, [&](int i, int thread_index) {
+            std::seed_seq seq{m_seed, static_cast<unsigned int>(i)};
+            std::mt19937 rng{seq};
+            greater[i - done] = shuffled_mi(rng, thread_index) >= original_mi;
+        });
+
+        count_greater += std::count(greater.begin(), greater.begin() + (end - done), 1);
+        done = end;
+
+        upper = binomial_distribution<>::find_upper_bound_on_p(done, count_greater, check_error);
+        lower = binomial_distribution<>::find_lower_bound_on_p(done, count_greater, check_error);
+        if (m_alpha && done < m_samples && (upper < *m_alpha || lower > *m_alpha)) break;
+    }
+
+    return PermutationTestResult{static_cast<double>(count_greater) / done, done, lower, upper, 1 - 2 * check_error};
+}
 
-    for (int i = 0; i < m_samples; ++i) {
-        std::shuffle(order.begin(), order.end(), rng);
-        shuffle_dataframe(original_rank_x, shuffled_x, order, used, neighbors, rng);
+template <typename MICalculator>
+PermutationTestResult KMutualInformation::shuffled_test(double original_mi,
+                                                        const std::string& x,
+                                                        const std::string& y,
+                                                        const std::vector<std::string>& z,
+                                                        const MatrixXi& neighbors,
+                                                        const MICalculator& mi_calculator) const {
+    struct Workspace {
+        DataFrame shuffled_df;
+        MatrixXi neighbors;
+        std::vector<size_t> order;
+        std::vector<bool> used;
+    };
+
+    auto original_rank_x = m_ranked_df.template data<arrow::FloatType>(x);
+
+    // Each thread shuffles its own copy of x. The workspaces are created by their threads.
+    std::vector<std::optional<Workspace>> workspaces(util::effective_num_threads(m_num_threads));
+
+    return run_permutations(original_mi, [&](std::mt19937& rng, int thread_index) {
+        auto& ws = workspaces[thread_index];
+        if (!ws) {
+            ws.emplace(Workspace{m_ranked_df.loc(Copy(x), y, z),
+                                 neighbors,
+                                 std::vector<size_t>(m_df->num_rows()),
+                                 std::vector<bool>(m_df->num_rows())});
+        }
 
-        auto shuffled_value = mi_calculator(shuffled_df, m_k);
+        // The state of the previous permutation is reset, so each permutation only depends on its rng.
+        ws->neighbors = neighbors;
+        std::iota(ws->order.begin(), ws->order.end(), 0);
+        std::fill(ws->used.begin(), ws->used.end(), false);
 
-        if (shuffled_value >= original_mi) ++count_greater;
+        auto shuffled_x = ws->shuffled_df.template mutable_data<arrow::FloatType>(0);
 
-        std::fill(used.begin(), used.end(), false);
-    }
+        std::shuffle(ws->order.begin(), ws->order.end(), rng);
+        shuffle_dataframe(original_rank_x, shuffled_x, ws->order, ws->used, ws->neighbors, rng);
 
-    return static_cast<double>(count_greater) / m_samples;
+        return mi_calculator(ws->shuffled_df, m_k);
+    });
 }
 
 using DynamicKMutualInformation = DynamicIndependenceTestAdaptator<KMutualInformation>;
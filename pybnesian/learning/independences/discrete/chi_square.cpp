@@ -1,140 +1,214 @@
 #include <learning/independences/discrete/chi_square.hpp>
 #include <factors/discrete/discrete_indices.hpp>
 #include <util/math_constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <boost/math/distributions/chi_squared.hpp>
 
 namespace learning::independences::discrete {
 
-double ChiSquare::pvalue(const std::string& v1, const std::string& v2) const {
-    std::vector<std::string> dummy_v2{v2};
-    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, v1, dummy_v2);
-    auto joint_counts = factors::discrete::joint_counts(m_df, v1, dummy_v2, cardinality, strides);
+namespace {
 
-    auto v1_marg = factors::discrete::marginal_counts(joint_counts, 0, cardinality, strides);
-    auto v2_marg = factors::discrete::marginal_counts(joint_counts, 1, cardinality, strides);
+// The statistic and the degrees of freedom of the test from the joint counts of (v1, v2, ev...), where each evidence
+// configuration is a contiguous table of cardinality(0) x cardinality(1) counts. The marginals of each table and the
+// statistic are computed in two passes over the table, with the marginal buffers allocated once for all the tables.
+std::pair<double, double> table_statistic(const VectorXi& joint_counts,
+                                          const VectorXi& cardinality,
+                                          bool g_test,
+                                          bool adjusted_df) {
+    auto rows = cardinality(0);
+    auto cols = cardinality(1);
+    auto vars_configurations = rows * cols;
+    auto evidence_configurations = joint_counts.rows() / vars_configurations;
 
-    auto inv_obs = 1. / joint_counts.sum();
+    VectorXi marginal_v1(rows);
+    VectorXi marginal_v2(cols);
 
     double statistic = 0;
-    for (int i = 0; i < cardinality(0); ++i) {
-        for (int j = 0; j < cardinality(1); ++j) {
-            auto expected = static_cast<double>(v1_marg(i) * v2_marg(j)) * inv_obs;
+    double df = 0;
 
-            if (expected != 0) {
-                auto index = i + j * strides(1);
+    for (auto k = 0; k < evidence_configurations; ++k) {
+        auto table = joint_counts.data() + k * vars_configurations;
 
-                auto d = joint_counts(index) - expected;
-                statistic += d * d / expected;
+        marginal_v1.setZero();
+        marginal_v2.setZero();
+        int total_sum = 0;
+        for (auto j = 0; j < cols; ++j) {
+            for (auto i = 0; i < rows; ++i) {
+                auto c = table[i + j * rows];
+                marginal_v1(i) += c;
+                marginal_v2(j) += c;
+                total_sum += c;
             }
         }
-    }
-
-    auto df = (cardinality(0) - 1) * (cardinality(1) - 1);
-
-    boost::math::chi_squared_distribution chidist(static_cast<double>(df));
-    return cdf(complement(chidist, statistic));
-}
-
-double ChiSquare::pvalue(const std::string& v1, const std::string& v2, const std::string& ev) const {
-    std::vector<std::string> dummy_vars{v2, ev};
-    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, v1, dummy_vars);
-    auto joint_counts = factors::discrete::joint_counts(m_df, v1, dummy_vars, cardinality, strides);
-
-    auto evidence_marg = factors::discrete::marginal_counts(joint_counts, 2, cardinality, strides);
-
-    auto evidence_configurations = cardinality(2);
-    auto vars_configurations = strides(2);
-
-    double statistic = 0;
-
-    for (auto k = 0; k < evidence_configurations; ++k) {
-        if (evidence_marg(k) == 0) continue;
 
-        auto offset = k * vars_configurations;
-        auto evidence_segment = joint_counts.segment(offset, vars_configurations);
-
-        auto v1_marg = factors::discrete::marginal_counts(evidence_segment, 0, cardinality, strides);
-        auto v2_marg = factors::discrete::marginal_counts(evidence_segment, 1, cardinality, strides);
+        if (total_sum == 0) continue;
 
-        auto inv_obs = 1. / evidence_marg(k);
+        auto inv_obs = 1. / static_cast<double>(total_sum);
 
-        for (int i = 0; i < cardinality(0); ++i) {
-            for (int j = 0; j < cardinality(1); ++j) {
-                auto expected = static_cast<double>(v1_marg(i) * v2_marg(j)) * inv_obs;
+        for (auto j = 0; j < cols; ++j) {
+            if (marginal_v2(j) == 0) continue;
 
-                if (expected != 0) {
-                    auto index = offset + i + j * strides(1);
+            for (auto i = 0; i < rows; ++i) {
+                auto expected = static_cast<double>(marginal_v1(i)) * static_cast<double>(marginal_v2(j)) * inv_obs;
+                if (expected == 0) continue;
 
-                    auto d = joint_counts(index) - expected;
+                auto c = table[i + j * rows];
+                if (g_test) {
+                    if (c > 0) statistic += 2 * c * std::log(c / expected);
+                } else {
+                    auto d = c - expected;
                     statistic += d * d / expected;
                 }
             }
         }
+
+        if (adjusted_df) {
+            auto nonzero_rows = (marginal_v1.array() > 0).count();
+            auto nonzero_cols = (marginal_v2.array() > 0).count();
+            df += (nonzero_rows - 1) * (nonzero_cols - 1);
+        }
     }
 
-    auto df = (cardinality(0) - 1) * (cardinality(1) - 1) * cardinality(2);
+    if (!adjusted_df) df = static_cast<double>((rows - 1) * (cols - 1)) * evidence_configurations;
 
-    boost::math::chi_squared_distribution chidist(static_cast<double>(df));
-    return cdf(complement(chidist, statistic));
+    return std::make_pair(statistic, df);
 }
 
-double ChiSquare::pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const {
+std::vector<std::string> evidence_variables(const std::string& v2, const std::vector<std::string>& ev) {
     std::vector<std::string> dummy_vars{v2};
     dummy_vars.reserve(ev.size() + 1);
     dummy_vars.insert(dummy_vars.end(), ev.begin(), ev.end());
+    return dummy_vars;
+}
 
-    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, v1, dummy_vars);
-    auto joint_counts = factors::discrete::joint_counts(m_df, v1, dummy_vars, cardinality, strides);
+}  // namespace
 
-    auto evidence_configurations = cardinality.tail(ev.size()).prod();
-    auto vars_configurations = cardinality(0) * cardinality(1);
+double ChiSquare::pvalue_from_counts(const VectorXi& joint_counts, const VectorXi& cardinality) const {
+    auto [statistic, df] = table_statistic(joint_counts, cardinality, m_g_test, m_adjusted_df);
 
-    double statistic = 0;
+    // Avoids error: OverflowError: Error in function boost::math::tgamma<long double>(long double): Result of tgamma is
+    // too large to represent. of Boost, when statistic is very close to 0. With adjusted_df, all the tables can have a
+    // single non-empty row or column, so there is no evidence against the independence.
+    if (statistic < util::machine_tol || df <= 0) {
+        return 1;
+    }
 
-    for (auto k = 0; k < evidence_configurations; ++k) {
-        auto offset = k * vars_configurations;
+    boost::math::chi_squared_distribution chidist(df);
+    return cdf(complement(chidist, statistic));
+}
 
-        int total_sum = 0;
-        auto marginal_v1 = VectorXi::Zero(cardinality(0)).eval();
-        auto marginal_v2 = VectorXi::Zero(cardinality(1)).eval();
+double ChiSquare::permutation_pvalue(const std::string& v1, const std::vector<std::string>& vars) const {
+    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, v1, vars);
+    auto indices = factors::discrete::discrete_indices(m_df, v1, vars, strides);
 
-        for (auto i = 0; i < cardinality(0); ++i) {
-            for (auto j = 0; j < cardinality(1); ++j) {
-                auto c = joint_counts(offset + i + j * strides(1));
-                marginal_v1(i) += c;
-                marginal_v2(j) += c;
-                total_sum += c;
-            }
+    auto rows = cardinality(0);
+    auto vars_configurations = rows * cardinality(1);
+    auto evidence_configurations = cardinality.prod() / vars_configurations;
+
+    // Groups the instances by evidence configuration (counting sort), storing the category of v1 and the rest of the
+    // index of each instance. The permutations shuffle the categories of v1 within each group.
+    std::vector<int> group_begin(evidence_configurations + 1, 0);
+    for (auto r = 0; r < indices.rows(); ++r) {
+        ++group_begin[indices(r) / vars_configurations + 1];
+    }
+    std::partial_sum(group_begin.begin(), group_begin.end(), group_begin.begin());
+
+    std::vector<int> v1_values(indices.rows());
+    std::vector<int> base_index(indices.rows());
+    std::vector<int> next = group_begin;
+    for (auto r = 0; r < indices.rows(); ++r) {
+        auto position = next[indices(r) / vars_configurations]++;
+        v1_values[position] = indices(r) % rows;
+        base_index[position] = indices(r) - v1_values[position];
+    }
+
+    VectorXi joint_counts = VectorXi::Zero(cardinality.prod());
+    for (auto r = 0; r < indices.rows(); ++r) {
+        ++joint_counts(indices(r));
+    }
+
+    auto observed = table_statistic(joint_counts, cardinality, m_g_test, m_adjusted_df).first;
+
+    std::mt19937 rng{m_seed};
+    int extreme = 0;
+    for (auto b = 0; b < m_permutations; ++b) {
+        for (auto k = 0; k < evidence_configurations; ++k) {
+            std::shuffle(v1_values.begin() + group_begin[k], v1_values.begin() + group_begin[k + 1], rng);
         }
 
-        if (total_sum == 0) continue;
+        joint_counts.setZero();
+        for (size_t r = 0; r < v1_values.size(); ++r) {
+            ++joint_counts(base_index[r] + v1_values[r]);
+        }
 
-        auto inv_obs = 1. / static_cast<double>(total_sum);
+        auto statistic = table_statistic(joint_counts, cardinality, m_g_test, m_adjusted_df).first;
+        if (statistic >= observed - util::machine_tol) ++extreme;
+    }
 
-        for (auto i = 0; i < cardinality(0); ++i) {
-            for (auto j = 0; j < cardinality(1); ++j) {
-                auto expected = static_cast<double>(marginal_v1(i) * marginal_v2(j)) * inv_obs;
+    return static_cast<double>(1 + extreme) / static_cast<double>(1 + m_permutations);
+}
 
-                if (expected != 0) {
-                    auto c = joint_counts(offset + i + j * strides(1));
-                    auto d = c - expected;
+double ChiSquare::pvalue_impl(const std::string& v1, const std::vector<std::string>& vars) const {
+    if (m_permutations > 0) return permutation_pvalue(v1, vars);
 
-                    statistic += d * d / expected;
-                }
-            }
+    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, v1, vars);
+    auto joint_counts = m_index->joint_counts(v1, vars, cardinality, strides);
+    return pvalue_from_counts(joint_counts, cardinality);
+}
+
+double ChiSquare::pvalue(const std::string& v1, const std::string& v2) const {
+    return pvalue_impl(v1, std::vector<std::string>{v2});
+}
+
+double ChiSquare::pvalue(const std::string& v1, const std::string& v2, const std::string& ev) const {
+    return pvalue_impl(v1, std::vector<std::string>{v2, ev});
+}
+
+double ChiSquare::pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const {
+    return pvalue_impl(v1, evidence_variables(v2, ev));
+}
+
+std::vector<double> ChiSquare::pvalues(const std::string& v1,
+                                       const std::string& v2,
+                                       const std::vector<std::vector<std::string>>& evs) const {
+    std::vector<double> res(evs.size());
+
+    if (m_permutations > 0) {
+        for (size_t i = 0; i < evs.size(); ++i) {
+            res[i] = permutation_pvalue(v1, evidence_variables(v2, evs[i]));
         }
+
+        return res;
     }
 
-    // Avoids error: OverflowError: Error in function boost::math::tgamma<long double>(long double): Result of tgamma is
-    // too large to represent. of Boost, when statistic is very close to 0.
-    if (statistic < util::machine_tol) {
-        return 1;
+    // The small tables are counted with the bit-sliced index. The rest are counted together with batch_joint_counts(),
+    // so the columns of v1, v2 and the common evidence are read once.
+    std::vector<size_t> batch;
+    std::vector<std::vector<std::string>> batch_vars;
+    for (size_t i = 0; i < evs.size(); ++i) {
+        auto dummy_vars = evidence_variables(v2, evs[i]);
+        auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, v1, dummy_vars);
+
+        if (factors::discrete::BitSlicedIndex::is_efficient(cardinality)) {
+            auto joint_counts = m_index->joint_counts(v1, dummy_vars, cardinality, strides);
+            res[i] = pvalue_from_counts(joint_counts, cardinality);
+        } else {
+            batch.push_back(i);
+            batch_vars.push_back(std::move(dummy_vars));
+        }
     }
 
-    auto df = (cardinality(0) - 1) * (cardinality(1) - 1) * evidence_configurations;
+    if (!batch.empty()) {
+        auto counts = factors::discrete::batch_joint_counts(m_df, v1, batch_vars);
+        for (size_t k = 0; k < batch.size(); ++k) {
+            const auto& [cardinality, joint_counts] = counts[k];
+            res[batch[k]] = pvalue_from_counts(joint_counts, cardinality);
+        }
+    }
 
-    boost::math::chi_squared_distribution chidist(static_cast<double>(df));
-    return cdf(complement(chidist, statistic));
+    return res;
 }
 
 }  // namespace learning::independences::discrete
\ No newline at end of file
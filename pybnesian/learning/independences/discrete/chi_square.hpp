@@ -1,24 +1,54 @@
 #ifndef PYBNESIAN_LEARNING_INDEPENDENCES_DISCRETE_CHI_SQUARE_HPP
 #define PYBNESIAN_LEARNING_INDEPENDENCES_DISCRETE_CHI_SQUARE_HPP
 
+#include <random>
+#include <factors/discrete/bit_sliced_index.hpp>
 #include <learning/independences/independence.hpp>
 
 namespace learning::independences::discrete {
 
+// The Pearson's X^2 test (or the G-test if g_test) of the contingency tables of the evidence configurations. If
+// adjusted_df, the degrees of freedom only count the non-empty rows and columns of each table, so the sparse tables are
+// not tested with too many degrees of freedom. If permutations > 0, the p-value is the proportion of permutations
+// (of v1 within each evidence configuration) with a statistic greater than or equal to the observed one.
 class ChiSquare : public IndependenceTest {
 public:
-    ChiSquare(const DataFrame& df) : m_df(df) {
+    ChiSquare(const DataFrame& df,
+              bool g_test = false,
+              bool adjusted_df = false,
+              int permutations = 0,
+              unsigned int seed = std::random_device{}())
+        : m_df(df),
+          m_index(std::make_shared<factors::discrete::BitSlicedIndex>(df)),
+          m_g_test(g_test),
+          m_adjusted_df(adjusted_df),
+          m_permutations(permutations),
+          m_seed(seed) {
         auto discrete_indices = df.discrete_columns();
 
         if (discrete_indices.size() < 2) {
             throw std::invalid_argument("DataFrame does not contain enough categorical columns.");
         }
+
+        if (permutations < 0) throw std::invalid_argument("permutations must be a non-negative number.");
     }
 
     double pvalue(const std::string& v1, const std::string& v2) const override;
     double pvalue(const std::string& v1, const std::string& v2, const std::string& ev) const override;
     double pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const override;
 
+    using IndependenceTest::pvalues;
+    std::vector<double> pvalues(const std::string& v1,
+                                const std::string& v2,
+                                const std::vector<std::vector<std::string>>& evs) const override;
+    // The batches read the columns once, except with permutations, which test each set independently.
+    std::size_t native_batch_size() const override { return m_permutations > 0 ? 1 : unlimited_batch_size; }
+
+    bool g_test() const { return m_g_test; }
+    bool adjusted_df() const { return m_adjusted_df; }
+    int permutations() const { return m_permutations; }
+
+    std::string ToString() const override { return "ChiSquare"; }
     int num_variables() const override { return m_df->num_columns(); }
     std::vector<std::string> variable_names() const override { return m_df.column_names(); }
     const std::string& name(int i) const override { return m_df.name(i); }
@@ -26,7 +56,16 @@ public:
     bool has_variables(const std::vector<std::string>& cols) const override { return m_df.has_columns(cols); }
 
 private:
+    double pvalue_from_counts(const VectorXi& joint_counts, const VectorXi& cardinality) const;
+    double permutation_pvalue(const std::string& v1, const std::vector<std::string>& vars) const;
+    double pvalue_impl(const std::string& v1, const std::vector<std::string>& vars) const;
+
     const DataFrame m_df;
+    std::shared_ptr<factors::discrete::BitSlicedIndex> m_index;
+    bool m_g_test;
+    bool m_adjusted_df;
+    int m_permutations;
+    unsigned int m_seed;
 };
 
 using DynamicChiSquare = DynamicIndependenceTestAdaptator<ChiSquare>;
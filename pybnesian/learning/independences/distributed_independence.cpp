@@ -0,0 +1,70 @@
+#include <learning/independences/distributed_independence.hpp>
+#include <util/parallel.hpp>
+
+namespace learning::independences {
+
+std::vector<std::vector<double>> evaluate_independence_tests(const IndependenceTest& test,
+                                                             const std::vector<IndependenceTestRequest>& requests,
+                                                             int num_threads) {
+    std::vector<std::vector<double>> res(requests.size());
+
+    util::parallel_for(0, static_cast<int>(requests.size()), num_threads, [&](int i, int) {
+        const auto& request = requests[i];
+        res[i] = test.pvalues(request.x, request.y, request.evs);
+    });
+
+    return res;
+}
+
+DistributedIndependenceTest::DistributedIndependenceTest(std::shared_ptr<IndependenceTest> test,
+                                                         std::shared_ptr<IndependenceTransport> transport)
+    : m_test(std::move(test)), m_transport(std::move(transport)) {
+    if (!m_test) throw std::invalid_argument("The test of a DistributedIndependenceTest can not be null.");
+    if (!m_transport) throw std::invalid_argument("The transport of a DistributedIndependenceTest can not be null.");
+}
+
+std::vector<double> DistributedIndependenceTest::pvalues(const std::string& v1,
+                                                         const std::string& v2,
+                                                         const std::vector<std::vector<std::string>>& evs) const {
+    if (evs.empty()) return {};
+    return std::move(evaluate({IndependenceTestRequest{v1, v2, evs}})[0]);
+}
+
+std::vector<double> DistributedIndependenceTest::pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                                         const std::vector<std::string>& ev) const {
+    std::vector<IndependenceTestRequest> requests;
+    requests.reserve(pairs.size());
+    for (const auto& pair : pairs) {
+        requests.push_back(IndependenceTestRequest{pair.first, pair.second, {ev}});
+    }
+
+    if (requests.empty()) return {};
+    auto batch = evaluate(requests);
+
+    std::vector<double> res;
+    res.reserve(batch.size());
+    for (const auto& pvalues : batch) {
+        res.push_back(pvalues[0]);
+    }
+
+    return res;
+}
+
+std::vector<std::vector<double>> DistributedIndependenceTest::evaluate(
+    const std::vector<IndependenceTestRequest>& requests) const {
+    auto res = m_transport->evaluate(requests);
+
+    if (res.size() != requests.size())
+        throw std::runtime_error("The IndependenceTransport must return the p-values of " +
+                                 std::to_string(requests.size()) + " requests.");
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (res[i].size() != requests[i].evs.size())
+            throw std::runtime_error("The IndependenceTransport must return " + std::to_string(requests[i].evs.size()) +
+                                     " p-values for the request " + requests[i].x + " _|_ " + requests[i].y + ".");
+    }
+
+    return res;
+}
+
+}  // namespace learning::independences
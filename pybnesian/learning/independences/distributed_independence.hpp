@@ -0,0 +1,81 @@
+#ifndef PYBNESIAN_LEARNING_INDEPENDENCES_DISTRIBUTED_INDEPENDENCE_HPP
+#define PYBNESIAN_LEARNING_INDEPENDENCES_DISTRIBUTED_INDEPENDENCE_HPP
+
+#include <memory>
+#include <learning/independences/independence.hpp>
+
+namespace learning::independences {
+
+// A batch of tests x _|_ y | ev for each ev in evs.
+struct IndependenceTestRequest {
+    std::string x;
+    std::string y;
+    std::vector<std::vector<std::string>> evs;
+};
+
+// Sends batches of independence tests to a set of workers and gathers the p-values. The workers hold the same data and
+// run the batches with evaluate_independence_tests(), so the transport only sends the requests and the p-values (e.g.,
+// with MPI or a pool of processes).
+//
+// PC and MMPC call evaluate() concurrently from each of their threads (each thread processes a different set of edges
+// or target variables), so the number of threads of the algorithm is the number of batches run at the same time.
+class IndependenceTransport {
+public:
+    virtual ~IndependenceTransport() {}
+    virtual bool is_python_derived() const { return false; }
+    // Returns the p-values of each request, in the same order as the conditioning sets of the request.
+    virtual std::vector<std::vector<double>> evaluate(const std::vector<IndependenceTestRequest>& requests) const = 0;
+};
+
+// Runs the requests of an IndependenceTransport with test, using num_threads threads.
+std::vector<std::vector<double>> evaluate_independence_tests(const IndependenceTest& test,
+                                                             const std::vector<IndependenceTestRequest>& requests,
+                                                             int num_threads = 1);
+
+// An IndependenceTest that runs all the tests in the workers of an IndependenceTransport. The learning algorithms keep
+// the skeleton and the sepsets, and they only receive the p-values of the workers. The local test is only used for the
+// names of the variables.
+class DistributedIndependenceTest : public IndependenceTest {
+public:
+    DistributedIndependenceTest(std::shared_ptr<IndependenceTest> test,
+                                std::shared_ptr<IndependenceTransport> transport);
+
+    std::string ToString() const override { return "DistributedIndependenceTest(" + m_test->ToString() + ")"; }
+
+    double pvalue(const std::string& v1, const std::string& v2) const override { return pvalues(v1, v2, {{}})[0]; }
+    double pvalue(const std::string& v1, const std::string& v2, const std::string& ev) const override {
+        return pvalues(v1, v2, {{ev}})[0];
+    }
+    double pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const override {
+        return pvalues(v1, v2, {ev})[0];
+    }
+
+    std::vector<double> pvalues(const std::string& v1,
+                                const std::string& v2,
+                                const std::vector<std::vector<std::string>>& evs) const override;
+    std::vector<double> pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                const std::vector<std::string>& ev) const override;
+    using IndependenceTest::pvalues;
+    // A batch is sent to the workers in one request.
+    std::size_t native_batch_size() const override { return unlimited_batch_size; }
+
+    int num_variables() const override { return m_test->num_variables(); }
+    std::vector<std::string> variable_names() const override { return m_test->variable_names(); }
+    const std::string& name(int i) const override { return m_test->name(i); }
+    int index(const std::string& name) const override { return m_test->index(name); }
+    bool has_variables(const std::string& name) const override { return m_test->has_variables(name); }
+    bool has_variables(const std::vector<std::string>& cols) const override { return m_test->has_variables(cols); }
+
+    const std::shared_ptr<IndependenceTest>& test() const { return m_test; }
+    const std::shared_ptr<IndependenceTransport>& transport() const { return m_transport; }
+
+private:
+    std::vector<std::vector<double>> evaluate(const std::vector<IndependenceTestRequest>& requests) const;
+
+    std::shared_ptr<IndependenceTest> m_test;
+    std::shared_ptr<IndependenceTransport> m_transport;
+};
+
+}  // namespace learning::independences
+
+#endif  // PYBNESIAN_LEARNING_INDEPENDENCES_DISTRIBUTED_INDEPENDENCE_HPP
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <dataset/covariance_registry.hpp>
 #include <factors/continuous/LinearGaussianCPD.hpp>
 #include <factors/discrete/discrete_indices.hpp>
 #include <learning/independences/hybrid/mutual_information.hpp>
@@ -6,6 +7,7 @@
 #include <boost/math/distributions/chi_squared.hpp>
 #include <boost/math/distributions/normal.hpp>
 
+using dataset::CovarianceRegistry;
 using factors::continuous::LinearGaussianCPD;
 using learning::parameters::MLE;
 
@@ -923,11 +925,84 @@ double entropy_mvn(int dimensionality, double cov_det) {
     return 0.5 * d + 0.5 * d * std::log(2 * util::pi<double>) + 0.5 * std::log(cov_det);
 }
 
-double MutualInformation::mi_discrete(const std::string& x, const std::string& y) const {
-    std::vector<std::string> dummy_y{y};
-    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, x, dummy_y);
-    auto joint_counts = factors::discrete::joint_counts(m_df, x, dummy_y, cardinality, strides);
+// The entropy H(D, C) = H(D) + H(C | D), where C is Gaussian for each configuration of D. The mean and covariance of C
+// are estimated for each configuration of D. df must not contain nulls in D and C.
+double discrete_gaussian_entropy(const DataFrame& df,
+                                 const std::vector<std::string>& discrete,
+                                 const std::vector<std::string>& continuous) {
+    auto num_rows = df->num_rows();
+    auto N = static_cast<double>(num_rows);
+
+    int num_configurations = 1;
+    VectorXi indices;
+    if (discrete.empty()) {
+        indices = VectorXi::Zero(num_rows);
+    } else {
+        auto [cardinality, strides] = factors::discrete::create_cardinality_strides(df, discrete);
+        indices = factors::discrete::discrete_indices(df, discrete, strides);
+        num_configurations = strides(discrete.size() - 1) * cardinality(discrete.size() - 1);
+    }
+
+    int num_continuous = continuous.size();
+    MatrixXd data(num_rows, num_continuous);
+    for (int j = 0; j < num_continuous; ++j) {
+        switch (df.col(continuous[j])->type_id()) {
+            case Type::DOUBLE: {
+                auto* raw = df.data<arrow::DoubleType>(continuous[j]);
+                data.col(j) = Eigen::Map<const VectorXd>(raw, num_rows);
+                break;
+            }
+            case Type::FLOAT: {
+                auto* raw = df.data<arrow::FloatType>(continuous[j]);
+                data.col(j) = Eigen::Map<const Eigen::VectorXf>(raw, num_rows).template cast<double>();
+                break;
+            }
+            default:
+                throw std::runtime_error("Wrong data type! This code should be unreachable.");
+        }
+    }
 
+    VectorXi counts = VectorXi::Zero(num_configurations);
+    MatrixXd means = MatrixXd::Zero(num_continuous, num_configurations);
+    for (int64_t i = 0; i < num_rows; ++i) {
+        ++counts(indices(i));
+        means.col(indices(i)) += data.row(i).transpose();
+    }
+
+    std::vector<MatrixXd> cov;
+    if (num_continuous > 0) {
+        for (auto k = 0; k < num_configurations; ++k) {
+            if (counts(k) > 0) means.col(k) /= counts(k);
+        }
+
+        cov.resize(num_configurations, MatrixXd::Zero(num_continuous, num_continuous));
+        VectorXd d(num_continuous);
+        for (int64_t i = 0; i < num_rows; ++i) {
+            d.noalias() = data.row(i).transpose() - means.col(indices(i));
+            cov[indices(i)].noalias() += d * d.transpose();
+        }
+    }
+
+    double h = 0;
+    for (auto k = 0; k < num_configurations; ++k) {
+        if (counts(k) == 0) continue;
+
+        auto p = static_cast<double>(counts(k)) / N;
+        // Add H(D)
+        h -= p * std::log(p);
+
+        if (num_continuous > 0) {
+            cov[k] /= counts(k) - 1;
+            // Add H(C | D)
+            h += p * entropy_mvn(num_continuous, cov[k].determinant());
+        }
+    }
+
+    return h;
+}
+
+// The MI(X; Y) from the joint counts of (x, y).
+double mi_discrete_counts(const VectorXi& joint_counts, const VectorXi& cardinality, const VectorXi& strides) {
     auto x_marg = factors::discrete::marginal_counts(joint_counts, 0, cardinality, strides);
     auto y_marg = factors::discrete::marginal_counts(joint_counts, 1, cardinality, strides);
 
@@ -954,6 +1029,13 @@ double MutualInformation::mi_discrete(const std::string& x, const std::string& y
     return mi;
 }
 
+double MutualInformation::mi_discrete(const std::string& x, const std::string& y) const {
+    std::vector<std::string> dummy_y{y};
+    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, x, dummy_y);
+    auto joint_counts = factors::discrete::joint_counts(m_df, x, dummy_y, cardinality, strides);
+    return mi_discrete_counts(joint_counts, cardinality, strides);
+}
+
 template <bool contains_null, typename IndicesArrowType, typename ContinuousArrowType>
 double MutualInformation::mi_mixed_impl(const std::string& discrete, const std::string& continuous) const {
     using IndicesArrayType = typename arrow::TypeTraits<IndicesArrowType>::ArrayType;
@@ -1052,6 +1134,53 @@ double MutualInformation::mi_mixed(const std::string& discrete, const std::strin
     }
 }
 
+void MutualInformation::cache_covariance() {
+    std::vector<int> continuous_indices;
+    for (int i = 0; i < m_df->num_columns(); ++i) {
+        if (m_df.is_continuous(i)) continuous_indices.push_back(i);
+    }
+
+    if (continuous_indices.empty() || m_df.null_count(continuous_indices) > 0) return;
+
+    auto type = m_df.col(continuous_indices[0])->type_id();
+    bool same_type = std::all_of(continuous_indices.begin(), continuous_indices.end(), [this, type](int i) {
+        return m_df.col(i)->type_id() == type;
+    });
+    if (!same_type) return;
+
+    // The covariances are shared with LinearCorrelation and the other tests of the same columns.
+    auto& registry = CovarianceRegistry::get();
+    auto continuous_columns = m_df.indices_to_columns(continuous_indices);
+    if (type == Type::DOUBLE)
+        m_cov = std::move(*registry.cov<arrow::DoubleType>(continuous_columns));
+    else
+        m_cov = registry.cov<arrow::FloatType>(continuous_columns)->template cast<double>();
+
+    for (int i = 0, size = continuous_indices.size(); i < size; ++i) {
+        m_cov_indices.insert({m_df.name(continuous_indices[i]), i});
+    }
+
+    m_cached_cov = true;
+}
+
+MatrixXd MutualInformation::cached_cov(const std::vector<std::string>& continuous) const {
+    int k = continuous.size();
+    std::vector<int> indices;
+    indices.reserve(k);
+    for (const auto& c : continuous) {
+        indices.push_back(m_cov_indices.at(c));
+    }
+
+    MatrixXd cov(k, k);
+    for (int i = 0; i < k; ++i) {
+        for (int j = 0; j < k; ++j) {
+            cov(i, j) = m_cov(indices[i], indices[j]);
+        }
+    }
+
+    return cov;
+}
+
 template <typename ArrowType>
 double MutualInformation::mi_continuous_impl(const std::string& x, const std::string& y) const {
     auto pcov = m_df.cov<ArrowType>(x, y);
@@ -1062,6 +1191,12 @@ double MutualInformation::mi_continuous_impl(const std::string& x, const std::st
 }
 
 double MutualInformation::mi_continuous(const std::string& x, const std::string& y) const {
+    if (m_cached_cov) {
+        auto cov = cached_cov({x, y});
+        auto cor = cov(0, 1) / sqrt(cov(0, 0) * cov(1, 1));
+        return -0.5 * std::log(1 - cor * cor);
+    }
+
     auto tt = m_df.same_type(x, y);
 
     switch (tt->id()) {
@@ -1295,6 +1430,13 @@ double MutualInformation::cmi_discrete_continuous(const std::string& x,
 }
 
 double MutualInformation::mi(const std::string& x, const std::string& y, const std::string& z) const {
+    if (!(m_df.is_discrete(x) && m_df.is_discrete(y) && m_df.is_discrete(z)) && m_df.null_count(x, y, z) == 0) {
+        if (m_df.is_discrete(z))
+            return cmi_entropies(x, y, {z}, {});
+        else
+            return cmi_entropies(x, y, {}, {z});
+    }
+
     if (m_df.is_discrete(x)) {
         if (m_df.is_discrete(y)) {
             return (m_df.is_discrete(z)) ? cmi_discrete_discrete(x, y, {z}) : cmi_discrete_continuous(x, y, z);
@@ -1388,19 +1530,8 @@ double MutualInformation::pvalue(const std::string& x, const std::string& y, con
  *  CONDITIONAL MI
  * **********************************************************/
 
-double MutualInformation::cmi_discrete_discrete(const std::string& x,
-                                                const std::string& y,
-                                                const std::vector<std::string>& discrete_z) const {
-    if (discrete_z.empty()) return mi_discrete(x, y);
-
-    std::vector<std::string> dummy_vars;
-    dummy_vars.reserve(1 + discrete_z.size());
-    dummy_vars.push_back(y);
-    dummy_vars.insert(dummy_vars.end(), discrete_z.begin(), discrete_z.end());
-
-    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, x, dummy_vars);
-    auto joint_counts = factors::discrete::joint_counts(m_df, x, dummy_vars, cardinality, strides);
-
+// The MI(X; Y | Z) from the joint counts of (x, y, z...).
+double cmi_discrete_counts(const VectorXi& joint_counts, const VectorXi& cardinality, const VectorXi& strides) {
     auto vars_configurations = strides(2);
     auto evidence_configurations =
         (cardinality(cardinality.rows() - 1) * strides(strides.rows() - 1)) / vars_configurations;
@@ -1445,6 +1576,21 @@ double MutualInformation::cmi_discrete_discrete(const std::string& x,
     return mi;
 }
 
+double MutualInformation::cmi_discrete_discrete(const std::string& x,
+                                                const std::string& y,
+                                                const std::vector<std::string>& discrete_z) const {
+    if (discrete_z.empty()) return mi_discrete(x, y);
+
+    std::vector<std::string> dummy_vars;
+    dummy_vars.reserve(1 + discrete_z.size());
+    dummy_vars.push_back(y);
+    dummy_vars.insert(dummy_vars.end(), discrete_z.begin(), discrete_z.end());
+
+    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, x, dummy_vars);
+    auto joint_counts = factors::discrete::joint_counts(m_df, x, dummy_vars, cardinality, strides);
+    return cmi_discrete_counts(joint_counts, cardinality, strides);
+}
+
 double MutualInformation::cmi_general_both_discrete(const std::string& x,
                                                     const std::string& y,
                                                     const std::vector<std::string>& discrete_z,
@@ -1624,10 +1770,107 @@ double MutualInformation::cmi_general_both_continuous(const std::string& x,
     return std::max(mi, 0.);
 }
 
+double MutualInformation::entropy(std::vector<std::string> discrete, std::vector<std::string> continuous) const {
+    std::sort(discrete.begin(), discrete.end());
+    std::sort(continuous.begin(), continuous.end());
+    EntropyKey key(std::move(discrete), std::move(continuous));
+
+    {
+        std::lock_guard<std::mutex> lock(m_entropy_mutex);
+        auto it = m_entropies.find(key);
+        if (it != m_entropies.end()) return it->second;
+    }
+
+    // Without discrete variables, H(C) only depends on the covariance of C.
+    double h;
+    if (m_cached_cov && key.first.empty() && !key.second.empty())
+        h = entropy_mvn(key.second.size(), cached_cov(key.second).determinant());
+    else
+        h = discrete_gaussian_entropy(m_df, key.first, key.second);
+
+    auto memory = entropy_memory(key);
+    std::lock_guard<std::mutex> lock(m_entropy_mutex);
+    if (m_entropies.count(key) > 0 || memory > m_max_entropy_memory) return h;
+
+    evict_entropies_unlocked(memory, max_cached_entropies - 1);
+    m_entropy_memory += memory;
+    m_entropy_order.push_back(key);
+    m_entropies.emplace(std::move(key), h);
+    return h;
+}
+
+std::size_t MutualInformation::entropy_memory(const EntropyKey& key) {
+    // The key is stored in the hash table and in the queue. The sizes (instead of the capacities) are used, so the
+    // memory of the copies of the key is the same.
+    std::size_t key_memory = sizeof(EntropyKey) + (key.first.size() + key.second.size()) * sizeof(std::string);
+    for (const auto& v : key.first) key_memory += v.size();
+    for (const auto& v : key.second) key_memory += v.size();
+    return 2 * key_memory + sizeof(double) + 2 * sizeof(void*);
+}
+
+void MutualInformation::evict_entropies_unlocked(std::size_t memory, std::size_t max_entropies) const {
+    while (!m_entropy_order.empty() &&
+           (m_entropy_order.size() > max_entropies || m_entropy_memory + memory > m_max_entropy_memory)) {
+        m_entropy_memory -= entropy_memory(m_entropy_order.front());
+        m_entropies.erase(m_entropy_order.front());
+        m_entropy_order.pop_front();
+    }
+}
+
+util::MemoryUsage MutualInformation::memory_usage() const {
+    util::MemoryUsage usage;
+    usage.add("cov", util::eigen_bytes(m_cov));
+    std::lock_guard<std::mutex> lock(m_entropy_mutex);
+    usage.add("entropies", m_entropy_memory);
+    return usage;
+}
+
+void MutualInformation::set_max_cache_memory(std::size_t max_memory) {
+    std::lock_guard<std::mutex> lock(m_entropy_mutex);
+    m_max_entropy_memory = max_memory;
+    evict_entropies_unlocked(0, max_cached_entropies);
+}
+
+double MutualInformation::cmi_entropies(const std::string& x,
+                                        const std::string& y,
+                                        const std::vector<std::string>& discrete_z,
+                                        const std::vector<std::string>& continuous_z) const {
+    auto discrete_xz = discrete_z;
+    auto continuous_xz = continuous_z;
+    if (m_df.is_discrete(x))
+        discrete_xz.push_back(x);
+    else
+        continuous_xz.push_back(x);
+
+    auto discrete_yz = discrete_z;
+    auto continuous_yz = continuous_z;
+    if (m_df.is_discrete(y))
+        discrete_yz.push_back(y);
+    else
+        continuous_yz.push_back(y);
+
+    auto discrete_xyz = discrete_xz;
+    auto continuous_xyz = continuous_xz;
+    if (m_df.is_discrete(y))
+        discrete_xyz.push_back(y);
+    else
+        continuous_xyz.push_back(y);
+
+    auto mi = entropy(discrete_xz, continuous_xz) + entropy(discrete_yz, continuous_yz) -
+              entropy(discrete_xyz, continuous_xyz) - entropy(discrete_z, continuous_z);
+    return std::max(mi, 0.);
+}
+
 double MutualInformation::cmi_general(const std::string& x,
                                       const std::string& y,
                                       const std::vector<std::string>& discrete_z,
                                       const std::vector<std::string>& continuous_z) const {
+    bool all_discrete = continuous_z.empty() && m_df.is_discrete(x) && m_df.is_discrete(y);
+    // Without nulls, all the tests share the same rows, so the cached entropies can be reused.
+    if (!all_discrete && m_df.null_count(continuous_z, x, y, discrete_z) == 0) {
+        return cmi_entropies(x, y, discrete_z, continuous_z);
+    }
+
     if (m_df.is_discrete(x)) {
         if (m_df.is_discrete(y)) {
             return cmi_general_both_discrete(x, y, discrete_z, continuous_z);
@@ -1750,4 +1993,65 @@ double MutualInformation::pvalue(const std::string& x, const std::string& y, con
     return cdf(complement(chidist, mi_value));
 }
 
+std::vector<double> MutualInformation::pvalues(const std::string& x,
+                                              const std::string& y,
+                                              const std::vector<std::vector<std::string>>& z) const {
+    std::vector<double> res(z.size());
+
+    // The joint counts of the tests with discrete data are computed together with batch_joint_counts(), so the columns
+    // of x, y and the common conditioning variables are read once.
+    std::vector<size_t> discrete_tests;
+    std::vector<std::vector<std::string>> discrete_vars;
+
+    bool discrete_xy = m_df.is_discrete(x) && m_df.is_discrete(y);
+    for (size_t i = 0; i < z.size(); ++i) {
+        bool all_discrete =
+            discrete_xy && std::all_of(z[i].begin(), z[i].end(), [this](const auto& e) { return m_df.is_discrete(e); });
+
+        if (all_discrete) {
+            std::vector<std::string> dummy_vars;
+            dummy_vars.reserve(1 + z[i].size());
+            dummy_vars.push_back(y);
+            dummy_vars.insert(dummy_vars.end(), z[i].begin(), z[i].end());
+
+            discrete_tests.push_back(i);
+            discrete_vars.push_back(std::move(dummy_vars));
+        } else {
+            res[i] = conditional_pvalue(x, y, z[i]);
+        }
+    }
+
+    if (!discrete_tests.empty()) {
+        auto counts = factors::discrete::batch_joint_counts(m_df, x, discrete_vars);
+        for (size_t k = 0; k < discrete_tests.size(); ++k) {
+            const auto& ev = z[discrete_tests[k]];
+            const auto& [cardinality, joint_counts] = counts[k];
+
+            VectorXi strides(cardinality.rows());
+            strides(0) = 1;
+            for (auto j = 1; j < strides.rows(); ++j) {
+                strides(j) = strides(j - 1) * cardinality(j - 1);
+            }
+
+            double mi_value;
+            double df;
+            if (ev.empty()) {
+                mi_value = mi_discrete_counts(joint_counts, cardinality, strides) * 2 * m_df.valid_rows(x, y);
+                df = calculate_df(x, y);
+            } else if (ev.size() == 1) {
+                mi_value = cmi_discrete_counts(joint_counts, cardinality, strides) * 2 * m_df.valid_rows(x, y, ev[0]);
+                df = calculate_df(x, y, ev[0]);
+            } else {
+                mi_value = cmi_discrete_counts(joint_counts, cardinality, strides) * 2 * m_df.valid_rows(x, y, ev);
+                df = calculate_df(x, y, ev, {});
+            }
+
+            boost::math::chi_squared_distribution chidist(static_cast<double>(df));
+            res[discrete_tests[k]] = cdf(complement(chidist, mi_value));
+        }
+    }
+
+    return res;
+}
+
 }  // namespace learning::independences::hybrid
\ No newline at end of file
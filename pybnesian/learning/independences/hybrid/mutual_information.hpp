@@ -1,8 +1,12 @@
 #ifndef PYBNESIAN_LEARNING_INDEPENDENCES_HYBRID_MUTUAL_INFORMATION_HPP
 #define PYBNESIAN_LEARNING_INDEPENDENCES_HYBRID_MUTUAL_INFORMATION_HPP
 
+#include <deque>
+#include <mutex>
+#include <unordered_map>
 #include <dataset/dataset.hpp>
 #include <learning/independences/independence.hpp>
+#include <util/hash_utils.hpp>
 
 using dataset::DataFrame;
 using learning::independences::IndependenceTest;
@@ -11,29 +15,100 @@ namespace learning::independences::hybrid {
 
 class MutualInformation : public IndependenceTest {
 public:
-    MutualInformation(const DataFrame& df, bool asymptotic_df = true) : m_df(df), m_asymptotic_df(asymptotic_df) {
+    // Maximum number of cached entropies.
+    static constexpr std::size_t max_cached_entropies = 1 << 16;
+
+    MutualInformation(const DataFrame& df, bool asymptotic_df = true)
+        : m_df(df),
+          m_asymptotic_df(asymptotic_df),
+          m_cached_cov(false),
+          m_cov(),
+          m_cov_indices(),
+          m_entropy_mutex(),
+          m_entropies(),
+          m_entropy_order(),
+          m_entropy_memory(0),
+          m_max_entropy_memory(util::unlimited_memory) {
         for (int i = 0; i < m_df->num_columns(); ++i) {
             if (!m_df.is_discrete(i) && !m_df.is_continuous(i))
                 throw std::invalid_argument("Wrong data type (" + m_df.col(i)->type()->ToString() + ") for column " +
                                             m_df.name(i) + ".");
         }
+
+        cache_covariance();
     }
 
     double pvalue(const std::string& x, const std::string& y) const override;
     double pvalue(const std::string& x, const std::string& y, const std::string& z) const override;
     double pvalue(const std::string& x, const std::string& y, const std::vector<std::string>& z) const override;
 
+    using IndependenceTest::pvalues;
+    std::vector<double> pvalues(const std::string& x,
+                                const std::string& y,
+                                const std::vector<std::vector<std::string>>& z) const override;
+    // The batches of tests with discrete data read the columns once. The other tests are evaluated one at a time.
+    std::size_t native_batch_size() const override {
+        return m_df.discrete_columns().size() > 1 ? unlimited_batch_size : 1;
+    }
+
     double mi(const std::string& x, const std::string& y) const;
     double mi(const std::string& x, const std::string& y, const std::string& z) const;
     double mi(const std::string& x, const std::string& y, const std::vector<std::string>& z) const;
 
+    std::string ToString() const override { return "MutualInformation"; }
     int num_variables() const override { return m_df->num_columns(); }
     std::vector<std::string> variable_names() const override { return m_df.column_names(); }
     const std::string& name(int i) const override { return m_df.name(i); }
     bool has_variables(const std::string& name) const override { return m_df.has_columns(name); }
     bool has_variables(const std::vector<std::string>& cols) const override { return m_df.has_columns(cols); }
 
+    // The memory of the cached covariance and of the cached entropies. The limit is applied to the cached entropies.
+    util::MemoryUsage memory_usage() const override;
+    void set_max_cache_memory(std::size_t max_memory) override;
+
 private:
+    // Caches the covariance matrix of all the continuous columns (as LinearCorrelation) if they do not contain nulls
+    // and have the same data type.
+    void cache_covariance();
+    // Returns the covariance matrix of the continuous variables from the cached covariance.
+    MatrixXd cached_cov(const std::vector<std::string>& continuous) const;
+
+    // The variables of an entropy: the sorted discrete variables and the sorted continuous variables.
+    using EntropyKey = std::pair<std::vector<std::string>, std::vector<std::string>>;
+
+    class HashEntropyKey {
+    public:
+        inline std::size_t operator()(const EntropyKey& key) const {
+            size_t seed = key.first.size();
+            for (const auto& v : key.first) {
+                util::hash_combine(seed, v);
+            }
+
+            util::hash_combine(seed, key.second.size());
+            for (const auto& v : key.second) {
+                util::hash_combine(seed, v);
+            }
+            return seed;
+        }
+    };
+
+    // Returns the entropy H(D, C) = H(D) + H(C | D) of the discrete variables D and the continuous variables C, where
+    // C is Gaussian for each configuration of D. The entropies are cached, so the common terms of the tests with
+    // overlapping variables (e.g. H(Z) or H(X, Z)) are computed once. The entropies of continuous variables are
+    // computed from the cached covariance, without a pass over the data. The variables must not contain nulls.
+    double entropy(std::vector<std::string> discrete, std::vector<std::string> continuous) const;
+    // Approximate memory of a cached entropy: the nodes of the hash table and the queue, and the key strings.
+    static std::size_t entropy_memory(const EntropyKey& key);
+    // Removes the oldest entropies until there are at most max_entropies entropies and an entropy of memory bytes fits
+    // in the limit.
+    void evict_entropies_unlocked(std::size_t memory, std::size_t max_entropies) const;
+    // MI(X; Y | Z) = H(X, Z) + H(Y, Z) - H(X, Y, Z) - H(Z) computed with entropy(). The variables must not contain
+    // nulls.
+    double cmi_entropies(const std::string& x,
+                         const std::string& y,
+                         const std::vector<std::string>& discrete_z,
+                         const std::vector<std::string>& continuous_z) const;
+
     double mi_discrete(const std::string& x, const std::string& y) const;
     template <bool contains_null, typename IndicesArrowType, typename ContinuousArrowType>
     double mi_mixed_impl(const std::string& discrete, const std::string& continuous) const;
@@ -95,6 +170,15 @@ private:
 
     DataFrame m_df;
     bool m_asymptotic_df;
+    bool m_cached_cov;
+    MatrixXd m_cov;
+    // The index of each continuous column in m_cov.
+    std::unordered_map<std::string, int> m_cov_indices;
+    mutable std::mutex m_entropy_mutex;
+    mutable std::unordered_map<EntropyKey, double, HashEntropyKey> m_entropies;
+    mutable std::deque<EntropyKey> m_entropy_order;
+    mutable std::size_t m_entropy_memory;
+    std::size_t m_max_entropy_memory;
 };
 
 using DynamicMutualInformation = DynamicIndependenceTestAdaptator<MutualInformation>;
@@ -1,10 +1,13 @@
 #ifndef PYBNESIAN_LEARNING_INDEPENDENCES_INDEPENDENCE_HPP
 #define PYBNESIAN_LEARNING_INDEPENDENCES_INDEPENDENCE_HPP
 
+#include <limits>
 #include <string>
 #include <vector>
 #include <dataset/dataset.hpp>
 #include <dataset/dynamic_dataset.hpp>
+#include <util/memory_usage.hpp>
+#include <util/profiler.hpp>
 #include <util/util_types.hpp>
 
 using dataset::DataFrame, dataset::DynamicDataFrame, dataset::DynamicVariable, dataset::DynamicAdaptator;
@@ -18,18 +21,210 @@ public:
     using string_iterator = typename std::vector<std::string>::const_iterator;
 
     virtual ~IndependenceTest(){};
+    virtual bool is_python_derived() const { return false; }
+    virtual std::string ToString() const { return "IndependenceTest"; }
 
     virtual double pvalue(const std::string& v1, const std::string& v2) const = 0;
     virtual double pvalue(const std::string& v1, const std::string& v2, const std::string& ev) const = 0;
     virtual double pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const = 0;
 
+    // Returns the p-values of the tests v1 _|_ v2 | ev for each ev in evs. An empty ev is the test pvalue(v1, v2), and
+    // an ev with one variable is the test pvalue(v1, v2, ev[0]). The default implementation calls pvalue() for each
+    // ev.
+    virtual std::vector<double> pvalues(const std::string& v1,
+                                        const std::string& v2,
+                                        const std::vector<std::vector<std::string>>& evs) const {
+        std::vector<double> res;
+        res.reserve(evs.size());
+        for (const auto& ev : evs) {
+            res.push_back(conditional_pvalue(v1, v2, ev));
+        }
+
+        return res;
+    }
+
+    // Returns the p-values of the tests pair.first _|_ pair.second | ev for each pair in pairs. The ev follows the same
+    // convention as in pvalues(v1, v2, evs).
+    virtual std::vector<double> pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                        const std::vector<std::string>& ev) const {
+        std::vector<double> res;
+        res.reserve(pairs.size());
+        for (const auto& pair : pairs) {
+            res.push_back(conditional_pvalue(pair.first, pair.second, ev));
+        }
+
+        return res;
+    }
+
+    // The tests with the indices of the variables (see name() and index()), so the learning algorithms can resolve the
+    // names once and run the tests with integer ids. The default implementations call the tests with the names.
+    virtual double pvalue(int v1, int v2) const { return pvalue(name(v1), name(v2)); }
+    virtual double pvalue(int v1, int v2, int ev) const { return pvalue(name(v1), name(v2), name(ev)); }
+    virtual double pvalue(int v1, int v2, const std::vector<int>& ev) const {
+        return pvalue(name(v1), name(v2), names(ev));
+    }
+    virtual std::vector<double> pvalues(const std::vector<std::pair<int, int>>& pairs,
+                                        const std::vector<int>& ev) const {
+        std::vector<std::pair<std::string, std::string>> name_pairs;
+        name_pairs.reserve(pairs.size());
+        for (const auto& pair : pairs) {
+            name_pairs.push_back({name(pair.first), name(pair.second)});
+        }
+
+        return pvalues(name_pairs, names(ev));
+    }
+
+    // A test v1 _|_ v2 | ev with the indices of the variables.
+    struct IndexedTest {
+        int v1;
+        int v2;
+        std::vector<int> ev;
+    };
+
+    // Returns the p-values of a batch of unrelated tests. The default implementation calls pvalue() for each test.
+    virtual std::vector<double> pvalues(const std::vector<IndexedTest>& tests) const {
+        std::vector<double> res;
+        res.reserve(tests.size());
+        for (const auto& t : tests) {
+            switch (t.ev.size()) {
+                case 0:
+                    res.push_back(pvalue(t.v1, t.v2));
+                    break;
+                case 1:
+                    res.push_back(pvalue(t.v1, t.v2, t.ev[0]));
+                    break;
+                default:
+                    res.push_back(pvalue(t.v1, t.v2, t.ev));
+            }
+        }
+
+        return res;
+    }
+
+    // Returns true if pvalues(tests) is faster with large batches (e.g., if the tests are evaluated with an OpenCL
+    // device). Then, the PC algorithm tests the conditioning sets of all the edges of a level in the same batch.
+    virtual bool batched_levels() const { return false; }
+
+    // The value of native_batch_size() for the tests whose batches have no maximum size.
+    inline static constexpr std::size_t unlimited_batch_size = std::numeric_limits<std::size_t>::max();
+
+    // Returns the maximum number of conditioning sets that pvalues(v1, v2, evs) evaluates together, sharing work
+    // between them. The default is 1, because the default pvalues() calls pvalue() for each set. Then, the algorithms
+    // that stop at the first independent set (e.g., the sepset searches of PC and MMPC) test a set at a time, instead
+    // of testing the sets after the independent one in vain.
+    virtual std::size_t native_batch_size() const { return 1; }
+
     virtual int num_variables() const = 0;
     virtual std::vector<std::string> variable_names() const = 0;
     virtual const std::string& name(int i) const = 0;
+    // Returns the index of the variable name. The default implementation searches the name in all the variables.
+    virtual int index(const std::string& name) const {
+        for (int i = 0, n = num_variables(); i < n; ++i) {
+            if (this->name(i) == name) return i;
+        }
+
+        throw std::invalid_argument("Variable " + name + " not present in " + ToString() + ".");
+    }
     virtual bool has_variables(const std::string& name) const = 0;
     virtual bool has_variables(const std::vector<std::string>& cols) const = 0;
+
+    // Returns the memory of the caches of the test. The default implementation returns an empty report.
+    virtual util::MemoryUsage memory_usage() const { return util::MemoryUsage(); }
+    // Limits the memory of the caches of the test to max_memory bytes (see Score::set_max_cache_memory()). The tests
+    // without caches ignore it.
+    virtual void set_max_cache_memory(std::size_t) {}
+
+protected:
+    std::vector<std::string> names(const std::vector<int>& indices) const {
+        std::vector<std::string> res;
+        res.reserve(indices.size());
+        for (auto i : indices) {
+            res.push_back(name(i));
+        }
+
+        return res;
+    }
+
+    // Calls the pvalue() overload that corresponds to the size of ev.
+    double conditional_pvalue(const std::string& v1, const std::string& v2, const std::vector<std::string>& ev) const {
+        switch (ev.size()) {
+            case 0:
+                return pvalue(v1, v2);
+            case 1:
+                return pvalue(v1, v2, ev[0]);
+            default:
+                return pvalue(v1, v2, ev);
+        }
+    }
 };
 
+// The profiled_pvalue() and profiled_pvalues() functions run the tests, recording their wall time in the
+// "pvalue:<IndependenceTest>" counter of the profiler and the number of tests with k conditioning variables in the
+// "pvalue:<IndependenceTest>:<k>" counter.
+inline void profile_conditioning_size(const IndependenceTest& test, std::size_t k, std::int64_t calls = 1) {
+    util::profile_count([&test, k] { return "pvalue:" + test.ToString() + ":" + std::to_string(k); }, calls);
+}
+
+inline double profiled_pvalue(const IndependenceTest& test, const std::string& v1, const std::string& v2) {
+    util::ProfileScope profile([&test] { return "pvalue:" + test.ToString(); });
+    profile_conditioning_size(test, 0);
+    return test.pvalue(v1, v2);
+}
+
+inline double profiled_pvalue(const IndependenceTest& test,
+                              const std::string& v1,
+                              const std::string& v2,
+                              const std::string& ev) {
+    util::ProfileScope profile([&test] { return "pvalue:" + test.ToString(); });
+    profile_conditioning_size(test, 1);
+    return test.pvalue(v1, v2, ev);
+}
+
+inline double profiled_pvalue(const IndependenceTest& test,
+                              const std::string& v1,
+                              const std::string& v2,
+                              const std::vector<std::string>& ev) {
+    util::ProfileScope profile([&test] { return "pvalue:" + test.ToString(); });
+    profile_conditioning_size(test, ev.size());
+    return test.pvalue(v1, v2, ev);
+}
+
+inline std::vector<double> profiled_pvalues(const IndependenceTest& test,
+                                            const std::string& v1,
+                                            const std::string& v2,
+                                            const std::vector<std::vector<std::string>>& evs) {
+    util::ProfileScope profile([&test] { return "pvalue:" + test.ToString(); }, evs.size());
+    if (util::Profiler::enabled()) {
+        for (const auto& ev : evs) profile_conditioning_size(test, ev.size());
+    }
+    return test.pvalues(v1, v2, evs);
+}
+
+inline std::vector<double> profiled_pvalues(const IndependenceTest& test,
+                                            const std::vector<std::pair<std::string, std::string>>& pairs,
+                                            const std::vector<std::string>& ev) {
+    util::ProfileScope profile([&test] { return "pvalue:" + test.ToString(); }, pairs.size());
+    profile_conditioning_size(test, ev.size(), pairs.size());
+    return test.pvalues(pairs, ev);
+}
+
+inline std::vector<double> profiled_pvalues(const IndependenceTest& test,
+                                            const std::vector<std::pair<int, int>>& pairs,
+                                            const std::vector<int>& ev) {
+    util::ProfileScope profile([&test] { return "pvalue:" + test.ToString(); }, pairs.size());
+    profile_conditioning_size(test, ev.size(), pairs.size());
+    return test.pvalues(pairs, ev);
+}
+
+inline std::vector<double> profiled_pvalues(const IndependenceTest& test,
+                                            const std::vector<IndependenceTest::IndexedTest>& tests) {
+    util::ProfileScope profile([&test] { return "pvalue:" + test.ToString(); }, tests.size());
+    if (util::Profiler::enabled()) {
+        for (const auto& t : tests) profile_conditioning_size(test, t.ev.size());
+    }
+    return test.pvalues(tests);
+}
+
 class DynamicIndependenceTest {
 public:
     virtual ~DynamicIndependenceTest() {}
@@ -1,3 +1,4 @@
+#include <numeric>
 #include <models/BayesianNetwork.hpp>
 #include <models/SemiparametricBN.hpp>
 #include <learning/scores/scores.hpp>
@@ -16,87 +17,253 @@ std::shared_ptr<Operator> AddArc::opposite(const ConditionalBayesianNetworkBase&
     return opposite(static_cast<const BayesianNetworkBase&>(m));
 }
 
+// Returns the index of a source node in the rows of the delta matrix: the collapsed index in a Bayesian network, or the
+// joint collapsed index in a conditional Bayesian network.
+int source_index(const BayesianNetworkBase& model, const std::string& node) { return model.collapsed_index(node); }
+int source_index(const ConditionalBayesianNetworkBase& model, const std::string& node) {
+    return model.joint_collapsed_index(node);
+}
+
+int num_sources(const BayesianNetworkBase& model) { return model.num_nodes(); }
+int num_sources(const ConditionalBayesianNetworkBase& model) { return model.num_joint_nodes(); }
+
+bool contains_source(const BayesianNetworkBase& model, const std::string& node) { return model.contains_node(node); }
+bool contains_source(const ConditionalBayesianNetworkBase& model, const std::string& node) {
+    return model.contains_joint_node(node);
+}
+
+template <typename M>
+void ArcOperatorSet::initialize_candidates(const M& model) {
+    m_candidates.clear();
+    if (m_candidate_parents.empty()) return;
+
+    m_candidates.resize(model.num_nodes());
+    for (const auto& target : model.nodes()) {
+        auto& candidates = m_candidates[model.collapsed_index(target)];
+
+        if (auto it = m_candidate_parents.find(target); it != m_candidate_parents.end()) {
+            for (const auto& source : it->second) {
+                if (!contains_source(model, source))
+                    throw std::invalid_argument("Candidate parent " + source + " of node " + target +
+                                                " not present in the model.");
+                candidates.push_back(source_index(model, source));
+            }
+        }
+
+        for (const auto& parent : model.parents(target)) {
+            candidates.push_back(source_index(model, parent));
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+}
+
+std::vector<int> ArcOperatorSet::sources(int target, int num_sources) const {
+    if (restricts_candidates()) return m_candidates[target];
+
+    std::vector<int> res(num_sources);
+    std::iota(res.begin(), res.end(), 0);
+    return res;
+}
+
 void ArcOperatorSet::update_valid_ops(const BayesianNetworkBase& model) {
     int num_nodes = model.num_nodes();
 
-    bool changed_size = delta.rows() != num_nodes || delta.cols() != num_nodes;
+    initialize_candidates(model);
+    int rows = num_nodes;
+    if (restricts_candidates()) {
+        rows = 0;
+        for (const auto& candidates : m_candidates) {
+            rows = std::max(rows, static_cast<int>(candidates.size()));
+        }
+    }
+
+    bool changed_size = delta.rows() != rows || delta.cols() != num_nodes;
     if (changed_size) {
-        delta = MatrixXd(num_nodes, num_nodes);
-        valid_op = MatrixXb(num_nodes, num_nodes);
+        delta = MatrixXd(rows, num_nodes);
+        valid_op = MatrixXb(rows, num_nodes);
     }
 
     auto val_ptr = valid_op.data();
-    std::fill(val_ptr, val_ptr + num_nodes * num_nodes, true);
+    std::fill(val_ptr, val_ptr + valid_op.size(), true);
+    // The operators that are not valid or cannot be applied (see BayesianNetworkType::can_have_arc()) are never
+    // selected.
+    std::fill(delta.data(), delta.data() + delta.size(), std::numeric_limits<double>::lowest());
 
-    auto restrictions = util::validate_restrictions(model, m_blacklist, m_whitelist);
+    if (restricts_candidates()) {
+        // The rows after the last candidate of each target are padding.
+        for (int j = 0; j < num_nodes; ++j) {
+            for (int i = static_cast<int>(m_candidates[j].size()); i < rows; ++i) {
+                valid_op(i, j) = false;
+            }
+        }
+    }
 
-    auto valid_ops =
-        (num_nodes * num_nodes) - 2 * restrictions.arc_whitelist.size() - restrictions.arc_blacklist.size() - num_nodes;
+    auto restrictions = util::validate_restrictions(model, m_blacklist, m_whitelist);
 
     for (const auto& whitelist_arc : restrictions.arc_whitelist) {
         int source_index = model.collapsed_from_index(whitelist_arc.first);
         int target_index = model.collapsed_from_index(whitelist_arc.second);
 
-        valid_op(source_index, target_index) = false;
-        valid_op(target_index, source_index) = false;
-        delta(source_index, target_index) = std::numeric_limits<double>::lowest();
-        delta(target_index, source_index) = std::numeric_limits<double>::lowest();
+        set_invalid(source_index, target_index);
+        set_invalid(target_index, source_index);
     }
 
     for (const auto& blacklist_arc : restrictions.arc_blacklist) {
         int source_index = model.collapsed_from_index(blacklist_arc.first);
         int target_index = model.collapsed_from_index(blacklist_arc.second);
 
-        valid_op(source_index, target_index) = false;
-        delta(source_index, target_index) = std::numeric_limits<double>::lowest();
+        set_invalid(source_index, target_index);
     }
 
     for (int i = 0; i < num_nodes; ++i) {
-        valid_op(i, i) = false;
-        delta(i, i) = std::numeric_limits<double>::lowest();
+        set_invalid(i, i);
     }
 
-    sorted_idx.clear();
-    sorted_idx.reserve(valid_ops);
+    m_arc_mask.update(model);
+    initialize_sorted_sources();
+}
 
-    for (int i = 0; i < num_nodes; ++i) {
-        for (int j = 0; j < num_nodes; ++j) {
-            if (valid_op(i, j)) {
-                sorted_idx.push_back(i + j * num_nodes);
-            }
+void ArcOperatorSet::initialize_sorted_sources() {
+    auto rows = valid_op.rows();
+    auto cols = valid_op.cols();
+
+    m_sorted_sources.resize(cols);
+    for (int j = 0; j < cols; ++j) {
+        auto& sources = m_sorted_sources[j];
+        sources.clear();
+        for (int i = 0; i < rows; ++i) {
+            if (valid_op(i, j)) sources.push_back(i);
         }
     }
+
+    m_dirty_targets.assign(cols, true);
+}
+
+void ArcOperatorSet::update_sorted_sources() const {
+    for (int j = 0, end = static_cast<int>(m_sorted_sources.size()); j < end; ++j) {
+        if (m_dirty_targets[j]) {
+            std::sort(m_sorted_sources[j].begin(), m_sorted_sources[j].end(), [this, j](int i1, int i2) {
+                auto d1 = delta(i1, j);
+                auto d2 = delta(i2, j);
+                if (d1 != d2) return d1 > d2;
+                return i1 < i2;
+            });
+            m_dirty_targets[j] = false;
+        }
+    }
+}
+
+// Parents of target_node after removing the arc source_node -> target_node. The order of the other parents is kept.
+std::vector<std::string> parents_without(const std::vector<std::string>& parents, const std::string& source_node) {
+    std::vector<std::string> res;
+    res.reserve(parents.size());
+    for (const auto& p : parents) {
+        if (p != source_node) res.push_back(p);
+    }
+
+    return res;
+}
+
+// Parents of target_node after adding the arc source_node -> target_node. All the added arcs for the same target node
+// share the current parents as prefix, so the scores can reuse the work of the prefix in Score::local_scores().
+std::vector<std::string> parents_with(const std::vector<std::string>& parents, const std::string& source_node) {
+    std::vector<std::string> res;
+    res.reserve(parents.size() + 1);
+    res.insert(res.end(), parents.begin(), parents.end());
+    res.push_back(source_node);
+    return res;
+}
+
+std::vector<std::string> candidate_parents(const BayesianNetworkBase& model,
+                                           const std::string& source,
+                                           const std::string& target,
+                                           const std::vector<std::string>& parents_target) {
+    if (model.has_arc(source, target))
+        return parents_without(parents_target, source);
+    else
+        return parents_with(parents_target, source);
 }
 
 double cache_score_operation(const BayesianNetworkBase& model,
                              const Score& score,
+                             LocalScoreMemo& memo,
                              const std::string& source,
                              const std::string& target,
-                             std::vector<std::string>& parents_target,
+                             double target_new_score,
                              double source_cached_score,
                              double target_cached_score) {
-    if (model.has_arc(source, target)) {
-        util::swap_remove_v(parents_target, source);
-        auto d = score.local_score(model, target, parents_target) - target_cached_score;
-        parents_target.push_back(source);
-        return d;
-    } else if (model.has_arc(target, source)) {
-        auto new_parents_source = model.parents(source);
-        util::swap_remove_v(new_parents_source, target);
-
-        parents_target.push_back(source);
-        double d = score.local_score(model, source, new_parents_source) +
-                   score.local_score(model, target, parents_target) - source_cached_score - target_cached_score;
-        parents_target.pop_back();
-        return d;
+    if (model.has_arc(target, source)) {
+        auto new_parents_source = parents_without(model.parents(source), target);
+        return memo.local_score(model, score, source, new_parents_source) + target_new_score - source_cached_score -
+               target_cached_score;
+    } else {
+        return target_new_score - target_cached_score;
+    }
+}
+
+template <typename M>
+void ArcCompatibilityMask::update(const M& model, const std::vector<std::string>& sources) {
+    const auto& targets = model.nodes();
+    int num_sources = sources.size();
+    int num_targets = targets.size();
+
+    std::vector<bool> changed(num_sources, true);
+    if (m_type != model.type() || m_sources != sources || m_targets != targets) {
+        m_type = model.type();
+        m_sources = sources;
+        m_targets = targets;
+        m_target_sources.clear();
+        for (const auto& target : targets) {
+            m_target_sources.push_back(std::find(sources.begin(), sources.end(), target) - sources.begin());
+        }
+
+        m_source_types.clear();
+        for (const auto& source : sources) {
+            m_source_types.push_back(model.node_type(source));
+        }
+
+        m_mask = MatrixXb(num_sources, num_targets);
     } else {
-        parents_target.push_back(source);
-        double d = score.local_score(model, target, parents_target) - target_cached_score;
-        parents_target.pop_back();
-        return d;
+        bool any_changed = false;
+        for (int i = 0; i < num_sources; ++i) {
+            auto type = model.node_type(sources[i]);
+            changed[i] = *type != *m_source_types[i];
+            if (changed[i]) {
+                m_source_types[i] = std::move(type);
+                any_changed = true;
+            }
+        }
+
+        if (!any_changed) return;
+    }
+
+    for (int t = 0; t < num_targets; ++t) {
+        auto target_source = m_target_sources[t];
+        for (int s = 0; s < num_sources; ++s) {
+            if (changed[s] || changed[target_source])
+                m_mask(s, t) = s != target_source && m_type->can_have_arc(model, sources[s], targets[t]);
+        }
     }
 }
 
+void ArcCompatibilityMask::update(const BayesianNetworkBase& model) { update(model, model.nodes()); }
+
+void ArcCompatibilityMask::update(const ConditionalBayesianNetworkBase& model) { update(model, model.joint_nodes()); }
+
+// Returns true if Score::add_parent_bound() proves that adding the arc source_node -> target_node does not improve the
+// score, so its local score is not computed.
+bool cannot_improve(const BayesianNetworkBase& model,
+                    const Score& score,
+                    const std::string& source_node,
+                    const std::string& target_node,
+                    const std::vector<std::string>& parents_target,
+                    double target_cached_score) {
+    auto bound = score.add_parent_bound(model, target_node, parents_target, source_node, target_cached_score);
+    return bound && *bound <= 0;
+}
+
 void ArcOperatorSet::cache_scores(const BayesianNetworkBase& model, const Score& score) {
     if (!score.compatible_bn(model)) {
         throw std::invalid_argument("BayesianNetwork is not compatible with the score.");
@@ -105,81 +272,109 @@ void ArcOperatorSet::cache_scores(const BayesianNetworkBase& model, const Score&
     initialize_local_cache(model);
 
     if (owns_local_cache()) {
-        this->m_local_cache->cache_local_scores(model, score);
+        this->m_local_cache->cache_local_scores(model, score, m_num_threads);
     }
 
     update_valid_ops(model);
+    m_sample_draws.assign(model.num_nodes(), 0);
 
-    auto bn_type = model.type();
-    for (const auto& target_node : model.nodes()) {
-        std::vector<std::string> new_parents_target = model.parents(target_node);
+    const auto& nodes = model.nodes();
+    // Each target node is processed by a single thread in the same order as the serial code, so the deltas are
+    // bit-identical for any number of threads. The new local scores of each target are computed in a single batch.
+    util::parallel_for(0, static_cast<int>(nodes.size()), m_num_threads, [&](int t, int) {
+        const auto& target_node = nodes[t];
         int target_collapsed = model.collapsed_index(target_node);
-        for (const auto& source_node : model.nodes()) {
-            int source_collapsed = model.collapsed_index(source_node);
-            if (valid_op(source_collapsed, target_collapsed) &&
-                bn_type->can_have_arc(model, source_node, target_node)) {
-                delta(source_collapsed, target_collapsed) =
-                    cache_score_operation(model,
-                                          score,
-                                          source_node,
-                                          target_node,
-                                          new_parents_target,
-                                          m_local_cache->local_score(model, source_node),
-                                          m_local_cache->local_score(model, target_node));
+        auto parents_target = model.parents(target_node);
+
+        std::optional<std::mt19937> rng;
+        if (samples_neighborhood()) rng = sampling_rng(target_collapsed);
+        std::bernoulli_distribution sampled(m_sample_ratio);
+
+        double target_cached_score = m_local_cache->local_score(model, target_node);
+
+        std::vector<int> sources;
+        std::vector<std::vector<std::string>> parents_sets;
+        for (auto source_collapsed : this->sources(target_collapsed, num_sources(model))) {
+            const auto& source_node = nodes[source_collapsed];
+            if (is_valid(source_collapsed, target_collapsed) &&
+                m_arc_mask.can_have_arc(source_collapsed, target_collapsed)) {
+                // The AddArc operators not sampled or that cannot improve the score keep the lowest delta of
+                // update_valid_ops().
+                if (!model.has_arc(source_node, target_node) && !model.has_arc(target_node, source_node) &&
+                    ((rng && !sampled(*rng)) ||
+                     cannot_improve(model, score, source_node, target_node, parents_target, target_cached_score)))
+                    continue;
+
+                sources.push_back(source_collapsed);
+                parents_sets.push_back(candidate_parents(model, source_node, target_node, parents_target));
             }
         }
-    }
-}
 
-double cache_score_interface(const ConditionalBayesianNetworkBase& model,
-                             const Score& score,
-                             const std::string& source,
-                             const std::string& target,
-                             std::vector<std::string>& parents_target,
-                             double target_cached_score) {
-    if (model.has_arc(source, target)) {
-        util::swap_remove_v(parents_target, source);
-        double d = score.local_score(model, target, parents_target) - target_cached_score;
-        parents_target.push_back(source);
-        return d;
-    } else {
-        parents_target.push_back(source);
-        double d = score.local_score(model, target, parents_target) - target_cached_score;
-        parents_target.pop_back();
-        return d;
-    }
+        auto target_scores = [&]() {
+            util::ProfileScope profile([&score] { return "local_score:" + score.ToString(); }, parents_sets.size());
+            return score.local_scores(model, target_node, parents_sets);
+        }();
+        m_local_cache->memo().add_evaluations(parents_sets.size());
+
+        for (size_t k = 0, end = sources.size(); k < end; ++k) {
+            const auto& source_node = model.collapsed_name(sources[k]);
+            delta(row(sources[k], target_collapsed), target_collapsed) =
+                cache_score_operation(model,
+                                      score,
+                                      m_local_cache->memo(),
+                                      source_node,
+                                      target_node,
+                                      target_scores[k],
+                                      m_local_cache->local_score(model, source_node),
+                                      target_cached_score);
+        }
+    });
 }
 
 void ArcOperatorSet::update_valid_ops(const ConditionalBayesianNetworkBase& model) {
     int num_nodes = model.num_nodes();
-    int total_nodes = model.num_joint_nodes();
 
-    bool changed_size = delta.rows() != total_nodes || delta.cols() != num_nodes;
+    initialize_candidates(model);
+    int rows = model.num_joint_nodes();
+    if (restricts_candidates()) {
+        rows = 0;
+        for (const auto& candidates : m_candidates) {
+            rows = std::max(rows, static_cast<int>(candidates.size()));
+        }
+    }
+
+    bool changed_size = delta.rows() != rows || delta.cols() != num_nodes;
     if (changed_size) {
-        delta = MatrixXd(total_nodes, num_nodes);
-        valid_op = MatrixXb(total_nodes, num_nodes);
+        delta = MatrixXd(rows, num_nodes);
+        valid_op = MatrixXb(rows, num_nodes);
     }
 
     auto val_ptr = valid_op.data();
-    std::fill(val_ptr, val_ptr + total_nodes * num_nodes, true);
+    std::fill(val_ptr, val_ptr + valid_op.size(), true);
+    // The operators that are not valid or cannot be applied (see BayesianNetworkType::can_have_arc()) are never
+    // selected.
+    std::fill(delta.data(), delta.data() + delta.size(), std::numeric_limits<double>::lowest());
 
-    auto restrictions = util::validate_restrictions(model, m_blacklist, m_whitelist);
+    if (restricts_candidates()) {
+        // The rows after the last candidate of each target are padding.
+        for (int j = 0; j < num_nodes; ++j) {
+            for (int i = static_cast<int>(m_candidates[j].size()); i < rows; ++i) {
+                valid_op(i, j) = false;
+            }
+        }
+    }
 
-    auto valid_ops = total_nodes * num_nodes - num_nodes;
+    auto restrictions = util::validate_restrictions(model, m_blacklist, m_whitelist);
 
     for (const auto& whitelist_arc : restrictions.arc_whitelist) {
         int source_joint_collapsed = model.joint_collapsed_from_index(whitelist_arc.first);
         int target_collapsed = model.collapsed_from_index(whitelist_arc.second);
 
-        valid_op(source_joint_collapsed, target_collapsed) = false;
-        delta(source_joint_collapsed, target_collapsed) = std::numeric_limits<double>::lowest();
-        --valid_ops;
+        set_invalid(source_joint_collapsed, target_collapsed);
         if (!model.is_interface(model.name(whitelist_arc.first))) {
             int target_joint_collapsed = model.joint_collapsed_from_index(whitelist_arc.second);
             int source_collapsed = model.collapsed_from_index(whitelist_arc.first);
-            valid_op(target_joint_collapsed, source_collapsed) = false;
-            delta(target_joint_collapsed, source_collapsed) = std::numeric_limits<double>::lowest();
-            --valid_ops;
+            set_invalid(target_joint_collapsed, source_collapsed);
         }
     }
 
@@ -187,27 +382,16 @@ void ArcOperatorSet::update_valid_ops(const ConditionalBayesianNetworkBase& mode
         int source_joint_collapsed = model.joint_collapsed_from_index(blacklist_arc.first);
         int target_collapsed = model.collapsed_from_index(blacklist_arc.second);
 
-        valid_op(source_joint_collapsed, target_collapsed) = false;
-        delta(source_joint_collapsed, target_collapsed) = std::numeric_limits<double>::lowest();
-        --valid_ops;
+        set_invalid(source_joint_collapsed, target_collapsed);
     }
 
     for (int i = 0; i < num_nodes; ++i) {
         auto joint_collapsed = model.joint_collapsed_from_index(model.index_from_collapsed(i));
-        valid_op(joint_collapsed, i) = false;
-        delta(joint_collapsed, i) = std::numeric_limits<double>::lowest();
+        set_invalid(joint_collapsed, i);
     }
 
-    sorted_idx.clear();
-    sorted_idx.reserve(valid_ops);
-
-    for (int i = 0; i < total_nodes; ++i) {
-        for (int j = 0; j < num_nodes; ++j) {
-            if (valid_op(i, j)) {
-                sorted_idx.push_back(i + j * total_nodes);
-            }
-        }
-    }
+    m_arc_mask.update(model);
+    initialize_sorted_sources();
 }
 
 void ArcOperatorSet::cache_scores(const ConditionalBayesianNetworkBase& model, const Score& score) {
@@ -218,41 +402,69 @@ void ArcOperatorSet::cache_scores(const ConditionalBayesianNetworkBase& model, c
     initialize_local_cache(model);
 
     if (owns_local_cache()) {
-        this->m_local_cache->cache_local_scores(model, score);
+        this->m_local_cache->cache_local_scores(model, score, m_num_threads);
     }
 
     update_valid_ops(model);
+    m_sample_draws.assign(model.num_nodes(), 0);
 
-    auto bn_type = model.type();
-    for (const auto& target_node : model.nodes()) {
+    const auto& nodes = model.nodes();
+    const auto& joint_nodes = model.joint_nodes();
+    util::parallel_for(0, static_cast<int>(nodes.size()), m_num_threads, [&](int t, int) {
+        const auto& target_node = nodes[t];
         auto target_collapsed = model.collapsed_index(target_node);
-        auto new_parents_target = model.parents(target_node);
-
-        for (const auto& source_node : model.joint_nodes()) {
-            int source_joint_collapsed = model.joint_collapsed_index(source_node);
-            if (valid_op(source_joint_collapsed, target_collapsed) &&
-                bn_type->can_have_arc(model, source_node, target_node)) {
-                if (model.is_interface(source_node)) {
-                    delta(source_joint_collapsed, target_collapsed) =
-                        cache_score_interface(model,
-                                              score,
-                                              source_node,
-                                              target_node,
-                                              new_parents_target,
-                                              m_local_cache->local_score(model, target_node));
-                } else {
-                    delta(source_joint_collapsed, target_collapsed) =
-                        cache_score_operation(model,
-                                              score,
-                                              source_node,
-                                              target_node,
-                                              new_parents_target,
-                                              m_local_cache->local_score(model, source_node),
-                                              m_local_cache->local_score(model, target_node));
-                }
+        auto parents_target = model.parents(target_node);
+
+        std::optional<std::mt19937> rng;
+        if (samples_neighborhood()) rng = sampling_rng(target_collapsed);
+        std::bernoulli_distribution sampled(m_sample_ratio);
+
+        double target_cached_score = m_local_cache->local_score(model, target_node);
+
+        std::vector<int> sources;
+        std::vector<std::vector<std::string>> parents_sets;
+        for (auto source_joint_collapsed : this->sources(target_collapsed, num_sources(model))) {
+            const auto& source_node = joint_nodes[source_joint_collapsed];
+            if (is_valid(source_joint_collapsed, target_collapsed) &&
+                m_arc_mask.can_have_arc(source_joint_collapsed, target_collapsed)) {
+                // The AddArc operators not sampled or that cannot improve the score keep the lowest delta of
+                // update_valid_ops().
+                if (!model.has_arc(source_node, target_node) &&
+                    (model.is_interface(source_node) || !model.has_arc(target_node, source_node)) &&
+                    ((rng && !sampled(*rng)) ||
+                     cannot_improve(model, score, source_node, target_node, parents_target, target_cached_score)))
+                    continue;
+
+                sources.push_back(source_joint_collapsed);
+                parents_sets.push_back(candidate_parents(model, source_node, target_node, parents_target));
             }
         }
-    }
+
+        auto target_scores = [&]() {
+            util::ProfileScope profile([&score] { return "local_score:" + score.ToString(); }, parents_sets.size());
+            return score.local_scores(model, target_node, parents_sets);
+        }();
+        m_local_cache->memo().add_evaluations(parents_sets.size());
+
+        for (size_t k = 0, end = sources.size(); k < end; ++k) {
+            const auto& source_node = model.joint_collapsed_name(sources[k]);
+            // If source is interface, the arc cannot be flipped.
+            auto r = row(sources[k], target_collapsed);
+            if (model.is_interface(source_node)) {
+                delta(r, target_collapsed) = target_scores[k] - target_cached_score;
+            } else {
+                delta(r, target_collapsed) =
+                    cache_score_operation(model,
+                                          score,
+                                          m_local_cache->memo(),
+                                          source_node,
+                                          target_node,
+                                          target_scores[k],
+                                          m_local_cache->local_score(model, source_node),
+                                          target_cached_score);
+            }
+        }
+    });
 }
 
 std::shared_ptr<Operator> ArcOperatorSet::find_max(const BayesianNetworkBase& model) const {
@@ -293,134 +505,304 @@ std::shared_ptr<Operator> ArcOperatorSet::find_max(const ConditionalBayesianNetw
         return find_max_indegree<false>(model, tabu_set);
 }
 
-void ArcOperatorSet::update_incoming_arcs_scores(const BayesianNetworkBase& model,
-                                                 const Score& score,
-                                                 const std::string& target_node) {
-    auto target_collapsed = model.collapsed_index(target_node);
+// A delta score update of an arc operator. The updates are computed in three steps: first, the updates are collected in
+// the same order as a serial update. Then, the local scores of all the updates are computed (possibly in parallel). The
+// new local scores of the target nodes are computed in batches of updates with the same target (see
+// Score::local_scores()). Finally, the updates are written into the delta matrix in the collection order. Thus, the
+// deltas are bit-identical for any number of threads.
+struct ArcDeltaUpdate {
+    enum class Kind { Remove, Flip, Add };
+
+    Kind kind;
+    std::string source;
+    std::string target;
+    std::vector<std::string> parents_target;
+    int row;
+    int col;
+    // If true, the remove arc update also updates the flip arc operator in (reverse_row, reverse_col).
+    bool update_reverse;
+    int reverse_row;
+    int reverse_col;
+    double target_score;
+    double delta;
+    double reverse_delta;
+};
+
+template <typename IsValid>
+void collect_incoming_arcs_updates(const BayesianNetworkBase& model,
+                                   const std::vector<int>& sources,
+                                   IsValid&& is_valid,
+                                   const ArcCompatibilityMask& arc_mask,
+                                   const std::string& target_node,
+                                   std::vector<ArcDeltaUpdate>& updates) {
+    using Kind = ArcDeltaUpdate::Kind;
+
+    int target_collapsed = model.collapsed_index(target_node);
     auto parents = model.parents(target_node);
 
-    auto bn_type = model.type();
-    for (const auto& source_node : model.nodes()) {
-        auto source_collapsed = model.collapsed_index(source_node);
+    for (auto source_collapsed : sources) {
+        const auto& source_node = model.collapsed_name(source_collapsed);
 
-        if (valid_op(source_collapsed, target_collapsed)) {
+        if (is_valid(source_collapsed, target_collapsed)) {
             if (model.has_arc(source_node, target_node)) {
                 // Update remove arc: source_node -> target_node
-                util::swap_remove_v(parents, source_node);
-                double d = score.local_score(model, target_node, parents) -
-                           this->m_local_cache->local_score(model, target_node);
-                parents.push_back(source_node);
-                delta(source_collapsed, target_collapsed) = d;
-
                 // Update flip arc: source_node -> target_node
-                if (valid_op(target_collapsed, source_collapsed) &&
-                    bn_type->can_have_arc(model, target_node, source_node)) {
-                    auto parents_source = model.parents(source_node);
-                    parents_source.push_back(target_node);
-                    delta(target_collapsed, source_collapsed) = d +
-                                                                score.local_score(model, source_node, parents_source) -
-                                                                this->m_local_cache->local_score(model, source_node);
-                }
+                bool update_flip = is_valid(target_collapsed, source_collapsed) &&
+                                   arc_mask.can_have_arc(target_collapsed, source_collapsed);
+                updates.push_back(ArcDeltaUpdate{Kind::Remove,
+                                                 source_node,
+                                                 target_node,
+                                                 parents_without(parents, source_node),
+                                                 source_collapsed,
+                                                 target_collapsed,
+                                                 update_flip,
+                                                 target_collapsed,
+                                                 source_collapsed,
+                                                 0,
+                                                 0,
+                                                 0});
             } else if (model.has_arc(target_node, source_node) &&
-                       bn_type->can_have_arc(model, source_node, target_node)) {
+                       arc_mask.can_have_arc(source_collapsed, target_collapsed)) {
                 // Update flip arc: target_node -> source_node
-                auto parents_source = model.parents(source_node);
-                util::swap_remove_v(parents_source, target_node);
-
-                parents.push_back(source_node);
-                double d = score.local_score(model, source_node, parents_source) +
-                           score.local_score(model, target_node, parents) -
-                           this->m_local_cache->local_score(model, source_node) -
-                           this->m_local_cache->local_score(model, target_node);
-                parents.pop_back();
-                delta(source_collapsed, target_collapsed) = d;
-            } else if (bn_type->can_have_arc(model, source_node, target_node)) {
+                updates.push_back(ArcDeltaUpdate{Kind::Flip,
+                                                 source_node,
+                                                 target_node,
+                                                 parents_with(parents, source_node),
+                                                 source_collapsed,
+                                                 target_collapsed,
+                                                 false,
+                                                 -1,
+                                                 -1,
+                                                 0,
+                                                 0,
+                                                 0});
+            } else if (arc_mask.can_have_arc(source_collapsed, target_collapsed)) {
                 // Update add arc: source_node -> target_node
-                parents.push_back(source_node);
-                double d = score.local_score(model, target_node, parents) -
-                           this->m_local_cache->local_score(model, target_node);
-                parents.pop_back();
-                delta(source_collapsed, target_collapsed) = d;
+                updates.push_back(ArcDeltaUpdate{Kind::Add,
+                                                 source_node,
+                                                 target_node,
+                                                 parents_with(parents, source_node),
+                                                 source_collapsed,
+                                                 target_collapsed,
+                                                 false,
+                                                 -1,
+                                                 -1,
+                                                 0,
+                                                 0,
+                                                 0});
             }
         }
     }
 }
 
-void ArcOperatorSet::update_scores(const BayesianNetworkBase& model,
-                                   const Score& score,
-                                   const std::vector<std::string>& variables) {
-    raise_uninitialized();
+template <typename IsValid>
+void collect_incoming_arcs_updates(const ConditionalBayesianNetworkBase& model,
+                                   const std::vector<int>& sources,
+                                   IsValid&& is_valid,
+                                   const ArcCompatibilityMask& arc_mask,
+                                   const std::string& target_node,
+                                   std::vector<ArcDeltaUpdate>& updates) {
+    using Kind = ArcDeltaUpdate::Kind;
 
-    if (owns_local_cache()) {
-        for (const auto& n : variables) {
-            m_local_cache->update_local_score(model, score, n);
+    int target_collapsed = model.collapsed_index(target_node);
+    auto parents = model.parents(target_node);
+
+    for (auto source_joint_collapsed : sources) {
+        const auto& source_node = model.joint_collapsed_name(source_joint_collapsed);
+
+        if (is_valid(source_joint_collapsed, target_collapsed)) {
+            if (model.has_arc(source_node, target_node)) {
+                // Update remove arc: source_node -> target_node
+                bool update_flip = false;
+                int target_joint_collapsed = -1;
+                int source_collapsed = -1;
+                if (!model.is_interface(source_node)) {
+                    // Update flip arc: source_node -> target_node
+                    target_joint_collapsed = model.joint_collapsed_index(target_node);
+                    source_collapsed = model.collapsed_index(source_node);
+                    update_flip = arc_mask.can_have_arc(target_joint_collapsed, source_collapsed) &&
+                                  is_valid(target_joint_collapsed, source_collapsed);
+                }
+
+                updates.push_back(ArcDeltaUpdate{Kind::Remove,
+                                                 source_node,
+                                                 target_node,
+                                                 parents_without(parents, source_node),
+                                                 source_joint_collapsed,
+                                                 target_collapsed,
+                                                 update_flip,
+                                                 target_joint_collapsed,
+                                                 source_collapsed,
+                                                 0,
+                                                 0,
+                                                 0});
+            } else if (!model.is_interface(source_node) && model.has_arc(target_node, source_node) &&
+                       arc_mask.can_have_arc(source_joint_collapsed, target_collapsed)) {
+                // Update flip arc: target_node -> source_node
+                updates.push_back(ArcDeltaUpdate{Kind::Flip,
+                                                 source_node,
+                                                 target_node,
+                                                 parents_with(parents, source_node),
+                                                 source_joint_collapsed,
+                                                 target_collapsed,
+                                                 false,
+                                                 -1,
+                                                 -1,
+                                                 0,
+                                                 0,
+                                                 0});
+            } else if (arc_mask.can_have_arc(source_joint_collapsed, target_collapsed)) {
+                // Update add arc: source_node -> target_node
+                updates.push_back(ArcDeltaUpdate{Kind::Add,
+                                                 source_node,
+                                                 target_node,
+                                                 parents_with(parents, source_node),
+                                                 source_joint_collapsed,
+                                                 target_collapsed,
+                                                 false,
+                                                 -1,
+                                                 -1,
+                                                 0,
+                                                 0,
+                                                 0});
+            }
         }
     }
+}
 
-    for (const auto& n : variables) {
-        update_incoming_arcs_scores(model, score, n);
+void compute_delta_update(const BayesianNetworkBase& model,
+                          const Score& score,
+                          LocalScoreCache& local_cache,
+                          ArcDeltaUpdate& update) {
+    switch (update.kind) {
+        case ArcDeltaUpdate::Kind::Remove: {
+            double d = update.target_score - local_cache.local_score(model, update.target);
+            update.delta = d;
+
+            if (update.update_reverse) {
+                auto parents_source = parents_with(model.parents(update.source), update.target);
+                update.reverse_delta = d + local_cache.memo().local_score(model, score, update.source, parents_source) -
+                                       local_cache.local_score(model, update.source);
+            }
+            break;
+        }
+        case ArcDeltaUpdate::Kind::Flip: {
+            auto parents_source = parents_without(model.parents(update.source), update.target);
+
+            update.delta = local_cache.memo().local_score(model, score, update.source, parents_source) +
+                           update.target_score -
+                           local_cache.local_score(model, update.source) -
+                           local_cache.local_score(model, update.target);
+            break;
+        }
+        case ArcDeltaUpdate::Kind::Add: {
+            update.delta = update.target_score - local_cache.local_score(model, update.target);
+            break;
+        }
     }
 }
 
-void ArcOperatorSet::update_incoming_arcs_scores(const ConditionalBayesianNetworkBase& model,
+template <typename M>
+void ArcOperatorSet::update_incoming_arcs_scores(const M& model,
                                                  const Score& score,
-                                                 const std::string& target_node) {
-    auto target_collapsed = model.collapsed_index(target_node);
-    auto parents = model.parents(target_node);
+                                                 const std::vector<std::string>& target_nodes) {
+    std::vector<ArcDeltaUpdate> updates;
+    // AddArc operators not sampled in this update, or that cannot improve the score (see Score::add_parent_bound()).
+    // They are not selected until they are updated again.
+    std::vector<std::pair<int, int>> not_sampled;
+    // Each batch is a range [begin, end) of updates with the same target node. The updates of a target are split in
+    // m_num_threads batches, so the work is distributed between the threads even if there is only one target node.
+    std::vector<std::pair<int, int>> batches;
+    for (const auto& target_node : target_nodes) {
+        int begin = static_cast<int>(updates.size());
+        auto target_collapsed = model.collapsed_index(target_node);
+        collect_incoming_arcs_updates(
+            model,
+            sources(target_collapsed, num_sources(model)),
+            [this](int source, int target) { return is_valid(source, target); },
+            m_arc_mask,
+            target_node,
+            updates);
+
+        std::optional<std::mt19937> rng;
+        if (samples_neighborhood()) rng = sampling_rng(target_collapsed);
+        std::bernoulli_distribution sampled(m_sample_ratio);
+
+        auto parents_target = model.parents(target_node);
+        double target_cached_score = m_local_cache->local_score(model, target_node);
+
+        auto kept = begin;
+        for (int i = begin, end = static_cast<int>(updates.size()); i < end; ++i) {
+            if (updates[i].kind == ArcDeltaUpdate::Kind::Add &&
+                ((rng && !sampled(*rng)) ||
+                 cannot_improve(
+                     model, score, updates[i].source, target_node, parents_target, target_cached_score))) {
+                not_sampled.emplace_back(updates[i].row, updates[i].col);
+            } else {
+                if (kept != i) updates[kept] = std::move(updates[i]);
+                ++kept;
+            }
+        }
+        updates.erase(updates.begin() + kept, updates.end());
 
-    auto bn_type = model.type();
-    for (const auto& source_node : model.joint_nodes()) {
-        auto source_joint_collapsed = model.joint_collapsed_index(source_node);
+        int end = static_cast<int>(updates.size());
 
-        if (valid_op(source_joint_collapsed, target_collapsed)) {
-            if (model.has_arc(source_node, target_node)) {
-                // Update remove arc: source_node -> target_node
-                util::swap_remove_v(parents, source_node);
-                double d = score.local_score(model, target_node, parents) -
-                           this->m_local_cache->local_score(model, target_node);
-                parents.push_back(source_node);
-                delta(source_joint_collapsed, target_collapsed) = d;
+        int batch_size = (end - begin + m_num_threads - 1) / m_num_threads;
+        for (int batch_begin = begin; batch_begin < end; batch_begin += batch_size) {
+            batches.emplace_back(batch_begin, std::min(batch_begin + batch_size, end));
+        }
+    }
 
-                if (!model.is_interface(source_node) && bn_type->can_have_arc(model, target_node, source_node)) {
-                    // Update flip arc: source_node -> target_node
-                    int target_joint_collapsed = model.joint_collapsed_index(target_node);
-                    int source_collapsed = model.collapsed_index(source_node);
+    util::parallel_for(0, static_cast<int>(batches.size()), m_num_threads, [&](int b, int) {
+        auto [begin, end] = batches[b];
 
-                    if (valid_op(target_joint_collapsed, source_collapsed)) {
-                        auto parents_source = model.parents(source_node);
-                        parents_source.push_back(target_node);
+        std::vector<std::vector<std::string>> parents_sets;
+        parents_sets.reserve(end - begin);
+        for (int i = begin; i < end; ++i) {
+            parents_sets.push_back(std::move(updates[i].parents_target));
+        }
 
-                        delta(target_joint_collapsed, source_collapsed) =
-                            d + score.local_score(model, source_node, parents_source) -
-                            this->m_local_cache->local_score(model, source_node);
-                    }
-                }
-            } else if (!model.is_interface(source_node) && model.has_arc(target_node, source_node) &&
-                       bn_type->can_have_arc(model, source_node, target_node)) {
-                // Update flip arc: target_node -> source_node
-                auto parents_source = model.parents(source_node);
-                util::swap_remove_v(parents_source, target_node);
-
-                parents.push_back(source_node);
-                double d = score.local_score(model, source_node, parents_source) +
-                           score.local_score(model, target_node, parents) -
-                           this->m_local_cache->local_score(model, source_node) -
-                           this->m_local_cache->local_score(model, target_node);
-                parents.pop_back();
-                delta(source_joint_collapsed, target_collapsed) = d;
-            } else if (bn_type->can_have_arc(model, source_node, target_node)) {
-                // Update add arc: source_node -> target_node
-                parents.push_back(source_node);
-                double d = score.local_score(model, target_node, parents) -
-                           this->m_local_cache->local_score(model, target_node);
-                parents.pop_back();
-                delta(source_joint_collapsed, target_collapsed) = d;
-            }
+        auto target_scores = [&]() {
+            util::ProfileScope profile([&score] { return "local_score:" + score.ToString(); }, parents_sets.size());
+            return score.local_scores(model, updates[begin].target, parents_sets);
+        }();
+        m_local_cache->memo().add_evaluations(parents_sets.size());
+
+        for (int i = begin; i < end; ++i) {
+            updates[i].target_score = target_scores[i - begin];
+            compute_delta_update(model, score, *this->m_local_cache, updates[i]);
+        }
+    });
+
+    for (const auto& [source, target] : not_sampled) {
+        delta(row(source, target), target) = std::numeric_limits<double>::lowest();
+        m_dirty_targets[target] = true;
+    }
+
+    for (const auto& update : updates) {
+        delta(row(update.row, update.col), update.col) = update.delta;
+        m_dirty_targets[update.col] = true;
+
+        if (update.update_reverse) {
+            delta(row(update.reverse_row, update.reverse_col), update.reverse_col) = update.reverse_delta;
+            m_dirty_targets[update.reverse_col] = true;
         }
     }
 }
 
-void ArcOperatorSet::update_scores(const ConditionalBayesianNetworkBase& model,
+void ArcOperatorSet::update_incoming_arcs_scores(const BayesianNetworkBase& model,
+                                                 const Score& score,
+                                                 const std::string& target_node) {
+    update_incoming_arcs_scores(model, score, std::vector<std::string>{target_node});
+}
+
+void ArcOperatorSet::update_incoming_arcs_scores(const ConditionalBayesianNetworkBase& model,
+                                                 const Score& score,
+                                                 const std::string& target_node) {
+    update_incoming_arcs_scores(model, score, std::vector<std::string>{target_node});
+}
+
+void ArcOperatorSet::update_scores(const BayesianNetworkBase& model,
                                    const Score& score,
                                    const std::vector<std::string>& variables) {
     raise_uninitialized();
@@ -431,9 +813,25 @@ void ArcOperatorSet::update_scores(const ConditionalBayesianNetworkBase& model,
         }
     }
 
-    for (const auto& n : variables) {
-        update_incoming_arcs_scores(model, score, n);
+    // The node types of variables could have changed.
+    m_arc_mask.update(model);
+    update_incoming_arcs_scores(model, score, variables);
+}
+
+void ArcOperatorSet::update_scores(const ConditionalBayesianNetworkBase& model,
+                                   const Score& score,
+                                   const std::vector<std::string>& variables) {
+    raise_uninitialized();
+
+    if (owns_local_cache()) {
+        for (const auto& n : variables) {
+            m_local_cache->update_local_score(model, score, n);
+        }
     }
+
+    // The node types of variables could have changed.
+    m_arc_mask.update(model);
+    update_incoming_arcs_scores(model, score, variables);
 }
 
 void ChangeNodeTypeSet::cache_scores(const BayesianNetworkBase& model, const Score& score) {
@@ -480,8 +878,9 @@ void ChangeNodeTypeSet::cache_scores(const BayesianNetworkBase& model, const Sco
 
                 if (not_blacklisted && bn_type->compatible_node_type(model, collapsed_name, alt_node_types[k])) {
                     auto parents = model.parents(collapsed_name);
-                    delta.back()(k) =
-                        score.local_score(model, alt_node_types[k], collapsed_name, parents) - current_score;
+                    auto alt_score =
+                        m_local_cache->memo().local_score(model, score, alt_node_types[k], collapsed_name, parents);
+                    delta.back()(k) = alt_score - current_score;
                 } else {
                     delta.back()(k) = std::numeric_limits<double>::lowest();
                 }
@@ -590,7 +989,8 @@ void ChangeNodeTypeSet::update_scores(const BayesianNetworkBase& model,
 
             if (bn_type->compatible_node_type(model, n, alt_node_types[k]) && not_blacklisted) {
                 auto parents = model.parents(n);
-                delta[collapsed_index](k) = score.local_score(model, alt_node_types[k], n, parents) - current_score;
+                delta[collapsed_index](k) =
+                    m_local_cache->memo().local_score(model, score, alt_node_types[k], n, parents) - current_score;
             } else {
                 delta[collapsed_index](k) = std::numeric_limits<double>::lowest();
             }
@@ -598,4 +998,180 @@ void ChangeNodeTypeSet::update_scores(const BayesianNetworkBase& model,
     }
 }
 
+LocalScoreMemo::LocalScoreMemo(std::shared_ptr<Score> score, size_t max_memory)
+    : m_mutex(),
+      m_score(score.get()),
+      m_score_holder(score),
+      m_score_name(),
+      m_adopts_score(false),
+      m_max_memory(max_memory) {
+    if (!score) throw std::invalid_argument("The score of a LocalScoreMemo can not be null.");
+}
+
+void LocalScoreMemo::copy(const LocalScoreMemo& other) {
+    m_score = other.m_score;
+    m_score_holder = other.m_score_holder;
+    m_score_name = other.m_score_name;
+    m_adopts_score = other.m_adopts_score;
+    m_max_memory = other.m_max_memory;
+    m_evaluations = other.m_evaluations.load();
+
+    clear_unlocked();
+    // Inserts from the least recently used, so the order of the entries is preserved.
+    for (auto it = other.m_entries.rbegin(), end = other.m_entries.rend(); it != end; ++it) {
+        auto key = it->first;
+        insert_unlocked(other.m_node_types.at(key.node_type), std::move(key), it->second);
+    }
+}
+
+void LocalScoreMemo::bind(std::shared_ptr<Score> score) {
+    if (!score) throw std::invalid_argument("The score of a LocalScoreMemo can not be null.");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto score_name = m_score_holder ? m_score_holder->ToString() : m_score_name;
+    if (!score_name.empty() && score_name != score->ToString())
+        throw std::invalid_argument("The LocalScoreMemo was created with a " + score_name +
+                                    " score, but it is bound to a " + score->ToString() + " score.");
+
+    for (const auto& entry : m_entries) {
+        if (!score->has_variables(entry.first.variable) || !score->has_variables(entry.first.parents))
+            throw std::invalid_argument("The score does not have the variables of the LocalScoreMemo.");
+    }
+
+    m_score = score.get();
+    m_score_holder = score;
+    m_score_name.clear();
+    m_adopts_score = false;
+}
+
+void LocalScoreMemo::check_score(const Score& score) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_adopts_score) return;
+
+    if (!m_score)
+        throw std::invalid_argument("The LocalScoreMemo is not bound to a score. Call bind() before using it.");
+    if (m_score != &score) throw std::invalid_argument("The LocalScoreMemo is bound to a different score.");
+}
+
+size_t LocalScoreMemo::entry_memory(const Key& key) {
+    // Nodes of the list and the hash table, and the memory of the key strings.
+    size_t memory = sizeof(Entry) + 2 * sizeof(void*) + sizeof(std::reference_wrapper<const Key>) +
+                    sizeof(EntryList::iterator) + 3 * sizeof(void*);
+    memory += key.variable.capacity();
+    memory += key.parents.capacity() * sizeof(std::string);
+    for (const auto& p : key.parents) memory += p.capacity();
+    return memory;
+}
+
+void LocalScoreMemo::clear_unlocked() {
+    m_index.clear();
+    m_entries.clear();
+    m_node_types.clear();
+    m_memory = 0;
+}
+
+bool LocalScoreMemo::compatible_unlocked(const Score& score) const {
+    if (m_score_name != score.ToString()) return false;
+
+    for (const auto& entry : m_entries) {
+        if (!score.has_variables(entry.first.variable) || !score.has_variables(entry.first.parents)) return false;
+    }
+
+    return true;
+}
+
+bool LocalScoreMemo::accepts_score(const Score& score) {
+    if (m_score == &score) return true;
+
+    if (m_adopts_score) {
+        // The memoized scores belong to another score. The memoized scores of an unbound memo loaded from a file (e.g.,
+        // the memo of a checkpoint) are kept for the first score if it is compatible.
+        if (m_score || !compatible_unlocked(score)) clear_unlocked();
+        m_score = &score;
+        m_score_name = score.ToString();
+        return true;
+    }
+
+    return false;
+}
+
+void LocalScoreMemo::insert_unlocked(const std::shared_ptr<FactorType>& node_type, Key&& key, double s) {
+    if (m_index.count(std::cref(key)) > 0) return;
+
+    auto memory = entry_memory(key);
+    if (memory > m_max_memory) return;
+
+    m_node_types.emplace(key.node_type, node_type);
+    m_entries.emplace_front(std::move(key), s);
+    m_index.emplace(std::cref(m_entries.front().first), m_entries.begin());
+    m_memory += memory;
+
+    while (m_memory > m_max_memory) {
+        const auto& lru = m_entries.back();
+        m_memory -= entry_memory(lru.first);
+        m_index.erase(std::cref(lru.first));
+        m_entries.pop_back();
+    }
+}
+
+std::optional<double> LocalScoreMemo::find(const Score& score, const Key& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!accepts_score(score)) return std::nullopt;
+
+    auto f = m_index.find(std::cref(key));
+    if (f == m_index.end()) {
+        util::profile_count([] { return std::string("local_score_memo:miss"); });
+        return std::nullopt;
+    }
+
+    util::profile_count([] { return std::string("local_score_memo:hit"); });
+
+    // Moves the entry to the front, as the most recently used.
+    m_entries.splice(m_entries.begin(), m_entries, f->second);
+    return f->second->second;
+}
+
+void LocalScoreMemo::insert(const Score& score, const std::shared_ptr<FactorType>& node_type, Key&& key, double s) {
+    // The hash of a Python node type is the address of the object, which can be reused by other objects. Its local
+    // scores are not memoized.
+    if (node_type->is_python_derived()) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!accepts_score(score)) return;
+    insert_unlocked(node_type, std::move(key), s);
+}
+
+py::tuple LocalScoreMemo::__getstate__() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto score_name = m_score_holder ? m_score_holder->ToString() : m_score_name;
+
+    py::list entries;
+    for (auto it = m_entries.rbegin(), end = m_entries.rend(); it != end; ++it) {
+        const auto& key = it->first;
+        entries.append(py::make_tuple(key.variable, m_node_types.at(key.node_type), key.parents, it->second));
+    }
+
+    return py::make_tuple(score_name, m_max_memory, entries, m_adopts_score);
+}
+
+std::shared_ptr<LocalScoreMemo> LocalScoreMemo::__setstate__(py::tuple& t) {
+    if (t.size() != 3 && t.size() != 4) throw std::runtime_error("Not valid LocalScoreMemo.");
+
+    auto memo = std::make_shared<LocalScoreMemo>(t[1].cast<size_t>());
+    // A bound memo must be bound to a score again before it is used. An unbound memo adopts the first score used.
+    memo->m_adopts_score = t.size() == 4 && t[3].cast<bool>();
+    memo->m_score_name = t[0].cast<std::string>();
+
+    // The entries are saved from the least recently used.
+    for (auto entry : t[2].cast<py::list>()) {
+        auto e = entry.cast<py::tuple>();
+        auto node_type = e[1].cast<std::shared_ptr<FactorType>>();
+        Key key{e[0].cast<std::string>(), node_type->hash(), e[2].cast<std::vector<std::string>>()};
+        memo->insert_unlocked(node_type, std::move(key), e[3].cast<double>());
+    }
+
+    return memo;
+}
+
 }  // namespace learning::operators
@@ -1,10 +1,22 @@
 #ifndef PYBNESIAN_LEARNING_OPERATORS_OPERATORS_HPP
 #define PYBNESIAN_LEARNING_OPERATORS_OPERATORS_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <Eigen/Dense>
 #include <models/BayesianNetwork.hpp>
 #include <learning/scores/scores.hpp>
+#include <util/profiler.hpp>
 #include <util/vector.hpp>
+#include <util/parallel.hpp>
 
 using Eigen::MatrixXd, Eigen::VectorXd, Eigen::Matrix, Eigen::Dynamic;
 using MatrixXb = Matrix<bool, Dynamic, Dynamic>;
@@ -18,6 +30,9 @@ using util::ArcStringVector, util::FactorTypeVector;
 
 namespace learning::operators {
 
+// The candidate parents of each node.
+using CandidateParents = std::unordered_map<std::string, std::vector<std::string>>;
+
 class Operator {
 public:
     Operator(double delta) : m_delta(delta) {}
@@ -255,56 +270,300 @@ public:
     }
 };
 
+enum class ArcOperatorType { AddArc, RemoveArc, FlipArc };
+
+// Lightweight description of an AddArc, RemoveArc or FlipArc operator. It does not own the node names, so an
+// OperatorTabuSet can be queried without creating an Operator.
+struct ArcOperatorKey {
+    ArcOperatorType type;
+    std::string_view source;
+    std::string_view target;
+
+    bool operator==(const ArcOperatorKey& other) const {
+        return type == other.type && source == other.source && target == other.target;
+    }
+};
+
+class HashArcOperatorKey {
+public:
+    inline std::size_t operator()(const ArcOperatorKey& key) const {
+        size_t seed = static_cast<size_t>(key.type);
+        util::hash_combine(seed, key.source);
+        util::hash_combine(seed, key.target);
+        return seed;
+    }
+};
+
 class OperatorTabuSet {
 public:
-    OperatorTabuSet() : m_set() {}
+    OperatorTabuSet() : m_set(), m_arc_keys() {}
 
-    OperatorTabuSet(const OperatorTabuSet& other) : m_set() {
+    OperatorTabuSet(const OperatorTabuSet& other) : m_set(), m_arc_keys() {
         for (const auto& op : other.m_set) {
-            m_set.insert(op);
+            insert(op);
         }
     }
 
     OperatorTabuSet& operator=(const OperatorTabuSet& other) {
         clear();
         for (const auto& op : other.m_set) {
-            m_set.insert(op);
+            insert(op);
         }
 
         return *this;
     }
 
-    OperatorTabuSet(OperatorTabuSet&& other) : m_set(std::move(other.m_set)) {}
+    // The keys point to the names owned by the operators, which are not moved.
+    OperatorTabuSet(OperatorTabuSet&& other)
+        : m_set(std::move(other.m_set)), m_arc_keys(std::move(other.m_arc_keys)) {}
     OperatorTabuSet& operator=(OperatorTabuSet&& other) {
         m_set = std::move(other.m_set);
+        m_arc_keys = std::move(other.m_arc_keys);
         return *this;
     }
 
-    void insert(const std::shared_ptr<Operator>& op) { m_set.insert(op); }
+    void insert(const std::shared_ptr<Operator>& op) {
+        if (m_set.insert(op).second) {
+            if (auto key = arc_key(*op)) m_arc_keys.insert(*key);
+        }
+    }
 
     bool contains(const std::shared_ptr<Operator>& op) const { return m_set.count(op) > 0; }
-    void clear() { m_set.clear(); }
+
+    // Equivalent to contains() with an AddArc, RemoveArc or FlipArc operator, but without allocating it.
+    bool contains_arc(ArcOperatorType type, const std::string& source, const std::string& target) const {
+        if (m_set.empty()) return false;
+
+        // If some operators are not arc operators (e.g. Python-derived), they could compare equal to an arc operator.
+        if (m_arc_keys.size() != m_set.size()) {
+            return contains(make_arc_operator(type, source, target));
+        }
+
+        return m_arc_keys.count(ArcOperatorKey{type, source, target}) > 0;
+    }
+
+    void clear() {
+        m_set.clear();
+        m_arc_keys.clear();
+    }
     bool empty() const { return m_set.empty(); }
+    std::vector<std::shared_ptr<Operator>> operators() const { return {m_set.begin(), m_set.end()}; }
 
 private:
+    static std::optional<ArcOperatorKey> arc_key(const Operator& op) {
+        if (op.is_python_derived()) return std::nullopt;
+
+        if (auto add = dynamic_cast<const AddArc*>(&op)) {
+            return ArcOperatorKey{ArcOperatorType::AddArc, add->source(), add->target()};
+        } else if (auto remove = dynamic_cast<const RemoveArc*>(&op)) {
+            return ArcOperatorKey{ArcOperatorType::RemoveArc, remove->source(), remove->target()};
+        } else if (auto flip = dynamic_cast<const FlipArc*>(&op)) {
+            return ArcOperatorKey{ArcOperatorType::FlipArc, flip->source(), flip->target()};
+        }
+
+        return std::nullopt;
+    }
+
+    static std::shared_ptr<Operator> make_arc_operator(ArcOperatorType type,
+                                                       const std::string& source,
+                                                       const std::string& target) {
+        switch (type) {
+            case ArcOperatorType::AddArc:
+                return std::make_shared<AddArc>(source, target, 0);
+            case ArcOperatorType::RemoveArc:
+                return std::make_shared<RemoveArc>(source, target, 0);
+            case ArcOperatorType::FlipArc:
+                return std::make_shared<FlipArc>(source, target, 0);
+            default:
+                throw std::invalid_argument("Unreachable code: wrong ArcOperatorType.");
+        }
+    }
+
     using SetType = std::unordered_set<std::shared_ptr<Operator>, HashOperator, OperatorPtrEqual>;
 
     SetType m_set;
+    std::unordered_set<ArcOperatorKey, HashArcOperatorKey> m_arc_keys;
+};
+
+// Memoizes the local scores computed by a Score, keyed by (variable, node type, parents). The parents are part of the
+// key in the given order, so a memoized score is always identical to the score that would be computed.
+//
+// A memo can be bound to a score: it keeps the score alive and it only memoizes the local scores of that score, so it
+// can be reused between many learning runs. An unbound memo adopts the last score used and it is cleared when the score
+// changes. An unbound memo loaded from a file keeps its local scores if the first score used has the same
+// Score::ToString() and variables. The least recently used local scores are evicted when the memory of the memo
+// exceeds max_memory().
+class LocalScoreMemo {
+public:
+    static constexpr size_t default_max_memory = 64 * 1024 * 1024;
+
+    LocalScoreMemo(size_t max_memory = default_max_memory)
+        : m_mutex(),
+          m_score(nullptr),
+          m_score_holder(),
+          m_score_name(),
+          m_adopts_score(true),
+          m_max_memory(max_memory) {}
+    LocalScoreMemo(std::shared_ptr<Score> score, size_t max_memory = default_max_memory);
+
+    LocalScoreMemo(const LocalScoreMemo& other) {
+        std::lock_guard<std::mutex> lock(other.m_mutex);
+        copy(other);
+    }
+
+    LocalScoreMemo& operator=(const LocalScoreMemo& other) {
+        if (this != &other) {
+            std::scoped_lock lock(m_mutex, other.m_mutex);
+            copy(other);
+        }
+        return *this;
+    }
+
+    // Returns score.local_score(model, node_type, variable, parents).
+    double local_score(const BayesianNetworkBase& model,
+                       const Score& score,
+                       const std::shared_ptr<FactorType>& node_type,
+                       const std::string& variable,
+                       const std::vector<std::string>& parents) {
+        Key key{variable, node_type->hash(), parents};
+        if (auto memo = find(score, key)) return *memo;
+
+        auto s = [&]() {
+            util::ProfileScope profile([&score] { return "local_score:" + score.ToString(); });
+            return score.local_score(model, node_type, variable, parents);
+        }();
+        add_evaluations(1);
+        insert(score, node_type, std::move(key), s);
+        return s;
+    }
+
+    // Returns score.local_score(model, variable, parents), which uses the node type of variable in model.
+    double local_score(const BayesianNetworkBase& model,
+                       const Score& score,
+                       const std::string& variable,
+                       const std::vector<std::string>& parents) {
+        const auto& node_type = model.node_type(variable);
+        Key key{variable, node_type->hash(), parents};
+        if (auto memo = find(score, key)) return *memo;
+
+        auto s = [&]() {
+            util::ProfileScope profile([&score] { return "local_score:" + score.ToString(); });
+            return score.local_score(model, variable, parents);
+        }();
+        add_evaluations(1);
+        insert(score, node_type, std::move(key), s);
+        return s;
+    }
+
+    // Binds the memo to score. A memo loaded from a file must be bound to a score (with the same data) before it is
+    // used, because the scores are not saved with the memo.
+    void bind(std::shared_ptr<Score> score);
+    const Score* score() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_score;
+    }
+    // Throws if the memo is bound to a score different from score.
+    void check_score(const Score& score) const;
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+    // Approximate memory (in bytes) used by the memoized local scores.
+    size_t memory() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_memory;
+    }
+    size_t max_memory() const { return m_max_memory; }
+
+    // Number of local scores computed through the memo, including the local scores that were not memoized, and the
+    // local scores computed in batches by the operator sets (see add_evaluations()).
+    int64_t evaluations() const { return m_evaluations; }
+    void add_evaluations(int64_t n) { m_evaluations += n; }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        clear_unlocked();
+    }
+
+    void save(const std::string name) const { util::save_object(*this, name); }
+
+    py::tuple __getstate__() const;
+    static std::shared_ptr<LocalScoreMemo> __setstate__(py::tuple& t);
+    static std::shared_ptr<LocalScoreMemo> __setstate__(py::tuple&& t) { return __setstate__(t); }
+
+private:
+    struct Key {
+        std::string variable;
+        std::size_t node_type;
+        std::vector<std::string> parents;
+
+        bool operator==(const Key& other) const {
+            return node_type == other.node_type && variable == other.variable && parents == other.parents;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            size_t seed = key.node_type;
+            util::hash_combine(seed, key.variable);
+            for (const auto& p : key.parents) util::hash_combine(seed, p);
+            return seed;
+        }
+    };
+
+    struct KeyEqual {
+        bool operator()(const Key& a, const Key& b) const { return a == b; }
+    };
+
+    using Entry = std::pair<Key, double>;
+    using EntryList = std::list<Entry>;
+
+    static size_t entry_memory(const Key& key);
+    void copy(const LocalScoreMemo& other);
+    void clear_unlocked();
+    // Returns true if the local scores of score can be memoized.
+    bool accepts_score(const Score& score);
+    // Returns true if the memoized local scores can belong to score.
+    bool compatible_unlocked(const Score& score) const;
+    void insert_unlocked(const std::shared_ptr<FactorType>& node_type, Key&& key, double s);
+
+    std::optional<double> find(const Score& score, const Key& key);
+    void insert(const Score& score, const std::shared_ptr<FactorType>& node_type, Key&& key, double s);
+
+    mutable std::mutex m_mutex;
+    const Score* m_score;
+    std::shared_ptr<Score> m_score_holder;
+    // Score::ToString() of the score of a memo loaded from a file or of the score adopted by an unbound memo.
+    std::string m_score_name;
+    bool m_adopts_score;
+    size_t m_max_memory;
+    size_t m_memory = 0;
+    // The most recently used local scores are at the front.
+    EntryList m_entries;
+    std::unordered_map<std::reference_wrapper<const Key>, EntryList::iterator, KeyHash, KeyEqual> m_index;
+    // Node types of the keys, to save the memo.
+    std::unordered_map<std::size_t, std::shared_ptr<FactorType>> m_node_types;
+    std::atomic<int64_t> m_evaluations{0};
 };
 
 class LocalScoreCache {
 public:
-    LocalScoreCache() : m_local_score() {}
-    LocalScoreCache(const BayesianNetworkBase& m) : m_local_score(m.num_nodes()) {}
+    LocalScoreCache() : m_local_score(), m_memo(std::make_shared<LocalScoreMemo>()) {}
+    // If memo is null, the cache creates its own memo.
+    LocalScoreCache(const BayesianNetworkBase& m, std::shared_ptr<LocalScoreMemo> memo = nullptr)
+        : m_local_score(m.num_nodes()), m_memo(memo ? memo : std::make_shared<LocalScoreMemo>()) {}
 
-    void cache_local_scores(const BayesianNetworkBase& model, const Score& score) {
+    void cache_local_scores(const BayesianNetworkBase& model, const Score& score, int num_threads = 1) {
         if (m_local_score.rows() != model.num_nodes()) {
             m_local_score = VectorXd(model.num_nodes());
         }
 
-        for (const auto& node : model.nodes()) {
-            m_local_score(model.collapsed_index(node)) = score.local_score(model, node);
-        }
+        const auto& nodes = model.nodes();
+        util::parallel_for(0, static_cast<int>(nodes.size()), num_threads, [&](int i, int) {
+            m_local_score(model.collapsed_index(nodes[i])) =
+                m_memo->local_score(model, score, nodes[i], model.parents(nodes[i]));
+        });
     }
 
     void cache_vlocal_scores(const BayesianNetworkBase& model, const ValidatedScore& score) {
@@ -312,18 +571,21 @@ public:
             m_local_score = VectorXd(model.num_nodes());
         }
 
+        util::ProfileScope profile([&score] { return "vlocal_score:" + score.ToString(); }, model.num_nodes());
         for (const auto& node : model.nodes()) {
             m_local_score(model.collapsed_index(node)) = score.vlocal_score(model, node);
         }
     }
 
     void update_local_score(const BayesianNetworkBase& model, const Score& score, const std::string& variable) {
-        m_local_score(model.collapsed_index(variable)) = score.local_score(model, variable);
+        m_local_score(model.collapsed_index(variable)) =
+            m_memo->local_score(model, score, variable, model.parents(variable));
     }
 
     void update_vlocal_score(const BayesianNetworkBase& model,
                              const ValidatedScore& score,
                              const std::string& variable) {
+        util::ProfileScope profile([&score] { return "vlocal_score:" + score.ToString(); });
         m_local_score(model.collapsed_index(variable)) = score.vlocal_score(model, variable);
     }
 
@@ -333,15 +595,22 @@ public:
         return m_local_score(model.collapsed_index(name));
     }
 
+    // Memo of the local scores shared by all the operator sets that use this cache (e.g., the operator sets of an
+    // OperatorPool), so a local score computed by one of them is not computed again by the others.
+    LocalScoreMemo& memo() { return *m_memo; }
+
 private:
     VectorXd m_local_score;
+    std::shared_ptr<LocalScoreMemo> m_memo;
 };
 
 class OperatorSet {
 public:
-    OperatorSet() : m_local_cache(nullptr), m_owns_local_cache(false) {}
+    OperatorSet() : m_local_cache(nullptr), m_owns_local_cache(false), m_local_memo(nullptr) {}
     virtual ~OperatorSet() {}
     virtual bool is_python_derived() const { return false; }
+    // Returns true if this operator set is (or contains) a Python-derived operator set.
+    virtual bool has_python_derived() const { return is_python_derived(); }
     virtual void cache_scores(const BayesianNetworkBase&, const Score&) = 0;
     virtual std::shared_ptr<Operator> find_max(const BayesianNetworkBase&) const = 0;
     virtual std::shared_ptr<Operator> find_max(const BayesianNetworkBase&, const OperatorTabuSet&) const = 0;
@@ -354,6 +623,25 @@ public:
                                const Score&,
                                const std::vector<std::string>&) = 0;
 
+    // Returns up to max_operators operators with pairwise-disjoint nodes_changed(), in descending order of delta. The
+    // first operator is find_max(model, tabu_set) and the other operators have a delta greater than min_delta. Each
+    // operator is valid in model, but the operators are not checked together (e.g., two AddArc can create a cycle).
+    // The default implementation only returns find_max(model, tabu_set).
+    virtual std::vector<std::shared_ptr<Operator>> find_max_batch(const BayesianNetworkBase& model,
+                                                                  const OperatorTabuSet& tabu_set,
+                                                                  int,
+                                                                  double) const {
+        if (auto op = find_max(model, tabu_set)) return {op};
+        return {};
+    }
+    virtual std::vector<std::shared_ptr<Operator>> find_max_batch(const ConditionalBayesianNetworkBase& model,
+                                                                  const OperatorTabuSet& tabu_set,
+                                                                  int,
+                                                                  double) const {
+        if (auto op = find_max(model, tabu_set)) return {op};
+        return {};
+    }
+
     void set_local_score_cache(std::shared_ptr<LocalScoreCache> score_cache) {
         m_local_cache = score_cache;
         m_owns_local_cache = false;
@@ -361,12 +649,21 @@ public:
 
     std::shared_ptr<LocalScoreCache> local_score_cache() { return m_local_cache; }
 
+    // Sets the memo of local scores used by the local cache created in cache_scores(). It is reset in finished().
+    void set_local_score_memo(std::shared_ptr<LocalScoreMemo> memo) { m_local_memo = memo; }
+
     virtual void set_arc_blacklist(const ArcStringVector&){};
     virtual void set_arc_whitelist(const ArcStringVector&){};
     virtual void set_max_indegree(int){};
     virtual void set_type_blacklist(const FactorTypeVector&){};
     virtual void set_type_whitelist(const FactorTypeVector&){};
-    virtual void finished() { m_local_cache = nullptr; }
+    virtual void set_num_threads(int){};
+    virtual void set_neighborhood_sampling(double, unsigned int){};
+    virtual void set_candidate_parents(const CandidateParents&){};
+    virtual void finished() {
+        m_local_cache = nullptr;
+        m_local_memo = nullptr;
+    }
 
     static std::shared_ptr<OperatorSet>& keep_python_alive(std::shared_ptr<OperatorSet>& op_set) {
         if (op_set && op_set->is_python_derived()) {
@@ -417,7 +714,7 @@ protected:
     template <typename M>
     void initialize_local_cache(M& model) {
         if (!this->m_local_cache) {
-            m_local_cache = std::make_shared<LocalScoreCache>(model);
+            m_local_cache = std::make_shared<LocalScoreCache>(model, m_local_memo);
             m_owns_local_cache = true;
         }
     }
@@ -430,6 +727,38 @@ protected:
 
     std::shared_ptr<LocalScoreCache> m_local_cache;
     bool m_owns_local_cache;
+    std::shared_ptr<LocalScoreMemo> m_local_memo;
+};
+
+// Caches BayesianNetworkType::can_have_arc() for each pair of source and target nodes, so the operator sets do not call
+// the network type for each operator they update. This avoids calling the Python overrides of the Python-derived
+// network types. The sources are the collapsed indices of the nodes (the joint collapsed indices in a conditional
+// Bayesian network), and the targets are the collapsed indices.
+//
+// The result of can_have_arc() is assumed to depend only on the nodes and their node types, so the entries of a node
+// are only computed again when its node type changes. All the entries are computed again if the network type or the
+// nodes change.
+class ArcCompatibilityMask {
+public:
+    ArcCompatibilityMask() : m_type(), m_sources(), m_targets(), m_target_sources(), m_source_types(), m_mask() {}
+
+    // Updates the entries of the nodes whose node type changed since the last update.
+    void update(const BayesianNetworkBase& model);
+    void update(const ConditionalBayesianNetworkBase& model);
+
+    bool can_have_arc(int source, int target) const { return m_mask(source, target); }
+
+private:
+    template <typename M>
+    void update(const M& model, const std::vector<std::string>& sources);
+
+    std::shared_ptr<models::BayesianNetworkType> m_type;
+    std::vector<std::string> m_sources;
+    std::vector<std::string> m_targets;
+    // The source index of each target node.
+    std::vector<int> m_target_sources;
+    std::vector<std::shared_ptr<FactorType>> m_source_types;
+    MatrixXb m_mask;
 };
 
 class ArcOperatorSet : public OperatorSet {
@@ -437,7 +766,20 @@ public:
     ArcOperatorSet(ArcStringVector blacklist = ArcStringVector(),
                    ArcStringVector whitelist = ArcStringVector(),
                    int indegree = 0)
-        : delta(), valid_op(), sorted_idx(), m_blacklist(blacklist), m_whitelist(whitelist), max_indegree(indegree) {}
+        : delta(),
+          valid_op(),
+          m_sorted_sources(),
+          m_dirty_targets(),
+          m_candidate_parents(),
+          m_candidates(),
+          m_blacklist(blacklist),
+          m_whitelist(whitelist),
+          max_indegree(indegree),
+          m_num_threads(1),
+          m_sample_ratio(1),
+          m_sample_seed(0),
+          m_sample_draws(),
+          m_arc_mask() {}
 
     void cache_scores(const BayesianNetworkBase& model, const Score& score) override;
     std::shared_ptr<Operator> find_max(const BayesianNetworkBase& model) const override;
@@ -461,6 +803,19 @@ public:
                                                 const OperatorTabuSet& tabu_set) const;
     void update_scores(const ConditionalBayesianNetworkBase&, const Score&, const std::vector<std::string>&) override;
 
+    std::vector<std::shared_ptr<Operator>> find_max_batch(const BayesianNetworkBase& model,
+                                                          const OperatorTabuSet& tabu_set,
+                                                          int max_operators,
+                                                          double min_delta) const override {
+        return find_max_batch<>(model, tabu_set, max_operators, min_delta);
+    }
+    std::vector<std::shared_ptr<Operator>> find_max_batch(const ConditionalBayesianNetworkBase& model,
+                                                          const OperatorTabuSet& tabu_set,
+                                                          int max_operators,
+                                                          double min_delta) const override {
+        return find_max_batch<>(model, tabu_set, max_operators, min_delta);
+    }
+
     void update_incoming_arcs_scores(const BayesianNetworkBase& model,
                                      const Score& score,
                                      const std::string& target_node);
@@ -477,70 +832,250 @@ public:
 
     void set_max_indegree(int indegree) override { max_indegree = indegree; }
 
+    void set_num_threads(int num_threads) override { m_num_threads = util::effective_num_threads(num_threads); }
+
+    // Each time the delta scores of a target node are computed, only a random sample (with probability ratio) of the
+    // AddArc operators is evaluated. The other AddArc operators of the target are not selected until its delta scores
+    // are computed again. The RemoveArc and FlipArc operators are always evaluated. A ratio of 1 evaluates all the
+    // operators.
+    void set_neighborhood_sampling(double ratio, unsigned int seed) override {
+        if (ratio <= 0 || ratio > 1) throw std::invalid_argument("The sampling ratio must be in the interval (0, 1].");
+        m_sample_ratio = ratio;
+        m_sample_seed = seed;
+    }
+
+    // Restricts the parents of each node to a set of candidate parents (e.g., selected with candidate_parents()). The
+    // delta scores are stored in a matrix with a row for each candidate instead of a row for each node, so the memory
+    // and the operators evaluated are O(n * K) for K candidates. The current parents of each node when the scores are
+    // cached are also candidates, so they can be removed. An empty map removes the restriction.
+    void set_candidate_parents(const CandidateParents& candidates) override { m_candidate_parents = candidates; }
+
 private:
+    template <typename M>
+    void update_incoming_arcs_scores(const M& model, const Score& score, const std::vector<std::string>& target_nodes);
+
+    bool samples_neighborhood() const { return m_sample_ratio < 1; }
+    // Returns the random generator of the next sample of the AddArc operators of target_collapsed. It only depends on
+    // the seed, the target and the number of previous samples of the target, so the sampling is independent of the
+    // number of threads.
+    std::mt19937 sampling_rng(int target_collapsed) {
+        std::seed_seq seq{m_sample_seed,
+                          static_cast<unsigned int>(target_collapsed),
+                          m_sample_draws[target_collapsed]++};
+        return std::mt19937(seq);
+    }
+
+    bool restricts_candidates() const { return !m_candidates.empty(); }
+    // Returns the row of delta of the operators of source -> target, or -1 if source is not a candidate of target.
+    int row(int source, int target) const {
+        if (!restricts_candidates()) return source;
+
+        const auto& candidates = m_candidates[target];
+        auto it = std::lower_bound(candidates.begin(), candidates.end(), source);
+        if (it == candidates.end() || *it != source) return -1;
+        return static_cast<int>(it - candidates.begin());
+    }
+    int row_source(int row, int target) const { return restricts_candidates() ? m_candidates[target][row] : row; }
+    bool is_valid(int source, int target) const {
+        auto r = row(source, target);
+        return r != -1 && valid_op(r, target);
+    }
+    void set_invalid(int source, int target) {
+        auto r = row(source, target);
+        if (r != -1) valid_op(r, target) = false;
+    }
+    double delta_value(int source, int target) const { return delta(row(source, target), target); }
+    // Returns the sources whose operators to target are stored: the candidates of target or all the num_sources nodes.
+    std::vector<int> sources(int target, int num_sources) const;
+    template <typename M>
+    void initialize_candidates(const M& model);
+
+    void initialize_sorted_sources();
+    void update_sorted_sources() const;
+    // Returns a function (source, target) -> operator that returns the valid operator between the collapsed source and
+    // target (or nullptr) in model.
+    template <bool limited_indegree>
+    auto arc_operator_check(const BayesianNetworkBase& model) const;
+    template <bool limited_indegree>
+    auto arc_operator_check(const ConditionalBayesianNetworkBase& model) const;
+    template <bool limited_indegree>
+    auto arc_operator_check(const BayesianNetworkBase& model, const OperatorTabuSet& tabu_set) const;
+    template <bool limited_indegree>
+    auto arc_operator_check(const ConditionalBayesianNetworkBase& model, const OperatorTabuSet& tabu_set) const;
+
+    enum class VisitResult { Next, SkipTarget, Stop };
+    // Calls visit(source, target) for each stored operator in descending order of delta until it returns Stop. If it
+    // returns SkipTarget, the rest of the operators of the target are not visited.
+    template <typename Visit>
+    void visit_ordered(Visit&& visit) const;
+    template <typename CheckOperator>
+    std::shared_ptr<Operator> find_max_ordered(CheckOperator&& check) const;
+    template <typename M, typename CheckOperator>
+    std::vector<std::shared_ptr<Operator>> find_batch_ordered(const M& model,
+                                                              CheckOperator&& check,
+                                                              int max_operators,
+                                                              double min_delta) const;
+    template <typename M>
+    std::vector<std::shared_ptr<Operator>> find_max_batch(const M& model,
+                                                          const OperatorTabuSet& tabu_set,
+                                                          int max_operators,
+                                                          double min_delta) const;
+
     MatrixXd delta;
     MatrixXb valid_op;
-    mutable std::vector<int> sorted_idx;
+    // For each target node (column of delta), the valid rows sorted by descending delta. Only the targets whose delta
+    // column changed are sorted again in find_max().
+    mutable std::vector<std::vector<int>> m_sorted_sources;
+    mutable std::vector<bool> m_dirty_targets;
+    CandidateParents m_candidate_parents;
+    // The sorted indices of the candidates of each target node (the source of each row of delta). If empty, the parents
+    // are not restricted and the rows of delta are the source nodes.
+    std::vector<std::vector<int>> m_candidates;
     ArcStringVector m_blacklist;
     ArcStringVector m_whitelist;
     int max_indegree;
+    int m_num_threads;
+    double m_sample_ratio;
+    unsigned int m_sample_seed;
+    std::vector<unsigned int> m_sample_draws;
+    ArcCompatibilityMask m_arc_mask;
 };
 
-template <bool limited_indegree>
-std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const BayesianNetworkBase& model) const {
-    auto delta_ptr = delta.data();
+template <typename Visit>
+void ArcOperatorSet::visit_ordered(Visit&& visit) const {
+    update_sorted_sources();
+
+    // Each heap entry is a (target, position) pair pointing to the best unvisited source of each target. The heap
+    // merges the sorted lists of each target, so the operators are visited in descending order of delta.
+    using HeapEntry = std::pair<int, int>;
+    auto heap_less = [this](const HeapEntry& a, const HeapEntry& b) {
+        auto row_a = m_sorted_sources[a.first][a.second];
+        auto row_b = m_sorted_sources[b.first][b.second];
+        auto delta_a = delta(row_a, a.first);
+        auto delta_b = delta(row_b, b.first);
+
+        if (delta_a != delta_b) return delta_a < delta_b;
+        // The rows of each target are sorted by source, so the ties are broken by (target, row).
+        return std::make_pair(a.first, row_a) > std::make_pair(b.first, row_b);
+    };
+
+    std::vector<HeapEntry> heap;
+    heap.reserve(m_sorted_sources.size());
+    for (int target = 0, end = static_cast<int>(m_sorted_sources.size()); target < end; ++target) {
+        if (!m_sorted_sources[target].empty()) heap.emplace_back(target, 0);
+    }
+
+    std::make_heap(heap.begin(), heap.end(), heap_less);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), heap_less);
+        auto& [target, position] = heap.back();
+
+        switch (visit(row_source(m_sorted_sources[target][position], target), target)) {
+            case VisitResult::Stop:
+                return;
+            case VisitResult::SkipTarget:
+                heap.pop_back();
+                continue;
+            case VisitResult::Next:
+                break;
+        }
 
-    // TODO: Not checking sorted_idx empty
-    std::sort(
-        sorted_idx.begin(), sorted_idx.end(), [&delta_ptr](auto i1, auto i2) { return delta_ptr[i1] > delta_ptr[i2]; });
+        if (++position < static_cast<int>(m_sorted_sources[target].size())) {
+            std::push_heap(heap.begin(), heap.end(), heap_less);
+        } else {
+            heap.pop_back();
+        }
+    }
+}
 
-    for (auto it = sorted_idx.begin(), end = sorted_idx.end(); it != end; ++it) {
-        auto idx = *it;
-        auto source_collapsed = idx % model.num_nodes();
-        auto target_collapsed = idx / model.num_nodes();
+template <typename CheckOperator>
+std::shared_ptr<Operator> ArcOperatorSet::find_max_ordered(CheckOperator&& check) const {
+    std::shared_ptr<Operator> max_op = nullptr;
+    visit_ordered([&check, &max_op](int source, int target) {
+        max_op = check(source, target);
+        return max_op ? VisitResult::Stop : VisitResult::Next;
+    });
 
+    return max_op;
+}
+
+template <typename M, typename CheckOperator>
+std::vector<std::shared_ptr<Operator>> ArcOperatorSet::find_batch_ordered(const M& model,
+                                                                          CheckOperator&& check,
+                                                                          int max_operators,
+                                                                          double min_delta) const {
+    std::vector<std::shared_ptr<Operator>> batch;
+    std::unordered_set<std::string> changed;
+
+    visit_ordered([&](int source, int target) {
+        if (!batch.empty() && delta_value(source, target) <= min_delta) return VisitResult::Stop;
+        // The target node of every operator is changed, so a changed target has no more operators in the batch.
+        if (changed.count(model.collapsed_name(target)) > 0) return VisitResult::SkipTarget;
+
+        auto op = check(source, target);
+        if (!op) return VisitResult::Next;
+
+        auto nodes = op->nodes_changed(model);
+        if (std::any_of(nodes.begin(), nodes.end(), [&changed](const auto& n) { return changed.count(n) > 0; }))
+            return VisitResult::Next;
+
+        changed.insert(nodes.begin(), nodes.end());
+        batch.push_back(std::move(op));
+        return static_cast<int>(batch.size()) < max_operators ? VisitResult::Next : VisitResult::Stop;
+    });
+
+    return batch;
+}
+
+template <typename M>
+std::vector<std::shared_ptr<Operator>> ArcOperatorSet::find_max_batch(const M& model,
+                                                                      const OperatorTabuSet& tabu_set,
+                                                                      int max_operators,
+                                                                      double min_delta) const {
+    raise_uninitialized();
+
+    if (max_indegree > 0)
+        return find_batch_ordered(model, arc_operator_check<true>(model, tabu_set), max_operators, min_delta);
+    else
+        return find_batch_ordered(model, arc_operator_check<false>(model, tabu_set), max_operators, min_delta);
+}
+
+template <bool limited_indegree>
+auto ArcOperatorSet::arc_operator_check(const BayesianNetworkBase& model) const {
+    return [this, &model](int source_collapsed, int target_collapsed) -> std::shared_ptr<Operator> {
         const auto& source = model.collapsed_name(source_collapsed);
         const auto& target = model.collapsed_name(target_collapsed);
 
         if (model.has_arc(source, target)) {
-            return std::make_shared<RemoveArc>(source, target, delta(source_collapsed, target_collapsed));
+            return std::make_shared<RemoveArc>(source, target, delta_value(source_collapsed, target_collapsed));
         } else if (model.has_arc(target, source) && model.can_flip_arc(target, source)) {
             if constexpr (limited_indegree) {
                 if (model.num_parents(target) >= max_indegree) {
-                    continue;
+                    return nullptr;
                 }
             }
-            return std::make_shared<FlipArc>(target, source, delta(source_collapsed, target_collapsed));
+            return std::make_shared<FlipArc>(target, source, delta_value(source_collapsed, target_collapsed));
         } else if (model.can_add_arc(source, target)) {
             if constexpr (limited_indegree) {
                 if (model.num_parents(target) >= max_indegree) {
-                    continue;
+                    return nullptr;
                 }
             }
-            return std::make_shared<AddArc>(source, target, delta(source_collapsed, target_collapsed));
+            return std::make_shared<AddArc>(source, target, delta_value(source_collapsed, target_collapsed));
         }
-    }
 
-    return nullptr;
+        return nullptr;
+    };
 }
 
 template <bool limited_indegree>
-std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const ConditionalBayesianNetworkBase& model) const {
-    auto delta_ptr = delta.data();
-
-    // TODO: Not checking sorted_idx empty
-    std::sort(
-        sorted_idx.begin(), sorted_idx.end(), [&delta_ptr](auto i1, auto i2) { return delta_ptr[i1] > delta_ptr[i2]; });
-
-    for (auto it = sorted_idx.begin(), end = sorted_idx.end(); it != end; ++it) {
-        auto idx = *it;
-        auto source_joint_collapsed = idx % model.num_joint_nodes();
-        auto target_collapsed = idx / model.num_joint_nodes();
-
+auto ArcOperatorSet::arc_operator_check(const ConditionalBayesianNetworkBase& model) const {
+    return [this, &model](int source_joint_collapsed, int target_collapsed) -> std::shared_ptr<Operator> {
         const auto& source = model.joint_collapsed_name(source_joint_collapsed);
         const auto& target = model.collapsed_name(target_collapsed);
 
-        auto d = delta(source_joint_collapsed, target_collapsed);
+        auto d = delta_value(source_joint_collapsed, target_collapsed);
         if (model.has_arc(source, target)) {
             return std::make_shared<RemoveArc>(source, target, d);
         }
@@ -548,142 +1083,139 @@ std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const ConditionalBay
         if (model.is_interface(source)) {
             if constexpr (limited_indegree) {
                 if (model.num_parents(target) >= max_indegree) {
-                    continue;
+                    return nullptr;
                 }
             }
-            // If source is interface, the arc has a unique direction, and cannot produce cycles as source cannot have
-            // parents.
+            // If source is interface, the arc has a unique direction, and cannot produce cycles as source cannot
+            // have parents.
             if (model.type_ref().can_have_arc(model, source, target))
                 return std::make_shared<AddArc>(source, target, d);
         } else {
             if (model.has_arc(target, source) && model.can_flip_arc(target, source)) {
                 if constexpr (limited_indegree) {
                     if (model.num_parents(target) >= max_indegree) {
-                        continue;
+                        return nullptr;
                     }
                 }
                 return std::make_shared<FlipArc>(target, source, d);
             } else if (model.can_add_arc(source, target)) {
                 if constexpr (limited_indegree) {
                     if (model.num_parents(target) >= max_indegree) {
-                        continue;
+                        return nullptr;
                     }
                 }
                 return std::make_shared<AddArc>(source, target, d);
             }
         }
-    }
 
-    return nullptr;
+        return nullptr;
+    };
 }
 
 template <bool limited_indegree>
-std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const BayesianNetworkBase& model,
-                                                            const OperatorTabuSet& tabu_set) const {
-    auto delta_ptr = delta.data();
-
-    // TODO: Not checking sorted_idx empty
-    std::sort(
-        sorted_idx.begin(), sorted_idx.end(), [&delta_ptr](auto i1, auto i2) { return delta_ptr[i1] > delta_ptr[i2]; });
-
-    for (auto it = sorted_idx.begin(), end = sorted_idx.end(); it != end; ++it) {
-        auto idx = *it;
-        auto source_collapsed = idx % model.num_nodes();
-        auto target_collapsed = idx / model.num_nodes();
-
+auto ArcOperatorSet::arc_operator_check(const BayesianNetworkBase& model,
+                                         const OperatorTabuSet& tabu_set) const {
+    return [this, &model, &tabu_set](int source_collapsed, int target_collapsed) -> std::shared_ptr<Operator> {
         const auto& source = model.collapsed_name(source_collapsed);
         const auto& target = model.collapsed_name(target_collapsed);
 
         if (model.has_arc(source, target)) {
-            std::shared_ptr<Operator> op =
-                std::make_shared<RemoveArc>(source, target, delta(source_collapsed, target_collapsed));
-            if (!tabu_set.contains(op)) return op;
+            if (!tabu_set.contains_arc(ArcOperatorType::RemoveArc, source, target))
+                return std::make_shared<RemoveArc>(source, target, delta_value(source_collapsed, target_collapsed));
         } else if (model.has_arc(target, source) && model.can_flip_arc(target, source)) {
             if constexpr (limited_indegree) {
                 if (model.num_parents(target) >= max_indegree) {
-                    continue;
+                    return nullptr;
                 }
             }
-            std::shared_ptr<Operator> op =
-                std::make_shared<FlipArc>(target, source, delta(source_collapsed, target_collapsed));
-            if (!tabu_set.contains(op)) return op;
+            if (!tabu_set.contains_arc(ArcOperatorType::FlipArc, target, source))
+                return std::make_shared<FlipArc>(target, source, delta_value(source_collapsed, target_collapsed));
         } else if (model.can_add_arc(source, target)) {
             if constexpr (limited_indegree) {
                 if (model.num_parents(target) >= max_indegree) {
-                    continue;
+                    return nullptr;
                 }
             }
-            std::shared_ptr<Operator> op =
-                std::make_shared<AddArc>(source, target, delta(source_collapsed, target_collapsed));
-            if (!tabu_set.contains(op)) return op;
+            if (!tabu_set.contains_arc(ArcOperatorType::AddArc, source, target))
+                return std::make_shared<AddArc>(source, target, delta_value(source_collapsed, target_collapsed));
         }
-    }
 
-    return nullptr;
+        return nullptr;
+    };
 }
 
 template <bool limited_indegree>
-std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const ConditionalBayesianNetworkBase& model,
-                                                            const OperatorTabuSet& tabu_set) const {
-    auto delta_ptr = delta.data();
-
-    // TODO: Not checking sorted_idx empty
-    std::sort(
-        sorted_idx.begin(), sorted_idx.end(), [&delta_ptr](auto i1, auto i2) { return delta_ptr[i1] > delta_ptr[i2]; });
-
-    for (auto it = sorted_idx.begin(), end = sorted_idx.end(); it != end; ++it) {
-        auto idx = *it;
-        auto source_joint_collapsed = idx % model.num_joint_nodes();
-        auto target_collapsed = idx / model.num_joint_nodes();
-
+auto ArcOperatorSet::arc_operator_check(const ConditionalBayesianNetworkBase& model,
+                                         const OperatorTabuSet& tabu_set) const {
+    return [this, &model, &tabu_set](int source_joint_collapsed, int target_collapsed) -> std::shared_ptr<Operator> {
         const auto& source = model.joint_collapsed_name(source_joint_collapsed);
         const auto& target = model.collapsed_name(target_collapsed);
 
-        auto d = delta(source_joint_collapsed, target_collapsed);
+        auto d = delta_value(source_joint_collapsed, target_collapsed);
 
         if (model.has_arc(source, target)) {
-            std::shared_ptr<Operator> op = std::make_shared<RemoveArc>(source, target, d);
-
-            if (!tabu_set.contains(op))
-                return op;
+            if (!tabu_set.contains_arc(ArcOperatorType::RemoveArc, source, target))
+                return std::make_shared<RemoveArc>(source, target, d);
             else
-                continue;
+                return nullptr;
         }
 
         if (model.is_interface(source)) {
             if constexpr (limited_indegree) {
                 if (model.num_parents(target) >= max_indegree) {
-                    continue;
+                    return nullptr;
                 }
             }
-            // If source is interface, the arc has a unique direction, and cannot produce cycles as source cannot have
-            // parents.
+            // If source is interface, the arc has a unique direction, and cannot produce cycles as source cannot
+            // have parents.
             if (model.type_ref().can_have_arc(model, source, target)) {
-                std::shared_ptr<Operator> op = std::make_shared<AddArc>(source, target, d);
-                if (!tabu_set.contains(op)) return op;
+                if (!tabu_set.contains_arc(ArcOperatorType::AddArc, source, target))
+                    return std::make_shared<AddArc>(source, target, d);
             }
         } else {
             if (model.has_arc(target, source) && model.can_flip_arc(target, source)) {
                 if constexpr (limited_indegree) {
                     if (model.num_parents(target) >= max_indegree) {
-                        continue;
+                        return nullptr;
                     }
                 }
-                std::shared_ptr<Operator> op = std::make_shared<FlipArc>(target, source, d);
-                if (!tabu_set.contains(op)) return op;
+                if (!tabu_set.contains_arc(ArcOperatorType::FlipArc, target, source))
+                    return std::make_shared<FlipArc>(target, source, d);
             } else if (model.can_add_arc(source, target)) {
                 if constexpr (limited_indegree) {
                     if (model.num_parents(target) >= max_indegree) {
-                        continue;
+                        return nullptr;
                     }
                 }
-                std::shared_ptr<Operator> op = std::make_shared<AddArc>(source, target, d);
-                if (!tabu_set.contains(op)) return op;
+                if (!tabu_set.contains_arc(ArcOperatorType::AddArc, source, target))
+                    return std::make_shared<AddArc>(source, target, d);
             }
         }
-    }
 
-    return nullptr;
+        return nullptr;
+    };
+}
+
+template <bool limited_indegree>
+std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const BayesianNetworkBase& model) const {
+    return find_max_ordered(arc_operator_check<limited_indegree>(model));
+}
+
+template <bool limited_indegree>
+std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const ConditionalBayesianNetworkBase& model) const {
+    return find_max_ordered(arc_operator_check<limited_indegree>(model));
+}
+
+template <bool limited_indegree>
+std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const BayesianNetworkBase& model,
+                                                            const OperatorTabuSet& tabu_set) const {
+    return find_max_ordered(arc_operator_check<limited_indegree>(model, tabu_set));
+}
+
+template <bool limited_indegree>
+std::shared_ptr<Operator> ArcOperatorSet::find_max_indegree(const ConditionalBayesianNetworkBase& model,
+                                                            const OperatorTabuSet& tabu_set) const {
+    return find_max_ordered(arc_operator_check<limited_indegree>(model, tabu_set));
 }
 
 class ChangeNodeTypeSet : public OperatorSet {
@@ -750,12 +1282,17 @@ private:
 
 class OperatorPool : public OperatorSet {
 public:
-    OperatorPool(std::vector<std::shared_ptr<OperatorSet>> op_sets) : m_op_sets(std::move(op_sets)) {
+    OperatorPool(std::vector<std::shared_ptr<OperatorSet>> op_sets) : m_op_sets(std::move(op_sets)), m_num_threads(1) {
         if (m_op_sets.empty()) {
             throw std::invalid_argument("op_sets argument cannot be empty.");
         }
     }
 
+    bool has_python_derived() const override {
+        return std::any_of(
+            m_op_sets.begin(), m_op_sets.end(), [](const auto& op_set) { return op_set->has_python_derived(); });
+    }
+
     void cache_scores(const BayesianNetworkBase& model, const Score& score) override {
         cache_scores<BayesianNetworkBase>(model, score);
     }
@@ -788,6 +1325,19 @@ public:
         update_scores<>(model, score, variables);
     }
 
+    std::vector<std::shared_ptr<Operator>> find_max_batch(const BayesianNetworkBase& model,
+                                                          const OperatorTabuSet& tabu_set,
+                                                          int max_operators,
+                                                          double min_delta) const override {
+        return find_max_batch<>(model, tabu_set, max_operators, min_delta);
+    }
+    std::vector<std::shared_ptr<Operator>> find_max_batch(const ConditionalBayesianNetworkBase& model,
+                                                          const OperatorTabuSet& tabu_set,
+                                                          int max_operators,
+                                                          double min_delta) const override {
+        return find_max_batch<>(model, tabu_set, max_operators, min_delta);
+    }
+
     template <typename M>
     void cache_scores(const M& model, const Score& score);
     template <typename M>
@@ -796,6 +1346,11 @@ public:
     std::shared_ptr<Operator> find_max(const M& model, const OperatorTabuSet& tabu_set) const;
     template <typename M>
     void update_scores(const M& model, const Score& score, const std::vector<std::string>& variables);
+    template <typename M>
+    std::vector<std::shared_ptr<Operator>> find_max_batch(const M& model,
+                                                          const OperatorTabuSet& tabu_set,
+                                                          int max_operators,
+                                                          double min_delta) const;
 
     void set_arc_blacklist(const ArcStringVector& blacklist) override {
         for (auto& opset : m_op_sets) {
@@ -821,6 +1376,25 @@ public:
         }
     }
 
+    void set_num_threads(int num_threads) override {
+        m_num_threads = util::effective_num_threads(num_threads);
+        for (auto& opset : m_op_sets) {
+            opset->set_num_threads(num_threads);
+        }
+    }
+
+    void set_neighborhood_sampling(double ratio, unsigned int seed) override {
+        for (auto& opset : m_op_sets) {
+            opset->set_neighborhood_sampling(ratio, seed);
+        }
+    }
+
+    void set_candidate_parents(const CandidateParents& candidates) override {
+        for (auto& opset : m_op_sets) {
+            opset->set_candidate_parents(candidates);
+        }
+    }
+
     virtual void finished() override {
         for (auto& opset : m_op_sets) {
             opset->finished();
@@ -831,6 +1405,7 @@ public:
 
 private:
     std::vector<std::shared_ptr<OperatorSet>> m_op_sets;
+    int m_num_threads;
 };
 
 template <typename M>
@@ -843,7 +1418,7 @@ void OperatorPool::cache_scores(const M& model, const Score& score) {
         }
     }
 
-    m_local_cache->cache_local_scores(model, score);
+    m_local_cache->cache_local_scores(model, score, m_num_threads);
 
     for (auto& op_set : m_op_sets) {
         op_set->cache_scores(model, score);
@@ -888,6 +1463,41 @@ std::shared_ptr<Operator> OperatorPool::find_max(const M& model, const OperatorT
     return max_op;
 }
 
+// Merges the batches of each operator set in descending order of delta, keeping the operators whose nodes_changed() are
+// disjoint from the better operators. The first operator of the merged batch is the best operator of the pool.
+template <typename M>
+std::vector<std::shared_ptr<Operator>> OperatorPool::find_max_batch(const M& model,
+                                                                    const OperatorTabuSet& tabu_set,
+                                                                    int max_operators,
+                                                                    double min_delta) const {
+    raise_uninitialized();
+
+    std::vector<std::shared_ptr<Operator>> candidates;
+    for (auto& op_set : m_op_sets) {
+        auto batch = op_set->find_max_batch(model, tabu_set, max_operators, min_delta);
+        candidates.insert(candidates.end(), batch.begin(), batch.end());
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a->delta() > b->delta();
+    });
+
+    std::vector<std::shared_ptr<Operator>> batch;
+    std::unordered_set<std::string> changed;
+    for (auto& op : candidates) {
+        if (static_cast<int>(batch.size()) >= max_operators) break;
+
+        auto nodes = op->nodes_changed(model);
+        if (std::any_of(nodes.begin(), nodes.end(), [&changed](const auto& n) { return changed.count(n) > 0; }))
+            continue;
+
+        changed.insert(nodes.begin(), nodes.end());
+        batch.push_back(std::move(op));
+    }
+
+    return batch;
+}
+
 template <typename M>
 void OperatorPool::update_scores(const M& model, const Score& score, const std::vector<std::string>& variables) {
     raise_uninitialized();
@@ -5,12 +5,79 @@ namespace learning::parameters {
 typename DiscreteFactor::ParamsClass _fit(const DataFrame& df,
                                           const std::string& variable,
                                           const std::vector<std::string>& evidence) {
-    auto num_variables = evidence.size() + 1;
-
     auto [cardinality, strides] = factors::discrete::create_cardinality_strides(df, variable, evidence);
 
+    if (factors::discrete::sparse_configurations(cardinality)) {
+        auto sparse_counts = factors::discrete::sparse_joint_counts(df, variable, evidence, cardinality, strides);
+        return _fit_sparse_counts(sparse_counts, cardinality);
+    }
+
     auto joint_counts = factors::discrete::joint_counts(df, variable, evidence, cardinality, strides);
 
+    return _fit_counts(joint_counts, cardinality);
+}
+
+typename DiscreteFactor::ParamsClass _fit_weighted(const DataFrame& df,
+                                                   const std::string& variable,
+                                                   const std::vector<std::string>& evidence,
+                                                   const VectorXd& weights) {
+    factors::check_weights(df, weights);
+    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(df, variable, evidence);
+
+    if (factors::discrete::sparse_configurations(cardinality)) {
+        auto sparse_counts =
+            factors::discrete::weighted_sparse_joint_counts(df, variable, evidence, cardinality, strides, weights);
+        return _fit_sparse_counts(sparse_counts, cardinality);
+    }
+
+    auto joint_counts = factors::discrete::weighted_joint_counts(df, variable, evidence, cardinality, strides, weights);
+    return _fit_counts(joint_counts, cardinality);
+}
+
+namespace {
+
+template <typename SparseCounts>
+typename DiscreteFactor::ParamsClass fit_sparse_counts_impl(const SparseCounts& sparse_counts,
+                                                            const VectorXi& cardinality) {
+    using CountsType = std::decay_t<decltype(sparse_counts.counts)>;
+
+    auto num_categories = cardinality(0);
+    int num_configurations = sparse_counts.configurations.size();
+
+    // The configurations without data are represented by one configuration with zero counts after the stored ones, so
+    // they are normalized as in a dense table.
+    CountsType counts = CountsType::Zero((num_configurations + 1) * num_categories);
+    counts.head(sparse_counts.counts.rows()) = sparse_counts.counts;
+
+    VectorXi table_cardinality(2);
+    table_cardinality << num_categories, num_configurations + 1;
+
+    auto params = _fit_counts(counts, table_cardinality);
+    params.cardinality = cardinality;
+    params.configurations = sparse_counts.configurations;
+    return params;
+}
+
+}  // namespace
+
+typename DiscreteFactor::ParamsClass _fit_sparse_counts(const factors::discrete::SparseJointCounts& sparse_counts,
+                                                        const VectorXi& cardinality) {
+    return fit_sparse_counts_impl(sparse_counts, cardinality);
+}
+
+typename DiscreteFactor::ParamsClass _fit_sparse_counts(
+    const factors::discrete::WeightedSparseJointCounts& sparse_counts, const VectorXi& cardinality) {
+    return fit_sparse_counts_impl(sparse_counts, cardinality);
+}
+
+typename DiscreteFactor::ParamsClass _fit_counts(const VectorXi& joint_counts, const VectorXi& cardinality) {
+    // The counts are exactly representable in double, so the sums and the logarithms do not change.
+    return _fit_counts(VectorXd(joint_counts.cast<double>()), cardinality);
+}
+
+typename DiscreteFactor::ParamsClass _fit_counts(const VectorXd& joint_counts, const VectorXi& cardinality) {
+    auto num_variables = cardinality.rows();
+
     // Normalize the CPD.
     auto parent_configurations = cardinality.bottomRows(num_variables - 1).prod();
 
@@ -19,7 +86,7 @@ typename DiscreteFactor::ParamsClass _fit(const DataFrame& df,
     for (auto k = 0; k < parent_configurations; ++k) {
         auto offset = k * cardinality(0);
 
-        int sum_configuration = 0;
+        double sum_configuration = 0;
         for (auto i = 0; i < cardinality(0); ++i) {
             sum_configuration += joint_counts(offset + i);
         }
@@ -30,9 +97,9 @@ typename DiscreteFactor::ParamsClass _fit(const DataFrame& df,
                 logprob(offset + i) = loguniform;
             }
         } else {
-            double logsum_configuration = std::log(static_cast<double>(sum_configuration));
+            double logsum_configuration = std::log(sum_configuration);
             for (auto i = 0; i < cardinality(0); ++i) {
-                logprob(offset + i) = std::log(static_cast<double>(joint_counts(offset + i))) - logsum_configuration;
+                logprob(offset + i) = std::log(joint_counts(offset + i)) - logsum_configuration;
             }
         }
     }
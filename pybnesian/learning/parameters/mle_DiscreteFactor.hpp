@@ -13,6 +13,23 @@ typename DiscreteFactor::ParamsClass _fit(const DataFrame& df,
                                           const std::string& variable,
                                           const std::vector<std::string>& evidence);
 
+// Same as _fit(), but each row is weighted by weights (see factors::check_weights()).
+typename DiscreteFactor::ParamsClass _fit_weighted(const DataFrame& df,
+                                                   const std::string& variable,
+                                                   const std::vector<std::string>& evidence,
+                                                   const VectorXd& weights);
+
+// Returns the parameters of a DiscreteFactor from the joint_counts() of the variable and the evidence.
+typename DiscreteFactor::ParamsClass _fit_counts(const VectorXi& joint_counts, const VectorXi& cardinality);
+// Same as _fit_counts(), but the counts can be weighted (e.g., the exponentially forgotten counts of partial_fit()).
+typename DiscreteFactor::ParamsClass _fit_counts(const VectorXd& joint_counts, const VectorXi& cardinality);
+
+// Returns the parameters of a sparse DiscreteFactor from the sparse_joint_counts() of the variable and the evidence.
+typename DiscreteFactor::ParamsClass _fit_sparse_counts(const factors::discrete::SparseJointCounts& sparse_counts,
+                                                        const VectorXi& cardinality);
+typename DiscreteFactor::ParamsClass _fit_sparse_counts(
+    const factors::discrete::WeightedSparseJointCounts& sparse_counts, const VectorXi& cardinality);
+
 }  // namespace learning::parameters
 
 #endif  // PYBNESIAN_LEARNING_PARAMETERS_MLE_DISCRETEFACTOR_HPP
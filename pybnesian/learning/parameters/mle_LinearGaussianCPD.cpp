@@ -2,6 +2,181 @@
 
 namespace learning::parameters {
 
+namespace {
+
+template <typename ArrowType>
+LinearGaussianCPD_Statistics linear_gaussian_statistics_impl(const DataFrame& df,
+                                                             const std::vector<std::string>& columns) {
+    // The rows with null values are removed.
+    auto data = df.to_eigen<false, ArrowType>(columns);
+    auto rows = data->rows();
+    int d = columns.size();
+
+    if (rows == 0) return LinearGaussianCPD_Statistics{0, VectorXd::Zero(d), MatrixXd::Zero(d, d)};
+
+    MatrixXd centered;
+    if constexpr (std::is_same_v<typename ArrowType::c_type, double>) {
+        centered = std::move(*data);
+    } else {
+        centered = data->template cast<double>();
+    }
+
+    VectorXd mean = centered.colwise().mean().transpose();
+    centered.rowwise() -= mean.transpose();
+    MatrixXd scatter = centered.transpose() * centered;
+
+    return LinearGaussianCPD_Statistics{static_cast<double>(rows), std::move(mean), std::move(scatter)};
+}
+
+template <typename ArrowType>
+LinearGaussianCPD_Statistics weighted_statistics_impl(const DataFrame& df,
+                                                      const std::vector<std::string>& columns,
+                                                      const VectorXd& weights) {
+    // The rows with null values are removed.
+    auto data = df.to_eigen<false, ArrowType>(columns);
+    VectorXd w = factors::valid_weights(df, weights, columns);
+    int d = columns.size();
+
+    double count = w.sum();
+    if (count == 0) return LinearGaussianCPD_Statistics{0, VectorXd::Zero(d), MatrixXd::Zero(d, d)};
+
+    MatrixXd centered;
+    if constexpr (std::is_same_v<typename ArrowType::c_type, double>) {
+        centered = std::move(*data);
+    } else {
+        centered = data->template cast<double>();
+    }
+
+    VectorXd mean = centered.transpose() * w / count;
+    centered.rowwise() -= mean.transpose();
+    MatrixXd weighted = centered.array().colwise() * w.array();
+    MatrixXd scatter = centered.transpose() * weighted;
+
+    return LinearGaussianCPD_Statistics{count, std::move(mean), std::move(scatter)};
+}
+
+}  // namespace
+
+LinearGaussianCPD_Statistics linear_gaussian_statistics(const DataFrame& df,
+                                                        const std::string& variable,
+                                                        const std::vector<std::string>& evidence) {
+    auto type_id = df.same_type(variable, evidence);
+
+    std::vector<std::string> columns(evidence);
+    columns.push_back(variable);
+
+    switch (type_id->id()) {
+        case Type::DOUBLE:
+            return linear_gaussian_statistics_impl<DoubleType>(df, columns);
+        case Type::FLOAT:
+            return linear_gaussian_statistics_impl<FloatType>(df, columns);
+        default:
+            throw std::invalid_argument("Wrong data type (" + type_id->ToString() +
+                                        ") to fit the LinearGaussianCPD of " + variable +
+                                        ". \"double\" or \"float\" data is expected.");
+    }
+}
+
+LinearGaussianCPD_Statistics linear_gaussian_statistics(const DataFrame& df,
+                                                        const std::string& variable,
+                                                        const std::vector<std::string>& evidence,
+                                                        const VectorXd& weights) {
+    factors::check_weights(df, weights);
+    auto type_id = df.same_type(variable, evidence);
+
+    std::vector<std::string> columns(evidence);
+    columns.push_back(variable);
+
+    switch (type_id->id()) {
+        case Type::DOUBLE:
+            return weighted_statistics_impl<DoubleType>(df, columns, weights);
+        case Type::FLOAT:
+            return weighted_statistics_impl<FloatType>(df, columns, weights);
+        default:
+            throw std::invalid_argument("Wrong data type (" + type_id->ToString() +
+                                        ") to fit the LinearGaussianCPD of " + variable +
+                                        ". \"double\" or \"float\" data is expected.");
+    }
+}
+
+void update_statistics(LinearGaussianCPD_Statistics& stats,
+                       const LinearGaussianCPD_Statistics& batch,
+                       double forgetting) {
+    double previous = forgetting * stats.count;
+    stats.scatter *= forgetting;
+    stats.count = previous;
+
+    if (batch.count == 0) return;
+
+    double count = previous + batch.count;
+    VectorXd delta = batch.mean - stats.mean;
+
+    stats.mean += delta * (batch.count / count);
+    stats.scatter += batch.scatter;
+    stats.scatter.noalias() += (previous * batch.count / count) * delta * delta.transpose();
+    stats.count = count;
+}
+
+NormalEquationsSolution solve_normal_equations(const MatrixXd& scatter,
+                                               const std::vector<int>& evidence,
+                                               int variable) {
+    int k = evidence.size();
+    VectorXd scale(k);
+    VectorXd cross_scatter(k);
+    for (int a = 0; a < k; ++a) {
+        scale(a) = std::sqrt(scatter(evidence[a], evidence[a]));
+        cross_scatter(a) = scatter(evidence[a], variable);
+    }
+
+    MatrixXd correlation(k, k);
+    for (int a = 0; a < k; ++a) {
+        for (int b = 0; b < k; ++b) {
+            correlation(a, b) = scatter(evidence[a], evidence[b]) / (scale(a) * scale(b));
+        }
+    }
+
+    VectorXd scaled_cross = cross_scatter.cwiseQuotient(scale);
+    Eigen::LLT<MatrixXd> llt(correlation);
+    if (llt.info() == Eigen::Success && llt.rcond() >= util::machine_tol)
+        return NormalEquationsSolution{llt.solve(scaled_cross).cwiseQuotient(scale), true};
+
+    // The evidence is (almost) collinear.
+    return NormalEquationsSolution{
+        correlation.completeOrthogonalDecomposition().solve(scaled_cross).cwiseQuotient(scale), false};
+}
+
+typename LinearGaussianCPD::ParamsClass _fit_statistics(const LinearGaussianCPD_Statistics& stats) {
+    int m = stats.mean.rows() - 1;
+    const auto& scatter = stats.scatter;
+
+    VectorXd beta = VectorXd::Zero(m + 1);
+    double rss = scatter(m, m);
+
+    // The evidence with (almost) zero variance is ignored.
+    std::vector<int> active;
+    for (int i = 0; i < m; ++i) {
+        if (stats.count > 1 && scatter(i, i) / (stats.count - 1) >= util::machine_tol) active.push_back(i);
+    }
+
+    if (!active.empty()) {
+        auto b = solve_normal_equations(scatter, active, m).beta;
+        for (int a = 0, k = active.size(); a < k; ++a) {
+            beta(active[a] + 1) = b(a);
+            rss -= b(a) * scatter(active[a], m);
+        }
+    }
+
+    beta(0) = stats.mean(m) - beta.tail(m).dot(stats.mean.head(m));
+
+    if (stats.count <= m + 1) {
+        return typename LinearGaussianCPD::ParamsClass{/*.beta = */ beta,
+                                                       /*.variance = */ std::numeric_limits<double>::infinity()};
+    }
+
+    return typename LinearGaussianCPD::ParamsClass{/*.beta = */ beta,
+                                                   /*.variance = */ std::max(rss, 0.) / (stats.count - m - 1)};
+}
+
 template <>
 typename LinearGaussianCPD::ParamsClass MLE<LinearGaussianCPD>::estimate(const DataFrame& df,
                                                                          const std::string& variable,
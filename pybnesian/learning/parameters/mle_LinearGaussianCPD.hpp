@@ -5,9 +5,46 @@
 #include <factors/continuous/LinearGaussianCPD.hpp>
 
 using factors::continuous::LinearGaussianCPD;
+using factors::continuous::LinearGaussianCPD_Statistics;
 
 namespace learning::parameters {
 
+// Returns the LinearGaussianCPD_Statistics of the rows of df without null values in the variable and the evidence.
+LinearGaussianCPD_Statistics linear_gaussian_statistics(const DataFrame& df,
+                                                        const std::string& variable,
+                                                        const std::vector<std::string>& evidence);
+
+// Same as linear_gaussian_statistics(), but each row is weighted by weights (see factors::check_weights()), so the
+// count is the sum of the weights.
+LinearGaussianCPD_Statistics linear_gaussian_statistics(const DataFrame& df,
+                                                        const std::string& variable,
+                                                        const std::vector<std::string>& evidence,
+                                                        const VectorXd& weights);
+
+// Adds the statistics of batch to stats, after multiplying the statistics of stats by forgetting. The scatter matrices
+// are combined with the difference of the means, so the data is not centered with a stale mean.
+void update_statistics(LinearGaussianCPD_Statistics& stats,
+                       const LinearGaussianCPD_Statistics& batch,
+                       double forgetting);
+
+// The coefficients of the evidence of a linear regression fitted with a scatter matrix (see solve_normal_equations()).
+struct NormalEquationsSolution {
+    VectorXd beta;
+    // False if the correlation matrix of the evidence is (almost) singular. Then, beta is the minimum norm solution.
+    bool well_conditioned;
+};
+
+// Solves the normal equations of the regression of the variable with index variable on the evidence with indices
+// evidence, where scatter is the scatter matrix of the centered data. The normal equations are solved with the
+// correlation matrix, so the condition number does not depend on the scale of the evidence. The evidence must have a
+// positive variance.
+NormalEquationsSolution solve_normal_equations(const MatrixXd& scatter, const std::vector<int>& evidence, int variable);
+
+// Returns the parameters of a LinearGaussianCPD fitted with the sufficient statistics. As in MLE<LinearGaussianCPD>,
+// the evidence with (almost) zero variance has a zero coefficient, and the variance is infinite if there are not
+// enough instances.
+typename LinearGaussianCPD::ParamsClass _fit_statistics(const LinearGaussianCPD_Statistics& stats);
+
 template <typename ArrowType, bool contains_null>
 typename LinearGaussianCPD::ParamsClass _fit_1parent(const DataFrame& df,
                                                      const std::string& variable,
@@ -149,46 +186,40 @@ typename LinearGaussianCPD::ParamsClass _fit_2parent(const DataFrame& df,
     }
 }
 
-template <typename ArrowType, bool contains_null>
-typename LinearGaussianCPD::ParamsClass _fit_nparent(const DataFrame& df,
-                                                     const std::string& variable,
-                                                     const std::vector<std::string>& evidence) {
-    auto [y, X] = [&df, &variable, &evidence]() {
-        if constexpr (contains_null) {
-            auto combined_bitmap = df.combined_bitmap(variable, evidence);
-            auto y = df.to_eigen<false, ArrowType>(combined_bitmap, variable);
-            auto X = df.to_eigen<true, ArrowType>(combined_bitmap, evidence);
-            return std::make_tuple(std::move(y), std::move(X));
-        } else {
-            auto y = df.to_eigen<false, ArrowType, contains_null>(variable);
-            auto X = df.to_eigen<true, ArrowType, contains_null>(evidence);
-            return std::make_tuple(std::move(y), std::move(X));
-        }
-    }();
-
-    auto rows = y->rows();
+// Returns the least squares fit of y given the design matrix X, whose first column is the intercept.
+template <typename XType, typename YType>
+typename LinearGaussianCPD::ParamsClass _fit_nparent_matrices(const XType& X, const YType& y) {
+    auto rows = y.rows();
 
-    const auto b = X->colPivHouseholderQr().solve(*y).eval();
+    const auto b = X.colPivHouseholderQr().solve(y).eval();
 
     if (rows <= b.rows()) {
-        if constexpr (std::is_same_v<typename ArrowType::c_type, double>) {
-            return typename LinearGaussianCPD::ParamsClass{/*.beta = */ b,
-                                                           /*.variance = */ std::numeric_limits<double>::infinity()};
-        } else {
-            return typename LinearGaussianCPD::ParamsClass{/*.beta = */ b.template cast<double>(),
-                                                           /*.variance = */ std::numeric_limits<double>::infinity()};
-        }
+        return typename LinearGaussianCPD::ParamsClass{/*.beta = */ b.template cast<double>(),
+                                                       /*.variance = */ std::numeric_limits<double>::infinity()};
     }
 
-    auto r = (*X) * b;
-    auto v = ((*y) - r).squaredNorm() / (rows - b.rows());
+    auto v = (y - X * b).squaredNorm() / (rows - b.rows());
 
-    if constexpr (std::is_same_v<typename ArrowType::c_type, double>) {
-        return typename LinearGaussianCPD::ParamsClass{/*.beta = */ b,
-                                                       /*.variance = */ v};
+    return typename LinearGaussianCPD::ParamsClass{/*.beta = */ b.template cast<double>(),
+                                                   /*.variance = */ v};
+}
+
+template <typename ArrowType, bool contains_null>
+typename LinearGaussianCPD::ParamsClass _fit_nparent(const DataFrame& df,
+                                                     const std::string& variable,
+                                                     const std::vector<std::string>& evidence) {
+    if constexpr (contains_null) {
+        auto combined_bitmap = df.combined_bitmap(variable, evidence);
+        auto y = df.to_eigen<false, ArrowType>(combined_bitmap, variable);
+        auto X = df.to_eigen<true, ArrowType>(combined_bitmap, evidence);
+        return _fit_nparent_matrices(*X, *y);
     } else {
-        return typename LinearGaussianCPD::ParamsClass{/*.beta = */ b.template cast<double>(),
-                                                       /*.variance = */ v};
+        // The design matrix of an evidence set is shared by the fits of different variables in the same DataFrame. The
+        // cached matrices are checked against the current values of the columns (see dataset::EigenMatrixCache), and
+        // y is a view of the current values, so X and y always come from the same data.
+        auto y = df.eigen_view<false, ArrowType>(variable);
+        auto X = df.eigen_view<true, ArrowType>(evidence);
+        return _fit_nparent_matrices(*X, y->col(0));
     }
 }
 
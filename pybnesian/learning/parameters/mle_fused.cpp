@@ -0,0 +1,156 @@
+#include <learning/parameters/mle_fused.hpp>
+#include <learning/parameters/mle_DiscreteFactor.hpp>
+#include <learning/parameters/mle_LinearGaussianCPD.hpp>
+#include <learning/scores/gaussian_statistics.hpp>
+
+using factors::discrete::DiscreteIndicesColumn;
+
+namespace learning::parameters {
+
+namespace {
+
+bool valid_linear_gaussian(const DataFrame& df, const Factor& cpd) {
+    // The variable and the evidence must have the same type, as in MLE<LinearGaussianCPD>.
+    auto type = df.col(cpd.variable())->type_id();
+    if ((type != Type::DOUBLE && type != Type::FLOAT) || df.null_count(cpd.variable()) > 0) return false;
+
+    for (const auto& e : cpd.evidence()) {
+        if (df.col(e)->type_id() != type || df.null_count(e) > 0) return false;
+    }
+
+    return true;
+}
+
+bool valid_discrete(const DataFrame& df, const Factor& cpd) {
+    if (df.col(cpd.variable())->type_id() != Type::DICTIONARY || df.null_count(cpd.variable()) > 0) return false;
+
+    for (const auto& e : cpd.evidence()) {
+        if (df.col(e)->type_id() != Type::DICTIONARY || df.null_count(e) > 0) return false;
+    }
+
+    // The sparse factors are fitted without the dense joint counts.
+    auto cardinality = factors::discrete::create_cardinality_strides(df, cpd.variable(), cpd.evidence()).first;
+    return !factors::discrete::sparse_configurations(cardinality);
+}
+
+// Fits the LinearGaussianCPDs at the given indices with the statistics of the union of their columns. Returns the
+// indices that could not be fitted with the statistics.
+std::vector<int> fused_linear_gaussian(const DataFrame& df,
+                                       const std::vector<std::shared_ptr<Factor>>& cpds,
+                                       const std::vector<int>& indices) {
+    std::vector<std::string> columns;
+    std::unordered_map<std::string, int> column_indices;
+    auto add_column = [&columns, &column_indices](const std::string& name) {
+        if (column_indices.insert({name, columns.size()}).second) columns.push_back(name);
+    };
+
+    for (auto i : indices) {
+        add_column(cpds[i]->variable());
+        for (const auto& e : cpds[i]->evidence()) {
+            add_column(e);
+        }
+    }
+
+    auto stats = learning::scores::gaussian_statistics(df, columns);
+
+    std::vector<int> not_fitted;
+    for (auto i : indices) {
+        auto& cpd = static_cast<LinearGaussianCPD&>(*cpds[i]);
+
+        std::vector<int> family;
+        family.reserve(cpd.evidence().size() + 1);
+        for (const auto& e : cpd.evidence()) {
+            family.push_back(column_indices.at(e));
+        }
+        family.push_back(column_indices.at(cpd.variable()));
+
+        auto params = learning::scores::linear_gaussian_mle(stats, family);
+        if (params) {
+            cpd.set_beta(params->beta);
+            cpd.set_variance(params->variance);
+        } else {
+            not_fitted.push_back(i);
+        }
+    }
+
+    return not_fitted;
+}
+
+// Fits the DiscreteFactors at the given indices with the joint counts of their columns. The counts of all the factors
+// are computed in the same pass over the blocks of df.
+void fused_discrete(const DataFrame& df,
+                    const std::vector<std::shared_ptr<Factor>>& cpds,
+                    const std::vector<int>& indices) {
+    std::vector<VectorXi> cardinalities;
+    std::vector<VectorXi> counts;
+    std::vector<std::vector<DiscreteIndicesColumn>> columns;
+    cardinalities.reserve(indices.size());
+    counts.reserve(indices.size());
+    columns.reserve(indices.size());
+
+    for (auto i : indices) {
+        const auto& cpd = *cpds[i];
+        auto [cardinality, strides] =
+            factors::discrete::create_cardinality_strides(df, cpd.variable(), cpd.evidence());
+        columns.push_back(factors::discrete::discrete_indices_columns(df, cpd.variable(), cpd.evidence(), strides));
+        counts.push_back(VectorXi::Zero(cardinality.prod()));
+        cardinalities.push_back(std::move(cardinality));
+    }
+
+    constexpr int block_rows = factors::discrete::discrete_indices_block_rows;
+    int block[block_rows];
+    int64_t rows = df->num_rows();
+    for (int64_t offset = 0; offset < rows; offset += block_rows) {
+        int length = std::min(static_cast<int64_t>(block_rows), rows - offset);
+
+        for (size_t f = 0; f < columns.size(); ++f) {
+            std::fill(block, block + length, 0);
+            for (const auto& column : columns[f]) {
+                column.accumulate(column.raw_indices, offset, length, column.stride, block);
+            }
+
+            auto& family_counts = counts[f];
+            for (int k = 0; k < length; ++k) {
+                ++family_counts(block[k]);
+            }
+        }
+    }
+
+    for (size_t f = 0; f < indices.size(); ++f) {
+        auto& cpd = static_cast<DiscreteFactor&>(*cpds[indices[f]]);
+        cpd.set_fitted_params(df, _fit_counts(counts[f], cardinalities[f]));
+    }
+}
+
+}  // namespace
+
+std::vector<int> fused_mle_fit(const DataFrame& df,
+                               const std::vector<std::shared_ptr<Factor>>& cpds,
+                               const std::vector<int>& indices) {
+    std::vector<int> linear_gaussian, discrete, not_fitted;
+
+    for (auto i : indices) {
+        const auto& cpd = *cpds[i];
+        // The Python-derived factors can override fit(), so they are not fitted with the shared statistics.
+        if (cpd.is_python_derived()) {
+            not_fitted.push_back(i);
+        } else if (dynamic_cast<const LinearGaussianCPD*>(&cpd) && valid_linear_gaussian(df, cpd)) {
+            linear_gaussian.push_back(i);
+        } else if (dynamic_cast<const DiscreteFactor*>(&cpd) && valid_discrete(df, cpd)) {
+            discrete.push_back(i);
+        } else {
+            not_fitted.push_back(i);
+        }
+    }
+
+    if (!linear_gaussian.empty()) {
+        auto degenerate = fused_linear_gaussian(df, cpds, linear_gaussian);
+        not_fitted.insert(not_fitted.end(), degenerate.begin(), degenerate.end());
+    }
+
+    if (!discrete.empty()) fused_discrete(df, cpds, discrete);
+
+    return not_fitted;
+}
+
+}  // namespace learning::parameters
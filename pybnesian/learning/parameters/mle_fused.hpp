@@ -0,0 +1,28 @@
+#ifndef PYBNESIAN_LEARNING_PARAMETERS_MLE_FUSED_HPP
+#define PYBNESIAN_LEARNING_PARAMETERS_MLE_FUSED_HPP
+
+#include <dataset/dataset.hpp>
+#include <factors/factors.hpp>
+
+using dataset::DataFrame;
+using factors::Factor;
+
+namespace learning::parameters {
+
+// Fits with MLE the factors cpds[i] for each i in indices, sharing the passes over df between the factors:
+//
+// - The LinearGaussianCPDs whose columns are double columns without null values are fitted with the sufficient
+//   statistics of all their columns, computed with one pass over df.
+// - The DiscreteFactors whose columns do not contain null values are fitted with the joint counts of all of them,
+//   computed with one blocked pass over df, so the indices of each column are read while they are in the cache.
+//
+// Returns the indices of the factors that were not fitted (other factor types, Python-derived factors, columns with
+// null values, or degenerate statistics), that should be fitted with Factor::fit(). The fitted parameters are equal
+// (up to rounding errors) to the parameters fitted with Factor::fit().
+std::vector<int> fused_mle_fit(const DataFrame& df,
+                               const std::vector<std::shared_ptr<Factor>>& cpds,
+                               const std::vector<int>& indices);
+
+}  // namespace learning::parameters
+
+#endif  // PYBNESIAN_LEARNING_PARAMETERS_MLE_FUSED_HPP
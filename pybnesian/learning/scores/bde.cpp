@@ -2,17 +2,39 @@
 
 namespace learning::scores {
 
+LgammaCache::Table::Table(double alpha, int size) : m_alpha(alpha), m_values(size) {
+    for (int m = 0; m < size; ++m) {
+        m_values[m] = std::lgamma(m + alpha);
+    }
+}
+
+std::shared_ptr<const LgammaCache::Table> LgammaCache::table(double alpha) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_tables.find(alpha);
+    if (found != m_tables.end()) return found->second;
+
+    // When the cache is full, the table is not stored and only contains the small counts.
+    if (m_tables.size() >= max_tables) return std::make_shared<const Table>(alpha, std::min(m_table_size, 64));
+
+    auto table = std::make_shared<const Table>(alpha, m_table_size);
+    m_tables.insert({alpha, table});
+    return table;
+}
+
 double BDe::bde_impl_noparents(const std::string& variable) const {
-    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, variable, {});
-    auto joint_counts = factors::discrete::joint_counts(m_df, variable, {}, cardinality, strides);
+    auto [cardinality, joint_counts] = m_counts_cache->joint_counts(m_df, variable, {});
+    return bde_noparents_counts(cardinality, joint_counts);
+}
 
+double BDe::bde_noparents_counts(const VectorXi& cardinality, const VectorXi& joint_counts) const {
     double alpha = m_iss / cardinality(0);
+    auto lgamma_alpha = m_lgamma_cache->table(alpha);
 
     auto num_rows = 0;
     auto res = -cardinality(0) * std::lgamma(alpha);
     for (auto i = 0; i < joint_counts.rows(); ++i) {
         num_rows += joint_counts(i);
-        res += std::lgamma(joint_counts(i) + alpha);
+        res += lgamma_alpha->lgamma(joint_counts(i));
     }
 
     res += std::lgamma(m_iss) - std::lgamma(m_iss + num_rows);
@@ -22,11 +44,22 @@ double BDe::bde_impl_noparents(const std::string& variable) const {
 
 double BDe::bde_impl_parents(const std::string& variable, const std::vector<std::string>& parents) const {
     auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, variable, parents);
-    auto joint_counts = factors::discrete::joint_counts(m_df, variable, parents, cardinality, strides);
+    if (factors::discrete::sparse_configurations(cardinality)) {
+        auto sparse_counts = factors::discrete::sparse_joint_counts(m_df, variable, parents, cardinality, strides);
+        return bde_parents_sparse_counts(cardinality, sparse_counts);
+    }
 
+    auto [_, joint_counts] = m_counts_cache->joint_counts(m_df, variable, parents);
+    return bde_parents_counts(cardinality, joint_counts);
+}
+
+double BDe::bde_parents_counts(const VectorXi& cardinality, const VectorXi& joint_counts) const {
     auto cardinality_prod = cardinality.prod();
     double alpha = m_iss / cardinality_prod;
     auto parent_configurations = cardinality_prod / cardinality(0);
+    auto sum_alpha = alpha * cardinality(0);
+    auto lgamma_alpha = m_lgamma_cache->table(alpha);
+    auto lgamma_sum_alpha = m_lgamma_cache->table(sum_alpha);
 
     auto res = -cardinality_prod * std::lgamma(alpha);
     for (auto k = 0; k < parent_configurations; ++k) {
@@ -35,12 +68,36 @@ double BDe::bde_impl_parents(const std::string& variable, const std::vector<std:
 
         for (auto i = 0; i < cardinality(0); ++i) {
             auto m = joint_counts(offset + i);
-            res += std::lgamma(m + alpha);
+            res += lgamma_alpha->lgamma(m);
+            sum += m;
+        }
+
+        res += lgamma_sum_alpha->lgamma(0) - lgamma_sum_alpha->lgamma(sum);
+    }
+
+    return res;
+}
+
+double BDe::bde_parents_sparse_counts(const VectorXi& cardinality,
+                                     const factors::discrete::SparseJointCounts& sparse_counts) const {
+    double alpha = m_iss / cardinality.cast<double>().prod();
+    auto sum_alpha = alpha * cardinality(0);
+    auto lgamma_alpha = m_lgamma_cache->table(alpha);
+    auto lgamma_sum_alpha = m_lgamma_cache->table(sum_alpha);
+
+    // The terms of the parent configurations without data cancel out, so only the stored configurations are summed.
+    double res = 0;
+    for (int k = 0, k_end = sparse_counts.configurations.size(); k < k_end; ++k) {
+        auto offset = k * cardinality(0);
+        auto sum = 0;
+
+        for (auto i = 0; i < cardinality(0); ++i) {
+            auto m = sparse_counts.counts(offset + i);
+            res += lgamma_alpha->lgamma(m) - lgamma_alpha->lgamma(0);
             sum += m;
         }
 
-        auto sum_alpha = alpha * cardinality(0);
-        res += std::lgamma(sum_alpha) - std::lgamma(sum_alpha + sum);
+        res += lgamma_sum_alpha->lgamma(0) - lgamma_sum_alpha->lgamma(sum);
     }
 
     return res;
@@ -60,6 +117,42 @@ double BDe::local_score(const BayesianNetworkBase& model,
                                 "\" not valid for score BGe");
 }
 
+std::vector<double> BDe::local_scores(const BayesianNetworkBase& model,
+                                      const std::string& variable,
+                                      const std::vector<std::vector<std::string>>& parents_sets) const {
+    if (*model.node_type(variable) != DiscreteFactorType::get_ref()) {
+        throw std::invalid_argument("Bayesian network type \"" + model.type_ref().ToString() +
+                                    "\" not valid for score BDe");
+    }
+
+    // The parent sets with sparse configurations are scored without the dense joint counts.
+    std::vector<std::vector<std::string>> dense_sets;
+    std::vector<size_t> dense_positions;
+    std::vector<double> res(parents_sets.size());
+    for (size_t i = 0, end = parents_sets.size(); i < end; ++i) {
+        if (!parents_sets[i].empty() &&
+            factors::discrete::sparse_configurations(
+                factors::discrete::create_cardinality_strides(m_df, variable, parents_sets[i]).first)) {
+            res[i] = bde_impl_parents(variable, parents_sets[i]);
+        } else {
+            dense_sets.push_back(parents_sets[i]);
+            dense_positions.push_back(i);
+        }
+    }
+
+    auto counts = m_counts_cache->batch_joint_counts(m_df, variable, dense_sets);
+
+    for (size_t i = 0, end = dense_sets.size(); i < end; ++i) {
+        const auto& [cardinality, joint_counts] = counts[i];
+        if (dense_sets[i].empty())
+            res[dense_positions[i]] = bde_noparents_counts(cardinality, joint_counts);
+        else
+            res[dense_positions[i]] = bde_parents_counts(cardinality, joint_counts);
+    }
+
+    return res;
+}
+
 double BDe::local_score(const BayesianNetworkBase&,
                         const std::shared_ptr<FactorType>& node_type,
                         const std::string& variable,
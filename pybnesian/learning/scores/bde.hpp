@@ -1,16 +1,62 @@
 #ifndef PYBNESIAN_LEARNING_SCORES_BDE_HPP
 #define PYBNESIAN_LEARNING_SCORES_BDE_HPP
 
+#include <cmath>
+#include <mutex>
 #include <factors/discrete/DiscreteFactor.hpp>
+#include <factors/discrete/joint_counts_cache.hpp>
 #include <learning/scores/scores.hpp>
 
 using factors::discrete::DiscreteFactorType;
 
 namespace learning::scores {
 
+// Memoized values of lgamma(m + alpha) for the integer counts m of a family, where alpha is fixed for each family
+// cardinality. A table stores the counts m < min(max_count + 1, max_table_size), and the greater counts are computed
+// with std::lgamma. Thus, the tables return the same values as std::lgamma. At most max_tables tables are stored. The
+// tables can be requested concurrently.
+class LgammaCache {
+public:
+    static constexpr int max_table_size = 1 << 16;
+    static constexpr std::size_t max_tables = 256;
+
+    class Table {
+    public:
+        Table(double alpha, int size);
+
+        double lgamma(int m) const {
+            return (m < static_cast<int>(m_values.size())) ? m_values[m] : std::lgamma(m + m_alpha);
+        }
+
+    private:
+        double m_alpha;
+        std::vector<double> m_values;
+    };
+
+    LgammaCache(int max_count) : m_table_size(std::min(max_count + 1, max_table_size)), m_mutex(), m_tables() {}
+
+    std::shared_ptr<const Table> table(double alpha);
+
+    // Number of bytes of the stored tables.
+    std::size_t memory() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return sizeof(double) * m_table_size * m_tables.size();
+    }
+
+private:
+    int m_table_size;
+    mutable std::mutex m_mutex;
+    std::unordered_map<double, std::shared_ptr<const Table>> m_tables;
+};
+
 class BDe : public Score {
 public:
-    BDe(const DataFrame& df, double iss = 1) : m_df(df), m_iss(iss) {}
+    BDe(const DataFrame& df, double iss = 1)
+        : m_df(df),
+          m_iss(iss),
+          m_counts_cache(std::make_shared<factors::discrete::JointCountsCache>(
+              std::make_shared<factors::discrete::BitSlicedIndex>(df))),
+          m_lgamma_cache(std::make_shared<LgammaCache>(df->num_rows())) {}
 
     double local_score(const BayesianNetworkBase& model,
                        const std::string& variable,
@@ -21,6 +67,10 @@ public:
                        const std::string& variable,
                        const std::vector<std::string>& parents) const override;
 
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override;
+
     std::string ToString() const override { return "BDe"; }
 
     bool has_variables(const std::string& name) const override { return m_df.has_columns(name); }
@@ -41,12 +91,32 @@ public:
 
     DataFrame data() const override { return m_df; }
 
+    // The memory of the cache of joint counts and of the lgamma tables. The limit is applied to the cache of joint
+    // counts, because the number of lgamma tables is bounded by LgammaCache::max_tables.
+    util::MemoryUsage memory_usage() const override {
+        util::MemoryUsage usage;
+        usage.add("counts_cache", m_counts_cache->memory_usage());
+        usage.add("lgamma_cache", m_lgamma_cache->memory());
+        return usage;
+    }
+
+    void set_max_cache_memory(std::size_t max_memory) override {
+        m_counts_cache->set_max_cells(
+            std::min(factors::discrete::JointCountsCache::default_max_cells, max_memory / sizeof(int)));
+    }
+
 private:
     double bde_impl_noparents(const std::string& variable) const;
     double bde_impl_parents(const std::string& variable, const std::vector<std::string>& parents) const;
+    double bde_noparents_counts(const VectorXi& cardinality, const VectorXi& joint_counts) const;
+    double bde_parents_counts(const VectorXi& cardinality, const VectorXi& joint_counts) const;
+    double bde_parents_sparse_counts(const VectorXi& cardinality,
+                                     const factors::discrete::SparseJointCounts& sparse_counts) const;
 
     const DataFrame m_df;
     double m_iss;
+    std::shared_ptr<factors::discrete::JointCountsCache> m_counts_cache;
+    std::shared_ptr<LgammaCache> m_lgamma_cache;
 };
 
 using DynamicBDe = DynamicScoreAdaptator<BDe>;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <learning/scores/bge.hpp>
 
 using models::GaussianNetworkType;
@@ -38,23 +39,6 @@ double BGe::bge_parents(const std::string& variable,
     }
 }
 
-void BGe::generate_cached_r(MatrixXd& r, const std::string& variable, const std::vector<std::string>& parents) const {
-    int var_index = cached_index(variable);
-    r(0, 0) = m_cached_sse(var_index, var_index);
-
-    for (size_t i = 0, end = parents.size(); i < end; ++i) {
-        int ei_index = cached_index(parents[i]);
-        r(i + 1, i + 1) = m_cached_sse(ei_index, ei_index);
-
-        r(0, i + 1) = r(i + 1, 0) = m_cached_sse(var_index, ei_index);
-
-        for (size_t j = i + 1; j < end; ++j) {
-            int ej_index = cached_index(parents[j]);
-            r(i + 1, j + 1) = r(j + 1, i + 1) = m_cached_sse(ei_index, ej_index);
-        }
-    }
-}
-
 void BGe::generate_r(MatrixXd& r, const std::string& variable, const std::vector<std::string>& parents) const {
     auto type = m_df.same_type(variable, parents);
     switch (type->id()) {
@@ -73,18 +57,6 @@ void BGe::generate_r(MatrixXd& r, const std::string& variable, const std::vector
     }
 }
 
-void BGe::generate_cached_means(VectorXd& means,
-                                const std::string& variable,
-                                const std::vector<std::string>& parents) const {
-    int var_index = cached_index(variable);
-    means(0) = m_cached_means(var_index);
-
-    for (size_t i = 0, end = parents.size(); i < end; ++i) {
-        int ei_index = cached_index(parents[i]);
-        means(i + 1) = m_cached_means(ei_index);
-    }
-}
-
 void BGe::generate_means(VectorXd& means, const std::string& variable, const std::vector<std::string>& parents) const {
     auto type = m_df.same_type(variable, parents);
     switch (type->id()) {
@@ -103,9 +75,178 @@ void BGe::generate_means(VectorXd& means, const std::string& variable, const std
     }
 }
 
+BGe::ParentsFactor BGe::parents_factor(int variable, const std::vector<int>& parents, double t) const {
+    int p = parents.size();
+    MatrixXd r(p, p);
+    VectorXd r_variable(p);
+    for (int i = 0; i < p; ++i) {
+        r_variable(i) = cached_r(parents[i], variable, t);
+        for (int j = i; j < p; ++j) {
+            r(i, j) = r(j, i) = cached_r(parents[i], parents[j], t);
+        }
+    }
+
+    Eigen::LLT<MatrixXd> llt(r);
+
+    ParentsFactor factor;
+    factor.parents = parents;
+    factor.variable = variable;
+    factor.t = t;
+    factor.r_inverse = llt.solve(MatrixXd::Identity(p, p));
+    factor.beta = factor.r_inverse * r_variable;
+    factor.log_det = 2 * llt.matrixLLT().diagonal().array().log().sum();
+    factor.schur = cached_r(variable, variable, t) - r_variable.dot(factor.beta);
+    return factor;
+}
+
+std::shared_ptr<const BGe::ParentsFactor> BGe::model_parents_factor(const BayesianNetworkBase& model,
+                                                                    const std::string& variable,
+                                                                    double t) const {
+    std::vector<int> parents;
+    for (const auto& p : model.parents(variable)) {
+        parents.push_back(cached_index(p));
+    }
+    std::sort(parents.begin(), parents.end());
+
+    {
+        std::lock_guard<std::mutex> lock(m_parents_factors->mutex);
+        auto it = m_parents_factors->factors.find(variable);
+        if (it != m_parents_factors->factors.end() && it->second->t == t && it->second->parents == parents)
+            return it->second;
+    }
+
+    auto factor = std::make_shared<const ParentsFactor>(parents_factor(cached_index(variable), parents, t));
+    std::lock_guard<std::mutex> lock(m_parents_factors->mutex);
+    m_parents_factors->factors[variable] = factor;
+    return factor;
+}
+
+double BGe::bge_parents_cached(const BayesianNetworkBase& model,
+                               const std::string& variable,
+                               const std::vector<std::string>& parents) const {
+    int total_nodes = model.num_nodes();
+    double N = m_df->num_rows();
+    double p = parents.size();
+
+    double logprob = 0.5 * (log(m_iss_mu) - log(N + m_iss_mu));
+    logprob += lgamma(0.5 * (N + m_iss_w - total_nodes + p + 1)) - lgamma(0.5 * (m_iss_w - total_nodes + p + 1));
+    logprob -= 0.5 * N * log(util::pi<double>);
+
+    double t = m_iss_mu * (m_iss_w - total_nodes - 1) / (m_iss_mu + 1);
+    logprob += 0.5 * (m_iss_w - total_nodes + 2 * p + 1) * log(t);
+
+    std::vector<int> indices;
+    indices.reserve(parents.size());
+    for (const auto& e : parents) {
+        indices.push_back(cached_index(e));
+    }
+    std::sort(indices.begin(), indices.end());
+
+    auto base = model_parents_factor(model, variable, t);
+    const auto& base_parents = base->parents;
+    int v = base->variable;
+
+    double log_det;
+    double schur;
+    if (indices == base_parents) {
+        log_det = base->log_det;
+        schur = base->schur;
+    } else if (indices.size() + 1 == base_parents.size() &&
+               std::includes(base_parents.begin(), base_parents.end(), indices.begin(), indices.end())) {
+        // Removes a parent x: det(R_{-x}) = det(R) * (R^-1)_xx, and the Schur complement of the variable increases by
+        // beta_x^2 / (R^-1)_xx.
+        auto k = std::mismatch(indices.begin(), indices.end(), base_parents.begin()).second - base_parents.begin();
+        double inv_kk = base->r_inverse(k, k);
+        log_det = base->log_det + log(inv_kk);
+        schur = base->schur + base->beta(k) * base->beta(k) / inv_kk;
+    } else if (indices.size() == base_parents.size() + 1 &&
+               std::includes(indices.begin(), indices.end(), base_parents.begin(), base_parents.end())) {
+        // Adds a parent x: c = R_xx - R_xB R_B^-1 R_Bx is the Schur complement of x given the current parents B.
+        int x = *std::mismatch(base_parents.begin(), base_parents.end(), indices.begin()).second;
+        int b = base_parents.size();
+        VectorXd r_x(b);
+        for (int i = 0; i < b; ++i) {
+            r_x(i) = cached_r(base_parents[i], x, t);
+        }
+
+        VectorXd g = base->r_inverse * r_x;
+        double c = cached_r(x, x, t) - r_x.dot(g);
+        double cross = cached_r(x, v, t);
+        for (int i = 0; i < b; ++i) {
+            cross -= g(i) * cached_r(base_parents[i], v, t);
+        }
+
+        log_det = base->log_det + log(c);
+        schur = base->schur - cross * cross / c;
+    } else {
+        auto factor = parents_factor(v, indices, t);
+        log_det = factor.log_det;
+        schur = factor.schur;
+    }
+
+    logprob -= 0.5 * (N + m_iss_w - total_nodes + p + 1) * (log_det + log(schur));
+    logprob += 0.5 * (N + m_iss_w - total_nodes + p) * log_det;
+    return logprob;
+}
+
+double BGe::bge_pattern(const BayesianNetworkBase& model,
+                        const std::string& variable,
+                        const std::vector<std::string>& parents) const {
+    std::vector<int> indices;
+    indices.reserve(parents.size() + 1);
+    indices.push_back(cached_index(variable));
+    for (const auto& e : parents) {
+        indices.push_back(cached_index(e));
+    }
+
+    auto moments = m_pattern_moments->moments(indices);
+
+    int total_nodes = model.num_nodes();
+    double N = moments->rows;
+    int p = parents.size();
+
+    double logprob = 0.5 * (log(m_iss_mu) - log(N + m_iss_mu));
+    logprob += lgamma(0.5 * (N + m_iss_w - total_nodes + p + 1)) - lgamma(0.5 * (m_iss_w - total_nodes + p + 1));
+    logprob -= 0.5 * N * log(util::pi<double>);
+
+    double t = m_iss_mu * (m_iss_w - total_nodes - 1) / (m_iss_mu + 1);
+    logprob += 0.5 * (m_iss_w - total_nodes + 2 * p + 1) * log(t);
+
+    // The default nu is the mean of each column in the rows of the pattern.
+    std::vector<int> positions;
+    VectorXd nu_diff = VectorXd::Zero(p + 1);
+    positions.reserve(p + 1);
+    for (int i = 0; i <= p; ++i) {
+        positions.push_back(moments->positions[indices[i]]);
+        if (m_nu) {
+            const auto& name = (i == 0) ? variable : parents[i - 1];
+            nu_diff(i) = moments->means(positions[i]) - (*m_nu)(m_df.index(name));
+        }
+    }
+
+    double cte_r = (N * m_iss_mu) / (N + m_iss_mu);
+    MatrixXd r_full(p + 1, p + 1);
+    for (int i = 0; i <= p; ++i) {
+        r_full(i, i) = moments->sse(positions[i], positions[i]) + cte_r * nu_diff(i) * nu_diff(i) + t;
+        for (int j = i + 1; j <= p; ++j) {
+            r_full(i, j) = r_full(j, i) = moments->sse(positions[i], positions[j]) + cte_r * nu_diff(i) * nu_diff(j);
+        }
+    }
+
+    logprob -= 0.5 * (N + m_iss_w - total_nodes + p + 1) * log(r_full.determinant());
+    if (p > 0) {
+        auto r_parents = r_full.bottomRightCorner(p, p);
+        logprob += 0.5 * (N + m_iss_w - total_nodes + p) * log(r_parents.determinant());
+    }
+
+    return logprob;
+}
+
 double BGe::bge_impl(const BayesianNetworkBase& model,
                      const std::string& variable,
                      const std::vector<std::string>& parents) const {
+    if (m_pattern_moments) return bge_pattern(model, variable, parents);
+
     if (parents.empty()) {
         double nu = [this, &variable]() {
             if (m_nu) {
@@ -118,6 +259,8 @@ double BGe::bge_impl(const BayesianNetworkBase& model,
         auto col = m_df.col(variable);
 
         return bge_no_parents(variable, model.num_nodes(), nu);
+    } else if (m_is_cached) {
+        return bge_parents_cached(model, variable, parents);
     } else {
         VectorXd nu = [this, &variable, &parents]() {
             if (m_nu) {
@@ -154,6 +297,59 @@ double BGe::local_score(const BayesianNetworkBase& model,
                                 "\" not valid for score BGe");
 }
 
+std::vector<double> BGe::local_scores(const BayesianNetworkBase& model,
+                                      const std::string& variable,
+                                      const std::vector<std::vector<std::string>>& parents_sets) const {
+    if (*model.node_type(variable) != LinearGaussianCPDType::get_ref()) {
+        throw std::invalid_argument("Bayesian network type \"" + model.type_ref().ToString() +
+                                    "\" not valid for score BGe");
+    }
+
+    std::vector<std::string> all_parents;
+    for (const auto& parents : parents_sets) {
+        for (const auto& p : parents) {
+            if (std::find(all_parents.begin(), all_parents.end(), p) == all_parents.end()) all_parents.push_back(p);
+        }
+    }
+
+    std::vector<double> res;
+    res.reserve(parents_sets.size());
+
+    // When the SSE is cached, bge_impl() updates the factor of the current parents of variable. Otherwise, without
+    // nulls, the means of every parent set are the means of each column, so they are computed only once for all the
+    // parent sets.
+    if (m_is_cached || m_nu || parents_sets.size() < 2 || m_df.null_count(variable, all_parents) > 0) {
+        for (const auto& parents : parents_sets) {
+            res.push_back(bge_impl(model, variable, parents));
+        }
+
+        return res;
+    }
+
+    auto all_means = m_df.means(variable, all_parents);
+
+    std::unordered_map<std::string, int> mean_index;
+    for (int i = 0, end = all_parents.size(); i < end; ++i) {
+        mean_index.insert({all_parents[i], i + 1});
+    }
+
+    for (const auto& parents : parents_sets) {
+        if (parents.empty()) {
+            res.push_back(bge_no_parents(variable, model.num_nodes(), all_means(0)));
+        } else {
+            VectorXd nu(parents.size() + 1);
+            nu(0) = all_means(0);
+            for (int i = 0, end = parents.size(); i < end; ++i) {
+                nu(i + 1) = all_means(mean_index.at(parents[i]));
+            }
+
+            res.push_back(bge_parents(variable, parents, model.num_nodes(), nu));
+        }
+    }
+
+    return res;
+}
+
 double BGe::local_score(const BayesianNetworkBase& model,
                         const std::shared_ptr<FactorType>& node_type,
                         const std::string& variable,
@@ -165,4 +361,24 @@ double BGe::local_score(const BayesianNetworkBase& model,
     throw std::invalid_argument("Node type \"" + node_type->ToString() + "\" not valid for score BGe");
 }
 
-}  // namespace learning::scores
\ No newline at end of file
+util::MemoryUsage BGe::memory_usage() const {
+    util::MemoryUsage usage;
+    usage.add("sse",
+              util::eigen_bytes(m_cached_sse) + util::eigen_bytes(m_cached_means) +
+                  util::eigen_bytes(m_cached_nu_diff));
+
+    std::size_t factors_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_parents_factors->mutex);
+        for (const auto& f : m_parents_factors->factors) {
+            factors_bytes += util::vector_bytes(f.second->parents) + util::eigen_bytes(f.second->r_inverse) +
+                             util::eigen_bytes(f.second->beta);
+        }
+    }
+    usage.add("parents_factors", factors_bytes);
+
+    if (m_pattern_moments) usage.add("pattern_moments", m_pattern_moments->memory());
+    return usage;
+}
+
+}  // namespace learning::scores
@@ -1,11 +1,15 @@
 #ifndef PYBNESIAN_LEARNING_SCORES_BGE_HPP
 #define PYBNESIAN_LEARNING_SCORES_BGE_HPP
 
+#include <algorithm>
+#include <mutex>
 #include <dataset/dataset.hpp>
+#include <dataset/dynamic_dataset.hpp>
+#include <dataset/missing_patterns.hpp>
 #include <models/BayesianNetwork.hpp>
 #include <learning/scores/scores.hpp>
 
-using dataset::DataFrame;
+using dataset::DataFrame, dataset::LaggedDataFrame, dataset::MissingPatternMoments;
 using learning::scores::Score;
 using models::BayesianNetworkBase, models::BayesianNetworkType, models::GaussianNetworkType;
 
@@ -17,14 +21,73 @@ public:
         double iss_mu = 1,
         std::optional<double> iss_w = std::nullopt,
         std::optional<VectorXd> nu = std::nullopt)
+        : BGe(df, nullptr, iss_mu, iss_w, nu) {}
+    // The means and the sum of squared errors of the columns of df are computed with LaggedDataFrame::moments().
+    BGe(const LaggedDataFrame& df,
+        double iss_mu = 1,
+        std::optional<double> iss_w = std::nullopt,
+        std::optional<VectorXd> nu = std::nullopt)
+        : BGe(df.dataframe(), &df, iss_mu, iss_w, nu) {}
+
+    double local_score(const BayesianNetworkBase& model,
+                       const std::string& variable,
+                       const std::vector<std::string>& parents) const override;
+
+    double local_score(const BayesianNetworkBase& model,
+                       const std::shared_ptr<FactorType>& node_type,
+                       const std::string& variable,
+                       const std::vector<std::string>& parents) const override;
+
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override;
+
+    std::string ToString() const override { return "BGe"; }
+
+    bool has_variables(const std::string& name) const override { return m_df.has_columns(name); }
+
+    bool has_variables(const std::vector<std::string>& cols) const override { return m_df.has_columns(cols); }
+
+    bool compatible_bn(const BayesianNetworkBase& model) const override {
+        const auto& model_type = model.type_ref();
+        return model_type.is_homogeneous() && *model_type.default_node_type() == LinearGaussianCPDType::get_ref() &&
+               m_df.has_columns(model.nodes());
+    }
+
+    bool compatible_bn(const ConditionalBayesianNetworkBase& model) const override {
+        const auto& model_type = model.type_ref();
+        return model_type.is_homogeneous() && *model_type.default_node_type() == LinearGaussianCPDType::get_ref() &&
+               m_df.has_columns(model.joint_nodes());
+    }
+
+    DataFrame data() const override { return m_df; }
+
+    // The memory of the cached SSE, the factors of the parents of the last model and the moments of the missingness
+    // patterns. The limit is applied to the moments of the missingness patterns, because the rest are bounded by the
+    // number of variables.
+    util::MemoryUsage memory_usage() const override;
+    void set_max_cache_memory(std::size_t max_memory) override {
+        if (m_pattern_moments)
+            m_pattern_moments->set_max_cells(std::min(MissingPatternMoments::max_cells, max_memory / sizeof(double)));
+    }
+
+private:
+    BGe(const DataFrame& df,
+        const LaggedDataFrame* lagged,
+        double iss_mu,
+        std::optional<double> iss_w,
+        std::optional<VectorXd> nu)
         : m_df(df),
           m_iss_mu(iss_mu),
           m_iss_w(),
           m_nu(),
           m_cached_sse(),
           m_cached_means(),
+          m_cached_nu_diff(),
           m_is_cached(false),
-          m_cached_indices() {
+          m_cached_indices(),
+          m_parents_factors(std::make_shared<ParentsFactorCache>()),
+          m_pattern_moments() {
         if (iss_w) {
             if (*iss_w <= df->num_columns() - 1) {
                 throw std::invalid_argument(
@@ -51,57 +114,74 @@ public:
 
         auto continuous_indices = df.continuous_columns();
 
-        if (m_df.null_count(continuous_indices) == 0) {
+        for (int i = 0, size = continuous_indices.size(); i < size; ++i) {
+            m_cached_indices.insert(std::make_pair(m_df->column_name(continuous_indices[i]), i));
+        }
+
+        if (m_df.null_count(continuous_indices) > 0) {
+            // With nulls, the SSE is cached for each missingness pattern. This requires the same data type in all the
+            // continuous columns.
+            auto type = m_df.col(continuous_indices[0])->type_id();
+            bool same_type = std::all_of(continuous_indices.begin(), continuous_indices.end(), [this, type](int i) {
+                return m_df.col(i)->type_id() == type;
+            });
+
+            if (same_type) m_pattern_moments = std::make_shared<MissingPatternMoments>(m_df, continuous_indices);
+        } else {
             m_is_cached = true;
-            for (int i = 0, size = continuous_indices.size(); i < size; ++i) {
-                m_cached_indices.insert(std::make_pair(m_df->column_name(continuous_indices[i]), i));
+            if (lagged) {
+                std::tie(m_cached_means, m_cached_sse) = lagged->moments(continuous_indices);
+            } else {
+                switch (m_df.same_type(continuous_indices)->id()) {
+                    case Type::DOUBLE:
+                        m_cached_means = m_df.means<arrow::DoubleType>(continuous_indices);
+                        m_cached_sse = std::move(*m_df.sse<arrow::DoubleType, false>(continuous_indices));
+                        break;
+                    case Type::FLOAT:
+                        m_cached_means = m_df.means<arrow::FloatType>(continuous_indices).template cast<double>();
+                        m_cached_sse = m_df.sse<arrow::FloatType, false>(continuous_indices)->template cast<double>();
+                        break;
+                    default:
+                        break;
+                }
             }
 
-            switch (m_df.same_type(continuous_indices)->id()) {
-                case Type::DOUBLE:
-                    m_cached_means = m_df.means<arrow::DoubleType>(continuous_indices);
-                    m_cached_sse = std::move(*m_df.sse<arrow::DoubleType, false>(continuous_indices));
-                    break;
-                case Type::FLOAT:
-                    m_cached_means = m_df.means<arrow::FloatType>(continuous_indices).template cast<double>();
-                    m_cached_sse = m_df.sse<arrow::FloatType, false>(continuous_indices)->template cast<double>();
-                    break;
-                default:
-                    break;
+            // Without nulls, the default nu of every parent set is the mean of each column.
+            m_cached_nu_diff = VectorXd::Zero(continuous_indices.size());
+            if (m_nu) {
+                for (int i = 0, size = continuous_indices.size(); i < size; ++i) {
+                    m_cached_nu_diff(i) = m_cached_means(i) - (*m_nu)(continuous_indices[i]);
+                }
             }
         }
     }
 
-    double local_score(const BayesianNetworkBase& model,
-                       const std::string& variable,
-                       const std::vector<std::string>& parents) const override;
-
-    double local_score(const BayesianNetworkBase& model,
-                       const std::shared_ptr<FactorType>& node_type,
-                       const std::string& variable,
-                       const std::vector<std::string>& parents) const override;
-
-    std::string ToString() const override { return "BGe"; }
-
-    bool has_variables(const std::string& name) const override { return m_df.has_columns(name); }
-
-    bool has_variables(const std::vector<std::string>& cols) const override { return m_df.has_columns(cols); }
-
-    bool compatible_bn(const BayesianNetworkBase& model) const override {
-        const auto& model_type = model.type_ref();
-        return model_type.is_homogeneous() && *model_type.default_node_type() == LinearGaussianCPDType::get_ref() &&
-               m_df.has_columns(model.nodes());
-    }
-
-    bool compatible_bn(const ConditionalBayesianNetworkBase& model) const override {
-        const auto& model_type = model.type_ref();
-        return model_type.is_homogeneous() && *model_type.default_node_type() == LinearGaussianCPDType::get_ref() &&
-               m_df.has_columns(model.joint_nodes());
-    }
-
-    DataFrame data() const override { return m_df; }
+    // The matrix R of bge_parents() of the parents of a node in the model. Without nulls, R of a parent set is a
+    // submatrix of R of all the columns, so the scores of the parent sets that add or remove one parent (the
+    // neighbourhood of hill-climbing) are computed with a rank-one update of R^-1 of the current parents, instead of
+    // computing two determinants from scratch.
+    struct ParentsFactor {
+        // The cached indices of the parents and the variable.
+        std::vector<int> parents;
+        int variable;
+        double t;
+        // R^-1 of the parents, obtained from its Cholesky decomposition.
+        MatrixXd r_inverse;
+        // R^-1 R(parents, variable).
+        VectorXd beta;
+        // log(det(R)) of the parents.
+        double log_det;
+        // R(variable, variable) - R(variable, parents) R^-1 R(parents, variable), so the log-determinant of R of the
+        // variable and the parents is log_det + log(schur).
+        double schur;
+    };
+
+    // The ParentsFactor of the parents of each variable in the last model. It is shared by the copies of the score.
+    struct ParentsFactorCache {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<const ParentsFactor>> factors;
+    };
 
-private:
     int cached_index(int v) const {
         auto it = m_cached_indices.find(m_df->column_name(v));
         if (it == m_cached_indices.end())
@@ -133,12 +213,28 @@ private:
                        int total_nodes,
                        VectorXd& nu) const;
 
-    void generate_cached_r(MatrixXd& r, const std::string& variable, const std::vector<std::string>& parents) const;
-    void generate_r(MatrixXd& r, const std::string& variable, const std::vector<std::string>& parents) const;
+    // The score of variable given parents (not empty) when the SSE is cached.
+    double bge_parents_cached(const BayesianNetworkBase& model,
+                              const std::string& variable,
+                              const std::vector<std::string>& parents) const;
+    // The score of variable given parents with the SSE of their missingness pattern, when the DataFrame contains nulls.
+    double bge_pattern(const BayesianNetworkBase& model,
+                       const std::string& variable,
+                       const std::vector<std::string>& parents) const;
+    // The entry (i, j) of R of the cached columns.
+    double cached_r(int i, int j, double t) const {
+        double N = m_df->num_rows();
+        double cte_r = (N * m_iss_mu) / (N + m_iss_mu);
+        double r = m_cached_sse(i, j) + cte_r * m_cached_nu_diff(i) * m_cached_nu_diff(j);
+        return (i == j) ? r + t : r;
+    }
+    ParentsFactor parents_factor(int variable, const std::vector<int>& parents, double t) const;
+    // Returns the ParentsFactor of the parents of variable in the model.
+    std::shared_ptr<const ParentsFactor> model_parents_factor(const BayesianNetworkBase& model,
+                                                              const std::string& variable,
+                                                              double t) const;
 
-    void generate_cached_means(VectorXd& means,
-                               const std::string& variable,
-                               const std::vector<std::string>& parents) const;
+    void generate_r(MatrixXd& r, const std::string& variable, const std::vector<std::string>& parents) const;
     void generate_means(VectorXd& means, const std::string& variable, const std::vector<std::string>& parents) const;
 
     const DataFrame m_df;
@@ -147,8 +243,12 @@ private:
     std::optional<VectorXd> m_nu;
     MatrixXd m_cached_sse;
     VectorXd m_cached_means;
+    // The difference between the cached means and nu.
+    VectorXd m_cached_nu_diff;
     bool m_is_cached;
     std::unordered_map<std::string, int> m_cached_indices;
+    std::shared_ptr<ParentsFactorCache> m_parents_factors;
+    std::shared_ptr<MissingPatternMoments> m_pattern_moments;
 };
 
 template <typename ArrowType>
@@ -200,13 +300,8 @@ double BGe::bge_parents(const std::string& variable,
     VectorXd means_full(evidence.size() + 1);
     MatrixXd r_full(evidence.size() + 1, evidence.size() + 1);
 
-    if (m_is_cached) {
-        generate_cached_means(means_full, variable, evidence);
-        generate_cached_r(r_full, variable, evidence);
-    } else {
-        generate_means(means_full, variable, evidence);
-        generate_r(r_full, variable, evidence);
-    }
+    generate_means(means_full, variable, evidence);
+    generate_r(r_full, variable, evidence);
 
     for (size_t i = 0, end = evidence.size() + 1; i < end; ++i) {
         r_full(i, i) += t;
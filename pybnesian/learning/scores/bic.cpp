@@ -9,7 +9,138 @@ using models::GaussianNetworkType;
 
 namespace learning::scores {
 
+namespace {
+
+// Log-likelihood of a LinearGaussianCPD fitted with the weighted statistics, where the number of instances is the sum
+// of the weights.
+double weighted_lineargaussian_loglik(const LinearGaussianCPD_Statistics& stats) {
+    auto params = learning::parameters::_fit_statistics(stats);
+
+    if (params.variance < util::machine_tol || std::isinf(params.variance)) {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    auto rows = stats.count;
+    auto num_parents = static_cast<double>(stats.mean.rows() - 1);
+    return 0.5 * (1 + num_parents - rows) - 0.5 * rows * std::log(2 * util::pi<double>) -
+           rows * 0.5 * std::log(params.variance);
+}
+
+}  // namespace
+
+const BIC::CachedSSE& BIC::cached_sse() const {
+    std::call_once(m_cached_sse->initialized, [this]() {
+        bool has_double = false;
+        bool has_float = false;
+        std::vector<int> continuous_indices;
+        for (int i = 0, num_columns = m_df->num_columns(); i < num_columns; ++i) {
+            switch (m_df.col(i)->type_id()) {
+                case Type::DOUBLE:
+                    has_double = true;
+                    continuous_indices.push_back(i);
+                    break;
+                case Type::FLOAT:
+                    has_float = true;
+                    continuous_indices.push_back(i);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (continuous_indices.empty() || (has_double && has_float) || m_df.null_count(continuous_indices) > 0) return;
+
+        if (has_double)
+            m_cached_sse->sse = std::move(*m_df.sse<arrow::DoubleType, false>(continuous_indices));
+        else
+            m_cached_sse->sse = m_df.sse<arrow::FloatType, false>(continuous_indices)->template cast<double>();
+
+        for (int i = 0, size = continuous_indices.size(); i < size; ++i) {
+            m_cached_sse->indices.insert(std::make_pair(m_df->column_name(continuous_indices[i]), i));
+        }
+
+        m_cached_sse->is_cached = true;
+    });
+
+    m_cached_sse->computed = true;
+    return *m_cached_sse;
+}
+
+util::MemoryUsage BIC::memory_usage() const {
+    util::MemoryUsage usage;
+    if (m_cached_sse->computed) usage.add("sse", util::eigen_bytes(m_cached_sse->sse));
+    usage.add("counts_cache", m_counts_cache->memory_usage());
+    return usage;
+}
+
+void BIC::set_max_cache_memory(std::size_t max_memory) {
+    m_counts_cache->set_max_cells(
+        std::min(factors::discrete::JointCountsCache::default_max_cells, max_memory / sizeof(int)));
+}
+
+double BIC::bic_lineargaussian_cached(const CachedSSE& cache,
+                                      const std::string& variable,
+                                      const std::vector<std::string>& parents) const {
+    double rows = m_df->num_rows();
+    auto var_index = cache.indices.at(variable);
+
+    // Parents with zero variance are not used in the regression (their coefficients are 0), as in
+    // MLE<LinearGaussianCPD>.
+    std::vector<int> parent_indices;
+    parent_indices.reserve(parents.size());
+    for (const auto& p : parents) {
+        auto index = cache.indices.at(p);
+        if (cache.sse(index, index) / (rows - 1) >= util::machine_tol) parent_indices.push_back(index);
+    }
+
+    auto num_parents = parents.size();
+    if (rows <= num_parents + 1) {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    double rss = cache.sse(var_index, var_index);
+    if (!parent_indices.empty()) {
+        auto k = parent_indices.size();
+        MatrixXd sse_parents(k, k);
+        VectorXd sse_cross(k);
+        for (size_t i = 0; i < k; ++i) {
+            sse_cross(i) = cache.sse(parent_indices[i], var_index);
+            for (size_t j = 0; j < k; ++j) {
+                sse_parents(i, j) = cache.sse(parent_indices[i], parent_indices[j]);
+            }
+        }
+
+        // The column pivoting solves the regression even if some parents are collinear.
+        VectorXd beta = sse_parents.colPivHouseholderQr().solve(sse_cross);
+        rss -= sse_cross.dot(beta);
+    }
+
+    auto variance = rss / (rows - num_parents - 1);
+
+    if (variance < util::machine_tol || std::isinf(variance)) {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    auto loglik = 0.5 * (1 + static_cast<double>(num_parents) - rows) - 0.5 * rows * std::log(2 * util::pi<double>) -
+                  rows * 0.5 * std::log(variance);
+
+    return loglik - std::log(rows) * 0.5 * (num_parents + 2);
+}
+
 double BIC::bic_lineargaussian(const std::string& variable, const std::vector<std::string>& parents) const {
+    if (m_weights) {
+        auto stats = learning::parameters::linear_gaussian_statistics(m_df, variable, parents, *m_weights);
+        return weighted_lineargaussian_loglik(stats) - std::log(stats.count) * 0.5 * (parents.size() + 2);
+    }
+
+    const auto& cache = cached_sse();
+    if (cache.is_cached && cache.indices.count(variable) > 0 &&
+        std::all_of(parents.begin(), parents.end(), [&cache](const std::string& p) {
+            return cache.indices.count(p) > 0;
+        })) {
+        return bic_lineargaussian_cached(cache, variable, parents);
+    }
+
     MLE<LinearGaussianCPD> mle;
 
     auto mle_params = mle.estimate(m_df, variable, parents);
@@ -32,7 +163,9 @@ double BIC::bic_clg(const std::string& variable,
     auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, discrete_parents);
 
     auto num_configs = cardinality.prod();
-    auto slices = factors::discrete::discrete_slice_indices(m_df, discrete_parents, strides, num_configs);
+    // The rows are reordered by configuration once, so the data of each configuration is a slice.
+    factors::discrete::DiscretePartition partition(
+        m_df, discrete_parents, strides, num_configs, m_df.loc(variable, continuous_parents));
 
     MLE<LinearGaussianCPD> mle;
 
@@ -40,10 +173,35 @@ double BIC::bic_clg(const std::string& variable,
 
     auto num_continuous_parents = continuous_parents.size();
 
-    for (auto i = 0; i < num_configs; ++i) {
-        if (slices[i]) {
-            // Calling take() can be slower than fitting all the linear regressions at the same time (as bnlearn)
-            auto df_filtered = m_df.loc(variable, continuous_parents).take(slices[i]);
+    if (m_weights) {
+        double valid_rows = 0;
+        for (auto g = 0; g < partition.num_groups(); ++g) {
+            if (partition.rows(g) == 0) continue;
+
+            const auto* indices = partition.row_indices(g);
+            VectorXd group_weights(partition.rows(g));
+            for (auto i = 0; i < partition.rows(g); ++i) {
+                group_weights(i) = (*m_weights)(indices[i]);
+            }
+
+            auto stats = learning::parameters::linear_gaussian_statistics(
+                partition.data(g), variable, continuous_parents, group_weights);
+            // A configuration whose instances have zero weight is not observed.
+            if (stats.count == 0) continue;
+
+            auto group_loglik = weighted_lineargaussian_loglik(stats);
+            if (std::isinf(group_loglik)) return group_loglik;
+
+            loglik += group_loglik;
+            valid_rows += stats.count;
+        }
+
+        return loglik - std::log(valid_rows) * 0.5 * num_configs * (num_continuous_parents + 2);
+    }
+
+    for (auto g = 0; g < partition.num_groups(); ++g) {
+        if (partition.rows(g) > 0) {
+            auto df_filtered = partition.data(g);
 
             auto num_valid_config = df_filtered.valid_rows(variable, continuous_parents);
             auto mle_params = mle.estimate(df_filtered, variable, continuous_parents);
@@ -64,17 +222,31 @@ double BIC::bic_clg(const std::string& variable,
 }
 
 double BIC::bic_discrete(const std::string& variable, const std::vector<std::string>& parents) const {
-    auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, variable, parents);
-    auto joint_counts = factors::discrete::joint_counts(m_df, variable, parents, cardinality, strides);
+    if (m_weights) {
+        auto [cardinality, strides] = factors::discrete::create_cardinality_strides(m_df, variable, parents);
+        auto joint_counts =
+            factors::discrete::weighted_joint_counts(m_df, variable, parents, cardinality, strides, *m_weights);
+        return bic_discrete_counts(cardinality, joint_counts);
+    }
 
-    auto parent_configurations = cardinality.tail(parents.size()).prod();
+    auto [cardinality, joint_counts] = m_counts_cache->joint_counts(m_df, variable, parents);
+    return bic_discrete_counts(cardinality, joint_counts);
+}
+
+namespace {
+
+// The counts are integer (VectorXi) or weighted (VectorXd).
+template <typename Counts>
+double discrete_bic(const VectorXi& cardinality, const Counts& joint_counts) {
+    using CountType = typename Counts::Scalar;
+    auto parent_configurations = cardinality.tail(cardinality.rows() - 1).prod();
 
     double ll = 0;
 
     for (auto k = 0; k < parent_configurations; ++k) {
         auto offset = k * cardinality(0);
 
-        int sum_configuration = 0;
+        CountType sum_configuration = 0;
         for (auto i = 0; i < cardinality(0); ++i) {
             sum_configuration += joint_counts(offset + i);
         }
@@ -95,6 +267,16 @@ double BIC::bic_discrete(const std::string& variable, const std::vector<std::str
     return ll - std::log(sum_count) * 0.5 * (cardinality(0) - 1) * parent_configurations;
 }
 
+}  // namespace
+
+double BIC::bic_discrete_counts(const VectorXi& cardinality, const VectorXi& joint_counts) const {
+    return discrete_bic(cardinality, joint_counts);
+}
+
+double BIC::bic_discrete_counts(const VectorXi& cardinality, const VectorXd& joint_counts) const {
+    return discrete_bic(cardinality, joint_counts);
+}
+
 bool BIC::are_all_discrete(const BayesianNetworkBase& model, const std::vector<std::string>& vars) const {
     for (const auto& v : vars) {
         if (*model.underlying_node_type(m_df, v) != DiscreteFactorType::get_ref()) {
@@ -141,6 +323,102 @@ double BIC::local_score(const BayesianNetworkBase& model,
                                 "\" not valid for score BIC");
 }
 
+std::vector<double> BIC::local_scores(const BayesianNetworkBase& model,
+                                      const std::string& variable,
+                                      const std::vector<std::vector<std::string>>& parents_sets) const {
+    std::vector<double> res;
+    res.reserve(parents_sets.size());
+
+    const auto& node_type = *model.underlying_node_type(m_df, variable);
+    if (node_type == LinearGaussianCPDType::get_ref()) {
+        // The node type of each parent is checked only once for all the parent sets.
+        std::unordered_map<std::string, bool> is_discrete;
+        std::vector<std::string> discrete_parents;
+        std::vector<std::string> continuous_parents;
+
+        for (const auto& parents : parents_sets) {
+            discrete_parents.clear();
+            continuous_parents.clear();
+
+            for (const auto& p : parents) {
+                auto it = is_discrete.find(p);
+                if (it == is_discrete.end()) {
+                    auto discrete = *model.underlying_node_type(m_df, p) == DiscreteFactorType::get_ref();
+                    it = is_discrete.insert({p, discrete}).first;
+                }
+
+                if (it->second) {
+                    discrete_parents.push_back(p);
+                } else {
+                    continuous_parents.push_back(p);
+                }
+            }
+
+            if (discrete_parents.empty())
+                res.push_back(bic_lineargaussian(variable, parents));
+            else
+                res.push_back(bic_clg(variable, discrete_parents, continuous_parents));
+        }
+
+        return res;
+    }
+
+    if (node_type == DiscreteFactorType::get_ref()) {
+        for (const auto& parents : parents_sets) {
+            if (!are_all_discrete(model, parents)) {
+                throw std::invalid_argument("Local score for discrete variable " + variable +
+                                            " cannot be calculated"
+                                            " because the parents/evidence contains non-discrete variables.");
+            }
+        }
+
+        if (m_weights) {
+            for (const auto& parents : parents_sets) {
+                res.push_back(bic_discrete(variable, parents));
+            }
+
+            return res;
+        }
+
+        for (const auto& [cardinality, joint_counts] :
+             m_counts_cache->batch_joint_counts(m_df, variable, parents_sets)) {
+            res.push_back(bic_discrete_counts(cardinality, joint_counts));
+        }
+
+        return res;
+    }
+
+    throw std::invalid_argument("Bayesian network type \"" + model.type_ref().ToString() +
+                                "\" not valid for score BIC");
+}
+
+std::optional<double> BIC::add_parent_bound(const BayesianNetworkBase& model,
+                                            const std::string& variable,
+                                            const std::vector<std::string>& parents,
+                                            const std::string& new_parent,
+                                            double current_score) const {
+    if (*model.underlying_node_type(m_df, variable) != DiscreteFactorType::get_ref() ||
+        *model.underlying_node_type(m_df, new_parent) != DiscreteFactorType::get_ref() ||
+        !are_all_discrete(model, parents))
+        return std::nullopt;
+
+    auto new_parents = parents;
+    new_parents.push_back(new_parent);
+    // With null values, the number of instances of the local score depends on the parents.
+    if (m_df->num_rows() == 0 || m_df.null_count(variable, new_parents) > 0) return std::nullopt;
+
+    auto rows = m_weights ? m_weights->sum() : static_cast<double>(m_df->num_rows());
+    if (rows <= 0) return std::nullopt;
+    auto cardinality = factors::discrete::create_cardinality_strides(m_df, variable, new_parents).first;
+    double parent_configurations = cardinality.segment(1, parents.size()).cast<double>().prod();
+    double new_parent_cardinality = cardinality(cardinality.rows() - 1);
+
+    double penalty = std::log(rows) * 0.5 * (cardinality(0) - 1) * parent_configurations;
+    double loglik = current_score + penalty;
+    double max_gain = std::min(-loglik, rows * std::log(new_parent_cardinality));
+    return max_gain - penalty * (new_parent_cardinality - 1);
+}
+
 double BIC::local_score(const BayesianNetworkBase& model,
                         const std::shared_ptr<FactorType>& node_type,
                         const std::string& variable,
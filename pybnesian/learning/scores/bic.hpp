@@ -1,6 +1,9 @@
 #ifndef PYBNESIAN_LEARNING_SCORES_BIC_HPP
 #define PYBNESIAN_LEARNING_SCORES_BIC_HPP
 
+#include <atomic>
+#include <mutex>
+#include <factors/discrete/joint_counts_cache.hpp>
 #include <learning/scores/scores.hpp>
 #include <learning/parameters/mle_LinearGaussianCPD.hpp>
 
@@ -13,7 +16,10 @@ namespace learning::scores {
 
 class BIC : public Score {
 public:
-    BIC(const DataFrame& df) : m_df(df) {}
+    BIC(const DataFrame& df) : BIC(df, std::nullopt) {}
+    // The rows of df are weighted by weights (see factors::check_weights()), so the score is equal to the BIC of df
+    // with each row repeated (integer) weight times. The number of instances of the penalty is the sum of the weights.
+    BIC(const DataFrame& df, const VectorXd& weights) : BIC(df, std::optional<VectorXd>(weights)) {}
 
     double local_score(const BayesianNetworkBase& model,
                        const std::string& variable,
@@ -24,6 +30,19 @@ public:
                        const std::string& variable,
                        const std::vector<std::string>& parents) const override;
 
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override;
+
+    // The bound is only known for the discrete variables without null values: the log-likelihood is not positive, and
+    // the log-likelihood gain of a new parent is (N times) a conditional mutual information, which is at most the
+    // logarithm of the cardinality of the new parent. The bound subtracts the increase of the penalty.
+    std::optional<double> add_parent_bound(const BayesianNetworkBase& model,
+                                           const std::string& variable,
+                                           const std::vector<std::string>& parents,
+                                           const std::string& new_parent,
+                                           double current_score) const override;
+
     std::string ToString() const override { return "BIC"; }
 
     bool has_variables(const std::string& name) const override { return m_df.has_columns(name); }
@@ -38,9 +57,44 @@ public:
 
     DataFrame data() const override { return m_df; }
 
+    // The memory of the cached sums of squares and of the cache of joint counts. The limit is applied to the cache of
+    // joint counts, because the sums of squares are computed once.
+    util::MemoryUsage memory_usage() const override;
+    void set_max_cache_memory(std::size_t max_memory) override;
+
+    const std::optional<VectorXd>& weights() const { return m_weights; }
+
 private:
+    BIC(const DataFrame& df, std::optional<VectorXd> weights)
+        : m_df(df),
+          m_weights(std::move(weights)),
+          m_cached_sse(std::make_shared<CachedSSE>()),
+          m_counts_cache(std::make_shared<factors::discrete::JointCountsCache>(
+              std::make_shared<factors::discrete::BitSlicedIndex>(df))) {
+        if (m_weights) factors::check_weights(m_df, *m_weights);
+    }
+
+    // Sums of squared deviations and cross products of the continuous columns, if they do not contain nulls. They are
+    // computed the first time a Gaussian local score is needed, so the local scores of the linear Gaussian nodes do not
+    // depend on the number of rows. The cache is shared between the copies of the score.
+    struct CachedSSE {
+        std::once_flag initialized;
+        // Set after initialized is called, so memory_usage() can read the cache without calling cached_sse().
+        std::atomic<bool> computed = false;
+        bool is_cached = false;
+        MatrixXd sse;
+        std::unordered_map<std::string, int> indices;
+    };
+
+    const CachedSSE& cached_sse() const;
+
     double bic_lineargaussian(const std::string& variable, const std::vector<std::string>& parents) const;
+    double bic_lineargaussian_cached(const CachedSSE& cache,
+                                     const std::string& variable,
+                                     const std::vector<std::string>& parents) const;
     double bic_discrete(const std::string& variable, const std::vector<std::string>& parents) const;
+    double bic_discrete_counts(const VectorXi& cardinality, const VectorXi& joint_counts) const;
+    double bic_discrete_counts(const VectorXi& cardinality, const VectorXd& joint_counts) const;
     double bic_clg(const std::string& variable,
                    const std::vector<std::string>& discrete_parents,
                    const std::vector<std::string>& continuous_parents) const;
@@ -48,6 +102,9 @@ private:
     bool are_all_discrete(const BayesianNetworkBase& model, const std::vector<std::string>& vars) const;
 
     const DataFrame m_df;
+    std::optional<VectorXd> m_weights;
+    std::shared_ptr<CachedSSE> m_cached_sse;
+    std::shared_ptr<factors::discrete::JointCountsCache> m_counts_cache;
 };
 
 using DynamicBIC = DynamicScoreAdaptator<BIC>;
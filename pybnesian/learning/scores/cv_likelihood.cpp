@@ -1,7 +1,51 @@
+#include <numeric>
 #include <learning/scores/cv_likelihood.hpp>
+#include <factors/continuous/CKDE.hpp>
+#include <factors/continuous/LinearGaussianCPD.hpp>
+
+using factors::continuous::CKDE, factors::continuous::CKDEType, factors::continuous::LinearGaussianCPDType;
 
 namespace learning::scores {
 
+namespace {
+
+// The log-likelihood of each fold is stored and added in the order of the folds, so the score does not depend on the
+// number of threads.
+double sum_folds(const std::vector<double>& fold_logliks) {
+    return std::accumulate(fold_logliks.begin(), fold_logliks.end(), 0.);
+}
+
+void release_factors(std::vector<std::shared_ptr<factors::Factor>>& cpds) {
+    for (auto& cpd : cpds) {
+        factors::release_factor(cpd);
+    }
+}
+
+}  // namespace
+
+std::vector<DataFrame> CVLikelihood::test_folds(const CrossValidation& cv) {
+    std::vector<int> columns;
+    for (int i = 0; i < cv.data()->num_columns(); ++i) {
+        auto type = cv.data().col(i)->type_id();
+        if (type == Type::DOUBLE || type == Type::FLOAT) columns.push_back(i);
+    }
+
+    std::vector<DataFrame> folds;
+    if (columns.empty()) return folds;
+
+    auto double_cv = cv.loc(columns);
+    folds.reserve(double_cv.num_folds());
+    for (int i = 0; i < double_cv.num_folds(); ++i) {
+        folds.push_back(double_cv.fold(i).second);
+    }
+
+    return folds;
+}
+
+int CVLikelihood::fold_threads(const std::shared_ptr<factors::Factor>& cpd) const {
+    return cpd->is_python_derived() ? 1 : util::effective_num_threads(m_num_threads);
+}
+
 double CVLikelihood::local_score(const BayesianNetworkBase& model,
                                  const std::string& variable,
                                  const std::vector<std::string>& evidence) const {
@@ -12,16 +56,103 @@ double CVLikelihood::local_score(const BayesianNetworkBase& model,
                                  const std::shared_ptr<FactorType>& variable_type,
                                  const std::string& variable,
                                  const std::vector<std::string>& evidence) const {
-    auto [args, kwargs] = m_arguments.args(variable, variable_type);
-    auto cpd = variable_type->new_factor(model, variable, evidence, args, kwargs);
+    if (*variable_type == LinearGaussianCPDType::get_ref() && m_statistics.has_variables(variable, evidence)) {
+        if (auto loglik = m_statistics.cv_slogl(variable, evidence)) return *loglik;
+    }
+
+    auto cv = m_cv.loc(variable, evidence);
+    auto cpd = factors::new_factor_from_arguments(model, variable_type, variable, evidence, m_arguments);
+    int num_threads = fold_threads(cpd);
+
+    if (num_threads == 1) {
+        double loglik = 0;
+        for (auto [train_df, test_df] : cv) {
+            factors::profiled_fit(*cpd, train_df);
+            loglik += cpd->slogl(test_df);
+        }
+
+        factors::release_factor(cpd);
+        return loglik;
+    }
+
+    // Each fold is fitted with a different CPD, so the folds can be fitted at the same time. If this is called from an
+    // operator evaluated in parallel, util::parallel_for() runs the folds serially, so the cores are not
+    // oversubscribed.
+    std::vector<std::shared_ptr<factors::Factor>> cpds;
+    cpds.reserve(cv.num_folds());
+    cpds.push_back(std::move(cpd));
+    for (int i = 1; i < cv.num_folds(); ++i) {
+        cpds.push_back(factors::new_factor_from_arguments(model, variable_type, variable, evidence, m_arguments));
+    }
+
+    std::vector<double> fold_logliks(cv.num_folds());
+    util::parallel_for(0, cv.num_folds(), num_threads, [&](int fold, int) {
+        auto [train_df, test_df] = cv.fold(fold);
+        factors::profiled_fit(*cpds[fold], train_df);
+        fold_logliks[fold] = cpds[fold]->slogl(test_df);
+    });
+
+    release_factors(cpds);
+    return sum_folds(fold_logliks);
+}
+
+std::vector<double> CVLikelihood::local_scores(const BayesianNetworkBase& model,
+                                               const std::string& variable,
+                                               const std::vector<std::vector<std::string>>& parents_sets) const {
+    auto variable_type = model.underlying_node_type(m_cv.data(), variable);
+    if (*variable_type != CKDEType::get_ref() || parents_sets.size() < 2) {
+        return Score::local_scores(model, variable, parents_sets);
+    }
+
+    // The CKDEs of the current parents in each fold.
+    auto parents = model.parents(variable);
+    auto base_cpd = factors::new_factor_from_arguments(model, variable_type, variable, parents, m_arguments);
+    auto base_ckde = std::dynamic_pointer_cast<CKDE>(base_cpd);
+    if (!base_ckde) {
+        factors::release_factor(base_cpd);
+        return Score::local_scores(model, variable, parents_sets);
+    }
+
+    auto base_cv = m_cv.loc(variable, parents);
+    int num_threads = fold_threads(base_cpd);
+
+    // Each fold is fitted from a copy of the unfitted CKDE.
+    std::vector<CKDE> base_folds(base_cv.num_folds(), *base_ckde);
+    util::parallel_for(0, base_cv.num_folds(), num_threads, [&](int fold, int) {
+        factors::profiled_fit(base_folds[fold], base_cv.fold(fold).first);
+    });
+
+    base_ckde.reset();
+    factors::release_factor(base_cpd);
+
+    std::vector<double> res;
+    res.reserve(parents_sets.size());
+    for (const auto& evidence : parents_sets) {
+        auto cv = m_cv.loc(variable, evidence);
+        std::vector<std::shared_ptr<factors::Factor>> cpds;
+        cpds.reserve(cv.num_folds());
+        for (int i = 0; i < cv.num_folds(); ++i) {
+            cpds.push_back(factors::new_factor_from_arguments(model, variable_type, variable, evidence, m_arguments));
+        }
+
+        std::vector<double> fold_logliks(cv.num_folds());
+        util::parallel_for(0, cv.num_folds(), num_threads, [&](int fold, int) {
+            auto [train_df, test_df] = cv.fold(fold);
+            // A CKDE with discrete parents is not a CKDE.
+            if (auto ckde = std::dynamic_pointer_cast<CKDE>(cpds[fold])) {
+                util::ProfileScope profile([&ckde] { return "fit_incremental:" + ckde->type_ref().ToString(); });
+                ckde->fit_incremental(base_folds[fold], train_df);
+            } else {
+                factors::profiled_fit(*cpds[fold], train_df);
+            }
+            fold_logliks[fold] = cpds[fold]->slogl(test_df);
+        });
 
-    double loglik = 0;
-    for (auto [train_df, test_df] : m_cv.loc(variable, evidence)) {
-        cpd->fit(train_df);
-        loglik += cpd->slogl(test_df);
+        release_factors(cpds);
+        res.push_back(sum_folds(fold_logliks));
     }
 
-    return loglik;
+    return res;
 }
 
 }  // namespace learning::scores
@@ -3,6 +3,8 @@
 
 #include <dataset/crossvalidation_adaptator.hpp>
 #include <learning/scores/scores.hpp>
+#include <learning/scores/gaussian_statistics.hpp>
+#include <util/parallel.hpp>
 
 using dataset::CrossValidation;
 using factors::FactorType;
@@ -16,8 +18,14 @@ public:
     CVLikelihood(const DataFrame& df,
                  int k = 10,
                  unsigned int seed = std::random_device{}(),
-                 Arguments construction_args = Arguments())
-        : m_cv(df, k, seed), m_arguments(construction_args) {}
+                 Arguments construction_args = Arguments(),
+                 int num_threads = 1)
+        : m_cv(df, k, seed),
+          m_arguments(construction_args),
+          m_num_threads(num_threads),
+          m_statistics(test_folds(m_cv)) {
+        util::effective_num_threads(num_threads);
+    }
 
     double local_score(const BayesianNetworkBase& model,
                        const std::string& variable,
@@ -28,8 +36,19 @@ public:
                        const std::string& variable,
                        const std::vector<std::string>& evidence) const override;
 
+    // The CKDEs of the parent sets that add or remove one parent of variable are fitted in each fold from the CKDE of
+    // the current parents (see CKDE::fit_incremental()). With KDEBackend::OPENCL, the Cholesky factor of the bandwidth
+    // is updated instead of computed again, so the scores are equal to local_score() up to rounding errors. This is
+    // an exception to the contract of Score::local_scores(). With the other backends, the CKDEs are fitted as in
+    // local_score() and the scores are identical.
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override;
+
     const CrossValidation& cv() { return m_cv; }
 
+    int num_threads() const { return m_num_threads; }
+
     std::string ToString() const override { return "CVLikelihood"; }
 
     bool has_variables(const std::string& name) const override { return m_cv.data().has_columns(name); }
@@ -46,12 +65,29 @@ public:
 
     DataFrame data() const override { return m_cv.data(); }
 
+    // The sufficient statistics of the LinearGaussianCPDs in the folds.
+    util::MemoryUsage memory_usage() const override {
+        util::MemoryUsage usage;
+        usage.add("statistics", m_statistics.memory());
+        return usage;
+    }
+
 private:
     template <typename FactorType>
     double factor_score(const std::string& variable, const std::vector<std::string>& evidence) const;
 
+    // Returns the test DataFrame of each fold with the double columns of cv.
+    static std::vector<DataFrame> test_folds(const CrossValidation& cv);
+
+    // Returns the number of threads used to fit the folds. Python derived factors are fitted by the calling thread.
+    int fold_threads(const std::shared_ptr<factors::Factor>& cpd) const;
+
     CrossValidation m_cv;
     Arguments m_arguments;
+    int m_num_threads;
+    // The LinearGaussianCPDs are fitted in each fold with the statistics of the test folds: the training statistics are
+    // the total statistics minus the statistics of the test fold.
+    GaussianFoldStatistics m_statistics;
 };
 
 using DynamicCVLikelihood = DynamicScoreAdaptator<CVLikelihood>;
@@ -0,0 +1,50 @@
+#include <learning/scores/distributed_score.hpp>
+#include <util/parallel.hpp>
+
+namespace learning::scores {
+
+std::vector<std::vector<double>> evaluate_local_scores(const Score& score,
+                                                       const BayesianNetworkBase& model,
+                                                       const std::vector<LocalScoreRequest>& requests,
+                                                       int num_threads) {
+    std::vector<std::vector<double>> res(requests.size());
+
+    util::parallel_for(0, static_cast<int>(requests.size()), num_threads, [&](int i, int) {
+        const auto& request = requests[i];
+        if (!model.contains_node(request.variable))
+            throw std::invalid_argument("The model does not contain the variable " + request.variable + ".");
+
+        if (request.node_type) {
+            res[i].reserve(request.parents_sets.size());
+            for (const auto& parents : request.parents_sets) {
+                res[i].push_back(score.local_score(model, request.node_type, request.variable, parents));
+            }
+        } else {
+            res[i] = score.local_scores(model, request.variable, request.parents_sets);
+        }
+    });
+
+    return res;
+}
+
+DistributedScore::DistributedScore(std::shared_ptr<Score> score, std::shared_ptr<ScoreTransport> transport)
+    : m_score(std::move(score)), m_transport(std::move(transport)) {
+    if (!m_score) throw std::invalid_argument("The score of a DistributedScore can not be null.");
+    if (!m_transport) throw std::invalid_argument("The transport of a DistributedScore can not be null.");
+}
+
+std::vector<double> DistributedScore::evaluate(const BayesianNetworkBase& model, LocalScoreRequest&& request) const {
+    auto num_scores = request.parents_sets.size();
+    std::vector<LocalScoreRequest> requests;
+    requests.push_back(std::move(request));
+
+    auto res = m_transport->evaluate(model, requests);
+    if (res.size() != 1 || res[0].size() != num_scores) {
+        throw std::runtime_error("The ScoreTransport must return " + std::to_string(num_scores) +
+                                 " local scores for the request of variable " + requests[0].variable + ".");
+    }
+
+    return std::move(res[0]);
+}
+
+}  // namespace learning::scores
@@ -0,0 +1,96 @@
+#ifndef PYBNESIAN_LEARNING_SCORES_DISTRIBUTED_SCORE_HPP
+#define PYBNESIAN_LEARNING_SCORES_DISTRIBUTED_SCORE_HPP
+
+#include <learning/scores/scores.hpp>
+
+namespace learning::scores {
+
+// A batch of local scores of a variable: one for each parent set. If node_type is null, the local scores use the node
+// type of the variable in the model.
+struct LocalScoreRequest {
+    std::string variable;
+    std::shared_ptr<FactorType> node_type;
+    std::vector<std::vector<std::string>> parents_sets;
+};
+
+// Sends batches of local scores to a set of workers and gathers the results. The workers evaluate the batches with
+// evaluate_local_scores() over their own copies of the data, so the transport only sends the model, the requests and
+// the local scores (e.g., with MPI or a pool of processes).
+//
+// The learning algorithms call evaluate() concurrently from each of their threads, so the number of threads of the
+// algorithm is the number of batches that are evaluated at the same time.
+class ScoreTransport {
+public:
+    virtual ~ScoreTransport() {}
+    virtual bool is_python_derived() const { return false; }
+    // Returns the local scores of each request, in the same order as the parent sets of the request.
+    virtual std::vector<std::vector<double>> evaluate(const BayesianNetworkBase& model,
+                                                      const std::vector<LocalScoreRequest>& requests) const = 0;
+};
+
+// Evaluates the requests of a ScoreTransport with score, using num_threads threads.
+std::vector<std::vector<double>> evaluate_local_scores(const Score& score,
+                                                       const BayesianNetworkBase& model,
+                                                       const std::vector<LocalScoreRequest>& requests,
+                                                       int num_threads = 1);
+
+// A Score that evaluates all the local scores in the workers of a ScoreTransport. The local score is only used to check
+// the variables and the compatibility of the models, and to return the data of the score, so the local scores of the
+// learning algorithms are never computed by the coordinator.
+class DistributedScore : public Score {
+public:
+    DistributedScore(std::shared_ptr<Score> score, std::shared_ptr<ScoreTransport> transport);
+
+    double local_score(const BayesianNetworkBase& model,
+                       const std::string& variable,
+                       const std::vector<std::string>& parents) const override {
+        return evaluate(model, LocalScoreRequest{variable, nullptr, {parents}})[0];
+    }
+
+    double local_score(const BayesianNetworkBase& model,
+                       const std::shared_ptr<FactorType>& node_type,
+                       const std::string& variable,
+                       const std::vector<std::string>& parents) const override {
+        return evaluate(model, LocalScoreRequest{variable, node_type, {parents}})[0];
+    }
+
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override {
+        if (parents_sets.empty()) return {};
+        return evaluate(model, LocalScoreRequest{variable, nullptr, parents_sets});
+    }
+
+    // The bounds are cheap, so they are computed by the coordinator.
+    std::optional<double> add_parent_bound(const BayesianNetworkBase& model,
+                                           const std::string& variable,
+                                           const std::vector<std::string>& parents,
+                                           const std::string& new_parent,
+                                           double current_score) const override {
+        return m_score->add_parent_bound(model, variable, parents, new_parent, current_score);
+    }
+
+    std::string ToString() const override { return "DistributedScore(" + m_score->ToString() + ")"; }
+
+    bool has_variables(const std::string& name) const override { return m_score->has_variables(name); }
+    bool has_variables(const std::vector<std::string>& cols) const override { return m_score->has_variables(cols); }
+    bool compatible_bn(const BayesianNetworkBase& model) const override { return m_score->compatible_bn(model); }
+    bool compatible_bn(const ConditionalBayesianNetworkBase& model) const override {
+        return m_score->compatible_bn(model);
+    }
+
+    DataFrame data() const override { return m_score->data(); }
+
+    const std::shared_ptr<Score>& score() const { return m_score; }
+    const std::shared_ptr<ScoreTransport>& transport() const { return m_transport; }
+
+private:
+    std::vector<double> evaluate(const BayesianNetworkBase& model, LocalScoreRequest&& request) const;
+
+    std::shared_ptr<Score> m_score;
+    std::shared_ptr<ScoreTransport> m_transport;
+};
+
+}  // namespace learning::scores
+
+#endif  // PYBNESIAN_LEARNING_SCORES_DISTRIBUTED_SCORE_HPP
@@ -0,0 +1,275 @@
+#include <numeric>
+#include <learning/scores/gaussian_statistics.hpp>
+#include <learning/parameters/mle_LinearGaussianCPD.hpp>
+#include <util/math_constants.hpp>
+
+namespace learning::scores {
+
+namespace {
+
+// The statistics of some variables, centered at their mean.
+struct CenteredStatistics {
+    double count;
+    VectorXd mean;
+    MatrixXd scatter;
+};
+
+// Returns the CenteredStatistics of the given indices in stats, removing the instances of excluded if it is not null.
+CenteredStatistics centered_statistics(const GaussianStatistics& stats,
+                                       const std::vector<int>& indices,
+                                       const GaussianStatistics* excluded = nullptr) {
+    int d = indices.size();
+    double count = stats.count;
+    VectorXd sum(d);
+    MatrixXd scatter(d, d);
+
+    for (int i = 0; i < d; ++i) {
+        sum(i) = stats.sum(indices[i]);
+        for (int j = 0; j <= i; ++j) {
+            scatter(i, j) = stats.cross_products(indices[i], indices[j]);
+        }
+    }
+
+    if (excluded) {
+        count -= excluded->count;
+        for (int i = 0; i < d; ++i) {
+            sum(i) -= excluded->sum(indices[i]);
+            for (int j = 0; j <= i; ++j) {
+                scatter(i, j) -= excluded->cross_products(indices[i], indices[j]);
+            }
+        }
+    }
+
+    for (int i = 0; i < d; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            scatter(i, j) = scatter(j, i) = scatter(i, j) - sum(i) * sum(j) / count;
+        }
+    }
+
+    return CenteredStatistics{count, sum / count, scatter};
+}
+
+// The parameters of a LinearGaussianCPD: variable = intercept + beta^T evidence + e, where e ~ N(0, variance).
+struct LinearGaussianFit {
+    double intercept;
+    VectorXd beta;
+    double variance;
+};
+
+// Fits a LinearGaussianCPD with the statistics, where the last index of the statistics is the variable and the rest the
+// evidence. It returns std::nullopt if the LinearGaussianCPD might not be equal (up to rounding errors) to the one
+// fitted by MLE<LinearGaussianCPD> (see GaussianFoldStatistics::slogl()).
+std::optional<LinearGaussianFit> fit_linear_gaussian(const CenteredStatistics& training) {
+    int m = training.mean.rows() - 1;
+    // The variance of the LinearGaussianCPD is infinite.
+    if (training.count <= m + 1) return std::nullopt;
+
+    const auto& scatter = training.scatter;
+    VectorXd beta = VectorXd::Zero(m);
+    double rss = scatter(m, m);
+    if (m > 0) {
+        // MLE<LinearGaussianCPD> ignores the evidence with (almost) zero variance.
+        if ((scatter.diagonal().head(m).array() / (training.count - 1)).minCoeff() < util::machine_tol)
+            return std::nullopt;
+
+        std::vector<int> evidence(m);
+        std::iota(evidence.begin(), evidence.end(), 0);
+        auto solution = learning::parameters::solve_normal_equations(scatter, evidence, m);
+        if (!solution.well_conditioned) return std::nullopt;
+
+        beta = std::move(solution.beta);
+        rss -= beta.dot(scatter.col(m).head(m));
+    }
+
+    // The residual sum of squares is (almost) zero, so it is dominated by rounding errors.
+    if (rss <= util::machine_tol * scatter(m, m)) return std::nullopt;
+
+    double intercept = training.mean(m) - beta.dot(training.mean.head(m));
+    return LinearGaussianFit{intercept, std::move(beta), rss / (training.count - m - 1)};
+}
+
+// Fits a LinearGaussianCPD with the training statistics and returns its log-likelihood in the test statistics. The
+// last index of the statistics is the variable and the rest the evidence. See GaussianFoldStatistics::slogl().
+std::optional<double> linear_gaussian_slogl(const CenteredStatistics& training, const CenteredStatistics& test) {
+    auto fitted = fit_linear_gaussian(training);
+    if (!fitted) return std::nullopt;
+
+    int m = fitted->beta.rows();
+    const auto& beta = fitted->beta;
+    auto intercept = fitted->intercept;
+    auto variance = fitted->variance;
+
+    if (test.count == 0) return 0.;
+
+    // The residuals of the test instances are r = v^T z - intercept, with v = (-beta, 1). The sum of squares is
+    // computed with the test scatter matrix to avoid the cancellation of the raw cross products.
+    VectorXd v(m + 1);
+    v.head(m) = -beta;
+    v(m) = 1;
+
+    double mean_residual = v.dot(test.mean) - intercept;
+    double sse = v.dot(test.scatter * v) + test.count * mean_residual * mean_residual;
+
+    return -0.5 * test.count * (std::log(variance) + std::log(2 * util::pi<double>)) - 0.5 * sse / variance;
+}
+
+// The instances are converted to double in blocks of statistics_block_rows rows, so the float columns are accumulated
+// in double without a double copy of all the data.
+constexpr int64_t statistics_block_rows = 4096;
+
+// Copies the rows [offset, offset + block.rows()) of the columns (double or float arrays) to block.
+void read_block(const Array_vector& columns, int64_t offset, MatrixXd& block) {
+    for (int j = 0, j_end = columns.size(); j < j_end; ++j) {
+        if (columns[j]->type_id() == Type::DOUBLE) {
+            auto raw = std::static_pointer_cast<arrow::DoubleArray>(columns[j])->raw_values();
+            block.col(j) = Map<const VectorXd>(raw + offset, block.rows());
+        } else {
+            auto raw = std::static_pointer_cast<arrow::FloatArray>(columns[j])->raw_values();
+            block.col(j) = Map<const VectorXf>(raw + offset, block.rows()).cast<double>();
+        }
+    }
+}
+
+// Calls f(block) for each block of rows of the columns of df.
+template <typename F>
+void for_each_block(const DataFrame& df, const std::vector<std::string>& columns, F&& f) {
+    auto arrays = df.indices_to_columns(columns);
+    auto rows = df->num_rows();
+
+    MatrixXd block;
+    for (int64_t offset = 0; offset < rows; offset += statistics_block_rows) {
+        block.resize(std::min(statistics_block_rows, rows - offset), columns.size());
+        read_block(arrays, offset, block);
+        f(block);
+    }
+}
+
+VectorXd column_means(const DataFrame& df, const std::vector<std::string>& columns) {
+    VectorXd sum = VectorXd::Zero(columns.size());
+    for_each_block(df, columns, [&sum](const MatrixXd& block) { sum += block.colwise().sum().transpose(); });
+    return sum / df->num_rows();
+}
+
+// Returns the GaussianStatistics of the columns of df shifted by reference.
+GaussianStatistics shifted_statistics(const DataFrame& df,
+                                      const std::vector<std::string>& columns,
+                                      const VectorXd& reference) {
+    int d = columns.size();
+    GaussianStatistics stats{static_cast<double>(df->num_rows()), VectorXd::Zero(d), MatrixXd::Zero(d, d)};
+
+    for_each_block(df, columns, [&stats, &reference](MatrixXd& block) {
+        block.rowwise() -= reference.transpose();
+        stats.sum += block.colwise().sum().transpose();
+        stats.cross_products.noalias() += block.transpose() * block;
+    });
+
+    return stats;
+}
+
+}  // namespace
+
+GaussianStatistics gaussian_statistics(const DataFrame& df, const std::vector<std::string>& columns) {
+    if (df->num_rows() == 0) {
+        int d = columns.size();
+        return GaussianStatistics{0, VectorXd::Zero(d), MatrixXd::Zero(d, d)};
+    }
+
+    return shifted_statistics(df, columns, column_means(df, columns));
+}
+
+std::optional<LinearGaussianCPD_Params> linear_gaussian_mle(const GaussianStatistics& stats,
+                                                            const std::vector<int>& indices) {
+    auto fitted = fit_linear_gaussian(centered_statistics(stats, indices));
+    if (!fitted) return std::nullopt;
+
+    VectorXd beta(fitted->beta.rows() + 1);
+    beta(0) = fitted->intercept;
+    beta.tail(fitted->beta.rows()) = fitted->beta;
+    return LinearGaussianCPD_Params{std::move(beta), fitted->variance};
+}
+
+GaussianFoldStatistics::GaussianFoldStatistics(const std::vector<DataFrame>& parts)
+    : m_indices(), m_parts(), m_total() {
+    if (parts.empty()) return;
+
+    const auto& first = parts.front();
+    std::vector<std::string> columns;
+    for (int i = 0; i < first->num_columns(); ++i) {
+        auto name = first->column_name(i);
+        auto type = first.col(i)->type_id();
+        bool valid = type == arrow::Type::DOUBLE || type == arrow::Type::FLOAT;
+        for (auto it = parts.begin(); valid && it != parts.end(); ++it) {
+            valid = it->col(name)->type_id() == type && it->col(name)->null_count() == 0;
+        }
+
+        if (valid) {
+            m_indices.insert(std::make_pair(name, columns.size()));
+            columns.push_back(name);
+        }
+    }
+
+    if (columns.empty()) return;
+
+    int d = columns.size();
+    m_total = GaussianStatistics{0, VectorXd::Zero(d), MatrixXd::Zero(d, d)};
+
+    // All the parts are shifted by the mean of the first part with instances.
+    std::optional<VectorXd> reference;
+    m_parts.reserve(parts.size());
+    for (const auto& part : parts) {
+        if (!reference && part->num_rows() > 0) reference = column_means(part, columns);
+        auto stats = shifted_statistics(part, columns, reference.value_or(VectorXd::Zero(d)));
+
+        m_total.count += stats.count;
+        m_total.sum += stats.sum;
+        m_total.cross_products += stats.cross_products;
+        m_parts.push_back(std::move(stats));
+    }
+}
+
+bool GaussianFoldStatistics::has_variables(const std::string& variable,
+                                           const std::vector<std::string>& evidence) const {
+    if (m_indices.count(variable) == 0) return false;
+
+    for (const auto& e : evidence) {
+        if (m_indices.count(e) == 0) return false;
+    }
+
+    return true;
+}
+
+std::vector<int> GaussianFoldStatistics::indices(const std::string& variable,
+                                                 const std::vector<std::string>& evidence) const {
+    std::vector<int> res;
+    res.reserve(evidence.size() + 1);
+    for (const auto& e : evidence) {
+        res.push_back(m_indices.at(e));
+    }
+    res.push_back(m_indices.at(variable));
+    return res;
+}
+
+std::optional<double> GaussianFoldStatistics::slogl(int training,
+                                                    int test,
+                                                    const std::string& variable,
+                                                    const std::vector<std::string>& evidence) const {
+    auto i = indices(variable, evidence);
+    return linear_gaussian_slogl(centered_statistics(m_parts[training], i), centered_statistics(m_parts[test], i));
+}
+
+std::optional<double> GaussianFoldStatistics::cv_slogl(const std::string& variable,
+                                                       const std::vector<std::string>& evidence) const {
+    auto i = indices(variable, evidence);
+
+    double loglik = 0;
+    for (const auto& test : m_parts) {
+        auto fold_loglik =
+            linear_gaussian_slogl(centered_statistics(m_total, i, &test), centered_statistics(test, i));
+        if (!fold_loglik) return std::nullopt;
+        loglik += *fold_loglik;
+    }
+
+    return loglik;
+}
+
+}  // namespace learning::scores
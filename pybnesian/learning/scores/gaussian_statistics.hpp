@@ -0,0 +1,78 @@
+#ifndef PYBNESIAN_LEARNING_SCORES_GAUSSIAN_STATISTICS_HPP
+#define PYBNESIAN_LEARNING_SCORES_GAUSSIAN_STATISTICS_HPP
+
+#include <optional>
+#include <unordered_map>
+#include <dataset/dataset.hpp>
+#include <factors/continuous/LinearGaussianCPD.hpp>
+#include <util/memory_usage.hpp>
+
+using dataset::DataFrame;
+using Eigen::MatrixXd, Eigen::VectorXd;
+using factors::continuous::LinearGaussianCPD_Params;
+
+namespace learning::scores {
+
+// The sufficient statistics of a set of instances: the number of instances, and the sum and the cross products of
+// the instances. The instances are shifted by a common reference point to reduce the rounding errors.
+struct GaussianStatistics {
+    double count;
+    VectorXd sum;
+    MatrixXd cross_products;
+};
+
+// Returns the GaussianStatistics of the columns of df, that must be double or float columns without null values. The
+// instances are shifted by the mean of the columns. The statistics are always accumulated in double.
+GaussianStatistics gaussian_statistics(const DataFrame& df, const std::vector<std::string>& columns);
+
+// Fits a LinearGaussianCPD with the statistics of the given indices, where the evidence indices are followed by the
+// index of the variable. It returns std::nullopt if the fitted LinearGaussianCPD might not be equal (up to rounding
+// errors) to the one fitted by MLE<LinearGaussianCPD> (see GaussianFoldStatistics::slogl()).
+std::optional<LinearGaussianCPD_Params> linear_gaussian_mle(const GaussianStatistics& stats,
+                                                            const std::vector<int>& indices);
+
+// Stores the GaussianStatistics of some DataFrames (the folds of a cross validation or the training and test
+// DataFrames of a holdout) with the same columns. They are used to fit a LinearGaussianCPD in a DataFrame and to
+// compute its log-likelihood in another DataFrame without reading the data again.
+//
+// Only the double or float columns (with the same type in all the DataFrames) without null values are included.
+class GaussianFoldStatistics {
+public:
+    GaussianFoldStatistics(const std::vector<DataFrame>& parts);
+
+    bool has_variables(const std::string& variable, const std::vector<std::string>& evidence) const;
+
+    int num_parts() const { return m_parts.size(); }
+
+    // Fits a LinearGaussianCPD in the part training and returns its log-likelihood in the part test. It returns
+    // std::nullopt if the fitted LinearGaussianCPD might not be equal (up to rounding errors) to the one fitted by
+    // MLE<LinearGaussianCPD>: when there are not enough training instances, or the evidence or the residuals are
+    // (almost) degenerate. In that case, the caller should fit the LinearGaussianCPD with the data.
+    std::optional<double> slogl(int training,
+                                int test,
+                                const std::string& variable,
+                                const std::vector<std::string>& evidence) const;
+
+    // Returns the sum of the log-likelihoods of each part, where the LinearGaussianCPD of each part is fitted with the
+    // rest of the parts (the training data of a cross validation). It returns std::nullopt if the LinearGaussianCPD
+    // of any fold cannot be fitted with the statistics (see slogl()).
+    std::optional<double> cv_slogl(const std::string& variable, const std::vector<std::string>& evidence) const;
+
+    // Number of bytes of the statistics.
+    std::size_t memory() const {
+        auto bytes = util::eigen_bytes(m_total.sum) + util::eigen_bytes(m_total.cross_products);
+        for (const auto& part : m_parts) bytes += util::eigen_bytes(part.sum) + util::eigen_bytes(part.cross_products);
+        return bytes;
+    }
+
+private:
+    std::vector<int> indices(const std::string& variable, const std::vector<std::string>& evidence) const;
+
+    std::unordered_map<std::string, int> m_indices;
+    std::vector<GaussianStatistics> m_parts;
+    GaussianStatistics m_total;
+};
+
+}  // namespace learning::scores
+
+#endif  // PYBNESIAN_LEARNING_SCORES_GAUSSIAN_STATISTICS_HPP
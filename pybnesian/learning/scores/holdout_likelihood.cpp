@@ -1,6 +1,9 @@
 #include <learning/scores/holdout_likelihood.hpp>
 #include <models/BayesianNetwork.hpp>
+#include <factors/continuous/CKDE.hpp>
+#include <factors/continuous/LinearGaussianCPD.hpp>
 
+using factors::continuous::CKDE, factors::continuous::CKDEType, factors::continuous::LinearGaussianCPDType;
 using models::BayesianNetworkType;
 
 namespace learning::scores {
@@ -15,11 +18,145 @@ double HoldoutLikelihood::local_score(const BayesianNetworkBase& model,
                                       const std::shared_ptr<FactorType>& variable_type,
                                       const std::string& variable,
                                       const std::vector<std::string>& evidence) const {
-    auto [args, kwargs] = m_arguments.args(variable, variable_type);
+    if (*variable_type == LinearGaussianCPDType::get_ref() && m_statistics.has_variables(variable, evidence)) {
+        if (auto slogl = m_statistics.slogl(0, 1, variable, evidence)) return *slogl;
+    }
 
-    auto cpd = variable_type->new_factor(model, variable, evidence, args, kwargs);
-    cpd->fit(training_data());
-    return cpd->slogl(test_data());
+    auto key = fit_key(model, *variable_type, variable, evidence);
+    if (auto fit = cached_fit(key)) return fit_slogl(key, *fit);
+
+    auto cpd = factors::new_factor_from_arguments(model, variable_type, variable, evidence, m_arguments);
+    factors::profiled_fit(*cpd, training_data());
+    auto slogl = cpd->slogl(test_data());
+
+    cache_fit(std::move(key), HoldoutFit{std::move(cpd), slogl});
+    return slogl;
+}
+
+std::vector<double> HoldoutLikelihood::local_scores(const BayesianNetworkBase& model,
+                                                    const std::string& variable,
+                                                    const std::vector<std::vector<std::string>>& parents_sets) const {
+    auto variable_type = model.underlying_node_type(training_data(), variable);
+    if (*variable_type != CKDEType::get_ref() || parents_sets.size() < 2) {
+        return Score::local_scores(model, variable, parents_sets);
+    }
+
+    // The CKDE of the current parents, fitted with the training data.
+    auto parents = model.parents(variable);
+    auto base_key = fit_key(model, *variable_type, variable, parents);
+    std::shared_ptr<factors::Factor> base_cpd;
+    if (auto fit = cached_fit(base_key)) {
+        base_cpd = fit->cpd;
+    } else {
+        base_cpd = factors::new_factor_from_arguments(model, variable_type, variable, parents, m_arguments);
+        if (std::dynamic_pointer_cast<CKDE>(base_cpd)) {
+            factors::profiled_fit(*base_cpd, training_data());
+            cache_fit(std::move(base_key), HoldoutFit{base_cpd, std::nullopt});
+        }
+    }
+
+    auto base_ckde = std::dynamic_pointer_cast<CKDE>(base_cpd);
+    if (!base_ckde) {
+        factors::release_factor(base_cpd);
+        return Score::local_scores(model, variable, parents_sets);
+    }
+
+    std::vector<double> res;
+    res.reserve(parents_sets.size());
+    for (const auto& evidence : parents_sets) {
+        auto key = fit_key(model, *variable_type, variable, evidence);
+        if (auto fit = cached_fit(key)) {
+            res.push_back(fit_slogl(key, *fit));
+            continue;
+        }
+
+        auto cpd = factors::new_factor_from_arguments(model, variable_type, variable, evidence, m_arguments);
+        // A CKDE with discrete parents is not a CKDE.
+        if (auto ckde = std::dynamic_pointer_cast<CKDE>(cpd))
+            ckde->fit_incremental(*base_ckde, training_data());
+        else
+            factors::profiled_fit(*cpd, training_data());
+        res.push_back(cpd->slogl(test_data()));
+
+        cache_fit(std::move(key), HoldoutFit{std::move(cpd), res.back()});
+    }
+
+    base_ckde.reset();
+    factors::release_factor(base_cpd);
+    return res;
+}
+
+std::optional<HoldoutLikelihood::HoldoutFit> HoldoutLikelihood::cached_fit(const FitKey& key) const {
+    std::lock_guard<std::mutex> lock(m_fits->mutex);
+    auto it = m_fits->fits.find(key);
+    if (it == m_fits->fits.end()) return std::nullopt;
+    return it->second;
+}
+
+double HoldoutLikelihood::fit_slogl(const FitKey& key, const HoldoutFit& fit) const {
+    if (fit.slogl) return *fit.slogl;
+
+    auto slogl = fit.cpd->slogl(test_data());
+    std::lock_guard<std::mutex> lock(m_fits->mutex);
+    auto it = m_fits->fits.find(key);
+    if (it != m_fits->fits.end()) it->second.slogl = slogl;
+    return slogl;
+}
+
+void HoldoutLikelihood::cache_fit(FitKey&& key, HoldoutFit&& fit) const {
+    if (fit.cpd->is_python_derived()) {
+        factors::release_factor(fit.cpd);
+        return;
+    }
+
+    fit.memory = fit.cpd->memory_usage().total_bytes();
+
+    // The evicted CPDs are destroyed after releasing the lock.
+    std::vector<std::shared_ptr<factors::Factor>> evicted;
+    std::lock_guard<std::mutex> lock(m_fits->mutex);
+    if (m_fits->fits.count(key) > 0 || fit.memory > m_fits->max_memory) return;
+
+    evict_unlocked(fit.memory, max_cached_fits - 1, evicted);
+
+    m_fits->memory += fit.memory;
+    m_fits->order.push_back(key);
+    m_fits->fits.emplace(std::move(key), std::move(fit));
+}
+
+void HoldoutLikelihood::evict_unlocked(std::size_t memory,
+                                       std::size_t max_fits,
+                                       std::vector<std::shared_ptr<factors::Factor>>& evicted) const {
+    while (!m_fits->order.empty() &&
+           (m_fits->order.size() > max_fits || m_fits->memory + memory > m_fits->max_memory)) {
+        auto it = m_fits->fits.find(m_fits->order.front());
+        m_fits->memory -= it->second.memory;
+        evicted.push_back(std::move(it->second.cpd));
+        m_fits->fits.erase(it);
+        m_fits->order.pop_front();
+    }
+}
+
+util::MemoryUsage HoldoutLikelihood::memory_usage() const {
+    std::vector<std::shared_ptr<factors::Factor>> cpds;
+    {
+        std::lock_guard<std::mutex> lock(m_fits->mutex);
+        for (const auto& fit : m_fits->fits) cpds.push_back(fit.second.cpd);
+    }
+
+    util::MemoryUsage usage;
+    for (const auto& cpd : cpds) {
+        auto cpd_usage = cpd->memory_usage();
+        usage.add("fits", cpd_usage.host_bytes(), cpd_usage.device_bytes());
+    }
+    usage.add("statistics", m_statistics.memory());
+    return usage;
+}
+
+void HoldoutLikelihood::set_max_cache_memory(std::size_t max_memory) {
+    std::vector<std::shared_ptr<factors::Factor>> evicted;
+    std::lock_guard<std::mutex> lock(m_fits->mutex);
+    m_fits->max_memory = max_memory;
+    evict_unlocked(0, max_cached_fits, evicted);
 }
 
 }  // namespace learning::scores
\ No newline at end of file
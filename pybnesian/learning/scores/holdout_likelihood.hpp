@@ -1,10 +1,15 @@
 #ifndef PYBNESIAN_LEARNING_SCORES_HOLDOUT_LIKELIHOOD_HPP
 #define PYBNESIAN_LEARNING_SCORES_HOLDOUT_LIKELIHOOD_HPP
 
+#include <deque>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <dataset/holdout_adaptator.hpp>
 #include <models/GaussianNetwork.hpp>
 #include <models/SemiparametricBN.hpp>
 #include <learning/scores/scores.hpp>
+#include <learning/scores/gaussian_statistics.hpp>
 
 using dataset::HoldOut;
 using learning::scores::Score;
@@ -18,17 +23,32 @@ public:
                       double test_ratio = 0.2,
                       unsigned int seed = std::random_device{}(),
                       Arguments construction_args = Arguments())
-        : m_holdout(df, test_ratio, seed), m_arguments(construction_args) {}
+        : m_holdout(df, test_ratio, seed),
+          m_arguments(construction_args),
+          m_statistics({m_holdout.training_data(), m_holdout.test_data()}),
+          m_fits(std::make_shared<FitCache>()) {}
+
+    // Maximum number of fitted CPDs kept by the score.
+    static constexpr std::size_t max_cached_fits = 32;
 
     double local_score(const BayesianNetworkBase& model,
                        const std::string& variable,
                        const std::vector<std::string>& evidence) const override;
 
+    // The CPDs fitted with the training data are cached (except the Python-derived CPDs), so the score of a CPD that
+    // was already evaluated (e.g., when an operator of the search is undone, or the CPD is the base of local_scores())
+    // does not fit it again. The LinearGaussianCPDs are not cached: they are evaluated with the sufficient statistics.
     double local_score(const BayesianNetworkBase& model,
                        const std::shared_ptr<FactorType>& variable_type,
                        const std::string& variable,
                        const std::vector<std::string>& evidence) const override;
 
+    // The CKDEs of the parent sets that add or remove one parent of variable are fitted from the CKDE of the current
+    // parents (see CKDE::fit_incremental()). The scores are equal to local_score() up to rounding errors.
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override;
+
     const DataFrame& training_data() const { return m_holdout.training_data(); }
     const DataFrame& test_data() const { return m_holdout.test_data(); }
 
@@ -52,18 +72,66 @@ public:
 
     DataFrame data() const override { return training_data(); }
 
+    // The memory of the cached CPDs and of the sufficient statistics of the LinearGaussianCPDs. The limit is applied to
+    // the cached CPDs, which are also limited to max_cached_fits.
+    util::MemoryUsage memory_usage() const override;
+    void set_max_cache_memory(std::size_t max_memory) override;
+
 private:
     template <typename FactorType>
     double factor_score(const std::string& variable, const std::vector<std::string>& evidence) const;
 
+    // A CPD fitted with the training data and its log-likelihood in the test data, if it was evaluated.
+    struct HoldoutFit {
+        std::shared_ptr<factors::Factor> cpd;
+        std::optional<double> slogl;
+        // The memory of the CPD, set when it is cached.
+        std::size_t memory = 0;
+    };
+
+    // The hash of the Bayesian network type and the factor type, the variable and the evidence of a CPD. The model type
+    // is included because the factor types can construct a different CPD for each model.
+    using FitKey = std::tuple<std::size_t, std::size_t, std::string, std::vector<std::string>>;
+
+    // The fitted CPDs in insertion order. It is shared by the copies of the score.
+    struct FitCache {
+        std::mutex mutex;
+        std::map<FitKey, HoldoutFit> fits;
+        std::deque<FitKey> order;
+        std::size_t memory = 0;
+        std::size_t max_memory = util::unlimited_memory;
+    };
+
+    static FitKey fit_key(const BayesianNetworkBase& model,
+                          const FactorType& variable_type,
+                          const std::string& variable,
+                          const std::vector<std::string>& evidence) {
+        return FitKey(model.type_ref().hash(), variable_type.hash(), variable, evidence);
+    }
+
+    std::optional<HoldoutFit> cached_fit(const FitKey& key) const;
+    // Caches the fit of a CPD. The Python-derived CPDs are released instead.
+    void cache_fit(FitKey&& key, HoldoutFit&& fit) const;
+    // Removes the oldest fits until there are at most max_fits fits and a fit of memory bytes fits in the limit. The
+    // evicted CPDs are moved to evicted, so they are destroyed after releasing the lock.
+    void evict_unlocked(std::size_t memory,
+                        std::size_t max_fits,
+                        std::vector<std::shared_ptr<factors::Factor>>& evicted) const;
+    // Returns the log-likelihood of a cached fit. The base CKDEs of local_scores() are cached before evaluating their
+    // log-likelihood, so it is evaluated (and cached) the first time.
+    double fit_slogl(const FitKey& key, const HoldoutFit& fit) const;
+
     HoldOut m_holdout;
     Arguments m_arguments;
+    // The statistics of the training (part 0) and test (part 1) data to fit the LinearGaussianCPDs.
+    GaussianFoldStatistics m_statistics;
+    std::shared_ptr<FitCache> m_fits;
 };
 
 template <typename FactorType>
 double HoldoutLikelihood::factor_score(const std::string& variable, const std::vector<std::string>& evidence) const {
     FactorType cpd(variable, evidence);
-    cpd.fit(training_data());
+    factors::profiled_fit(cpd, training_data());
     return cpd.slogl(test_data());
 }
 
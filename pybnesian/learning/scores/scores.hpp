@@ -1,9 +1,11 @@
 #ifndef PYBNESIAN_LEARNING_SCORES_SCORES_HPP
 #define PYBNESIAN_LEARNING_SCORES_SCORES_HPP
 
+#include <optional>
 #include <models/GaussianNetwork.hpp>
 #include <models/SemiparametricBN.hpp>
 #include <dataset/dynamic_dataset.hpp>
+#include <util/memory_usage.hpp>
 
 using dataset::DynamicDataFrame, dataset::DynamicAdaptator;
 using models::BayesianNetworkBase, models::GaussianNetwork, models::SemiparametricBN;
@@ -14,6 +16,7 @@ namespace learning::scores {
 class Score {
 public:
     virtual ~Score() {}
+    virtual bool is_python_derived() const { return false; }
     virtual double score(const BayesianNetworkBase& model) const {
         double s = 0;
         for (const auto& node : model.nodes()) {
@@ -36,12 +39,47 @@ public:
                                const std::string& variable,
                                const std::vector<std::string>& parents) const = 0;
 
+    // Returns the local score of variable for each of the parent sets in parents_sets. The scores can override this
+    // method to share the work (for example, reading the data) between all the parent sets. The result must be
+    // identical to calling local_score(model, variable, parents) for each parent set, unless the score documents that
+    // its result is only equal up to rounding errors (see CVLikelihood::local_scores()).
+    virtual std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                             const std::string& variable,
+                                             const std::vector<std::vector<std::string>>& parents_sets) const {
+        std::vector<double> res;
+        res.reserve(parents_sets.size());
+        for (const auto& parents : parents_sets) {
+            res.push_back(local_score(model, variable, parents));
+        }
+
+        return res;
+    }
+
+    // Returns an upper bound of local_score(model, variable, parents + [new_parent]) - current_score, where
+    // current_score is local_score(model, variable, parents), or nullopt if the score does not have a bound for these
+    // variables. The operator sets do not evaluate the arcs whose bound is not positive, because they can not improve
+    // the score.
+    virtual std::optional<double> add_parent_bound(const BayesianNetworkBase&,
+                                                   const std::string&,
+                                                   const std::vector<std::string>&,
+                                                   const std::string&,
+                                                   double) const {
+        return std::nullopt;
+    }
+
     virtual std::string ToString() const = 0;
     virtual bool has_variables(const std::string& name) const = 0;
     virtual bool has_variables(const std::vector<std::string>& cols) const = 0;
     virtual bool compatible_bn(const BayesianNetworkBase& model) const = 0;
     virtual bool compatible_bn(const ConditionalBayesianNetworkBase& model) const = 0;
     virtual DataFrame data() const = 0;
+
+    // Returns the memory of the caches of the score. The default implementation returns an empty report.
+    virtual util::MemoryUsage memory_usage() const { return util::MemoryUsage(); }
+    // Limits the memory of the caches of the score to max_memory bytes (util::unlimited_memory by default), removing
+    // their oldest entries. The caches keep their own limits, so the limit can only reduce their memory. The scores
+    // without caches ignore it.
+    virtual void set_max_cache_memory(std::size_t) {}
 };
 
 class ValidatedScore : public Score {
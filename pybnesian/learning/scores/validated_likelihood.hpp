@@ -15,9 +15,10 @@ public:
                         double test_ratio = 0.2,
                         int k = 10,
                         unsigned int seed = std::random_device{}(),
-                        Arguments construction_args = Arguments())
+                        Arguments construction_args = Arguments(),
+                        int num_threads = 1)
         : m_holdout(df, test_ratio, seed, construction_args),
-          m_cv(m_holdout.training_data(), k, seed, construction_args) {}
+          m_cv(m_holdout.training_data(), k, seed, construction_args, num_threads) {}
 
     using ValidatedScore::local_score;
 
@@ -34,6 +35,12 @@ public:
         return m_cv.local_score(model, variable_type, variable, parents);
     }
 
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override {
+        return m_cv.local_scores(model, variable, parents_sets);
+    }
+
     std::string ToString() const override { return "ValidatedLikelihood"; }
 
     bool has_variables(const std::string& name) const override { return m_cv.has_variables(name); }
@@ -69,6 +76,15 @@ public:
 
     DataFrame data() const override { return m_cv.data(); }
 
+    util::MemoryUsage memory_usage() const override {
+        util::MemoryUsage usage;
+        usage.add("holdout", m_holdout.memory_usage());
+        usage.add("cv", m_cv.memory_usage());
+        return usage;
+    }
+
+    void set_max_cache_memory(std::size_t max_memory) override { m_holdout.set_max_cache_memory(max_memory); }
+
 private:
     HoldoutLikelihood m_holdout;
     CVLikelihood m_cv;
@@ -1,8 +1,14 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include <arrow/python/pyarrow.h>
 #include <arrow/python/platform.h>
 #include <arrow/api.h>
+#include <models/binary_models.hpp>
+#include <util/memory_usage.hpp>
+#include <util/parallel.hpp>
 #include <util/pickle.hpp>
+#include <util/profiler.hpp>
+#include <util/simd.hpp>
 
 #define STRINGIFY(x)       #x
 #define MACRO_STRINGIFY(x) STRINGIFY(x)
@@ -15,6 +21,7 @@ void pybindings_kde(py::module& root);
 void pybindings_factors(py::module& root);
 void pybindings_graph(py::module& root);
 void pybindings_models(py::module& root);
+void pybindings_inference(py::module& root);
 void pybindings_learning(py::module& root);
 
 /*This module is needed to trick the MSVC linker, so a PyInit___init__() method exists.*/
@@ -63,6 +70,261 @@ Load the saved object (a :class:`Factor <pybnesian.Factor>`, a graph, a :class:`
 
 :param filename: File name.
 :returns: The object saved in the file.
+)doc");
+
+    m.def("load_binary",
+          &models::load_binary,
+          py::arg("filename"),
+          py::arg("lazy") = false,
+          py::arg("memory_map") = false,
+          R"doc(
+Load the Bayesian network (a :class:`BayesianNetworkBase <pybnesian.BayesianNetworkBase>`, a
+:class:`ConditionalBayesianNetworkBase <pybnesian.ConditionalBayesianNetworkBase>` or a
+:class:`DynamicBayesianNetworkBase <pybnesian.DynamicBayesianNetworkBase>`) saved in ``filename`` with
+:func:`BayesianNetworkBase.save_binary <pybnesian.BayesianNetworkBase.save_binary>`. The file is memory-mapped, so the
+training data of the KDEs is copied once to the fitted models.
+
+:param filename: File name.
+:param lazy: If True, each CPD is loaded the first time it is used (e.g., with
+    :func:`BayesianNetworkBase.cpd <pybnesian.BayesianNetworkBase.cpd>`) instead of loading all the CPDs when the
+    file is loaded.
+:param memory_map: If True, the training data of the KDEs and the probability tables of the discrete CPDs are used
+    directly from the memory-mapped file instead of copying them, so the processes that load the same file share one
+    copy of the model. The file must not be modified while the model is in use.
+:returns: The Bayesian network saved in the file.
+)doc");
+
+    m.def("load_binary_bn",
+          &models::load_binary_bn,
+          py::arg("filename"),
+          py::arg("lazy") = false,
+          py::arg("memory_map") = false,
+          R"doc(
+Same as :func:`load_binary <pybnesian.load_binary>`, but ``filename`` must contain a
+:class:`BayesianNetworkBase <pybnesian.BayesianNetworkBase>`.
+
+:param filename: File name.
+:param lazy: If True, each CPD is loaded the first time it is used.
+:param memory_map: If True, the training data of the KDEs and the probability tables of the discrete CPDs are used
+    directly from the memory-mapped file.
+:returns: The Bayesian network saved in the file.
+:raises ValueError: If the file contains a conditional or dynamic Bayesian network.
+)doc");
+
+    m.def("load_binary_cbn",
+          &models::load_binary_cbn,
+          py::arg("filename"),
+          py::arg("lazy") = false,
+          py::arg("memory_map") = false,
+          R"doc(
+Same as :func:`load_binary <pybnesian.load_binary>`, but ``filename`` must contain a
+:class:`ConditionalBayesianNetworkBase <pybnesian.ConditionalBayesianNetworkBase>`.
+
+:param filename: File name.
+:param lazy: If True, each CPD is loaded the first time it is used.
+:param memory_map: If True, the training data of the KDEs and the probability tables of the discrete CPDs are used
+    directly from the memory-mapped file.
+:returns: The conditional Bayesian network saved in the file.
+:raises ValueError: If the file contains a non-conditional or dynamic Bayesian network.
+)doc");
+
+    m.def("load_binary_dbn",
+          &models::load_binary_dbn,
+          py::arg("filename"),
+          py::arg("lazy") = false,
+          py::arg("memory_map") = false,
+          R"doc(
+Same as :func:`load_binary <pybnesian.load_binary>`, but ``filename`` must contain a
+:class:`DynamicBayesianNetworkBase <pybnesian.DynamicBayesianNetworkBase>`.
+
+:param filename: File name.
+:param lazy: If True, each CPD is loaded the first time it is used.
+:param memory_map: If True, the training data of the KDEs and the probability tables of the discrete CPDs are used
+    directly from the memory-mapped file.
+:returns: The dynamic Bayesian network saved in the file.
+:raises ValueError: If the file contains a static Bayesian network.
+)doc");
+
+    py::class_<util::ProfileCounter>(m, "ProfileCounter", R"doc(
+The statistics of a counter of the profiler. See :func:`profiler_stats`.
+)doc")
+        .def_readonly("calls", &util::ProfileCounter::calls, R"doc(
+Number of calls (e.g., local score evaluations, CPD fits or independence tests) recorded in the counter.
+)doc")
+        .def_readonly("seconds", &util::ProfileCounter::seconds, R"doc(
+Total wall time (in seconds) of the calls, summed over all the threads. It is 0 for the counters that only count events,
+such as the cache hits.
+)doc")
+        .def_readonly("bytes", &util::ProfileCounter::bytes, R"doc(
+Number of bytes transferred by the calls. It is only recorded for the OpenCL transfers.
+)doc")
+        .def("__repr__", [](const util::ProfileCounter& self) {
+            return "ProfileCounter(calls=" + std::to_string(self.calls) + ", seconds=" + std::to_string(self.seconds) +
+                   ", bytes=" + std::to_string(self.bytes) + ")";
+        });
+
+    py::class_<util::MemoryUsage>(m, "MemoryUsage", R"doc(
+The memory used by an object in bytes, by component. It is returned by the ``memory_usage()`` method of the models, the
+CPDs, the scores and the independence tests, and by :func:`opencl_memory_usage`. The host bytes are allocated in the
+memory of the process, and the device bytes in the OpenCL devices. Only the main buffers (the data, the parameters and
+the caches) are counted, and the memory of the memory-mapped files (see :func:`load_binary`) is not included.
+)doc")
+        .def_property_readonly("host_bytes", &util::MemoryUsage::host_bytes, R"doc(
+Total bytes allocated in the host.
+)doc")
+        .def_property_readonly("device_bytes", &util::MemoryUsage::device_bytes, R"doc(
+Total bytes allocated in the OpenCL devices.
+)doc")
+        .def_property_readonly("total_bytes", &util::MemoryUsage::total_bytes, R"doc(
+Sum of :attr:`MemoryUsage.host_bytes` and :attr:`MemoryUsage.device_bytes`.
+)doc")
+        .def(
+            "components",
+            [](const util::MemoryUsage& self) {
+                py::dict res;
+                for (const auto& [component, bytes] : self.components()) {
+                    res[py::str(component)] = py::make_tuple(bytes.host, bytes.device);
+                }
+                return res;
+            },
+            R"doc(
+Returns the bytes of each component. The components of the nested objects are prefixed by the name of the object (e.g.,
+``"cpd:a.beta"`` is the component ``"beta"`` of the CPD of the node ``"a"``).
+
+:returns: A dict with the name of each component as key and a tuple ``(host_bytes, device_bytes)`` as value.
+)doc")
+        .def("__repr__", [](const util::MemoryUsage& self) {
+            return "MemoryUsage(host_bytes=" + std::to_string(self.host_bytes()) +
+                   ", device_bytes=" + std::to_string(self.device_bytes()) + ")";
+        });
+
+    m.def("enable_profiler", &util::Profiler::enable, R"doc(
+Enables the profiler of the learning algorithms. While the profiler is enabled, the local score evaluations, the CPD
+fits, the independence tests, the OpenCL kernel launches and transfers, and the local score memo hits/misses are
+recorded. The profiler is disabled by default.
+)doc");
+
+    m.def("disable_profiler", &util::Profiler::disable, R"doc(
+Disables the profiler. The recorded statistics are kept until :func:`reset_profiler` is called.
+)doc");
+
+    m.def("profiler_enabled", &util::Profiler::enabled, R"doc(
+Checks whether the profiler is enabled.
+
+:returns: True if the profiler is enabled, False otherwise.
+)doc");
+
+    m.def("reset_profiler", &util::Profiler::reset, R"doc(
+Removes all the statistics recorded by the profiler, and the spans of the trace.
+)doc");
+
+    m.def("enable_tracing", &util::Profiler::enable_tracing, R"doc(
+Enables the tracing of the learning algorithms. While the tracing is enabled, each operation recorded by the profiler
+(see :func:`profiler_stats`) is also recorded as a span with its start time, its duration and the thread that executed
+it, so the timeline of a run can be saved with :func:`save_trace`. The tracing is independent of the profiler
+counters, and it is disabled by default.
+
+The spans are kept in memory until :func:`reset_profiler` is called. The times of the spans are relative to the first
+time the tracing is enabled after a reset.
+)doc");
+
+    m.def("disable_tracing", &util::Profiler::disable_tracing, R"doc(
+Disables the tracing. The recorded spans are kept until :func:`reset_profiler` is called.
+)doc");
+
+    m.def("tracing_enabled", &util::Profiler::tracing, R"doc(
+Checks whether the tracing is enabled.
+
+:returns: True if the tracing is enabled, False otherwise.
+)doc");
+
+    m.def("save_trace", &util::Profiler::save_trace, py::arg("file_name"), R"doc(
+Saves the recorded spans in a JSON file with the Chrome trace event format, that can be opened with
+``chrome://tracing`` or `Perfetto <https://ui.perfetto.dev>`_. The category of each span is the prefix of the name of
+its counter (e.g., ``"local_score"`` or ``"opencl"``), and the threads are numbered in the order they recorded their
+first span.
+
+:param file_name: Name of the JSON file.
+)doc");
+
+    m.def("profiler_stats", &util::Profiler::stats, R"doc(
+Returns the statistics recorded by the profiler. The name of each counter has the form ``"<event>:<type>"``:
+
+- ``"local_score:<Score>"``: local score evaluations of each score.
+- ``"vlocal_score:<Score>"``: validation local score evaluations of each score.
+- ``"fit:<FactorType>"``: CPD fits of each factor type.
+- ``"pvalue:<IndependenceTest>"``: independence tests of each test type. The number of tests with ``k`` conditioning
+  variables is recorded in ``"pvalue:<IndependenceTest>:<k>"``.
+- ``"opencl:kernel_launch"``, ``"opencl:write"`` and ``"opencl:read"``: OpenCL kernel launches and transfers.
+- ``"opencl_device:kernel:<kernel>"``, ``"opencl_device:write"``, ``"opencl_device:read"``, ``"opencl_device:copy"``
+  and ``"opencl_device:fill"``: device time of each OpenCL kernel and transfer type. They are only recorded if the
+  OpenCL profiling mode is enabled (see :func:`set_opencl_profiling <pybnesian.set_opencl_profiling>`).
+- ``"local_score_memo:hit"`` and ``"local_score_memo:miss"``: hits and misses of the
+  :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>`.
+- ``"covariance_registry:hit"`` and ``"covariance_registry:miss"``: hits and misses of the covariance registry (see
+  :func:`covariance_registry_size <pybnesian.covariance_registry_size>`).
+- ``"gaussian_inference:llt_hit"`` and ``"gaussian_inference:llt_miss"``: hits and misses of the cached
+  decompositions of the covariance of the evidence of :class:`GaussianInference <pybnesian.GaussianInference>`.
+- ``"hc:iteration"``: iterations of the hill-climbing.
+- ``"pc:sepset_order:<k>"``: skeleton search of PC with sepsets of size ``k``.
+
+:returns: A dict with the name of each counter as key and its :class:`ProfileCounter` as value.
+)doc");
+
+    m.def(
+        "cpu_instruction_set",
+        []() { return util::simd::instruction_set_name(util::simd::instruction_set()); },
+        R"doc(
+Returns the instruction set used by the vectorized CPU kernels (the covariance, the discrete joint counts and the
+distances of the k-d trees). It is the most capable instruction set supported by the CPU, limited by
+:func:`set_cpu_max_instruction_set`.
+
+:returns: ``"generic"``, ``"avx2"`` (AVX2 and FMA) or ``"avx512"`` (AVX-512F).
+)doc");
+
+    m.def(
+        "set_cpu_max_instruction_set",
+        [](const std::string& name) {
+            util::simd::set_max_instruction_set(util::simd::instruction_set_from_name(name));
+        },
+        py::arg("instruction_set"),
+        R"doc(
+Limits the instruction set of the vectorized CPU kernels. The kernels never use an instruction set that is not
+supported by the CPU, so this function can only force a less capable instruction set (for example, to compare the
+results with the ``"generic"`` kernels). The default limit is ``"avx512"``.
+
+The distances and the joint counts do not depend on the instruction set. The dot products of the covariance are summed
+in a different order, so they can differ in the last bits.
+
+:param instruction_set: ``"generic"``, ``"avx2"`` or ``"avx512"``.
+:raises ValueError: If the instruction set is not valid.
+)doc");
+
+    m.def("set_deterministic_mode", &util::set_deterministic_mode, py::arg("deterministic"), R"doc(
+Enables or disables the deterministic mode. The parallel algorithms split their work in tasks that do not depend on
+the number of threads, and combine the results of the tasks in a fixed order: the learned structures (including the
+ties of the operator deltas, which are broken by the order of the operators), the parallel sampling, the covariances
+and the levels of the PC algorithm (whose removed edges are applied in the order of the edges) do not depend on the
+number of threads. In the deterministic mode, the remaining parallel reductions also use a fixed order:
+
+- :func:`BayesianNetworkBase.logl <pybnesian.BayesianNetworkBase.logl>` and :func:`BayesianNetworkBase.slogl
+  <pybnesian.BayesianNetworkBase.slogl>` with ``num_threads`` add the log-likelihood of the nodes in order, as with a
+  single thread. Each thread evaluates its nodes in its own vector, so the parallel ``logl`` uses a vector of
+  temporary memory for each thread.
+- The PC algorithm with a ``max_evaluations`` budget takes the budget of the edges of each level in order, so the same
+  edges are tested with any number of threads.
+
+Then, the results are bit-identical for any number of threads. The budgets with ``max_seconds``, a pool of OpenCL
+devices with different hardware (see :func:`set_opencl_devices <pybnesian.set_opencl_devices>`) and the instruction set
+of the CPU (see :func:`set_cpu_max_instruction_set`) can still change the results.
+
+:param deterministic: If True, the deterministic mode is enabled. It is disabled by default.
+)doc");
+
+    m.def("deterministic_mode", &util::deterministic_mode, R"doc(
+Returns whether the deterministic mode is enabled (see :func:`set_deterministic_mode`).
+
+:returns: True if the deterministic mode is enabled.
 )doc");
 
     pybindings_dataset(m);
@@ -70,5 +332,6 @@ Load the saved object (a :class:`Factor <pybnesian.Factor>`, a graph, a :class:`
     pybindings_factors(m);
     pybindings_graph(m);
     pybindings_models(m);
+    pybindings_inference(m);
     pybindings_learning(m);
 }
\ No newline at end of file
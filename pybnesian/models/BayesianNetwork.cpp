@@ -1,7 +1,300 @@
 #include <models/BayesianNetwork.hpp>
+#include <util/parallel.hpp>
 
 namespace models {
 
+namespace {
+
+// Returns the boundaries of the contiguous blocks of nodes evaluated by each parallel task. There are a few blocks per
+// thread, so the threads are balanced when the CPDs have different costs.
+std::vector<int> node_blocks(int num_nodes, int num_threads) {
+    int num_blocks = std::min(num_nodes, 4 * num_threads);
+    std::vector<int> boundaries(num_blocks + 1);
+    for (int b = 0; b <= num_blocks; ++b) {
+        boundaries[b] = static_cast<int>(static_cast<int64_t>(b) * num_nodes / num_blocks);
+    }
+    return boundaries;
+}
+
+// Returns the seed of a block of instances of a node. The first block uses the seed of sample(), so the sampling of a
+// single block is equal to sample().
+unsigned int block_seed(unsigned int node_seed, int block) {
+    if (block == 0) return node_seed;
+
+    std::seed_seq seq{node_seed, static_cast<unsigned int>(block)};
+    unsigned int res;
+    seq.generate(&res, &res + 1);
+    return res;
+}
+
+Array_ptr concatenate_blocks(const Array_vector& blocks) {
+    if (blocks.size() == 1) return blocks[0];
+
+    RAISE_RESULT_ERROR(auto res, arrow::Concatenate(blocks))
+    return res;
+}
+
+std::unordered_map<std::string, int> node_positions(const std::vector<std::string>& nodes) {
+    std::unordered_map<std::string, int> position;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        position.insert({nodes[i], static_cast<int>(i)});
+    }
+    return position;
+}
+
+// Samples the nodes of top_sort (a topological sort) in blocks of instances, where block_evidence[b] contains the
+// evidence (the interface nodes) of block b. The nodes of each topological level and the blocks are sampled in
+// parallel. It returns the sampled blocks of each node of top_sort.
+std::vector<Array_vector> sample_blocks(const BayesianNetworkBase& bn,
+                                        const std::vector<std::string>& top_sort,
+                                        const std::vector<DataFrame>& block_evidence,
+                                        unsigned int seed,
+                                        int num_threads) {
+    auto position = node_positions(top_sort);
+
+    // The level of a node is the length of the longest path from a root node (or an interface node), so the nodes of
+    // a level are independent given the previous levels.
+    std::vector<std::vector<std::string>> node_parents(top_sort.size());
+    std::vector<std::vector<int>> levels;
+    std::vector<int> node_level(top_sort.size());
+    for (size_t i = 0; i < top_sort.size(); ++i) {
+        node_parents[i] = bn.parents(top_sort[i]);
+        int level = 0;
+        for (const auto& p : node_parents[i]) {
+            auto it = position.find(p);
+            if (it != position.end()) level = std::max(level, node_level[it->second] + 1);
+        }
+
+        node_level[i] = level;
+        if (level == static_cast<int>(levels.size())) levels.emplace_back();
+        levels[level].push_back(i);
+    }
+
+    int num_blocks = block_evidence.size();
+    std::vector<Array_vector> samples(top_sort.size(), Array_vector(num_blocks));
+
+    for (const auto& level : levels) {
+        util::parallel_for(0, static_cast<int>(level.size()) * num_blocks, num_threads, [&](int task, int) {
+            auto i = level[task / num_blocks];
+            auto b = task % num_blocks;
+            const auto& block = block_evidence[b];
+
+            std::vector<Field_ptr> fields;
+            Array_vector columns;
+            for (const auto& p : node_parents[i]) {
+                auto it = position.find(p);
+                auto column = (it != position.end()) ? samples[it->second][b] : block.col(p);
+                fields.push_back(arrow::field(p, column->type()));
+                columns.push_back(std::move(column));
+            }
+
+            DataFrame evidence(arrow::RecordBatch::Make(arrow::schema(fields), block->num_rows(), columns));
+            samples[i][b] = bn.cpd(top_sort[i])->sample(block->num_rows(), evidence, block_seed(seed + i, b));
+        });
+    }
+
+    return samples;
+}
+
+}  // namespace
+
+DataFrame BayesianNetworkBase::parallel_sample(int n, unsigned int seed, bool ordered, int num_threads) const {
+    auto threads = util::effective_num_threads(num_threads);
+
+    // sample() raises the errors of the unfitted networks and the conditional networks with interface nodes.
+    auto conditional = dynamic_cast<const ConditionalBayesianNetworkBase*>(this);
+    if (n < 0 || !fitted() || (conditional && conditional->num_interface_nodes() > 0)) return sample(n, seed, ordered);
+
+    std::vector<DataFrame> block_evidence;
+    for (int offset = 0; offset < n || block_evidence.empty(); offset += sample_block_rows) {
+        block_evidence.push_back(DataFrame(std::min(sample_block_rows, n - offset)));
+    }
+
+    auto top_sort = graph().topological_sort();
+    auto samples = sample_blocks(*this, top_sort, block_evidence, seed, threads);
+
+    std::vector<Field_ptr> fields;
+    Array_vector columns;
+    auto add_column = [&](int i) {
+        auto column = concatenate_blocks(samples[i]);
+        fields.push_back(arrow::field(top_sort[i], column->type()));
+        columns.push_back(column);
+    };
+
+    if (ordered) {
+        auto position = node_positions(top_sort);
+        for (const auto& name : nodes()) {
+            add_column(position.at(name));
+        }
+    } else {
+        for (size_t i = 0; i < top_sort.size(); ++i) {
+            add_column(i);
+        }
+    }
+
+    return DataFrame(arrow::RecordBatch::Make(arrow::schema(fields), n, columns));
+}
+
+DataFrame ConditionalBayesianNetworkBase::parallel_sample(const DataFrame& evidence,
+                                                          unsigned int seed,
+                                                          bool concat_evidence,
+                                                          bool ordered,
+                                                          int num_threads,
+                                                          int draws) const {
+    if (draws < 1) throw std::invalid_argument("draws must be a positive number.");
+
+    auto threads = util::effective_num_threads(num_threads);
+    // sample() raises the error of the unfitted networks.
+    if (!fitted()) return sample(evidence, seed, concat_evidence, ordered);
+    evidence.raise_has_columns(interface_nodes());
+
+    // The draws are stacked: the rows [k*N, (k+1)*N) contain the draw k of the N evidence rows. Each block of
+    // instances belongs to a single draw, so its evidence is a slice of the evidence DataFrame.
+    int64_t N = evidence->num_rows();
+    std::vector<DataFrame> block_evidence;
+    for (int k = 0; k < draws; ++k) {
+        for (int64_t offset = 0; offset < N || offset == 0; offset += sample_block_rows) {
+            block_evidence.push_back(evidence.slice(offset, std::min<int64_t>(sample_block_rows, N - offset)));
+        }
+    }
+
+    auto top_sort = graph().topological_sort();
+    auto samples = sample_blocks(*this, top_sort, block_evidence, seed, threads);
+    auto position = node_positions(top_sort);
+
+    std::vector<Field_ptr> fields;
+    Array_vector columns;
+    auto add_evidence_column = [&](const Field_ptr& field, const Array_ptr& column) {
+        fields.push_back(field);
+        columns.push_back(concatenate_blocks(Array_vector(draws, column)));
+    };
+
+    if (ordered) {
+        auto schema = evidence->schema();
+        for (const auto& name : nodes()) {
+            auto it = position.find(name);
+            if (it != position.end()) {
+                auto column = concatenate_blocks(samples[it->second]);
+                fields.push_back(arrow::field(name, column->type()));
+                columns.push_back(column);
+            } else {
+                add_evidence_column(schema->GetFieldByName(name), evidence.col(name));
+            }
+        }
+    } else {
+        for (size_t i = 0; i < top_sort.size(); ++i) {
+            auto column = concatenate_blocks(samples[i]);
+            fields.push_back(arrow::field(top_sort[i], column->type()));
+            columns.push_back(column);
+        }
+    }
+
+    if (concat_evidence) {
+        auto schema = evidence->schema();
+        for (auto i = 0; i < evidence->num_columns(); ++i) {
+            add_evidence_column(schema->field(i), evidence.col(i));
+        }
+    }
+
+    return DataFrame(arrow::RecordBatch::Make(arrow::schema(fields), N * draws, columns));
+}
+
+VectorXd BayesianNetworkBase::parallel_logl(const DataFrame& df, int num_threads) const {
+    VectorXd accum(df->num_rows());
+    parallel_logl_into(df, num_threads, accum);
+    return accum;
+}
+
+void BayesianNetworkBase::deterministic_logl_into(const DataFrame& df, int threads, Eigen::Ref<VectorXd> out) const {
+    const auto& nn = nodes();
+    factors::check_logl_output(df, out.rows());
+
+    // The nodes are evaluated in groups of threads nodes. The first node is evaluated in out, and the other nodes of
+    // each group in their own vectors, which are added to out in the order of the nodes.
+    int num_nodes = nn.size();
+    std::vector<VectorXd> node_logl(std::min(threads, num_nodes));
+    for (int group = 0; group < num_nodes; group += threads) {
+        int length = std::min(threads, num_nodes - group);
+        util::parallel_for(0, length, threads, [&](int k, int) {
+            if (group + k == 0) {
+                cpd(nn[0])->logl_into(df, out);
+            } else {
+                if (node_logl[k].rows() == 0) node_logl[k].resize(df->num_rows());
+                cpd(nn[group + k])->logl_into(df, node_logl[k]);
+            }
+        });
+
+        for (int k = (group == 0) ? 1 : 0; k < length; ++k) {
+            out += node_logl[k];
+        }
+    }
+}
+
+void BayesianNetworkBase::parallel_logl_into(const DataFrame& df, int num_threads, Eigen::Ref<VectorXd> out) const {
+    const auto& nn = nodes();
+    auto threads = util::effective_num_threads(num_threads);
+    // logl_into() raises the error of the unfitted networks. The Python-derived networks can override logl_into(), so
+    // their CPDs are not evaluated directly.
+    if (nn.size() <= 1 || !fitted() || is_python_derived()) {
+        logl_into(df, out);
+        return;
+    }
+
+    // The deterministic evaluation is also used with one thread, so its result does not depend on num_threads.
+    if (util::deterministic_mode()) {
+        deterministic_logl_into(df, threads, out);
+        return;
+    }
+
+    if (threads == 1) {
+        logl_into(df, out);
+        return;
+    }
+
+    factors::check_logl_output(df, out.rows());
+    // The first block is accumulated in out, and the other blocks in their own vectors.
+    auto blocks = node_blocks(nn.size(), threads);
+    std::vector<VectorXd> partial(blocks.size() - 2, VectorXd(df->num_rows()));
+    auto accumulate_block = [&](int b, Eigen::Ref<VectorXd> accum) {
+        cpd(nn[blocks[b]])->logl_into(df, accum);
+        for (int i = blocks[b] + 1; i < blocks[b + 1]; ++i) {
+            cpd(nn[i])->logl_into(df, accum, true);
+        }
+    };
+    util::parallel_for(0, blocks.size() - 1, threads, [&](int b, int) {
+        if (b == 0)
+            accumulate_block(b, out);
+        else
+            accumulate_block(b, partial[b - 1]);
+    });
+
+    for (const auto& p : partial) {
+        out += p;
+    }
+}
+
+double BayesianNetworkBase::parallel_slogl(const DataFrame& df, int num_threads) const {
+    const auto& nn = nodes();
+    auto threads = util::effective_num_threads(num_threads);
+    if (threads == 1 || nn.size() <= 1 || !fitted() || is_python_derived()) return slogl(df);
+
+    // In the deterministic mode, each node is a block, so the slogl of the nodes are added in order as in slogl().
+    auto blocks = util::deterministic_mode() ? node_blocks(nn.size(), nn.size()) : node_blocks(nn.size(), threads);
+    std::vector<double> partial(blocks.size() - 1, 0.);
+    util::parallel_for(0, partial.size(), threads, [&](int b, int) {
+        for (int i = blocks[b]; i < blocks[b + 1]; ++i) {
+            partial[b] += cpd(nn[i])->slogl(df);
+        }
+    });
+
+    double accum = 0;
+    for (auto p : partial) {
+        accum += p;
+    }
+
+    return accum;
+}
+
 void requires_continuous_data(const DataFrame& df) {
     auto schema = df->schema();
 
@@ -55,44 +348,31 @@ DataFrame ConditionalBayesianNetwork::sample(const DataFrame& evidence,
     this->check_fitted();
     evidence.raise_has_columns(interface_nodes());
 
-    DataFrame parents(evidence);
+    DataFrameBuilder samples(evidence.loc(interface_nodes()));
+    samples.reserve(num_interface_nodes() + num_nodes());
 
-    auto top_sort = this->g.topological_sort();
+    std::vector<std::string> sampled;
+    const auto& top_sort = this->g.topological_indices();
     for (size_t i = 0; i < top_sort.size(); ++i) {
-        auto idx = this->index(top_sort[i]);
-        auto array = this->m_cpds[idx]->sample(evidence->num_rows(), parents, seed + i);
-
-        auto res = parents->AddColumn(evidence->num_columns() + i, top_sort[i], array);
-        parents = DataFrame(std::move(res).ValueOrDie());
+        auto idx = top_sort[i];
+        auto parents = samples.loc(this->m_cpds[idx]->evidence());
+        samples.append(this->name(idx), this->m_cpds[idx]->sample(evidence->num_rows(), parents, seed + i));
+        sampled.push_back(this->name(idx));
     }
 
-    std::vector<Field_ptr> fields;
-    std::vector<Array_ptr> columns;
-
-    auto schema = parents->schema();
-    if (ordered) {
-        for (const auto& name : this->nodes()) {
-            fields.push_back(schema->GetFieldByName(name));
-            columns.push_back(parents.col(name));
-        }
-    } else {
-        for (auto i = evidence->num_columns(); i < parents->num_columns(); ++i) {
-            fields.push_back(schema->field(i));
-            columns.push_back(parents.col(i));
-        }
-    }
+    auto df = samples.finish(ordered ? this->nodes() : sampled);
+    if (!concat_evidence) return df;
 
-    if (concat_evidence) {
-        auto evidence_schema = evidence->schema();
-        for (auto i = 0; i < evidence->num_columns(); ++i) {
-            fields.push_back(evidence_schema->field(i));
-            columns.push_back(evidence.col(i));
-        }
+    // The evidence columns are appended even if their names are repeated.
+    auto fields = df->schema()->fields();
+    auto columns = df.columns();
+    auto evidence_schema = evidence->schema();
+    for (auto i = 0; i < evidence->num_columns(); ++i) {
+        fields.push_back(evidence_schema->field(i));
+        columns.push_back(evidence.col(i));
     }
 
-    auto new_schema = std::make_shared<arrow::Schema>(fields);
-    auto new_rb = arrow::RecordBatch::Make(new_schema, evidence->num_rows(), columns);
-    return DataFrame(new_rb);
+    return DataFrame(arrow::RecordBatch::Make(arrow::schema(fields), evidence->num_rows(), columns));
 }
 
 }  // namespace models
\ No newline at end of file
@@ -1,12 +1,16 @@
 #ifndef PYBNESIAN_MODELS_BAYESIANNETWORK_HPP
 #define PYBNESIAN_MODELS_BAYESIANNETWORK_HPP
 
+#include <algorithm>
 #include <random>
 #include <dataset/dataset.hpp>
 #include <factors/factors.hpp>
 #include <factors/arguments.hpp>
+#include <factors/lazy_factor.hpp>
 #include <factors/unknown_factor.hpp>
 #include <graph/generic_graph.hpp>
+#include <learning/parameters/mle_fused.hpp>
+#include <util/parallel.hpp>
 #include <util/parameter_traits.hpp>
 #include <util/virtual_clone.hpp>
 
@@ -30,6 +34,9 @@ class BayesianNetworkBase : public std::enable_shared_from_this<BayesianNetworkB
 public:
     virtual ~BayesianNetworkBase() = default;
     virtual bool is_python_derived() const { return false; }
+    // Returns true if the model, its type, or any of its node types or CPDs is Python-derived. The default
+    // implementation conservatively returns true.
+    virtual bool has_python_derived() const { return true; }
     virtual const DagBase& graph() const = 0;
     virtual DagBase& graph() = 0;
     virtual int num_nodes() const = 0;
@@ -56,6 +63,13 @@ public:
     virtual bool has_path(const std::string& source, const std::string& target) const = 0;
     virtual void add_arc(const std::string& source, const std::string& target) = 0;
     virtual void add_arc_unsafe(const std::string& source, const std::string& target) = 0;
+    // Adds all the arcs. The C++ Bayesian networks check the acyclicity once for all the arcs (see
+    // graph::DagImpl::add_arcs()). The default implementation calls add_arc() for each arc.
+    virtual void add_arcs(const ArcStringVector& arcs) {
+        for (const auto& arc : arcs) {
+            add_arc(arc.first, arc.second);
+        }
+    }
     virtual void remove_arc(const std::string& source, const std::string& target) = 0;
     virtual void flip_arc(const std::string& source, const std::string& target) = 0;
     virtual void flip_arc_unsafe(const std::string& source, const std::string& target) = 0;
@@ -78,11 +92,47 @@ public:
     virtual const std::shared_ptr<Factor> cpd(const std::string& node) const = 0;
     virtual void add_cpds(const std::vector<std::shared_ptr<Factor>>& cpds) = 0;
     virtual void fit(const DataFrame& df, const Arguments& construction_args = Arguments()) = 0;
+    // Same as fit(), but the CPDs are fitted in parallel with num_threads threads (0 selects the hardware concurrency).
+    // If fused, the LinearGaussianCPDs and DiscreteFactors are fitted with statistics shared between the CPDs (see
+    // learning::parameters::fused_mle_fit()). The Python-derived Bayesian networks are fitted with fit().
+    virtual void parallel_fit(const DataFrame& df, const Arguments& construction_args, int, bool) {
+        fit(df, construction_args);
+    }
+    // Updates all the CPDs with Factor::partial_fit(), constructing the CPDs that are not added yet. The CPDs are
+    // updated in parallel with num_threads threads (0 selects the hardware concurrency).
+    virtual void partial_fit(const DataFrame&, double, const Arguments&, int) {
+        throw std::invalid_argument("Bayesian network " + ToString() + " does not support partial_fit().");
+    }
     virtual VectorXd logl(const DataFrame& df) const = 0;
+    // Same as logl(), but the log-likelihood is stored in out, which must have df->num_rows() elements. The default
+    // implementation copies the result of logl().
+    virtual void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const {
+        factors::check_logl_output(df, out.rows());
+        out = logl(df);
+    }
     virtual double slogl(const DataFrame& df) const = 0;
+    // Same as logl() and slogl(), but the CPDs of the nodes are evaluated in parallel with num_threads threads (0
+    // selects the hardware concurrency). The nodes are split in contiguous blocks that are accumulated in order, and
+    // the blocks are added in order, so the result only depends on num_threads. In the deterministic mode (see
+    // util::deterministic_mode()), the log-likelihood of each node is added in the order of the nodes, so the result
+    // does not depend on num_threads. The Python-derived networks are evaluated with the virtual logl_into() and
+    // slogl(), so their overrides are used.
+    VectorXd parallel_logl(const DataFrame& df, int num_threads) const;
+    // Same as parallel_logl(), but the log-likelihood is stored in out as in logl_into().
+    void parallel_logl_into(const DataFrame& df, int num_threads, Eigen::Ref<VectorXd> out) const;
+    double parallel_slogl(const DataFrame& df, int num_threads) const;
+    // Returns the memory used by the CPDs, with the components of each CPD prefixed by "cpd:<node>". The default
+    // implementation (of the Python-derived Bayesian networks) returns an empty report.
+    virtual util::MemoryUsage memory_usage() const { return util::MemoryUsage(); }
     virtual std::shared_ptr<BayesianNetworkType> type() const = 0;
     virtual BayesianNetworkType& type_ref() const = 0;
     virtual DataFrame sample(int n, unsigned int seed = std::random_device{}(), bool ordered = false) const = 0;
+    // Same as sample(), but the nodes of each topological level are sampled in parallel with num_threads threads (0
+    // selects the hardware concurrency), and the instances are sampled in blocks of sample_block_rows rows. Each block
+    // has its own seed, so the result does not depend on num_threads. If n <= sample_block_rows, the result is equal to
+    // sample(n, seed, ordered).
+    DataFrame parallel_sample(int n, unsigned int seed, bool ordered, int num_threads) const;
+    static constexpr int sample_block_rows = 1 << 16;
     virtual std::shared_ptr<ConditionalBayesianNetworkBase> conditional_bn(
         const std::vector<std::string>& nodes, const std::vector<std::string>& interface_nodes) const = 0;
     virtual std::shared_ptr<ConditionalBayesianNetworkBase> conditional_bn() const = 0;
@@ -142,6 +192,8 @@ public:
 
 private:
     virtual BayesianNetworkBase* clone_impl() const = 0;
+    // parallel_logl_into() in the deterministic mode.
+    void deterministic_logl_into(const DataFrame& df, int threads, Eigen::Ref<VectorXd> out) const;
 };
 
 class ConditionalBayesianNetworkBase : public BayesianNetworkBase {
@@ -176,6 +228,17 @@ public:
                              unsigned int seed = std::random_device{}(),
                              bool concat_evidence = false,
                              bool ordered = false) const = 0;
+    // Same as sample(), but the nodes are sampled in parallel as in BayesianNetworkBase::parallel_sample(), and each
+    // evidence row is sampled draws times. The draws are stacked: the rows [k*N, (k+1)*N) contain the draw k of the N
+    // evidence rows. The evidence of each block is a slice of evidence, so the evidence is only replicated (draws
+    // times) for the evidence columns included in the result.
+    using BayesianNetworkBase::parallel_sample;
+    DataFrame parallel_sample(const DataFrame& evidence,
+                              unsigned int seed,
+                              bool concat_evidence,
+                              bool ordered,
+                              int num_threads,
+                              int draws = 1) const;
 
     std::shared_ptr<ConditionalBayesianNetworkBase> clone() const {
         if (is_python_derived()) {
@@ -556,6 +619,15 @@ public:
 
     void add_arc_unsafe(const std::string& source, const std::string& target) override { g.add_arc(source, target); }
 
+    void add_arcs(const ArcStringVector& arcs) override {
+        for (const auto& arc : arcs) {
+            if (!m_type->can_have_arc(*this, arc.first, arc.second))
+                throw std::invalid_argument("Cannot add arc " + arc.first + " -> " + arc.second + ".");
+        }
+
+        g.add_arcs(arcs);
+    }
+
     void remove_arc(const std::string& source, const std::string& target) override { g.remove_arc(source, target); }
 
     void flip_arc(const std::string& source, const std::string& target) override {
@@ -595,18 +667,21 @@ public:
             }
         }
 
-        g.topological_sort();
+        g.topological_indices();
     }
 
     virtual bool can_have_cpd(const std::string& name) const { return is_valid(name); }
 
     bool fitted() const override;
+    bool has_python_derived() const override;
 
     std::shared_ptr<Factor> cpd(const std::string& node) override {
         auto idx = check_index(node);
-        if (!m_cpds.empty() && m_cpds[idx])
+        if (!m_cpds.empty() && m_cpds[idx]) {
+            // The lazily loaded CPDs are replaced with the loaded CPD (see factors::LazyFactor).
+            m_cpds[idx] = factors::LazyFactor::unwrap(m_cpds[idx]);
             return m_cpds[idx];
-        else
+        } else
             throw std::invalid_argument("CPD of variable \"" + node +
                                         "\" not added. Call add_cpds() or fit() to add the CPD.");
     }
@@ -614,7 +689,7 @@ public:
     const std::shared_ptr<Factor> cpd(const std::string& node) const override {
         auto idx = check_index(node);
         if (!m_cpds.empty() && m_cpds[idx])
-            return m_cpds[idx];
+            return factors::LazyFactor::unwrap(m_cpds[idx]);
         else
             throw std::invalid_argument("CPD of variable \"" + node +
                                         "\" not added. Call add_cpds() or fit() to add the CPD.");
@@ -625,9 +700,22 @@ public:
                                     const FactorType& model_node_type,
                                     const std::vector<std::string>& model_parents) const;
     void add_cpds(const std::vector<std::shared_ptr<Factor>>& cpds) override;
-    void fit(const DataFrame& df, const Arguments& construction_args = Arguments()) override;
+    void fit(const DataFrame& df, const Arguments& construction_args = Arguments()) override {
+        parallel_fit(df, construction_args, 1, false);
+    }
+    // The CPDs are constructed serially, because the construction arguments are Python objects, and the constructed
+    // CPDs are fitted in parallel. Each CPD is fitted independently, so the result does not depend on num_threads.
+    void parallel_fit(const DataFrame& df, const Arguments& construction_args, int num_threads, bool fused) override;
+    void partial_fit(const DataFrame& df,
+                     double forgetting,
+                     const Arguments& construction_args,
+                     int num_threads) override;
+    // The log-likelihood of the CPDs is accumulated in the same vector with Factor::logl_into().
     VectorXd logl(const DataFrame& df) const override;
+    void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const override;
     double slogl(const DataFrame& df) const override;
+    // The CPDs that are not loaded yet (see factors::LazyFactor) are not loaded.
+    util::MemoryUsage memory_usage() const override;
 
     std::shared_ptr<BayesianNetworkType> type() const override { return m_type; }
     BayesianNetworkType& type_ref() const override { return *m_type; }
@@ -811,6 +899,9 @@ public:
 
 protected:
     void check_fitted() const;
+    // Constructs the CPDs that are not added or not compatible with the model, and returns the indices of the CPDs
+    // that are not fitted.
+    std::vector<int> construct_cpds(const DataFrame& df, const Arguments& construction_args);
     DagType g;
     std::shared_ptr<BayesianNetworkType> m_type;
     std::vector<std::shared_ptr<Factor>> m_cpds;
@@ -836,6 +927,21 @@ bool BNGeneric<DagType>::fitted() const {
     }
 }
 
+template <typename DagType>
+bool BNGeneric<DagType>::has_python_derived() const {
+    if (this->is_python_derived() || m_type->is_python_derived()) return true;
+
+    if (m_type->is_homogeneous()) {
+        if (m_type->default_node_type()->is_python_derived()) return true;
+    } else {
+        for (const auto& nn : nodes()) {
+            if (m_node_types[check_index(nn)]->is_python_derived()) return true;
+        }
+    }
+
+    return std::any_of(m_cpds.begin(), m_cpds.end(), [](const auto& cpd) { return cpd && cpd->is_python_derived(); });
+}
+
 template <typename DagType>
 void BNGeneric<DagType>::check_fitted() const {
     if (m_cpds.empty()) {
@@ -957,7 +1063,7 @@ bool BNGeneric<DagType>::must_construct_cpd(const Factor& cpd,
 }
 
 template <typename DagType>
-void BNGeneric<DagType>::fit(const DataFrame& df, const Arguments& construction_args) {
+std::vector<int> BNGeneric<DagType>::construct_cpds(const DataFrame& df, const Arguments& construction_args) {
     if (m_cpds.empty()) {
         m_cpds.resize(num_raw_nodes());
     }
@@ -975,6 +1081,7 @@ void BNGeneric<DagType>::fit(const DataFrame& df, const Arguments& construction_
 
     force_type_whitelist(new_factor_types);
 
+    std::vector<int> unfitted;
     for (const auto& nn : nodes()) {
         auto i = check_index(nn);
 
@@ -984,27 +1091,94 @@ void BNGeneric<DagType>::fit(const DataFrame& df, const Arguments& construction_
         auto node_type_ = node_type(nn);
 
         if (!m_cpds[i] || must_construct_cpd(*m_cpds[i], *node_type_, p)) {
-            auto [args, kwargs] = construction_args.args(nn, node_type_);
-            m_cpds[i] = node_type_->new_factor(*this, nn, p, args, kwargs);
-            m_cpds[i]->fit(df);
+            // The construction arguments are Python objects, so the GIL is acquired while they are used.
+            m_cpds[i] = factors::new_factor_from_arguments(*this, node_type_, nn, p, construction_args);
+            unfitted.push_back(i);
         } else if (!m_cpds[i]->fitted()) {
-            m_cpds[i]->fit(df);
+            unfitted.push_back(i);
         }
     }
+
+    return unfitted;
+}
+
+template <typename DagType>
+void BNGeneric<DagType>::parallel_fit(const DataFrame& df,
+                                      const Arguments& construction_args,
+                                      int num_threads,
+                                      bool fused) {
+    auto threads = util::effective_num_threads(num_threads);
+
+    auto unfitted = construct_cpds(df, construction_args);
+
+    // The Python-derived CPDs hold the GIL while they are fitted, so they are fitted serially.
+    if (has_python_derived()) threads = 1;
+
+    // The CPDs that can not be fitted with the shared statistics are fitted independently.
+    if (fused) unfitted = learning::parameters::fused_mle_fit(df, m_cpds, unfitted);
+
+    util::parallel_for(0, unfitted.size(), threads, [this, &df, &unfitted](int k, int) {
+        factors::profiled_fit(*m_cpds[unfitted[k]], df);
+    });
+}
+
+template <typename DagType>
+void BNGeneric<DagType>::partial_fit(const DataFrame& df,
+                                     double forgetting,
+                                     const Arguments& construction_args,
+                                     int num_threads) {
+    factors::check_forgetting(forgetting);
+    auto threads = util::effective_num_threads(num_threads);
+
+    construct_cpds(df, construction_args);
+
+    std::vector<int> indices;
+    for (const auto& nn : nodes()) {
+        indices.push_back(index(nn));
+    }
+
+    // The Python-derived CPDs hold the GIL while they are updated, so they are updated serially.
+    if (has_python_derived()) threads = 1;
+
+    util::parallel_for(0, indices.size(), threads, [this, &df, &indices, forgetting](int k, int) {
+        factors::profiled_partial_fit(*m_cpds[indices[k]], df, forgetting);
+    });
 }
 
 template <typename DagType>
 VectorXd BNGeneric<DagType>::logl(const DataFrame& df) const {
+    VectorXd accum(df->num_rows());
+    BNGeneric<DagType>::logl_into(df, accum);
+    return accum;
+}
+
+template <typename DagType>
+void BNGeneric<DagType>::logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const {
     check_fitted();
+    factors::check_logl_output(df, out.rows());
 
     const auto& nn = nodes();
-    VectorXd accum = m_cpds[index(nn[0])]->logl(df);
+    if (nn.empty()) {
+        out.setZero();
+        return;
+    }
 
+    m_cpds[index(nn[0])]->logl_into(df, out);
     for (int i = 1, i_end = nn.size(); i < i_end; ++i) {
-        accum += m_cpds[index(nn[i])]->logl(df);
+        m_cpds[index(nn[i])]->logl_into(df, out, true);
     }
+}
 
-    return accum;
+template <typename DagType>
+util::MemoryUsage BNGeneric<DagType>::memory_usage() const {
+    util::MemoryUsage usage;
+    if (m_cpds.empty()) return usage;
+
+    for (const auto& nn : nodes()) {
+        if (const auto& cpd = m_cpds[index(nn)]) usage.add("cpd:" + nn, cpd->memory_usage());
+    }
+
+    return usage;
 }
 
 template <typename DagType>
@@ -1036,33 +1210,21 @@ DataFrame BNGeneric<DagType>::sample(int n, unsigned int seed, bool ordered) con
 
     check_fitted();
 
-    DataFrame parents(n);
+    // Each CPD receives a DataFrame with only its parents, so sampling d nodes is O(d) in the number of columns.
+    DataFrameBuilder samples(n);
+    samples.reserve(num_nodes());
 
-    auto top_sort = g.topological_sort();
+    const auto& top_sort = g.topological_indices();
     for (size_t i = 0; i < top_sort.size(); ++i) {
-        auto idx = index(top_sort[i]);
-        auto array = m_cpds[idx]->sample(n, parents, seed + i);
-
-        auto res = parents->AddColumn(i, top_sort[i], array);
-        parents = DataFrame(std::move(res).ValueOrDie());
+        auto idx = top_sort[i];
+        auto parents = samples.loc(m_cpds[idx]->evidence());
+        samples.append(name(idx), m_cpds[idx]->sample(n, parents, seed + i));
     }
 
-    if (ordered) {
-        std::vector<Field_ptr> fields;
-        std::vector<Array_ptr> columns;
-
-        auto schema = parents->schema();
-        for (auto& name : nodes()) {
-            fields.push_back(schema->GetFieldByName(name));
-            columns.push_back(parents->GetColumnByName(name));
-        }
-
-        auto new_schema = std::make_shared<arrow::Schema>(fields);
-        auto new_rb = arrow::RecordBatch::Make(new_schema, n, columns);
-        return DataFrame(new_rb);
-    } else {
-        return parents;
-    }
+    if (ordered)
+        return samples.finish(nodes());
+    else
+        return samples.finish();
 }
 
 template <typename DagType>
@@ -1145,7 +1307,7 @@ py::tuple BNGeneric<DagType>::__getstate__() const {
             if (m_cpds[i]) {
                 try {
                     check_compatible_cpd(*m_cpds[i]);
-                    cpds.push_back(m_cpds[i]);
+                    cpds.push_back(factors::LazyFactor::unwrap(m_cpds[i]));
                 } catch (std::exception&) {
                 }
             }
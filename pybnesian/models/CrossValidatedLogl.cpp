@@ -0,0 +1,61 @@
+#include <unordered_set>
+#include <models/CrossValidatedLogl.hpp>
+#include <util/parallel.hpp>
+
+namespace models {
+
+CrossValidatedLogl cross_validated_logl(const BayesianNetworkBase& model,
+                                        const CrossValidation& cv,
+                                        const Arguments& construction_args,
+                                        int num_threads) {
+    const auto& nodes = model.nodes();
+
+    std::vector<std::shared_ptr<FactorType>> node_types;
+    std::vector<std::vector<std::string>> parents;
+    node_types.reserve(nodes.size());
+    parents.reserve(nodes.size());
+    // The parents of a conditional Bayesian network can be interface nodes.
+    std::vector<std::string> columns(nodes);
+    std::unordered_set<std::string> in_columns(nodes.begin(), nodes.end());
+    for (const auto& node : nodes) {
+        parents.push_back(model.parents(node));
+        for (const auto& p : parents.back()) {
+            if (in_columns.insert(p).second) columns.push_back(p);
+        }
+    }
+
+    cv.data().raise_has_columns(columns);
+    for (const auto& node : nodes) {
+        node_types.push_back(model.underlying_node_type(cv.data(), node));
+    }
+
+    auto model_cv = cv.loc(columns);
+    int k = model_cv.num_folds();
+    std::vector<std::pair<DataFrame, DataFrame>> folds;
+    folds.reserve(k);
+    for (int f = 0; f < k; ++f) {
+        folds.push_back(model_cv.fold(f));
+    }
+
+    int num_nodes = nodes.size();
+    CrossValidatedLogl res{nodes, MatrixXd(k, num_nodes)};
+
+    bool python_derived = model.has_python_derived();
+    util::gil_release_if_held release(!python_derived);
+    auto threads = python_derived ? 1 : num_threads;
+
+    util::parallel_for(0, k * num_nodes, threads, [&](int t, int) {
+        auto f = t / num_nodes;
+        auto n = t % num_nodes;
+        const auto& [train_df, test_df] = folds[f];
+
+        auto cpd = factors::new_factor_from_arguments(model, node_types[n], nodes[n], parents[n], construction_args);
+        factors::profiled_fit(*cpd, train_df);
+        res.node_slogl(f, n) = cpd->slogl(test_df);
+        factors::release_factor(cpd);
+    });
+
+    return res;
+}
+
+}  // namespace models
@@ -0,0 +1,39 @@
+#ifndef PYBNESIAN_MODELS_CROSSVALIDATEDLOGL_HPP
+#define PYBNESIAN_MODELS_CROSSVALIDATEDLOGL_HPP
+
+#include <dataset/crossvalidation_adaptator.hpp>
+#include <factors/arguments.hpp>
+#include <models/BayesianNetwork.hpp>
+
+using dataset::CrossValidation;
+using factors::Arguments;
+
+namespace models {
+
+// The log-likelihood of the test folds of a CrossValidation, where the CPDs of the structure of a model are fitted
+// with each training fold (see cross_validated_logl()).
+struct CrossValidatedLogl {
+    std::vector<std::string> nodes;
+    // The slogl() of the CPD of each node (columns, in the order of nodes) in each test fold (rows).
+    MatrixXd node_slogl;
+
+    // The slogl() of the model in each test fold.
+    VectorXd fold_slogl() const { return node_slogl.rowwise().sum(); }
+    double slogl() const { return node_slogl.sum(); }
+};
+
+// Fits the CPDs of the structure of model (its arcs and node types, ignoring its CPDs) with the training data of each
+// fold of cv, and evaluates them in the test data of the fold. The CPDs are constructed with construction_args. Each
+// pair of a fold and a node is fitted and evaluated independently, in parallel with num_threads threads (0 selects the
+// hardware concurrency), so the result does not depend on num_threads. The folds are slices of the fold columns of cv
+// (see CrossValidationProperties::fold_column()), so the columns are reordered once for all the folds.
+//
+// The models with Python-derived node types or CPDs are evaluated serially.
+CrossValidatedLogl cross_validated_logl(const BayesianNetworkBase& model,
+                                        const CrossValidation& cv,
+                                        const Arguments& construction_args = Arguments(),
+                                        int num_threads = 1);
+
+}  // namespace models
+
+#endif  // PYBNESIAN_MODELS_CROSSVALIDATEDLOGL_HPP
@@ -34,6 +34,13 @@ Array_ptr new_discrete_array(const std::vector<std::string>& values, int length)
     return out;
 }
 
+Array_ptr concatenate_steps(const Array_vector& steps) {
+    if (steps.size() == 1) return steps[0];
+
+    RAISE_RESULT_ERROR(auto res, arrow::Concatenate(steps))
+    return res;
+}
+
 void DynamicBayesianNetwork::add_variable(const std::string& name) {
     if (contains_variable(name)) {
         throw std::invalid_argument("Cannot add variable " + name +
@@ -68,10 +75,8 @@ void DynamicBayesianNetwork::remove_variable(const std::string& name) {
     }
 }
 
-VectorXd DynamicBayesianNetwork::logl(const DataFrame& df) const {
-    check_fitted();
-
-    if (df->num_rows() < m_markovian_order)
+void check_enough_rows(const DataFrame& df, int markovian_order) {
+    if (df->num_rows() < markovian_order)
         throw std::invalid_argument(
             "Not enough information. There are less rows in "
             "test DataFrame (" +
@@ -79,7 +84,13 @@ VectorXd DynamicBayesianNetwork::logl(const DataFrame& df) const {
             ")"
             " than the markovian order of the "
             "DynamicBayesianNetwork (" +
-            std::to_string(m_markovian_order) + ")");
+            std::to_string(markovian_order) + ")");
+}
+
+VectorXd DynamicBayesianNetwork::logl(const DataFrame& df) const {
+    check_fitted();
+
+    check_enough_rows(df, m_markovian_order);
 
     VectorXd ll = VectorXd::Zero(df->num_rows());
 
@@ -115,15 +126,7 @@ VectorXd DynamicBayesianNetwork::logl(const DataFrame& df) const {
 double DynamicBayesianNetwork::slogl(const DataFrame& df) const {
     check_fitted();
 
-    if (df->num_rows() < m_markovian_order)
-        throw std::invalid_argument(
-            "Not enough information. There are less rows in "
-            "test DataFrame (" +
-            std::to_string(df->num_rows()) +
-            ")"
-            " than the markovian order of the "
-            "DynamicBayesianNetwork (" +
-            std::to_string(m_markovian_order) + ")");
+    check_enough_rows(df, m_markovian_order);
 
     double sll = 0;
 
@@ -151,6 +154,97 @@ double DynamicBayesianNetwork::slogl(const DataFrame& df) const {
     return sll;
 }
 
+// Evaluates the static Bayesian network and the transition CPD of each variable of dbn in parallel. static_logl(i) is
+// the log-likelihood of the row i of the static Bayesian network, static_slogl is their sum (added in the same order as
+// DynamicBayesianNetwork::slogl()), and transition[k] is the result of f for the transition CPD of the k-th variable.
+template <typename T, typename F>
+void parallel_dbn_logl(const DynamicBayesianNetworkBase& dbn,
+                       const DataFrame& df,
+                       int num_threads,
+                       VectorXd& static_logl,
+                       double& static_slogl,
+                       std::vector<T>& transition,
+                       F&& f) {
+    auto markovian_order = dbn.markovian_order();
+    const auto& variables = dbn.variables();
+
+    auto dstatic_df = create_static_df(df.slice(0, markovian_order), markovian_order);
+    auto temporal_slices = create_temporal_slices(df, markovian_order);
+    auto dtransition_df = create_transition_df(temporal_slices, markovian_order);
+
+    static_logl = VectorXd::Zero(markovian_order);
+    static_slogl = 0;
+    transition.resize(variables.size());
+
+    // The task 0 evaluates the static Bayesian network, and the task k evaluates the variable k - 1.
+    util::parallel_for(0, static_cast<int>(variables.size()) + 1, num_threads, [&](int k, int) {
+        if (k == 0) {
+            for (int i = 0; i < markovian_order; ++i) {
+                for (const auto& v : variables) {
+                    const auto& cpd = dbn.static_bn().cpd(util::temporal_name(v, markovian_order - i));
+                    auto sll = cpd->slogl(dstatic_df);
+                    static_logl(i) += sll;
+                    static_slogl += sll;
+                }
+            }
+        } else {
+            const auto& cpd = dbn.transition_bn().cpd(util::temporal_name(variables[k - 1], 0));
+            transition[k - 1] = f(*cpd, dtransition_df);
+        }
+    });
+}
+
+int dbn_logl_threads(const DynamicBayesianNetworkBase& dbn, int num_threads) {
+    auto threads = util::effective_num_threads(num_threads);
+    // logl() raises the error of the unfitted networks.
+    if (threads == 1 || !dbn.fitted() || dbn.has_python_derived()) return 1;
+    return threads;
+}
+
+VectorXd DynamicBayesianNetworkBase::parallel_logl(const DataFrame& df, int num_threads) const {
+    auto threads = dbn_logl_threads(*this, num_threads);
+    if (threads == 1) return logl(df);
+
+    auto order = markovian_order();
+    check_enough_rows(df, order);
+
+    VectorXd static_logl;
+    double static_slogl;
+    std::vector<VectorXd> transition;
+    parallel_dbn_logl(
+        *this, df, threads, static_logl, static_slogl, transition, [](const Factor& cpd, const DataFrame& tdf) {
+            return cpd.logl(tdf);
+        });
+
+    VectorXd ll = VectorXd::Zero(df->num_rows());
+    ll.head(order) = static_logl;
+    for (const auto& vll : transition) {
+        ll.tail(vll.rows()) += vll;
+    }
+
+    return ll;
+}
+
+double DynamicBayesianNetworkBase::parallel_slogl(const DataFrame& df, int num_threads) const {
+    auto threads = dbn_logl_threads(*this, num_threads);
+    if (threads == 1) return slogl(df);
+
+    check_enough_rows(df, markovian_order());
+
+    VectorXd static_logl;
+    double sll;
+    std::vector<double> transition;
+    parallel_dbn_logl(*this, df, threads, static_logl, sll, transition, [](const Factor& cpd, const DataFrame& tdf) {
+        return cpd.slogl(tdf);
+    });
+
+    for (auto vsll : transition) {
+        sll += vsll;
+    }
+
+    return sll;
+}
+
 std::unordered_map<std::string, std::shared_ptr<arrow::DataType>> DynamicBayesianNetwork::check_same_datatypes() const {
     std::unordered_map<std::string, std::shared_ptr<arrow::DataType>> types;
 
@@ -461,6 +555,197 @@ DataFrame DynamicBayesianNetwork::sample(int n, unsigned int seed) const {
     return sampled;
 }
 
+DynamicBatchSampler::DynamicBatchSampler(const DynamicBayesianNetworkBase& dbn,
+                                         int n,
+                                         int batch_steps,
+                                         int num_trajectories,
+                                         unsigned int seed,
+                                         int num_threads)
+    : m_dbn(dbn),
+      m_n(n),
+      m_batch_steps(batch_steps),
+      m_num_trajectories(num_trajectories),
+      m_seed(seed),
+      m_num_threads(num_threads),
+      m_step(0),
+      m_state(),
+      m_transition_sample() {
+    if (n < 0) throw std::invalid_argument("n should be a non-negative number");
+    if (batch_steps < 1) throw std::invalid_argument("batch_steps must be a positive number.");
+    if (num_trajectories < 1) throw std::invalid_argument("num_trajectories must be a positive number.");
+
+    if (!dbn.fitted()) {
+        throw std::invalid_argument(
+            "DynamicBayesianNetwork currently not fitted. "
+            "Call fit() method, or add_cpds() for static_bn() and transition_bn()");
+    }
+
+    // The first markovian_order() time steps of all the trajectories.
+    m_state = dbn.static_bn().parallel_sample(num_trajectories, seed, false, num_threads);
+}
+
+Array_ptr DynamicBatchSampler::sample_step(const std::string& variable) {
+    auto markovian_order = m_dbn.markovian_order();
+    if (m_step < markovian_order) return m_state.col(util::temporal_name(variable, markovian_order - m_step));
+
+    return m_transition_sample.col(util::temporal_name(variable, 0));
+}
+
+// Returns the seed of a transition time step. parallel_sample() adds the index of each node to the seed, so the seeds
+// of the time steps are mixed with a seed_seq: m_seed + m_step would reuse the seeds of the nodes of the next step.
+unsigned int transition_step_seed(unsigned int seed, int step) {
+    std::seed_seq seq{seed, static_cast<unsigned int>(step)};
+    unsigned int res;
+    seq.generate(&res, &res + 1);
+    return res;
+}
+
+void DynamicBatchSampler::sample_transition() {
+    m_transition_sample = m_dbn.transition_bn().parallel_sample(
+        m_state, transition_step_seed(m_seed, m_step), false, false, m_num_threads);
+
+    // Shifts the state one time step: var_t_0 becomes var_t_1, var_t_1 becomes var_t_2, and so on.
+    std::vector<Field_ptr> fields;
+    Array_vector columns;
+    for (const auto& v : m_dbn.variables()) {
+        for (int i = 1; i <= m_dbn.markovian_order(); ++i) {
+            auto column = (i == 1) ? m_transition_sample.col(util::temporal_name(v, 0))
+                                   : m_state.col(util::temporal_name(v, i - 1));
+            fields.push_back(arrow::field(util::temporal_name(v, i), column->type()));
+            columns.push_back(std::move(column));
+        }
+    }
+
+    m_state = DataFrame(arrow::RecordBatch::Make(arrow::schema(fields), m_num_trajectories, columns));
+}
+
+DataFrame DynamicBatchSampler::next() {
+    if (!has_next()) throw std::runtime_error("All the time steps of the DynamicBatchSampler were sampled.");
+
+    const auto& variables = m_dbn.variables();
+    std::vector<Array_vector> steps(variables.size());
+
+    auto end = std::min(m_n, m_step + m_batch_steps);
+    auto num_steps = end - m_step;
+    for (; m_step < end; ++m_step) {
+        if (m_step >= m_dbn.markovian_order()) sample_transition();
+
+        for (size_t i = 0; i < variables.size(); ++i) {
+            steps[i].push_back(sample_step(variables[i]));
+        }
+    }
+
+    std::vector<Field_ptr> fields;
+    Array_vector columns;
+    for (size_t i = 0; i < variables.size(); ++i) {
+        auto column = concatenate_steps(steps[i]);
+        fields.push_back(arrow::field(variables[i], column->type()));
+        columns.push_back(std::move(column));
+    }
+
+    return DataFrame(arrow::RecordBatch::Make(
+        arrow::schema(fields), static_cast<int64_t>(num_steps) * m_num_trajectories, columns));
+}
+
+// The schema with the columns var_t_k for k in [first_lag, markovian_order()], ordered by k and then by variable. The
+// types are the data types of the transition CPDs.
+std::shared_ptr<arrow::Schema> lagged_schema(const DynamicBayesianNetworkBase& dbn, int first_lag) {
+    std::vector<Field_ptr> fields;
+    for (int lag = first_lag; lag <= dbn.markovian_order(); ++lag) {
+        for (const auto& v : dbn.variables()) {
+            auto type = dbn.transition_bn().cpd(util::temporal_name(v, 0))->data_type();
+            fields.push_back(arrow::field(util::temporal_name(v, lag), type));
+        }
+    }
+
+    return arrow::schema(fields);
+}
+
+const DynamicBayesianNetworkBase& check_fitted_dbn(const DynamicBayesianNetworkBase& dbn) {
+    if (!dbn.fitted()) {
+        throw std::invalid_argument(
+            "DynamicBayesianNetwork currently not fitted. "
+            "Call fit() method, or add_cpds() for static_bn() and transition_bn()");
+    }
+
+    return dbn;
+}
+
+DynamicLoglFilter::DynamicLoglFilter(const DynamicBayesianNetworkBase& dbn)
+    : m_variables(dbn.variables()),
+      m_markovian_order(dbn.markovian_order()),
+      m_static_plan(check_fitted_dbn(dbn).static_bn(), lagged_schema(dbn, 1)),
+      m_transition_plan(dbn.transition_bn(), lagged_schema(dbn, 0)),
+      m_state(m_markovian_order),
+      m_static_values(m_markovian_order * m_variables.size()),
+      m_transition_values((m_markovian_order + 1) * m_variables.size()),
+      m_step(0),
+      m_slogl(0) {
+    if (!m_static_plan.supports_instances() || !m_transition_plan.supports_instances()) {
+        throw std::invalid_argument(
+            "DynamicLoglFilter can only evaluate LinearGaussianCPD, DiscreteFactor and CLinearGaussianCPD (not sparse) "
+            "CPDs.");
+    }
+}
+
+double DynamicLoglFilter::append(const std::vector<AssignmentValue>& values) {
+    if (values.size() != m_variables.size()) {
+        throw std::invalid_argument("The time step has " + std::to_string(values.size()) + " values, but there are " +
+                                    std::to_string(m_variables.size()) + " variables.");
+    }
+
+    return append_step(std::vector<AssignmentValue>(values));
+}
+
+double DynamicLoglFilter::append(const std::unordered_map<std::string, AssignmentValue>& values) {
+    std::vector<AssignmentValue> step;
+    step.reserve(m_variables.size());
+    for (const auto& v : m_variables) {
+        auto it = values.find(v);
+        if (it == values.end()) throw std::invalid_argument("The time step does not contain the variable " + v + ".");
+        step.push_back(it->second);
+    }
+
+    return append_step(std::move(step));
+}
+
+double DynamicLoglFilter::append_step(std::vector<AssignmentValue>&& values) {
+    auto n = m_variables.size();
+    double logl = 0;
+
+    if (m_step < m_markovian_order) {
+        if (m_step == m_markovian_order - 1) {
+            // The time step t is the lag markovian_order() - t of the static Bayesian network.
+            for (int lag = 1; lag <= m_markovian_order; ++lag) {
+                const auto& step = (lag == 1) ? values : m_state[m_markovian_order - lag];
+                for (size_t j = 0; j < n; ++j) {
+                    m_static_values[(lag - 1) * n + j] = &step[j];
+                }
+            }
+
+            logl = m_static_plan.logl_instance(m_static_values);
+        }
+    } else {
+        for (size_t j = 0; j < n; ++j) {
+            m_transition_values[j] = &values[j];
+        }
+
+        for (int lag = 1; lag <= m_markovian_order; ++lag) {
+            const auto& step = m_state[(m_step - lag) % m_markovian_order];
+            for (size_t j = 0; j < n; ++j) {
+                m_transition_values[lag * n + j] = &step[j];
+            }
+        }
+
+        logl = m_transition_plan.logl_instance(m_transition_values);
+    }
+
+    if (m_markovian_order > 0) m_state[m_step % m_markovian_order] = std::move(values);
+    ++m_step;
+    m_slogl += logl;
+    return logl;
+}
+
 py::tuple DynamicBayesianNetwork::__getstate__() const {
     m_static->set_include_cpd(m_include_cpd);
     m_transition->set_include_cpd(m_include_cpd);
@@ -6,6 +6,7 @@
 #include <factors/continuous/CKDE.hpp>
 #include <factors/discrete/DiscreteFactor.hpp>
 #include <models/BayesianNetwork.hpp>
+#include <models/LoglPlan.hpp>
 #include <util/temporal.hpp>
 
 using dataset::DynamicDataFrame;
@@ -17,6 +18,11 @@ namespace models {
 class DynamicBayesianNetworkBase : public clone_inherit<abstract_class<DynamicBayesianNetworkBase>> {
 public:
     virtual ~DynamicBayesianNetworkBase() = default;
+    virtual bool is_python_derived() const { return false; }
+    // Returns true if the model, or any part of its static or transition Bayesian networks, is Python-derived.
+    bool has_python_derived() const {
+        return is_python_derived() || static_bn().has_python_derived() || transition_bn().has_python_derived();
+    }
     virtual BayesianNetworkBase& static_bn() = 0;
     virtual const BayesianNetworkBase& static_bn() const = 0;
     virtual ConditionalBayesianNetworkBase& transition_bn() = 0;
@@ -32,6 +38,18 @@ public:
     virtual void fit(const DataFrame& df, const Arguments& construction_args = Arguments()) = 0;
     virtual VectorXd logl(const DataFrame& df) const = 0;
     virtual double slogl(const DataFrame& df) const = 0;
+    // Same as logl() and slogl(), but the static Bayesian network and the transition CPD of each variable are evaluated
+    // concurrently with num_threads threads (0 selects the hardware concurrency). The log-likelihoods are added in the
+    // same order as logl() and slogl(), so the result does not depend on num_threads.
+    VectorXd parallel_logl(const DataFrame& df, int num_threads) const;
+    double parallel_slogl(const DataFrame& df, int num_threads) const;
+    // Returns the memory of the static and transition Bayesian networks, prefixed by "static" and "transition".
+    util::MemoryUsage memory_usage() const {
+        util::MemoryUsage usage;
+        usage.add("static", static_bn().memory_usage());
+        usage.add("transition", transition_bn().memory_usage());
+        return usage;
+    }
     virtual std::shared_ptr<BayesianNetworkType> type() const = 0;
     virtual BayesianNetworkType& type_ref() const = 0;
     virtual DataFrame sample(int n, unsigned int seed = std::random_device{}()) const = 0;
@@ -155,6 +173,93 @@ private:
     mutable bool m_include_cpd;
 };
 
+// Samples num_trajectories independent trajectories of n time steps from a fitted dynamic Bayesian network, returning
+// batch_steps time steps in each call to next(). Only the last markovian_order() time steps of each trajectory are kept
+// between calls, so the memory does not depend on n. Each time step of all the trajectories is sampled together with
+// ConditionalBayesianNetworkBase::parallel_sample(). The trajectories are stacked in each batch: the rows
+// [k*T, (k+1)*T) contain the k-th time step of the batch for the T trajectories.
+class DynamicBatchSampler {
+public:
+    DynamicBatchSampler(const DynamicBayesianNetworkBase& dbn,
+                        int n,
+                        int batch_steps,
+                        int num_trajectories,
+                        unsigned int seed,
+                        int num_threads);
+
+    bool has_next() const { return m_step < m_n; }
+    // Sampled time steps so far.
+    int time_step() const { return m_step; }
+    DataFrame next();
+
+private:
+    Array_ptr sample_step(const std::string& variable);
+    void sample_transition();
+
+    const DynamicBayesianNetworkBase& m_dbn;
+    int m_n;
+    int m_batch_steps;
+    int m_num_trajectories;
+    unsigned int m_seed;
+    int m_num_threads;
+    int m_step;
+    // The columns var_t_1, ..., var_t_{markovian_order()} of the last markovian_order() time steps.
+    DataFrame m_state;
+    // The columns var_t_0 of the last sampled time step.
+    DataFrame m_transition_sample;
+};
+
+// Evaluates the log-likelihood of a fitted dynamic Bayesian network one time step at a time. Only the last
+// markovian_order() time steps are kept (in a ring buffer), and each new time step is evaluated with the transition
+// CPDs in LoglPlan::logl_instance(), so the cost of append() does not depend on the number of time steps and no
+// DataFrame is created.
+//
+// The first markovian_order() time steps are evaluated together by the static Bayesian network, so append() returns 0
+// until the markovian_order()-th time step, that returns the log-likelihood of all of them. Thus, the sum of the values
+// returned by append() is DynamicBayesianNetworkBase::slogl() of the time steps, and each later value is the
+// DynamicBayesianNetworkBase::logl() of the corresponding time step.
+//
+// The parameters of the CPDs are copied when the filter is created, so it must be created again if the model is fitted
+// again.
+class DynamicLoglFilter {
+public:
+    DynamicLoglFilter(const DynamicBayesianNetworkBase& dbn);
+
+    const std::vector<std::string>& variables() const { return m_variables; }
+    int markovian_order() const { return m_markovian_order; }
+    // Appended time steps so far.
+    int time_step() const { return m_step; }
+    // Log-likelihood of all the appended time steps.
+    double slogl() const { return m_slogl; }
+
+    // Appends a time step, with the values in the order of variables(), and returns its log-likelihood.
+    double append(const std::vector<AssignmentValue>& values);
+    // Same as append() with the values of the variables by name.
+    double append(const std::unordered_map<std::string, AssignmentValue>& values);
+    // Removes all the time steps, so the next time step starts a new trajectory.
+    void reset() {
+        m_step = 0;
+        m_slogl = 0;
+    }
+
+private:
+    double append_step(std::vector<AssignmentValue>&& values);
+
+    std::vector<std::string> m_variables;
+    int m_markovian_order;
+    // The columns of the static plan are var_t_k for k = 1, ..., markovian_order(), and the columns of the transition
+    // plan are var_t_k for k = 0, ..., markovian_order(), ordered by k and then by variable.
+    LoglPlan m_static_plan;
+    LoglPlan m_transition_plan;
+    // The time step t is stored in m_state[t % markovian_order()].
+    std::vector<std::vector<AssignmentValue>> m_state;
+    // The pointers to the values of each column of the plans, updated in each time step.
+    std::vector<const AssignmentValue*> m_static_values;
+    std::vector<const AssignmentValue*> m_transition_values;
+    int m_step;
+    double m_slogl;
+};
+
 void __nonderived_dbn_setstate__(py::object& self, py::tuple& t);
 
 template <typename DerivedBN>
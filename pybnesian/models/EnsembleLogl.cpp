@@ -0,0 +1,253 @@
+#include <models/EnsembleLogl.hpp>
+#include <factors/continuous/LinearGaussianCPD.hpp>
+#include <factors/discrete/DiscreteFactor.hpp>
+#include <util/hash_utils.hpp>
+#include <util/math_constants.hpp>
+#include <util/parallel.hpp>
+
+using factors::continuous::LinearGaussianCPD;
+using factors::discrete::DiscreteFactor;
+
+namespace models {
+
+namespace {
+
+template <typename Vector>
+void hash_values(std::size_t& seed, const Vector& values) {
+    for (Eigen::Index i = 0, size = values.rows(); i < size; ++i) {
+        util::hash_combine(seed, values(i));
+    }
+}
+
+// The hash of the variable, the evidence and the parameters of the CPDs that can be deduplicated (the
+// LinearGaussianCPDs and the DiscreteFactors). The hash of the rest of CPDs is the hash of their address.
+std::size_t factor_hash(const std::shared_ptr<Factor>& cpd) {
+    std::size_t seed = 0;
+    if (!cpd->is_python_derived()) {
+        if (auto lg = std::dynamic_pointer_cast<LinearGaussianCPD>(cpd)) {
+            hash_values(seed, lg->beta());
+            util::hash_combine(seed, lg->variance());
+        } else if (auto discrete = std::dynamic_pointer_cast<DiscreteFactor>(cpd)) {
+            hash_values(seed, discrete->logprob_table());
+        } else {
+            util::hash_combine(seed, cpd.get());
+            return seed;
+        }
+    } else {
+        util::hash_combine(seed, cpd.get());
+        return seed;
+    }
+
+    util::hash_combine(seed, cpd->variable());
+    for (const auto& e : cpd->evidence()) {
+        util::hash_combine(seed, e);
+    }
+
+    return seed;
+}
+
+bool same_factor(const std::shared_ptr<Factor>& a, const std::shared_ptr<Factor>& b) {
+    if (a == b) return true;
+    if (a->is_python_derived() || b->is_python_derived()) return false;
+    if (a->variable() != b->variable() || a->evidence() != b->evidence()) return false;
+
+    auto lg_a = std::dynamic_pointer_cast<LinearGaussianCPD>(a);
+    auto lg_b = std::dynamic_pointer_cast<LinearGaussianCPD>(b);
+    if (lg_a && lg_b) return lg_a->variance() == lg_b->variance() && lg_a->beta() == lg_b->beta();
+
+    auto discrete_a = std::dynamic_pointer_cast<DiscreteFactor>(a);
+    auto discrete_b = std::dynamic_pointer_cast<DiscreteFactor>(b);
+    if (discrete_a && discrete_b) {
+        return discrete_a->variable_values() == discrete_b->variable_values() &&
+               discrete_a->evidence_values() == discrete_b->evidence_values() &&
+               discrete_a->sparse() == discrete_b->sparse() &&
+               discrete_a->configurations() == discrete_b->configurations() &&
+               discrete_a->logprob_table().rows() == discrete_b->logprob_table().rows() &&
+               discrete_a->logprob_table() == discrete_b->logprob_table();
+    }
+
+    return false;
+}
+
+}  // namespace
+
+EnsembleLogl::EnsembleLogl(const std::vector<std::shared_ptr<BayesianNetworkBase>>& models)
+    : m_models(models),
+      m_factors(),
+      m_users(),
+      m_hashes(),
+      m_discrete_groups(),
+      m_other_factors(),
+      m_python_models(),
+      m_python_derived(false) {
+    for (int m = 0, num_models = m_models.size(); m < num_models; ++m) {
+        const auto& model = m_models[m];
+        if (!model) throw std::invalid_argument("The models of an EnsembleLogl must be non-null.");
+        if (!model->fitted()) throw std::invalid_argument("Model " + std::to_string(m) + " is not fitted.");
+
+        m_python_derived = m_python_derived || model->has_python_derived();
+        if (model->is_python_derived()) {
+            m_python_models.push_back(m);
+            continue;
+        }
+
+        for (const auto& node : model->nodes()) {
+            auto f = add_factor(model->cpd(node));
+            m_users[f].push_back(m);
+        }
+    }
+
+    for (int f = 0, num_factors = m_factors.size(); f < num_factors; ++f) {
+        add_discrete_group(f);
+    }
+}
+
+int EnsembleLogl::add_factor(const std::shared_ptr<Factor>& cpd) {
+    auto& candidates = m_hashes[factor_hash(cpd)];
+    for (auto f : candidates) {
+        if (same_factor(m_factors[f], cpd)) return f;
+    }
+
+    int f = m_factors.size();
+    candidates.push_back(f);
+    m_factors.push_back(cpd);
+    m_users.emplace_back();
+    return f;
+}
+
+void EnsembleLogl::add_discrete_group(int factor) {
+    const auto& cpd = m_factors[factor];
+    auto discrete = cpd->is_python_derived() ? nullptr : std::dynamic_pointer_cast<DiscreteFactor>(cpd);
+    if (!discrete) {
+        m_other_factors.push_back(factor);
+        return;
+    }
+
+    for (auto& group : m_discrete_groups) {
+        if (group.variable == cpd->variable() && group.evidence == cpd->evidence() &&
+            group.strides == discrete->strides()) {
+            group.factors.push_back(factor);
+            return;
+        }
+    }
+
+    m_discrete_groups.push_back(DiscreteGroup{cpd->variable(), cpd->evidence(), discrete->strides(), {factor}});
+}
+
+void EnsembleLogl::add_logl(const DataFrame& df, MatrixXd& accum, int offset) const {
+    auto rows = df->num_rows();
+    auto add_to_users = [&](int f, const VectorXd& factor_logl) {
+        for (auto m : m_users[f]) {
+            accum.col(m).segment(offset, rows) += factor_logl;
+        }
+    };
+
+    VectorXd factor_logl(rows);
+    for (const auto& group : m_discrete_groups) {
+        bool contains_null = df.null_count(group.variable, group.evidence) > 0;
+        if (!contains_null) {
+            auto indices =
+                factors::discrete::discrete_indices<false>(df, group.variable, group.evidence, group.strides);
+            for (auto f : group.factors) {
+                const auto& discrete = static_cast<const DiscreteFactor&>(*m_factors[f]);
+                auto logprob = discrete.logprob_table();
+                for (auto i = 0; i < rows; ++i) {
+                    factor_logl(i) = logprob(discrete.table_index(indices(i)));
+                }
+                add_to_users(f, factor_logl);
+            }
+        } else {
+            auto bitmap = df.combined_bitmap(group.variable, group.evidence);
+            const auto* bitmap_data = bitmap->data();
+            // The indices of the valid rows are compacted.
+            auto indices =
+                factors::discrete::discrete_indices<true>(df, group.variable, group.evidence, group.strides);
+            for (auto f : group.factors) {
+                const auto& discrete = static_cast<const DiscreteFactor&>(*m_factors[f]);
+                auto logprob = discrete.logprob_table();
+                for (auto i = 0, k = 0; i < rows; ++i) {
+                    factor_logl(i) = util::bit_util::GetBit(bitmap_data, i)
+                                         ? logprob(discrete.table_index(indices(k++)))
+                                         : util::nan<double>;
+                }
+                add_to_users(f, factor_logl);
+            }
+        }
+    }
+
+    for (auto f : m_other_factors) {
+        add_to_users(f, m_factors[f]->logl(df));
+    }
+}
+
+MatrixXd EnsembleLogl::logl(const DataFrame& df, int num_threads) const {
+    auto rows = df->num_rows();
+    MatrixXd res = MatrixXd::Zero(rows, m_models.size());
+
+    for (auto m : m_python_models) {
+        res.col(m) = m_models[m]->logl(df);
+    }
+
+    util::gil_release_if_held release(!m_python_derived);
+    auto threads = m_python_derived ? 1 : num_threads;
+
+    int num_blocks = (rows + block_rows - 1) / block_rows;
+    util::parallel_for(0, num_blocks, threads, [&](int b, int) {
+        auto offset = b * block_rows;
+        auto length = std::min<int64_t>(block_rows, rows - offset);
+        add_logl(DataFrame(df->Slice(offset, length)), res, offset);
+    });
+
+    return res;
+}
+
+VectorXd EnsembleLogl::slogl(const DataFrame& df, int num_threads) const {
+    VectorXd res = VectorXd::Zero(m_models.size());
+    for (auto m : m_python_models) {
+        res(m) = m_models[m]->slogl(df);
+    }
+
+    std::vector<double> factor_slogl(m_factors.size());
+
+    util::gil_release_if_held release(!m_python_derived);
+    auto threads = m_python_derived ? 1 : num_threads;
+
+    int num_groups = m_discrete_groups.size();
+    int num_tasks = num_groups + m_other_factors.size();
+    util::parallel_for(0, num_tasks, threads, [&](int t, int) {
+        if (t >= num_groups) {
+            auto f = m_other_factors[t - num_groups];
+            factor_slogl[f] = m_factors[f]->slogl(df);
+            return;
+        }
+
+        // The discrete_indices() of the valid rows are shared by all the factors of the group.
+        const auto& group = m_discrete_groups[t];
+        VectorXi indices;
+        if (df.null_count(group.variable, group.evidence) > 0)
+            indices = factors::discrete::discrete_indices<true>(df, group.variable, group.evidence, group.strides);
+        else
+            indices = factors::discrete::discrete_indices<false>(df, group.variable, group.evidence, group.strides);
+
+        for (auto f : group.factors) {
+            const auto& discrete = static_cast<const DiscreteFactor&>(*m_factors[f]);
+            auto logprob = discrete.logprob_table();
+            double sum = 0;
+            for (auto i = 0; i < indices.rows(); ++i) {
+                sum += logprob(discrete.table_index(indices(i)));
+            }
+            factor_slogl[f] = sum;
+        }
+    });
+
+    // The factors are added in order, so the result does not depend on num_threads.
+    for (int f = 0, num_factors = m_factors.size(); f < num_factors; ++f) {
+        for (auto m : m_users[f]) {
+            res(m) += factor_slogl[f];
+        }
+    }
+
+    return res;
+}
+
+}  // namespace models
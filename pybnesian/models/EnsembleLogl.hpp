@@ -0,0 +1,66 @@
+#ifndef PYBNESIAN_MODELS_ENSEMBLELOGL_HPP
+#define PYBNESIAN_MODELS_ENSEMBLELOGL_HPP
+
+#include <models/BayesianNetwork.hpp>
+
+namespace models {
+
+// Evaluates the log-likelihood of an ensemble of fitted Bayesian networks (e.g., the bootstrap models of a structure
+// learning algorithm) on the same DataFrames. The models usually share many families, so the CPDs are deduplicated
+// when the ensemble is created: two CPDs are the same factor if they are the same object, or if they are
+// LinearGaussianCPDs or DiscreteFactors with the same variable, evidence and parameters. Each distinct factor is
+// evaluated once and its log-likelihood is added to all the models that contain it. The DiscreteFactors with the same
+// variable, evidence and strides also share the discrete_indices() of the data.
+//
+// The ensemble does not change if the models are modified or fitted again, so it must be created again to use the new
+// CPDs. The Python-derived models are evaluated with BayesianNetworkBase::logl().
+class EnsembleLogl {
+public:
+    // The rows of df are evaluated in blocks of block_rows rows, so the log-likelihood of a factor is not stored for
+    // all the rows.
+    static constexpr int block_rows = 1 << 14;
+
+    EnsembleLogl(const std::vector<std::shared_ptr<BayesianNetworkBase>>& models);
+
+    int num_models() const { return m_models.size(); }
+    // The number of distinct CPDs of the models that are not Python-derived.
+    int num_factors() const { return m_factors.size(); }
+
+    // Returns the log-likelihood of each row of df (rows) for each model (columns). The blocks of rows are evaluated in
+    // parallel with num_threads threads (0 selects the hardware concurrency).
+    MatrixXd logl(const DataFrame& df, int num_threads = 1) const;
+    // Returns the slogl() of df for each model.
+    VectorXd slogl(const DataFrame& df, int num_threads = 1) const;
+
+private:
+    // A set of DiscreteFactors with the same variable, evidence and strides.
+    struct DiscreteGroup {
+        std::string variable;
+        std::vector<std::string> evidence;
+        VectorXi strides;
+        std::vector<int> factors;
+    };
+
+    int add_factor(const std::shared_ptr<Factor>& cpd);
+    void add_discrete_group(int factor);
+
+    // Adds the log-likelihood of each factor in df, a block of rows starting at offset, to the columns of accum of the
+    // models that contain the factor.
+    void add_logl(const DataFrame& df, MatrixXd& accum, int offset) const;
+
+    std::vector<std::shared_ptr<BayesianNetworkBase>> m_models;
+    std::vector<std::shared_ptr<Factor>> m_factors;
+    // The models (not Python-derived) that contain each factor.
+    std::vector<std::vector<int>> m_users;
+    // The distinct factors with each hash.
+    std::unordered_map<std::size_t, std::vector<int>> m_hashes;
+    std::vector<DiscreteGroup> m_discrete_groups;
+    // The factors that are not in a DiscreteGroup.
+    std::vector<int> m_other_factors;
+    std::vector<int> m_python_models;
+    bool m_python_derived;
+};
+
+}  // namespace models
+
+#endif  // PYBNESIAN_MODELS_ENSEMBLELOGL_HPP
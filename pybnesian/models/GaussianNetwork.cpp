@@ -1,7 +1,16 @@
 #include <models/GaussianNetwork.hpp>
+#include <util/math_constants.hpp>
 
 namespace models {
 
+namespace {
+
+// Number of rows of each block of LinearGaussianParameters. The log-likelihood of a block is accumulated while the
+// residuals of all the nodes are computed, so it should fit in the L1 cache.
+constexpr int64_t logl_block_rows = 512;
+
+}  // namespace
+
 std::shared_ptr<BayesianNetworkBase> GaussianNetworkType::new_bn(const std::vector<std::string>& nodes) const {
     return std::make_shared<GaussianNetwork>(nodes);
 }
@@ -10,4 +19,217 @@ std::shared_ptr<ConditionalBayesianNetworkBase> GaussianNetworkType::new_cbn(
     return std::make_shared<ConditionalGaussianNetwork>(nodes, interface_nodes);
 }
 
-}  // namespace models
\ No newline at end of file
+std::optional<LinearGaussianParameters> LinearGaussianParameters::from_model(const BayesianNetworkBase& model) {
+    LinearGaussianParameters params;
+    std::unordered_map<std::string, int> column_indices;
+    auto column_index = [&params, &column_indices](const std::string& name) {
+        auto [it, inserted] = column_indices.insert({name, static_cast<int>(params.m_columns.size())});
+        if (inserted) params.m_columns.push_back(name);
+        return it->second;
+    };
+
+    auto num_nodes = model.num_nodes();
+    params.m_variable.reserve(num_nodes);
+    params.m_intercept.reserve(num_nodes);
+    params.m_variance.reserve(num_nodes);
+    params.m_row_offsets.reserve(num_nodes + 1);
+    params.m_row_offsets.push_back(0);
+
+    for (const auto& node : model.nodes()) {
+        auto cpd = model.cpd(node);
+        if (cpd->is_python_derived()) return std::nullopt;
+
+        auto lg = std::dynamic_pointer_cast<LinearGaussianCPD>(cpd);
+        if (!lg) return std::nullopt;
+
+        const auto& beta = lg->beta();
+        const auto& evidence = lg->evidence();
+        params.m_variable.push_back(column_index(lg->variable()));
+        params.m_intercept.push_back(beta(0));
+        params.m_variance.push_back(lg->variance());
+        for (int k = 0, k_end = evidence.size(); k < k_end; ++k) {
+            params.m_evidence.push_back(column_index(evidence[k]));
+            params.m_coefficients.push_back(beta(k + 1));
+        }
+        params.m_row_offsets.push_back(params.m_evidence.size());
+    }
+
+    return params;
+}
+
+template <typename ArrowType>
+std::vector<const typename ArrowType::c_type*> LinearGaussianParameters::raw_columns(const DataFrame& df) const {
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+
+    std::vector<const typename ArrowType::c_type*> columns;
+    columns.reserve(m_columns.size());
+    for (const auto& name : m_columns) {
+        auto column = df.col(name);
+        if (column->type_id() != ArrowType::type_id || column->null_count() > 0) return {};
+        columns.push_back(std::static_pointer_cast<ArrayType>(column)->raw_values());
+    }
+
+    return columns;
+}
+
+template <typename ArrowType, typename F>
+void LinearGaussianParameters::for_each_residual_block(const DataFrame& df,
+                                                       const std::vector<const typename ArrowType::c_type*>& columns,
+                                                       F&& f) const {
+    using CType = typename ArrowType::c_type;
+
+    // The residuals are computed with the same operations of LinearGaussianCPD, so the results are equal.
+    CType residuals[logl_block_rows];
+    for (int64_t offset = 0, rows = df->num_rows(); offset < rows; offset += logl_block_rows) {
+        auto block_rows = std::min(logl_block_rows, rows - offset);
+        for (int i = 0, i_end = m_variable.size(); i < i_end; ++i) {
+            auto intercept = static_cast<CType>(m_intercept[i]);
+            for (int64_t r = 0; r < block_rows; ++r) {
+                residuals[r] = intercept;
+            }
+
+            for (int k = m_row_offsets[i]; k < m_row_offsets[i + 1]; ++k) {
+                auto coefficient = static_cast<CType>(m_coefficients[k]);
+                const CType* evidence = columns[m_evidence[k]] + offset;
+                for (int64_t r = 0; r < block_rows; ++r) {
+                    residuals[r] += coefficient * evidence[r];
+                }
+            }
+
+            const CType* variable = columns[m_variable[i]] + offset;
+            for (int64_t r = 0; r < block_rows; ++r) {
+                residuals[r] = variable[r] - residuals[r];
+            }
+
+            f(i, offset, block_rows, residuals);
+        }
+    }
+}
+
+template <typename ArrowType>
+void LinearGaussianParameters::logl_impl(const DataFrame& df,
+                                         const std::vector<const typename ArrowType::c_type*>& columns,
+                                         Eigen::Ref<VectorXd> out) const {
+    using CType = typename ArrowType::c_type;
+
+    std::vector<CType> lognorm, half_inv_variance;
+    for (auto variance : m_variance) {
+        lognorm.push_back(static_cast<CType>(-0.5 * std::log(variance) - 0.5 * std::log(2 * util::pi<double>)));
+        half_inv_variance.push_back(static_cast<CType>(0.5 / variance));
+    }
+
+    out.setZero();
+    for_each_residual_block<ArrowType>(
+        df, columns, [&](int i, int64_t offset, int64_t block_rows, const CType* residuals) {
+            for (int64_t r = 0; r < block_rows; ++r) {
+                CType logl = lognorm[i] - half_inv_variance[i] * residuals[r] * residuals[r];
+                out(offset + r) += logl;
+            }
+        });
+}
+
+template <typename ArrowType>
+double LinearGaussianParameters::slogl_impl(const DataFrame& df,
+                                            const std::vector<const typename ArrowType::c_type*>& columns) const {
+    using CType = typename ArrowType::c_type;
+
+    std::vector<double> sse(m_variable.size(), 0);
+    for_each_residual_block<ArrowType>(
+        df, columns, [&sse](int i, int64_t, int64_t block_rows, const CType* residuals) {
+            for (int64_t r = 0; r < block_rows; ++r) {
+                sse[i] += static_cast<double>(residuals[r]) * residuals[r];
+            }
+        });
+
+    double accum = 0;
+    for (int i = 0, i_end = m_variable.size(); i < i_end; ++i) {
+        accum += -0.5 * df->num_rows() * (std::log(m_variance[i]) + std::log(2 * util::pi<double>)) -
+                 0.5 * sse[i] / m_variance[i];
+    }
+
+    return accum;
+}
+
+std::optional<VectorXd> LinearGaussianParameters::logl(const DataFrame& df) const {
+    VectorXd accum(df->num_rows());
+    if (logl_into(df, accum)) return accum;
+    return std::nullopt;
+}
+
+bool LinearGaussianParameters::logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const {
+    if (auto columns = raw_columns<arrow::DoubleType>(df); !columns.empty() || m_columns.empty()) {
+        logl_impl<arrow::DoubleType>(df, columns, out);
+        return true;
+    }
+    if (auto columns = raw_columns<arrow::FloatType>(df); !columns.empty()) {
+        logl_impl<arrow::FloatType>(df, columns, out);
+        return true;
+    }
+    return false;
+}
+
+std::optional<double> LinearGaussianParameters::slogl(const DataFrame& df) const {
+    if (auto columns = raw_columns<arrow::DoubleType>(df); !columns.empty() || m_columns.empty())
+        return slogl_impl<arrow::DoubleType>(df, columns);
+    if (auto columns = raw_columns<arrow::FloatType>(df); !columns.empty())
+        return slogl_impl<arrow::FloatType>(df, columns);
+    return std::nullopt;
+}
+
+VectorXd GaussianNetwork::logl(const DataFrame& df) const {
+    check_fitted();
+    if (auto params = LinearGaussianParameters::from_model(*this)) {
+        if (auto res = params->logl(df)) return *std::move(res);
+    }
+
+    return BayesianNetwork::logl(df);
+}
+
+void GaussianNetwork::logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const {
+    check_fitted();
+    factors::check_logl_output(df, out.rows());
+    if (auto params = LinearGaussianParameters::from_model(*this)) {
+        if (params->logl_into(df, out)) return;
+    }
+
+    BayesianNetwork::logl_into(df, out);
+}
+
+double GaussianNetwork::slogl(const DataFrame& df) const {
+    check_fitted();
+    if (auto params = LinearGaussianParameters::from_model(*this)) {
+        if (auto res = params->slogl(df)) return *res;
+    }
+
+    return BayesianNetwork::slogl(df);
+}
+
+VectorXd ConditionalGaussianNetwork::logl(const DataFrame& df) const {
+    check_fitted();
+    if (auto params = LinearGaussianParameters::from_model(*this)) {
+        if (auto res = params->logl(df)) return *std::move(res);
+    }
+
+    return ConditionalBayesianNetwork::logl(df);
+}
+
+void ConditionalGaussianNetwork::logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const {
+    check_fitted();
+    factors::check_logl_output(df, out.rows());
+    if (auto params = LinearGaussianParameters::from_model(*this)) {
+        if (params->logl_into(df, out)) return;
+    }
+
+    ConditionalBayesianNetwork::logl_into(df, out);
+}
+
+double ConditionalGaussianNetwork::slogl(const DataFrame& df) const {
+    check_fitted();
+    if (auto params = LinearGaussianParameters::from_model(*this)) {
+        if (auto res = params->slogl(df)) return *res;
+    }
+
+    return ConditionalBayesianNetwork::slogl(df);
+}
+
+}  // namespace models
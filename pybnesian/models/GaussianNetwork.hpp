@@ -1,6 +1,7 @@
 #ifndef PYBNESIAN_MODELS_GAUSSIANNETWORK_HPP
 #define PYBNESIAN_MODELS_GAUSSIANNETWORK_HPP
 
+#include <optional>
 #include <models/BayesianNetwork.hpp>
 #include <models/DynamicBayesianNetwork.hpp>
 #include <factors/continuous/LinearGaussianCPD.hpp>
@@ -56,6 +57,56 @@ private:
     GaussianNetworkType() { m_hash = reinterpret_cast<std::uintptr_t>(this); }
 };
 
+// The parameters of the LinearGaussianCPDs of a Gaussian network, stored as a struct of arrays. The coefficients of the
+// evidence of all the nodes form a sparse matrix in compressed row format (a row for each node), so the log-likelihood
+// of the whole network is a sparse matrix-vector product for each row of the data, evaluated in one pass over blocks of
+// rows without the virtual calls, the lookups of the columns and the temporary vectors of each LinearGaussianCPD.
+class LinearGaussianParameters {
+public:
+    // Returns the parameters of the CPDs of model, or std::nullopt if some CPD is not a LinearGaussianCPD (e.g., a
+    // Python-derived CPD).
+    static std::optional<LinearGaussianParameters> from_model(const BayesianNetworkBase& model);
+
+    // Return the same result as BayesianNetworkBase::logl() and BayesianNetworkBase::slogl(), or std::nullopt if the
+    // columns of the CPDs contain null values or do not have the same data type (double or float).
+    std::optional<VectorXd> logl(const DataFrame& df) const;
+    // Same as logl(), but the log-likelihood is stored in out (with df->num_rows() elements). Returns false, without
+    // modifying out, if it cannot be evaluated.
+    bool logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const;
+    std::optional<double> slogl(const DataFrame& df) const;
+
+private:
+    LinearGaussianParameters() = default;
+
+    // Returns the raw values of m_columns in df, or an empty vector if they cannot be evaluated together.
+    template <typename ArrowType>
+    std::vector<const typename ArrowType::c_type*> raw_columns(const DataFrame& df) const;
+    // Calls f(node, offset, residuals) for each node and block of rows [offset, offset + block_rows) of df.
+    template <typename ArrowType, typename F>
+    void for_each_residual_block(const DataFrame& df,
+                                 const std::vector<const typename ArrowType::c_type*>& columns,
+                                 F&& f) const;
+    template <typename ArrowType>
+    void logl_impl(const DataFrame& df,
+                   const std::vector<const typename ArrowType::c_type*>& columns,
+                   Eigen::Ref<VectorXd> out) const;
+    template <typename ArrowType>
+    double slogl_impl(const DataFrame& df, const std::vector<const typename ArrowType::c_type*>& columns) const;
+
+    // The names of the columns used by the CPDs.
+    std::vector<std::string> m_columns;
+    // For each node (in the order of BayesianNetworkBase::nodes()), the index of its column in m_columns, and its
+    // intercept and variance.
+    std::vector<int> m_variable;
+    std::vector<double> m_intercept;
+    std::vector<double> m_variance;
+    // The evidence of the node i are m_evidence[m_row_offsets[i], m_row_offsets[i + 1]) (indices of m_columns) with
+    // coefficients m_coefficients[m_row_offsets[i], m_row_offsets[i + 1]).
+    std::vector<int> m_row_offsets;
+    std::vector<int> m_evidence;
+    std::vector<double> m_coefficients;
+};
+
 class GaussianNetwork : public clone_inherit<GaussianNetwork, BayesianNetwork> {
 public:
     GaussianNetwork(const std::vector<std::string>& nodes) : clone_inherit(GaussianNetworkType::get(), nodes) {}
@@ -68,6 +119,11 @@ public:
     GaussianNetwork(const Dag& graph) : clone_inherit(GaussianNetworkType::get(), graph) {}
     GaussianNetwork(Dag&& graph) : clone_inherit(GaussianNetworkType::get(), std::move(graph)) {}
 
+    // Evaluated with LinearGaussianParameters when all the CPDs are LinearGaussianCPDs.
+    VectorXd logl(const DataFrame& df) const override;
+    void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const override;
+    double slogl(const DataFrame& df) const override;
+
     std::string ToString() const override { return "GaussianNetwork"; }
 };
 
@@ -84,6 +140,10 @@ public:
     ConditionalGaussianNetwork(const ConditionalDag& graph) : clone_inherit(GaussianNetworkType::get(), graph) {}
     ConditionalGaussianNetwork(ConditionalDag&& graph) : clone_inherit(GaussianNetworkType::get(), std::move(graph)) {}
 
+    VectorXd logl(const DataFrame& df) const override;
+    void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const override;
+    double slogl(const DataFrame& df) const override;
+
     std::string ToString() const override { return "ConditionalGaussianNetwork"; }
 };
 
@@ -0,0 +1,450 @@
+#include <models/LoglPlan.hpp>
+#include <factors/continuous/LinearGaussianCPD.hpp>
+#include <factors/discrete/DiscreteFactor.hpp>
+#include <opencl/opencl_config.hpp>
+#include <util/math_constants.hpp>
+
+using factors::continuous::LinearGaussianCPD, factors::continuous::CLinearGaussianCPD;
+using factors::discrete::DiscreteFactor, factors::discrete::DiscreteIndicesColumn;
+using opencl::OpenCLConfig, opencl::OpenCL_kernel_traits;
+
+namespace models {
+
+namespace {
+
+int column_index(const arrow::Schema& schema, const std::string& name) {
+    auto index = schema.GetFieldIndex(name);
+    if (index == -1) {
+        throw std::invalid_argument("The schema does not contain a unique column " + name + ".");
+    }
+
+    return index;
+}
+
+// Returns the type of the columns if all the columns have the same type. Otherwise, returns arrow::Type::NA.
+arrow::Type::type same_type(const arrow::Schema& schema, const std::vector<int>& columns) {
+    auto type = schema.field(columns[0])->type()->id();
+    for (auto c : columns) {
+        if (schema.field(c)->type()->id() != type) return arrow::Type::NA;
+    }
+
+    return type;
+}
+
+std::unordered_map<std::string, int> category_indices(const std::vector<std::string>& categories) {
+    std::unordered_map<std::string, int> indices;
+    for (int i = 0, i_end = categories.size(); i < i_end; ++i) {
+        indices.insert({categories[i], i});
+    }
+
+    return indices;
+}
+
+double continuous_value(const AssignmentValue& value, const arrow::Schema& schema, int column) {
+    if (const auto* v = std::get_if<double>(&value.value())) return *v;
+    throw std::invalid_argument("The value of " + schema.field(column)->name() + " must be a number.");
+}
+
+int category_index(const AssignmentValue& value,
+                   const std::unordered_map<std::string, int>& categories,
+                   const arrow::Schema& schema,
+                   int column) {
+    const auto* v = std::get_if<std::string>(&value.value());
+    if (!v) throw std::invalid_argument("The value of " + schema.field(column)->name() + " must be a string.");
+
+    auto found = categories.find(*v);
+    if (found == categories.end()) {
+        throw std::invalid_argument("Category " + *v + " is not a category of " + schema.field(column)->name() + ".");
+    }
+
+    return found->second;
+}
+
+}  // namespace
+
+LoglPlan::LoglPlan(const BayesianNetworkBase& model,
+                   const std::shared_ptr<arrow::Schema>& schema,
+                   KDEBackend backend)
+    : m_schema(schema), m_kernels(), m_backend(kde::resolve_backend(backend)) {
+    if (!schema) throw std::invalid_argument("The schema of a LoglPlan must be non-null.");
+    if (!model.fitted()) throw std::invalid_argument("Model not fitted.");
+
+    auto gaussian_params = [](const LinearGaussianCPD& lg) {
+        return LinearGaussianParams{lg.beta(),
+                                    -0.5 * std::log(lg.variance()) - 0.5 * std::log(2 * util::pi<double>),
+                                    0.5 / lg.variance()};
+    };
+
+    m_kernels.reserve(model.num_nodes());
+    for (const auto& node : model.nodes()) {
+        Kernel kernel{};
+        kernel.kind = KernelKind::FACTOR;
+        kernel.cpd = model.cpd(node);
+
+        kernel.columns.push_back(column_index(*schema, kernel.cpd->variable()));
+        for (const auto& e : kernel.cpd->evidence()) {
+            kernel.columns.push_back(column_index(*schema, e));
+        }
+
+        auto type = same_type(*schema, kernel.columns);
+        if (!kernel.cpd->is_python_derived()) {
+            if (auto lg = std::dynamic_pointer_cast<LinearGaussianCPD>(kernel.cpd);
+                lg && (type == arrow::Type::DOUBLE || type == arrow::Type::FLOAT)) {
+                kernel.kind = KernelKind::LINEAR_GAUSSIAN;
+                kernel.type = type;
+                kernel.gaussians.push_back(gaussian_params(*lg));
+            } else if (auto discrete = std::dynamic_pointer_cast<DiscreteFactor>(kernel.cpd);
+                       discrete && !discrete->sparse() && type == arrow::Type::DICTIONARY) {
+                kernel.kind = KernelKind::DISCRETE;
+                kernel.strides = discrete->strides();
+                kernel.logprob = discrete->logprob();
+                kernel.categories.push_back(category_indices(discrete->variable_values()));
+                for (const auto& values : discrete->evidence_values()) {
+                    kernel.categories.push_back(category_indices(values));
+                }
+            } else if (auto clg = std::dynamic_pointer_cast<CLinearGaussianCPD>(kernel.cpd); clg && !clg->sparse()) {
+                Kernel conditional{};
+                conditional.kind = KernelKind::CONDITIONAL_LINEAR_GAUSSIAN;
+                conditional.cpd = kernel.cpd;
+                conditional.columns.push_back(kernel.columns[0]);
+                for (const auto& e : clg->continuous_evidence()) {
+                    conditional.columns.push_back(column_index(*schema, e));
+                }
+
+                for (const auto& e : clg->discrete_evidence()) {
+                    conditional.discrete_columns.push_back(column_index(*schema, e));
+                }
+                for (const auto& values : clg->discrete_values()) {
+                    conditional.categories.push_back(category_indices(values));
+                }
+                conditional.strides = clg->strides();
+
+                bool all_gaussian = true;
+                for (const auto& f : clg->conditional_factors()) {
+                    if (!f) {
+                        VectorXd beta = VectorXd::Zero(conditional.columns.size());
+                        conditional.gaussians.push_back(LinearGaussianParams{beta, util::nan<double>, 0});
+                    } else if (auto conditional_lg = std::dynamic_pointer_cast<LinearGaussianCPD>(f)) {
+                        conditional.gaussians.push_back(gaussian_params(*conditional_lg));
+                    } else {
+                        all_gaussian = false;
+                    }
+                }
+
+                if (all_gaussian) kernel = std::move(conditional);
+            }
+        }
+
+        m_kernels.push_back(std::move(kernel));
+    }
+}
+
+void LoglPlan::check_schema(const DataFrame& df) const {
+    if (!df->schema()->Equals(*m_schema, false)) {
+        throw std::invalid_argument("The schema of the DataFrame is not the schema of the LoglPlan:\n" +
+                                    df->schema()->ToString() + "\nExpected schema:\n" + m_schema->ToString());
+    }
+}
+
+bool LoglPlan::contains_null(const Kernel& kernel, const DataFrame& df) const {
+    for (auto c : kernel.columns) {
+        if (df->column(c)->null_count() > 0) return true;
+    }
+
+    return false;
+}
+
+template <typename ArrowType, typename F>
+void LoglPlan::for_each_residual(const Kernel& kernel, const DataFrame& df, F&& f) const {
+    using CType = typename ArrowType::c_type;
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+
+    auto raw_values = [&df](int column) {
+        return std::static_pointer_cast<ArrayType>(df->column(column))->raw_values();
+    };
+
+    const auto& params = kernel.gaussians[0];
+    const CType* variable = raw_values(kernel.columns[0]);
+    int num_evidence = kernel.columns.size() - 1;
+    std::vector<const CType*> evidence(num_evidence);
+    for (int k = 0; k < num_evidence; ++k) {
+        evidence[k] = raw_values(kernel.columns[k + 1]);
+    }
+
+    for (int64_t i = 0, end = df->num_rows(); i < end; ++i) {
+        double mean = params.beta(0);
+        for (int k = 0; k < num_evidence; ++k) {
+            mean += params.beta(k + 1) * evidence[k][i];
+        }
+
+        f(i, variable[i] - mean);
+    }
+}
+
+template <typename ArrowType>
+void LoglPlan::add_linear_gaussian_logl(const Kernel& kernel, const DataFrame& df, VectorXd& accum) const {
+    const auto& params = kernel.gaussians[0];
+    for_each_residual<ArrowType>(kernel, df, [&params, &accum](int64_t i, double residual) {
+        accum(i) += params.lognorm - params.half_inv_variance * residual * residual;
+    });
+}
+
+template <typename ArrowType>
+double LoglPlan::linear_gaussian_slogl(const Kernel& kernel, const DataFrame& df) const {
+    double sse = 0;
+    for_each_residual<ArrowType>(kernel, df, [&sse](int64_t, double residual) { sse += residual * residual; });
+    const auto& params = kernel.gaussians[0];
+    return df->num_rows() * params.lognorm - params.half_inv_variance * sse;
+}
+
+template <typename ArrowType, typename F>
+void LoglPlan::opencl_linear_gaussian(const std::vector<const Kernel*>& kernels, const DataFrame& df, F&& f) const {
+    using CType = typename ArrowType::c_type;
+
+    int rows = df->num_rows();
+    if (kernels.empty() || rows == 0) return;
+
+    // The columns of the kernels are the columns of the evaluated matrix, in the order of their first use.
+    std::vector<int> matrix_columns;
+    std::unordered_map<int, unsigned int> matrix_index;
+    auto matrix_column = [&](int column) {
+        auto [it, inserted] = matrix_index.insert({column, matrix_columns.size()});
+        if (inserted) matrix_columns.push_back(column);
+        return it->second;
+    };
+
+    std::vector<unsigned int> variables, offsets{0}, evidence;
+    std::vector<CType> beta, lognorm, half_inv_variance;
+    for (const auto* kernel : kernels) {
+        const auto& params = kernel->gaussians[0];
+        variables.push_back(matrix_column(kernel->columns[0]));
+        for (size_t k = 1; k < kernel->columns.size(); ++k) {
+            evidence.push_back(matrix_column(kernel->columns[k]));
+        }
+        offsets.push_back(evidence.size());
+
+        for (int k = 0, k_end = params.beta.rows(); k < k_end; ++k) {
+            beta.push_back(params.beta(k));
+        }
+        lognorm.push_back(params.lognorm);
+        half_inv_variance.push_back(params.half_inv_variance);
+    }
+    // The OpenCL buffers can not be empty.
+    if (evidence.empty()) evidence.push_back(0);
+
+    auto opencl_lock = OpenCLConfig::get(OpenCLConfig::select_device()).lock();
+    auto& opencl = OpenCLConfig::get();
+
+    std::vector<std::shared_ptr<cl::Buffer>> columns;
+    columns.reserve(matrix_columns.size());
+    for (auto c : matrix_columns) {
+        columns.push_back(opencl.shared_column<ArrowType>(df->column(c)));
+    }
+
+    unsigned int m = matrix_columns.size();
+    unsigned int num_cpds = kernels.size();
+    // The matrix of a block of rows (and its result) is not larger than a temporary matrix (see
+    // OpenCLConfig::temp_mat_cols()), so the DataFrames with many rows are evaluated in many blocks.
+    int block_rows = static_cast<int>(opencl.temp_mat_cols(m, rows, 1, sizeof(CType)));
+
+    auto variables_buffer = opencl.copy_to_temp_buffer(variables.data(), variables.size());
+    auto offsets_buffer = opencl.copy_to_temp_buffer(offsets.data(), offsets.size());
+    auto evidence_buffer = opencl.copy_to_temp_buffer(evidence.data(), evidence.size());
+    auto beta_buffer = opencl.copy_to_temp_buffer(beta.data(), beta.size());
+    auto lognorm_buffer = opencl.copy_to_temp_buffer(lognorm.data(), lognorm.size());
+    auto half_inv_variance_buffer = opencl.copy_to_temp_buffer(half_inv_variance.data(), half_inv_variance.size());
+    auto matrix = opencl.temp_buffer<CType>(block_rows * m);
+    auto res = opencl.temp_buffer<CType>(block_rows);
+
+    auto& k_logl = opencl.kernel(OpenCL_kernel_traits<ArrowType>::linear_gaussian_logl);
+    k_logl.setArg(0, matrix);
+    k_logl.setArg(1, static_cast<unsigned int>(block_rows));
+    k_logl.setArg(2, num_cpds);
+    k_logl.setArg(3, variables_buffer);
+    k_logl.setArg(4, offsets_buffer);
+    k_logl.setArg(5, evidence_buffer);
+    k_logl.setArg(6, beta_buffer);
+    k_logl.setArg(7, lognorm_buffer);
+    k_logl.setArg(8, half_inv_variance_buffer);
+    k_logl.setArg(9, res);
+
+    std::vector<CType> values(block_rows);
+    for (int offset = 0; offset < rows; offset += block_rows) {
+        int length = std::min(block_rows, rows - offset);
+        for (unsigned int j = 0; j < m; ++j) {
+            opencl.copy_buffer_region<CType>(*columns[j], offset, matrix, j * block_rows, length);
+        }
+
+        RAISE_ENQUEUEKERNEL_ERROR(
+            opencl.queue().enqueueNDRangeKernel(k_logl, cl::NullRange, cl::NDRange(length), cl::NullRange));
+        opencl.read_from_buffer(values.data(), res, length);
+        f(offset, length, values.data());
+    }
+}
+
+std::vector<DiscreteIndicesColumn> LoglPlan::discrete_columns(const Kernel& kernel, const DataFrame& df) const {
+    std::vector<DiscreteIndicesColumn> columns;
+    columns.reserve(kernel.columns.size());
+    for (size_t i = 0; i < kernel.columns.size(); ++i) {
+        columns.push_back(factors::discrete::discrete_indices_column(df->column(kernel.columns[i]), kernel.strides(i)));
+    }
+
+    return columns;
+}
+
+VectorXd LoglPlan::logl(const DataFrame& df) const {
+    check_schema(df);
+
+    VectorXd accum = VectorXd::Zero(df->num_rows());
+    std::vector<const Kernel*> opencl_double, opencl_float;
+    for (const auto& kernel : m_kernels) {
+        if (evaluate_factor(kernel, df)) {
+            accum += kernel.cpd->logl(df);
+        } else if (kernel.kind == KernelKind::LINEAR_GAUSSIAN && m_backend == KDEBackend::OPENCL) {
+            (kernel.type == arrow::Type::DOUBLE ? opencl_double : opencl_float).push_back(&kernel);
+        } else if (kernel.kind == KernelKind::LINEAR_GAUSSIAN) {
+            if (kernel.type == arrow::Type::DOUBLE)
+                add_linear_gaussian_logl<arrow::DoubleType>(kernel, df, accum);
+            else
+                add_linear_gaussian_logl<arrow::FloatType>(kernel, df, accum);
+        } else {
+            factors::discrete::for_each_discrete_indices_block(
+                discrete_columns(kernel, df), df->num_rows(), nullptr, [&](int offset, int length, const int* indices) {
+                    for (int k = 0; k < length; ++k) {
+                        accum(offset + k) += kernel.logprob(indices[k]);
+                    }
+                });
+        }
+    }
+
+    auto add_logl = [&accum](int offset, int length, const auto* values) {
+        for (int k = 0; k < length; ++k) {
+            accum(offset + k) += values[k];
+        }
+    };
+    opencl_linear_gaussian<arrow::DoubleType>(opencl_double, df, add_logl);
+    opencl_linear_gaussian<arrow::FloatType>(opencl_float, df, add_logl);
+
+    return accum;
+}
+
+double LoglPlan::slogl(const DataFrame& df) const {
+    check_schema(df);
+
+    double accum = 0;
+    std::vector<const Kernel*> opencl_double, opencl_float;
+    for (const auto& kernel : m_kernels) {
+        if (evaluate_factor(kernel, df)) {
+            accum += kernel.cpd->slogl(df);
+        } else if (kernel.kind == KernelKind::LINEAR_GAUSSIAN && m_backend == KDEBackend::OPENCL) {
+            (kernel.type == arrow::Type::DOUBLE ? opencl_double : opencl_float).push_back(&kernel);
+        } else if (kernel.kind == KernelKind::LINEAR_GAUSSIAN) {
+            if (kernel.type == arrow::Type::DOUBLE)
+                accum += linear_gaussian_slogl<arrow::DoubleType>(kernel, df);
+            else
+                accum += linear_gaussian_slogl<arrow::FloatType>(kernel, df);
+        } else {
+            factors::discrete::for_each_discrete_indices_block(
+                discrete_columns(kernel, df), df->num_rows(), nullptr, [&](int, int length, const int* indices) {
+                    for (int k = 0; k < length; ++k) {
+                        accum += kernel.logprob(indices[k]);
+                    }
+                });
+        }
+    }
+
+    auto add_slogl = [&accum](int, int length, const auto* values) {
+        for (int k = 0; k < length; ++k) {
+            accum += values[k];
+        }
+    };
+    opencl_linear_gaussian<arrow::DoubleType>(opencl_double, df, add_slogl);
+    opencl_linear_gaussian<arrow::FloatType>(opencl_float, df, add_slogl);
+
+    return accum;
+}
+
+template <typename ValueFunc>
+double LoglPlan::_logl_instance(ValueFunc&& value) const {
+    const auto& schema = *m_schema;
+
+    // The log-likelihood of the column columns[0] given the columns [1, ...) in a LinearGaussianCPD.
+    auto gaussian_logl = [&](const LinearGaussianParams& params, const std::vector<int>& columns) {
+        double mean = params.beta(0);
+        for (int k = 1, k_end = columns.size(); k < k_end; ++k) {
+            mean += params.beta(k) * continuous_value(value(columns[k]), schema, columns[k]);
+        }
+
+        double residual = continuous_value(value(columns[0]), schema, columns[0]) - mean;
+        return params.lognorm - params.half_inv_variance * residual * residual;
+    };
+
+    auto discrete_index = [&](const Kernel& kernel, const std::vector<int>& columns) {
+        int index = 0;
+        for (int k = 0, k_end = columns.size(); k < k_end; ++k) {
+            index += category_index(value(columns[k]), kernel.categories[k], schema, columns[k]) * kernel.strides(k);
+        }
+
+        return index;
+    };
+
+    double accum = 0;
+    for (const auto& kernel : m_kernels) {
+        switch (kernel.kind) {
+            case KernelKind::LINEAR_GAUSSIAN:
+                accum += gaussian_logl(kernel.gaussians[0], kernel.columns);
+                break;
+            case KernelKind::DISCRETE:
+                accum += kernel.logprob(discrete_index(kernel, kernel.columns));
+                break;
+            case KernelKind::CONDITIONAL_LINEAR_GAUSSIAN:
+                accum += gaussian_logl(kernel.gaussians[discrete_index(kernel, kernel.discrete_columns)],
+                                       kernel.columns);
+                break;
+            default:
+                throw std::invalid_argument("The CPD " + kernel.cpd->ToString() +
+                                            " cannot be evaluated with logl_instance().");
+        }
+    }
+
+    return accum;
+}
+
+double LoglPlan::logl_instance(const std::vector<AssignmentValue>& values) const {
+    if (values.size() != static_cast<size_t>(m_schema->num_fields())) {
+        throw std::invalid_argument("The instance has " + std::to_string(values.size()) +
+                                    " values, but the schema of the LoglPlan has " +
+                                    std::to_string(m_schema->num_fields()) + " columns.");
+    }
+
+    return _logl_instance([&values](int column) -> const AssignmentValue& { return values[column]; });
+}
+
+double LoglPlan::logl_instance(const std::vector<const AssignmentValue*>& values) const {
+    if (values.size() != static_cast<size_t>(m_schema->num_fields())) {
+        throw std::invalid_argument("The instance has " + std::to_string(values.size()) +
+                                    " values, but the schema of the LoglPlan has " +
+                                    std::to_string(m_schema->num_fields()) + " columns.");
+    }
+
+    return _logl_instance([&values](int column) -> const AssignmentValue& { return *values[column]; });
+}
+
+bool LoglPlan::supports_instances() const {
+    return std::all_of(
+        m_kernels.begin(), m_kernels.end(), [](const Kernel& kernel) { return kernel.kind != KernelKind::FACTOR; });
+}
+
+double LoglPlan::logl_instance(const std::unordered_map<std::string, AssignmentValue>& values) const {
+    return _logl_instance([this, &values](int column) -> const AssignmentValue& {
+        const auto& name = m_schema->field(column)->name();
+        auto found = values.find(name);
+        if (found == values.end()) {
+            throw std::invalid_argument("The instance does not contain a value for " + name + ".");
+        }
+
+        return found->second;
+    });
+}
+
+}  // namespace models
@@ -0,0 +1,113 @@
+#ifndef PYBNESIAN_MODELS_LOGLPLAN_HPP
+#define PYBNESIAN_MODELS_LOGLPLAN_HPP
+
+#include <factors/assignment.hpp>
+#include <factors/discrete/discrete_indices.hpp>
+#include <kde/KDE.hpp>
+#include <models/BayesianNetwork.hpp>
+
+using factors::AssignmentValue;
+using kde::KDEBackend;
+
+namespace models {
+
+// A plan to evaluate the log-likelihood of a fitted Bayesian network on DataFrames with a fixed schema. The columns of
+// each CPD are resolved, and the parameters of the LinearGaussianCPDs and DiscreteFactors are copied, when the plan is
+// created, so logl() and slogl() skip the lookup of the columns by name, the type checks and the virtual calls of
+// BayesianNetworkBase::logl(), that dominate the time to evaluate a small DataFrame. The other CPDs, and the CPDs whose
+// columns contain null values, are evaluated with Factor::logl().
+//
+// With KDEBackend::OPENCL, logl() and slogl() evaluate all the LinearGaussianCPDs with the same column type in a single
+// fused kernel. The columns are uploaded once and shared with the other models of the device (see
+// OpenCLConfig::shared_column()), so the next DataFrames with the same columns are not uploaded again.
+//
+// The plan does not change if the model is modified or fitted again, so it must be created again to use the new CPDs.
+class LoglPlan {
+public:
+    LoglPlan(const BayesianNetworkBase& model,
+             const std::shared_ptr<arrow::Schema>& schema,
+             KDEBackend backend = KDEBackend::CPU);
+
+    const std::shared_ptr<arrow::Schema>& schema() const { return m_schema; }
+    KDEBackend backend() const { return m_backend; }
+
+    VectorXd logl(const DataFrame& df) const;
+    double slogl(const DataFrame& df) const;
+
+    // Returns the log-likelihood of one instance without creating a DataFrame. values contains the value of each
+    // column of the schema: a double for the continuous columns and the category (a string) for the discrete columns.
+    // Only the LinearGaussianCPDs, DiscreteFactors and CLinearGaussianCPDs can be evaluated.
+    double logl_instance(const std::vector<AssignmentValue>& values) const;
+    // Same as logl_instance() with the values of the nodes (and their evidence) by name.
+    double logl_instance(const std::unordered_map<std::string, AssignmentValue>& values) const;
+    // Same as logl_instance() with a pointer to the value of each column of the schema, so the values can be stored
+    // elsewhere (e.g., in the ring buffer of DynamicLoglFilter) without copying them.
+    double logl_instance(const std::vector<const AssignmentValue*>& values) const;
+    // Returns true if all the CPDs can be evaluated with logl_instance().
+    bool supports_instances() const;
+
+private:
+    enum class KernelKind { LINEAR_GAUSSIAN, DISCRETE, CONDITIONAL_LINEAR_GAUSSIAN, FACTOR };
+
+    struct LinearGaussianParams {
+        VectorXd beta;
+        double lognorm;
+        double half_inv_variance;
+    };
+
+    struct Kernel {
+        KernelKind kind;
+        // The indices of the columns of the variable and the evidence in the schema. The columns of a
+        // CONDITIONAL_LINEAR_GAUSSIAN kernel are the variable and the continuous evidence.
+        std::vector<int> columns;
+        // The type of the columns of a LINEAR_GAUSSIAN kernel.
+        arrow::Type::type type;
+        // The parameters of a LINEAR_GAUSSIAN kernel, or the parameters of each configuration of the discrete evidence
+        // of a CONDITIONAL_LINEAR_GAUSSIAN kernel. The lognorm of the configurations not fitted is NaN.
+        std::vector<LinearGaussianParams> gaussians;
+        // The columns of the discrete evidence of a CONDITIONAL_LINEAR_GAUSSIAN kernel.
+        std::vector<int> discrete_columns;
+        // The strides of the columns of a DISCRETE kernel, or of the discrete_columns of a CONDITIONAL_LINEAR_GAUSSIAN
+        // kernel.
+        VectorXi strides;
+        // The index of each category of the discrete columns, used by logl_instance().
+        std::vector<std::unordered_map<std::string, int>> categories;
+        // The log-probability table of a DISCRETE kernel.
+        VectorXd logprob;
+        std::shared_ptr<Factor> cpd;
+    };
+
+    void check_schema(const DataFrame& df) const;
+    bool contains_null(const Kernel& kernel, const DataFrame& df) const;
+    // The kernels evaluated with Factor::logl() for df.
+    bool evaluate_factor(const Kernel& kernel, const DataFrame& df) const {
+        return kernel.kind == KernelKind::FACTOR || kernel.kind == KernelKind::CONDITIONAL_LINEAR_GAUSSIAN ||
+               contains_null(kernel, df);
+    }
+
+    template <typename ArrowType>
+    void add_linear_gaussian_logl(const Kernel& kernel, const DataFrame& df, VectorXd& accum) const;
+    template <typename ArrowType>
+    double linear_gaussian_slogl(const Kernel& kernel, const DataFrame& df) const;
+    // Evaluates the LINEAR_GAUSSIAN kernels with columns of ArrowType with OpenCL, calling f(offset, length, values)
+    // for each block of rows, where values is the sum of the log-likelihood of the kernels for each row of the block.
+    template <typename ArrowType, typename F>
+    void opencl_linear_gaussian(const std::vector<const Kernel*>& kernels, const DataFrame& df, F&& f) const;
+    // Calls f(row, residual) for the residual of each row of df.
+    template <typename ArrowType, typename F>
+    void for_each_residual(const Kernel& kernel, const DataFrame& df, F&& f) const;
+    std::vector<factors::discrete::DiscreteIndicesColumn> discrete_columns(const Kernel& kernel,
+                                                                           const DataFrame& df) const;
+
+    // Returns the log-likelihood of an instance, where value(c) returns the value of the column c.
+    template <typename ValueFunc>
+    double _logl_instance(ValueFunc&& value) const;
+
+    std::shared_ptr<arrow::Schema> m_schema;
+    std::vector<Kernel> m_kernels;
+    KDEBackend m_backend;
+};
+
+}  // namespace models
+
+#endif  // PYBNESIAN_MODELS_LOGLPLAN_HPP
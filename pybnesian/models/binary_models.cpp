@@ -0,0 +1,322 @@
+#include <typeinfo>
+#include <models/binary_models.hpp>
+#include <models/GaussianNetwork.hpp>
+#include <models/SemiparametricBN.hpp>
+#include <models/KDENetwork.hpp>
+#include <models/DiscreteBN.hpp>
+#include <models/CLGNetwork.hpp>
+#include <factors/continuous/LinearGaussianCPD.hpp>
+#include <factors/continuous/CKDE.hpp>
+#include <factors/discrete/DiscreteFactor.hpp>
+
+using factors::continuous::LinearGaussianCPD, factors::continuous::CLinearGaussianCPD, factors::continuous::CKDE,
+    factors::continuous::HCKDE, factors::continuous::CKDEType;
+using factors::discrete::DiscreteFactor;
+
+namespace models {
+
+namespace {
+
+const std::string bn_content = "BayesianNetwork";
+const std::string cbn_content = "ConditionalBayesianNetwork";
+const std::string dbn_content = "DynamicBayesianNetwork";
+
+enum class BinaryFactor : std::uint8_t { LINEAR_GAUSSIAN, CKDE, DISCRETE, CLINEAR_GAUSSIAN, HCKDE };
+
+void write_factor(util::BinaryWriter& writer, const Factor& cpd) {
+    if (cpd.is_python_derived()) {
+        throw std::invalid_argument("CPD " + cpd.ToString() +
+                                    " is defined in Python, so it cannot be saved in the binary format.");
+    }
+
+    // The header of the CPD is saved before its record, so the CPD can be loaded lazily (see factors::LazyFactor).
+    writer.write(cpd.variable());
+    writer.write(cpd.evidence());
+    writer.write(cpd.type_ref().ToString());
+    writer.write(cpd.fitted());
+    auto record = writer.begin_record();
+
+    if (auto lg = dynamic_cast<const LinearGaussianCPD*>(&cpd)) {
+        writer.write(static_cast<std::uint8_t>(BinaryFactor::LINEAR_GAUSSIAN));
+        lg->write_binary(writer);
+    } else if (auto ckde = dynamic_cast<const CKDE*>(&cpd)) {
+        writer.write(static_cast<std::uint8_t>(BinaryFactor::CKDE));
+        ckde->write_binary(writer);
+    } else if (auto discrete = dynamic_cast<const DiscreteFactor*>(&cpd)) {
+        writer.write(static_cast<std::uint8_t>(BinaryFactor::DISCRETE));
+        discrete->write_binary(writer);
+    } else if (auto clg = dynamic_cast<const CLinearGaussianCPD*>(&cpd)) {
+        writer.write(static_cast<std::uint8_t>(BinaryFactor::CLINEAR_GAUSSIAN));
+        clg->write_binary(writer);
+    } else if (auto hckde = dynamic_cast<const HCKDE*>(&cpd)) {
+        writer.write(static_cast<std::uint8_t>(BinaryFactor::HCKDE));
+        hckde->write_binary(writer);
+    } else {
+        throw std::invalid_argument("CPD " + cpd.ToString() + " cannot be saved in the binary format.");
+    }
+
+    writer.end_record(record);
+}
+
+std::shared_ptr<Factor> read_factor_record(util::BinaryReader& reader) {
+    switch (static_cast<BinaryFactor>(reader.read<std::uint8_t>())) {
+        case BinaryFactor::LINEAR_GAUSSIAN:
+            return std::make_shared<LinearGaussianCPD>(LinearGaussianCPD::read_binary(reader));
+        case BinaryFactor::CKDE:
+            return std::make_shared<CKDE>(CKDE::read_binary(reader));
+        case BinaryFactor::DISCRETE:
+            return std::make_shared<DiscreteFactor>(DiscreteFactor::read_binary(reader));
+        case BinaryFactor::CLINEAR_GAUSSIAN:
+            return std::make_shared<CLinearGaussianCPD>(CLinearGaussianCPD::read_binary(reader));
+        case BinaryFactor::HCKDE:
+            return std::make_shared<HCKDE>(HCKDE::read_binary(reader));
+        default:
+            throw std::runtime_error("Not valid CPD in binary file.");
+    }
+}
+
+// The types of Bayesian network that can be saved in the binary format.
+std::shared_ptr<BayesianNetworkType> binary_bn_type(const std::string& name) {
+    if (name == GaussianNetworkType::get_ref().ToString()) return GaussianNetworkType::get();
+    if (name == SemiparametricBNType::get_ref().ToString()) return SemiparametricBNType::get();
+    if (name == KDENetworkType::get_ref().ToString()) return KDENetworkType::get();
+    if (name == DiscreteBNType::get_ref().ToString()) return DiscreteBNType::get();
+    if (name == CLGNetworkType::get_ref().ToString()) return CLGNetworkType::get();
+    return nullptr;
+}
+
+std::shared_ptr<FactorType> binary_node_type(const std::string& name) {
+    if (name == UnknownFactorType::get_ref().ToString()) return UnknownFactorType::get();
+    if (name == LinearGaussianCPDType::get_ref().ToString()) return LinearGaussianCPDType::get();
+    if (name == CKDEType::get_ref().ToString()) return CKDEType::get();
+    if (name == DiscreteFactorType::get_ref().ToString()) return DiscreteFactorType::get();
+    return nullptr;
+}
+
+std::shared_ptr<Factor> read_factor(util::BinaryReader& reader, bool lazy) {
+    auto variable = reader.read_string();
+    auto evidence = reader.read_strings();
+    auto type = binary_node_type(reader.read_string());
+    if (!type) throw std::runtime_error("Not valid CPD type in binary file.");
+    auto fitted = reader.read_bool();
+
+    auto record = reader.read_record();
+    if (!lazy) return read_factor_record(record);
+
+    return std::make_shared<factors::LazyFactor>(
+        variable, evidence, type, fitted, [record]() mutable { return read_factor_record(record); });
+}
+
+void check_binary_bn(const BayesianNetworkBase& model) {
+    if (model.has_python_derived()) {
+        throw std::invalid_argument("Model " + model.ToString() +
+                                    " contains objects defined in Python, so it cannot be saved in the binary "
+                                    "format. Use save() instead.");
+    }
+
+    auto type = binary_bn_type(model.type_ref().ToString());
+    if (!type || *type != model.type_ref()) {
+        throw std::invalid_argument("Bayesian networks of type " + model.type_ref().ToString() +
+                                    " cannot be saved in the binary format. Use save() instead.");
+    }
+}
+
+void write_bn(util::BinaryWriter& writer, const BayesianNetworkBase& model, bool include_cpd) {
+    const auto& type = model.type_ref();
+    writer.write(type.ToString());
+    writer.write(model.nodes());
+
+    if (auto cmodel = dynamic_cast<const ConditionalBayesianNetworkBase*>(&model)) {
+        writer.write(cmodel->interface_nodes());
+    }
+
+    // The node types are saved before the arcs, because the arcs allowed by the type can depend on them.
+    if (!type.is_homogeneous()) {
+        for (const auto& node : model.nodes()) {
+            auto node_type = model.node_type(node);
+            if (!binary_node_type(node_type->ToString())) {
+                throw std::invalid_argument("Node type " + node_type->ToString() +
+                                            " cannot be saved in the binary format.");
+            }
+
+            writer.write(node_type->ToString());
+        }
+    }
+
+    auto arcs = model.arcs();
+    writer.write<std::uint64_t>(arcs.size());
+    for (const auto& arc : arcs) {
+        writer.write(arc.first);
+        writer.write(arc.second);
+    }
+
+    // As save(), only the added CPDs compatible with the model are saved.
+    std::vector<std::shared_ptr<Factor>> cpds;
+    if (include_cpd) {
+        for (const auto& node : model.nodes()) {
+            try {
+                auto cpd = model.cpd(node);
+                if (auto bn = dynamic_cast<const BNGeneric<Dag>*>(&model))
+                    bn->check_compatible_cpd(*cpd);
+                else
+                    dynamic_cast<const BNGeneric<ConditionalDag>&>(model).check_compatible_cpd(*cpd);
+                cpds.push_back(cpd);
+            } catch (std::invalid_argument&) {
+            }
+        }
+    }
+
+    writer.write<std::uint64_t>(cpds.size());
+    for (const auto& cpd : cpds) {
+        write_factor(writer, *cpd);
+    }
+}
+
+void read_bn_body(util::BinaryReader& reader, BayesianNetworkBase& bn, bool lazy) {
+    if (!bn.type_ref().is_homogeneous()) {
+        for (const auto& node : bn.nodes()) {
+            auto node_type = binary_node_type(reader.read_string());
+            if (!node_type) throw std::runtime_error("Not valid node type in binary file.");
+            if (*node_type != UnknownFactorType::get_ref()) bn.set_node_type(node, node_type);
+        }
+    }
+
+    ArcStringVector arcs;
+    auto num_arcs = reader.read_count(2 * sizeof(std::uint64_t));
+    for (std::uint64_t i = 0; i < num_arcs; ++i) {
+        auto source = reader.read_string();
+        arcs.emplace_back(std::move(source), reader.read_string());
+    }
+    bn.add_arcs(arcs);
+
+    std::vector<std::shared_ptr<Factor>> cpds(reader.read_count(sizeof(std::uint64_t)));
+    for (auto& cpd : cpds) {
+        cpd = read_factor(reader, lazy);
+    }
+
+    if (!cpds.empty()) bn.add_cpds(cpds);
+}
+
+std::shared_ptr<BayesianNetworkType> read_bn_type(util::BinaryReader& reader) {
+    auto type_name = reader.read_string();
+    auto type = binary_bn_type(type_name);
+    if (!type) throw std::runtime_error("Not valid Bayesian network type in binary file: " + type_name);
+    return type;
+}
+
+std::shared_ptr<BayesianNetworkBase> read_bn(util::BinaryReader& reader, bool lazy) {
+    auto type = read_bn_type(reader);
+    auto bn = type->new_bn(reader.read_strings());
+    read_bn_body(reader, *bn, lazy);
+    return bn;
+}
+
+std::shared_ptr<ConditionalBayesianNetworkBase> read_cbn(util::BinaryReader& reader, bool lazy) {
+    auto type = read_bn_type(reader);
+    auto nodes = reader.read_strings();
+    auto cbn = type->new_cbn(nodes, reader.read_strings());
+    read_bn_body(reader, *cbn, lazy);
+    return cbn;
+}
+
+std::shared_ptr<DynamicBayesianNetworkBase> new_dbn(const std::shared_ptr<BayesianNetworkType>& type,
+                                                    const std::vector<std::string>& variables,
+                                                    int markovian_order,
+                                                    std::shared_ptr<BayesianNetworkBase> static_bn,
+                                                    std::shared_ptr<ConditionalBayesianNetworkBase> transition_bn) {
+    if (*type == GaussianNetworkType::get_ref())
+        return std::make_shared<DynamicGaussianNetwork>(variables, markovian_order, static_bn, transition_bn);
+    if (*type == SemiparametricBNType::get_ref())
+        return std::make_shared<DynamicSemiparametricBN>(variables, markovian_order, static_bn, transition_bn);
+    if (*type == KDENetworkType::get_ref())
+        return std::make_shared<DynamicKDENetwork>(variables, markovian_order, static_bn, transition_bn);
+    if (*type == DiscreteBNType::get_ref())
+        return std::make_shared<DynamicDiscreteBN>(variables, markovian_order, static_bn, transition_bn);
+    return std::make_shared<DynamicCLGNetwork>(variables, markovian_order, static_bn, transition_bn);
+}
+
+std::shared_ptr<DynamicBayesianNetworkBase> read_dbn(util::BinaryReader& reader, bool lazy) {
+    auto variables = reader.read_strings();
+    auto markovian_order = reader.read<std::int32_t>();
+    auto static_bn = read_bn(reader, lazy);
+    auto transition_bn = read_cbn(reader, lazy);
+    return new_dbn(static_bn->type(), variables, markovian_order, static_bn, transition_bn);
+}
+
+void check_content(const util::BinaryReader& reader, const std::string& name, const std::string& expected) {
+    if (reader.content() != expected)
+        throw std::invalid_argument("File " + name + " contains an object of type " + reader.content() + ", not " +
+                                    expected + ".");
+}
+
+std::string binary_filename(std::string name) {
+    if (name.size() < 4 || name.substr(name.size() - 4) != ".pbn") name += ".pbn";
+    return name;
+}
+
+}  // namespace
+
+void save_binary(const BayesianNetworkBase& model, std::string name, bool include_cpd) {
+    check_binary_bn(model);
+
+    auto conditional = dynamic_cast<const ConditionalBayesianNetworkBase*>(&model) != nullptr;
+    util::BinaryWriter writer(binary_filename(name), conditional ? cbn_content : bn_content);
+    write_bn(writer, model, include_cpd);
+    writer.close();
+}
+
+void save_binary(const DynamicBayesianNetworkBase& model, std::string name, bool include_cpd) {
+    // The Python-derived dynamic Bayesian networks could have extra state, so only the C++ classes are saved.
+    const auto& dbn_type = typeid(model);
+    if (dbn_type != typeid(DynamicBayesianNetwork) && dbn_type != typeid(DynamicGaussianNetwork) &&
+        dbn_type != typeid(DynamicSemiparametricBN) && dbn_type != typeid(DynamicKDENetwork) &&
+        dbn_type != typeid(DynamicDiscreteBN) && dbn_type != typeid(DynamicCLGNetwork)) {
+        throw std::invalid_argument("Model " + model.ToString() +
+                                    " cannot be saved in the binary format. Use save() instead.");
+    }
+
+    check_binary_bn(model.static_bn());
+    check_binary_bn(model.transition_bn());
+
+    util::BinaryWriter writer(binary_filename(name), dbn_content);
+    writer.write(model.variables());
+    writer.write<std::int32_t>(model.markovian_order());
+    write_bn(writer, model.static_bn(), include_cpd);
+    write_bn(writer, model.transition_bn(), include_cpd);
+    writer.close();
+}
+
+py::object load_binary(const std::string& name, bool lazy, bool memory_map) {
+    util::BinaryReader reader(name, memory_map);
+    const auto& content = reader.content();
+
+    if (content == bn_content) {
+        return py::cast(read_bn(reader, lazy));
+    } else if (content == cbn_content) {
+        return py::cast(read_cbn(reader, lazy));
+    } else if (content == dbn_content) {
+        return py::cast(read_dbn(reader, lazy));
+    } else {
+        throw std::invalid_argument("File " + name + " contains an object of unknown type: " + content);
+    }
+}
+
+std::shared_ptr<BayesianNetworkBase> load_binary_bn(const std::string& name, bool lazy, bool memory_map) {
+    util::BinaryReader reader(name, memory_map);
+    check_content(reader, name, bn_content);
+    return read_bn(reader, lazy);
+}
+
+std::shared_ptr<ConditionalBayesianNetworkBase> load_binary_cbn(const std::string& name, bool lazy, bool memory_map) {
+    util::BinaryReader reader(name, memory_map);
+    check_content(reader, name, cbn_content);
+    return read_cbn(reader, lazy);
+}
+
+std::shared_ptr<DynamicBayesianNetworkBase> load_binary_dbn(const std::string& name, bool lazy, bool memory_map) {
+    util::BinaryReader reader(name, memory_map);
+    check_content(reader, name, dbn_content);
+    return read_dbn(reader, lazy);
+}
+
+}  // namespace models
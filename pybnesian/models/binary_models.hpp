@@ -0,0 +1,42 @@
+#ifndef PYBNESIAN_MODELS_BINARY_MODELS_HPP
+#define PYBNESIAN_MODELS_BINARY_MODELS_HPP
+
+#include <models/BayesianNetwork.hpp>
+#include <models/DynamicBayesianNetwork.hpp>
+#include <util/binary_io.hpp>
+
+namespace models {
+
+// Saves the model in the binary format of PyBNesian (see util::BinaryWriter). Unlike save(), the binary format does not
+// use pickle, so only the models, node types, CPDs and bandwidth selectors implemented in C++ can be saved. If
+// include_cpd is true, the CPDs of the model are also saved. The extension ".pbn" is appended to name if it does not
+// have it.
+void save_binary(const BayesianNetworkBase& model, std::string name, bool include_cpd = false);
+void save_binary(const DynamicBayesianNetworkBase& model, std::string name, bool include_cpd = false);
+
+// Loads a model saved with save_binary(). If lazy is true, each CPD is loaded the first time it is used (see
+// factors::LazyFactor), so the load time is proportional to the CPDs that are used. The lazily loaded CPDs keep the
+// file memory-mapped until they are loaded. If memory_map is true, the training data of the KDEs and the
+// log-probability tables of the discrete factors are used directly from the memory-mapped file, so the processes that
+// load the same file share one copy of them (see util::BinaryReader).
+py::object load_binary(const std::string& name, bool lazy = false, bool memory_map = false);
+
+// Same as load_binary(), but the model is returned as a C++ object instead of a Python object, so the binary files can
+// be loaded by C++ code that does not convert the models to Python. Each function loads one kind of model, and it
+// throws if the file contains another kind of model. These loaders are only the native entry points of the binary
+// format: they are compiled in the Python extension, and there is no core library that can be linked without Python,
+// because the models, factors and scores still depend on pybind11 (e.g., __getstate__() and the Python-derived node
+// types and CPDs).
+std::shared_ptr<BayesianNetworkBase> load_binary_bn(const std::string& name,
+                                                    bool lazy = false,
+                                                    bool memory_map = false);
+std::shared_ptr<ConditionalBayesianNetworkBase> load_binary_cbn(const std::string& name,
+                                                                bool lazy = false,
+                                                                bool memory_map = false);
+std::shared_ptr<DynamicBayesianNetworkBase> load_binary_dbn(const std::string& name,
+                                                            bool lazy = false,
+                                                            bool memory_map = false);
+
+}  // namespace models
+
+#endif  // PYBNESIAN_MODELS_BINARY_MODELS_HPP
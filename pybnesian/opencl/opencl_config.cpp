@@ -1,7 +1,25 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <random>
+#include <sstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <opencl/opencl_config.hpp>
 #include <opencl/opencl_code.hpp>
 
+namespace fs = std::filesystem;
+
 namespace opencl {
 
 const char* opencl_error(cl_int error) {
@@ -146,7 +164,9 @@ const char* opencl_error(cl_int error) {
     }
 }
 
-OpenCLConfig::OpenCLConfig() {
+std::vector<std::unique_ptr<OpenCLConfig>> OpenCLConfig::create_pool() {
+    std::lock_guard<std::mutex> l(s_devices_mutex);
+
     std::vector<cl::Platform> platforms;
     cl::Platform::get(&platforms);
     if (platforms.empty()) {
@@ -158,21 +178,229 @@ OpenCLConfig::OpenCLConfig() {
         throw std::runtime_error("Error setting default platform.");
     }
 
-    std::vector<cl::Device> devices;
-    plat.getDevices(CL_DEVICE_TYPE_ALL, &devices);
-    if (devices.size() == 0) {
+    std::vector<cl::Device> platform_devices;
+    plat.getDevices(CL_DEVICE_TYPE_ALL, &platform_devices);
+    if (platform_devices.size() == 0) {
         throw std::runtime_error("No devices found. Check OpenCL installation!");
     }
 
-    cl::Device dev = cl::Device::setDefault(devices[default_device_idx]);
+    std::vector<cl::Device> devices;
+    for (auto index : s_devices) {
+        if (static_cast<size_t>(index) >= platform_devices.size()) {
+            throw std::invalid_argument("OpenCL device " + std::to_string(index) + " not found. The platform has " +
+                                        std::to_string(platform_devices.size()) + " devices.");
+        }
+
+        devices.push_back(platform_devices[index]);
+    }
+
+    cl::Device dev = cl::Device::setDefault(devices.front());
 
-    if (dev != devices[default_device_idx]) {
+    if (dev != devices.front()) {
         throw std::runtime_error("Error setting default device.");
     }
 
-    cl::Context context(dev);
+    cl::Context context(devices);
+    auto program = build_program(context, devices);
+
+#ifndef _WIN32
+    static std::once_flag fork_handlers;
+    std::call_once(fork_handlers, [] {
+        pthread_atfork([] { s_devices_mutex.lock(); }, [] { s_devices_mutex.unlock(); }, after_fork_child);
+    });
+#endif
+
+    std::vector<std::unique_ptr<OpenCLConfig>> configs;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        configs.push_back(
+            std::unique_ptr<OpenCLConfig>(new OpenCLConfig(context, program, devices[i], static_cast<int>(i))));
+    }
+
+    s_initialized = true;
+    return configs;
+}
+
+namespace {
+
+// FNV-1a hash. Unlike std::hash, it does not change between processes or compilers.
+uint64_t stable_hash(const std::string& s) {
+    uint64_t hash = 14695981039346656037ull;
+    for (auto c : s) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// The default cache is private to the user, so other users can not write the binaries that are run on the devices.
+std::string default_program_cache_dir() {
+    if (auto dir = std::getenv("PYBNESIAN_OPENCL_CACHE_DIR")) return dir;
+
+#ifdef _WIN32
+    if (auto dir = std::getenv("LOCALAPPDATA"); dir && *dir) return (fs::path(dir) / "pybnesian").string();
+#else
+    if (auto dir = std::getenv("XDG_CACHE_HOME"); dir && *dir) return (fs::path(dir) / "pybnesian").string();
+    if (auto dir = std::getenv("HOME"); dir && *dir) return (fs::path(dir) / ".cache" / "pybnesian").string();
+#endif
+
+    return "";
+}
+
+// Creates dir (and its missing parents) with mode 0700. Returns false if dir is not a directory, it belongs to another
+// user or other users can write to it.
+bool prepare_cache_dir(const std::string& dir) {
+#ifdef _WIN32
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    return fs::is_directory(dir, ec);
+#else
+    fs::path current;
+    for (const auto& part : fs::path(dir)) {
+        current /= part;
+        if (mkdir(current.c_str(), 0700) != 0 && errno != EEXIST) return false;
+    }
+
+    struct stat st;
+    return stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == geteuid() &&
+           (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#endif
+}
+
+// The cached binary (and the tuned local sizes) are only valid for the same program source, device and driver.
+std::string device_cache_file(const std::string& dir, const cl::Device& device, const char* extension) {
+    cl::Platform platform(device.getInfo<CL_DEVICE_PLATFORM>());
+
+    std::string key = opencl::OPENCL_CODE;
+    for (const auto& info : {platform.getInfo<CL_PLATFORM_NAME>(),
+                             platform.getInfo<CL_PLATFORM_VERSION>(),
+                             device.getInfo<CL_DEVICE_NAME>(),
+                             device.getInfo<CL_DEVICE_VERSION>(),
+                             device.getInfo<CL_DRIVER_VERSION>()}) {
+        key += '\0';
+        key += info;
+    }
+
+    std::stringstream file;
+    file << "pybnesian-opencl-" << std::hex << std::setw(16) << std::setfill('0') << stable_hash(key) << extension;
+    return (fs::path(dir) / file.str()).string();
+}
+
+// Returns the content of a cached file, or an empty vector if it does not exist or it can not be trusted: it is not a
+// regular file owned by the current user with mode 0600.
+std::vector<unsigned char> read_binary_file(const std::string& file) {
+#ifdef _WIN32
+    std::ifstream f(file, std::ios::binary);
+    if (!f) return {};
 
-    cl::CommandQueue queue(context, dev);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+#else
+    int fd = open(file.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return {};
+
+    std::vector<unsigned char> content;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == geteuid() && (st.st_mode & 07777) == 0600) {
+        content.resize(st.st_size);
+        size_t offset = 0;
+        while (offset < content.size()) {
+            auto n = read(fd, content.data() + offset, content.size() - offset);
+            if (n <= 0) break;
+            offset += n;
+        }
+
+        content.resize(offset);
+    }
+
+    close(fd);
+    return content;
+#endif
+}
+
+// The binary is written to a temporary file with mode 0600 and renamed, so other processes never read a partial
+// binary. The cache is optional, so the errors are ignored.
+void write_binary_file(const std::string& file, const std::vector<unsigned char>& binary) {
+    auto tmp_file = file + "." + std::to_string(std::random_device{}()) + ".tmp";
+
+#ifdef _WIN32
+    {
+        std::ofstream f(tmp_file, std::ios::binary);
+        if (!f) return;
+        f.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+        if (!f) {
+            f.close();
+            std::remove(tmp_file.c_str());
+            return;
+        }
+    }
+#else
+    int fd = open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+
+    // The umask can only remove permissions, but the cached files must have exactly mode 0600.
+    bool ok = fchmod(fd, 0600) == 0;
+    size_t offset = 0;
+    while (ok && offset < binary.size()) {
+        auto n = write(fd, binary.data() + offset, binary.size() - offset);
+        if (n <= 0) {
+            ok = false;
+        } else {
+            offset += n;
+        }
+    }
+
+    if (close(fd) != 0 || !ok) {
+        std::remove(tmp_file.c_str());
+        return;
+    }
+#endif
+
+    if (std::rename(tmp_file.c_str(), file.c_str()) != 0) std::remove(tmp_file.c_str());
+}
+
+// Returns the program built from a binary for each device, or std::nullopt if some binary is missing or invalid (e.g.,
+// corrupted).
+std::optional<cl::Program> program_from_binaries(const cl::Context& context,
+                                                 const std::vector<cl::Device>& devices,
+                                                 const cl::Program::Binaries& binaries) {
+    if (binaries.size() != devices.size() ||
+        std::any_of(binaries.begin(), binaries.end(), [](const auto& b) { return b.empty(); }))
+        return std::nullopt;
+
+    std::vector<cl_int> binary_status;
+    cl_int err_code = CL_SUCCESS;
+    cl::Program program(context, devices, binaries, &binary_status, &err_code);
+
+    if (err_code == CL_SUCCESS && program.build(devices) == CL_SUCCESS) return program;
+    return std::nullopt;
+}
+
+}  // namespace
+
+std::string OpenCLConfig::program_cache_dir() {
+    auto cache_dir = s_program_cache_dir ? *s_program_cache_dir : default_program_cache_dir();
+    if (cache_dir.empty() || !prepare_cache_dir(cache_dir)) return "";
+    return cache_dir;
+}
+
+cl::Program OpenCLConfig::build_program(const cl::Context& context, const std::vector<cl::Device>& devices) {
+    // The pool of a child process (see after_fork_child()) is built from the binaries of the parent.
+    if (auto program = program_from_binaries(context, devices, s_program_binaries)) return *program;
+
+    auto cache_dir = program_cache_dir();
+
+    if (!cache_dir.empty()) {
+        cl::Program::Binaries binaries;
+        for (const auto& device : devices) {
+            binaries.push_back(read_binary_file(device_cache_file(cache_dir, device, ".bin")));
+            if (binaries.back().empty()) break;
+        }
+
+        // An invalid binary is replaced by compiling the source.
+        if (auto program = program_from_binaries(context, devices, binaries)) {
+            s_program_binaries = std::move(binaries);
+            return *program;
+        }
+    }
 
     // Read the program source
     cl::Program::Sources source({opencl::OPENCL_CODE});
@@ -192,7 +420,28 @@ OpenCLConfig::OpenCLConfig() {
                                  std::to_string(err_code) + ").");
     }
 
-    err_code = CL_SUCCESS;
+    cl_int devices_err = CL_SUCCESS;
+    auto program_devices = program.getInfo<CL_PROGRAM_DEVICES>(&devices_err);
+    cl_int binaries_err = CL_SUCCESS;
+    auto binaries = program.getInfo<CL_PROGRAM_BINARIES>(&binaries_err);
+
+    if (devices_err == CL_SUCCESS && binaries_err == CL_SUCCESS && program_devices.size() == binaries.size()) {
+        if (!cache_dir.empty()) {
+            for (size_t i = 0; i < binaries.size(); ++i) {
+                if (!binaries[i].empty()) {
+                    write_binary_file(device_cache_file(cache_dir, program_devices[i], ".bin"), binaries[i]);
+                }
+            }
+        }
+
+        if (program_devices == devices) s_program_binaries = std::move(binaries);
+    }
+
+    return program;
+}
+
+OpenCLConfig::OpenCLConfig(const cl::Context& context, const cl::Program& program, const cl::Device& dev, int index) {
+    cl_int err_code = CL_SUCCESS;
     auto max_local_size = dev.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>(&err_code);
     if (err_code != CL_SUCCESS) {
         throw std::runtime_error(std::string("Maximum work group size could not be determined. ") +
@@ -206,23 +455,237 @@ OpenCLConfig::OpenCLConfig() {
                                  opencl_error(err_code) + " (" + std::to_string(err_code) + ").");
     }
 
+    err_code = CL_SUCCESS;
+    auto global_memory_bytes = dev.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>(&err_code);
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Global memory size could not be determined. ") +
+                                 opencl_error(err_code) + " (" + std::to_string(err_code) + ").");
+    }
+
+    err_code = CL_SUCCESS;
+    auto max_buffer_memory_bytes = dev.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>(&err_code);
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Maximum buffer size could not be determined. ") +
+                                 opencl_error(err_code) + " (" + std::to_string(err_code) + ").");
+    }
+
+    m_index = index;
     m_context = context;
-    m_queue = queue;
     m_program = program;
     m_device = dev;
     m_max_local_size = max_local_size;
     m_max_local_memory_bytes = max_local_size_bytes;
+    m_global_memory_bytes = global_memory_bytes;
+    m_max_buffer_memory_bytes = max_buffer_memory_bytes;
+    m_last_temp_mat_cols = 0;
+    m_pool_hits = 0;
+    m_pool_misses = 0;
+    m_pool_cached_buffers = 0;
+    m_pool_cached_bytes = 0;
+    // The free buffers can not use more than a quarter of the device memory.
+    m_pool_max_bytes = static_cast<size_t>(global_memory_bytes / 4);
+
+    // The pool is created while holding s_devices_mutex.
+    auto cache_dir = program_cache_dir();
+    if (!cache_dir.empty()) m_tuning_file = device_cache_file(cache_dir, dev, ".tune");
+    load_tuning();
+}
+
+std::vector<std::unique_ptr<OpenCLConfig>>& OpenCLConfig::pool() {
+    static std::vector<std::unique_ptr<OpenCLConfig>> configs = create_pool();
+
+    if (s_forked) {
+        std::lock_guard<std::mutex> l(s_fork_mutex);
+        if (s_forked) {
+            // The inherited OpenCL objects can not be released in the child, so the configs are leaked.
+            for (auto& config : configs) {
+                static_cast<void>(config.release());
+            }
+            configs.clear();
+            configs = create_pool();
+            s_forked = false;
+        }
+    }
+
+    return configs;
+}
+
+void OpenCLConfig::after_fork_child() {
+    s_devices_mutex.unlock();
+    // The thread that called fork() is the only thread of the child, and its resources belong to the inherited context.
+    for (auto& resources : s_thread_resources) {
+        static_cast<void>(resources.release());
+    }
+    s_thread_resources.clear();
+    s_forked = true;
 }
 
 OpenCLConfig& OpenCLConfig::get() {
-    static OpenCLConfig singleton;
-    return singleton;
+    auto& configs = pool();
+    return *configs[(s_current_device >= 0) ? s_current_device : 0];
+}
+
+OpenCLConfig& OpenCLConfig::get(int device) {
+    auto& configs = pool();
+    if (device < 0 || static_cast<size_t>(device) >= configs.size()) {
+        throw std::invalid_argument("Not valid OpenCL device " + std::to_string(device) + ". The device pool has " +
+                                    std::to_string(configs.size()) + " devices.");
+    }
+
+    return *configs[device];
+}
+
+void OpenCLConfig::set_devices(const std::vector<int>& devices) {
+    if (devices.empty()) {
+        throw std::invalid_argument("The OpenCL device pool must contain at least one device.");
+    }
+
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (devices[i] < 0) {
+            throw std::invalid_argument("Not valid OpenCL device index " + std::to_string(devices[i]) + ".");
+        }
+
+        if (std::find(devices.begin(), devices.begin() + i, devices[i]) != devices.begin() + i) {
+            throw std::invalid_argument("OpenCL device " + std::to_string(devices[i]) + " is repeated.");
+        }
+    }
+
+    std::lock_guard<std::mutex> l(s_devices_mutex);
+    if (s_initialized) {
+        throw std::runtime_error("The OpenCL devices can not be changed after OpenCL is initialized.");
+    }
+
+    s_devices = devices;
+    s_gpu_available = -1;
+}
+
+void OpenCLConfig::set_program_cache_dir(const std::string& dir) {
+    std::lock_guard<std::mutex> l(s_devices_mutex);
+    if (s_initialized) {
+        throw std::runtime_error("The OpenCL program cache can not be changed after OpenCL is initialized.");
+    }
+
+    s_program_cache_dir = dir;
+}
+
+int OpenCLConfig::select_device() {
+    if (s_current_device >= 0) return s_current_device;
+
+    auto n = num_devices();
+    if (n == 1) return 0;
+
+    return static_cast<int>(s_next_device++ % static_cast<unsigned int>(n));
+}
+
+bool OpenCLConfig::gpu_available() {
+    std::lock_guard<std::mutex> l(s_devices_mutex);
+
+    if (s_gpu_available == -1) {
+        s_gpu_available = [first_device = s_devices.front()]() {
+            std::vector<cl::Platform> platforms;
+            if (cl::Platform::get(&platforms) != CL_SUCCESS || platforms.empty()) return false;
+
+            std::vector<cl::Device> devices;
+            if (platforms[default_platform_idx].getDevices(CL_DEVICE_TYPE_ALL, &devices) != CL_SUCCESS ||
+                devices.size() <= static_cast<size_t>(first_device))
+                return false;
+
+            cl_int err_code = CL_SUCCESS;
+            auto type = devices[first_device].getInfo<CL_DEVICE_TYPE>(&err_code);
+            return err_code == CL_SUCCESS && (type & CL_DEVICE_TYPE_GPU) != 0;
+        }();
+    }
+
+    return s_gpu_available == 1;
+}
+
+OpenCLLock::OpenCLLock(int device)
+    : m_device(device), m_previous_device(OpenCLConfig::s_current_device), m_active(true) {
+    OpenCLConfig::s_current_device = device;
+}
+
+OpenCLLock::~OpenCLLock() {
+    if (!m_active) return;
+
+    OpenCLConfig::s_current_device = m_previous_device;
+
+    if (m_previous_device != m_device) {
+        // The thread could have not used the device (e.g., a model with the CPU backend).
+        if (auto resources = OpenCLConfig::get(m_device).existing_thread_resources()) {
+            resources->queue.finish();
+            resources->transfer_queue.finish();
+            resources->queue.collect();
+            resources->transfer_queue.collect();
+        }
+    }
+}
+
+OpenCLConfig::ThreadResources& OpenCLConfig::thread_resources() {
+    auto index = static_cast<size_t>(m_index);
+    if (s_thread_resources.size() <= index) s_thread_resources.resize(index + 1);
+
+    auto& resources = s_thread_resources[index];
+    bool profiling = s_profiling;
+    if (!resources || resources->queue.profiling() != profiling) {
+        cl_int err_code = CL_SUCCESS;
+        ProfiledQueue queue(m_context, m_device, profiling, &err_code);
+        cl_int transfer_err_code = CL_SUCCESS;
+        ProfiledQueue transfer_queue(m_context, m_device, profiling, &transfer_err_code);
+        if (err_code == CL_SUCCESS) err_code = transfer_err_code;
+
+        if (err_code != CL_SUCCESS) {
+            throw std::runtime_error(std::string("Error creating OpenCL command queue. ") + opencl_error(err_code) +
+                                     " (" + std::to_string(err_code) + ").");
+        }
+
+        if (resources) {
+            // The profiling mode changed. The kernels are kept, and the commands of the old queues are finished.
+            resources->queue.finish();
+            resources->transfer_queue.finish();
+            resources->queue.collect();
+            resources->transfer_queue.collect();
+        } else {
+            resources = std::make_unique<ThreadResources>();
+        }
+
+        resources->queue = std::move(queue);
+        resources->transfer_queue = std::move(transfer_queue);
+    }
+
+    return *resources;
+}
+
+void ProfiledQueue::collect() {
+    if (m_commands.empty()) return;
+
+    // The counters are added at once, so the profiler is locked once.
+    std::unordered_map<std::string, util::ProfileCounter> counters;
+    for (auto& command : m_commands) {
+        cl_ulong start = 0;
+        cl_ulong end = 0;
+        if (command.event.wait() != CL_SUCCESS ||
+            command.event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start) != CL_SUCCESS ||
+            command.event.getProfilingInfo(CL_PROFILING_COMMAND_END, &end) != CL_SUCCESS)
+            continue;
+
+        auto& counter = counters[command.name];
+        ++counter.calls;
+        counter.seconds += static_cast<double>(end - start) * 1e-9;
+        counter.bytes += static_cast<std::int64_t>(command.bytes);
+    }
+
+    m_commands.clear();
+
+    for (const auto& [name, counter] : counters) {
+        util::Profiler::add("opencl_device:" + name, counter.calls, counter.seconds, counter.bytes);
+    }
 }
 
 cl::Kernel& OpenCLConfig::kernel(const char* name) {
-    auto it = m_kernels.find(name);
+    auto& kernels = thread_resources().kernels;
+    auto it = kernels.find(name);
 
-    if (it != m_kernels.end()) {
+    if (it != kernels.end()) {
         return it->second;
     } else {
         cl_int err_code = CL_SUCCESS;
@@ -232,12 +695,12 @@ cl::Kernel& OpenCLConfig::kernel(const char* name) {
                                      ") creating OpenCL kernel " + name);
         }
 
-        m_kernels.insert({name, std::move(k)});
-        return m_kernels.find(name)->second;
+        return kernels.emplace(name, std::move(k)).first->second;
     }
 }
 
 size_t OpenCLConfig::kernel_local_size(const char* kernel_name) {
+    std::lock_guard<std::mutex> l(m_kernels_mutex);
     auto it = m_kernels_local_size.find(kernel_name);
 
     if (it != m_kernels_local_size.end()) {
@@ -257,6 +720,7 @@ size_t OpenCLConfig::kernel_local_size(const char* kernel_name) {
 }
 
 cl_ulong OpenCLConfig::kernel_local_memory(const char* kernel_name) {
+    std::lock_guard<std::mutex> l(m_kernels_mutex);
     auto it = m_kernels_local_memory.find(kernel_name);
 
     if (it != m_kernels_local_memory.end()) {
@@ -275,6 +739,287 @@ cl_ulong OpenCLConfig::kernel_local_memory(const char* kernel_name) {
     }
 }
 
+OpenCLConfig::KernelTuning& OpenCLConfig::kernel_tuning(const char* kernel_name) {
+    auto it = m_tuning.find(kernel_name);
+    if (it != m_tuning.end()) return it->second;
+
+    KernelTuning tuning;
+    tuning.candidates.push_back(0);
+    auto max_local_size = std::min(kernel_local_size(kernel_name), m_max_local_size);
+    for (auto local_size = min_tuning_local_size; local_size <= max_local_size; local_size *= 2) {
+        tuning.candidates.push_back(local_size);
+    }
+
+    tuning.times.resize(tuning.candidates.size(), std::numeric_limits<double>::infinity());
+    tuning.samples.resize(tuning.candidates.size(), 0);
+    return m_tuning.emplace(kernel_name, std::move(tuning)).first->second;
+}
+
+void OpenCLConfig::finish_tuning(KernelTuning& tuning) {
+    auto best = std::min_element(tuning.times.begin(), tuning.times.end());
+    tuning.best = tuning.candidates[best - tuning.times.begin()];
+    tuning.tuned = true;
+    save_tuning();
+}
+
+// The tuned local sizes are saved as lines of "<kernel name> <local size>".
+void OpenCLConfig::load_tuning() {
+    if (m_tuning_file.empty()) return;
+
+    // The tuning file is checked like the cached binaries (see read_binary_file()).
+    auto content = read_binary_file(m_tuning_file);
+    std::stringstream f(std::string(content.begin(), content.end()));
+    std::string kernel_name;
+    size_t local_size;
+    while (f >> kernel_name >> local_size) {
+        if (local_size > m_max_local_size) continue;
+
+        KernelTuning tuning;
+        tuning.tuned = true;
+        tuning.best = local_size;
+        m_tuning[kernel_name] = std::move(tuning);
+    }
+}
+
+void OpenCLConfig::save_tuning() {
+    if (m_tuning_file.empty()) return;
+
+    std::stringstream ss;
+    for (const auto& [kernel_name, tuning] : m_tuning) {
+        if (tuning.tuned) ss << kernel_name << " " << tuning.best << "\n";
+    }
+
+    auto content = ss.str();
+    write_binary_file(m_tuning_file, std::vector<unsigned char>(content.begin(), content.end()));
+}
+
+cl_int OpenCLConfig::enqueue_tuned_kernel(const char* kernel_name, size_t global_size) {
+    auto& k = kernel(kernel_name);
+    auto& q = queue();
+
+    size_t local_size = 0;
+    int candidate = -1;
+    {
+        std::lock_guard<std::mutex> l(m_tuning_mutex);
+        auto& tuning = kernel_tuning(kernel_name);
+
+        if (tuning.tuned) {
+            local_size = tuning.best;
+        } else if (s_autotuning && global_size >= min_tuning_work_items) {
+            for (size_t i = 0; i < tuning.candidates.size(); ++i) {
+                auto c = tuning.candidates[i];
+                if (tuning.samples[i] < tuning_samples && (c == 0 || global_size % c == 0)) {
+                    candidate = static_cast<int>(i);
+                    local_size = c;
+                    // Other threads time the next samples.
+                    ++tuning.samples[i];
+                    ++tuning.launches;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (local_size > 0 && global_size % local_size != 0) local_size = 0;
+    auto local_range = (local_size > 0) ? cl::NDRange(local_size) : cl::NullRange;
+
+    if (candidate == -1) return q.enqueueNDRangeKernel(k, cl::NullRange, cl::NDRange(global_size), local_range);
+
+    // Only the kernel is timed.
+    auto err_code = q.finish();
+    if (err_code != CL_SUCCESS) return err_code;
+
+    auto start = std::chrono::steady_clock::now();
+    err_code = q.enqueueNDRangeKernel(k, cl::NullRange, cl::NDRange(global_size), local_range);
+    if (err_code == CL_SUCCESS) err_code = q.finish();
+    if (err_code != CL_SUCCESS) return err_code;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard<std::mutex> l(m_tuning_mutex);
+    auto& tuning = m_tuning.at(kernel_name);
+    if (tuning.tuned) return CL_SUCCESS;
+
+    tuning.times[candidate] = std::min(tuning.times[candidate], elapsed.count() / static_cast<double>(global_size));
+
+    bool timed = std::all_of(tuning.samples.begin(), tuning.samples.end(), [](int s) { return s >= tuning_samples; });
+    if (timed || tuning.launches >= max_tuning_launches) finish_tuning(tuning);
+
+    return CL_SUCCESS;
+}
+
+std::unordered_map<std::string, size_t> OpenCLConfig::tuned_local_sizes() {
+    std::lock_guard<std::mutex> l(m_tuning_mutex);
+
+    std::unordered_map<std::string, size_t> res;
+    for (const auto& [kernel_name, tuning] : m_tuning) {
+        if (tuning.tuned) res.emplace(kernel_name, tuning.best);
+    }
+
+    return res;
+}
+
+size_t OpenCLConfig::temp_mat_cols(size_t rows, size_t cols, size_t extra_rows, size_t element_bytes) {
+    size_t max_cols = s_temp_mat_max_cols;
+
+    if (max_cols == 0) {
+        auto col_bytes = std::max((rows + extra_rows) * element_bytes, static_cast<size_t>(1));
+        max_cols = static_cast<size_t>(m_global_memory_bytes / 8) / col_bytes;
+
+        // The matrix must fit in a buffer, and the kernels index it with 32-bit integers.
+        auto max_elements = std::min(static_cast<size_t>(m_max_buffer_memory_bytes) / element_bytes,
+                                     static_cast<size_t>(std::numeric_limits<int>::max()));
+        max_cols = std::min(max_cols, max_elements / std::max(rows, static_cast<size_t>(1)));
+    }
+
+    auto allocated_cols = std::max(std::min(cols, max_cols), static_cast<size_t>(1));
+    m_last_temp_mat_cols = allocated_cols;
+    return allocated_cols;
+}
+
+// The pooled buffers are rounded up to one of 4 sizes between consecutive powers of 2. Thus, a buffer is reused for
+// requests slightly smaller than it, and no more than 25% of its memory is wasted.
+size_t buffer_pool_bytes(size_t bytes) {
+    constexpr size_t min_bytes = 256;
+    if (bytes <= min_bytes) return min_bytes;
+
+    size_t power2 = min_bytes;
+    while (2 * power2 < bytes) power2 *= 2;
+
+    auto step = power2 / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+PooledBuffer OpenCLConfig::pooled_buffer(size_t bytes) {
+    auto pool_bytes = buffer_pool_bytes(bytes);
+
+    std::optional<FreeBuffer> free_buffer;
+    {
+        std::lock_guard<std::mutex> l(m_pool_mutex);
+        auto it = m_buffer_pool.find(pool_bytes);
+        if (it != m_buffer_pool.end() && !it->second.empty()) {
+            free_buffer = std::move(it->second.back());
+            it->second.pop_back();
+            ++m_pool_hits;
+            --m_pool_cached_buffers;
+            m_pool_cached_bytes -= pool_bytes;
+        } else {
+            ++m_pool_misses;
+        }
+    }
+
+    if (free_buffer) {
+        auto& q = queue();
+        if (free_buffer->queue() != nullptr && free_buffer->queue() != q()) {
+            // The kernels of the previous owner, enqueued in the queue of other thread, could still use the buffer.
+            cl::Event released;
+            raise_transfer_error(free_buffer->queue.enqueueMarkerWithWaitList(nullptr, &released));
+            raise_transfer_error(free_buffer->queue.flush());
+            std::vector<cl::Event> wait{released};
+            raise_transfer_error(q.enqueueBarrierWithWaitList(&wait));
+        }
+
+        return PooledBuffer(std::move(free_buffer->buffer), pool_bytes, this);
+    }
+
+    cl_int err_code = CL_SUCCESS;
+    cl::Buffer b(m_context, CL_MEM_READ_WRITE, pool_bytes, NULL, &err_code);
+
+    if (err_code == CL_MEM_OBJECT_ALLOCATION_FAILURE || err_code == CL_OUT_OF_RESOURCES) {
+        // The free buffers of the pool could be using the device memory.
+        clear_buffer_pool();
+        err_code = CL_SUCCESS;
+        b = cl::Buffer(m_context, CL_MEM_READ_WRITE, pool_bytes, NULL, &err_code);
+    }
+
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Error creating OpenCL buffer of ") + std::to_string(pool_bytes) +
+                                 " bytes. " + opencl_error(err_code) + " (" + std::to_string(err_code) + ").");
+    }
+
+    return PooledBuffer(std::move(b), pool_bytes, this);
+}
+
+void OpenCLConfig::release_pooled_buffer(cl::Buffer&& buffer, size_t bytes) {
+    std::lock_guard<std::mutex> l(m_pool_mutex);
+    // If the pool is full, the buffer is not moved, so it is freed by its owner.
+    if (m_pool_cached_bytes + bytes > m_pool_max_bytes) return;
+
+    auto resources = existing_thread_resources();
+    m_buffer_pool[bytes].push_back(FreeBuffer{std::move(buffer), resources ? resources->queue : cl::CommandQueue()});
+    ++m_pool_cached_buffers;
+    m_pool_cached_bytes += bytes;
+}
+
+void OpenCLConfig::remove_expired_shared_columns() {
+    for (auto it = m_shared_columns.begin(); it != m_shared_columns.end();) {
+        if (it->second.source.expired() || it->second.buffer.expired())
+            it = m_shared_columns.erase(it);
+        else
+            ++it;
+    }
+}
+
+BufferPoolStatistics OpenCLConfig::buffer_pool_statistics() {
+    std::lock_guard<std::mutex> l(m_pool_mutex);
+    return BufferPoolStatistics{m_pool_hits, m_pool_misses, m_pool_cached_buffers, m_pool_cached_bytes};
+}
+
+void OpenCLConfig::clear_buffer_pool() {
+    std::lock_guard<std::mutex> l(m_pool_mutex);
+    m_buffer_pool.clear();
+    m_pool_cached_buffers = 0;
+    m_pool_cached_bytes = 0;
+}
+
+void OpenCLConfig::set_buffer_pool_max_bytes(size_t bytes) {
+    std::lock_guard<std::mutex> l(m_pool_mutex);
+    m_pool_max_bytes = bytes;
+
+    for (auto it = m_buffer_pool.begin(); it != m_buffer_pool.end() && m_pool_cached_bytes > m_pool_max_bytes;) {
+        auto& buffers = it->second;
+        while (!buffers.empty() && m_pool_cached_bytes > m_pool_max_bytes) {
+            buffers.pop_back();
+            --m_pool_cached_buffers;
+            m_pool_cached_bytes -= it->first;
+        }
+
+        if (buffers.empty())
+            it = m_buffer_pool.erase(it);
+        else
+            ++it;
+    }
+}
+
+util::MemoryUsage OpenCLConfig::memory_usage() {
+    util::MemoryUsage usage;
+    {
+        std::lock_guard<std::mutex> l(m_pool_mutex);
+        usage.add("buffer_pool", 0, m_pool_cached_bytes);
+    }
+
+    std::lock_guard<std::mutex> l(m_shared_columns_mutex);
+    size_t shared_bytes = 0;
+    for (const auto& column : m_shared_columns) {
+        if (auto buffer = column.second.buffer.lock()) shared_bytes += buffer_bytes(*buffer);
+    }
+    usage.add("shared_columns", 0, shared_bytes);
+
+    return usage;
+}
+
+void PooledBuffer::release() {
+    if ((*this)() != nullptr && m_pool != nullptr) {
+        m_pool->release_pooled_buffer(std::move(*this), m_bytes);
+    }
+}
+
+void raise_transfer_error(cl_int err_code) {
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Error in the pipelined OpenCL transfers. ") + opencl_error(err_code) +
+                                 " (" + std::to_string(err_code) + ").");
+    }
+}
+
 void update_reduction_status(int& length, int& num_groups, int& local_size, int& global_size, int max_local_size) {
     length = num_groups;
     local_size = std::min(length, max_local_size);
@@ -1,12 +1,25 @@
 #ifndef PYBNESIAN_OPENCL_OPENCL_CONFIG_HPP
 #define PYBNESIAN_OPENCL_OPENCL_CONFIG_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <arrow/api.h>
 #define CL_HPP_MINIMUM_OPENCL_VERSION 120
 #define CL_HPP_TARGET_OPENCL_VERSION  120
 #include <CL/cl2.hpp>
 #include <util/bit_util.hpp>
+#include <util/memory_usage.hpp>
+#include <util/profiler.hpp>
 
 // #define CL_HPP_ENABLE_EXCEPTIONS
 // #ifdef CL_HPP_MINIMUM_OPENCL_VERSION
@@ -18,6 +31,7 @@
 
 #define RAISE_ENQUEUEKERNEL_ERROR(enqueue)                                                                             \
     {                                                                                                                  \
+        util::profile_count([] { return std::string("opencl:kernel_launch"); });                                       \
         cl_int err_code = CL_SUCCESS;                                                                                  \
         err_code = enqueue;                                                                                            \
         if (err_code != CL_SUCCESS) {                                                                                  \
@@ -43,10 +57,13 @@ struct OpenCL_kernel_traits<arrow::DoubleType> {
     inline constexpr static const char* solve = "solve_double";
     inline constexpr static const char* square = "square_double";
     inline constexpr static const char* logl_values_1d_mat = "logl_values_1d_mat_double";
-    inline constexpr static const char* add_logl_values_1d_mat = "add_logl_values_1d_mat_double";
+    inline constexpr static const char* logl_values_product_mat = "logl_values_product_mat_double";
     inline constexpr static const char* substract = "substract_double";
     inline constexpr static const char* logl_values_mat_column = "logl_values_mat_column_double";
     inline constexpr static const char* logl_values_mat_row = "logl_values_mat_row_double";
+    inline constexpr static const char* conditional_logl_mat_column = "conditional_logl_mat_column_double";
+    inline constexpr static const char* conditional_logl_mat_row = "conditional_logl_mat_row_double";
+    inline constexpr static const char* conditional_logl_grid = "conditional_logl_grid_double";
     inline constexpr static const char* finish_lse_offset = "finish_lse_offset_double";
     inline constexpr static const char* substract_vectors = "substract_vectors_double";
     inline constexpr static const char* exp_elementwise = "exp_elementwise_double";
@@ -57,6 +74,9 @@ struct OpenCL_kernel_traits<arrow::DoubleType> {
     inline constexpr static const char* conditional_means_1d = "conditional_means_1d_double";
     inline constexpr static const char* conditional_means_column = "conditional_means_column_double";
     inline constexpr static const char* conditional_means_row = "conditional_means_row_double";
+    inline constexpr static const char* random_uniform = "random_uniform_double";
+    inline constexpr static const char* sample_kde_1d = "sample_kde_1d_double";
+    inline constexpr static const char* sample_ckde = "sample_ckde_double";
     inline constexpr static const char* univariate_normal_cdf = "univariate_normal_cdf_double";
     inline constexpr static const char* normal_cdf = "normal_cdf_double";
     inline constexpr static const char* product_elementwise = "product_elementwise_double";
@@ -67,6 +87,18 @@ struct OpenCL_kernel_traits<arrow::DoubleType> {
     inline constexpr static const char* ucv_diag = "ucv_diag_double";
     inline constexpr static const char* sum_ucv_diag = "sum_ucv_diag_double";
     inline constexpr static const char* copy_ucv_diag = "copy_ucv_diag_double";
+    inline constexpr static const char* sum_ucv_batch = "sum_ucv_batch_double";
+    inline constexpr static const char* logl_lse = "logl_lse_double";
+    inline constexpr static const char* logl_lse_weighted = "logl_lse_weighted_double";
+    inline constexpr static const char* finish_logl_lse = "finish_logl_lse_double";
+    inline constexpr static const char* rcot_fourier_features = "rcot_fourier_features_double";
+    inline constexpr static const char* rcot_product_sums = "rcot_product_sums_double";
+    inline constexpr static const char* rcot_product_crossproducts = "rcot_product_crossproducts_double";
+    inline constexpr static const char* linear_correlation_batch = "linear_correlation_batch_double";
+    inline constexpr static const char* linear_gaussian_logl = "linear_gaussian_logl_double";
+    inline constexpr static const char* kmi_knn_distance = "kmi_knn_distance_double";
+    inline constexpr static const char* kmi_count_subspaces = "kmi_count_subspaces_double";
+    inline constexpr static const char* convert_to_float = "convert_double_to_float";
 };
 
 template <>
@@ -79,10 +111,13 @@ struct OpenCL_kernel_traits<arrow::FloatType> {
     inline constexpr static const char* solve = "solve_float";
     inline constexpr static const char* square = "square_float";
     inline constexpr static const char* logl_values_1d_mat = "logl_values_1d_mat_float";
-    inline constexpr static const char* add_logl_values_1d_mat = "add_logl_values_1d_mat_float";
+    inline constexpr static const char* logl_values_product_mat = "logl_values_product_mat_float";
     inline constexpr static const char* substract = "substract_float";
     inline constexpr static const char* logl_values_mat_column = "logl_values_mat_column_float";
     inline constexpr static const char* logl_values_mat_row = "logl_values_mat_row_float";
+    inline constexpr static const char* conditional_logl_mat_column = "conditional_logl_mat_column_float";
+    inline constexpr static const char* conditional_logl_mat_row = "conditional_logl_mat_row_float";
+    inline constexpr static const char* conditional_logl_grid = "conditional_logl_grid_float";
     inline constexpr static const char* finish_lse_offset = "finish_lse_offset_float";
     inline constexpr static const char* substract_vectors = "substract_vectors_float";
     inline constexpr static const char* exp_elementwise = "exp_elementwise_float";
@@ -93,6 +128,9 @@ struct OpenCL_kernel_traits<arrow::FloatType> {
     inline constexpr static const char* conditional_means_1d = "conditional_means_1d_float";
     inline constexpr static const char* conditional_means_column = "conditional_means_column_float";
     inline constexpr static const char* conditional_means_row = "conditional_means_row_float";
+    inline constexpr static const char* random_uniform = "random_uniform_float";
+    inline constexpr static const char* sample_kde_1d = "sample_kde_1d_float";
+    inline constexpr static const char* sample_ckde = "sample_ckde_float";
     inline constexpr static const char* univariate_normal_cdf = "univariate_normal_cdf_float";
     inline constexpr static const char* normal_cdf = "normal_cdf_float";
     inline constexpr static const char* product_elementwise = "product_elementwise_float";
@@ -103,6 +141,18 @@ struct OpenCL_kernel_traits<arrow::FloatType> {
     inline constexpr static const char* ucv_diag = "ucv_diag_float";
     inline constexpr static const char* sum_ucv_diag = "sum_ucv_diag_float";
     inline constexpr static const char* copy_ucv_diag = "copy_ucv_diag_float";
+    inline constexpr static const char* sum_ucv_batch = "sum_ucv_batch_float";
+    inline constexpr static const char* logl_lse = "logl_lse_float";
+    inline constexpr static const char* logl_lse_weighted = "logl_lse_weighted_float";
+    inline constexpr static const char* finish_logl_lse = "finish_logl_lse_float";
+    inline constexpr static const char* rcot_fourier_features = "rcot_fourier_features_float";
+    inline constexpr static const char* rcot_product_sums = "rcot_product_sums_float";
+    inline constexpr static const char* rcot_product_crossproducts = "rcot_product_crossproducts_float";
+    inline constexpr static const char* linear_correlation_batch = "linear_correlation_batch_float";
+    inline constexpr static const char* linear_gaussian_logl = "linear_gaussian_logl_float";
+    inline constexpr static const char* kmi_knn_distance = "kmi_knn_distance_float";
+    inline constexpr static const char* kmi_count_subspaces = "kmi_count_subspaces_float";
+    inline constexpr static const char* convert_to_double = "convert_float_to_double";
 };
 
 template <typename ArrowType>
@@ -119,10 +169,294 @@ struct SumReduction {
 
 inline constexpr int default_platform_idx = 0;
 inline constexpr int default_device_idx = 0;
+// Number of test instances uploaded at a time by OpenCLConfig::pipelined_rows().
+inline constexpr int default_pipeline_rows = 65536;
+// Number of pipeline chunks of each range of rows distributed by OpenCLConfig::multi_device_rows().
+inline constexpr int multi_device_chunks = 4;
+// Smallest local size tried by OpenCLConfig::enqueue_tuned_kernel(), and the minimum number of work items of a timed
+// launch.
+inline constexpr size_t min_tuning_local_size = 32;
+inline constexpr size_t min_tuning_work_items = 4096;
+// Number of timed launches of each candidate local size, and the maximum number of launches of a kernel that can be
+// timed before its local size is chosen.
+inline constexpr int tuning_samples = 2;
+inline constexpr int max_tuning_launches = 64;
+// Maximum number of commands recorded by a ProfiledQueue before they are collected.
+inline constexpr size_t max_profiled_commands = 4096;
+
+// Returns the size of the device memory of a buffer, or 0 if the buffer is not created.
+inline size_t buffer_bytes(const cl::Buffer& buffer) {
+    if (buffer() == nullptr) return 0;
+    return buffer.getInfo<CL_MEM_SIZE>();
+}
+
+class OpenCLConfig;
+
+// A temporary buffer taken from the buffer pool of an OpenCLConfig. The buffer is returned to the same pool when the
+// PooledBuffer is destroyed, so a later temporary of a similar size reuses it instead of allocating device memory. The
+// command queues are in-order, so the kernels of the next owner of the buffer are executed after the kernels enqueued
+// by the previous owner. If the owners are in different threads (with different queues), the next owner waits for the
+// queue of the previous one.
+//
+// A PooledBuffer can be used wherever a cl::Buffer is expected, but it can only be moved: a cl::Buffer copy would keep
+// referencing the buffer after it is returned to the pool.
+class PooledBuffer : public cl::Buffer {
+public:
+    PooledBuffer() = default;
+    PooledBuffer(cl::Buffer&& buffer, size_t bytes, OpenCLConfig* pool)
+        : cl::Buffer(std::move(buffer)), m_bytes(bytes), m_pool(pool) {}
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+    PooledBuffer(PooledBuffer&& other) noexcept
+        : cl::Buffer(std::move(other)), m_bytes(other.m_bytes), m_pool(other.m_pool) {}
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            cl::Buffer::operator=(std::move(other));
+            m_bytes = other.m_bytes;
+            m_pool = other.m_pool;
+        }
+        return *this;
+    }
+
+    ~PooledBuffer() { release(); }
+
+    // Size of the buffer in bytes. It can be larger than the requested size.
+    size_t bytes() const { return m_bytes; }
+
+private:
+    void release();
+
+    size_t m_bytes = 0;
+    OpenCLConfig* m_pool = nullptr;
+};
+
+// The command queue of a thread (see OpenCLConfig::queue()). If it is created in the profiling mode (see
+// OpenCLConfig::set_profiling()), the kernels and transfers enqueued in it are recorded, and collect() adds their
+// device times to the "opencl_device:*" counters of the profiler (util::Profiler). The commands are only recorded
+// while the profiler is enabled, and the other methods of cl::CommandQueue are not recorded.
+class ProfiledQueue : public cl::CommandQueue {
+public:
+    ProfiledQueue() = default;
+    ProfiledQueue(const cl::Context& context, const cl::Device& device, bool profiling, cl_int* err_code)
+        : cl::CommandQueue(context, device, profiling ? CL_QUEUE_PROFILING_ENABLE : 0, err_code),
+          m_profiling(profiling),
+          m_commands() {}
+
+    bool profiling() const { return m_profiling; }
+
+    cl_int enqueueNDRangeKernel(const cl::Kernel& kernel,
+                                const cl::NDRange& offset,
+                                const cl::NDRange& global,
+                                const cl::NDRange& local = cl::NullRange,
+                                const std::vector<cl::Event>* events = nullptr,
+                                cl::Event* event = nullptr) {
+        return profiled(
+            event,
+            [&](cl::Event* e) {
+                return cl::CommandQueue::enqueueNDRangeKernel(kernel, offset, global, local, events, e);
+            },
+            [&kernel]() { return "kernel:" + kernel.getInfo<CL_KERNEL_FUNCTION_NAME>(); },
+            0);
+    }
+
+    cl_int enqueueReadBuffer(const cl::Buffer& buffer,
+                             cl_bool blocking,
+                             size_t offset,
+                             size_t size,
+                             void* ptr,
+                             const std::vector<cl::Event>* events = nullptr,
+                             cl::Event* event = nullptr) {
+        return profiled(
+            event,
+            [&](cl::Event* e) {
+                return cl::CommandQueue::enqueueReadBuffer(buffer, blocking, offset, size, ptr, events, e);
+            },
+            []() { return std::string("read"); },
+            size);
+    }
+
+    cl_int enqueueWriteBuffer(const cl::Buffer& buffer,
+                              cl_bool blocking,
+                              size_t offset,
+                              size_t size,
+                              const void* ptr,
+                              const std::vector<cl::Event>* events = nullptr,
+                              cl::Event* event = nullptr) {
+        return profiled(
+            event,
+            [&](cl::Event* e) {
+                return cl::CommandQueue::enqueueWriteBuffer(buffer, blocking, offset, size, ptr, events, e);
+            },
+            []() { return std::string("write"); },
+            size);
+    }
+
+    cl_int enqueueWriteBufferRect(const cl::Buffer& buffer,
+                                  cl_bool blocking,
+                                  const cl::array<cl::size_type, 3>& buffer_offset,
+                                  const cl::array<cl::size_type, 3>& host_offset,
+                                  const cl::array<cl::size_type, 3>& region,
+                                  cl::size_type buffer_row_pitch,
+                                  cl::size_type buffer_slice_pitch,
+                                  cl::size_type host_row_pitch,
+                                  cl::size_type host_slice_pitch,
+                                  const void* ptr,
+                                  const std::vector<cl::Event>* events = nullptr,
+                                  cl::Event* event = nullptr) {
+        return profiled(
+            event,
+            [&](cl::Event* e) {
+                return cl::CommandQueue::enqueueWriteBufferRect(buffer,
+                                                                blocking,
+                                                                buffer_offset,
+                                                                host_offset,
+                                                                region,
+                                                                buffer_row_pitch,
+                                                                buffer_slice_pitch,
+                                                                host_row_pitch,
+                                                                host_slice_pitch,
+                                                                ptr,
+                                                                events,
+                                                                e);
+            },
+            []() { return std::string("write"); },
+            region[0] * region[1] * region[2]);
+    }
+
+    cl_int enqueueCopyBuffer(const cl::Buffer& src,
+                             const cl::Buffer& dst,
+                             size_t src_offset,
+                             size_t dst_offset,
+                             size_t size,
+                             const std::vector<cl::Event>* events = nullptr,
+                             cl::Event* event = nullptr) {
+        return profiled(
+            event,
+            [&](cl::Event* e) {
+                return cl::CommandQueue::enqueueCopyBuffer(src, dst, src_offset, dst_offset, size, events, e);
+            },
+            []() { return std::string("copy"); },
+            size);
+    }
+
+    template <typename PatternType>
+    cl_int enqueueFillBuffer(const cl::Buffer& buffer,
+                             PatternType pattern,
+                             size_t offset,
+                             size_t size,
+                             const std::vector<cl::Event>* events = nullptr,
+                             cl::Event* event = nullptr) {
+        return profiled(
+            event,
+            [&](cl::Event* e) {
+                return cl::CommandQueue::enqueueFillBuffer<PatternType>(buffer, pattern, offset, size, events, e);
+            },
+            []() { return std::string("fill"); },
+            size);
+    }
+
+    // Waits for the recorded commands, and adds their device times to the profiler.
+    void collect();
+
+private:
+    struct Command {
+        std::string name;
+        cl::Event event;
+        size_t bytes;
+    };
+
+    template <typename Enqueue, typename Name>
+    cl_int profiled(cl::Event* event, Enqueue&& enqueue, Name&& name, size_t bytes) {
+        if (!m_profiling || !util::Profiler::enabled()) return enqueue(event);
+
+        cl::Event e;
+        auto err_code = enqueue(&e);
+        if (err_code == CL_SUCCESS) {
+            if (event) *event = e;
+            m_commands.push_back(Command{name(), std::move(e), bytes});
+            if (m_commands.size() >= max_profiled_commands) collect();
+        }
+
+        return err_code;
+    }
+
+    bool m_profiling = false;
+    std::vector<Command> m_commands;
+};
+
+struct BufferPoolStatistics {
+    // Number of temporary buffers reused from the pool.
+    size_t hits;
+    // Number of temporary buffers allocated in the device because the pool did not have a buffer of that size.
+    size_t misses;
+    // Number of buffers (and their total size in bytes) currently kept by the pool.
+    size_t cached_buffers;
+    size_t cached_bytes;
+};
 
+// The lock of an OpenCL device. While a thread holds it, OpenCLConfig::get() returns the locked device in that thread,
+// so the code executed under the lock uses the same device. The previous device of the thread is restored when the
+// lock is destroyed.
+//
+// The lock does not exclude the other threads: each thread enqueues its work in its own kernels and command queues
+// (see OpenCLConfig::kernel()), so many threads can use the same device at the same time. When the outermost lock of
+// a device is destroyed, it waits for the commands enqueued by the thread, so the buffers written under the lock
+// (e.g., the training data of a model) can be used by the queues of the other threads.
+class OpenCLLock {
+public:
+    OpenCLLock() = default;
+    OpenCLLock(int device);
+    OpenCLLock(const OpenCLLock&) = delete;
+    OpenCLLock& operator=(const OpenCLLock&) = delete;
+    OpenCLLock(OpenCLLock&& other) noexcept
+        : m_device(other.m_device), m_previous_device(other.m_previous_device), m_active(other.m_active) {
+        other.m_active = false;
+    }
+    OpenCLLock& operator=(OpenCLLock&&) = delete;
+
+    ~OpenCLLock();
+
+    bool owns_lock() const { return m_active; }
+
+private:
+    int m_device = -1;
+    int m_previous_device = -1;
+    bool m_active = false;
+};
+
+// There is an OpenCLConfig for each device of the device pool. All the devices share the same context and program, so
+// the buffers of a device can be used by the kernels of the others.
 class OpenCLConfig {
 public:
+    // Returns the OpenCLConfig of the device locked by the current thread or, if it does not hold any lock, of the
+    // first device of the pool.
     static OpenCLConfig& get();
+    static OpenCLConfig& get(int device);
+    static int num_devices() { return static_cast<int>(pool().size()); }
+
+    // Sets the indices (in the default platform) of the devices of the pool. The default pool only contains the default
+    // device. It must be called before OpenCL is initialized.
+    static void set_devices(const std::vector<int>& devices);
+
+    // Sets the directory where the compiled OpenCL program is cached, so the next processes that use the same devices
+    // and drivers do not compile it again. If it is empty, the program is not cached. It must be called before OpenCL
+    // is initialized. By default, the directory is the PYBNESIAN_OPENCL_CACHE_DIR environment variable or, if it is not
+    // defined, $XDG_CACHE_HOME/pybnesian (~/.cache/pybnesian). The directory is created with mode 0700, and it is not
+    // used if it belongs to another user or other users can write to it. The cached files must belong to the current
+    // user and have mode 0600, so other users can not replace the binaries that are run on the devices.
+    static void set_program_cache_dir(const std::string& dir);
+
+    // Returns the device for a new model: the device locked by the current thread or, if it does not hold any lock, the
+    // next device of the pool in round-robin order.
+    static int select_device();
+
+    // Returns true if the first device of the pool is a GPU. It does not initialize the OpenCLConfig (and does not
+    // compile the OpenCL program), so it can be used to choose between the OpenCL code and the CPU code.
+    static bool gpu_available();
+
+    // Position of the device in the pool.
+    int index() const { return m_index; }
 
     cl::Context& context() { return m_context; }
     cl::Program& program() { return m_program; }
@@ -134,54 +468,170 @@ public:
     template <typename T>
     void read_from_buffer(T* dest, const cl::Buffer& from, int size);
 
+    // Returns the device copy of a column without null values. The copy is shared by all the models fitted with the
+    // same column (the same arrow::ArrayData), so the overlapping training data of the models of a Bayesian network is
+    // uploaded once. The device only keeps weak references: the copy is released when no model uses it.
+    template <typename ArrowType>
+    std::shared_ptr<cl::Buffer> shared_column(const std::shared_ptr<arrow::Array>& column);
+
     template <typename T>
     cl::Buffer new_buffer(int size, cl_mem_flags flags = CL_MEM_READ_WRITE);
 
+    // Returns a read-only buffer that uses the host memory of d (CL_MEM_USE_HOST_PTR), so the devices that share the
+    // host memory (e.g., the CPU devices) do not copy it. d must outlive the buffer.
+    template <typename T>
+    cl::Buffer host_buffer(const T* d, int size);
+
+    // Temporary buffers are taken from the buffer pool. Use new_buffer() or copy_to_buffer() for the buffers kept by
+    // the models (e.g., the training data), so they do not hold pooled memory.
+    template <typename T>
+    PooledBuffer temp_buffer(int size) { return pooled_buffer(sizeof(T) * static_cast<size_t>(size)); }
+
+    template <typename T>
+    PooledBuffer copy_to_temp_buffer(const T* d, int size);
+
+    PooledBuffer pooled_buffer(size_t bytes);
+
+    BufferPoolStatistics buffer_pool_statistics();
+    // Frees the device memory of the buffers kept by the pool. The statistics are not reset.
+    void clear_buffer_pool();
+    // Sets the maximum number of bytes kept by the pool (1/4 of the global memory of the device by default), freeing
+    // the pooled buffers that do not fit.
+    void set_buffer_pool_max_bytes(size_t bytes);
+    // The device memory of the buffers kept by the pool and the data columns shared by the models. The buffers owned by
+    // the models are reported by their memory_usage().
+    util::MemoryUsage memory_usage();
+
     template <typename T>
     cl::Buffer copy_buffer(const cl::Buffer& input,
                            unsigned int offset,
                            unsigned int length,
                            cl_mem_flags flags = CL_MEM_READ_WRITE);
 
+    template <typename T>
+    PooledBuffer copy_temp_buffer(const cl::Buffer& input, unsigned int offset, unsigned int length);
+
+    // Copies length elements of input (from input_offset) to output (from output_offset).
+    template <typename T>
+    void copy_buffer_region(const cl::Buffer& input,
+                            unsigned int input_offset,
+                            cl::Buffer& output,
+                            unsigned int output_offset,
+                            unsigned int length);
+
     template <typename T>
     void fill_buffer(cl::Buffer& b, const T value, unsigned int length);
 
+    // Allocates a temporary matrix of rows x allocated_m, where allocated_m <= cols is the number of columns processed
+    // at a time. extra_rows is the size of the other temporary buffers allocated per column by the caller.
     template <typename ArrowType>
-    std::pair<cl::Buffer, uint64_t> allocate_temp_mat(size_t rows, size_t cols, size_t max_cols = 64) {
+    std::pair<PooledBuffer, uint64_t> allocate_temp_mat(size_t rows, size_t cols, size_t extra_rows = 0) {
         using CType = typename ArrowType::c_type;
-        auto allocated_m = std::min(cols, max_cols);
-        return std::make_pair(new_buffer<CType>(rows * allocated_m), allocated_m);
+        auto allocated_m = temp_mat_cols(rows, cols, extra_rows, sizeof(CType));
+        return std::make_pair(temp_buffer<CType>(rows * allocated_m), allocated_m);
     }
 
+    // Returns the number of columns of a temporary matrix of rows x cols with elements of element_bytes. If no maximum
+    // number of columns is set, the columns (and the extra_rows of each column) use at most 1/8 of the global memory
+    // of the device, and the matrix is not larger than the maximum size of a buffer.
+    size_t temp_mat_cols(size_t rows, size_t cols, size_t extra_rows, size_t element_bytes);
+    // The number of columns chosen in the last call to temp_mat_cols().
+    size_t last_temp_mat_cols() const { return m_last_temp_mat_cols; }
+
+    // Sets the maximum number of columns of the temporary matrices. If 0, it is chosen from the device memory. It does
+    // not initialize the OpenCLConfig.
+    static void set_temp_mat_max_cols(size_t max_cols) { s_temp_mat_max_cols = max_cols; }
+    static size_t temp_mat_max_cols() { return s_temp_mat_max_cols; }
+
+    // Evaluates compute(chunk_buffer, chunk_rows) for consecutive chunks of pipeline_rows() rows of a column-major
+    // matrix of rows x cols. host_matrix points to the first row of the matrix, whose columns are host_rows apart.
+    // compute() enqueues its kernels in queue() and returns a buffer with a value for each row of the chunk, which is
+    // downloaded to output. The transfers are enqueued in transfer_queue(), so the upload of the next chunk and the
+    // download of the previous results overlap with the kernels of the current chunk.
+    template <typename T, typename Compute>
+    void pipelined_rows(const T* host_matrix, int host_rows, int rows, int cols, Compute compute, T* output);
+
+    // Same as pipelined_rows(), but the rows are split in ranges of multi_device_chunks * pipeline_rows() rows that are
+    // evaluated by all the devices of the pool. The current thread must hold the lock of its device. The other devices
+    // are used by helper threads (where get() returns their device).
+    template <typename T, typename Compute>
+    static void multi_device_rows(const T* host_matrix, int rows, int cols, Compute compute, T* output);
+
+    // Sets the number of rows of each chunk of pipelined_rows(). If 0, default_pipeline_rows is used. It does not
+    // initialize the OpenCLConfig.
+    static void set_pipeline_rows(int rows) { s_pipeline_rows = (rows > 0) ? rows : default_pipeline_rows; }
+    static int pipeline_rows() { return s_pipeline_rows; }
+
+    // Sets the maximum number of training instances of a KDE kept in a buffer of the device. The KDEs fitted with more
+    // training instances keep them in the host, and stream them to the device in blocks of rows instances when they are
+    // evaluated. If 0, the training instances are only streamed if they do not fit in the memory of the device. It does
+    // not initialize the OpenCLConfig.
+    static void set_training_block_rows(int rows) { s_training_block_rows = std::max(rows, 0); }
+    static int training_block_rows() { return s_training_block_rows; }
+
+    // If true, the OpenCL logl of the KDE models with double data computes the kernel exponents in float and the
+    // log-sum-exp in double. It does not initialize the OpenCLConfig.
+    static void set_mixed_precision(bool mixed_precision) { s_mixed_precision = mixed_precision; }
+    static bool mixed_precision() { return s_mixed_precision; }
+
+    // Enqueues the kernel kernel_name, whose arguments are already set, over global_size work items in queue(). The
+    // first launches of each kernel in a device try each candidate local size (the powers of 2 up to
+    // kernel_local_size() and the default of the driver), timing them with the real arguments. Then, the fastest local
+    // size is used by the next launches and saved next to the cached program (see set_program_cache_dir()), so the
+    // next processes do not tune the kernel again.
+    //
+    // Each launch is executed once, so the kernel can accumulate in its output. The local size can only be used if it
+    // divides global_size, so the kernel must not depend on the local size (e.g., reductions in local memory).
+    cl_int enqueue_tuned_kernel(const char* kernel_name, size_t global_size);
+    // Enables or disables the tuning of enqueue_tuned_kernel(). If it is disabled, the kernels not tuned yet use the
+    // default local size of the driver. It does not initialize the OpenCLConfig.
+    static void set_autotuning(bool autotuning) { s_autotuning = autotuning; }
+    static bool autotuning() { return s_autotuning; }
+
+    // If true, the command queues are created with CL_QUEUE_PROFILING_ENABLE, so the device time of the kernels (by
+    // kernel name) and the transfers is added to the profiler (see ProfiledQueue). The queues of each thread are
+    // created again when it next uses them after the mode is changed. The commands are collected when the outermost
+    // lock of the device is released. It does not initialize the OpenCLConfig.
+    static void set_profiling(bool profiling) { s_profiling = profiling; }
+    static bool profiling() { return s_profiling; }
+    // Returns the local size chosen for each tuned kernel, where 0 is the default local size of the driver.
+    std::unordered_map<std::string, size_t> tuned_local_sizes();
+
+    // The kernels and the command queues are created for each thread when it first uses them, so the arguments set by
+    // a thread are not overwritten by the others. The kernels of all the threads are created from the same program.
     cl::Kernel& kernel(const char* name);
-    cl::CommandQueue& queue() { return m_queue; }
+    ProfiledQueue& queue() { return thread_resources().queue; }
+    ProfiledQueue& transfer_queue() { return thread_resources().transfer_queue; }
+
+    // The lock can be acquired again by the thread that holds it (see OpenCLLock).
+    OpenCLLock lock() { return OpenCLLock(m_index); }
 
     template <typename ArrowType>
-    std::vector<cl::Buffer> create_reduction1d_buffers(int length, const char* kernel_name);
+    std::vector<PooledBuffer> create_reduction1d_buffers(int length, const char* kernel_name);
 
     template <typename ArrowType>
-    std::vector<cl::Buffer> create_reduction_mat_buffers(int length, int cols_mat, const char* kernel_name);
+    std::vector<PooledBuffer> create_reduction_mat_buffers(int length, int cols_mat, const char* kernel_name);
 
     template <typename ArrowType, typename Reduction>
     void reduction1d(cl::Buffer& input_vec, int input_length, cl::Buffer& output_buffer, int ouput_offset);
 
     template <typename ArrowType>
-    cl::Buffer sum1d(cl::Buffer& input_vec, int input_length) {
-        cl::Buffer output = new_buffer<typename ArrowType::c_type>(1);
+    PooledBuffer sum1d(cl::Buffer& input_vec, int input_length) {
+        PooledBuffer output = temp_buffer<typename ArrowType::c_type>(1);
         reduction1d<ArrowType, SumReduction<ArrowType>>(input_vec, input_length, output, 0);
         return output;
     }
 
 
     template <typename ArrowType, typename Reduction>
-    cl::Buffer reduction_cols(const cl::Buffer& input_mat, int input_rows, int input_cols);
+    PooledBuffer reduction_cols(const cl::Buffer& input_mat, int input_rows, int input_cols);
 
     template <typename ArrowType, typename Reduction>
     void reduction_cols_offset(
         const cl::Buffer& input_mat, int input_rows, int input_cols, cl::Buffer& output_vec, int output_offset);
 
     template <typename ArrowType>
-    cl::Buffer amax_cols(const cl::Buffer& input_mat, int input_rows, int input_cols) {
+    PooledBuffer amax_cols(const cl::Buffer& input_mat, int input_rows, int input_cols) {
         return reduction_cols<ArrowType, MaxReduction<ArrowType>>(input_mat, input_rows, input_cols);
     }
 
@@ -197,7 +647,7 @@ public:
         cl::Buffer& input_mat, int input_rows, int input_cols, cl::Buffer& output_vec, int output_offset);
 
     template <typename ArrowType>
-    cl::Buffer accum_sum_cols(cl::Buffer& mat, int input_rows, int input_cols);
+    PooledBuffer accum_sum_cols(cl::Buffer& mat, int input_rows, int input_cols);
 
     size_t kernel_local_size(const char* kernel_name);
 
@@ -207,29 +657,173 @@ public:
 
     cl_ulong max_local_memory() { return m_max_local_memory_bytes; }
 
+    cl_ulong global_memory() { return m_global_memory_bytes; }
+
+    cl_ulong max_buffer_memory() { return m_max_buffer_memory_bytes; }
+
     OpenCLConfig(const OpenCLConfig&) = delete;
     void operator=(const OpenCLConfig&) = delete;
 
 private:
-    OpenCLConfig();
+    friend class PooledBuffer;
+    friend class OpenCLLock;
+
+    // The kernels and command queues of a thread in a device.
+    struct ThreadResources {
+        ProfiledQueue queue;
+        ProfiledQueue transfer_queue;
+        std::unordered_map<const char*, cl::Kernel> kernels;
+    };
+
+    // A free buffer of the pool, and the queue of the thread that released it (null if the thread did not use the
+    // device).
+    struct FreeBuffer {
+        cl::Buffer buffer;
+        cl::CommandQueue queue;
+    };
+
+    // The tuning of the local size of a kernel (see enqueue_tuned_kernel()). The candidate 0 is the default local size
+    // of the driver.
+    struct KernelTuning {
+        std::vector<size_t> candidates;
+        // The best time per work item of each candidate.
+        std::vector<double> times;
+        std::vector<int> samples;
+        int launches = 0;
+        bool tuned = false;
+        size_t best = 0;
+    };
+
+    OpenCLConfig(const cl::Context& context, const cl::Program& program, const cl::Device& device, int index);
+
+    KernelTuning& kernel_tuning(const char* kernel_name);
+    // Chooses the best local size of a kernel when its candidates are timed.
+    void finish_tuning(KernelTuning& tuning);
+    void load_tuning();
+    void save_tuning();
+
+    ThreadResources& thread_resources();
+    // Returns the resources of the current thread, or nullptr if it has not used the device.
+    ThreadResources* existing_thread_resources() {
+        auto index = static_cast<size_t>(m_index);
+        return (index < s_thread_resources.size()) ? s_thread_resources[index].get() : nullptr;
+    }
 
+    // The pool is created the first time it is used. A child process created with fork() (e.g., by multiprocessing)
+    // inherits the OpenCL objects of the parent, but the driver state is not valid in the child. Thus, the child
+    // creates a new pool the first time it uses OpenCL, built from the program binaries of the parent.
+    static std::vector<std::unique_ptr<OpenCLConfig>>& pool();
+    static std::vector<std::unique_ptr<OpenCLConfig>> create_pool();
+    static cl::Program build_program(const cl::Context& context, const std::vector<cl::Device>& devices);
+    // Returns the program cache directory, or an empty string if the program is not cached or the directory can not be
+    // used safely (see set_program_cache_dir()).
+    static std::string program_cache_dir();
+    // Called in the child process after fork(). It abandons the resources of the current thread, and the pool is
+    // created again by the next call to pool().
+    static void after_fork_child();
+
+    void release_pooled_buffer(cl::Buffer&& buffer, size_t bytes);
+    // Removes the shared columns whose source data or device copy no longer exist.
+    void remove_expired_shared_columns();
+
+    int m_index;
     cl::Context m_context;
-    cl::CommandQueue m_queue;
     cl::Program m_program;
     cl::Device m_device;
-    std::unordered_map<const char*, cl::Kernel> m_kernels;
     std::unordered_map<const char*, size_t> m_kernels_local_size;
     std::unordered_map<const char*, cl_ulong> m_kernels_local_memory;
+    std::mutex m_kernels_mutex;
+    std::unordered_map<std::string, KernelTuning> m_tuning;
+    // The file where the tuned local sizes are saved, or empty if the program is not cached.
+    std::string m_tuning_file;
+    std::mutex m_tuning_mutex;
     size_t m_max_local_size;
     cl_ulong m_max_local_memory_bytes;
+    cl_ulong m_global_memory_bytes;
+    cl_ulong m_max_buffer_memory_bytes;
+    std::atomic<size_t> m_last_temp_mat_cols;
+    inline static std::atomic<size_t> s_temp_mat_max_cols = 0;
+    inline static std::atomic<int> s_pipeline_rows = default_pipeline_rows;
+    inline static std::atomic<int> s_training_block_rows = 0;
+    inline static std::atomic<bool> s_mixed_precision = false;
+    inline static std::atomic<bool> s_autotuning = true;
+    inline static std::atomic<bool> s_profiling = false;
+    // Free pooled buffers, by size in bytes.
+    std::unordered_map<size_t, std::vector<FreeBuffer>> m_buffer_pool;
+    size_t m_pool_hits;
+    size_t m_pool_misses;
+    size_t m_pool_cached_buffers;
+    size_t m_pool_cached_bytes;
+    size_t m_pool_max_bytes;
+    std::mutex m_pool_mutex;
+    struct SharedColumn {
+        std::weak_ptr<arrow::ArrayData> source;
+        std::weak_ptr<cl::Buffer> buffer;
+    };
+    std::unordered_map<const arrow::ArrayData*, SharedColumn> m_shared_columns;
+    std::mutex m_shared_columns_mutex;
+
+    // The device locked by each thread (-1 if it does not hold any lock).
+    inline static thread_local int s_current_device = -1;
+    // The resources of each thread, by the index of the device.
+    inline static thread_local std::vector<std::unique_ptr<ThreadResources>> s_thread_resources;
+    inline static std::atomic<unsigned int> s_next_device = 0;
+    inline static std::mutex s_devices_mutex;
+    inline static std::vector<int> s_devices{default_device_idx};
+    inline static bool s_initialized = false;
+    inline static std::optional<std::string> s_program_cache_dir;
+    // The binaries of the program for each device of the pool, so a child process does not compile it again.
+    inline static cl::Program::Binaries s_program_binaries;
+    // True in a child process until it creates its pool.
+    inline static std::atomic<bool> s_forked = false;
+    inline static std::mutex s_fork_mutex;
+    // 1 (0) if the first device is (not) a GPU, or -1 if it is not known yet.
+    inline static int s_gpu_available = -1;
 };
 
 template <typename T>
 cl::Buffer OpenCLConfig::copy_to_buffer(const T* d, int size) {
     cl::Buffer b = new_buffer<T>(size);
 
+    util::ProfileScope profile([] { return std::string("opencl:write"); }, 1, sizeof(T) * size);
     cl_int err_code = CL_SUCCESS;
-    err_code = m_queue.enqueueWriteBuffer(b, CL_TRUE, 0, sizeof(T) * size, d);
+    err_code = queue().enqueueWriteBuffer(b, CL_TRUE, 0, sizeof(T) * size, d);
+
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Error copying OpenCL buffer. ") + opencl::opencl_error(err_code) + " (" +
+                                 std::to_string(err_code) + ").");
+    }
+
+    return b;
+}
+
+template <typename ArrowType>
+std::shared_ptr<cl::Buffer> OpenCLConfig::shared_column(const std::shared_ptr<arrow::Array>& column) {
+    using ArrayType = typename arrow::TypeTraits<ArrowType>::ArrayType;
+    const auto& data = column->data();
+
+    std::lock_guard<std::mutex> l(m_shared_columns_mutex);
+    auto it = m_shared_columns.find(data.get());
+    // The address of an expired ArrayData can be reused by a different column.
+    if (it != m_shared_columns.end() && it->second.source.lock() == data) {
+        if (auto buffer = it->second.buffer.lock()) return buffer;
+    }
+
+    auto dwn_column = std::static_pointer_cast<ArrayType>(column);
+    auto buffer = std::make_shared<cl::Buffer>(copy_to_buffer(dwn_column->raw_values(), column->length()));
+
+    remove_expired_shared_columns();
+    m_shared_columns[data.get()] = SharedColumn{data, buffer};
+    return buffer;
+}
+
+template <typename T>
+PooledBuffer OpenCLConfig::copy_to_temp_buffer(const T* d, int size) {
+    PooledBuffer b = temp_buffer<T>(size);
+
+    util::ProfileScope profile([] { return std::string("opencl:write"); }, 1, sizeof(T) * size);
+    cl_int err_code = CL_SUCCESS;
+    err_code = queue().enqueueWriteBuffer(b, CL_TRUE, 0, sizeof(T) * size, d);
 
     if (err_code != CL_SUCCESS) {
         throw std::runtime_error(std::string("Error copying OpenCL buffer. ") + opencl::opencl_error(err_code) + " (" +
@@ -241,8 +835,9 @@ cl::Buffer OpenCLConfig::copy_to_buffer(const T* d, int size) {
 
 template <typename T>
 void OpenCLConfig::read_from_buffer(T* dest, const cl::Buffer& from, int size) {
+    util::ProfileScope profile([] { return std::string("opencl:read"); }, 1, sizeof(T) * size);
     cl_int err_code = CL_SUCCESS;
-    err_code = m_queue.enqueueReadBuffer(from, CL_TRUE, 0, sizeof(T) * size, dest);
+    err_code = queue().enqueueReadBuffer(from, CL_TRUE, 0, sizeof(T) * size, dest);
 
     if (err_code != CL_SUCCESS) {
         throw std::runtime_error(std::string("Error reading buffer. ") + opencl::opencl_error(err_code) + " (" +
@@ -263,6 +858,20 @@ cl::Buffer OpenCLConfig::new_buffer(int size, cl_mem_flags flags) {
     return b;
 }
 
+template <typename T>
+cl::Buffer OpenCLConfig::host_buffer(const T* d, int size) {
+    cl_int err_code = CL_SUCCESS;
+    // The buffer is read-only, so the device never writes to d.
+    cl::Buffer b(m_context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(T) * size, const_cast<T*>(d), &err_code);
+
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Error creating OpenCL buffer of size ") + std::to_string(size) +
+                                 opencl::opencl_error(err_code) + " (" + std::to_string(err_code) + ").");
+    }
+
+    return b;
+}
+
 template <typename T>
 cl::Buffer OpenCLConfig::copy_buffer(const cl::Buffer& input,
                                      unsigned int offset,
@@ -271,7 +880,22 @@ cl::Buffer OpenCLConfig::copy_buffer(const cl::Buffer& input,
     cl::Buffer b = new_buffer<T>(length, flags);
 
     cl_int err_code = CL_SUCCESS;
-    err_code = m_queue.enqueueCopyBuffer(input, b, sizeof(T) * offset, 0, sizeof(T) * length);
+    err_code = queue().enqueueCopyBuffer(input, b, sizeof(T) * offset, 0, sizeof(T) * length);
+
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Error copying OpenCL buffer. ") + opencl::opencl_error(err_code) + " (" +
+                                 std::to_string(err_code) + ").");
+    }
+
+    return b;
+}
+
+template <typename T>
+PooledBuffer OpenCLConfig::copy_temp_buffer(const cl::Buffer& input, unsigned int offset, unsigned int length) {
+    PooledBuffer b = temp_buffer<T>(length);
+
+    cl_int err_code = CL_SUCCESS;
+    err_code = queue().enqueueCopyBuffer(input, b, sizeof(T) * offset, 0, sizeof(T) * length);
 
     if (err_code != CL_SUCCESS) {
         throw std::runtime_error(std::string("Error copying OpenCL buffer. ") + opencl::opencl_error(err_code) + " (" +
@@ -281,10 +905,26 @@ cl::Buffer OpenCLConfig::copy_buffer(const cl::Buffer& input,
     return b;
 }
 
+template <typename T>
+void OpenCLConfig::copy_buffer_region(const cl::Buffer& input,
+                                      unsigned int input_offset,
+                                      cl::Buffer& output,
+                                      unsigned int output_offset,
+                                      unsigned int length) {
+    cl_int err_code = CL_SUCCESS;
+    err_code = queue().enqueueCopyBuffer(
+        input, output, sizeof(T) * input_offset, sizeof(T) * output_offset, sizeof(T) * length);
+
+    if (err_code != CL_SUCCESS) {
+        throw std::runtime_error(std::string("Error copying OpenCL buffer. ") + opencl::opencl_error(err_code) + " (" +
+                                 std::to_string(err_code) + ").");
+    }
+}
+
 template <typename T>
 void OpenCLConfig::fill_buffer(cl::Buffer& buffer, const T value, unsigned int length) {
     cl_int err_code = CL_SUCCESS;
-    err_code = m_queue.enqueueFillBuffer<T>(buffer, value, 0, length * sizeof(T));
+    err_code = queue().enqueueFillBuffer<T>(buffer, value, 0, length * sizeof(T));
 
     if (err_code != CL_SUCCESS) {
         throw std::runtime_error(std::string("Error filling OpenCL buffer. ") + opencl::opencl_error(err_code) + " (" +
@@ -293,9 +933,9 @@ void OpenCLConfig::fill_buffer(cl::Buffer& buffer, const T value, unsigned int l
 }
 
 template <typename ArrowType>
-std::vector<cl::Buffer> OpenCLConfig::create_reduction1d_buffers(int length, const char* kernel_name) {
+std::vector<PooledBuffer> OpenCLConfig::create_reduction1d_buffers(int length, const char* kernel_name) {
     using CType = typename ArrowType::c_type;
-    std::vector<cl::Buffer> res;
+    std::vector<PooledBuffer> res;
 
     auto k_local_size = kernel_local_size(kernel_name);
     auto k_local_memory = kernel_local_memory(kernel_name);
@@ -308,7 +948,7 @@ std::vector<cl::Buffer> OpenCLConfig::create_reduction1d_buffers(int length, con
     while (current_length > device_max_local_size) {
         auto num_groups = static_cast<int>(
             std::ceil(static_cast<double>(current_length) / static_cast<double>(device_max_local_size)));
-        auto reduc_buffer = new_buffer<CType>(num_groups);
+        auto reduc_buffer = temp_buffer<CType>(num_groups);
         res.push_back(std::move(reduc_buffer));
         current_length = num_groups;
     }
@@ -317,9 +957,11 @@ std::vector<cl::Buffer> OpenCLConfig::create_reduction1d_buffers(int length, con
 }
 
 template <typename ArrowType>
-std::vector<cl::Buffer> OpenCLConfig::create_reduction_mat_buffers(int length, int cols_mat, const char* kernel_name) {
+std::vector<PooledBuffer> OpenCLConfig::create_reduction_mat_buffers(int length,
+                                                                    int cols_mat,
+                                                                    const char* kernel_name) {
     using CType = typename ArrowType::c_type;
-    std::vector<cl::Buffer> res;
+    std::vector<PooledBuffer> res;
 
     auto k_local_size = kernel_local_size(kernel_name);
     auto k_local_memory = kernel_local_memory(kernel_name);
@@ -332,7 +974,7 @@ std::vector<cl::Buffer> OpenCLConfig::create_reduction_mat_buffers(int length, i
     while (current_length > device_max_local_size) {
         auto num_groups = static_cast<int>(
             std::ceil(static_cast<double>(current_length) / static_cast<double>(device_max_local_size)));
-        auto reduc_buffer = new_buffer<CType>(num_groups * cols_mat);
+        auto reduc_buffer = temp_buffer<CType>(num_groups * cols_mat);
         res.push_back(std::move(reduc_buffer));
         current_length = num_groups;
     }
@@ -342,6 +984,143 @@ std::vector<cl::Buffer> OpenCLConfig::create_reduction_mat_buffers(int length, i
 
 void update_reduction_status(int& length, int& num_groups, int& local_size, int& global_size, int max_local_size);
 
+void raise_transfer_error(cl_int err_code);
+
+template <typename T, typename Compute>
+void OpenCLConfig::pipelined_rows(const T* host_matrix, int host_rows, int rows, int cols, Compute compute, T* output) {
+    struct Slot {
+        PooledBuffer input;
+        PooledBuffer result;
+        cl::Event uploaded;
+        cl::Event computed;
+        cl::Event downloaded;
+    };
+
+    if (rows == 0) return;
+
+    int chunk_rows = pipeline_rows();
+    auto num_chunks = (rows + chunk_rows - 1) / chunk_rows;
+    auto chunk_length = [rows, chunk_rows](int chunk) { return std::min(chunk_rows, rows - chunk * chunk_rows); };
+
+    // Two slots are used alternatively: while the kernels of a chunk are executed in one slot, the next chunk is
+    // uploaded to the other.
+    Slot slots[2];
+    slots[0].input = temp_buffer<T>(chunk_length(0) * cols);
+    if (num_chunks > 1) slots[1].input = temp_buffer<T>(chunk_rows * cols);
+
+    // The pooled buffers can still be used by the kernels enqueued before in queue().
+    cl::Event ready;
+    raise_transfer_error(queue().enqueueMarkerWithWaitList(nullptr, &ready));
+    raise_transfer_error(queue().flush());
+
+    auto upload = [&](int chunk) {
+        auto& slot = slots[chunk % 2];
+        auto length = chunk_length(chunk);
+        // The input of a slot is overwritten when the kernels of its previous chunk are finished.
+        std::vector<cl::Event> wait{(chunk < 2) ? ready : slot.computed};
+        // The transfers are asynchronous, so only their bytes are recorded.
+        util::profile_count([] { return std::string("opencl:write"); }, 1, sizeof(T) * length * cols);
+        raise_transfer_error(
+            transfer_queue().enqueueWriteBufferRect(slot.input,
+                                                    CL_FALSE,
+                                                    {0, 0, 0},
+                                                    {sizeof(T) * static_cast<size_t>(chunk) * chunk_rows, 0, 0},
+                                                    {sizeof(T) * length, static_cast<size_t>(cols), 1},
+                                                    sizeof(T) * length,
+                                                    0,
+                                                    sizeof(T) * host_rows,
+                                                    0,
+                                                    host_matrix,
+                                                    &wait,
+                                                    &slot.uploaded));
+        raise_transfer_error(transfer_queue().flush());
+    };
+
+    try {
+        upload(0);
+        for (auto chunk = 0; chunk < num_chunks; ++chunk) {
+            auto& slot = slots[chunk % 2];
+            auto length = chunk_length(chunk);
+            if (chunk + 1 < num_chunks) upload(chunk + 1);
+
+            std::vector<cl::Event> uploaded{slot.uploaded};
+            raise_transfer_error(queue().enqueueBarrierWithWaitList(&uploaded));
+
+            // The previous result of the slot is returned to the pool when its download is finished.
+            if (slot.downloaded()) raise_transfer_error(slot.downloaded.wait());
+            slot.result = compute(slot.input, length);
+            raise_transfer_error(queue().enqueueMarkerWithWaitList(nullptr, &slot.computed));
+            raise_transfer_error(queue().flush());
+
+            std::vector<cl::Event> computed{slot.computed};
+            util::profile_count([] { return std::string("opencl:read"); }, 1, sizeof(T) * length);
+            raise_transfer_error(transfer_queue().enqueueReadBuffer(slot.result,
+                                                                    CL_FALSE,
+                                                                    0,
+                                                                    sizeof(T) * length,
+                                                                    output + static_cast<size_t>(chunk) * chunk_rows,
+                                                                    &computed,
+                                                                    &slot.downloaded));
+            raise_transfer_error(transfer_queue().flush());
+        }
+
+        raise_transfer_error(transfer_queue().finish());
+    } catch (...) {
+        // The pending transfers use host memory and pooled buffers.
+        queue().finish();
+        transfer_queue().finish();
+        throw;
+    }
+}
+
+template <typename T, typename Compute>
+void OpenCLConfig::multi_device_rows(const T* host_matrix, int rows, int cols, Compute compute, T* output) {
+    auto& current = get();
+    auto n = num_devices();
+    auto range_rows = multi_device_chunks * pipeline_rows();
+    auto num_ranges = (rows + range_rows - 1) / range_rows;
+
+    if (n == 1 || num_ranges < 2) {
+        current.pipelined_rows(host_matrix, rows, rows, cols, compute, output);
+        return;
+    }
+
+    std::atomic<int> next_range = 0;
+    std::vector<std::exception_ptr> errors(n);
+    auto work = [&](OpenCLConfig& config) {
+        try {
+            for (auto range = next_range++; range < num_ranges; range = next_range++) {
+                auto begin = range * range_rows;
+                auto length = std::min(range_rows, rows - begin);
+                config.pipelined_rows(host_matrix + begin, rows, length, cols, compute, output + begin);
+            }
+        } catch (...) {
+            errors[config.m_index] = std::current_exception();
+            next_range = num_ranges;
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    for (auto i = 0; i < n && static_cast<int>(helpers.size()) + 1 < num_ranges; ++i) {
+        if (i == current.m_index) continue;
+
+        helpers.emplace_back([&work, i]() {
+            auto& config = get(i);
+            auto l = config.lock();
+            work(config);
+        });
+    }
+
+    work(current);
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
 template <typename ArrowType, typename Reduction>
 void OpenCLConfig::reduction1d(cl::Buffer& input_vec, int input_length, cl::Buffer& output_buffer, int output_offset) {
     using CType = typename ArrowType::c_type;
@@ -370,7 +1149,7 @@ void OpenCLConfig::reduction1d(cl::Buffer& input_vec, int input_length, cl::Buff
     }
 
     RAISE_ENQUEUEKERNEL_ERROR(
-        m_queue.enqueueNDRangeKernel(k_reduction, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size)));
+        queue().enqueueNDRangeKernel(k_reduction, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size)));
 
     if (num_groups == 1) return;
 
@@ -383,7 +1162,7 @@ void OpenCLConfig::reduction1d(cl::Buffer& input_vec, int input_length, cl::Buff
         k_reduction.setArg(3, reduc_buffers[i + 1]);
         k_reduction.setArg(4, 0u);
 
-        RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+        RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
             k_reduction, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size)));
         update_reduction_status(length, num_groups, local_size, global_size, device_max_local_size);
     }
@@ -394,11 +1173,11 @@ void OpenCLConfig::reduction1d(cl::Buffer& input_vec, int input_length, cl::Buff
     k_reduction.setArg(3, output_buffer);
     k_reduction.setArg(4, output_offset);
     RAISE_ENQUEUEKERNEL_ERROR(
-        m_queue.enqueueNDRangeKernel(k_reduction, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size)));
+        queue().enqueueNDRangeKernel(k_reduction, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size)));
 }
 
 template <typename ArrowType, typename Reduction>
-cl::Buffer OpenCLConfig::reduction_cols(const cl::Buffer& input_mat, int input_rows, int input_cols) {
+PooledBuffer OpenCLConfig::reduction_cols(const cl::Buffer& input_mat, int input_rows, int input_cols) {
     using CType = typename ArrowType::c_type;
 
     auto reduc_buffers = create_reduction_mat_buffers<ArrowType>(input_rows, input_cols, Reduction::reduction_mat);
@@ -413,7 +1192,7 @@ cl::Buffer OpenCLConfig::reduction_cols(const cl::Buffer& input_mat, int input_r
     auto num_groups = static_cast<int>(std::ceil(static_cast<double>(length) / static_cast<double>(local_size)));
     auto global_size = local_size * num_groups;
 
-    auto res = new_buffer<ArrowType>(input_cols);
+    auto res = temp_buffer<CType>(input_cols);
 
     auto k_reduction = kernel(Reduction::reduction_mat);
     k_reduction.setArg(0, input_mat);
@@ -426,7 +1205,7 @@ cl::Buffer OpenCLConfig::reduction_cols(const cl::Buffer& input_mat, int input_r
         k_reduction.setArg(3, reduc_buffers[0]);
     }
 
-    RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+    RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
         k_reduction, cl::NullRange, cl::NDRange(global_size, input_cols), cl::NDRange(local_size, 1)));
 
     if (num_groups == 1) return res;
@@ -439,7 +1218,7 @@ cl::Buffer OpenCLConfig::reduction_cols(const cl::Buffer& input_mat, int input_r
         k_reduction.setArg(2, cl::Local(local_size * sizeof(CType)));
         k_reduction.setArg(3, reduc_buffers[i + 1]);
 
-        RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+        RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
             k_reduction, cl::NullRange, cl::NDRange(global_size, input_cols), cl::NDRange(local_size, 1)));
         update_reduction_status(length, num_groups, local_size, global_size, device_max_local_size);
     }
@@ -448,7 +1227,7 @@ cl::Buffer OpenCLConfig::reduction_cols(const cl::Buffer& input_mat, int input_r
     k_reduction.setArg(1, static_cast<unsigned int>(length));
     k_reduction.setArg(2, cl::Local(local_size * sizeof(CType)));
     k_reduction.setArg(3, res);
-    RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+    RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
         k_reduction, cl::NullRange, cl::NDRange(global_size, input_cols), cl::NDRange(local_size, 1)));
     return res;
 }
@@ -477,7 +1256,7 @@ void OpenCLConfig::reduction_cols_offset(
         k_reduction.setArg(2, cl::Local(local_size * sizeof(CType)));
         k_reduction.setArg(3, output_vec);
         k_reduction.setArg(4, static_cast<unsigned int>(output_offset));
-        RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+        RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
             k_reduction, cl::NullRange, cl::NDRange(global_size, input_cols), cl::NDRange(local_size, 1)));
     } else {
         auto k_reduction = kernel(Reduction::reduction_mat);
@@ -487,7 +1266,7 @@ void OpenCLConfig::reduction_cols_offset(
         k_reduction.setArg(3, reduc_buffers[0]);
         k_reduction.setArg(4, 0u);
 
-        RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+        RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
             k_reduction, cl::NullRange, cl::NDRange(global_size, input_cols), cl::NDRange(local_size, 1)));
 
         update_reduction_status(length, num_groups, local_size, global_size, device_max_local_size);
@@ -498,7 +1277,7 @@ void OpenCLConfig::reduction_cols_offset(
             k_reduction.setArg(2, cl::Local(local_size * sizeof(CType)));
             k_reduction.setArg(3, reduc_buffers[i + 1]);
 
-            RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+            RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
                 k_reduction, cl::NullRange, cl::NDRange(global_size, input_cols), cl::NDRange(local_size, 1)));
 
             update_reduction_status(length, num_groups, local_size, global_size, device_max_local_size);
@@ -510,7 +1289,7 @@ void OpenCLConfig::reduction_cols_offset(
         k_reduction.setArg(3, output_vec);
         k_reduction.setArg(4, static_cast<unsigned int>(output_offset));
 
-        RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+        RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
             k_reduction, cl::NullRange, cl::NDRange(global_size, input_cols), cl::NDRange(local_size, 1)));
     }
 }
@@ -524,7 +1303,7 @@ void OpenCLConfig::logsumexp_cols_offset(
     logsumexp_coeffs.setArg(0, input_mat);
     logsumexp_coeffs.setArg(1, static_cast<unsigned int>(input_rows));
     logsumexp_coeffs.setArg(2, max_buffer);
-    RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+    RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
         logsumexp_coeffs, cl::NullRange, cl::NDRange(input_rows * input_cols), cl::NullRange));
     sum_cols_offset<ArrowType>(input_mat, input_rows, input_cols, output_vec, static_cast<unsigned int>(output_offset));
 
@@ -533,11 +1312,11 @@ void OpenCLConfig::logsumexp_cols_offset(
     finish_lse.setArg(1, static_cast<unsigned int>(output_offset));
     finish_lse.setArg(2, max_buffer);
     RAISE_ENQUEUEKERNEL_ERROR(
-        m_queue.enqueueNDRangeKernel(finish_lse, cl::NullRange, cl::NDRange(input_cols), cl::NullRange));
+        queue().enqueueNDRangeKernel(finish_lse, cl::NullRange, cl::NDRange(input_cols), cl::NullRange));
 }
 
 template <typename ArrowType>
-cl::Buffer OpenCLConfig::accum_sum_cols(cl::Buffer& mat, int input_rows, int input_cols) {
+PooledBuffer OpenCLConfig::accum_sum_cols(cl::Buffer& mat, int input_rows, int input_cols) {
     using CType = typename ArrowType::c_type;
     auto k_local_size = kernel_local_size(OpenCL_kernel_traits<ArrowType>::accum_sum_mat_cols);
     auto k_local_memory = kernel_local_memory(OpenCL_kernel_traits<ArrowType>::accum_sum_mat_cols);
@@ -549,15 +1328,14 @@ cl::Buffer OpenCLConfig::accum_sum_cols(cl::Buffer& mat, int input_rows, int inp
     auto num_groups = static_cast<int>(std::ceil(static_cast<double>(input_rows) / static_cast<double>(2 * local_wg)));
     auto global_wg = static_cast<int>(std::ceil(static_cast<double>(num_groups * local_wg)));
 
-    auto& opencl = OpenCLConfig::get();
-    auto group_sums = opencl.new_buffer<CType>(num_groups * input_cols);
+    auto group_sums = temp_buffer<CType>(num_groups * input_cols);
 
     auto k_accum_sumexp = kernel(OpenCL_kernel_traits<ArrowType>::accum_sum_mat_cols);
     k_accum_sumexp.setArg(0, mat);
     k_accum_sumexp.setArg(1, static_cast<unsigned int>(input_rows));
     k_accum_sumexp.setArg(2, cl::Local(2 * local_wg * sizeof(CType)));
     k_accum_sumexp.setArg(3, group_sums);
-    RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+    RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
         k_accum_sumexp, cl::NullRange, cl::NDRange(global_wg, input_cols), cl::NDRange(local_wg, 1)));
 
     if (num_groups > 1) {
@@ -570,7 +1348,7 @@ cl::Buffer OpenCLConfig::accum_sum_cols(cl::Buffer& mat, int input_rows, int inp
         k_add_accum_sumexp.setArg(3, static_cast<unsigned int>(2 * local_wg));
         k_add_accum_sumexp.setArg(4, static_cast<unsigned int>(num_groups));
         k_add_accum_sumexp.setArg(5, group_sums);
-        RAISE_ENQUEUEKERNEL_ERROR(m_queue.enqueueNDRangeKernel(
+        RAISE_ENQUEUEKERNEL_ERROR(queue().enqueueNDRangeKernel(
             k_add_accum_sumexp, cl::NullRange, cl::NDRange(input_rows - 2 * local_wg, input_cols), cl::NullRange));
 
         return total_sum;
@@ -0,0 +1,27 @@
+#ifndef PYBNESIAN_PYBINDINGS_BUFFERS_HPP
+#define PYBNESIAN_PYBINDINGS_BUFFERS_HPP
+
+#include <stdexcept>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <Eigen/Dense>
+
+namespace py = pybind11;
+
+namespace pybindings {
+
+// A caller-provided output buffer (the out parameter of logl()): a contiguous and writeable NumPy float64 vector. The
+// out arguments must be declared with noconvert(), so the arrays with other types or layouts are rejected instead of
+// copied, and the result is always written in the memory of the caller.
+using OutputVector = py::array_t<double, py::array::c_style>;
+
+// Returns an Eigen view of the buffer.
+inline Eigen::Map<Eigen::VectorXd> output_vector_map(OutputVector& out) {
+    if (out.ndim() != 1) throw std::invalid_argument("The output buffer must be a vector.");
+    if (!out.writeable()) throw std::invalid_argument("The output buffer must be writeable.");
+    return Eigen::Map<Eigen::VectorXd>(out.mutable_data(), out.shape(0));
+}
+
+}  // namespace pybindings
+
+#endif  // PYBNESIAN_PYBINDINGS_BUFFERS_HPP
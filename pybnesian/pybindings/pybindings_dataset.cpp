@@ -1,11 +1,16 @@
 #include <pybind11/stl.h>
+#include <pybind11/eigen.h>
+#include <dataset/chunked_dataframe.hpp>
+#include <dataset/covariance_registry.hpp>
 #include <dataset/crossvalidation_adaptator.hpp>
 #include <dataset/holdout_adaptator.hpp>
+#include <dataset/shared_dataframe.hpp>
 #include <dataset/dynamic_dataset.hpp>
+#include <factors/discrete/discrete_indices.hpp>
 #include <util/util_types.hpp>
 
-using dataset::DataFrame, dataset::CrossValidation, dataset::HoldOut, dataset::DynamicDataFrame,
-    dataset::DynamicVariable;
+using dataset::DataFrame, dataset::ChunkedDataFrame, dataset::CrossValidation, dataset::HoldOut,
+    dataset::DynamicDataFrame, dataset::DynamicVariable, dataset::SharedDataFrame;
 
 using util::random_seed_arg;
 
@@ -143,6 +148,207 @@ Gets the training data.
 Gets the test data.
 
 :returns: Test data.
+)doc");
+
+    root.def("read_ipc", &dataset::read_ipc, py::arg("path"), py::arg("columns") = std::vector<std::string>{}, R"doc(
+Reads an Arrow IPC file (also known as Feather v2). The file is memory-mapped, so the data is not copied to memory if
+the file is uncompressed and contains a single record batch. Then, the data is loaded from the disk on demand, so the
+learning algorithms can be used with datasets larger than the memory.
+
+:param path: Path of the file.
+:param columns: Names of the columns to read. If empty, all the columns are read.
+:returns: A :class:`DataFrame` with the selected columns.
+)doc");
+
+    root.def("read_parquet",
+             &dataset::read_parquet,
+             py::arg("path"),
+             py::arg("columns") = std::vector<std::string>{},
+             py::arg("row_groups") = std::vector<int>{},
+             R"doc(
+Reads a Parquet file. Only the selected columns are read and decoded.
+
+Unlike :func:`read_ipc`, this is an eager loader: the Parquet data is encoded (and usually compressed), so the selected
+columns of the selected row groups are decoded into memory when the function is called. A file larger than the memory
+can be processed by row groups, reading a subset of the row groups (see
+:attr:`pyarrow.parquet.ParquetFile.num_row_groups`) in each call.
+
+:param path: Path of the file.
+:param columns: Names of the columns to read. If empty, all the columns are read.
+:param row_groups: Indices of the row groups to read, in the order they are returned. If empty, all the row groups are
+                   read.
+:returns: A :class:`DataFrame` with the selected columns of the selected row groups.
+)doc");
+
+    root.def("write_ipc", &dataset::write_ipc, py::arg("df"), py::arg("path"), R"doc(
+Writes a :class:`DataFrame` in an uncompressed Arrow IPC file with a single record batch, so :func:`read_ipc`
+memory-maps its columns without copying them.
+
+:param df: A :class:`DataFrame`.
+:param path: Path of the file.
+)doc");
+
+    py::class_<SharedDataFrame, std::shared_ptr<SharedDataFrame>>(root, "SharedDataFrame", R"doc(
+A :class:`DataFrame` exported to an Arrow IPC file that is memory-mapped by every process that uses it. By default, the
+file is created in the shared memory of the operating system (``/dev/shm``), so the data is never written to the disk.
+
+The pickles of a :class:`SharedDataFrame` only contain the path of the file, so the worker processes of
+``multiprocessing`` attach to the same memory instead of receiving a copy of the data. The scores, independence tests
+and models built with :func:`SharedDataFrame.dataframe` in a worker use the shared memory directly.
+
+The process that creates the :class:`SharedDataFrame` owns the file, and removes it when the :class:`SharedDataFrame`
+is destroyed or :func:`SharedDataFrame.unlink` is called. Keep it alive until all the workers attached to it.
+)doc")
+        .def(py::init<const DataFrame&, const std::optional<std::string>&>(),
+             py::arg("df"),
+             py::arg("path") = std::nullopt,
+             R"doc(
+Exports a :class:`DataFrame` to a shared file.
+
+:param df: A :class:`DataFrame`.
+:param path: Path of the file. If ``None``, a new file is created in the shared memory of the operating system.
+:raises ValueError: If the file already exists.
+)doc")
+        .def_static("attach", &SharedDataFrame::attach, py::arg("path"), R"doc(
+Attaches to a file exported by another :class:`SharedDataFrame`. The returned :class:`SharedDataFrame` does not own the
+file. Unpickling a :class:`SharedDataFrame` also attaches to its file.
+
+:param path: Path of the file.
+:returns: The attached :class:`SharedDataFrame`.
+:raises ValueError: If the file does not exist.
+)doc")
+        .def("path", &SharedDataFrame::path, R"doc(
+Gets the path of the shared file.
+
+:returns: The path of the file.
+)doc")
+        .def("owner", &SharedDataFrame::owner, R"doc(
+Checks whether this :class:`SharedDataFrame` removes the file when it is destroyed. Only the process that created the
+:class:`SharedDataFrame` owns the file (the processes forked from it do not).
+
+:returns: True if this :class:`SharedDataFrame` owns the file, False otherwise.
+)doc")
+        .def("dataframe", &SharedDataFrame::dataframe, R"doc(
+Gets the :class:`DataFrame` backed by the memory-mapped file. The data is not copied.
+
+:returns: The shared :class:`DataFrame`.
+)doc")
+        .def("unlink", &SharedDataFrame::unlink, R"doc(
+Removes the shared file. The DataFrames already attached keep their data, but the file cannot be attached again.
+)doc")
+        .def(py::pickle([](const SharedDataFrame& self) { return self.__getstate__(); },
+                        [](py::tuple t) { return SharedDataFrame::__setstate__(t); }));
+
+    root.def(
+        "covariance_registry_size",
+        []() { return dataset::CovarianceRegistry::get().size(); },
+        R"doc(
+Returns the number of cached covariances of the covariance registry. The registry caches the covariances between the
+pairs of continuous columns without null values, so the bandwidth selectors (such as
+:class:`NormalReferenceRule <pybnesian.NormalReferenceRule>`) and the :class:`LinearCorrelation
+<pybnesian.LinearCorrelation>` test read them instead of the data when the same columns are used again. The columns are
+shared by the DataFrames that contain them, including the training data of each fold of a
+:class:`CrossValidation`. The hits and misses of the registry are recorded by the profiler in
+``"covariance_registry:hit"`` and ``"covariance_registry:miss"``.
+
+:returns: Number of cached covariances.
+)doc");
+
+    root.def(
+        "clear_covariance_registry",
+        []() { dataset::CovarianceRegistry::get().clear(); },
+        R"doc(
+Removes all the cached covariances of the covariance registry (see :func:`covariance_registry_size`).
+)doc");
+
+    py::class_<ChunkedDataFrame>(root, "ChunkedDataFrame", R"doc(
+A pyarrow Table with chunked columns (as read from Parquet files or Arrow datasets) that is processed in batches, so its
+chunks are not concatenated into one :class:`DataFrame`. Each batch contains consecutive rows that end at the chunk
+boundaries of every column, and it does not copy the data.
+)doc")
+        .def(py::init<std::shared_ptr<arrow::Table>>(), py::arg("table"), R"doc(
+Creates a :class:`ChunkedDataFrame` from a pyarrow Table.
+
+:param table: A pyarrow Table.
+)doc")
+        .def(py::init<const DataFrame&>(), py::arg("df"), R"doc(
+Creates a :class:`ChunkedDataFrame` with a single batch.
+
+:param df: A :class:`DataFrame`.
+)doc")
+        .def("table", &ChunkedDataFrame::table, R"doc(
+Gets the pyarrow Table.
+
+:returns: The pyarrow Table of the :class:`ChunkedDataFrame`.
+)doc")
+        .def("num_rows", &ChunkedDataFrame::num_rows, R"doc(
+Gets the number of rows.
+
+:returns: Number of rows.
+)doc")
+        .def("num_columns", &ChunkedDataFrame::num_columns, R"doc(
+Gets the number of columns.
+
+:returns: Number of columns.
+)doc")
+        .def("column_names", &ChunkedDataFrame::column_names, R"doc(
+Gets the names of the columns.
+
+:returns: Names of the columns.
+)doc")
+        .def("num_batches", &ChunkedDataFrame::num_batches, R"doc(
+Gets the number of batches.
+
+:returns: Number of batches.
+)doc")
+        .def("batch", &ChunkedDataFrame::batch, py::arg("index"), R"doc(
+Gets a batch.
+
+:param index: Index of the batch.
+:returns: A :class:`DataFrame` with the rows of the batch.
+)doc")
+        .def("means", &ChunkedDataFrame::means, py::arg("columns"), R"doc(
+Computes the mean of each column, ignoring its null values. The means are accumulated over the batches.
+
+:param columns: Names of "double" or "float" columns.
+:returns: A numpy array with the mean of each column.
+)doc")
+        .def("sse", &ChunkedDataFrame::sse, py::arg("columns"), R"doc(
+Computes the sum of squared errors matrix of the columns, in the rows where all the columns are not null. The sum of
+squared errors of the batches are merged with a numerically stable update.
+
+:param columns: Names of "double" or "float" columns.
+:returns: A numpy matrix with the sum of squared errors.
+)doc")
+        .def("cov", &ChunkedDataFrame::cov, py::arg("columns"), R"doc(
+Computes the covariance matrix of the columns, in the rows where all the columns are not null. See
+:func:`ChunkedDataFrame.sse`.
+
+:param columns: Names of "double" or "float" columns.
+:returns: A numpy matrix with the covariance.
+)doc")
+        .def(
+            "joint_counts",
+            [](const ChunkedDataFrame& self, const std::string& variable, const std::vector<std::string>& evidence) {
+                return factors::discrete::joint_counts(self, variable, evidence);
+            },
+            py::arg("variable"),
+            py::arg("evidence") = std::vector<std::string>{},
+            R"doc(
+Counts the joint configurations of a categorical variable and its evidence. The counts of the batches are accumulated.
+The chunks of each column must have the same categories.
+
+:param variable: Name of a categorical column.
+:param evidence: Names of categorical columns.
+:returns: A tuple (cardinality, counts). The count of the configuration with category indices
+    (i_0, i_1, ..., i_n) of (variable, evidence) is at position i_0 + cardinality[0]*i_1 +
+    cardinality[0]*cardinality[1]*i_2 + ...
+)doc")
+        .def("combine", &ChunkedDataFrame::combine, R"doc(
+Concatenates the chunks of the columns into a single :class:`DataFrame`. This copies the data of the columns with more
+than one chunk.
+
+:returns: A :class:`DataFrame` with all the rows.
 )doc");
 
     py::class_<DynamicVariable<int>>(root, "DynamicVariable<int>")
@@ -11,6 +11,7 @@
 #include <factors/discrete/DiscreteFactor.hpp>
 #include <factors/factors.hpp>
 #include <models/BayesianNetwork.hpp>
+#include <pybindings/pybindings_buffers.hpp>
 #include <util/util_types.hpp>
 
 namespace py = pybind11;
@@ -23,6 +24,7 @@ using factors::FactorType, factors::continuous::LinearGaussianCPDType, factors::
 
 using factors::Assignment, factors::AssignmentValue, factors::AssignmentHash;
 using models::BayesianNetworkBase, models::ConditionalBayesianNetworkBase;
+using pybindings::OutputVector, pybindings::output_vector_map;
 using util::random_seed_arg;
 
 class PyFactorType : public FactorType {
@@ -185,6 +187,14 @@ public:
 
     void fit(const DataFrame& df) override { PYBIND11_OVERRIDE_PURE(void, Factor, fit, df); }
 
+    void partial_fit(const DataFrame& df, double forgetting = 1) override {
+        PYBIND11_OVERRIDE(void, Factor, partial_fit, df, forgetting);
+    }
+
+    void weighted_fit(const DataFrame& df, const VectorXd& weights) override {
+        PYBIND11_OVERRIDE(void, Factor, weighted_fit, df, weights);
+    }
+
     VectorXd logl(const DataFrame& df) const override { PYBIND11_OVERRIDE_PURE(VectorXd, Factor, logl, df); }
 
     double slogl(const DataFrame& df) const override { PYBIND11_OVERRIDE_PURE(double, Factor, slogl, df); }
@@ -417,17 +427,59 @@ Fits the :class:`Factor` with the data in ``df``.
 
 :param df: DataFrame to fit the :class:`Factor`.
 )doc")
-        .def("logl",
-             &Factor::logl,
-             py::arg("df"),
-             R"doc(
+        .def("partial_fit", &Factor::partial_fit, py::arg("df"), py::arg("forgetting") = 1., R"doc(
+Updates the parameters of the :class:`Factor` with the data in ``df``, keeping sufficient statistics of all the data
+seen by :func:`Factor.partial_fit`. Each call costs time proportional to the rows of ``df``, so a model can be updated
+with new batches of data without fitting it again with all the data. An unfitted :class:`Factor` is fitted with the
+first ``df``.
+
+The statistics of the previous data are multiplied by ``forgetting`` before ``df`` is added, so the old data is
+forgotten exponentially. If ``forgetting`` is 1, the parameters are equal to the parameters fitted by
+:func:`Factor.fit` with all the data, up to rounding errors.
+
+:class:`LinearGaussianCPD`, :class:`CLinearGaussianCPD` and :class:`DiscreteFactor` implement
+:func:`Factor.partial_fit`. The sufficient statistics are saved when the :class:`Factor` is pickled, but they are not
+saved in the binary format.
+
+:param df: DataFrame with the new data.
+:param forgetting: A value in (0, 1] that multiplies the statistics of the previous data.
+:raises ValueError: If the :class:`Factor` was fitted with :func:`Factor.fit`, so it does not have sufficient
+                    statistics, or it does not implement :func:`Factor.partial_fit`.
+)doc")
+        .def("weighted_fit", &Factor::weighted_fit, py::arg("df"), py::arg("weights"), R"doc(
+Fits the :class:`Factor` with the rows of ``df`` weighted by ``weights``. The weights are frequency weights: an integer
+weight is equivalent to repeating the row that number of times, so a bootstrap resample of ``df`` can be fitted with the
+number of times each row is drawn instead of a copy of the data.
+
+:class:`LinearGaussianCPD` and :class:`DiscreteFactor` implement :func:`Factor.weighted_fit`.
+
+:param df: DataFrame to fit the :class:`Factor`.
+:param weights: A numpy.ndarray with a finite and non-negative weight for each row of ``df``.
+:raises ValueError: If the number of weights is not the number of rows of ``df``, some weight is negative or not
+                    finite, or the :class:`Factor` does not implement :func:`Factor.weighted_fit`.
+)doc")
+        .def(
+            "logl",
+            [](const Factor& self, const DataFrame& df, std::optional<OutputVector> out) -> py::object {
+                if (!out) return py::cast(self.logl(df));
+
+                auto out_map = output_vector_map(*out);
+                self.logl_into(df, out_map);
+                return *out;
+            },
+            py::arg("df"),
+            py::arg("out").noconvert() = std::nullopt,
+            R"doc(
 Returns the log-likelihood of each instance in the DataFrame ``df``.
 
 :param df: DataFrame to compute the log-likelihood.
+:param out: A contiguous and writeable :class:`numpy.ndarray` vector with dtype :class:`numpy.float64` and one element
+            for each instance of ``df``. If given, the log-likelihood is stored in ``out`` without allocating a new
+            array, and ``out`` is returned.
 :returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64`, where the i-th value is the log-likelihod
           of the i-th instance of ``df``.
-)doc",
-             py::return_value_policy::take_ownership)
+:raises ValueError: If ``out`` is not a writeable vector with one element for each instance of ``df``.
+)doc")
         .def("slogl", &Factor::slogl, py::arg("df"), R"doc(
 Returns the sum of the log-likelihood of each instance in the DataFrame ``df``. That is, the sum of the result of
 :func:`Factor.logl`.
@@ -459,6 +511,13 @@ evidence variable. Each sampled instance must be conditioned on ``evidence_value
 :param n: Number of instances to sample.
 :param evidence_values: DataFrame of evidence values to condition the sampling.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
+)doc")
+        .def("memory_usage", &Factor::memory_usage, R"doc(
+Returns the memory used by the fitted parameters and the training data of the :class:`Factor` (e.g., the coefficients
+of a :class:`LinearGaussianCPD`, the probability table of a :class:`DiscreteFactor` or the training data of a
+:class:`CKDE`, in the host or in the OpenCL device). The factors implemented in Python return an empty report.
+
+:returns: A :class:`MemoryUsage <pybnesian.MemoryUsage>`.
 )doc")
         .def("save", &Factor::save, py::arg("filename"), R"doc(
 Saves the :class:`Factor` in a pickle file with the given name.
@@ -590,29 +649,46 @@ A conditional kernel density estimator (CKDE) is the ratio of two KDE models:
 
 where :math:`\hat{f}_{K}` is a :class:`KDE` estimation.
 )doc")
-        .def(py::init<std::string, std::vector<std::string>>(),
+        .def(py::init<std::string, std::vector<std::string>, double>(),
              py::arg("variable"),
              py::arg("evidence"),
+             py::arg("relative_error") = 0.,
              R"doc(
 Initializes a new :class:`CKDE` with a given ``variable`` and ``evidence``.
 
 :param variable: Variable name.
 :param evidence: List of evidence variable names.
+:param relative_error: If positive, the log-likelihood of the joint and marginal :class:`KDE` models is approximated
+                       with a relative error bound (see :class:`KDE`). If 0, the log-likelihood is exact.
 )doc")
         .def(py::init<>([](std::string variable,
                            std::vector<std::string> evidence,
-                           std::shared_ptr<BandwidthSelector> bandwidth_selector) {
-                 return CKDE(variable, evidence, BandwidthSelector::keep_python_alive(bandwidth_selector));
+                           std::shared_ptr<BandwidthSelector> bandwidth_selector,
+                           double relative_error) {
+                 return CKDE(
+                     variable, evidence, BandwidthSelector::keep_python_alive(bandwidth_selector), relative_error);
              }),
              py::arg("variable"),
              py::arg("evidence"),
              py::arg("bandwidth_selector"),
+             py::arg("relative_error") = 0.,
              R"doc(
 Initializes a new :class:`CKDE` with a given ``variable`` and ``evidence``.
 
 :param variable: Variable name.
 :param evidence: List of evidence variable names.
 :param bandwidth_selector: Procedure to fit the bandwidth.
+:param relative_error: If positive, the log-likelihood of the joint and marginal :class:`KDE` models is approximated
+                       with a relative error bound (see :class:`KDE`). If 0, the log-likelihood is exact.
+)doc")
+        .def_property_readonly("relative_error", &CKDE::relative_error, R"doc(
+The relative error bound of the approximate log-likelihood, or 0 if the log-likelihood is exact.
+)doc")
+        .def("out_of_core", &CKDE::out_of_core, R"doc(
+Checks whether the training instances are kept in the host memory and streamed to the OpenCL device when the model is
+evaluated (see :func:`set_opencl_training_block_rows <pybnesian.set_opencl_training_block_rows>`).
+
+:returns: True if the training instances are streamed, False otherwise.
 )doc")
         .def("num_instances", &CKDE::num_instances, R"doc(
 Gets the number of training instances (:math:`N`).
@@ -635,6 +711,24 @@ Returns the cumulative distribution function values of each instance in the Data
 :param df: DataFrame to compute the log-likelihood.
 :returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64`, where the i-th value is the cumulative
           distribution function value of the i-th instance of ``df``.
+)doc")
+        .def(
+            "logl_grid",
+            [](const CKDE& self, const VectorXd& values, std::optional<DataFrame> evidence) {
+                return self.logl_grid(values, evidence ? *evidence : DataFrame(1));
+            },
+            py::arg("values"),
+            py::arg("evidence") = std::nullopt,
+            R"doc(
+Returns the conditional log-likelihood of each value of the variable given each row of ``evidence``, that is, the
+log-likelihood of the Cartesian product of ``values`` and the ``evidence`` rows. The kernel terms of each evidence row
+are computed once for all the values, so this is faster than calling :func:`CKDE.logl` over the Cartesian product.
+
+:param values: A :class:`numpy.ndarray` vector with the values of the variable (e.g., a grid for plotting).
+:param evidence: A DataFrame with the evidence variables. If the CKDE has no evidence, it can be ``None``.
+:returns: A :class:`numpy.ndarray` matrix where the value ``[i, j]`` is the conditional log-likelihood of
+          ``values[j]`` given the i-th row of ``evidence``. The rows with null evidence values are NaN. If the CKDE
+          has no evidence, each row is the marginal log-likelihood of ``values``.
 )doc")
         .def(py::pickle([](const CKDE& self) { return self.__getstate__(); },
                         [](py::tuple t) { return CKDE::__setstate__(t); }));
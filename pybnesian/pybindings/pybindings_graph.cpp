@@ -1168,6 +1168,24 @@ Adds an arc between the nodes ``source`` and ``target``. If the arc already exis
 
 :param source: A node name or index.
 :param target: A node name or index.
+)doc")
+            .def(
+                "add_arcs",
+                [](Dag& self, const std::vector<graph::Arc>& arcs) { self.add_arcs(arcs); },
+                py::arg("arcs"))
+            .def(
+                "add_arcs",
+                [](Dag& self, const ArcStringVector& arcs) { self.add_arcs(arcs); },
+                py::arg("arcs"),
+                R"doc(
+add_arcs(self: pybnesian.Dag, arcs: List[Tuple[int, int]] or List[Tuple[str, str]]) -> None
+
+Adds a list of arcs. The acyclicity is checked once for all the arcs, so it is faster than calling
+:func:`Dag.add_arc` for each arc. The arcs that already exist are ignored. If the arcs would create a cycle, the graph
+is left unaffected.
+
+:param arcs: A list of arcs, given as tuples of node names or indices.
+:raises RuntimeError: If the arcs would create a cycle.
 )doc")
             .def(
                 "flip_arc",
@@ -1414,6 +1432,24 @@ Adds an arc between the nodes ``source`` and ``target``. If the arc already exis
 
 :param source: A node name or index.
 :param target: A node name or index.
+)doc")
+            .def(
+                "add_arcs",
+                [](ConditionalDag& self, const std::vector<graph::Arc>& arcs) { self.add_arcs(arcs); },
+                py::arg("arcs"))
+            .def(
+                "add_arcs",
+                [](ConditionalDag& self, const ArcStringVector& arcs) { self.add_arcs(arcs); },
+                py::arg("arcs"),
+                R"doc(
+add_arcs(self: pybnesian.ConditionalDag, arcs: List[Tuple[int, int]] or List[Tuple[str, str]]) -> None
+
+Adds a list of arcs. The acyclicity is checked once for all the arcs, so it is faster than calling
+:func:`ConditionalDag.add_arc` for each arc. The arcs that already exist are ignored. If the arcs would create a cycle,
+the graph is left unaffected.
+
+:param arcs: A list of arcs, given as tuples of node names or indices.
+:raises RuntimeError: If the arcs would create a cycle.
 )doc")
             .def(
                 "flip_arc",
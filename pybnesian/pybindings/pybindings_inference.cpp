@@ -0,0 +1,323 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/eigen.h>
+#include <inference/DiscreteInference.hpp>
+#include <inference/GaussianInference.hpp>
+#include <inference/ImportanceSampling.hpp>
+#include <util/parallel.hpp>
+#include <util/util_types.hpp>
+
+namespace py = pybind11;
+
+using inference::DiscreteInference, inference::GaussianInference, inference::ImportanceSampling,
+    inference::WeightedSampleStream, inference::WeightedSamples;
+using util::random_seed_arg;
+
+// Returns the joint posterior of DiscreteInference::query() as a numpy.ndarray with one dimension for each variable.
+py::array_t<double> joint_posterior_array(const DiscreteInference& self,
+                                          const std::vector<std::string>& variables,
+                                          const VectorXd& posterior) {
+    std::vector<size_t> shape, strides;
+    shape.reserve(variables.size());
+    strides.reserve(variables.size());
+
+    size_t stride = sizeof(double);
+    for (const auto& v : variables) {
+        shape.push_back(self.categories(v).size());
+        strides.push_back(stride);
+        stride *= shape.back();
+    }
+
+    // https://github.com/pybind/pybind11/issues/1429
+    return py::array_t<double>(py::buffer_info(const_cast<double*>(posterior.data()),
+                                               sizeof(double),
+                                               py::format_descriptor<double>::format(),
+                                               variables.size(),
+                                               shape,
+                                               strides));
+}
+
+void pybindings_inference(py::module& root) {
+    py::class_<DiscreteInference>(root, "DiscreteInference", R"doc(
+Exact inference on a fitted Bayesian network where all the CPDs are :class:`DiscreteFactor <pybnesian.DiscreteFactor>`
+(e.g., a :class:`DiscreteBN <pybnesian.DiscreteBN>`).
+
+The joint posteriors are computed with variable elimination, where the nodes that are not ancestors of the query or the
+evidence are removed first. The marginal posteriors are computed with a junction tree that is compiled when the object
+is created. The junction tree calibrated without evidence is cached.
+
+The object does not change if the model is modified or fitted again.
+)doc")
+        .def(py::init<const BayesianNetworkBase&>(), py::arg("model"), R"doc(
+Compiles the junction tree of a fitted model.
+
+:param model: A fitted Bayesian network with :class:`DiscreteFactor <pybnesian.DiscreteFactor>` CPDs.
+:raises ValueError: If the model is not fitted or a CPD is not a :class:`DiscreteFactor <pybnesian.DiscreteFactor>`.
+)doc")
+        .def("nodes", &DiscreteInference::nodes, R"doc(
+Gets the nodes of the model.
+
+:returns: Nodes of the model.
+)doc")
+        .def("categories", &DiscreteInference::categories, py::arg("node"), R"doc(
+Gets the categories of a node, in the order of the posterior probabilities.
+
+:param node: A node name.
+:returns: The categories of ``node``.
+)doc")
+        .def("cliques", &DiscreteInference::cliques, R"doc(
+Gets the cliques of the junction tree.
+
+:returns: A list with the nodes of each clique.
+)doc")
+        .def(
+            "query",
+            [](const DiscreteInference& self,
+               const std::vector<std::string>& variables,
+               const std::unordered_map<std::string, std::string>& evidence) {
+                return joint_posterior_array(self, variables, self.query(variables, evidence));
+            },
+            py::arg("variables"),
+            py::arg("evidence") = std::unordered_map<std::string, std::string>{},
+            R"doc(
+Computes the joint posterior ``P(variables | evidence)`` with variable elimination.
+
+:param variables: List of query variables.
+:param evidence: A dict with the observed category of each evidence variable.
+:returns: A :class:`numpy.ndarray` with one dimension for each query variable, where the value
+          ``[i_1, ..., i_k]`` is the posterior probability of the ``i_j``-th category of each variable (see
+          :func:`DiscreteInference.categories`). If the evidence has probability 0, the values are NaN.
+:raises ValueError: If a variable is not in the model or a category is not valid.
+)doc")
+        .def("marginal",
+             &DiscreteInference::marginal,
+             py::arg("variable"),
+             py::arg("evidence") = std::unordered_map<std::string, std::string>{},
+             R"doc(
+Computes the marginal posterior ``P(variable | evidence)`` with the junction tree.
+
+:param variable: A query variable.
+:param evidence: A dict with the observed category of each evidence variable.
+:returns: A :class:`numpy.ndarray` vector with the posterior probability of each category of ``variable``. If the
+          evidence has probability 0, the values are NaN.
+:raises ValueError: If a variable is not in the model or a category is not valid.
+)doc")
+        .def(
+            "query_batch",
+            [](const DiscreteInference& self, const std::vector<std::string>& variables, const DataFrame& evidence) {
+                auto marginals = self.query_batch(variables, evidence);
+
+                py::dict result;
+                for (size_t i = 0; i < variables.size(); ++i) {
+                    result[py::str(variables[i])] = py::cast(std::move(marginals[i]));
+                }
+                return result;
+            },
+            py::arg("variables"),
+            py::arg("evidence"),
+            R"doc(
+Computes the marginal posterior of each variable for each row of the DataFrame ``evidence``. The junction tree is
+calibrated once for each distinct row of evidence.
+
+:param variables: List of query variables.
+:param evidence: A DataFrame with a categorical column for each evidence variable. The null values are not observed.
+:returns: A dict with a :class:`numpy.ndarray` matrix for each query variable, where the ``i``-th row is the marginal
+          posterior given the ``i``-th row of ``evidence``.
+:raises ValueError: If a column is not a node of the model or its categories are not the categories of the node.
+)doc");
+
+    py::class_<GaussianInference>(root, "GaussianInference", R"doc(
+Exact inference on a fitted Bayesian network where all the CPDs are
+:class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>` (e.g., a :class:`GaussianNetwork <pybnesian.GaussianNetwork>`).
+
+The network is compiled into its joint multivariate normal distribution, computed from the coefficients and variances
+of the CPDs in topological order. A query conditions the joint distribution on the evidence with Schur complements. The
+Cholesky decomposition of the covariance of the evidence is cached for each set of evidence variables (up to 64 sets),
+so the queries with the same evidence variables reuse it.
+
+The object does not change if the model is modified or fitted again.
+)doc")
+        .def(py::init<const BayesianNetworkBase&>(), py::arg("model"), R"doc(
+Compiles the joint multivariate normal distribution of a fitted model.
+
+:param model: A fitted Bayesian network with :class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>` CPDs.
+:raises ValueError: If the model is not fitted or a CPD is not a
+                    :class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>`.
+)doc")
+        .def("nodes", &GaussianInference::nodes, R"doc(
+Gets the nodes of the model.
+
+:returns: Nodes of the model.
+)doc")
+        .def("mean", &GaussianInference::mean, R"doc(
+Gets the mean vector of the joint distribution.
+
+:returns: The mean of each node, in the order of :func:`GaussianInference.nodes`.
+)doc")
+        .def("covariance", &GaussianInference::covariance, R"doc(
+Gets the covariance matrix of the joint distribution.
+
+:returns: The covariance matrix of the nodes, in the order of :func:`GaussianInference.nodes`.
+)doc")
+        .def("query",
+             &GaussianInference::query,
+             py::arg("variables"),
+             py::arg("evidence") = std::unordered_map<std::string, double>{},
+             R"doc(
+Computes the posterior ``P(variables | evidence)``, that is a multivariate normal distribution.
+
+:param variables: List of query variables.
+:param evidence: A dict with the observed value of each evidence variable.
+:returns: A tuple ``(mean, covariance)`` with the mean vector and the covariance matrix of the posterior.
+:raises ValueError: If a variable is not in the model or it is both in the query and the evidence.
+)doc")
+        .def("query_batch", &GaussianInference::query_batch, py::arg("variables"), py::arg("evidence"), R"doc(
+Computes the posterior ``P(variables | evidence)`` for each row of the DataFrame ``evidence``. The covariance of the
+posterior does not depend on the values of the evidence, so the posterior is solved once for all the rows.
+
+:param variables: List of query variables.
+:param evidence: A DataFrame with a continuous column for each evidence variable, without null values.
+:returns: A tuple ``(means, covariance)``, where the ``i``-th row of the matrix ``means`` is the posterior mean given
+          the ``i``-th row of ``evidence`` and ``covariance`` is the posterior covariance of all the rows.
+        :raises ValueError: If a column is not a node of the model, it is not continuous or it contains null values.
+)doc")
+        .def("conditional_logl",
+             &GaussianInference::conditional_logl,
+             py::arg("variables"),
+             py::arg("df"),
+             R"doc(
+Computes the log-density of ``P(variables | evidence)`` for each row of the DataFrame ``df``, where the evidence are the
+columns of ``df`` that are not in ``variables``.
+
+:param variables: List of query variables.
+:param df: A DataFrame with a continuous column for each query and evidence variable, without null values.
+:returns: A numpy.ndarray with the log-density of each row.
+:raises ValueError: If a column is not a node of the model, it is not continuous or it contains null values.
+)doc");
+
+    py::class_<ImportanceSampling>(root, "ImportanceSampling", R"doc(
+Approximate inference on a fitted Bayesian network with importance sampling, for any type of CPDs (e.g., a
+:class:`CLGNetwork <pybnesian.CLGNetwork>` or a :class:`SemiparametricBN <pybnesian.SemiparametricBN>`).
+
+The nodes that are not observed are sampled from a proposal network (with the evidence nodes fixed to their observed
+values) and each sample is weighted by the ratio of the densities of the model and the proposal. If the proposal is the
+model, this is likelihood weighting: the weight of a sample is the likelihood of the evidence given its parents.
+
+The posterior expectation of a function ``f`` is estimated with ``np.average(f(samples), weights=np.exp(log_weights -
+log_weights.max()))``.
+
+The instances are sampled in blocks of 4096 rows, and each block has a different seed, so the samples do not depend on
+the number of threads. The CPDs are shared with the networks, so the networks should not be fitted again while the
+object is used.
+)doc")
+        .def(py::init<const BayesianNetworkBase&>(), py::arg("model"), py::keep_alive<1, 2>(), R"doc(
+Initializes a likelihood weighting sampler.
+
+:param model: A fitted Bayesian network.
+:raises ValueError: If the model is not fitted or it is a conditional Bayesian network.
+)doc")
+        .def(py::init<const BayesianNetworkBase&, const BayesianNetworkBase&>(),
+             py::arg("model"),
+             py::arg("proposal"),
+             py::keep_alive<1, 2>(),
+             py::keep_alive<1, 3>(),
+             R"doc(
+Initializes an importance sampler with a proposal network.
+
+:param model: A fitted Bayesian network.
+:param proposal: A fitted Bayesian network with the same nodes as ``model``. Its CPDs should not have lighter tails
+                 than the posterior, so that the weights have finite variance.
+:raises ValueError: If a network is not fitted, it is a conditional Bayesian network or the nodes are different.
+)doc")
+        .def_property_readonly("likelihood_weighting", &ImportanceSampling::likelihood_weighting, R"doc(
+True if the proposal is the model.
+)doc")
+        .def(
+            "sample",
+            [](const ImportanceSampling& self,
+               int n,
+               const DataFrame& evidence,
+               std::optional<unsigned int> seed,
+               int num_threads) {
+                WeightedSamples res;
+                {
+                    util::gil_release_if_held release(!self.has_python_derived());
+                    res = self.sample(n, evidence, random_seed_arg(seed), num_threads);
+                }
+                return py::make_tuple(res.samples, std::move(res.log_weights));
+            },
+            py::arg("n"),
+            py::arg("evidence"),
+            py::arg("seed") = std::nullopt,
+            py::arg("num_threads") = 1,
+            R"doc(
+Samples ``n`` weighted instances given the evidence.
+
+:param n: Number of instances to sample.
+:param evidence: A DataFrame with one row and a column with the observed value of each evidence node. The discrete
+                 columns must be categorical, and their value must be a category of the node in the model (the
+                 categories of the column may be a subset of the model categories).
+:param seed: A random seed number. If not specified or ``None``, a random seed is generated.
+:param num_threads: Number of threads that sample the blocks of instances in parallel. If 0, the hardware concurrency
+                    is used.
+:returns: A tuple ``(samples, log_weights)``, where ``samples`` is a :class:`pyarrow.RecordBatch` with the nodes that
+          are not observed and ``log_weights`` is a :class:`numpy.ndarray` with the logarithm of the unnormalized
+          weight of each instance. The instances with a null density in the model have weight ``-inf``.
+:raises ValueError: If the evidence does not have one row, it contains null values or a column is not a node.
+)doc")
+        .def(
+            "stream",
+            [](const ImportanceSampling& self,
+               const DataFrame& evidence,
+               int batch_size,
+               double min_ess,
+               int max_samples,
+               std::optional<unsigned int> seed,
+               int num_threads) {
+                return self.stream(evidence, batch_size, min_ess, max_samples, random_seed_arg(seed), num_threads);
+            },
+            py::arg("evidence"),
+            py::arg("batch_size") = ImportanceSampling::block_rows,
+            py::arg("min_ess") = std::numeric_limits<double>::infinity(),
+            py::arg("max_samples") = 1000000,
+            py::arg("seed") = std::nullopt,
+            py::arg("num_threads") = 1,
+            py::keep_alive<0, 1>(),
+            R"doc(
+Returns an iterator over batches of weighted instances given the evidence. The iteration stops when the effective
+sample size of all the returned instances, ``(sum of weights)^2 / (sum of squared weights)``, reaches ``min_ess``, or
+when ``max_samples`` instances have been sampled.
+
+:param evidence: A DataFrame with one row and a column with the observed value of each evidence node (see
+                 :func:`ImportanceSampling.sample`).
+:param batch_size: Number of instances of each batch.
+:param min_ess: Effective sample size that stops the iteration.
+:param max_samples: Maximum number of sampled instances.
+:param seed: A random seed number. If not specified or ``None``, a random seed is generated.
+:param num_threads: Number of threads that sample each batch. If 0, the hardware concurrency is used.
+:returns: A :class:`WeightedSampleStream` that returns tuples ``(samples, log_weights)`` as
+          :func:`ImportanceSampling.sample`.
+:raises ValueError: If the evidence is not valid, or ``batch_size`` or ``max_samples`` are not positive.
+)doc");
+
+    py::class_<WeightedSampleStream>(root, "WeightedSampleStream", R"doc(
+Iterator over batches of weighted instances returned by :func:`ImportanceSampling.stream`.
+)doc")
+        .def("__iter__", [](WeightedSampleStream& self) -> WeightedSampleStream& { return self; })
+        .def("__next__",
+             [](WeightedSampleStream& self) {
+                 std::optional<WeightedSamples> batch;
+                 {
+                     util::gil_release_if_held release(!self.has_python_derived());
+                     batch = self.next();
+                 }
+                 if (!batch) throw py::stop_iteration();
+                 return py::make_tuple(batch->samples, std::move(batch->log_weights));
+             })
+        .def_property_readonly("num_samples", &WeightedSampleStream::num_samples, R"doc(
+Number of instances returned so far.
+)doc")
+        .def_property_readonly("effective_sample_size", &WeightedSampleStream::effective_sample_size, R"doc(
+Effective sample size of the instances returned so far.
+)doc");
+}
@@ -9,12 +9,19 @@
 #include <kde/ScottsBandwidth.hpp>
 #include <kde/NormalReferenceRule.hpp>
 #include <kde/UCV.hpp>
+#include <kdtree/kdtree.hpp>
 #include <util/exceptions.hpp>
+#include <util/util_types.hpp>
+#include <opencl/opencl_config.hpp>
 
-using kde::KDE, kde::ProductKDE, kde::BandwidthSelector, kde::ScottsBandwidth, kde::NormalReferenceRule, kde::UCV,
-    kde::UCVScorer;
+using kde::KDE, kde::KDEBackend, kde::ProductKDE, kde::BandwidthSelector, kde::ScottsBandwidth,
+    kde::NormalReferenceRule, kde::UCV, kde::UCVScorer;
 
-using util::singular_covariance_data;
+using kdtree::KDTree;
+
+using opencl::OpenCLConfig;
+
+using util::random_seed_arg, util::singular_covariance_data;
 
 class PyBandwidthSelector : public BandwidthSelector {
 public:
@@ -185,9 +192,15 @@ Initializes a :class:`NormalReferenceRule <pybnesian.NormalReferenceRule>`.
                         [](py::tuple&) { return std::make_shared<NormalReferenceRule>(); }));
 
     py::class_<UCVScorer>(root, "UCVScorer")
-        .def(py::init<const DataFrame&, const std::vector<std::string>&>())
+        .def(py::init<const DataFrame&, const std::vector<std::string>&, int>(),
+             py::arg("df"),
+             py::arg("variables"),
+             py::arg("binned_grid_size") = 0)
+        .def_property_readonly("binned_grid_size", &UCVScorer::binned_grid_size)
         .def("score_diagonal", &UCVScorer::score_diagonal)
-        .def("score_unconstrained", &UCVScorer::score_unconstrained);
+        .def("score_unconstrained", &UCVScorer::score_unconstrained)
+        .def("score_diagonal_batch", &UCVScorer::score_diagonal_batch, py::arg("diagonal_bandwidths"))
+        .def("score_unconstrained_batch", &UCVScorer::score_unconstrained_batch, py::arg("bandwidths"));
 
     py::class_<UCV, BandwidthSelector, std::shared_ptr<UCV>>(root, "UCV", R"doc(
 Selects the bandwidth using the Unbiased Cross Validation (UCV) criterion (also known as least-squares cross
@@ -203,11 +216,216 @@ where :math:`N` is the number of training instances, :math:`\phi_{\Sigma}` is th
 with covariance :math:`\Sigma`, :math:`\mathbf{t}_{i}` is the :math:`i`-th training instance, and :math:`\mathbf{H}` is
 the bandwidth matrix.
 )doc")
-        .def(py::init<>(), R"doc(
+        .def(py::init<bool, int, bool>(),
+             py::arg("pattern_search") = false,
+             py::arg("binned_grid_size") = 0,
+             py::arg("warm_start") = false,
+             R"doc(
 Initializes a :class:`UCV <pybnesian.UCV>`.
+
+:param pattern_search: If True, the bandwidth is optimized with a multi-start compass search. The candidate bandwidths
+                       of each iteration are evaluated together by a single pass of the OpenCL kernels over the pairs
+                       of training instances, which is faster for large training datasets. If False, the bandwidth is
+                       optimized with the Nelder-Mead method starting from the
+                       :class:`NormalReferenceRule <pybnesian.NormalReferenceRule>` bandwidth.
+:param binned_grid_size: If positive, the UCV of the diagonal bandwidths is approximated by linearly binning the
+                         training data in a grid with ``binned_grid_size`` points per variable. The kernel sums are
+                         computed with FFT convolutions in :math:`O(N + G^{d}\log G)` time instead of
+                         :math:`O(N^{2})`. The unconstrained bandwidth of more than one variable is not diagonal, so
+                         it is always computed exactly.
+:param warm_start: If True, the last bandwidth optimized for each list of variables is kept. The next optimization of
+                   the same variables starts from it with a smaller initial step, if its UCV is lower than the UCV of
+                   the :class:`NormalReferenceRule <pybnesian.NormalReferenceRule>` bandwidth. The related fits (e.g.
+                   the folds of :class:`CVLikelihood <pybnesian.CVLikelihood>`) converge in fewer evaluations.
+)doc")
+        .def_property_readonly("pattern_search", &UCV::pattern_search, R"doc(
+Whether the bandwidth is optimized with the multi-start compass search.
+)doc")
+        .def_property_readonly("binned_grid_size", &UCV::binned_grid_size, R"doc(
+The grid size of the binned UCV approximation. If 0, the UCV is computed exactly.
+)doc")
+        .def_property_readonly("warm_start", &UCV::warm_start, R"doc(
+Whether the optimizations start from the last bandwidth of the same variables.
+)doc")
+        .def("clear_warm_start", &UCV::clear_warm_start, R"doc(
+Removes the bandwidths kept for the warm starts.
 )doc")
         .def(py::pickle([](const UCV& self) { return self.__getstate__(); },
-                        [](py::tuple&) { return std::make_shared<UCV>(); }));
+                        [](py::tuple& t) { return UCV::__setstate__(t); }));
+
+    py::enum_<KDEBackend>(root, "KDEBackend", R"doc(
+The device used to evaluate a :class:`KDE <pybnesian.KDE>`.
+)doc")
+        .value("AUTO", KDEBackend::AUTO, R"doc(
+Selects ``OPENCL`` if the default OpenCL device is a GPU. Otherwise, it selects ``CPU``.
+)doc")
+        .value("OPENCL", KDEBackend::OPENCL, R"doc(
+Evaluates the KDE with the default OpenCL device.
+)doc")
+        .value("CPU", KDEBackend::CPU, R"doc(
+Evaluates the KDE with vectorized native code in the CPU, without initializing OpenCL.
+)doc");
+
+    root.def("set_opencl_tile_columns", &OpenCLConfig::set_temp_mat_max_cols, py::arg("columns"), R"doc(
+Sets the maximum number of test instances evaluated at a time by the OpenCL kernels of the KDE models (e.g.,
+:class:`KDE <pybnesian.KDE>`, :class:`CKDE <pybnesian.CKDE>` or :class:`ProductKDE <pybnesian.ProductKDE>`). Each
+test instance uses a column of a temporary matrix with a row for each training instance, except in
+:func:`KDE.logl <pybnesian.KDE.logl>` without mixed precision, where it uses a row for each chunk of training instances
+reduced by a work group.
+
+:param columns: Maximum number of test instances evaluated at a time. If 0 (the default), it is chosen so the temporary
+                matrices use at most 1/8 of the global memory of the OpenCL device.
+)doc");
+
+    root.def("set_opencl_pipeline_rows", &OpenCLConfig::set_pipeline_rows, py::arg("rows"), R"doc(
+Sets the number of test instances uploaded at a time to the OpenCL device by :func:`KDE.logl <pybnesian.KDE.logl>`,
+:func:`KDE.slogl <pybnesian.KDE.slogl>` and the same methods of :class:`CKDE <pybnesian.CKDE>`. If the test data has
+more instances, it is streamed in chunks of ``rows`` instances, so that the upload of the next chunk and the download
+of the previous results are overlapped with the evaluation of the current chunk.
+
+:param rows: Number of test instances of each chunk. If 0, the default value (65536) is used.
+)doc");
+
+    root.def("set_opencl_training_block_rows", &OpenCLConfig::set_training_block_rows, py::arg("rows"), R"doc(
+Sets the maximum number of training instances of an OpenCL :class:`KDE <pybnesian.KDE>` (or :class:`CKDE
+<pybnesian.CKDE>`) kept in the memory of the device. The models fitted with more training instances keep them in the
+host memory, and stream them to the device in blocks of ``rows`` instances each time the log-likelihood is evaluated.
+Only the models fitted after calling this function are affected.
+
+The out of core :class:`CKDE <pybnesian.CKDE>` models cannot be sampled nor compute their cdf.
+
+:param rows: Number of training instances of each block. If 0 (the default), the training instances are only streamed
+             if they do not fit in the memory of the device.
+)doc");
+
+    root.def("set_opencl_mixed_precision", &OpenCLConfig::set_mixed_precision, py::arg("mixed_precision"), R"doc(
+Enables or disables the mixed precision mode of the OpenCL KDE models (e.g., :class:`KDE <pybnesian.KDE>` with
+:attr:`KDEBackend.OPENCL <pybnesian.KDEBackend.OPENCL>` or :class:`CKDE <pybnesian.CKDE>`). In this mode, the
+log-likelihood of double data computes the squared Mahalanobis distances in float, and the log-sum-exp of the kernels
+in double. This is faster in the devices with a low double precision performance (e.g., most consumer GPUs), and the
+error of each log-likelihood value is close to the float precision. The float data and the CPU backend are not
+affected.
+
+:param mixed_precision: If True, the mixed precision mode is enabled. It is disabled by default.
+)doc");
+
+    root.def("set_opencl_autotuning", &OpenCLConfig::set_autotuning, py::arg("autotuning"), R"doc(
+Enables or disables the tuning of the OpenCL work-group sizes. The first evaluations of the element-wise kernels (e.g.,
+the kernel values of the KDE models and the UCV scores) try different work-group sizes in each device. Then, the fastest
+work-group size is used, and it is saved next to the cached OpenCL program (see :func:`set_opencl_program_cache
+<pybnesian.set_opencl_program_cache>`), so the next processes with the same devices and drivers do not tune the kernels
+again. The work-group sizes do not change the results.
+
+:param autotuning: If True (the default), the kernels are tuned. If False, the kernels that are not tuned yet use the
+                   default work-group size of the OpenCL driver.
+)doc");
+
+    root.def("set_opencl_profiling", &OpenCLConfig::set_profiling, py::arg("profiling"), R"doc(
+Enables or disables the OpenCL profiling mode. In this mode, the OpenCL command queues are created with
+``CL_QUEUE_PROFILING_ENABLE``, and the device time of each kernel and transfer is added to the counters
+``"opencl_device:*"`` of the profiler (see :func:`profiler_stats <pybnesian.profiler_stats>`), aggregated by kernel
+name. The wall time of the other counters includes the host overhead, so the device time can be compared with it. The
+commands are only recorded while the profiler is enabled (see :func:`enable_profiler <pybnesian.enable_profiler>`).
+
+The mode can be changed at any time. The profiling adds a small overhead to each OpenCL command.
+
+:param profiling: If True, the OpenCL profiling mode is enabled. It is disabled by default.
+)doc");
+
+    root.def(
+        "opencl_tuned_local_sizes",
+        [](int device) { return OpenCLConfig::get(device).tuned_local_sizes(); },
+        py::arg("device") = 0,
+        R"doc(
+Returns the work-group size chosen for each tuned OpenCL kernel of a device. It initializes OpenCL. See
+:func:`set_opencl_autotuning <pybnesian.set_opencl_autotuning>`.
+
+:param device: Index of the device in the device pool (see :func:`set_opencl_devices <pybnesian.set_opencl_devices>`).
+:returns: A dict with the name of each tuned kernel and its work-group size, where 0 is the default work-group size of
+          the OpenCL driver.
+)doc");
+
+    root.def(
+        "opencl_memory_usage",
+        [](int device) { return OpenCLConfig::get(device).memory_usage(); },
+        py::arg("device") = 0,
+        R"doc(
+Returns the device memory of an OpenCL device that is not owned by a model: the temporary buffers kept by the buffer
+pool for reuse and the data columns shared by the models fitted with the same data. The memory of each model is
+reported by its ``memory_usage()`` method (e.g., :func:`KDE.memory_usage <pybnesian.KDE.memory_usage>`). It
+initializes OpenCL.
+
+:param device: Index of the device in the device pool (see :func:`set_opencl_devices <pybnesian.set_opencl_devices>`).
+:returns: A :class:`MemoryUsage <pybnesian.MemoryUsage>`.
+)doc");
+
+    root.def(
+        "set_opencl_buffer_pool_limit",
+        [](int device, size_t bytes) { OpenCLConfig::get(device).set_buffer_pool_max_bytes(bytes); },
+        py::arg("device"),
+        py::arg("max_bytes"),
+        R"doc(
+Sets the maximum number of bytes of the temporary buffers kept for reuse by the buffer pool of an OpenCL device. The
+pooled buffers that do not fit are freed. By default, the pool keeps at most 1/4 of the global memory of the device. It
+initializes OpenCL.
+
+:param device: Index of the device in the device pool (see :func:`set_opencl_devices <pybnesian.set_opencl_devices>`).
+:param max_bytes: Maximum number of bytes kept by the pool. If 0, the temporary buffers are not reused.
+)doc");
+
+    root.def("set_opencl_devices", &OpenCLConfig::set_devices, py::arg("devices"), R"doc(
+Sets the OpenCL devices used by the KDE models. The :class:`CKDE <pybnesian.CKDE>` models (e.g., the nodes of a
+:class:`SemiparametricBN <pybnesian.SemiparametricBN>` or a :class:`KDENetwork <pybnesian.KDENetwork>`) are assigned to
+the devices in round-robin order, so the models fitted or evaluated in different threads can use different devices. The
+test instances of a large :func:`KDE.logl <pybnesian.KDE.logl>` (or :func:`CKDE.logl <pybnesian.CKDE.logl>`) are split
+in ranges evaluated by the devices that are not in use. It must be called before OpenCL is initialized (i.e., before a
+KDE model is fitted with the OpenCL backend).
+
+:param devices: List of indices of the devices in the default OpenCL platform. By default, only the first device is
+                used.
+:raises ValueError: If the list is empty or contains repeated or negative indices.
+)doc");
+
+    root.def("set_opencl_program_cache", &OpenCLConfig::set_program_cache_dir, py::arg("directory"), R"doc(
+Sets the directory where the compiled OpenCL program is cached. The program is compiled when OpenCL is first used in a
+process, which can take a few seconds. The compiled binary of each device is saved in the cache, so the next processes
+with the same devices, drivers and PyBNesian version load it instead of compiling the program. It must be called before
+OpenCL is initialized.
+
+By default, the cache directory is the value of the ``PYBNESIAN_OPENCL_CACHE_DIR`` environment variable or, if it is
+not defined, ``$XDG_CACHE_HOME/pybnesian`` (``~/.cache/pybnesian`` if ``XDG_CACHE_HOME`` is not defined). The directory
+is created with mode 0700 if it does not exist. The cache is not used if the directory belongs to another user or other
+users can write to it, and a cached file is ignored (and compiled again) if it does not belong to the current user or
+its mode is not 0600. Thus, other users can not replace the binaries that are run on the devices.
+
+The child processes created with ``fork()`` (e.g., the workers of a :class:`multiprocessing.Pool` with the ``fork``
+start method) can not use the OpenCL context of the parent. The child creates its own context the first time it uses
+OpenCL, and the program is loaded from the binaries compiled by the parent, so it is not compiled again. The KDE models
+fitted with the OpenCL backend in the parent keep their data in the context of the parent, so they must be sent to
+the child (e.g., pickled as arguments of the task) or fitted again in the child.
+
+:param directory: A directory. If it is an empty string, the program is not cached.
+)doc");
+
+    root.def(
+        "opencl_num_devices",
+        []() { return OpenCLConfig::num_devices(); },
+        R"doc(
+Returns the number of OpenCL devices used by the KDE models. It initializes OpenCL. See
+:func:`set_opencl_devices <pybnesian.set_opencl_devices>`.
+
+:returns: Number of OpenCL devices.
+)doc");
+
+    root.def(
+        "last_opencl_tile_columns",
+        []() { return OpenCLConfig::get().last_temp_mat_cols(); },
+        R"doc(
+Returns the number of test instances evaluated at a time in the last OpenCL evaluation of a KDE model. See
+:func:`set_opencl_tile_columns <pybnesian.set_opencl_tile_columns>`.
+
+:returns: Number of test instances evaluated at a time.
+)doc");
 
     py::class_<KDE>(root, "KDE", R"doc(
 This class implements Kernel Density Estimation (KDE) for a set of variables:
@@ -220,22 +438,40 @@ This class implements Kernel Density Estimation (KDE) for a set of variables:
 where :math:`N` is the number of training instances, :math:`K()` is the multivariate Gaussian kernel function,
 :math:`\mathbf{t}_{i}` is the :math:`i`-th training instance, and :math:`\mathbf{H}` is the bandwidth matrix.
 )doc")
-        .def(py::init<std::vector<std::string>>(), py::arg("variables"), R"doc(
+        .def(py::init<std::vector<std::string>, KDEBackend, double>(),
+             py::arg("variables"),
+             py::arg("backend") = KDEBackend::AUTO,
+             py::arg("relative_error") = 0.,
+             R"doc(
 Initializes a KDE with the given ``variables``. It uses the :class:`NormalReferenceRule <pybnesian.NormalReferenceRule>` as the default bandwidth
 selector.
 
 :param variables: List of variable names.
-)doc")
-        .def(py::init<>([](std::vector<std::string> variables, std::shared_ptr<BandwidthSelector> bandwidth_selector) {
-                 return KDE(variables, BandwidthSelector::keep_python_alive(bandwidth_selector));
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device that evaluates the KDE.
+:param relative_error: If positive, the log-likelihood is approximated with a KD-tree so that the relative error of the
+                       density of each instance is at most ``relative_error``. The approximation is computed in the CPU.
+                       If 0, the log-likelihood is exact.
+)doc")
+        .def(py::init<>([](std::vector<std::string> variables,
+                           std::shared_ptr<BandwidthSelector> bandwidth_selector,
+                           KDEBackend backend,
+                           double relative_error) {
+                 return KDE(
+                     variables, BandwidthSelector::keep_python_alive(bandwidth_selector), backend, relative_error);
              }),
              py::arg("variables"),
              py::arg("bandwidth_selector"),
+             py::arg("backend") = KDEBackend::AUTO,
+             py::arg("relative_error") = 0.,
              R"doc(
 Initializes a KDE with the given ``variables`` and ``bandwidth_selector`` procedure to fit the bandwidth.
 
 :param variables: List of variable names.
 :param bandwidth_selector: Procedure to fit the bandwidth.
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device that evaluates the KDE.
+:param relative_error: If positive, the log-likelihood is approximated with a KD-tree so that the relative error of the
+                       density of each instance is at most ``relative_error``. The approximation is computed in the CPU.
+                       If 0, the log-likelihood is exact.
 )doc")
         .def("variables", &KDE::variables, R"doc(
 Gets the variable names:
@@ -260,6 +496,18 @@ Bandwidth matrix (:math:`\mathbf{H}`)
 Gets the training dataset for this KDE (the :math:`\mathbf{t}_{i}` instances).
 
 :returns: Training instance.
+)doc")
+        .def_property_readonly("backend", &KDE::backend, R"doc(
+The :class:`KDEBackend <pybnesian.KDEBackend>` that evaluates the KDE. It is never ``KDEBackend.AUTO``, because the
+backend is selected when the KDE is created.
+)doc")
+        .def_property_readonly("relative_error", &KDE::relative_error, R"doc(
+The relative error bound of the approximate log-likelihood, or 0 if the log-likelihood is exact.
+)doc")
+        .def_property("num_threads", &KDE::num_threads, &KDE::set_num_threads, R"doc(
+Number of threads that evaluate the log-likelihood in the CPU (with ``KDEBackend.CPU`` or a positive
+``relative_error``). If 0 (the default), the number of hardware threads is used. The log-likelihood does not depend on
+the number of threads.
 )doc")
         .def("fitted", &KDE::fitted, R"doc(
 Checks whether the model is fitted.
@@ -279,19 +527,90 @@ provided bandwidth selector.
 
 :param df: DataFrame to fit the :class:`KDE <pybnesian.KDE>`.
 )doc")
-        .def("logl", &KDE::logl, py::return_value_policy::take_ownership, py::arg("df"), R"doc(
+        .def(
+            "fit",
+            [](KDE& self, const DataFrame& df, int condensed_instances, std::optional<unsigned int> seed) {
+                self.fit(df, condensed_instances, random_seed_arg(seed));
+            },
+            py::arg("df"),
+            py::arg("condensed_instances"),
+            py::arg("seed") = std::nullopt,
+            R"doc(
+Fits the :class:`KDE <pybnesian.KDE>` with the data in ``df`` and condenses its training instances in (at most)
+``condensed_instances`` weighted instances:
+
+.. math::
+
+    \hat{f}(\text{variables}) = \frac{1}{\lvert\mathbf{H} \rvert} \sum_{i=1}^{k}
+    w_{i} K(\mathbf{H}^{-1}(\text{variables} - \mathbf{c}_{i}))
+
+The bandwidth :math:`\mathbf{H}` is estimated with all the instances of ``df``. Then, the instances are clustered with
+k-means in the metric of the bandwidth, and each cluster is replaced by its mean :math:`\mathbf{c}_{i}` with a weight
+:math:`w_{i}` proportional to its number of instances. The cost of the log-likelihood is proportional to the number of
+condensed instances, and the error of the approximation decreases as the clusters are smaller than the bandwidth.
+
+:param df: DataFrame to fit the :class:`KDE <pybnesian.KDE>`.
+:param condensed_instances: Maximum number of condensed instances.
+:param seed: A random seed number to initialize the k-means. If not specified or ``None``, a random seed is generated.
+)doc")
+        .def("fit",
+             (void(KDE::*)(const DataFrame&, const VectorXd&)) & KDE::fit,
+             py::arg("df"),
+             py::arg("weights"),
+             R"doc(
+Fits the :class:`KDE <pybnesian.KDE>` with the rows of ``df`` weighted by ``weights``:
+
+.. math::
+
+    \hat{f}(\text{variables}) = \frac{1}{\lvert\mathbf{H} \rvert} \sum_{i=1}^{N}
+    \frac{w_{i}}{W} K(\mathbf{H}^{-1}(\text{variables} - \mathbf{t}_{i})),\quad W = \sum_{i=1}^{N} w_{i}
+
+The rows with zero weight or null values are not training instances. The bandwidth :math:`\mathbf{H}` is estimated by
+the bandwidth selector without weights.
+
+:param df: DataFrame to fit the :class:`KDE <pybnesian.KDE>`.
+:param weights: Non-negative weight of each row of ``df``.
+)doc")
+        .def("out_of_core", &KDE::out_of_core, R"doc(
+Checks whether the training instances are kept in the host memory and streamed to the OpenCL device when the model is
+evaluated (see :func:`set_opencl_training_block_rows <pybnesian.set_opencl_training_block_rows>`).
+
+:returns: True if the training instances are streamed, False otherwise.
+)doc")
+        .def("condensed", &KDE::condensed, R"doc(
+Checks whether the training instances of the model were condensed (see :func:`KDE.fit <pybnesian.KDE.fit>`).
+
+:returns: True if the training instances are weighted, False otherwise.
+)doc")
+        .def("weights", &KDE::weights, R"doc(
+Gets the weight of each training instance in the density. The weights are :math:`1/N` if the model is not condensed.
+
+:returns: A :class:`numpy.ndarray` vector with the weights, which sum to 1.
+)doc")
+        .def("logl",
+             &KDE::logl,
+             py::return_value_policy::take_ownership,
+             py::arg("df"),
+             py::call_guard<py::gil_scoped_release>(),
+             R"doc(
 Returns the log-likelihood of each instance in the DataFrame ``df``.
 
 :param df: DataFrame to compute the log-likelihood.
 :returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64`, where the i-th value is the log-likelihod
           of the i-th instance of ``df``.
 )doc")
-        .def("slogl", &KDE::slogl, py::arg("df"), R"doc(
+        .def("slogl", &KDE::slogl, py::arg("df"), py::call_guard<py::gil_scoped_release>(), R"doc(
 Returns the sum of the log-likelihood of each instance in the DataFrame ``df``. That is, the sum of the result of
 :func:`KDE.logl <pybnesian.KDE.logl>`.
 
 :param df: DataFrame to compute the sum of the log-likelihood.
 :returns: The sum of log-likelihood for DataFrame ``df``.
+)doc")
+        .def("memory_usage", &KDE::memory_usage, R"doc(
+Returns the memory used by the training data (in the host or in the OpenCL device), the bandwidth and the trees of the
+approximate log-likelihood of the :class:`KDE <pybnesian.KDE>`.
+
+:returns: A :class:`MemoryUsage <pybnesian.MemoryUsage>`.
 )doc")
         .def("save", &KDE::save, py::arg("filename"), R"doc(
 Saves the :class:`KDE <pybnesian.KDE>` in a pickle file with the given name.
@@ -313,21 +632,36 @@ where :math:`N` is the number of training instances, :math:`d` is the dimensiona
 the multivariate Gaussian kernel function, :math:`t_{ji}` is the value of the :math:`j`-th variable in the
 :math:`i`-th training instance, and :math:`h_{j}` is the bandwidth parameter for the :math:`j`-th variable.
 )doc")
-        .def(py::init<std::vector<std::string>>(), py::arg("variables"), R"doc(
+        .def(py::init<std::vector<std::string>, int>(),
+             py::arg("variables"),
+             py::arg("binned_grid_size") = 0,
+             R"doc(
 Initializes a ProductKDE with the given ``variables``.
 
 :param variables: List of variable names.
-)doc")
-        .def(py::init<>([](std::vector<std::string> variables, std::shared_ptr<BandwidthSelector> bandwidth_selector) {
-                 return ProductKDE(variables, BandwidthSelector::keep_python_alive(bandwidth_selector));
+:param binned_grid_size: If positive, the log-likelihood is approximated by linearly binning the training data in a grid
+                         with ``binned_grid_size`` points per variable and convolving it with the kernel using FFTs.
+                         The test instances outside the grid or in regions of very low density are evaluated exactly.
+                         The approximation is computed in the CPU.
+)doc")
+        .def(py::init<>([](std::vector<std::string> variables,
+                           std::shared_ptr<BandwidthSelector> bandwidth_selector,
+                           int binned_grid_size) {
+                 return ProductKDE(
+                     variables, BandwidthSelector::keep_python_alive(bandwidth_selector), binned_grid_size);
              }),
              py::arg("variables"),
              py::arg("bandwidth_selector"),
+             py::arg("binned_grid_size") = 0,
              R"doc(
 Initializes a ProductKDE with the given ``variables`` and ``bandwidth_selector`` procedure to fit the bandwidth.
 
 :param variables: List of variable names.
 :param bandwidth_selector: Procedure to fit the bandwidth.
+:param binned_grid_size: If positive, the log-likelihood is approximated by linearly binning the training data in a grid
+                         with ``binned_grid_size`` points per variable and convolving it with the kernel using FFTs.
+                         The test instances outside the grid or in regions of very low density are evaluated exactly.
+                         The approximation is computed in the CPU.
 )doc")
         .def("variables", &ProductKDE::variables, R"doc(
 Gets the variable names:
@@ -346,6 +680,9 @@ Gets the number of variables.
 )doc")
         .def_property("bandwidth", &ProductKDE::bandwidth, &ProductKDE::setBandwidth, R"doc(
 Vector of bandwidth values (:math:`h_{j}^{2}`).
+)doc")
+        .def_property_readonly("binned_grid_size", &ProductKDE::binned_grid_size, R"doc(
+The grid size of the binned approximation of the log-likelihood. If 0, the log-likelihood is computed exactly.
 )doc")
         .def("dataset", &ProductKDE::training_data, R"doc(
 Gets the training dataset for this ProductKDE (the :math:`\mathbf{t}_{i}` instances).
@@ -370,14 +707,19 @@ using the provided bandwidth selector.
 
 :param df: DataFrame to fit the :class:`ProductKDE <pybnesian.ProductKDE>`.
 )doc")
-        .def("logl", &ProductKDE::logl, py::return_value_policy::take_ownership, py::arg("df"), R"doc(
+        .def("logl",
+             &ProductKDE::logl,
+             py::return_value_policy::take_ownership,
+             py::arg("df"),
+             py::call_guard<py::gil_scoped_release>(),
+             R"doc(
 Returns the log-likelihood of each instance in the DataFrame ``df``.
 
 :param df: DataFrame to compute the log-likelihood.
 :returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64`, where the i-th value is the log-likelihod
           of the i-th instance of ``df``.
 )doc")
-        .def("slogl", &ProductKDE::slogl, py::arg("df"), R"doc(
+        .def("slogl", &ProductKDE::slogl, py::arg("df"), py::call_guard<py::gil_scoped_release>(), R"doc(
 Returns the sum of the log-likelihood of each instance in the DataFrame ``df``. That is, the sum of the result of
 :func:`ProductKDE.logl <pybnesian.ProductKDE.logl>`.
 
@@ -391,4 +733,86 @@ Saves the :class:`ProductKDE <pybnesian.ProductKDE>` in a pickle file with the g
 )doc")
         .def(py::pickle([](const ProductKDE& self) { return self.__getstate__(); },
                         [](py::tuple t) { return ProductKDE::__setstate__(t); }));
+
+    py::class_<KDTree>(root, "KDTree", R"doc(
+A k-d tree of continuous data, used in the k-nn searches of :class:`KMutualInformation <pybnesian.KMutualInformation>`.
+)doc")
+        .def(py::init<DataFrame, int, int>(),
+             py::arg("df"),
+             py::arg("leafsize") = 16,
+             py::arg("num_threads") = 1,
+             R"doc(
+Builds a :class:`KDTree` of the rows of ``df``. All the columns of ``df`` must have the same data type
+(:func:`pyarrow.float64 <pyarrow.float64>` or :func:`pyarrow.float32 <pyarrow.float32>`).
+
+:param df: DataFrame with the training points.
+:param leafsize: Maximum number of points in each leaf. The leaves with equal points can be larger.
+:param num_threads: Number of threads used to build the tree. If 0, the number of hardware threads is used. The tree
+                    does not depend on ``num_threads``.
+)doc")
+        .def("query",
+             &KDTree::query_batch,
+             py::arg("test_df"),
+             py::arg("k") = 1,
+             py::arg("p") = 2.,
+             py::arg("eps") = 0.,
+             py::arg("num_threads") = 1,
+             py::call_guard<py::gil_scoped_release>(),
+             R"doc(
+Searches the ``k`` nearest neighbors of each row of ``test_df`` with the Minkowski distance of order ``p``.
+
+:param test_df: DataFrame with the test points. It must contain the columns of the training data.
+:param k: Number of neighbors.
+:param p: Order of the Minkowski distance. ``numpy.inf`` selects the Chebyshev distance.
+:param eps: If greater than 0, the search is approximate: the distance to the i-th returned neighbor is at most
+            :math:`1 + \epsilon` times the distance to the exact i-th neighbor.
+:param num_threads: Number of threads used to search the test points. If 0, the number of hardware threads is used.
+:returns: A tuple (distances, indices) of two :class:`numpy.ndarray` with shape (``k``, number of test points). The
+          i-th column contains the distances and the training row indices of the neighbors of the i-th test point,
+          sorted by distance.
+)doc")
+        .def(
+            "count_ball_subspaces",
+            [](const KDTree& self,
+               const DataFrame& df,
+               const std::string& x,
+               const std::string& y,
+               const VectorXd& eps,
+               int num_threads) {
+                auto columns = self.ranked_data().column_names();
+                auto z_df = df.loc(columns);
+                if (df.same_type(x, y, columns)->id() != self.ranked_data().same_type()->id()) {
+                    throw std::invalid_argument("Test data type is different from training data types.");
+                }
+
+                if (eps.rows() != df->num_rows()) {
+                    throw std::invalid_argument("The length of \"eps\" must be the number of rows of \"df\".");
+                }
+
+                return self.count_ball_subspaces(z_df, df.col(x), df.col(y), eps, num_threads);
+            },
+            py::arg("df"),
+            py::arg("x"),
+            py::arg("y"),
+            py::arg("eps"),
+            py::arg("num_threads") = 1,
+            py::call_guard<py::gil_scoped_release>(),
+            R"doc(
+Counts, for each row :math:`i` of the training data, the rows :math:`j` of the balls of the subspaces used in the
+estimation of the conditional mutual information: the rows whose Chebyshev distance to row :math:`i` is lower than
+``eps[i]`` in the space of the training columns (:math:`\mathbf{z}`), of :math:`x` and :math:`\mathbf{z}`, and of
+:math:`y` and :math:`\mathbf{z}`. The row :math:`i` itself is counted.
+
+:param df: The training DataFrame of the tree with the columns ``x`` and ``y``.
+:param x: A column name of ``df``.
+:param y: A column name of ``df``.
+:param eps: The radius of the ball of each row.
+:param num_threads: Number of threads used to count the rows. If 0, the number of hardware threads is used.
+:returns: A tuple (count_xz, count_yz, count_z) of :class:`numpy.ndarray` with the counts of each row.
+)doc")
+        .def("max_leaf_size", &KDTree::max_leaf_size, R"doc(
+Gets the number of points of the largest leaf of the tree.
+
+:returns: Number of points of the largest leaf.
+)doc");
 }
\ No newline at end of file
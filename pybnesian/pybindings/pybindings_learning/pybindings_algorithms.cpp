@@ -3,12 +3,21 @@
 #include <learning/operators/operators.hpp>
 #include <learning/algorithms/callbacks/callback.hpp>
 #include <learning/algorithms/callbacks/save_model.hpp>
+#include <learning/algorithms/callbacks/save_operators.hpp>
+#include <learning/algorithms/callbacks/progress_events.hpp>
+#include <learning/algorithms/callbacks/search_budget.hpp>
 #include <learning/algorithms/hillclimbing.hpp>
 #include <learning/algorithms/constraint.hpp>
 #include <learning/algorithms/pc.hpp>
 #include <learning/algorithms/mmpc.hpp>
 #include <learning/algorithms/mmhc.hpp>
 #include <learning/algorithms/dmmhc.hpp>
+#include <learning/algorithms/ges.hpp>
+#include <learning/algorithms/exact_search.hpp>
+#include <learning/algorithms/order_search.hpp>
+#include <learning/algorithms/candidate_parents.hpp>
+#include <learning/algorithms/checkpoint.hpp>
+#include <learning/algorithms/async_learning.hpp>
 
 namespace py = pybind11;
 
@@ -16,10 +25,17 @@ using models::GaussianNetworkType;
 
 using learning::algorithms::GreedyHillClimbing, learning::algorithms::PC, learning::algorithms::MeekRules,
     learning::algorithms::MMPC, learning::algorithms::MMHC;
-using learning::algorithms::callbacks::Callback, learning::algorithms::callbacks::SaveModel;
-using learning::operators::OperatorPool;
+using learning::algorithms::callbacks::Callback, learning::algorithms::callbacks::SaveModel,
+    learning::algorithms::callbacks::SaveOperators, learning::algorithms::callbacks::ProgressEvents,
+    learning::algorithms::callbacks::SearchBudget;
+using learning::operators::OperatorPool, learning::operators::LocalScoreMemo;
 
 using learning::algorithms::DMMHC;
+using learning::algorithms::HillClimbingCheckpoint, learning::algorithms::PCCheckpoint;
+using learning::algorithms::GES;
+using learning::algorithms::ExactSearch;
+using learning::algorithms::OrderBasedSearch;
+using learning::algorithms::LearningTask;
 
 class PyCallback : public Callback {
 public:
@@ -28,6 +44,8 @@ public:
     void call(BayesianNetworkBase& model, Operator* new_operator, Score& score, int num_iter) const override {
         PYBIND11_OVERRIDE_PURE(void, Callback, call, model.shared_from_this(), new_operator, &score, num_iter);
     }
+
+    bool stop(int64_t evaluations) const override { PYBIND11_OVERRIDE(bool, Callback, stop, evaluations); }
 };
 
 void pybindings_algorithms_callbacks(py::module& root) {
@@ -55,6 +73,13 @@ This method is called after each iteration of
 :param score: The score used in the :class:`GreedyHillClimbing <pybnesian.GreedyHillClimbing>`.
 :param iteration: Iteration number of the
                   :class:`GreedyHillClimbing <pybnesian.GreedyHillClimbing>`. It is 0 at the start.
+)doc")
+        .def("stop", &Callback::stop, py::arg("evaluations"), R"doc(
+This method is called before each iteration of :class:`GreedyHillClimbing <pybnesian.GreedyHillClimbing>`. If it
+returns True, the search stops and returns the best model found so far. By default, it returns False.
+
+:param evaluations: Number of local scores computed since the start of the search.
+:returns: True if the search must stop.
 )doc");
 
     py::class_<SaveModel, Callback, std::shared_ptr<SaveModel>>(root, "SaveModel", R"doc(
@@ -67,10 +92,230 @@ Initializes a :class:`SaveModel`. It saves all the models in the folder ``folder
 
 :param folder_name: Name of the folder where the models will be saved.
 )doc");
+
+    py::class_<SaveOperators, Callback, std::shared_ptr<SaveOperators>>(root, "SaveOperators", R"doc(
+Saves the search of :class:`GreedyHillClimbing <pybnesian.GreedyHillClimbing>` in a text file: the structure of the
+starting model and the operator applied on each iteration. Unlike :class:`SaveModel`, the models are not pickled. The
+lines are written by a background thread, so the search does not wait for the disk.
+
+Each line starts with the iteration number. The lines of the iteration 0 contain the arcs (``Arc(source -> target)``)
+and the known node types (``NodeType(node, type)``) of the starting model. The last line of a search is ``End``.
+)doc")
+        .def(py::init<const std::string&, int>(), py::arg("file_name"), py::arg("write_interval") = 1, R"doc(
+Initializes a :class:`SaveOperators`. The file ``file_name`` is truncated, and each search is appended to it.
+
+:param file_name: Name of the file where the operators will be saved.
+:param write_interval: Number of iterations between writes to the file. The end of the search is always written
+                       before the search returns.
+)doc");
+
+    py::class_<ProgressEvents, Callback, std::shared_ptr<ProgressEvents>>(root, "ProgressEvents", R"doc(
+Records an event for each iteration of :class:`GreedyHillClimbing <pybnesian.GreedyHillClimbing>`, to monitor the
+search without parsing the text of the progress spinner. The callback does not call Python code, so the search can
+release the GIL and the events can be read from another Python thread while the search is running.
+)doc")
+        .def(py::init<>(), R"doc(
+Initializes a :class:`ProgressEvents`.
+)doc")
+        .def(
+            "events",
+            [](const ProgressEvents& self, size_t first) {
+                std::vector<std::tuple<int, double, double>> events;
+                for (const auto& e : self.events(first)) {
+                    events.emplace_back(e.iteration, e.delta, e.elapsed);
+                }
+                return events;
+            },
+            py::arg("first") = 0,
+            R"doc(
+Gets the recorded events.
+
+:param first: Index of the first event returned. Pass the number of events already read to get only the new events.
+:returns: A list of tuples (iteration, delta, elapsed), where ``delta`` is the delta score of the operator applied in
+          the iteration and ``elapsed`` is the number of seconds since the start of the search.
+)doc")
+        .def("__len__", &ProgressEvents::size, R"doc(
+Gets the number of recorded events.
+
+:returns: Number of recorded events.
+)doc")
+        .def("clear", &ProgressEvents::clear, R"doc(
+Removes all the recorded events.
+)doc");
+
+    py::class_<SearchBudget, Callback, std::shared_ptr<SearchBudget>>(root, "SearchBudget", R"doc(
+Stops a search when its wall-clock time or its number of evaluations runs out, and the search returns the best model
+found so far. It can be used as the ``callback`` of :class:`GreedyHillClimbing <pybnesian.GreedyHillClimbing>`,
+:func:`pybnesian.hc` and :class:`MMHC <pybnesian.MMHC>` (where it limits the hill-climbing phase), and as the
+``budget`` of :class:`PC <pybnesian.PC>`.
+
+The wall-clock time is counted from the creation of the budget (or the last call to :func:`SearchBudget.reset`), so
+the same budget can limit a sequence of learning algorithms. The callback does not call Python code, so the search can
+release the GIL.
+)doc")
+        .def(py::init<std::optional<double>, std::optional<int64_t>>(),
+             py::arg("max_seconds") = std::nullopt,
+             py::arg("max_evaluations") = std::nullopt,
+             R"doc(
+Initializes a :class:`SearchBudget`.
+
+:param max_seconds: Maximum number of seconds of the search. If ``None``, the time is not limited.
+:param max_evaluations: Maximum number of local scores computed by a hill-climbing (or edges tested by
+                        :class:`PC <pybnesian.PC>`). If ``None``, the evaluations are not limited.
+)doc")
+        .def_property_readonly("max_seconds", &SearchBudget::max_seconds, R"doc(
+Maximum number of seconds of the search, or ``None``.
+)doc")
+        .def_property_readonly("max_evaluations", &SearchBudget::max_evaluations, R"doc(
+Maximum number of evaluations of the search, or ``None``.
+)doc")
+        .def("elapsed", &SearchBudget::elapsed, R"doc(
+Gets the number of seconds since the budget was created or reset.
+
+:returns: Number of seconds.
+)doc")
+        .def("reset", &SearchBudget::reset, R"doc(
+Restarts the wall-clock time of the budget.
+)doc");
+}
+
+void pybindings_algorithms_async(py::module& root) {
+    py::class_<LearningTask, std::shared_ptr<LearningTask>>(root, "LearningTask", R"doc(
+A learning algorithm executed asynchronously in a pool of native threads (one for each hardware thread), returned by
+:func:`pybnesian.hc_async`, :func:`PC.estimate_async <pybnesian.PC.estimate_async>` and
+:func:`BayesianNetworkBase.fit_async <pybnesian.BayesianNetworkBase.fit_async>`. The threads never hold the GIL, so many
+tasks can run concurrently with the Python code. For this reason, the tasks cannot use Python-derived objects.
+
+A :class:`LearningTask` can be awaited in a coroutine of :mod:`asyncio`: ``model = await pybnesian.hc_async(df, ...)``.
+Cancelling the coroutine also cancels the task.
+)doc")
+        .def("done", &LearningTask::done, R"doc(
+Checks whether the task has finished (with a result, an exception or cancelled before it started).
+
+:returns: True if the task has finished.
+)doc")
+        .def(
+            "running",
+            [](const LearningTask& self) { return self.status() == LearningTask::Status::Running; },
+            R"doc(
+Checks whether the task is running.
+
+:returns: True if the task is running.
+)doc")
+        .def("cancel", &LearningTask::cancel, R"doc(
+Requests the cancellation of the task. A pending task is never executed, and its :func:`LearningTask.result` raises an
+exception. A running hill-climbing or PC stops as soon as possible, and its result is the best model found so far (the
+partial result). A running fit is not interrupted.
+
+:returns: False if the task has already finished, True otherwise.
+)doc")
+        .def("cancelled", &LearningTask::cancelled, R"doc(
+Checks whether the cancellation of the task was requested.
+
+:returns: True if :func:`LearningTask.cancel` was called before the task finished.
+)doc")
+        .def("wait",
+             &LearningTask::wait,
+             py::arg("timeout") = std::nullopt,
+             py::call_guard<py::gil_scoped_release>(),
+             R"doc(
+Blocks until the task finishes. The GIL is released while waiting.
+
+:param timeout: Maximum number of seconds to wait. If ``None``, it waits until the task finishes.
+:returns: True if the task has finished.
+)doc")
+        .def("result",
+             &LearningTask::result,
+             py::arg("timeout") = std::nullopt,
+             py::call_guard<py::gil_scoped_release>(),
+             R"doc(
+Gets the result of the task, blocking until it finishes. The GIL is released while waiting.
+
+:param timeout: Maximum number of seconds to wait. If ``None``, it waits until the task finishes.
+:returns: The learned Bayesian network (:func:`pybnesian.hc_async`), the learned
+          :class:`PartiallyDirectedGraph <pybnesian.PartiallyDirectedGraph>` (:func:`PC.estimate_async
+          <pybnesian.PC.estimate_async>`) or the fitted model (:func:`BayesianNetworkBase.fit_async
+          <pybnesian.BayesianNetworkBase.fit_async>`).
+:raises RuntimeError: If the task does not finish before the ``timeout`` or it was cancelled before it started. If the
+                      algorithm raised an exception, it is raised again.
+)doc")
+        .def("iterations", &LearningTask::iterations, R"doc(
+Gets the number of operators applied by a hill-climbing task.
+
+:returns: Number of iterations.
+)doc")
+        .def("evaluations", &LearningTask::evaluations, R"doc(
+Gets the number of local scores (or independence tests, in PC) evaluated by the task, as counted by
+:class:`SearchBudget`.
+
+:returns: Number of evaluations.
+)doc")
+        .def("elapsed", &LearningTask::elapsed, R"doc(
+Gets the number of seconds since the task started running.
+
+:returns: Number of seconds. It is 0 if the task is pending.
+)doc")
+        .def(
+            "events",
+            [](const LearningTask& self, size_t first) {
+                std::vector<std::tuple<int, double, double>> events;
+                for (const auto& e : self.events(first)) {
+                    events.emplace_back(e.iteration, e.delta, e.elapsed);
+                }
+                return events;
+            },
+            py::arg("first") = 0,
+            R"doc(
+Gets the progress events of a hill-climbing task, as :func:`ProgressEvents.events`.
+
+:param first: Index of the first event returned. Pass the number of events already read to get only the new events.
+:returns: A list of tuples (iteration, delta, elapsed).
+)doc")
+        .def("partial_model", &LearningTask::partial_model, R"doc(
+Gets a copy of the current model of a hill-climbing task after its last iteration, so the partial result can be
+inspected while the search is running.
+
+:returns: The current model of the search, or ``None`` if the task has not completed any iteration.
+)doc")
+        .def("__await__", [](const std::shared_ptr<LearningTask>& self) {
+            auto loop = py::module_::import("asyncio").attr("get_running_loop")();
+            auto future = loop.attr("create_future")();
+
+            future.attr("add_done_callback")(py::cpp_function([self](py::object f) {
+                if (f.attr("cancelled")().cast<bool>()) self->cancel();
+            }));
+
+            // The result (or the exception) is read with the Python method, so the C++ exceptions are translated.
+            auto py_self = py::cast(self);
+            auto resolve = py::cpp_function([py_self](py::object f) {
+                if (f.attr("done")().cast<bool>()) return;
+                try {
+                    f.attr("set_result")(py_self.attr("result")());
+                } catch (py::error_already_set& e) {
+                    f.attr("set_exception")(e.value());
+                }
+            });
+
+            // The done callback is called without the GIL, so the Python objects are released manually.
+            auto* pending = new py::tuple(py::make_tuple(loop.attr("call_soon_threadsafe"), resolve, future));
+            self->add_done_callback([pending]() {
+                if (!Py_IsInitialized()) return;
+                py::gil_scoped_acquire gil;
+                std::unique_ptr<py::tuple> t(pending);
+                try {
+                    (*t)[0]((*t)[1], (*t)[2]);
+                } catch (py::error_already_set&) {
+                    // The event loop is closed.
+                }
+            });
+
+            return future.attr("__await__")();
+        });
 }
 
 void pybindings_algorithms(py::module& root) {
     pybindings_algorithms_callbacks(root);
+    pybindings_algorithms_async(root);
 
     root.def("hc",
              &learning::algorithms::hc,
@@ -92,6 +337,8 @@ void pybindings_algorithms(py::module& root) {
              py::arg("num_folds") = 10,
              py::arg("test_holdout_ratio") = 0.2,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("batch_operators") = 1,
              R"doc(
 Executes a greedy hill-climbing algorithm. This calls :func:`GreedyHillClimbing.estimate`.
 
@@ -123,9 +370,160 @@ Executes a greedy hill-climbing algorithm. This calls :func:`GreedyHillClimbing.
 :param test_holdout_ratio: Parameter for the :class:`HoldoutLikelihood <pybnesian.HoldoutLikelihood>`
                            and :class:`ValidatedLikelihood <pybnesian.ValidatedLikelihood>` scores.
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to cache the operators delta scores. If 0, the number of hardware threads
+                    is used. The result does not depend on the number of threads.
+:param batch_operators: Maximum number of operators applied in each iteration. See
+                        :func:`GreedyHillClimbing.estimate`.
 :returns: The estimated Bayesian network structure.
 )doc");
 
+    root.def("hc_async",
+             &learning::algorithms::hc_async,
+             py::arg("df"),
+             py::arg("bn_type") = nullptr,
+             py::arg("start") = nullptr,
+             py::arg("score") = std::nullopt,
+             py::arg("operators") = std::nullopt,
+             py::arg("arc_blacklist") = ArcStringVector(),
+             py::arg("arc_whitelist") = ArcStringVector(),
+             py::arg("type_blacklist") = FactorTypeVector(),
+             py::arg("type_whitelist") = FactorTypeVector(),
+             py::arg("callback") = nullptr,
+             py::arg("max_indegree") = 0,
+             py::arg("max_iters") = std::numeric_limits<int>::max(),
+             py::arg("epsilon") = 0,
+             py::arg("patience") = 0,
+             py::arg("seed") = std::nullopt,
+             py::arg("num_folds") = 10,
+             py::arg("test_holdout_ratio") = 0.2,
+             py::arg("num_threads") = 1,
+             py::arg("batch_operators") = 1,
+             R"doc(
+Executes :func:`pybnesian.hc` asynchronously, and returns immediately. The search can be monitored and cancelled with
+the returned :class:`LearningTask`, and a cancelled search returns the best model found so far.
+
+The parameters are the same as in :func:`pybnesian.hc` (without ``verbose``). The Python-derived objects (models,
+types and callbacks) are not supported, because the search runs without the GIL.
+
+:returns: A :class:`LearningTask` whose result is the estimated Bayesian network structure.
+:raises ValueError: If some parameter is a Python-derived object, or ``batch_operators`` is not positive.
+)doc");
+
+    root.def("bootstrap_hc",
+             &learning::algorithms::bootstrap_hc,
+             py::arg("df"),
+             py::arg("bn_type"),
+             py::arg("num_samples"),
+             py::arg("bootstrap") = true,
+             py::arg("random_start") = false,
+             py::arg("score") = std::nullopt,
+             py::arg("operators") = std::nullopt,
+             py::arg("arc_blacklist") = ArcStringVector(),
+             py::arg("arc_whitelist") = ArcStringVector(),
+             py::arg("type_blacklist") = FactorTypeVector(),
+             py::arg("type_whitelist") = FactorTypeVector(),
+             py::arg("max_indegree") = 0,
+             py::arg("max_iters") = std::numeric_limits<int>::max(),
+             py::arg("epsilon") = 0,
+             py::arg("patience") = 0,
+             py::arg("seed") = std::nullopt,
+             py::arg("num_folds") = 10,
+             py::arg("test_holdout_ratio") = 0.2,
+             py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             R"doc(
+Executes ``num_samples`` independent greedy hill-climbing searches (see :func:`pybnesian.hc`) and returns the frequency
+of each arc in the learned structures (the arc strength). The searches are executed concurrently in ``num_threads``
+threads.
+
+:param df: DataFrame used to learn the Bayesian network models.
+:param bn_type: :class:`BayesianNetworkType` of the learned models.
+:param num_samples: Number of hill-climbing searches.
+:param bootstrap: If True, each search learns from a bootstrap resample of ``df``.
+:param random_start: If True, each search starts from a random DAG with, on average, one parent for each node.
+                     Otherwise, each search starts from an empty network.
+:param score: A string representing the score used to drive the search. The possible options are the same as in
+              :func:`pybnesian.hc`.
+:param operators: Set of operators in the search process.
+:param arc_blacklist: List of arcs blacklist (forbidden arcs).
+:param arc_whitelist: List of arcs whitelist (forced arcs).
+:param type_blacklist: List of type blacklist (forbidden :class:`FactorType <pybnesian.FactorType>`).
+:param type_whitelist: List of type whitelist (forced :class:`FactorType <pybnesian.FactorType>`).
+:param max_indegree: Maximum indegree allowed in the graph.
+:param max_iters: Maximum number of search iterations
+:param epsilon: Minimum delta score allowed for each operator. If the new operator is less than epsilon, the search
+                process is stopped.
+:param patience: The patience parameter (only used with
+                :class:`ValidatedScore <pybnesian.ValidatedScore>`). See `patience`_.
+:param seed: Seed of the resamples, the random starts and the scores. The search ``i`` uses the seed ``seed + i``.
+:param num_folds: Number of folds for the :class:`CVLikelihood <pybnesian.CVLikelihood>` and
+                  :class:`ValidatedLikelihood <pybnesian.ValidatedLikelihood>` scores.
+:param test_holdout_ratio: Parameter for the :class:`HoldoutLikelihood <pybnesian.HoldoutLikelihood>`
+                           and :class:`ValidatedLikelihood <pybnesian.ValidatedLikelihood>` scores.
+:param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to execute the searches. If 0, the number of hardware threads is used. The
+                    result does not depend on the number of threads.
+:returns: A dict that maps each arc (source, target) learned in any search to the ratio of searches that learned it.
+)doc");
+
+    root.def("candidate_parents",
+             &learning::algorithms::candidate_parents,
+             py::arg("hypot_test"),
+             py::arg("k"),
+             py::arg("nodes") = std::vector<std::string>(),
+             py::arg("interface_nodes") = std::vector<std::string>(),
+             py::arg("num_threads") = 1,
+             R"doc(
+Selects the ``k`` candidate parents of each node with the strongest marginal association, as in the sparse candidate
+algorithm. The candidates of a node are the ``k`` other nodes (or interface nodes) with the lowest p-value of the
+marginal independence test. The result can be passed to :func:`OperatorSet.set_candidate_parents
+<pybnesian.OperatorSet.set_candidate_parents>` to restrict the search of very large networks.
+
+:param hypot_test: The :class:`IndependenceTest <pybnesian.IndependenceTest>` that measures the marginal association
+                   (e.g., :class:`LinearCorrelation <pybnesian.LinearCorrelation>` or
+                   :class:`MutualInformation <pybnesian.MutualInformation>`).
+:param k: Number of candidate parents of each node.
+:param nodes: The nodes. If empty (the default value), the node names are extracted from
+              :func:`IndependenceTest.variable_names() <pybnesian.IndependenceTest.variable_names>`.
+:param interface_nodes: The interface nodes, which can be candidate parents but do not have candidates.
+:param num_threads: Number of threads used to execute the independence tests. If 0, the number of hardware threads is
+                    used. The result does not depend on the number of threads.
+:returns: A dict that maps each node to the list of its candidate parents.
+)doc");
+
+    py::class_<HillClimbingCheckpoint, std::shared_ptr<HillClimbingCheckpoint>>(root, "HillClimbingCheckpoint", R"doc(
+The state of a :class:`GreedyHillClimbing` search after an iteration, saved with the ``checkpoint`` parameter of
+:func:`GreedyHillClimbing.estimate`. The search can be resumed from it with the ``resume`` parameter. Load it with
+:func:`pybnesian.load`.
+)doc")
+        .def("model", &HillClimbingCheckpoint::model, R"doc(
+Gets the current model of the search (not the best model found).
+
+:returns: The current model of the search.
+)doc")
+        .def("iteration", &HillClimbingCheckpoint::iteration, R"doc(
+Gets the number of iterations of the search.
+
+:returns: The number of iterations.
+)doc")
+        .def("patience_counter", &HillClimbingCheckpoint::patience_counter, R"doc(
+Gets the number of iterations since the best model was found.
+
+:returns: The patience counter of the search.
+)doc")
+        .def("score_memo", &HillClimbingCheckpoint::score_memo, R"doc(
+Gets the :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` of the search.
+
+:returns: The score memo of the search, or ``None``.
+)doc")
+        .def("save", &HillClimbingCheckpoint::save, py::arg("filename"), R"doc(
+Saves the :class:`HillClimbingCheckpoint` in a pickle file with the given name.
+
+:param filename: File name of the saved checkpoint.
+)doc")
+        .def(py::pickle([](const HillClimbingCheckpoint& self) { return self.__getstate__(); },
+                        [](py::tuple t) { return HillClimbingCheckpoint::__setstate__(t); }));
+
     py::class_<GreedyHillClimbing> hc(root, "GreedyHillClimbing", R"doc(
 This class implements a greedy hill-climbing algorithm. It finds the best structure applying small local changes
 iteratively. The best operator is found using a delta score.
@@ -163,6 +561,12 @@ Initializes a :class:`GreedyHillClimbing`.
                                  int,
                                  double,
                                  int,
+                                 int,
+                                 int,
+                                 const std::shared_ptr<LocalScoreMemo>,
+                                 const std::optional<std::string>&,
+                                 int,
+                                 const std::shared_ptr<HillClimbingCheckpoint>,
                                  int>(&GreedyHillClimbing::estimate<ConditionalBayesianNetworkBase>),
                py::arg("operators"),
                py::arg("score"),
@@ -176,7 +580,13 @@ Initializes a :class:`GreedyHillClimbing`.
                py::arg("max_iters") = std::numeric_limits<int>::max(),
                py::arg("epsilon") = 0,
                py::arg("patience") = 0,
-               py::arg("verbose") = 0)
+               py::arg("verbose") = 0,
+               py::arg("num_threads") = 1,
+               py::arg("score_memo") = nullptr,
+               py::arg("checkpoint") = std::nullopt,
+               py::arg("checkpoint_interval") = 1,
+               py::arg("resume") = nullptr,
+               py::arg("batch_operators") = 1)
             .def("estimate",
                  py::overload_cast<OperatorSet&,
                                    Score&,
@@ -190,6 +600,12 @@ Initializes a :class:`GreedyHillClimbing`.
                                    int,
                                    double,
                                    int,
+                                   int,
+                                   int,
+                                   const std::shared_ptr<LocalScoreMemo>,
+                                   const std::optional<std::string>&,
+                                   int,
+                                   const std::shared_ptr<HillClimbingCheckpoint>,
                                    int>(&GreedyHillClimbing::estimate<BayesianNetworkBase>),
                  py::arg("operators"),
                  py::arg("score"),
@@ -204,8 +620,14 @@ Initializes a :class:`GreedyHillClimbing`.
                  py::arg("epsilon") = 0,
                  py::arg("patience") = 0,
                  py::arg("verbose") = 0,
+                 py::arg("num_threads") = 1,
+                 py::arg("score_memo") = nullptr,
+                 py::arg("checkpoint") = std::nullopt,
+                 py::arg("checkpoint_interval") = 1,
+                 py::arg("resume") = nullptr,
+                 py::arg("batch_operators") = 1,
                  R"doc(
-estimate(self: pybnesian.GreedyHillClimbing, operators: pybnesian.OperatorSet, score: pybnesian.Score, start: BayesianNetworkBase or ConditionalBayesianNetworkBase, arc_blacklist: List[Tuple[str, str]] = [], arc_whitelist: List[Tuple[str, str]] = [], type_blacklist: List[Tuple[str, pybnesian.FactorType]] = [], type_whitelist: List[Tuple[str, pybnesian.FactorType]] = [], callback: pybnesian.Callback = None, max_indegree: int = 0, max_iters: int = 2147483647, epsilon: float = 0, patience: int = 0, verbose: int = 0) -> type[start]
+estimate(self: pybnesian.GreedyHillClimbing, operators: pybnesian.OperatorSet, score: pybnesian.Score, start: BayesianNetworkBase or ConditionalBayesianNetworkBase, arc_blacklist: List[Tuple[str, str]] = [], arc_whitelist: List[Tuple[str, str]] = [], type_blacklist: List[Tuple[str, pybnesian.FactorType]] = [], type_whitelist: List[Tuple[str, pybnesian.FactorType]] = [], callback: pybnesian.Callback = None, max_indegree: int = 0, max_iters: int = 2147483647, epsilon: float = 0, patience: int = 0, verbose: int = 0, num_threads: int = 1, score_memo: pybnesian.LocalScoreMemo = None, checkpoint: str = None, checkpoint_interval: int = 1, resume: pybnesian.HillClimbingCheckpoint = None, batch_operators: int = 1) -> type[start]
 
 Estimates the structure of a Bayesian network. The estimated Bayesian network is of the same type as ``start``. The set
 of operators allowed in the search is ``operators``. The delta score of each operator is evaluated using the ``score``.
@@ -229,10 +651,61 @@ There are many optional parameters that restricts to the learning process.
 :param patience: The patience parameter (only used with
                 :class:`ValidatedScore <pybnesian.ValidatedScore>`). See `patience`_.
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to cache the operators delta scores. If 0, the number of hardware threads
+                    is used. The result does not depend on the number of threads.
+:param score_memo: A :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` bound to ``score``. The local scores computed
+                   in the search are memoized in ``score_memo``, so they are not computed again in the next
+                   executions that use the same ``score_memo``. The result does not change.
+:param checkpoint: If not ``None``, name of the file where a :class:`HillClimbingCheckpoint` is saved every
+                   ``checkpoint_interval`` iterations. If ``score_memo`` is ``None``, a new
+                   :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` is created and saved with the checkpoints.
+:param checkpoint_interval: Number of iterations between checkpoints.
+:param resume: A :class:`HillClimbingCheckpoint` loaded with :func:`pybnesian.load`. If not ``None``, the search
+               continues from the model and the state of ``resume`` instead of ``start``, with the same
+               ``operators``, ``score`` and restrictions of the interrupted search. If ``score_memo`` is ``None``, the
+               memo of the checkpoint is used. The memo created by the checkpoints adopts ``score``, but a memo that
+               was bound must be bound to ``score`` with :func:`LocalScoreMemo.bind <pybnesian.LocalScoreMemo.bind>`.
+:param batch_operators: Maximum number of operators applied in each iteration. If greater than 1, each iteration
+                        applies the best operator and the next improving operators whose changed nodes are disjoint
+                        from the applied operators (so their delta scores do not interact) and that keep the graph
+                        acyclic, and the delta scores are updated once. This reduces the number of iterations of
+                        large searches. The callback is called for each applied operator.
 :returns: The estimated Bayesian network structure of the same type as ``start``.
 )doc");
     }
 
+    py::class_<PCCheckpoint, std::shared_ptr<PCCheckpoint>>(root, "PCCheckpoint", R"doc(
+The state of the skeleton search of :class:`PC` after a sepset order, saved with the ``checkpoint`` parameter of
+:func:`PC.estimate`. The search can be resumed from it with the ``resume`` parameter. Load it with
+:func:`pybnesian.load`.
+)doc")
+        .def("level", &PCCheckpoint::level, R"doc(
+Gets the next sepset order to test.
+
+:returns: The next sepset order.
+)doc")
+        .def(
+            "sepsets",
+            [](const PCCheckpoint& self) {
+                std::vector<std::tuple<std::string, std::string, std::vector<std::string>, double>> sepsets;
+                for (const auto& s : self.sepsets()) {
+                    sepsets.emplace_back(s.first, s.second, s.sepset, s.pvalue);
+                }
+                return sepsets;
+            },
+            R"doc(
+Gets the separating sets found in the search.
+
+:returns: A list of tuples (node1, node2, sepset, pvalue). The edge node1 - node2 was removed from the skeleton.
+)doc")
+        .def("save", &PCCheckpoint::save, py::arg("filename"), R"doc(
+Saves the :class:`PCCheckpoint` in a pickle file with the given name.
+
+:param filename: File name of the saved checkpoint.
+)doc")
+        .def(py::pickle([](const PCCheckpoint& self) { return self.__getstate__(); },
+                        [](py::tuple t) { return PCCheckpoint::__setstate__(t); }));
+
     py::class_<PC>(root, "PC", R"doc(
 This class implements the PC learning algorithm. The PC algorithm finds the best partially directed graph that expresses
 the conditional independences in the data.
@@ -259,6 +732,11 @@ Initializes a :class:`PC`.
              py::arg("ambiguous_threshold") = 0.5,
              py::arg("allow_bidirected") = true,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("checkpoint") = std::nullopt,
+             py::arg("resume") = nullptr,
+             py::arg("budget") = nullptr,
+             py::arg("association_order") = false,
              R"doc(
 Estimates the skeleton (the partially directed graph) using the PC algorithm.
 
@@ -283,8 +761,88 @@ Estimates the skeleton (the partially directed graph) using the PC algorithm.
                          order-independent while applying v-structures (as in LCPC and LMPC in [pc-stable]_). Otherwise,
                          it does not return bi-directed arcs.
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to execute the independence tests of the skeleton search. All the edges of
+                    the same sepset order are tested concurrently. If 0, the number of hardware threads is used. The
+                    result does not depend on the number of threads. With a :class:`LinearCorrelation` with
+                    :attr:`KDEBackend.OPENCL <pybnesian.KDEBackend.OPENCL>`, the conditioning sets of all the edges of
+                    the same sepset order are tested in batches with the OpenCL device instead.
+:param checkpoint: If not ``None``, name of the file where a :class:`PCCheckpoint` is saved after each sepset order of
+                   the skeleton search.
+:param resume: A :class:`PCCheckpoint` loaded with :func:`pybnesian.load`. If not ``None``, the skeleton search
+               continues from the sepset order of ``resume``, without testing again the edges removed in ``resume``.
+               The other parameters must be the same as in the interrupted search.
+:param budget: A :class:`SearchBudget`. If not ``None``, the skeleton search stops when the budget runs out, keeping
+               the edges that were not tested. The edges with a larger marginal p-value are tested first, because they
+               are the most likely to be removed. A sepset order interrupted by the budget is not saved in
+               ``checkpoint``.
+:param association_order: If True, the edges with the weakest marginal association (the largest marginal p-value) are
+                          tested first, and the conditioning sets made of the adjacent variables most strongly
+                          associated with the edge (the smallest marginal p-values with its nodes) are tested first.
+                          Independent edges usually find their sepset with fewer tests. The skeleton is the same, but
+                          the sepsets found can be different, so the v-structures can change if ``use_sepsets`` is
+                          ``True``. The association is not known in a search resumed after the marginal tests.
 :returns: A :class:`PartiallyDirectedGraph <pybnesian.PartiallyDirectedGraph>` trained by PC that represents
           the conditional independences in ``hypot_test``.
+)doc")
+        .def(
+            "estimate_async",
+            [](const PC&,
+               const std::shared_ptr<IndependenceTest>& hypot_test,
+               const std::vector<std::string>& nodes,
+               const ArcStringVector& arc_blacklist,
+               const ArcStringVector& arc_whitelist,
+               const EdgeStringVector& edge_blacklist,
+               const EdgeStringVector& edge_whitelist,
+               double alpha,
+               bool use_sepsets,
+               double ambiguous_threshold,
+               bool allow_bidirected,
+               int num_threads,
+               const std::optional<std::string>& checkpoint,
+               const std::shared_ptr<PCCheckpoint>& resume,
+               const std::shared_ptr<SearchBudget>& budget,
+               bool association_order) {
+                return learning::algorithms::pc_async(hypot_test,
+                                                      nodes,
+                                                      arc_blacklist,
+                                                      arc_whitelist,
+                                                      edge_blacklist,
+                                                      edge_whitelist,
+                                                      alpha,
+                                                      use_sepsets,
+                                                      ambiguous_threshold,
+                                                      allow_bidirected,
+                                                      num_threads,
+                                                      checkpoint,
+                                                      resume,
+                                                      budget,
+                                                      association_order);
+            },
+            py::arg("hypot_test"),
+            py::arg("nodes") = std::vector<std::string>(),
+            py::arg("arc_blacklist") = ArcStringVector(),
+            py::arg("arc_whitelist") = ArcStringVector(),
+            py::arg("edge_blacklist") = EdgeStringVector(),
+            py::arg("edge_whitelist") = EdgeStringVector(),
+            py::arg("alpha") = 0.05,
+            py::arg("use_sepsets") = false,
+            py::arg("ambiguous_threshold") = 0.5,
+            py::arg("allow_bidirected") = true,
+            py::arg("num_threads") = 1,
+            py::arg("checkpoint") = std::nullopt,
+            py::arg("resume") = nullptr,
+            py::arg("budget") = nullptr,
+            py::arg("association_order") = false,
+            R"doc(
+Executes :func:`PC.estimate` asynchronously, and returns immediately. Cancelling the returned :class:`LearningTask`
+stops the skeleton search as a :class:`SearchBudget` that runs out, so the result keeps the edges that were not tested.
+
+The parameters are the same as in :func:`PC.estimate` (without ``verbose``). Python-derived independence tests are not
+supported, because the search runs without the GIL.
+
+:returns: A :class:`LearningTask` whose result is the estimated
+          :class:`PartiallyDirectedGraph <pybnesian.PartiallyDirectedGraph>`.
+:raises ValueError: If ``hypot_test`` is a Python-derived independence test.
 )doc")
         .def("estimate_conditional",
              &PC::estimate_conditional,
@@ -300,6 +858,11 @@ Estimates the skeleton (the partially directed graph) using the PC algorithm.
              py::arg("ambiguous_threshold") = 0.5,
              py::arg("allow_bidirected") = true,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("checkpoint") = std::nullopt,
+             py::arg("resume") = nullptr,
+             py::arg("budget") = nullptr,
+             py::arg("association_order") = false,
              R"doc(
 Estimates the conditional skeleton (the conditional partially directed graph) using the PC algorithm.
 
@@ -324,6 +887,21 @@ Estimates the conditional skeleton (the conditional partially directed graph) us
                          order-independent while applying v-structures (as in LCPC and LMPC in [pc-stable]_). Otherwise,
                          it does not return bi-directed arcs.
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to execute the independence tests of the skeleton search. All the edges of
+                    the same sepset order are tested concurrently. If 0, the number of hardware threads is used. The
+                    result does not depend on the number of threads. With a :class:`LinearCorrelation` with
+                    :attr:`KDEBackend.OPENCL <pybnesian.KDEBackend.OPENCL>`, the conditioning sets of all the edges of
+                    the same sepset order are tested in batches with the OpenCL device instead.
+:param checkpoint: If not ``None``, name of the file where a :class:`PCCheckpoint` is saved after each sepset order of
+                   the skeleton search.
+:param resume: A :class:`PCCheckpoint` loaded with :func:`pybnesian.load`. If not ``None``, the skeleton search
+               continues from the sepset order of ``resume``, without testing again the edges removed in ``resume``.
+               The other parameters must be the same as in the interrupted search.
+:param budget: A :class:`SearchBudget`. If not ``None``, the skeleton search stops when the budget runs out, keeping
+               the edges that were not tested. The edges with a larger marginal p-value are tested first, because they
+               are the most likely to be removed. A sepset order interrupted by the budget is not saved in
+               ``checkpoint``.
+:param association_order: The same as in :func:`PC.estimate`.
 :returns: A :class:`ConditionalPartiallyDirectedGraph <pybnesian.ConditionalPartiallyDirectedGraph>` trained by PC
           that represents the conditional independences in ``hypot_test``.
 )doc");
@@ -377,6 +955,29 @@ Applies the rule 3 to ``graph``.
 
 :param graph: Graph to apply the rule 3.
 :returns: True if the rule changed the graph, False otherwise.
+)doc")
+            .def_static(
+                "apply",
+                [](PartiallyDirectedGraph& graph, int num_threads) { return MeekRules::apply(graph, num_threads); },
+                py::arg("graph"),
+                py::arg("num_threads") = 1)
+            .def_static(
+                "apply",
+                [](ConditionalPartiallyDirectedGraph& graph, int num_threads) {
+                    return MeekRules::apply(graph, num_threads);
+                },
+                py::arg("graph"),
+                py::arg("num_threads") = 1,
+                R"doc(
+apply(graph: pybnesian.PartiallyDirectedGraph or pybnesian.ConditionalPartiallyDirectedGraph, num_threads: int = 1) -> bool
+
+Applies the rules 1, 2 and 3 to ``graph`` until no more edges can be directed. Only the edges incident to the nodes of
+the last directed arcs are evaluated again, so it is faster than applying each rule until convergence.
+
+:param graph: Graph to apply the rules.
+:param num_threads: Number of threads used to evaluate the rules in the edges. If 0, the number of hardware threads is
+                    used.
+:returns: True if the rules changed the graph, False otherwise.
 )doc");
     }
 
@@ -404,6 +1005,8 @@ Initializes a :class:`MMPC`.
              py::arg("ambiguous_threshold") = 0.5,
              py::arg("allow_bidirected") = true,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("lazy") = false,
              R"doc(
 Estimates the skeleton (the partially directed graph) using the MMPC algorithm.
 
@@ -423,6 +1026,13 @@ Estimates the skeleton (the partially directed graph) using the MMPC algorithm.
                          order-independent while applying v-structures (as in LCPC and LMPC in [pc-stable]_). Otherwise,
                          it does not return bi-directed arcs.
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to execute the independence tests. The forward and backward phases of
+                    different variables are executed concurrently. If 0, the number of hardware threads is used. The
+                    result does not depend on the number of threads.
+:param lazy: If True, the forward phase keeps the candidates in a priority queue ordered by their (stale) association,
+             and only the top candidate is tested with the new conditioning sets until it is up to date. The
+             association can only decrease as the CPC grows, so the result is the same, but many less independence
+             tests are executed.
 :returns: A :class:`PartiallyDirectedGraph <pybnesian.PartiallyDirectedGraph>` trained by MMPC.
 )doc")
         .def("estimate_conditional",
@@ -438,6 +1048,8 @@ Estimates the skeleton (the partially directed graph) using the MMPC algorithm.
              py::arg("ambiguous_threshold") = 0.5,
              py::arg("allow_bidirected") = true,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("lazy") = false,
              R"doc(
 Estimates the conditional skeleton (the conditional partially directed graph) using the MMPC algorithm.
 
@@ -457,6 +1069,13 @@ Estimates the conditional skeleton (the conditional partially directed graph) us
                          order-independent while applying v-structures (as in LCPC and LMPC in [pc-stable]_). Otherwise,
                          it does not return bi-directed arcs.
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to execute the independence tests. The forward and backward phases of
+                    different variables are executed concurrently. If 0, the number of hardware threads is used. The
+                    result does not depend on the number of threads.
+:param lazy: If True, the forward phase keeps the candidates in a priority queue ordered by their (stale) association,
+             and only the top candidate is tested with the new conditioning sets until it is up to date. The
+             association can only decrease as the CPC grows, so the result is the same, but many less independence
+             tests are executed.
 :returns: A :class:`PartiallyDirectedGraph <pybnesian.PartiallyDirectedGraph>` trained by MMPC.
 )doc");
 
@@ -486,6 +1105,9 @@ This class implements Max-Min Hill-Climbing (MMHC) [mmhc]_. The MMHC algorithm f
              py::arg("patience") = 0,
              py::arg("alpha") = 0.05,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("score_memo") = nullptr,
+             py::arg("start") = nullptr,
              R"doc(
 Estimates the structure of a Bayesian network. This implementation calls :class:`MMPC` and :class:`GreedyHillClimbing`
 with the set of parameters provided.
@@ -514,6 +1136,16 @@ with the set of parameters provided.
                 :class:`GreedyHillClimbing`).
 :param alpha: The type I error of each independence test (for :class:`MMPC`).
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to execute the independence tests (for :class:`MMPC`) and to cache the
+                    operators delta scores (for :class:`GreedyHillClimbing`). If 0, the number of hardware threads is
+                    used. The result does not depend on the number of threads.
+:param score_memo: A :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` bound to ``score`` to memoize the local
+                   scores of :class:`GreedyHillClimbing`.
+:param start: A previously learned :class:`BayesianNetworkBase <pybnesian.BayesianNetworkBase>` (e.g., in the previous
+              window of a stream of data) to warm start the search. :class:`MMPC` verifies and repairs the skeleton of
+              ``start`` instead of searching the possible arcs from scratch, and :class:`GreedyHillClimbing` starts
+              from the arcs of ``start`` that are allowed by the new skeleton. The node types of ``start`` are not
+              used. If None, the search starts from scratch.
 :returns: The Bayesian network structure learned by MMHC.
 )doc")
         .def("estimate_conditional",
@@ -537,6 +1169,9 @@ with the set of parameters provided.
              py::arg("patience") = 0,
              py::arg("alpha") = 0.05,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("score_memo") = nullptr,
+             py::arg("start") = nullptr,
              R"doc(
 Estimates the structure of a conditional Bayesian network. This implementation calls :class:`MMPC` and
 :class:`GreedyHillClimbing` with the set of parameters provided.
@@ -565,7 +1200,173 @@ Estimates the structure of a conditional Bayesian network. This implementation c
                 :class:`GreedyHillClimbing`).
 :param alpha: The type I error of each independence test (for :class:`MMPC`).
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to execute the independence tests (for :class:`MMPC`) and to cache the
+                    operators delta scores (for :class:`GreedyHillClimbing`). If 0, the number of hardware threads is
+                    used. The result does not depend on the number of threads.
+:param score_memo: A :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` bound to ``score`` to memoize the local
+                   scores of :class:`GreedyHillClimbing`.
+:param start: A previously learned :class:`ConditionalBayesianNetworkBase <pybnesian.ConditionalBayesianNetworkBase>`
+              to warm start the search. :class:`MMPC` verifies and repairs the skeleton of ``start`` instead of
+              searching the possible arcs from scratch, and :class:`GreedyHillClimbing` starts from the arcs of
+              ``start`` that are allowed by the new skeleton. The node types of ``start`` are not used. If None, the
+              search starts from scratch.
 :returns: The conditional Bayesian network structure learned by MMHC.
+)doc");
+
+    py::class_<GES>(root, "GES", R"doc(
+This class implements the Greedy Equivalence Search (GES) [ges]_. GES searches over the space of equivalence classes,
+represented by completed partially directed acyclic graphs (CPDAGs). A forward phase inserts edges while the score
+improves, and then a backward phase deletes edges while the score improves.
+
+As the search is performed over equivalence classes, no iteration is spent on score-equivalent changes (e.g. reversing
+a reversible arc). For this reason, the :class:`Score <pybnesian.Score>` must be score-equivalent.
+)doc")
+        .def(py::init<>())
+        .def("estimate",
+             &GES::estimate,
+             py::arg("score"),
+             py::arg("nodes") = std::vector<std::string>(),
+             py::arg("bn_type") = GaussianNetworkType::get(),
+             py::arg("edge_blacklist") = EdgeStringVector(),
+             py::arg("epsilon") = 0,
+             py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("score_memo") = nullptr,
+             R"doc(
+Estimates the structure of a Bayesian network. The returned Bayesian network is a consistent extension
+of the learned CPDAG.
+
+:param score: A score-equivalent :class:`Score <pybnesian.Score>` that drives the search (e.g.
+              :class:`BIC <pybnesian.BIC>` or :class:`BGe <pybnesian.BGe>`).
+:param nodes: The list of nodes of the returned graph. If empty (the default value), the node names are extracted from
+              ``score.data()``.
+:param bn_type: A homogeneous :class:`BayesianNetworkType <pybnesian.BayesianNetworkType>` that defines the node type
+                of all the nodes.
+:param edge_blacklist: List of edge blacklist (forbidden edges).
+:param epsilon: Minimum delta score allowed for each operator. If the best operator is less than epsilon, the phase of
+                the search is stopped.
+:param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to evaluate the operators. If 0, the number of hardware threads is used.
+                    The result does not depend on the number of threads.
+:param score_memo: A :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` bound to ``score`` to memoize the local
+                   scores.
+:returns: A Bayesian network of the learned equivalence class.
+)doc")
+        .def("estimate_cpdag",
+             &GES::estimate_cpdag,
+             py::arg("score"),
+             py::arg("nodes") = std::vector<std::string>(),
+             py::arg("bn_type") = GaussianNetworkType::get(),
+             py::arg("edge_blacklist") = EdgeStringVector(),
+             py::arg("epsilon") = 0,
+             py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("score_memo") = nullptr,
+             R"doc(
+Estimates the equivalence class of a Bayesian network.
+
+:param score: A score-equivalent :class:`Score <pybnesian.Score>` that drives the search (e.g.
+              :class:`BIC <pybnesian.BIC>` or :class:`BGe <pybnesian.BGe>`).
+:param nodes: The list of nodes of the returned graph. If empty (the default value), the node names are extracted from
+              ``score.data()``.
+:param bn_type: A homogeneous :class:`BayesianNetworkType <pybnesian.BayesianNetworkType>` that defines the node type
+                of all the nodes.
+:param edge_blacklist: List of edge blacklist (forbidden edges).
+:param epsilon: Minimum delta score allowed for each operator. If the best operator is less than epsilon, the phase of
+                the search is stopped.
+:param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to evaluate the operators. If 0, the number of hardware threads is used.
+                    The result does not depend on the number of threads.
+:param score_memo: A :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` bound to ``score`` to memoize the local
+                   scores.
+:returns: A :class:`PartiallyDirectedGraph <pybnesian.PartiallyDirectedGraph>` with the learned CPDAG.
+)doc");
+
+    py::class_<ExactSearch>(root, "ExactSearch", R"doc(
+This class finds the Bayesian network structure with the optimal score by dynamic programming over the subsets of nodes
+[exact]_. The local score of each parent set is cached (in parallel for the different nodes), and the parent sets with a
+subset of better (or equal) score are pruned, because they can not be part of an optimal structure. Then, the best
+structure of each subset of nodes is found from the best structures of its subsets.
+
+The time and memory are exponential in the number of nodes (it uses :math:`9 \cdot 2^{n}` bytes for :math:`n` nodes), so
+it is only practical for a small number of nodes (up to about 25). The :class:`Score <pybnesian.Score>` must be
+decomposable (e.g. :class:`BIC <pybnesian.BIC>`, :class:`BDe <pybnesian.BDe>` or :class:`BGe <pybnesian.BGe>`).
+)doc")
+        .def(py::init<>())
+        .def("estimate",
+             &ExactSearch::estimate,
+             py::arg("score"),
+             py::arg("nodes") = std::vector<std::string>(),
+             py::arg("bn_type") = GaussianNetworkType::get(),
+             py::arg("arc_blacklist") = ArcStringVector(),
+             py::arg("arc_whitelist") = ArcStringVector(),
+             py::arg("max_indegree") = 0,
+             py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             R"doc(
+Estimates the structure of a Bayesian network with the optimal score.
+
+:param score: A decomposable :class:`Score <pybnesian.Score>` that drives the search.
+:param nodes: The list of nodes of the returned graph. If empty (the default value), the node names are extracted from
+              ``score.data()``.
+:param bn_type: A homogeneous :class:`BayesianNetworkType <pybnesian.BayesianNetworkType>` that defines the node type
+                of all the nodes.
+:param arc_blacklist: List of arcs blacklist (forbidden arcs).
+:param arc_whitelist: List of arcs whitelist (forced arcs).
+:param max_indegree: Maximum indegree allowed in the graph. If 0, the indegree is not limited. Limiting the indegree
+                     reduces the number of local scores that are evaluated.
+:param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to cache the local scores and to search the subsets of nodes. If 0, the
+                    number of hardware threads is used. The result does not depend on the number of threads.
+:returns: The Bayesian network with the optimal score.
+:raises ValueError: If there are more than 30 nodes, or no structure satisfies the arc whitelist, the arc blacklist and
+                    ``max_indegree``.
+)doc");
+
+    py::class_<OrderBasedSearch>(root, "OrderBasedSearch", R"doc(
+This class implements the ordering-based search [obs]_. It is a greedy hill-climbing over the topological orders of the
+nodes, where each node takes the parent set with the best local score among its predecessors in the order. The only
+operator swaps two adjacent nodes in the order.
+
+The local scores of the parent sets of each node are cached once (in parallel for the different nodes), so the search
+itself does not evaluate any local score. The parent sets with a subset of better (or equal) score are pruned, because
+they are never selected. The number of parent sets is limited with ``max_indegree`` and
+:func:`candidate_parents <pybnesian.candidate_parents>`, which makes the search practical for large networks.
+)doc")
+        .def(py::init<>())
+        .def("estimate",
+             &OrderBasedSearch::estimate,
+             py::arg("score"),
+             py::arg("nodes") = std::vector<std::string>(),
+             py::arg("bn_type") = GaussianNetworkType::get(),
+             py::arg("candidate_parents") = CandidateParents(),
+             py::arg("max_indegree") = 0,
+             py::arg("max_iters") = std::numeric_limits<int>::max(),
+             py::arg("epsilon") = 0,
+             py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
+             py::arg("score_memo") = nullptr,
+             R"doc(
+Estimates the structure of a Bayesian network. The search starts from the order of ``nodes``.
+
+:param score: A decomposable :class:`Score <pybnesian.Score>` that drives the search.
+:param nodes: The list of nodes of the returned graph, in the initial order of the search. If empty (the default
+              value), the node names are extracted from ``score.data()``.
+:param bn_type: A homogeneous :class:`BayesianNetworkType <pybnesian.BayesianNetworkType>` that defines the node type
+                of all the nodes.
+:param candidate_parents: A dict with the candidate parents of each node (e.g. the result of
+                          :func:`candidate_parents <pybnesian.candidate_parents>`). The nodes that are not in the dict
+                          can have any parent.
+:param max_indegree: Maximum indegree allowed in the graph. If 0, the indegree is not limited, so the number of cached
+                     local scores is exponential in the number of candidate parents.
+:param max_iters: Maximum number of search iterations.
+:param epsilon: Minimum delta score allowed for each swap. If the best swap is less than epsilon, the search is stopped.
+:param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used to cache the local scores. If 0, the number of hardware threads is used. The
+                    result does not depend on the number of threads.
+:param score_memo: A :class:`LocalScoreMemo <pybnesian.LocalScoreMemo>` bound to ``score`` to memoize the local
+                   scores, so they can be reused by other searches.
+:returns: The estimated Bayesian network structure.
 )doc");
 
     py::class_<DMMHC>(root, "DMMHC", R"doc(
@@ -589,6 +1390,7 @@ train the static and transition components of the dynamic Bayesian network.
              py::arg("patience") = 0,
              py::arg("alpha") = 0.05,
              py::arg("verbose") = 0,
+             py::arg("num_threads") = 1,
              R"doc(
 Estimates a dynamic Bayesian network. This implementation uses :class:`MMHC` to estimate both the static and transition
 Bayesian networks. This set of parameters are provided to the functions :func:`MMHC.estimate` and
@@ -616,6 +1418,10 @@ Bayesian networks. This set of parameters are provided to the functions :func:`M
                 :class:`GreedyHillClimbing`).
 :param alpha: The type I error of each independence test (for :class:`MMPC`).
 :param verbose: If True the progress will be displayed, otherwise nothing will be displayed.
+:param num_threads: Number of threads used in :class:`MMPC` and :class:`GreedyHillClimbing`. If 0, the number of
+                    hardware threads is used. If ``num_threads != 1``, the skeletons of the static and transition
+                    networks are searched at the same time, each one with half of the threads, unless some object is
+                    implemented in Python.
 :returns: The dynamic Bayesian network structure learned by DMMHC.
 )doc");
 }
@@ -0,0 +1,62 @@
+#ifndef PYBNESIAN_PYBINDINGS_BATCH_HPP
+#define PYBNESIAN_PYBINDINGS_BATCH_HPP
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+namespace py = pybind11;
+
+namespace pybindings::learning {
+
+// The batched overrides (local_scores_batch() and pvalues_batch()) receive the sets of variables as two NumPy int32
+// arrays: indices, with the concatenated indices of all the sets, and offsets, of length n + 1, so the i-th set is
+// indices[offsets[i]:offsets[i + 1]].
+struct IndexSets {
+    py::array_t<int32_t> indices;
+    py::array_t<int32_t> offsets;
+};
+
+// Encodes the sets, where index(v) is the index of the variable v.
+template <typename Sets, typename Index>
+IndexSets encode_index_sets(const Sets& sets, Index&& index) {
+    size_t total = 0;
+    for (const auto& s : sets) {
+        total += s.size();
+    }
+
+    py::array_t<int32_t> indices(total);
+    py::array_t<int32_t> offsets(sets.size() + 1);
+    auto raw_indices = indices.mutable_data();
+    auto raw_offsets = offsets.mutable_data();
+
+    int32_t k = 0;
+    raw_offsets[0] = 0;
+    for (size_t i = 0; i < sets.size(); ++i) {
+        for (const auto& v : sets[i]) {
+            raw_indices[k++] = index(v);
+        }
+        raw_offsets[i + 1] = k;
+    }
+
+    return IndexSets{std::move(indices), std::move(offsets)};
+}
+
+// Converts the result of a batched override to a std::vector<double> with size elements. name is the name of the
+// override in the error messages.
+inline std::vector<double> decode_batch_result(py::object o, size_t size, const std::string& name) {
+    // ensure() returns an empty handle if o cannot be converted.
+    auto values = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(o);
+
+    if (!values || values.ndim() != 1)
+        throw std::runtime_error("The returned object of " + name + " is not a 1-D array of double.");
+
+    if (static_cast<size_t>(values.size()) != size)
+        throw std::runtime_error("The returned array of " + name + " must contain " + std::to_string(size) +
+                                 " elements.");
+
+    return std::vector<double>(values.data(), values.data() + size);
+}
+
+}  // namespace pybindings::learning
+
+#endif  // PYBNESIAN_PYBINDINGS_BATCH_HPP
@@ -1,19 +1,27 @@
+#include <algorithm>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/eigen.h>
 #include <learning/independences/independence.hpp>
+#include <learning/independences/cached_independence.hpp>
+#include <learning/independences/distributed_independence.hpp>
 #include <learning/independences/continuous/linearcorrelation.hpp>
 #include <learning/independences/continuous/mutual_information.hpp>
 #include <learning/independences/continuous/RCoT.hpp>
 #include <learning/independences/discrete/chi_square.hpp>
 #include <learning/independences/hybrid/mutual_information.hpp>
+#include <pybindings/pybindings_learning/pybindings_batch.hpp>
 #include <util/util_types.hpp>
 
 namespace py = pybind11;
 
-using learning::independences::IndependenceTest, learning::independences::continuous::LinearCorrelation,
-    learning::independences::continuous::KMutualInformation, learning::independences::continuous::RCoT,
-    learning::independences::discrete::ChiSquare, learning::independences::hybrid::MutualInformation;
+using learning::independences::IndependenceTest, learning::independences::CachedIndependenceTest,
+    learning::independences::DistributedIndependenceTest, learning::independences::IndependenceTransport,
+    learning::independences::IndependenceTestRequest,
+    learning::independences::continuous::LinearCorrelation,
+    learning::independences::continuous::KMutualInformation, learning::independences::continuous::PermutationTestResult,
+    learning::independences::continuous::RCoT, learning::independences::discrete::ChiSquare,
+    learning::independences::hybrid::MutualInformation;
 
 using learning::independences::DynamicIndependenceTest, learning::independences::continuous::DynamicLinearCorrelation,
     learning::independences::continuous::DynamicKMutualInformation, learning::independences::continuous::DynamicRCoT,
@@ -25,6 +33,8 @@ class PyIndependenceTest : public IndependenceTest {
 public:
     using IndependenceTest::IndependenceTest;
 
+    bool is_python_derived() const override { return true; }
+
     double pvalue(const std::string& v1, const std::string& v2) const override {
         PYBIND11_OVERRIDE_PURE(double,           /* Return type */
                                IndependenceTest, /* Parent class */
@@ -55,6 +65,88 @@ public:
         );
     }
 
+    std::vector<double> pvalues(const std::string& v1,
+                                const std::string& v2,
+                                const std::vector<std::vector<std::string>>& evs) const override {
+        {
+            py::gil_scoped_acquire gil;
+            py::function batch = pybind11::get_override(static_cast<const IndependenceTest*>(this), "pvalues_batch");
+            if (batch) {
+                py::array_t<int32_t> x(evs.size());
+                py::array_t<int32_t> y(evs.size());
+                std::fill(x.mutable_data(), x.mutable_data() + evs.size(), index(v1));
+                std::fill(y.mutable_data(), y.mutable_data() + evs.size(), index(v2));
+                auto sets = pybindings::learning::encode_index_sets(
+                    evs, [this](const std::string& v) { return index(v); });
+                return call_pvalues_batch(batch, x, y, sets);
+            }
+        }
+
+        PYBIND11_OVERRIDE(std::vector<double>, /* Return type */
+                          IndependenceTest,    /* Parent class */
+                          pvalues,             /* Name of function in C++ (must match Python name) */
+                          v1,
+                          v2,
+                          evs /* Argument(s) */
+        );
+    }
+
+    std::vector<double> pvalues(const std::vector<std::pair<std::string, std::string>>& pairs,
+                                const std::vector<std::string>& ev) const override {
+        {
+            py::gil_scoped_acquire gil;
+            py::function batch = pybind11::get_override(static_cast<const IndependenceTest*>(this), "pvalues_batch");
+            if (batch) {
+                std::vector<std::pair<int, int>> index_pairs;
+                index_pairs.reserve(pairs.size());
+                for (const auto& pair : pairs) {
+                    index_pairs.push_back({index(pair.first), index(pair.second)});
+                }
+
+                std::vector<int> index_ev;
+                index_ev.reserve(ev.size());
+                for (const auto& e : ev) {
+                    index_ev.push_back(index(e));
+                }
+
+                return pairs_pvalues_batch(batch, index_pairs, index_ev);
+            }
+        }
+
+        PYBIND11_OVERRIDE(std::vector<double>, /* Return type */
+                          IndependenceTest,    /* Parent class */
+                          pvalues,             /* Name of function in C++ (must match Python name) */
+                          pairs,
+                          ev /* Argument(s) */
+        );
+    }
+
+    std::vector<double> pvalues(const std::vector<std::pair<int, int>>& pairs,
+                                const std::vector<int>& ev) const override {
+        {
+            py::gil_scoped_acquire gil;
+            py::function batch = pybind11::get_override(static_cast<const IndependenceTest*>(this), "pvalues_batch");
+            if (batch) return pairs_pvalues_batch(batch, pairs, ev);
+        }
+
+        return IndependenceTest::pvalues(pairs, ev);
+    }
+
+    std::size_t native_batch_size() const override {
+        py::gil_scoped_acquire gil;
+        auto self = static_cast<const IndependenceTest*>(this);
+        if (py::function override = pybind11::get_override(self, "native_batch_size")) {
+            return override().cast<std::size_t>();
+        }
+
+        // The Python tests that implement pvalues_batch() or pvalues() are assumed to evaluate the batches natively.
+        if (pybind11::get_override(self, "pvalues_batch") || pybind11::get_override(self, "pvalues")) {
+            return unlimited_batch_size;
+        }
+
+        return 1;
+    }
+
     int num_variables() const override {
         PYBIND11_OVERRIDE_PURE(int,              /* Return type */
                                IndependenceTest, /* Parent class */
@@ -92,6 +184,51 @@ public:
                                cols              /* Argument(s) */
         );
     }
+
+private:
+    // pvalues_batch(x, y, z, offsets) runs the tests x[i] _|_ y[i] | z[offsets[i]:offsets[i + 1]], where the variables
+    // are the indices of name().
+    static std::vector<double> call_pvalues_batch(const py::function& batch,
+                                                  const py::array_t<int32_t>& x,
+                                                  const py::array_t<int32_t>& y,
+                                                  const pybindings::learning::IndexSets& sets) {
+        auto o = batch(x, y, sets.indices, sets.offsets);
+        return pybindings::learning::decode_batch_result(
+            std::move(o), x.size(), "IndependenceTest::pvalues_batch");
+    }
+
+    static std::vector<double> pairs_pvalues_batch(const py::function& batch,
+                                                   const std::vector<std::pair<int, int>>& pairs,
+                                                   const std::vector<int>& ev) {
+        py::array_t<int32_t> x(pairs.size());
+        py::array_t<int32_t> y(pairs.size());
+        auto raw_x = x.mutable_data();
+        auto raw_y = y.mutable_data();
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            raw_x[i] = pairs[i].first;
+            raw_y[i] = pairs[i].second;
+        }
+
+        // All the tests share the same conditioning set.
+        std::vector<std::vector<int>> evs(pairs.size(), ev);
+        auto sets = pybindings::learning::encode_index_sets(evs, [](int v) { return v; });
+        return call_pvalues_batch(batch, x, y, sets);
+    }
+};
+
+class PyIndependenceTransport : public IndependenceTransport {
+public:
+    using IndependenceTransport::IndependenceTransport;
+
+    bool is_python_derived() const override { return true; }
+
+    std::vector<std::vector<double>> evaluate(const std::vector<IndependenceTestRequest>& requests) const override {
+        PYBIND11_OVERRIDE_PURE(std::vector<std::vector<double>>, /* Return type */
+                               IndependenceTransport,            /* Parent class */
+                               evaluate, /* Name of function in C++ (must match Python name) */
+                               requests  /* Argument(s) */
+        );
+    }
 };
 
 void pybindings_independence_tests(py::module& root) {
@@ -101,6 +238,13 @@ The :class:`IndependenceTest` is an abstract class defining an interface for a c
 
 An :class:`IndependenceTest` is defined over a set of variables and can calculate the p-value of any conditional test on
 these variables.
+
+A Python-derived :class:`IndependenceTest` can also implement the method
+``pvalues_batch(self, x, y, z, offsets)``. The learning algorithms call it instead of :func:`IndependenceTest.pvalues`
+with all the tests of a batch encoded as NumPy ``int32`` arrays, so the tests can be vectorized with NumPy or JAX. The
+``i``-th test is :math:`x_{i} \perp y_{i} \mid \mathbf{z}_{i}`, where ``x[i]`` and ``y[i]`` are the indices of the
+variables (see :func:`IndependenceTest.name`), and :math:`\mathbf{z}_{i}` are the indices
+``z[offsets[i]:offsets[i + 1]]``. It must return an array with the p-value of each test.
 )doc");
     indep_test
         .def(py::init<>(), R"doc(
@@ -149,6 +293,58 @@ Calculates the p-value of a multivariate conditional test of independence :math:
 :param y: A variable name.
 :param z: A list of variable names.
 :returns: The p-value of a multivariate conditional test of independence :math:`x \perp y \mid \mathbf{z}`.
+)doc")
+        .def(
+            "pvalues",
+            [](IndependenceTest& self,
+               const std::string& v1,
+               const std::string& v2,
+               const std::vector<std::vector<std::string>>& conds) { return self.pvalues(v1, v2, conds); },
+            py::arg("x"),
+            py::arg("y"),
+            py::arg("z"),
+            R"doc(
+Calculates the p-values of the conditional tests of independence :math:`x \perp y \mid \mathbf{z}_{i}` for each
+conditioning set :math:`\mathbf{z}_{i}` in ``z``. An empty conditioning set is an unconditional test, and a conditioning
+set of one variable is an univariate conditional test.
+
+Some tests share the data extraction of :math:`x` and :math:`y` between the tests, so this method can be faster than
+calling :func:`IndependenceTest.pvalue` for each conditioning set.
+
+:param x: A variable name.
+:param y: A variable name.
+:param z: A list of conditioning sets. Each conditioning set is a list of variable names.
+:returns: A list with the p-value of each conditional test of independence.
+)doc")
+        .def(
+            "pvalues",
+            [](IndependenceTest& self,
+               const std::vector<std::pair<std::string, std::string>>& pairs,
+               const std::vector<std::string>& cond) { return self.pvalues(pairs, cond); },
+            py::arg("pairs"),
+            py::arg("z"),
+            R"doc(
+Calculates the p-values of the conditional tests of independence :math:`x \perp y \mid \mathbf{z}` for each pair of
+variables :math:`(x, y)` in ``pairs`` with the same conditioning set :math:`\mathbf{z}`. An empty conditioning set is an
+unconditional test, and a conditioning set of one variable is an univariate conditional test.
+
+Some tests share the data extraction of :math:`\mathbf{z}` between the tests, so this method can be faster than calling
+:func:`IndependenceTest.pvalue` for each pair.
+
+:param pairs: A list of tuples of variable names.
+:param z: A list of variable names.
+:returns: A list with the p-value of each conditional test of independence.
+)doc")
+        .def("native_batch_size", &IndependenceTest::native_batch_size, R"doc(
+Gets the maximum number of conditioning sets that :func:`IndependenceTest.pvalues` evaluates together, sharing work
+between them. The learning algorithms that stop at the first independent conditioning set (e.g., the sepset searches of
+:class:`PC` and :class:`MMPC`) test the sets in batches of at most this size, so the tests that do not batch natively
+(that return 1) do not evaluate the sets after the independent one.
+
+The default is 1, unless a Python-derived test implements ``pvalues`` or ``pvalues_batch`` (then, the batches have no
+maximum size). It can be overridden by the Python-derived tests.
+
+:returns: The maximum number of conditioning sets evaluated together.
 )doc")
         .def("num_variables", &IndependenceTest::num_variables, R"doc(
 Gets the number of variables of the :class:`IndependenceTest`.
@@ -165,6 +361,21 @@ Gets the variable name of the index-th variable.
 
 :param index: Index of the variable.
 :returns: Variable name at the ``index`` position.
+)doc")
+        .def("memory_usage", &IndependenceTest::memory_usage, R"doc(
+Returns the memory used by the caches of the test (e.g., the Cholesky factors of :class:`LinearCorrelation`, the
+entropies of :class:`MutualInformation` or the memoized p-values of :class:`CachedIndependenceTest`). The tests
+implemented in Python return an empty report.
+
+:returns: A :class:`MemoryUsage <pybnesian.MemoryUsage>`.
+)doc")
+        .def("set_max_cache_memory", &IndependenceTest::set_max_cache_memory, py::arg("max_memory"), R"doc(
+Limits the memory of the caches of the test. If the caches use more memory, their oldest entries are removed, and the
+new entries are not cached if they do not fit in the limit. It is applied to the caches of :class:`LinearCorrelation`,
+:class:`MutualInformation`, :class:`KMutualInformation` and :class:`RCoT`. :class:`CachedIndependenceTest` sets its
+``max_memory`` and limits the caches of the wrapped test. The other tests ignore it.
+
+:param max_memory: Maximum number of bytes of the caches.
 )doc");
 
     {
@@ -193,10 +404,22 @@ Checks whether this :class:`IndependenceTest` has the given ``variables``.
 This class implements a partial linear correlation independence test. This independence is only valid for continuous
 data.
 )doc")
-        .def(py::init<const DataFrame&>(), py::arg("df"), R"doc(
+        .def(py::init<const DataFrame&, KDEBackend>(),
+             py::arg("df"),
+             py::arg("backend") = KDEBackend::CPU,
+             R"doc(
 Initializes a :class:`LinearCorrelation` for the continuous variables in the DataFrame ``df``.
 
 :param df: DataFrame on which to calculate the independence tests.
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device that computes the partial correlations
+                of the batched tests of the :class:`PC` skeleton search. With
+                :attr:`KDEBackend.OPENCL <pybnesian.KDEBackend.OPENCL>`, the covariance of ``df`` is uploaded once
+                to the OpenCL device, and the tests of each sepset order are evaluated in batches with the device. The
+                OpenCL device is only used if ``df`` does not contain null values. With
+                :attr:`KDEBackend.AUTO <pybnesian.KDEBackend.AUTO>`, the OpenCL device is used if it is a GPU.
+)doc")
+        .def_property_readonly("backend", &LinearCorrelation::backend, R"doc(
+The :class:`KDEBackend <pybnesian.KDEBackend>` that computes the batched tests.
 )doc");
 
     py::class_<MutualInformation, IndependenceTest, std::shared_ptr<MutualInformation>>(root,
@@ -266,6 +489,28 @@ Estimates the multivariate conditional mutual information :math:`\text{MI}(x, y
 :param y: A variable name.
 :param z: A list of variable names.
 :returns: The multivariate conditional mutual information :math:`\text{MI}(x, y \mid \mathbf{z})`.
+)doc");
+
+    py::class_<PermutationTestResult>(root, "PermutationTestResult", R"doc(
+The result of a permutation test of :class:`KMutualInformation`, returned by
+:func:`KMutualInformation.permutation_test`.
+)doc")
+        .def_readonly("pvalue", &PermutationTestResult::pvalue, R"doc(
+Proportion of the evaluated permutations whose statistic is greater or equal than the original statistic.
+)doc")
+        .def_readonly("permutations", &PermutationTestResult::permutations, R"doc(
+Number of evaluated permutations. It is lower than ``samples`` if the permutations stopped early.
+)doc")
+        .def_readonly("lower_bound", &PermutationTestResult::lower_bound, R"doc(
+Lower bound of the Clopper-Pearson confidence interval of the p-value.
+)doc")
+        .def_readonly("upper_bound", &PermutationTestResult::upper_bound, R"doc(
+Upper bound of the Clopper-Pearson confidence interval of the p-value.
+)doc")
+        .def_readonly("confidence", &PermutationTestResult::confidence, R"doc(
+Confidence of the interval [:attr:`PermutationTestResult.lower_bound`, :attr:`PermutationTestResult.upper_bound`]. It
+is the confidence of each check of the early stopping, so the interval does not contain ``alpha`` if the permutations
+stopped early.
 )doc");
 
     py::class_<KMutualInformation, IndependenceTest, std::shared_ptr<KMutualInformation>>(
@@ -275,14 +520,40 @@ using k-nearest neighbors. This independence is only implemented for continuous
 
 This independence test is based on [CMIknn]_.
 )doc")
-        .def(py::init([](DataFrame df, int k, std::optional<unsigned int> seed, int shuffle_neighbors, int samples) {
-                 return KMutualInformation(df, k, random_seed_arg(seed), shuffle_neighbors, samples);
+        .def(py::init([](DataFrame df,
+                         int k,
+                         std::optional<unsigned int> seed,
+                         int shuffle_neighbors,
+                         int samples,
+                         std::optional<double> alpha,
+                         double confidence,
+                         int num_threads,
+                         double knn_eps,
+                         int64_t subsample,
+                         KDEBackend backend) {
+                 return std::make_shared<KMutualInformation>(df,
+                                                             k,
+                                                             random_seed_arg(seed),
+                                                             shuffle_neighbors,
+                                                             samples,
+                                                             alpha,
+                                                             confidence,
+                                                             num_threads,
+                                                             knn_eps,
+                                                             subsample,
+                                                             backend);
              }),
              py::arg("df"),
              py::arg("k"),
              py::arg("seed") = std::nullopt,
              py::arg("shuffle_neighbors") = 5,
              py::arg("samples") = 1000,
+             py::arg("alpha") = std::nullopt,
+             py::arg("confidence") = 0.99,
+             py::arg("num_threads") = 1,
+             py::arg("knn_eps") = 0.,
+             py::arg("subsample") = 0,
+             py::arg("backend") = KDEBackend::CPU,
              R"doc(
 Initializes a :class:`KMutualInformation` for data ``df``. ``k`` is the number of neighbors in the k-nn model used to
 estimate the mutual information.
@@ -291,11 +562,44 @@ This is a permutation independence test, so ``samples`` defines the number of pe
 (:math:`k_{perm}` in the original paper [CMIknn]_) defines how many neighbors are used to perform the conditional
 permutations.
 
+If ``alpha`` is specified, the permutations stop early when the p-value is clearly above or below ``alpha``: the
+permutations are evaluated in blocks and, after each block, the test stops if the Clopper-Pearson confidence interval
+of the p-value does not contain ``alpha``. The returned p-value is then the proportion of the evaluated permutations,
+and it is on the correct side of ``alpha`` with probability at least ``confidence``.
+
+Each permutation uses a random generator derived from the ``seed`` and the number of the permutation, so the result
+does not depend on ``num_threads``.
+
+If ``knn_eps`` is greater than 0, the k-nn searches are approximate: the distance to each returned neighbor is at most
+:math:`1 + \epsilon` times the distance to the exact neighbor. This is much faster with many conditioning variables.
+
+If ``subsample`` is greater than 0 and ``df`` has more rows, the tests use a uniform random sample of ``subsample`` rows
+of ``df``, drawn with ``seed``. The same sample is used in all the tests, so their results are consistent.
+
+With :attr:`KDEBackend.OPENCL <pybnesian.KDEBackend.OPENCL>`, the tests with many rows or many conditioning variables
+compute the k-nn searches and the neighbor counts by brute force with the OpenCL device. These searches are always
+exact, so ``knn_eps`` is ignored by them.
+
 :param df: DataFrame on which to calculate the independence tests.
 :param k: number of neighbors in the k-nn model used to estimate the mutual information.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
 :param shuffle_neighbors: Number of neighbors used to perform the conditional permutation.
 :param samples: Number of permutations for the :class:`KMutualInformation`.
+:param alpha: Significance level used to stop the permutations early. If not specified or ``None``, all the ``samples``
+              permutations are evaluated.
+:param confidence: Confidence of the early stopping decision.
+:param num_threads: Number of threads used to evaluate the permutations and the k-nn searches. If 0, the number of
+                    hardware threads is used.
+:param knn_eps: Approximation factor :math:`\epsilon` of the k-nn searches. If 0, the searches are exact.
+:param subsample: Number of rows of the random sample used in the tests. If 0, all the rows are used.
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device of the k-nn searches. With
+                :attr:`KDEBackend.AUTO <pybnesian.KDEBackend.AUTO>`, the OpenCL device is used if it is a GPU.
+)doc")
+        .def_property_readonly("subsample", &KMutualInformation::subsample, R"doc(
+Number of rows of the random sample used in the tests (0 if all the rows are used).
+)doc")
+        .def_property_readonly("backend", &KMutualInformation::backend, R"doc(
+The :class:`KDEBackend <pybnesian.KDEBackend>` that computes the brute force k-nn searches.
 )doc")
         .def(
             "mi",
@@ -341,6 +645,27 @@ Estimates the multivariate conditional mutual information :math:`\text{MI}(x, y
 :param y: A variable name.
 :param z: A list of variable names.
 :returns: The multivariate conditional mutual information :math:`\text{MI}(x, y \mid \mathbf{z})`.
+)doc")
+        .def(
+            "permutation_test",
+            [](KMutualInformation& self,
+               const std::string& x,
+               const std::string& y,
+               const std::optional<std::vector<std::string>>& z) {
+                return z ? self.permutation_test(x, y, *z) : self.permutation_test(x, y);
+            },
+            py::arg("x"),
+            py::arg("y"),
+            py::arg("z") = std::nullopt,
+            R"doc(
+Runs the permutation test of :func:`IndependenceTest.pvalue` for :math:`x \perp y \mid \mathbf{z}`, and returns the
+p-value with the number of evaluated permutations and the confidence interval of the p-value. It is useful to check the
+early stopping with ``alpha``.
+
+:param x: A variable name.
+:param y: A variable name.
+:param z: A list of variable names. If not specified or ``None``, the unconditional test is run.
+:returns: A :class:`PermutationTestResult`.
 )doc");
 
     py::class_<RCoT, IndependenceTest, std::shared_ptr<RCoT>>(root, "RCoT", R"doc(
@@ -349,28 +674,253 @@ method is described in [RCoT]_. This independence is only implemented for contin
 
 This method uses random fourier features and is designed to be a fast non-parametric independence test.
 )doc")
-        .def(py::init<const DataFrame&, int, int>(),
+        .def(py::init([](const DataFrame& df,
+                         int random_fourier_xy,
+                         int random_fourier_z,
+                         std::size_t cache_memory,
+                         std::optional<unsigned int> seed,
+                         KDEBackend backend,
+                         int64_t subsample) {
+                 return std::make_shared<RCoT>(
+                     df, random_fourier_xy, random_fourier_z, cache_memory, random_seed_arg(seed), backend, subsample);
+             }),
              py::arg("df"),
              py::arg("random_fourier_xy") = 5,
              py::arg("random_fourier_z") = 100,
+             py::arg("cache_memory") = 0,
+             py::arg("seed") = std::nullopt,
+             py::arg("backend") = KDEBackend::CPU,
+             py::arg("subsample") = 0,
              R"doc(
 Initializes a :class:`RCoT` for data ``df``. The number of random fourier features used for the ``x`` and ``y`` variables
 in :class:`IndependenceTest.pvalue` is ``random_fourier_xy``. The number of random features used for ``z`` is equal
 to ``random_fourier_z``.
 
+If ``cache_memory`` is greater than 0, the random fourier features of each variable are generated once, with a fixed
+seed for each variable, and reused in the following independence tests. At most ``cache_memory`` bytes of features are
+cached. The features of the variables with missing values, and of a ``z`` with more than one variable, are not cached.
+
+If ``subsample`` is greater than 0 and ``df`` has more rows, the tests use a uniform random sample of ``subsample`` rows
+of ``df``, drawn with ``seed``. The same sample is used in all the tests, so their results are consistent.
+
 :param df: DataFrame on which to calculate the independence tests.
 :param random_fourier_xy: Number of random fourier features for the variables of the independence test.
 :param randoum_fourier_z: Number of random fourier features for the conditioning variables of the independence test.
+:param cache_memory: Maximum number of bytes of the cached random fourier features. If 0, the features are not cached.
+:param seed: A random seed number to generate the random fourier features, with or without the cache. The tests
+             return the same p-values with the same seed. If not specified or ``None``, a random seed is generated.
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device that computes the random fourier
+                features and the covariance of their products. With :attr:`KDEBackend.AUTO <pybnesian.KDEBackend.AUTO>`,
+                the OpenCL devices are used if the default device is a GPU.
+:param subsample: Number of rows of the random sample used in the tests. If 0, all the rows are used.
+)doc")
+        .def_property_readonly("backend", &RCoT::backend, R"doc(
+The :class:`KDEBackend <pybnesian.KDEBackend>` that computes the random fourier features.
+)doc")
+        .def_property_readonly("subsample", &RCoT::subsample, R"doc(
+Number of rows of the random sample used in the tests (0 if all the rows are used).
 )doc");
 
     py::class_<ChiSquare, IndependenceTest, std::shared_ptr<ChiSquare>>(root, "ChiSquare", R"doc(
+This class implements the Pearson's X^2 test (or the G-test) for categorical data.
+)doc")
+        .def(py::init([](const DataFrame& df,
+                         bool g_test,
+                         bool adjusted_df,
+                         int permutations,
+                         std::optional<unsigned int> seed) {
+                 return std::make_shared<ChiSquare>(df, g_test, adjusted_df, permutations, random_seed_arg(seed));
+             }),
+             py::arg("df"),
+             py::arg("g_test") = false,
+             py::arg("adjusted_df") = false,
+             py::arg("permutations") = 0,
+             py::arg("seed") = std::nullopt,
+             R"doc(
 Initializes a :class:`ChiSquare` for data ``df``. This independence test is only valid for categorical data.
 
-It implements the Pearson's X^2 test.
+If ``adjusted_df`` is true, the degrees of freedom of each contingency table only count its non-empty rows and columns.
+This avoids the loss of power of the test when the contingency tables are sparse (e.g. with many evidence variables).
+
+If ``permutations`` is greater than 0, the p-value is not computed with the asymptotic :math:`\chi^{2}` distribution.
+Instead, the statistic is compared with the statistic of ``permutations`` random permutations of ``x`` within each
+configuration of the evidence.
 
 :param df: DataFrame on which to calculate the independence tests.
+:param g_test: If true, the statistic is the G-test (log-likelihood ratio) statistic. Otherwise, it is the Pearson's X^2
+               statistic.
+:param adjusted_df: If true, the degrees of freedom are adjusted to the non-empty rows and columns of each table.
+:param permutations: Number of permutations of the permutation test. If 0, the asymptotic test is used.
+:param seed: A random seed number to generate the permutations. If not specified or ``None``, a random seed is
+             generated.
+)doc")
+        .def_property_readonly("g_test", &ChiSquare::g_test, R"doc(
+Whether the statistic is the G-test statistic.
+)doc")
+        .def_property_readonly("adjusted_df", &ChiSquare::adjusted_df, R"doc(
+Whether the degrees of freedom are adjusted to the non-empty rows and columns of each table.
+)doc")
+        .def_property_readonly("permutations", &ChiSquare::permutations, R"doc(
+Number of permutations of the permutation test (0 if the asymptotic test is used).
+)doc");
+
+    py::class_<CachedIndependenceTest, IndependenceTest, std::shared_ptr<CachedIndependenceTest>>(
+        root, "CachedIndependenceTest", R"doc(
+This class memoizes the p-values of another :class:`IndependenceTest`. The tests are canonicalized, so the tests
+:math:`x \perp y \mid \mathbf{z}` and :math:`y \perp x \mid \mathbf{z}'` for any permutation :math:`\mathbf{z}'` of
+:math:`\mathbf{z}` are run only once. The least recently used p-values are removed when the memory of the memo exceeds
+:func:`CachedIndependenceTest.max_memory`.
+
+It can be passed to many executions of :func:`PC.estimate <pybnesian.PC.estimate>`,
+:func:`MMPC.estimate <pybnesian.MMPC.estimate>` or :func:`MMHC.estimate <pybnesian.MMHC.estimate>` with the same data,
+so the tests run in an execution are not run again in the next executions. It is thread-safe.
+)doc")
+        .def(py::init<std::shared_ptr<IndependenceTest>, size_t>(),
+             py::arg("test"),
+             py::arg("max_memory") = CachedIndependenceTest::default_max_memory,
+             py::keep_alive<1, 2>(),
+             R"doc(
+Initializes a :class:`CachedIndependenceTest` for the given ``test``.
+
+:param test: The :class:`IndependenceTest` whose p-values are memoized.
+:param max_memory: Maximum memory (in bytes) of the memoized p-values.
+)doc")
+        .def_property_readonly("test", &CachedIndependenceTest::test, R"doc(
+The memoized :class:`IndependenceTest`, or ``None`` if the memo is not bound to a test.
+)doc")
+        .def("bind", &CachedIndependenceTest::bind, py::arg("test"), py::keep_alive<1, 2>(), R"doc(
+Binds the memo to ``test``. A :class:`CachedIndependenceTest` loaded with :func:`pybnesian.load` is not bound to any
+test and it must be bound to a test with the same data before it is used.
+
+:param test: An :class:`IndependenceTest` of the same type (and data) of the test that was memoized.
+)doc")
+        .def("__len__", &CachedIndependenceTest::size, R"doc(
+Gets the number of memoized p-values.
+
+:returns: Number of memoized p-values.
+)doc")
+        .def("memory", &CachedIndependenceTest::memory, R"doc(
+Gets the approximate memory (in bytes) used by the memoized p-values.
+
+:returns: Memory of the memoized p-values.
+)doc")
+        .def("max_memory", &CachedIndependenceTest::max_memory, R"doc(
+Gets the maximum memory (in bytes) of the memoized p-values.
+
+:returns: Maximum memory of the memoized p-values.
+)doc")
+        .def("hits", &CachedIndependenceTest::hits, R"doc(
+Gets the number of tests whose p-value was found in the memo.
+
+:returns: Number of memo hits.
+)doc")
+        .def("misses", &CachedIndependenceTest::misses, R"doc(
+Gets the number of tests that were run and added to the memo.
+
+:returns: Number of memo misses.
 )doc")
-        .def(py::init<const DataFrame&>(), py::arg("df"));
+        .def("clear", &CachedIndependenceTest::clear, R"doc(
+Removes all the memoized p-values.
+)doc")
+        .def("save", &CachedIndependenceTest::save, py::arg("filename"), R"doc(
+Saves the :class:`CachedIndependenceTest` in a pickle file with the given name. The memoized test is not saved, so the
+loaded memo must be bound to a test with :func:`CachedIndependenceTest.bind`.
+
+:param filename: File name of the saved memo.
+)doc")
+        .def(py::pickle([](const CachedIndependenceTest& self) { return self.__getstate__(); },
+                        [](py::tuple t) { return CachedIndependenceTest::__setstate__(t); }));
+
+    py::class_<IndependenceTestRequest>(root, "IndependenceTestRequest", R"doc(
+A batch of independence tests :math:`x \perp y \mid \mathbf{z}` sent by a :class:`DistributedIndependenceTest` to its
+:class:`IndependenceTransport`: one test for each conditioning set :math:`\mathbf{z}` in ``evs``.
+)doc")
+        .def(py::init<std::string, std::string, std::vector<std::vector<std::string>>>(),
+             py::arg("x"),
+             py::arg("y"),
+             py::arg("evs"),
+             R"doc(
+Initializes an :class:`IndependenceTestRequest`.
+
+:param x: A variable name.
+:param y: A variable name.
+:param evs: List of conditioning sets.
+)doc")
+        .def_readonly("x", &IndependenceTestRequest::x, R"doc(
+A variable name.
+)doc")
+        .def_readonly("y", &IndependenceTestRequest::y, R"doc(
+A variable name.
+)doc")
+        .def_readonly("evs", &IndependenceTestRequest::evs, R"doc(
+List of conditioning sets.
+)doc")
+        .def(py::pickle(
+            [](const IndependenceTestRequest& self) { return py::make_tuple(self.x, self.y, self.evs); },
+            [](py::tuple t) {
+                if (t.size() != 3) throw std::runtime_error("Not valid IndependenceTestRequest.");
+                return IndependenceTestRequest{t[0].cast<std::string>(),
+                                               t[1].cast<std::string>(),
+                                               t[2].cast<std::vector<std::vector<std::string>>>()};
+            }));
+
+    py::class_<IndependenceTransport, PyIndependenceTransport, std::shared_ptr<IndependenceTransport>>(
+        root, "IndependenceTransport", R"doc(
+An :class:`IndependenceTransport` sends the independence tests of a :class:`DistributedIndependenceTest` to a set of
+workers, and gathers the p-values. For example, a transport can be implemented with ``mpi4py`` or a
+``concurrent.futures`` pool of processes. Each worker holds the same data (and an independence test over it), and runs
+the tests with :func:`evaluate_independence_tests`, so the transport only sends the requests and the p-values.
+
+:func:`PC.estimate <pybnesian.PC.estimate>` and :func:`MMPC.estimate <pybnesian.MMPC.estimate>` call
+:func:`IndependenceTransport.evaluate` concurrently from each of their threads, so the ``num_threads`` of the algorithm
+is the number of requests that are run by the workers at the same time.
+)doc")
+        .def(py::init<>(), R"doc(
+Initializes an :class:`IndependenceTransport`.
+)doc")
+        .def("evaluate", &IndependenceTransport::evaluate, py::arg("requests"), R"doc(
+Runs the independence tests of the ``requests`` in the workers.
+
+:param requests: List of :class:`IndependenceTestRequest`.
+:returns: A list with the p-value of each conditioning set, for each request.
+)doc");
+
+    py::class_<DistributedIndependenceTest, IndependenceTest, std::shared_ptr<DistributedIndependenceTest>>(
+        root, "DistributedIndependenceTest", R"doc(
+An :class:`IndependenceTest` that runs all its tests in the workers of an :class:`IndependenceTransport`. The learning
+algorithms keep the skeleton and the sepsets, so only the tests of each level and their p-values are exchanged with the
+workers.
+)doc")
+        .def(py::init<std::shared_ptr<IndependenceTest>, std::shared_ptr<IndependenceTransport>>(),
+             py::arg("test"),
+             py::arg("transport"),
+             R"doc(
+Initializes a :class:`DistributedIndependenceTest`.
+
+:param test: A local :class:`IndependenceTest` with the same variables as the tests of the workers. It is only used for
+             the names of the variables.
+:param transport: :class:`IndependenceTransport` to the workers.
+)doc")
+        .def_property_readonly("test", &DistributedIndependenceTest::test, R"doc(
+The local :class:`IndependenceTest`.
+)doc")
+        .def_property_readonly("transport", &DistributedIndependenceTest::transport, R"doc(
+The :class:`IndependenceTransport` to the workers.
+)doc");
+
+    root.def("evaluate_independence_tests",
+             &learning::independences::evaluate_independence_tests,
+             py::arg("test"),
+             py::arg("requests"),
+             py::arg("num_threads") = 1,
+             R"doc(
+Runs the :class:`IndependenceTestRequest` of an :class:`IndependenceTransport` in a worker.
+
+:param test: :class:`IndependenceTest` of the worker.
+:param requests: List of :class:`IndependenceTestRequest`.
+:param num_threads: Number of threads used to run the requests. If 0, the number of hardware threads is used.
+:returns: A list with the p-value of each conditioning set, for each request.
+)doc");
 
     py::class_<DynamicIndependenceTest, std::shared_ptr<DynamicIndependenceTest>> dynamic_indep_test(
         root, "DynamicIndependenceTest", R"doc(
@@ -475,43 +1025,93 @@ The dynamic adaptation of the :class:`KMutualInformation` independence test.
                          int k,
                          std::optional<unsigned int> seed,
                          int shuffle_neighbors,
-                         int samples) {
-                 return DynamicKMutualInformation(
-                     df, k, static_cast<unsigned int>(random_seed_arg(seed)), shuffle_neighbors, samples);
+                         int samples,
+                         std::optional<double> alpha,
+                         double confidence,
+                         int num_threads,
+                         double knn_eps,
+                         int64_t subsample) {
+                 return std::make_shared<DynamicKMutualInformation>(df,
+                                                                    k,
+                                                                    static_cast<unsigned int>(random_seed_arg(seed)),
+                                                                    shuffle_neighbors,
+                                                                    samples,
+                                                                    alpha,
+                                                                    confidence,
+                                                                    num_threads,
+                                                                    knn_eps,
+                                                                    subsample);
              }),
              py::arg("ddf"),
              py::arg("k"),
              py::arg("seed") = std::nullopt,
              py::arg("shuffle_neighbors") = 5,
              py::arg("samples") = 1000,
+             py::arg("alpha") = std::nullopt,
+             py::arg("confidence") = 0.99,
+             py::arg("num_threads") = 1,
+             py::arg("knn_eps") = 0.,
+             py::arg("subsample") = 0,
              R"doc(
 Initializes a :class:`DynamicKMutualInformation` with the given :class:`DynamicDataFrame` ``df``. The ``k``, ``seed``,
-``shuffle_neighbors`` and ``samples`` parameters are passed to the static and transition components of
-:class:`KMutualInformation`.
+``shuffle_neighbors``, ``samples``, ``alpha``, ``confidence``, ``num_threads``, ``knn_eps`` and ``subsample`` parameters
+are passed to the static and transition components of :class:`KMutualInformation`.
 
 :param ddf: :class:`DynamicDataFrame` to create the :class:`DynamicKMutualInformation`.
 :param k: number of neighbors in the k-nn model used to estimate the mutual information.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
 :param shuffle_neighbors: Number of neighbors used to perform the conditional permutation.
 :param samples: Number of permutations for the :class:`KMutualInformation`.
+:param alpha: Significance level used to stop the permutations early. If not specified or ``None``, all the ``samples``
+              permutations are evaluated.
+:param confidence: Confidence of the early stopping decision.
+:param num_threads: Number of threads used to evaluate the permutations and the k-nn searches. If 0, the number of
+                    hardware threads is used.
+:param knn_eps: Approximation factor :math:`\epsilon` of the k-nn searches. If 0, the searches are exact.
+:param subsample: Number of rows of the random sample used in the tests. If 0, all the rows are used.
 )doc");
 
     py::class_<DynamicRCoT, DynamicIndependenceTest, std::shared_ptr<DynamicRCoT>>(
         root, "DynamicRCoT", py::multiple_inheritance(), R"doc(
 The dynamic adaptation of the :class:`RCoT` independence test.
 )doc")
-        .def(py::init<const DynamicDataFrame&, int, int>(),
+        .def(py::init([](const DynamicDataFrame& ddf,
+                         int random_fourier_xy,
+                         int random_fourier_z,
+                         std::size_t cache_memory,
+                         std::optional<unsigned int> seed,
+                         KDEBackend backend,
+                         int64_t subsample) {
+                 return std::make_shared<DynamicRCoT>(ddf,
+                                                      random_fourier_xy,
+                                                      random_fourier_z,
+                                                      cache_memory,
+                                                      static_cast<unsigned int>(random_seed_arg(seed)),
+                                                      backend,
+                                                      subsample);
+             }),
              py::arg("ddf"),
              py::arg("random_fourier_xy") = 5,
              py::arg("random_fourier_z") = 100,
+             py::arg("cache_memory") = 0,
+             py::arg("seed") = std::nullopt,
+             py::arg("backend") = KDEBackend::CPU,
+             py::arg("subsample") = 0,
              R"doc(
-Initializes a :class:`DynamicRCoT` with the given :class:`DynamicDataFrame` ``df``. The ``random_fourier_xy`` and
-``random_fourier_z`` parameters are passed to the static and transition components of
-:class:`RCoT`.
+Initializes a :class:`DynamicRCoT` with the given :class:`DynamicDataFrame` ``df``. The ``random_fourier_xy``,
+``random_fourier_z``, ``cache_memory``, ``seed``, ``backend`` and ``subsample`` parameters are passed to the static and
+transition components of :class:`RCoT`.
 
 :param ddf: :class:`DynamicDataFrame` to create the :class:`DynamicRCoT`.
 :param random_fourier_xy: Number of random fourier features for the variables of the independence test.
 :param randoum_fourier_z: Number of random fourier features for the conditioning variables of the independence test.
+:param cache_memory: Maximum number of bytes of the cached random fourier features of each component. If 0, the
+                     features are not cached.
+:param seed: A random seed number to generate the random fourier features, with or without the cache. The tests
+             return the same p-values with the same seed. If not specified or ``None``, a random seed is generated.
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device that computes the random fourier
+                features.
+:param subsample: Number of rows of the random sample used in the tests. If 0, all the rows are used.
 )doc");
 
     py::class_<DynamicChiSquare, DynamicIndependenceTest, std::shared_ptr<DynamicChiSquare>>(
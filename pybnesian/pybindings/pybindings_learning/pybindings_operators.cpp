@@ -6,7 +6,8 @@ namespace py = pybind11;
 
 using learning::operators::Operator, learning::operators::ArcOperator, learning::operators::AddArc,
     learning::operators::RemoveArc, learning::operators::FlipArc, learning::operators::ChangeNodeType,
-    learning::operators::OperatorTabuSet, learning::operators::LocalScoreCache, learning::operators::OperatorSet,
+    learning::operators::OperatorTabuSet, learning::operators::LocalScoreMemo, learning::operators::LocalScoreCache,
+    learning::operators::OperatorSet, learning::operators::CandidateParents,
     learning::operators::ArcOperatorSet, learning::operators::ChangeNodeTypeSet, learning::operators::OperatorPool;
 
 void register_ArcOperators(py::module& m) {
@@ -500,6 +501,30 @@ public:
         );
     }
 
+    void set_num_threads(int num_threads) override {
+        PYBIND11_OVERRIDE(void,            /* Return type */
+                          OperatorSet,     /* Parent class */
+                          set_num_threads, /* Name of function in C++ (must match Python name) */
+                          num_threads      /* Argument(s) */
+        );
+    }
+
+    void set_neighborhood_sampling(double ratio, unsigned int seed) override {
+        PYBIND11_OVERRIDE(void,                      /* Return type */
+                          OperatorSet,               /* Parent class */
+                          set_neighborhood_sampling, /* Name of function in C++ (must match Python name) */
+                          ratio,                     /* Argument(s) */
+                          seed);
+    }
+
+    void set_candidate_parents(const CandidateParents& candidates) override {
+        PYBIND11_OVERRIDE(void,                  /* Return type */
+                          OperatorSet,           /* Parent class */
+                          set_candidate_parents, /* Name of function in C++ (must match Python name) */
+                          candidates             /* Argument(s) */
+        );
+    }
+
     void set_type_blacklist(const FactorTypeVector& type_blacklist) override {
         PYBIND11_OVERRIDE(void,               /* Return type */
                           OperatorSet,        /* Parent class */
@@ -667,6 +692,58 @@ Gets the new :class:`FactorType` of the :class:`ChangeNodeType`.
 
     register_OperatorTabuSet(root);
 
+    py::class_<LocalScoreMemo, std::shared_ptr<LocalScoreMemo>>(root, "LocalScoreMemo", R"doc(
+This class memoizes the local scores of a :class:`Score <pybnesian.Score>` for each (variable, node type, parents). It
+can be passed to many executions of :func:`GreedyHillClimbing.estimate <pybnesian.GreedyHillClimbing.estimate>` or
+:func:`MMHC.estimate <pybnesian.MMHC.estimate>` with the same score, so the local scores computed in an execution are
+not computed again in the next executions. The least recently used local scores are removed when the memory of the memo
+exceeds :func:`LocalScoreMemo.max_memory`.
+)doc")
+        .def(py::init<std::shared_ptr<Score>, size_t>(),
+             py::arg("score"),
+             py::arg("max_memory") = LocalScoreMemo::default_max_memory,
+             py::keep_alive<1, 2>(),
+             R"doc(
+Initializes a :class:`LocalScoreMemo` for the given ``score``.
+
+:param score: The :class:`Score <pybnesian.Score>` whose local scores are memoized.
+:param max_memory: Maximum memory (in bytes) of the memoized local scores.
+)doc")
+        .def("bind", &LocalScoreMemo::bind, py::arg("score"), py::keep_alive<1, 2>(), R"doc(
+Binds the memo to ``score``. A bound :class:`LocalScoreMemo` loaded with :func:`pybnesian.load` is not bound to any
+score and it must be bound to a score with the same data before it is used. An unbound memo (e.g., the memo created by
+the checkpoints of :func:`GreedyHillClimbing.estimate <pybnesian.GreedyHillClimbing.estimate>`) adopts the first score
+used after it is loaded, and it keeps the memoized local scores if the score has the same type and variables.
+
+:param score: A :class:`Score <pybnesian.Score>` of the same type (and data) of the score that was memoized.
+)doc")
+        .def("__len__", &LocalScoreMemo::size, R"doc(
+Gets the number of memoized local scores.
+
+:returns: Number of memoized local scores.
+)doc")
+        .def("memory", &LocalScoreMemo::memory, R"doc(
+Gets the approximate memory (in bytes) used by the memoized local scores.
+
+:returns: Memory of the memoized local scores.
+)doc")
+        .def("max_memory", &LocalScoreMemo::max_memory, R"doc(
+Gets the maximum memory (in bytes) of the memoized local scores.
+
+:returns: Maximum memory of the memoized local scores.
+)doc")
+        .def("clear", &LocalScoreMemo::clear, R"doc(
+Removes all the memoized local scores.
+)doc")
+        .def("save", &LocalScoreMemo::save, py::arg("filename"), R"doc(
+Saves the :class:`LocalScoreMemo` in a pickle file with the given name. The score is not saved, so the loaded memo must
+be bound to a score with :func:`LocalScoreMemo.bind` if it was bound.
+
+:param filename: File name of the saved memo.
+)doc")
+        .def(py::pickle([](const LocalScoreMemo& self) { return self.__getstate__(); },
+                        [](py::tuple t) { return LocalScoreMemo::__setstate__(t); }));
+
     py::class_<LocalScoreCache, std::shared_ptr<LocalScoreCache>>(root, "LocalScoreCache", R"doc(
 This class implements a cache for the local score of each node.
 )doc")
@@ -678,11 +755,17 @@ Initializes a :class:`LocalScoreCache` for the given ``model``.
 
 :param model: A Bayesian network model.
 )doc")
-        .def("cache_local_scores", &LocalScoreCache::cache_local_scores, py::arg("model"), py::arg("score"), R"doc(
+        .def("cache_local_scores",
+             &LocalScoreCache::cache_local_scores,
+             py::arg("model"),
+             py::arg("score"),
+             py::arg("num_threads") = 1,
+             R"doc(
 Caches the local score for all the nodes.
 
 :param model: A Bayesian network model.
 :param score: A :class:`Score <pybnesian.Score>` object to calculate the score.
+:param num_threads: Number of threads used to compute the local scores.
 )doc")
         .def("cache_vlocal_scores", &LocalScoreCache::cache_vlocal_scores, py::arg("model"), py::arg("score"), R"doc(
 Caches the validation local score for all the nodes.
@@ -829,6 +912,39 @@ Sets the arc whitelist (a list of arcs that are forced).
 Sets the max indegree allowed. This may change the set of valid operators.
 
 :param max_indegree: Max indegree allowed.
+)doc")
+        .def("set_num_threads", &OperatorSet::set_num_threads, py::arg("num_threads"), R"doc(
+Sets the number of threads used to cache the delta scores. If 0, the number of hardware threads is used.
+
+:param num_threads: Number of threads.
+)doc")
+        .def("set_neighborhood_sampling",
+             &OperatorSet::set_neighborhood_sampling,
+             py::arg("ratio"),
+             py::arg("seed") = 0,
+             R"doc(
+Sets a stochastic neighborhood: each time the delta scores of a node are computed, only a random sample of the
+operators that add a parent to the node is evaluated. The operators that remove or flip an arc are always evaluated.
+This reduces the cost of :func:`OperatorSet.cache_scores` and :func:`OperatorSet.update_scores` in large networks. The
+sample does not depend on the number of threads.
+
+Only :class:`ArcOperatorSet` (and :class:`OperatorPool` with an :class:`ArcOperatorSet`) implements this method.
+
+:param ratio: Probability of evaluating each operator that adds an arc. It must be in the interval (0, 1]. A ratio of 1
+              evaluates all the operators.
+:param seed: Seed of the random samples.
+)doc")
+        .def("set_candidate_parents", &OperatorSet::set_candidate_parents, py::arg("candidates"), R"doc(
+Restricts the operators that add a parent to each node to a set of candidate parents (e.g., selected with
+:func:`pybnesian.candidate_parents`). The delta scores are stored only for the candidates, so the memory and the cost
+of :func:`OperatorSet.cache_scores` and :func:`OperatorSet.update_scores` are proportional to the number of candidates
+instead of the number of nodes. The current parents of each node when :func:`OperatorSet.cache_scores` is called are
+also candidates. An empty dict removes the restriction.
+
+Only :class:`ArcOperatorSet` (and :class:`OperatorPool` with an :class:`ArcOperatorSet`) implements this method.
+
+:param candidates: A dict that maps each node to the list of its candidate parents. The nodes that are not in the dict
+                   only keep their current parents.
 )doc")
         .def(
             "set_type_blacklist",
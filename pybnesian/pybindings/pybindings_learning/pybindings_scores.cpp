@@ -7,13 +7,16 @@
 #include <learning/scores/cv_likelihood.hpp>
 #include <learning/scores/holdout_likelihood.hpp>
 #include <learning/scores/validated_likelihood.hpp>
+#include <learning/scores/distributed_score.hpp>
+#include <pybindings/pybindings_learning/pybindings_batch.hpp>
 #include <util/util_types.hpp>
 
 namespace py = pybind11;
 
 using learning::scores::Score, learning::scores::ValidatedScore, learning::scores::BIC, learning::scores::BGe,
     learning::scores::BDe, learning::scores::CVLikelihood, learning::scores::HoldoutLikelihood,
-    learning::scores::ValidatedLikelihood;
+    learning::scores::ValidatedLikelihood, learning::scores::DistributedScore, learning::scores::ScoreTransport,
+    learning::scores::LocalScoreRequest;
 
 using learning::scores::DynamicScore, learning::scores::DynamicBIC, learning::scores::DynamicBGe,
     learning::scores::DynamicBDe, learning::scores::DynamicCVLikelihood, learning::scores::DynamicHoldoutLikelihood,
@@ -121,11 +124,93 @@ distribution of ``"a"`` is a :class:`LinearGaussianCPD <pybnesian.LinearGaussian
 :param evidence: A list of parent names.
 :returns: Local score value of ``node`` in the ``model`` with ``evidence`` as parents and ``variable_type`` as
           conditional distribution.
+)doc")
+        .def(
+            "local_scores",
+            [](const CppClass& self,
+               const ConditionalBayesianNetworkBase& m,
+               const std::string& variable,
+               const std::vector<std::vector<std::string>>& evidence_sets) {
+                return self.local_scores(m, variable, evidence_sets);
+            },
+            py::arg("model"),
+            py::arg("variable"),
+            py::arg("evidence_sets"))
+        .def(
+            "local_scores",
+            [](const CppClass& self,
+               const BayesianNetworkBase& m,
+               const std::string& variable,
+               const std::vector<std::vector<std::string>>& evidence_sets) {
+                return self.local_scores(m, variable, evidence_sets);
+            },
+            py::arg("model"),
+            py::arg("variable"),
+            py::arg("evidence_sets"),
+            R"doc(
+Returns the local score values of a node ``variable`` in the ``model`` for each of the parent sets in
+``evidence_sets``.
+
+For example:
+
+.. code-block:: python
+
+    >>> score.local_scores(m, "a", [[], ["b"], ["b", "c"]])
+
+returns the same values as ``[score.local_score(m, "a", e) for e in [[], ["b"], ["b", "c"]]]``. Some scores
+(:class:`BIC`, :class:`BGe` and :class:`BDe`) share part of the work between all the parent sets, so this method is
+faster than calling :func:`Score.local_score` for each parent set. The operator sets use this method to compute the
+delta scores. The values are identical to :func:`Score.local_score`, except for :class:`CVLikelihood` with
+:class:`CKDE` nodes fitted with ``KDEBackend.OPENCL``, whose values are equal up to rounding errors.
+
+:param model: Bayesian network model.
+:param variable: A variable name.
+:param evidence_sets: A list of parent sets. Each parent set is a list of parent names.
+:returns: A list with the local score value of ``node`` in the ``model`` for each parent set in ``evidence_sets``.
+)doc")
+        .def("add_parent_bound",
+             &Score::add_parent_bound,
+             py::arg("model"),
+             py::arg("variable"),
+             py::arg("parents"),
+             py::arg("new_parent"),
+             py::arg("current_score"),
+             R"doc(
+Returns an upper bound of the delta score of adding ``new_parent`` to the parents of ``variable``, that is,
+``score.local_score(model, variable, parents + [new_parent]) - current_score``, where ``current_score`` is
+``score.local_score(model, variable, parents)``. The operator sets do not compute the local score of the arcs whose
+bound is not positive, because they cannot improve the score.
+
+By default, there is no bound. :class:`BIC` implements a bound for the discrete variables without null values.
+
+:param model: Bayesian network model.
+:param variable: A variable name.
+:param parents: A list of the current parent names.
+:param new_parent: The name of the new parent.
+:param current_score: The local score of ``variable`` with ``parents`` as parents.
+:returns: An upper bound of the delta score, or None if the score does not have a bound for these variables.
 )doc")
         .def("data", &Score::data, R"doc(
 Returns the DataFrame used to calculate the score and local scores.
 
 :returns: DataFrame used to calculate the score. If the score do not use data, it returns None.
+)doc")
+        .def("memory_usage", &Score::memory_usage, R"doc(
+Returns the memory used by the caches of the score (e.g., the joint counts of :class:`BDe` and :class:`BIC`, the sums
+of squares of :class:`BGe` or the CPDs cached by :class:`HoldoutLikelihood`). The scores implemented in Python return
+an empty report.
+
+:returns: A :class:`MemoryUsage <pybnesian.MemoryUsage>`.
+)doc")
+        .def("set_max_cache_memory", &Score::set_max_cache_memory, py::arg("max_memory"), R"doc(
+Limits the memory of the caches of the score, so a learning run with this score does not use more memory for its
+caches. If the caches use more memory, their oldest entries are removed, and the new entries are not cached if they do
+not fit in the limit. The caches keep their own (count) limits, so the limit can only reduce their memory. The limit
+is shared by the copies of the score. It is applied to the caches that grow during the learning: the joint counts of
+:class:`BDe` and :class:`BIC`, the moments of the missingness patterns of :class:`BGe`, and the CPDs cached by
+:class:`HoldoutLikelihood` and :class:`ValidatedLikelihood`. The other scores ignore it.
+
+:param max_memory: Maximum number of bytes of the caches.
 )doc");
 
     {
@@ -284,6 +369,8 @@ public:
     using ScoreBase::local_score;
     using ScoreBase::ScoreBase;
 
+    bool is_python_derived() const override { return true; }
+
     double score(const BayesianNetworkBase& model) const override {
         {
             py::gil_scoped_acquire gil;
@@ -301,6 +388,44 @@ public:
         return ScoreBase::score(model);
     }
 
+    std::vector<double> local_scores(const BayesianNetworkBase& model,
+                                     const std::string& variable,
+                                     const std::vector<std::vector<std::string>>& parents_sets) const override {
+        {
+            py::gil_scoped_acquire gil;
+            // local_scores_batch() receives the indices of the variable and the parents in the model, so the Python
+            // implementation can compute all the scores with array operations.
+            py::function batch = pybind11::get_override(static_cast<const ScoreBase*>(this), "local_scores_batch");
+            if (batch) {
+                auto sets = pybindings::learning::encode_index_sets(
+                    parents_sets, [&model](const std::string& p) { return model.index(p); });
+                auto o = batch(model.shared_from_this(), model.index(variable), sets.indices, sets.offsets);
+                return pybindings::learning::decode_batch_result(
+                    std::move(o), parents_sets.size(), "Score::local_scores_batch");
+            }
+
+            py::function override = pybind11::get_override(static_cast<const ScoreBase*>(this), "local_scores");
+            if (override) {
+                auto o = override(model.shared_from_this(), variable, parents_sets);
+                std::vector<double> res;
+                try {
+                    res = std::move(o).cast<std::vector<double>>();
+                } catch (py::cast_error& e) {
+                    throw std::runtime_error("The returned object of Score::local_scores is not a list of double.");
+                }
+
+                if (res.size() != parents_sets.size()) {
+                    throw std::runtime_error("The returned list of Score::local_scores must contain " +
+                                             std::to_string(parents_sets.size()) + " elements.");
+                }
+
+                return res;
+            }
+        }
+
+        return ScoreBase::local_scores(model, variable, parents_sets);
+    }
+
     double local_score(const BayesianNetworkBase& model,
                        const std::string& variable,
                        const std::vector<std::string>& parents) const override {
@@ -326,6 +451,21 @@ public:
                                     parents);
     }
 
+    std::optional<double> add_parent_bound(const BayesianNetworkBase& model,
+                                           const std::string& variable,
+                                           const std::vector<std::string>& parents,
+                                           const std::string& new_parent,
+                                           double current_score) const override {
+        PYBIND11_OVERRIDE(std::optional<double>, /* Return type */
+                          ScoreBase,             /* Parent class */
+                          add_parent_bound,      /* Name of function in C++ (must match Python name) */
+                          model.shared_from_this(),
+                          variable, /* Argument(s) */
+                          parents,
+                          new_parent,
+                          current_score);
+    }
+
     std::string ToString() const override {
         PYBIND11_OVERRIDE_PURE_NAME(std::string, /* Return type */
                                     ScoreBase,   /* Parent class */
@@ -438,6 +578,23 @@ public:
     }
 };
 
+class PyScoreTransport : public ScoreTransport {
+public:
+    using ScoreTransport::ScoreTransport;
+
+    bool is_python_derived() const override { return true; }
+
+    std::vector<std::vector<double>> evaluate(const BayesianNetworkBase& model,
+                                              const std::vector<LocalScoreRequest>& requests) const override {
+        PYBIND11_OVERRIDE_PURE(std::vector<std::vector<double>>, /* Return type */
+                               ScoreTransport,                   /* Parent class */
+                               evaluate, /* Name of function in C++ (must match Python name) */
+                               model.shared_from_this(),
+                               requests /* Argument(s) */
+        );
+    }
+};
+
 template <typename DynamicScoreBase = DynamicScore>
 class PyDynamicScore : public DynamicScoreBase {
     using DynamicScoreBase::DynamicScoreBase;
@@ -459,6 +616,13 @@ void pybindings_scores(py::module& root) {
     // register_Score<GaussianNetwork, SemiparametricBN>(scores);
     py::class_<Score, PyScore<>, std::shared_ptr<Score>> score(root, "Score", R"doc(
 A :class:`Score` scores Bayesian network structures.
+
+A Python-derived :class:`Score` can also implement the method
+``local_scores_batch(self, model, variable, parents, offsets)``. The learning algorithms call it instead of
+:func:`Score.local_scores` with all the parent sets of a batch encoded as NumPy ``int32`` arrays, so the local scores
+can be vectorized with NumPy or JAX. ``variable`` is the index of the node in the ``model`` (see
+:func:`BayesianNetworkBase.index`), and the ``i``-th parent set contains the node indices
+``parents[offsets[i]:offsets[i + 1]]``. It must return an array with the local score of each parent set.
 )doc");
     score.def(py::init<>(), R"doc(
 Initializes a :class:`Score`.
@@ -516,10 +680,21 @@ a validation likelihood (usually defined over different data) through the functi
     py::class_<BIC, Score, std::shared_ptr<BIC>>(root, "BIC", R"doc(
 This class implements the Bayesian Information Criterion (BIC).
 )doc")
-        .def(py::init<const DataFrame&>(), py::arg("df"), R"doc(
+        .def(py::init([](const DataFrame& df, std::optional<VectorXd> weights) {
+                 if (weights)
+                     return std::make_shared<BIC>(df, *weights);
+                 else
+                     return std::make_shared<BIC>(df);
+             }),
+             py::arg("df"),
+             py::arg("weights") = std::nullopt,
+             R"doc(
 Initializes a :class:`BIC` with the given DataFrame ``df``.
 
 :param df: DataFrame to compute the BIC score.
+:param weights: Non-negative weight of each row of ``df``. The score is equal to the BIC of ``df`` with each row
+    repeated (integer) weight times, and the number of instances of the penalty is the sum of the weights. If None, all
+    the rows have weight 1.
 )doc");
 
     py::class_<BGe, Score, std::shared_ptr<BGe>>(root, "BGe", R"doc(
@@ -555,13 +730,18 @@ Initializes a :class:`BDe` with the given DataFrame ``df``.
     py::class_<CVLikelihood, Score, std::shared_ptr<CVLikelihood>>(root, "CVLikelihood", R"doc(
 This class implements an estimation of the log-likelihood on unseen data using k-fold cross validation over the data.
 )doc")
-        .def(py::init([](const DataFrame& df, int k, std::optional<unsigned int> seed, Arguments construction_args) {
-                 return CVLikelihood(df, k, random_seed_arg(seed), construction_args);
+        .def(py::init([](const DataFrame& df,
+                         int k,
+                         std::optional<unsigned int> seed,
+                         Arguments construction_args,
+                         int num_threads) {
+                 return CVLikelihood(df, k, random_seed_arg(seed), construction_args, num_threads);
              }),
              py::arg("df"),
              py::arg("k") = 10,
              py::arg("seed") = std::nullopt,
              py::arg("construction_args") = Arguments(),
+             py::arg("num_threads") = 1,
              R"doc(
 Initializes a :class:`CVLikelihood` with the given DataFrame ``df``. It uses a
 :class:`CrossValidation <pybnesian.CrossValidation>` with ``k`` folds and the given ``seed``.
@@ -570,6 +750,9 @@ Initializes a :class:`CVLikelihood` with the given DataFrame ``df``. It uses a
 :param k: Number of folds of the cross validation.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
 :param construction_args: Additional arguments provided to construct the :class:`Factor <pybnesian.Factor>`.
+:param num_threads: Number of threads used to fit the folds of the cross validation in parallel. If 0, the number of
+                    hardware threads is used. If the score is evaluated in parallel by a learning algorithm, the folds
+                    are fitted serially by each of its threads.
 )doc")
         .def_property_readonly("cv", &CVLikelihood::cv, R"doc(
 The underlying :class:`CrossValidation <pybnesian.CrossValidation>` object to compute the score.
@@ -578,6 +761,9 @@ The underlying :class:`CrossValidation <pybnesian.CrossValidation>` object to co
     py::class_<HoldoutLikelihood, Score, std::shared_ptr<HoldoutLikelihood>>(root, "HoldoutLikelihood", R"doc(
 This class implements an estimation of the log-likelihood on unseen data using a holdout dataset. Thus, the parameters
 are estimated using training data, and the score is estimated in the holdout data.
+
+The last fitted CPDs are cached, so the score of a CPD that was already evaluated (e.g., when
+:class:`ValidatedLikelihood` evaluates the validation score of an undone operator) does not fit it again.
 )doc")
         .def(py::init([](const DataFrame& df,
                          double test_ratio,
@@ -621,14 +807,16 @@ This class mixes the functionality of :class:`CVLikelihood` and :class:`HoldoutL
                          double test_ratio,
                          int k,
                          std::optional<unsigned int> seed,
-                         Arguments construction_args) {
-                 return ValidatedLikelihood(df, test_ratio, k, random_seed_arg(seed), construction_args);
+                         Arguments construction_args,
+                         int num_threads) {
+                 return ValidatedLikelihood(df, test_ratio, k, random_seed_arg(seed), construction_args, num_threads);
              }),
              py::arg("df"),
              py::arg("test_ratio") = 0.2,
              py::arg("k") = 10,
              py::arg("seed") = std::nullopt,
              py::arg("construction_args") = Arguments(),
+             py::arg("num_threads") = 1,
              R"doc(
 Initializes a :class:`ValidatedLikelihood` with the given DataFrame ``df``. The
 :class:`HoldOut <pybnesian.HoldOut>` is initialized with ``test_ratio`` and ``seed``. The ``CVLikelihood`` is
@@ -639,6 +827,8 @@ initialized with ``k`` and ``seed`` over the training data of the holdout :class
 :param k: Number of folds of the cross validation.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
 :param construction_args: Additional arguments provided to construct the :class:`Factor <pybnesian.Factor>`.
+:param num_threads: Number of threads used to fit the folds of the ``CVLikelihood`` in parallel. If 0, the number of
+                    hardware threads is used.
 )doc")
         .def_property_readonly(
             "holdout_lik", &ValidatedLikelihood::holdout, py::return_value_policy::reference_internal, R"doc(
@@ -655,6 +845,100 @@ The underlying training data of the :class:`HoldOut <pybnesian.HoldOut>`.
              py::return_value_policy::reference_internal,
              R"doc(
 The underlying holdout data of the :class:`HoldOut <pybnesian.HoldOut>`.
+)doc");
+
+    py::class_<LocalScoreRequest>(root, "LocalScoreRequest", R"doc(
+A batch of local scores of a variable sent by a :class:`DistributedScore` to its :class:`ScoreTransport`.
+)doc")
+        .def(py::init<std::string, std::shared_ptr<FactorType>, std::vector<std::vector<std::string>>>(),
+             py::arg("variable"),
+             py::arg("node_type"),
+             py::arg("parents_sets"),
+             R"doc(
+Initializes a :class:`LocalScoreRequest`.
+
+:param variable: Name of the variable.
+:param node_type: :class:`FactorType <pybnesian.FactorType>` of the variable. If ``None``, the node type of the
+                  variable in the model is used.
+:param parents_sets: List of parent sets of the variable.
+)doc")
+        .def_readonly("variable", &LocalScoreRequest::variable, R"doc(
+Name of the variable.
+)doc")
+        .def_readonly("node_type", &LocalScoreRequest::node_type, R"doc(
+:class:`FactorType <pybnesian.FactorType>` of the variable, or ``None`` to use the node type of the model.
+)doc")
+        .def_readonly("parents_sets", &LocalScoreRequest::parents_sets, R"doc(
+List of parent sets of the variable.
+)doc")
+        .def(py::pickle(
+            [](const LocalScoreRequest& self) {
+                return py::make_tuple(self.variable, self.node_type, self.parents_sets);
+            },
+            [](py::tuple t) {
+                if (t.size() != 3) throw std::runtime_error("Not valid LocalScoreRequest.");
+                return LocalScoreRequest{t[0].cast<std::string>(),
+                                         t[1].cast<std::shared_ptr<FactorType>>(),
+                                         t[2].cast<std::vector<std::vector<std::string>>>()};
+            }));
+
+    py::class_<ScoreTransport, PyScoreTransport, std::shared_ptr<ScoreTransport>>(root, "ScoreTransport", R"doc(
+A :class:`ScoreTransport` sends the local scores of a :class:`DistributedScore` to a set of workers, and gathers the
+results. For example, a transport can be implemented with ``mpi4py`` or a ``concurrent.futures`` pool of processes.
+Each worker keeps its own copy of the data (and a score over it), and computes the local scores with
+:func:`evaluate_local_scores`, so the transport only sends the model, the requests and the local scores.
+
+The learning algorithms call :func:`ScoreTransport.evaluate` concurrently from each of their threads, so the
+``num_threads`` of the algorithm is the number of requests that are evaluated by the workers at the same time.
+)doc")
+        .def(py::init<>(), R"doc(
+Initializes a :class:`ScoreTransport`.
+)doc")
+        .def("evaluate", &ScoreTransport::evaluate, py::arg("model"), py::arg("requests"), R"doc(
+Evaluates the local scores of the ``requests`` in the workers.
+
+:param model: Bayesian network model of the local scores.
+:param requests: List of :class:`LocalScoreRequest`.
+:returns: A list with the local score of each parent set, for each request.
+)doc");
+
+    py::class_<DistributedScore, Score, std::shared_ptr<DistributedScore>>(root, "DistributedScore", R"doc(
+A :class:`Score` that evaluates all its local scores in the workers of a :class:`ScoreTransport`. The learning
+algorithms send the batches of local scores of each variable (for example, the parent sets of the arc operators of a
+:class:`GreedyHillClimbing <pybnesian.GreedyHillClimbing>` step) to the workers, and compute the deltas of the
+operators from the returned local scores.
+)doc")
+        .def(py::init<std::shared_ptr<Score>, std::shared_ptr<ScoreTransport>>(),
+             py::arg("score"),
+             py::arg("transport"),
+             R"doc(
+Initializes a :class:`DistributedScore`.
+
+:param score: A local :class:`Score` with the same variables as the scores of the workers. It is only used to check the
+              variables and the compatibility of the models.
+:param transport: :class:`ScoreTransport` to the workers.
+)doc")
+        .def_property_readonly("score", &DistributedScore::score, R"doc(
+The local :class:`Score`.
+)doc")
+        .def_property_readonly("transport", &DistributedScore::transport, R"doc(
+The :class:`ScoreTransport` to the workers.
+)doc");
+
+    root.def("evaluate_local_scores",
+             &learning::scores::evaluate_local_scores,
+             py::arg("score"),
+             py::arg("model"),
+             py::arg("requests"),
+             py::arg("num_threads") = 1,
+             R"doc(
+Evaluates the :class:`LocalScoreRequest` of a :class:`ScoreTransport` in a worker.
+
+:param score: :class:`Score` of the worker.
+:param model: Bayesian network model of the local scores.
+:param requests: List of :class:`LocalScoreRequest`.
+:param num_threads: Number of threads used to evaluate the requests. If 0, the number of hardware threads is used.
+:returns: A list with the local score of each parent set, for each request.
 )doc");
 
     py::class_<DynamicScore, PyDynamicScore<>, std::shared_ptr<DynamicScore>> dynamic_score(root, "DynamicScore", R"doc(
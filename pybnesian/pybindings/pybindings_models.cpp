@@ -10,6 +10,13 @@
 #include <models/HomogeneousBN.hpp>
 #include <models/HeterogeneousBN.hpp>
 #include <models/CLGNetwork.hpp>
+#include <models/binary_models.hpp>
+#include <models/LoglPlan.hpp>
+#include <models/EnsembleLogl.hpp>
+#include <models/CrossValidatedLogl.hpp>
+#include <learning/algorithms/async_learning.hpp>
+#include <pybindings/pybindings_buffers.hpp>
+#include <util/parallel.hpp>
 #include <util/util_types.hpp>
 
 using models::BayesianNetworkType, models::GaussianNetworkType, models::SemiparametricBNType, models::KDENetworkType,
@@ -26,8 +33,9 @@ using models::ConditionalBayesianNetworkBase, models::ConditionalBayesianNetwork
 
 using models::DynamicBayesianNetworkBase, models::DynamicBayesianNetwork, models::DynamicGaussianNetwork,
     models::DynamicSemiparametricBN, models::DynamicKDENetwork, models::DynamicDiscreteBN, models::DynamicHomogeneousBN,
-    models::DynamicHeterogeneousBN, models::DynamicCLGNetwork;
+    models::DynamicHeterogeneousBN, models::DynamicCLGNetwork, models::DynamicBatchSampler, models::DynamicLoglFilter;
 
+using pybindings::OutputVector, pybindings::output_vector_map;
 using util::random_seed_arg;
 
 class PyBayesianNetworkType : public BayesianNetworkType {
@@ -748,6 +756,20 @@ public:
 
     VectorXd logl(const DataFrame& df) const override { PYBIND11_OVERRIDE(VectorXd, Base, logl, df); }
 
+    // The Python subclasses that override logl() copy its result in out.
+    void logl_into(const DataFrame& df, Eigen::Ref<VectorXd> out) const override {
+        bool python_logl;
+        {
+            py::gil_scoped_acquire gil;
+            python_logl = static_cast<bool>(py::get_override(static_cast<const Base*>(this), "logl"));
+        }
+
+        if (python_logl)
+            BayesianNetworkBase::logl_into(df, out);
+        else
+            Base::logl_into(df, out);
+    }
+
     double slogl(const DataFrame& df) const override { PYBIND11_OVERRIDE(double, Base, slogl, df); }
 
     std::shared_ptr<BayesianNetworkType> type() const override {
@@ -956,6 +978,8 @@ class PyDynamicBayesianNetworkBase : public Base {
 public:
     using Base::Base;
 
+    bool is_python_derived() const override { return true; }
+
     BayesianNetworkBase& static_bn() override { PYBIND11_OVERRIDE_PURE(BayesianNetworkBase&, Base, static_bn, ); }
 
     const BayesianNetworkBase& static_bn() const override {
@@ -1112,6 +1136,36 @@ public:
     }
 };
 
+// Returns an iterator over the record batches of a pyarrow.Table, a pyarrow.RecordBatchReader, or any Python iterable
+// of DataFrames (e.g., pyarrow.RecordBatch or pandas.DataFrame).
+py::iterator record_batches_iterator(py::handle batches) {
+    if (pyarrow::is_table(batches.ptr())) return py::iter(batches.attr("to_batches")());
+    return py::iter(batches);
+}
+
+// Iterates over the logl of each DataFrame of an iterable. Only one DataFrame is converted at a time, so the memory
+// does not depend on the total number of rows.
+class LoglBatchIterator {
+public:
+    LoglBatchIterator(const BayesianNetworkBase& bn, py::iterator batches, int num_threads)
+        : m_bn(bn), m_batches(std::move(batches)), m_num_threads(num_threads) {}
+
+    VectorXd next() {
+        auto batch = py::reinterpret_steal<py::object>(PyIter_Next(m_batches.ptr()));
+        if (!batch) {
+            if (PyErr_Occurred()) throw py::error_already_set();
+            throw py::stop_iteration();
+        }
+
+        return m_bn.parallel_logl(batch.cast<DataFrame>(), m_num_threads);
+    }
+
+private:
+    const BayesianNetworkBase& m_bn;
+    py::iterator m_batches;
+    int m_num_threads;
+};
+
 template <typename CppClass, typename Class>
 void register_BayesianNetwork_methods(Class& m) {
     m.def_property("include_cpd", &CppClass::include_cpd, &CppClass::set_include_cpd, R"doc(
@@ -1254,6 +1308,12 @@ Adds an arc between the nodes ``source`` and ``target``. If the arc already exis
 
 :param source: A node name.
 :param target: A node name.
+)doc")
+        .def("add_arcs", &CppClass::add_arcs, py::arg("arcs"), R"doc(
+Adds a list of arcs. The Bayesian networks implemented in C++ check the acyclicity once for all the arcs, so it is
+faster than calling :func:`BayesianNetworkBase.add_arc` for each arc. The arcs that already exist are ignored.
+
+:param arcs: A list of arcs, given as tuples of node names.
 )doc")
         .def("remove_arc", &CppClass::remove_arc, py::arg("source"), py::arg("target"), R"doc(
 Removes an arc between the nodes ``source`` and ``target``. If the arc do not exist, the graph is left unaffected.
@@ -1318,30 +1378,225 @@ partial (just some a subset of the nodes).
 
 :param cpds: List of :class:`Factor <pybnesian.Factor>`.
 )doc")
-        .def("fit", &CppClass::fit, py::arg("df"), py::arg("construction_args") = Arguments(), R"doc(
+        .def(
+            "fit",
+            [](CppClass& self, const DataFrame& df, const Arguments& construction_args, int num_threads, bool fused) {
+                util::gil_release_if_held release(!self.has_python_derived());
+                self.parallel_fit(df, construction_args, num_threads, fused);
+            },
+            py::arg("df"),
+            py::arg("construction_args") = Arguments(),
+            py::arg("num_threads") = 1,
+            py::arg("fused") = false,
+            R"doc(
 Fit all the unfitted :class:`Factor <pybnesian.Factor>` with the data ``df``.
 
 :param df: DataFrame to fit the Bayesian network.
 :param construction_args: Additional arguments provided to construct the :class:`Factor <pybnesian.Factor>`.
+:param num_threads: Number of threads that fit the factors in parallel. If 0, the hardware concurrency is used. Each
+                    factor is fitted independently, so the result does not depend on the number of threads. The
+                    Bayesian networks with Python-derived factors or node types are fitted serially.
+:param fused: If True, the :class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>` are fitted with the covariance
+              matrix of all their columns, computed with a single pass over ``df``, and the
+              :class:`DiscreteFactor <pybnesian.DiscreteFactor>` are fitted with the joint counts of all the factors,
+              computed in the same pass over ``df``. The factors with null values in their columns (or with degenerate
+              statistics) are fitted independently. The parameters are equal to the ones fitted independently, up to
+              rounding errors.
 )doc")
-        .def("logl",
-             &CppClass::logl,
-             py::return_value_policy::take_ownership,
-             py::arg("df"),
-             R"doc(
+        .def(
+            "fit_async",
+            [](CppClass& self, const DataFrame& df, const Arguments& construction_args, int num_threads, bool fused) {
+                // The arguments can contain Python objects, so they are released with the GIL.
+                std::shared_ptr<const Arguments> args(new Arguments(construction_args), [](const Arguments* a) {
+                    if (!Py_IsInitialized()) return;
+                    py::gil_scoped_acquire gil;
+                    delete a;
+                });
+                return learning::algorithms::fit_async(self.shared_from_this(), df, args, num_threads, fused);
+            },
+            py::arg("df"),
+            py::arg("construction_args") = Arguments(),
+            py::arg("num_threads") = 1,
+            py::arg("fused") = false,
+            R"doc(
+Executes :func:`BayesianNetworkBase.fit` asynchronously, and returns immediately. The model must not be used until the
+returned :class:`LearningTask <pybnesian.LearningTask>` finishes. The fit is not interrupted by
+:func:`LearningTask.cancel <pybnesian.LearningTask.cancel>` once it has started.
+
+The parameters are the same as in :func:`BayesianNetworkBase.fit`. The Bayesian networks with Python-derived factors or
+node types are not supported, because the fit runs without the GIL.
+
+:returns: A :class:`LearningTask <pybnesian.LearningTask>` whose result is this model.
+:raises ValueError: If the Bayesian network has Python-derived factors or node types.
+)doc")
+        .def(
+            "partial_fit",
+            [](CppClass& self,
+               const DataFrame& df,
+               double forgetting,
+               const Arguments& construction_args,
+               int num_threads) {
+                util::gil_release_if_held release(!self.has_python_derived());
+                self.partial_fit(df, forgetting, construction_args, num_threads);
+            },
+            py::arg("df"),
+            py::arg("forgetting") = 1.,
+            py::arg("construction_args") = Arguments(),
+            py::arg("num_threads") = 1,
+            R"doc(
+Updates all the :class:`Factor <pybnesian.Factor>` with :func:`Factor.partial_fit <pybnesian.Factor.partial_fit>` and
+the data ``df``. The factors that are not added yet are constructed and fitted with ``df``. All the factors must be
+fitted with :func:`Factor.partial_fit <pybnesian.Factor.partial_fit>`.
+
+:param df: DataFrame with the new data.
+:param forgetting: A value in (0, 1] that multiplies the sufficient statistics of the previous data.
+:param construction_args: Additional arguments provided to construct the :class:`Factor <pybnesian.Factor>`.
+:param num_threads: Number of threads that update the factors in parallel. If 0, the hardware concurrency is used.
+)doc")
+        .def(
+            "logl",
+            [](const CppClass& self, const DataFrame& df, int num_threads, std::optional<OutputVector> out)
+                -> py::object {
+                if (!out) {
+                    VectorXd res;
+                    {
+                        util::gil_release_if_held release(!self.has_python_derived());
+                        res = self.parallel_logl(df, num_threads);
+                    }
+                    return py::cast(std::move(res));
+                }
+
+                auto out_map = output_vector_map(*out);
+                {
+                    util::gil_release_if_held release(!self.has_python_derived());
+                    self.parallel_logl_into(df, num_threads, out_map);
+                }
+                return *out;
+            },
+            py::arg("df"),
+            py::arg("num_threads") = 1,
+            py::arg("out").noconvert() = std::nullopt,
+            R"doc(
 Returns the log-likelihood of each instance in the DataFrame ``df``. This returns the sum of the log-likelihood for all
 the factors in the Bayesian network.
 
+The log-likelihood of the factors is accumulated in the same vector, so no temporary vector is created for each factor.
+
 :param df: DataFrame to compute the log-likelihood.
+:param num_threads: Number of threads that evaluate the factors in parallel. If 0, the hardware concurrency is used. The
+                    result is deterministic for a given number of threads, but it can differ in the last bits from the
+                    serial result (``num_threads=1``) because the log-likelihoods are added in a different order. In
+                    the deterministic mode (see :func:`set_deterministic_mode <pybnesian.set_deterministic_mode>`),
+                    the result does not depend on ``num_threads``.
+:param out: A contiguous and writeable :class:`numpy.ndarray` vector with dtype :class:`numpy.float64` and one element
+            for each instance of ``df``. If given, the log-likelihood is stored in ``out`` without allocating a new
+            array, and ``out`` is returned.
 :returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64`, where the i-th value is the log-likelihod
           of the i-th instance of ``df``.
+:raises ValueError: If ``out`` is not a writeable vector with one element for each instance of ``df``.
 )doc")
-        .def("slogl", &CppClass::slogl, py::arg("df"), R"doc(
+        .def(
+            "slogl",
+            [](const CppClass& self, const DataFrame& df, int num_threads) {
+                util::gil_release_if_held release(!self.has_python_derived());
+                return self.parallel_slogl(df, num_threads);
+            },
+            py::arg("df"),
+            py::arg("num_threads") = 1,
+            R"doc(
 Returns the sum of the log-likelihood of each instance in the DataFrame ``df``. That is, the sum of the result of
 :func:`BayesianNetworkBase.logl`.
 
 :param df: DataFrame to compute the sum of the log-likelihood.
+:param num_threads: Number of threads that evaluate the factors in parallel. If 0, the hardware concurrency is used. In
+                    the deterministic mode (see :func:`set_deterministic_mode <pybnesian.set_deterministic_mode>`),
+                    the result does not depend on ``num_threads``.
 :returns: The sum of log-likelihood for DataFrame ``df``.
+)doc")
+        .def("memory_usage", &CppClass::memory_usage, R"doc(
+Returns the memory used by the CPDs of the Bayesian network (see :func:`Factor.memory_usage
+<pybnesian.Factor.memory_usage>`). The components of the CPD of each node are prefixed by ``"cpd:<node>"``. The CPDs
+of a model loaded lazily (see :func:`load_binary <pybnesian.load_binary>`) that are not loaded yet are not included.
+
+:returns: A :class:`MemoryUsage <pybnesian.MemoryUsage>`.
+)doc")
+        .def(
+            "logl_batches",
+            [](const CppClass& self, py::handle batches, int num_threads) {
+                return LoglBatchIterator(self, record_batches_iterator(batches), num_threads);
+            },
+            py::keep_alive<0, 1>(),
+            py::arg("batches"),
+            py::arg("num_threads") = 1,
+            R"doc(
+Returns an iterator over the log-likelihood of each batch of instances in ``batches``. The batches are read and
+evaluated one at a time, so the data does not need to fit in memory.
+
+:param batches: A :class:`pyarrow.Table`, a :class:`pyarrow.RecordBatchReader` or an iterable of DataFrames (e.g.,
+                :class:`pyarrow.RecordBatch` or :class:`pandas.DataFrame`).
+:param num_threads: Number of threads that evaluate the factors in parallel (see :func:`BayesianNetworkBase.logl`).
+:returns: An iterator of :class:`numpy.ndarray` vectors with dtype :class:`numpy.float64`, with the log-likelihood of
+          each batch.
+)doc")
+        .def(
+            "slogl_batches",
+            [](const CppClass& self, py::handle batches, int num_threads) {
+                double slogl = 0;
+                for (auto batch : record_batches_iterator(batches)) {
+                    slogl += self.parallel_slogl(batch.cast<DataFrame>(), num_threads);
+                }
+                return slogl;
+            },
+            py::arg("batches"),
+            py::arg("num_threads") = 1,
+            R"doc(
+Returns the sum of the log-likelihood of all the batches of instances in ``batches``. The batches are read and
+evaluated one at a time, so the data does not need to fit in memory.
+
+:param batches: A :class:`pyarrow.Table`, a :class:`pyarrow.RecordBatchReader` or an iterable of DataFrames (e.g.,
+                :class:`pyarrow.RecordBatch` or :class:`pandas.DataFrame`).
+:param num_threads: Number of threads that evaluate the factors in parallel (see :func:`BayesianNetworkBase.logl`).
+:returns: The sum of the log-likelihood of all the batches.
+)doc")
+        .def(
+            "compile",
+            [](const CppClass& self, const std::shared_ptr<arrow::Schema>& schema, KDEBackend backend) {
+                return models::LoglPlan(self, schema, backend);
+            },
+            py::arg("schema"),
+            py::arg("backend") = KDEBackend::CPU,
+            R"doc(
+Compiles a :class:`LoglPlan` that evaluates the log-likelihood of the DataFrames with the given ``schema``. The plan
+resolves the columns and copies the parameters of the CPDs once, so it is faster than
+:func:`BayesianNetworkBase.logl` for the DataFrames with a few instances. The plan does not change if the Bayesian
+network is modified or fitted again.
+
+:param schema: A :class:`pyarrow.Schema` of the evaluated DataFrames.
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device that evaluates the
+                :class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>`. With
+                :attr:`KDEBackend.OPENCL <pybnesian.KDEBackend.OPENCL>`, they are evaluated with a single OpenCL
+                kernel, and the columns are kept in the device for the next DataFrames. With
+                :attr:`KDEBackend.AUTO <pybnesian.KDEBackend.AUTO>`, the OpenCL device is used if it is a GPU.
+:returns: A :class:`LoglPlan` for ``schema``.
+:raises ValueError: If the Bayesian network is not fitted or ``schema`` does not contain the nodes.
+)doc")
+        .def(
+            "compile",
+            [](const CppClass& self, const DataFrame& df, KDEBackend backend) {
+                return models::LoglPlan(self, df->schema(), backend);
+            },
+            py::arg("df"),
+            py::arg("backend") = KDEBackend::CPU,
+            R"doc(
+Compiles a :class:`LoglPlan` that evaluates the log-likelihood of the DataFrames with the schema of ``df``.
+
+:param df: A DataFrame with the schema of the evaluated DataFrames (e.g., a :class:`pandas.DataFrame` with one
+           instance).
+:param backend: A :class:`KDEBackend <pybnesian.KDEBackend>` to select the device that evaluates the
+                :class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>` (see
+                :func:`BayesianNetworkBase.compile`).
+:returns: A :class:`LoglPlan` for the schema of ``df``.
+:raises ValueError: If the Bayesian network is not fitted or ``df`` does not contain the nodes.
 )doc")
         .def("type", &CppClass::type, R"doc(
 Gets the underlying :class:`BayesianNetworkType`.
@@ -1350,22 +1605,29 @@ Gets the underlying :class:`BayesianNetworkType`.
 )doc")
         .def(
             "sample",
-            [](const CppClass& self, int n, std::optional<unsigned int> seed, bool ordered) {
-                return self.sample(n, random_seed_arg(seed), ordered);
+            [](const CppClass& self, int n, std::optional<unsigned int> seed, bool ordered, int num_threads) {
+                util::gil_release_if_held release(!self.has_python_derived());
+                return self.parallel_sample(n, random_seed_arg(seed), ordered, num_threads);
             },
             py::return_value_policy::move,
             py::arg("n"),
             py::arg("seed") = std::nullopt,
             py::arg("ordered") = false,
+            py::arg("num_threads") = 1,
             R"doc(
 Samples ``n`` values from this BayesianNetwork. This method returns a :class:`pyarrow.RecordBatch` with ``n`` instances.
 
 If ``ordered`` is True, it orders the columns according to the list :func:`BayesianNetworkBase.nodes`. Else, it
 orders the columns according to a topological sort.
 
+The nodes whose parents are already sampled are sampled in parallel, and the instances are sampled in blocks of 65536
+rows with a different seed for each block. The result does not depend on ``num_threads``.
+
 :param n: Number of instances to sample.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
 :param ordered: If True, order the columns according to :func:`BayesianNetworkBase.nodes`.
+:param num_threads: Number of threads that sample the nodes and blocks of instances in parallel. If 0, the hardware
+                    concurrency is used.
 :returns: A DataFrame with ``n`` instances that contains the sampled data.
 )doc")
         .def("conditional_bn", py::overload_cast<>(&CppClass::conditional_bn, py::const_), R"doc(
@@ -1406,6 +1668,23 @@ conditional probability distributions (CPDs) in the Bayesian network.
 
 :param filename: File name of the saved Bayesian network.
 :param include_cpd: Include the CPDs.
+)doc")
+        .def(
+            "save_binary",
+            [](const CppClass& self, std::string filename, bool include_cpd) {
+                models::save_binary(self, filename, include_cpd);
+            },
+            py::arg("filename"),
+            py::arg("include_cpd") = false,
+            R"doc(
+Saves the Bayesian network in the binary format of PyBNesian with the given name. The extension ``.pbn`` is appended
+to the name if it does not have it. The binary format does not use pickle (see :func:`load_binary`), but only the
+Bayesian networks, node types and CPDs implemented in PyBNesian can be saved.
+
+:param filename: File name of the saved Bayesian network.
+:param include_cpd: Include the CPDs.
+:raises ValueError: If the Bayesian network contains objects defined in Python, or CPDs with additional
+    construction arguments.
 )doc")
         .def("node_type", &CppClass::node_type, py::arg("node"), R"doc(
 Gets the corresponding :class:`FactorType <pybnesian.FactorType>` for ``node``.
@@ -1621,12 +1900,20 @@ Converts an interface node into a normal node.
                const DataFrame& evidence,
                std::optional<unsigned int> seed,
                bool concat_evidence,
-               bool ordered) { return self.sample(evidence, random_seed_arg(seed), concat_evidence, ordered); },
+               bool ordered,
+               int num_threads,
+               int draws) {
+                util::gil_release_if_held release(!self.has_python_derived());
+                return self.parallel_sample(
+                    evidence, random_seed_arg(seed), concat_evidence, ordered, num_threads, draws);
+            },
             py::return_value_policy::move,
             py::arg("evidence"),
             py::arg("seed") = std::nullopt,
             py::arg("concat_evidence") = false,
             py::arg("ordered") = false,
+            py::arg("num_threads") = 1,
+            py::arg("draws") = 1,
             R"doc(
 Samples ``n`` values from this conditional BayesianNetwork conditioned on ``evidence``. ``evidence`` must contain a
 column for each interface node. This method returns a :class:`pyarrow.RecordBatch` with ``n`` instances.
@@ -1636,11 +1923,20 @@ If ``concat`` is True, it concatenates ``evidence`` in the result.
 If ``ordered`` is True, it orders the columns according to the list :func:`BayesianNetworkBase.nodes`. Else, it
 orders the columns according to a topological sort.
 
+If ``draws`` is greater than 1, each evidence row is sampled ``draws`` times, and the result contains ``n * draws``
+instances: the rows ``[k*n, (k+1)*n)`` contain the draw ``k``. The evidence is not replicated to sample the draws.
+
+As in :func:`BayesianNetworkBase.sample`, the instances are sampled in parallel in blocks of 65536 rows, and the result
+does not depend on ``num_threads``.
+
 :param n: Number of instances to sample.
 :param evidence: A DataFrame of ``n`` instances to condition the sampling.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
 :param ordered: If True, order the columns according to :func:`BayesianNetworkBase.nodes`.
-:returns: A DataFrame with ``n`` instances that contains the sampled data.
+:param num_threads: Number of threads that sample the nodes and blocks of instances in parallel. If 0, the hardware
+                    concurrency is used.
+:param draws: Number of samples of each evidence row.
+:returns: A DataFrame with ``n * draws`` instances that contains the sampled data.
 )doc")
         .def("clone", &CppClass::clone, R"doc(
 Clones (copies) this Bayesian network.
@@ -1729,22 +2025,49 @@ Bayesian networks.
 :param df: DataFrame to fit the dynamic Bayesian network.
 :param construction_args: Additional arguments provided to construct the :class:`Factor <pybnesian.Factor>`.
 )doc")
-        .def("logl",
-             &CppClass::logl,
-             py::arg("df"),
-             R"doc(
+        .def(
+            "logl",
+            [](const CppClass& self, const DataFrame& df, int num_threads) {
+                util::gil_release_if_held release(!self.has_python_derived());
+                return self.parallel_logl(df, num_threads);
+            },
+            py::return_value_policy::take_ownership,
+            py::arg("df"),
+            py::arg("num_threads") = 1,
+            R"doc(
 Returns the log-likelihood of each instance in the DataFrame ``df``.
 
 :param df: DataFrame to compute the log-likelihood.
+:param num_threads: Number of threads that evaluate the static Bayesian network and the transition factors of the
+                    variables concurrently. If 0, the hardware concurrency is used. The result does not depend on
+                    ``num_threads``.
 :returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64`, where the i-th value is the log-likelihood
           of the i-th instance of ``df``.
 )doc")
-        .def("slogl", &CppClass::slogl, py::arg("df"), R"doc(
+        .def(
+            "slogl",
+            [](const CppClass& self, const DataFrame& df, int num_threads) {
+                util::gil_release_if_held release(!self.has_python_derived());
+                return self.parallel_slogl(df, num_threads);
+            },
+            py::arg("df"),
+            py::arg("num_threads") = 1,
+            R"doc(
 Returns the sum of the log-likelihood of each instance in the DataFrame ``df``. That is, the sum of the result of
 :func:`DynamicBayesianNetworkBase.logl`.
 
 :param df: DataFrame to compute the sum of the log-likelihood.
+:param num_threads: Number of threads that evaluate the static Bayesian network and the transition factors of the
+                    variables concurrently. If 0, the hardware concurrency is used. The result does not depend on
+                    ``num_threads``.
 :returns: The sum of log-likelihood for DataFrame ``df``.
+)doc")
+        .def("memory_usage", &CppClass::memory_usage, R"doc(
+Returns the memory used by the CPDs of the static and transition Bayesian networks (see
+:func:`BayesianNetworkBase.memory_usage <pybnesian.BayesianNetworkBase.memory_usage>`), prefixed by ``"static"`` and
+``"transition"``.
+
+:returns: A :class:`MemoryUsage <pybnesian.MemoryUsage>`.
 )doc")
         .def("type", &CppClass::type, R"doc(
 Gets the underlying :class:`BayesianNetworkType`.
@@ -1764,11 +2087,61 @@ instances.
 
 :param n: Number of instances to sample.
 :param seed: A random seed number. If not specified or ``None``, a random seed is generated.
+)doc")
+        .def(
+            "sample_batches",
+            [](const CppClass& self,
+               int n,
+               int batch_steps,
+               int num_trajectories,
+               std::optional<unsigned int> seed,
+               int num_threads) {
+                return DynamicBatchSampler(
+                    self, n, batch_steps, num_trajectories, random_seed_arg(seed), num_threads);
+            },
+            py::arg("n"),
+            py::arg("batch_steps"),
+            py::arg("num_trajectories") = 1,
+            py::arg("seed") = std::nullopt,
+            py::arg("num_threads") = 1,
+            py::keep_alive<0, 1>(),
+            R"doc(
+Samples ``num_trajectories`` independent trajectories of ``n`` time steps from this dynamic Bayesian network. It
+returns a :class:`DynamicBatchSampler` that yields a :class:`pyarrow.RecordBatch` with ``batch_steps`` time steps of all
+the trajectories (the last batch may contain less time steps). Only the last
+:func:`DynamicBayesianNetworkBase.markovian_order` time steps are kept between batches, so the memory does not depend on
+``n``.
+
+The trajectories are stacked in each batch: the rows ``[k*num_trajectories, (k+1)*num_trajectories)`` contain the k-th
+time step of the batch for each trajectory. Each time step of all the trajectories is sampled together (in parallel
+with ``num_threads`` threads) by the transition Bayesian network, so the result does not depend on ``num_threads``
+but it is not equal to :func:`DynamicBayesianNetworkBase.sample` with the same seed.
+
+:param n: Number of time steps of each trajectory.
+:param batch_steps: Number of time steps of each batch.
+:param num_trajectories: Number of independent trajectories.
+:param seed: A random seed number. If not specified or ``None``, a random seed is generated.
+:param num_threads: Number of threads. If 0, the hardware concurrency is used.
+:returns: A :class:`DynamicBatchSampler` over the sampled batches.
 )doc")
         .def("save", &CppClass::save, py::arg("filename"), py::arg("include_cpd") = false, R"doc(
 Saves the dynamic Bayesian network in a pickle file with the given name. If ``include_cpd`` is True, it also saves the
 conditional probability distributions (CPDs) in the dynamic Bayesian network.
 
+:param filename: File name of the saved dynamic Bayesian network.
+:param include_cpd: Include the CPDs.
+)doc")
+        .def(
+            "save_binary",
+            [](const CppClass& self, std::string filename, bool include_cpd) {
+                models::save_binary(self, filename, include_cpd);
+            },
+            py::arg("filename"),
+            py::arg("include_cpd") = false,
+            R"doc(
+Saves the dynamic Bayesian network in the binary format of PyBNesian with the given name. See
+:func:`BayesianNetworkBase.save_binary <pybnesian.BayesianNetworkBase.save_binary>`.
+
 :param filename: File name of the saved dynamic Bayesian network.
 :param include_cpd: Include the CPDs.
 )doc")
@@ -2046,6 +2419,9 @@ can_have_arc(model: BayesianNetworkBase or ConditionalBayesianNetworkBase, sourc
 
 Checks whether the :class:`BayesianNetworkType` allows an arc ``source`` -> ``target`` in the Bayesian network ``model``.
 
+The learning operators cache the result of this method for each pair of nodes, and only call it again for the nodes
+whose node type changes. Thus, the result should only depend on the nodes and their node types.
+
 :param model: BayesianNetwork model.
 :param source: Name of the source node.
 :param target: Name of the target node.
@@ -2172,6 +2548,235 @@ continuous parents.
         .def(py::pickle([](const CLGNetworkType& self) { return self.__getstate__(); },
                         [](py::tuple&) { return CLGNetworkType::get(); }));
 
+    py::class_<LoglBatchIterator>(root, "LoglBatchIterator", R"doc(
+Iterator over the log-likelihood of each batch of instances. It is returned by
+:func:`BayesianNetworkBase.logl_batches`.
+)doc")
+        .def("__iter__", [](LoglBatchIterator& self) -> LoglBatchIterator& { return self; })
+        .def("__next__", &LoglBatchIterator::next, py::return_value_policy::take_ownership);
+
+    py::class_<models::LoglPlan>(root, "LoglPlan", R"doc(
+A plan to evaluate the log-likelihood of a fitted Bayesian network on the DataFrames with a fixed schema. It is
+returned by :func:`BayesianNetworkBase.compile`.
+
+The columns of each CPD are resolved, and the parameters of the
+:class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>` and :class:`DiscreteFactor <pybnesian.DiscreteFactor>` are
+copied, when the plan is compiled. The other CPDs, and the CPDs whose columns contain null values, are evaluated with
+:func:`Factor.logl <pybnesian.Factor.logl>`.
+
+A single instance can be evaluated with :func:`LoglPlan.logl_instance` without creating a DataFrame.
+)doc")
+        .def_property_readonly("schema", &models::LoglPlan::schema, R"doc(
+The :class:`pyarrow.Schema` of the evaluated DataFrames.
+)doc")
+        .def_property_readonly("backend", &models::LoglPlan::backend, R"doc(
+The :class:`KDEBackend <pybnesian.KDEBackend>` that evaluates the
+:class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>`. It is never ``KDEBackend.AUTO``.
+)doc")
+        .def("logl", &models::LoglPlan::logl, py::return_value_policy::take_ownership, py::arg("df"), R"doc(
+Returns the log-likelihood of each instance in the DataFrame ``df``. It is equal to :func:`BayesianNetworkBase.logl`.
+
+:param df: DataFrame with the schema of the plan.
+:returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64`, where the i-th value is the log-likelihod
+          of the i-th instance of ``df``.
+:raises ValueError: If the schema of ``df`` is not the schema of the plan.
+)doc")
+        .def("slogl", &models::LoglPlan::slogl, py::arg("df"), R"doc(
+Returns the sum of the log-likelihood of each instance in the DataFrame ``df``. It is equal to
+:func:`BayesianNetworkBase.slogl`.
+
+:param df: DataFrame with the schema of the plan.
+:returns: The sum of log-likelihood for DataFrame ``df``.
+:raises ValueError: If the schema of ``df`` is not the schema of the plan.
+)doc")
+        .def("logl_instance",
+             py::overload_cast<const std::unordered_map<std::string, AssignmentValue>&>(
+                 &models::LoglPlan::logl_instance, py::const_),
+             py::arg("values"),
+             R"doc(
+Returns the log-likelihood of a single instance. The instance is evaluated directly with the parameters of the plan,
+so it is faster than evaluating a DataFrame of one row. Only the
+:class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>`, :class:`DiscreteFactor <pybnesian.DiscreteFactor>` and
+:class:`CLinearGaussianCPD <pybnesian.CLinearGaussianCPD>` can be evaluated.
+
+:param values: A dict with the value of each node (and its evidence) by name, or a list with the value of each column
+               of :attr:`LoglPlan.schema`. The values of the continuous variables are numbers and the values of the
+               discrete variables are the categories (:class:`str`).
+:returns: The log-likelihood of the instance.
+:raises ValueError: If a value is missing, it has a wrong type, it is not a category of the variable, or a CPD cannot
+                    be evaluated with this method.
+)doc")
+        .def("logl_instance",
+             py::overload_cast<const std::vector<AssignmentValue>&>(&models::LoglPlan::logl_instance, py::const_),
+             py::arg("values"));
+
+    py::class_<models::EnsembleLogl>(root, "EnsembleLogl", R"doc(
+Evaluates the log-likelihood of an ensemble of fitted Bayesian networks (e.g., the bootstrap models of a structure
+learning algorithm) on the same DataFrames.
+
+The CPDs of the models are deduplicated when the ensemble is created: two CPDs are the same factor if they are the same
+object, or if they are :class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>` or
+:class:`DiscreteFactor <pybnesian.DiscreteFactor>` with the same variable, evidence and parameters. Each distinct factor
+is evaluated once for all the models that contain it, and the :class:`DiscreteFactor <pybnesian.DiscreteFactor>` with
+the same variable and evidence share the indices of the configurations of the data.
+
+The CPDs are read when the ensemble is created, so it must be created again if the models are fitted again.
+)doc")
+        .def(py::init<const std::vector<std::shared_ptr<BayesianNetworkBase>>&>(), py::arg("models"), R"doc(
+Initializes an :class:`EnsembleLogl` with a list of fitted models.
+
+:param models: A list of fitted :class:`BayesianNetworkBase`.
+:raises ValueError: If some model is not fitted.
+)doc")
+        .def("num_models", &models::EnsembleLogl::num_models, R"doc(
+Gets the number of models of the ensemble.
+
+:returns: Number of models.
+)doc")
+        .def("num_factors", &models::EnsembleLogl::num_factors, R"doc(
+Gets the number of distinct CPDs of the models (excluding the Python-derived models).
+
+:returns: Number of distinct CPDs.
+)doc")
+        .def("logl",
+             &models::EnsembleLogl::logl,
+             py::return_value_policy::take_ownership,
+             py::arg("df"),
+             py::arg("num_threads") = 1,
+             R"doc(
+Returns the log-likelihood of each instance in the DataFrame ``df`` for each model. The column i is equal to
+:func:`BayesianNetworkBase.logl` of the i-th model (up to rounding errors).
+
+:param df: DataFrame to compute the log-likelihood.
+:param num_threads: Number of threads that evaluate the blocks of instances in parallel. 0 selects the hardware
+                    concurrency.
+:returns: A :class:`numpy.ndarray` matrix with dtype :class:`numpy.float64` and shape ``(df.shape[0], num_models())``.
+)doc")
+        .def("slogl",
+             &models::EnsembleLogl::slogl,
+             py::return_value_policy::take_ownership,
+             py::arg("df"),
+             py::arg("num_threads") = 1,
+             R"doc(
+Returns the sum of the log-likelihood of the instances in the DataFrame ``df`` for each model. The i-th value is equal
+to :func:`BayesianNetworkBase.slogl` of the i-th model (up to rounding errors).
+
+:param df: DataFrame to compute the sum of the log-likelihood.
+:param num_threads: Number of threads that evaluate the factors in parallel. 0 selects the hardware concurrency.
+:returns: A :class:`numpy.ndarray` vector with dtype :class:`numpy.float64` and the slogl of each model.
+)doc");
+
+    py::class_<models::CrossValidatedLogl>(root, "CrossValidatedLogl", R"doc(
+The log-likelihood of the test folds of a :class:`CrossValidation <pybnesian.CrossValidation>`, where the CPDs of a
+structure are fitted with each training fold. It is returned by
+:func:`cross_validated_logl <pybnesian.cross_validated_logl>`.
+)doc")
+        .def_readonly("nodes", &models::CrossValidatedLogl::nodes, R"doc(
+The nodes of the model, in the order of the columns of :attr:`CrossValidatedLogl.node_slogl`.
+)doc")
+        .def_readonly("node_slogl", &models::CrossValidatedLogl::node_slogl, R"doc(
+A :class:`numpy.ndarray` matrix with the sum of the log-likelihood of the CPD of each node (columns) in each test fold
+(rows).
+)doc")
+        .def("fold_slogl", &models::CrossValidatedLogl::fold_slogl, R"doc(
+Returns the sum of the log-likelihood of the model in each test fold.
+
+:returns: A :class:`numpy.ndarray` vector with the log-likelihood of each test fold.
+)doc")
+        .def("slogl", &models::CrossValidatedLogl::slogl, R"doc(
+Returns the sum of the log-likelihood of the model in all the test folds.
+
+:returns: The cross-validated log-likelihood.
+)doc");
+
+    root.def("cross_validated_logl",
+             &models::cross_validated_logl,
+             py::arg("model"),
+             py::arg("cv"),
+             py::arg("construction_args") = Arguments(),
+             py::arg("num_threads") = 1,
+             R"doc(
+Fits the CPDs of the structure of ``model`` (its arcs and node types, ignoring its CPDs) with the training data of
+each fold of ``cv``, and evaluates them in the test data of the fold. It is equivalent to fitting a copy of the
+structure in each training fold and calling :func:`BayesianNetworkBase.slogl` in each test fold, but the folds and the
+nodes are fitted in parallel and the columns of ``cv`` are reordered once for all the folds.
+
+:param model: A :class:`BayesianNetworkBase`. It does not need to be fitted.
+:param cv: A :class:`CrossValidation <pybnesian.CrossValidation>` with the columns of the model.
+:param construction_args: Additional arguments provided to construct the :class:`Factor <pybnesian.Factor>`.
+:param num_threads: Number of threads that fit and evaluate the pairs of fold and node in parallel. If 0, the hardware
+                    concurrency is used. The result does not depend on the number of threads. The models with
+                    Python-derived factors or node types are evaluated serially.
+:returns: A :class:`CrossValidatedLogl` with the log-likelihood of each node in each test fold.
+)doc");
+
+    py::class_<DynamicBatchSampler>(root, "DynamicBatchSampler", R"doc(
+Iterator over the batches of time steps of independent trajectories sampled from a dynamic Bayesian network. It is
+returned by :func:`DynamicBayesianNetworkBase.sample_batches`.
+)doc")
+        .def("__iter__", [](DynamicBatchSampler& self) -> DynamicBatchSampler& { return self; })
+        .def("__next__",
+             [](DynamicBatchSampler& self) {
+                 if (!self.has_next()) throw py::stop_iteration();
+                 return self.next();
+             })
+        .def_property_readonly("time_step", &DynamicBatchSampler::time_step, R"doc(
+Number of time steps sampled so far in each trajectory.
+)doc");
+
+    py::class_<DynamicLoglFilter>(root, "DynamicLoglFilter", R"doc(
+Evaluates the log-likelihood of a fitted dynamic Bayesian network one time step at a time, as in an online filter.
+Only the last :func:`DynamicBayesianNetworkBase.markovian_order` time steps are kept, and each new time step is
+evaluated directly with the parameters of the transition CPDs, so the cost of :func:`DynamicLoglFilter.append` does not
+depend on the number of time steps and no DataFrame is created. Only the
+:class:`LinearGaussianCPD <pybnesian.LinearGaussianCPD>`, :class:`DiscreteFactor <pybnesian.DiscreteFactor>` and
+:class:`CLinearGaussianCPD <pybnesian.CLinearGaussianCPD>` can be evaluated.
+
+The parameters are copied when the filter is created, so it must be created again if the model is fitted again.
+)doc")
+        .def(py::init<const DynamicBayesianNetworkBase&>(), py::arg("dbn"), R"doc(
+Initializes a :class:`DynamicLoglFilter` for a fitted dynamic Bayesian network.
+
+:param dbn: A fitted :class:`DynamicBayesianNetworkBase`.
+:raises ValueError: If ``dbn`` is not fitted or a CPD cannot be evaluated by the filter.
+)doc")
+        .def_property_readonly("variables", &DynamicLoglFilter::variables, R"doc(
+The variables of the dynamic Bayesian network, in the order of the values of :func:`DynamicLoglFilter.append`.
+)doc")
+        .def_property_readonly("time_step", &DynamicLoglFilter::time_step, R"doc(
+Number of time steps appended so far.
+)doc")
+        .def("slogl", &DynamicLoglFilter::slogl, R"doc(
+Returns the log-likelihood of all the appended time steps. It is equal to :func:`DynamicBayesianNetworkBase.slogl` of
+the time steps.
+
+:returns: The sum of the values returned by :func:`DynamicLoglFilter.append`.
+)doc")
+        .def("append",
+             py::overload_cast<const std::unordered_map<std::string, AssignmentValue>&>(&DynamicLoglFilter::append),
+             py::arg("values"),
+             R"doc(
+Appends a time step and returns its log-likelihood.
+
+The first :func:`DynamicBayesianNetworkBase.markovian_order` time steps are evaluated together by the static Bayesian
+network, so this method returns 0 until the last of them, that returns the log-likelihood of all of them. The later
+time steps return the log-likelihood of the transition Bayesian network, that is equal to
+:func:`DynamicBayesianNetworkBase.logl` for the time step.
+
+:param values: A dict with the value of each variable by name, or a list with the values in the order of
+               :attr:`DynamicLoglFilter.variables`. The values of the continuous variables are numbers and the values of
+               the discrete variables are the categories (:class:`str`).
+:returns: The log-likelihood of the time step.
+:raises ValueError: If a value is missing, it has a wrong type or it is not a category of the variable. The time step
+                    is not appended in that case.
+)doc")
+        .def("append",
+             py::overload_cast<const std::vector<AssignmentValue>&>(&DynamicLoglFilter::append),
+             py::arg("values"))
+        .def("reset", &DynamicLoglFilter::reset, R"doc(
+Removes all the appended time steps, so the next time step starts a new trajectory.
+)doc");
+
     register_BayesianNetwork_methods<BayesianNetworkBase>(bn_base);
     register_ConditionalBayesianNetwork_methods<ConditionalBayesianNetworkBase>(cbn_base);
 
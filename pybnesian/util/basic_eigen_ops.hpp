@@ -146,6 +146,91 @@ bool is_psd(const M& m) {
     return true;
 }
 
+// Replaces the lower Cholesky factor L of a matrix A with the Cholesky factor of A + sigma * v * v^T. Returns false
+// if the updated matrix is not positive definite. The algorithm is the same as Eigen::LLT::rankUpdate().
+template <typename M, typename V>
+bool cholesky_rank_update(M& L, V v, typename M::Scalar sigma) {
+    using Scalar = typename M::Scalar;
+    auto n = L.rows();
+    Scalar beta = 1;
+
+    for (auto j = 0; j < n; ++j) {
+        Scalar Ljj = L(j, j);
+        Scalar wj = v(j);
+        Scalar swj2 = sigma * wj * wj;
+        Scalar gamma = Ljj * Ljj * beta + swj2;
+
+        Scalar x = Ljj * Ljj + swj2 / beta;
+        if (!(x > 0)) return false;
+        Scalar nLjj = std::sqrt(x);
+        L(j, j) = nLjj;
+        beta += swj2 / (Ljj * Ljj);
+
+        auto rs = n - j - 1;
+        if (rs > 0) {
+            v.tail(rs) -= (wj / Ljj) * L.col(j).tail(rs);
+            if (gamma != 0) {
+                L.col(j).tail(rs) = (nLjj / Ljj) * L.col(j).tail(rs) + (nLjj * sigma * wj / gamma) * v.tail(rs);
+            }
+        }
+    }
+
+    return true;
+}
+
+// Computes the lower Cholesky factor of A with the column c (the diagonal element is c(position)) inserted at position,
+// given the lower Cholesky factor L of A. Returns false if the new matrix is not positive definite.
+template <typename M, typename V>
+bool cholesky_insert(const M& L, int position, const V& c, M& result) {
+    using Scalar = typename M::Scalar;
+    using VectorType = Matrix<Scalar, Dynamic, 1>;
+    int d = L.rows();
+    int p = position;
+    int after = d - p;
+
+    result = M::Zero(d + 1, d + 1);
+    result.topLeftCorner(p, p) = L.topLeftCorner(p, p);
+    result.bottomLeftCorner(after, p) = L.bottomLeftCorner(after, p);
+
+    VectorType l21 = L.topLeftCorner(p, p).template triangularView<Eigen::Lower>().solve(c.head(p));
+    Scalar l22 = c(p) - l21.squaredNorm();
+    if (!(l22 > 0)) return false;
+    l22 = std::sqrt(l22);
+
+    result.row(p).head(p) = l21.transpose();
+    result(p, p) = l22;
+
+    VectorType l32 = (c.tail(after) - L.bottomLeftCorner(after, p) * l21) / l22;
+    result.col(p).tail(after) = l32;
+
+    M L33 = L.bottomRightCorner(after, after);
+    if (!cholesky_rank_update(L33, l32, -1)) return false;
+    result.bottomRightCorner(after, after) = L33;
+    return true;
+}
+
+// Computes the lower Cholesky factor of A without the row and column at position, given the lower Cholesky factor L
+// of A.
+template <typename M>
+M cholesky_remove(const M& L, int position) {
+    using Scalar = typename M::Scalar;
+    using VectorType = Matrix<Scalar, Dynamic, 1>;
+    int d = L.rows();
+    int p = position;
+    int after = d - p - 1;
+
+    M result = M::Zero(d - 1, d - 1);
+    result.topLeftCorner(p, p) = L.topLeftCorner(p, p);
+    result.bottomLeftCorner(after, p) = L.bottomLeftCorner(after, p);
+
+    // A rank-one update of a positive definite matrix is positive definite.
+    M L33 = L.bottomRightCorner(after, after);
+    VectorType l32 = L.col(p).tail(after);
+    cholesky_rank_update(L33, l32, 1);
+    result.bottomRightCorner(after, after) = L33;
+    return result;
+}
+
 }  // namespace util
 
 #endif  // PYBNESIAN_UTIL_ARROW_BASIC_EIGEN_OPS_HPP
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include <util/binary_io.hpp>
+#include <util/arrow_macros.hpp>
+
+namespace util {
+
+namespace {
+
+constexpr char magic[] = "PYBNESIAN";
+constexpr std::size_t magic_size = sizeof(magic) - 1;
+constexpr std::uint32_t format_version = 1;
+// Detects the files saved in a machine with a different byte order.
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+std::shared_ptr<arrow::io::MemoryMappedFile> open_mapped_file(const std::string& filename) {
+    RAISE_RESULT_ERROR(auto file, arrow::io::MemoryMappedFile::Open(filename, arrow::io::FileMode::READ))
+    return file;
+}
+
+std::int64_t file_size(arrow::io::MemoryMappedFile& file) {
+    RAISE_RESULT_ERROR(auto size, file.GetSize())
+    return size;
+}
+
+// The ReadAt() of a memory-mapped file returns a slice of the mapping, so the file is not copied.
+std::shared_ptr<arrow::Buffer> mapped_buffer(arrow::io::MemoryMappedFile& file) {
+    RAISE_RESULT_ERROR(auto buffer, file.ReadAt(0, file_size(file)))
+    return buffer;
+}
+
+}  // namespace
+
+BinaryWriter::BinaryWriter(const std::string& filename, const std::string& content)
+    : m_file(filename, std::ios::out | std::ios::binary | std::ios::trunc), m_offset(0) {
+    if (!m_file) throw std::runtime_error("Could not open file " + filename + " for writing.");
+
+    write_bytes(magic, magic_size);
+    write(format_version);
+    write(byte_order_mark);
+    write(content);
+}
+
+void BinaryWriter::write_bytes(const void* data, std::size_t size) {
+    if (size == 0) return;
+
+    m_file.write(reinterpret_cast<const char*>(data), size);
+    if (!m_file) throw std::runtime_error("Error writing the binary file.");
+    m_offset += size;
+}
+
+void BinaryWriter::pad(std::size_t alignment) {
+    static const char zeros[block_alignment] = {};
+    auto remainder = m_offset % alignment;
+    if (remainder != 0) write_bytes(zeros, alignment - remainder);
+}
+
+std::size_t BinaryWriter::begin_record() {
+    write<std::uint64_t>(0);
+    return m_offset;
+}
+
+void BinaryWriter::end_record(std::size_t record_offset) {
+    std::uint64_t size = m_offset - record_offset;
+
+    m_file.seekp(record_offset - sizeof(std::uint64_t));
+    m_file.write(reinterpret_cast<const char*>(&size), sizeof(std::uint64_t));
+    m_file.seekp(m_offset);
+    if (!m_file) throw std::runtime_error("Error writing the binary file.");
+}
+
+void BinaryWriter::close() {
+    m_file.close();
+    if (!m_file) throw std::runtime_error("Error writing the binary file.");
+}
+
+BinaryReader::BinaryReader(const std::string& filename, bool memory_map)
+    : m_filename(filename), m_offset(0), m_memory_map(memory_map) {
+    m_file = open_mapped_file(filename);
+    m_buffer = mapped_buffer(*m_file);
+
+    if (static_cast<std::size_t>(m_buffer->size()) < magic_size ||
+        std::memcmp(m_buffer->data(), magic, magic_size) != 0) {
+        throw std::invalid_argument("File " + filename + " is not a PyBNesian binary file.");
+    }
+    m_offset = magic_size;
+
+    // The byte order mark is checked first, because the version of a file with a different byte order is not valid.
+    auto version = read<std::uint32_t>();
+    if (read<std::uint32_t>() != byte_order_mark) {
+        throw std::invalid_argument("File " + filename + " was saved in a machine with a different byte order.");
+    }
+
+    if (version > format_version) {
+        throw std::invalid_argument("File " + filename + " was saved with a newer version of the binary format (" +
+                                    std::to_string(version) + "). Update PyBNesian to load it.");
+    }
+
+    m_content = read_string();
+}
+
+BinaryReader BinaryReader::read_record() {
+    auto size = read<std::uint64_t>();
+    BinaryReader record = *this;
+    take(size);
+    return record;
+}
+
+const std::uint8_t* BinaryReader::take(std::size_t size) {
+    if (size > remaining()) throw_corrupted();
+
+    auto ptr = m_buffer->data() + m_offset;
+    m_offset += size;
+    return ptr;
+}
+
+void BinaryReader::skip_padding(std::size_t alignment) {
+    auto remainder = m_offset % alignment;
+    if (remainder != 0) take(alignment - remainder);
+}
+
+void BinaryReader::throw_corrupted() const {
+    throw std::runtime_error("File " + m_filename + " is truncated or corrupted.");
+}
+
+}  // namespace util
@@ -0,0 +1,177 @@
+#ifndef PYBNESIAN_UTIL_BINARY_IO_HPP
+#define PYBNESIAN_UTIL_BINARY_IO_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <Eigen/Dense>
+
+namespace util {
+
+// The binary format of PyBNesian saves the objects without pickle (see models::load_binary()). A file starts with a
+// header (a magic string, the format version, a byte order mark and the type of the saved object) followed by the
+// values of the object. The values are saved in the byte order of the machine, and the blocks of data (e.g., the
+// training data of a KDE) are aligned to block_alignment bytes, so they can be used directly from a memory-mapped file.
+class BinaryWriter {
+public:
+    static constexpr std::size_t block_alignment = 64;
+
+    BinaryWriter(const std::string& filename, const std::string& content);
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_arithmetic_v<T>, "Only arithmetic values can be written.");
+        write_bytes(&value, sizeof(T));
+    }
+
+    void write(bool value) { write<std::uint8_t>(value); }
+    void write(const std::string& value) {
+        write<std::uint64_t>(value.size());
+        write_bytes(value.data(), value.size());
+    }
+    void write(const char* value) { write(std::string(value)); }
+
+    template <typename T>
+    void write(const std::vector<T>& values) {
+        write<std::uint64_t>(values.size());
+        for (const auto& v : values) write(v);
+    }
+
+    // Writes count values in an aligned block of data.
+    template <typename T>
+    void write_block(const T* data, std::size_t count) {
+        static_assert(std::is_arithmetic_v<T>, "Only arithmetic blocks can be written.");
+        write<std::uint64_t>(count);
+        pad(block_alignment);
+        write_bytes(data, sizeof(T) * count);
+    }
+
+    // Writes the shape and an aligned block with the (column-major) values of a matrix.
+    template <typename Derived>
+    void write_matrix(const Eigen::MatrixBase<Derived>& m) {
+        using Scalar = typename Derived::Scalar;
+        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> plain = m;
+        write<std::int64_t>(plain.rows());
+        write<std::int64_t>(plain.cols());
+        write_block(plain.data(), plain.size());
+    }
+
+    // Starts a record, whose size in bytes is written before its values, so the record can be skipped when it is read
+    // (see BinaryReader::read_record()). Returns the offset that must be passed to end_record() once the values of the
+    // record are written.
+    std::size_t begin_record();
+    void end_record(std::size_t record_offset);
+
+    void close();
+
+private:
+    void write_bytes(const void* data, std::size_t size);
+    void pad(std::size_t alignment);
+
+    std::ofstream m_file;
+    std::size_t m_offset;
+};
+
+// Reader of the binary format. The file is memory-mapped, so the blocks of data are not copied until they are used.
+// The copies of a reader share the memory-mapped file and have their own position.
+//
+// If memory_map is true, the objects read keep using their blocks of data from the memory-mapped file instead of
+// copying them (see mapping()). The operating system shares the pages of a file mapped by multiple processes, so the
+// processes that load the same file share one copy of the data.
+class BinaryReader {
+public:
+    explicit BinaryReader(const std::string& filename, bool memory_map = false);
+
+    // The type of the saved object.
+    const std::string& content() const { return m_content; }
+
+    bool memory_map() const { return m_memory_map; }
+    // Keeps the file mapped while it is alive, so the blocks of data returned by this reader remain valid.
+    std::shared_ptr<const void> mapping() const { return m_buffer; }
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_arithmetic_v<T>, "Only arithmetic values can be read.");
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    bool read_bool() { return read<std::uint8_t>() != 0; }
+    std::string read_string() {
+        auto size = read<std::uint64_t>();
+        return std::string(reinterpret_cast<const char*>(take(size)), size);
+    }
+    std::vector<std::string> read_strings() {
+        std::vector<std::string> res(read_count(sizeof(std::uint64_t)));
+        for (auto& s : res) s = read_string();
+        return res;
+    }
+    std::vector<std::vector<std::string>> read_nested_strings() {
+        std::vector<std::vector<std::string>> res(read_count(sizeof(std::uint64_t)));
+        for (auto& s : res) s = read_strings();
+        return res;
+    }
+
+    // Reads the number of elements of a sequence whose elements take at least min_size bytes each. It throws if the
+    // remaining bytes can not contain the sequence, so a corrupted count does not allocate the sequence.
+    std::size_t read_count(std::size_t min_size) {
+        auto count = read<std::uint64_t>();
+        if (min_size > 0 && count > remaining() / min_size) throw_corrupted();
+        return count;
+    }
+
+    // Returns a pointer to a block of data in the memory-mapped file, and sets count to its number of values. The
+    // pointer is valid while this reader exists.
+    template <typename T>
+    const T* read_block(std::size_t& count) {
+        count = read<std::uint64_t>();
+        skip_padding(BinaryWriter::block_alignment);
+        // Checked before the multiplication, so sizeof(T) * count does not overflow.
+        if (count > remaining() / sizeof(T)) throw_corrupted();
+        return reinterpret_cast<const T*>(take(sizeof(T) * count));
+    }
+
+    // Returns a map of a matrix in the memory-mapped file. The map is valid while this reader exists.
+    template <typename T>
+    Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>> read_matrix() {
+        auto rows = read<std::int64_t>();
+        auto cols = read<std::int64_t>();
+        if (rows < 0 || cols < 0 || (cols > 0 && rows > std::numeric_limits<std::int64_t>::max() / cols))
+            throw_corrupted();
+
+        std::size_t count;
+        auto data = read_block<T>(count);
+        if (static_cast<std::size_t>(rows * cols) != count) throw_corrupted();
+        return Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>(data, rows, cols);
+    }
+
+    // Returns a reader of the values of a record (see BinaryWriter::begin_record()), and skips the record in this
+    // reader. The returned reader shares the memory-mapped file, so it can be used after this reader is destroyed.
+    BinaryReader read_record();
+
+private:
+    std::size_t remaining() const { return static_cast<std::size_t>(m_buffer->size()) - m_offset; }
+    const std::uint8_t* take(std::size_t size);
+    void skip_padding(std::size_t alignment);
+    [[noreturn]] void throw_corrupted() const;
+
+    std::string m_filename;
+    std::shared_ptr<arrow::io::MemoryMappedFile> m_file;
+    std::shared_ptr<arrow::Buffer> m_buffer;
+    std::size_t m_offset;
+    std::string m_content;
+    bool m_memory_map;
+};
+
+}  // namespace util
+
+#endif  // PYBNESIAN_UTIL_BINARY_IO_HPP
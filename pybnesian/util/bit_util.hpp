@@ -1,6 +1,7 @@
 #ifndef PYBNESIAN_UTIL_BIT_UTIL_HPP
 #define PYBNESIAN_UTIL_BIT_UTIL_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <arrow/api.h>
 
@@ -36,11 +37,82 @@ int next_power2(int value);
 int previous_power2(int value);
 
 #if ARROW_VERSION_MAJOR >= 7
+using arrow::bit_util::CountTrailingZeros;
 using arrow::bit_util::GetBit;
+using arrow::bit_util::PopCount;
 #else
+using arrow::BitUtil::CountTrailingZeros;
 using arrow::BitUtil::GetBit;
+using arrow::BitUtil::PopCount;
 #endif
 
+// Calls f(begin, run_length) for each maximal run of set bits in the first length bits of bitmap, in order. The bitmap
+// is read in 64-bit words and the run boundaries are found with CountTrailingZeros(), so the cost depends on the
+// number of runs instead of the number of bits.
+template <typename F>
+void visit_set_runs(const uint8_t* bitmap, int64_t length, F&& f) {
+    int64_t run_begin = -1;
+
+    for (int64_t word_begin = 0; word_begin < length; word_begin += 64) {
+        auto word_bits = std::min<int64_t>(64, length - word_begin);
+        // The bitmaps are LSB ordered, so the byte j of the word holds the bits [8j, 8j + 8).
+        uint64_t word = 0;
+        for (int64_t j = 0, bytes = (word_bits + 7) / 8; j < bytes; ++j) {
+            word |= static_cast<uint64_t>(bitmap[word_begin / 8 + j]) << (8 * j);
+        }
+        if (word_bits < 64) word &= (uint64_t{1} << word_bits) - 1;
+
+        // The bits after the end of the bitmap are unset in word and set in ~word, so a run that reaches the end of
+        // the bitmap is finished in the last word.
+        int64_t pos = 0;
+        while (pos < word_bits) {
+            if (run_begin < 0) {
+                auto rest = word >> pos;
+                if (rest == 0) break;
+                pos += CountTrailingZeros(rest);
+                run_begin = word_begin + pos;
+            } else {
+                auto rest = ~word >> pos;
+                if (rest == 0) break;
+                pos += CountTrailingZeros(rest);
+                f(run_begin, word_begin + pos - run_begin);
+                run_begin = -1;
+            }
+        }
+    }
+
+    if (run_begin >= 0) f(run_begin, length - run_begin);
+}
+
+// Copies input[i] to the next position of output for each set bit i of the first length bits of bitmap. Returns the
+// number of copied values (the number of set bits).
+template <typename T, typename U>
+int64_t compact(const uint8_t* bitmap, int64_t length, const T* input, U* output) {
+    int64_t k = 0;
+    visit_set_runs(bitmap, length, [input, output, &k](int64_t begin, int64_t run) {
+        std::copy(input + begin, input + begin + run, output + k);
+        k += run;
+    });
+
+    return k;
+}
+
+// The inverse of compact(): copies the consecutive values of input to the positions of output whose bit is set in
+// bitmap, and fills the other positions of the length values of output with fill.
+template <typename T, typename U>
+void expand(const uint8_t* bitmap, int64_t length, const T* input, U fill, U* output) {
+    int64_t k = 0;
+    int64_t next = 0;
+    visit_set_runs(bitmap, length, [input, fill, output, &k, &next](int64_t begin, int64_t run) {
+        std::fill(output + next, output + begin, fill);
+        std::copy(input + k, input + k + run, output + begin);
+        k += run;
+        next = begin + run;
+    });
+
+    std::fill(output + next, output + length, fill);
+}
+
 }  // namespace util::bit_util
 
 #endif  // PYBNESIAN_UTIL_BIT_UTIL_HPP
@@ -1,6 +1,7 @@
 #ifndef PYBNESIAN_UTIL_CHISQUARESUM_HPP
 #define PYBNESIAN_UTIL_CHISQUARESUM_HPP
 
+#include <algorithm>
 #include <Eigen/Dense>
 #include <boost/math/special_functions/binomial.hpp>
 #include <boost/math/distributions/gamma.hpp>
@@ -304,6 +305,48 @@ typename VectorType::Scalar hbe_complement(VectorType& coeffs, typename VectorTy
     return cdf(complement(gamma, statistic));
 }
 
+// The p-values of chisquaresum_complement() smaller than this are not refined with lpb4_complement().
+constexpr double chisquaresum_min_refined_pvalue = 1e-6;
+// The p-values of chisquaresum_complement() greater than this (with the HBE approximation) are not refined with
+// lpb4_complement().
+constexpr double chisquaresum_max_refined_pvalue = 0.5;
+
+/**
+ * Returns the probability that the weighted sum of chi-squared random variables is greater than quantile. The LPB4
+ * approximation (lpb4_complement()) is only computed when the p-value can be close to the usual significance levels:
+ *
+ * - The sum is stochastically smaller than max(coeffs) times a chi-squared with coeffs.rows() degrees of freedom. If
+ *   the p-value of this bound is smaller than chisquaresum_min_refined_pvalue, the p-value is the minimum of the bound
+ *   and the HBE approximation.
+ * - If the HBE approximation (hbe_complement()) is greater than chisquaresum_max_refined_pvalue, the p-value is the HBE
+ *   approximation.
+ *
+ * The HBE approximation is also used if there are less than 4 coefficients or the LPB4 approximation fails. The p-value
+ * is never negative.
+ */
+template <typename VectorType>
+typename VectorType::Scalar chisquaresum_complement(VectorType& coeffs, typename VectorType::Scalar quantile) {
+    using Scalar = typename VectorType::Scalar;
+
+    auto hbe_pvalue = std::max(hbe_complement(coeffs, quantile), static_cast<Scalar>(0));
+    if (coeffs.rows() < 4) return hbe_pvalue;
+
+    auto max_coeff = coeffs.maxCoeff();
+    if (max_coeff > 0) {
+        gamma_distribution<Scalar> dominating(coeffs.rows() / 2., 2);
+        auto bound = cdf(complement(dominating, std::max(quantile / max_coeff, static_cast<Scalar>(0))));
+        if (bound < chisquaresum_min_refined_pvalue) return std::min(hbe_pvalue, bound);
+    }
+
+    if (hbe_pvalue > chisquaresum_max_refined_pvalue) return hbe_pvalue;
+
+    try {
+        return std::max(lpb4_complement(coeffs, quantile), static_cast<Scalar>(0));
+    } catch (std::exception&) {
+        return hbe_pvalue;
+    }
+}
+
 }  // namespace util
 
 #endif  // PYBNESIAN_UTIL_CHISQUARESUM_HPP
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef PYBNESIAN_UTIL_MEMORY_USAGE_HPP
+#define PYBNESIAN_UTIL_MEMORY_USAGE_HPP
+
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace util {
+
+// The memory used by an object (a model, a CPD, a score, an independence test or an OpenCL device) in bytes, by
+// component. The host bytes are allocated in the memory of the process, and the device bytes in the OpenCL devices.
+// Only the main buffers (the data, the parameters and the caches) are counted, so the small members of the objects are
+// not included. The memory of the memory-mapped files is not counted either, because it is owned by the operating
+// system.
+class MemoryUsage {
+public:
+    struct Bytes {
+        std::size_t host = 0;
+        std::size_t device = 0;
+    };
+
+    void add(const std::string& component, std::size_t host, std::size_t device = 0) {
+        if (host == 0 && device == 0) return;
+        auto& bytes = m_components[component];
+        bytes.host += host;
+        bytes.device += device;
+    }
+
+    // Adds the components of other, named prefix + "." + component.
+    void add(const std::string& prefix, const MemoryUsage& other) {
+        for (const auto& [component, bytes] : other.m_components) {
+            add(prefix + "." + component, bytes.host, bytes.device);
+        }
+    }
+
+    std::size_t host_bytes() const {
+        std::size_t total = 0;
+        for (const auto& c : m_components) total += c.second.host;
+        return total;
+    }
+
+    std::size_t device_bytes() const {
+        std::size_t total = 0;
+        for (const auto& c : m_components) total += c.second.device;
+        return total;
+    }
+
+    std::size_t total_bytes() const { return host_bytes() + device_bytes(); }
+
+    const std::map<std::string, Bytes>& components() const { return m_components; }
+
+private:
+    std::map<std::string, Bytes> m_components;
+};
+
+// The memory limit of the caches that are not limited by set_max_cache_memory().
+inline constexpr std::size_t unlimited_memory = std::numeric_limits<std::size_t>::max();
+
+template <typename EigenType>
+std::size_t eigen_bytes(const EigenType& m) {
+    return sizeof(typename EigenType::Scalar) * static_cast<std::size_t>(m.size());
+}
+
+template <typename T>
+std::size_t vector_bytes(const std::vector<T>& v) {
+    return sizeof(T) * v.capacity();
+}
+
+}  // namespace util
+
+#endif  // PYBNESIAN_UTIL_MEMORY_USAGE_HPP
@@ -0,0 +1,239 @@
+#ifndef PYBNESIAN_UTIL_PARALLEL_HPP
+#define PYBNESIAN_UTIL_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <pybind11/pybind11.h>
+
+namespace py = pybind11;
+
+namespace util {
+
+// Returns the effective number of threads for a num_threads parameter. A value of 0 selects the
+// hardware concurrency.
+inline int effective_num_threads(int num_threads) {
+    if (num_threads < 0) {
+        throw std::invalid_argument("num_threads must be a non-negative number.");
+    }
+
+    if (num_threads == 0) {
+        auto hw = std::thread::hardware_concurrency();
+        return hw > 0 ? static_cast<int>(hw) : 1;
+    }
+
+    return num_threads;
+}
+
+// The deterministic mode. Most of the parallel code already distributes the work in tasks that do not depend on the
+// number of threads, and reduces their results in the order of the tasks. In the deterministic mode, the few remaining
+// parallel reductions whose order depends on the number of threads (e.g., the blocks of nodes of
+// BayesianNetworkBase::parallel_logl()) also use a fixed order, so their results are bit-identical for any number of
+// threads (including 1). It is disabled by default.
+inline std::atomic<bool>& deterministic_mode_flag() {
+    static std::atomic<bool> deterministic = false;
+    return deterministic;
+}
+
+inline bool deterministic_mode() { return deterministic_mode_flag().load(std::memory_order_relaxed); }
+inline void set_deterministic_mode(bool deterministic) { deterministic_mode_flag() = deterministic; }
+
+// Releases the GIL only if the current thread holds it. This is needed because the parallel code can be
+// called from a Python thread (holding the GIL) or from C++ code that already released it. If release is false, the
+// GIL is never released, which is used when the code calls Python-derived objects.
+//
+// The long-running native entry points (the structure learning algorithms and the independence tests of the
+// constraint-based algorithms) hold one for their whole run, with release = false if any of the objects they call
+// (the score, the test, the model, the operators or the callback) is implemented in Python, so other Python threads
+// can run in the meantime.
+class gil_release_if_held {
+public:
+    explicit gil_release_if_held(bool release = true) : m_release() {
+        if (release && Py_IsInitialized() && PyGILState_Check()) m_release.emplace();
+    }
+
+private:
+    std::optional<py::gil_scoped_release> m_release;
+};
+
+// A pool of persistent worker threads. The work of each parallel_for() call is distributed dynamically: each thread
+// takes the next unprocessed iteration, so threads that finish early keep taking work from the slow ones.
+//
+// The pools are usually obtained with ThreadPool::shared(), so that all the algorithms (and all the steps of an
+// algorithm) reuse the same threads instead of creating new ones.
+class ThreadPool {
+public:
+    explicit ThreadPool(int num_threads)
+        : m_threads(), m_mutex(), m_submit_mutex(), m_work_cv(), m_done_cv(), m_job(), m_generation(0), m_active(0),
+          m_stop(false) {
+        num_threads = effective_num_threads(num_threads);
+        m_threads.reserve(num_threads - 1);
+        for (int t = 1; t < num_threads; ++t) {
+            m_threads.emplace_back([this, t]() { worker_loop(t); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_work_cv.notify_all();
+
+        for (auto& t : m_threads) {
+            t.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads, including the thread that calls parallel_for().
+    int num_threads() const { return static_cast<int>(m_threads.size()) + 1; }
+
+    // Returns a process-wide pool with num_threads threads.
+    static ThreadPool& shared(int num_threads) {
+        static std::mutex pools_mutex;
+        static std::vector<std::unique_ptr<ThreadPool>> pools;
+
+        num_threads = effective_num_threads(num_threads);
+
+        std::lock_guard<std::mutex> lock(pools_mutex);
+        for (auto& pool : pools) {
+            if (pool->num_threads() == num_threads) return *pool;
+        }
+
+        pools.push_back(std::make_unique<ThreadPool>(num_threads));
+        return *pools.back();
+    }
+
+    // Runs f(i, thread_index) for every i in [begin, end). The calling thread participates as thread 0. f must be safe
+    // to call concurrently for different i. The first exception thrown by any iteration is rethrown in the calling
+    // thread once all the threads have finished.
+    //
+    // The GIL is released while the threads run: any code inside f that touches Python objects must acquire it.
+    //
+    // A parallel_for() called from inside a running job is executed serially by the calling thread.
+    template <typename F>
+    void parallel_for(int begin, int end, F&& f) {
+        if (end <= begin) return;
+
+        if (m_threads.empty() || in_job() || (end - begin) == 1) {
+            for (int i = begin; i < end; ++i) {
+                f(i, 0);
+            }
+            return;
+        }
+
+        std::atomic<int> next(begin);
+        std::atomic<bool> failed(false);
+        std::exception_ptr first_exception = nullptr;
+        std::mutex exception_mutex;
+
+        std::function<void(int)> job = [&](int thread_index) {
+            in_job() = true;
+            while (!failed.load(std::memory_order_relaxed)) {
+                int i = next.fetch_add(1, std::memory_order_relaxed);
+                if (i >= end) break;
+
+                try {
+                    f(i, thread_index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(exception_mutex);
+                    if (!first_exception) first_exception = std::current_exception();
+                    failed = true;
+                }
+            }
+            in_job() = false;
+        };
+
+        {
+            gil_release_if_held release;
+            std::lock_guard<std::mutex> submit_lock(m_submit_mutex);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_job = &job;
+                m_active = static_cast<int>(m_threads.size());
+                ++m_generation;
+            }
+            m_work_cv.notify_all();
+
+            job(0);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done_cv.wait(lock, [this]() { return m_active == 0; });
+            m_job = nullptr;
+        }
+
+        if (first_exception) std::rethrow_exception(first_exception);
+    }
+
+private:
+    static bool& in_job() {
+        thread_local bool in_job = false;
+        return in_job;
+    }
+
+    void worker_loop(int thread_index) {
+        std::uint64_t last_generation = 0;
+
+        while (true) {
+            std::function<void(int)>* job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work_cv.wait(lock, [&]() { return m_stop || m_generation != last_generation; });
+                if (m_stop) return;
+
+                last_generation = m_generation;
+                job = m_job;
+            }
+
+            (*job)(thread_index);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_active == 0) m_done_cv.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::mutex m_submit_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    std::function<void(int)>* m_job;
+    std::uint64_t m_generation;
+    int m_active;
+    bool m_stop;
+};
+
+// Runs f(i, thread_index) for every i in [begin, end) using the shared ThreadPool with num_threads threads. See
+// ThreadPool::parallel_for(). If num_threads is 1, the iterations are executed serially by the calling thread.
+template <typename F>
+void parallel_for(int begin, int end, int num_threads, F&& f) {
+    if (end <= begin) return;
+
+    if (effective_num_threads(num_threads) <= 1) {
+        for (int i = begin; i < end; ++i) {
+            f(i, 0);
+        }
+        return;
+    }
+
+    ThreadPool::shared(num_threads).parallel_for(begin, end, std::forward<F>(f));
+}
+
+}  // namespace util
+
+#endif  // PYBNESIAN_UTIL_PARALLEL_HPP
@@ -0,0 +1,70 @@
+#ifndef PYBNESIAN_UTIL_PHILOX_HPP
+#define PYBNESIAN_UTIL_PHILOX_HPP
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <util/math_constants.hpp>
+
+namespace util {
+
+// Philox4x32-10 counter-based random number generator (Salmon et al., 2011), with the same constants and streams as
+// philox_random() in KDE.cl.src. The random numbers of each sample index are computed from the index, so the samples
+// do not depend on the order in which the indices are generated, and a loop over the indices keeps no generator state.
+namespace philox {
+
+inline constexpr uint32_t M0 = 0xD2511F53;
+inline constexpr uint32_t M1 = 0xCD9E8D57;
+inline constexpr uint32_t W0 = 0x9E3779B9;
+inline constexpr uint32_t W1 = 0xBB67AE85;
+inline constexpr uint32_t KEY1 = 0x8A5CD789;
+
+// Independent streams of random numbers for the same sample index.
+inline constexpr uint32_t STREAM_UNIFORM = 0;
+inline constexpr uint32_t STREAM_NORMAL = 1;
+
+using Counter = std::array<uint32_t, 4>;
+
+inline Counter philox4x32_10(Counter ctr, uint32_t key0, uint32_t key1) {
+    for (int r = 0; r < 10; ++r) {
+        uint64_t p0 = static_cast<uint64_t>(M0) * ctr[0];
+        uint64_t p1 = static_cast<uint64_t>(M1) * ctr[2];
+        auto hi0 = static_cast<uint32_t>(p0 >> 32);
+        auto lo0 = static_cast<uint32_t>(p0);
+        auto hi1 = static_cast<uint32_t>(p1 >> 32);
+        auto lo1 = static_cast<uint32_t>(p1);
+        ctr = Counter{hi1 ^ ctr[1] ^ key0, lo1, hi0 ^ ctr[3] ^ key1, lo0};
+        key0 += W0;
+        key1 += W1;
+    }
+    return ctr;
+}
+
+inline Counter random(uint32_t index, uint32_t stream, uint32_t seed) {
+    return philox4x32_10(Counter{index, stream, 0, 0}, seed, KEY1);
+}
+
+// Uniform number in [0, 1) from two random words.
+inline double to_uniform(uint32_t a, uint32_t b) {
+    return static_cast<double>((static_cast<uint64_t>(a >> 6) << 27) | (b >> 5)) * 0x1.0p-53;
+}
+
+// Uniform number in [0, 1) of a sample index.
+inline double uniform(uint32_t index, uint32_t seed) {
+    auto r = random(index, STREAM_UNIFORM, seed);
+    return to_uniform(r[0], r[1]);
+}
+
+// Standard normal number of a sample index with the Box-Muller transform.
+inline double normal(uint32_t index, uint32_t seed) {
+    auto r = random(index, STREAM_NORMAL, seed);
+    double u1 = 1.0 - to_uniform(r[0], r[1]);
+    double u2 = to_uniform(r[2], r[3]);
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2 * util::pi<double> * u2);
+}
+
+}  // namespace philox
+
+}  // namespace util
+
+#endif  // PYBNESIAN_UTIL_PHILOX_HPP
@@ -0,0 +1,139 @@
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <util/profiler.hpp>
+
+namespace util {
+
+namespace {
+
+struct ProfilerCounters {
+    std::mutex mutex;
+    std::unordered_map<std::string, ProfileCounter> counters;
+    // Start of the trace. It is empty until the tracing is enabled.
+    std::optional<std::chrono::steady_clock::time_point> trace_origin;
+    std::vector<TraceSpan> spans;
+};
+
+ProfilerCounters& profiler_counters() {
+    static ProfilerCounters counters;
+    return counters;
+}
+
+// Small sequential ids for the threads, in the order they record their first span.
+int trace_thread_id() {
+    static std::atomic<int> next_id{0};
+    thread_local int id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+std::string escape_json(const std::string& s) {
+    std::string res;
+    res.reserve(s.size());
+    for (auto c : s) {
+        switch (c) {
+            case '"':
+                res += "\\\"";
+                break;
+            case '\\':
+                res += "\\\\";
+                break;
+            case '\n':
+                res += "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    res += buf;
+                } else {
+                    res += c;
+                }
+        }
+    }
+    return res;
+}
+
+}  // namespace
+
+std::atomic<bool> Profiler::s_enabled{false};
+std::atomic<bool> Profiler::s_tracing{false};
+
+void Profiler::add(const std::string& name, std::int64_t calls, double seconds, std::int64_t bytes) {
+    auto& p = profiler_counters();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    auto& counter = p.counters[name];
+    counter.calls += calls;
+    counter.seconds += seconds;
+    counter.bytes += bytes;
+}
+
+std::map<std::string, ProfileCounter> Profiler::stats() {
+    auto& p = profiler_counters();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    return std::map<std::string, ProfileCounter>(p.counters.begin(), p.counters.end());
+}
+
+void Profiler::reset() {
+    auto& p = profiler_counters();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.counters.clear();
+    p.spans.clear();
+    p.trace_origin.reset();
+    if (tracing()) p.trace_origin = std::chrono::steady_clock::now();
+}
+
+void Profiler::enable_tracing() {
+    auto& p = profiler_counters();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    if (!p.trace_origin) p.trace_origin = std::chrono::steady_clock::now();
+    s_tracing.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::add_span(std::string&& name,
+                        std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point end) {
+    auto thread = trace_thread_id();
+    auto& p = profiler_counters();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    // The spans that started before a reset() are discarded.
+    if (!p.trace_origin || start < *p.trace_origin) return;
+
+    std::chrono::duration<double, std::micro> offset = start - *p.trace_origin;
+    std::chrono::duration<double, std::micro> duration = end - start;
+    p.spans.push_back(TraceSpan{std::move(name), thread, offset.count(), duration.count()});
+}
+
+std::vector<TraceSpan> Profiler::trace() {
+    auto& p = profiler_counters();
+    std::lock_guard<std::mutex> lock(p.mutex);
+    return p.spans;
+}
+
+void Profiler::save_trace(const std::string& file_name) {
+    auto spans = trace();
+
+    std::ofstream file(file_name);
+    if (!file) throw std::invalid_argument("Could not open the file " + file_name + ".");
+
+    std::ostringstream out;
+    out.precision(3);
+    out << std::fixed << "{\"traceEvents\":[";
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const auto& span = spans[i];
+        auto category = span.name.substr(0, span.name.find(':'));
+        if (i > 0) out << ",";
+        out << "\n{\"name\":\"" << escape_json(span.name) << "\",\"cat\":\"" << escape_json(category)
+            << "\",\"ph\":\"X\",\"ts\":" << span.start << ",\"dur\":" << span.duration
+            << ",\"pid\":0,\"tid\":" << span.thread << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    file << out.str();
+}
+
+}  // namespace util
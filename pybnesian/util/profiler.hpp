@@ -0,0 +1,110 @@
+#ifndef PYBNESIAN_UTIL_PROFILER_HPP
+#define PYBNESIAN_UTIL_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace util {
+
+// Statistics of a profiler counter: the number of calls, the wall time (in seconds) and the bytes transferred. The wall
+// time and the bytes are 0 for the counters that only count events (e.g., the cache hits).
+struct ProfileCounter {
+    std::int64_t calls = 0;
+    double seconds = 0;
+    std::int64_t bytes = 0;
+};
+
+// A span of the trace: an instrumented scope executed by a thread. The times are in microseconds since the trace was
+// started (see Profiler::enable_tracing()).
+struct TraceSpan {
+    std::string name;
+    int thread;
+    double start;
+    double duration;
+};
+
+// A global profiler of the learning algorithms. It is disabled by default, and the instrumented code only checks an
+// atomic flag while it is disabled.
+//
+// The tracing is independent of the counters: it records a span for each instrumented scope, with the thread that
+// executed it, so the timeline of a learning run can be saved in the Chrome trace format (see save_trace()).
+class Profiler {
+public:
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void enable() { s_enabled.store(true, std::memory_order_relaxed); }
+    static void disable() { s_enabled.store(false, std::memory_order_relaxed); }
+
+    static void add(const std::string& name, std::int64_t calls, double seconds, std::int64_t bytes = 0);
+    static std::map<std::string, ProfileCounter> stats();
+    // Removes the counters and the spans of the trace.
+    static void reset();
+
+    static bool tracing() { return s_tracing.load(std::memory_order_relaxed); }
+    // The trace starts when the tracing is enabled for the first time after a reset().
+    static void enable_tracing();
+    static void disable_tracing() { s_tracing.store(false, std::memory_order_relaxed); }
+
+    static void add_span(std::string&& name,
+                         std::chrono::steady_clock::time_point start,
+                         std::chrono::steady_clock::time_point end);
+    static std::vector<TraceSpan> trace();
+    // Saves the spans in a JSON file with the Chrome trace event format, which can be opened with chrome://tracing or
+    // Perfetto. The category of each span is the prefix of its name before the first ':'.
+    static void save_trace(const std::string& file_name);
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<bool> s_tracing;
+};
+
+// Records the wall time of a scope (and the bytes transferred) in a profiler counter, and a span of the trace if the
+// tracing is enabled. name is a callable that returns the name of the counter. It is only called if the profiler or the
+// tracing are enabled, so the names of the disabled counters are never built.
+class ProfileScope {
+public:
+    template <typename F>
+    explicit ProfileScope(F&& name, std::int64_t calls = 1, std::int64_t bytes = 0)
+        : m_counted(Profiler::enabled()), m_traced(Profiler::tracing()), m_calls(calls), m_bytes(bytes) {
+        if (m_counted || m_traced) {
+            m_name = name();
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope() {
+        if (m_counted || m_traced) {
+            auto end = std::chrono::steady_clock::now();
+            if (m_counted) {
+                std::chrono::duration<double> elapsed = end - m_start;
+                Profiler::add(m_name, m_calls, elapsed.count(), m_bytes);
+            }
+
+            if (m_traced) Profiler::add_span(std::move(m_name), m_start, end);
+        }
+    }
+
+private:
+    bool m_counted;
+    bool m_traced;
+    std::int64_t m_calls;
+    std::int64_t m_bytes;
+    std::string m_name;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Counts calls (and bytes) in the profiler counter returned by name(), without recording any wall time.
+template <typename F>
+void profile_count(F&& name, std::int64_t calls = 1, std::int64_t bytes = 0) {
+    if (Profiler::enabled()) Profiler::add(name(), calls, 0, bytes);
+}
+
+}  // namespace util
+
+#endif  // PYBNESIAN_UTIL_PROFILER_HPP
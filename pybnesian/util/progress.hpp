@@ -1,10 +1,36 @@
 #ifndef PYBNESIAN_UTIL_PROGRESS_HPP
 #define PYBNESIAN_UTIL_PROGRESS_HPP
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <indicators/indicators.hpp>
 
 namespace util {
 
+// Limits the refreshes of the terminal to one every interval. It can be used from many threads.
+class RefreshLimiter {
+public:
+    static constexpr std::chrono::milliseconds interval{100};
+
+    RefreshLimiter() : m_last(never) {}
+
+    // Returns true if the terminal should be refreshed now.
+    bool ready() {
+        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+        auto last = m_last.load(std::memory_order_relaxed);
+        if (last != never && now - last < std::chrono::nanoseconds(interval).count()) return false;
+        return m_last.compare_exchange_strong(last, now, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int64_t never = std::numeric_limits<int64_t>::min();
+    std::atomic<int64_t> m_last;
+};
+
 class BaseIndeterminateSpinner {
 public:
     virtual ~BaseIndeterminateSpinner() {}
@@ -14,6 +40,15 @@ public:
     virtual void mark_as_completed(const std::string& s) = 0;
     virtual void mark_as_completed(std::string&& s) = 0;
     virtual void mark_as_completed() = 0;
+    // Returns true if the status is displayed now. The spinners refresh the terminal at most once every
+    // RefreshLimiter::interval.
+    virtual bool refresh() = 0;
+
+    // Updates the status with make_status() only if the terminal is refreshed, so the status is not built otherwise.
+    template <typename F>
+    void lazy_update_status(F&& make_status) {
+        if (refresh()) update_status(make_status());
+    }
 };
 
 class VoidProgressSpinner : public BaseIndeterminateSpinner {
@@ -23,6 +58,7 @@ public:
     void update_status(const std::string&) override {}
     void update_status(std::string&&) override {}
     void update_status() override {}
+    bool refresh() override { return false; }
     void mark_as_completed(const std::string&) override {}
     void mark_as_completed(std::string&&) override {}
     void mark_as_completed() override {}
@@ -61,8 +97,11 @@ public:
 
     void mark_as_completed() override { m_spinner.mark_as_completed(); }
 
+    bool refresh() override { return m_limiter.ready(); }
+
 private:
     indicators::ProgressSpinner m_spinner;
+    RefreshLimiter m_limiter;
 };
 
 template <typename... Args>
@@ -95,6 +134,15 @@ public:
     virtual void mark_as_completed() = 0;
     virtual void clean_terminal() = 0;
     virtual int verbose_level() = 0;
+    // Returns true if the text is displayed now. The progress bars refresh the text at most once every
+    // RefreshLimiter::interval.
+    virtual bool refresh_text() = 0;
+
+    // Sets the text to make_text() only if the text is refreshed, so the text is not built otherwise.
+    template <typename F>
+    void lazy_set_text(F&& make_text) {
+        if (refresh_text()) set_text(make_text());
+    }
 };
 
 class VoidProgressBar : public BaseProgressBar {
@@ -111,6 +159,7 @@ public:
     void mark_as_completed() override {}
     void clean_terminal() override {}
     int verbose_level() override { return 0; }
+    bool refresh_text() override { return false; }
 };
 
 class ProgressBar : public BaseProgressBar {
@@ -120,7 +169,8 @@ public:
                 indicators::option::Start{"["},
                 indicators::option::End{"]"},
                 indicators::option::ShowElapsedTime{true},
-                indicators::option::ForegroundColor{indicators::Color::white}) {}
+                indicators::option::ForegroundColor{indicators::Color::white}),
+          m_progress(0) {}
 
     ProgressBar(int max_progress)
         : m_bar(indicators::option::BarWidth{40},
@@ -128,10 +178,11 @@ public:
                 indicators::option::End{"]"},
                 indicators::option::ShowElapsedTime{true},
                 indicators::option::ForegroundColor{indicators::Color::white},
-                indicators::option::MaxProgress{max_progress}) {}
+                indicators::option::MaxProgress{max_progress}),
+          m_progress(0) {}
 
     template <typename... Args>
-    ProgressBar(Args&&... args) : m_bar(args...) {}
+    ProgressBar(Args&&... args) : m_bar(args...), m_progress(0) {}
 
     void set_text(const std::string& s) override { m_bar.set_option(indicators::option::PostfixText{s}); }
 
@@ -141,11 +192,18 @@ public:
         m_bar.set_option(indicators::option::MaxProgress{max_progress});
     }
 
-    void add_progress(int progress) override { m_bar.set_progress(m_bar.current() + progress); }
+    void add_progress(int progress) override { m_bar.set_progress(m_progress += progress); }
 
-    void set_progress(int progress) override { m_bar.set_progress(progress); }
+    void set_progress(int progress) override {
+        m_progress = progress;
+        m_bar.set_progress(progress);
+    }
 
-    void tick() override { m_bar.tick(); }
+    // The ticks can be called from many threads. The bar is only redrawn once every RefreshLimiter::interval.
+    void tick() override {
+        auto progress = ++m_progress;
+        if (m_tick_limiter.ready()) m_bar.set_progress(progress);
+    }
 
     void mark_as_completed(const std::string& s) override {
         m_bar.set_option(indicators::option::PrefixText{"✔  "});
@@ -156,14 +214,23 @@ public:
 
     void mark_as_completed(std::string&& s) override { mark_as_completed(s); }
 
-    void mark_as_completed() override { m_bar.mark_as_completed(); }
+    void mark_as_completed() override {
+        m_bar.set_progress(m_progress);
+        m_bar.mark_as_completed();
+    }
 
     void clean_terminal() override { std::cout << std::string(indicators::terminal_width(), ' ') << "\r"; }
 
     int verbose_level() override { return 1; };
 
+    bool refresh_text() override { return m_text_limiter.ready(); }
+
 private:
     indicators::BlockProgressBar m_bar;
+    // The current progress. The bar can display an older progress until it is redrawn.
+    std::atomic<int> m_progress;
+    RefreshLimiter m_tick_limiter;
+    RefreshLimiter m_text_limiter;
 };
 
 template <typename... Args>
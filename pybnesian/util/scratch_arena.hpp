@@ -0,0 +1,131 @@
+#ifndef PYBNESIAN_UTIL_SCRATCH_ARENA_HPP
+#define PYBNESIAN_UTIL_SCRATCH_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <Eigen/Dense>
+
+namespace util {
+
+// A per-thread bump allocator for the temporaries of a local score evaluation (centered columns, residuals, ...). The
+// memory is released in LIFO order with ScratchScope, and the blocks are kept by the thread, so the evaluations after
+// the first one do not call malloc/free. When the outermost scope ends and the arena had to grow in more than one
+// block, the blocks are merged into one with the total size.
+//
+// The memory is not initialized, and the destructors of the allocated objects are not called: only trivially
+// destructible scalar types should be allocated.
+class ScratchArena {
+public:
+    static constexpr size_t alignment = 64;
+    static constexpr size_t min_block_size = 1 << 20;
+
+    struct Mark {
+        size_t block;
+        size_t offset;
+    };
+
+    static ScratchArena& get() {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    template <typename T>
+    T* allocate(size_t n) {
+        static_assert(std::is_trivially_destructible_v<T>, "Only trivially destructible types can be allocated.");
+        return static_cast<T*>(allocate_bytes(n * sizeof(T)));
+    }
+
+    // Returns a vector of n (uninitialized) values.
+    template <typename T>
+    Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>, Eigen::Aligned64> vector(Eigen::Index n) {
+        return Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>, Eigen::Aligned64>(allocate<T>(n), n);
+    }
+
+    Mark mark() const { return Mark{m_current, m_offset}; }
+
+    void rewind(const Mark& m) {
+        m_current = m.block;
+        m_offset = m.offset;
+
+        if (m_current == 0 && m_offset == 0 && m_blocks.size() > 1) {
+            size_t total = 0;
+            for (const auto& b : m_blocks) {
+                total += b.size;
+            }
+
+            m_blocks.clear();
+            add_block(total);
+        }
+    }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for (const auto& b : m_blocks) {
+            total += b.size;
+        }
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    ScratchArena() : m_blocks(), m_current(0), m_offset(0) {}
+
+    void add_block(size_t size) {
+        m_blocks.push_back(Block{std::make_unique<std::byte[]>(size + alignment), size});
+    }
+
+    std::byte* aligned_data(size_t block) const {
+        auto address = reinterpret_cast<uintptr_t>(m_blocks[block].data.get());
+        return m_blocks[block].data.get() + ((alignment - address % alignment) % alignment);
+    }
+
+    void* allocate_bytes(size_t bytes) {
+        bytes = (bytes + alignment - 1) / alignment * alignment;
+
+        // Skips the blocks without enough free space. The skipped space is recovered when the blocks are merged.
+        while (m_current < m_blocks.size() && m_offset + bytes > m_blocks[m_current].size) {
+            ++m_current;
+            m_offset = 0;
+        }
+
+        if (m_current == m_blocks.size()) {
+            auto last = m_blocks.empty() ? min_block_size / 2 : m_blocks.back().size;
+            add_block(std::max(2 * last, bytes));
+        }
+
+        auto ptr = aligned_data(m_current) + m_offset;
+        m_offset += bytes;
+        return ptr;
+    }
+
+    std::vector<Block> m_blocks;
+    size_t m_current;
+    size_t m_offset;
+};
+
+// Releases the memory allocated in the ScratchArena of the thread during the lifetime of the scope.
+class ScratchScope {
+public:
+    ScratchScope() : m_arena(ScratchArena::get()), m_mark(m_arena.mark()) {}
+    ~ScratchScope() { m_arena.rewind(m_mark); }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+    ScratchArena& arena() { return m_arena; }
+
+private:
+    ScratchArena& m_arena;
+    ScratchArena::Mark m_mark;
+};
+
+}  // namespace util
+
+#endif  // PYBNESIAN_UTIL_SCRATCH_ARENA_HPP
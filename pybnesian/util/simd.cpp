@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <Eigen/Dense>
+#include <util/simd.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PYBNESIAN_SIMD_DISPATCH 1
+#include <immintrin.h>
+#define PYBNESIAN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define PYBNESIAN_TARGET_AVX512 __attribute__((target("avx512f")))
+// GCC contracts the multiplications and additions of the intrinsics in FMA instructions, which would change the results
+// of the distance kernels. The FMA instructions of the dot products are explicit.
+#if !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+#else
+#define PYBNESIAN_SIMD_DISPATCH 0
+#endif
+
+using Eigen::Map, Eigen::Matrix, Eigen::Dynamic;
+
+namespace util::simd {
+
+namespace {
+
+// The same as dataset::reduction_block_size.
+constexpr size_t dot_block_size = 256;
+
+InstructionSet cpu_instruction_set() {
+#if PYBNESIAN_SIMD_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return InstructionSet::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return InstructionSet::AVX2;
+#endif
+    return InstructionSet::Generic;
+}
+
+std::atomic<int> s_max_instruction_set{static_cast<int>(InstructionSet::AVX512)};
+
+// ////////////////////////////// Generic kernels //////////////////////////////
+// The generic kernels compute the same operations as the Eigen expressions they replace, so the results do not change
+// when the CPU does not support the other instruction sets.
+template <typename T>
+double dot_generic(const T* a, const T* b, size_t n) {
+    using VectorType = Map<const Matrix<T, Dynamic, 1>>;
+    if constexpr (std::is_same_v<T, double>) {
+        return VectorType(a, n).dot(VectorType(b, n));
+    } else {
+        double res = 0;
+        for (size_t i = 0; i < n; i += dot_block_size) {
+            auto length = std::min(dot_block_size, n - i);
+            res += static_cast<double>(VectorType(a + i, length).dot(VectorType(b + i, length)));
+        }
+        return res;
+    }
+}
+
+template <typename T>
+void add_squared_differences_generic(const T* x, T value, size_t n, T* d) {
+    for (size_t i = 0; i < n; ++i) {
+        auto diff = x[i] - value;
+        d[i] += diff * diff;
+    }
+}
+
+template <typename T>
+void add_abs_differences_generic(const T* x, T value, size_t n, T* d) {
+    for (size_t i = 0; i < n; ++i) {
+        d[i] += std::abs(x[i] - value);
+    }
+}
+
+template <typename IndexType>
+void accumulate_strided_generic(const IndexType* indices, int length, int stride, int* block) {
+    for (int k = 0; k < length; ++k) {
+        block[k] += static_cast<int>(indices[k]) * stride;
+    }
+}
+
+#if PYBNESIAN_SIMD_DISPATCH
+// ////////////////////////////// AVX2 kernels //////////////////////////////
+// The distance kernels do not use FMA, so their results are the same as the generic kernels.
+PYBNESIAN_TARGET_AVX2 double hsum_avx2(__m256d v) {
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+PYBNESIAN_TARGET_AVX2 float hsum_avx2(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    return _mm_cvtss_f32(_mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1)));
+}
+
+PYBNESIAN_TARGET_AVX2 double dot_avx2(const double* a, const double* b, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+    }
+
+    double res = hsum_avx2(_mm256_add_pd(acc0, acc1));
+    for (; i < n; ++i) res += a[i] * b[i];
+    return res;
+}
+
+PYBNESIAN_TARGET_AVX2 double dot_avx2(const float* a, const float* b, size_t n) {
+    double res = 0;
+    for (size_t begin = 0; begin < n; begin += dot_block_size) {
+        auto end = std::min(n, begin + dot_block_size);
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        size_t i = begin;
+        for (; i + 16 <= end; i += 16) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        }
+
+        float block = hsum_avx2(_mm256_add_ps(acc0, acc1));
+        for (; i < end; ++i) block += a[i] * b[i];
+        res += static_cast<double>(block);
+    }
+
+    return res;
+}
+
+PYBNESIAN_TARGET_AVX2 void add_squared_differences_avx2(const double* x, double value, size_t n, double* d) {
+    __m256d v = _mm256_set1_pd(value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(x + i), v);
+        _mm256_storeu_pd(d + i, _mm256_add_pd(_mm256_loadu_pd(d + i), _mm256_mul_pd(diff, diff)));
+    }
+
+    add_squared_differences_generic(x + i, value, n - i, d + i);
+}
+
+PYBNESIAN_TARGET_AVX2 void add_squared_differences_avx2(const float* x, float value, size_t n, float* d) {
+    __m256 v = _mm256_set1_ps(value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(x + i), v);
+        _mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_mul_ps(diff, diff)));
+    }
+
+    add_squared_differences_generic(x + i, value, n - i, d + i);
+}
+
+PYBNESIAN_TARGET_AVX2 void add_abs_differences_avx2(const double* x, double value, size_t n, double* d) {
+    __m256d v = _mm256_set1_pd(value);
+    __m256d sign = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d diff = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(x + i), v));
+        _mm256_storeu_pd(d + i, _mm256_add_pd(_mm256_loadu_pd(d + i), diff));
+    }
+
+    add_abs_differences_generic(x + i, value, n - i, d + i);
+}
+
+PYBNESIAN_TARGET_AVX2 void add_abs_differences_avx2(const float* x, float value, size_t n, float* d) {
+    __m256 v = _mm256_set1_ps(value);
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 diff = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(x + i), v));
+        _mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), diff));
+    }
+
+    add_abs_differences_generic(x + i, value, n - i, d + i);
+}
+
+// Loads 8 indices as 32-bit integers.
+PYBNESIAN_TARGET_AVX2 __m256i load_indices_avx2(const int8_t* indices) {
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices)));
+}
+
+PYBNESIAN_TARGET_AVX2 __m256i load_indices_avx2(const int16_t* indices) {
+    return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices)));
+}
+
+PYBNESIAN_TARGET_AVX2 __m256i load_indices_avx2(const int32_t* indices) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+}
+
+template <typename IndexType>
+PYBNESIAN_TARGET_AVX2 void accumulate_strided_avx2(const IndexType* indices, int length, int stride, int* block) {
+    __m256i s = _mm256_set1_epi32(stride);
+    int k = 0;
+    for (; k + 8 <= length; k += 8) {
+        auto* b = reinterpret_cast<__m256i*>(block + k);
+        __m256i products = _mm256_mullo_epi32(load_indices_avx2(indices + k), s);
+        _mm256_storeu_si256(b, _mm256_add_epi32(_mm256_loadu_si256(b), products));
+    }
+
+    accumulate_strided_generic(indices + k, length - k, stride, block + k);
+}
+
+// ////////////////////////////// AVX-512 kernels //////////////////////////////
+PYBNESIAN_TARGET_AVX512 double dot_avx512(const double* a, const double* b, size_t n) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), acc1);
+    }
+
+    double res = _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+    for (; i < n; ++i) res += a[i] * b[i];
+    return res;
+}
+
+PYBNESIAN_TARGET_AVX512 double dot_avx512(const float* a, const float* b, size_t n) {
+    double res = 0;
+    for (size_t begin = 0; begin < n; begin += dot_block_size) {
+        auto end = std::min(n, begin + dot_block_size);
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        size_t i = begin;
+        for (; i + 32 <= end; i += 32) {
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+        }
+
+        float block = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+        for (; i < end; ++i) block += a[i] * b[i];
+        res += static_cast<double>(block);
+    }
+
+    return res;
+}
+
+PYBNESIAN_TARGET_AVX512 void add_squared_differences_avx512(const double* x, double value, size_t n, double* d) {
+    __m512d v = _mm512_set1_pd(value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(x + i), v);
+        _mm512_storeu_pd(d + i, _mm512_add_pd(_mm512_loadu_pd(d + i), _mm512_mul_pd(diff, diff)));
+    }
+
+    add_squared_differences_generic(x + i, value, n - i, d + i);
+}
+
+PYBNESIAN_TARGET_AVX512 void add_squared_differences_avx512(const float* x, float value, size_t n, float* d) {
+    __m512 v = _mm512_set1_ps(value);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(x + i), v);
+        _mm512_storeu_ps(d + i, _mm512_add_ps(_mm512_loadu_ps(d + i), _mm512_mul_ps(diff, diff)));
+    }
+
+    add_squared_differences_generic(x + i, value, n - i, d + i);
+}
+
+PYBNESIAN_TARGET_AVX512 void add_abs_differences_avx512(const double* x, double value, size_t n, double* d) {
+    __m512d v = _mm512_set1_pd(value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d diff = _mm512_abs_pd(_mm512_sub_pd(_mm512_loadu_pd(x + i), v));
+        _mm512_storeu_pd(d + i, _mm512_add_pd(_mm512_loadu_pd(d + i), diff));
+    }
+
+    add_abs_differences_generic(x + i, value, n - i, d + i);
+}
+
+PYBNESIAN_TARGET_AVX512 void add_abs_differences_avx512(const float* x, float value, size_t n, float* d) {
+    __m512 v = _mm512_set1_ps(value);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 diff = _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(x + i), v));
+        _mm512_storeu_ps(d + i, _mm512_add_ps(_mm512_loadu_ps(d + i), diff));
+    }
+
+    add_abs_differences_generic(x + i, value, n - i, d + i);
+}
+
+// Loads 16 indices as 32-bit integers.
+PYBNESIAN_TARGET_AVX512 __m512i load_indices_avx512(const int8_t* indices) {
+    return _mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices)));
+}
+
+PYBNESIAN_TARGET_AVX512 __m512i load_indices_avx512(const int16_t* indices) {
+    return _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)));
+}
+
+PYBNESIAN_TARGET_AVX512 __m512i load_indices_avx512(const int32_t* indices) { return _mm512_loadu_si512(indices); }
+
+template <typename IndexType>
+PYBNESIAN_TARGET_AVX512 void accumulate_strided_avx512(const IndexType* indices, int length, int stride, int* block) {
+    __m512i s = _mm512_set1_epi32(stride);
+    int k = 0;
+    for (; k + 16 <= length; k += 16) {
+        __m512i products = _mm512_mullo_epi32(load_indices_avx512(indices + k), s);
+        _mm512_storeu_si512(block + k, _mm512_add_epi32(_mm512_loadu_si512(block + k), products));
+    }
+
+    accumulate_strided_generic(indices + k, length - k, stride, block + k);
+}
+#endif
+
+}  // namespace
+
+InstructionSet instruction_set() {
+    static const InstructionSet cpu = cpu_instruction_set();
+    return static_cast<InstructionSet>(std::min(static_cast<int>(cpu), s_max_instruction_set.load()));
+}
+
+void set_max_instruction_set(InstructionSet max) { s_max_instruction_set = static_cast<int>(max); }
+
+InstructionSet max_instruction_set() { return static_cast<InstructionSet>(s_max_instruction_set.load()); }
+
+std::string instruction_set_name(InstructionSet set) {
+    switch (set) {
+        case InstructionSet::Generic:
+            return "generic";
+        case InstructionSet::AVX2:
+            return "avx2";
+        case InstructionSet::AVX512:
+            return "avx512";
+        default:
+            throw std::invalid_argument("Wrong instruction set.");
+    }
+}
+
+InstructionSet instruction_set_from_name(const std::string& name) {
+    if (name == "generic") return InstructionSet::Generic;
+    if (name == "avx2") return InstructionSet::AVX2;
+    if (name == "avx512") return InstructionSet::AVX512;
+
+    throw std::invalid_argument("Wrong instruction set \"" + name + "\". The instruction sets are \"generic\", "
+                                "\"avx2\" and \"avx512\".");
+}
+
+#if PYBNESIAN_SIMD_DISPATCH
+#define PYBNESIAN_DISPATCH(kernel, ...)                 \
+    switch (instruction_set()) {                        \
+        case InstructionSet::AVX512:                    \
+            return kernel##_avx512(__VA_ARGS__);        \
+        case InstructionSet::AVX2:                      \
+            return kernel##_avx2(__VA_ARGS__);          \
+        default:                                        \
+            return kernel##_generic(__VA_ARGS__);       \
+    }
+#else
+#define PYBNESIAN_DISPATCH(kernel, ...) return kernel##_generic(__VA_ARGS__);
+#endif
+
+double dot(const double* a, const double* b, size_t n) { PYBNESIAN_DISPATCH(dot, a, b, n) }
+double dot(const float* a, const float* b, size_t n) { PYBNESIAN_DISPATCH(dot, a, b, n) }
+
+void add_squared_differences(const double* x, double value, size_t n, double* d) {
+    PYBNESIAN_DISPATCH(add_squared_differences, x, value, n, d)
+}
+void add_squared_differences(const float* x, float value, size_t n, float* d) {
+    PYBNESIAN_DISPATCH(add_squared_differences, x, value, n, d)
+}
+
+void add_abs_differences(const double* x, double value, size_t n, double* d) {
+    PYBNESIAN_DISPATCH(add_abs_differences, x, value, n, d)
+}
+void add_abs_differences(const float* x, float value, size_t n, float* d) {
+    PYBNESIAN_DISPATCH(add_abs_differences, x, value, n, d)
+}
+
+void accumulate_strided(const int8_t* indices, int length, int stride, int* block) {
+    PYBNESIAN_DISPATCH(accumulate_strided, indices, length, stride, block)
+}
+void accumulate_strided(const int16_t* indices, int length, int stride, int* block) {
+    PYBNESIAN_DISPATCH(accumulate_strided, indices, length, stride, block)
+}
+void accumulate_strided(const int32_t* indices, int length, int stride, int* block) {
+    PYBNESIAN_DISPATCH(accumulate_strided, indices, length, stride, block)
+}
+// The 64-bit indices do not have vectorized kernels.
+void accumulate_strided(const int64_t* indices, int length, int stride, int* block) {
+    accumulate_strided_generic(indices, length, stride, block);
+}
+
+}  // namespace util::simd
@@ -0,0 +1,46 @@
+#ifndef PYBNESIAN_UTIL_SIMD_HPP
+#define PYBNESIAN_UTIL_SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace util::simd {
+
+// The instruction sets of the CPU kernels, from the least to the most capable. The extension is compiled with generic
+// flags, so the kernels of each instruction set are compiled separately (with the target attribute of GCC and Clang)
+// and chosen at runtime from the features of the CPU. The other compilers and architectures only use Generic.
+enum class InstructionSet { Generic = 0, AVX2 = 1, AVX512 = 2 };
+
+// Returns the instruction set used by the kernels: the most capable one supported by the CPU, limited by
+// set_max_instruction_set().
+InstructionSet instruction_set();
+// Limits the instruction set of the kernels (e.g., to compare the results of the generic kernels). The CPU features are
+// still checked, so a larger limit than the supported instruction set has no effect.
+void set_max_instruction_set(InstructionSet max);
+InstructionSet max_instruction_set();
+
+std::string instruction_set_name(InstructionSet set);
+InstructionSet instruction_set_from_name(const std::string& name);
+
+// Returns the dot product of a and b, of n elements. The float products are summed in blocks of reduction_block_size
+// values, and the blocks are accumulated in double (see dataset::accurate_dot()).
+double dot(const double* a, const double* b, size_t n);
+double dot(const float* a, const float* b, size_t n);
+
+// d[i] += (x[i] - value)^2 for i in [0, n).
+void add_squared_differences(const double* x, double value, size_t n, double* d);
+void add_squared_differences(const float* x, float value, size_t n, float* d);
+// d[i] += |x[i] - value| for i in [0, n).
+void add_abs_differences(const double* x, double value, size_t n, double* d);
+void add_abs_differences(const float* x, float value, size_t n, float* d);
+
+// block[k] += indices[k] * stride for k in [0, length).
+void accumulate_strided(const int8_t* indices, int length, int stride, int* block);
+void accumulate_strided(const int16_t* indices, int length, int stride, int* block);
+void accumulate_strided(const int32_t* indices, int length, int stride, int* block);
+void accumulate_strided(const int64_t* indices, int length, int stride, int* block);
+
+}  // namespace util::simd
+
+#endif  // PYBNESIAN_UTIL_SIMD_HPP
@@ -119,6 +119,7 @@ ext_modules = [
          'pybnesian/pybindings/pybindings_factors.cpp',
          'pybnesian/pybindings/pybindings_graph.cpp',
          'pybnesian/pybindings/pybindings_models.cpp',
+         'pybnesian/pybindings/pybindings_inference.cpp',
          'pybnesian/pybindings/pybindings_learning/pybindings_learning.cpp',
          'pybnesian/pybindings/pybindings_learning/pybindings_scores.cpp',
          'pybnesian/pybindings/pybindings_learning/pybindings_independences.cpp',
@@ -129,14 +130,23 @@ ext_modules = [
          'pybnesian/kde/KDE.cpp',
          'pybnesian/kde/ProductKDE.cpp',
          'pybnesian/kde/UCV.cpp',
+         'pybnesian/kde/BinnedGrid.cpp',
          'pybnesian/factors/continuous/LinearGaussianCPD.cpp',
          'pybnesian/factors/continuous/CKDE.cpp',
          'pybnesian/factors/discrete/DiscreteFactor.cpp',
          'pybnesian/factors/discrete/discrete_indices.cpp',
+         'pybnesian/factors/discrete/discrete_columns.cpp',
+         'pybnesian/factors/discrete/joint_counts_cache.cpp',
+         'pybnesian/factors/discrete/bit_sliced_index.cpp',
          'pybnesian/dataset/dataset.cpp',
          'pybnesian/dataset/dynamic_dataset.cpp',
          'pybnesian/dataset/crossvalidation_adaptator.cpp',
          'pybnesian/dataset/holdout_adaptator.cpp',
+         'pybnesian/dataset/missing_patterns.cpp',
+         'pybnesian/dataset/covariance_registry.cpp',
+         'pybnesian/dataset/derived_columns.cpp',
+         'pybnesian/dataset/chunked_dataframe.cpp',
+         'pybnesian/dataset/shared_dataframe.cpp',
          'pybnesian/util/bit_util.cpp',
          'pybnesian/util/validate_options.cpp',
          'pybnesian/util/validate_whitelists.cpp',
@@ -145,13 +155,25 @@ ext_modules = [
          'pybnesian/util/vech_ops.cpp',
          'pybnesian/util/pickle.cpp',
          'pybnesian/util/util_types.cpp',
+         'pybnesian/util/profiler.cpp',
+         'pybnesian/util/binary_io.cpp',
+         'pybnesian/util/simd.cpp',
          'pybnesian/kdtree/kdtree.cpp',
          'pybnesian/learning/operators/operators.cpp',
+         'pybnesian/learning/algorithms/callbacks/save_operators.cpp',
+         'pybnesian/learning/algorithms/checkpoint.cpp',
          'pybnesian/learning/algorithms/hillclimbing.cpp',
          'pybnesian/learning/algorithms/pc.cpp',
          'pybnesian/learning/algorithms/mmpc.cpp',
          'pybnesian/learning/algorithms/mmhc.cpp',
          'pybnesian/learning/algorithms/dmmhc.cpp',
+         'pybnesian/learning/algorithms/ges.cpp',
+         'pybnesian/learning/algorithms/exact_search.cpp',
+         'pybnesian/learning/algorithms/order_search.cpp',
+         'pybnesian/learning/algorithms/candidate_parents.cpp',
+         'pybnesian/learning/algorithms/async_learning.cpp',
+         'pybnesian/learning/independences/cached_independence.cpp',
+         'pybnesian/learning/independences/distributed_independence.cpp',
          'pybnesian/learning/independences/continuous/linearcorrelation.cpp',
          'pybnesian/learning/independences/continuous/mutual_information.cpp',
          'pybnesian/learning/independences/continuous/RCoT.cpp',
@@ -159,11 +181,14 @@ ext_modules = [
          'pybnesian/learning/independences/hybrid/mutual_information.cpp',
          'pybnesian/learning/parameters/mle_LinearGaussianCPD.cpp',
          'pybnesian/learning/parameters/mle_DiscreteFactor.cpp',
+         'pybnesian/learning/parameters/mle_fused.cpp',
          'pybnesian/learning/scores/bic.cpp',
          'pybnesian/learning/scores/bge.cpp',
          'pybnesian/learning/scores/bde.cpp',
          'pybnesian/learning/scores/cv_likelihood.cpp',
          'pybnesian/learning/scores/holdout_likelihood.cpp',
+         'pybnesian/learning/scores/gaussian_statistics.cpp',
+         'pybnesian/learning/scores/distributed_score.cpp',
          'pybnesian/graph/generic_graph.cpp',
          'pybnesian/models/BayesianNetwork.cpp',
          'pybnesian/models/GaussianNetwork.cpp',
@@ -174,6 +199,13 @@ ext_modules = [
          'pybnesian/models/HeterogeneousBN.cpp',
          'pybnesian/models/CLGNetwork.cpp',
          'pybnesian/models/DynamicBayesianNetwork.cpp',
+         'pybnesian/models/binary_models.cpp',
+         'pybnesian/models/LoglPlan.cpp',
+         'pybnesian/models/EnsembleLogl.cpp',
+         'pybnesian/models/CrossValidatedLogl.cpp',
+         'pybnesian/inference/DiscreteInference.cpp',
+         'pybnesian/inference/GaussianInference.cpp',
+         'pybnesian/inference/ImportanceSampling.cpp',
          'pybnesian/opencl/opencl_config.cpp'
          ],
         language='c++',
@@ -225,6 +257,7 @@ class BuildExt(build_ext):
                     "/external:I" + os.path.join(os.path.dirname(self.build_temp), 'nlopt', 'include'),
                     "-DNOGDI"],
             'unix': ["-std=c++17",
+                    "-pthread",
                     "-isystem" + pa.get_include(),
                     "-isystem" + np.get_include(),
                     "-isystemlib/eigen-3.3.7",
@@ -238,7 +271,7 @@ class BuildExt(build_ext):
 
         l_opts = {
             'msvc': [],
-            'unix': [],
+            'unix': ["-pthread"],
         }
 
         if sys.platform == 'darwin':
@@ -301,7 +334,11 @@ class BuildExt(build_ext):
     def expand_sources(self):
         import conv_template
 
-        sources = ['pybnesian/kde/opencl_kernels/KDE.cl.src']
+        sources = ['pybnesian/kde/opencl_kernels/KDE.cl.src',
+                   'pybnesian/kde/opencl_kernels/RCoT.cl.src',
+                   'pybnesian/kde/opencl_kernels/LinearCorrelation.cl.src',
+                   'pybnesian/kde/opencl_kernels/LinearGaussian.cl.src',
+                   'pybnesian/kde/opencl_kernels/KMutualInformation.cl.src']
         
         for source in sources:
             (base, _) = os.path.splitext(source)
@@ -310,7 +347,11 @@ class BuildExt(build_ext):
                 fid.write(outstr)
 
     def copy_opencl_code(self):
-        sources = ['pybnesian/kde/opencl_kernels/KDE.cl']
+        sources = ['pybnesian/kde/opencl_kernels/KDE.cl',
+                   'pybnesian/kde/opencl_kernels/RCoT.cl',
+                   'pybnesian/kde/opencl_kernels/LinearCorrelation.cl',
+                   'pybnesian/kde/opencl_kernels/LinearGaussian.cl',
+                   'pybnesian/kde/opencl_kernels/KMutualInformation.cl']
 
         # Split the CPP code because the MSVC only allow strings of a max size.
         # Error C2026: https://docs.microsoft.com/en-us/cpp/error-messages/compiler-errors-1/compiler-error-c2026?view=msvc-160
@@ -463,6 +504,44 @@ namespace opencl {
                 shutil.copyfile(pa.get_library_dirs()[0] + '/' + lib + '.dll',
                                 path_to_build_folder() + '/' + lib + '.dll')
 
+class Benchmark(setuptools.Command):
+    """Builds the extension in place and runs the benchmarks in the benchmarks folder."""
+
+    description = "run the benchmarks and write their JSON report"
+    user_options = [
+        ('suite=', None, "benchmark suite to run (default: micro)"),
+        ('output=', None, "file of the JSON report (default: <suite>_benchmarks.json)"),
+        ('quick', None, "run the small sizes only"),
+    ]
+    boolean_options = ['quick']
+
+    def initialize_options(self):
+        self.suite = 'micro'
+        self.output = None
+        self.quick = False
+
+    def finalize_options(self):
+        if self.output is None:
+            self.output = self.suite + '_benchmarks.json'
+
+    def run(self):
+        # build_ext links the libraries of build_clib, but it does not build them.
+        self.run_command('build_clib')
+        self.reinitialize_command('build_ext', inplace=1)
+        self.run_command('build_ext')
+
+        script = os.path.join('benchmarks', self.suite + '_benchmarks.py')
+        if not os.path.exists(script):
+            raise RuntimeError("Benchmark suite not found: " + script)
+
+        args = [sys.executable, script, '--output', self.output]
+        if self.quick:
+            args.append('--quick')
+
+        env = dict(os.environ)
+        env['PYTHONPATH'] = os.pathsep.join([os.getcwd()] + ([env['PYTHONPATH']] if 'PYTHONPATH' in env else []))
+        subprocess.check_call(args, env=env)
+
 
 with open("README.md", "r", encoding="utf-8") as fh:
     long_description = fh.read()
@@ -489,7 +568,7 @@ setup(
     libraries=ext_libraries,
     setup_requires=['pybind11>=2.6', 'pyarrow>=3.0', "numpy"],
     install_requires=['pybind11>=2.6', 'pyarrow>=3.0', "numpy"],
-    cmdclass={'build_clib': Build_CMakeExternalLibrary, 'build_ext': BuildExt},
+    cmdclass={'build_clib': Build_CMakeExternalLibrary, 'build_ext': BuildExt, 'benchmark': Benchmark},
     license="MIT",
     zip_safe=False,
 )
\ No newline at end of file
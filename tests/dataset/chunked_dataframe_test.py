@@ -0,0 +1,118 @@
+import numpy as np
+import pandas as pd
+import pyarrow as pa
+import pytest
+import pybnesian as pbn
+
+import util_test
+
+SIZE = 10000
+
+df = util_test.generate_normal_data(SIZE)
+discrete_df = util_test.generate_discrete_data_dependent(SIZE)
+
+def chunked(values, chunksize):
+    return pa.chunked_array([values[i:i + chunksize] for i in range(0, len(values), chunksize)])
+
+def test_chunked_batches():
+    table = pa.Table.from_pandas(df, preserve_index=False).combine_chunks()
+    table = pa.table({"a": chunked(table.column("a").combine_chunks(), 1000),
+                      "b": chunked(table.column("b").combine_chunks(), 3000),
+                      "c": table.column("c")})
+    cdf = pbn.ChunkedDataFrame(table)
+
+    assert cdf.num_rows() == SIZE
+    assert cdf.num_columns() == 3
+    assert cdf.column_names() == ["a", "b", "c"]
+    # The batches end at the boundaries of the chunks of every column.
+    assert cdf.num_batches() == 10
+    assert sum(cdf.batch(i).num_rows for i in range(cdf.num_batches())) == SIZE
+    assert cdf.combine().to_pandas().equals(df[["a", "b", "c"]])
+
+    with pytest.raises(ValueError) as ex:
+        cdf.batch(10)
+    assert "do not exist" in str(ex.value)
+
+def test_chunked_moments():
+    columns = ["a", "b", "c", "d"]
+    table = pa.Table.from_pandas(df, preserve_index=False)
+    table = pa.table({c: chunked(table.column(c).combine_chunks(), 700) for c in columns})
+    cdf = pbn.ChunkedDataFrame(table)
+
+    assert np.allclose(cdf.means(columns), df[columns].mean().to_numpy())
+    assert np.allclose(cdf.cov(columns), df[columns].cov().to_numpy())
+    centered = df[columns].to_numpy() - df[columns].mean().to_numpy()
+    assert np.allclose(cdf.sse(columns), centered.T @ centered)
+
+    # The nulls are ignored by the means, and the covariance uses the rows where all the columns are valid.
+    null_df = df.copy()
+    null_df.loc[null_df.sample(frac=0.1, random_state=0).index, "a"] = np.nan
+    null_df.loc[null_df.sample(frac=0.1, random_state=1).index, "b"] = np.nan
+    null_table = pa.Table.from_pandas(null_df, preserve_index=False)
+    null_table = pa.table({"a": chunked(null_table.column("a").combine_chunks(), 700),
+                           "b": chunked(null_table.column("b").combine_chunks(), 1100)})
+    null_cdf = pbn.ChunkedDataFrame(null_table)
+
+    assert np.allclose(null_cdf.means(["a", "b"]), null_df[["a", "b"]].mean().to_numpy())
+    assert np.allclose(null_cdf.cov(["a", "b"]), null_df[["a", "b"]].dropna().cov().to_numpy())
+
+    single = pbn.ChunkedDataFrame(df)
+    assert single.num_batches() == 1
+    assert np.allclose(single.cov(columns), df[columns].cov().to_numpy())
+
+def test_chunked_joint_counts():
+    table = pa.Table.from_pandas(discrete_df, preserve_index=False)
+    table = pa.Table.from_batches(table.to_batches(max_chunksize=900))
+    cdf = pbn.ChunkedDataFrame(table)
+
+    cardinality, counts = cdf.joint_counts("C", ["A", "B"])
+    assert list(cardinality) == [len(discrete_df[v].cat.categories) for v in ["C", "A", "B"]]
+    assert counts.sum() == SIZE
+
+    codes = [discrete_df[v].cat.codes.to_numpy() for v in ["C", "A", "B"]]
+    indices = codes[0] + cardinality[0] * codes[1] + cardinality[0] * cardinality[1] * codes[2]
+    assert np.all(counts == np.bincount(indices, minlength=np.prod(cardinality)))
+
+def test_cpu_instruction_sets():
+    columns = ["a", "b", "c", "d"]
+    cdf = pbn.ChunkedDataFrame(df)
+    cov = cdf.cov(columns)
+    _, counts = pbn.ChunkedDataFrame(discrete_df).joint_counts("C", ["A", "B"])
+    kmi = pbn.KMutualInformation(df, k=10, seed=0, samples=20, subsample=500).pvalue("a", "b", "c")
+
+    assert pbn.cpu_instruction_set() in ["generic", "avx2", "avx512"]
+
+    try:
+        pbn.set_cpu_max_instruction_set("generic")
+        assert pbn.cpu_instruction_set() == "generic"
+        # The dot products are summed in a different order, but the counts and the distances do not change.
+        assert np.allclose(cdf.cov(columns), cov)
+        assert np.all(pbn.ChunkedDataFrame(discrete_df).joint_counts("C", ["A", "B"])[1] == counts)
+        assert pbn.KMutualInformation(df, k=10, seed=0, samples=20, subsample=500).pvalue("a", "b", "c") == kmi
+    finally:
+        pbn.set_cpu_max_instruction_set("avx512")
+
+    with pytest.raises(ValueError) as ex:
+        pbn.set_cpu_max_instruction_set("sse")
+    assert "Wrong instruction set" in str(ex.value)
+
+def test_blocked_cross_products():
+    # Several panels of rows and tiles of columns.
+    rows, cols = 5000, 21
+    rng = np.random.default_rng(0)
+    values = rng.normal(size=(rows, cols)) @ rng.normal(size=(cols, cols))
+    wide = pd.DataFrame(values, columns=["x" + str(i) for i in range(cols)])
+    columns = list(wide.columns.values)
+    cdf = pbn.ChunkedDataFrame(wide)
+
+    cov = cdf.cov(columns)
+    assert np.allclose(cov, np.cov(values, rowvar=False))
+    assert np.array_equal(cov, cov.T)
+    centered = values - values.mean(axis=0)
+    assert np.allclose(cdf.sse(columns), centered.T @ centered)
+
+    # Each covariance only depends on its two columns.
+    subset = ["x19", "x2", "x11"]
+    indices = [columns.index(c) for c in subset]
+    assert np.array_equal(cdf.cov(subset), cov[np.ix_(indices, indices)])
+
@@ -170,4 +170,19 @@ def test_cv_null():
         assert np.setdiff1d(nptrain, nptest).shape == nptrain.shape, "The train indices includes test indices"
         assert np.setdiff1d(nptest, nptrain).shape == nptest.shape, "The test indices includes train indices"
         assert np.all(np.sort(np.setdiff1d(train_indices, test_indices)) == np.sort(train_indices)), "The train indices includes test indices"
-        assert np.all(np.sort(np.setdiff1d(test_indices, train_indices)) == np.sort(test_indices)), "The test indices includes train indices"
\ No newline at end of file
+        assert np.all(np.sort(np.setdiff1d(test_indices, train_indices)) == np.sort(test_indices)), "The test indices includes train indices"
+
+def test_cv_loc_folds():
+    cv = pbn.CrossValidation(df, seed=0)
+
+    # The folds of the selected columns are equal to the columns of the folds of the full DataFrame.
+    for (train_df, test_df), (train_loc, test_loc) in zip(cv, cv.loc(["c", "a"])):
+        assert train_loc.column(0).equals(train_df.column(2))
+        assert train_loc.column(1).equals(train_df.column(0))
+        assert test_loc.column(0).equals(test_df.column(2))
+        assert test_loc.column(1).equals(test_df.column(0))
+
+    for i, (train_df, test_df) in enumerate(cv.loc("b")):
+        train_fold, test_fold = cv.loc("b").fold(i)
+        assert train_fold.equals(train_df), "Train DataFrame fold() and __iter__ are not equal."
+        assert test_fold.equals(test_df), "Test DataFrame fold() and __iter__ are not equal."
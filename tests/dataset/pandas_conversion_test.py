@@ -0,0 +1,88 @@
+import numpy as np
+import pandas as pd
+import pyarrow as pa
+import pybnesian as pbn
+
+import util_test
+
+SIZE = 10000
+
+df = util_test.generate_normal_data(SIZE)
+
+def converted(d):
+    return pbn.DynamicDataFrame(d, 1).origin_df()
+
+def expected(d):
+    return pa.RecordBatch.from_pandas(d, preserve_index=False)
+
+def test_pandas_conversion():
+    assert converted(df).equals(expected(df))
+
+    df_float = df.astype('float32')
+    rb = converted(df_float)
+    assert rb.schema.field("a").type == pa.float32()
+    assert rb.equals(expected(df_float))
+
+    # The columns of a row-major matrix are not contiguous.
+    df_strided = pd.DataFrame(np.ascontiguousarray(df.to_numpy()), columns=df.columns)
+    assert converted(df_strided).equals(expected(df_strided))
+
+    # Non float columns.
+    df_mixed = df.copy()
+    df_mixed["e"] = np.arange(SIZE)
+    df_mixed["f"] = pd.Series(np.repeat(["x", "y"], SIZE // 2)).astype("category")
+    assert converted(df_mixed).equals(expected(df_mixed))
+
+def test_pandas_conversion_null():
+    df_null = df.copy()
+    df_null.loc[df_null.index[[0, 7, 8, 9, 100]], 'a'] = np.nan
+    df_null.loc[df_null.index[[1, 7, 9999]], 'c'] = np.nan
+
+    rb = converted(df_null)
+    assert rb.column(0).null_count == 5
+    assert rb.column(1).null_count == 0
+    assert rb.column(2).null_count == 3
+    assert rb.equals(expected(df_null))
+
+def test_pandas_conversion_cache():
+    df_copy = df.copy()
+    first = converted(df_copy)
+    assert converted(df_copy).equals(first)
+
+    # New columns are converted again.
+    df_copy["a"] = df_copy["a"] + 1
+    rb = converted(df_copy)
+    assert rb.equals(expected(df_copy))
+    assert not rb.equals(first)
+
+    df_copy["e"] = df_copy["b"]
+    rb = converted(df_copy)
+    assert rb.schema.names == ["a", "b", "c", "d", "e"]
+    assert rb.equals(expected(df_copy))
+
+    short = df_copy.iloc[:100]
+    assert converted(short).equals(expected(short))
+
+def test_pandas_conversion_cache_inplace():
+    df_copy = df.copy()
+    converted(df_copy)
+
+    # The DataFrame keeps its NumPy buffers when it is modified in place, so the cached conversion must not be reused.
+    df_copy.loc[df_copy.index[[3, 50]], 'b'] = np.nan
+    rb = converted(df_copy)
+    assert rb.column(1).null_count == 2
+    assert rb.equals(expected(df_copy))
+
+    df_copy.loc[df_copy.index[3], 'b'] = 1.5
+    rb = converted(df_copy)
+    assert rb.column(1).null_count == 1
+    assert rb.equals(expected(df_copy))
+
+    df_copy['c'] *= 2
+    assert converted(df_copy).equals(expected(df_copy))
+
+    # A KDE fitted after the modification uses the new values.
+    df_copy.loc[:, 'a'] = df_copy['a'].to_numpy()[::-1]
+    cpd = pbn.KDE(['a'])
+    cpd.fit(df_copy)
+    assert np.all(cpd.dataset().column(0).to_numpy() == df_copy['a'].to_numpy())
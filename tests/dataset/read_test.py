@@ -0,0 +1,125 @@
+import os
+import pickle
+import numpy as np
+import pandas as pd
+import pyarrow as pa
+import pyarrow.feather as feather
+import pyarrow.parquet as pq
+import pytest
+import pybnesian as pbn
+
+import util_test
+
+SIZE = 10000
+
+df = util_test.generate_normal_data(SIZE)
+
+def test_read_ipc(tmp_path):
+    path = str(tmp_path / "data.arrow")
+    feather.write_feather(df, path, compression="uncompressed")
+
+    rb = pbn.read_ipc(path)
+    assert isinstance(rb, pa.RecordBatch)
+    assert rb.to_pandas().equals(df)
+
+    rb = pbn.read_ipc(path, ["c", "a"])
+    assert rb.schema.names == ["c", "a"]
+    assert rb.to_pandas().equals(df[["c", "a"]])
+
+    # A file with many record batches.
+    feather.write_feather(df, path, compression="uncompressed", chunksize=SIZE // 7)
+    rb = pbn.read_ipc(path, ["b", "d"])
+    assert rb.to_pandas().equals(df[["b", "d"]])
+
+    with pytest.raises(ValueError) as ex:
+        pbn.read_ipc(path, ["a", "e"])
+    assert "not present" in str(ex.value)
+
+def test_read_parquet(tmp_path):
+    path = str(tmp_path / "data.parquet")
+    pq.write_table(pa.Table.from_pandas(df, preserve_index=False), path, row_group_size=SIZE // 7)
+
+    rb = pbn.read_parquet(path)
+    assert isinstance(rb, pa.RecordBatch)
+    assert rb.to_pandas().equals(df)
+
+    rb = pbn.read_parquet(path, ["d", "b"])
+    assert rb.schema.names == ["d", "b"]
+    assert rb.to_pandas().equals(df[["d", "b"]])
+
+    # The file is read by row groups.
+    num_row_groups = pq.ParquetFile(path).num_row_groups
+    assert num_row_groups == 8
+    row_group_size = SIZE // 7
+    rb = pbn.read_parquet(path, ["c", "a"], row_groups=[2])
+    assert rb.to_pandas().equals(df[["c", "a"]].iloc[2 * row_group_size:3 * row_group_size].reset_index(drop=True))
+
+    rb = pbn.read_parquet(path, row_groups=[3, 0])
+    expected = df.iloc[np.r_[3 * row_group_size:4 * row_group_size, 0:row_group_size]].reset_index(drop=True)
+    assert rb.to_pandas().equals(expected)
+
+    parts = [pbn.read_parquet(path, row_groups=[i]).to_pandas() for i in range(num_row_groups)]
+    assert pd.concat(parts, ignore_index=True).equals(df)
+
+    with pytest.raises(ValueError) as ex:
+        pbn.read_parquet(path, row_groups=[num_row_groups])
+    assert "not present" in str(ex.value)
+
+def test_read_ipc_learning(tmp_path):
+    path = str(tmp_path / "data.arrow")
+    feather.write_feather(df, path, compression="uncompressed")
+
+    rb = pbn.read_ipc(path)
+    gbn = pbn.GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("b", "c")])
+    gbn.fit(rb)
+
+    gbn_pandas = pbn.GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("b", "c")])
+    gbn_pandas.fit(df)
+
+    assert gbn.slogl(rb) == pytest.approx(gbn_pandas.slogl(df))
+
+def test_write_ipc(tmp_path):
+    path = str(tmp_path / "data.arrow")
+    pbn.write_ipc(df, path)
+
+    rb = pbn.read_ipc(path)
+    assert rb.to_pandas().equals(df)
+
+def test_shared_dataframe(tmp_path):
+    shared = pbn.SharedDataFrame(df)
+    assert shared.owner()
+    assert os.path.exists(shared.path())
+    assert shared.dataframe().to_pandas().equals(df)
+
+    # The pickle attaches to the same file instead of copying the data.
+    attached = pickle.loads(pickle.dumps(shared))
+    assert attached.path() == shared.path()
+    assert not attached.owner()
+    assert len(pickle.dumps(shared)) < 1000
+
+    gbn = pbn.GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("b", "c")])
+    gbn.fit(attached.dataframe())
+    gbn_pandas = pbn.GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("b", "c")])
+    gbn_pandas.fit(df)
+    assert gbn.slogl(attached.dataframe()) == pytest.approx(gbn_pandas.slogl(df))
+
+    # Only the owner removes the file.
+    path = shared.path()
+    del attached
+    assert os.path.exists(path)
+    del shared
+    assert not os.path.exists(path)
+
+    with pytest.raises(ValueError):
+        pbn.SharedDataFrame.attach(path)
+
+    path = str(tmp_path / "shared.arrow")
+    shared = pbn.SharedDataFrame(df, path)
+    with pytest.raises(ValueError):
+        pbn.SharedDataFrame(df, path)
+
+    rb = shared.dataframe()
+    shared.unlink()
+    assert not os.path.exists(path)
+    # The attached data is still valid.
+    assert rb.to_pandas().equals(df)
@@ -253,6 +253,24 @@ def test_ckde_logl():
     cpd2.fit(df_float)
     assert np.all(np.isclose(cpd.logl(test_df_float), cpd2.logl(test_df_float), atol=0.0005)), "Order of evidence changes logl() result."
 
+def test_ckde_logl_fused():
+    test_df = util_test.generate_normal_data(TEST_SIZE, seed=1)
+
+    for _df, _test_df, atol in [(df, test_df, 1e-8), (df_float, test_df.astype('float32'), 0.0005)]:
+        for variable, evidence in [('b', ['a']), ('c', ['a', 'b']), ('d', ['c', 'a', 'b'])]:
+            cpd = pbn.CKDE(variable, evidence)
+            cpd.fit(_df)
+
+            # The joint and the marginal KDE are evaluated in one pass, so compare with the two-pass logl.
+            two_pass = cpd.kde_joint().logl(_test_df) - cpd.kde_marg().logl(_test_df)
+            assert np.all(np.isclose(cpd.logl(_test_df), two_pass, atol=atol))
+            assert np.isclose(cpd.slogl(_test_df), two_pass.sum(), atol=atol * TEST_SIZE)
+
+            # A marginal bandwidth that does not match the joint bandwidth is evaluated in two passes.
+            cpd.kde_marg().bandwidth = 2 * cpd.kde_marg().bandwidth
+            two_pass = cpd.kde_joint().logl(_test_df) - cpd.kde_marg().logl(_test_df)
+            assert np.all(np.isclose(cpd.logl(_test_df), two_pass, atol=atol))
+
 def test_ckde_logl_null():
     def _test_ckde_logl_null(variable, evidence, _df, _test_df):
         cpd = pbn.CKDE(variable, evidence)
@@ -551,4 +569,132 @@ def test_ckde_sample():
     sampled = cpd.sample(SAMPLE_SIZE, sampling_df, 0)
 
     assert sampled.type == pa.float32()
-    assert int(sampled.nbytes / (sampled.type.bit_width / 8)) == SAMPLE_SIZE
\ No newline at end of file
+    assert int(sampled.nbytes / (sampled.type.bit_width / 8)) == SAMPLE_SIZE
+
+def test_ckde_sample_seed():
+    SAMPLE_SIZE = 10000
+
+    for variable, evidence in [('a', []), ('b', ['a']), ('c', ['a', 'b'])]:
+        cpd = pbn.CKDE(variable, evidence)
+        cpd.fit(df)
+
+        sampling_df = df.sample(SAMPLE_SIZE, replace=True, random_state=0).reset_index(drop=True)
+        sampled = cpd.sample(SAMPLE_SIZE, sampling_df, 0).to_numpy()
+
+        assert np.all(sampled == cpd.sample(SAMPLE_SIZE, sampling_df, 0).to_numpy())
+        assert not np.all(sampled == cpd.sample(SAMPLE_SIZE, sampling_df, 1).to_numpy())
+        assert len(cpd.sample(0, sampling_df.iloc[:0], 0)) == 0
+
+        if not evidence:
+            # The marginal sample has the mean and (slightly inflated) variance of the training data.
+            assert np.isclose(sampled.mean(), df[variable].mean(), atol=0.05 * df[variable].std())
+            assert np.std(sampled) >= 0.95 * df[variable].std()
+
+def test_ckde_relative_error():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    relative_error = 0.05
+
+    for variable, evidence in [('a', []), ('b', ['a']), ('c', ['a', 'b']), ('d', ['a', 'b', 'c'])]:
+        exact = pbn.CKDE(variable, evidence)
+        exact.fit(df)
+        approx = pbn.CKDE(variable, evidence, relative_error=relative_error)
+        approx.fit(df)
+        assert approx.relative_error == relative_error
+
+        # The joint and marginal densities are approximated independently.
+        error = -2 * np.log1p(-relative_error) + 1e-8
+        approx_logl = approx.logl(test_df)
+        assert np.all(np.abs(approx_logl - exact.logl(test_df)) <= error)
+        assert np.isclose(approx.slogl(test_df), approx_logl.sum())
+
+
+def test_ckde_opencl_pipeline():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+
+    for variable, evidence in [('a', []), ('b', ['a']), ('c', ['a', 'b'])]:
+        cpd = pbn.CKDE(variable, evidence)
+        cpd.fit(df)
+        logl = cpd.logl(test_df)
+        slogl = cpd.slogl(test_df)
+
+        try:
+            for rows in [1, 7, 64]:
+                pbn.set_opencl_pipeline_rows(rows)
+                assert np.allclose(cpd.logl(test_df), logl, equal_nan=True)
+                assert np.isclose(cpd.slogl(test_df), slogl)
+        finally:
+            pbn.set_opencl_pipeline_rows(0)
+
+def test_ckde_opencl_out_of_core():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+
+    for variable, evidence in [('a', []), ('b', ['a']), ('c', ['a', 'b'])]:
+        in_core = pbn.CKDE(variable, evidence)
+        in_core.fit(df)
+        logl = in_core.logl(test_df)
+
+        try:
+            pbn.set_opencl_training_block_rows(3000)
+            cpd = pbn.CKDE(variable, evidence)
+            cpd.fit(df)
+        finally:
+            pbn.set_opencl_training_block_rows(0)
+
+        assert cpd.out_of_core()
+        assert not in_core.out_of_core()
+        assert np.allclose(cpd.logl(test_df), logl, equal_nan=True)
+        assert np.isclose(cpd.slogl(test_df), np.nansum(logl))
+
+        values = np.linspace(-2, 2, 5)
+        assert np.allclose(cpd.logl_grid(values, test_df), in_core.logl_grid(values, test_df), rtol=1e-5, atol=1e-5,
+                           equal_nan=True)
+
+        with pytest.raises(ValueError) as ex:
+            cpd.sample(10, test_df)
+        assert "does not fit in the OpenCL device" in str(ex.value)
+        with pytest.raises(ValueError) as ex:
+            cpd.cdf(test_df)
+        assert "does not fit in the OpenCL device" in str(ex.value)
+
+def test_ckde_opencl_mixed_precision():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+
+    for variable, evidence in [('a', []), ('b', ['a']), ('c', ['a', 'b'])]:
+        cpd = pbn.CKDE(variable, evidence)
+        cpd.fit(df)
+        logl = cpd.logl(test_df)
+        slogl = cpd.slogl(test_df)
+
+        try:
+            pbn.set_opencl_mixed_precision(True)
+            assert np.allclose(cpd.logl(test_df), logl, atol=2e-3, equal_nan=True)
+            assert np.isclose(cpd.slogl(test_df), slogl, atol=1e-1)
+        finally:
+            pbn.set_opencl_mixed_precision(False)
+
+def test_ckde_logl_grid():
+    test_df = util_test.generate_normal_data(20, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+    values = np.linspace(-5, 5, 30)
+
+    for variable, evidence in [('b', ['a']), ('c', ['a', 'b']), ('d', ['a', 'b', 'c'])]:
+        for data, rtol in [(df, 1e-5), (df_float, 1e-3)]:
+            cpd = pbn.CKDE(variable, evidence)
+            cpd.fit(data)
+
+            evidence_df = test_df[evidence].astype(data.dtypes['a'])
+            grid = cpd.logl_grid(values, evidence_df)
+            assert grid.shape == (test_df.shape[0], values.shape[0])
+
+            # The Cartesian product of the evidence rows and the values.
+            cartesian = evidence_df.loc[evidence_df.index.repeat(values.shape[0])].reset_index(drop=True)
+            cartesian[variable] = np.tile(values, test_df.shape[0]).astype(data.dtypes['a'])
+            expected = cpd.logl(cartesian).reshape(test_df.shape[0], values.shape[0])
+            assert np.allclose(grid, expected, rtol=rtol, atol=rtol, equal_nan=True)
+
+    cpd = pbn.CKDE('a', [])
+    cpd.fit(df)
+    assert np.allclose(cpd.logl_grid(values)[0], cpd.logl(pd.DataFrame({'a': values})))
@@ -1,9 +1,15 @@
+import multiprocessing
+import os
+import stat
+import subprocess
+import sys
 import pytest
 import numpy as np
 import pyarrow as pa
+import pickle
 import pybnesian as pbn
 from pybnesian import BandwidthSelector
-from scipy.stats import gaussian_kde
+from scipy.stats import gaussian_kde, norm
 
 import util_test
 
@@ -294,6 +300,25 @@ def test_kde_slogl():
     assert np.all(np.isclose(cpd.slogl(test_df_float), cpd2.slogl(test_df_float))), "Order of evidence changes slogl() result."
 
 
+def test_kde_logl_null_runs():
+    # The nulls are compacted and expanded by runs of 64-bit words, so the runs cross the word boundaries.
+    TEST_SIZE = 300
+    test_df = util_test.generate_normal_data(TEST_SIZE, seed=1)
+    null_rows = np.r_[0, 5:70, 127, 128, 190:260, 299]
+    df_null = test_df.copy()
+    df_null.loc[df_null.index[null_rows], 'a'] = np.nan
+    df_null.loc[df_null.index[np.r_[63, 64, 65, 280:290]], 'b'] = np.nan
+
+    for variables in [['a'], ['b', 'a']]:
+        cpd = pbn.KDE(variables)
+        cpd.fit(df)
+        logl = cpd.logl(df_null)
+        valid = df_null.loc[:, variables].notna().all(axis=1).to_numpy()
+
+        assert np.all(np.isnan(logl[~valid]))
+        assert np.all(np.isclose(logl[valid], cpd.logl(df_null[valid])))
+        assert np.isclose(cpd.slogl(df_null), logl[valid].sum())
+
 def test_kde_slogl_null():
     def _test_kde_slogl_null_iter(variables, _df, _test_df):
         cpd = pbn.KDE(variables)
@@ -346,3 +371,543 @@ def test_kde_slogl_null():
     cpd2 = pbn.KDE(['a', 'c', 'd', 'b'])
     cpd2.fit(df_float)
     assert np.all(np.isclose(cpd.slogl(df_null_float), cpd2.slogl(df_null_float))), "Order of evidence changes slogl() result."
+
+def test_kde_backend():
+    assert pbn.KDE(['a'], backend=pbn.KDEBackend.CPU).backend == pbn.KDEBackend.CPU
+    assert pbn.KDE(['a'], backend=pbn.KDEBackend.OPENCL).backend == pbn.KDEBackend.OPENCL
+    assert pbn.KDE(['a']).backend != pbn.KDEBackend.AUTO
+
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+    test_df_float = test_df.astype('float32')
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b'], ['d', 'a', 'b', 'c']]:
+        for _df, _test_df, atol in [(df, test_df, 1e-8), (df_float, test_df_float, 0.0005)]:
+            cpu = pbn.KDE(variables, backend=pbn.KDEBackend.CPU)
+            cpu.fit(_df)
+            opencl = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+            opencl.fit(_df)
+
+            cpu_logl = cpu.logl(_test_df)
+            assert np.all(np.isnan(cpu_logl) == np.isnan(opencl.logl(_test_df)))
+            assert np.allclose(cpu_logl, opencl.logl(_test_df), atol=atol, equal_nan=True)
+            assert np.isclose(cpu.slogl(_test_df), opencl.slogl(_test_df), atol=atol * _test_df.shape[0])
+            assert np.all(cpu.dataset().to_pandas().to_numpy() == opencl.dataset().to_pandas().to_numpy())
+
+            loaded = pickle.loads(pickle.dumps(cpu))
+            assert loaded.backend == pbn.KDEBackend.CPU
+            assert np.allclose(loaded.logl(_test_df), cpu_logl, equal_nan=True)
+
+def test_kde_opencl_chunks():
+    # Enough training instances to split the log-sum-exp of each test instance in several work groups.
+    train_df = util_test.generate_normal_data(20000, seed=2)
+    test_df = util_test.generate_normal_data(50, seed=1)
+    # The kernels of the far test instances underflow.
+    test_df.iloc[:5] *= 1000
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b']]:
+        cpu = pbn.KDE(variables, backend=pbn.KDEBackend.CPU)
+        cpu.fit(train_df)
+        opencl = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+        opencl.fit(train_df)
+
+        assert np.allclose(cpu.logl(test_df), opencl.logl(test_df), atol=1e-8)
+
+def test_kde_cpu_num_threads():
+    test_df = util_test.generate_normal_data(500, seed=1)
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b']]:
+        for relative_error in [0, 0.01]:
+            cpu = pbn.KDE(variables, backend=pbn.KDEBackend.CPU, relative_error=relative_error)
+            cpu.fit(df)
+            assert cpu.num_threads == 0
+            logl = cpu.logl(test_df)
+
+            # Each block of test instances is evaluated on its own, so the result does not depend on the threads.
+            for num_threads in [1, 3]:
+                cpu.num_threads = num_threads
+                assert cpu.num_threads == num_threads
+                assert np.all(cpu.logl(test_df) == logl)
+
+    with pytest.raises(ValueError):
+        cpu.num_threads = -1
+
+def test_kde_opencl_shared_columns():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    other_df = util_test.generate_normal_data(SIZE, seed=3)
+
+    # The KDEs fitted with the same DataFrame share the device copies of the columns.
+    univariate = pbn.KDE(['a'], backend=pbn.KDEBackend.OPENCL)
+    univariate.fit(df)
+    multivariate = pbn.KDE(['b', 'a'], backend=pbn.KDEBackend.OPENCL)
+    multivariate.fit(df)
+    univariate_logl = univariate.logl(test_df)
+    multivariate_logl = multivariate.logl(test_df)
+
+    for variables, logl in [(['a'], univariate_logl), (['b', 'a'], multivariate_logl)]:
+        cpu = pbn.KDE(variables, backend=pbn.KDEBackend.CPU)
+        cpu.fit(df)
+        assert np.allclose(cpu.logl(test_df), logl)
+
+    # Refitting a KDE does not change the data of the others.
+    other = pbn.KDE(['a'], backend=pbn.KDEBackend.OPENCL)
+    other.fit(df)
+    other.fit(other_df)
+    assert np.all(univariate.logl(test_df) == univariate_logl)
+    assert np.all(multivariate.logl(test_df) == multivariate_logl)
+
+    cpu = pbn.KDE(['a'], backend=pbn.KDEBackend.CPU)
+    cpu.fit(other_df)
+    assert np.allclose(cpu.logl(test_df), other.logl(test_df))
+
+def test_kde_relative_error():
+    with pytest.raises(ValueError):
+        pbn.KDE(['a'], relative_error=-0.1)
+
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b'], ['d', 'a', 'b', 'c']]:
+        for backend in [pbn.KDEBackend.CPU, pbn.KDEBackend.OPENCL]:
+            for relative_error in [0.01, 0.1]:
+                exact = pbn.KDE(variables, backend=backend)
+                exact.fit(df)
+                approx = pbn.KDE(variables, backend=backend, relative_error=relative_error)
+                approx.fit(df)
+                assert approx.relative_error == relative_error
+
+                exact_logl = exact.logl(test_df)
+                approx_logl = approx.logl(test_df)
+                assert np.all(np.isnan(exact_logl) == np.isnan(approx_logl))
+                assert np.all(np.abs(approx_logl - exact_logl)[~np.isnan(exact_logl)] <= -np.log1p(-relative_error) + 1e-8)
+                assert np.isclose(approx.slogl(test_df), np.nansum(approx_logl))
+
+                loaded = pickle.loads(pickle.dumps(approx))
+                assert loaded.relative_error == relative_error
+                assert np.allclose(loaded.logl(test_df), approx_logl, equal_nan=True)
+
+def test_kde_condensation():
+    train_df = util_test.generate_normal_data(20000, seed=2)
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+
+    with pytest.raises(ValueError) as ex:
+        pbn.KDE(['a']).fit(train_df, condensed_instances=0)
+    assert "must be a positive number" in str(ex.value)
+    with pytest.raises(ValueError) as ex:
+        pbn.KDE(['a'], relative_error=0.1).fit(train_df, condensed_instances=100)
+    assert "cannot be condensed" in str(ex.value)
+
+    for variables in [['a'], ['b', 'a']]:
+        exact = pbn.KDE(variables, backend=pbn.KDEBackend.CPU)
+        exact.fit(train_df)
+        exact_logl = exact.logl(test_df)
+        valid = ~np.isnan(exact_logl)
+
+        condensed_logls = []
+        for backend in [pbn.KDEBackend.CPU, pbn.KDEBackend.OPENCL]:
+            condensed = pbn.KDE(variables, backend=backend)
+            condensed.fit(train_df, condensed_instances=1000, seed=0)
+            assert condensed.condensed()
+            assert condensed.num_instances() <= 1000
+            assert np.isclose(condensed.weights().sum(), 1)
+            # The bandwidth is estimated with all the instances.
+            assert np.all(condensed.bandwidth == exact.bandwidth)
+
+            logl = condensed.logl(test_df)
+            assert np.all(np.isnan(logl) == ~valid)
+            assert np.mean(np.abs(logl - exact_logl)[valid]) < 0.05
+            assert np.isclose(condensed.slogl(test_df), np.nansum(logl))
+            condensed_logls.append(logl)
+
+            loaded = pickle.loads(pickle.dumps(condensed))
+            assert loaded.condensed()
+            assert np.allclose(loaded.weights(), condensed.weights())
+            assert np.allclose(loaded.logl(test_df), logl, equal_nan=True)
+
+            # Fitting again without condensation uses all the instances.
+            condensed.fit(train_df)
+            assert not condensed.condensed()
+            assert condensed.num_instances() == train_df.shape[0]
+            assert np.allclose(condensed.weights(), 1 / train_df.shape[0])
+
+        assert np.allclose(condensed_logls[0], condensed_logls[1], equal_nan=True)
+
+    # The KDE is not condensed if it has less training instances than condensed_instances.
+    small = pbn.KDE(['a'])
+    small.fit(df, condensed_instances=SIZE)
+    assert not small.condensed()
+    assert small.num_instances() == SIZE
+
+def test_kde_weighted_fit():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    np.random.seed(0)
+    weights = np.random.randint(0, 4, size=SIZE).astype(float)
+
+    with pytest.raises(ValueError) as ex:
+        pbn.KDE(['a'], relative_error=0.1).fit(df, weights=weights)
+    assert "cannot be weighted" in str(ex.value)
+    with pytest.raises(ValueError) as ex:
+        pbn.KDE(['a']).fit(df, weights=weights[:10])
+    assert "number of weights" in str(ex.value)
+    with pytest.raises(ValueError) as ex:
+        pbn.KDE(['a']).fit(df, weights=np.zeros(SIZE))
+    assert "zero weight" in str(ex.value)
+
+    train = df.loc[:, 'a'].to_numpy()[weights > 0]
+    w = weights[weights > 0] / weights.sum()
+
+    for backend in [pbn.KDEBackend.CPU, pbn.KDEBackend.OPENCL]:
+        weighted = pbn.KDE(['a'], backend=backend)
+        weighted.fit(df, weights=weights)
+        assert weighted.condensed()
+        assert weighted.num_instances() == train.shape[0]
+        assert np.allclose(weighted.weights(), w)
+
+        # The bandwidth is estimated without weights.
+        unweighted = pbn.KDE(['a'], backend=backend)
+        unweighted.fit(df)
+        assert np.all(weighted.bandwidth == unweighted.bandwidth)
+
+        h = np.sqrt(weighted.bandwidth[0, 0])
+        kernels = norm.pdf(test_df.loc[:, 'a'].to_numpy()[:, None], train[None, :], h)
+        assert np.allclose(weighted.logl(test_df), np.log(kernels @ w))
+
+        loaded = pickle.loads(pickle.dumps(weighted))
+        assert np.allclose(loaded.logl(test_df), weighted.logl(test_df))
+
+def test_kde_opencl_tile_columns():
+    test_df = util_test.generate_normal_data(50, seed=1)
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b']]:
+        cpd = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+        cpd.fit(df)
+        logl = cpd.logl(test_df)
+        assert pbn.last_opencl_tile_columns() == test_df.shape[0]
+
+        try:
+            for columns in [1, 7, 64]:
+                pbn.set_opencl_tile_columns(columns)
+                assert np.allclose(cpd.logl(test_df), logl)
+                assert pbn.last_opencl_tile_columns() == min(columns, test_df.shape[0])
+        finally:
+            pbn.set_opencl_tile_columns(0)
+
+def test_kde_opencl_pipeline():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b']]:
+        cpd = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+        cpd.fit(df)
+        logl = cpd.logl(test_df)
+        slogl = cpd.slogl(test_df)
+
+        try:
+            for rows in [1, 7, 64]:
+                pbn.set_opencl_pipeline_rows(rows)
+                assert np.allclose(cpd.logl(test_df), logl, equal_nan=True)
+                assert np.isclose(cpd.slogl(test_df), slogl)
+        finally:
+            pbn.set_opencl_pipeline_rows(0)
+
+def test_kde_opencl_out_of_core():
+    train_df = util_test.generate_normal_data(20000, seed=2)
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+    test_df_float = test_df.astype('float32')
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b']]:
+        for _df, _test_df, atol in [(train_df, test_df, 1e-8), (train_df.astype('float32'), test_df_float, 0.0005)]:
+            in_core = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+            in_core.fit(_df)
+            assert not in_core.out_of_core()
+            logl = in_core.logl(_test_df)
+
+            try:
+                # The last block has less training instances.
+                pbn.set_opencl_training_block_rows(3000)
+                cpd = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+                cpd.fit(_df)
+                condensed = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+                condensed.fit(_df, condensed_instances=5000, seed=0)
+            finally:
+                pbn.set_opencl_training_block_rows(0)
+
+            assert cpd.out_of_core()
+            assert cpd.num_instances() == _df.shape[0]
+            assert np.allclose(cpd.logl(_test_df), logl, atol=atol, equal_nan=True)
+            assert np.isclose(cpd.slogl(_test_df), np.nansum(logl), atol=atol * _test_df.shape[0])
+            assert np.all(cpd.dataset().to_pandas().to_numpy() == in_core.dataset().to_pandas().to_numpy())
+
+            loaded = pickle.loads(pickle.dumps(cpd))
+            assert not loaded.out_of_core()
+            assert np.allclose(loaded.logl(_test_df), logl, atol=atol, equal_nan=True)
+
+            # The condensed instances are also streamed with their weights.
+            assert condensed.out_of_core()
+            cpu_condensed = pbn.KDE(variables, backend=pbn.KDEBackend.CPU)
+            cpu_condensed.fit(_df, condensed_instances=5000, seed=0)
+            assert np.allclose(condensed.logl(_test_df), cpu_condensed.logl(_test_df), atol=atol, equal_nan=True)
+
+def test_kde_opencl_devices():
+    cpd = pbn.KDE(['a', 'b'], backend=pbn.KDEBackend.OPENCL)
+    cpd.fit(df)
+    assert pbn.opencl_num_devices() >= 1
+
+    with pytest.raises(ValueError) as ex:
+        pbn.set_opencl_devices([])
+    assert "at least one device" in str(ex.value)
+
+    with pytest.raises(ValueError) as ex:
+        pbn.set_opencl_devices([0, 0])
+    assert "repeated" in str(ex.value)
+
+    with pytest.raises(RuntimeError) as ex:
+        pbn.set_opencl_devices([0])
+    assert "after OpenCL is initialized" in str(ex.value)
+
+def test_kde_opencl_mixed_precision():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    test_df.loc[test_df.sample(frac=0.2, random_state=0).index, 'a'] = np.nan
+    test_df_float = test_df.astype('float32')
+
+    for variables in [['a'], ['b', 'a'], ['c', 'a', 'b']]:
+        cpd = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+        cpd.fit(df)
+        logl = cpd.logl(test_df)
+        slogl = cpd.slogl(test_df)
+
+        cpd_float = pbn.KDE(variables, backend=pbn.KDEBackend.OPENCL)
+        cpd_float.fit(df_float)
+        logl_float = cpd_float.logl(test_df_float)
+
+        try:
+            pbn.set_opencl_mixed_precision(True)
+            assert np.allclose(cpd.logl(test_df), logl, atol=1e-3, equal_nan=True)
+            assert np.isclose(cpd.slogl(test_df), slogl, atol=5e-2)
+            # The float data is not affected.
+            assert np.allclose(cpd_float.logl(test_df_float), logl_float, rtol=0, atol=0, equal_nan=True)
+        finally:
+            pbn.set_opencl_mixed_precision(False)
+
+def test_kde_opencl_program_cache():
+    cpd = pbn.KDE(['a'], backend=pbn.KDEBackend.OPENCL)
+    cpd.fit(df)
+
+    with pytest.raises(RuntimeError) as ex:
+        pbn.set_opencl_program_cache("")
+    assert "after OpenCL is initialized" in str(ex.value)
+
+def test_opencl_autotuning():
+    variables = ['a', 'b']
+    scorer = pbn.UCVScorer(df, variables)
+    H = pbn.NormalReferenceRule().bandwidth(df, variables)
+
+    try:
+        pbn.set_opencl_autotuning(False)
+        score = scorer.score_unconstrained(H)
+    finally:
+        pbn.set_opencl_autotuning(True)
+
+    # The first evaluations time the candidate work-group sizes, which do not change the results.
+    for _ in range(20):
+        assert np.isclose(scorer.score_unconstrained(H), score)
+
+    for kernel, local_size in pbn.opencl_tuned_local_sizes().items():
+        assert local_size == 0 or local_size & (local_size - 1) == 0
+
+def opencl_kde_logl(test_df):
+    cpd = pbn.KDE(['a', 'b'], backend=pbn.KDEBackend.OPENCL)
+    cpd.fit(df)
+    return cpd.logl(test_df)
+
+@pytest.mark.skipif(not hasattr(os, 'fork'), reason="fork() is not available.")
+def test_opencl_fork():
+    # The parent initializes OpenCL before the workers are forked.
+    test_df = util_test.generate_normal_data(300, seed=1)
+    logl = opencl_kde_logl(test_df)
+
+    with multiprocessing.get_context('fork').Pool(2) as pool:
+        results = pool.map(opencl_kde_logl, [test_df, test_df.iloc[:100]])
+
+    assert np.allclose(results[0], logl)
+    assert np.allclose(results[1], logl[:100])
+    # The parent can still use its context.
+    assert np.allclose(opencl_kde_logl(test_df), logl)
+
+def test_opencl_profiling():
+    test_df = util_test.generate_normal_data(2000, seed=1)
+    cpd = pbn.KDE(['a', 'b'], backend=pbn.KDEBackend.OPENCL)
+
+    pbn.reset_profiler()
+    pbn.enable_profiler()
+    try:
+        pbn.set_opencl_profiling(True)
+        cpd.fit(df)
+        logl = cpd.logl(test_df)
+    finally:
+        pbn.set_opencl_profiling(False)
+        pbn.disable_profiler()
+
+    stats = pbn.profiler_stats()
+    kernels = [name for name in stats if name.startswith("opencl_device:kernel:")]
+    assert len(kernels) > 0
+    assert all(stats[name].calls > 0 and stats[name].seconds >= 0 for name in kernels)
+    assert stats["opencl_device:write"].bytes > 0
+    assert stats["opencl_device:read"].bytes >= 8 * test_df.shape[0]
+    pbn.reset_profiler()
+
+    # The profiling mode does not change the results.
+    assert np.all(cpd.logl(test_df) == logl)
+
+def test_ucv_batch():
+    variables = ['a', 'b']
+    scorer = pbn.UCVScorer(df, variables)
+
+    nr = pbn.NormalReferenceRule()
+    H = nr.bandwidth(df, variables)
+    bandwidths = [s * H for s in [0.5, 1., 2.]]
+    scores = scorer.score_unconstrained_batch(bandwidths)
+    assert np.all(np.isclose(scores, [scorer.score_unconstrained(bw) for bw in bandwidths]))
+
+    diagonals = [s * np.diag(H) for s in [0.5, 1., 2.]]
+    scores = scorer.score_diagonal_batch(diagonals)
+    assert np.all(np.isclose(scores, [scorer.score_diagonal(bw) for bw in diagonals]))
+
+    ucv = pbn.UCV(pattern_search=True)
+    assert ucv.pattern_search
+    assert scorer.score_unconstrained(ucv.bandwidth(df, variables)) <= scorer.score_unconstrained(H)
+    assert scorer.score_diagonal(ucv.diag_bandwidth(df, variables)) <= scorer.score_diagonal(np.diag(H))
+
+    ucv2 = pickle.loads(pickle.dumps(ucv))
+    assert ucv2.pattern_search
+
+def test_ucv_binned():
+    variables = ['a', 'b']
+    scorer = pbn.UCVScorer(df, variables)
+    binned = pbn.UCVScorer(df, variables, binned_grid_size=401)
+    assert binned.binned_grid_size == 401
+
+    nr = pbn.NormalReferenceRule()
+    diagonals = [s * nr.diag_bandwidth(df, variables) for s in [0.5, 1., 2.]]
+    scores = binned.score_diagonal_batch(diagonals)
+    assert np.all(np.isclose(scores, [scorer.score_diagonal(bw) for bw in diagonals], rtol=1e-2))
+
+    with pytest.raises(ValueError) as ex:
+        binned.score_unconstrained(nr.bandwidth(df, variables))
+    assert "only supports diagonal bandwidth matrices" in str(ex.value)
+
+    ucv = pbn.UCV(binned_grid_size=401)
+    assert ucv.binned_grid_size == 401
+    assert scorer.score_diagonal(ucv.diag_bandwidth(df, variables)) <= scorer.score_diagonal(diagonals[1])
+    assert np.all(np.isclose(ucv.bandwidth(df, variables), pbn.UCV().bandwidth(df, variables)))
+
+    ucv2 = pickle.loads(pickle.dumps(ucv))
+    assert ucv2.binned_grid_size == 401
+
+def test_ucv_warm_start():
+    variables = ['a', 'b']
+    cv = pbn.CrossValidation(df, 5, seed=0)
+
+    ucv = pbn.UCV(warm_start=True)
+    assert ucv.warm_start
+    cold = pbn.UCV()
+    for train_df, _ in cv:
+        scorer = pbn.UCVScorer(train_df, variables)
+        nr = pbn.NormalReferenceRule().bandwidth(train_df, variables)
+        warm_bw = ucv.bandwidth(train_df, variables)
+        assert scorer.score_unconstrained(warm_bw) <= scorer.score_unconstrained(nr)
+        assert np.isclose(scorer.score_unconstrained(warm_bw),
+                          scorer.score_unconstrained(cold.bandwidth(train_df, variables)), rtol=1e-2)
+        warm_diag = ucv.diag_bandwidth(train_df, variables)
+        assert scorer.score_diagonal(warm_diag) <= scorer.score_diagonal(np.diag(nr))
+
+    ucv.clear_warm_start()
+    assert np.all(np.isclose(ucv.bandwidth(df, variables), cold.bandwidth(df, variables)))
+
+    ucv2 = pickle.loads(pickle.dumps(ucv))
+    assert ucv2.warm_start
+
+def test_covariance_registry():
+    variables = ['a', 'b', 'c']
+    cv = pbn.CrossValidation(df, 5, seed=0)
+
+    pbn.clear_covariance_registry()
+    nr = pbn.NormalReferenceRule()
+    first = [nr.bandwidth(train_df, variables) for train_df, _ in cv]
+    assert pbn.covariance_registry_size() > 0
+
+    pbn.reset_profiler()
+    pbn.enable_profiler()
+    try:
+        # The training data of each fold is built again, but its columns are the same.
+        second = [nr.bandwidth(train_df, variables) for train_df, _ in cv]
+        diag = [nr.diag_bandwidth(train_df, ['a', 'c']) for train_df, _ in cv]
+    finally:
+        pbn.disable_profiler()
+
+    stats = pbn.profiler_stats()
+    assert stats["covariance_registry:hit"].calls == 10
+    assert "covariance_registry:miss" not in stats
+    pbn.reset_profiler()
+
+    for (train_df, _), f, s, d in zip(cv, first, second, diag):
+        train = train_df.to_pandas()
+        N = train.shape[0]
+        expected = np.cov(train[variables].to_numpy().T) * (4 / (N * 5))**(2 / 7)
+        assert np.all(f == s)
+        assert np.all(np.isclose(f, expected))
+
+        pbn.clear_covariance_registry()
+        assert np.all(np.isclose(d, nr.diag_bandwidth(train_df, ['a', 'c'])))
+
+OPENCL_CACHE_SCRIPT = """
+import sys
+import numpy as np
+import pandas as pd
+import pybnesian as pbn
+
+pbn.set_opencl_program_cache(sys.argv[1])
+np.random.seed(0)
+df = pd.DataFrame({"a": np.random.normal(size=200), "b": np.random.normal(size=200)})
+kde = pbn.KDE(["a", "b"], backend=pbn.KDEBackend.OPENCL)
+kde.fit(df)
+print(repr(kde.slogl(df)))
+"""
+
+def opencl_cache_process_slogl(directory):
+    # The program cache can only be set before OpenCL is initialized, so each run uses a new process.
+    result = subprocess.run([sys.executable, "-c", OPENCL_CACHE_SCRIPT, str(directory)],
+                            capture_output=True, text=True, check=True)
+    return float(result.stdout)
+
+@pytest.mark.skipif(sys.platform == "win32", reason="The cache permissions are only checked in POSIX systems.")
+def test_opencl_program_cache(tmp_path):
+    cache_dir = tmp_path / "cache" / "pybnesian"
+    slogl = opencl_cache_process_slogl(cache_dir)
+
+    assert stat.S_IMODE(os.stat(cache_dir).st_mode) == 0o700
+    binaries = list(cache_dir.glob("pybnesian-opencl-*.bin"))
+    assert len(binaries) > 0
+    for binary in binaries:
+        assert stat.S_IMODE(binary.stat().st_mode) == 0o600
+        assert binary.stat().st_uid == os.geteuid()
+
+    # The next process loads the cached binaries, so they are not written again.
+    inodes = {binary: binary.stat().st_ino for binary in binaries}
+    assert np.isclose(opencl_cache_process_slogl(cache_dir), slogl)
+    assert all(binary.stat().st_ino == inodes[binary] for binary in binaries)
+
+    # A binary that other users can write is not loaded: the program is compiled again and the binary replaced.
+    os.chmod(binaries[0], 0o666)
+    assert np.isclose(opencl_cache_process_slogl(cache_dir), slogl)
+    assert stat.S_IMODE(binaries[0].stat().st_mode) == 0o600
+    assert binaries[0].stat().st_ino != inodes[binaries[0]]
+
+    # A directory that other users can write is not used.
+    shared_dir = tmp_path / "shared"
+    shared_dir.mkdir()
+    os.chmod(shared_dir, 0o777)
+    assert np.isclose(opencl_cache_process_slogl(shared_dir), slogl)
+    assert list(shared_dir.iterdir()) == []
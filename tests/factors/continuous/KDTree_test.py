@@ -0,0 +1,153 @@
+import numpy as np
+import pandas as pd
+import pytest
+import pybnesian as pbn
+import util_test
+
+SIZE = 300
+df = util_test.generate_normal_data(SIZE, seed=0)
+df_float = df.astype('float32')
+
+def brute_force_distances(train, test, p):
+    differences = np.abs(test[:, np.newaxis, :] - train[np.newaxis, :, :])
+    if np.isinf(p):
+        return differences.max(axis=2)
+    return (differences**p).sum(axis=2)**(1. / p)
+
+def check_knn(tree, train_df, test_df, k, p, eps=0, num_threads=1):
+    train = train_df.to_numpy().astype('float64')
+    test = test_df.to_numpy().astype('float64')
+    rtol = 1e-5 if train_df.dtypes.iloc[0] == np.float32 else 1e-10
+
+    distances, indices = tree.query(test_df, k=k, p=p, eps=eps, num_threads=num_threads)
+    assert distances.shape == (k, test.shape[0])
+    assert indices.shape == (k, test.shape[0])
+
+    brute = np.sort(brute_force_distances(train, test, p), axis=1)[:, :k]
+    for i in range(test.shape[0]):
+        # The indices of tied neighbors can be returned in any order, so they are checked with their distances.
+        assert len(set(indices[:, i])) == k
+        assert np.all(np.diff(distances[:, i]) >= 0)
+        neighbor_distances = brute_force_distances(train[indices[:, i]], test[i:i + 1], p)[0]
+        assert np.allclose(neighbor_distances, distances[:, i], rtol=rtol, atol=1e-6)
+
+        if eps == 0:
+            assert np.allclose(distances[:, i], brute[i], rtol=rtol, atol=1e-6)
+        else:
+            assert np.all(distances[:, i] <= (1 + eps) * brute[i] * (1 + rtol) + 1e-6)
+
+def test_kdtree_query_metrics():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    for train_df, test_data in [(df, test_df), (df_float, test_df.astype('float32'))]:
+        for leafsize in [1, 3, 16]:
+            tree = pbn.KDTree(train_df, leafsize=leafsize)
+            for p in [1, 2, 3, np.inf]:
+                for k in [1, 5]:
+                    check_knn(tree, train_df, test_data, k, p)
+                    check_knn(tree, train_df, train_df, k, p)
+
+    tree = pbn.KDTree(df, leafsize=8)
+    check_knn(tree, df, df, 4, 2, num_threads=3)
+    check_knn(tree, df, df, 4, np.inf, num_threads=0)
+
+def test_kdtree_query_ties():
+    np.random.seed(0)
+    # Integer points have many ties at the same distance.
+    grid_df = pd.DataFrame(np.random.randint(0, 4, size=(200, 3)).astype('float64'), columns=["a", "b", "c"])
+    for leafsize in [1, 4, 16]:
+        tree = pbn.KDTree(grid_df, leafsize=leafsize)
+        for p in [1, 2, np.inf]:
+            check_knn(tree, grid_df, grid_df, 10, p)
+
+    # All the points are equal, so the tree is a single leaf.
+    equal_df = pd.DataFrame({"a": np.ones(40), "b": np.full(40, 2.)})
+    tree = pbn.KDTree(equal_df, leafsize=4)
+    assert tree.max_leaf_size() == 40
+    distances, indices = tree.query(equal_df, k=5)
+    assert np.all(distances == 0)
+    check_knn(tree, equal_df, equal_df, 5, 2)
+
+def test_kdtree_query_leafsize():
+    small_df = df.iloc[:20]
+    for leafsize in [1, 19, 20, 100]:
+        tree = pbn.KDTree(small_df, leafsize=leafsize)
+        assert tree.max_leaf_size() <= leafsize
+        for k in [1, 19]:
+            check_knn(tree, small_df, df.iloc[20:60], k, 2)
+            check_knn(tree, small_df, small_df, k, np.inf)
+
+    tree = pbn.KDTree(small_df)
+    with pytest.raises(ValueError):
+        tree.query(small_df, k=20)
+    with pytest.raises(ValueError):
+        tree.query(small_df, k=1, eps=-1)
+
+def test_kdtree_count_ball_subspaces():
+    np.random.seed(1)
+    count_df = pd.DataFrame({
+        "x": np.random.randint(0, 10, size=SIZE).astype('float64'),
+        "y": np.random.normal(size=SIZE),
+        "z1": np.random.randint(0, 5, size=SIZE).astype('float64'),
+        "z2": np.random.normal(size=SIZE),
+    })
+
+    data = count_df.to_numpy()
+    z = data[:, 2:]
+    for leafsize in [1, 7, 16, SIZE]:
+        tree = pbn.KDTree(count_df[["z1", "z2"]], leafsize=leafsize)
+        # The radii of the balls are the Chebyshev distances to the k-th neighbor, so many points are on the border.
+        eps = np.sort(brute_force_distances(data, data, np.inf), axis=1)[:, 5]
+        for num_threads in [1, 3]:
+            count_xz, count_yz, count_z = tree.count_ball_subspaces(count_df, "x", "y", eps, num_threads=num_threads)
+
+            z_distances = brute_force_distances(z, z, np.inf)
+            in_z = z_distances < eps[:, np.newaxis]
+            in_x = np.abs(data[:, 0][:, np.newaxis] - data[:, 0][np.newaxis, :]) < eps[:, np.newaxis]
+            in_y = np.abs(data[:, 1][:, np.newaxis] - data[:, 1][np.newaxis, :]) < eps[:, np.newaxis]
+
+            assert np.all(count_z == in_z.sum(axis=1))
+            assert np.all(count_xz == (in_z & in_x).sum(axis=1))
+            assert np.all(count_yz == (in_z & in_y).sum(axis=1))
+
+    with pytest.raises(ValueError):
+        tree.count_ball_subspaces(count_df, "x", "y", eps[:10])
+
+def test_kdtree_query_approximate():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    tree = pbn.KDTree(df, leafsize=4)
+
+    # The Chebyshev distances are computed without rounding errors, so the exact search matches brute force bit for bit.
+    distances, _ = tree.query(test_df, k=5, p=np.inf, eps=0)
+    brute = np.sort(brute_force_distances(df.to_numpy(), test_df.to_numpy(), np.inf), axis=1)[:, :5]
+    assert np.all(distances == brute.T)
+
+    for p in [1, 2, np.inf]:
+        exact_distances, exact_indices = tree.query(test_df, k=5, p=p)
+        zero_distances, zero_indices = tree.query(test_df, k=5, p=p, eps=0.)
+        assert np.all(exact_distances == zero_distances)
+        assert np.all(exact_indices == zero_indices)
+
+        for eps in [0.1, 0.5, 2.]:
+            check_knn(tree, df, test_df, 5, p, eps=eps)
+            approximate_distances, _ = tree.query(test_df, k=5, p=p, eps=eps)
+            assert np.all(approximate_distances >= exact_distances * (1 - 1e-12))
+            assert np.all(approximate_distances <= (1 + eps) * exact_distances * (1 + 1e-12))
+
+def test_kdtree_query_num_threads():
+    # The test points are split in blocks of 64 rows among the threads, so the test covers several blocks.
+    test_df = util_test.generate_normal_data(1000, seed=2)
+    for train_df, test_data in [(df, test_df), (df_float, test_df.astype('float32'))]:
+        tree = pbn.KDTree(train_df, leafsize=8)
+        for p in [1, 2, np.inf]:
+            serial_distances, serial_indices = tree.query(test_data, k=6, p=p)
+            for num_threads in [2, 3, 0]:
+                distances, indices = tree.query(test_data, k=6, p=p, num_threads=num_threads)
+                assert np.all(distances == serial_distances)
+                assert np.all(indices == serial_indices)
+
+    eps = np.full(SIZE, 0.5)
+    tree = pbn.KDTree(df[["c", "d"]])
+    serial = tree.count_ball_subspaces(df, "a", "b", eps)
+    for num_threads in [2, 0]:
+        for serial_counts, counts in zip(serial, tree.count_ball_subspaces(df, "a", "b", eps, num_threads=num_threads)):
+            assert np.all(serial_counts == counts)
@@ -1,3 +1,4 @@
+import pickle
 import numpy as np
 import pandas as pd
 import pyarrow as pa
@@ -156,6 +157,33 @@ def test_lg_logl_null():
                         cpd2.logl(test_df), equal_nan=True)),\
                      "The order of the evidence changes the logl() result."
 
+def test_lg_logl_out():
+    test_df = util_test.generate_normal_data(5000)
+    test_df_float = test_df.astype('float32')
+
+    cpd = pbn.LinearGaussianCPD('d', ['a', 'b', 'c'])
+    cpd.fit(df)
+
+    out = np.empty(5000)
+    assert cpd.logl(test_df, out=out) is out
+    assert np.allclose(out, cpd.logl(test_df))
+
+    out_float = np.empty(5000)
+    cpd.logl(test_df_float, out=out_float)
+    assert np.allclose(out_float, cpd.logl(test_df_float))
+
+    df_null = test_df.copy()
+    df_null.loc[df_null.index[:10], 'a'] = np.nan
+    out_null = np.empty(5000)
+    cpd.logl(df_null, out=out_null)
+    assert np.all(np.isnan(out_null[:10]))
+    assert np.allclose(out_null[10:], out[10:])
+
+    with pytest.raises(ValueError):
+        cpd.logl(test_df, out=np.empty(4999))
+    with pytest.raises(TypeError):
+        cpd.logl(test_df, out=np.empty(5000, dtype=np.float32))
+
 def test_lg_slogl():
     test_df = util_test.generate_normal_data(5000)
 
@@ -208,6 +236,28 @@ def test_lg_slogl_null():
 
     assert np.all(np.isclose(cpd.slogl(df_null), cpd2.slogl(df_null))), "The order of the evidence changes the slogl() result."
 
+def test_lg_logl_many_evidence():
+    rng = np.random.default_rng(0)
+    columns = ['x' + str(i) for i in range(12)]
+    test_df = pd.DataFrame(rng.normal(size=(3000, len(columns))), columns=columns)
+    test_df_null = test_df.copy()
+    test_df_null.loc[test_df_null.sample(frac=0.1, random_state=0).index, 'x5'] = np.nan
+
+    # The logl is specialized for each number of evidence variables up to 8.
+    for num_evidence in [4, 8, 9, 11]:
+        variable = columns[-1]
+        evidence = columns[:num_evidence]
+        beta = rng.normal(size=(num_evidence + 1,))
+        variance = 1.5
+        cpd = pbn.LinearGaussianCPD(variable, evidence, beta, variance)
+
+        for _df in [test_df, test_df_null]:
+            expected = numpy_logpdf(_df, variable, evidence, beta, variance)
+            logl = cpd.logl(_df)
+            assert np.all(np.isnan(logl) == np.isnan(expected))
+            assert np.allclose(logl, expected, equal_nan=True)
+            assert np.isclose(cpd.slogl(_df), np.nansum(expected))
+
 def test_lg_cdf():
     test_df = util_test.generate_normal_data(5000)
 
@@ -294,4 +344,133 @@ def test_lg_sample():
     sampled = cpd.sample(SAMPLE_SIZE, sampling_df, 0)
 
     assert sampled.type == pa.float64()
-    assert int(sampled.nbytes / (sampled.type.bit_width / 8)) == SAMPLE_SIZE
\ No newline at end of file
+    assert int(sampled.nbytes / (sampled.type.bit_width / 8)) == SAMPLE_SIZE
+
+def test_lg_sample_counter_based():
+    cpd = pbn.LinearGaussianCPD('a', [])
+    cpd.fit(df)
+
+    sampled = cpd.sample(100000, None, 0).to_numpy()
+    assert np.isclose(sampled.mean(), cpd.beta[0], atol=0.01)
+    assert np.isclose(sampled.var(), cpd.variance, rtol=0.02)
+
+    # The value of each row only depends on the seed and the row index.
+    assert np.all(cpd.sample(1000, None, 0).to_numpy() == sampled[:1000])
+    assert not np.all(cpd.sample(1000, None, 1).to_numpy() == sampled[:1000])
+
+def test_lg_partial_fit():
+    batches = [df.iloc[:3000], df.iloc[3000:3001], df.iloc[3001:7000], df.iloc[7000:]]
+    for variable, evidence in [("a", []), ("b", ["a"]), ("c", ["a", "b"]), ("d", ["a", "b", "c"])]:
+        cpd = pbn.LinearGaussianCPD(variable, evidence)
+        for batch in batches:
+            cpd.partial_fit(batch)
+        assert cpd.fitted()
+
+        npbeta, npvar = fit_numpy(df, variable, evidence)
+        assert np.all(np.isclose(npbeta, cpd.beta)), "Wrong beta vector."
+        assert np.all(np.isclose(npvar, cpd.variance)), "Wrong variance."
+
+        # The sufficient statistics are pickled, so the updates continue after loading the factor.
+        loaded = pickle.loads(pickle.dumps(pbn.LinearGaussianCPD(variable, evidence)))
+        loaded.partial_fit(df.iloc[:5000])
+        loaded = pickle.loads(pickle.dumps(loaded))
+        loaded.partial_fit(df.iloc[5000:])
+        assert np.all(np.isclose(npbeta, loaded.beta))
+        assert np.all(np.isclose(npvar, loaded.variance))
+
+    # With forgetting, the fit is a weighted least squares where each batch multiplies the weights of the previous one.
+    forgetting = 0.5
+    cpd = pbn.LinearGaussianCPD("c", ["a", "b"])
+    cpd.partial_fit(df.iloc[:5000])
+    cpd.partial_fit(df.iloc[5000:], forgetting)
+
+    weights = np.where(np.arange(SIZE) < 5000, forgetting, 1.)
+    design = np.column_stack((np.ones(SIZE), df.loc[:, ["a", "b"]]))
+    sqrt_weights = np.sqrt(weights)
+    beta, res, _, _ = np.linalg.lstsq(design * sqrt_weights[:, None], df["c"] * sqrt_weights, rcond=None)
+    assert np.all(np.isclose(beta, cpd.beta))
+    assert np.isclose(res / (weights.sum() - 3), cpd.variance)
+
+    fitted = pbn.LinearGaussianCPD("c", ["a", "b"])
+    fitted.fit(df)
+    with pytest.raises(ValueError) as ex:
+        fitted.partial_fit(df)
+    assert "does not have sufficient statistics" in str(ex.value)
+
+    with pytest.raises(ValueError) as ex:
+        cpd.partial_fit(df, 0)
+    assert "forgetting factor" in str(ex.value)
+
+def test_lg_weighted_fit():
+    np.random.seed(0)
+    weights = np.random.randint(0, 4, size=SIZE).astype(float)
+    # An integer weight is equivalent to repeating the row.
+    repeated = df.iloc[np.repeat(np.arange(SIZE), weights.astype(int))]
+
+    for variable, evidence in [("a", []), ("b", ["a"]), ("c", ["a", "b"]), ("d", ["a", "b", "c"])]:
+        weighted = pbn.LinearGaussianCPD(variable, evidence)
+        weighted.weighted_fit(df, weights)
+        assert weighted.fitted()
+
+        fitted = pbn.LinearGaussianCPD(variable, evidence)
+        fitted.fit(repeated)
+        assert np.all(np.isclose(weighted.beta, fitted.beta))
+        assert np.isclose(weighted.variance, fitted.variance)
+
+    df_null = df.copy()
+    df_null.loc[df_null.sample(frac=0.1, random_state=0).index, "a"] = np.nan
+    weighted = pbn.LinearGaussianCPD("c", ["a", "b"])
+    weighted.weighted_fit(df_null, weights)
+    fitted = pbn.LinearGaussianCPD("c", ["a", "b"])
+    fitted.fit(df_null.iloc[np.repeat(np.arange(SIZE), weights.astype(int))])
+    assert np.all(np.isclose(weighted.beta, fitted.beta))
+    assert np.isclose(weighted.variance, fitted.variance)
+
+    with pytest.raises(ValueError) as ex:
+        weighted.weighted_fit(df, weights[:10])
+    assert "number of weights" in str(ex.value)
+
+    with pytest.raises(ValueError) as ex:
+        weighted.weighted_fit(df, -weights)
+    assert "non-negative" in str(ex.value)
+
+def test_lg_memory_usage():
+    cpd = pbn.LinearGaussianCPD('c', ['a', 'b'])
+    assert cpd.memory_usage().total_bytes == 0
+
+    cpd.fit(df)
+    usage = cpd.memory_usage()
+    assert usage.components()['beta'] == (3 * 8, 0)
+    assert usage.device_bytes == 0
+    assert usage.host_bytes == sum(host for host, _ in usage.components().values())
+
+    bn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'], [('a', 'c'), ('b', 'c')])
+    bn.fit(df)
+    components = bn.memory_usage().components()
+    assert components['cpd:c.beta'] == (3 * 8, 0)
+    assert components['cpd:a.beta'] == (8, 0)
+
+def test_clg_configurations():
+    hybrid_df = util_test.generate_hybrid_data(SIZE)
+    clg = pbn.CLinearGaussianCPD('D', ['A', 'B', 'C'])
+    clg.fit(hybrid_df)
+
+    # The factors of the configurations are fitted and evaluated concurrently, and each row is evaluated with the
+    # factor of its configuration.
+    expected = np.empty(SIZE)
+    expected_slogl = 0
+    for a in ['a1', 'a2']:
+        for b in ['b1', 'b2', 'b3']:
+            indices = np.logical_and(hybrid_df['A'] == a, hybrid_df['B'] == b).to_numpy()
+            lg = pbn.LinearGaussianCPD('D', ['C'])
+            lg.fit(hybrid_df[indices])
+
+            factor = clg.conditional_factor(pbn.Assignment({'A': a, 'B': b}))
+            assert np.allclose(factor.beta, lg.beta)
+            assert np.isclose(factor.variance, lg.variance)
+
+            expected[indices] = lg.logl(hybrid_df[indices])
+            expected_slogl += lg.slogl(hybrid_df[indices])
+
+    assert np.allclose(clg.logl(hybrid_df), expected)
+    assert np.isclose(clg.slogl(hybrid_df), expected_slogl)
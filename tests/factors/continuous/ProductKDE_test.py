@@ -1,6 +1,7 @@
 import pytest
 import numpy as np
 import pyarrow as pa
+import pickle
 import pybnesian as pbn
 from pybnesian import BandwidthSelector
 from scipy.stats import gaussian_kde
@@ -363,3 +364,27 @@ def test_productkde_slogl_null():
     cpd2 = pbn.ProductKDE(['a', 'c', 'd', 'b'])
     cpd2.fit(df_float)
     assert np.all(np.isclose(cpd.slogl(df_null_float), cpd2.slogl(df_null_float), atol=0.0005)), "Order of evidence changes slogl() result."
+
+def test_productkde_binned():
+    test_df = util_test.generate_normal_data(50, seed=1)
+    # An instance far from the training data is evaluated exactly.
+    test_df.loc[test_df.index[0], 'a'] = 1000
+
+    for variables in [['a'], ['b', 'a']]:
+        cpd = pbn.ProductKDE(variables)
+        cpd.fit(df)
+        binned = pbn.ProductKDE(variables, binned_grid_size=401)
+        binned.fit(df)
+
+        assert binned.binned_grid_size == 401
+        assert np.all(np.isclose(binned.bandwidth, cpd.bandwidth))
+        assert np.all(np.isclose(binned.logl(test_df), cpd.logl(test_df), atol=0.01))
+        assert np.isclose(binned.slogl(test_df), cpd.slogl(test_df), rtol=1e-3)
+
+        binned2 = pickle.loads(pickle.dumps(binned))
+        assert binned2.binned_grid_size == 401
+        assert np.all(np.isclose(binned2.logl(test_df), binned.logl(test_df)))
+
+    with pytest.raises(ValueError) as ex:
+        pbn.ProductKDE(['a'], binned_grid_size=-1)
+    assert "must be non-negative" in str(ex.value)
@@ -1,4 +1,5 @@
 import pytest
+import pickle
 import numpy as np
 import pandas as pd
 import pyarrow as pa
@@ -35,3 +36,210 @@ def test_fit():
     # a = DiscreteFactor('C', ['A', 'B'])
     a = pbn.DiscreteFactor('C', [])
     a.fit(df)
+
+def test_logl():
+    a = pbn.DiscreteFactor('C', ['A', 'B'])
+    a.fit(df)
+
+    joint = df.groupby(['A', 'B', 'C'], observed=True).size()
+    parents = df.groupby(['A', 'B'], observed=True).size()
+    expected = np.log(np.asarray([joint[(r.A, r.B, r.C)] / parents[(r.A, r.B)] for r in df.itertuples()]))
+
+    assert np.allclose(a.logl(df), expected)
+    assert np.isclose(a.slogl(df), expected.sum())
+
+    df_null = df.copy()
+    null_rows = df_null.sample(frac=0.1, random_state=0).index
+    df_null.loc[null_rows, 'A'] = np.nan
+    expected[df_null.index.isin(null_rows)] = np.nan
+
+    logl = a.logl(df_null)
+    assert np.all(np.isnan(logl) == np.isnan(expected))
+    assert np.allclose(logl, expected, equal_nan=True)
+    assert np.isclose(a.slogl(df_null), np.nansum(expected))
+
+def test_sparse_configurations():
+    np.random.seed(0)
+    size = 5000
+    # 50^3 parent configurations are stored sparsely.
+    categories = np.asarray(["v" + str(i) for i in range(50)])
+    sparse_df = pd.DataFrame({
+        p: pd.Categorical(categories[np.random.randint(50, size=size)], categories=categories)
+        for p in ['A', 'B', 'C']
+    })
+    sparse_df['D'] = pd.Categorical(np.where(np.random.rand(size) < 0.7, "d1", "d2"), categories=["d1", "d2"])
+
+    fitted = pbn.DiscreteFactor('D', ['A', 'B', 'C'])
+    fitted.fit(sparse_df)
+
+    joint = sparse_df.groupby(['A', 'B', 'C', 'D'], observed=True).size()
+    parents = sparse_df.groupby(['A', 'B', 'C'], observed=True).size()
+    expected = np.log(np.asarray([joint[(r.A, r.B, r.C, r.D)] / parents[(r.A, r.B, r.C)]
+                                  for r in sparse_df.itertuples()]))
+
+    assert np.allclose(fitted.logl(sparse_df), expected)
+    assert np.isclose(fitted.slogl(sparse_df), expected.sum())
+
+    # The parent configurations without data have a uniform distribution.
+    observed = set(parents.index)
+    unseen = next((a, b, c) for a in categories for b in categories for c in categories if (a, b, c) not in observed)
+    unseen_df = sparse_df.iloc[:1].copy()
+    unseen_df['A'], unseen_df['B'], unseen_df['C'] = unseen
+    assert np.allclose(fitted.logl(unseen_df), np.log(0.5))
+
+    loaded = pickle.loads(pickle.dumps(fitted))
+    assert np.allclose(loaded.logl(sparse_df), expected)
+    assert np.allclose(loaded.logl(unseen_df), np.log(0.5))
+
+    bde = pbn.BDe(sparse_df)
+    model = pbn.DiscreteBN(['A', 'B', 'C', 'D'], [('A', 'D'), ('B', 'D'), ('C', 'D')])
+    score = bde.local_score(model, 'D', ['A', 'B', 'C'])
+    assert np.isfinite(score)
+    assert np.isclose(score, bde.local_scores(model, 'D', [['A', 'B', 'C']])[0])
+
+def test_domain_checks():
+    a = pbn.DiscreteFactor('A', [])
+    a.fit(df)
+    assert list(a.sample(100, None, 0).to_pandas().cat.categories) == list(df['A'].cat.categories)
+
+    # The categories are extracted for each data, even if other data was validated before.
+    renamed = df.copy()
+    renamed['A'] = renamed['A'].cat.rename_categories(lambda c: c + "_renamed")
+    a.fit(renamed)
+    assert list(a.sample(100, None, 0).to_pandas().cat.categories) == list(renamed['A'].cat.categories)
+
+    numeric = df.copy()
+    numeric['A'] = numeric['A'].cat.rename_categories(range(len(numeric['A'].cat.categories)))
+    with pytest.raises(ValueError) as ex:
+        pbn.DiscreteFactor('C', ['A']).fit(numeric)
+    assert "must be of type string" in str(ex.value)
+
+def test_sample():
+    SAMPLE_SIZE = 20000
+    b = pbn.DiscreteFactor('B', ['A'])
+    b.fit(df)
+
+    parents = df.groupby(['A'], observed=True).size()
+    joint = df.groupby(['A', 'B'], observed=True).size()
+
+    evidence = pd.DataFrame({'A': pd.Categorical(np.where(np.arange(SAMPLE_SIZE) % 2 == 0, 'a1', 'a2'),
+                                                 categories=df['A'].cat.categories)})
+    sampled = b.sample(SAMPLE_SIZE, evidence, 0).to_pandas()
+    assert np.all(sampled == b.sample(SAMPLE_SIZE, evidence, 0).to_pandas())
+    assert not np.all(sampled == b.sample(SAMPLE_SIZE, evidence, 1).to_pandas())
+
+    for a in ['a1', 'a2']:
+        rows = (evidence['A'] == a).to_numpy()
+        for category in df['B'].cat.categories:
+            expected = joint.get((a, category), 0) / parents[a]
+            frequency = np.mean(sampled[rows] == category)
+            if expected == 0:
+                assert frequency == 0
+            else:
+                assert np.isclose(frequency, expected, atol=0.02)
+
+    # 300 categories without evidence.
+    categories = np.asarray(["v" + str(i) for i in range(300)])
+    weights = np.arange(1, 301) / np.arange(1, 301).sum()
+    many_df = pd.DataFrame({'V': pd.Categorical(categories[np.random.choice(300, size=50000, p=weights)],
+                                                categories=categories)})
+    v = pbn.DiscreteFactor('V', [])
+    v.fit(many_df)
+    sampled = v.sample(50000, None, 0).to_pandas()
+    frequencies = sampled.value_counts(normalize=True).reindex(categories, fill_value=0).to_numpy()
+    expected = many_df['V'].value_counts(normalize=True).reindex(categories, fill_value=0).to_numpy()
+    assert np.allclose(frequencies, expected, atol=0.005)
+    assert len(v.sample(0, None, 0)) == 0
+    # The value of each row only depends on the seed and the row index.
+    assert np.all(v.sample(1000, None, 0).to_pandas() == sampled[:1000])
+
+def test_partial_fit():
+    fitted = pbn.DiscreteFactor('C', ['A', 'B'])
+    fitted.fit(df)
+
+    updated = pbn.DiscreteFactor('C', ['A', 'B'])
+    for batch in [df.iloc[:2500], df.iloc[2500:2501], df.iloc[2501:8000], df.iloc[8000:]]:
+        updated.partial_fit(batch)
+    assert np.allclose(updated.logl(df), fitted.logl(df))
+
+    loaded = pickle.loads(pickle.dumps(updated))
+    loaded.partial_fit(df.iloc[:100])
+    updated.partial_fit(df.iloc[:100])
+    assert np.allclose(loaded.logl(df), updated.logl(df))
+
+    # The counts of the first batch are halved.
+    forgetting = 0.5
+    forgotten = pbn.DiscreteFactor('C', ['A', 'B'])
+    forgotten.partial_fit(df.iloc[:5000])
+    forgotten.partial_fit(df.iloc[5000:], forgetting)
+
+    weights = pd.Series(np.where(np.arange(df.shape[0]) < 5000, forgetting, 1.), index=df.index)
+    joint = weights.groupby([df['A'], df['B'], df['C']], observed=True).sum()
+    parents = weights.groupby([df['A'], df['B']], observed=True).sum()
+    expected = np.log(np.asarray([joint[(r.A, r.B, r.C)] / parents[(r.A, r.B)] for r in df.itertuples()]))
+    assert np.allclose(forgotten.logl(df), expected)
+
+    with pytest.raises(ValueError) as ex:
+        fitted.partial_fit(df)
+    assert "does not have sufficient statistics" in str(ex.value)
+
+    renamed = df.copy()
+    renamed['A'] = renamed['A'].cat.rename_categories(lambda c: c + "_renamed")
+    with pytest.raises(ValueError):
+        updated.partial_fit(renamed)
+
+def test_sparse_partial_fit():
+    np.random.seed(1)
+    size = 4000
+    categories = np.asarray(["v" + str(i) for i in range(50)])
+    sparse_df = pd.DataFrame({
+        p: pd.Categorical(categories[np.random.randint(50, size=size)], categories=categories)
+        for p in ['A', 'B', 'C']
+    })
+    sparse_df['D'] = pd.Categorical(np.where(np.random.rand(size) < 0.7, "d1", "d2"), categories=["d1", "d2"])
+
+    fitted = pbn.DiscreteFactor('D', ['A', 'B', 'C'])
+    fitted.fit(sparse_df)
+
+    # Each batch adds new parent configurations to the sparse factor.
+    updated = pbn.DiscreteFactor('D', ['A', 'B', 'C'])
+    for start in range(0, size, 1000):
+        updated.partial_fit(sparse_df.iloc[start:start + 1000])
+
+    assert np.allclose(updated.logl(sparse_df), fitted.logl(sparse_df))
+    assert np.allclose(pickle.loads(pickle.dumps(updated)).logl(sparse_df), fitted.logl(sparse_df))
+
+def test_weighted_fit():
+    np.random.seed(0)
+    weights = np.random.randint(0, 4, size=df.shape[0]).astype(float)
+    # An integer weight is equivalent to repeating the row.
+    repeated = df.iloc[np.repeat(np.arange(df.shape[0]), weights.astype(int))]
+
+    for variable, evidence in [('A', []), ('B', ['A']), ('C', ['A', 'B']), ('D', ['A', 'B', 'C'])]:
+        weighted = pbn.DiscreteFactor(variable, evidence)
+        weighted.weighted_fit(df, weights)
+        assert weighted.fitted()
+
+        fitted = pbn.DiscreteFactor(variable, evidence)
+        fitted.fit(repeated)
+        assert np.allclose(weighted.logl(df), fitted.logl(df))
+
+    np.random.seed(1)
+    size = 4000
+    categories = np.asarray(["v" + str(i) for i in range(50)])
+    sparse_df = pd.DataFrame({
+        p: pd.Categorical(categories[np.random.randint(50, size=size)], categories=categories)
+        for p in ['A', 'B', 'C']
+    })
+    sparse_df['D'] = pd.Categorical(np.where(np.random.rand(size) < 0.7, "d1", "d2"), categories=["d1", "d2"])
+    sparse_weights = np.random.randint(1, 4, size=size).astype(float)
+
+    weighted = pbn.DiscreteFactor('D', ['A', 'B', 'C'])
+    weighted.weighted_fit(sparse_df, sparse_weights)
+    fitted = pbn.DiscreteFactor('D', ['A', 'B', 'C'])
+    fitted.fit(sparse_df.iloc[np.repeat(np.arange(size), sparse_weights.astype(int))])
+    assert np.allclose(weighted.logl(sparse_df), fitted.logl(sparse_df))
+
+    with pytest.raises(ValueError) as ex:
+        weighted.weighted_fit(sparse_df, sparse_weights[:10])
+    assert "number of weights" in str(ex.value)
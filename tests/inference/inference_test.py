@@ -0,0 +1,242 @@
+import itertools
+import pytest
+import numpy as np
+import pandas as pd
+import pybnesian as pbn
+import util_test
+
+discrete_df = util_test.generate_discrete_data_dependent(10000)
+gaussian_df = util_test.generate_normal_data(10000)
+
+def discrete_model():
+    model = pbn.DiscreteBN(['A', 'B', 'C', 'D'], [('A', 'B'), ('A', 'C'), ('B', 'C'), ('C', 'D')])
+    model.fit(discrete_df)
+    return model
+
+def joint_table(model):
+    categories = [discrete_df[n].cat.categories for n in model.nodes()]
+    configurations = list(itertools.product(*categories))
+    table = pd.DataFrame({n: pd.Categorical([c[i] for c in configurations], categories=categories[i])
+                          for i, n in enumerate(model.nodes())})
+    table['p'] = np.exp(model.logl(table))
+    return table
+
+def brute_force(table, variables, evidence):
+    selected = table
+    for k, v in evidence.items():
+        selected = selected[selected[k] == v]
+    posterior = selected.groupby(variables, observed=False)['p'].sum()
+    return (posterior / posterior.sum()).to_numpy()
+
+def test_discrete_inference():
+    model = discrete_model()
+    table = joint_table(model)
+    inference = pbn.DiscreteInference(model)
+
+    assert sorted(inference.nodes()) == ['A', 'B', 'C', 'D']
+    assert inference.categories('B') == ['b1', 'b2', 'b3']
+    assert all(set(c) <= {'A', 'B', 'C', 'D'} for c in inference.cliques())
+
+    for evidence in [{}, {'D': 'd1'}, {'A': 'a2', 'D': 'd3'}]:
+        for v in ['A', 'B', 'C', 'D']:
+            assert np.allclose(inference.marginal(v, evidence), brute_force(table, [v], evidence))
+
+    joint = inference.query(['B', 'C'], {'D': 'd2'})
+    assert joint.shape == (3, 2)
+    # The first dimension is the first variable of the query.
+    expected = brute_force(table, ['B', 'C'], {'D': 'd2'}).reshape(3, 2)
+    assert np.allclose(joint, expected)
+    assert np.isclose(joint.sum(), 1)
+
+    with pytest.raises(ValueError) as ex:
+        inference.marginal('A', {'D': 'd5'})
+    assert "is not a category" in str(ex.value)
+
+    with pytest.raises(ValueError):
+        inference.query(['Z'])
+
+    gbn = pbn.GaussianNetwork(['a', 'b'], [('a', 'b')])
+    gbn.fit(gaussian_df)
+    with pytest.raises(ValueError):
+        pbn.DiscreteInference(gbn)
+
+def test_discrete_inference_batch():
+    model = discrete_model()
+    table = joint_table(model)
+    inference = pbn.DiscreteInference(model)
+
+    evidence = discrete_df[['A', 'D']].iloc[:50].copy()
+    evidence.loc[evidence.index[:10], 'D'] = np.nan
+    evidence.loc[evidence.index[5:15], 'A'] = np.nan
+
+    posterior = inference.query_batch(['B', 'C'], evidence)
+    assert posterior['B'].shape == (50, 3)
+    assert posterior['C'].shape == (50, 2)
+
+    for i in range(50):
+        row = {k: v for k, v in evidence.iloc[i].items() if not pd.isna(v)}
+        assert np.allclose(posterior['B'][i], brute_force(table, ['B'], row))
+        assert np.allclose(posterior['C'][i], brute_force(table, ['C'], row))
+
+def test_gaussian_inference():
+    model = pbn.GaussianNetwork([('a', 'b'), ('a', 'c'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    model.fit(gaussian_df)
+    inference = pbn.GaussianInference(model)
+
+    # Moment form of the joint Gaussian from the CPDs.
+    nodes = ['a', 'b', 'c', 'd']
+    B = np.zeros((4, 4))
+    beta0 = np.zeros(4)
+    variance = np.zeros(4)
+    for i, n in enumerate(nodes):
+        cpd = model.cpd(n)
+        beta0[i] = cpd.beta[0]
+        variance[i] = cpd.variance
+        for k, e in enumerate(cpd.evidence()):
+            B[i, nodes.index(e)] = cpd.beta[k + 1]
+
+    inv = np.linalg.inv(np.eye(4) - B)
+    mu = inv @ beta0
+    sigma = inv @ np.diag(variance) @ inv.T
+
+    mean, cov = inference.query(['d', 'b'])
+    assert np.allclose(mean, mu[[3, 1]])
+    assert np.allclose(cov, sigma[np.ix_([3, 1], [3, 1])])
+
+    q, e = [0, 3], [1, 2]
+    gain = sigma[np.ix_(q, e)] @ np.linalg.inv(sigma[np.ix_(e, e)])
+    expected_cov = sigma[np.ix_(q, q)] - gain @ sigma[np.ix_(e, q)]
+
+    values = np.asarray([2.5, 1.0])
+    mean, cov = inference.query(['a', 'd'], {'b': values[0], 'c': values[1]})
+    assert np.allclose(mean, mu[q] + gain @ (values - mu[e]))
+    assert np.allclose(cov, expected_cov)
+
+    evidence = gaussian_df[['b', 'c']].iloc[:100]
+    means, batch_cov = inference.query_batch(['a', 'd'], evidence)
+    assert means.shape == (100, 2)
+    assert np.allclose(means, mu[q] + (evidence.to_numpy() - mu[e]) @ gain.T)
+    assert np.allclose(batch_cov, expected_cov)
+
+    with pytest.raises(ValueError) as ex:
+        inference.query(['b'], {'b': 0.})
+    assert "both in the query and the evidence" in str(ex.value)
+
+    with pytest.raises(ValueError):
+        pbn.GaussianInference(discrete_model())
+
+def test_gaussian_inference_joint():
+    model = pbn.GaussianNetwork(['d', 'c', 'b', 'a'], [('a', 'b'), ('a', 'c'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    model.fit(gaussian_df)
+    inference = pbn.GaussianInference(model)
+
+    # The nodes are not in topological order.
+    nodes = inference.nodes()
+    samples = model.sample(200000, 0).to_pandas()[nodes].to_numpy()
+    assert np.allclose(inference.mean(), samples.mean(axis=0), atol=0.05)
+    assert np.allclose(inference.covariance(), np.cov(samples, rowvar=False), rtol=0.05, atol=0.05)
+
+    mu, sigma = inference.mean(), inference.covariance()
+    q = [nodes.index('a'), nodes.index('d')]
+    e = [nodes.index('c'), nodes.index('b')]
+    gain = sigma[np.ix_(q, e)] @ np.linalg.inv(sigma[np.ix_(e, e)])
+    cov = sigma[np.ix_(q, q)] - gain @ sigma[np.ix_(e, q)]
+
+    test_df = gaussian_df.iloc[:100]
+    logl = inference.conditional_logl(['a', 'd'], test_df[['c', 'a', 'b', 'd']])
+    residuals = test_df[['a', 'd']].to_numpy() - (mu[q] + (test_df[['c', 'b']].to_numpy() - mu[e]) @ gain.T)
+    expected = -0.5 * (2 * np.log(2 * np.pi) + np.log(np.linalg.det(cov)) +
+                       np.sum(residuals @ np.linalg.inv(cov) * residuals, axis=1))
+    assert np.allclose(logl, expected)
+
+    # Without evidence, the conditional density is the marginal density of the model.
+    assert np.allclose(inference.conditional_logl(nodes, test_df), model.logl(test_df))
+
+    # The decomposition of the covariance of the evidence is reused for the same evidence variables in any order.
+    pbn.reset_profiler()
+    pbn.enable_profiler()
+    try:
+        m1, c1 = inference.query(['a', 'd'], {'b': 0.5, 'c': 1.})
+        m2, c2 = inference.query(['d'], {'c': 1., 'b': 0.5})
+        inference.query_batch(['a'], test_df[['b', 'c']])
+    finally:
+        pbn.disable_profiler()
+
+    stats = pbn.profiler_stats()
+    pbn.reset_profiler()
+    assert stats["gaussian_inference:llt_hit"].calls == 3
+    assert np.isclose(m2[0], m1[1])
+    assert np.isclose(c2[0, 0], c1[1, 1])
+
+def test_importance_sampling():
+    model = pbn.GaussianNetwork([('a', 'b'), ('a', 'c'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    model.fit(gaussian_df)
+    exact_mean, _ = pbn.GaussianInference(model).query(['a', 'd'], {'c': 1.0})
+
+    evidence = pd.DataFrame({'c': [1.0]})
+    sampler = pbn.ImportanceSampling(model)
+    assert sampler.likelihood_weighting
+
+    samples, log_weights = sampler.sample(50000, evidence, seed=0, num_threads=2)
+    samples = samples.to_pandas()
+    assert set(samples.columns) == {'a', 'b', 'd'}
+    weights = np.exp(log_weights - log_weights.max())
+    assert np.allclose([np.average(samples['a'], weights=weights), np.average(samples['d'], weights=weights)],
+                       exact_mean, atol=0.1)
+
+    # The samples do not depend on the number of threads.
+    same_samples, same_log_weights = sampler.sample(50000, evidence, seed=0, num_threads=1)
+    assert np.allclose(same_log_weights, log_weights)
+    assert np.allclose(same_samples.to_pandas()['a'], samples['a'])
+
+    # With a copy of the model as proposal, importance sampling is equal to likelihood weighting.
+    proposal = pbn.ImportanceSampling(model, model.clone())
+    assert not proposal.likelihood_weighting
+    assert np.allclose(proposal.sample(1000, evidence, seed=0)[1], log_weights[:1000])
+
+    stream = sampler.stream(evidence, batch_size=1000, min_ess=2000, seed=0)
+    batches = list(stream)
+    assert stream.effective_sample_size >= 2000
+    assert stream.num_samples == 1000 * len(batches)
+
+    with pytest.raises(ValueError) as ex:
+        sampler.sample(10, pd.DataFrame({'c': [1.0, 2.0]}))
+    assert "exactly one row" in str(ex.value)
+
+def test_importance_sampling_discrete_evidence():
+    model = discrete_model()
+    sampler = pbn.ImportanceSampling(model)
+    exact = pbn.DiscreteInference(model).marginal('A', {'D': 'd3'})
+
+    # A Categorical of one row only contains its own category, so its index 0 is the index 2 of the model.
+    evidence = pd.DataFrame({'D': pd.Categorical(['d3'])})
+    samples, log_weights = sampler.sample(50000, evidence, seed=0)
+    samples = samples.to_pandas()
+    weights = np.exp(log_weights - log_weights.max())
+    posterior = [weights[(samples['A'] == a).to_numpy()].sum() / weights.sum() for a in ['a1', 'a2']]
+    assert np.allclose(posterior, exact, atol=0.02)
+
+    full_evidence = pd.DataFrame({'D': pd.Categorical(['d3'], categories=discrete_df['D'].cat.categories)})
+    full_samples, full_log_weights = sampler.sample(50000, full_evidence, seed=0)
+    assert np.all(full_log_weights == log_weights)
+    assert full_samples.to_pandas().equals(samples)
+
+    hybrid_df = util_test.generate_hybrid_data(10000)
+    clg = pbn.CLGNetwork([('A', 'C'), ('A', 'D'), ('B', 'D'), ('C', 'D')])
+    clg.fit(hybrid_df)
+    clg_sampler = pbn.ImportanceSampling(clg)
+
+    single = pd.DataFrame({'B': pd.Categorical(['b3']), 'D': [1.0]})
+    full = pd.DataFrame({'B': pd.Categorical(['b3'], categories=hybrid_df['B'].cat.categories), 'D': [1.0]})
+    single_samples, single_log_weights = clg_sampler.sample(5000, single, seed=0)
+    full_samples, full_log_weights = clg_sampler.sample(5000, full, seed=0)
+    assert np.all(single_log_weights == full_log_weights)
+    assert single_samples.to_pandas().equals(full_samples.to_pandas())
+
+    with pytest.raises(ValueError) as ex:
+        sampler.sample(10, pd.DataFrame({'D': pd.Categorical(['d5'])}))
+    assert "is not a category" in str(ex.value)
+
+    with pytest.raises(ValueError) as ex:
+        sampler.sample(10, pd.DataFrame({'D': ['d3']}))
+    assert "must be categorical" in str(ex.value)
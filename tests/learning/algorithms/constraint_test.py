@@ -1,4 +1,12 @@
+import numpy as np
+import pandas as pd
+import pytest
+import pybnesian as pbn
 from pybnesian import PartiallyDirectedGraph, MeekRules
+import util_test
+
+SIZE = 10000
+df = util_test.generate_normal_data(SIZE)
 
 def test_meek_rule1():
     # From Koller Chapter 3.4, Figure 3.12, pag 89.
@@ -41,4 +49,675 @@ def test_meek_sequential():
         changed = changed or MeekRules.rule3(koller)
 
     assert set(koller.edges()) == set([('A', 'B'), ('B', 'D')])
-    assert set(koller.arcs()) == set([('B', 'E'), ('C', 'E'), ('E', 'F'), ('C', 'F'), ('F', 'G')])
\ No newline at end of file
+    assert set(koller.arcs()) == set([('B', 'E'), ('C', 'E'), ('E', 'F'), ('C', 'F'), ('F', 'G')])
+
+def test_meek_apply():
+    for num_threads in [1, 2]:
+        # From Koller Chapter 3.4, Figure 3.13, pag 90.
+        koller = PartiallyDirectedGraph(["A", "B", "C", "D", "E", "F", "G"],
+                                        [("B", "E"), ("C", "E")],
+                                        [("A", "B"), ("B", "D"), ("C", "F"), ("E", "F"), ("F", "G")])
+
+        assert MeekRules.apply(koller, num_threads=num_threads)
+        assert set(koller.edges()) == set([('A', 'B'), ('B', 'D')])
+        assert set(koller.arcs()) == set([('B', 'E'), ('C', 'E'), ('E', 'F'), ('C', 'F'), ('F', 'G')])
+        assert not MeekRules.apply(koller, num_threads=num_threads)
+
+    # The rule chains propagate through the worklist.
+    chain = PartiallyDirectedGraph(["A", "B", "C", "D", "E"], [("A", "B")], [("B", "C"), ("C", "D"), ("D", "E")])
+    assert MeekRules.apply(chain)
+    assert chain.num_edges() == 0
+    assert set(chain.arcs()) == set([('A', 'B'), ('B', 'C'), ('C', 'D'), ('D', 'E')])
+
+def test_mmpc_num_threads():
+    lc = pbn.LinearCorrelation(df)
+    mmpc = pbn.MMPC()
+
+    serial = mmpc.estimate(lc)
+    for num_threads in [2, 4, 0]:
+        parallel = mmpc.estimate(lc, num_threads=num_threads)
+        assert set(serial.arcs()) == set(parallel.arcs())
+        assert set(serial.edges()) == set(parallel.edges())
+
+    column_names = list(df.columns.values)
+    serial = mmpc.estimate_conditional(lc, column_names[2:], column_names[:2])
+    parallel = mmpc.estimate_conditional(lc, column_names[2:], column_names[:2], num_threads=4)
+    assert set(serial.arcs()) == set(parallel.arcs())
+    assert set(serial.edges()) == set(parallel.edges())
+
+def test_mmpc_lazy():
+    lc = pbn.LinearCorrelation(df)
+    mmpc = pbn.MMPC()
+
+    # The lazy forward phase adds the same variables to the CPCs.
+    eager = mmpc.estimate(lc)
+    lazy = mmpc.estimate(lc, lazy=True)
+    assert set(eager.arcs()) == set(lazy.arcs())
+    assert set(eager.edges()) == set(lazy.edges())
+
+    column_names = list(df.columns.values)
+    eager = mmpc.estimate_conditional(lc, column_names[2:], column_names[:2])
+    lazy = mmpc.estimate_conditional(lc, column_names[2:], column_names[:2], lazy=True, num_threads=2)
+    assert set(eager.arcs()) == set(lazy.arcs())
+    assert set(eager.edges()) == set(lazy.edges())
+
+def test_mmhc_num_threads():
+    lc = pbn.LinearCorrelation(df)
+    bic = pbn.BIC(df)
+    arc_set = pbn.ArcOperatorSet()
+    mmhc = pbn.MMHC()
+
+    serial = mmhc.estimate(lc, arc_set, bic)
+    parallel = mmhc.estimate(lc, arc_set, bic, num_threads=4)
+    assert set(serial.arcs()) == set(parallel.arcs())
+
+def test_mmhc_start():
+    lc = pbn.LinearCorrelation(df)
+    bic = pbn.BIC(df)
+    arc_set = pbn.ArcOperatorSet()
+    mmhc = pbn.MMHC()
+
+    previous = mmhc.estimate(lc, arc_set, bic)
+
+    # The skeleton of the previous model is verified with the same data, so the search finds the same structure.
+    warm = mmhc.estimate(lc, arc_set, bic, start=previous)
+    assert set(previous.arcs()) == set(warm.arcs())
+
+    # The spurious arcs of the start model are removed by MMPC.
+    indep_df = util_test.generate_normal_data_indep(SIZE)
+    indep_lc = pbn.LinearCorrelation(indep_df)
+    indep_bic = pbn.BIC(indep_df)
+    spurious = pbn.GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("a", "c"), ("b", "c"), ("c", "d")])
+    repaired = mmhc.estimate(indep_lc, arc_set, indep_bic, start=spurious)
+    assert not repaired.has_arc("a", "b") and not repaired.has_arc("b", "a")
+
+    column_names = list(df.columns.values)
+    previous = mmhc.estimate_conditional(lc, arc_set, bic, column_names[2:], column_names[:2])
+    warm = mmhc.estimate_conditional(lc, arc_set, bic, column_names[2:], column_names[:2], start=previous)
+    assert set(previous.arcs()) == set(warm.arcs())
+
+def test_dmmhc_num_threads():
+    ddf = pbn.DynamicDataFrame(df, 2)
+    dlc = pbn.DynamicLinearCorrelation(ddf)
+    dbic = pbn.DynamicBIC(ddf)
+    arc_set = pbn.ArcOperatorSet()
+    dmmhc = pbn.DMMHC()
+
+    # The static and transition skeletons are searched at the same time.
+    serial = dmmhc.estimate(dlc, arc_set, dbic, markovian_order=2)
+    parallel = dmmhc.estimate(dlc, arc_set, dbic, markovian_order=2, num_threads=4)
+    assert set(serial.static_bn().arcs()) == set(parallel.static_bn().arcs())
+    assert set(serial.transition_bn().arcs()) == set(parallel.transition_bn().arcs())
+
+def test_pc_num_threads():
+    lc = pbn.LinearCorrelation(df)
+    pc = pbn.PC()
+
+    serial = pc.estimate(lc)
+    for num_threads in [2, 4, 0]:
+        parallel = pc.estimate(lc, num_threads=num_threads)
+        assert set(serial.arcs()) == set(parallel.arcs())
+        assert set(serial.edges()) == set(parallel.edges())
+
+    column_names = list(df.columns.values)
+    serial = pc.estimate_conditional(lc, column_names[2:], column_names[:2], use_sepsets=True)
+    parallel = pc.estimate_conditional(lc, column_names[2:], column_names[:2], use_sepsets=True, num_threads=4)
+    assert set(serial.arcs()) == set(parallel.arcs())
+    assert set(serial.edges()) == set(parallel.edges())
+
+def test_dynamic_linear_correlation_lagged():
+    ddf = pbn.DynamicDataFrame(df, 3)
+    dlc = pbn.DynamicLinearCorrelation(ddf)
+
+    transition = pbn.LinearCorrelation(ddf.transition_df())
+    static = pbn.LinearCorrelation(ddf.static_df())
+
+    tests = [("a_t_0", "b_t_1"), ("a_t_0", "a_t_3", "c_t_2"), ("d_t_2", "b_t_0", ["a_t_1", "c_t_3"])]
+    for test in tests:
+        assert np.isclose(dlc.transition_tests().pvalue(*test), transition.pvalue(*test))
+
+    tests = [("a_t_1", "b_t_2"), ("a_t_3", "a_t_1", "c_t_2"), ("d_t_2", "b_t_1", ["a_t_1", "c_t_3"])]
+    for test in tests:
+        assert np.isclose(dlc.static_tests().pvalue(*test), static.pvalue(*test))
+
+def test_chi_square_variants():
+    from scipy.stats import chi2_contingency
+    discrete_df = util_test.generate_discrete_data_dependent(SIZE)
+    table = pd.crosstab(discrete_df["A"], discrete_df["B"]).values
+
+    chi = pbn.ChiSquare(discrete_df)
+    assert np.isclose(chi.pvalue("A", "B"), chi2_contingency(table, correction=False)[1])
+
+    g = pbn.ChiSquare(discrete_df, g_test=True)
+    assert g.g_test
+    assert np.isclose(g.pvalue("A", "B"), chi2_contingency(table, correction=False, lambda_="log-likelihood")[1])
+
+    # Without empty rows or columns, the adjusted degrees of freedom are the usual ones.
+    adjusted = pbn.ChiSquare(discrete_df, adjusted_df=True)
+    assert np.isclose(adjusted.pvalue("A", "B"), chi.pvalue("A", "B"))
+    assert adjusted.pvalue("C", "D", ["A", "B"]) <= chi.pvalue("C", "D", ["A", "B"])
+
+    uniform_df = util_test.generate_discrete_data_uniform(SIZE)
+    permutation = pbn.ChiSquare(uniform_df, permutations=99, seed=0)
+    assert permutation.permutations == 99
+    assert pbn.ChiSquare(discrete_df, permutations=99, seed=0).pvalue("A", "B") == 0.01
+    for v1, v2, ev in [("A", "B", []), ("A", "C", ["B"]), ("C", "D", ["A", "B"])]:
+        p = permutation.pvalue(v1, v2, ev)
+        assert 0.01 <= p <= 1
+        assert p == pbn.ChiSquare(uniform_df, permutations=99, seed=0).pvalue(v1, v2, ev)
+        assert np.allclose(permutation.pvalues(v1, v2, [ev]), [p])
+
+def test_chi_square_packed_columns():
+    # The binary and ternary columns are bit-packed. The size is not a multiple of 64 rows.
+    from scipy.stats import chi2_contingency
+    discrete_df = util_test.generate_discrete_data_dependent(SIZE + 17)
+    discrete_df.loc[discrete_df.sample(frac=0.05, random_state=0).index, "B"] = np.nan
+
+    chi = pbn.ChiSquare(discrete_df)
+    for v1, v2 in [("A", "B"), ("A", "C"), ("B", "D")]:
+        table = pd.crosstab(discrete_df[v1], discrete_df[v2]).values
+        assert np.isclose(chi.pvalue(v1, v2), chi2_contingency(table, correction=False)[1])
+
+def test_chi_square_batched_sepsets():
+    np.random.seed(0)
+    columns = ["A", "B", "C", "D", "E", "F"]
+    wide_df = pd.DataFrame({c: pd.Categorical(np.random.choice([c + str(i) for i in range(5)], size=SIZE))
+                            for c in columns})
+
+    # The large tables of pvalues() are counted together, extending the indices of the longest common prefixes.
+    chi = pbn.ChiSquare(wide_df)
+    sepsets = [["D", "E"], ["C"], ["C", "D", "F"], [], ["C", "D"], ["E", "D"], ["C", "F"], ["C", "D", "E"]]
+    assert np.allclose(chi.pvalues("A", "B", sepsets), [chi.pvalue("A", "B", s) for s in sepsets])
+
+    null_df = wide_df.copy()
+    null_df.loc[null_df.sample(frac=0.05, random_state=0).index, "D"] = np.nan
+    null_chi = pbn.ChiSquare(null_df)
+    assert np.allclose(null_chi.pvalues("A", "B", sepsets), [null_chi.pvalue("A", "B", s) for s in sepsets])
+
+def test_rcot_opencl_backend():
+    cpu = pbn.RCoT(df, cache_memory=1 << 26, seed=0, backend=pbn.KDEBackend.CPU)
+    opencl = pbn.RCoT(df, cache_memory=1 << 26, seed=0, backend=pbn.KDEBackend.OPENCL)
+    assert cpu.backend == pbn.KDEBackend.CPU
+    assert opencl.backend == pbn.KDEBackend.OPENCL
+
+    # The cached features use the same random weights, so both backends compute the same test.
+    for test in [("a", "b"), ("a", "c", "b"), ("b", "d", "c")]:
+        assert np.isclose(opencl.pvalue(*test), cpu.pvalue(*test), rtol=1e-4)
+
+def test_linear_correlation_opencl_backend():
+    cpu = pbn.LinearCorrelation(df)
+    opencl = pbn.LinearCorrelation(df, backend=pbn.KDEBackend.OPENCL)
+    assert cpu.backend == pbn.KDEBackend.CPU
+    assert opencl.backend == pbn.KDEBackend.OPENCL
+
+    # The sepset orders are tested in batches with the OpenCL device, and the batches find the same sepsets.
+    pc = pbn.PC()
+    serial = pc.estimate(cpu, use_sepsets=True)
+    batched = pc.estimate(opencl, use_sepsets=True)
+    assert set(serial.arcs()) == set(batched.arcs())
+    assert set(serial.edges()) == set(batched.edges())
+
+    indep_df = util_test.generate_normal_data_indep(SIZE)
+    serial = pc.estimate(pbn.LinearCorrelation(indep_df))
+    batched = pc.estimate(pbn.LinearCorrelation(indep_df, backend=pbn.KDEBackend.OPENCL))
+    assert set(serial.edges()) == set(batched.edges())
+
+def test_kmutual_information_opencl_backend():
+    np.random.seed(0)
+    df_e = df.assign(e=df["d"] + np.random.normal(size=SIZE))
+
+    cpu = pbn.KMutualInformation(df_e, k=10, seed=0, samples=20)
+    opencl = pbn.KMutualInformation(df_e, k=10, seed=0, samples=20, backend=pbn.KDEBackend.OPENCL)
+    assert cpu.backend == pbn.KDEBackend.CPU
+    assert opencl.backend == pbn.KDEBackend.OPENCL
+
+    # The tests with 5 variables use the exact brute force searches of the OpenCL device.
+    assert np.isclose(cpu.mi("a", "e", ["b", "c", "d"]), opencl.mi("a", "e", ["b", "c", "d"]))
+    assert np.isclose(cpu.pvalue("a", "e", ["b", "c", "d"]), opencl.pvalue("a", "e", ["b", "c", "d"]))
+    assert cpu.mi("a", "b") == opencl.mi("a", "b")
+
+def test_rcot_pvalue_approximation():
+    # The strongly dependent tests take the bounded fast path, and the independent tests the refined approximation.
+    rcot = pbn.RCoT(df, seed=0)
+    assert 0 <= rcot.pvalue("a", "b") < 1e-6
+    assert 0 <= rcot.pvalue("c", "d", "b") <= 1
+
+    indep_df = util_test.generate_normal_data_indep(SIZE)
+    indep = pbn.RCoT(indep_df, seed=0)
+    assert indep.pvalue("a", "b") > 0.01
+    assert 0 <= indep.pvalue("a", "d", "c") <= 1
+
+def test_independence_subsample():
+    rcot = pbn.RCoT(df, cache_memory=1 << 26, seed=0, subsample=1000)
+    assert rcot.subsample == 1000
+    same_seed = pbn.RCoT(df, cache_memory=1 << 26, seed=0, subsample=1000)
+    assert rcot.pvalue("a", "c", "b") == same_seed.pvalue("a", "c", "b")
+
+    kmi = pbn.KMutualInformation(df, k=10, seed=0, samples=50, subsample=500)
+    assert kmi.subsample == 500
+    assert kmi.pvalue("a", "b") == pbn.KMutualInformation(df, k=10, seed=0, samples=50, subsample=500).pvalue("a", "b")
+
+    # A subsample larger than the data uses all the rows.
+    full = pbn.KMutualInformation(df, k=10, seed=0, samples=50)
+    assert pbn.KMutualInformation(df, k=10, seed=0, samples=50, subsample=2 * SIZE).mi("a", "b") == full.mi("a", "b")
+
+def test_independence_shared_derived_columns():
+    # The ranks and the normalized columns are shared by the tests created with the same data.
+    kmi = pbn.KMutualInformation(df, k=10, seed=0, samples=50)
+    threads = pbn.KMutualInformation(df, k=10, seed=0, samples=50, num_threads=2)
+    copied = pbn.KMutualInformation(df.copy(), k=10, seed=0, samples=50)
+    assert kmi.mi("a", "b") == threads.mi("a", "b") == copied.mi("a", "b")
+    assert kmi.mi("a", "b", "c") == copied.mi("a", "b", "c")
+    # The KDTrees built with several threads have the same nodes.
+    assert kmi.mi("a", "b", ["c", "d"]) == threads.mi("a", "b", ["c", "d"])
+
+    # The random fourier features are generated with the seed, with or without the cache, so the p-values are equal.
+    rcot = pbn.RCoT(df, seed=0)
+    assert rcot.pvalue("a", "b", "c") == pbn.RCoT(df.copy(), seed=0).pvalue("a", "b", "c")
+    cached = pbn.RCoT(df, cache_memory=1 << 26, seed=0)
+    assert cached.pvalue("a", "b", "c") == pbn.RCoT(df.copy(), cache_memory=1 << 26, seed=0).pvalue("a", "b", "c")
+
+def test_linear_correlation_null_patterns():
+    np.random.seed(1)
+    df_null = df.copy()
+    df_null.loc[df_null.index[np.random.randint(0, SIZE, size=100)], "a"] = np.nan
+    df_null.loc[df_null.index[np.random.randint(0, SIZE, size=100)], "c"] = np.nan
+
+    lc = pbn.LinearCorrelation(df_null)
+    # The reference tests the data without the rows with nulls in the variables of the test.
+    tests = [("a", "b"), ("b", "d"), ("a", "c", "b"), ("b", "d", "c"), ("a", "b", ["c", "d"])]
+    for test in tests:
+        ev = test[2:] if len(test) < 3 or isinstance(test[2], str) else test[2]
+        reference = pbn.LinearCorrelation(df_null.dropna(subset=list(test[:2]) + list(ev)).fillna(0))
+        assert np.isclose(lc.pvalue(*test), reference.pvalue(*test))
+        # The second test of a pattern reads the cached covariance.
+        assert lc.pvalue(*test) == lc.pvalue(*test)
+
+def test_pc_checkpoint(tmp_path):
+    path = str(tmp_path / "pc_checkpoint.pickle")
+    lc = pbn.LinearCorrelation(df)
+    pc = pbn.PC()
+
+    expected = pc.estimate(lc)
+    res = pc.estimate(lc, checkpoint=path)
+    assert set(res.arcs()) == set(expected.arcs())
+    assert set(res.edges()) == set(expected.edges())
+
+    checkpoint = pbn.load(path)
+    assert checkpoint.level() >= 1
+    for n1, n2, _, _ in checkpoint.sepsets():
+        assert not res.has_edge(n1, n2) and not res.has_arc(n1, n2) and not res.has_arc(n2, n1)
+
+    resumed = pc.estimate(lc, resume=checkpoint)
+    assert set(resumed.arcs()) == set(expected.arcs())
+    assert set(resumed.edges()) == set(expected.edges())
+
+def test_pc_budget():
+    lc = pbn.LinearCorrelation(df)
+    pc = pbn.PC()
+    nodes = list(df.columns.values)
+
+    expected = pc.estimate(lc)
+    res = pc.estimate(lc, budget=pbn.SearchBudget(max_seconds=3600, max_evaluations=10**9))
+    assert set(res.arcs()) == set(expected.arcs())
+    assert set(res.edges()) == set(expected.edges())
+
+    # No edge is tested, so the skeleton is complete.
+    res = pc.estimate(lc, budget=pbn.SearchBudget(max_evaluations=0), num_threads=2)
+    assert res.num_edges() + res.num_arcs() == len(nodes) * (len(nodes) - 1) // 2
+
+    res = pc.estimate(lc, budget=pbn.SearchBudget(max_seconds=0))
+    assert res.num_edges() + res.num_arcs() == len(nodes) * (len(nodes) - 1) // 2
+
+def test_pc_association_order():
+    lc = pbn.LinearCorrelation(df)
+    pc = pbn.PC()
+
+    def skeleton(graph):
+        return set(frozenset(e) for e in graph.edges()) | set(frozenset(a) for a in graph.arcs())
+
+    # The order of the tests changes the sepsets found, but not the skeleton.
+    expected = pc.estimate(lc)
+    for num_threads in [1, 4]:
+        res = pc.estimate(lc, association_order=True, num_threads=num_threads)
+        assert skeleton(res) == skeleton(expected)
+
+    column_names = list(df.columns.values)
+    expected = pc.estimate_conditional(lc, column_names[2:], column_names[:2])
+    res = pc.estimate_conditional(lc, column_names[2:], column_names[:2], association_order=True)
+    assert skeleton(res) == skeleton(expected)
+
+def test_pc_async():
+    lc = pbn.LinearCorrelation(df)
+    pc = pbn.PC()
+    nodes = list(df.columns.values)
+
+    expected = pc.estimate(lc)
+    task = pc.estimate_async(lc, num_threads=2)
+    res = task.result()
+    assert set(res.arcs()) == set(expected.arcs())
+    assert set(res.edges()) == set(expected.edges())
+    assert task.evaluations() > 0
+
+    # The task is checked with the budget: no edge is tested, so the skeleton is complete.
+    res = pc.estimate_async(lc, budget=pbn.SearchBudget(max_evaluations=0)).result()
+    assert res.num_edges() + res.num_arcs() == len(nodes) * (len(nodes) - 1) // 2
+
+def test_mutual_information_cached_covariance():
+    mi = pbn.MutualInformation(df)
+    cor = df[["a", "b"]].corr().to_numpy()[0, 1]
+    assert np.isclose(mi.mi("a", "b"), -0.5 * np.log(1 - cor**2))
+
+    precision = np.linalg.inv(df[["a", "b", "c", "d"]].cov().to_numpy())
+    partial_cor = -precision[0, 1] / np.sqrt(precision[0, 0] * precision[1, 1])
+    assert np.isclose(mi.mi("a", "b", ["c", "d"]), -0.5 * np.log(1 - partial_cor**2))
+
+    # The covariance is not cached if some continuous column contains nulls.
+    null_df = df.copy()
+    null_df.loc[0, "d"] = np.nan
+    null_mi = pbn.MutualInformation(null_df)
+    assert np.isclose(mi.mi("a", "b", "c"), null_mi.mi("a", "b", "c"))
+    assert np.isclose(mi.pvalue("a", "c", ["b"]), null_mi.pvalue("a", "c", ["b"]))
+
+def test_cached_independence_test(tmp_path):
+    lc = pbn.LinearCorrelation(df)
+    cached = pbn.CachedIndependenceTest(lc)
+
+    # The pair and the conditioning set are canonicalized.
+    assert cached.pvalue("a", "b", ["c", "d"]) == lc.pvalue("a", "b", ["c", "d"])
+    assert cached.pvalue("b", "a", ["d", "c"]) == lc.pvalue("a", "b", ["c", "d"])
+    assert cached.pvalue("a", "c") == lc.pvalue("a", "c")
+    assert len(cached) == 2
+    assert cached.hits() == 1 and cached.misses() == 2
+
+    assert cached.pvalues("a", "b", [[], ["c"], ["d", "c"]]) == lc.pvalues("a", "b", [[], ["c"], ["d", "c"]])
+    assert len(cached) == 4
+
+    pc = pbn.PC()
+    expected = pc.estimate(lc)
+    res = pc.estimate(cached, num_threads=4)
+    assert set(res.arcs()) == set(expected.arcs())
+    assert set(res.edges()) == set(expected.edges())
+
+    # The second execution finds all the tests in the memo.
+    misses = cached.misses()
+    pc.estimate(cached)
+    assert cached.misses() == misses
+
+    path = str(tmp_path / "cached_test.pickle")
+    cached.save(path)
+    loaded = pbn.load(path)
+    assert len(loaded) == len(cached)
+    loaded.bind(pbn.LinearCorrelation(df))
+    assert loaded.pvalue("b", "a", ["c", "d"]) == lc.pvalue("a", "b", ["c", "d"])
+    assert loaded.misses() == 0
+
+class OracleTest(pbn.IndependenceTest):
+    # The independences of the network a -> c <- b, c -> d.
+    def __init__(self):
+        pbn.IndependenceTest.__init__(self)
+        self.variables = ["a", "b", "c", "d"]
+
+    def num_variables(self):
+        return len(self.variables)
+
+    def variable_names(self):
+        return self.variables
+
+    def has_variables(self, vars):
+        return set(vars).issubset(set(self.variables))
+
+    def name(self, index):
+        return self.variables[index]
+
+    def pvalue(self, x, y, z):
+        if z is None:
+            return 1 if set([x, y]) == set(["a", "b"]) else 0
+
+        if "c" in list(z) and (set([x, y]) == set(["a", "d"]) or set([x, y]) == set(["b", "d"])):
+            return 1
+        return 0
+
+def test_cached_python_independence_test():
+    oracle = OracleTest()
+    cached = pbn.CachedIndependenceTest(oracle)
+    assert cached.pvalue("a", "b") == 1
+    assert cached.pvalue("d", "a", ["c"]) == 1
+    assert cached.pvalue("a", "c") == 0
+
+    # The Python test is run with the GIL from all the threads.
+    graph = pbn.PC().estimate(cached, num_threads=4)
+    assert set(graph.arcs()) == {('a', 'c'), ('b', 'c'), ('c', 'd')}
+    assert graph.num_edges() == 0
+    assert cached.misses() > 0
+
+    misses = cached.misses()
+    pbn.PC().estimate(cached, num_threads=4)
+    assert cached.misses() == misses
+
+def test_distributed_independence_test():
+    import pickle
+    from concurrent.futures import ThreadPoolExecutor
+
+    class PoolTransport(pbn.IndependenceTransport):
+        # Each worker holds its own copy of the data. The requests are pickled, as in a remote transport.
+        def __init__(self, num_workers):
+            pbn.IndependenceTransport.__init__(self)
+            self.workers = [pbn.LinearCorrelation(df.copy()) for _ in range(num_workers)]
+            self.executor = ThreadPoolExecutor(max_workers=num_workers)
+            self.num_requests = 0
+
+        def evaluate(self, requests):
+            message = pickle.dumps(requests)
+            worker = self.workers[self.num_requests % len(self.workers)]
+            self.num_requests += 1
+            return self.executor.submit(lambda: pbn.evaluate_independence_tests(worker, pickle.loads(message))).result()
+
+    lc = pbn.LinearCorrelation(df)
+    transport = PoolTransport(2)
+    distributed = pbn.DistributedIndependenceTest(lc, transport)
+    assert str(distributed) == "DistributedIndependenceTest(LinearCorrelation)"
+    assert distributed.pvalue("a", "b", ["c", "d"]) == lc.pvalue("a", "b", ["c", "d"])
+    assert distributed.pvalues("a", "b", [[], ["c"]]) == lc.pvalues("a", "b", [[], ["c"]])
+
+    for algorithm in [pbn.PC(), pbn.MMPC()]:
+        expected = algorithm.estimate(lc)
+        for num_threads in [1, 4]:
+            res = algorithm.estimate(distributed, num_threads=num_threads)
+            assert set(res.arcs()) == set(expected.arcs())
+            assert set(res.edges()) == set(expected.edges())
+
+    assert transport.num_requests > 0
+
+def test_pvalues_match_pvalue():
+    small_df = df.iloc[:1000]
+    discrete_df = util_test.generate_discrete_data_dependent(1000)
+    hybrid_df = util_test.generate_hybrid_data(1000)
+
+    tests = [(pbn.LinearCorrelation(df), ["a", "b", "c", "d"]),
+             (pbn.KMutualInformation(small_df, k=10, seed=0, samples=20), ["a", "b", "c", "d"]),
+             (pbn.RCoT(small_df, cache_memory=1 << 26, seed=0), ["a", "b", "c", "d"]),
+             (pbn.ChiSquare(discrete_df), ["A", "B", "C", "D"]),
+             (pbn.MutualInformation(hybrid_df), ["A", "B", "C", "D"])]
+
+    for test, (x, y, z1, z2) in tests:
+        sepsets = [[], [z1], [z2], [z1, z2]]
+        assert np.allclose(test.pvalues(x, y, sepsets), [test.pvalue(x, y, s) for s in sepsets])
+
+        pairs = [(x, y), (x, z1), (y, z1)]
+        assert np.allclose(test.pvalues(pairs, [z2]), [test.pvalue(v1, v2, [z2]) for v1, v2 in pairs])
+
+    # The seeded RCoT evaluates each set of the batch with the same features as pvalue().
+    rcot = tests[2][0]
+    assert rcot.pvalues("a", "b", [[], ["c"], ["d"], ["c", "d"]]) == \
+        [rcot.pvalue("a", "b", s) for s in [[], ["c"], ["d"], ["c", "d"]]]
+
+    # Only the tests that evaluate the batches natively are tested in batches by the sepset searches.
+    assert pbn.LinearCorrelation(df).native_batch_size() == 1
+    assert pbn.RCoT(small_df, seed=0).native_batch_size() == 1
+    assert pbn.ChiSquare(discrete_df).native_batch_size() > 1
+    assert pbn.ChiSquare(discrete_df, permutations=99, seed=0).native_batch_size() == 1
+    assert pbn.MutualInformation(hybrid_df).native_batch_size() > 1
+    assert pbn.MutualInformation(small_df).native_batch_size() == 1
+
+def test_kmutual_information_early_stopping():
+    indep_df = util_test.generate_normal_data_indep(500)
+    tests = [("a", "b", None), ("a", "c", None), ("c", "d", None), ("a", "d", ["c"]), ("b", "d", ["c"]),
+             ("a", "c", ["b"]), ("a", "b", ["c", "d"])]
+
+    alpha = 0.05
+    full = pbn.KMutualInformation(indep_df, k=10, seed=0, samples=200)
+    early = pbn.KMutualInformation(indep_df, k=10, seed=0, samples=200, alpha=alpha, confidence=0.99)
+
+    stopped = 0
+    for x, y, z in tests:
+        full_result = full.permutation_test(x, y, z)
+        early_result = early.permutation_test(x, y, z)
+
+        assert full_result.permutations == 200
+        assert full_result.pvalue == full.pvalue(x, y, z if z is not None else [])
+        assert early_result.pvalue == early.pvalue(x, y, z if z is not None else [])
+        assert early_result.permutations <= 200
+        assert early_result.lower_bound <= early_result.pvalue <= early_result.upper_bound
+
+        # The early stopped decision falls on the same side of alpha as the decision with all the permutations.
+        assert (early_result.pvalue < alpha) == (full_result.pvalue < alpha)
+
+        if early_result.permutations < 200:
+            stopped += 1
+            assert early_result.upper_bound < alpha or early_result.lower_bound > alpha
+
+    assert stopped > 0
+
+def test_kmutual_information_num_threads():
+    small_df = df.iloc[:500]
+    tests = [("a", "b", None), ("a", "d", ["c"]), ("a", "d", ["b", "c"])]
+
+    for alpha in [None, 0.05]:
+        serial = pbn.KMutualInformation(small_df, k=10, seed=3, samples=100, alpha=alpha)
+        for num_threads in [2, 4]:
+            parallel = pbn.KMutualInformation(small_df, k=10, seed=3, samples=100, alpha=alpha, num_threads=num_threads)
+            for x, y, z in tests:
+                serial_result = serial.permutation_test(x, y, z)
+                parallel_result = parallel.permutation_test(x, y, z)
+                assert serial_result.pvalue == parallel_result.pvalue
+                assert serial_result.permutations == parallel_result.permutations
+
+def test_kmutual_information_knn_eps():
+    small_df = df.iloc[:500]
+    exact = pbn.KMutualInformation(small_df, k=10, seed=0, samples=50)
+    zero = pbn.KMutualInformation(small_df, k=10, seed=0, samples=50, knn_eps=0.)
+    approximate = pbn.KMutualInformation(small_df, k=10, seed=0, samples=50, knn_eps=0.1)
+
+    for args in [("a", "b"), ("a", "c", ["b"]), ("c", "d", ["a", "b"])]:
+        assert exact.mi(*args) == zero.mi(*args)
+        assert exact.pvalue(*args) == zero.pvalue(*args)
+
+        assert np.isclose(approximate.mi(*args), exact.mi(*args), rtol=0.1, atol=0.02)
+        assert abs(approximate.pvalue(*args) - exact.pvalue(*args)) <= 0.1
+
+    with pytest.raises(ValueError):
+        pbn.KMutualInformation(small_df, k=10, knn_eps=-1)
+
+def test_rcot_feature_cache():
+    indep_df = util_test.generate_normal_data_indep(SIZE)
+    # Only the features of the single variables are cached, so the tests condition on one variable at most.
+    tests = [("a", "b"), ("a", "c", "b"), ("a", "d", "c"), ("b", "d", "c")]
+
+    for data in [df, indep_df]:
+        cached = pbn.RCoT(data, cache_memory=1 << 26, seed=0)
+        # A cache smaller than the features regenerates the same seeded features in each test.
+        regenerated = pbn.RCoT(data, cache_memory=1, seed=0)
+
+        for test in tests:
+            miss = cached.pvalue(*test)
+            hit = cached.pvalue(*test)
+            assert miss == hit
+            assert hit == regenerated.pvalue(*test)
+            assert hit == pbn.RCoT(data, cache_memory=1 << 26, seed=0).pvalue(*test)
+
+        assert cached.memory_usage().components()["feature_cache"][0] > 0
+        assert regenerated.memory_usage().total_bytes == 0
+
+        # The seed also generates the features without the cache, including the features of a multivariate z.
+        uncached = pbn.RCoT(data, seed=0)
+        for test in tests + [("a", "b", ["c", "d"])]:
+            assert uncached.pvalue(*test) == pbn.RCoT(data, cache_memory=0, seed=0).pvalue(*test)
+        assert uncached.pvalue("a", "b") == cached.pvalue("a", "b")
+
+    # The cached features follow the same distribution as the features drawn in each test without the cache.
+    uncached = pbn.RCoT(df)
+    cached = pbn.RCoT(df, cache_memory=1 << 26, seed=0)
+    assert cached.pvalue("a", "b") < 1e-3 and uncached.pvalue("a", "b") < 1e-3
+    assert cached.pvalue("b", "d", "c") < 1e-3 and uncached.pvalue("b", "d", "c") < 1e-3
+
+    uncached_indep = pbn.RCoT(indep_df)
+    cached_indep = pbn.RCoT(indep_df, cache_memory=1 << 26, seed=0)
+    assert cached_indep.pvalue("a", "b") > 0.01
+    assert np.median([uncached_indep.pvalue("a", "b") for _ in range(5)]) > 0.01
+
+def test_linear_correlation_cholesky_cache():
+    from scipy.stats import t
+
+    np.random.seed(2)
+    data = util_test.generate_normal_data_indep(SIZE).assign(e=np.random.normal(size=SIZE),
+                                                             f=np.random.normal(size=SIZE))
+    data["f"] += 0.05 * data["a"]
+
+    def reference_pvalue(x, y, z):
+        # The partial correlation of the inverse covariance of (x, y, z), as computed before the Cholesky factors.
+        precision = np.linalg.pinv(data[[x, y] + z].cov().to_numpy())
+        cor = -precision[0, 1] / np.sqrt(precision[0, 0] * precision[1, 1])
+        dof = SIZE - 2 - len(z)
+        return 2 * t.sf(np.abs(cor * np.sqrt(dof) / np.sqrt(1 - cor**2)), dof)
+
+    tests = [("a", "f", ["b", "e"]), ("a", "f", ["b", "c", "e"]), ("a", "b", ["c", "d"]), ("a", "d", ["c", "e"]),
+             ("b", "d", ["a", "c", "e", "f"]), ("e", "f", ["a", "b", "c", "d"])]
+
+    lc = pbn.LinearCorrelation(data)
+    for x, y, z in tests:
+        pvalue = lc.pvalue(x, y, z)
+        assert np.isclose(pvalue, reference_pvalue(x, y, z))
+
+        # The factors of the sorted conditioning sets are shared, so the result does not depend on the cache state.
+        assert pvalue == pbn.LinearCorrelation(data).pvalue(x, y, z)
+        assert pvalue == lc.pvalue(x, y, list(reversed(z)))
+
+def test_kmutual_information_conditioning_cache():
+    small_df = df.iloc[:500]
+    cached = pbn.KMutualInformation(small_df, k=10, seed=0, samples=30)
+    # Without cache memory, the neighbors, the sorted rows and the KDTree of each conditioning set are rebuilt.
+    uncached = pbn.KMutualInformation(small_df, k=10, seed=0, samples=30)
+    uncached.set_max_cache_memory(0)
+
+    for z in [["c"], ["c", "d"], ["b", "d"]]:
+        free = [v for v in ["a", "b", "c", "d"] if v not in z]
+        pairs = [(v1, v2) for i, v1 in enumerate(free) for v2 in free[i + 1:]]
+        expected = [uncached.pvalue(v1, v2, z) for v1, v2 in pairs]
+        assert cached.pvalues(pairs, z) == expected
+        assert [cached.pvalue(v1, v2, z) for v1, v2 in pairs] == expected
+
+    assert cached.memory_usage().components()["conditioning_cache"][0] > 0
+    assert uncached.memory_usage().total_bytes == 0
+
+def test_mutual_information_cached_entropies():
+    hybrid_df = util_test.generate_hybrid_data(2000)
+    np.random.seed(3)
+    hybrid_df["E"] = hybrid_df["C"] + np.random.normal(size=2000)
+
+    # The nulls select the previous computation, which tests the rows without nulls in the variables of the test. All
+    # the tests contain C or E, so they test the same rows as valid_df.
+    null_df = hybrid_df.copy()
+    null_df.loc[0, ["C", "E"]] = np.nan
+    valid_df = hybrid_df.iloc[1:]
+
+    cached = pbn.MutualInformation(valid_df)
+    previous = pbn.MutualInformation(null_df)
+
+    tests = [("A", "D", ["C"]), ("C", "D", ["A"]), ("C", "D", ["A", "E"]), ("A", "B", ["C", "E"]),
+             ("D", "E", ["A", "B"]), ("A", "E", ["B", "C", "D"]), ("C", "E", ["A", "B", "D"])]
+    for x, y, z in tests:
+        assert np.isclose(cached.mi(x, y, z), previous.mi(x, y, z))
+        assert np.isclose(cached.pvalue(x, y, z), previous.pvalue(x, y, z))
+        # The result does not depend on the entropies cached by the previous tests.
+        assert cached.mi(x, y, z) == pbn.MutualInformation(valid_df).mi(x, y, z)
@@ -1,3 +1,7 @@
+import asyncio
+import itertools
+import pickle
+import pytest
 import numpy as np
 import pybnesian as pbn
 from pybnesian import BayesianNetworkType, BayesianNetwork
@@ -153,6 +157,34 @@ def test_hc_estimate_validation():
     res = hc.estimate(arc_set, vl, start, verbose=False)
     res_removed = hc.estimate(arc_set, vl, start_removed_nodes, verbose=False)
 
+def test_hc_patience_restores_best():
+    # With patience, the search continues after the validation score decreases, and the best model is restored at the
+    # end by undoing the operators applied after it.
+    class ValidationScores(pbn.Callback):
+        def __init__(self):
+            pbn.Callback.__init__(self)
+            self.scores = []
+            self.final = None
+
+        def call(self, model, operator, score, iteration):
+            if operator is None and iteration > 0:
+                self.final = (set(model.arcs()), score.vscore(model))
+            else:
+                self.scores.append(score.vscore(model))
+
+    start = pbn.GaussianNetwork(list(df.columns.values))
+    vl = pbn.ValidatedLikelihood(df)
+    hc = pbn.GreedyHillClimbing()
+
+    for patience in [0, 3]:
+        callback = ValidationScores()
+        res = hc.estimate(pbn.ArcOperatorSet(), vl, start, callback=callback, patience=patience)
+
+        assert set(res.arcs()) == callback.final[0]
+        assert np.isclose(vl.vscore(res), callback.final[1])
+        assert np.isclose(vl.vscore(res), max(callback.scores))
+        assert start.num_arcs() == 0
+
 def test_hc_shortcut_function():
     model = pbn.hc(df, bn_type=pbn.GaussianNetworkType())
     assert type(model) == pbn.GaussianNetwork
@@ -203,4 +235,485 @@ def test_newbn_estimate_validation():
     estimated = hc.estimate(arc, bic, start)
 
     assert type(start) == type(estimated)
-    assert estimated.extra_data == "extra"
\ No newline at end of file
+    assert estimated.extra_data == "extra"
+
+def test_hc_num_threads():
+    hc = pbn.GreedyHillClimbing()
+    arc_set = pbn.ArcOperatorSet()
+    bic = pbn.BIC(df)
+    start = pbn.GaussianNetwork(list(df.columns.values))
+
+    serial = hc.estimate(arc_set, bic, start)
+    for num_threads in [2, 4, 0]:
+        parallel = hc.estimate(arc_set, bic, start, num_threads=num_threads)
+        assert set(serial.arcs()) == set(parallel.arcs())
+        assert bic.score(serial) == bic.score(parallel)
+
+    cv = pbn.CVLikelihood(df, 5, seed=0)
+    serial = hc.estimate(arc_set, cv, start, max_iters=3)
+    parallel = hc.estimate(arc_set, cv, start, max_iters=3, num_threads=4)
+    assert set(serial.arcs()) == set(parallel.arcs())
+
+    model = pbn.hc(df, bn_type=MyRestrictedGaussianNetworkType(), score="bic", operators=["arcs"], num_threads=4)
+    assert type(model) == NewBN
+
+def test_hc_conditional_num_threads():
+    hc = pbn.GreedyHillClimbing()
+    arc_set = pbn.ArcOperatorSet()
+    bic = pbn.BIC(df)
+    column_names = list(df.columns.values)
+    start = pbn.ConditionalGaussianNetwork(column_names[2:], column_names[:2])
+
+    serial = hc.estimate(arc_set, bic, start)
+    parallel = hc.estimate(arc_set, bic, start, num_threads=4)
+    assert set(serial.arcs()) == set(parallel.arcs())
+    assert bic.score(serial) == bic.score(parallel)
+
+def test_hc_batch_operators():
+    hc = pbn.GreedyHillClimbing()
+    arc_set = pbn.ArcOperatorSet()
+    bic = pbn.BIC(df)
+    start = pbn.GaussianNetwork(list(df.columns.values))
+
+    serial = hc.estimate(arc_set, bic, start)
+    batch_one = hc.estimate(arc_set, bic, start, batch_operators=1)
+    assert set(serial.arcs()) == set(batch_one.arcs())
+
+    first_iteration = hc.estimate(arc_set, bic, start, max_iters=1, batch_operators=4)
+    assert 1 < first_iteration.num_arcs() <= 4
+    targets = [t for _, t in first_iteration.arcs()]
+    assert len(targets) == len(set(targets))
+
+    batched = hc.estimate(arc_set, bic, start, batch_operators=4)
+    assert bic.score(batched) > bic.score(start)
+
+    spbn = pbn.SemiparametricBN(list(df.columns.values))
+    pool = pbn.OperatorPool([pbn.ArcOperatorSet(), pbn.ChangeNodeTypeSet()])
+    cv = pbn.CVLikelihood(df, 5, seed=0)
+    batched = hc.estimate(pool, cv, spbn, max_iters=3, batch_operators=4)
+    assert batched.num_arcs() + len([n for n in batched.nodes() if batched.node_type(n) == pbn.CKDEType()]) >= 3
+
+    with pytest.raises(ValueError) as ex:
+        hc.estimate(arc_set, bic, start, batch_operators=0)
+    assert "batch_operators" in str(ex.value)
+
+def test_hc_score_memo():
+    hc = pbn.GreedyHillClimbing()
+    arc_set = pbn.ArcOperatorSet()
+    bic = pbn.BIC(df)
+    start = pbn.GaussianNetwork(list(df.columns.values))
+
+    memo = pbn.LocalScoreMemo(bic)
+    assert len(memo) == 0
+
+    res = hc.estimate(arc_set, bic, start)
+    first = hc.estimate(arc_set, bic, start, score_memo=memo)
+    assert len(memo) > 0
+    assert memo.memory() <= memo.max_memory()
+    second = hc.estimate(arc_set, bic, start, score_memo=memo)
+
+    for m in [first, second]:
+        assert set(res.arcs()) == set(m.arcs())
+        assert bic.score(res) == bic.score(m)
+
+    with pytest.raises(ValueError) as ex:
+        hc.estimate(arc_set, pbn.BIC(df), start, score_memo=memo)
+    assert "different score" in str(ex.value)
+
+    loaded = pickle.loads(pickle.dumps(memo))
+    assert len(loaded) == len(memo)
+    with pytest.raises(ValueError) as ex:
+        hc.estimate(arc_set, bic, start, score_memo=loaded)
+    assert "not bound" in str(ex.value)
+
+    loaded.bind(bic)
+    res_loaded = hc.estimate(arc_set, bic, start, score_memo=loaded)
+    assert set(res.arcs()) == set(res_loaded.arcs())
+
+    with pytest.raises(ValueError):
+        loaded.bind(pbn.BGe(df))
+
+    small = pbn.LocalScoreMemo(bic, max_memory=1000)
+    res_small = hc.estimate(arc_set, bic, start, score_memo=small)
+    assert small.memory() <= 1000
+    assert set(res.arcs()) == set(res_small.arcs())
+
+def test_bootstrap_hc():
+    serial = pbn.bootstrap_hc(df, pbn.GaussianNetworkType(), 8, seed=0)
+    assert len(serial) > 0
+    assert all(0 < f <= 1 for f in serial.values())
+    assert all(s in df.columns and t in df.columns for (s, t) in serial.keys())
+
+    for num_threads in [2, 4, 0]:
+        parallel = pbn.bootstrap_hc(df, pbn.GaussianNetworkType(), 8, seed=0, num_threads=num_threads)
+        assert serial == parallel
+
+    # Each resample learns a structure with the whitelisted arc.
+    whitelist = pbn.bootstrap_hc(df, pbn.GaussianNetworkType(), 4, seed=0, arc_whitelist=[("a", "b")])
+    assert whitelist[("a", "b")] == 1
+
+    random_start = pbn.bootstrap_hc(df, pbn.GaussianNetworkType(), 4, bootstrap=False, random_start=True,
+                                    seed=0, arc_blacklist=[("a", "b")], num_threads=2)
+    assert ("a", "b") not in random_start
+
+    with pytest.raises(ValueError):
+        pbn.bootstrap_hc(df, pbn.GaussianNetworkType(), 4, bootstrap=False, random_start=False)
+
+def test_ges_estimate():
+    bic = pbn.BIC(df)
+    ges = pbn.GES()
+
+    cpdag = ges.estimate_cpdag(bic)
+    assert set(cpdag.nodes()) == set(df.columns.values)
+
+    bn = ges.estimate(bic)
+    assert bn.type() == pbn.GaussianNetworkType()
+    assert bn.num_arcs() == cpdag.num_arcs() + cpdag.num_edges()
+    assert set(bn.graph().to_pdag().arcs()) == set(cpdag.arcs())
+
+    # GES should find a score at least as good as hill-climbing starting from the empty graph.
+    hc_bn = pbn.GreedyHillClimbing().estimate(pbn.ArcOperatorSet(), bic, pbn.GaussianNetwork(list(df.columns.values)))
+    assert bic.score(bn) >= bic.score(hc_bn) - 1e-6
+
+    for num_threads in [2, 0]:
+        cpdag_threads = ges.estimate_cpdag(bic, num_threads=num_threads)
+        assert set(cpdag_threads.arcs()) == set(cpdag.arcs())
+        assert set(map(frozenset, cpdag_threads.edges())) == set(map(frozenset, cpdag.edges()))
+
+    edge_blacklist = [cpdag.arcs()[0] if cpdag.num_arcs() > 0 else cpdag.edges()[0]]
+    cpdag_blacklist = ges.estimate_cpdag(bic, edge_blacklist=edge_blacklist)
+    assert not cpdag_blacklist.has_connection(*edge_blacklist[0])
+
+    memo = pbn.LocalScoreMemo(bic)
+    cpdag_memo = ges.estimate_cpdag(bic, score_memo=memo)
+    assert len(memo) > 0
+    assert set(cpdag_memo.arcs()) == set(cpdag.arcs())
+
+    with pytest.raises(ValueError):
+        ges.estimate(bic, bn_type=pbn.SemiparametricBNType())
+
+def test_hc_python_threads():
+    # The native searches release the GIL, so they can be executed from many Python threads.
+    from concurrent.futures import ThreadPoolExecutor
+
+    expected = pbn.hc(df, bn_type=pbn.GaussianNetworkType(), score="bic")
+
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        futures = [executor.submit(pbn.hc, df, bn_type=pbn.GaussianNetworkType(), score="bic") for _ in range(4)]
+        results = [f.result() for f in futures]
+
+    for res in results:
+        assert set(res.arcs()) == set(expected.arcs())
+
+    expected.fit(df)
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        logls = list(executor.map(lambda _: expected.logl(df), range(4)))
+
+    for logl in logls:
+        assert np.all(logl == expected.logl(df))
+
+def test_hc_profiler():
+    pbn.reset_profiler()
+    assert not pbn.profiler_enabled()
+
+    pbn.enable_profiler()
+    try:
+        model = pbn.hc(df, bn_type=pbn.GaussianNetworkType(), score="bic")
+        model.fit(df)
+    finally:
+        pbn.disable_profiler()
+
+    stats = pbn.profiler_stats()
+    assert stats["local_score:BIC"].calls > 0
+    assert stats["local_score:BIC"].seconds >= 0
+    assert stats["local_score_memo:miss"].calls > 0
+    assert stats["fit:LinearGaussianFactor"].calls == len(model.nodes())
+
+    # The disabled profiler does not record anything.
+    pbn.hc(df, bn_type=pbn.GaussianNetworkType(), score="bic")
+    assert pbn.profiler_stats()["local_score:BIC"].calls == stats["local_score:BIC"].calls
+
+    pbn.reset_profiler()
+    assert pbn.profiler_stats() == {}
+
+def test_hc_trace(tmp_path):
+    import json
+
+    pbn.reset_profiler()
+    assert not pbn.tracing_enabled()
+
+    pbn.enable_tracing()
+    try:
+        pbn.hc(df, bn_type=pbn.GaussianNetworkType(), score="bic", num_threads=2)
+    finally:
+        pbn.disable_tracing()
+
+    # The tracing does not record the counters of the profiler.
+    assert pbn.profiler_stats() == {}
+
+    path = str(tmp_path / "trace.json")
+    pbn.save_trace(path)
+    with open(path) as f:
+        events = json.load(f)["traceEvents"]
+
+    names = set(e["name"] for e in events)
+    assert "hc:iteration" in names
+    assert "local_score:BIC" in names
+    assert all(e["ph"] == "X" and e["dur"] >= 0 and e["ts"] >= 0 for e in events)
+    assert all(e["cat"] == e["name"].split(":")[0] for e in events)
+
+    pbn.reset_profiler()
+    pbn.save_trace(path)
+    with open(path) as f:
+        assert json.load(f)["traceEvents"] == []
+
+def test_save_operators(tmp_path):
+    import re
+
+    path = str(tmp_path / "operators.log")
+    start = pbn.GaussianNetwork(list(df.columns.values), [('a', 'b')])
+    hc = pbn.GreedyHillClimbing()
+    res = hc.estimate(pbn.ArcOperatorSet(), pbn.BIC(df), start, callback=pbn.SaveOperators(path, write_interval=3))
+
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    assert lines[0] == "0 Arc(a -> b)"
+    assert lines[-1].endswith(" End")
+
+    # The log replays the search.
+    replay = pbn.GaussianNetwork(list(df.columns.values))
+    for line in lines[:-1]:
+        it, op = line.split(" ", 1)
+        name, source, target = re.match(r"(\w+)\((\w+) -> (\w+)", op).groups()
+        if name in ("Arc", "AddArc"):
+            replay.add_arc(source, target)
+        elif name == "RemoveArc":
+            replay.remove_arc(source, target)
+        elif name == "FlipArc":
+            replay.flip_arc(source, target)
+
+    assert set(replay.arcs()) == set(res.arcs())
+
+    with pytest.raises(ValueError):
+        pbn.SaveOperators(path, write_interval=0)
+
+def test_hc_checkpoint(tmp_path):
+    path = str(tmp_path / "hc_checkpoint.pickle")
+    start = pbn.GaussianNetwork(list(df.columns.values))
+    bic = pbn.BIC(df)
+    hc = pbn.GreedyHillClimbing()
+
+    expected = hc.estimate(pbn.ArcOperatorSet(), bic, start)
+
+    # Interrupted search: the last checkpoint is saved after the iteration 2.
+    hc.estimate(pbn.ArcOperatorSet(), bic, start, max_iters=3, checkpoint=path, checkpoint_interval=2)
+
+    checkpoint = pbn.load(path)
+    assert checkpoint.iteration() == 2
+    assert len(checkpoint.score_memo()) > 0
+
+    # The memo created by the checkpoint adopts the score of the resumed search and keeps its local scores.
+    memo = checkpoint.score_memo()
+    memoized = len(memo)
+    res = hc.estimate(pbn.ArcOperatorSet(), bic, start, resume=checkpoint)
+    assert set(res.arcs()) == set(expected.arcs())
+    assert len(memo) >= memoized
+
+    # A round trip through pickle keeps the adopted memo unbound.
+    resumed = pickle.loads(pickle.dumps(pbn.load(path)))
+    res = hc.estimate(pbn.ArcOperatorSet(), pbn.BIC(df), start, resume=resumed)
+    assert set(res.arcs()) == set(expected.arcs())
+
+    # A bound memo must be bound again after it is loaded.
+    bound = pbn.LocalScoreMemo(bic)
+    hc.estimate(pbn.ArcOperatorSet(), bic, start, max_iters=3, score_memo=bound, checkpoint=path,
+                checkpoint_interval=2)
+    checkpoint = pbn.load(path)
+    with pytest.raises(ValueError):
+        hc.estimate(pbn.ArcOperatorSet(), bic, start, resume=checkpoint)
+
+    checkpoint.score_memo().bind(bic)
+    res = hc.estimate(pbn.ArcOperatorSet(), bic, start, resume=checkpoint)
+    assert set(res.arcs()) == set(expected.arcs())
+
+    with pytest.raises(ValueError):
+        hc.estimate(pbn.ArcOperatorSet(), bic, start, checkpoint=path, checkpoint_interval=0)
+
+def test_progress_events():
+    start = pbn.GaussianNetwork(list(df.columns.values))
+    bic = pbn.BIC(df)
+    hc = pbn.GreedyHillClimbing()
+
+    events = pbn.ProgressEvents()
+    res = hc.estimate(pbn.ArcOperatorSet(), bic, start, callback=events)
+    expected = hc.estimate(pbn.ArcOperatorSet(), bic, start)
+    assert set(res.arcs()) == set(expected.arcs())
+
+    all_events = events.events()
+    assert len(all_events) == len(events) > 0
+    assert [e[0] for e in all_events] == list(range(1, len(all_events) + 1))
+    assert all(e[1] > 0 for e in all_events)
+    assert all(a[2] <= b[2] for a, b in zip(all_events, all_events[1:]))
+    assert np.isclose(sum(e[1] for e in all_events), bic.score(res) - bic.score(start))
+
+    assert events.events(2) == all_events[2:]
+    assert events.events(len(all_events)) == []
+
+    events.clear()
+    assert len(events) == 0
+
+class StopAfter(pbn.Callback):
+    def __init__(self, iterations):
+        pbn.Callback.__init__(self)
+        self.iterations = iterations
+        self.calls = 0
+
+    def call(self, model, operator, score, iteration):
+        if operator is not None:
+            self.calls += 1
+
+    def stop(self, evaluations):
+        return self.calls >= self.iterations
+
+def test_search_budget():
+    start = pbn.GaussianNetwork(list(df.columns.values))
+    bic = pbn.BIC(df)
+    hc = pbn.GreedyHillClimbing()
+
+    expected = hc.estimate(pbn.ArcOperatorSet(), bic, start)
+    budget = pbn.SearchBudget(max_seconds=3600, max_evaluations=10**9)
+    res = hc.estimate(pbn.ArcOperatorSet(), bic, start, callback=budget)
+    assert set(res.arcs()) == set(expected.arcs())
+
+    # The budget runs out before the first iteration, so the search returns the start model.
+    for budget in [pbn.SearchBudget(max_evaluations=0), pbn.SearchBudget(max_seconds=0)]:
+        res = hc.estimate(pbn.ArcOperatorSet(), bic, start, callback=budget)
+        assert res.num_arcs() == 0
+
+    budget = pbn.SearchBudget(max_seconds=0.5)
+    assert budget.max_seconds == 0.5 and budget.max_evaluations is None
+    assert budget.elapsed() >= 0
+    budget.reset()
+
+    with pytest.raises(ValueError):
+        pbn.SearchBudget(max_seconds=-1)
+
+    # A Python callback can stop the search.
+    res = hc.estimate(pbn.ArcOperatorSet(), bic, start, callback=StopAfter(2))
+    assert res.num_arcs() == 2
+
+    res = pbn.hc(df, bn_type=pbn.GaussianNetworkType(), callback=pbn.SearchBudget(max_evaluations=0))
+    assert res.num_arcs() == 0
+
+def test_hc_async():
+    expected = pbn.hc(df, bn_type=pbn.GaussianNetworkType(), score="bic")
+    task = pbn.hc_async(df, bn_type=pbn.GaussianNetworkType(), score="bic")
+    res = task.result()
+    assert task.done() and not task.running() and not task.cancelled()
+    assert set(res.arcs()) == set(expected.arcs())
+    assert task.iterations() == len(task.events()) > 0
+    assert task.evaluations() > 0
+    assert set(task.partial_model().arcs()) == set(res.arcs())
+    assert not task.cancel()
+
+    # The budget of the callback runs out before the first iteration.
+    task = pbn.hc_async(df, bn_type=pbn.GaussianNetworkType(), callback=pbn.SearchBudget(max_evaluations=0))
+    assert task.wait() and task.result().num_arcs() == 0
+
+    with pytest.raises(ValueError):
+        pbn.hc_async(df, bn_type=pbn.GaussianNetworkType(), callback=StopAfter(2))
+
+    with pytest.raises(ValueError):
+        pbn.hc_async(df, bn_type=pbn.GaussianNetworkType(), score="unknown").result()
+
+    batched = pbn.hc(df, bn_type=pbn.GaussianNetworkType(), score="bic", batch_operators=4)
+    task = pbn.hc_async(df, bn_type=pbn.GaussianNetworkType(), score="bic", batch_operators=4)
+    assert set(task.result().arcs()) == set(batched.arcs())
+    assert task.iterations() == len(task.events())
+
+    with pytest.raises(ValueError):
+        pbn.hc_async(df, bn_type=pbn.GaussianNetworkType(), batch_operators=0)
+
+    async def learn():
+        return await asyncio.gather(*[pbn.hc_async(df, bn_type=pbn.GaussianNetworkType(), score="bic")
+                                      for _ in range(4)])
+
+    for model in asyncio.run(learn()):
+        assert set(model.arcs()) == set(expected.arcs())
+
+    gbn = pbn.GaussianNetwork(list(df.columns.values), list(expected.arcs()))
+    task = gbn.fit_async(df)
+    assert task.result() is gbn and gbn.fitted()
+
+def test_exact_search_estimate():
+    bic = pbn.BIC(df)
+    nodes = list(df.columns.values)
+    exact = pbn.ExactSearch()
+
+    bn = exact.estimate(bic)
+    assert bn.type() == pbn.GaussianNetworkType()
+    assert set(bn.nodes()) == set(nodes)
+
+    # The optimal score is the best score of all the orderings, where each node takes its best parent set among the
+    # previous nodes.
+    empty = pbn.GaussianNetwork(nodes)
+    def best_local(v, candidates):
+        return max(bic.local_score(empty, v, list(parents))
+                   for k in range(len(candidates) + 1) for parents in itertools.combinations(candidates, k))
+
+    optimal = max(sum(best_local(v, order[:i]) for i, v in enumerate(order)) for order in itertools.permutations(nodes))
+    assert np.isclose(bic.score(bn), optimal)
+
+    hc_bn = pbn.GreedyHillClimbing().estimate(pbn.ArcOperatorSet(), bic, pbn.GaussianNetwork(nodes))
+    assert bic.score(bn) >= bic.score(hc_bn) - 1e-6
+
+    for num_threads in [2, 0]:
+        bn_threads = exact.estimate(bic, num_threads=num_threads)
+        assert set(bn_threads.arcs()) == set(bn.arcs())
+
+    arc = bn.arcs()[0]
+    bn_blacklist = exact.estimate(bic, arc_blacklist=[arc])
+    assert not bn_blacklist.has_arc(*arc)
+
+    bn_whitelist = exact.estimate(bic, arc_whitelist=[(arc[1], arc[0])])
+    assert bn_whitelist.has_arc(arc[1], arc[0])
+
+    bn_indegree = exact.estimate(bic, max_indegree=1)
+    assert all(len(bn_indegree.parents(n)) <= 1 for n in nodes)
+    assert bic.score(bn_indegree) <= bic.score(bn) + 1e-6
+
+    with pytest.raises(ValueError, match="no DAG compatible"):
+        exact.estimate(bic, arc_whitelist=[("a", "b"), ("b", "c"), ("c", "a")])
+
+def test_order_based_search_estimate():
+    bic = pbn.BIC(df)
+    nodes = list(df.columns.values)
+    obs = pbn.OrderBasedSearch()
+
+    bn = obs.estimate(bic)
+    assert bn.type() == pbn.GaussianNetworkType()
+    assert set(bn.nodes()) == set(nodes)
+
+    # The result is never worse than the empty graph, and every node takes its best parent set among its predecessors.
+    assert bic.score(bn) >= bic.score(pbn.GaussianNetwork(nodes)) - 1e-6
+    exact_bn = pbn.ExactSearch().estimate(bic)
+    assert bic.score(bn) <= bic.score(exact_bn) + 1e-6
+
+    for num_threads in [2, 0]:
+        bn_threads = obs.estimate(bic, num_threads=num_threads)
+        assert set(bn_threads.arcs()) == set(bn.arcs())
+
+    bn_indegree = obs.estimate(bic, max_indegree=1)
+    assert all(len(bn_indegree.parents(n)) <= 1 for n in nodes)
+
+    bn_candidates = obs.estimate(bic, candidate_parents={"d": ["a"]})
+    assert set(bn_candidates.parents("d")) <= {"a"}
+
+    memo = pbn.LocalScoreMemo(bic)
+    bn_memo = obs.estimate(bic, score_memo=memo)
+    assert len(memo) > 0
+    assert set(bn_memo.arcs()) == set(bn.arcs())
+
+    with pytest.raises(ValueError, match="is not in the list of nodes"):
+        obs.estimate(bic, candidate_parents={"a": ["z"]})
@@ -76,3 +76,143 @@ def test_nomax():
 
 
 
+
+def test_find_max_is_best():
+    gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'])
+    bic = pbn.BIC(df)
+    arc_op = pbn.ArcOperatorSet()
+
+    arc_op.cache_scores(gbn, bic)
+
+    for _ in range(4):
+        op = arc_op.find_max(gbn)
+
+        nodes = gbn.nodes()
+        for source in nodes:
+            for target in nodes:
+                if source != target and not gbn.has_arc(source, target) and gbn.can_add_arc(source, target):
+                    parents = gbn.parents(target)
+                    d = bic.local_score(gbn, target, parents + [source]) - bic.local_score(gbn, target, parents)
+                    assert op.delta() >= d or np.isclose(op.delta(), d)
+
+        op.apply(gbn)
+        arc_op.update_scores(gbn, bic, op.nodes_changed(gbn))
+
+def test_neighborhood_sampling():
+    bic = pbn.BIC(df)
+    hc = pbn.GreedyHillClimbing()
+    start = pbn.GaussianNetwork(['a', 'b', 'c', 'd'])
+
+    full = pbn.ArcOperatorSet()
+    full.set_neighborhood_sampling(1)
+    res_full = hc.estimate(full, bic, start)
+    assert set(res_full.arcs()) == set(hc.estimate(pbn.ArcOperatorSet(), bic, start).arcs())
+
+    serial = pbn.ArcOperatorSet()
+    serial.set_neighborhood_sampling(0.5, seed=1)
+    res_serial = hc.estimate(serial, bic, start)
+
+    # The sampled operators do not depend on the number of threads.
+    for num_threads in [2, 4]:
+        parallel = pbn.ArcOperatorSet()
+        parallel.set_neighborhood_sampling(0.5, seed=1)
+        res_parallel = hc.estimate(parallel, bic, start, num_threads=num_threads)
+        assert set(res_serial.arcs()) == set(res_parallel.arcs())
+
+    # Each AddArc operator found is one of the sampled operators, so its delta is an exact delta. All the variables of
+    # df are dependent, so every sampled AddArc operator improves the score.
+    arc_op = pbn.ArcOperatorSet()
+    arc_op.set_neighborhood_sampling(0.5, seed=2)
+    gbn = start.clone()
+    arc_op.cache_scores(gbn, bic)
+    op = arc_op.find_max(gbn)
+    assert isinstance(op, pbn.AddArc) and op.delta() > 0
+    d = bic.local_score(gbn, op.target(), [op.source()]) - bic.local_score(gbn, op.target(), [])
+    assert np.isclose(op.delta(), d)
+    arc_op.finished()
+
+    with pytest.raises(ValueError):
+        arc_op.set_neighborhood_sampling(0)
+    with pytest.raises(ValueError):
+        arc_op.set_neighborhood_sampling(1.5)
+
+def test_candidate_parents():
+    bic = pbn.BIC(df)
+    lc = pbn.LinearCorrelation(df)
+    hc = pbn.GreedyHillClimbing()
+    start = pbn.GaussianNetwork(['a', 'b', 'c', 'd'])
+
+    candidates = pbn.candidate_parents(lc, 3)
+    assert set(candidates.keys()) == set(start.nodes())
+    for node, c in candidates.items():
+        assert set(c) == set(start.nodes()) - {node}
+    assert candidates == pbn.candidate_parents(lc, 3, num_threads=4)
+
+    # If all the nodes are candidates, the search is not restricted.
+    all_candidates = pbn.ArcOperatorSet()
+    all_candidates.set_candidate_parents(candidates)
+    res_all = hc.estimate(all_candidates, bic, start)
+    assert set(res_all.arcs()) == set(hc.estimate(pbn.ArcOperatorSet(), bic, start).arcs())
+
+    candidates = pbn.candidate_parents(lc, 1)
+    assert all(len(c) == 1 for c in candidates.values())
+
+    restricted = pbn.ArcOperatorSet()
+    restricted.set_candidate_parents(candidates)
+    res = hc.estimate(restricted, bic, start)
+    for source, target in res.arcs():
+        assert source in candidates[target]
+
+    # The current parents are also candidates, so they can be removed.
+    gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'], [('a', 'b'), ('a', 'c'), ('a', 'd')])
+    restricted.cache_scores(gbn, bic)
+    op = restricted.find_max(gbn)
+    assert op is not None
+    restricted.finished()
+
+    restricted.set_candidate_parents({'a': ['e']})
+    with pytest.raises(ValueError):
+        restricted.cache_scores(start, bic)
+
+    with pytest.raises(ValueError):
+        pbn.candidate_parents(lc, 0)
+
+class CountingNetworkType(pbn.BayesianNetworkType):
+    def __init__(self):
+        pbn.BayesianNetworkType.__init__(self)
+        self.calls = 0
+
+    def is_homogeneous(self):
+        return True
+
+    def default_node_type(self):
+        return pbn.LinearGaussianCPDType()
+
+    def can_have_arc(self, model, source, target):
+        self.calls += 1
+        return source == 'a'
+
+    def __str__(self):
+        return "CountingNetworkType"
+
+def test_arc_compatibility_mask():
+    bic = pbn.BIC(df)
+    bn_type = CountingNetworkType()
+    model = pbn.BayesianNetwork(bn_type, ['a', 'b', 'c', 'd'])
+
+    arc_op = pbn.ArcOperatorSet()
+    arc_op.cache_scores(model, bic)
+    # can_have_arc() is called once for each pair of different nodes.
+    assert bn_type.calls == 12
+
+    op = arc_op.find_max(model)
+    assert op.source() == 'a'
+    op.apply(model)
+    calls = bn_type.calls
+    arc_op.update_scores(model, bic, op.nodes_changed(model))
+    # The node types did not change, so the cached compatibility is used.
+    assert bn_type.calls == calls
+
+    op = arc_op.find_max(model)
+    assert op is None or op.source() == 'a'
+    arc_op.finished()
@@ -53,4 +53,62 @@ def test_mle_lg():
     p = mle.estimate(df, "d", ["a", "b", "c"])
     np_beta, np_var = numpy_fit_mle_lg(df, "d", ["a", "b", "c"])
     assert np.all(np.isclose(p.beta, np_beta))
-    assert np.isclose(p.variance, np_var)
\ No newline at end of file
+    assert np.isclose(p.variance, np_var)
+
+def test_mle_lg_repeated_evidence():
+    mle = pbn.MLE(pbn.LinearGaussianCPDType())
+
+    # The design matrix of ["a", "b"] is cached between the fits of "c" and "d".
+    for _ in range(2):
+        for variable in ["c", "d"]:
+            p = mle.estimate(df, variable, ["a", "b"])
+            np_beta, np_var = numpy_fit_mle_lg(df, variable, ["a", "b"])
+            assert np.all(np.isclose(p.beta, np_beta))
+            assert np.isclose(p.variance, np_var)
+
+    # The cached matrix is not reused after the columns change.
+    df_copy = df.copy()
+    df_copy["a"] = df_copy["a"] * 2
+    p = mle.estimate(df_copy, "c", ["a", "b"])
+    np_beta, np_var = numpy_fit_mle_lg(df_copy, "c", ["a", "b"])
+    assert np.all(np.isclose(p.beta, np_beta))
+    assert np.isclose(p.variance, np_var)
+
+def test_mle_lg_inplace_modification():
+    mle = pbn.MLE(pbn.LinearGaussianCPDType())
+    df_copy = df.copy()
+    df_copy["e"] = df_copy["d"] - df_copy["a"] + np.random.normal(size=SIZE)
+
+    def check_fit(variable):
+        p = mle.estimate(df_copy, variable, ["a", "b", "c"])
+        np_beta, np_var = numpy_fit_mle_lg(df_copy, variable, ["a", "b", "c"])
+        assert np.all(np.isclose(p.beta, np_beta))
+        assert np.isclose(p.variance, np_var)
+
+    # The design matrix of ["a", "b", "c"] is cached between the fits of "d" and "e".
+    check_fit("d")
+    check_fit("e")
+
+    # The in-place modifications keep the NumPy buffers of the columns, so the cached matrix must not be reused.
+    df_copy.loc[df_copy.index[:SIZE // 2], "a"] *= 3
+    check_fit("d")
+    check_fit("e")
+
+    df_copy.loc[df_copy.index[:SIZE // 2], "e"] += df_copy["b"].iloc[:SIZE // 2]
+    check_fit("e")
+
+def test_mle_lg_null():
+    np.random.seed(0)
+    df_null = df.copy()
+    for column, n in [("a", 100), ("b", 500), ("c", 50)]:
+        df_null.loc[df_null.index[np.random.randint(0, SIZE, size=n)], column] = np.nan
+
+    mle = pbn.MLE(pbn.LinearGaussianCPDType())
+
+    # The combined bitmap of ["a", "b"] is reused between the fits.
+    for _ in range(2):
+        for variable, evidence in [("c", ["a", "b"]), ("d", ["b", "a"]), ("d", ["a", "b", "c"])]:
+            p = mle.estimate(df_null, variable, evidence)
+            np_beta, np_var = numpy_fit_mle_lg(df_null, variable, evidence)
+            assert np.all(np.isclose(p.beta, np_beta))
+            assert np.isclose(p.variance, np_var)
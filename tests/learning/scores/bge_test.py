@@ -0,0 +1,57 @@
+import numpy as np
+import pybnesian as pbn
+import util_test
+
+SIZE = 10000
+
+df = util_test.generate_normal_data(SIZE)
+
+def test_dynamic_bge_lagged():
+    ddf = pbn.DynamicDataFrame(df, 2)
+    dbge = pbn.DynamicBGe(ddf)
+    dbn = pbn.DynamicGaussianNetwork(["a", "b", "c", "d"], 2)
+
+    transition = pbn.BGe(ddf.transition_df())
+    for variable, parents in [("a_t_0", []), ("b_t_0", ["a_t_0", "b_t_1"]), ("d_t_0", ["a_t_2", "c_t_1", "d_t_2"])]:
+        assert np.isclose(dbge.transition_score().local_score(dbn.transition_bn(), variable, parents),
+                          transition.local_score(dbn.transition_bn(), variable, parents))
+
+    static = pbn.BGe(ddf.static_df())
+    for variable, parents in [("a_t_1", []), ("b_t_1", ["a_t_1", "b_t_2"]), ("d_t_2", ["a_t_2", "c_t_1"])]:
+        assert np.isclose(dbge.static_score().local_score(dbn.static_bn(), variable, parents),
+                          static.local_score(dbn.static_bn(), variable, parents))
+
+def test_bge_cached_neighbours():
+    # A null value in an extra column disables the cached SSE in the reference score.
+    df_null = df.copy()
+    df_null["e"] = np.random.normal(size=SIZE)
+    df_null.loc[df_null.index[0], "e"] = np.nan
+
+    bge = pbn.BGe(df, iss_w=10)
+    reference = pbn.BGe(df_null, iss_w=10)
+
+    gbn = pbn.GaussianNetwork(["a", "b", "c", "d"], [("a", "d"), ("b", "d")])
+    parents_sets = [["a", "b"], ["b"], ["a"], ["a", "b", "c"], ["c"], ["c", "b"], []]
+    for parents in parents_sets:
+        assert np.isclose(bge.local_score(gbn, "d", parents), reference.local_score(gbn, "d", parents))
+
+    assert np.all(np.isclose(bge.local_scores(gbn, "d", parents_sets),
+                             [reference.local_score(gbn, "d", p) for p in parents_sets]))
+
+    # The cached factor of the parents is updated when the model changes.
+    gbn.add_arc("c", "d")
+    for parents in parents_sets:
+        assert np.isclose(bge.local_score(gbn, "d", parents), reference.local_score(gbn, "d", parents))
+
+def test_bge_null_patterns():
+    np.random.seed(1)
+    df_null = df.copy()
+    df_null.loc[df_null.index[np.random.randint(0, SIZE, size=100)], "a"] = np.nan
+    df_null.loc[df_null.index[np.random.randint(0, SIZE, size=100)], "c"] = np.nan
+
+    gbn = pbn.GaussianNetwork(["a", "b", "c", "d"])
+    bge = pbn.BGe(df_null)
+    # The reference scores the data without the rows with nulls in the variable or the parents.
+    for variable, parents in [("a", []), ("b", []), ("b", ["a"]), ("d", ["a", "b"]), ("d", ["b", "c"]), ("c", ["a"])]:
+        reference = pbn.BGe(df_null.dropna(subset=[variable] + parents).fillna(0))
+        assert np.isclose(bge.local_score(gbn, variable, parents), reference.local_score(gbn, variable, parents))
@@ -44,6 +44,17 @@ def test_bic_local_score():
     assert bic.local_score(gbn, 'c') == bic.local_score(gbn, 'c', gbn.parents('c'))
     assert bic.local_score(gbn, 'd') == bic.local_score(gbn, 'd', gbn.parents('d'))
 
+def test_bic_cached_sse_mle():
+    gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'])
+    # The data has no nulls, so the local scores are computed from the cached SSE matrix.
+    bic = pbn.BIC(df)
+
+    for variable, evidence in [('a', []), ('d', []), ('b', ['a']), ('c', ['b', 'a']), ('d', ['a', 'b', 'c'])]:
+        cpd = pbn.LinearGaussianCPD(variable, evidence)
+        cpd.fit(df)
+        mle_bic = cpd.slogl(df) - np.log(SIZE) * 0.5 * (len(evidence) + 2)
+        assert np.isclose(bic.local_score(gbn, variable, evidence), mle_bic)
+
 def test_bic_local_score_null():
     gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'], [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
 
@@ -83,3 +94,155 @@ def test_bic_score():
                               bic.local_score(gbn, 'd', ['a', 'b', 'c'])))
 
 
+
+def test_bic_local_scores():
+    gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'], [('a', 'b'), ('a', 'c'), ('b', 'c')])
+    bic = pbn.BIC(df)
+
+    evidence_sets = [[], ['a'], ['a', 'b'], ['a', 'b', 'd'], ['b']]
+    scores = bic.local_scores(gbn, 'c', evidence_sets)
+
+    assert len(scores) == len(evidence_sets)
+    for s, e in zip(scores, evidence_sets):
+        assert s == bic.local_score(gbn, 'c', e)
+
+    discrete_df = util_test.generate_discrete_data_dependent(SIZE)
+    dbn = pbn.DiscreteBN(['A', 'B', 'C', 'D'], [('A', 'B'), ('A', 'C'), ('B', 'C')])
+    bic = pbn.BIC(discrete_df)
+
+    evidence_sets = [[], ['A'], ['A', 'B'], ['A', 'B', 'D'], ['B', 'A', 'D'], ['B']]
+    scores = bic.local_scores(dbn, 'C', evidence_sets)
+
+    assert len(scores) == len(evidence_sets)
+    for s, e in zip(scores, evidence_sets):
+        assert s == bic.local_score(dbn, 'C', e)
+
+def test_bic_discrete_cached_counts():
+    discrete_df = util_test.generate_discrete_data_dependent(SIZE)
+    dbn = pbn.DiscreteBN(['A', 'B', 'C', 'D'], [('A', 'B'), ('A', 'C'), ('B', 'C')])
+    bic = pbn.BIC(discrete_df)
+
+    # The counts of the supersets are computed first, so the rest are reordered or marginalized from the cache.
+    evidence_sets = [['A', 'B', 'D'], ['D', 'B', 'A'], ['B', 'A'], ['D'], []]
+    for e in evidence_sets:
+        bic.local_score(dbn, 'C', e)
+
+    for e in evidence_sets:
+        assert bic.local_score(dbn, 'C', e) == pbn.BIC(discrete_df).local_score(dbn, 'C', e)
+
+    assert bic.local_score(dbn, 'D', ['C']) == pbn.BIC(discrete_df).local_score(dbn, 'D', ['C'])
+
+def test_bic_discrete_local_score_null():
+    discrete_df = util_test.generate_discrete_data_dependent(SIZE)
+    dbn = pbn.DiscreteBN(['A', 'B', 'C', 'D'], [('A', 'B'), ('A', 'C'), ('B', 'C')])
+
+    np.random.seed(0)
+    df_null = discrete_df.copy()
+    df_null.loc[df_null.index[np.random.randint(0, SIZE, size=100)], 'A'] = np.nan
+    df_null.loc[df_null.index[np.random.randint(0, SIZE, size=100)], 'B'] = np.nan
+
+    bic = pbn.BIC(df_null)
+    for e in [[], ['A'], ['A', 'B'], ['B', 'D']]:
+        bic_dropna = pbn.BIC(df_null.loc[:, ['C'] + e].dropna())
+        assert np.isclose(bic.local_score(dbn, 'C', e), bic_dropna.local_score(dbn, 'C', e))
+
+class BatchedBIC(pbn.Score):
+    def __init__(self, data):
+        pbn.Score.__init__(self)
+        self.bic = pbn.BIC(data)
+        self.batches = []
+
+    def local_score(self, model, variable, evidence):
+        return self.bic.local_score(model, variable, evidence)
+
+    def local_scores_batch(self, model, variable, parents, offsets):
+        self.batches.append(len(offsets) - 1)
+        parents_sets = [[model.name(p) for p in parents[offsets[i]:offsets[i + 1]]] for i in range(len(offsets) - 1)]
+        return np.asarray(self.bic.local_scores(model, model.name(variable), parents_sets))
+
+    def has_variables(self, vars):
+        return self.bic.has_variables(vars)
+
+    def compatible_bn(self, model):
+        return self.bic.compatible_bn(model)
+
+    def __str__(self):
+        return "BatchedBIC"
+
+def test_bic_python_local_scores_batch():
+    gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'])
+    score = BatchedBIC(df)
+
+    evidence_sets = [[], ['a'], ['a', 'b'], ['d', 'b', 'a']]
+    scores = score.local_scores(gbn, 'c', evidence_sets)
+    assert score.batches == [len(evidence_sets)]
+    assert np.all(np.isclose(scores, [score.bic.local_score(gbn, 'c', e) for e in evidence_sets]))
+
+    # The hill-climbing computes the delta scores of the operators with the batched hook.
+    arc_set = pbn.ArcOperatorSet()
+    expected = pbn.GreedyHillClimbing().estimate(arc_set, pbn.BIC(df), gbn)
+    res = pbn.GreedyHillClimbing().estimate(arc_set, score, gbn)
+    assert score.batches[1:]
+    assert set(res.arcs()) == set(expected.arcs())
+
+def test_bic_add_parent_bound():
+    discrete_df = util_test.generate_discrete_data_dependent(SIZE)
+    dbn = pbn.DiscreteBN(['A', 'B', 'C', 'D'])
+    bic = pbn.BIC(discrete_df)
+
+    for variable in ['A', 'B', 'C', 'D']:
+        others = [v for v in ['A', 'B', 'C', 'D'] if v != variable]
+        for parents in [[], others[:1], others[1:]]:
+            current = bic.local_score(dbn, variable, parents)
+            for new_parent in [p for p in others if p not in parents]:
+                bound = bic.add_parent_bound(dbn, variable, parents, new_parent, current)
+                delta = bic.local_score(dbn, variable, parents + [new_parent]) - current
+                assert bound is not None
+                assert bound >= delta - 1e-9
+
+    # The bounds are only known for the discrete variables without null values.
+    gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'])
+    assert pbn.BIC(df).add_parent_bound(gbn, 'c', [], 'a', pbn.BIC(df).local_score(gbn, 'c', [])) is None
+
+    df_null = discrete_df.copy()
+    df_null.loc[df_null.index[:10], 'A'] = np.nan
+    bic_null = pbn.BIC(df_null)
+    assert bic_null.add_parent_bound(dbn, 'C', [], 'A', bic_null.local_score(dbn, 'C', [])) is None
+
+    # The arcs pruned by the bound do not change the result of the hill-climbing. The Python score has no bound.
+    small_df = discrete_df.iloc[:200]
+    arc_set = pbn.ArcOperatorSet()
+    expected = pbn.GreedyHillClimbing().estimate(arc_set, BatchedBIC(small_df), dbn)
+    res = pbn.GreedyHillClimbing().estimate(arc_set, pbn.BIC(small_df), dbn)
+    assert set(res.arcs()) == set(expected.arcs())
+
+def test_bic_weighted():
+    np.random.seed(0)
+    weights = np.random.randint(0, 4, size=SIZE).astype(float)
+    # An integer weight is equivalent to repeating the row.
+    repeat = lambda data: data.iloc[np.repeat(np.arange(SIZE), weights.astype(int))]
+
+    gbn = pbn.GaussianNetwork(['a', 'b', 'c', 'd'])
+    weighted = pbn.BIC(df, weights)
+    repeated = pbn.BIC(repeat(df))
+    for variable, evidence in [('a', []), ('b', ['a']), ('c', ['a', 'b']), ('d', ['a', 'b', 'c'])]:
+        assert np.isclose(weighted.local_score(gbn, variable, evidence),
+                          repeated.local_score(gbn, variable, evidence))
+
+    hybrid_df = util_test.generate_hybrid_data(SIZE)
+    clg = pbn.CLGNetwork(['A', 'B', 'C', 'D'])
+    weighted = pbn.BIC(hybrid_df, weights)
+    repeated = pbn.BIC(repeat(hybrid_df))
+    for evidence in [['A'], ['A', 'B'], ['A', 'B', 'C']]:
+        assert np.isclose(weighted.local_score(clg, 'D', evidence), repeated.local_score(clg, 'D', evidence))
+
+    discrete_df = util_test.generate_discrete_data_dependent(SIZE)
+    dbn = pbn.DiscreteBN(['A', 'B', 'C', 'D'])
+    weighted = pbn.BIC(discrete_df, weights)
+    repeated = pbn.BIC(repeat(discrete_df))
+    parents_sets = [[], ['A'], ['A', 'B']]
+    assert np.allclose(weighted.local_scores(dbn, 'C', parents_sets), repeated.local_scores(dbn, 'C', parents_sets))
+
+    current = weighted.local_score(dbn, 'C', ['A'])
+    bound = weighted.add_parent_bound(dbn, 'C', ['A'], 'B', current)
+    assert np.isclose(bound, repeated.add_parent_bound(dbn, 'C', ['A'], 'B', current))
@@ -88,6 +88,22 @@ def test_cvl_local_score_gbn():
     assert cvl.local_score(gbn, 'c') == cvl.local_score(gbn, 'c', gbn.parents('c'))
     assert cvl.local_score(gbn, 'd') == cvl.local_score(gbn, 'd', gbn.parents('d'))
 
+def test_cvl_local_score_gbn_collinear():
+    collinear_df = df.copy()
+    collinear_df['e'] = 2 * collinear_df['a']
+    gbn = pbn.GaussianNetwork([('a', 'b'), ('e', 'b')])
+
+    cvl = pbn.CVLikelihood(collinear_df, 10, seed)
+
+    # The LinearGaussianCPD cannot be fitted with the fold statistics, so it is fitted with the data of each fold.
+    loglik = 0
+    for train_df, test_df in cvl.cv.loc(['a', 'b', 'e']):
+        cpd = pbn.LinearGaussianCPD('b', ['a', 'e'])
+        cpd.fit(train_df)
+        loglik += cpd.slogl(test_df)
+
+    assert np.isclose(cvl.local_score(gbn, 'b', ['a', 'e']), loglik)
+
 def test_cvl_local_score_gbn_null():
     gbn = pbn.GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
     
@@ -218,4 +234,52 @@ def test_cvl_score():
                             cv.local_score(spbn, 'a') +
                             cv.local_score(spbn, 'b') +
                             cv.local_score(spbn, 'c') +
-                            cv.local_score(spbn, 'd')))
\ No newline at end of file
+                            cv.local_score(spbn, 'd')))
+
+def test_cvl_local_scores_ckde():
+    spbn = pbn.SemiparametricBN([('a', 'c'), ('b', 'c')], [('c', pbn.CKDEType())])
+    cvl = pbn.CVLikelihood(df, 10, 0)
+
+    # The parent sets add or remove one parent of the current parents ['a', 'b'].
+    evidence_sets = [['a', 'b', 'd'], ['a'], ['b'], ['a', 'd', 'b']]
+    scores = cvl.local_scores(spbn, 'c', evidence_sets)
+
+    # The CKDEs are only updated incrementally with the OpenCL backend. Otherwise, they are fitted as in local_score().
+    incremental = pbn.CKDE('c', ['a', 'b']).kde_joint().backend == pbn.KDEBackend.OPENCL
+
+    assert len(scores) == len(evidence_sets)
+    for s, e in zip(scores, evidence_sets):
+        if incremental:
+            assert np.isclose(s, cvl.local_score(spbn, 'c', e))
+        else:
+            assert s == cvl.local_score(spbn, 'c', e)
+        assert np.isclose(s, numpy_local_score(pbn.CKDEType(), df, 'c', e))
+
+def test_cvl_num_threads():
+    gbn = pbn.GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    spbn = pbn.SemiparametricBN([('a', 'c'), ('b', 'c')], [('c', pbn.CKDEType())])
+
+    cvl = pbn.CVLikelihood(df, 10, 0)
+    cvl_parallel = pbn.CVLikelihood(df, 10, 0, num_threads=4)
+
+    # The folds are added in order, so the scores do not depend on the number of threads.
+    assert cvl.score(gbn) == cvl_parallel.score(gbn)
+    assert cvl.local_score(spbn, 'c', ['a', 'b']) == cvl_parallel.local_score(spbn, 'c', ['a', 'b'])
+
+    evidence_sets = [['a', 'b', 'd'], ['a'], ['b']]
+    assert cvl.local_scores(spbn, 'c', evidence_sets) == cvl_parallel.local_scores(spbn, 'c', evidence_sets)
+
+    with pytest.raises(ValueError):
+        pbn.CVLikelihood(df, 10, 0, num_threads=-1)
+
+def test_cvl_float():
+    gbn = pbn.GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    float_df = df.astype('float32')
+
+    cvl = pbn.CVLikelihood(float_df.astype('float64'), 10, 0)
+    float_cvl = pbn.CVLikelihood(float_df, 10, 0)
+
+    # The float statistics are accumulated in double.
+    assert np.isclose(float_cvl.score(gbn), cvl.score(gbn), rtol=1e-4)
+    assert np.isclose(float_cvl.local_score(gbn, 'd', ['a', 'b', 'c']), cvl.local_score(gbn, 'd', ['a', 'b', 'c']),
+                      rtol=1e-4)
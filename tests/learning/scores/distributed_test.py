@@ -0,0 +1,73 @@
+import pickle
+import pytest
+import pybnesian as pbn
+from concurrent.futures import ThreadPoolExecutor
+import util_test
+
+df = util_test.generate_normal_data(1000)
+
+class PoolTransport(pbn.ScoreTransport):
+    # Each worker has its own copy of the data. The model and the requests are pickled, as in a remote transport.
+    def __init__(self, num_workers):
+        pbn.ScoreTransport.__init__(self)
+        self.workers = [pbn.BIC(df.copy()) for _ in range(num_workers)]
+        self.executor = ThreadPoolExecutor(max_workers=num_workers)
+        self.num_requests = 0
+
+    def evaluate(self, model, requests):
+        message = pickle.dumps((model, requests))
+        worker = self.workers[self.num_requests % len(self.workers)]
+        self.num_requests += 1
+
+        def run():
+            worker_model, worker_requests = pickle.loads(message)
+            return pbn.evaluate_local_scores(worker, worker_model, worker_requests)
+
+        return self.executor.submit(run).result()
+
+def test_distributed_score():
+    transport = PoolTransport(2)
+    bic = pbn.BIC(df)
+    distributed = pbn.DistributedScore(bic, transport)
+    assert str(distributed) == "DistributedScore(BIC)"
+
+    gbn = pbn.GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("b", "c")])
+    assert distributed.local_score(gbn, "c", ["a", "b"]) == bic.local_score(gbn, "c", ["a", "b"])
+    assert distributed.local_scores(gbn, "d", [[], ["a"], ["b", "c"]]) == \
+        bic.local_scores(gbn, "d", [[], ["a"], ["b", "c"]])
+
+    hc = pbn.GreedyHillClimbing()
+    arc_set = pbn.ArcOperatorSet()
+    start = pbn.GaussianNetwork(list(df.columns.values))
+
+    expected = hc.estimate(arc_set, bic, start)
+    for num_threads in [1, 4]:
+        transport.num_requests = 0
+        res = hc.estimate(arc_set, distributed, start, num_threads=num_threads)
+        assert set(res.arcs()) == set(expected.arcs())
+        assert bic.score(res) == bic.score(expected)
+        assert transport.num_requests > 0
+
+def test_distributed_score_requests():
+    gbn = pbn.GaussianNetwork(["a", "b", "c", "d"])
+    request = pbn.LocalScoreRequest("a", pbn.LinearGaussianCPDType(), [[], ["b"]])
+    loaded = pickle.loads(pickle.dumps(request))
+    assert loaded.variable == "a"
+    assert loaded.node_type == pbn.LinearGaussianCPDType()
+    assert loaded.parents_sets == [[], ["b"]]
+
+    bic = pbn.BIC(df)
+    res = pbn.evaluate_local_scores(bic, gbn, [loaded, pbn.LocalScoreRequest("b", None, [["c", "d"]])], num_threads=2)
+    assert res == [[bic.local_score(gbn, "a", []), bic.local_score(gbn, "a", ["b"])],
+                   [bic.local_score(gbn, "b", ["c", "d"])]]
+
+    class WrongTransport(pbn.ScoreTransport):
+        def __init__(self):
+            pbn.ScoreTransport.__init__(self)
+
+        def evaluate(self, model, requests):
+            return [[0.0]]
+
+    with pytest.raises(RuntimeError) as ex:
+        pbn.DistributedScore(bic, WrongTransport()).local_scores(gbn, "a", [[], ["b"]])
+    assert "must return 2 local scores" in str(ex.value)
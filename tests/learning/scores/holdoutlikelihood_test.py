@@ -194,4 +194,60 @@ def test_holdout_score():
                             hl.local_score(spbn, 'a') +
                             hl.local_score(spbn, 'b') +
                             hl.local_score(spbn, 'c') +
-                            hl.local_score(spbn, 'd')))
\ No newline at end of file
+                            hl.local_score(spbn, 'd')))
+
+def test_holdout_local_scores_ckde():
+    spbn = pbn.SemiparametricBN([('a', 'c'), ('b', 'c')], [('c', pbn.CKDEType())])
+    hl = pbn.HoldoutLikelihood(df, 0.2, seed)
+
+    # The parent sets add or remove one parent of the current parents ['a', 'b'].
+    evidence_sets = [['a', 'b', 'd'], ['a'], ['b'], ['a', 'd', 'b']]
+    scores = hl.local_scores(spbn, 'c', evidence_sets)
+
+    assert len(scores) == len(evidence_sets)
+    for s, e in zip(scores, evidence_sets):
+        assert np.isclose(s, hl.local_score(spbn, 'c', e))
+        assert np.isclose(s, numpy_local_score(pbn.CKDEType(), hl.training_data().to_pandas(),
+                                               hl.test_data().to_pandas(), 'c', e))
+
+def test_holdout_cached_fits():
+    spbn = pbn.SemiparametricBN([('a', 'c'), ('b', 'c')], [('c', pbn.CKDEType())])
+    hl = pbn.HoldoutLikelihood(df, 0.2, seed)
+
+    def num_fits():
+        stats = pbn.profiler_stats()
+        return sum(stats[name].calls for name in stats if name.startswith("fit:"))
+
+    pbn.reset_profiler()
+    pbn.enable_profiler()
+    try:
+        score = hl.local_score(spbn, 'c', ['a', 'b'])
+        fits = num_fits()
+        assert hl.local_score(spbn, 'c', ['a', 'b']) == score
+        assert num_fits() == fits
+
+        # The CKDE of the current parents is the base of local_scores(), and the fitted parent sets are reused.
+        scores = hl.local_scores(spbn, 'c', [['a'], ['b']])
+        fits = num_fits()
+        assert hl.local_scores(spbn, 'c', [['a'], ['b']]) == scores
+        assert hl.local_score(spbn, 'c', ['a']) == scores[0]
+        assert num_fits() == fits
+    finally:
+        pbn.disable_profiler()
+        pbn.reset_profiler()
+
+    assert np.isclose(score, numpy_local_score(pbn.CKDEType(), hl.training_data().to_pandas(),
+                                               hl.test_data().to_pandas(), 'c', ['a', 'b']))
+
+def test_holdout_max_cache_memory():
+    spbn = pbn.SemiparametricBN([('a', 'c'), ('b', 'c')], [('c', pbn.CKDEType())])
+    hl = pbn.HoldoutLikelihood(df, 0.2, seed)
+
+    score = hl.local_score(spbn, 'c', ['a', 'b'])
+    hl.local_score(spbn, 'c', ['a'])
+    assert hl.memory_usage().components()['fits'][0] > 0
+
+    hl.set_max_cache_memory(0)
+    assert 'fits' not in hl.memory_usage().components()
+    assert hl.local_score(spbn, 'c', ['a', 'b']) == score
+    assert 'fits' not in hl.memory_usage().components()
@@ -1,5 +1,7 @@
+import pickle
 import pytest
 import numpy as np
+import pyarrow as pa
 import pybnesian as pbn
 from pybnesian import BayesianNetwork, GaussianNetwork
 import util_test
@@ -218,6 +220,135 @@ def test_arcs():
     assert not gbn.has_path('a', 'c')
     assert not gbn.has_path('b', 'c')
 
+def test_arcs_reachability():
+    nodes = ["n" + str(i) for i in range(30)]
+    gbn = GaussianNetwork(nodes)
+
+    def reachable(source, target):
+        stack = gbn.children(source)
+        visited = set(stack)
+        while stack:
+            v = stack.pop()
+            if v == target:
+                return True
+            for ch in gbn.children(v):
+                if ch not in visited:
+                    visited.add(ch)
+                    stack.append(ch)
+        return False
+
+    rng = np.random.default_rng(0)
+    for _ in range(300):
+        source, target = rng.choice(nodes, 2, replace=False)
+        if gbn.has_arc(source, target) and rng.random() < 0.3:
+            gbn.remove_arc(source, target)
+        elif gbn.can_add_arc(source, target):
+            gbn.add_arc(source, target)
+
+        # Many queries without changes in the arcs use the reachability index.
+        for _ in range(20):
+            source, target = rng.choice(nodes, 2, replace=False)
+            assert gbn.has_path(source, target) == reachable(source, target)
+            assert gbn.can_add_arc(source, target) == (not reachable(target, source))
+            if gbn.has_arc(source, target):
+                gbn.remove_arc(source, target)
+                can_flip = not reachable(source, target)
+                gbn.add_arc(source, target)
+                assert gbn.can_flip_arc(source, target) == can_flip
+
+def test_parents_children_order():
+    nodes = ["n" + str(i) for i in range(20)]
+    gbn = GaussianNetwork(nodes)
+
+    rng = np.random.default_rng(1)
+    for _ in range(200):
+        source, target = rng.choice(nodes, 2, replace=False)
+        if gbn.has_arc(source, target):
+            gbn.remove_arc(source, target)
+        elif gbn.can_add_arc(source, target):
+            gbn.add_arc(source, target)
+
+    # The adjacent nodes are stored sorted by index.
+    for n in nodes:
+        assert gbn.parents(n) == sorted(gbn.parents(n), key=gbn.index)
+        assert gbn.children(n) == sorted(gbn.children(n), key=gbn.index)
+        assert gbn.num_parents(n) == len(set(gbn.parents(n)))
+
+    for s, t in gbn.arcs():
+        assert s in gbn.parents(t)
+        assert t in gbn.children(s)
+
+    n0_index = gbn.index("n0")
+    gbn.remove_node("n0")
+    for n in gbn.nodes():
+        assert "n0" not in gbn.parents(n)
+        assert "n0" not in gbn.children(n)
+
+    # The index of the removed node is reused by the next added node, which has no adjacent nodes.
+    assert gbn.add_node("new") == n0_index
+    assert gbn.parents("new") == [] and gbn.children("new") == []
+    for n in gbn.nodes():
+        assert "new" not in gbn.parents(n)
+        assert "new" not in gbn.children(n)
+
+    for n in nodes[1:]:
+        if gbn.can_add_arc("new", n):
+            gbn.add_arc("new", n)
+
+    for n in gbn.nodes():
+        assert gbn.parents(n) == sorted(gbn.parents(n), key=gbn.index)
+        assert gbn.children(n) == sorted(gbn.children(n), key=gbn.index)
+
+    for s, t in gbn.arcs():
+        assert s in gbn.parents(t)
+        assert t in gbn.children(s)
+
+def test_topological_sort_cache():
+    gbn = GaussianNetwork(['a', 'b', 'c', 'd'])
+
+    def check_order(bn):
+        top_sort = bn.graph().topological_sort()
+        assert sorted(top_sort) == sorted(bn.nodes())
+        position = {n: i for i, n in enumerate(top_sort)}
+        for s, t in bn.arcs():
+            assert position[s] < position[t]
+
+    check_order(gbn)
+    gbn.add_arc('d', 'c')
+    check_order(gbn)
+    gbn.add_arc('c', 'a')
+    check_order(gbn)
+    gbn.flip_arc('d', 'c')
+    check_order(gbn)
+    gbn.remove_arc('c', 'a')
+    gbn.add_arc('a', 'd')
+    check_order(gbn)
+    gbn.add_node('e')
+    gbn.add_arc('e', 'a')
+    check_order(gbn)
+    gbn.remove_node('a')
+    check_order(gbn)
+
+def test_add_arcs():
+    gbn = GaussianNetwork(['a', 'b', 'c', 'd'])
+    gbn.add_arcs([('a', 'b'), ('b', 'c'), ('a', 'c'), ('a', 'b')])
+    assert set(gbn.arcs()) == {('a', 'b'), ('b', 'c'), ('a', 'c')}
+    assert gbn.num_arcs() == 3
+
+    with pytest.raises(RuntimeError):
+        gbn.add_arcs([('c', 'd'), ('d', 'a')])
+    # The network is unchanged if the arcs would create a cycle.
+    assert set(gbn.arcs()) == {('a', 'b'), ('b', 'c'), ('a', 'c')}
+
+    dag = pbn.Dag(['a', 'b', 'c'])
+    dag.add_arcs([(0, 1), (1, 2)])
+    assert set(dag.arcs()) == {('a', 'b'), ('b', 'c')}
+    with pytest.raises(RuntimeError):
+        dag.add_arcs([('c', 'a')])
+
+    unpickled = pickle.loads(pickle.dumps(dag))
+    assert set(unpickled.arcs()) == {('a', 'b'), ('b', 'c')}
+
 def test_bn_fit():
     gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
 
@@ -321,6 +452,343 @@ def test_bn_logl():
     assert np.isclose(sll, ll.sum())
     assert sll == sum_sll
 
+def test_bn_logl_parallel():
+    gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.fit(df)
+
+    test_df = util_test.generate_normal_data(5000)
+    ll = gbn.logl(test_df)
+    sll = gbn.slogl(test_df)
+
+    for num_threads in [0, 2, 3]:
+        parallel_ll = gbn.logl(test_df, num_threads=num_threads)
+        assert np.allclose(parallel_ll, ll)
+        assert np.isclose(gbn.slogl(test_df, num_threads=num_threads), sll)
+        # The reduction order only depends on the number of threads.
+        assert np.all(gbn.logl(test_df, num_threads=num_threads) == parallel_ll)
+
+    unfitted = GaussianNetwork(['a', 'b'])
+    with pytest.raises(ValueError):
+        unfitted.logl(test_df, num_threads=2)
+
+def test_bn_logl_deterministic():
+    gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.fit(df)
+    test_df = util_test.generate_normal_data(5000)
+
+    assert not pbn.deterministic_mode()
+    pbn.set_deterministic_mode(True)
+    try:
+        assert pbn.deterministic_mode()
+        ll = gbn.logl(test_df)
+        deterministic_ll = gbn.logl(test_df, num_threads=1)
+        assert np.allclose(deterministic_ll, ll)
+        sll = gbn.slogl(test_df)
+
+        for num_threads in [0, 2, 3, 5]:
+            assert np.all(gbn.logl(test_df, num_threads=num_threads) == deterministic_ll)
+            assert gbn.slogl(test_df, num_threads=num_threads) == sll
+
+            out = np.full(5000, np.nan)
+            gbn.logl(test_df, num_threads=num_threads, out=out)
+            assert np.all(out == deterministic_ll)
+    finally:
+        pbn.set_deterministic_mode(False)
+
+def test_bn_logl_out():
+    arcs = [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')]
+    test_df = util_test.generate_normal_data(5000)
+
+    for model in [GaussianNetwork(arcs), BayesianNetwork(pbn.GaussianNetworkType(), arcs)]:
+        model.fit(df)
+        ll = model.logl(test_df)
+
+        out = np.full(5000, np.nan)
+        assert model.logl(test_df, out=out) is out
+        assert np.all(out == ll)
+
+        for num_threads in [2, 3]:
+            model.logl(test_df, num_threads=num_threads, out=out)
+            assert np.all(out == model.logl(test_df, num_threads=num_threads))
+
+        with pytest.raises(ValueError):
+            model.logl(test_df, out=np.empty(100))
+
+def test_kde_network_logl_parallel():
+    # The threads evaluate the same CKDEs, each one with its own OpenCL kernels and queues.
+    kde = pbn.KDENetwork(['a', 'b', 'c', 'd'], [('a', 'b'), ('a', 'c'), ('b', 'c'), ('c', 'd')])
+    kde.fit(df.iloc[:2000])
+
+    test_df = util_test.generate_normal_data(3000, seed=1)
+    ll = kde.logl(test_df)
+
+    for num_threads in [2, 4]:
+        assert np.allclose(kde.logl(test_df, num_threads=num_threads), ll)
+        assert np.isclose(kde.slogl(test_df, num_threads=num_threads), ll.sum())
+
+def test_bn_logl_batches():
+    gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.fit(df)
+
+    test_df = util_test.generate_normal_data(5000)
+    ll = gbn.logl(test_df)
+    sll = gbn.slogl(test_df)
+
+    table = pa.Table.from_pandas(test_df, preserve_index=False)
+    batches = table.to_batches(max_chunksize=1000)
+    assert len(batches) == 5
+
+    for source in [table, batches, pa.RecordBatchReader.from_batches(table.schema, batches),
+                   (test_df.iloc[i:i + 1000] for i in range(0, 5000, 1000))]:
+        batch_ll = np.concatenate(list(gbn.logl_batches(source)))
+        assert np.allclose(batch_ll, ll)
+
+    assert np.isclose(gbn.slogl_batches(table), sll)
+    assert np.isclose(gbn.slogl_batches(iter(batches), num_threads=2), sll)
+    assert gbn.slogl_batches([]) == 0
+
+class ShiftedNetwork(BayesianNetwork):
+    def __init__(self, arcs):
+        BayesianNetwork.__init__(self, pbn.GaussianNetworkType(), arcs)
+
+    def logl(self, df):
+        return super().logl(df, num_threads=2) + 1
+
+    def slogl(self, df):
+        return super().slogl(df, num_threads=2) + 1
+
+def test_python_bn_logl_override():
+    arcs = [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')]
+    gbn = GaussianNetwork(arcs)
+    gbn.fit(df)
+    shifted = ShiftedNetwork(arcs)
+    shifted.fit(df)
+
+    test_df = util_test.generate_normal_data(5000)
+    ll = gbn.logl(test_df)
+    assert np.allclose(shifted.logl(test_df), ll + 1)
+    assert np.isclose(shifted.slogl(test_df), gbn.slogl(test_df) + 1)
+
+    # The batches of a Python-derived network are evaluated with its overrides for any number of threads.
+    table = pa.Table.from_pandas(test_df, preserve_index=False)
+    for num_threads in [1, 2]:
+        batch_ll = np.concatenate(list(shifted.logl_batches(table.to_batches(max_chunksize=1000),
+                                                            num_threads=num_threads)))
+        assert np.allclose(batch_ll, ll + 1)
+        assert np.isclose(shifted.slogl_batches(table.to_batches(max_chunksize=1000), num_threads=num_threads),
+                          gbn.slogl(test_df) + 5)
+
+def test_bn_fused_fit():
+    arcs = [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')]
+    gbn = GaussianNetwork(arcs)
+    gbn.fit(df)
+
+    fused = GaussianNetwork(arcs)
+    fused.fit(df, fused=True)
+    for n in gbn.nodes():
+        assert fused.cpd(n).fitted()
+        assert np.allclose(fused.cpd(n).beta, gbn.cpd(n).beta)
+        assert np.isclose(fused.cpd(n).variance, gbn.cpd(n).variance)
+
+    null_df = df.copy()
+    null_df.loc[null_df.index[:10], 'b'] = np.nan
+    gbn = GaussianNetwork(arcs)
+    gbn.fit(null_df)
+    fused = GaussianNetwork(arcs)
+    fused.fit(null_df, fused=True, num_threads=2)
+    assert np.allclose(fused.logl(df), gbn.logl(df))
+
+    discrete_df = util_test.generate_discrete_data_dependent(1000)
+    dbn = pbn.DiscreteBN([('A', 'B'), ('A', 'C'), ('B', 'C'), ('C', 'D')])
+    dbn.fit(discrete_df)
+    fused_dbn = pbn.DiscreteBN([('A', 'B'), ('A', 'C'), ('B', 'C'), ('C', 'D')])
+    fused_dbn.fit(discrete_df, fused=True)
+    for n in dbn.nodes():
+        assert fused_dbn.cpd(n).fitted()
+    assert np.allclose(fused_dbn.logl(discrete_df), dbn.logl(discrete_df))
+
+def test_clg_partition():
+    hybrid_df = util_test.generate_hybrid_data(2000)
+    null_df = hybrid_df.copy()
+    null_df.loc[null_df.index[:20], 'C'] = np.nan
+    null_df.loc[null_df.index[20:30], 'A'] = np.nan
+
+    for fit_df in [hybrid_df, null_df]:
+        clg = pbn.CLGNetwork([('A', 'D'), ('B', 'D'), ('C', 'D')])
+        clg.fit(fit_df)
+
+        expected = np.full(fit_df.shape[0], np.nan)
+        for a in ['a1', 'a2']:
+            for b in ['b1', 'b2', 'b3']:
+                mask = ((fit_df['A'] == a) & (fit_df['B'] == b)).to_numpy()
+                lg = pbn.LinearGaussianCPD('D', ['C'])
+                lg.fit(fit_df[mask])
+                expected[mask] = lg.logl(fit_df[mask])
+
+        assert np.allclose(clg.cpd('D').logl(fit_df), expected, equal_nan=True)
+        assert np.isclose(clg.cpd('D').slogl(fit_df), np.nansum(expected))
+
+def test_bn_float_fit():
+    arcs = [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')]
+    # A large offset makes the naive float reductions lose precision.
+    float_df = (df + 1e4).astype('float32')
+    double_df = float_df.astype('float64')
+
+    gbn = GaussianNetwork(arcs)
+    gbn.fit(double_df)
+    float_gbn = GaussianNetwork(arcs)
+    float_gbn.fit(float_df)
+    fused = GaussianNetwork(arcs)
+    fused.fit(float_df, fused=True)
+
+    for n in gbn.nodes():
+        assert np.allclose(float_gbn.cpd(n).beta, gbn.cpd(n).beta, rtol=1e-3, atol=1e-3)
+        assert np.isclose(float_gbn.cpd(n).variance, gbn.cpd(n).variance, rtol=1e-3)
+        assert np.allclose(fused.cpd(n).beta, gbn.cpd(n).beta, rtol=1e-3, atol=1e-3)
+        assert np.isclose(fused.cpd(n).variance, gbn.cpd(n).variance, rtol=1e-3)
+
+def test_bn_compile():
+    gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.fit(df)
+
+    test_df = util_test.generate_normal_data(5000)
+    batch = pa.RecordBatch.from_pandas(test_df, preserve_index=False)
+    plan = gbn.compile(batch.schema)
+    assert plan.schema == batch.schema
+
+    assert np.allclose(plan.logl(batch), gbn.logl(batch))
+    assert np.isclose(plan.slogl(batch), gbn.slogl(batch))
+    assert np.allclose(plan.logl(batch.slice(10, 1)), gbn.logl(batch.slice(10, 1)))
+    assert np.allclose(gbn.compile(test_df).logl(test_df.iloc[:1]), gbn.logl(test_df.iloc[:1]))
+
+    null_df = test_df.copy()
+    null_df.loc[null_df.index[:10], 'b'] = np.nan
+    null_batch = pa.RecordBatch.from_pandas(null_df, preserve_index=False)
+    assert np.allclose(plan.logl(null_batch), gbn.logl(null_batch), equal_nan=True)
+    assert np.isclose(plan.slogl(null_batch), gbn.slogl(null_batch))
+
+    discrete_df = util_test.generate_discrete_data_dependent(1000)
+    dbn = pbn.DiscreteBN([('A', 'B'), ('B', 'C'), ('C', 'D')])
+    dbn.fit(discrete_df)
+    discrete_plan = dbn.compile(discrete_df)
+    assert np.allclose(discrete_plan.logl(discrete_df), dbn.logl(discrete_df))
+    assert np.isclose(discrete_plan.slogl(discrete_df), dbn.slogl(discrete_df))
+
+    missing_batch = pa.RecordBatch.from_pandas(test_df[['a', 'b', 'c']], preserve_index=False)
+    with pytest.raises(ValueError) as ex:
+        plan.logl(missing_batch)
+    assert "schema" in str(ex.value)
+
+    with pytest.raises(ValueError):
+        gbn.compile(missing_batch.schema)
+
+    with pytest.raises(ValueError):
+        GaussianNetwork(['a', 'b']).compile(batch.schema)
+
+def test_bn_compile_opencl():
+    gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.fit(df)
+
+    test_df = util_test.generate_normal_data(5000, seed=1)
+    plan = gbn.compile(test_df, backend=pbn.KDEBackend.OPENCL)
+    assert plan.backend == pbn.KDEBackend.OPENCL
+    assert gbn.compile(test_df).backend == pbn.KDEBackend.CPU
+
+    logl = gbn.logl(test_df)
+    assert np.allclose(plan.logl(test_df), logl)
+    assert np.isclose(plan.slogl(test_df), gbn.slogl(test_df))
+
+    try:
+        for columns in [7, 4999]:
+            pbn.set_opencl_tile_columns(columns)
+            assert np.allclose(plan.logl(test_df), logl)
+    finally:
+        pbn.set_opencl_tile_columns(0)
+
+    null_df = test_df.copy()
+    null_df.loc[null_df.index[:10], 'b'] = np.nan
+    assert np.allclose(plan.logl(null_df), gbn.logl(null_df), equal_nan=True)
+    assert np.isclose(plan.slogl(null_df), gbn.slogl(null_df))
+
+    hybrid_df = util_test.generate_hybrid_data(1000)
+    clg = pbn.CLGNetwork([('A', 'C'), ('C', 'D')])
+    clg.fit(hybrid_df)
+    hybrid_plan = clg.compile(hybrid_df, backend=pbn.KDEBackend.OPENCL)
+    assert np.allclose(hybrid_plan.logl(hybrid_df), clg.logl(hybrid_df))
+    assert np.isclose(hybrid_plan.slogl(hybrid_df), clg.slogl(hybrid_df))
+
+def test_bn_logl_instance():
+    gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.fit(df)
+
+    test_df = util_test.generate_normal_data(20)
+    plan = gbn.compile(test_df)
+    logl = gbn.logl(test_df)
+    for i in range(test_df.shape[0]):
+        row = test_df.iloc[i]
+        assert np.isclose(plan.logl_instance(row.to_dict()), logl[i])
+        assert np.isclose(plan.logl_instance(row.tolist()), logl[i])
+
+    discrete_df = util_test.generate_discrete_data_dependent(1000)
+    dbn = pbn.DiscreteBN([('A', 'B'), ('B', 'C'), ('C', 'D')])
+    dbn.fit(discrete_df)
+    discrete_plan = dbn.compile(discrete_df)
+    discrete_logl = dbn.logl(discrete_df.iloc[:20])
+    for i in range(20):
+        row = {k: str(v) for k, v in discrete_df.iloc[i].items()}
+        assert np.isclose(discrete_plan.logl_instance(row), discrete_logl[i])
+
+    hybrid_df = util_test.generate_hybrid_data(1000)
+    clg = pbn.CLGNetwork([('A', 'D'), ('B', 'D'), ('C', 'D')])
+    clg.fit(hybrid_df)
+    hybrid_plan = clg.compile(hybrid_df)
+    hybrid_logl = clg.logl(hybrid_df.iloc[:20])
+    for i in range(20):
+        row = hybrid_df.iloc[i]
+        values = {'A': str(row['A']), 'B': str(row['B']), 'C': float(row['C']), 'D': float(row['D'])}
+        assert np.isclose(hybrid_plan.logl_instance(values), hybrid_logl[i])
+
+    with pytest.raises(ValueError) as ex:
+        plan.logl_instance({'a': 0., 'b': 0., 'c': 0.})
+    assert "does not contain a value" in str(ex.value)
+
+    with pytest.raises(ValueError):
+        plan.logl_instance([0., 0., 0.])
+
+    with pytest.raises(ValueError) as ex:
+        discrete_plan.logl_instance({'A': 'missing', 'B': 'b1', 'C': 'c1', 'D': 'd1'})
+    assert "is not a category" in str(ex.value)
+
+def test_bn_partial_fit():
+    gbn = GaussianNetwork(['a', 'b', 'c', 'd'], [('a', 'b'), ('a', 'c'), ('b', 'c'), ('c', 'd')])
+    gbn.fit(df)
+
+    updated = GaussianNetwork(['a', 'b', 'c', 'd'], [('a', 'b'), ('a', 'c'), ('b', 'c'), ('c', 'd')])
+    updated.partial_fit(df.iloc[:4000])
+    updated.partial_fit(df.iloc[4000:], num_threads=2)
+    assert updated.fitted()
+    assert np.allclose(updated.logl(df), gbn.logl(df))
+
+    with pytest.raises(ValueError) as ex:
+        gbn.partial_fit(df)
+    assert "does not have sufficient statistics" in str(ex.value)
+
+    # The CLinearGaussianCPD updates the factor of each discrete configuration.
+    hybrid_df = util_test.generate_hybrid_data(4000)
+    clg = pbn.CLGNetwork([('A', 'D'), ('B', 'D'), ('C', 'D')])
+    clg.fit(hybrid_df)
+
+    updated_clg = pbn.CLGNetwork([('A', 'D'), ('B', 'D'), ('C', 'D')])
+    for start in range(0, 4000, 1000):
+        updated_clg.partial_fit(hybrid_df.iloc[start:start + 1000])
+    assert np.allclose(updated_clg.logl(hybrid_df), clg.logl(hybrid_df))
+
+    updated_clg.include_cpd = True
+    loaded = pickle.loads(pickle.dumps(updated_clg))
+    loaded.partial_fit(hybrid_df.iloc[:500], 0.9)
+    updated_clg.partial_fit(hybrid_df.iloc[:500], 0.9)
+    assert np.allclose(loaded.logl(hybrid_df), updated_clg.logl(hybrid_df))
+
 def test_bn_sample():
     gbn = GaussianNetwork(['a', 'c', 'b', 'd'], [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
 
@@ -346,3 +814,187 @@ def test_bn_sample():
     assert not sample.column(1).equals(other_seed.column(2))
     assert not sample.column(2).equals(other_seed.column(1))
     assert not sample.column(3).equals(other_seed.column(3))
+
+def test_bn_sample_parallel():
+    gbn = GaussianNetwork(['a', 'c', 'b', 'd'], [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd')])
+    gbn.fit(df)
+
+    # A single block is sampled as the serial sample.
+    sample = gbn.sample(1000, 0, False)
+    for num_threads in [2, 0]:
+        assert gbn.sample(1000, 0, False, num_threads=num_threads).equals(sample)
+
+    # The result does not depend on the number of threads when there are many blocks.
+    n = 3 * 65536 + 100
+    sample = gbn.sample(n, 0, True)
+    assert sample.schema.names == ['a', 'c', 'b', 'd']
+    assert sample.num_rows == n
+    for num_threads in [2, 3, 0]:
+        assert gbn.sample(n, 0, True, num_threads=num_threads).equals(sample)
+
+    # The blocks use different seeds.
+    a = sample.column(0).to_numpy()
+    assert not (a[:65536] == a[65536:2*65536]).all()
+
+    other_seed = gbn.sample(n, 1, True, num_threads=2)
+    assert not sample.column(0).equals(other_seed.column(0))
+
+def test_cbn_sample_draws():
+    cgbn = pbn.ConditionalGaussianNetwork(['c', 'b', 'd'], ['a'], [('a', 'b'), ('a', 'c'), ('b', 'c'), ('b', 'd')])
+    cgbn.fit(df)
+
+    evidence = df[['a']]
+    sample = cgbn.sample(evidence, 0)
+    assert sorted(sample.schema.names) == ['b', 'c', 'd']
+    assert sample.num_rows == df.shape[0]
+
+    for num_threads in [2, 0]:
+        assert cgbn.sample(evidence, 0, num_threads=num_threads).equals(sample)
+
+    draws = cgbn.sample(evidence, 0, concat_evidence=True, ordered=True, num_threads=2, draws=3)
+    N = df.shape[0]
+    assert draws.schema.names == ['c', 'b', 'd', 'a']
+    assert draws.num_rows == 3 * N
+
+    # The first draw is equal to a single sample.
+    assert draws.slice(0, N).column(1).equals(sample.column(sample.schema.get_field_index('b')))
+    assert not draws.slice(0, N).column(1).equals(draws.slice(N, N).column(1))
+
+    a = draws.column(3).to_numpy()
+    for k in range(3):
+        assert (a[k*N:(k+1)*N] == df['a'].to_numpy()).all()
+
+    assert cgbn.sample(evidence, 0, concat_evidence=True, ordered=True, draws=3).equals(draws)
+
+    with pytest.raises(ValueError) as ex:
+        cgbn.sample(evidence, 0, draws=0)
+    assert "draws must be a positive number" in str(ex.value)
+
+def test_gbn_logl_fused():
+    # GaussianNetwork evaluates all the LinearGaussianCPDs in one pass with the same operations of each CPD.
+    gbn = GaussianNetwork([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.fit(df)
+
+    # The number of rows is not a multiple of the size of the blocks.
+    test_df = util_test.generate_normal_data(1234, seed=1)
+    sum_ll = sum(gbn.cpd(n).logl(test_df) for n in gbn.nodes())
+    assert np.all(gbn.logl(test_df) == sum_ll)
+    assert gbn.slogl(test_df) == sum(gbn.cpd(n).slogl(test_df) for n in gbn.nodes())
+
+    float_df = test_df.astype('float32')
+    sum_ll = sum(gbn.cpd(n).logl(float_df) for n in gbn.nodes())
+    assert np.all(gbn.logl(float_df) == sum_ll)
+    assert gbn.slogl(float_df) == sum(gbn.cpd(n).slogl(float_df) for n in gbn.nodes())
+
+    # The columns with null values are evaluated by each CPD.
+    null_df = test_df.copy()
+    null_df.loc[::7, 'b'] = np.nan
+    ll = gbn.logl(null_df)
+    assert np.all(np.isnan(ll[::7]))
+    assert np.allclose(ll[1::7], sum(gbn.cpd(n).logl(null_df) for n in gbn.nodes())[1::7])
+    assert np.isclose(gbn.slogl(null_df), sum(gbn.cpd(n).slogl(null_df) for n in gbn.nodes()))
+
+    cgbn = pbn.ConditionalGaussianNetwork(['c', 'b', 'd'], ['a'], [('a', 'b'), ('a', 'c'), ('b', 'c'), ('b', 'd')])
+    cgbn.fit(df)
+    assert np.all(cgbn.logl(test_df) == sum(cgbn.cpd(n).logl(test_df) for n in cgbn.nodes()))
+    assert cgbn.slogl(test_df) == sum(cgbn.cpd(n).slogl(test_df) for n in cgbn.nodes())
+
+def test_ensemble_logl():
+    arcs = [('a', 'b'), ('a', 'c'), ('b', 'c'), ('c', 'd')]
+    models = [GaussianNetwork(arcs), GaussianNetwork(arcs), GaussianNetwork(['a', 'b', 'c', 'd'], [('a', 'b')])]
+    for model in models:
+        model.fit(df)
+
+    # The models share the families fitted with the same data: 4 CPDs of the first model and c, d without parents.
+    ensemble = pbn.EnsembleLogl(models)
+    assert ensemble.num_models() == 3
+    assert ensemble.num_factors() == 6
+
+    # The test DataFrame contains more than one block of instances.
+    test_df = util_test.generate_normal_data(20000, seed=1)
+    test_df.loc[test_df.index[:10], 'b'] = np.nan
+    for num_threads in [1, 4]:
+        logl = ensemble.logl(test_df, num_threads)
+        assert logl.shape == (test_df.shape[0], 3)
+        slogl = ensemble.slogl(test_df, num_threads)
+        for i, model in enumerate(models):
+            assert np.allclose(logl[:, i], model.logl(test_df), equal_nan=True)
+            assert np.isclose(slogl[i], model.slogl(test_df))
+
+    discrete_df = util_test.generate_discrete_data_dependent(1000)
+    discrete_df.loc[discrete_df.index[:10], 'A'] = np.nan
+    dbns = [pbn.DiscreteBN([('A', 'B'), ('B', 'C'), ('C', 'D')]),
+            pbn.DiscreteBN([('A', 'B'), ('B', 'C'), ('C', 'D')]),
+            pbn.DiscreteBN([('A', 'C'), ('B', 'C'), ('C', 'D')])]
+    dbns[0].fit(discrete_df)
+    dbns[1].fit(discrete_df.iloc[:500])
+    dbns[2].fit(discrete_df)
+
+    discrete_ensemble = pbn.EnsembleLogl(dbns)
+    # A and D of the first and the third model are the same.
+    assert discrete_ensemble.num_factors() == 4 + 4 + 2
+    discrete_logl = discrete_ensemble.logl(discrete_df)
+    discrete_slogl = discrete_ensemble.slogl(discrete_df)
+    for i, model in enumerate(dbns):
+        assert np.allclose(discrete_logl[:, i], model.logl(discrete_df), equal_nan=True)
+        assert np.isclose(discrete_slogl[i], model.slogl(discrete_df))
+
+    with pytest.raises(ValueError) as ex:
+        pbn.EnsembleLogl([GaussianNetwork(['a', 'b'])])
+    assert "not fitted" in str(ex.value)
+
+def test_cross_validated_logl():
+    arcs = [('a', 'b'), ('a', 'c'), ('b', 'c'), ('c', 'd')]
+    gbn = GaussianNetwork(arcs)
+    cv = pbn.CrossValidation(df, 5, seed=0)
+
+    expected = np.empty((5, 4))
+    for i, (train_df, test_df) in enumerate(cv):
+        model = GaussianNetwork(arcs)
+        model.fit(train_df)
+        for j, node in enumerate(gbn.nodes()):
+            expected[i, j] = model.cpd(node).slogl(test_df)
+
+    for num_threads in [1, 4]:
+        res = pbn.cross_validated_logl(gbn, cv, num_threads=num_threads)
+        assert res.nodes == gbn.nodes()
+        assert res.node_slogl.shape == (5, 4)
+        assert np.allclose(res.node_slogl, expected)
+        assert np.allclose(res.fold_slogl(), expected.sum(axis=1))
+        assert np.isclose(res.slogl(), expected.sum())
+
+    # The CPDs of a fitted model are not used.
+    gbn.fit(df)
+    assert np.allclose(pbn.cross_validated_logl(gbn, cv).node_slogl, expected)
+
+    spbn = pbn.SemiparametricBN(arcs, [('c', pbn.CKDEType())])
+    res = pbn.cross_validated_logl(spbn, cv, num_threads=2)
+    for i, (train_df, test_df) in enumerate(cv):
+        model = pbn.SemiparametricBN(arcs, [('c', pbn.CKDEType())])
+        model.fit(train_df)
+        assert np.isclose(res.fold_slogl()[i], model.slogl(test_df))
+
+    with pytest.raises(ValueError):
+        pbn.cross_validated_logl(GaussianNetwork(['a', 'e']), cv)
+
+def test_bn_conditional_conversion():
+    gbn = GaussianNetwork(['e', 'a', 'b', 'c', 'd'], [('e', 'a'), ('a', 'b'), ('a', 'c'), ('b', 'd'), ('c', 'd')])
+    gbn.remove_node('e')
+
+    cbn = gbn.conditional_bn(['d', 'c'], ['b', 'a'])
+    assert set(cbn.nodes()) == {'c', 'd'}
+    assert set(cbn.interface_nodes()) == {'a', 'b'}
+    assert set(cbn.arcs()) == set(gbn.arcs())
+
+    ubn = cbn.unconditional_bn()
+    assert set(ubn.nodes()) == {'a', 'b', 'c', 'd'}
+    assert set(ubn.arcs()) == set(gbn.arcs())
+
+    with pytest.raises(ValueError):
+        gbn.conditional_bn(['a', 'b'], ['c', 'd'])
+
+    pdag = pbn.PartiallyDirectedGraph(['a', 'b', 'c', 'd'], [('a', 'c'), ('b', 'c')], [('c', 'd')])
+    cpdag = pdag.conditional_graph(['c', 'd'], ['a', 'b'])
+    assert set(cpdag.arcs()) == {('a', 'c'), ('b', 'c')}
+    assert cpdag.edges() in ([('c', 'd')], [('d', 'c')])
+    assert set(cpdag.unconditional_graph().arcs()) == {('a', 'c'), ('b', 'c')}
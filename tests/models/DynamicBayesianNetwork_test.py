@@ -202,4 +202,103 @@ def test_slogl_dbn():
     gbn.fit(df)
     test_df = util_test.generate_normal_data(100)
     ll = numpy_logl(gbn, test_df)
-    assert np.isclose(gbn.slogl(test_df), ll.sum())
\ No newline at end of file
+    assert np.isclose(gbn.slogl(test_df), ll.sum())
+
+def test_parallel_logl_dbn():
+    variables = ["a", "b", "c", "d"]
+    gbn = DynamicGaussianNetwork(variables, 2)
+    gbn.static_bn().add_arc("a_t_2", "c_t_2")
+    gbn.static_bn().add_arc("c_t_1", "d_t_1")
+    gbn.transition_bn().add_arc("a_t_1", "a_t_0")
+    gbn.transition_bn().add_arc("b_t_2", "c_t_0")
+    gbn.transition_bn().add_arc("c_t_0", "d_t_0")
+    gbn.fit(df)
+
+    test_df = util_test.generate_normal_data(1000)
+    ll = gbn.logl(test_df)
+    sll = gbn.slogl(test_df)
+    for num_threads in [2, 3, 0]:
+        assert np.all(gbn.logl(test_df, num_threads=num_threads) == ll)
+        assert gbn.slogl(test_df, num_threads=num_threads) == sll
+
+    with pytest.raises(ValueError, match="Not enough information"):
+        gbn.logl(test_df.iloc[:1], num_threads=2)
+
+def test_sample_batches_dbn():
+    variables = ["a", "b", "c", "d"]
+    dbn = DynamicGaussianNetwork(variables, 2)
+    dbn.fit(df)
+
+    sampler = dbn.sample_batches(10, 4, num_trajectories=3, seed=0)
+    batches = [b.to_pandas() for b in sampler]
+    assert [b.shape[0] for b in batches] == [12, 12, 6]
+    assert sampler.time_step == 10
+    for b in batches:
+        assert list(b.columns.values) == variables
+
+    # The first markovian_order time steps are sampled by the static BN.
+    static_sample = dbn.static_bn().sample(3, seed=0).to_pandas()
+    for v in variables:
+        assert np.all(batches[0][v].to_numpy()[:3] == static_sample[v + "_t_2"].to_numpy())
+        assert np.all(batches[0][v].to_numpy()[3:6] == static_sample[v + "_t_1"].to_numpy())
+
+    sample = pd.concat(batches, ignore_index=True)
+    parallel = pd.concat([b.to_pandas() for b in dbn.sample_batches(10, 3, num_trajectories=3, seed=0, num_threads=3)],
+                         ignore_index=True)
+    assert sample.equals(parallel)
+
+    with pytest.raises(ValueError, match="batch_steps must be a positive number"):
+        dbn.sample_batches(10, 0)
+
+    with pytest.raises(ValueError, match="num_trajectories must be a positive number"):
+        dbn.sample_batches(10, 2, num_trajectories=0)
+
+    # The variables with the same CPD are sampled with different seeds in each time step.
+    same = DynamicGaussianNetwork(["a", "b"], 1)
+    same.static_bn().add_cpds([pbn.LinearGaussianCPD("a_t_1", [], [0], 1), pbn.LinearGaussianCPD("b_t_1", [], [0], 1)])
+    same.transition_bn().add_cpds([pbn.LinearGaussianCPD("a_t_0", [], [0], 1),
+                                   pbn.LinearGaussianCPD("b_t_0", [], [0], 1)])
+    sample = pd.concat([b.to_pandas() for b in same.sample_batches(6, 6, num_trajectories=50, seed=0)],
+                       ignore_index=True)
+    steps = [sample.iloc[50 * k:50 * (k + 1)] for k in range(6)]
+    for k in range(5):
+        for v1, v2 in [("a", "b"), ("b", "a")]:
+            assert not np.array_equal(steps[k][v1].to_numpy(), steps[k + 1][v2].to_numpy())
+            assert abs(np.corrcoef(steps[k][v1].to_numpy(), steps[k + 1][v2].to_numpy())[0, 1]) < 0.9
+
+def test_logl_filter_dbn():
+    variables = ["a", "b", "c", "d"]
+    dbn = DynamicGaussianNetwork(variables, 2)
+    dbn.transition_bn().add_arc("a_t_1", "a_t_0")
+    dbn.transition_bn().add_arc("a_t_2", "b_t_0")
+    dbn.transition_bn().add_arc("c_t_1", "c_t_0")
+    dbn.transition_bn().add_arc("c_t_0", "d_t_0")
+    dbn.fit(df)
+
+    with pytest.raises(ValueError, match="not fitted"):
+        pbn.DynamicLoglFilter(DynamicGaussianNetwork(variables, 2))
+
+    test_df = util_test.generate_normal_data(20)
+    ll = dbn.logl(test_df)
+
+    logl_filter = pbn.DynamicLoglFilter(dbn)
+    assert logl_filter.variables == variables
+
+    values = [logl_filter.append(test_df.loc[i, variables].tolist()) for i in range(test_df.shape[0])]
+    assert logl_filter.time_step == test_df.shape[0]
+    assert values[0] == 0
+    assert np.isclose(values[1], ll[:2].sum())
+    assert np.all(np.isclose(values[2:], ll[2:]))
+    assert np.isclose(logl_filter.slogl(), dbn.slogl(test_df))
+
+    logl_filter.reset()
+    assert logl_filter.time_step == 0
+    for i in range(5):
+        logl_filter.append(test_df.loc[i, variables].to_dict())
+    assert np.isclose(logl_filter.slogl(), dbn.slogl(test_df.iloc[:5]))
+
+    with pytest.raises(ValueError, match="does not contain the variable"):
+        logl_filter.append({"a": 0., "b": 0., "c": 0.})
+    with pytest.raises(ValueError, match="time step has 3 values"):
+        logl_filter.append([0., 0., 0.])
+    assert logl_filter.time_step == 5
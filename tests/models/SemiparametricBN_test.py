@@ -151,6 +151,29 @@ def test_fit():
     cpd_c = spbn.cpd('c')
     assert cpd_c.type() == spbn.node_type('c')
 
+def test_parallel_fit():
+    arcs = [('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')]
+    node_types = [('b', pbn.CKDEType()), ('c', pbn.CKDEType())]
+    serial = SemiparametricBN(arcs, node_types)
+    serial.fit(df)
+
+    parallel = SemiparametricBN(arcs, node_types)
+    parallel.fit(df, num_threads=4)
+
+    for n in serial.nodes():
+        assert parallel.cpd(n).type() == serial.node_type(n)
+        assert parallel.cpd(n).fitted()
+
+    assert np.all(parallel.logl(df) == serial.logl(df))
+
+    parallel.set_node_type('d', pbn.CKDEType())
+    parallel.fit(df, num_threads=0)
+    assert parallel.cpd('d').type() == pbn.CKDEType()
+    assert np.all(parallel.cpd('a').logl(df) == serial.cpd('a').logl(df))
+
+    with pytest.raises(ValueError):
+        SemiparametricBN(arcs).fit(df, num_threads=-1)
+
 
 def test_cpd():
     spbn = SemiparametricBN([('a', 'b'), ('a', 'c'), ('a', 'd'), ('b', 'c'), ('b', 'd'), ('c', 'd')], [('d', pbn.CKDEType())])
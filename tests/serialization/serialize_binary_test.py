@@ -0,0 +1,269 @@
+import pickle
+import sys
+import pytest
+import numpy as np
+import pybnesian as pbn
+from pybnesian import GaussianNetwork, SemiparametricBN, DiscreteBN, CLGNetwork, ConditionalGaussianNetwork,\
+    DynamicGaussianNetwork
+import util_test
+
+df = util_test.generate_normal_data(1000)
+discrete_df = util_test.generate_discrete_data_dependent(1000)
+hybrid_df = util_test.generate_hybrid_data(1000)
+
+
+def check_loaded_model(model, loaded, df):
+    assert type(loaded) == type(model)
+    assert loaded.nodes() == model.nodes()
+    assert set(loaded.arcs()) == set(model.arcs())
+    assert loaded.fitted()
+    assert np.all(np.isclose(loaded.logl(df), model.logl(df)))
+
+
+def test_binary_gaussian(tmp_path):
+    model = GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("b", "c"), ("a", "d")])
+    model.fit(df)
+
+    model.save_binary(str(tmp_path / "gaussian"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "gaussian.pbn"))
+    check_loaded_model(model, loaded, df)
+
+    model.save_binary(str(tmp_path / "gaussian_nocpd.pbn"))
+    loaded = pbn.load_binary(str(tmp_path / "gaussian_nocpd.pbn"))
+    assert set(loaded.arcs()) == set(model.arcs())
+    assert not loaded.fitted()
+
+
+def test_binary_spbn(tmp_path):
+    model = SemiparametricBN(["a", "b", "c", "d"], [("a", "b"), ("b", "c"), ("c", "d")],
+                             [("b", pbn.CKDEType()), ("c", pbn.CKDEType())])
+    model.fit(df)
+
+    model.save_binary(str(tmp_path / "spbn"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "spbn.pbn"))
+    check_loaded_model(model, loaded, df)
+    assert loaded.node_types() == model.node_types()
+
+
+def test_binary_kdenetwork(tmp_path):
+    model = pbn.KDENetwork(["a", "b"], [("a", "b")])
+    model.fit(df)
+
+    model.save_binary(str(tmp_path / "kdenetwork"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "kdenetwork.pbn"))
+    check_loaded_model(model, loaded, df)
+
+
+def test_binary_discrete_clg(tmp_path):
+    model = DiscreteBN(["A", "B", "C", "D"], [("A", "B"), ("B", "C"), ("C", "D")])
+    model.fit(discrete_df)
+
+    model.save_binary(str(tmp_path / "discrete"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "discrete.pbn"))
+    check_loaded_model(model, loaded, discrete_df)
+
+    model = CLGNetwork(["A", "B", "C", "D"], [("A", "D"), ("B", "D"), ("C", "D")])
+    model.fit(hybrid_df)
+
+    model.save_binary(str(tmp_path / "clg"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "clg.pbn"))
+    check_loaded_model(model, loaded, hybrid_df)
+    assert loaded.node_types() == model.node_types()
+
+
+def test_binary_conditional_dynamic(tmp_path):
+    model = ConditionalGaussianNetwork(["c", "d"], ["a", "b"], [("a", "c"), ("b", "d"), ("c", "d")])
+    model.fit(df)
+
+    model.save_binary(str(tmp_path / "conditional"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "conditional.pbn"))
+    check_loaded_model(model, loaded, df)
+    assert loaded.interface_nodes() == model.interface_nodes()
+
+    dbn = DynamicGaussianNetwork(["a", "b", "c", "d"], 2)
+    dbn.fit(df)
+
+    dbn.save_binary(str(tmp_path / "dynamic"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "dynamic.pbn"))
+    assert type(loaded) == DynamicGaussianNetwork
+    assert loaded.variables() == dbn.variables()
+    assert loaded.markovian_order() == dbn.markovian_order()
+    assert loaded.fitted()
+    assert np.isclose(loaded.slogl(df), dbn.slogl(df))
+
+
+def test_binary_lazy(tmp_path):
+    model = SemiparametricBN(["a", "b", "c", "d"], [("a", "b"), ("b", "c"), ("c", "d")],
+                             [("b", pbn.CKDEType()), ("c", pbn.CKDEType())])
+    model.fit(df)
+
+    model.save_binary(str(tmp_path / "lazy"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "lazy.pbn"), lazy=True)
+    assert loaded.fitted()
+    assert type(loaded.cpd("a")) == pbn.LinearGaussianCPD
+    assert type(loaded.cpd("b")) == pbn.CKDE
+    assert loaded.cpd("b").evidence() == model.cpd("b").evidence()
+    check_loaded_model(model, loaded, df)
+
+    loaded = pbn.load_binary(str(tmp_path / "lazy.pbn"), lazy=True)
+    assert np.isclose(loaded.slogl(df), model.slogl(df))
+    sample = loaded.sample(100, seed=0)
+    assert sample.num_rows == 100
+
+
+def test_binary_memory_map(tmp_path):
+    model = SemiparametricBN(["a", "b", "c", "d"], [("a", "b"), ("b", "c"), ("c", "d")],
+                             [("b", pbn.CKDEType()), ("c", pbn.CKDEType())])
+    model.fit(df)
+
+    model.save_binary(str(tmp_path / "mapped_spbn"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "mapped_spbn.pbn"), memory_map=True)
+    check_loaded_model(model, loaded, df)
+    assert loaded.cpd("c").sample(100, df, seed=0).null_count == 0
+
+    lazy = pbn.load_binary(str(tmp_path / "mapped_spbn.pbn"), lazy=True, memory_map=True)
+    check_loaded_model(model, lazy, df)
+
+    model = DiscreteBN(["A", "B", "C", "D"], [("A", "B"), ("B", "C"), ("C", "D")])
+    model.fit(discrete_df)
+
+    model.save_binary(str(tmp_path / "mapped_discrete"), include_cpd=True)
+    loaded = pbn.load_binary(str(tmp_path / "mapped_discrete.pbn"), memory_map=True)
+    check_loaded_model(model, loaded, discrete_df)
+    assert str(loaded.cpd("B")) == str(model.cpd("B"))
+
+    # The pickled copy of a memory-mapped CPD owns its parameters.
+    unpickled = pickle.loads(pickle.dumps(loaded.cpd("B")))
+    del loaded
+    assert np.all(np.isclose(unpickled.logl(discrete_df), model.cpd("B").logl(discrete_df)))
+
+
+class MyLG(pbn.LinearGaussianCPD):
+    def __init__(self, variable, evidence):
+        pbn.LinearGaussianCPD.__init__(self, variable, evidence)
+
+
+def test_binary_python_derived(tmp_path):
+    model = GaussianNetwork(["a", "b"], [("a", "b")])
+    model.add_cpds([MyLG("a", []), MyLG("b", ["a"])])
+
+    with pytest.raises(ValueError) as ex:
+        model.save_binary(str(tmp_path / "python"), include_cpd=True)
+    assert "Python" in str(ex.value)
+
+
+def test_binary_wrong_file(tmp_path):
+    path = tmp_path / "wrong.pbn"
+    path.write_bytes(b"not a PyBNesian file")
+
+    with pytest.raises(ValueError) as ex:
+        pbn.load_binary(str(path))
+    assert "not a PyBNesian binary file" in str(ex.value)
+
+    model = GaussianNetwork(["a", "b", "c", "d"], [("a", "b")])
+    model.fit(df)
+    model.save_binary(str(tmp_path / "truncated"), include_cpd=True)
+
+    data = (tmp_path / "truncated.pbn").read_bytes()
+    (tmp_path / "truncated.pbn").write_bytes(data[:len(data) // 2])
+
+    with pytest.raises(RuntimeError) as ex:
+        pbn.load_binary(str(tmp_path / "truncated.pbn"))
+    assert "truncated" in str(ex.value)
+
+
+def test_binary_corrupted_header(tmp_path):
+    model = GaussianNetwork(["a", "b", "c", "d"], [("a", "b")])
+    model.fit(df)
+    model.save_binary(str(tmp_path / "model"), include_cpd=True)
+    data = bytearray((tmp_path / "model.pbn").read_bytes())
+
+    # Magic string, version and byte order mark. The version of a file with another byte order is not reported as a
+    # newer version.
+    swapped = bytearray(data)
+    swapped[9:13] = data[9:13][::-1]
+    swapped[13:17] = data[13:17][::-1]
+    (tmp_path / "swapped.pbn").write_bytes(swapped)
+    with pytest.raises(ValueError) as ex:
+        pbn.load_binary(str(tmp_path / "swapped.pbn"))
+    assert "byte order" in str(ex.value)
+
+    # The content and the network type strings are followed by the number of nodes.
+    pos = 17
+    for _ in range(2):
+        pos += 8 + int.from_bytes(data[pos:pos + 8], sys.byteorder)
+    corrupted = bytearray(data)
+    corrupted[pos:pos + 8] = (2**62).to_bytes(8, sys.byteorder)
+    (tmp_path / "corrupted.pbn").write_bytes(corrupted)
+    with pytest.raises(RuntimeError) as ex:
+        pbn.load_binary(str(tmp_path / "corrupted.pbn"))
+    assert "corrupted" in str(ex.value)
+
+
+def test_binary_typed_loaders(tmp_path):
+    bns = [(GaussianNetwork(["a", "b", "c", "d"], [("a", "b"), ("b", "c"), ("a", "d")]), df),
+           (SemiparametricBN(["a", "b", "c", "d"], [("a", "b"), ("b", "c")], [("b", pbn.CKDEType())]), df),
+           (pbn.KDENetwork(["a", "b"], [("a", "b")]), df),
+           (DiscreteBN(["A", "B", "C", "D"], [("A", "B"), ("B", "C"), ("C", "D")]), discrete_df),
+           (CLGNetwork(["A", "B", "C", "D"], [("A", "D"), ("B", "D"), ("C", "D")]), hybrid_df)]
+
+    for i, (model, data) in enumerate(bns):
+        model.fit(data)
+        model.save_binary(str(tmp_path / ("bn" + str(i))), include_cpd=True)
+        loaded = pbn.load_binary_bn(str(tmp_path / ("bn" + str(i) + ".pbn")))
+        check_loaded_model(model, loaded, data)
+        assert loaded.node_types() == model.node_types()
+
+    cbns = [(ConditionalGaussianNetwork(["c", "d"], ["a", "b"], [("a", "c"), ("b", "d"), ("c", "d")]), df),
+            (pbn.ConditionalSemiparametricBN(["c", "d"], ["a", "b"], [("a", "c"), ("c", "d")],
+                                             [("c", pbn.CKDEType())]), df),
+            (pbn.ConditionalKDENetwork(["c", "d"], ["a", "b"], [("a", "c")]), df),
+            (pbn.ConditionalDiscreteBN(["C", "D"], ["A", "B"], [("A", "C"), ("C", "D")]), discrete_df),
+            (pbn.ConditionalCLGNetwork(["C", "D"], ["A", "B"], [("A", "D"), ("C", "D")]), hybrid_df)]
+
+    for i, (model, data) in enumerate(cbns):
+        model.fit(data)
+        model.save_binary(str(tmp_path / ("cbn" + str(i))), include_cpd=True)
+        loaded = pbn.load_binary_cbn(str(tmp_path / ("cbn" + str(i) + ".pbn")))
+        check_loaded_model(model, loaded, data)
+        assert loaded.interface_nodes() == model.interface_nodes()
+        assert loaded.node_types() == model.node_types()
+
+    dbns = [(DynamicGaussianNetwork(["a", "b", "c", "d"], 2), df),
+            (pbn.DynamicSemiparametricBN(["a", "b", "c", "d"], 2), df),
+            (pbn.DynamicKDENetwork(["a", "b"], 1), df[["a", "b"]]),
+            (pbn.DynamicDiscreteBN(["A", "B", "C", "D"], 2), discrete_df),
+            (pbn.DynamicCLGNetwork(["A", "B", "C", "D"], 2), hybrid_df)]
+
+    for i, (dbn, data) in enumerate(dbns):
+        dbn.fit(data)
+        dbn.save_binary(str(tmp_path / ("dbn" + str(i))), include_cpd=True)
+        loaded = pbn.load_binary_dbn(str(tmp_path / ("dbn" + str(i) + ".pbn")))
+        assert type(loaded) == type(dbn)
+        assert loaded.variables() == dbn.variables()
+        assert loaded.markovian_order() == dbn.markovian_order()
+        assert set(loaded.static_bn().arcs()) == set(dbn.static_bn().arcs())
+        assert set(loaded.transition_bn().arcs()) == set(dbn.transition_bn().arcs())
+        assert loaded.fitted()
+        assert np.isclose(loaded.slogl(data), dbn.slogl(data))
+
+
+def test_binary_typed_loaders_wrong_type(tmp_path):
+    GaussianNetwork(["a", "b"], [("a", "b")]).save_binary(str(tmp_path / "bn"))
+    ConditionalGaussianNetwork(["b"], ["a"], [("a", "b")]).save_binary(str(tmp_path / "cbn"))
+    DynamicGaussianNetwork(["a", "b"], 2).save_binary(str(tmp_path / "dbn"))
+
+    bn_path = str(tmp_path / "bn.pbn")
+    cbn_path = str(tmp_path / "cbn.pbn")
+    dbn_path = str(tmp_path / "dbn.pbn")
+
+    for loader, path in [(pbn.load_binary_bn, cbn_path), (pbn.load_binary_bn, dbn_path),
+                         (pbn.load_binary_cbn, bn_path), (pbn.load_binary_cbn, dbn_path),
+                         (pbn.load_binary_dbn, bn_path), (pbn.load_binary_dbn, cbn_path)]:
+        with pytest.raises(ValueError) as ex:
+            loader(path)
+        assert "contains an object of type" in str(ex.value)
+
+    assert type(pbn.load_binary_bn(bn_path)) == GaussianNetwork
+    assert type(pbn.load_binary_cbn(cbn_path)) == ConditionalGaussianNetwork
+    assert type(pbn.load_binary_dbn(dbn_path)) == DynamicGaussianNetwork